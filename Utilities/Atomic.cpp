@@ -0,0 +1,151 @@
+#include "stdafx.h"
+#include "Atomic.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(__APPLE__)
+extern "C" int __ulock_wait(u32 operation, void* addr, u64 value, u32 timeout);
+extern "C" int __ulock_wake(u32 operation, void* addr, u64 wake_value);
+#endif
+
+namespace
+{
+#ifdef _WIN32
+	// WaitOnAddress is only available since Windows 8, loaded dynamically
+	using wait_on_address_t = BOOL(WINAPI*)(volatile VOID* addr, PVOID compare, SIZE_T size, DWORD ms);
+	using wake_by_address_t = VOID(WINAPI*)(PVOID addr);
+
+	const HMODULE g_synch_module = LoadLibraryW(L"api-ms-win-core-synch-l1-2-0.dll");
+
+	const auto g_wait_on_address = g_synch_module ? (wait_on_address_t)GetProcAddress(g_synch_module, "WaitOnAddress") : nullptr;
+	const auto g_wake_by_address_single = g_synch_module ? (wake_by_address_t)GetProcAddress(g_synch_module, "WakeByAddressSingle") : nullptr;
+	const auto g_wake_by_address_all = g_synch_module ? (wake_by_address_t)GetProcAddress(g_synch_module, "WakeByAddressAll") : nullptr;
+
+	bool is_native(std::size_t size)
+	{
+		return g_wait_on_address && size <= 8;
+	}
+#elif defined(__linux__) || defined(__APPLE__)
+	bool is_native(std::size_t size)
+	{
+		return size == 4;
+	}
+#else
+	bool is_native(std::size_t size)
+	{
+		return false;
+	}
+#endif
+
+	// Parking lot slot shared by all addresses with the same hash
+	struct wait_slot_t
+	{
+		std::mutex mutex;
+		std::condition_variable cv;
+		std::atomic<u32> waiters{ 0 };
+	};
+
+	std::array<wait_slot_t, 256> g_wait_slots;
+
+	wait_slot_t& get_slot(const volatile void* data)
+	{
+		return g_wait_slots[(reinterpret_cast<std::uintptr_t>(data) >> 3) % g_wait_slots.size()];
+	}
+
+	bool is_equal(const volatile void* data, std::size_t size, const void* old)
+	{
+		switch (size)
+		{
+		case 1: return *static_cast<const volatile u8*>(data) == *static_cast<const u8*>(old);
+		case 2: return *static_cast<const volatile u16*>(data) == *static_cast<const u16*>(old);
+		case 4: return *static_cast<const volatile u32*>(data) == *static_cast<const u32*>(old);
+		case 8: return *static_cast<const volatile u64*>(data) == *static_cast<const u64*>(old);
+		}
+
+		// torn reads may only cause spurious wakeups: the writer notifies after the write if it sees the waiter
+		return std::memcmp(const_cast<const void*>(data), old, size) == 0;
+	}
+}
+
+void atomic_wait_engine::wait(const volatile void* data, std::size_t size, const void* old, u64 timeout)
+{
+	if (is_native(size))
+	{
+#ifdef _WIN32
+		g_wait_on_address(const_cast<volatile void*>(data), const_cast<void*>(old), size, timeout ? (DWORD)std::min<u64>((timeout + 999) / 1000, INFINITE - 1) : INFINITE);
+#elif defined(__linux__)
+		struct timespec ts{ (time_t)(timeout / 1000000), (long)(timeout % 1000000 * 1000) };
+		syscall(SYS_futex, const_cast<volatile void*>(data), FUTEX_WAIT_PRIVATE, *static_cast<const u32*>(old), timeout ? &ts : nullptr, nullptr, 0);
+#elif defined(__APPLE__)
+		__ulock_wait(1 /* UL_COMPARE_AND_WAIT */, const_cast<void*>(data), *static_cast<const u32*>(old), (u32)std::min<u64>(timeout, UINT32_MAX));
+#endif
+		return;
+	}
+
+	auto& slot = get_slot(data);
+
+	std::unique_lock<std::mutex> lock(slot.mutex);
+
+	// the waiter is registered before the value is checked, so the writer either sees it or the value is already changed
+	slot.waiters++;
+
+	if (is_equal(data, size, old))
+	{
+		if (timeout)
+		{
+			slot.cv.wait_for(lock, std::chrono::microseconds(timeout));
+		}
+		else
+		{
+			slot.cv.wait(lock);
+		}
+	}
+
+	slot.waiters--;
+}
+
+void atomic_wait_engine::notify_one(const volatile void* data, std::size_t size)
+{
+	if (is_native(size))
+	{
+#ifdef _WIN32
+		g_wake_by_address_single(const_cast<void*>(data));
+#elif defined(__linux__)
+		syscall(SYS_futex, const_cast<volatile void*>(data), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#elif defined(__APPLE__)
+		__ulock_wake(1 /* UL_COMPARE_AND_WAIT */, const_cast<void*>(data), 0);
+#endif
+		return;
+	}
+
+	notify_all(data, size);
+}
+
+void atomic_wait_engine::notify_all(const volatile void* data, std::size_t size)
+{
+	if (is_native(size))
+	{
+#ifdef _WIN32
+		g_wake_by_address_all(const_cast<void*>(data));
+#elif defined(__linux__)
+		syscall(SYS_futex, const_cast<volatile void*>(data), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#elif defined(__APPLE__)
+		__ulock_wake(1 /* UL_COMPARE_AND_WAIT */ | 0x100 /* ULF_WAKE_ALL */, const_cast<void*>(data), 0);
+#endif
+		return;
+	}
+
+	auto& slot = get_slot(data);
+
+	// the slot is shared by other addresses, all its waiters are woken up
+	if (slot.waiters)
+	{
+		std::lock_guard<std::mutex> lock(slot.mutex);
+
+		slot.cv.notify_all();
+	}
+}
@@ -401,6 +401,19 @@ template<typename CT, typename... FArgs, typename VT> struct atomic_op_result_t<
 	}
 };
 
+// Blocking on the address of an atomic variable: futex (Linux), WaitOnAddress (Windows 8+), __ulock (OS X) or a hashed parking lot
+struct atomic_wait_engine
+{
+	// Sleep while size bytes at data are equal to old (may return spuriously), timeout in microseconds (0 = infinite)
+	static void wait(const volatile void* data, std::size_t size, const void* old, u64 timeout = 0);
+
+	// Wake up one thread sleeping on data (may wake up more)
+	static void notify_one(const volatile void* data, std::size_t size);
+
+	// Wake up all threads sleeping on data
+	static void notify_all(const volatile void* data, std::size_t size);
+};
+
 // Atomic type with lock-free and standard layout guarantees (and appropriate limitations)
 template<typename T> class atomic_t
 {
@@ -564,6 +577,26 @@ public:
 	{
 		return from_subtype(sync_fetch_and_xor(&m_data, to_subtype(right)) ^ to_subtype(right));
 	}
+
+	// Sleep while data is equal to old (may return spuriously, the condition must be checked again by the caller)
+	// Optional timeout in microseconds (0 = infinite)
+	void wait(const type& old, u64 timeout = 0) const volatile
+	{
+		const stype value = to_subtype(old);
+		atomic_wait_engine::wait(&m_data, sizeof(stype), &value, timeout);
+	}
+
+	// Wake up one thread sleeping in wait(), must be called after data is modified
+	void notify_one() volatile
+	{
+		atomic_wait_engine::notify_one(&m_data, sizeof(stype));
+	}
+
+	// Wake up all threads sleeping in wait(), must be called after data is modified
+	void notify_all() volatile
+	{
+		atomic_wait_engine::notify_all(&m_data, sizeof(stype));
+	}
 };
 
 template<typename T> inline std::enable_if_t<IS_INTEGRAL(T), T> operator ++(atomic_t<T>& left)
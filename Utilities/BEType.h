@@ -493,6 +493,56 @@ template<typename T> struct se_storage<T, 16>
 
 template<typename T> using se_storage_t = typename se_storage<T>::type;
 
+// Byte swap count packed elements of Size bytes (dst may be equal to src, but the arrays mustn't overlap otherwise)
+template<std::size_t Size> inline void se_swap_array(void* dst, const void* src, std::size_t count)
+{
+	static_assert(Size == 2 || Size == 4 || Size == 8, "se_swap_array<> error: invalid element size");
+
+	const auto mask = Size == 2
+		? _mm_set_epi8(14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1)
+		: Size == 4
+		? _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3)
+		: _mm_set_epi8(8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7);
+
+	const auto _dst = static_cast<u8*>(dst);
+	const auto _src = static_cast<const u8*>(src);
+	const std::size_t size = count * Size;
+
+	std::size_t i = 0;
+
+#ifdef __AVX2__
+	const auto mask256 = _mm256_broadcastsi128_si256(mask);
+
+	for (; i + 32 <= size; i += 32)
+	{
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(_dst + i), _mm256_shuffle_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(_src + i)), mask256));
+	}
+#else
+	for (; i + 32 <= size; i += 32)
+	{
+		const auto value0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_src + i));
+		const auto value1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_src + i + 16));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(_dst + i), _mm_shuffle_epi8(value0, mask));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(_dst + i + 16), _mm_shuffle_epi8(value1, mask));
+	}
+#endif
+
+	for (; i + 16 <= size; i += 16)
+	{
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(_dst + i), _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(_src + i)), mask));
+	}
+
+	using type = se_storage_t<std::conditional_t<Size == 2, u16, std::conditional_t<Size == 4, u32, u64>>>;
+
+	for (; i < size; i += Size)
+	{
+		type value;
+		std::memcpy(&value, _src + i, Size);
+		value = se_storage<type>::swap(value);
+		std::memcpy(_dst + i, &value, Size);
+	}
+}
+
 template<typename T1, typename T2> struct se_convert
 {
 	using type_from = std::remove_cv_t<T1>;
@@ -865,6 +915,26 @@ template<typename T> using le_t = se_t<T, true>;
 #endif
 
 
+// Convert count big-endian values to native ones (SIMD bulk conversion, arrays may be unaligned)
+template<typename T> inline void be_to_native(T* dst, const be_t<T>* src, std::size_t count)
+{
+#ifdef IS_LE_MACHINE
+	se_swap_array<sizeof(T)>(dst, src, count);
+#else
+	std::memcpy(dst, src, count * sizeof(T));
+#endif
+}
+
+// Convert count native values to big-endian ones (SIMD bulk conversion, arrays may be unaligned)
+template<typename T> inline void native_to_be(be_t<T>* dst, const T* src, std::size_t count)
+{
+#ifdef IS_LE_MACHINE
+	se_swap_array<sizeof(T)>(dst, src, count);
+#else
+	std::memcpy(dst, src, count * sizeof(T));
+#endif
+}
+
 template<typename T, bool Se, typename = void> struct to_se
 {
 	using type = typename std::conditional<std::is_arithmetic<T>::value || std::is_enum<T>::value, se_t<T, Se>, T>::type;
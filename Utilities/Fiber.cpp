@@ -0,0 +1,565 @@
+#include "stdafx.h"
+#include "Thread.h"
+#include "Fiber.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#ifdef __APPLE__
+#define _XOPEN_SOURCE
+#define _DARWIN_C_SOURCE
+#endif
+#include <ucontext.h>
+#include <sys/mman.h>
+#endif
+
+// Fiber stack size (reserved address space, committed on use)
+static const std::size_t fiber_stack_size = 0x800000;
+
+// Time a fiber may run while other fibers are ready
+static const auto fiber_time_slice = std::chrono::milliseconds(2);
+
+struct fiber_t
+{
+	std::function<void()> func;
+	std::function<void()> on_preempt;
+
+#ifdef _WIN32
+	void* handle = nullptr;
+#else
+	ucontext_t context;
+	void* stack = nullptr;
+#endif
+
+	// Values of the registered thread local variables while the fiber isn't running
+	std::vector<u64> tls;
+
+	std::chrono::steady_clock::time_point slice_start;
+	bool preempted = false; // on_preempt called in the current time slice
+	bool finished = false;
+};
+
+struct fiber_worker_t
+{
+#ifdef _WIN32
+	void* handle = nullptr;
+#else
+	ucontext_t context;
+#endif
+
+	// Running fiber (protected by the pool mutex)
+	fiber_t* current = nullptr;
+
+	// Values of the registered thread local variables of the worker while a fiber is running
+	std::vector<u64> tls;
+
+	// Actions done by the worker after the fiber is suspended
+	std::mutex* unlock = nullptr;
+	std::shared_ptr<fiber_wait_t> timer;
+	std::chrono::steady_clock::time_point timer_deadline;
+	bool requeue = false;
+};
+
+static thread_local fiber_worker_t* g_tls_fiber_worker = nullptr;
+
+struct fiber_tls_entry_t
+{
+	void*(*addr)();
+	std::size_t size;
+};
+
+static std::vector<fiber_tls_entry_t>& get_fiber_tls()
+{
+	static std::vector<fiber_tls_entry_t> s_entries;
+
+	return s_entries;
+}
+
+fiber_tls_t::fiber_tls_t(void*(*addr)(), std::size_t size)
+{
+	CHECK_ASSERTION(size <= sizeof(u64));
+
+	get_fiber_tls().push_back({ addr, size });
+}
+
+// Save the registered thread local variables of the current thread and set new values
+static void swap_fiber_tls(std::vector<u64>& save, const std::vector<u64>& load)
+{
+	const auto& entries = get_fiber_tls();
+
+	for (std::size_t i = 0; i < entries.size(); i++)
+	{
+		std::memcpy(&save[i], entries[i].addr(), entries[i].size);
+		std::memcpy(entries[i].addr(), &load[i], entries[i].size);
+	}
+}
+
+// Not inlined: the fiber may be resumed on another worker thread, the TLS address mustn't be reused
+static never_inline fiber_worker_t* get_fiber_worker()
+{
+	return g_tls_fiber_worker;
+}
+
+class fiber_pool_t final
+{
+	std::mutex m_mutex;
+
+	std::condition_variable m_cv; // Idle workers wait for ready fibers
+	std::condition_variable m_timer_cv;
+
+	std::deque<fiber_t*> m_ready;
+
+	// Deadlines of timed waits (entries of resumed fibers are dropped when they expire)
+	std::multimap<std::chrono::steady_clock::time_point, std::shared_ptr<fiber_wait_t>> m_timers;
+
+	std::vector<fiber_worker_t*> m_workers;
+	std::vector<std::shared_ptr<thread_ctrl>> m_threads;
+
+	u32 m_idle = 0;
+	bool m_exit = false;
+
+	// Must be called under the mutex
+	void push_ready(fiber_t* fiber)
+	{
+		m_ready.push_back(fiber);
+
+		if (m_idle)
+		{
+			m_cv.notify_one();
+		}
+		else if (m_ready.size() == 1)
+		{
+			// Running fibers may need to be preempted
+			m_timer_cv.notify_one();
+		}
+	}
+
+	static void destroy(fiber_t* fiber)
+	{
+#ifdef _WIN32
+		DeleteFiber(fiber->handle);
+#else
+		munmap(fiber->stack, fiber_stack_size);
+#endif
+		delete fiber;
+	}
+
+	void work(fiber_worker_t& worker)
+	{
+		g_tls_fiber_worker = &worker;
+
+		worker.tls.resize(get_fiber_tls().size());
+
+#ifdef _WIN32
+		worker.handle = ConvertThreadToFiberEx(nullptr, FIBER_FLAG_FLOAT_SWITCH);
+
+		if (!worker.handle)
+		{
+			throw EXCEPTION("ConvertThreadToFiberEx() failed (0x%x)", GetLastError());
+		}
+#endif
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		while (true)
+		{
+			if (m_ready.empty())
+			{
+				if (m_exit)
+				{
+					break;
+				}
+
+				m_idle++;
+				m_cv.wait(lock);
+				m_idle--;
+				continue;
+			}
+
+			const auto fiber = m_ready.front();
+			m_ready.pop_front();
+
+			worker.current = fiber;
+			fiber->slice_start = std::chrono::steady_clock::now();
+			fiber->preempted = false;
+
+			lock.unlock();
+
+			swap_fiber_tls(worker.tls, fiber->tls);
+
+#ifdef _WIN32
+			SwitchToFiber(fiber->handle);
+#else
+			swapcontext(&worker.context, &fiber->context);
+#endif
+
+			// The fiber restored the worker's thread local variables
+			lock.lock();
+
+			worker.current = nullptr;
+
+			if (worker.timer)
+			{
+				if (m_timers.empty() || worker.timer_deadline < m_timers.begin()->first)
+				{
+					m_timer_cv.notify_one();
+				}
+
+				m_timers.emplace(worker.timer_deadline, std::move(worker.timer));
+				worker.timer.reset();
+			}
+
+			if (worker.unlock)
+			{
+				// Notifiers can resume the fiber from now
+				worker.unlock->unlock();
+				worker.unlock = nullptr;
+			}
+
+			if (worker.requeue)
+			{
+				push_ready(fiber);
+				worker.requeue = false;
+			}
+
+			if (fiber->finished)
+			{
+				lock.unlock();
+				destroy(fiber);
+				lock.lock();
+			}
+		}
+
+#ifdef _WIN32
+		ConvertFiberToThread();
+#endif
+	}
+
+	void work_timers()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		while (!m_exit)
+		{
+			const auto now = std::chrono::steady_clock::now();
+
+			while (!m_timers.empty() && m_timers.begin()->first <= now)
+			{
+				const auto wait = std::move(m_timers.begin()->second);
+
+				m_timers.erase(m_timers.begin());
+
+				if (!wait->done.exchange(true))
+				{
+					wait->timed_out = true;
+					push_ready(wait->fiber);
+				}
+			}
+
+			auto wakeup = m_timers.empty() ? std::chrono::steady_clock::time_point::max() : m_timers.begin()->first;
+
+			if (!m_ready.empty())
+			{
+				// Check again at least once per time slice while fibers wait
+				wakeup = std::min(wakeup, now + fiber_time_slice);
+
+				for (const auto worker : m_workers)
+				{
+					const auto fiber = worker->current;
+
+					if (fiber && !fiber->preempted && fiber->on_preempt)
+					{
+						if (now - fiber->slice_start >= fiber_time_slice)
+						{
+							fiber->preempted = true;
+							fiber->on_preempt();
+						}
+						else
+						{
+							wakeup = std::min(wakeup, fiber->slice_start + fiber_time_slice);
+						}
+					}
+				}
+			}
+
+			if (wakeup == std::chrono::steady_clock::time_point::max())
+			{
+				m_timer_cv.wait(lock);
+			}
+			else
+			{
+				m_timer_cv.wait_until(lock, wakeup);
+			}
+		}
+	}
+
+public:
+	~fiber_pool_t()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			m_exit = true;
+			m_cv.notify_all();
+			m_timer_cv.notify_one();
+		}
+
+		for (const auto& thread : m_threads)
+		{
+			thread->join();
+		}
+
+		for (const auto worker : m_workers)
+		{
+			delete worker;
+		}
+	}
+
+	void start(u32 count)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		if (m_threads.size())
+		{
+			return;
+		}
+
+		if (!count)
+		{
+			count = std::max<u32>(size32(thread_ctrl::get_physical_cores()), 1);
+		}
+
+		for (u32 i = 0; i < count; i++)
+		{
+			const auto worker = new fiber_worker_t;
+
+			m_workers.emplace_back(worker);
+			m_threads.emplace_back(thread_ctrl::spawn([i] { return fmt::format("Fiber Worker[%u]", i); }, [this, worker] { work(*worker); }));
+		}
+
+		m_threads.emplace_back(thread_ctrl::spawn(PURE_EXPR("Fiber Timer"s), [this] { work_timers(); }));
+	}
+
+	void ready(fiber_t* fiber)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		push_ready(fiber);
+	}
+
+	// Check whether other fibers are ready, restart the time slice of the current one otherwise
+	bool should_yield(fiber_t* fiber)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		if (m_ready.empty())
+		{
+			fiber->slice_start = std::chrono::steady_clock::now();
+			fiber->preempted = false;
+			return false;
+		}
+
+		return true;
+	}
+};
+
+static fiber_pool_t g_fiber_pool;
+
+// Suspend the current fiber, the worker does the actions set in fiber_worker_t then
+static void switch_to_worker(fiber_worker_t* worker, fiber_t* fiber)
+{
+	swap_fiber_tls(fiber->tls, worker->tls);
+
+#ifdef _WIN32
+	SwitchToFiber(worker->handle);
+#else
+	swapcontext(&fiber->context, &worker->context);
+#endif
+}
+
+#ifdef _WIN32
+static void WINAPI fiber_entry(void* arg)
+{
+	const auto fiber = static_cast<fiber_t*>(arg);
+#else
+static void fiber_entry()
+{
+	const auto fiber = get_fiber_worker()->current;
+#endif
+
+	try
+	{
+		fiber->func();
+	}
+	catch (...)
+	{
+		catch_all_exceptions();
+	}
+
+	fiber->func = nullptr;
+	fiber->on_preempt = nullptr;
+	fiber->finished = true;
+
+	switch_to_worker(get_fiber_worker(), fiber);
+}
+
+void fiber::start(u32 count)
+{
+	g_fiber_pool.start(count);
+}
+
+fiber_t* fiber::get_current()
+{
+	const auto worker = get_fiber_worker();
+
+	return worker ? worker->current : nullptr;
+}
+
+void fiber::spawn(std::function<void()> func, std::function<void()> on_preempt)
+{
+	std::unique_ptr<fiber_t> fiber(new fiber_t);
+
+	fiber->func = std::move(func);
+	fiber->on_preempt = std::move(on_preempt);
+	fiber->tls.resize(get_fiber_tls().size());
+
+#ifdef _WIN32
+	fiber->handle = CreateFiberEx(0, fiber_stack_size, FIBER_FLAG_FLOAT_SWITCH, fiber_entry, fiber.get());
+
+	if (!fiber->handle)
+	{
+		throw EXCEPTION("CreateFiberEx() failed (0x%x)", GetLastError());
+	}
+#else
+	fiber->stack = mmap(nullptr, fiber_stack_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+	if (fiber->stack == MAP_FAILED)
+	{
+		throw EXCEPTION("mmap() failed (%d)", errno);
+	}
+
+	// Guard page
+	mprotect(fiber->stack, 4096, PROT_NONE);
+
+	getcontext(&fiber->context);
+	fiber->context.uc_stack.ss_sp = fiber->stack;
+	fiber->context.uc_stack.ss_size = fiber_stack_size;
+	fiber->context.uc_link = nullptr;
+	makecontext(&fiber->context, fiber_entry, 0);
+#endif
+
+	g_fiber_pool.ready(fiber.release());
+}
+
+void fiber::yield()
+{
+	const auto worker = get_fiber_worker();
+
+	if (!worker || !worker->current || !g_fiber_pool.should_yield(worker->current))
+	{
+		return;
+	}
+
+	worker->requeue = true;
+	switch_to_worker(worker, worker->current);
+}
+
+std::cv_status thread_cv_t::fiber_wait(std::unique_lock<std::mutex>& lock, const std::chrono::steady_clock::time_point* deadline)
+{
+	const auto worker = get_fiber_worker();
+	const auto wait = std::make_shared<fiber_wait_t>(worker->current);
+
+	m_mutex.lock();
+	m_fibers.emplace_back(wait);
+	m_fiber_count++;
+
+	lock.unlock();
+
+	// The worker unlocks m_mutex and starts the timer after the fiber is suspended
+	worker->unlock = &m_mutex;
+
+	if (deadline)
+	{
+		worker->timer = wait;
+		worker->timer_deadline = *deadline;
+	}
+
+	switch_to_worker(worker, wait->fiber);
+
+	if (wait->timed_out)
+	{
+		std::lock_guard<std::mutex> cv_lock(m_mutex);
+
+		const auto found = std::find(m_fibers.begin(), m_fibers.end(), wait);
+
+		if (found != m_fibers.end())
+		{
+			m_fibers.erase(found);
+			m_fiber_count--;
+		}
+	}
+
+	lock.lock();
+
+	return wait->timed_out ? std::cv_status::timeout : std::cv_status::no_timeout;
+}
+
+bool thread_cv_t::fiber_notify(bool all)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	bool result = false;
+
+	while (m_fibers.size())
+	{
+		const auto wait = std::move(m_fibers.front());
+
+		m_fibers.pop_front();
+		m_fiber_count--;
+
+		// Skip fibers resumed by the timer
+		if (!wait->done.exchange(true))
+		{
+			g_fiber_pool.ready(wait->fiber);
+
+			result = true;
+
+			if (!all)
+			{
+				break;
+			}
+		}
+	}
+
+	return result;
+}
+
+void thread_cv_t::wait(std::unique_lock<std::mutex>& lock)
+{
+	if (!fiber::get_current())
+	{
+		return m_cv.wait(lock);
+	}
+
+	fiber_wait(lock, nullptr);
+}
+
+void thread_cv_t::notify_one()
+{
+	if (m_fiber_count && fiber_notify(false))
+	{
+		return;
+	}
+
+	m_cv.notify_one();
+}
+
+void thread_cv_t::notify_all()
+{
+	if (m_fiber_count)
+	{
+		fiber_notify(true);
+	}
+
+	m_cv.notify_all();
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+//! Fibers: user-space threads multiplexed onto a fixed pool of host worker threads.
+//! A fiber gives its worker to another ready fiber only when it waits on thread_cv_t, calls fiber::yield()
+//! or exits; other blocking calls (host mutexes, atomic waits, I/O) block the worker itself.
+//! Thread local variables are per worker thread, the ones which must follow the fiber are registered with fiber_tls_t
+//! (MSVC needs /GT so that TLS addresses aren't cached across the switches).
+
+struct fiber_t;
+
+namespace fiber
+{
+	// Start the worker threads (only the first call has effect, count = 0 uses the physical core count)
+	void start(u32 count);
+
+	// Get the current fiber (nullptr if not called on a fiber)
+	fiber_t* get_current();
+
+	// Create a fiber and make it ready, on_preempt is called (from another thread) when its time slice expired and other fibers wait
+	void spawn(std::function<void()> func, std::function<void()> on_preempt = nullptr);
+
+	// Give the worker to other ready fibers (returns immediately if there are none)
+	void yield();
+}
+
+// Registers a thread local variable (up to 8 bytes, trivially copyable) which is saved and restored on every fiber switch.
+// The accessor returns its address in the current thread. New fibers start with zeroed values.
+struct fiber_tls_t final
+{
+	fiber_tls_t(void*(*addr)(), std::size_t size);
+};
+
+// Wait node of a fiber waiting on thread_cv_t, resumed by the notifier or by the timer (whichever sets `done` first)
+struct fiber_wait_t final
+{
+	fiber_t* const fiber;
+
+	std::atomic<bool> done{ false };
+
+	bool timed_out = false;
+
+	fiber_wait_t(fiber_t* fiber)
+		: fiber(fiber)
+	{
+	}
+};
+
+// Condition variable for threads and fibers: a waiting fiber is suspended and its worker runs other fibers
+class thread_cv_t final
+{
+	std::condition_variable m_cv;
+
+	// Protects m_fibers (a waiting fiber keeps it locked until it's suspended)
+	std::mutex m_mutex;
+
+	std::deque<std::shared_ptr<fiber_wait_t>> m_fibers;
+
+	std::atomic<u32> m_fiber_count{ 0 };
+
+	std::cv_status fiber_wait(std::unique_lock<std::mutex>& lock, const std::chrono::steady_clock::time_point* deadline);
+
+	// Resume waiting fibers, returns false if there were none
+	bool fiber_notify(bool all);
+
+public:
+	void wait(std::unique_lock<std::mutex>& lock);
+
+	template<typename P>
+	void wait(std::unique_lock<std::mutex>& lock, P pred)
+	{
+		while (!pred())
+		{
+			wait(lock);
+		}
+	}
+
+	template<typename Clock, typename Duration>
+	std::cv_status wait_until(std::unique_lock<std::mutex>& lock, const std::chrono::time_point<Clock, Duration>& time)
+	{
+		if (!fiber::get_current())
+		{
+			return m_cv.wait_until(lock, time);
+		}
+
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(time - Clock::now());
+
+		return fiber_wait(lock, &deadline);
+	}
+
+	template<typename Rep, typename Period>
+	std::cv_status wait_for(std::unique_lock<std::mutex>& lock, const std::chrono::duration<Rep, Period>& duration)
+	{
+		if (!fiber::get_current())
+		{
+			return m_cv.wait_for(lock, duration);
+		}
+
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration);
+
+		return fiber_wait(lock, &deadline);
+	}
+
+	template<typename Rep, typename Period, typename P>
+	bool wait_for(std::unique_lock<std::mutex>& lock, const std::chrono::duration<Rep, Period>& duration, P pred)
+	{
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration);
+
+		while (!pred())
+		{
+			if (wait_until(lock, deadline) == std::cv_status::timeout)
+			{
+				return pred();
+			}
+		}
+
+		return true;
+	}
+
+	void notify_one();
+
+	void notify_all();
+};
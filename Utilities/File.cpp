@@ -351,6 +351,36 @@ bool fs::rename(const std::string& from, const std::string& to)
 #endif
 }
 
+bool fs::write_file_atomic(const std::string& path, const void* data, u64 size)
+{
+	static std::atomic<u64> g_tmp_counter{ 0 };
+
+	// Unique name in the same directory (same volume), also among processes sharing the directory
+	const std::string tmp = fmt::format("%s.%llx.%llx.tmp", path, std::chrono::system_clock::now().time_since_epoch().count(), std::hash<std::thread::id>()(std::this_thread::get_id()) ^ g_tmp_counter++);
+
+	{
+		const fs::file f(tmp, fom::write | fom::create | fom::excl);
+
+		if (!f || f.write(data, size) != size)
+		{
+			fs::remove_file(tmp);
+			return false;
+		}
+	}
+
+#ifdef _WIN32
+	if (!MoveFileExW(to_wchar(tmp).get(), to_wchar(path).get(), MOVEFILE_REPLACE_EXISTING))
+#else
+	if (::rename(tmp.c_str(), path.c_str()))
+#endif
+	{
+		fs::remove_file(tmp);
+		return false;
+	}
+
+	return true;
+}
+
 bool fs::copy_file(const std::string& from, const std::string& to, bool overwrite)
 {
 #ifdef _WIN32
@@ -651,6 +681,15 @@ bool fs::file::stat(stat_t& info) const
 	return true;
 }
 
+bool fs::file::sync() const
+{
+#ifdef _WIN32
+	return FlushFileBuffers((HANDLE)m_fd) != FALSE;
+#else
+	return !::fsync(m_fd);
+#endif
+}
+
 void fs::file::close()
 {
 	if (m_fd == null)
@@ -699,6 +738,36 @@ u64 fs::file::read(void* buffer, u64 count) const
 #endif
 }
 
+u64 fs::file::read_at(u64 offset, void* buffer, u64 count) const
+{
+	const int size = count <= INT_MAX ? static_cast<int>(count) : throw EXCEPTION("Invalid count (0x%llx)", count);
+
+#ifdef _WIN32
+	// the file pointer is updated by ReadFile even with OVERLAPPED, but it's never used by positional reads
+	OVERLAPPED ovl{};
+	ovl.Offset = static_cast<DWORD>(offset);
+	ovl.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+	DWORD nread;
+	if (!ReadFile((HANDLE)m_fd, buffer, size, &nread, &ovl))
+	{
+		// TODO: convert Win32 error code to errno
+		switch (DWORD error = GetLastError())
+		{
+		case ERROR_HANDLE_EOF: return 0;
+		case ERROR_INVALID_HANDLE: errno = EBADF; break;
+		default: throw EXCEPTION("Unknown Win32 error: 0x%x.", error);
+		}
+
+		return -1;
+	}
+
+	return nread;
+#else
+	return ::pread(m_fd, buffer, size, offset);
+#endif
+}
+
 u64 fs::file::write(const void* buffer, u64 count) const
 {
 	// TODO (call WriteFile multiple times if count is too big)
@@ -841,6 +910,56 @@ void fs::file_read_map::reset()
 #else
 		::munmap(m_ptr, m_size);
 #endif
+		m_ptr = nullptr;
+	}
+}
+
+void fs::file_read_map::prefetch(u64 offset, u64 count) const
+{
+	if (!m_ptr || offset >= m_size)
+	{
+		return;
+	}
+
+	count = std::min<u64>(count, m_size - offset);
+
+#ifdef _WIN32
+	// TODO (PrefetchVirtualMemory requires Windows 8)
+#else
+	// madvise requires page-aligned address
+	const u64 start = offset & ~0xfffull;
+	::madvise(m_ptr + start, count + (offset - start), MADV_WILLNEED);
+#endif
+}
+
+void fs::file_write_map::reset(const file& f)
+{
+	reset();
+
+	if (f)
+	{
+#ifdef _WIN32
+		const HANDLE handle = ::CreateFileMapping((HANDLE)f.m_fd, NULL, PAGE_READWRITE, 0, 0, NULL);
+		m_ptr = (char*)::MapViewOfFile(handle, FILE_MAP_WRITE, 0, 0, 0);
+		m_size = f.size();
+		::CloseHandle(handle);
+#else
+		m_ptr = (char*)::mmap(nullptr, m_size = f.size(), PROT_READ | PROT_WRITE, MAP_SHARED, f.m_fd, 0);
+		if (m_ptr == (void*)-1) m_ptr = nullptr;
+#endif
+	}
+}
+
+void fs::file_write_map::reset()
+{
+	if (m_ptr)
+	{
+#ifdef _WIN32
+		::UnmapViewOfFile(m_ptr);
+#else
+		::munmap(m_ptr, m_size);
+#endif
+		m_ptr = nullptr;
 	}
 }
 
@@ -902,7 +1021,8 @@ bool fs::dir::read(std::string& name, stat_t& info)
 
 	if (is_first)
 	{
-		m_dd = (std::intptr_t)FindFirstFileW(to_wchar(m_path.get() + "/*"s).get(), &found);
+		// the short name isn't used, large fetch reduces the number of kernel calls for big directories
+		m_dd = (std::intptr_t)FindFirstFileExW(to_wchar(m_path.get() + "/*"s).get(), FindExInfoBasic, &found, FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH);
 	}
 
 	if (is_first && m_dd == -1 || !is_first && !FindNextFileW((HANDLE)m_dd, &found))
@@ -61,6 +61,9 @@ namespace fs
 	// Rename (move) file or directory
 	bool rename(const std::string& from, const std::string& to);
 
+	// Replace file contents atomically (written to a temporary file which is renamed), other processes see the old or the new file
+	bool write_file_atomic(const std::string& path, const void* data, u64 size);
+
 	// Copy file contents
 	bool copy_file(const std::string& from, const std::string& to, bool overwrite);
 
@@ -124,12 +127,18 @@ namespace fs
 		// Get file information
 		bool stat(stat_t& info) const;
 
+		// Flush written data to the storage device
+		bool sync() const;
+
 		// Close the file explicitly (destructor automatically closes the file)
 		void close();
 
 		// Read the data from the file and return the amount of data written in buffer
 		u64 read(void* buffer, u64 count) const;
 
+		// Read the data at specified position without changing the file pointer (thread-safe)
+		u64 read_at(u64 offset, void* buffer, u64 count) const;
+
 		// Write the data to the file and return the amount of data actually written
 		u64 write(const void* buffer, u64 count) const;
 
@@ -240,6 +249,15 @@ namespace fs
 		// Close file mapping
 		void reset();
 
+		// Hint that the specified range will be read soon
+		void prefetch(u64 offset, u64 count) const;
+
+		// Get mapping size
+		u64 size() const
+		{
+			return m_ptr ? m_size : 0;
+		}
+
 		// Get pointer
 		operator const char*() const
 		{
@@ -286,6 +304,12 @@ namespace fs
 		// Close file mapping
 		void reset();
 
+		// Get mapping size
+		u64 size() const
+		{
+			return m_ptr ? m_size : 0;
+		}
+
 		// Get pointer
 		operator char*() const
 		{
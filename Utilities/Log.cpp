@@ -2,6 +2,7 @@
 #include "Thread.h"
 #include "File.h"
 #include "Log.h"
+#include "Emu/PerfCounters.h"
 
 #ifdef _WIN32
 #include <Windows.h>
@@ -38,7 +39,8 @@ _log::listener::listener()
 
 _log::listener::~listener()
 {
-	// Unregister self
+	// Write queued messages and unregister self
+	get_logger().flush();
 	get_logger().remove_listener(this);
 }
 
@@ -49,6 +51,139 @@ _log::channel::channel(const std::string& name, _log::level init_level)
 	// TODO: register config property "name" associated with "enabled" member
 }
 
+// Bounded lock-free queue of log messages (multiple producers, the log thread is the only consumer)
+struct _log::logger::queue_t
+{
+	static const u64 size = 0x4000;
+
+	struct record_t
+	{
+		const channel* ch;
+		level sev;
+		std::string thread;
+		std::string text;
+	};
+
+	struct slot_t
+	{
+		std::atomic<u64> seq;
+		record_t data;
+	};
+
+	std::unique_ptr<slot_t[]> slots{ new slot_t[size] };
+
+	std::atomic<u64> push_pos{ 0 };
+	std::atomic<u64> pop_pos{ 0 }; // written by the log thread only
+	std::atomic<u64> dropped{ 0 };
+	std::atomic<bool> exit{ false };
+
+	std::thread thread;
+
+	queue_t()
+	{
+		for (u64 i = 0; i < size; i++)
+		{
+			slots[i].seq = i;
+		}
+
+		perf::mem_add(perf::mem_log, size * sizeof(slot_t));
+	}
+
+	// Returns the position of the record or -1 if the queue is full
+	u64 push(record_t&& record)
+	{
+		u64 pos = push_pos.load(std::memory_order_relaxed);
+
+		while (true)
+		{
+			slot_t& slot = slots[pos % size];
+
+			const u64 seq = slot.seq.load(std::memory_order_acquire);
+
+			if (seq == pos)
+			{
+				if (push_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					slot.data = std::move(record);
+					slot.seq.store(pos + 1, std::memory_order_release);
+					return pos;
+				}
+			}
+			else if (seq < pos)
+			{
+				return -1;
+			}
+			else
+			{
+				pos = push_pos.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	bool pop(record_t& record)
+	{
+		const u64 pos = pop_pos.load(std::memory_order_relaxed);
+
+		slot_t& slot = slots[pos % size];
+
+		if (slot.seq.load(std::memory_order_acquire) != pos + 1)
+		{
+			return false;
+		}
+
+		record = std::move(slot.data);
+		slot.seq.store(pos + size, std::memory_order_release);
+		pop_pos.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+};
+
+_log::logger::logger()
+	: m_queue(new queue_t)
+{
+	m_queue->thread = std::thread([this]() { dispatch(); });
+}
+
+_log::logger::~logger()
+{
+	m_queue->exit = true;
+	m_queue->thread.join();
+}
+
+void _log::logger::dispatch()
+{
+	queue_t::record_t record;
+
+	while (true)
+	{
+		if (!m_queue->pop(record))
+		{
+			if (m_queue->exit)
+			{
+				break;
+			}
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
+		}
+
+		reader_lock lock(m_mutex);
+
+		if (const u64 dropped = m_queue->dropped.exchange(0))
+		{
+			for (auto listener : m_listeners)
+			{
+				listener->log(*record.ch, level::warning, record.thread, fmt::format("%llu log messages dropped (the log queue was full)", dropped));
+			}
+		}
+
+		for (auto listener : m_listeners)
+		{
+			listener->log(*record.ch, record.sev, record.thread, record.text);
+		}
+	}
+}
+
 void _log::logger::add_listener(_log::listener* listener)
 {
 	std::lock_guard<shared_mutex> lock(m_mutex);
@@ -65,11 +200,33 @@ void _log::logger::remove_listener(_log::listener* listener)
 
 void _log::logger::broadcast(const _log::channel& ch, _log::level sev, const std::string& text) const
 {
-	reader_lock lock(m_mutex);
+	const auto t = thread_ctrl::get_current();
+
+	const u64 pos = m_queue->push({ &ch, sev, t ? t->get_name() : std::string{}, text });
 
-	for (auto listener : m_listeners)
+	if (pos == -1)
 	{
-		listener->log(ch, sev, text);
+		m_queue->dropped++;
+		return;
+	}
+
+	if (sev <= level::fatal)
+	{
+		// the process may be terminated after the fatal error
+		while (m_queue->pop_pos.load(std::memory_order_acquire) <= pos && !m_queue->exit)
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+void _log::logger::flush() const
+{
+	const u64 pos = m_queue->push_pos.load();
+
+	while (m_queue->pop_pos.load(std::memory_order_acquire) < pos && !m_queue->exit)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
 	}
 }
 
@@ -78,6 +235,11 @@ void _log::broadcast(const _log::channel& ch, _log::level sev, const std::string
 	get_logger().broadcast(ch, sev, text);
 }
 
+void _log::flush()
+{
+	get_logger().flush();
+}
+
 _log::file_writer::file_writer(const std::string& name)
 {
 	try
@@ -107,7 +269,7 @@ std::size_t _log::file_writer::size() const
 	return m_file.seek(0, fs::seek_cur);
 }
 
-void _log::file_listener::log(const _log::channel& ch, _log::level sev, const std::string& text)
+void _log::file_listener::log(const _log::channel& ch, _log::level sev, const std::string& thread, const std::string& text)
 {
 	std::string msg; msg.reserve(text.size() + 200);
 
@@ -126,10 +288,10 @@ void _log::file_listener::log(const _log::channel& ch, _log::level sev, const st
 
 	// TODO: print time?
 
-	if (auto t = thread_ctrl::get_current())
+	if (thread.size())
 	{
 		msg += '{';
-		msg += t->get_name();
+		msg += thread;
 		msg += "} ";
 	}
 
@@ -2,6 +2,11 @@
 
 #include "SharedMutex.h"
 
+// The lowest log level compiled in, calls with lower levels are eliminated at compile time (may be set by the build, e.g. to notice)
+#ifndef LOG_MAX_LEVEL
+#define LOG_MAX_LEVEL trace
+#endif
+
 namespace _log
 {
 	enum class level : uint
@@ -19,27 +24,44 @@ namespace _log
 	struct channel;
 	struct listener;
 
-	// Log manager
+	// Log manager: messages are queued by the emulation threads and sent to the listeners by a background thread
 	class logger final
 	{
+		struct queue_t;
+
 		mutable shared_mutex m_mutex;
 
 		std::set<listener*> m_listeners;
 
+		std::unique_ptr<queue_t> m_queue;
+
+		// Log thread loop
+		void dispatch();
+
 	public:
+		logger();
+
+		~logger();
+
 		// Register listener
 		void add_listener(listener* listener);
 
 		// Unregister listener
 		void remove_listener(listener* listener);
 
-		// Send log message to all listeners
+		// Queue log message (never blocks: the message is dropped if the queue is full, fatal messages are waited for)
 		void broadcast(const channel& ch, level sev, const std::string& text) const;
+
+		// Wait until all queued messages are sent to the listeners
+		void flush() const;
 	};
 
 	// Send log message to global logger instance
 	void broadcast(const channel& ch, level sev, const std::string& text);
 
+	// Wait until all log messages are written
+	void flush();
+
 	// Log channel (source)
 	struct channel
 	{
@@ -73,7 +95,8 @@ namespace _log
 		template<typename... Args>\
 		force_inline void _sev(const char* fmt, const Args&... args)\
 		{\
-			return format<Args...>(level::_sev, fmt, args...);\
+			if (level::_sev <= level::LOG_MAX_LEVEL)\
+				return format<Args...>(level::_sev, fmt, args...);\
 		}
 
 		GEN_LOG_METHOD(fatal)
@@ -94,7 +117,8 @@ namespace _log
 		
 		virtual ~listener();
 
-		virtual void log(const channel& ch, level sev, const std::string& text) = 0;
+		// Called from the log thread (thread is the name of the thread which logged the message)
+		virtual void log(const channel& ch, level sev, const std::string& thread, const std::string& text) = 0;
 	};
 
 	class file_writer
@@ -122,8 +146,8 @@ namespace _log
 		{
 		}
 
-		// Encode level, current thread name, channel name and write log message
-		virtual void log(const channel& ch, level sev, const std::string& text) override;
+		// Encode level, thread name, channel name and write log message
+		virtual void log(const channel& ch, level sev, const std::string& thread, const std::string& text) override;
 	};
 
 	// Global variable for RPCS3.log
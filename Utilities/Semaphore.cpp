@@ -4,22 +4,22 @@
 bool semaphore_t::try_wait()
 {
 	// check m_value without interlocked op
-	if (m_var.load().value == 0)
+	if (m_value.load() == 0)
 	{
 		return false;
 	}
 
 	// try to decrement m_value atomically
-	const auto old = m_var.atomic_op([](sync_var_t& var)
+	const auto old = m_value.atomic_op([](u32& value)
 	{
-		if (var.value)
+		if (value)
 		{
-			var.value--;
+			value--;
 		}
 	});
 
 	// recheck atomic result
-	if (old.value == 0)
+	if (old == 0)
 	{
 		return false;
 	}
@@ -30,32 +30,30 @@ bool semaphore_t::try_wait()
 bool semaphore_t::try_post()
 {
 	// check m_value without interlocked op
-	if (m_var.load().value >= max_value)
+	if (m_value.load() >= max_value)
 	{
 		return false;
 	}
 
 	// try to increment m_value atomically
-	const auto old = m_var.atomic_op([&](sync_var_t& var)
+	const auto old = m_value.atomic_op([&](u32& value)
 	{
-		if (var.value < max_value)
+		if (value < max_value)
 		{
-			var.value++;
+			value++;
 		}
 	});
 
 	// recheck atomic result
-	if (old.value >= max_value)
+	if (old >= max_value)
 	{
 		return false;
 	}
 
-	if (old.waiters)
+	if (m_waiters.load())
 	{
 		// notify waiting thread
-		std::lock_guard<std::mutex> lock(m_mutex);
-
-		m_cv.notify_one();
+		m_value.notify_one();
 	}
 
 	return true;
@@ -63,49 +61,20 @@ bool semaphore_t::try_post()
 
 void semaphore_t::wait()
 {
-	if (m_var.atomic_op([](sync_var_t& var) -> bool
-	{
-		if (var.value)
-		{
-			var.value--;
-
-			return true;
-		}
-		else
-		{
-			//var.waiters++;
-
-			return false;
-		}
-	}))
+	if (try_wait())
 	{
 		return;
 	}
 
-	std::unique_lock<std::mutex> lock(m_mutex);
+	// registered before m_value is checked again, so try_post() either sees the waiter or the new value is seen here
+	m_waiters++;
 
-	m_var.atomic_op([](sync_var_t& var)
+	while (!try_wait())
 	{
-		var.waiters++;
-	});
-
-	while (!m_var.atomic_op([](sync_var_t& var) -> bool
-	{
-		if (var.value)
-		{
-			var.value--;
-			var.waiters--;
-
-			return true;
-		}
-		else
-		{
-			return false;
-		}
-	}))
-	{
-		m_cv.wait(lock);
+		m_value.wait(0);
 	}
+
+	m_waiters--;
 }
 
 bool semaphore_t::post_and_wait()
@@ -117,4 +86,4 @@ bool semaphore_t::post_and_wait()
 	wait();
 
 	return true;
-}
+}
\ No newline at end of file
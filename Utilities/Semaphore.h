@@ -2,27 +2,18 @@
 
 class semaphore_t
 {
-	// semaphore mutex
-	std::mutex m_mutex;
+	// current semaphore value (waiters sleep on it)
+	atomic_t<u32> m_value;
 
-	// semaphore condition variable
-	std::condition_variable m_cv;
-
-	struct sync_var_t
-	{
-		u32 value; // current semaphore value
-		u32 waiters; // current amount of waiters
-	};
-
-	// current semaphore value
-	atomic_t<sync_var_t> m_var;
+	// current amount of waiters
+	atomic_t<u32> m_waiters{ 0 };
 
 public:
 	// max semaphore value
 	const u32 max_value;
 
 	semaphore_t(u32 max_value = 1, u32 value = 0)
-		: m_var(sync_var_t{ value, 0 })
+		: m_value(value)
 		, max_value(max_value)
 	{
 	}
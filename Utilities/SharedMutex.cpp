@@ -1,36 +1,82 @@
 #include "stdafx.h"
 #include "SharedMutex.h"
 
+bool shared_mutex::impl_spin(bool(*op)(u32&))
+{
+	const u32 spin_count = m_spin_count.load();
+
+	for (u32 i = 0; i < spin_count; i++)
+	{
+		_mm_pause();
+
+		u32 ctrl = m_ctrl.load();
+		const u32 old = ctrl;
+
+		if (op(ctrl) && m_ctrl.compare_and_swap_test(old, ctrl))
+		{
+			// Spinning pays off, allow longer spins (up to 1024 iterations)
+			if (spin_count < 1024)
+			{
+				m_spin_count.compare_and_swap(spin_count, spin_count * 2);
+			}
+
+			return true;
+		}
+	}
+
+	// The lock is held for long periods, spin less (down to 16 iterations)
+	if (spin_count > 16)
+	{
+		m_spin_count.compare_and_swap(spin_count, spin_count / 2);
+	}
+
+	return false;
+}
+
+void shared_mutex::impl_sleep(u32 ctrl, u32 flags)
+{
+	// Set the flags before sleeping, the thread which clears SM_WAITERS notifies all sleeping threads
+	if ((ctrl & (flags | SM_WAITERS)) != (flags | SM_WAITERS) && !m_ctrl.compare_and_swap_test(ctrl, ctrl | flags | SM_WAITERS))
+	{
+		return;
+	}
+
+	m_sleeps++;
+	m_ctrl.wait(ctrl | flags | SM_WAITERS);
+}
+
 void shared_mutex::impl_lock_shared(u32 old_value)
 {
 	// Throw if reader count breaks the "second" limit (it should be impossible)
 	CHECK_ASSERTION((old_value & SM_READER_COUNT) != SM_READER_COUNT);
 
-	std::unique_lock<std::mutex> lock(m_mutex);
-
-	// Notify non-zero reader queue size
-	m_ctrl |= SM_READER_QUEUE;
+	m_contended++;
 
 	// Compensate incorrectly increased reader count
-	if ((--m_ctrl & SM_READER_COUNT) == 0 && m_wq_size)
+	impl_unlock_shared(--m_ctrl);
+
+	if (impl_spin(op_lock_shared))
 	{
-		// Notify current exclusive owner (condition passed)
-		m_ocv.notify_one();
+		return;
 	}
 
-	CHECK_ASSERTION(++m_rq_size);
-
 	// Obtain the reader lock
-	while (!atomic_op(m_ctrl, op_lock_shared))
+	while (true)
 	{
-		m_rcv.wait(lock);
-	}
+		u32 ctrl = m_ctrl.load();
+		const u32 old = ctrl;
 
-	CHECK_ASSERTION(m_rq_size--);
+		if (op_lock_shared(ctrl))
+		{
+			if (m_ctrl.compare_and_swap_test(old, ctrl))
+			{
+				return;
+			}
 
-	if (m_rq_size == 0)
-	{
-		m_ctrl &= ~SM_READER_QUEUE;
+			continue;
+		}
+
+		impl_sleep(old, 0);
 	}
 }
 
@@ -39,46 +85,73 @@ void shared_mutex::impl_unlock_shared(u32 new_value)
 	// Throw if reader count was zero
 	CHECK_ASSERTION((new_value & SM_READER_COUNT) != SM_READER_COUNT);
 
-	// Mutex cannot be unlocked before notification because m_ctrl has been changed outside
-	std::lock_guard<std::mutex> lock(m_mutex);
-
-	if (m_wq_size && (new_value & SM_READER_COUNT) == 0)
-	{
-		// Notify current exclusive owner that the latest reader is gone
-		m_ocv.notify_one();
-	}
-	else if (m_rq_size)
+	if ((new_value & SM_WRITER_LOCK && (new_value & SM_READER_COUNT) == 0) || (new_value & SM_WAITERS && (new_value & SM_READER_COUNT) == SM_READER_MAX - 1))
 	{
-		m_rcv.notify_one();
+		// Notify current exclusive owner that the latest reader is gone (or readers waiting for the reader limit)
+		m_ctrl.notify_all();
 	}
 }
 
 void shared_mutex::impl_lock_excl(u32 value)
 {
-	std::unique_lock<std::mutex> lock(m_mutex);
-
-	// Notify non-zero writer queue size
-	m_ctrl |= SM_WRITER_QUEUE;
-
-	CHECK_ASSERTION(++m_wq_size);
+	m_contended++;
 
-	// Obtain the writer lock
-	while (!atomic_op(m_ctrl, op_lock_excl))
+	if (!impl_spin(op_lock_excl))
 	{
-		m_wcv.wait(lock);
+		bool queued = false;
+
+		// Obtain the writer lock
+		while (true)
+		{
+			u32 ctrl = m_ctrl.load();
+			const u32 old = ctrl;
+
+			if (op_lock_excl(ctrl))
+			{
+				if (m_ctrl.compare_and_swap_test(old, ctrl))
+				{
+					break;
+				}
+
+				continue;
+			}
+
+			if (!queued)
+			{
+				// Block new readers while waiting
+				CHECK_ASSERTION(++m_wq_size);
+				queued = true;
+			}
+
+			impl_sleep(old, SM_WRITER_QUEUE);
+		}
+
+		// The flag may be set again by another writer or left cleared until it sleeps
+		if (queued && --m_wq_size == 0)
+		{
+			m_ctrl &= ~SM_WRITER_QUEUE;
+		}
 	}
 
 	// Wait for remaining readers
-	while ((m_ctrl & SM_READER_COUNT) != 0)
+	for (u32 i = 0;; i++)
 	{
-		m_ocv.wait(lock);
-	}
-
-	CHECK_ASSERTION(m_wq_size--);
-
-	if (m_wq_size == 0)
-	{
-		m_ctrl &= ~SM_WRITER_QUEUE;
+		const u32 ctrl = m_ctrl.load();
+
+		if ((ctrl & SM_READER_COUNT) == 0)
+		{
+			break;
+		}
+
+		if (i < m_spin_count.load())
+		{
+			_mm_pause();
+			continue;
+		}
+
+		// The latest reader notifies (SM_WRITER_LOCK is set)
+		m_sleeps++;
+		m_ctrl.wait(ctrl);
 	}
 }
 
@@ -87,17 +160,10 @@ void shared_mutex::impl_unlock_excl(u32 value)
 	// Throw if was not locked exclusively
 	CHECK_ASSERTION(value & SM_WRITER_LOCK);
 
-	// Mutex cannot be unlocked before notification because m_ctrl has been changed outside
-	std::lock_guard<std::mutex> lock(m_mutex);
-	
-	if (m_wq_size)
-	{
-		// Notify next exclusive owner
-		m_wcv.notify_one();
-	}
-	else if (m_rq_size)
+	if (value & SM_WAITERS)
 	{
-		// Notify all readers
-		m_rcv.notify_all();
+		// Notify all sleeping readers and writers, they set the flag again if they need to sleep
+		m_ctrl &= ~SM_WAITERS;
+		m_ctrl.notify_all();
 	}
 }
@@ -4,34 +4,31 @@
 //! All locking and unlocking may be done by single LOCK XADD or LOCK CMPXCHG instructions.
 //! MSVC implementation of std::shared_timed_mutex seems suboptimal.
 //! std::shared_mutex is not available until C++17.
+//! Contended threads spin shortly, then sleep on the control variable itself (atomic_t<>::wait).
 class shared_mutex final
 {
 	enum : u32
 	{
 		SM_WRITER_LOCK  = 1u << 31, // Exclusive lock flag, must be MSB
-		SM_WRITER_QUEUE = 1u << 30, // Flag set if m_wq_size != 0
-		SM_READER_QUEUE = 1u << 29, // Flag set if m_rq_size != 0
+		SM_WRITER_QUEUE = 1u << 30, // Flag set if m_wq_size != 0 (new readers wait)
+		SM_WAITERS      = 1u << 29, // Flag set by sleeping threads, cleared by the notifying thread
 
-		SM_READER_COUNT = SM_READER_QUEUE - 1, // Valid reader count bit mask
+		SM_READER_COUNT = SM_WAITERS - 1, // Valid reader count bit mask
 		SM_READER_MAX   = 1u << 24, // Max reader count
 	};
 
-	std::atomic<u32> m_ctrl{}; // Control atomic variable: reader count | SM_* flags
-	std::thread::id m_owner{}; // Current exclusive owner (TODO: implement only for debug mode?)
+	atomic_t<u32> m_ctrl{ 0 }; // Control atomic variable: reader count | SM_* flags
 
-	std::mutex m_mutex;
+	atomic_t<u32> m_wq_size{ 0 }; // Amount of writers waiting for the exclusive lock
+	atomic_t<u32> m_spin_count{ 64 }; // Spin iterations before sleeping, adjusted by the spin results
 
-	u32 m_rq_size{}; // Reader queue size (threads waiting on m_rcv)
-	u32 m_wq_size{}; // Writer queue size (threads waiting on m_wcv+m_ocv)
-	
-	std::condition_variable m_rcv; // Reader queue
-	std::condition_variable m_wcv; // Writer queue
-	std::condition_variable m_ocv; // For current exclusive owner
+	atomic_t<u64> m_contended{ 0 }; // Amount of lock operations which took the slow path
+	atomic_t<u64> m_sleeps{ 0 }; // Amount of times a thread went to sleep
 
 	static bool op_lock_shared(u32& ctrl)
 	{
 		// Check writer flags and reader limit
-		return (ctrl & ~SM_READER_QUEUE) < SM_READER_MAX ? ctrl++, true : false;
+		return (ctrl & ~SM_WAITERS) < SM_READER_MAX ? ctrl++, true : false;
 	}
 
 	static bool op_lock_excl(u32& ctrl)
@@ -40,6 +37,8 @@ class shared_mutex final
 		return (ctrl & SM_WRITER_LOCK) == 0 ? ctrl |= SM_WRITER_LOCK, true : false;
 	}
 
+	bool impl_spin(bool(*op)(u32&));
+	void impl_sleep(u32 ctrl, u32 flags);
 	void impl_lock_shared(u32 old_ctrl);
 	void impl_unlock_shared(u32 new_ctrl);
 	void impl_lock_excl(u32 ctrl);
@@ -63,7 +62,7 @@ public:
 	// Try to lock in shared mode
 	bool try_lock_shared()
 	{
-		return atomic_op(m_ctrl, [](u32& ctrl)
+		return m_ctrl.atomic_op([](u32& ctrl)
 		{
 			// Check flags and reader limit
 			return ctrl < SM_READER_MAX ? ctrl++, true : false;
@@ -85,9 +84,9 @@ public:
 	// Lock exclusively
 	void lock()
 	{
-		u32 value = 0;
+		const u32 value = m_ctrl.compare_and_swap(0, SM_WRITER_LOCK);
 
-		if (!m_ctrl.compare_exchange_strong(value, SM_WRITER_LOCK))
+		if (value != 0)
 		{
 			impl_lock_excl(value);
 		}
@@ -96,15 +95,13 @@ public:
 	// Try to lock exclusively
 	bool try_lock()
 	{
-		u32 value = 0;
-
-		return m_ctrl.compare_exchange_strong(value, SM_WRITER_LOCK);
+		return m_ctrl.compare_and_swap_test(0, SM_WRITER_LOCK);
 	}
 
 	// Unlock exclusively
 	void unlock()
 	{
-		const u32 value = m_ctrl.fetch_add(SM_WRITER_LOCK);
+		const u32 value = m_ctrl._xor(SM_WRITER_LOCK);
 
 		// Check if notification required
 		if (value != SM_WRITER_LOCK)
@@ -112,6 +109,18 @@ public:
 			impl_unlock_excl(value);
 		}
 	}
+
+	// Amount of lock operations which didn't succeed immediately
+	u64 contention_count() const
+	{
+		return m_contended.load();
+	}
+
+	// Amount of times a contended thread had to sleep
+	u64 sleep_count() const
+	{
+		return m_sleeps.load();
+	}
 };
 
 //! Simplified shared (reader) lock implementation, similar to std::lock_guard.
@@ -3,9 +3,25 @@
 
 #include "SleepQueue.h"
 
+void sleep_queue_insert(sleep_queue_t& queue, const sleep_queue_t::value_type& thread, bool priority)
+{
+	if (!priority)
+	{
+		return queue.emplace_back(thread);
+	}
+
+	// binary search for the position after all threads with the same or higher priority
+	const s32 prio = thread->get_prio();
+
+	queue.emplace(std::upper_bound(queue.begin(), queue.end(), prio, [](s32 prio, const sleep_queue_t::value_type& entry)
+	{
+		return prio < entry->get_prio();
+	}), thread);
+}
+
 void sleep_queue_entry_t::add_entry()
 {
-	m_queue.emplace_back(std::static_pointer_cast<CPUThread>(m_thread.shared_from_this()));
+	sleep_queue_insert(m_queue, std::static_pointer_cast<CPUThread>(m_thread.shared_from_this()), m_priority);
 }
 
 void sleep_queue_entry_t::remove_entry()
@@ -33,17 +49,19 @@ bool sleep_queue_entry_t::find() const
 	return false;
 }
 
-sleep_queue_entry_t::sleep_queue_entry_t(sleep_entry_t& cpu, sleep_queue_t& queue)
+sleep_queue_entry_t::sleep_queue_entry_t(sleep_entry_t& cpu, sleep_queue_t& queue, bool priority)
 	: m_thread(cpu)
 	, m_queue(queue)
+	, m_priority(priority)
 {
 	add_entry();
 	cpu.sleep();
 }
 
-sleep_queue_entry_t::sleep_queue_entry_t(sleep_entry_t& cpu, sleep_queue_t& queue, const defer_sleep_t&)
+sleep_queue_entry_t::sleep_queue_entry_t(sleep_entry_t& cpu, sleep_queue_t& queue, const defer_sleep_t&, bool priority)
 	: m_thread(cpu)
 	, m_queue(queue)
+	, m_priority(priority)
 {
 	cpu.sleep();
 }
@@ -5,22 +5,26 @@ using sleep_queue_t = std::deque<std::shared_ptr<sleep_entry_t>>;
 
 static struct defer_sleep_t {} const defer_sleep{};
 
+// add thread to the sleep queue; if priority is set, the queue is kept ordered by get_prio() (FIFO among equal priorities)
+void sleep_queue_insert(sleep_queue_t& queue, const sleep_queue_t::value_type& thread, bool priority);
+
 // automatic object handling a thread entry in the sleep queue
 class sleep_queue_entry_t final
 {
 	sleep_entry_t& m_thread;
 	sleep_queue_t& m_queue;
+	const bool m_priority;
 
 	void add_entry();
 	void remove_entry();
 	bool find() const;
 
 public:
-	// add specified thread to the sleep queue
-	sleep_queue_entry_t(sleep_entry_t& entry, sleep_queue_t& queue);
+	// add specified thread to the sleep queue (ordered by priority if set)
+	sleep_queue_entry_t(sleep_entry_t& entry, sleep_queue_t& queue, bool priority = false);
 
 	// don't add specified thread to the sleep queue
-	sleep_queue_entry_t(sleep_entry_t& entry, sleep_queue_t& queue, const defer_sleep_t&);
+	sleep_queue_entry_t(sleep_entry_t& entry, sleep_queue_t& queue, const defer_sleep_t&, bool priority = false);
 
 	// removes specified thread from the sleep queue if added
 	~sleep_queue_entry_t();
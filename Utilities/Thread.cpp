@@ -19,6 +19,15 @@
 #include <ucontext.h>
 #endif
 
+#ifdef __linux__
+#include <sched.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+
 static void report_fatal_error(const std::string& msg)
 {
 #ifdef _WIN32
@@ -802,6 +811,8 @@ size_t get_x64_access_size(x64_context* context, x64_op_t op, x64_reg_t reg, siz
  */
 std::function<bool(u32 addr)> gfxHandler = [](u32) { return false; };
 
+extern bool ppu_on_code_write(u32 addr);
+
 bool handle_access_violation(u32 addr, bool is_writing, x64_context* context)
 {
 	auto code = (const u8*)RIP(context);
@@ -814,6 +825,14 @@ bool handle_access_violation(u32 addr, bool is_writing, x64_context* context)
 	if (gfxHandler(addr))
 		return true;
 
+	// check if the page is watched by compiled PPU code (the access is repeated after invalidation)
+	if (is_writing && ppu_on_code_write(addr))
+		return true;
+
+	// check if the page is protected by the memory snapshot (the access is repeated after copying)
+	if (is_writing && vm::snapshot_on_write(addr))
+		return true;
+
 	// decode single x64 instruction that causes memory access
 	decode_x64_reg_op(code, op, reg, d_size, i_size);
 
@@ -843,7 +862,7 @@ bool handle_access_violation(u32 addr, bool is_writing, x64_context* context)
 	}
 
 	// check if address is RawSPU MMIO register
-	if (addr - RAW_SPU_BASE_ADDR < (6 * RAW_SPU_OFFSET) && (addr % RAW_SPU_OFFSET) >= RAW_SPU_PROB_OFFSET)
+	if (IsRawSPUMMIO(addr))
 	{
 		auto thread = Emu.GetCPU().GetRawSPUThread((addr - RAW_SPU_BASE_ADDR) / RAW_SPU_OFFSET);
 
@@ -1270,12 +1289,22 @@ const bool g_exception_handler_set = []() -> bool
 
 thread_local thread_ctrl* thread_ctrl::g_tls_this_thread = nullptr;
 
+const fiber_tls_t thread_ctrl::g_fiber_tls([]() -> void* { return &g_tls_this_thread; }, sizeof(g_tls_this_thread));
+
 // TODO
 std::atomic<u32> g_thread_count{ 0 };
 
 void thread_ctrl::initialize()
 {
-	SetCurrentThreadDebugName(g_tls_this_thread->m_name().c_str());
+	// Fibers share the worker thread
+	if (!g_tls_this_thread->m_is_fiber)
+	{
+		SetCurrentThreadDebugName(g_tls_this_thread->m_name().c_str());
+
+#ifdef __linux__
+		g_tls_this_thread->m_native_id = syscall(SYS_gettid);
+#endif
+	}
 
 	// TODO
 	g_thread_count++;
@@ -1298,7 +1327,10 @@ void thread_ctrl::finalize() noexcept
 
 thread_ctrl::~thread_ctrl()
 {
-	m_thread.detach();
+	if (m_thread.joinable())
+	{
+		m_thread.detach();
+	}
 
 	if (m_future.valid())
 	{
@@ -1320,6 +1352,190 @@ std::string thread_ctrl::get_name() const
 	return m_name();
 }
 
+void thread_ctrl::set_native_priority(int priority) const
+{
+	if (m_is_fiber)
+	{
+		// The worker thread is shared with other fibers
+		return;
+	}
+
+#ifdef _WIN32
+	// THREAD_PRIORITY_LOWEST .. THREAD_PRIORITY_HIGHEST are -2 .. 2 (the handle may be not set yet in the thread itself)
+	const HANDLE handle = this == g_tls_this_thread ? GetCurrentThread() : const_cast<std::thread&>(m_thread).native_handle();
+
+	if (!SetThreadPriority(handle, priority))
+	{
+		LOG_WARNING(GENERAL, "set_native_priority(%d) failed for '%s' (0x%x)", priority, get_name(), GetLastError());
+	}
+#elif defined(__linux__)
+	// Linux threads have their own nice value, raising the priority requires CAP_SYS_NICE
+	if (const s64 tid = m_native_id)
+	{
+		setpriority(PRIO_PROCESS, static_cast<id_t>(tid), -5 * priority);
+	}
+#endif
+}
+
+void thread_ctrl::set_native_affinity(u64 mask) const
+{
+	if (m_is_fiber)
+	{
+		return;
+	}
+
+#ifdef _WIN32
+	const HANDLE handle = this == g_tls_this_thread ? GetCurrentThread() : const_cast<std::thread&>(m_thread).native_handle();
+
+	DWORD_PTR process_mask, system_mask;
+
+	if (!mask && GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask))
+	{
+		mask = process_mask;
+	}
+
+	if (!SetThreadAffinityMask(handle, static_cast<DWORD_PTR>(mask)))
+	{
+		LOG_WARNING(GENERAL, "set_native_affinity(0x%llx) failed for '%s' (0x%x)", mask, get_name(), GetLastError());
+	}
+#elif defined(__linux__)
+	if (const s64 tid = m_native_id)
+	{
+		cpu_set_t set;
+		CPU_ZERO(&set);
+
+		for (u32 i = 0; i < CPU_SETSIZE; i++)
+		{
+			if (!mask || (i < 64 && mask & (1ull << i)))
+			{
+				CPU_SET(i, &set);
+			}
+		}
+
+		if (sched_setaffinity(static_cast<pid_t>(tid), sizeof(set), &set) != 0)
+		{
+			LOG_WARNING(GENERAL, "set_native_affinity(0x%llx) failed for '%s' (%d)", mask, get_name(), errno);
+		}
+	}
+#endif
+}
+
+u64 thread_ctrl::get_cpu_time() const
+{
+	if (m_is_fiber)
+	{
+		// The worker thread is shared with other fibers
+		return 0;
+	}
+
+#ifdef _WIN32
+	const HANDLE handle = this == g_tls_this_thread ? GetCurrentThread() : const_cast<std::thread&>(m_thread).native_handle();
+
+	FILETIME creation, exit, kernel, user;
+
+	if (GetThreadTimes(handle, &creation, &exit, &kernel, &user))
+	{
+		// 100 ns units
+		const u64 k = u64{ kernel.dwHighDateTime } << 32 | kernel.dwLowDateTime;
+		const u64 u = u64{ user.dwHighDateTime } << 32 | user.dwLowDateTime;
+		return (k + u) / 10;
+	}
+#elif defined(__linux__)
+	clockid_t clock;
+	timespec ts;
+
+	const pthread_t handle = this == g_tls_this_thread ? pthread_self() : const_cast<std::thread&>(m_thread).native_handle();
+
+	if (m_native_id && pthread_getcpuclockid(handle, &clock) == 0 && clock_gettime(clock, &ts) == 0)
+	{
+		return ts.tv_sec * 1000000ull + ts.tv_nsec / 1000;
+	}
+#endif
+
+	return 0;
+}
+
+const std::vector<u64>& thread_ctrl::get_physical_cores()
+{
+	static const std::vector<u64> s_cores = []()
+	{
+		std::vector<u64> cores;
+		const u32 count = std::min<u32>(64, std::max<u32>(1, std::thread::hardware_concurrency()));
+
+#ifdef _WIN32
+		DWORD size = 0;
+		GetLogicalProcessorInformation(nullptr, &size);
+
+		std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> info(size / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+
+		if (size && GetLogicalProcessorInformation(info.data(), &size))
+		{
+			for (auto& entry : info)
+			{
+				if (entry.Relationship == RelationProcessorCore && entry.ProcessorMask)
+				{
+					cores.emplace_back(entry.ProcessorMask);
+				}
+			}
+		}
+#elif defined(__linux__)
+		// group logical processors by (package, core)
+		std::vector<std::pair<u64, u64>> ids;
+
+		auto read_id = [](u32 cpu, const char* name) -> s64
+		{
+			const fs::file f(fmt::format("/sys/devices/system/cpu/cpu%u/topology/%s", cpu, name));
+
+			char buf[32]{};
+
+			if (!f || !f.read(buf, sizeof(buf) - 1))
+			{
+				return -1;
+			}
+
+			return std::strtoll(buf, nullptr, 10);
+		};
+
+		for (u32 i = 0; i < count; i++)
+		{
+			const s64 package = read_id(i, "physical_package_id");
+			const s64 core = read_id(i, "core_id");
+
+			// unknown topology: every processor is a core
+			const u64 id = package < 0 || core < 0 ? ~0ull - i : static_cast<u64>(package) << 32 | static_cast<u32>(core);
+
+			auto found = std::find_if(ids.begin(), ids.end(), [=](const auto& pair) { return pair.first == id; });
+
+			if (found == ids.end())
+			{
+				ids.emplace_back(id, 1ull << i);
+			}
+			else
+			{
+				found->second |= 1ull << i;
+			}
+		}
+
+		for (auto& pair : ids)
+		{
+			cores.emplace_back(pair.second);
+		}
+#endif
+
+		if (cores.empty())
+		{
+			for (u32 i = 0; i < count; i++)
+			{
+				cores.emplace_back(1ull << i);
+			}
+		}
+
+		return cores;
+	}();
+
+	return s_cores;
+}
+
 std::string named_thread_t::get_name() const
 {
 	return fmt::format("('%s') Unnamed Thread", typeid(*this).name());
@@ -1346,8 +1562,8 @@ void named_thread_t::start()
 		}
 	};
 
-	// Run thread
-	m_thread = thread_ctrl::spawn(std::move(name), [thread = std::move(ptr)]()
+	// Thread task
+	auto task = [thread = std::move(ptr)]()
 	{
 		try
 		{
@@ -1368,7 +1584,23 @@ void named_thread_t::start()
 		}
 
 		thread->on_exit();
-	});
+	};
+
+	// Run thread
+	if (run_on_fiber())
+	{
+		m_thread = thread_ctrl::spawn_fiber(std::move(name), std::move(task), [wptr = std::weak_ptr<named_thread_t>(shared_from_this())]()
+		{
+			if (const auto ptr = wptr.lock())
+			{
+				ptr->on_fiber_preempt();
+			}
+		});
+	}
+	else
+	{
+		m_thread = thread_ctrl::spawn(std::move(name), std::move(task));
+	}
 }
 
 void named_thread_t::join()
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "Fiber.h"
+
 // Will report exception and call std::abort() if put in catch(...)
 [[noreturn]] void catch_all_exceptions();
 
@@ -20,6 +22,15 @@ class thread_ctrl final
 	// Functions scheduled at thread exit
 	std::deque<std::function<void()>> m_atexit;
 
+	// Host thread ID (Linux), set at the thread start
+	std::atomic<s64> m_native_id{ 0 };
+
+	// Runs on a fiber (no host thread of its own)
+	bool m_is_fiber = false;
+
+	// Fiber thread local variable: g_tls_this_thread
+	static const fiber_tls_t g_fiber_tls;
+
 	// Called at the thread start
 	static void initialize();
 
@@ -53,6 +64,18 @@ public:
 		return g_tls_this_thread;
 	}
 
+	// Set host priority of the thread (-2 = lowest, 0 = normal, 2 = highest), may silently fail without permissions
+	void set_native_priority(int priority) const;
+
+	// Restrict the thread to the host logical processors in the mask (0 = all processors), ignored if not supported
+	void set_native_affinity(u64 mask) const;
+
+	// Get host CPU time consumed by the thread (microseconds, 0 for fibers or if not supported)
+	u64 get_cpu_time() const;
+
+	// Get masks of host logical processors which belong to the same physical core, for every core (first 64 processors)
+	static const std::vector<u64>& get_physical_cores();
+
 	// Register function at thread exit (for the current thread)
 	template<typename T>
 	static inline void at_exit(T&& func)
@@ -93,6 +116,39 @@ public:
 
 		return ctrl;
 	}
+
+	// Named fiber factory (see Fiber.h), on_preempt is called when the time slice expired
+	template<typename N, typename F, typename P>
+	static inline std::shared_ptr<thread_ctrl> spawn_fiber(N&& name, F&& func, P&& on_preempt)
+	{
+		auto ctrl = std::make_shared<thread_ctrl>(std::forward<N>(name));
+
+		auto promise = std::make_shared<std::promise<void>>();
+
+		ctrl->m_future = promise->get_future();
+		ctrl->m_is_fiber = true;
+
+		fiber::spawn([ctrl, promise, task = std::forward<F>(func)]()
+		{
+			g_tls_this_thread = ctrl.get();
+
+			try
+			{
+				initialize();
+				task();
+				finalize();
+				promise->set_value();
+			}
+			catch (...)
+			{
+				finalize();
+				promise->set_exception(std::current_exception());
+			}
+
+		}, std::forward<P>(on_preempt));
+
+		return ctrl;
+	}
 };
 
 class named_thread_t : public std::enable_shared_from_this<named_thread_t>
@@ -102,7 +158,7 @@ class named_thread_t : public std::enable_shared_from_this<named_thread_t>
 
 public:
 	// Thread condition variable for external use (this thread waits on it, other threads may notify)
-	std::condition_variable cv;
+	thread_cv_t cv;
 
 	// Thread mutex for external use (can be used with `cv`)
 	std::mutex mutex;
@@ -120,6 +176,12 @@ protected:
 	// ID finalization (called through id_aux_finalize)
 	virtual void on_id_aux_finalize() { join(); }
 
+	// Run the thread on a fiber instead of a host thread (checked in start())
+	virtual bool run_on_fiber() const { return false; }
+
+	// Called from another thread when the fiber should yield (its time slice expired and other fibers are ready)
+	virtual void on_fiber_preempt() {}
+
 public:
 	named_thread_t() = default;
 
@@ -172,48 +234,183 @@ public:
 	}
 };
 
+// Event counter for waiting on state changes made by other threads: take get() before checking the awaited condition,
+// then wait() returns as soon as notify() is called after it (no lost wakeups); the timeout allows to check exit conditions
+class event_notifier_t final
+{
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	u64 m_count = 0;
+
+public:
+	u64 get()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		return m_count;
+	}
+
+	void notify()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			m_count++;
+		}
+
+		m_cv.notify_all();
+	}
+
+	void wait(u64 count, std::chrono::milliseconds timeout = std::chrono::milliseconds(20))
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		m_cv.wait_for(lock, timeout, [&] { return m_count != count; });
+	}
+};
+
 extern const std::function<bool()> SQUEUE_ALWAYS_EXIT;
 extern const std::function<bool()> SQUEUE_NEVER_EXIT;
 
 bool squeue_test_exit();
 
-template<typename T, u32 sq_size = 256>
+// Bounded queue, lock-free (Vyukov's bounded MPMC queue: each slot has a sequence number telling whether it's free or filled).
+// If is_spsc is set, only one thread may push and only one thread may pop (positions are updated without CAS).
+// Blocked threads sleep on the event counter, which is only notified if there are waiters.
+template<typename T, u32 sq_size = 256, bool is_spsc = false>
 class squeue_t
 {
-	struct squeue_sync_var_t
+	// Slot sequence: equal to the push position if free, to the push position + 1 if filled (64 bit positions never wrap)
+	atomic_t<u64> m_seq[sq_size];
+
+	T m_data[sq_size];
+
+	atomic_t<u64> m_push_pos{ 0 };
+	atomic_t<u64> m_pop_pos{ 0 };
+
+	atomic_t<u32> m_event{ 0 }; // Incremented after each push or pop
+	atomic_t<u32> m_waiters{ 0 };
+
+	// Claim up to count free slots, returns the amount claimed and their first position (0 if the queue is full)
+	u32 claim_push(u32 count, u64& pos)
 	{
-		struct
+		while (true)
 		{
-			u32 position : 31;
-			u32 pop_lock : 1;
-		};
-		struct
+			pos = m_push_pos.load();
+
+			u32 result = 0;
+
+			while (result < count && m_seq[(pos + result) % sq_size].load() == pos + result)
+			{
+				result++;
+			}
+
+			if (!result && static_cast<s64>(m_seq[pos % sq_size].load() - pos) < 0)
+			{
+				return 0;
+			}
+
+			if (result && (is_spsc || m_push_pos.compare_and_swap_test(pos, pos + result)))
+			{
+				if (is_spsc)
+				{
+					m_push_pos = pos + result;
+				}
+
+				// Data is written after the sequence
+				std::atomic_thread_fence(std::memory_order_acquire);
+				return result;
+			}
+
+			// Another thread claimed the slot
+		}
+	}
+
+	// Claim up to count filled slots, returns the amount claimed and their first position (0 if the queue is empty)
+	u32 claim_pop(u32 count, u64& pos)
+	{
+		while (true)
 		{
-			u32 count : 31;
-			u32 push_lock : 1;
-		};
-	};
+			pos = m_pop_pos.load();
+
+			u32 result = 0;
 
-	atomic_t<squeue_sync_var_t> m_sync;
+			while (result < count && m_seq[(pos + result) % sq_size].load() == pos + result + 1)
+			{
+				result++;
+			}
 
-	mutable std::mutex m_rcv_mutex;
-	mutable std::mutex m_wcv_mutex;
-	mutable std::condition_variable m_rcv;
-	mutable std::condition_variable m_wcv;
+			if (!result && static_cast<s64>(m_seq[pos % sq_size].load() - (pos + 1)) < 0)
+			{
+				return 0;
+			}
 
-	T m_data[sq_size];
+			if (result && (is_spsc || m_pop_pos.compare_and_swap_test(pos, pos + result)))
+			{
+				if (is_spsc)
+				{
+					m_pop_pos = pos + result;
+				}
+
+				// Data is read after the sequence
+				std::atomic_thread_fence(std::memory_order_acquire);
+				return result;
+			}
+		}
+	}
+
+	void notify()
+	{
+		m_event++;
+
+		if (m_waiters.load())
+		{
+			m_event.notify_all();
+		}
+	}
 
-	enum squeue_sync_var_result : u32
+	// Call op() until it returns true, sleep between attempts. Returns false if the exit test passes first.
+	template<typename F>
+	bool wait_op(F op, const std::function<bool()>& test_exit)
 	{
-		SQSVR_OK = 0,
-		SQSVR_LOCKED = 1,
-		SQSVR_FAILED = 2,
-	};
+		if (op())
+		{
+			return true;
+		}
+
+		// Registered before the event is read: the other side either sees the waiter or the change is seen by op()
+		m_waiters++;
+
+		while (true)
+		{
+			const u32 event = m_event.load();
+
+			if (op())
+			{
+				break;
+			}
+
+			if (test_exit() || squeue_test_exit())
+			{
+				m_waiters--;
+				return false;
+			}
+
+			// Exit conditions aren't notified, check them periodically
+			m_event.wait(event, 1000);
+		}
+
+		m_waiters--;
+		return true;
+	}
 
 public:
 	squeue_t()
-		: m_sync(squeue_sync_var_t{})
 	{
+		for (u32 i = 0; i < sq_size; i++)
+		{
+			m_seq[i] = u64{i};
+		}
 	}
 
 	u32 get_max_size() const
@@ -223,55 +420,75 @@ public:
 
 	bool is_full() const
 	{
-		return m_sync.load().count == sq_size;
+		return m_push_pos.load() - m_pop_pos.load() >= sq_size;
 	}
 
-	bool push(const T& data, const std::function<bool()>& test_exit)
+	// Push count elements, returns the amount pushed (less than count if the exit test passed)
+	u32 push_n(const T* data, u32 count, const std::function<bool()>& test_exit)
 	{
-		u32 pos = 0;
+		u32 done = 0;
 
-		while (u32 res = m_sync.atomic_op([&pos](squeue_sync_var_t& sync) -> u32
+		while (done < count)
 		{
-			assert(sync.count <= sq_size);
-			assert(sync.position < sq_size);
+			u64 pos = 0;
+			u32 claimed = 0;
 
-			if (sync.push_lock)
+			if (!wait_op([&]() { return (claimed = claim_push(count - done, pos)) != 0; }, test_exit))
 			{
-				return SQSVR_LOCKED;
+				break;
 			}
-			if (sync.count == sq_size)
+
+			for (u32 i = 0; i < claimed; i++)
 			{
-				return SQSVR_FAILED;
+				m_data[(pos + i) % sq_size] = data[done + i];
 			}
 
-			sync.push_lock = 1;
-			pos = sync.position + sync.count;
-			return SQSVR_OK;
-		}))
-		{
-			if (res == SQSVR_FAILED && (test_exit() || squeue_test_exit()))
+			// Publish the slots after the data
+			std::atomic_thread_fence(std::memory_order_release);
+
+			for (u32 i = 0; i < claimed; i++)
 			{
-				return false;
+				m_seq[(pos + i) % sq_size] = pos + i + 1;
 			}
 
-			std::unique_lock<std::mutex> wcv_lock(m_wcv_mutex);
-			m_wcv.wait_for(wcv_lock, std::chrono::milliseconds(1));
+			done += claimed;
+			notify();
 		}
 
-		m_data[pos >= sq_size ? pos - sq_size : pos] = data;
+		return done;
+	}
+
+	// Pop up to count elements, waits for one at least. Returns the amount popped (0 if the exit test passed).
+	u32 pop_n(T* data, u32 count, const std::function<bool()>& test_exit)
+	{
+		u64 pos = 0;
+		u32 claimed = 0;
+
+		if (!count || !wait_op([&]() { return (claimed = claim_pop(count, pos)) != 0; }, test_exit))
+		{
+			return 0;
+		}
 
-		m_sync.atomic_op([](squeue_sync_var_t& sync)
+		for (u32 i = 0; i < claimed; i++)
 		{
-			assert(sync.count <= sq_size);
-			assert(sync.position < sq_size);
-			assert(sync.push_lock);
-			sync.push_lock = 0;
-			sync.count++;
-		});
-
-		m_rcv.notify_one();
-		m_wcv.notify_one();
-		return true;
+			data[i] = std::move(m_data[(pos + i) % sq_size]);
+		}
+
+		// Free the slots after the data is read
+		std::atomic_thread_fence(std::memory_order_release);
+
+		for (u32 i = 0; i < claimed; i++)
+		{
+			m_seq[(pos + i) % sq_size] = pos + i + sq_size;
+		}
+
+		notify();
+		return claimed;
+	}
+
+	bool push(const T& data, const std::function<bool()>& test_exit)
+	{
+		return push_n(&data, 1, test_exit) == 1;
 	}
 
 	bool push(const T& data, const volatile bool* do_exit)
@@ -291,55 +508,7 @@ public:
 
 	bool pop(T& data, const std::function<bool()>& test_exit)
 	{
-		u32 pos = 0;
-
-		while (u32 res = m_sync.atomic_op([&pos](squeue_sync_var_t& sync) -> u32
-		{
-			assert(sync.count <= sq_size);
-			assert(sync.position < sq_size);
-
-			if (!sync.count)
-			{
-				return SQSVR_FAILED;
-			}
-			if (sync.pop_lock)
-			{
-				return SQSVR_LOCKED;
-			}
-
-			sync.pop_lock = 1;
-			pos = sync.position;
-			return SQSVR_OK;
-		}))
-		{
-			if (res == SQSVR_FAILED && (test_exit() || squeue_test_exit()))
-			{
-				return false;
-			}
-
-			std::unique_lock<std::mutex> rcv_lock(m_rcv_mutex);
-			m_rcv.wait_for(rcv_lock, std::chrono::milliseconds(1));
-		}
-
-		data = m_data[pos];
-
-		m_sync.atomic_op([](squeue_sync_var_t& sync)
-		{
-			assert(sync.count <= sq_size);
-			assert(sync.position < sq_size);
-			assert(sync.pop_lock);
-			sync.pop_lock = 0;
-			sync.position++;
-			sync.count--;
-			if (sync.position == sq_size)
-			{
-				sync.position = 0;
-			}
-		});
-
-		m_rcv.notify_one();
-		m_wcv.notify_one();
-		return true;
+		return pop_n(&data, 1, test_exit) == 1;
 	}
 
 	bool pop(T& data, const volatile bool* do_exit)
@@ -357,51 +526,34 @@ public:
 		return pop(data, SQUEUE_ALWAYS_EXIT);
 	}
 
+	// Copy the element at start_pos from the front, the element may be popped concurrently only if T is trivially copyable
 	bool peek(T& data, u32 start_pos, const std::function<bool()>& test_exit)
 	{
 		assert(start_pos < sq_size);
-		u32 pos = 0;
-
-		while (u32 res = m_sync.atomic_op([&pos, start_pos](squeue_sync_var_t& sync) -> u32
-		{
-			assert(sync.count <= sq_size);
-			assert(sync.position < sq_size);
-
-			if (sync.count <= start_pos)
-			{
-				return SQSVR_FAILED;
-			}
-			if (sync.pop_lock)
-			{
-				return SQSVR_LOCKED;
-			}
 
-			sync.pop_lock = 1;
-			pos = sync.position + start_pos;
-			return SQSVR_OK;
-		}))
+		return wait_op([&]() -> bool
 		{
-			if (res == SQSVR_FAILED && (test_exit() || squeue_test_exit()))
+			while (true)
 			{
-				return false;
+				const u64 front = m_pop_pos.load();
+				const u64 pos = front + start_pos;
+
+				if (m_seq[pos % sq_size].load() != pos + 1)
+				{
+					return false;
+				}
+
+				std::atomic_thread_fence(std::memory_order_acquire);
+				data = m_data[pos % sq_size];
+				std::atomic_thread_fence(std::memory_order_acquire);
+
+				// The slot can only be reused if the front moved
+				if (m_pop_pos.load() == front)
+				{
+					return true;
+				}
 			}
-
-			std::unique_lock<std::mutex> rcv_lock(m_rcv_mutex);
-			m_rcv.wait_for(rcv_lock, std::chrono::milliseconds(1));
-		}
-
-		data = m_data[pos >= sq_size ? pos - sq_size : pos];
-
-		m_sync.atomic_op([](squeue_sync_var_t& sync)
-		{
-			assert(sync.count <= sq_size);
-			assert(sync.position < sq_size);
-			assert(sync.pop_lock);
-			sync.pop_lock = 0;
-		});
-
-		m_rcv.notify_one();
-		return true;
+		}, test_exit);
 	}
 
 	bool peek(T& data, u32 start_pos, const volatile bool* do_exit)
@@ -419,92 +571,13 @@ public:
 		return peek(data, start_pos, SQUEUE_ALWAYS_EXIT);
 	}
 
-	class squeue_data_t
-	{
-		T* const m_data;
-		const u32 m_pos;
-		const u32 m_count;
-
-		squeue_data_t(T* data, u32 pos, u32 count)
-			: m_data(data)
-			, m_pos(pos)
-			, m_count(count)
-		{
-		}
-
-	public:
-		T& operator [] (u32 index)
-		{
-			assert(index < m_count);
-			index += m_pos;
-			index = index < sq_size ? index : index - sq_size;
-			return m_data[index];
-		}
-	};
-
-	void process(void(*proc)(squeue_data_t data))
-	{
-		u32 pos, count;
-
-		while (m_sync.atomic_op([&pos, &count](squeue_sync_var_t& sync) -> u32
-		{
-			assert(sync.count <= sq_size);
-			assert(sync.position < sq_size);
-
-			if (sync.pop_lock || sync.push_lock)
-			{
-				return SQSVR_LOCKED;
-			}
-
-			pos = sync.position;
-			count = sync.count;
-			sync.pop_lock = 1;
-			sync.push_lock = 1;
-			return SQSVR_OK;
-		}))
-		{
-			std::unique_lock<std::mutex> rcv_lock(m_rcv_mutex);
-			m_rcv.wait_for(rcv_lock, std::chrono::milliseconds(1));
-		}
-
-		proc(squeue_data_t(m_data, pos, count));
-
-		m_sync.atomic_op([](squeue_sync_var_t& sync)
-		{
-			assert(sync.count <= sq_size);
-			assert(sync.position < sq_size);
-			assert(sync.pop_lock && sync.push_lock);
-			sync.pop_lock = 0;
-			sync.push_lock = 0;
-		});
-
-		m_wcv.notify_one();
-		m_rcv.notify_one();
-	}
-
+	// Pop all elements (must not be called concurrently with push)
 	void clear()
 	{
-		while (m_sync.atomic_op([](squeue_sync_var_t& sync) -> u32
-		{
-			assert(sync.count <= sq_size);
-			assert(sync.position < sq_size);
-
-			if (sync.pop_lock || sync.push_lock)
-			{
-				return SQSVR_LOCKED;
-			}
+		T data;
 
-			sync.pop_lock = 1;
-			sync.push_lock = 1;
-			return SQSVR_OK;
-		}))
+		while (try_pop(data))
 		{
-			std::unique_lock<std::mutex> rcv_lock(m_rcv_mutex);
-			m_rcv.wait_for(rcv_lock, std::chrono::milliseconds(1));
 		}
-
-		m_sync.exchange({});
-		m_wcv.notify_one();
-		m_rcv.notify_one();
 	}
 };
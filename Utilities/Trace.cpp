@@ -0,0 +1,256 @@
+#include "stdafx.h"
+#include "Thread.h"
+#include "Trace.h"
+#include "Emu/PerfCounters.h"
+
+namespace _log
+{
+	trace_writer g_trace;
+
+	timeline_t g_timeline;
+}
+
+// Thread name id in the string table
+static thread_local u32 g_tls_trace_thread = ~0u;
+
+bool _log::trace_writer::open(const std::string& path, u64 size)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_records)
+	{
+		return true;
+	}
+
+	const u64 strings_offset = 0x1000;
+	const u64 strings_size = 0x100000;
+	const u64 records_offset = strings_offset + strings_size;
+	const u64 records_max = std::max<u64>(size, records_offset + 0x100000) / sizeof(trace_record_t) - records_offset / sizeof(trace_record_t);
+
+	if (!m_file.open(path, fom::read | fom::write | fom::create | fom::trunc) || !m_file.trunc(records_offset + records_max * sizeof(trace_record_t)))
+	{
+		return false;
+	}
+
+	m_map.reset(m_file);
+
+	if (!m_map)
+	{
+		m_file.close();
+		return false;
+	}
+
+	m_header = reinterpret_cast<trace_header_t*>(static_cast<char*>(m_map));
+	std::memcpy(m_header->magic, "RPCS3TR", sizeof(m_header->magic));
+	m_header->version = version;
+	m_header->record_size = sizeof(trace_record_t);
+	m_header->strings_offset = strings_offset;
+	m_header->strings_size = strings_size;
+	m_header->strings_used = 0;
+	m_header->records_offset = records_offset;
+	m_header->records_max = records_max;
+
+	m_start = std::chrono::steady_clock::now();
+	m_records = reinterpret_cast<trace_record_t*>(static_cast<char*>(m_map) + records_offset);
+
+	perf::mem_add(perf::mem_log, records_offset + records_max * sizeof(trace_record_t));
+	return true;
+}
+
+u32 _log::trace_writer::intern(const char* str)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	const u64 size = std::strlen(str) + 1;
+
+	if (!m_header || m_header->strings_used + size > m_header->strings_size)
+	{
+		return -1;
+	}
+
+	const u64 id = m_header->strings_used;
+
+	std::memcpy(static_cast<char*>(m_map) + m_header->strings_offset + id, str, size);
+	m_header->strings_used += size;
+
+	return static_cast<u32>(id);
+}
+
+void _log::trace_writer::push(u32 msg, const u64* args, u32 argc)
+{
+	if (g_tls_trace_thread == ~0u)
+	{
+		const auto t = thread_ctrl::get_current();
+
+		g_tls_trace_thread = intern(t ? t->get_name().c_str() : "main");
+	}
+
+	const u64 pos = m_pos++;
+
+	trace_record_t& record = m_records.load()[pos % m_header->records_max];
+
+	// invalidate the slot while it's being written
+	record.seq = 0;
+	std::atomic_thread_fence(std::memory_order_release);
+
+	record.time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count();
+	record.msg = msg;
+	record.thread = g_tls_trace_thread;
+	record.argc = argc;
+	record.reserved = 0;
+	std::memcpy(record.args, args, argc * sizeof(u64));
+
+	std::atomic_thread_fence(std::memory_order_release);
+	record.seq = pos + 1;
+}
+
+struct _log::timeline_t::buffer_t
+{
+	struct event_t
+	{
+		const char* cat;
+		const char* name;
+		u64 arg;
+		u64 begin;
+		u64 end;
+	};
+
+	std::mutex mutex; // only contended while the timeline is saved
+	u32 tid;
+	std::string name;
+	std::vector<event_t> events;
+};
+
+_log::timeline_t::timeline_t()
+{
+}
+
+_log::timeline_t::~timeline_t()
+{
+}
+
+_log::timeline_t::buffer_t& _log::timeline_t::get_buffer()
+{
+	// Timeline buffer of the current thread
+	static thread_local buffer_t* g_tls_timeline_buffer = nullptr;
+
+	if (!g_tls_timeline_buffer)
+	{
+		const auto t = thread_ctrl::get_current();
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		m_buffers.emplace_back(new buffer_t);
+		m_buffers.back()->tid = static_cast<u32>(m_buffers.size());
+		m_buffers.back()->name = t ? t->get_name() : "main";
+
+		g_tls_timeline_buffer = m_buffers.back().get();
+	}
+
+	return *g_tls_timeline_buffer;
+}
+
+void _log::timeline_t::start()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	for (auto& buffer : m_buffers)
+	{
+		std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+
+		buffer->events.clear();
+	}
+
+	m_start = std::chrono::steady_clock::now();
+	m_enabled = true;
+}
+
+void _log::timeline_t::add(const char* cat, const char* name, u64 arg, u64 begin)
+{
+	const u64 end = now();
+
+	auto& buffer = get_buffer();
+
+	std::lock_guard<std::mutex> lock(buffer.mutex);
+
+	if (buffer.events.size() < max_events)
+	{
+		const std::size_t capacity = buffer.events.capacity();
+
+		buffer.events.push_back({ cat, name, arg, begin, end });
+
+		if (buffer.events.capacity() != capacity)
+		{
+			perf::mem_add(perf::mem_log, (buffer.events.capacity() - capacity) * sizeof(buffer_t::event_t));
+		}
+	}
+}
+
+static std::string timeline_escape(const std::string& str)
+{
+	std::string result;
+
+	for (char c : str)
+	{
+		if (c == '"' || c == '\\')
+		{
+			result += '\\';
+		}
+
+		if (static_cast<u8>(c) >= 0x20)
+		{
+			result += c;
+		}
+	}
+
+	return result;
+}
+
+bool _log::timeline_t::stop(const std::string& path)
+{
+	if (!m_enabled.exchange(false))
+	{
+		return false;
+	}
+
+	fs::file file(path, fom::rewrite);
+
+	if (!file)
+	{
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	std::string out = "{\"traceEvents\":[\n";
+
+	bool first = true;
+
+	for (auto& buffer : m_buffers)
+	{
+		std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+
+		out += fmt::format("%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", first ? "" : ",\n", buffer->tid, timeline_escape(buffer->name));
+		first = false;
+
+		for (const auto& event : buffer->events)
+		{
+			// timestamps are in microseconds
+			out += fmt::format(",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{\"arg\":%llu}}",
+				event.name, event.cat, event.begin / 1000., (event.end - event.begin) / 1000., buffer->tid, event.arg);
+
+			if (out.size() >= 0x100000)
+			{
+				file.write(out);
+				out.clear();
+			}
+		}
+
+		buffer->events.clear();
+	}
+
+	out += "\n]}\n";
+	file.write(out);
+
+	return true;
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include "File.h"
+
+// Binary trace: compact alternative to the text log for high-frequency messages (e.g. RSX method logging).
+// Records have a fixed size and contain the format string id, the thread name id, a timestamp and raw integer arguments.
+// Strings are interned in the string table of the file. The file is memory-mapped and used as a ring buffer (the oldest
+// records are overwritten), it's converted to text by the trace_decode tool (tools/trace_decode).
+namespace _log
+{
+	// File layout (must match tools/trace_decode/trace_decode.cpp)
+	struct trace_header_t
+	{
+		char magic[8]; // "RPCS3TR"
+		u32 version;
+		u32 record_size;
+		u64 strings_offset;
+		u64 strings_size; // string table size (entries are null-terminated strings, the id is the offset in the table)
+		u64 strings_used;
+		u64 records_offset;
+		u64 records_max; // ring buffer capacity (the slot of the record n is n % records_max)
+	};
+
+	struct trace_record_t
+	{
+		u64 seq; // record number + 1, written last (validates the record)
+		u64 time; // nanoseconds since the trace was started
+		u32 msg; // format string id
+		u32 thread; // thread name id
+		u32 argc;
+		u32 reserved;
+		u64 args[4];
+	};
+
+	static_assert(sizeof(trace_record_t) == 64, "Invalid trace record size");
+
+	class trace_writer final
+	{
+		fs::file m_file;
+		fs::file_write_map m_map;
+
+		trace_header_t* m_header = nullptr;
+		std::atomic<trace_record_t*> m_records{ nullptr };
+
+		std::mutex m_mutex; // protects the string table
+		std::atomic<u64> m_pos{ 0 };
+		std::chrono::steady_clock::time_point m_start;
+
+		void push(u32 msg, const u64* args, u32 argc);
+
+	public:
+		static const u32 version = 1;
+
+		// Create trace file (size in bytes), does nothing if already opened
+		bool open(const std::string& path, u64 size);
+
+		bool is_open() const
+		{
+			return m_records.load() != nullptr;
+		}
+
+		// Add string to the string table, returns its id (or -1 if the table is full)
+		u32 intern(const char* str);
+
+		// Write record (the arguments are stored as u64)
+		template<typename... Args>
+		void write(u32 msg, const Args&... args)
+		{
+			static_assert(sizeof...(Args) <= 4, "Too many trace arguments");
+
+			const u64 data[] = { static_cast<u64>(args)..., 0 };
+
+			push(msg, data, sizeof...(Args));
+		}
+	};
+
+	// Global variable for RPCS3.trace (opened by Emulator::Load if enabled)
+	extern trace_writer g_trace;
+
+	// Timeline of scoped events recorded in per-thread buffers, exported as Chrome trace JSON (chrome://tracing, Perfetto UI)
+	class timeline_t final
+	{
+		struct buffer_t;
+
+		std::mutex m_mutex; // protects the buffer list
+		std::vector<std::unique_ptr<buffer_t>> m_buffers; // never removed (referenced by threads)
+		std::atomic<bool> m_enabled{ false };
+		std::chrono::steady_clock::time_point m_start;
+
+		buffer_t& get_buffer();
+
+	public:
+		static const std::size_t max_events = 0x100000; // per thread, further events are dropped
+
+		timeline_t();
+
+		~timeline_t();
+
+		bool enabled() const
+		{
+			return m_enabled.load(std::memory_order_relaxed);
+		}
+
+		// Clear recorded events and start recording
+		void start();
+
+		// Stop recording and write the events to the file
+		bool stop(const std::string& path);
+
+		// Get current timestamp in nanoseconds (never 0)
+		u64 now() const
+		{
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count() + 1;
+		}
+
+		// Add complete event to the buffer of the current thread (name and category must be string literals)
+		void add(const char* cat, const char* name, u64 arg, u64 begin);
+	};
+
+	// Global timeline (started by Emulator::Load if enabled, saved to RPCS3.timeline.json on stop)
+	extern timeline_t g_timeline;
+
+	// Records the event from construction to destruction if the timeline is enabled
+	class timeline_scope final
+	{
+		const char* const m_cat;
+		const char* const m_name;
+		const u64 m_arg;
+		const u64 m_begin;
+
+	public:
+		timeline_scope(const char* cat, const char* name, u64 arg = 0)
+			: m_cat(cat)
+			, m_name(name)
+			, m_arg(arg)
+			, m_begin(g_timeline.enabled() ? g_timeline.now() : 0)
+		{
+		}
+
+		timeline_scope(const timeline_scope&) = delete;
+
+		~timeline_scope()
+		{
+			if (m_begin)
+			{
+				g_timeline.add(m_cat, m_name, m_arg, m_begin);
+			}
+		}
+	};
+}
+
+// Write binary trace record: fmt must be a string literal with printf-like specifiers, the arguments must be integers
+#define LOG_BINARY(fmt, ...) do { if (_log::g_trace.is_open()) { static const u32 _trace_msg = _log::g_trace.intern(fmt); _log::g_trace.write(_trace_msg, ##__VA_ARGS__); } } while (0)
@@ -0,0 +1,68 @@
+#include "stdafx.h"
+#include "benchmark.h"
+
+#include <cstdlib>
+#include <map>
+
+namespace
+{
+	std::mutex g_bench_mutex;
+
+	// sorted by name for stable output
+	std::map<std::string, bench::result_t> g_bench_results;
+}
+
+void bench::report(const std::string& name, const result_t& result)
+{
+	{
+		std::lock_guard<std::mutex> lock(g_bench_mutex);
+
+		g_bench_results[name] = result;
+	}
+
+	const double per_second = result.median_ns ? result.units * 1e9 / result.median_ns : 0.;
+
+	TEST_LOG("%s: median %.3f ms (min %.3f ms, max %.3f ms), %.0f %s/s\n", name, result.median_ns / 1e6, result.min_ns / 1e6, result.max_ns / 1e6, per_second, result.unit);
+}
+
+void bench::write_results()
+{
+	std::lock_guard<std::mutex> lock(g_bench_mutex);
+
+	if (g_bench_results.empty())
+	{
+		return;
+	}
+
+	const char* const env = std::getenv("RPCS3_BENCH_OUTPUT");
+	const std::string path = env && *env ? env : "rpcs3-bench.json";
+
+	std::string out = "{\n\t\"version\": 1,\n\t\"benchmarks\": [\n";
+
+	for (auto it = g_bench_results.begin(); it != g_bench_results.end(); it++)
+	{
+		const auto& r = it->second;
+
+		const double per_second = r.median_ns ? r.units * 1e9 / r.median_ns : 0.;
+
+		out += fmt::format("\t\t{ \"name\": \"%s\", \"unit\": \"%s\", \"units\": %llu, \"runs\": %u, \"median_ns\": %llu, \"min_ns\": %llu, \"max_ns\": %llu, \"per_second\": %.0f }%s\n",
+			it->first, r.unit, r.units, r.runs, r.median_ns, r.min_ns, r.max_ns, per_second, std::next(it) == g_bench_results.end() ? "" : ",");
+	}
+
+	out += "\t]\n}\n";
+
+	fs::file file(path, fom::rewrite);
+
+	if (!file)
+	{
+		Logger::WriteMessage(fmt::format("Failed to create %s\n", path).c_str());
+		return;
+	}
+
+	file.write(out);
+}
+
+TEST_MODULE_CLEANUP(benchmark_module_cleanup)
+{
+	bench::write_results();
+}
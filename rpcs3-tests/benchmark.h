@@ -0,0 +1,51 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+
+// Microbenchmark harness.
+// bench::run() calls the function once to warm up, then `runs` more times; the median time is used as the result
+// (less sensitive to scheduling noise than the mean). Results are printed to the test log and written by the module
+// cleanup to a JSON file sorted by benchmark name, so the files of two builds can be compared line by line.
+// The path is taken from the RPCS3_BENCH_OUTPUT environment variable (rpcs3-bench.json by default).
+namespace bench
+{
+	struct result_t
+	{
+		std::string unit; // what one run processes ("bytes", "instructions", "ops"...)
+		u64 units; // amount processed by one run
+		u32 runs;
+		u64 median_ns;
+		u64 min_ns;
+		u64 max_ns;
+	};
+
+	// Store the result (replaces the previous result with the same name) and print it
+	void report(const std::string& name, const result_t& result);
+
+	// Write all results to the JSON file (does nothing if no benchmark was run)
+	void write_results();
+
+	template<typename F>
+	result_t run(const std::string& name, const std::string& unit, u64 units, F func, u32 runs = 9)
+	{
+		func();
+
+		std::vector<u64> times(runs);
+
+		for (auto& time : times)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			func();
+			time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		std::sort(times.begin(), times.end());
+
+		const result_t result{ unit, units, runs, times[runs / 2], times.front(), times.back() };
+
+		report(name, result);
+
+		return result;
+	}
+}
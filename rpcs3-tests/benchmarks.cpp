@@ -0,0 +1,383 @@
+#include "stdafx.h"
+#include "benchmark.h"
+#include "Emu/IdManager.h"
+#include "Emu/Cell/SPUThread.h"
+#include "Emu/Cell/SPUInterpreter.h"
+#include "Emu/Cell/SPUAnalyser.h"
+#include "Emu/Cell/SPUASMJITRecompiler.h"
+#include "Emu/SysCalls/Modules/cellAudio.h"
+#include "Emu/SysCalls/Modules/cellVpost.h"
+#include "Emu/SysCalls/Modules/cellPngDec.h"
+#include "Emu/RSX/GCM.h"
+#include "Emu/RSX/Common/BufferUtils.h"
+#include "Emu/RSX/rsx_utils.h"
+#include "Crypto/aes.h"
+#include "Crypto/sha1.h"
+
+#include <random>
+
+namespace
+{
+	// Synthetic SPU kernel: random arithmetic, float and shuffle instructions on r3..r34, returns with bi $lr
+	std::vector<u32> make_spu_kernel(u32 count)
+	{
+		std::mt19937 rng(1);
+
+		const auto reg = [&]() -> u32 { return 3 + rng() % 32; };
+
+		const auto rr = [](u32 op, u32 rt, u32 ra, u32 rb) { return op << 21 | rb << 14 | ra << 7 | rt; };
+		const auto rrr = [](u32 op, u32 rt, u32 ra, u32 rb, u32 rc) { return op << 28 | rt << 21 | rb << 14 | ra << 7 | rc; };
+		const auto ri10 = [](u32 op, u32 rt, u32 ra, s32 i10) { return op << 24 | (i10 & 0x3ff) << 14 | ra << 7 | rt; };
+
+		std::vector<u32> result;
+
+		for (u32 i = 0; i < count; i++)
+		{
+			switch (rng() % 8)
+			{
+			case 0: result.push_back(rr(0xc0, reg(), reg(), reg())); break; // a
+			case 1: result.push_back(rr(0x241, reg(), reg(), reg())); break; // xor
+			case 2: result.push_back(rr(0x2c4, reg(), reg(), reg())); break; // fa
+			case 3: result.push_back(rr(0x2c6, reg(), reg(), reg())); break; // fm
+			case 4: result.push_back(rrr(0xe, reg(), reg(), reg(), reg())); break; // fma
+			case 5: result.push_back(rrr(0xb, reg(), reg(), reg(), reg())); break; // shufb
+			case 6: result.push_back(rr(0x1fc, reg(), reg(), rng() % 16)); break; // rotqbyi
+			case 7: result.push_back(ri10(0x1c, reg(), reg(), rng() % 512)); break; // ai
+			}
+		}
+
+		result.push_back(rr(0x1a8, 0, 0, 0)); // bi $lr
+
+		return result;
+	}
+
+	// Initialize registers used by the kernel (floats in [1, 2) keep FA/FM/FMA away from denormals and infinities)
+	void reset_spu_registers(SPUThread& spu)
+	{
+		std::mt19937 rng(2);
+
+		for (u32 i = 3; i < 35; i++)
+		{
+			for (u32 j = 0; j < 4; j++)
+			{
+				spu.gpr[i]._f[j] = 1.0f + (rng() % 0x10000) / 65536.0f;
+			}
+		}
+
+		spu.gpr[0]._u32[3] = 0x3fff0; // return address
+	}
+
+	void spu_interpreter_kernel(const char* name, const spu_opcode_table_t<spu_inter_func_t>& table)
+	{
+		Emu.SetTestMode();
+		vm::ps3::init();
+
+		const auto spu = idm::make_ptr<SPUThread>("Benchmark SPU", 0);
+		const auto kernel = make_spu_kernel(1024);
+		const auto ls = vm::_ptr<be_t<u32>>(spu->offset);
+
+		std::copy(kernel.begin(), kernel.end(), ls);
+
+		bench::run(name, "instructions", kernel.size() * 256, [&]()
+		{
+			for (u32 pass = 0; pass < 256; pass++)
+			{
+				reset_spu_registers(*spu);
+
+				for (u32 pc = 0; pc < kernel.size() * 4 - 4; pc += 4)
+				{
+					const u32 opcode = ls[pc / 4];
+					table[opcode](*spu, { opcode });
+				}
+			}
+		});
+	}
+
+	template<typename T>
+	void upload_index_array_benchmark(const char* name)
+	{
+		const u32 count = 1 << 20;
+
+		std::mt19937 rng(1);
+		std::vector<be_t<T>> src(count);
+		std::vector<T> dst(count);
+
+		for (auto& index : src) index = static_cast<T>(rng());
+
+		bench::run(name, "indexes", count, [&]()
+		{
+			upload_index_array(gsl::span<const be_t<T>>(src.data(), src.size()), gsl::span<T>(dst.data(), dst.size()), true, static_cast<T>(-1));
+		});
+	}
+}
+
+// Performance of emulator hot paths; the results are compared between builds with the JSON file written by benchmark.cpp
+TEST_CLASS(benchmark_test_class)
+{
+	TEST_METHOD(spu_interpreter_fast)
+	{
+		spu_interpreter_kernel("spu.interpreter_fast.kernel", spu_interpreter::fast::g_spu_opcode_table);
+	}
+
+	TEST_METHOD(spu_interpreter_precise)
+	{
+		spu_interpreter_kernel("spu.interpreter_precise.kernel", spu_interpreter::precise::g_spu_opcode_table);
+	}
+
+	TEST_METHOD(spu_asmjit)
+	{
+		Emu.SetTestMode();
+		vm::ps3::init();
+
+		const auto spu = idm::make_ptr<SPUThread>("Benchmark SPU", 0);
+		const auto kernel = make_spu_kernel(1024);
+		const auto ls = vm::_ptr<be_t<u32>>(spu->offset);
+
+		std::copy(kernel.begin(), kernel.end(), ls);
+
+		SPUDatabase db;
+		const auto func = db.analyse(ls, 0);
+
+		spu_recompiler rec;
+		rec.compile(*func);
+
+		const auto compiled = func->compiled.load();
+
+		if (!compiled)
+		{
+			TEST_FAILURE("SPU kernel compilation failed");
+		}
+
+		bench::run("spu.asmjit.kernel", "instructions", kernel.size() * 256, [&]()
+		{
+			for (u32 pass = 0; pass < 256; pass++)
+			{
+				reset_spu_registers(*spu);
+				spu->pc = 0;
+				compiled(spu.get(), ls);
+			}
+		});
+	}
+
+	TEST_METHOD(vm_reservation_update)
+	{
+		Emu.SetTestMode();
+		vm::ps3::init();
+
+		const u32 addr = vm::alloc(4096, vm::main);
+		const u32 count = 0x10000;
+
+		for (u32 threads : { 1, 2, 4 })
+		{
+			bench::run(fmt::format("vm.reservation_update.%u_threads", threads), "updates", count * threads, [&]()
+			{
+				std::vector<std::shared_ptr<thread_ctrl>> list;
+
+				for (u32 i = 0; i < threads; i++)
+				{
+					list.emplace_back(thread_ctrl::spawn(COPY_EXPR(fmt::format("Reservation[%u]", i)), [&]()
+					{
+						alignas(128) u8 data[128];
+
+						for (u32 done = 0; done < count;)
+						{
+							vm::reservation_acquire(data, addr, 128);
+
+							reinterpret_cast<u32&>(data[0])++;
+
+							if (vm::reservation_update(addr, data, 128))
+							{
+								done++;
+							}
+						}
+					}));
+				}
+
+				for (auto& thread : list)
+				{
+					thread->join();
+				}
+			}, 5);
+		}
+
+		vm::dealloc(addr, vm::main);
+	}
+
+	TEST_METHOD(spu_dma_list)
+	{
+		// measures the fast path of SPUThread::do_dma_list_cmd (synchronous lists without stall bits)
+		const u32 count = 2048;
+
+		std::mt19937 rng(1);
+		std::vector<spu_mfc_list_element_t> list(count);
+		std::vector<u8> mem(0x100000);
+		std::vector<u8> ls_buf(0x40000 + 16);
+
+		u8* const ls = ls_buf.data() + (16 - reinterpret_cast<std::uintptr_t>(ls_buf.data()) % 16) % 16;
+
+		u64 total = 0;
+
+		for (auto& e : list)
+		{
+			const u32 size = 16 << (rng() % 4); // 16..128 bytes
+
+			e.sb = 0;
+			e.ts = size;
+			e.ea = (rng() % (0xf0000 / 16)) * 16;
+			total += size;
+		}
+
+		bench::run("spu.dma_list_copy", "bytes", total, [&]()
+		{
+			spu_dma_list_copy(ls, mem.data(), 0x1000, list.data(), count, true);
+		});
+	}
+
+	TEST_METHOD(cell_audio_mix)
+	{
+		// one mixing iteration of the audio thread with all ports started (alternating 2 and 8 channels)
+		std::mt19937 rng(1);
+		std::vector<be_t<f32>> src(AUDIO_PORT_COUNT * 8 * AUDIO_SAMPLES);
+		std::unique_ptr<AudioPortConfig[]> ports(new AudioPortConfig[AUDIO_PORT_COUNT]);
+
+		for (auto& sample : src) sample = (rng() % 0x10000) / 32768.0f - 1.0f;
+
+		for (u32 i = 0; i < AUDIO_PORT_COUNT; i++)
+		{
+			ports[i].channel = i % 2 ? 8 : 2;
+		}
+
+		alignas(16) float buf2ch[2 * AUDIO_SAMPLES];
+		alignas(16) float buf8ch[8 * AUDIO_SAMPLES];
+
+		bench::run("cell_audio.mix_8_ports", "frames", AUDIO_PORT_COUNT * AUDIO_SAMPLES * 256, [&]()
+		{
+			for (u32 pass = 0; pass < 256; pass++)
+			{
+				for (u32 i = 0; i < AUDIO_PORT_COUNT; i++)
+				{
+					// half of the ports ramp their volume
+					ports[i].level = 1.0f;
+					ports[i].level_set.store({ 0.5f, i % 4 < 2 ? -0.5f / 624.0f : 0.0f });
+
+					audio_mix_port(ports[i], src.data() + i * 8 * AUDIO_SAMPLES, buf2ch, buf8ch, i == 0);
+				}
+			}
+		});
+	}
+
+	TEST_METHOD(cell_vpost_yuv420_to_rgba)
+	{
+		// no-scale cellVpostExec path (1080p frame)
+		const u32 w = 1920, h = 1080;
+
+		std::mt19937 rng(1);
+		std::vector<u8> yuv(w * h * 3 / 2), rgba(w * h * 4);
+
+		for (auto& b : yuv) b = static_cast<u8>(rng());
+
+		bench::run("cell_vpost.yuv420_to_rgba_1080p", "pixels", w * h, [&]()
+		{
+			vpost_yuv420_to_rgba(yuv.data(), yuv.data() + w * h, yuv.data() + w * h * 5 / 4, rgba.data(), w, h, 0xff);
+		});
+	}
+
+	TEST_METHOD(cell_image_dec_write)
+	{
+		// decoded RGBA to guest ARGB/RGB conversion (720p image, bottom-to-top with padded rows)
+		const u32 w = 1280, h = 720, pitch = w * 4 + 64;
+
+		std::mt19937 rng(1);
+		std::vector<u8> rgba(w * h * 4), out(pitch * h);
+
+		for (auto& b : rgba) b = static_cast<u8>(rng());
+
+		bench::run("cell_image_dec.write_argb_720p", "pixels", w * h, [&]()
+		{
+			image_dec_write(rgba.data(), w, h, out.data(), pitch, image_dec_format::argb, true);
+		});
+
+		bench::run("cell_image_dec.write_rgb_720p", "pixels", w * h, [&]()
+		{
+			image_dec_write(rgba.data(), w, h, out.data(), pitch, image_dec_format::rgb, true);
+		});
+	}
+
+	TEST_METHOD(rsx_upload_index_array)
+	{
+		upload_index_array_benchmark<u16>("rsx.upload_index_array.u16");
+		upload_index_array_benchmark<u32>("rsx.upload_index_array.u32");
+	}
+
+	TEST_METHOD(rsx_quads_to_triangles)
+	{
+		const u32 count = 1 << 20; // vertices (count / 4 quads, 6 indexes per quad)
+
+		std::vector<u16> dst(count / 4 * 6);
+
+		bench::run("rsx.quads_to_triangles", "vertices", count, [&]()
+		{
+			write_index_array_for_non_indexed_non_native_primitive_to_buffer(reinterpret_cast<char*>(dst.data()), Primitive_type::quads, 0, count);
+		});
+	}
+
+	TEST_METHOD(rsx_unswizzle)
+	{
+		// texture conversion cost (upload_placed_texture itself needs the RSX register state)
+		const u16 size = 1024;
+
+		std::vector<u32> src(size * size), dst(size * size);
+
+		std::mt19937 rng(1);
+
+		for (auto& texel : src) texel = rng();
+
+		bench::run("rsx.unswizzle.u32_1024x1024", "bytes", src.size() * sizeof(u32), [&]()
+		{
+			rsx::convert_linear_swizzle<u32>(src.data(), dst.data(), size, size, true);
+		});
+	}
+
+	TEST_METHOD(crypto)
+	{
+		const u32 size = 1 << 20;
+
+		std::vector<u8> in(size), out(size);
+
+		std::mt19937 rng(1);
+
+		for (auto& b : in) b = static_cast<u8>(rng());
+
+		const u8 key[16] = { 0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef, 0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10 };
+
+		bench::run("crypto.aes128_cbc_decrypt", "bytes", size, [&]()
+		{
+			aes_context ctx;
+			u8 iv[16] = {};
+			aes_setkey_dec(&ctx, key, 128);
+			aes_crypt_cbc(&ctx, AES_DECRYPT, size, iv, in.data(), out.data());
+		});
+
+		bench::run("crypto.aes128_ctr", "bytes", size, [&]()
+		{
+			aes_context ctx;
+			size_t nc_off = 0;
+			u8 nonce[16] = {};
+			u8 stream_block[16] = {};
+			aes_setkey_enc(&ctx, key, 128);
+			aes_crypt_ctr(&ctx, size, &nc_off, nonce, stream_block, in.data(), out.data());
+		});
+
+		bench::run("crypto.sha1", "bytes", size, [&]()
+		{
+			u8 hash[20];
+			sha1(in.data(), size, hash);
+		});
+
+		bench::run("crypto.sha1_hmac", "bytes", size, [&]()
+		{
+			u8 hash[20];
+			sha1_hmac(key, sizeof(key), in.data(), size, hash);
+		});
+	}
+};
@@ -22,6 +22,11 @@
 
 #include "Emu/System.h"
 #include "Emu/IdManager.h"
+#include "Emu/Cell/PPUDecoder.h"
+#include "Emu/Cell/PPUInterpreter2.h"
+#include "Emu/Cell/PPUInstrTable.h"
+
+#include "benchmark.h"
 
 #include <sstream>
 
@@ -275,6 +280,49 @@ public:
 
 		return std::make_pair(std::unique_ptr<llvm::ExecutionEngine>(execution_engine), (Executable)function);
 	}
+
+	/// Compile a straight sequence of instructions into one function (used by the benchmarks)
+	static std::pair<std::unique_ptr<llvm::ExecutionEngine>, Executable> build_sequence(const std::vector<u32>& opcodes)
+	{
+		LLVMContext &context(getGlobalContext());
+		IRBuilder<> builder(getGlobalContext());
+		std::unordered_map<std::string, void*> executable_map;
+
+		std::unique_ptr<llvm::Module> module = Compiler::create_module(context);
+
+		TestCompiler compiler(&context, &builder, executable_map);
+
+		compiler.m_module = module.get();
+		compiler.initiate_function("test");
+		auto block = BasicBlock::Create(context, "start", compiler.m_state.function);
+		builder.SetInsertPoint(block);
+
+		for (const u32 opcode : opcodes)
+		{
+			compiler.Decode(opcode);
+		}
+
+		builder.CreateRet(builder.getInt32(0));
+
+		Compiler::optimise_module(module.get());
+		llvm::Module *module_ptr = module.get();
+
+		llvm::ExecutionEngine *execution_engine =
+			EngineBuilder(std::move(module))
+			.setEngineKind(EngineKind::JIT)
+			.setMCJITMemoryManager(std::unique_ptr<llvm::SectionMemoryManager>(new CustomSectionMemoryManager(executable_map)))
+			.setOptLevel(llvm::CodeGenOpt::Aggressive)
+			.setMCPU("nehalem")
+			.create();
+		module_ptr->setDataLayout(execution_engine->getDataLayout());
+
+		execution_engine->finalizeObject();
+
+		Function *llvm_function = module_ptr->getFunction("test");
+		void *function = execution_engine->getPointerToFunction(llvm_function);
+
+		return std::make_pair(std::unique_ptr<llvm::ExecutionEngine>(execution_engine), (Executable)function);
+	}
 };
 
 namespace
@@ -374,6 +422,99 @@ namespace
 
 TEST_CLASS(ppu_llvm_test_class)
 {
+	// Interpreter and LLVM recompiler throughput on the same instruction mix (integer, load/store, float and vector)
+	TEST_METHOD(benchmark_instruction_mix)
+	{
+		using namespace PPU_instr;
+
+		InitializeNativeTarget();
+		InitializeNativeTargetAsmPrinter();
+		InitializeNativeTargetDisassembler();
+
+		Emu.SetTestMode();
+		vm::ps3::init();
+
+		const u32 addr = vm::alloc(4096, vm::memory_location_t::main);
+
+		std::vector<u32> opcodes;
+
+		for (u32 i = 0; i < 64; i++)
+		{
+			const u32 r = 3 + i % 16;
+
+			opcodes.push_back(ADDI(r, r, i + 1));
+			opcodes.push_back(ADD(r + 1, r, r + 2, 0, 0));
+			opcodes.push_back(SUBF(r + 2, r + 1, r, 0, 0));
+			opcodes.push_back(MULLW(r, r + 1, r + 2, 0, 0));
+			opcodes.push_back(RLWINM(r + 1, r, 3, 0, 28, 0));
+			opcodes.push_back(XOR(r + 2, r + 1, r, 0));
+			opcodes.push_back(OR(r, r, r + 2, 0));
+			opcodes.push_back(AND(r + 1, r + 1, r, 0));
+			opcodes.push_back(STW(r, r31, (i % 64) * 4));
+			opcodes.push_back(LWZ(r + 2, r31, ((i + 32) % 64) * 4));
+			opcodes.push_back(FADD(r, r + 1, r + 2, 0));
+			opcodes.push_back(FMUL(r + 1, r, r + 2, 0));
+			opcodes.push_back(VADDFP(r, r + 1, r + 2));
+			opcodes.push_back(VAND(r + 1, r, r + 2));
+			opcodes.push_back(VPERM(r + 2, r, r + 1, r + 3));
+		}
+
+		PPUThread* ppu = idm::make_ptr<PPUThread>("Test Thread").get();
+
+		const auto reset = [&]()
+		{
+			for (u32 i = 0; i < 32; i++)
+			{
+				ppu->GPR[i] = i;
+				ppu->FPR[i] = 1.0 + i / 32.0;
+				ppu->VPR[i] = v128::from32p(i);
+			}
+
+			ppu->GPR[31] = addr;
+		};
+
+		// decode once as the decoder cache does
+		std::vector<ppu_inter_func_t> funcs;
+
+		PPUInterpreter2* inter;
+		PPUDecoder dec(inter = new PPUInterpreter2);
+
+		for (const u32 opcode : opcodes)
+		{
+			inter->func = ppu_interpreter::NULL_OP;
+			dec.Decode(opcode);
+			funcs.push_back(inter->func);
+		}
+
+		const u32 passes = 256;
+
+		bench::run("ppu.interpreter.mix", "instructions", opcodes.size() * passes, [&]()
+		{
+			for (u32 pass = 0; pass < passes; pass++)
+			{
+				reset();
+
+				for (std::size_t i = 0; i < opcodes.size(); i++)
+				{
+					funcs[i](*ppu, { opcodes[i] });
+				}
+			}
+		});
+
+		auto build_result = TestCompiler::build_sequence(opcodes);
+
+		bench::run("ppu.llvm.mix", "instructions", opcodes.size() * passes, [&]()
+		{
+			for (u32 pass = 0; pass < passes; pass++)
+			{
+				reset();
+				build_result.second(ppu, 0);
+			}
+		});
+
+		vm::dealloc(addr, vm::memory_location_t::main);
+	}
+
 	TEST_INSTRUCTION_USING_RANDOM_INPUT(MFVSCR, MFVSCR, 50, 1u);
 	TEST_INSTRUCTION_USING_RANDOM_INPUT(MTVSCR, MTVSCR, 50, 1u);
 	TEST_INSTRUCTION_USING_RANDOM_INPUT(VADDCUW, VADDCUW, 50, 0u, 1u, 2u);
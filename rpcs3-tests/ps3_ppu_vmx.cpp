@@ -0,0 +1,83 @@
+#include "stdafx.h"
+#include "Emu/IdManager.h"
+#include "Emu/Cell/PPUThread.h"
+#include "Emu/Cell/PPUInterpreter2.h"
+
+#include <random>
+
+namespace
+{
+	// vd = v0, va = v1, vb = v2, vc = v3
+	const ppu_opcode_t g_test_op = { (1 << 16) | (2 << 11) | (3 << 6) };
+
+	const u32 g_extreme_values[] = { 0, 1, 0xff, 0x7f, 0x80, 0x7fff, 0x8000, 0xffff, 0x7fffffff, 0x80000000, 0xffffffff, 0xff00ff00, 0x00ff00ff, 0x80808080, 0x7f7f7f7f };
+
+	// Compare the SSE4.1 implementation of an instruction with the reference implementation
+	void check_vmx(const char* name, ppu_inter_func_t reference, ppu_inter_func_t sse41)
+	{
+		PPUThread& ppu = *idm::make_ptr<PPUThread>("Test Thread");
+
+		std::mt19937 rng(1);
+
+		for (u32 test = 0; test < 1000; test++)
+		{
+			v128 input[3];
+
+			for (auto& v : input)
+			{
+				for (auto& w : v._u32)
+				{
+					w = test < 500 ? g_extreme_values[rng() % (sizeof(g_extreme_values) / sizeof(u32))] : static_cast<u32>(rng());
+				}
+			}
+
+			v128 result[2];
+
+			for (u32 i = 0; i < 2; i++)
+			{
+				ppu.VPR[0].clear();
+				ppu.VPR[1] = input[0];
+				ppu.VPR[2] = input[1];
+				ppu.VPR[3] = input[2];
+
+				(i ? sse41 : reference)(ppu, g_test_op);
+
+				result[i] = ppu.VPR[0];
+			}
+
+			if (!(result[0] == result[1]))
+			{
+				TEST_FAILURE("%s: result mismatch (a=%s, b=%s, c=%s, reference=%s, sse4.1=%s)", name,
+					input[0].to_hex().c_str(), input[1].to_hex().c_str(), input[2].to_hex().c_str(), result[0].to_hex().c_str(), result[1].to_hex().c_str());
+			}
+		}
+	}
+}
+
+#define VMX_TEST(name) \
+	TEST_METHOD(name) \
+	{ \
+		if (g_ppu_vmx.name != ppu_interpreter_sse41::name) \
+		{ \
+			TEST_LOG("SSE4.1 is not supported, " #name " is not tested\n"); \
+			return; \
+		} \
+		check_vmx(#name, ppu_interpreter::name, ppu_interpreter_sse41::name); \
+	}
+
+TEST_CLASS(ppu_vmx_test_class)
+{
+	VMX_TEST(VMSUMUHS)
+	VMX_TEST(VPKSWUS)
+	VMX_TEST(VPKUHUM)
+	VMX_TEST(VPKUHUS)
+	VMX_TEST(VPKUWUM)
+	VMX_TEST(VPKUWUS)
+	VMX_TEST(VSUM4SBS)
+	VMX_TEST(VSUM4SHS)
+	VMX_TEST(VSUM4UBS)
+	VMX_TEST(VUPKHSB)
+	VMX_TEST(VUPKHSH)
+	VMX_TEST(VUPKLSB)
+	VMX_TEST(VUPKLSH)
+};
@@ -0,0 +1,106 @@
+#include "stdafx.h"
+#include "Emu/RSX/Common/BufferUtils.h"
+
+#include <chrono>
+#include <random>
+
+namespace
+{
+	// Element by element reference implementation
+	template<typename T>
+	std::tuple<T, T> upload_index_array_reference(const std::vector<be_t<T>>& src, std::vector<T>& dst, bool is_primitive_restart_enabled, T primitive_restart_index)
+	{
+		T min_index = -1;
+		T max_index = 0;
+
+		for (size_t i = 0; i < src.size(); i++)
+		{
+			T index = src[i];
+
+			if (is_primitive_restart_enabled && index == primitive_restart_index)
+			{
+				index = -1;
+			}
+			else
+			{
+				min_index = std::min(min_index, index);
+				max_index = std::max(max_index, index);
+			}
+
+			dst[i] = index;
+		}
+
+		return std::make_tuple(min_index, max_index);
+	}
+
+	template<typename T>
+	void check_upload_index_array(const char* type_name)
+	{
+		const u32 count = 1 << 20;
+		const u32 passes = 32;
+
+		std::mt19937 rng(1);
+
+		// Odd sizes and restart indexes check the scalar tail and masking
+		for (u32 test = 0; test < 256; test++)
+		{
+			std::vector<be_t<T>> src(rng() % 300);
+			for (auto& index : src) index = rng() % 8 ? static_cast<T>(rng()) : static_cast<T>(-1);
+
+			const bool restart = test % 2 != 0;
+			const T restart_index = src.empty() || test % 4 < 2 ? static_cast<T>(-1) : static_cast<T>(src[src.size() / 2]);
+
+			std::vector<T> ref(src.size()), res(src.size());
+			const auto ref_min_max = upload_index_array_reference<T>(src, ref, restart, restart_index);
+			const auto res_min_max = upload_index_array(gsl::span<const be_t<T>>(src.data(), src.size()), gsl::span<T>(res.data(), res.size()), restart, restart_index);
+
+			if (ref != res || ref_min_max != res_min_max)
+			{
+				TEST_FAILURE("upload_index_array<%s>() result mismatch (%u indexes)", type_name, src.size());
+			}
+		}
+
+		std::vector<be_t<T>> src(count);
+		std::vector<T> ref(count), res(count);
+		for (auto& index : src) index = static_cast<T>(rng());
+
+		const auto t0 = std::chrono::high_resolution_clock::now();
+
+		for (u32 pass = 0; pass < passes; pass++)
+		{
+			upload_index_array_reference<T>(src, ref, true, static_cast<T>(-1));
+		}
+
+		const auto t1 = std::chrono::high_resolution_clock::now();
+
+		for (u32 pass = 0; pass < passes; pass++)
+		{
+			upload_index_array(gsl::span<const be_t<T>>(src.data(), src.size()), gsl::span<T>(res.data(), res.size()), true, static_cast<T>(-1));
+		}
+
+		const auto t2 = std::chrono::high_resolution_clock::now();
+
+		const u64 ref_us = std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count();
+		const u64 test_us = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+
+		TEST_LOG("%u %s indexes x %u: scalar loop %llu us, upload_index_array %llu us\n", count, type_name, passes, ref_us, test_us);
+
+		if (ref != res)
+		{
+			TEST_FAILURE("upload_index_array<%s>() result mismatch", type_name);
+		}
+	}
+}
+
+TEST_CLASS(rsx_index_buffer_test_class)
+{
+	TEST_METHOD(upload_index_array_u16)
+	{
+		check_upload_index_array<u16>("u16");
+	}
+
+	TEST_METHOD(upload_index_array_u32)
+	{
+		check_upload_index_array<u32>("u32");
+	}
+};
@@ -0,0 +1,71 @@
+#include "stdafx.h"
+#include "Emu/Cell/SPUThread.h"
+
+#include <chrono>
+#include <random>
+
+TEST_CLASS(spu_dma_test_class)
+{
+	TEST_METHOD(list_copy_small_elements)
+	{
+		const u32 count = 1024;
+		const u32 passes = 64;
+
+		std::mt19937 rng(1);
+		std::vector<spu_mfc_list_element_t> list(count);
+		std::vector<u8> mem(0x100000);
+		std::vector<u8> ls_ref(0x40000 + 16), ls_test(0x40000 + 16);
+
+		// LS and main memory buffers are expected to be 16-byte aligned
+		u8* const ref = ls_ref.data() + (16 - reinterpret_cast<std::uintptr_t>(ls_ref.data()) % 16) % 16;
+		u8* const test = ls_test.data() + (16 - reinterpret_cast<std::uintptr_t>(ls_test.data()) % 16) % 16;
+
+		for (auto& b : mem) b = static_cast<u8>(rng());
+
+		u32 total = 0;
+
+		for (auto& e : list)
+		{
+			const u32 size = 16 << (rng() % 4); // 16..128 bytes
+
+			e.sb = 0;
+			e.ts = size;
+			e.ea = (rng() % (0xf0000 / 16)) * 16;
+			total += size;
+		}
+
+		const u32 lsa = 0x1000;
+
+		const auto t0 = std::chrono::high_resolution_clock::now();
+
+		for (u32 pass = 0; pass < passes; pass++)
+		{
+			u32 addr = lsa;
+
+			for (auto& e : list)
+			{
+				std::memcpy(ref + addr, mem.data() + e.ea, e.ts);
+				addr += std::max<u32>(e.ts, 16);
+			}
+		}
+
+		const auto t1 = std::chrono::high_resolution_clock::now();
+
+		for (u32 pass = 0; pass < passes; pass++)
+		{
+			spu_dma_list_copy(test, mem.data(), lsa, list.data(), count, true);
+		}
+
+		const auto t2 = std::chrono::high_resolution_clock::now();
+
+		const u64 ref_us = std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count();
+		const u64 test_us = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+
+		TEST_LOG("%u elements, %u bytes x %u: memcpy loop %llu us, spu_dma_list_copy %llu us\n", count, total, passes, ref_us, test_us);
+
+		if (std::memcmp(ref, test, 0x40000) != 0)
+		{
+			TEST_FAILURE("spu_dma_list_copy() result mismatch");
+		}
+	}
+};
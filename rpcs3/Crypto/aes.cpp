@@ -32,6 +32,123 @@
 #include "stdafx.h"
 #include "aes.h"
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#define AESNI_FUNC
+#else
+#include <cpuid.h>
+#include <wmmintrin.h>
+#define AESNI_FUNC __attribute__((target("aes,sse2")))
+#endif
+
+/*
+ * AES-NI support (CPUID.1:ECX[25]), used by ECB and CBC if available
+ */
+static bool aesni_supported()
+{
+#ifdef _MSC_VER
+    int regs[4];
+    __cpuid( regs, 1 );
+    return ( regs[2] & ( 1 << 25 ) ) != 0;
+#else
+    unsigned int eax, ebx, ecx, edx;
+    return __get_cpuid( 1, &eax, &ebx, &ecx, &edx ) && ( ecx & ( 1 << 25 ) ) != 0;
+#endif
+}
+
+static const bool g_aesni = aesni_supported();
+
+/*
+ * AES-NI block encryption/decryption (uses the same round keys as the table-based implementation,
+ * decryption keys are already in the "equivalent inverse cipher" form expected by AESDEC)
+ */
+AESNI_FUNC static inline __m128i aesni_crypt_block( const aes_context *ctx, int mode, __m128i block )
+{
+    const __m128i *rk = (const __m128i *) ctx->rk;
+
+    block = _mm_xor_si128( block, _mm_loadu_si128( rk++ ) );
+
+    if( mode == AES_DECRYPT )
+    {
+        for( int i = 1; i < ctx->nr; i++ )
+            block = _mm_aesdec_si128( block, _mm_loadu_si128( rk++ ) );
+
+        return _mm_aesdeclast_si128( block, _mm_loadu_si128( rk ) );
+    }
+
+    for( int i = 1; i < ctx->nr; i++ )
+        block = _mm_aesenc_si128( block, _mm_loadu_si128( rk++ ) );
+
+    return _mm_aesenclast_si128( block, _mm_loadu_si128( rk ) );
+}
+
+AESNI_FUNC static void aesni_crypt_ecb( const aes_context *ctx, int mode, const unsigned char input[16], unsigned char output[16] )
+{
+    _mm_storeu_si128( (__m128i *) output, aesni_crypt_block( ctx, mode, _mm_loadu_si128( (const __m128i *) input ) ) );
+}
+
+/*
+ * AES-NI CBC decryption (blocks are independent, so four of them are decrypted at once)
+ */
+AESNI_FUNC static void aesni_decrypt_cbc( const aes_context *ctx, size_t length, unsigned char iv[16], const unsigned char *input, unsigned char *output )
+{
+    const __m128i *rk = (const __m128i *) ctx->rk;
+
+    __m128i prev = _mm_loadu_si128( (const __m128i *) iv );
+
+    for( ; length >= 64; length -= 64, input += 64, output += 64 )
+    {
+        const __m128i c0 = _mm_loadu_si128( (const __m128i *) input + 0 );
+        const __m128i c1 = _mm_loadu_si128( (const __m128i *) input + 1 );
+        const __m128i c2 = _mm_loadu_si128( (const __m128i *) input + 2 );
+        const __m128i c3 = _mm_loadu_si128( (const __m128i *) input + 3 );
+
+        __m128i k = _mm_loadu_si128( rk );
+        __m128i b0 = _mm_xor_si128( c0, k ), b1 = _mm_xor_si128( c1, k ), b2 = _mm_xor_si128( c2, k ), b3 = _mm_xor_si128( c3, k );
+
+        for( int i = 1; i < ctx->nr; i++ )
+        {
+            k = _mm_loadu_si128( rk + i );
+            b0 = _mm_aesdec_si128( b0, k ); b1 = _mm_aesdec_si128( b1, k ); b2 = _mm_aesdec_si128( b2, k ); b3 = _mm_aesdec_si128( b3, k );
+        }
+
+        k = _mm_loadu_si128( rk + ctx->nr );
+        b0 = _mm_aesdeclast_si128( b0, k ); b1 = _mm_aesdeclast_si128( b1, k ); b2 = _mm_aesdeclast_si128( b2, k ); b3 = _mm_aesdeclast_si128( b3, k );
+
+        _mm_storeu_si128( (__m128i *) output + 0, _mm_xor_si128( b0, prev ) );
+        _mm_storeu_si128( (__m128i *) output + 1, _mm_xor_si128( b1, c0 ) );
+        _mm_storeu_si128( (__m128i *) output + 2, _mm_xor_si128( b2, c1 ) );
+        _mm_storeu_si128( (__m128i *) output + 3, _mm_xor_si128( b3, c2 ) );
+
+        prev = c3;
+    }
+
+    for( ; length > 0; length -= 16, input += 16, output += 16 )
+    {
+        const __m128i c = _mm_loadu_si128( (const __m128i *) input );
+        _mm_storeu_si128( (__m128i *) output, _mm_xor_si128( aesni_crypt_block( ctx, AES_DECRYPT, c ), prev ) );
+        prev = c;
+    }
+
+    _mm_storeu_si128( (__m128i *) iv, prev );
+}
+
+/*
+ * AES-NI CBC encryption
+ */
+AESNI_FUNC static void aesni_encrypt_cbc( const aes_context *ctx, size_t length, unsigned char iv[16], const unsigned char *input, unsigned char *output )
+{
+    __m128i block = _mm_loadu_si128( (const __m128i *) iv );
+
+    for( ; length > 0; length -= 16, input += 16, output += 16 )
+    {
+        block = aesni_crypt_block( ctx, AES_ENCRYPT, _mm_xor_si128( block, _mm_loadu_si128( (const __m128i *) input ) ) );
+        _mm_storeu_si128( (__m128i *) output, block );
+    }
+
+    _mm_storeu_si128( (__m128i *) iv, block );
+}
+
 /*
  * 32-bit integer manipulation macros (little endian)
  */
@@ -644,6 +761,12 @@ int aes_crypt_ecb( aes_context *ctx,
     int i;
     uint32_t *RK, X0, X1, X2, X3, Y0, Y1, Y2, Y3;
 
+    if( g_aesni )
+    {
+        aesni_crypt_ecb( ctx, mode, input, output );
+        return( 0 );
+    }
+
     RK = ctx->rk;
 
     GET_UINT32_LE( X0, input,  0 ); X0 ^= *RK++;
@@ -744,6 +867,16 @@ int aes_crypt_cbc( aes_context *ctx,
     if( length % 16 )
         return( POLARSSL_ERR_AES_INVALID_INPUT_LENGTH );
 
+    if( g_aesni )
+    {
+        if( mode == AES_DECRYPT )
+            aesni_decrypt_cbc( ctx, length, iv, input, output );
+        else
+            aesni_encrypt_cbc( ctx, length, iv, input, output );
+
+        return( 0 );
+    }
+
     if( mode == AES_DECRYPT )
     {
         while( length > 0 )
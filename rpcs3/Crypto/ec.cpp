@@ -460,12 +460,148 @@ try_again:
 	bn_from_mon(S, ec_N, 21);
 }
 
+// Point in Jacobian coordinates (x/z^2, y/z^3), z = 0 is the point at infinity
+struct jpoint {
+	u8 x[20];
+	u8 y[20];
+	u8 z[20];
+};
+
+static u8 ec_one[20];	// mon
+
+static void jpoint_double(struct jpoint *r, struct jpoint *p)
+{
+	u8 xx[20], yy[20], s[20], m[20], t[20];
+
+	if (elt_is_zero(p->z) || elt_is_zero(p->y)) {
+		elt_zero(r->z);
+		return;
+	}
+
+	elt_square(xx, p->x);		// xx = x*x
+	elt_square(yy, p->y);		// yy = y*y
+	elt_mul(s, p->x, yy);		// s = x*yy
+	elt_add(s, s, s);
+	elt_add(s, s, s);		// s = 4*x*yy
+	elt_square(t, p->z);
+	elt_square(t, t);		// t = z^4
+	elt_mul(m, t, ec_a);		// m = a*z^4
+	elt_add(m, m, xx);
+	elt_add(m, m, xx);
+	elt_add(m, m, xx);		// m = 3*xx + a*z^4
+
+	elt_mul(r->z, p->y, p->z);
+	elt_add(r->z, r->z, r->z);	// rz = 2*y*z
+
+	elt_square(r->x, m);
+	elt_sub(r->x, r->x, s);
+	elt_sub(r->x, r->x, s);		// rx = m*m - 2*s
+
+	elt_square(yy, yy);
+	elt_add(yy, yy, yy);
+	elt_add(yy, yy, yy);
+	elt_add(yy, yy, yy);		// yy = 8*y^4
+	elt_sub(t, s, r->x);
+	elt_mul(r->y, m, t);
+	elt_sub(r->y, r->y, yy);	// ry = m*(s - rx) - 8*y^4
+}
+
+// Add an affine point (mixed addition, r may be p)
+static void jpoint_add(struct jpoint *r, struct jpoint *p, struct point *q)
+{
+	u8 zz[20], u2[20], s2[20], h[20], rr[20], hh[20], hhh[20], v[20];
+
+	if (point_is_zero(q)) {
+		*r = *p;
+		return;
+	}
+
+	if (elt_is_zero(p->z)) {
+		elt_copy(r->x, q->x);
+		elt_copy(r->y, q->y);
+		elt_copy(r->z, ec_one);
+		return;
+	}
+
+	elt_square(zz, p->z);
+	elt_mul(u2, q->x, zz);		// u2 = qx*z^2
+	elt_mul(s2, q->y, zz);
+	elt_mul(s2, s2, p->z);		// s2 = qy*z^3
+	elt_sub(h, u2, p->x);		// h = u2 - px
+	elt_sub(rr, s2, p->y);		// rr = s2 - py
+
+	if (elt_is_zero(h)) {
+		if (elt_is_zero(rr))
+			jpoint_double(r, p);
+		else
+			elt_zero(r->z);
+
+		return;
+	}
+
+	elt_square(hh, h);
+	elt_mul(hhh, h, hh);
+	elt_mul(v, p->x, hh);		// v = px*h^2
+
+	elt_mul(r->z, p->z, h);		// rz = z*h
+
+	elt_mul(s2, p->y, hhh);		// s2 = py*h^3
+	elt_square(r->x, rr);
+	elt_sub(r->x, r->x, hhh);
+	elt_sub(r->x, r->x, v);
+	elt_sub(r->x, r->x, v);		// rx = rr*rr - h^3 - 2*v
+
+	elt_sub(v, v, r->x);
+	elt_mul(r->y, rr, v);
+	elt_sub(r->y, r->y, s2);	// ry = rr*(v - rx) - py*h^3
+}
+
+static void jpoint_to_point(struct point *r, struct jpoint *p)
+{
+	u8 zinv[20], t[20];
+
+	if (elt_is_zero(p->z)) {
+		point_zero(r);
+		return;
+	}
+
+	elt_inv(zinv, p->z);
+	elt_square(t, zinv);
+	elt_mul(r->x, p->x, t);
+	elt_mul(t, t, zinv);
+	elt_mul(r->y, p->y, t);
+}
+
+// d = a*b + c*e (Shamir's trick: both scalars are scanned at once, only the final result needs an inversion)
+static void point_mul_add(struct point *d, u8 *a, struct point *b, u8 *c, struct point *e)	// a and c are bignums
+{
+	struct point table[4];
+	struct jpoint r;
+	u32 i;
+	u8 mask;
+
+	point_zero(&table[0]);
+	table[1] = *b;
+	table[2] = *e;
+	point_add(&table[3], b, e);
+
+	elt_zero(r.z);
+
+	for (i = 0; i < 21; i++)
+		for (mask = 0x80; mask != 0; mask >>= 1) {
+			jpoint_double(&r, &r);
+			jpoint_add(&r, &r, &table[((a[i] & mask) ? 1 : 0) | ((c[i] & mask) ? 2 : 0)]);
+		}
+
+	jpoint_to_point(d, &r);
+}
+
 static int check_ecdsa(struct point *Q, u8 *R, u8 *S, u8 *hash)
 {
 	u8 Sinv[21];
 	u8 e[21];
 	u8 w1[21], w2[21];
-	struct point r1, r2;
+	struct point r1;
 	u8 rr[21];
 
 	e[0] = 0;
@@ -484,10 +620,7 @@ static int check_ecdsa(struct point *Q, u8 *R, u8 *S, u8 *hash)
 	bn_from_mon(w1, ec_N, 21);
 	bn_from_mon(w2, ec_N, 21);
 
-	point_mul(&r1, w1, &ec_G);
-	point_mul(&r2, w2, Q);
-
-	point_add(&r1, &r1, &r2);
+	point_mul_add(&r1, w1, &ec_G, w2, Q);
 
 	point_from_mon(&r1);
 
@@ -520,6 +653,10 @@ int ecdsa_set_curve(u8* p, u8* a, u8* b, u8* N, u8* Gx, u8* Gy)
 	bn_to_mon(ec_a, ec_p, 20);
 	bn_to_mon(ec_b, ec_p, 20);
 
+	elt_zero(ec_one);
+	ec_one[19] = 1;
+	bn_to_mon(ec_one, ec_p, 20);
+
 	point_to_mon(&ec_G);
 
 	return 0;
@@ -539,7 +676,30 @@ void ecdsa_set_priv(u8 *k)
 
 int ecdsa_verify(u8 *hash, u8 *R, u8 *S)
 {
-	return check_ecdsa(&ec_Q, R, S, hash);
+	// Results are cached for the curve, public key, hash and signature (the same files are checked on every boot or install)
+	static std::mutex mutex;
+	static std::unordered_map<std::string, int> cache;
+
+	std::string key;
+	key.append((char*)ec_p, sizeof(ec_p));
+	key.append((char*)ec_N, sizeof(ec_N));
+	key.append((char*)&ec_G, sizeof(ec_G));
+	key.append((char*)&ec_Q, sizeof(ec_Q));
+	key.append((char*)hash, 20);
+	key.append((char*)R, 21);
+	key.append((char*)S, 21);
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	const auto found = cache.find(key);
+
+	if (found != cache.end())
+		return found->second;
+
+	if (cache.size() >= 0x1000)
+		cache.clear();
+
+	return cache[key] = check_ecdsa(&ec_Q, R, S, hash);
 }
 
 void ecdsa_sign(u8 *hash, u8 *R, u8 *S)
@@ -1,6 +1,8 @@
 #include "stdafx.h"
 #include "key_vault.h"
-#include "unedat.h"
+#include "unedat.h"
+
+#include "Utilities/Thread.h"
 
 void generate_key(int crypto_mode, int version, unsigned char *key_final, unsigned char *iv_final, unsigned char *key, unsigned char *iv)
 {
@@ -135,171 +137,223 @@ unsigned char* get_block_key(int block, NPD_HEADER *npd)
 	return dest_key;
 }
 
-// EDAT/SDAT decryption.
-int decrypt_data(const fs::file* in, const fs::file* out, EDAT_HEADER *edat, NPD_HEADER *npd, unsigned char* crypt_key, bool verbose)
+// Decrypt a single EDAT/SDAT block (blocks are independent, so this function may be called concurrently).
+// Returns the decrypted data (padded to 16 bytes), its real length and the compression end flag.
+static bool decrypt_block(const fs::file* in, const EDAT_HEADER *edat, NPD_HEADER *npd, unsigned char* crypt_key, int i, std::vector<unsigned char>& dec_data, int& pad_length, int& compression_end, bool verbose)
 {
-	// Get metadata info and setup buffers.
+	// Get metadata info.
 	int block_num = (int)((edat->file_size + edat->block_size - 1) / edat->block_size);
 	int metadata_section_size = ((edat->flags & EDAT_COMPRESSED_FLAG) != 0 || (edat->flags & EDAT_FLAG_0x20) != 0) ? 0x20 : 0x10;
 	int metadata_offset = 0x100;
 
-	unsigned char *enc_data;
-	unsigned char *dec_data;
-	unsigned char *b_key;
-	unsigned char *iv;
-
-	unsigned char hash[0x10];
-	unsigned char key_result[0x10];
-	unsigned char hash_result[0x14];
-	memset(hash, 0, 0x10);
-	memset(key_result, 0, 0x10);
-	memset(hash_result, 0, 0x14);
+	unsigned char hash[0x10] = {};
+	unsigned char key_result[0x10] = {};
+	unsigned char hash_result[0x14] = {};
+	unsigned char empty_iv[0x10] = {};
 
 	unsigned long long offset = 0;
 	unsigned long long metadata_sec_offset = 0;
 	int length = 0;
-	int compression_end = 0;
-	unsigned char empty_iv[0x10] = {};
 
-	// Decrypt the metadata.
-	for (int i = 0; i < block_num; i++)
-	{
-		memset(hash_result, 0, 0x14);
+	compression_end = 0;
 
-		if ((edat->flags & EDAT_COMPRESSED_FLAG) != 0)
-		{
-			metadata_sec_offset = metadata_offset + (unsigned long long) i * metadata_section_size;
+	if ((edat->flags & EDAT_COMPRESSED_FLAG) != 0)
+	{
+		metadata_sec_offset = metadata_offset + (unsigned long long) i * metadata_section_size;
 
-			CHECK_ASSERTION(in->seek(metadata_sec_offset) != -1);
-			
-			unsigned char metadata[0x20];
-			memset(metadata, 0, 0x20);
-			in->read(metadata, 0x20);
+		unsigned char metadata[0x20] = {};
+		in->read_at(metadata_sec_offset, metadata, 0x20);
 
-			// If the data is compressed, decrypt the metadata.
-			// NOTE: For NPD version 1 the metadata is not encrypted.
-			if (npd->version <= 1)
-			{
-				offset = swap64(*(unsigned long long*)&metadata[0x10]);
-				length = swap32(*(int*)&metadata[0x18]);
-				compression_end = swap32(*(int*)&metadata[0x1C]);
-			}
-			else
-			{
-				unsigned char *result = dec_section(metadata);
-				offset = swap64(*(unsigned long long*)&result[0]);
-				length = swap32(*(int*)&result[8]);
-				compression_end = swap32(*(int*)&result[12]);
-				delete[] result;
-			}
-			
-			memcpy(hash_result, metadata, 0x10);
+		// If the data is compressed, decrypt the metadata.
+		// NOTE: For NPD version 1 the metadata is not encrypted.
+		if (npd->version <= 1)
+		{
+			offset = swap64(*(unsigned long long*)&metadata[0x10]);
+			length = swap32(*(int*)&metadata[0x18]);
+			compression_end = swap32(*(int*)&metadata[0x1C]);
 		}
-		else if ((edat->flags & EDAT_FLAG_0x20) != 0)
+		else
 		{
-			// If FLAG 0x20, the metadata precedes each data block.
-			metadata_sec_offset = metadata_offset + (unsigned long long) i * (metadata_section_size + length);
-			CHECK_ASSERTION(in->seek(metadata_sec_offset) != -1);
+			unsigned char *result = dec_section(metadata);
+			offset = swap64(*(unsigned long long*)&result[0]);
+			length = swap32(*(int*)&result[8]);
+			compression_end = swap32(*(int*)&result[12]);
+			delete[] result;
+		}
 
-			unsigned char metadata[0x20];
-			memset(metadata, 0, 0x20);
-			in->read(metadata, 0x20);
-			memcpy(hash_result, metadata, 0x14);
+		memcpy(hash_result, metadata, 0x10);
+	}
+	else if ((edat->flags & EDAT_FLAG_0x20) != 0)
+	{
+		// If FLAG 0x20, the metadata precedes each data block.
+		metadata_sec_offset = metadata_offset + (unsigned long long) i * (metadata_section_size + edat->block_size);
 
-			// If FLAG 0x20 is set, apply custom xor.
-			int j;
-			for (j = 0; j < 0x10; j++)
-				hash_result[j] = (unsigned char)(metadata[j] ^ metadata[j + 0x10]);
+		unsigned char metadata[0x20] = {};
+		in->read_at(metadata_sec_offset, metadata, 0x20);
+		memcpy(hash_result, metadata, 0x14);
 
-			offset = metadata_sec_offset + 0x20;
-			length = edat->block_size;
+		// If FLAG 0x20 is set, apply custom xor.
+		int j;
+		for (j = 0; j < 0x10; j++)
+			hash_result[j] = (unsigned char)(metadata[j] ^ metadata[j + 0x10]);
 
-			if ((i == (block_num - 1)) && (edat->file_size % edat->block_size))
-				length = (int)(edat->file_size % edat->block_size);
-		}
-		else
-		{
-			metadata_sec_offset = metadata_offset + (unsigned long long) i * metadata_section_size;
-			CHECK_ASSERTION(in->seek(metadata_sec_offset) != -1);
+		offset = metadata_sec_offset + 0x20;
+		length = edat->block_size;
 
-			in->read(hash_result, 0x10);
-			offset = metadata_offset + (unsigned long long) i * edat->block_size + (unsigned long long) block_num * metadata_section_size;
-			length = edat->block_size;
+		if ((i == (block_num - 1)) && (edat->file_size % edat->block_size))
+			length = (int)(edat->file_size % edat->block_size);
+	}
+	else
+	{
+		metadata_sec_offset = metadata_offset + (unsigned long long) i * metadata_section_size;
+
+		in->read_at(metadata_sec_offset, hash_result, 0x10);
+		offset = metadata_offset + (unsigned long long) i * edat->block_size + (unsigned long long) block_num * metadata_section_size;
+		length = edat->block_size;
+
+		if ((i == (block_num - 1)) && (edat->file_size % edat->block_size))
+			length = (int)(edat->file_size % edat->block_size);
+	}
+
+	// Locate the real data.
+	pad_length = length;
+	length = (int)((pad_length + 0xF) & 0xFFFFFFF0);
+
+	// Setup buffers for decryption and read the data.
+	std::vector<unsigned char> enc_data(length);
+	dec_data.assign(length, 0);
+
+	in->read_at(offset, enc_data.data(), length);
+
+	// Generate a key for the current block.
+	unsigned char *b_key = get_block_key(i, npd);
+
+	// Encrypt the block key with the crypto key.
+	aesecb128_encrypt(crypt_key, b_key, key_result);
+	if ((edat->flags & EDAT_FLAG_0x10) != 0)
+		aesecb128_encrypt(crypt_key, key_result, hash);  // If FLAG 0x10 is set, encrypt again to get the final hash.
+	else
+		memcpy(hash, key_result, 0x10);
+
+	delete[] b_key;
+
+	// Setup the crypto and hashing mode based on the extra flags.
+	int crypto_mode = ((edat->flags & EDAT_FLAG_0x02) == 0) ? 0x2 : 0x1;
+	int hash_mode;
+
+	if ((edat->flags  & EDAT_FLAG_0x10) == 0)
+		hash_mode = 0x02;
+	else if ((edat->flags & EDAT_FLAG_0x20) == 0)
+		hash_mode = 0x04;
+	else
+		hash_mode = 0x01;
+
+	if ((edat->flags  & EDAT_ENCRYPTED_KEY_FLAG) != 0)
+	{
+		crypto_mode |= 0x10000000;
+		hash_mode |= 0x10000000;
+	}
+
+	if ((edat->flags  & EDAT_DEBUG_DATA_FLAG) != 0)
+	{
+		// Reset the flags.
+		crypto_mode |= 0x01000000;
+		hash_mode |= 0x01000000;
+		// Simply copy the data without the header or the footer.
+		memcpy(dec_data.data(), enc_data.data(), length);
+	}
+	else
+	{
+		// IV is null if NPD version is 1 or 0.
+		unsigned char *iv = (npd->version <= 1) ? empty_iv : npd->digest;
+		// Call main crypto routine on this data block.
+		if (!decrypt(hash_mode, crypto_mode, (npd->version == 4), enc_data.data(), dec_data.data(), length, key_result, iv, hash, hash_result))
+		{
+			if (verbose)
+				LOG_WARNING(LOADER, "EDAT: Block at offset 0x%llx has invalid hash!", (u64)offset);
 
-			if ((i == (block_num - 1)) && (edat->file_size % edat->block_size))
-				length = (int)(edat->file_size % edat->block_size);
+			return false;
 		}
+	}
+
+	return true;
+}
 
-		// Locate the real data.
-		int pad_length = length;
-		length = (int)((pad_length + 0xF) & 0xFFFFFFF0);
+// EDAT/SDAT decryption.
+int decrypt_data(const fs::file* in, const fs::file* out, EDAT_HEADER *edat, NPD_HEADER *npd, unsigned char* crypt_key, bool verbose)
+{
+	int block_num = (int)((edat->file_size + edat->block_size - 1) / edat->block_size);
 
-		// Setup buffers for decryption and read the data.
-		enc_data = new unsigned char[length];
-		dec_data = new unsigned char[length];
-		memset(enc_data, 0, length);
-		memset(dec_data, 0, length);
-		memset(hash, 0, 0x10);
-		memset(key_result, 0, 0x10);
+	if ((edat->flags & EDAT_COMPRESSED_FLAG) == 0)
+	{
+		// Decrypt the blocks in parallel, write them in order.
+		std::atomic<int> next_block{ 0 };
+		std::atomic<bool> failed{ false };
 
-		CHECK_ASSERTION(in->seek(offset) != -1);
+		std::mutex mutex;
+		std::condition_variable cv;
+		int next_write = 0;
 
-		in->read(enc_data, length);
+		auto work = [&]()
+		{
+			std::vector<unsigned char> dec_data;
+			int pad_length, compression_end;
 
-		// Generate a key for the current block.
-		b_key = get_block_key(i, npd);
+			for (int i; (i = next_block++) < block_num;)
+			{
+				const bool ok = !failed && decrypt_block(in, edat, npd, crypt_key, i, dec_data, pad_length, compression_end, verbose);
 
-		// Encrypt the block key with the crypto key.
-		aesecb128_encrypt(crypt_key, b_key, key_result);
-		if ((edat->flags & EDAT_FLAG_0x10) != 0)
-			aesecb128_encrypt(crypt_key, key_result, hash);  // If FLAG 0x10 is set, encrypt again to get the final hash.
-		else
-			memcpy(hash, key_result, 0x10);
+				// Wait for the previous blocks (every thread holds only one block, taken in order)
+				std::unique_lock<std::mutex> lock(mutex);
 
-		// Setup the crypto and hashing mode based on the extra flags.
-		int crypto_mode = ((edat->flags & EDAT_FLAG_0x02) == 0) ? 0x2 : 0x1;
-		int hash_mode;
+				cv.wait(lock, [&] { return next_write == i; });
 
-		if ((edat->flags  & EDAT_FLAG_0x10) == 0)
-			hash_mode = 0x02;
-		else if ((edat->flags & EDAT_FLAG_0x20) == 0)
-			hash_mode = 0x04;
-		else
-			hash_mode = 0x01;
+				if (!ok)
+				{
+					failed = true;
+				}
+				else if (!failed)
+				{
+					out->write(dec_data.data(), pad_length);
+				}
 
-		if ((edat->flags  & EDAT_ENCRYPTED_KEY_FLAG) != 0)
+				next_write++;
+				cv.notify_all();
+			}
+		};
+
+		const u32 thread_count = std::max<u32>(std::min<u32>(std::thread::hardware_concurrency(), 8), 1);
+
+		std::vector<std::shared_ptr<thread_ctrl>> threads;
+
+		for (u32 i = 1; i < thread_count && i < (u32)block_num; i++)
 		{
-			crypto_mode |= 0x10000000;
-			hash_mode |= 0x10000000;
+			threads.emplace_back(thread_ctrl::spawn(COPY_EXPR(fmt::format("EDAT Worker[%u]", i)), work));
 		}
 
-		if ((edat->flags  & EDAT_DEBUG_DATA_FLAG) != 0)
+		work();
+
+		for (auto& thread : threads)
 		{
-			// Reset the flags.
-			crypto_mode |= 0x01000000;
-			hash_mode |= 0x01000000;
-			// Simply copy the data without the header or the footer.
-			memcpy(dec_data, enc_data, length);
+			thread->join();
 		}
-		else
+
+		return failed ? 1 : 0;
+	}
+
+	// Compressed data is decrypted sequentially.
+	for (int i = 0; i < block_num; i++)
+	{
+		std::vector<unsigned char> dec_data;
+		int pad_length, compression_end;
+
+		if (!decrypt_block(in, edat, npd, crypt_key, i, dec_data, pad_length, compression_end, verbose))
 		{
-			// IV is null if NPD version is 1 or 0.
-			iv = (npd->version <= 1) ? empty_iv : npd->digest;
-			// Call main crypto routine on this data block.
-			if (!decrypt(hash_mode, crypto_mode, (npd->version == 4), enc_data, dec_data, length, key_result, iv, hash, hash_result))
-			{
-				if (verbose)
-					LOG_WARNING(LOADER, "EDAT: Block at offset 0x%llx has invalid hash!", (u64)offset);
-				
-				delete[] enc_data;
-				delete[] dec_data;
-				delete[] b_key;
-				return 1;
-			}
+			return 1;
 		}
 
 		// Apply additional compression if needed and write the decrypted data.
-		if (((edat->flags & EDAT_COMPRESSED_FLAG) != 0) && compression_end)
+		if (compression_end)
 		{
 			int decomp_size = (int)edat->file_size;
 			unsigned char *decomp_data = new unsigned char[decomp_size];
@@ -308,7 +362,7 @@ int decrypt_data(const fs::file* in, const fs::file* out, EDAT_HEADER *edat, NPD
 			if (verbose)
 				LOG_NOTICE(LOADER, "EDAT: Decompressing data...");
 
-			int res = decompress(decomp_data, dec_data, decomp_size);
+			int res = decompress(decomp_data, dec_data.data(), decomp_size);
 			out->write(decomp_data, res);
 
 			if (verbose)
@@ -334,12 +388,8 @@ int decrypt_data(const fs::file* in, const fs::file* out, EDAT_HEADER *edat, NPD
 		}
 		else
 		{
-			out->write(dec_data, pad_length);
+			out->write(dec_data.data(), pad_length);
 		}
-
-		delete[] enc_data;
-		delete[] dec_data;
-		delete[] b_key;
 	}
 
 	return 0;
@@ -645,17 +695,13 @@ int validate_npd_hashes(const char* file_name, unsigned char *klicensee, NPD_HEA
 	return (title_hash_result && dev_hash_result);
 }
 
-bool extract_data(const fs::file* input, const fs::file* output, const char* input_file_name, unsigned char* devklic, unsigned char* rifkey, bool verbose)
+// Read in the NPD and EDAT/SDAT headers.
+static void read_headers(const fs::file* input, NPD_HEADER *NPD, EDAT_HEADER *EDAT)
 {
-	// Setup NPD and EDAT/SDAT structs.
-	NPD_HEADER *NPD = new NPD_HEADER();
-	EDAT_HEADER *EDAT = new EDAT_HEADER();
-
-	// Read in the NPD and EDAT/SDAT headers.
-	char npd_header[0x80];
-	char edat_header[0x10];
-	input->read(npd_header, sizeof(npd_header));
-	input->read(edat_header, sizeof(edat_header));
+	char npd_header[0x80] = {};
+	char edat_header[0x10] = {};
+	input->read_at(0, npd_header, sizeof(npd_header));
+	input->read_at(sizeof(npd_header), edat_header, sizeof(edat_header));
 
 	memcpy(NPD->magic, npd_header, 4);
 	NPD->version = swap32(*(int*)&npd_header[4]);
@@ -668,6 +714,19 @@ bool extract_data(const fs::file* input, const fs::file* output, const char* inp
 	NPD->unk1 = swap64(*(u64*)&npd_header[112]);
 	NPD->unk2 = swap64(*(u64*)&npd_header[120]);
 
+	EDAT->flags = swap32(*(int*)&edat_header[0]);
+	EDAT->block_size = swap32(*(int*)&edat_header[4]);
+	EDAT->file_size = swap64(*(u64*)&edat_header[8]);
+}
+
+bool extract_data(const fs::file* input, const fs::file* output, const char* input_file_name, unsigned char* devklic, unsigned char* rifkey, bool verbose)
+{
+	// Setup NPD and EDAT/SDAT structs.
+	NPD_HEADER *NPD = new NPD_HEADER();
+	EDAT_HEADER *EDAT = new EDAT_HEADER();
+
+	read_headers(input, NPD, EDAT);
+
 	unsigned char npd_magic[4] = {0x4E, 0x50, 0x44, 0x00};  //NPD0
 	if (memcmp(NPD->magic, npd_magic, 4))
 	{
@@ -677,10 +736,6 @@ bool extract_data(const fs::file* input, const fs::file* output, const char* inp
 		return 1;
 	}
 
-	EDAT->flags = swap32(*(int*)&edat_header[0]);
-	EDAT->block_size = swap32(*(int*)&edat_header[4]);
-	EDAT->file_size = swap64(*(u64*)&edat_header[8]);
-
 	if (verbose)
 	{
 		LOG_NOTICE(LOADER, "NPD HEADER");
@@ -900,3 +955,131 @@ int DecryptEDAT(const std::string& input_file_name, const std::string& output_fi
 	
 	return 0;
 }
+
+std::shared_ptr<sdata_stream_t> sdata_stream_t::open(const std::string& local_path)
+{
+	fs::file file(local_path);
+
+	if (!file)
+	{
+		return nullptr;
+	}
+
+	auto stream = std::make_shared<sdata_stream_t>();
+
+	read_headers(&file, &stream->m_npd, &stream->m_edat);
+
+	unsigned char npd_magic[4] = {0x4E, 0x50, 0x44, 0x00};  //NPD0
+	if (memcmp(stream->m_npd.magic, npd_magic, 4) || (stream->m_edat.flags & SDAT_FLAG) != SDAT_FLAG)
+	{
+		return nullptr;
+	}
+
+	if ((stream->m_edat.flags & EDAT_COMPRESSED_FLAG) != 0 || stream->m_edat.block_size <= 0)
+	{
+		LOG_ERROR(LOADER, "SDATA: %s: compressed data isn't supported.", local_path);
+		return nullptr;
+	}
+
+	// Generate SDAT key.
+	xor_key(stream->m_key, stream->m_npd.dev_hash, SDAT_KEY, 0x10);
+
+	if (check_data(stream->m_key, &stream->m_edat, &stream->m_npd, &file, false))
+	{
+		LOG_ERROR(LOADER, "SDATA: %s: data parsing failed!", local_path);
+		return nullptr;
+	}
+
+	stream->m_file = std::move(file);
+
+	return stream;
+}
+
+u64 sdata_stream_t::GetSize() const
+{
+	return m_edat.file_size;
+}
+
+u64 sdata_stream_t::Write(const void* src, u64 count)
+{
+	return 0;
+}
+
+u64 sdata_stream_t::Read(void* dst, u64 count)
+{
+	const u64 result = ReadAt(m_pos, dst, count);
+	m_pos += result;
+	return result;
+}
+
+u64 sdata_stream_t::ReadAt(u64 offset, void* dst, u64 count)
+{
+	if (offset >= m_edat.file_size)
+	{
+		return 0;
+	}
+
+	count = std::min<u64>(count, m_edat.file_size - offset);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	u64 done = 0;
+
+	while (done < count)
+	{
+		const int block = (int)((offset + done) / m_edat.block_size);
+
+		if (block != m_block)
+		{
+			int compression_end;
+
+			if (!decrypt_block(&m_file, &m_edat, &m_npd, m_key, block, m_data, m_block_size, compression_end, false))
+			{
+				LOG_ERROR(LOADER, "SDATA: Block %d has invalid hash!", block);
+				m_block = -1;
+				break;
+			}
+
+			m_block = block;
+		}
+
+		const u64 block_offset = offset + done - (u64)block * m_edat.block_size;
+		const u64 size = std::min<u64>(count - done, m_block_size - block_offset);
+
+		memcpy(static_cast<u8*>(dst) + done, m_data.data() + block_offset, size);
+		done += size;
+	}
+
+	return done;
+}
+
+bool sdata_stream_t::CanReadAt() const
+{
+	return true;
+}
+
+u64 sdata_stream_t::Seek(s64 offset, fs::seek_mode whence)
+{
+	const s64 pos =
+		whence == fs::seek_set ? offset :
+		whence == fs::seek_cur ? offset + m_pos :
+		whence == fs::seek_end ? offset + m_edat.file_size : -1;
+
+	if (pos < 0)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	return m_pos = pos;
+}
+
+u64 sdata_stream_t::Tell() const
+{
+	return m_pos;
+}
+
+bool sdata_stream_t::IsOpened() const
+{
+	return m_file.is_opened();
+}
@@ -3,6 +3,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "utils.h"
+#include "Emu/FS/vfsStream.h"
 
 #define SDAT_FLAG 0x01000000
 #define EDAT_COMPRESSED_FLAG 0x00000001
@@ -33,4 +34,33 @@ typedef struct
 	unsigned long long file_size;
 } EDAT_HEADER;
 
+// Random-access SDATA file reader: blocks are decrypted on demand instead of unpacking the whole file (compressed data isn't supported)
+class sdata_stream_t final : public vfsStream
+{
+	fs::file m_file;
+	NPD_HEADER m_npd;
+	EDAT_HEADER m_edat;
+	unsigned char m_key[0x10];
+	u64 m_pos = 0;
+
+	// Last decrypted block
+	std::mutex m_mutex;
+	int m_block = -1;
+	int m_block_size = 0;
+	std::vector<unsigned char> m_data;
+
+public:
+	// Open SDATA file (returns nullptr if it's not a valid uncompressed SDATA file)
+	static std::shared_ptr<sdata_stream_t> open(const std::string& local_path);
+
+	virtual u64 GetSize() const override;
+	virtual u64 Write(const void* src, u64 count) override;
+	virtual u64 Read(void* dst, u64 count) override;
+	virtual u64 ReadAt(u64 offset, void* dst, u64 count) override;
+	virtual bool CanReadAt() const override;
+	virtual u64 Seek(s64 offset, fs::seek_mode whence = fs::seek_set) override;
+	virtual u64 Tell() const override;
+	virtual bool IsOpened() const override;
+};
+
 int DecryptEDAT(const std::string& input_file_name, const std::string& output_file_name, int mode, const std::string& rap_file_name, unsigned char *custom_klic, bool verbose);
@@ -5,6 +5,8 @@
 #include "key_vault.h"
 #include "unpkg.h"
 
+#include "Utilities/Thread.h"
+
 static bool CheckHeader(const fs::file& pkg_f, PKGHeader& header)
 {
 	if (header.pkg_magic != 0x7F504B47)
@@ -56,6 +58,58 @@ static bool CheckHeader(const fs::file& pkg_f, PKGHeader& header)
 	return true;
 }
 
+// Decrypt the data at the specified offset of the data area (in place)
+static void pkg_decrypt(const PKGHeader& header, u64 offset, u128* buf, u64 size, bool psp)
+{
+	// Get block count
+	const u64 blocks = (size + 15) / 16;
+
+	if (header.pkg_type == PKG_RELEASE_TYPE_DEBUG)
+	{
+		// Debug key
+		be_t<u64> input[8] =
+		{
+			header.qa_digest[0],
+			header.qa_digest[0],
+			header.qa_digest[1],
+			header.qa_digest[1],
+		};
+
+		for (u64 i = 0; i < blocks; i++)
+		{
+			// Initialize "debug key" for current position
+			input[7] = offset / 16 + i;
+
+			u128 key;
+			
+			sha1(reinterpret_cast<const u8*>(input), sizeof(input), reinterpret_cast<u8*>(&key));
+
+			buf[i] ^= key;
+		}
+	}
+
+	if (header.pkg_type == PKG_RELEASE_TYPE_RELEASE)
+	{
+		aes_context ctx;
+
+		// Set decryption key
+		aes_setkey_enc(&ctx, psp ? PKG_AES_KEY2 : PKG_AES_KEY, 128);
+
+		// Initialize "release key" for start position
+		be_t<u128> input = header.klicensee.value() + offset / 16;
+
+		// Increment "release key" for every block
+		for (u64 i = 0; i < blocks; i++, input++)
+		{
+			u128 key;
+
+			aes_crypt_ecb(&ctx, AES_ENCRYPT, reinterpret_cast<const u8*>(&input), reinterpret_cast<u8*>(&key));
+
+			buf[i] ^= key;
+		}
+	}
+}
+
 // PKG Decryption
 bool pkg_install(const fs::file& pkg_f, const std::string& dir, volatile f64& progress)
 {
@@ -78,63 +132,14 @@ bool pkg_install(const fs::file& pkg_f, const std::string& dir, volatile f64& pr
 		return false;
 	}
 
-	// Allocate buffer with BUF_SIZE size or more if required
-	const std::unique_ptr<u128[]> buf(new u128[std::max<u64>(BUF_SIZE, sizeof(PKGEntry) * header.file_count) / sizeof(u128)]);
-
-	// Define decryption subfunction (`psp` arg selects the key for specific block)
-	auto decrypt = [&](u64 offset, u64 size, bool psp) -> u64
+	// Read and decrypt the data (positional read, may be called concurrently)
+	auto decrypt = [&](u64 offset, u64 size, bool psp, u128* buf) -> u64
 	{
-		CHECK_ASSERTION(pkg_f.seek(start_offset + header.data_offset + offset) != -1);
-
-		// Read the data and set available size
-		const u64 read = pkg_f.read(buf.get(), size);
-
-		// Get block count
-		const u64 blocks = (read + 15) / 16;
-
-		if (header.pkg_type == PKG_RELEASE_TYPE_DEBUG)
-		{
-			// Debug key
-			be_t<u64> input[8] =
-			{
-				header.qa_digest[0],
-				header.qa_digest[0],
-				header.qa_digest[1],
-				header.qa_digest[1],
-			};
+		const u64 read = pkg_f.read_at(start_offset + header.data_offset + offset, buf, size);
 
-			for (u64 i = 0; i < blocks; i++)
-			{
-				// Initialize "debug key" for current position
-				input[7] = offset / 16 + i;
-
-				u128 key;
-				
-				sha1(reinterpret_cast<const u8*>(input), sizeof(input), reinterpret_cast<u8*>(&key));
-
-				buf[i] ^= key;
-			}
-		}
-
-		if (header.pkg_type == PKG_RELEASE_TYPE_RELEASE)
+		if (read != -1)
 		{
-			aes_context ctx;
-
-			// Set decryption key
-			aes_setkey_enc(&ctx, psp ? PKG_AES_KEY2 : PKG_AES_KEY, 128);
-
-			// Initialize "release key" for start position
-			be_t<u128> input = header.klicensee.value() + offset / 16;
-
-			// Increment "release key" for every block
-			for (u64 i = 0; i < blocks; i++, input++)
-			{
-				u128 key;
-
-				aes_crypt_ecb(&ctx, AES_ENCRYPT, reinterpret_cast<const u8*>(&input), reinterpret_cast<u8*>(&key));
-
-				buf[i] ^= key;
-			}
+			pkg_decrypt(header, offset, buf, read, psp);
 		}
 
 		// Return the amount of data written in buf
@@ -143,15 +148,30 @@ bool pkg_install(const fs::file& pkg_f, const std::string& dir, volatile f64& pr
 
 	LOG_SUCCESS(LOADER, "PKG: Installing in %s (%d entries)...", dir, header.file_count);
 
-	decrypt(0, header.file_count * sizeof(PKGEntry), header.pkg_platform == PKG_PLATFORM_TYPE_PSP);
-
 	std::vector<PKGEntry> entries(header.file_count);
 
-	std::memcpy(entries.data(), buf.get(), entries.size() * sizeof(PKGEntry));
+	{
+		const std::unique_ptr<u128[]> buf(new u128[(entries.size() * sizeof(PKGEntry) + 15) / sizeof(u128)]);
 
-	for (const auto& entry : entries)
+		decrypt(0, entries.size() * sizeof(PKGEntry), header.pkg_platform == PKG_PLATFORM_TYPE_PSP, buf.get());
+
+		std::memcpy(entries.data(), buf.get(), entries.size() * sizeof(PKGEntry));
+	}
+
+	// Decrypt the names and split the files into chunks, which are read and decrypted in parallel and written in order
+	struct chunk_t
+	{
+		std::size_t entry;
+		u64 pos;
+		u64 size;
+	};
+
+	std::vector<std::string> names(entries.size());
+	std::vector<chunk_t> chunks;
+
+	for (std::size_t i = 0; i < entries.size(); i++)
 	{
-		const bool is_psp = (entry.type & PKG_FILE_ENTRY_PSP) != 0;
+		const auto& entry = entries[i];
 
 		if (entry.name_size > 256)
 		{
@@ -159,9 +179,11 @@ bool pkg_install(const fs::file& pkg_f, const std::string& dir, volatile f64& pr
 			continue;
 		}
 
-		decrypt(entry.name_offset, entry.name_size, is_psp);
+		u128 name[256 / sizeof(u128)];
 
-		const std::string name(reinterpret_cast<char*>(buf.get()), entry.name_size);
+		decrypt(entry.name_offset, entry.name_size, (entry.type & PKG_FILE_ENTRY_PSP) != 0, name);
+
+		names[i].assign(reinterpret_cast<char*>(name), entry.name_size);
 
 		switch (entry.type & 0xff)
 		{
@@ -171,30 +193,88 @@ bool pkg_install(const fs::file& pkg_f, const std::string& dir, volatile f64& pr
 		case PKG_FILE_ENTRY_REGULAR:
 		case PKG_FILE_ENTRY_UNK1:
 		{
-			const std::string path = dir + name;
+			u64 pos = 0;
 
-			const bool did_overwrite = fs::is_file(path);
+			do
+			{
+				chunks.push_back({ i, pos, std::min<u64>(BUF_SIZE, entry.file_size - pos) });
+				pos += BUF_SIZE;
+			}
+			while (pos < entry.file_size);
 
-			if (fs::file out{ path, fom::write | fom::create | fom::trunc })
+			break;
+		}
+
+		default:
+		{
+			chunks.push_back({ i, 0, 0 });
+		}
+		}
+	}
+
+	std::atomic<std::size_t> next_chunk{ 0 };
+
+	// Ordered stage state (protected by the mutex)
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::size_t next_write = 0;
+	fs::file out;
+	bool did_overwrite = false;
+
+	// Create the directory or file (first chunk), or write the decrypted chunk
+	auto write = [&](const chunk_t& chunk, const u128* buf, u64 read)
+	{
+		const auto& entry = entries[chunk.entry];
+		const auto& name = names[chunk.entry];
+		const std::string path = dir + name;
+
+		switch (entry.type & 0xff)
+		{
+		case PKG_FILE_ENTRY_NPDRM:
+		case PKG_FILE_ENTRY_NPDRMEDAT:
+		case PKG_FILE_ENTRY_SDAT:
+		case PKG_FILE_ENTRY_REGULAR:
+		case PKG_FILE_ENTRY_UNK1:
+		{
+			if (chunk.pos == 0)
 			{
-				for (u64 pos = 0; pos < entry.file_size; pos += BUF_SIZE)
+				did_overwrite = fs::is_file(path);
+
+				if (out.open(path, fom::write | fom::create | fom::trunc))
 				{
-					const u64 block_size = std::min<u64>(BUF_SIZE, entry.file_size - pos);
+					// Preallocate the file
+					out.trunc(entry.file_size);
+				}
+				else
+				{
+					LOG_ERROR(LOADER, "PKG: Could not create file %s", path);
+				}
+			}
 
-					if (decrypt(entry.file_offset + pos, block_size, is_psp) != block_size)
-					{
-						LOG_ERROR(LOADER, "PKG: Failed to extract file %s", path);
-						break;
-					}
+			if (!out)
+			{
+				break;
+			}
 
-					if (out.write(buf.get(), block_size) != block_size)
-					{
-						LOG_ERROR(LOADER, "PKG: Failed to write file %s", path);
-						break;
-					}
+			if (read != chunk.size)
+			{
+				LOG_ERROR(LOADER, "PKG: Failed to extract file %s", path);
+				out.close();
+				break;
+			}
 
-					progress += (block_size + 0.0) / header.data_size;
-				}
+			if (out.write(buf, chunk.size) != chunk.size)
+			{
+				LOG_ERROR(LOADER, "PKG: Failed to write file %s", path);
+				out.close();
+				break;
+			}
+
+			progress += (chunk.size + 0.0) / header.data_size;
+
+			if (chunk.pos + chunk.size >= entry.file_size)
+			{
+				out.close();
 
 				if (did_overwrite)
 				{
@@ -205,18 +285,12 @@ bool pkg_install(const fs::file& pkg_f, const std::string& dir, volatile f64& pr
 					LOG_SUCCESS(LOADER, "PKG: %s file created", name);
 				}
 			}
-			else
-			{
-				LOG_ERROR(LOADER, "PKG: Could not create file %s", path);
-			}
 
 			break;
 		}
 
 		case PKG_FILE_ENTRY_FOLDER:
 		{
-			const std::string path = dir + name;
-
 			if (fs::create_dir(path))
 			{
 				LOG_SUCCESS(LOADER, "PKG: %s directory created", name);
@@ -238,6 +312,45 @@ bool pkg_install(const fs::file& pkg_f, const std::string& dir, volatile f64& pr
 			LOG_ERROR(LOADER, "PKG: Unknown PKG entry type (0x%x) %s", entry.type, name);
 		}
 		}
+	};
+
+	auto work = [&]()
+	{
+		const std::unique_ptr<u128[]> buf(new u128[BUF_SIZE / sizeof(u128)]);
+
+		for (std::size_t i; (i = next_chunk++) < chunks.size();)
+		{
+			const auto& chunk = chunks[i];
+
+			const u64 read = chunk.size ? decrypt(entries[chunk.entry].file_offset + chunk.pos, chunk.size, (entries[chunk.entry].type & PKG_FILE_ENTRY_PSP) != 0, buf.get()) : 0;
+
+			// Wait for the previous chunks (every thread holds only one chunk, taken in order)
+			std::unique_lock<std::mutex> lock(mutex);
+
+			cv.wait(lock, [&] { return next_write == i; });
+
+			write(chunk, buf.get(), read);
+
+			next_write++;
+			cv.notify_all();
+		}
+	};
+
+	// Run the workers (the current thread is one of them)
+	const u32 thread_count = std::max<u32>(std::min<u32>(std::thread::hardware_concurrency(), 8), 1);
+
+	std::vector<std::shared_ptr<thread_ctrl>> threads;
+
+	for (u32 i = 1; i < thread_count; i++)
+	{
+		threads.emplace_back(thread_ctrl::spawn(COPY_EXPR(fmt::format("PKG Worker[%u]", i)), work));
+	}
+
+	work();
+
+	for (auto& thread : threads)
+	{
+		thread->join();
 	}
 
 	return true;
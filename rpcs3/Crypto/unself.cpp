@@ -2,8 +2,15 @@
 #include "aes.h"
 #include "sha1.h"
 #include "utils.h"
+#include "Emu/System.h"
+#include "Emu/state.h"
+#include "Emu/FS/VFS.h"
+#include "Emu/FS/vfsFile.h"
 #include "Emu/FS/vfsLocalFile.h"
 #include "unself.h"
+
+#include "Utilities/Thread.h"
+
 #pragma warning(push)
 #pragma message("TODO: remove wx dependencies: <wx/mstream.h> <wx/zstream.h>")
 #pragma warning(disable : 4996)
@@ -1013,69 +1020,88 @@ bool SELFDecrypter::LoadMetadata()
 	return true;
 }
 
+// Run func(i) for every i < count on up to 8 threads (sections are independent)
+template<typename F>
+static void process_sections(u32 count, const char* name, F func)
+{
+	std::atomic<u32> next{ 0 };
+
+	auto work = [&]()
+	{
+		for (u32 i; (i = next++) < count;)
+		{
+			func(i);
+		}
+	};
+
+	const u32 thread_count = std::max<u32>(std::min<u32>(std::thread::hardware_concurrency(), 8), 1);
+
+	std::vector<std::shared_ptr<thread_ctrl>> threads;
+
+	for (u32 i = 1; i < thread_count && i < count; i++)
+	{
+		threads.emplace_back(thread_ctrl::spawn(COPY_EXPR(fmt::format("%s Worker[%u]", name, i)), work));
+	}
+
+	work();
+
+	for (auto& thread : threads)
+	{
+		thread->join();
+	}
+}
+
 bool SELFDecrypter::DecryptData()
 {
-	aes_context aes;
+	// Offsets of the encrypted sections in the data buffer.
+	std::vector<u32> sections;
+	std::vector<u32> offsets;
 
 	// Calculate the total data size.
 	for (unsigned int i = 0; i < meta_hdr.section_count; i++)
 	{
 		if (meta_shdr[i].encrypted == 3)
 		{
+			// Make sure the key and iv are not out of boundaries.
 			if ((meta_shdr[i].key_idx <= meta_hdr.key_count - 1) && (meta_shdr[i].iv_idx <= meta_hdr.key_count))
+			{
+				sections.push_back(i);
+				offsets.push_back(data_buf_length);
 				data_buf_length += meta_shdr[i].data_size;
+			}
 		}
 	}
 
 	// Allocate a buffer to store decrypted data.
 	data_buf = (u8*)malloc(data_buf_length);
 
-	// Set initial offset.
-	u32 data_buf_offset = 0;
+	// Read the encrypted data of every section (the stream is not shared with the workers).
+	for (std::size_t j = 0; j < sections.size(); j++)
+	{
+		const auto& shdr = meta_shdr[sections[j]];
 
-	// Parse the metadata section headers to find the offsets of encrypted data.
-	for (unsigned int i = 0; i < meta_hdr.section_count; i++)
+		CHECK_ASSERTION(self_f.Seek(shdr.data_offset) != -1);
+		self_f.Read(data_buf + offsets[j], shdr.data_size);
+	}
+
+	// Perform AES-CTR decryption of the sections in place, in parallel.
+	process_sections(static_cast<u32>(sections.size()), "SELF", [&](u32 j)
 	{
+		const auto& shdr = meta_shdr[sections[j]];
+
+		aes_context aes;
 		size_t ctr_nc_off = 0;
-		u8 ctr_stream_block[0x10];
+		u8 ctr_stream_block[0x10] = {};
 		u8 data_key[0x10];
 		u8 data_iv[0x10];
 
-		// Check if this is an encrypted section.
-		if (meta_shdr[i].encrypted == 3)
-		{
-			// Make sure the key and iv are not out of boundaries.
-			if((meta_shdr[i].key_idx <= meta_hdr.key_count - 1) && (meta_shdr[i].iv_idx <= meta_hdr.key_count))
-			{
-				// Get the key and iv from the previously stored key buffer.
-				memcpy(data_key, data_keys + meta_shdr[i].key_idx * 0x10, 0x10);
-				memcpy(data_iv, data_keys + meta_shdr[i].iv_idx * 0x10, 0x10);
-
-				// Allocate a buffer to hold the data.
-				u8 *buf = (u8 *)malloc(meta_shdr[i].data_size);
-
-				// Seek to the section data offset and read the encrypted data.
-				CHECK_ASSERTION(self_f.Seek(meta_shdr[i].data_offset) != -1);
-				self_f.Read(buf, meta_shdr[i].data_size);
-
-				// Zero out our ctr nonce.
-				memset(ctr_stream_block, 0, sizeof(ctr_stream_block));
-
-				// Perform AES-CTR encryption on the data blocks.
-				aes_setkey_enc(&aes, data_key, 128);
-				aes_crypt_ctr(&aes, meta_shdr[i].data_size, &ctr_nc_off, data_iv, ctr_stream_block, buf, buf);
-
-				// Copy the decrypted data.
-				memcpy(data_buf + data_buf_offset, buf, meta_shdr[i].data_size);
-
-				// Advance the buffer's offset.
-				data_buf_offset += meta_shdr[i].data_size;
+		// Get the key and iv from the previously stored key buffer.
+		memcpy(data_key, data_keys + shdr.key_idx * 0x10, 0x10);
+		memcpy(data_iv, data_keys + shdr.iv_idx * 0x10, 0x10);
 
-				// Release the temporary buffer.
-				free(buf);
-			}
-		}
-	}
+		aes_setkey_enc(&aes, data_key, 128);
+		aes_crypt_ctr(&aes, shdr.data_size, &ctr_nc_off, data_iv, ctr_stream_block, data_buf + offsets[j], data_buf + offsets[j]);
+	});
 
 	return true;
 }
@@ -1141,49 +1167,63 @@ bool SELFDecrypter::MakeElf(const std::string& elf, bool isElf32)
 			WritePhdr(e, phdr64_arr[i]);
 		}
 
-		// Write data.
+		// Data buffer offsets of the PHDR sections.
+		std::vector<u32> sections;
+		std::vector<u32> offsets;
+
 		for (unsigned int i = 0; i < meta_hdr.section_count; i++)
 		{
 			// PHDR type.
 			if (meta_shdr[i].type == 2)
 			{
-				// Decompress if necessary.
-				if (meta_shdr[i].compressed == 2)
-				{
-					// Allocate a buffer for decompression.
-					u8 *decomp_buf = (u8 *)malloc(phdr64_arr[meta_shdr[i].program_idx].p_filesz);
+				sections.push_back(i);
+				offsets.push_back(data_buf_offset);
+
+				// Advance the data buffer offset by data size.
+				data_buf_offset += meta_shdr[i].data_size;
+			}
+		}
 
-					// Set up memory streams for input/output.
-					wxMemoryInputStream decomp_stream_in(data_buf + data_buf_offset, meta_shdr[i].data_size);
-					wxMemoryOutputStream decomp_stream_out;
+		// Decompress the compressed sections in parallel into their own buffers.
+		std::vector<std::vector<u8>> decomp_bufs(sections.size());
 
-					// Create a Zlib stream, read the data and flush the stream.
-					wxZlibInputStream* z_stream = new wxZlibInputStream(decomp_stream_in);
-					z_stream->Read(decomp_stream_out);
-					delete z_stream;
+		process_sections(static_cast<u32>(sections.size()), "SELF zlib", [&](u32 j)
+		{
+			const auto& shdr = meta_shdr[sections[j]];
 
-					// Copy the decompressed result from the stream.
-					decomp_stream_out.CopyTo(decomp_buf, phdr64_arr[meta_shdr[i].program_idx].p_filesz);
+			if (shdr.compressed == 2)
+			{
+				auto& decomp_buf = decomp_bufs[j];
+				decomp_buf.resize(phdr64_arr[shdr.program_idx].p_filesz);
 
-					// Seek to the program header data offset and write the data.
+				// Set up memory streams for input/output.
+				wxMemoryInputStream decomp_stream_in(data_buf + offsets[j], shdr.data_size);
+				wxMemoryOutputStream decomp_stream_out;
 
-					CHECK_ASSERTION(e.seek(phdr64_arr[meta_shdr[i].program_idx].p_offset) != -1);
+				// Create a Zlib stream, read the data and flush the stream.
+				wxZlibInputStream z_stream(decomp_stream_in);
+				z_stream.Read(decomp_stream_out);
 
-					e.write(decomp_buf, phdr64_arr[meta_shdr[i].program_idx].p_filesz);
+				// Copy the decompressed result from the stream.
+				decomp_stream_out.CopyTo(decomp_buf.data(), decomp_buf.size());
+			}
+		});
 
-					// Release the decompression buffer.
-					free(decomp_buf);
-				}
-				else
-				{
-					// Seek to the program header data offset and write the data.
-					CHECK_ASSERTION(e.seek(phdr64_arr[meta_shdr[i].program_idx].p_offset) != -1);
-					
-					e.write(data_buf + data_buf_offset, meta_shdr[i].data_size);
-				}
+		// Write data.
+		for (std::size_t j = 0; j < sections.size(); j++)
+		{
+			const auto& shdr = meta_shdr[sections[j]];
 
-				// Advance the data buffer offset by data size.
-				data_buf_offset += meta_shdr[i].data_size;
+			// Seek to the program header data offset and write the data.
+			CHECK_ASSERTION(e.seek(phdr64_arr[shdr.program_idx].p_offset) != -1);
+
+			if (shdr.compressed == 2)
+			{
+				e.write(decomp_bufs[j].data(), decomp_bufs[j].size());
+			}
+			else
+			{
+				e.write(data_buf + offsets[j], shdr.data_size);
 			}
 		}
 
@@ -1328,7 +1368,7 @@ bool CheckDebugSelf(const std::string& self, const std::string& elf)
 	return false;
 }
 
-bool DecryptSelf(const std::string& elf, const std::string& self)
+static bool DecryptSelfFile(const std::string& elf, const std::string& self)
 {
 	LOG_NOTICE(LOADER, "Decrypting %s", self);
 
@@ -1378,3 +1418,120 @@ bool DecryptSelf(const std::string& elf, const std::string& self)
 
 	return true;
 }
+
+// Get the path of the decrypted SELF in the cache. The key is the SHA-1 of the SELF header (it contains the encrypted
+// section keys and the section hashes, so it identifies the content) and the file size.
+static std::string GetSelfCachePath(const std::string& self)
+{
+	fs::file f(self);
+
+	u8 header[0x20];
+
+	if (!f || f.read(header, sizeof(header)) != sizeof(header))
+	{
+		return{};
+	}
+
+	const u64 header_size = swap64(*(u64*)&header[0x10]);
+
+	if (header_size < sizeof(header) || header_size > f.size() || header_size > 0x100000)
+	{
+		return{};
+	}
+
+	std::vector<u8> data(header_size);
+
+	if (f.read_at(0, data.data(), header_size) != header_size)
+	{
+		return{};
+	}
+
+	u8 hash[20];
+	sha1(data.data(), data.size(), hash);
+
+	std::string name;
+
+	for (u8 byte : hash)
+	{
+		name += fmt::format("%02x", byte);
+	}
+
+	return fs::get_config_dir() + "data/cache/self/" + name + fmt::format("_%llx.elf", f.size());
+}
+
+std::string DecryptSelfCached(const std::string& self)
+{
+	const std::string& path = GetSelfCachePath(self);
+
+	if (path.empty())
+	{
+		LOG_ERROR(LOADER, "SELF: Invalid SELF header (%s)", self);
+		return{};
+	}
+
+	if (fs::is_file(path))
+	{
+		LOG_NOTICE(LOADER, "Using decrypted %s from the cache", self);
+		return path;
+	}
+
+	const std::string& dir = fs::get_parent_dir(path);
+
+	if (!fs::is_dir(dir) && !fs::create_path(dir))
+	{
+		LOG_ERROR(LOADER, "SELF: Failed to create cache directory (%s)", dir);
+		return{};
+	}
+
+	// Decrypt to a temporary file first, so an interrupted decryption doesn't leave a broken ELF in the cache
+	const std::string& temp = path + ".tmp";
+
+	if (!DecryptSelfFile(temp, self) || !fs::rename(temp, path))
+	{
+		fs::remove_file(temp);
+		return{};
+	}
+
+	return path;
+}
+
+bool DecryptSelf(const std::string& elf, const std::string& self)
+{
+	if (rpcs3::config.system.self_cache.value())
+	{
+		const std::string& cached = DecryptSelfCached(self);
+
+		if (!cached.empty() && fs::copy_file(cached, elf, true))
+		{
+			return true;
+		}
+	}
+
+	return DecryptSelfFile(elf, self);
+}
+
+std::shared_ptr<vfsStream> OpenSelfOrElf(const std::string& path)
+{
+	std::string local_path;
+
+	if (rpcs3::config.system.self_cache.value() && Emu.GetVFS().GetDevice(path, local_path) && IsSelf(local_path))
+	{
+		const std::string& elf = DecryptSelfCached(local_path);
+
+		if (elf.empty())
+		{
+			return nullptr;
+		}
+
+		auto file = std::make_shared<vfsLocalFile>(nullptr);
+
+		if (!file->Open(elf))
+		{
+			return nullptr;
+		}
+
+		return file;
+	}
+
+	return std::make_shared<vfsFile>(path);
+}
@@ -393,3 +393,9 @@ extern bool IsSelf(const std::string& path);
 extern bool IsSelfElf32(const std::string& path);
 extern bool CheckDebugSelf(const std::string& self, const std::string& elf);
 extern bool DecryptSelf(const std::string& elf, const std::string& self);
+
+// Decrypt SELF file to the decrypted SELF cache (or find it there), returns the path of the ELF file or an empty string on failure
+extern std::string DecryptSelfCached(const std::string& self);
+
+// Open module file by VFS path (SELF file is opened as the decrypted ELF from the cache)
+extern std::shared_ptr<vfsStream> OpenSelfOrElf(const std::string& path);
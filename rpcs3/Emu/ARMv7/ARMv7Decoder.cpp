@@ -1152,45 +1152,67 @@ struct ARMv7_op2_table_t
 
 } g_op2t;
 
-struct ARMv7_op4t_table_t
+// Two-level lookup for 32-bit opcodes: 12 opcode bits select a bucket, which lists the opcodes that can match them in table order
+template<u32(*index)(u32), u32(*expand)(u32), u32 index_mask>
+struct ARMv7_op4_lookup_t
 {
-	std::vector<const ARMv7_opcode_t*> table;
+	std::vector<const ARMv7_opcode_t*> buckets[0x1000];
 
-	ARMv7_op4t_table_t()
+	void add(const ARMv7_opcode_t* opcode)
 	{
-		for (auto& opcode : ARMv7_opcode_table)
+		for (u32 i = 0; i < 0x1000; i++)
 		{
-			if (opcode.length == 4 && opcode.type < A1)
+			if ((expand(i) & opcode->mask & index_mask) == (opcode->code & index_mask))
 			{
-				if (opcode.code & ~opcode.mask)
-				{
-					LOG_ERROR(ARMv7, "%s: wrong opcode mask (mask=0x%04x 0x%04x, code=0x%04x 0x%04x)", opcode.name, opcode.mask >> 16, (u16)opcode.mask, opcode.code >> 16, (u16)opcode.code);
-				}
-
-				table.push_back(&opcode);
+				buckets[i].push_back(opcode);
 			}
 		}
 	}
 
-	const ARMv7_opcode_t* HACK()
+	const ARMv7_opcode_t* find(u32 code) const
 	{
-		for (auto& opcode : table)
+		for (auto opcode : buckets[index(code)])
 		{
-			if (opcode->func == ARMv7_instrs::HACK)
+			if ((code & opcode->mask) == opcode->code && (!opcode->skip || !opcode->skip(code)))
 			{
 				return opcode;
 			}
 		}
 
-		throw EXCEPTION("HACK instruction not found");
+		return nullptr;
 	}
-	
-} g_op4t;
+};
+
+// Thumb: bits 31..20 (the first halfword without its low nibble)
+inline u32 thumb_index(u32 code) { return code >> 20; }
+inline u32 thumb_expand(u32 index) { return index << 20; }
+
+// ARM: bits 27..20 and 7..4, the fields used by the ARM decoding tables
+inline u32 arm_index(u32 code) { return (code >> 16 & 0xff0) | (code >> 4 & 0xf); }
+inline u32 arm_expand(u32 index) { return (index & 0xff0) << 16 | (index & 0xf) << 4; }
 
-struct ARMv7_op4arm_table_t
+struct ARMv7_op4t_table_t : ARMv7_op4_lookup_t<thumb_index, thumb_expand, 0xfff00000>
 {
-	std::vector<const ARMv7_opcode_t*> table;
+	ARMv7_op4t_table_t()
+	{
+		for (auto& opcode : ARMv7_opcode_table)
+		{
+			if (opcode.length == 4 && opcode.type < A1)
+			{
+				if (opcode.code & ~opcode.mask)
+				{
+					LOG_ERROR(ARMv7, "%s: wrong opcode mask (mask=0x%04x 0x%04x, code=0x%04x 0x%04x)", opcode.name, opcode.mask >> 16, (u16)opcode.mask, opcode.code >> 16, (u16)opcode.code);
+				}
 
+				add(&opcode);
+			}
+		}
+	}
+
+} g_op4t;
+
+struct ARMv7_op4arm_table_t : ARMv7_op4_lookup_t<arm_index, arm_expand, 0x0ff000f0>
+{
 	ARMv7_op4arm_table_t()
 	{
 		for (auto& opcode : ARMv7_opcode_table)
@@ -1202,26 +1224,19 @@ struct ARMv7_op4arm_table_t
 					LOG_ERROR(ARMv7, "%s: wrong opcode mask (mask=0x%08x, code=0x%08x)", opcode.name, opcode.mask, opcode.code);
 				}
 
-				table.push_back(&opcode);
+				add(&opcode);
 			}
 		}
 	}
 
 } g_op4arm;
 
-std::unordered_map<u32, const ARMv7_opcode_t*> g_opct;
-
 void armv7_decoder_initialize(u32 addr, u32 end_addr, bool dump)
 {
-	// 1. Find every 4-byte Thumb instruction and cache it
+	// 1. Replace BLX calls of imported functions with HACK instructions
 	// 2. If some instruction is not recognized, print the error
 	// 3. Possibly print disasm
 
-	//g_opct.clear();
-	//g_opct.reserve(end_addr - addr);
-
-	const auto hack = g_op4t.HACK();
-
 	while (addr < end_addr)
 	{
 		ARMv7Code code = {};
@@ -1234,23 +1249,7 @@ void armv7_decoder_initialize(u32 addr, u32 end_addr, bool dump)
 			code.code1 = code.code0;
 			code.code0 = vm::psv::read16(addr + 2);
 
-			auto op = g_opct.find(code.data);
-			if (op != g_opct.end())
-			{
-				found = op->second;
-			}
-		}
-
-		if (!found)
-		{
-			for (auto opcode : g_op4t.table)
-			{
-				if ((code.data & opcode->mask) == opcode->code && (!opcode->skip || !opcode->skip(code.data)))
-				{
-					g_opct[code.data] = (found = opcode);
-					break;
-				}
-			}
+			found = g_op4t.find(code.data);
 		}
 		
 		if (!found)
@@ -1289,7 +1288,6 @@ void armv7_decoder_initialize(u32 addr, u32 end_addr, bool dump)
 				// replace BLX with "HACK" instruction directly (in Thumb form), it can help to see where it was called from
 				const u32 index = (instr & 0xfff00) >> 4 | (instr & 0xf);
 				vm::psv::write32(addr, 0xf870 | index << 16);
-				g_opct[0xf8700000 | index] = hack;
 			}
 			else
 			{
@@ -1305,61 +1303,135 @@ void armv7_decoder_initialize(u32 addr, u32 end_addr, bool dump)
 		addr += found->length;
 	}
 
-	LOG_NOTICE(ARMv7, "armv7_decoder_initialize() finished, g_opct.size() = %lld, g_op2t.null_ops=0x%x", (u64)g_opct.size(), g_op2t.null_ops);
+	LOG_NOTICE(ARMv7, "armv7_decoder_initialize() finished, g_op2t.null_ops=0x%x", g_op2t.null_ops);
 }
 
-u32 ARMv7Decoder::DecodeMemory(const u32 address)
+struct armv7_decoder_page_t
+{
+	armv7_decoded_t data[0x800];
+};
+
+armv7_decoded_t armv7_decode(ARMv7InstructionSet iset, const u32 address)
 {
-	ARMv7Code code = {};
+	armv7_decoded_t result = {};
+	result.length = 4;
+	result.iset = (u8)iset;
 
-	if (m_ctx.ISET == Thumb)
+	if (iset == Thumb)
 	{
-		code.code0 = vm::psv::read16(address);
+		result.code.code0 = vm::psv::read16(address);
 
-		if (auto opcode = g_op2t.data[code.code0])
+		if (auto opcode = g_op2t.data[result.code.code0])
 		{
-			(*opcode->func)(m_ctx, code, opcode->type);
-			return 2;
+			result.func = opcode->func;
+			result.type = opcode->type;
+			result.length = 2;
+			return result;
 		}
 
-		code.code1 = code.code0;
-		code.code0 = vm::psv::read16(address + 2);
+		result.code.code1 = result.code.code0;
+		result.code.code0 = vm::psv::read16(address + 2);
 
-		auto op = g_opct.find(code.data);
-		if (op != g_opct.end())
+		if (auto opcode = g_op4t.find(result.code.data))
 		{
-			(*op->second->func)(m_ctx, code, op->second->type);
-			return 4;
+			result.func = opcode->func;
+			result.type = opcode->type;
 		}
-
-		//for (auto opcode : g_op4t.table)
-		//{
-		//	if ((code.data & opcode->mask) == opcode->code && (!opcode->skip || !opcode->skip(code.data)))
-		//	{
-		//		(*opcode->func)(m_ctx, code, opcode->type);
-		//		return 4;
-		//	}
-		//}
 	}
-	else if (m_ctx.ISET == ARM)
+	else if (iset == ARM)
 	{
-		code.data = vm::psv::read32(address);
+		result.code.data = vm::psv::read32(address);
 
-		for (auto opcode : g_op4arm.table)
+		if (auto opcode = g_op4arm.find(result.code.data))
 		{
-			if ((code.data & opcode->mask) == opcode->code && (!opcode->skip || !opcode->skip(code.data)))
-			{
-				(*opcode->func)(m_ctx, code, opcode->type);
-				return 4;
-			}
+			result.func = opcode->func;
+			result.type = opcode->type;
 		}
 	}
 	else
 	{
 		throw EXCEPTION("Invalid instruction set");
 	}
-	
-	ARMv7_instrs::UNK(m_ctx, code);
+
+	return result;
+}
+
+ARMv7Decoder::ARMv7Decoder(ARMv7Context& context)
+	: m_ctx(context)
+{
+}
+
+ARMv7Decoder::~ARMv7Decoder()
+{
+}
+
+u32 ARMv7Decoder::Execute(const u32 address)
+{
+	const u32 page_addr = address & ~0xfff;
+
+	if (page_addr != m_last_page_addr)
+	{
+		auto& page = m_pages[page_addr];
+
+		if (!page)
+		{
+			page.reset(new armv7_decoder_page_t{});
+		}
+
+		m_last_page = page.get();
+		m_last_page_addr = page_addr;
+	}
+
+	armv7_decoded_t& entry = m_last_page->data[(address & 0xfff) / 2];
+
+	// The entry is stale if the code was modified or is executed in another instruction set
+	bool valid = entry.length && entry.iset == (u8)m_ctx.ISET;
+
+	if (valid)
+	{
+		if (entry.iset == ARM)
+		{
+			valid = vm::psv::read32(address) == entry.code.data;
+		}
+		else if (entry.length == 2)
+		{
+			valid = vm::psv::read16(address) == entry.code.code0;
+		}
+		else
+		{
+			valid = vm::psv::read16(address) == entry.code.code1 && vm::psv::read16(address + 2) == entry.code.code0;
+		}
+	}
+
+	if (!valid)
+	{
+		entry = armv7_decode(m_ctx.ISET, address);
+	}
+
+	// The handler may execute guest code recursively (HACK), which can replace the entry
+	const armv7_decoded_t decoded = entry;
+
+	if (!decoded.func)
+	{
+		ARMv7_instrs::UNK(m_ctx, decoded.code);
+		return decoded.length;
+	}
+
+	decoded.func(m_ctx, decoded.code, decoded.type);
+	return decoded.length;
+}
+
+u32 ARMv7Decoder::DecodeMemory(const u32 address)
+{
+	const armv7_decoded_t decoded = armv7_decode(m_ctx.ISET, address);
+
+	if (decoded.func)
+	{
+		decoded.func(m_ctx, decoded.code, decoded.type);
+		return decoded.length;
+	}
+
+	ARMv7_instrs::UNK(m_ctx, decoded.code);
 	return 4;
 
 	// "group" decoding algorithm (temporarily disabled)
@@ -1,18 +1,41 @@
 #pragma once
 #include "Emu/CPU/CPUDecoder.h"
+#include "ARMv7Context.h"
+#include "ARMv7Interpreter.h"
 
-struct ARMv7Context;
+struct armv7_decoded_t
+{
+	void(*func)(ARMv7Context& context, const ARMv7Code code, const ARMv7_encoding type);
+	ARMv7Code code;
+	ARMv7_encoding type;
+	u8 length; // 0 if not decoded
+	u8 iset;
+};
+
+// Decode the instruction at address, func is null for unknown instructions
+armv7_decoded_t armv7_decode(ARMv7InstructionSet iset, const u32 address);
+
+struct armv7_decoder_page_t;
 
 class ARMv7Decoder : public CPUDecoder
 {
+protected:
 	ARMv7Context& m_ctx;
 
+private:
+	// Pre-decoded instructions of the pages executed by this thread (4 KB pages)
+	std::unordered_map<u32, std::unique_ptr<armv7_decoder_page_t>> m_pages;
+	armv7_decoder_page_t* m_last_page = nullptr;
+	u32 m_last_page_addr = ~0u;
+
 public:
-	ARMv7Decoder(ARMv7Context& context) : m_ctx(context)
-	{
-	}
+	ARMv7Decoder(ARMv7Context& context);
+	~ARMv7Decoder();
 
 	virtual u32 DecodeMemory(const u32 address);
+
+	// Execute the instruction at address using the pre-decoded cache, returns its length
+	u32 Execute(const u32 address);
 };
 
 void armv7_decoder_initialize(u32 addr, u32 end_addr, bool dump = false);
@@ -0,0 +1,211 @@
+#include "stdafx.h"
+#include "Emu/Memory/Memory.h"
+#include "ARMv7Thread.h"
+#include "ARMv7Recompiler.h"
+
+#define ASMJIT_STATIC
+#define ASMJIT_DEBUG
+
+#ifdef _MSC_VER
+#pragma comment(lib, "asmjit.lib")
+#endif
+
+#include "asmjit.h"
+
+// Instructions per block, the state of the thread is only checked between blocks
+const u32 g_armv7_max_block_size = 64;
+
+static bool armv7_ends_block(const armv7_decoded_t& op)
+{
+	// Branches, and HLE calls which can wait or run guest callbacks
+	return op.func == ARMv7_instrs::B
+		|| op.func == ARMv7_instrs::BL
+		|| op.func == ARMv7_instrs::BLX
+		|| op.func == ARMv7_instrs::BX
+		|| op.func == ARMv7_instrs::CB_Z
+		|| op.func == ARMv7_instrs::TB_
+		|| op.func == ARMv7_instrs::POP
+		|| op.func == ARMv7_instrs::LDM
+		|| op.func == ARMv7_instrs::SVC
+		|| op.func == ARMv7_instrs::HACK;
+}
+
+ARMv7Recompiler::ARMv7Recompiler(ARMv7Context& context)
+	: ARMv7Decoder(context)
+	, m_jit(std::make_shared<asmjit::JitRuntime>())
+{
+}
+
+ARMv7Recompiler::~ARMv7Recompiler()
+{
+	for (auto& block : m_blocks)
+	{
+		if (block.second)
+		{
+			m_jit->release(asmjit_cast<void*>(block.second->func));
+		}
+	}
+
+	for (auto& block : m_stale_blocks)
+	{
+		m_jit->release(asmjit_cast<void*>(block->func));
+	}
+}
+
+u32 ARMv7Recompiler::gate(ARMv7Recompiler* _this, const armv7_decoded_t* op, u32 pc) noexcept
+{
+	ARMv7Context& context = _this->m_ctx;
+
+	try
+	{
+		const ARMv7InstructionSet iset = context.ISET;
+
+		context.PC = pc;
+		op->func(context, op->code, op->type);
+
+		// Leave the block if the instruction has branched
+		const bool branch = context.PC != pc || context.ISET != iset;
+
+		context.PC += op->length;
+		return branch;
+	}
+	catch (...)
+	{
+		_this->m_pending_exception = std::current_exception();
+		return 1;
+	}
+}
+
+ARMv7Recompiler::block_t* ARMv7Recompiler::get_block(u32 addr, ARMv7InstructionSet iset)
+{
+	auto& block = m_blocks[addr | (iset == Thumb)];
+
+	if (block)
+	{
+		// Compiled code is discarded if the memory was modified
+		if (!std::memcmp(vm::psv::_ptr<u8>(addr), block->code.data(), block->code.size()))
+		{
+			return block.get();
+		}
+
+		m_stale_blocks.emplace_back(std::move(block));
+	}
+
+	block.reset(new block_t{ addr });
+
+	// Blocks don't cross pages, the next page may be unmapped
+	const u32 page_end = (addr & ~0xfff) + 0x1000;
+
+	for (u32 pos = addr; block->ops.size() < g_armv7_max_block_size;)
+	{
+		if (pos + (iset == Thumb ? 2 : 4) > page_end || !vm::check_addr(pos, iset == Thumb ? 2 : 4))
+		{
+			break;
+		}
+
+		if (iset == Thumb && pos + 4 > page_end && (vm::psv::read16(pos) & 0xf800) >= 0xe800)
+		{
+			// 32-bit Thumb instruction crossing the page
+			break;
+		}
+
+		const armv7_decoded_t op = armv7_decode(iset, pos);
+
+		if (!op.func)
+		{
+			break;
+		}
+
+		block->ops.push_back(op);
+		pos += op.length;
+
+		if (armv7_ends_block(op))
+		{
+			break;
+		}
+	}
+
+	if (block->ops.empty())
+	{
+		block.reset();
+		return nullptr;
+	}
+
+	u32 size = 0;
+
+	for (const auto& op : block->ops)
+	{
+		size += op.length;
+	}
+
+	block->code.assign(vm::psv::_ptr<u8>(addr), vm::psv::_ptr<u8>(addr) + size);
+
+	compile(*block);
+
+	return block.get();
+}
+
+void ARMv7Recompiler::compile(block_t& block)
+{
+	using namespace asmjit;
+
+	X86Compiler compiler(m_jit.get());
+
+	compiler.addFunc(kFuncConvHost, FuncBuilder1<u32, void*>());
+
+	X86GpVar this_var(compiler, kVarTypeIntPtr, "this");
+	compiler.setArg(0, this_var);
+
+	X86GpVar ret_var(compiler, kVarTypeUInt32, "ret");
+
+	Label end = compiler.newLabel();
+
+	u32 pc = block.addr;
+
+	for (const auto& op : block.ops)
+	{
+		X86CallNode* call = compiler.call(imm_ptr(asmjit_cast<void*, u32(ARMv7Recompiler*, const armv7_decoded_t*, u32)>(gate)), kFuncConvHost, FuncBuilder3<u32, void*, void*, u32>());
+		call->setArg(0, this_var);
+		call->setArg(1, imm_ptr((void*)&op));
+		call->setArg(2, imm_u(pc));
+		call->setRet(0, ret_var);
+
+		// return if the instruction has branched or thrown
+		compiler.test(ret_var, ret_var);
+		compiler.jnz(end);
+
+		pc += op.length;
+	}
+
+	compiler.bind(end);
+	compiler.unuse(this_var);
+	compiler.ret(ret_var);
+	compiler.endFunc();
+
+	block.func = asmjit_cast<block_func_t>(compiler.make());
+
+	if (!block.func)
+	{
+		throw EXCEPTION("Failed to compile ARMv7 block at 0x%x", block.addr);
+	}
+}
+
+void ARMv7Recompiler::ExecuteBlock()
+{
+	block_t* block = get_block(m_ctx.PC, m_ctx.ISET);
+
+	if (!block)
+	{
+		m_ctx.PC += Execute(m_ctx.PC);
+		return;
+	}
+
+	block->func(this);
+
+	if (m_pending_exception)
+	{
+		std::exception_ptr e = std::move(m_pending_exception);
+		m_pending_exception = nullptr;
+		std::rethrow_exception(e);
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "ARMv7Decoder.h"
+
+namespace asmjit
+{
+	struct JitRuntime;
+}
+
+// ARMv7 ASMJIT Recompiler (basic blocks are compiled to sequences of interpreter calls)
+class ARMv7Recompiler : public ARMv7Decoder
+{
+	using block_func_t = u32(*)(ARMv7Recompiler* _this);
+
+	struct block_t
+	{
+		u32 addr;
+		std::vector<u8> code; // memory the block was compiled from
+		std::vector<armv7_decoded_t> ops;
+		block_func_t func;
+	};
+
+	const std::shared_ptr<asmjit::JitRuntime> m_jit;
+
+	// Blocks by address, bit 0 is set for Thumb code
+	std::unordered_map<u32, std::unique_ptr<block_t>> m_blocks;
+
+	// Replaced blocks, kept until destruction because they may still be executing (HLE calls can run guest code)
+	std::vector<std::unique_ptr<block_t>> m_stale_blocks;
+
+	std::exception_ptr m_pending_exception;
+
+	block_t* get_block(u32 addr, ARMv7InstructionSet iset);
+
+	void compile(block_t& block);
+
+	static u32 gate(ARMv7Recompiler* _this, const armv7_decoded_t* op, u32 pc) noexcept;
+
+public:
+	ARMv7Recompiler(ARMv7Context& context);
+	~ARMv7Recompiler();
+
+	// Execute the block at PC (or a single instruction if it can't be compiled)
+	void ExecuteBlock();
+};
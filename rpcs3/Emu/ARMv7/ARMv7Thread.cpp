@@ -7,6 +7,7 @@
 
 #include "ARMv7Thread.h"
 #include "ARMv7Decoder.h"
+#include "ARMv7Recompiler.h"
 #include "ARMv7DisAsm.h"
 #include "ARMv7Interpreter.h"
 
@@ -186,6 +187,9 @@ void ARMv7Thread::do_run()
 	case 1:
 		m_dec.reset(new ARMv7Decoder(*this));
 		break;
+	case 2:
+		m_dec.reset(new ARMv7Recompiler(*this));
+		break;
 	default:
 		LOG_ERROR(ARMv7, "Invalid CPU decoder mode: %d", (int)rpcs3::state.config.core.ppu_decoder.value());
 		Emu.Pause();
@@ -201,10 +205,22 @@ void ARMv7Thread::cpu_task()
 		return custom_task(*this);
 	}
 
+	if (auto recompiler = dynamic_cast<ARMv7Recompiler*>(m_dec.get()))
+	{
+		while (!m_state || !check_status())
+		{
+			recompiler->ExecuteBlock();
+		}
+
+		return;
+	}
+
+	auto& decoder = static_cast<ARMv7Decoder&>(*m_dec);
+
 	while (!m_state || !check_status())
 	{
-		// decode instruction using specified decoder
-		PC += m_dec->DecodeMemory(PC);
+		// execute pre-decoded instruction
+		PC += decoder.Execute(PC);
 	}
 }
 
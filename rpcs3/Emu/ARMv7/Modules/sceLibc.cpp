@@ -229,18 +229,181 @@ namespace sce_libc_func
 		g_dso = dso;
 	}
 
-	void memcpy(vm::ptr<void> dst, vm::cptr<void> src, u32 size)
+	// Memory and string functions are called very often, they are implemented natively and only traced
+
+	vm::ptr<void> memcpy(vm::ptr<void> dst, vm::cptr<void> src, u32 size)
 	{
-		sceLibc.warning("memcpy(dst=*0x%x, src=*0x%x, size=0x%x)", dst, src, size);
+		sceLibc.trace("memcpy(dst=*0x%x, src=*0x%x, size=0x%x)", dst, src, size);
 
 		::memcpy(dst.get_ptr(), src.get_ptr(), size);
+		return dst;
+	}
+
+	vm::ptr<void> memmove(vm::ptr<void> dst, vm::cptr<void> src, u32 size)
+	{
+		sceLibc.trace("memmove(dst=*0x%x, src=*0x%x, size=0x%x)", dst, src, size);
+
+		::memmove(dst.get_ptr(), src.get_ptr(), size);
+		return dst;
 	}
 
-	void memset(vm::ptr<void> dst, s32 value, u32 size)
+	vm::ptr<void> memset(vm::ptr<void> dst, s32 value, u32 size)
 	{
-		sceLibc.warning("memset(dst=*0x%x, value=%d, size=0x%x)", dst, value, size);
+		sceLibc.trace("memset(dst=*0x%x, value=%d, size=0x%x)", dst, value, size);
 
 		::memset(dst.get_ptr(), value, size);
+		return dst;
+	}
+
+	s32 memcmp(vm::cptr<void> ptr1, vm::cptr<void> ptr2, u32 size)
+	{
+		sceLibc.trace("memcmp(ptr1=*0x%x, ptr2=*0x%x, size=0x%x)", ptr1, ptr2, size);
+
+		return ::memcmp(ptr1.get_ptr(), ptr2.get_ptr(), size);
+	}
+
+	vm::ptr<void> memchr(vm::cptr<void> ptr, s32 value, u32 size)
+	{
+		sceLibc.trace("memchr(ptr=*0x%x, value=%d, size=0x%x)", ptr, value, size);
+
+		const void* found = ::memchr(ptr.get_ptr(), value, size);
+
+		return{ found ? ptr.addr() + (u32)(static_cast<const u8*>(found) - static_cast<const u8*>(ptr.get_ptr())) : 0, vm::addr };
+	}
+
+	u32 strlen(vm::cptr<char> str)
+	{
+		sceLibc.trace("strlen(str=*0x%x)", str);
+
+		return (u32)::strlen(str.get_ptr());
+	}
+
+	s32 strcmp(vm::cptr<char> str1, vm::cptr<char> str2)
+	{
+		sceLibc.trace("strcmp(str1=*0x%x, str2=*0x%x)", str1, str2);
+
+		return ::strcmp(str1.get_ptr(), str2.get_ptr());
+	}
+
+	s32 strncmp(vm::cptr<char> str1, vm::cptr<char> str2, u32 size)
+	{
+		sceLibc.trace("strncmp(str1=*0x%x, str2=*0x%x, size=0x%x)", str1, str2, size);
+
+		return ::strncmp(str1.get_ptr(), str2.get_ptr(), size);
+	}
+
+	s32 strcasecmp(vm::cptr<char> str1, vm::cptr<char> str2)
+	{
+		sceLibc.trace("strcasecmp(str1=*0x%x, str2=*0x%x)", str1, str2);
+
+		for (u32 i = 0;; i++)
+		{
+			const s32 c1 = ::tolower((u8)str1.get_ptr()[i]);
+			const s32 c2 = ::tolower((u8)str2.get_ptr()[i]);
+
+			if (c1 != c2 || !c1)
+			{
+				return c1 - c2;
+			}
+		}
+	}
+
+	s32 strncasecmp(vm::cptr<char> str1, vm::cptr<char> str2, u32 size)
+	{
+		sceLibc.trace("strncasecmp(str1=*0x%x, str2=*0x%x, size=0x%x)", str1, str2, size);
+
+		for (u32 i = 0; i < size; i++)
+		{
+			const s32 c1 = ::tolower((u8)str1.get_ptr()[i]);
+			const s32 c2 = ::tolower((u8)str2.get_ptr()[i]);
+
+			if (c1 != c2 || !c1)
+			{
+				return c1 - c2;
+			}
+		}
+
+		return 0;
+	}
+
+	vm::ptr<char> strcpy(vm::ptr<char> dst, vm::cptr<char> src)
+	{
+		sceLibc.trace("strcpy(dst=*0x%x, src=*0x%x)", dst, src);
+
+		::memcpy(dst.get_ptr(), src.get_ptr(), ::strlen(src.get_ptr()) + 1);
+		return dst;
+	}
+
+	vm::ptr<char> strncpy(vm::ptr<char> dst, vm::cptr<char> src, u32 size)
+	{
+		sceLibc.trace("strncpy(dst=*0x%x, src=*0x%x, size=0x%x)", dst, src, size);
+
+		::strncpy(dst.get_ptr(), src.get_ptr(), size);
+		return dst;
+	}
+
+	vm::ptr<char> strcat(vm::ptr<char> dst, vm::cptr<char> src)
+	{
+		sceLibc.trace("strcat(dst=*0x%x, src=*0x%x)", dst, src);
+
+		::memcpy(dst.get_ptr() + ::strlen(dst.get_ptr()), src.get_ptr(), ::strlen(src.get_ptr()) + 1);
+		return dst;
+	}
+
+	vm::ptr<char> strncat(vm::ptr<char> dst, vm::cptr<char> src, u32 size)
+	{
+		sceLibc.trace("strncat(dst=*0x%x, src=*0x%x, size=0x%x)", dst, src, size);
+
+		::strncat(dst.get_ptr(), src.get_ptr(), size);
+		return dst;
+	}
+
+	// Guest pointer to the character found by a host string function in str
+	static vm::ptr<char> found_in(vm::cptr<char> str, const char* found)
+	{
+		return{ found ? str.addr() + (u32)(found - str.get_ptr()) : 0, vm::addr };
+	}
+
+	vm::ptr<char> strchr(vm::cptr<char> str, s32 ch)
+	{
+		sceLibc.trace("strchr(str=*0x%x, ch=%d)", str, ch);
+
+		return found_in(str, ::strchr(str.get_ptr(), ch));
+	}
+
+	vm::ptr<char> strrchr(vm::cptr<char> str, s32 ch)
+	{
+		sceLibc.trace("strrchr(str=*0x%x, ch=%d)", str, ch);
+
+		return found_in(str, ::strrchr(str.get_ptr(), ch));
+	}
+
+	vm::ptr<char> strstr(vm::cptr<char> str, vm::cptr<char> substr)
+	{
+		sceLibc.trace("strstr(str=*0x%x, substr=*0x%x)", str, substr);
+
+		return found_in(str, ::strstr(str.get_ptr(), substr.get_ptr()));
+	}
+
+	vm::ptr<char> strpbrk(vm::cptr<char> str, vm::cptr<char> chars)
+	{
+		sceLibc.trace("strpbrk(str=*0x%x, chars=*0x%x)", str, chars);
+
+		return found_in(str, ::strpbrk(str.get_ptr(), chars.get_ptr()));
+	}
+
+	u32 strspn(vm::cptr<char> str, vm::cptr<char> chars)
+	{
+		sceLibc.trace("strspn(str=*0x%x, chars=*0x%x)", str, chars);
+
+		return (u32)::strspn(str.get_ptr(), chars.get_ptr());
+	}
+
+	u32 strcspn(vm::cptr<char> str, vm::cptr<char> chars)
+	{
+		sceLibc.trace("strcspn(str=*0x%x, chars=*0x%x)", str, chars);
+
+		return (u32)::strcspn(str.get_ptr(), chars.get_ptr());
 	}
 
 	void _Assert(vm::cptr<char> text, vm::cptr<char> func)
@@ -402,32 +565,32 @@ psv_log_base sceLibc("SceLibc", []()
 	//REG_FUNC(0x57A729DB, malloc_stats);
 	//REG_FUNC(0xB3D29DE1, malloc_stats_fast);
 	//REG_FUNC(0x54A54EB1, malloc_usable_size);
-	//REG_FUNC(0x2F3E5B16, memchr);
-	//REG_FUNC(0x7747F6D7, memcmp);
+	REG_FUNC(0x2F3E5B16, memchr);
+	REG_FUNC(0x7747F6D7, memcmp);
 	REG_FUNC(0x7205BFDB, memcpy);
-	//REG_FUNC(0xAF5C218D, memmove);
+	REG_FUNC(0xAF5C218D, memmove);
 	REG_FUNC(0x6DC1F0D8, memset);
-	//REG_FUNC(0x1434FA46, strcat);
-	//REG_FUNC(0xB9336E16, strchr);
-	//REG_FUNC(0x1B58FA3B, strcmp);
+	REG_FUNC(0x1434FA46, strcat);
+	REG_FUNC(0xB9336E16, strchr);
+	REG_FUNC(0x1B58FA3B, strcmp);
 	//REG_FUNC(0x46AE2311, strcoll);
-	//REG_FUNC(0x85B924B7, strcpy);
-	//REG_FUNC(0x0E29D27A, strcspn);
+	REG_FUNC(0x85B924B7, strcpy);
+	REG_FUNC(0x0E29D27A, strcspn);
 	//REG_FUNC(0x1E9D6335, strerror);
-	//REG_FUNC(0x8AECC873, strlen);
-	//REG_FUNC(0xFBA69BC2, strncat);
-	//REG_FUNC(0xE4299DCB, strncmp);
-	//REG_FUNC(0x9F87712D, strncpy);
-	//REG_FUNC(0x68C307B6, strpbrk);
-	//REG_FUNC(0xCEFDD143, strrchr);
-	//REG_FUNC(0x4203B663, strspn);
-	//REG_FUNC(0x0D5200CB, strstr);
+	REG_FUNC(0x8AECC873, strlen);
+	REG_FUNC(0xFBA69BC2, strncat);
+	REG_FUNC(0xE4299DCB, strncmp);
+	REG_FUNC(0x9F87712D, strncpy);
+	REG_FUNC(0x68C307B6, strpbrk);
+	REG_FUNC(0xCEFDD143, strrchr);
+	REG_FUNC(0x4203B663, strspn);
+	REG_FUNC(0x0D5200CB, strstr);
 	//REG_FUNC(0x0289B8B3, strtok);
 	//REG_FUNC(0x4D023DE9, strxfrm);
 	//REG_FUNC(0xEB31926D, strtok_r);
 	//REG_FUNC(0xFF6F77C7, strdup);
-	//REG_FUNC(0x184C4B07, strcasecmp);
-	//REG_FUNC(0xAF1CA2F1, strncasecmp);
+	REG_FUNC(0x184C4B07, strcasecmp);
+	REG_FUNC(0xAF1CA2F1, strncasecmp);
 	//REG_FUNC(0xC94AE948, asctime);
 	//REG_FUNC(0xC082CA03, clock);
 	//REG_FUNC(0x1EA1CA8D, ctime);
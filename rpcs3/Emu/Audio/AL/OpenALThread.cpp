@@ -101,14 +101,19 @@ void OpenALThread::Open(const void* src, int size)
 
 	m_buffer_size = size;
 
-	for (uint i = 0; i<g_al_buffers_count; ++i)
+	// the backend-driven output fills the queue itself up to the target latency, otherwise all buffers are queued as a prebuffer
+	const uint count = rpcs3::config.audio.backend_driven.value() ? 1 : g_al_buffers_count;
+
+	for (uint i = 0; i < count; ++i)
 	{
 		alBufferData(m_buffers[i], rpcs3::config.audio.convert_to_u16.value() ? AL_FORMAT_71CHN16 : AL_FORMAT_71CHN32, src, m_buffer_size, 48000);
 		checkForAlError("alBufferData");
 	}
 
-	alSourceQueueBuffers(m_source, g_al_buffers_count, m_buffers);
+	alSourceQueueBuffers(m_source, count, m_buffers);
 	checkForAlError("alSourceQueueBuffers");
+
+	m_unqueued_count = g_al_buffers_count - count;
 	Play();
 }
 
@@ -123,7 +128,11 @@ void OpenALThread::AddData(const void* src, int size)
 
 	while (size)
 	{
-		if (buffers_count-- <= 0)
+		if (m_unqueued_count)
+		{
+			buffer = m_buffers[g_al_buffers_count - m_unqueued_count--];
+		}
+		else if (buffers_count-- <= 0)
 		{
 			Play();
 
@@ -132,9 +141,11 @@ void OpenALThread::AddData(const void* src, int size)
 
 			continue;
 		}
-
-		alSourceUnqueueBuffers(m_source, 1, &buffer);
-		checkForAlError("alSourceUnqueueBuffers");
+		else
+		{
+			alSourceUnqueueBuffers(m_source, 1, &buffer);
+			checkForAlError("alSourceUnqueueBuffers");
+		}
 
 		int bsize = size < m_buffer_size ? size : m_buffer_size;
 
@@ -149,4 +160,16 @@ void OpenALThread::AddData(const void* src, int size)
 	}
 
 	Play();
-}
\ No newline at end of file
+}
+
+s32 OpenALThread::GetQueuedSize()
+{
+	ALint queued, processed, offset;
+
+	alGetSourcei(m_source, AL_BUFFERS_QUEUED, &queued);
+	alGetSourcei(m_source, AL_BUFFERS_PROCESSED, &processed);
+	alGetSourcei(m_source, AL_BYTE_OFFSET, &offset);
+	checkForAlError("OpenALThread::GetQueuedSize -> alGetSourcei");
+
+	return std::max<s32>((queued - processed) * m_buffer_size - offset, 0);
+}
@@ -13,6 +13,7 @@ private:
 	ALCdevice* m_device;
 	ALCcontext* m_context;
 	ALsizei m_buffer_size;
+	uint m_unqueued_count = 0; // buffers never queued (at the end of m_buffers), used before processed buffers
 
 public:
 	virtual ~OpenALThread();
@@ -24,4 +25,5 @@ public:
 	virtual void Close();
 	virtual void Stop();
 	virtual void AddData(const void* src, int size);
+	virtual s32 GetQueuedSize() override;
 };
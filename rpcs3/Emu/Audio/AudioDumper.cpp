@@ -1,4 +1,5 @@
 #include "stdafx.h"
+#include "Utilities/Thread.h"
 #include "AudioDumper.h"
 
 AudioDumper::AudioDumper() : m_header(0), m_init(false)
@@ -16,6 +17,13 @@ bool AudioDumper::Init(u8 ch)
 	{
 		m_header = WAVHeader(ch);
 		WriteHeader();
+
+		m_buffer.reset(new u8[buffer_size]);
+		m_push_pos = 0;
+		m_write_pos = 0;
+		m_stop = false;
+
+		m_thread = thread_ctrl::spawn(PURE_EXPR("Audio Dumper"s), [this] { WriterThread(); });
 	}
 
 	return m_init;
@@ -29,6 +37,41 @@ void AudioDumper::WriteHeader()
 	}
 }
 
+void AudioDumper::WriterThread()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while (true)
+	{
+		if (m_write_pos == m_push_pos)
+		{
+			if (m_stop)
+			{
+				break;
+			}
+
+			m_cv.wait(lock);
+			continue;
+		}
+
+		// write the largest contiguous part of the ring without holding the lock
+		const u32 offset = m_write_pos % buffer_size;
+		const u32 size = static_cast<u32>(std::min<u64>(m_push_pos - m_write_pos, buffer_size - offset));
+
+		lock.unlock();
+
+		if (m_output.write(m_buffer.get() + offset, size) != size)
+		{
+			LOG_ERROR(GENERAL, "AudioDumper: failed to write %u bytes", size);
+		}
+
+		lock.lock();
+
+		m_write_pos += size;
+		m_cv.notify_all();
+	}
+}
+
 size_t AudioDumper::WriteData(const void* buffer, size_t size)
 {
 #ifdef SKIP_EMPTY_AUDIO
@@ -47,12 +90,32 @@ size_t AudioDumper::WriteData(const void* buffer, size_t size)
 	if (m_init)
 #endif
 	{
-		size_t ret = m_output.write(buffer, size);
-		m_header.Size += (u32)ret;
-		m_header.RIFF.Size += (u32)ret;
-		return ret;
+		if (size > buffer_size)
+		{
+			return 0;
+		}
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		// only blocks if the disk can't keep up with several seconds of audio
+		while (m_push_pos + size - m_write_pos > buffer_size)
+		{
+			m_cv.wait(lock);
+		}
+
+		const u32 offset = m_push_pos % buffer_size;
+		const u32 first = std::min<u32>(static_cast<u32>(size), buffer_size - offset);
+
+		std::memcpy(m_buffer.get() + offset, buffer, first);
+		std::memcpy(m_buffer.get(), static_cast<const u8*>(buffer) + first, size - first);
+
+		m_push_pos += size;
+		m_header.Size += (u32)size;
+		m_header.RIFF.Size += (u32)size;
+
+		m_cv.notify_all();
 	}
-	
+
 	return size;
 }
 
@@ -60,8 +123,20 @@ void AudioDumper::Finalize()
 {
 	if (m_init)
 	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			m_stop = true;
+			m_cv.notify_all();
+		}
+
+		m_thread->join();
+		m_thread.reset();
+
 		m_output.seek(0);
 		m_output.write(&m_header, sizeof(m_header)); // write fixed file header
 		m_output.close();
+
+		m_init = false;
 	}
-}
\ No newline at end of file
+}
@@ -51,12 +51,28 @@ struct WAVHeader
 };
 
 
+class thread_ctrl;
+
 class AudioDumper
 {
 	WAVHeader m_header;
 	fs::file m_output;
 	bool m_init;
-	
+
+	// Ring buffer filled by the audio thread and drained by the writer thread
+	static const u32 buffer_size = 8 * 1024 * 1024;
+
+	std::unique_ptr<u8[]> m_buffer;
+	u64 m_push_pos = 0; // total bytes queued
+	u64 m_write_pos = 0; // total bytes written to file
+	bool m_stop = false;
+
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	std::shared_ptr<thread_ctrl> m_thread;
+
+	void WriterThread();
+
 public:
 	AudioDumper();
 	~AudioDumper();
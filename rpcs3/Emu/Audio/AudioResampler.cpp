@@ -0,0 +1,47 @@
+#include "stdafx.h"
+#include "AudioResampler.h"
+
+void AudioResampler::UpdateRatio(u64 queued, u64 target)
+{
+	if (!target)
+	{
+		return;
+	}
+
+	// relative fill error in [-1, 1], smoothed to avoid audible pitch jumps between blocks
+	const double error = std::min(std::max((static_cast<double>(queued) - target) / target, -1.0), 1.0);
+
+	m_ratio += (1.0 + error * max_deviation - m_ratio) * 0.05;
+}
+
+u32 AudioResampler::Process(const float* src, u32 count, float* dst)
+{
+	if (!count)
+	{
+		return 0;
+	}
+
+	u32 result = 0;
+
+	// interpolate between input frames (index 0 is m_last, index i is src[i - 1])
+	for (; m_pos <= count; m_pos += m_ratio, result++)
+	{
+		const u32 index = static_cast<u32>(m_pos);
+		const __m128 t = _mm_set1_ps(static_cast<float>(m_pos - index));
+
+		const float* a = index ? src + (index - 1) * 8 : m_last;
+		const float* b = index < count ? src + index * 8 : a;
+
+		for (u32 i = 0; i < 8; i += 4)
+		{
+			const __m128 va = _mm_loadu_ps(a + i);
+			_mm_storeu_ps(dst + result * 8 + i, _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(b + i), va), t)));
+		}
+	}
+
+	m_pos -= count;
+
+	std::memcpy(m_last, src + (count - 1) * 8, sizeof(m_last));
+
+	return result;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+// Variable-rate resampler for 8-channel float frames, placed between the mixer and the audio backend.
+// The ratio follows the amount of audio queued in the backend: playback slows down slightly when the queue runs low
+// (emulation slower than real time) and speeds up when it grows, instead of underrunning or adding latency.
+class AudioResampler
+{
+	alignas(16) float m_last[8]{}; // last input frame of the previous block
+	double m_pos = 1.0; // position of the next output frame (in input frames, 0 = m_last)
+	double m_ratio = 1.0; // input frames consumed per output frame
+
+public:
+	static constexpr double max_deviation = 0.05; // at most 5% pitch change
+
+	// Maximal number of frames returned by Process() for `count` input frames
+	static constexpr u32 GetMaxOutput(u32 count)
+	{
+		return static_cast<u32>(count / (1.0 - max_deviation)) + 2;
+	}
+
+	// Adjust the ratio from the queued time and the target queued time (in any unit)
+	void UpdateRatio(u64 queued, u64 target);
+
+	double GetRatio() const
+	{
+		return m_ratio;
+	}
+
+	// Resample `count` frames from `src` to `dst` (which must have room for GetMaxOutput(count) frames), return the number of frames written
+	u32 Process(const float* src, u32 count, float* dst);
+};
@@ -12,4 +12,13 @@ public:
 	virtual void Close() = 0;
 	virtual void Stop() = 0;
 	virtual void AddData(const void* src, int size) = 0;
+
+	// Backend-driven output: amount of submitted data (in bytes) not played yet, or -1 if the backend can't report it
+	virtual s32 GetQueuedSize() { return -1; }
+
+	// Backend-driven output: wait until the backend finishes playing a buffer, at most `timeout` microseconds
+	virtual void WaitForBuffer(u64 timeout)
+	{
+		std::this_thread::sleep_for(std::chrono::microseconds(timeout));
+	}
 };
@@ -113,7 +113,7 @@ void XAudio2Thread::Open(const void* src, int size)
 	waveformatex.wBitsPerSample = sample_size * 8;
 	waveformatex.cbSize = 0;
 
-	hr = m_xaudio2_instance->CreateSourceVoice(&m_source_voice, &waveformatex, 0, XAUDIO2_DEFAULT_FREQ_RATIO);
+	hr = m_xaudio2_instance->CreateSourceVoice(&m_source_voice, &waveformatex, 0, XAUDIO2_DEFAULT_FREQ_RATIO, this);
 	if (FAILED(hr))
 	{
 		LOG_ERROR(GENERAL, "XAudio2Thread : CreateSourceVoice() failed(0x%08x)", (u32)hr);
@@ -129,6 +129,8 @@ void XAudio2Thread::AddData(const void* src, int size)
 {
 	XAUDIO2_BUFFER buffer;
 
+	m_buffer_size = size;
+
 	buffer.AudioBytes = size;
 	buffer.Flags = 0;
 	buffer.LoopBegin = XAUDIO2_NO_LOOP_REGION;
@@ -137,7 +139,7 @@ void XAudio2Thread::AddData(const void* src, int size)
 	buffer.pAudioData = (const BYTE*)src;
 	buffer.pContext = 0;
 	buffer.PlayBegin = 0;
-	buffer.PlayLength = 256;
+	buffer.PlayLength = 0; // whole buffer (its size varies with time stretching)
 
 	HRESULT hr = m_source_voice->SubmitSourceBuffer(&buffer);
 	if (FAILED(hr))
@@ -146,4 +148,37 @@ void XAudio2Thread::AddData(const void* src, int size)
 		Emu.Pause();
 	}
 }
+
+s32 XAudio2Thread::GetQueuedSize()
+{
+	if (!m_source_voice)
+	{
+		return 0;
+	}
+
+	XAUDIO2_VOICE_STATE state;
+	m_source_voice->GetState(&state);
+
+	return state.BuffersQueued * m_buffer_size;
+}
+
+void XAudio2Thread::WaitForBuffer(u64 timeout)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	const u64 played = m_buffers_played;
+
+	m_cv.wait_for(lock, std::chrono::microseconds(timeout), [&] { return m_buffers_played != played; });
+}
+
+void XAudio2Thread::OnBufferEnd(void* context)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		m_buffers_played++;
+	}
+
+	m_cv.notify_one();
+}
 #endif
@@ -9,12 +9,26 @@
 #include "minidx9/Include/XAudio2.h" // XAudio2 2.8 available only on Win8+, used XAudio2 2.7 from dxsdk
 #pragma pop_macro("_WIN32_WINNT")
 
-class XAudio2Thread : public AudioThread
+class XAudio2Thread : public AudioThread, private IXAudio2VoiceCallback
 {
 private:
 	IXAudio2* m_xaudio2_instance;
 	IXAudio2MasteringVoice* m_master_voice;
 	IXAudio2SourceVoice* m_source_voice;
+	int m_buffer_size = 0;
+
+	// signaled from the XAudio2 thread when a buffer is played
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	u64 m_buffers_played = 0;
+
+	void __stdcall OnBufferEnd(void* context) override;
+	void __stdcall OnVoiceProcessingPassStart(UINT32 bytes_required) override {}
+	void __stdcall OnVoiceProcessingPassEnd() override {}
+	void __stdcall OnStreamEnd() override {}
+	void __stdcall OnBufferStart(void* context) override {}
+	void __stdcall OnLoopEnd(void* context) override {}
+	void __stdcall OnVoiceError(void* context, HRESULT error) override {}
 
 public:
 	virtual ~XAudio2Thread();
@@ -27,5 +41,7 @@ public:
 	virtual void Close();
 	virtual void Stop();
 	virtual void AddData(const void* src, int size);
+	virtual s32 GetQueuedSize() override;
+	virtual void WaitForBuffer(u64 timeout) override;
 };
 #endif
@@ -0,0 +1,291 @@
+#include "stdafx.h"
+#include "Utilities/Log.h"
+#include "Utilities/File.h"
+#include "Emu/System.h"
+#include "Emu/state.h"
+#include "Emu/CPU/CPUThreadManager.h"
+#include "Emu/CPU/CPUThread.h"
+#include "Emu/RSX/GSManager.h"
+#include "Emu/RSX/GSRender.h"
+#include "Benchmark.h"
+
+#include <numeric>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+extern u64 get_system_time();
+
+namespace bench
+{
+	// Host CPU time of a thread at the first flip
+	struct thread_sample_t
+	{
+		const thread_ctrl* ctrl;
+		std::string name;
+		u64 cpu_time;
+	};
+
+	static std::mutex g_mutex;
+	static std::atomic<bool> g_enabled{ false };
+	static settings_t g_settings{};
+	static bool g_done = false; // report written
+
+	static u64 g_start = 0; // time of the first flip (0 = not flipped yet)
+	static u64 g_last = 0; // time of the last flip
+	static u64 g_process_start = 0; // process CPU time at the first flip
+	static std::vector<u64> g_intervals; // time between consecutive flips (us)
+	static std::vector<thread_sample_t> g_threads;
+
+	static u64 get_process_cpu_time()
+	{
+#ifdef _WIN32
+		FILETIME creation, exit, kernel, user;
+
+		if (GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+		{
+			// 100 ns units
+			const u64 k = u64{ kernel.dwHighDateTime } << 32 | kernel.dwLowDateTime;
+			const u64 u = u64{ user.dwHighDateTime } << 32 | user.dwLowDateTime;
+			return (k + u) / 10;
+		}
+#else
+		rusage usage;
+
+		if (getrusage(RUSAGE_SELF, &usage) == 0)
+		{
+			return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000ull + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+		}
+#endif
+
+		return 0;
+	}
+
+	// Get CPU time of the emulated threads and the RSX thread (fibers and threads not started yet are skipped)
+	static std::vector<thread_sample_t> sample_threads()
+	{
+		std::vector<thread_sample_t> result;
+
+		for (auto& t : CPUThreadManager::GetAllThreads())
+		{
+			if (const auto ctrl = t->get_thread_ctrl())
+			{
+				result.push_back({ ctrl, t->GetFName(), ctrl->get_cpu_time() });
+			}
+		}
+
+		auto& rsx = Emu.GetGSManager().GetRender();
+
+		if (const auto ctrl = rsx.get_thread_ctrl())
+		{
+			result.push_back({ ctrl, rsx.get_name(), ctrl->get_cpu_time() });
+		}
+
+		result.erase(std::remove_if(result.begin(), result.end(), [](const thread_sample_t& s) { return s.cpu_time == 0; }), result.end());
+
+		return result;
+	}
+
+	static std::string escape(const std::string& str)
+	{
+		std::string result;
+
+		for (const char c : str)
+		{
+			if (c == '"' || c == '\\')
+			{
+				result += '\\';
+				result += c;
+			}
+			else if (static_cast<u8>(c) < 0x20)
+			{
+				result += fmt::format("\\u%04x", static_cast<u8>(c));
+			}
+			else
+			{
+				result += c;
+			}
+		}
+
+		return result;
+	}
+
+	// Format frame time statistics: average, average of the slowest 1% and 0.1% of frames, percentiles, extremes
+	static std::string format_frame_times(std::vector<u64> times)
+	{
+		if (times.empty())
+		{
+			return "null";
+		}
+
+		std::sort(times.begin(), times.end());
+
+		const std::size_t count = times.size();
+
+		const auto worst_average = [&](std::size_t parts)
+		{
+			const std::size_t n = std::max<std::size_t>(count / parts, 1);
+			return std::accumulate(times.end() - n, times.end(), 0ull) / static_cast<double>(n);
+		};
+
+		const auto percentile = [&](std::size_t per_mille)
+		{
+			return times[std::min(count - 1, count * per_mille / 1000)];
+		};
+
+		return fmt::format("{\"average\":%.3f,\"low_1_percent\":%.3f,\"low_0_1_percent\":%.3f,\"percentile_99\":%llu,\"percentile_99_9\":%llu,\"min\":%llu,\"max\":%llu}",
+			std::accumulate(times.begin(), times.end(), 0ull) / static_cast<double>(count), worst_average(100), worst_average(1000),
+			percentile(990), percentile(999), times.front(), times.back());
+	}
+
+	// Write the report (called under the mutex)
+	static void write_report(bool completed)
+	{
+		g_done = true;
+
+		const u64 now = get_system_time();
+		const u64 frames = g_intervals.size();
+		const u64 duration = g_start ? g_last - g_start : 0;
+		const double wall = g_start ? static_cast<double>(now - g_start) : 0.;
+
+		std::string out = "{\n";
+		out += fmt::format("\"path\":\"%s\",\n\"title\":\"%s\",\n\"serial\":\"%s\",\n", escape(Emu.GetPath()), escape(Emu.GetTitle()), escape(Emu.GetTitleID()));
+		out += fmt::format("\"renderer\":\"%s\",\n\"completed\":%s,\n", rpcs3::state.config.rsx.renderer.string_value(), completed ? "true" : "false");
+		out += fmt::format("\"frames\":%llu,\n\"duration_us\":%llu,\n\"average_fps\":%.3f,\n", frames, duration, duration ? frames * 1000000. / duration : 0.);
+		out += fmt::format("\"frame_time_us\":%s,\n", format_frame_times(g_intervals));
+
+		out += "\"flip_intervals_us\":[";
+
+		for (std::size_t i = 0; i < g_intervals.size(); i++)
+		{
+			out += fmt::format(i ? ",%llu" : "%llu", g_intervals[i]);
+		}
+
+		out += "],\n\"threads\":[";
+
+		if (g_start)
+		{
+			bool first = true;
+
+			for (const auto& t : sample_threads())
+			{
+				// threads started during the run are measured from their start
+				u64 start = 0;
+
+				for (const auto& s : g_threads)
+				{
+					if (s.ctrl == t.ctrl && s.name == t.name)
+					{
+						start = s.cpu_time;
+					}
+				}
+
+				out += fmt::format("%s\n{\"name\":\"%s\",\"cpu_time_us\":%llu,\"utilisation\":%.4f}", first ? "" : ",", escape(t.name), t.cpu_time - start, wall ? (t.cpu_time - start) / wall : 0.);
+				first = false;
+			}
+		}
+
+		const u64 process_time = g_start ? get_process_cpu_time() - g_process_start : 0;
+
+		out += fmt::format("],\n\"process\":{\"cpu_time_us\":%llu,\"utilisation\":%.4f}\n}\n", process_time, wall ? process_time / wall : 0.);
+
+		fs::file file(g_settings.report, fom::rewrite);
+
+		if (!file)
+		{
+			LOG_ERROR(GENERAL, "Benchmark: failed to write the report to %s", g_settings.report);
+			return;
+		}
+
+		file.write(out);
+
+		LOG_SUCCESS(GENERAL, "Benchmark %s: %llu frames in %.3f s (%.2f fps), report saved to %s", completed ? "finished" : "interrupted",
+			frames, duration / 1000000., duration ? frames * 1000000. / duration : 0., g_settings.report);
+	}
+}
+
+void bench::enable(const settings_t& settings)
+{
+	std::lock_guard<std::mutex> lock(g_mutex);
+
+	g_settings = settings;
+	g_done = false;
+	g_start = 0;
+	g_last = 0;
+	g_intervals.clear();
+	g_threads.clear();
+	g_enabled = true;
+}
+
+bool bench::enabled()
+{
+	return g_enabled;
+}
+
+void bench::configure()
+{
+	if (g_enabled && g_settings.null_renderer)
+	{
+		rpcs3::state.config.rsx.renderer = rsx_renderer_type::Null;
+		rpcs3::state.config.rsx.null_benchmark = true;
+	}
+}
+
+void bench::on_flip()
+{
+	if (!g_enabled)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(g_mutex);
+
+	if (g_done)
+	{
+		return;
+	}
+
+	const u64 now = get_system_time();
+
+	if (!g_start)
+	{
+		// measurement starts at the first flip (boot and loading screens before it are ignored)
+		g_start = now;
+		g_last = now;
+		g_threads = sample_threads();
+		g_process_start = get_process_cpu_time();
+		g_intervals.reserve(g_settings.frames);
+		return;
+	}
+
+	g_intervals.push_back(now - g_last);
+	g_last = now;
+
+	if ((g_settings.frames && g_intervals.size() >= g_settings.frames) || (g_settings.seconds && now - g_start >= g_settings.seconds * 1000000ull))
+	{
+		write_report(true);
+
+		Emu.CallAfter([]()
+		{
+			Emu.Stop();
+		});
+	}
+}
+
+void bench::on_stop()
+{
+	if (!g_enabled)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(g_mutex);
+
+	if (!g_done)
+	{
+		write_report(false);
+	}
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+// Command line benchmark mode (--bench).
+// Frame times are measured from the first flip for a number of frames or seconds, then a JSON report is written
+// and the emulation is stopped (the application exits with it). Used by automated performance regression runs.
+namespace bench
+{
+	struct settings_t
+	{
+		u32 frames; // frames to measure after the first flip (0 = no limit)
+		u32 seconds; // time to measure after the first flip (0 = no limit)
+		bool null_renderer; // force the Null renderer in benchmark mode (no window, nothing submitted to the GPU)
+		std::string report; // JSON report path
+	};
+
+	// Enable the benchmark mode (before the emulation is loaded)
+	void enable(const settings_t& settings);
+
+	// Check whether the benchmark mode is enabled
+	bool enabled();
+
+	// Apply benchmark overrides to the configuration of the game (called after it is loaded)
+	void configure();
+
+	// Called by the RSX thread on each flip, ends the benchmark when its length is reached
+	void on_flip();
+
+	// Called when the emulation stops (before threads are stopped): write the report if it wasn't written yet
+	void on_stop();
+}
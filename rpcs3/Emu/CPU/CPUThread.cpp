@@ -5,13 +5,18 @@
 
 #include "CPUDecoder.h"
 #include "CPUThread.h"
+#include "HostThreadPolicy.h"
 
 thread_local CPUThread* g_tls_current_cpu_thread = nullptr;
 
+static const fiber_tls_t s_fiber_tls_cpu_thread([]() -> void* { return &g_tls_current_cpu_thread; }, sizeof(g_tls_current_cpu_thread));
+
 void CPUThread::on_task()
 {
 	g_tls_current_cpu_thread = this;
 
+	host_thread_policy::apply_cpu_thread(*this);
+
 	Emu.SendDbgCommand(DID_CREATE_THREAD, this);
 
 	std::unique_lock<std::mutex> lock(mutex);
@@ -244,7 +249,7 @@ bool CPUThread::signal()
 	}
 	else
 	{
-		// not truly responsible for signal delivery, requires additional measures like LV2_LOCK
+		// not truly responsible for signal delivery, the caller must hold the lock the thread is waiting with
 		cv.notify_one();
 
 		return true;
@@ -257,8 +262,20 @@ bool CPUThread::unsignal()
 	return (m_state._and_not(CPU_STATE_SIGNAL) & CPU_STATE_SIGNAL) != 0;
 }
 
+void CPUThread::on_fiber_preempt()
+{
+	m_state |= CPU_STATE_YIELD;
+}
+
 bool CPUThread::check_status()
 {
+	if (m_state & CPU_STATE_YIELD && fiber::get_current())
+	{
+		// let other fibers run (no host mutex is locked here)
+		m_state &= ~CPU_STATE_YIELD;
+		fiber::yield();
+	}
+
 	std::unique_lock<std::mutex> lock(mutex, std::defer_lock);
 
 	while (true)
@@ -21,8 +21,9 @@ enum : u64
 	CPU_STATE_RETURN  = (1ull << 5), // used for callback return
 	CPU_STATE_SIGNAL  = (1ull << 6), // used for HLE signaling
 	CPU_STATE_INTR    = (1ull << 7), // thread interrupted
+	CPU_STATE_YIELD   = (1ull << 8), // the thread should give its slot to a waiting thread (SPU scheduler) or its worker to other fibers
 
-	CPU_STATE_MAX     = (1ull << 8), // added to (subtracted from) m_state by sleep()/awake() calls to trigger status check
+	CPU_STATE_MAX     = (1ull << 9), // added to (subtracted from) m_state by sleep()/awake() calls to trigger status check
 };
 
 class CPUThreadReturn {}; // "HLE return" exception event
@@ -35,6 +36,7 @@ class CPUThread : public named_thread_t
 {
 	void on_task() override;
 	void on_id_aux_finalize() override { exit(); } // call exit() instead of join()
+	void on_fiber_preempt() override;
 
 protected:
 	atomic_t<u64> m_state{ CPU_STATE_STOPPED }; // thread state flags
@@ -106,6 +108,9 @@ public:
 
 	virtual bool handle_interrupt() { return false; }
 
+	// thread priority used by priority-ordered sleep queues (lower value means higher priority)
+	virtual s32 get_prio() const { return 0; }
+
 	std::string GetFName() const
 	{
 		return fmt::format("%s[0x%x] Thread (%s)", GetTypeString(), m_id, m_name);
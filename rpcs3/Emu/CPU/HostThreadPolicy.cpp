@@ -0,0 +1,140 @@
+#include "stdafx.h"
+#include "Emu/state.h"
+#include "Emu/IdManager.h"
+
+#include "Emu/Cell/PPUThread.h"
+#include "CPUThread.h"
+#include "HostThreadPolicy.h"
+
+namespace host_thread_policy
+{
+	// Physical cores of pinned threads: the main PPU thread, the RSX thread, then SPU threads on the remaining cores
+	enum : u32
+	{
+		main_ppu_core,
+		rsx_core,
+		first_spu_core,
+	};
+
+	std::atomic<bool> g_main_ppu_pinned{ false };
+	std::atomic<u32> g_spu_count{ 0 };
+
+	static bool pinning_enabled()
+	{
+		return rpcs3::state.config.core.thread_affinity.value() && thread_ctrl::get_physical_cores().size() > first_spu_core;
+	}
+
+	// Only the first logical processor of the core is used, SMT siblings are left to other threads
+	static u64 core_processor(u32 core)
+	{
+		const u64 mask = thread_ctrl::get_physical_cores()[core];
+		return mask & (0 - mask);
+	}
+
+	// Processors available to threads which are not pinned
+	static u64 other_processors()
+	{
+		u64 all = 0, pinned = 0;
+
+		for (u32 i = 0; i < thread_ctrl::get_physical_cores().size(); i++)
+		{
+			all |= thread_ctrl::get_physical_cores()[i];
+			pinned |= core_processor(i);
+		}
+
+		// Without SMT all processors are shared
+		return all & ~pinned ? all & ~pinned : 0;
+	}
+
+	// Guest priorities are 0 (highest) .. 3071 (lowest), usual game threads use 1000 .. 3071
+	static int map_priority(s32 prio)
+	{
+		return prio < 1000 ? 1 : prio < 2048 ? 0 : -1;
+	}
+
+	static void set_ppu_priority(const thread_ctrl* thread, const CPUThread& ppu)
+	{
+		if (thread && rpcs3::state.config.core.thread_priorities.value())
+		{
+			thread->set_native_priority(map_priority(static_cast<const PPUThread&>(ppu).prio));
+		}
+	}
+
+	void reset()
+	{
+		g_main_ppu_pinned = false;
+		g_spu_count = 0;
+	}
+
+	void apply_cpu_thread(const CPUThread& cpu)
+	{
+		const auto thread = thread_ctrl::get_current();
+
+		if (!thread)
+		{
+			return;
+		}
+
+		switch (cpu.get_type())
+		{
+		case CPU_THREAD_PPU:
+		{
+			set_ppu_priority(thread, cpu);
+
+			if (pinning_enabled())
+			{
+				// The main thread is created first (by the loader), so it has the lowest PPU thread ID
+				const auto ids = idm::get_set<PPUThread>();
+
+				if (!ids.empty() && *ids.begin() == cpu.get_id() && !g_main_ppu_pinned.exchange(true))
+				{
+					LOG_NOTICE(GENERAL, "Host thread policy: %s pinned to core %u", cpu.get_name(), +main_ppu_core);
+					thread->set_native_affinity(core_processor(main_ppu_core));
+				}
+				else
+				{
+					thread->set_native_affinity(other_processors());
+				}
+			}
+
+			break;
+		}
+
+		case CPU_THREAD_SPU:
+		case CPU_THREAD_RAW_SPU:
+		{
+			if (pinning_enabled())
+			{
+				const u32 spu_cores = size32(thread_ctrl::get_physical_cores()) - first_spu_core;
+				const u32 core = first_spu_core + g_spu_count++ % spu_cores;
+
+				LOG_NOTICE(GENERAL, "Host thread policy: %s pinned to core %u", cpu.get_name(), core);
+				thread->set_native_affinity(core_processor(core));
+			}
+
+			break;
+		}
+
+		default:
+		{
+			break;
+		}
+		}
+	}
+
+	void apply_rsx_thread()
+	{
+		if (const auto thread = thread_ctrl::get_current())
+		{
+			if (pinning_enabled())
+			{
+				thread->set_native_affinity(core_processor(rsx_core));
+			}
+		}
+	}
+
+	void update_ppu_priority(const CPUThread& ppu)
+	{
+		set_ppu_priority(ppu.get_thread_ctrl(), ppu);
+	}
+}
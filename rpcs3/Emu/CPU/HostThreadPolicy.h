@@ -0,0 +1,17 @@
+#pragma once
+
+class CPUThread;
+
+// Host scheduling of emulator threads ("Map PPU thread priorities" and "Pin threads to cores" options)
+namespace host_thread_policy
+{
+	// Reset core assignment before the emulation is loaded
+	void reset();
+
+	// Apply the policy to the current thread (called at the thread start)
+	void apply_cpu_thread(const CPUThread& cpu);
+	void apply_rsx_thread();
+
+	// Update host priority after the guest priority of the PPU thread was changed
+	void update_ppu_priority(const CPUThread& ppu);
+}
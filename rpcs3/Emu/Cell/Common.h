@@ -15,9 +15,35 @@ struct ppu_decoder_cache_t
 {
 	ppu_inter_func_t* const pointer;
 
+	// Opcodes the functions were decoded from, a function is stale when the opcode in memory differs
+	u32* const opcodes;
+
 	ppu_decoder_cache_t();
 
 	~ppu_decoder_cache_t();
 
 	void initialize(u32 addr, u32 size);
+
+	// Initialize the page containing addr if it was never initialized (pages are decoded on their first execution)
+	void initialize_page(u32 addr);
+
+	// Decode again the instruction at addr after it was modified
+	ppu_inter_func_t update(u32 addr, u32 opcode);
+
+	// Get the function of the instruction at addr (the page must be initialized)
+	ppu_inter_func_t get(u32 addr, u32 opcode)
+	{
+		return opcodes[addr / 4] == opcode ? pointer[addr / 4] : update(addr, opcode);
+	}
+
+private:
+	std::mutex m_mutex;
+
+	std::array<atomic_t<u8>, 0x100000000ull / 4096> m_pages{}; // initialized pages
 };
+
+// Invalidate PPU code compiled from the page (the page is modified or unmapped)
+void ppu_invalidate_code(u32 addr);
+
+// Process a write to a page watched by compiled PPU code (vm::page_code_watch), returns false if the page isn't watched
+bool ppu_on_code_write(u32 addr);
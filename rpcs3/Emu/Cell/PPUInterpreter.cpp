@@ -2,6 +2,7 @@
 #include "Emu/Memory/Memory.h"
 #include "Emu/System.h"
 #include "Emu/Cell/PPUThread.h"
+#include "Emu/Cell/RawSPUThread.h"
 #include "Emu/SysCalls/SysCalls.h"
 #include "Emu/SysCalls/Modules.h"
 #include "Emu/Cell/PPUDecoder.h"
@@ -9,6 +10,10 @@
 #include "PPUInterpreter.h"
 #include "PPUInterpreter2.h"
 
+#ifndef _MSC_VER
+#include <cpuid.h>
+#endif
+
 class ppu_scale_table_t
 {
 	std::array<__m128, 32 + 31> m_data;
@@ -29,6 +34,16 @@ public:
 }
 const g_ppu_scale_table;
 
+// Signed saturated addition of 32-bit elements
+static force_inline __m128i adds_epi32(__m128i a, __m128i b)
+{
+	const auto s = _mm_add_epi32(a, b);
+	const auto m = _mm_and_si128(_mm_xor_si128(a, s), _mm_xor_si128(b, s)); // overflow bit
+	const auto x = _mm_srai_epi32(m, 31); // saturation mask
+	const auto y = _mm_srai_epi32(_mm_and_si128(s, m), 31); // positive saturation mask
+	return _mm_xor_si128(_mm_xor_si128(_mm_srli_epi32(x, 1), y), _mm_or_si128(s, x));
+}
+
 
 void ppu_interpreter::NULL_OP(PPUThread& CPU, ppu_opcode_t op)
 {
@@ -105,13 +120,7 @@ void ppu_interpreter::VADDSHS(PPUThread& CPU, ppu_opcode_t op)
 
 void ppu_interpreter::VADDSWS(PPUThread& CPU, ppu_opcode_t op)
 {
-	const auto a = CPU.VPR[op.va];
-	const auto b = CPU.VPR[op.vb];
-	const auto s = v128::add32(a, b); // a + b
-	const auto m = (a ^ s) & (b ^ s); // overflow bit
-	const auto x = _mm_srai_epi32(m.vi, 31); // saturation mask
-	const auto y = _mm_srai_epi32(_mm_and_si128(s.vi, m.vi), 31); // positive saturation mask
-	CPU.VPR[op.vd].vi = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi32(x, 1), y), _mm_or_si128(s.vi, x));
+	CPU.VPR[op.vd].vi = adds_epi32(CPU.VPR[op.va].vi, CPU.VPR[op.vb].vi);
 }
 
 void ppu_interpreter::VADDUBM(PPUThread& CPU, ppu_opcode_t op)
@@ -1460,9 +1469,19 @@ void ppu_interpreter::BC(PPUThread& CPU, ppu_opcode_t op)
 	if (ctr_ok && cond_ok)
 	{
 		const u32 nextLR = CPU.PC + 4;
-		CPU.PC = PPUOpcodes::branchTarget((op.aa ? 0 : CPU.PC), op.simm16) - 4;
+		const u32 target = PPUOpcodes::branchTarget((op.aa ? 0 : CPU.PC), op.simm16);
+
+		// guest spin loops are closed by backward conditional branches
+		if (target <= CPU.PC && !op.lk && bo2 && !bo0) CPU.spin_wait(CPU.PC, target);
+
+		CPU.PC = target - 4;
 		if (op.lk) CPU.LR = nextLR;
 	}
+	else if (CPU.spin_branch == CPU.PC)
+	{
+		// the loop was left
+		CPU.spin_count = 0;
+	}
 }
 
 void ppu_interpreter::HACK(PPUThread& CPU, ppu_opcode_t op)
@@ -1792,7 +1811,7 @@ void ppu_interpreter::LDX(PPUThread& CPU, ppu_opcode_t op)
 void ppu_interpreter::LWZX(PPUThread& CPU, ppu_opcode_t op)
 {
 	const u64 addr = op.ra ? CPU.GPR[op.ra] + CPU.GPR[op.rb] : CPU.GPR[op.rb];
-	CPU.GPR[op.rd] = vm::read32(VM_CAST(addr));
+	CPU.GPR[op.rd] = IsRawSPUMMIO(VM_CAST(addr)) ? raw_spu_read_reg(VM_CAST(addr)) : vm::read32(VM_CAST(addr)).value();
 }
 
 void ppu_interpreter::SLW(PPUThread& CPU, ppu_opcode_t op)
@@ -1897,7 +1916,7 @@ void ppu_interpreter::DCBST(PPUThread& CPU, ppu_opcode_t op)
 void ppu_interpreter::LWZUX(PPUThread& CPU, ppu_opcode_t op)
 {
 	const u64 addr = CPU.GPR[op.ra] + CPU.GPR[op.rb];
-	CPU.GPR[op.rd] = vm::read32(VM_CAST(addr));
+	CPU.GPR[op.rd] = IsRawSPUMMIO(VM_CAST(addr)) ? raw_spu_read_reg(VM_CAST(addr)) : vm::read32(VM_CAST(addr)).value();
 	CPU.GPR[op.ra] = addr;
 }
 
@@ -2085,6 +2104,11 @@ void ppu_interpreter::STWCX_(PPUThread& CPU, ppu_opcode_t op)
 void ppu_interpreter::STWX(PPUThread& CPU, ppu_opcode_t op)
 {
 	const u64 addr = op.ra ? CPU.GPR[op.ra] + CPU.GPR[op.rb] : CPU.GPR[op.rb];
+	if (IsRawSPUMMIO(VM_CAST(addr)))
+	{
+		return raw_spu_write_reg(VM_CAST(addr), (u32)CPU.GPR[op.rs]);
+	}
+
 	vm::write32(VM_CAST(addr), (u32)CPU.GPR[op.rs]);
 }
 
@@ -2105,6 +2129,11 @@ void ppu_interpreter::STDUX(PPUThread& CPU, ppu_opcode_t op)
 void ppu_interpreter::STWUX(PPUThread& CPU, ppu_opcode_t op)
 {
 	const u64 addr = CPU.GPR[op.ra] + CPU.GPR[op.rb];
+	if (IsRawSPUMMIO(VM_CAST(addr)))
+	{
+		return raw_spu_write_reg(VM_CAST(addr), (u32)CPU.GPR[op.rs]);
+	}
+
 	vm::write32(VM_CAST(addr), (u32)CPU.GPR[op.rs]);
 	CPU.GPR[op.ra] = addr;
 }
@@ -2857,13 +2886,13 @@ void ppu_interpreter::DCBZ(PPUThread& CPU, ppu_opcode_t op)
 void ppu_interpreter::LWZ(PPUThread& CPU, ppu_opcode_t op)
 {
 	const u64 addr = op.ra ? CPU.GPR[op.ra] + op.simm16 : op.simm16;
-	CPU.GPR[op.rd] = vm::read32(VM_CAST(addr));
+	CPU.GPR[op.rd] = IsRawSPUMMIO(VM_CAST(addr)) ? raw_spu_read_reg(VM_CAST(addr)) : vm::read32(VM_CAST(addr)).value();
 }
 
 void ppu_interpreter::LWZU(PPUThread& CPU, ppu_opcode_t op)
 {
 	const u64 addr = CPU.GPR[op.ra] + op.simm16;
-	CPU.GPR[op.rd] = vm::read32(VM_CAST(addr));
+	CPU.GPR[op.rd] = IsRawSPUMMIO(VM_CAST(addr)) ? raw_spu_read_reg(VM_CAST(addr)) : vm::read32(VM_CAST(addr)).value();
 	CPU.GPR[op.ra] = addr;
 }
 
@@ -2883,12 +2912,22 @@ void ppu_interpreter::LBZU(PPUThread& CPU, ppu_opcode_t op)
 void ppu_interpreter::STW(PPUThread& CPU, ppu_opcode_t op)
 {
 	const u64 addr = op.ra ? CPU.GPR[op.ra] + op.simm16 : op.simm16;
+	if (IsRawSPUMMIO(VM_CAST(addr)))
+	{
+		return raw_spu_write_reg(VM_CAST(addr), (u32)CPU.GPR[op.rs]);
+	}
+
 	vm::write32(VM_CAST(addr), (u32)CPU.GPR[op.rs]);
 }
 
 void ppu_interpreter::STWU(PPUThread& CPU, ppu_opcode_t op)
 {
 	const u64 addr = CPU.GPR[op.ra] + op.simm16;
+	if (IsRawSPUMMIO(VM_CAST(addr)))
+	{
+		return raw_spu_write_reg(VM_CAST(addr), (u32)CPU.GPR[op.rs]);
+	}
+
 	vm::write32(VM_CAST(addr), (u32)CPU.GPR[op.rs]);
 	CPU.GPR[op.ra] = addr;
 }
@@ -3324,3 +3363,137 @@ void ppu_interpreter::UNK(PPUThread& CPU, ppu_opcode_t op)
 {
 	throw EXCEPTION("");
 }
+
+#ifdef _MSC_VER
+#define SSE41_FUNC
+#else
+#define SSE41_FUNC __attribute__((target("sse4.1")))
+#endif
+
+static bool sse41_supported()
+{
+#ifdef _MSC_VER
+	int regs[4];
+	__cpuid(regs, 1);
+	return (regs[2] & (1 << 19)) != 0;
+#else
+	u32 eax, ebx, ecx, edx;
+	return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & (1 << 19)) != 0;
+#endif
+}
+
+SSE41_FUNC void ppu_interpreter_sse41::VMSUMUHS(PPUThread& CPU, ppu_opcode_t op)
+{
+	const auto a = CPU.VPR[op.va].vi;
+	const auto b = CPU.VPR[op.vb].vi;
+	const auto c = CPU.VPR[op.vc].vi;
+	const auto ml = _mm_mullo_epi16(a, b);
+	const auto mh = _mm_mulhi_epu16(a, b);
+	const auto pe = _mm_or_si128(_mm_srli_epi32(ml, 16), _mm_and_si128(mh, _mm_set1_epi32(0xffff0000))); // even products
+	const auto po = _mm_or_si128(_mm_slli_epi32(mh, 16), _mm_and_si128(ml, _mm_set1_epi32(0x0000ffff))); // odd products
+	const auto s1 = _mm_add_epi32(pe, po);
+	const auto s2 = _mm_add_epi32(s1, c);
+	const auto nc1 = _mm_cmpeq_epi32(_mm_max_epu32(s1, pe), s1); // no carry in pe + po
+	const auto nc2 = _mm_cmpeq_epi32(_mm_max_epu32(s2, s1), s2); // no carry in s1 + c
+	CPU.VPR[op.vd].vi = _mm_or_si128(s2, _mm_xor_si128(_mm_and_si128(nc1, nc2), _mm_set1_epi32(-1)));
+}
+
+SSE41_FUNC void ppu_interpreter_sse41::VPKSWUS(PPUThread& CPU, ppu_opcode_t op)
+{
+	CPU.VPR[op.vd].vi = _mm_packus_epi32(CPU.VPR[op.vb].vi, CPU.VPR[op.va].vi);
+}
+
+SSE41_FUNC void ppu_interpreter_sse41::VPKUHUM(PPUThread& CPU, ppu_opcode_t op)
+{
+	const auto mask = _mm_set1_epi16(0x00ff);
+	CPU.VPR[op.vd].vi = _mm_packus_epi16(_mm_and_si128(CPU.VPR[op.vb].vi, mask), _mm_and_si128(CPU.VPR[op.va].vi, mask));
+}
+
+SSE41_FUNC void ppu_interpreter_sse41::VPKUHUS(PPUThread& CPU, ppu_opcode_t op)
+{
+	const auto max = _mm_set1_epi16(0x00ff);
+	CPU.VPR[op.vd].vi = _mm_packus_epi16(_mm_min_epu16(CPU.VPR[op.vb].vi, max), _mm_min_epu16(CPU.VPR[op.va].vi, max));
+}
+
+SSE41_FUNC void ppu_interpreter_sse41::VPKUWUM(PPUThread& CPU, ppu_opcode_t op)
+{
+	const auto mask = _mm_set1_epi32(0x0000ffff);
+	CPU.VPR[op.vd].vi = _mm_packus_epi32(_mm_and_si128(CPU.VPR[op.vb].vi, mask), _mm_and_si128(CPU.VPR[op.va].vi, mask));
+}
+
+SSE41_FUNC void ppu_interpreter_sse41::VPKUWUS(PPUThread& CPU, ppu_opcode_t op)
+{
+	const auto max = _mm_set1_epi32(0x0000ffff);
+	CPU.VPR[op.vd].vi = _mm_packus_epi32(_mm_min_epu32(CPU.VPR[op.vb].vi, max), _mm_min_epu32(CPU.VPR[op.va].vi, max));
+}
+
+SSE41_FUNC void ppu_interpreter_sse41::VSUM4SBS(PPUThread& CPU, ppu_opcode_t op)
+{
+	const auto s = _mm_madd_epi16(_mm_maddubs_epi16(_mm_set1_epi8(1), CPU.VPR[op.va].vi), _mm_set1_epi16(1)); // sums of signed bytes
+	CPU.VPR[op.vd].vi = adds_epi32(s, CPU.VPR[op.vb].vi);
+}
+
+SSE41_FUNC void ppu_interpreter_sse41::VSUM4SHS(PPUThread& CPU, ppu_opcode_t op)
+{
+	const auto s = _mm_madd_epi16(CPU.VPR[op.va].vi, _mm_set1_epi16(1)); // sums of signed halfwords
+	CPU.VPR[op.vd].vi = adds_epi32(s, CPU.VPR[op.vb].vi);
+}
+
+SSE41_FUNC void ppu_interpreter_sse41::VSUM4UBS(PPUThread& CPU, ppu_opcode_t op)
+{
+	const auto b = CPU.VPR[op.vb].vi;
+	const auto s = _mm_add_epi32(_mm_madd_epi16(_mm_maddubs_epi16(CPU.VPR[op.va].vi, _mm_set1_epi8(1)), _mm_set1_epi16(1)), b);
+	const auto nc = _mm_cmpeq_epi32(_mm_max_epu32(s, b), s); // no carry
+	CPU.VPR[op.vd].vi = _mm_or_si128(s, _mm_xor_si128(nc, _mm_set1_epi32(-1)));
+}
+
+SSE41_FUNC void ppu_interpreter_sse41::VUPKHSB(PPUThread& CPU, ppu_opcode_t op)
+{
+	const auto b = CPU.VPR[op.vb].vi;
+	CPU.VPR[op.vd].vi = _mm_cvtepi8_epi16(_mm_unpackhi_epi64(b, b));
+}
+
+SSE41_FUNC void ppu_interpreter_sse41::VUPKHSH(PPUThread& CPU, ppu_opcode_t op)
+{
+	const auto b = CPU.VPR[op.vb].vi;
+	CPU.VPR[op.vd].vi = _mm_cvtepi16_epi32(_mm_unpackhi_epi64(b, b));
+}
+
+SSE41_FUNC void ppu_interpreter_sse41::VUPKLSB(PPUThread& CPU, ppu_opcode_t op)
+{
+	CPU.VPR[op.vd].vi = _mm_cvtepi8_epi16(CPU.VPR[op.vb].vi);
+}
+
+SSE41_FUNC void ppu_interpreter_sse41::VUPKLSH(PPUThread& CPU, ppu_opcode_t op)
+{
+	CPU.VPR[op.vd].vi = _mm_cvtepi16_epi32(CPU.VPR[op.vb].vi);
+}
+
+#undef SSE41_FUNC
+
+ppu_vmx_table_t::ppu_vmx_table_t()
+{
+	const bool sse41 = sse41_supported();
+
+#define VMX_FUNC(name) name = sse41 ? ppu_interpreter_sse41::name : ppu_interpreter::name
+
+	VMX_FUNC(VMSUMUHS);
+	VMX_FUNC(VPKSWUS);
+	VMX_FUNC(VPKUHUM);
+	VMX_FUNC(VPKUHUS);
+	VMX_FUNC(VPKUWUM);
+	VMX_FUNC(VPKUWUS);
+	VMX_FUNC(VSUM4SBS);
+	VMX_FUNC(VSUM4SHS);
+	VMX_FUNC(VSUM4UBS);
+	VMX_FUNC(VUPKHSB);
+	VMX_FUNC(VUPKHSH);
+	VMX_FUNC(VUPKLSB);
+	VMX_FUNC(VUPKLSH);
+
+#undef VMX_FUNC
+
+	LOG_NOTICE(PPU, "PPU interpreter: %s vector instructions", sse41 ? "SSE4.1" : "SSE2/SSSE3");
+}
+
+const ppu_vmx_table_t g_ppu_vmx;
@@ -2,6 +2,7 @@
 
 #include "Emu/Cell/PPUOpcodes.h"
 #include "Emu/Memory/Memory.h"
+#include "Emu/Cell/RawSPUThread.h"
 
 #if defined(_MSC_VER)
 #include <intrin.h>
@@ -2289,9 +2290,19 @@ private:
 		if (CheckCondition(bo, bi))
 		{
 			const u32 nextLR = CPU.PC + 4;
-			CPU.PC = branchTarget((aa ? 0 : CPU.PC), bd) - 4;
+			const u32 target = branchTarget((aa ? 0 : CPU.PC), bd);
+
+			// guest spin loops are closed by backward conditional branches
+			if (target <= CPU.PC && !lk && (bo & 0x14) == 0x04) CPU.spin_wait(CPU.PC, target);
+
+			CPU.PC = target - 4;
 			if(lk) CPU.LR = nextLR;
 		}
+		else if (CPU.spin_branch == CPU.PC)
+		{
+			// the loop was left
+			CPU.spin_count = 0;
+		}
 	}
 	void HACK(u32 index) override
 	{
@@ -2673,7 +2684,7 @@ private:
 	void LWZX(u32 rd, u32 ra, u32 rb) override
 	{
 		const u64 addr = ra ? CPU.GPR[ra] + CPU.GPR[rb] : CPU.GPR[rb];
-		CPU.GPR[rd] = vm::ps3::read32(VM_CAST(addr));
+		CPU.GPR[rd] = IsRawSPUMMIO(VM_CAST(addr)) ? raw_spu_read_reg(VM_CAST(addr)) : vm::ps3::read32(VM_CAST(addr)).value();
 	}
 	void SLW(u32 ra, u32 rs, u32 rb, u32 rc) override
 	{
@@ -2785,7 +2796,7 @@ private:
 	void LWZUX(u32 rd, u32 ra, u32 rb) override
 	{
 		const u64 addr = CPU.GPR[ra] + CPU.GPR[rb];
-		CPU.GPR[rd] = vm::ps3::read32(VM_CAST(addr));
+		CPU.GPR[rd] = IsRawSPUMMIO(VM_CAST(addr)) ? raw_spu_read_reg(VM_CAST(addr)) : vm::ps3::read32(VM_CAST(addr)).value();
 		CPU.GPR[ra] = addr;
 	}
 	void CNTLZD(u32 ra, u32 rs, u32 rc) override
@@ -2970,7 +2981,14 @@ private:
 	void STWX(u32 rs, u32 ra, u32 rb) override
 	{
 		const u64 addr = ra ? CPU.GPR[ra] + CPU.GPR[rb] : CPU.GPR[rb];
-		vm::ps3::write32(VM_CAST(addr), (u32)CPU.GPR[rs]);
+		if (IsRawSPUMMIO(VM_CAST(addr)))
+		{
+			raw_spu_write_reg(VM_CAST(addr), (u32)CPU.GPR[rs]);
+		}
+		else
+		{
+			vm::ps3::write32(VM_CAST(addr), (u32)CPU.GPR[rs]);
+		}
 	}
 	void STVEHX(u32 vs, u32 ra, u32 rb) override
 	{
@@ -2987,7 +3005,14 @@ private:
 	void STWUX(u32 rs, u32 ra, u32 rb) override
 	{
 		const u64 addr = CPU.GPR[ra] + CPU.GPR[rb];
-		vm::ps3::write32(VM_CAST(addr), (u32)CPU.GPR[rs]);
+		if (IsRawSPUMMIO(VM_CAST(addr)))
+		{
+			raw_spu_write_reg(VM_CAST(addr), (u32)CPU.GPR[rs]);
+		}
+		else
+		{
+			vm::ps3::write32(VM_CAST(addr), (u32)CPU.GPR[rs]);
+		}
 		CPU.GPR[ra] = addr;
 	}
 	void STVEWX(u32 vs, u32 ra, u32 rb) override
@@ -3705,7 +3730,7 @@ private:
 	static void LWZ_impl(PPUThread *CPU, u32 rd, u32 ra, s32 d)
 	{
 		const u64 addr = ra ? CPU->GPR[ra] + d : d;
-		CPU->GPR[rd] = vm::ps3::read32(VM_CAST(addr));
+		CPU->GPR[rd] = IsRawSPUMMIO(VM_CAST(addr)) ? raw_spu_read_reg(VM_CAST(addr)) : vm::ps3::read32(VM_CAST(addr)).value();
 	}
 	void LWZ(u32 rd, u32 ra, s32 d) override
 	{
@@ -3715,7 +3740,7 @@ private:
 	void LWZU(u32 rd, u32 ra, s32 d) override
 	{
 		const u64 addr = CPU.GPR[ra] + d;
-		CPU.GPR[rd] = vm::ps3::read32(VM_CAST(addr));
+		CPU.GPR[rd] = IsRawSPUMMIO(VM_CAST(addr)) ? raw_spu_read_reg(VM_CAST(addr)) : vm::ps3::read32(VM_CAST(addr)).value();
 		CPU.GPR[ra] = addr;
 	}
 
@@ -3739,7 +3764,14 @@ private:
 	static void STW_impl(PPUThread *CPU, u32 rs, u32 ra, s32 d)
 	{
 		const u64 addr = ra ? CPU->GPR[ra] + d : d;
-		vm::ps3::write32(VM_CAST(addr), (u32)CPU->GPR[rs]);
+		if (IsRawSPUMMIO(VM_CAST(addr)))
+		{
+			raw_spu_write_reg(VM_CAST(addr), (u32)CPU->GPR[rs]);
+		}
+		else
+		{
+			vm::ps3::write32(VM_CAST(addr), (u32)CPU->GPR[rs]);
+		}
 	}
 	void STW(u32 rs, u32 ra, s32 d) override
 	{
@@ -3749,7 +3781,14 @@ private:
 	void STWU(u32 rs, u32 ra, s32 d) override
 	{
 		const u64 addr = CPU.GPR[ra] + d;
-		vm::ps3::write32(VM_CAST(addr), (u32)CPU.GPR[rs]);
+		if (IsRawSPUMMIO(VM_CAST(addr)))
+		{
+			raw_spu_write_reg(VM_CAST(addr), (u32)CPU.GPR[rs]);
+		}
+		else
+		{
+			vm::ps3::write32(VM_CAST(addr), (u32)CPU.GPR[rs]);
+		}
 		CPU.GPR[ra] = addr;
 	}
 	void STB(u32 rs, u32 ra, s32 d) override
@@ -459,6 +459,46 @@ namespace ppu_interpreter
 	void UNK(PPUThread& CPU, ppu_opcode_t op);
 }
 
+// SSE4.1 implementations of vector instructions which use scalar loops in ppu_interpreter (reference implementations)
+namespace ppu_interpreter_sse41
+{
+	void VMSUMUHS(PPUThread& CPU, ppu_opcode_t op);
+	void VPKSWUS(PPUThread& CPU, ppu_opcode_t op);
+	void VPKUHUM(PPUThread& CPU, ppu_opcode_t op);
+	void VPKUHUS(PPUThread& CPU, ppu_opcode_t op);
+	void VPKUWUM(PPUThread& CPU, ppu_opcode_t op);
+	void VPKUWUS(PPUThread& CPU, ppu_opcode_t op);
+	void VSUM4SBS(PPUThread& CPU, ppu_opcode_t op);
+	void VSUM4SHS(PPUThread& CPU, ppu_opcode_t op);
+	void VSUM4UBS(PPUThread& CPU, ppu_opcode_t op);
+	void VUPKHSB(PPUThread& CPU, ppu_opcode_t op);
+	void VUPKHSH(PPUThread& CPU, ppu_opcode_t op);
+	void VUPKLSB(PPUThread& CPU, ppu_opcode_t op);
+	void VUPKLSH(PPUThread& CPU, ppu_opcode_t op);
+}
+
+// Functions of the vector instructions with host-specific implementations, selected once for the host CPU (CPUID)
+struct ppu_vmx_table_t
+{
+	ppu_inter_func_t VMSUMUHS;
+	ppu_inter_func_t VPKSWUS;
+	ppu_inter_func_t VPKUHUM;
+	ppu_inter_func_t VPKUHUS;
+	ppu_inter_func_t VPKUWUM;
+	ppu_inter_func_t VPKUWUS;
+	ppu_inter_func_t VSUM4SBS;
+	ppu_inter_func_t VSUM4SHS;
+	ppu_inter_func_t VSUM4UBS;
+	ppu_inter_func_t VUPKHSB;
+	ppu_inter_func_t VUPKHSH;
+	ppu_inter_func_t VUPKLSB;
+	ppu_inter_func_t VUPKLSH;
+
+	ppu_vmx_table_t();
+};
+
+extern const ppu_vmx_table_t g_ppu_vmx;
+
 class PPUInterpreter2 : public PPUOpcodes
 {
 public:
@@ -554,7 +594,7 @@ public:
 	virtual void VMSUMSHS(u32 vd, u32 va, u32 vb, u32 vc) { func = ppu_interpreter::VMSUMSHS; }
 	virtual void VMSUMUBM(u32 vd, u32 va, u32 vb, u32 vc) { func = ppu_interpreter::VMSUMUBM; }
 	virtual void VMSUMUHM(u32 vd, u32 va, u32 vb, u32 vc) { func = ppu_interpreter::VMSUMUHM; }
-	virtual void VMSUMUHS(u32 vd, u32 va, u32 vb, u32 vc) { func = ppu_interpreter::VMSUMUHS; }
+	virtual void VMSUMUHS(u32 vd, u32 va, u32 vb, u32 vc) { func = g_ppu_vmx.VMSUMUHS; }
 	virtual void VMULESB(u32 vd, u32 va, u32 vb) { func = ppu_interpreter::VMULESB; }
 	virtual void VMULESH(u32 vd, u32 va, u32 vb) { func = ppu_interpreter::VMULESH; }
 	virtual void VMULEUB(u32 vd, u32 va, u32 vb) { func = ppu_interpreter::VMULEUB; }
@@ -571,11 +611,11 @@ public:
 	virtual void VPKSHSS(u32 vd, u32 va, u32 vb) { func = ppu_interpreter::VPKSHSS; }
 	virtual void VPKSHUS(u32 vd, u32 va, u32 vb) { func = ppu_interpreter::VPKSHUS; }
 	virtual void VPKSWSS(u32 vd, u32 va, u32 vb) { func = ppu_interpreter::VPKSWSS; }
-	virtual void VPKSWUS(u32 vd, u32 va, u32 vb) { func = ppu_interpreter::VPKSWUS; }
-	virtual void VPKUHUM(u32 vd, u32 va, u32 vb) { func = ppu_interpreter::VPKUHUM; }
-	virtual void VPKUHUS(u32 vd, u32 va, u32 vb) { func = ppu_interpreter::VPKUHUS; }
-	virtual void VPKUWUM(u32 vd, u32 va, u32 vb) { func = ppu_interpreter::VPKUWUM; }
-	virtual void VPKUWUS(u32 vd, u32 va, u32 vb) { func = ppu_interpreter::VPKUWUS; }
+	virtual void VPKSWUS(u32 vd, u32 va, u32 vb) { func = g_ppu_vmx.VPKSWUS; }
+	virtual void VPKUHUM(u32 vd, u32 va, u32 vb) { func = g_ppu_vmx.VPKUHUM; }
+	virtual void VPKUHUS(u32 vd, u32 va, u32 vb) { func = g_ppu_vmx.VPKUHUS; }
+	virtual void VPKUWUM(u32 vd, u32 va, u32 vb) { func = g_ppu_vmx.VPKUWUM; }
+	virtual void VPKUWUS(u32 vd, u32 va, u32 vb) { func = g_ppu_vmx.VPKUWUS; }
 	virtual void VREFP(u32 vd, u32 vb) { func = ppu_interpreter::VREFP; }
 	virtual void VRFIM(u32 vd, u32 vb) { func = ppu_interpreter::VRFIM; }
 	virtual void VRFIN(u32 vd, u32 vb) { func = ppu_interpreter::VRFIN; }
@@ -619,15 +659,15 @@ public:
 	virtual void VSUBUWS(u32 vd, u32 va, u32 vb) { func = ppu_interpreter::VSUBUWS; }
 	virtual void VSUMSWS(u32 vd, u32 va, u32 vb) { func = ppu_interpreter::VSUMSWS; }
 	virtual void VSUM2SWS(u32 vd, u32 va, u32 vb) { func = ppu_interpreter::VSUM2SWS; }
-	virtual void VSUM4SBS(u32 vd, u32 va, u32 vb) { func = ppu_interpreter::VSUM4SBS; }
-	virtual void VSUM4SHS(u32 vd, u32 va, u32 vb) { func = ppu_interpreter::VSUM4SHS; }
-	virtual void VSUM4UBS(u32 vd, u32 va, u32 vb) { func = ppu_interpreter::VSUM4UBS; }
+	virtual void VSUM4SBS(u32 vd, u32 va, u32 vb) { func = g_ppu_vmx.VSUM4SBS; }
+	virtual void VSUM4SHS(u32 vd, u32 va, u32 vb) { func = g_ppu_vmx.VSUM4SHS; }
+	virtual void VSUM4UBS(u32 vd, u32 va, u32 vb) { func = g_ppu_vmx.VSUM4UBS; }
 	virtual void VUPKHPX(u32 vd, u32 vb) { func = ppu_interpreter::VUPKHPX; }
-	virtual void VUPKHSB(u32 vd, u32 vb) { func = ppu_interpreter::VUPKHSB; }
-	virtual void VUPKHSH(u32 vd, u32 vb) { func = ppu_interpreter::VUPKHSH; }
+	virtual void VUPKHSB(u32 vd, u32 vb) { func = g_ppu_vmx.VUPKHSB; }
+	virtual void VUPKHSH(u32 vd, u32 vb) { func = g_ppu_vmx.VUPKHSH; }
 	virtual void VUPKLPX(u32 vd, u32 vb) { func = ppu_interpreter::VUPKLPX; }
-	virtual void VUPKLSB(u32 vd, u32 vb) { func = ppu_interpreter::VUPKLSB; }
-	virtual void VUPKLSH(u32 vd, u32 vb) { func = ppu_interpreter::VUPKLSH; }
+	virtual void VUPKLSB(u32 vd, u32 vb) { func = g_ppu_vmx.VUPKLSB; }
+	virtual void VUPKLSH(u32 vd, u32 vb) { func = g_ppu_vmx.VUPKLSH; }
 	virtual void VXOR(u32 vd, u32 va, u32 vb) { func = ppu_interpreter::VXOR; }
 	virtual void MULLI(u32 rd, u32 ra, s32 simm16) { func = ppu_interpreter::MULLI; }
 	virtual void SUBFIC(u32 rd, u32 ra, s32 simm16) { func = ppu_interpreter::SUBFIC; }
@@ -1,678 +1,1821 @@
-#include "stdafx.h"
-#ifdef LLVM_AVAILABLE
-#include "Emu/System.h"
-#include "Emu/state.h"
-#include "Emu/Cell/PPUDisAsm.h"
-#include "Emu/Cell/PPULLVMRecompiler.h"
-#include "Emu/Memory/Memory.h"
-#include "Utilities/VirtualMemory.h"
-#ifdef _MSC_VER
-#pragma warning(push, 0)
-#endif
-#include "llvm/Support/TargetSelect.h"
-#include "llvm/Support/Host.h"
-#include "llvm/Support/ManagedStatic.h"
-#include "llvm/ExecutionEngine/GenericValue.h"
-#include "llvm/ExecutionEngine/MCJIT.h"
-#include "llvm/IR/Intrinsics.h"
-#include "llvm/Support/FileSystem.h"
-#include "llvm/Analysis/Passes.h"
-#include "llvm/Analysis/TargetTransformInfo.h"
-#include "llvm/Analysis/MemoryDependenceAnalysis.h"
-#include "llvm/Analysis/LoopInfo.h"
-#include "llvm/Analysis/ScalarEvolution.h"
-#include "llvm/IR/Dominators.h"
-#include "llvm/Transforms/Scalar.h"
-#include "llvm/Transforms/Vectorize.h"
-#include "llvm/MC/MCDisassembler.h"
-#include "llvm/IR/Verifier.h"
-#ifdef _MSC_VER
-#pragma warning(pop)
-#endif
-
-using namespace llvm;
-using namespace ppu_recompiler_llvm;
-
-#ifdef ID_MANAGER_INCLUDED
-#error "ID Manager cannot be used in this module"
-#endif
-
-// PS3 can address 32 bits aligned on 4 bytes boundaries : 2^30 pointers
-#define VIRTUAL_INSTRUCTION_COUNT 0x40000000
-#define PAGE_SIZE 4096
-
-u64  Compiler::s_rotate_mask[64][64];
-bool Compiler::s_rotate_mask_inited = false;
-
-std::unique_ptr<Module> Compiler::create_module(LLVMContext &llvm_context)
-{
-	const std::vector<Type *> arg_types = { Type::getInt8PtrTy(llvm_context), Type::getInt64Ty(llvm_context) };
-	FunctionType *compiled_function_type = FunctionType::get(Type::getInt32Ty(llvm_context), arg_types, false);
-
-	std::unique_ptr<llvm::Module> result(new llvm::Module("Module", llvm_context));
-	Function *execute_unknown_function = (Function *)result->getOrInsertFunction("execute_unknown_function", compiled_function_type);
-	execute_unknown_function->setCallingConv(CallingConv::X86_64_Win64);
-
-	Function *execute_unknown_block = (Function *)result->getOrInsertFunction("execute_unknown_block", compiled_function_type);
-	execute_unknown_block->setCallingConv(CallingConv::X86_64_Win64);
-
-	std::string targetTriple = "x86_64-pc-windows-elf";
-	result->setTargetTriple(targetTriple);
-
-	return result;
-}
-
-void Compiler::optimise_module(llvm::Module *module)
-{
-	llvm::FunctionPassManager fpm(module);
-	fpm.add(createNoAAPass());
-	fpm.add(createBasicAliasAnalysisPass());
-	fpm.add(createNoTargetTransformInfoPass());
-	fpm.add(createEarlyCSEPass());
-	fpm.add(createTailCallEliminationPass());
-	fpm.add(createReassociatePass());
-	fpm.add(createInstructionCombiningPass());
-	fpm.add(new DominatorTreeWrapperPass());
-	fpm.add(new MemoryDependenceAnalysis());
-	fpm.add(createGVNPass());
-	fpm.add(createInstructionCombiningPass());
-	fpm.add(new MemoryDependenceAnalysis());
-	fpm.add(createDeadStoreEliminationPass());
-	fpm.add(new LoopInfo());
-	fpm.add(new ScalarEvolution());
-	fpm.add(createSLPVectorizerPass());
-	fpm.add(createInstructionCombiningPass());
-	fpm.add(createCFGSimplificationPass());
-	fpm.doInitialization();
-
-	for (auto I = module->begin(), E = module->end(); I != E; ++I)
-		fpm.run(*I);
-}
-
-
-Compiler::Compiler(LLVMContext *context, llvm::IRBuilder<> *builder, std::unordered_map<std::string, void*> &function_ptrs)
-	: m_llvm_context(context),
-	m_ir_builder(builder),
-	m_executable_map(function_ptrs) {
-
-	std::vector<Type *> arg_types;
-	arg_types.push_back(m_ir_builder->getInt8PtrTy());
-	arg_types.push_back(m_ir_builder->getInt64Ty());
-	m_compiled_function_type = FunctionType::get(m_ir_builder->getInt32Ty(), arg_types, false);
-
-	if (!s_rotate_mask_inited) {
-		InitRotateMask();
-		s_rotate_mask_inited = true;
-	}
-}
-
-Compiler::~Compiler() {
-}
-
-void Compiler::initiate_function(const std::string &name)
-{
-	m_state.function = (Function *)m_module->getOrInsertFunction(name, m_compiled_function_type);
-	m_state.function->setCallingConv(CallingConv::X86_64_Win64);
-	auto arg_i = m_state.function->arg_begin();
-	arg_i->setName("ppu_state");
-	m_state.args[CompileTaskState::Args::State] = arg_i;
-	(++arg_i)->setName("context");
-	m_state.args[CompileTaskState::Args::Context] = arg_i;
-}
-
-void ppu_recompiler_llvm::Compiler::translate_to_llvm_ir(llvm::Module *module, const std::string & name, u32 start_address, u32 instruction_count)
-{
-	m_module = module;
-
-	m_execute_unknown_function = module->getFunction("execute_unknown_function");
-	m_execute_unknown_block = module->getFunction("execute_unknown_block");
-
-	initiate_function(name);
-
-	// Create the entry block and add code to branch to the first instruction
-	m_ir_builder->SetInsertPoint(GetBasicBlockFromAddress(0));
-	m_ir_builder->CreateBr(GetBasicBlockFromAddress(start_address));
-
-	// Convert each instruction in the CFG to LLVM IR
-	std::vector<PHINode *> exit_instr_list;
-	for (u32 instructionAddress = start_address; instructionAddress < start_address + instruction_count * 4; instructionAddress += 4) {
-		m_state.hit_branch_instruction = false;
-		m_state.current_instruction_address = instructionAddress;
-		BasicBlock *instr_bb = GetBasicBlockFromAddress(instructionAddress);
-		m_ir_builder->SetInsertPoint(instr_bb);
-
-		u32 instr = vm::ps3::read32(instructionAddress);
-
-		Decode(instr);
-		if (!m_state.hit_branch_instruction)
-			m_ir_builder->CreateBr(GetBasicBlockFromAddress(instructionAddress + 4));
-	}
-
-	// Generate exit logic for all empty blocks
-	const std::string &default_exit_block_name = GetBasicBlockNameFromAddress(0xFFFFFFFF);
-	for (BasicBlock &block_i : *m_state.function) {
-		if (!block_i.getInstList().empty() || block_i.getName() == default_exit_block_name)
-			continue;
-
-		// Found an empty block
-		m_state.current_instruction_address = GetAddressFromBasicBlockName(block_i.getName());
-
-		m_ir_builder->SetInsertPoint(&block_i);
-		PHINode *exit_instr_i32 = m_ir_builder->CreatePHI(m_ir_builder->getInt32Ty(), 0);
-		exit_instr_list.push_back(exit_instr_i32);
-
-		SetPc(m_ir_builder->getInt32(m_state.current_instruction_address));
-
-		m_ir_builder->CreateRet(m_ir_builder->getInt32(ExecutionStatus::ExecutionStatusBlockEnded));
-	}
-
-	// If the function has a default exit block then generate code for it
-	BasicBlock *default_exit_bb = GetBasicBlockFromAddress(0xFFFFFFFF, "", false);
-	if (default_exit_bb) {
-		m_ir_builder->SetInsertPoint(default_exit_bb);
-		PHINode *exit_instr_i32 = m_ir_builder->CreatePHI(m_ir_builder->getInt32Ty(), 0);
-		exit_instr_list.push_back(exit_instr_i32);
-
-		m_ir_builder->CreateRet(m_ir_builder->getInt32(0));
-	}
-
-	// Add incoming values for all exit instr PHI nodes
-	for (PHINode *exit_instr_i : exit_instr_list) {
-		BasicBlock *block = exit_instr_i->getParent();
-		for (pred_iterator pred_i = pred_begin(block); pred_i != pred_end(block); pred_i++) {
-			u32 pred_address = GetAddressFromBasicBlockName((*pred_i)->getName());
-			exit_instr_i->addIncoming(m_ir_builder->getInt32(pred_address), *pred_i);
-		}
-	}
-
-	std::string        verify;
-	raw_string_ostream verify_ostream(verify);
-	if (verifyFunction(*m_state.function, &verify_ostream)) {
-//		m_recompilation_engine.trace() << "Verification failed: " << verify_ostream.str() << "\n";
-	}
-
-	m_module = nullptr;
-	m_state.function = nullptr;
-}
-
-void Compiler::Decode(const u32 code) {
-	(*PPU_instr::main_list)(this, code);
-}
-
-std::mutex                           RecompilationEngine::s_mutex;
-std::shared_ptr<RecompilationEngine> RecompilationEngine::s_the_instance = nullptr;
-
-RecompilationEngine::RecompilationEngine()
-	: m_log(nullptr)
-	, m_currentId(0)
-	, m_last_cache_clear_time(std::chrono::high_resolution_clock::now())
-	, m_llvm_context(getGlobalContext())
-	, m_ir_builder(getGlobalContext()) {
-	InitializeNativeTarget();
-	InitializeNativeTargetAsmPrinter();
-	InitializeNativeTargetDisassembler();
-
-	FunctionCache = (ExecutableStorageType *)memory_helper::reserve_memory(VIRTUAL_INSTRUCTION_COUNT * sizeof(ExecutableStorageType));
-	// Each char can store 8 page status
-	FunctionCachePagesCommited = (char *)malloc(VIRTUAL_INSTRUCTION_COUNT / (8 * PAGE_SIZE));
-	memset(FunctionCachePagesCommited, 0, VIRTUAL_INSTRUCTION_COUNT / (8 * PAGE_SIZE));
-}
-
-RecompilationEngine::~RecompilationEngine() {
-	m_executable_storage.clear();
-	memory_helper::free_reserved_memory(FunctionCache, VIRTUAL_INSTRUCTION_COUNT * sizeof(ExecutableStorageType));
-	free(FunctionCachePagesCommited);
-}
-
-bool RecompilationEngine::isAddressCommited(u32 address) const
-{
-	size_t offset = address * sizeof(ExecutableStorageType);
-	size_t page = offset / 4096;
-	// Since bool is stored in char, the char index is page / 8 (or page >> 3)
-	// and we shr the value with the remaining bits (page & 7)
-	return (FunctionCachePagesCommited[page >> 3] >> (page & 7)) & 1;
-}
-
-void RecompilationEngine::commitAddress(u32 address)
-{
-	size_t offset = address * sizeof(ExecutableStorageType);
-	size_t page = offset / 4096;
-	memory_helper::commit_page_memory((u8*)FunctionCache + page * 4096, 4096);
-	// Reverse of isAddressCommited : we set the (page & 7)th bit of (page / 8) th char
-	// in the array
-	FunctionCachePagesCommited[page >> 3] |= (1 << (page & 7));
-}
-
-const Executable RecompilationEngine::GetCompiledExecutableIfAvailable(u32 address) const
-{
-	if (!isAddressCommited(address / 4))
-		return nullptr;
-	u32 id = FunctionCache[address / 4].second;
-	if (rpcs3::state.config.core.llvm.exclusion_range.value() &&
-		(id >= rpcs3::state.config.core.llvm.min_id.value() && id <= rpcs3::state.config.core.llvm.max_id.value()))
-		return nullptr;
-	return FunctionCache[address / 4].first;
-}
-
-void RecompilationEngine::NotifyBlockStart(u32 address) {
-	{
-		std::lock_guard<std::mutex> lock(m_pending_address_start_lock);
-		if (m_pending_address_start.size() > 10000)
-			m_pending_address_start.clear();
-		m_pending_address_start.push_back(address);
-	}
-
-	if (!is_started()) {
-		start();
-	}
-
-	cv.notify_one();
-	// TODO: Increase the priority of the recompilation engine thread
-}
-
-raw_fd_ostream & RecompilationEngine::Log() {
-	if (!m_log) {
-		std::error_code error;
-		m_log = new raw_fd_ostream("PPULLVMRecompiler.log", error, sys::fs::F_Text);
-		m_log->SetUnbuffered();
-	}
-
-	return *m_log;
-}
-
-void RecompilationEngine::on_task() {
-	std::chrono::nanoseconds idling_time(0);
-	std::chrono::nanoseconds recompiling_time(0);
-
-	auto start = std::chrono::high_resolution_clock::now();
-	while (!Emu.IsStopped()) {
-		bool             work_done_this_iteration = false;
-		std::list <u32> m_current_execution_traces;
-
-		{
-			std::lock_guard<std::mutex> lock(m_pending_address_start_lock);
-			m_current_execution_traces.swap(m_pending_address_start);
-		}
-
-		if (!m_current_execution_traces.empty()) {
-			for (u32 address : m_current_execution_traces)
-				work_done_this_iteration |= IncreaseHitCounterAndBuild(address);
-		}
-
-		if (!work_done_this_iteration) {
-			// Wait a few ms for something to happen
-			auto idling_start = std::chrono::high_resolution_clock::now();
-			std::unique_lock<std::mutex> lock(mutex);
-			cv.wait_for(lock, std::chrono::milliseconds(10));
-			auto idling_end = std::chrono::high_resolution_clock::now();
-			idling_time += std::chrono::duration_cast<std::chrono::nanoseconds>(idling_end - idling_start);
-		}
-	}
-
-	s_the_instance = nullptr; // Can cause deadlock if this is the last instance. Need to fix this.
-}
-
-bool RecompilationEngine::IncreaseHitCounterAndBuild(u32 address) {
-	auto It = m_block_table.find(address);
-	if (It == m_block_table.end())
-		It = m_block_table.emplace(address, BlockEntry(address)).first;
-	BlockEntry &block = It->second;
-	if (!block.is_compiled) {
-		block.num_hits++;
-		if (block.num_hits >= rpcs3::state.config.core.llvm.threshold.value()) {
-			CompileBlock(block);
-			return true;
-		}
-	}
-	return false;
-}
-
-extern void execute_ppu_func_by_index(PPUThread& ppu, u32 id);
-extern void execute_syscall_by_index(PPUThread& ppu, u64 code);
-
-static u32
-wrappedExecutePPUFuncByIndex(PPUThread &CPU, u32 index) noexcept {
-	try
-	{
-		execute_ppu_func_by_index(CPU, index);
-		return ExecutionStatus::ExecutionStatusBlockEnded;
-	}
-	catch (...)
-	{
-		CPU.pending_exception = std::current_exception();
-		return ExecutionStatus::ExecutionStatusPropagateException;
-	}
-}
-
-static u32 wrappedDoSyscall(PPUThread &CPU, u64 code) noexcept {
-	try
-	{
-		execute_syscall_by_index(CPU, code);
-		return ExecutionStatus::ExecutionStatusBlockEnded;
-	}
-	catch (...)
-	{
-		CPU.pending_exception = std::current_exception();
-		return ExecutionStatus::ExecutionStatusPropagateException;
-	}
-}
-
-static void wrapped_fast_stop(PPUThread &CPU)
-{
-	CPU.fast_stop();
-}
-
-static void wrapped_trap(PPUThread &CPU, u32) noexcept {
-	try
-	{
-		throw EXCEPTION("trap");
-	}
-	catch (...)
-	{
-		CPU.pending_exception = std::current_exception();
-	}
-}
-
-std::pair<Executable, llvm::ExecutionEngine *> RecompilationEngine::compile(const std::string & name, u32 start_address, u32 instruction_count) {
-	std::unique_ptr<llvm::Module> module = Compiler::create_module(m_llvm_context);
-
-	std::unordered_map<std::string, void*> function_ptrs;
-	function_ptrs["execute_unknown_function"] = reinterpret_cast<void*>(CPUHybridDecoderRecompiler::ExecuteFunction);
-	function_ptrs["execute_unknown_block"] = reinterpret_cast<void*>(CPUHybridDecoderRecompiler::ExecuteTillReturn);
-	function_ptrs["PollStatus"] = reinterpret_cast<void*>(CPUHybridDecoderRecompiler::PollStatus);
-	function_ptrs["PPUThread.fast_stop"] = reinterpret_cast<void*>(wrapped_fast_stop);
-	function_ptrs["vm.reservation_acquire"] = reinterpret_cast<void*>(vm::reservation_acquire);
-	function_ptrs["vm.reservation_update"] = reinterpret_cast<void*>(vm::reservation_update);
-	function_ptrs["get_timebased_time"] = reinterpret_cast<void*>(get_timebased_time);
-	function_ptrs["wrappedExecutePPUFuncByIndex"] = reinterpret_cast<void*>(wrappedExecutePPUFuncByIndex);
-	function_ptrs["wrappedDoSyscall"] = reinterpret_cast<void*>(wrappedDoSyscall);
-	function_ptrs["trap"] = reinterpret_cast<void*>(wrapped_trap);
-
-#define REGISTER_FUNCTION_PTR(name) \
-	function_ptrs[#name] = reinterpret_cast<void*>(PPUInterpreter::name##_impl);
-
-	MACRO_PPU_INST_MAIN_EXPANDERS(REGISTER_FUNCTION_PTR)
-	MACRO_PPU_INST_G_13_EXPANDERS(REGISTER_FUNCTION_PTR)
-	MACRO_PPU_INST_G_1E_EXPANDERS(REGISTER_FUNCTION_PTR)
-	MACRO_PPU_INST_G_1F_EXPANDERS(REGISTER_FUNCTION_PTR)
-	MACRO_PPU_INST_G_3A_EXPANDERS(REGISTER_FUNCTION_PTR)
-	MACRO_PPU_INST_G_3E_EXPANDERS(REGISTER_FUNCTION_PTR)
-
-	Compiler(&m_llvm_context, &m_ir_builder, function_ptrs)
-		.translate_to_llvm_ir(module.get(), name, start_address, instruction_count);
-
-	llvm::Module *module_ptr = module.get();
-
-	Log() << *module_ptr;
-	Compiler::optimise_module(module_ptr);
-
-	llvm::ExecutionEngine *execution_engine =
-		EngineBuilder(std::move(module))
-		.setEngineKind(EngineKind::JIT)
-		.setMCJITMemoryManager(std::unique_ptr<llvm::SectionMemoryManager>(new CustomSectionMemoryManager(function_ptrs)))
-		.setOptLevel(llvm::CodeGenOpt::Aggressive)
-		.setMCPU("nehalem")
-		.create();
-	module_ptr->setDataLayout(execution_engine->getDataLayout());
-
-	// Translate to machine code
-	execution_engine->finalizeObject();
-
-	Function *llvm_function = module_ptr->getFunction(name);
-	void *function = execution_engine->getPointerToFunction(llvm_function);
-
-	/*    m_recompilation_engine.trace() << "\nDisassembly:\n";
-	auto disassembler = LLVMCreateDisasm(sys::getProcessTriple().c_str(), nullptr, 0, nullptr, nullptr);
-	for (size_t pc = 0; pc < mci.size();) {
-	char str[1024];
-
-	auto size = LLVMDisasmInstruction(disassembler, ((u8 *)mci.address()) + pc, mci.size() - pc, (uint64_t)(((u8 *)mci.address()) + pc), str, sizeof(str));
-	m_recompilation_engine.trace() << fmt::format("0x%08X: ", (u64)(((u8 *)mci.address()) + pc)) << str << '\n';
-	pc += size;
-	}
-
-	LLVMDisasmDispose(disassembler);*/
-
-	assert(function != nullptr);
-	return std::make_pair((Executable)function, execution_engine);
-}
-
-/**
-* This code is inspired from Dolphin PPC Analyst
-*/
-inline s32 SignExt16(s16 x) { return (s32)(s16)x; }
-inline s32 SignExt26(u32 x) { return x & 0x2000000 ? (s32)(x | 0xFC000000) : (s32)(x); }
-
-bool RecompilationEngine::AnalyseBlock(BlockEntry &functionData, size_t maxSize)
-{
-	u32 startAddress = functionData.address;
-	u32 farthestBranchTarget = startAddress;
-	functionData.instructionCount = 0;
-	functionData.calledFunctions.clear();
-	functionData.is_analysed = true;
-	functionData.is_compilable_function = true;
-	Log() << "Analysing " << (void*)(uint64_t)startAddress << "hit " << functionData.num_hits << "\n";
-	// Used to decode instructions
-	PPUDisAsm dis_asm(CPUDisAsm_DumpMode);
-	dis_asm.offset = vm::ps3::_ptr<u8>(startAddress);
-	for (size_t instructionAddress = startAddress; instructionAddress < startAddress + maxSize; instructionAddress += 4)
-	{
-		u32 instr = vm::ps3::read32((u32)instructionAddress);
-
-		dis_asm.dump_pc = instructionAddress - startAddress;
-		(*PPU_instr::main_list)(&dis_asm, instr);
-		Log() << dis_asm.last_opcode;
-		functionData.instructionCount++;
-		if (instr == PPU_instr::implicts::BLR() && instructionAddress >= farthestBranchTarget && functionData.is_compilable_function)
-		{
-			Log() << "Analysis: Block is compilable into a function \n";
-			return true;
-		}
-		else if (PPU_instr::fields::GD_13(instr) == PPU_opcodes::G_13Opcodes::BCCTR)
-		{
-			if (!PPU_instr::fields::LK(instr))
-			{
-				Log() << "Analysis: indirect branching found \n";
-				functionData.is_compilable_function = false;
-				return true;
-			}
-		}
-		else if (PPU_instr::fields::OPCD(instr) == PPU_opcodes::PPU_MainOpcodes::BC)
-		{
-			u32 target = SignExt16(PPU_instr::fields::BD(instr));
-			if (!PPU_instr::fields::AA(instr)) // Absolute address
-				target += (u32)instructionAddress;
-			if (target > farthestBranchTarget && !PPU_instr::fields::LK(instr))
-				farthestBranchTarget = target;
-		}
-		else if (PPU_instr::fields::OPCD(instr) == PPU_opcodes::PPU_MainOpcodes::B)
-		{
-			u32 target = SignExt26(PPU_instr::fields::LL(instr));
-			if (!PPU_instr::fields::AA(instr)) // Absolute address
-				target += (u32)instructionAddress;
-
-			if (!PPU_instr::fields::LK(instr))
-			{
-				if (target < startAddress)
-				{
-					Log() << "Analysis: branch to previous block\n";
-					functionData.is_compilable_function = false;
-					return true;
-				}
-				else if (target > farthestBranchTarget)
-					farthestBranchTarget = target;
-			}
-			else
-				functionData.calledFunctions.insert(target);
-		}
-	}
-	Log() << "Analysis: maxSize reached \n";
-	functionData.is_compilable_function = false;
-	return true;
-}
-
-void RecompilationEngine::CompileBlock(BlockEntry & block_entry) {
-	if (block_entry.is_analysed)
-		return;
-
-	if (!AnalyseBlock(block_entry))
-		return;
-	Log() << "Compile: " << block_entry.ToString() << "\n";
-
-	{
-		// We create a lock here so that data are properly stored at the end of the function.
-		/// Lock for accessing compiler
-		std::mutex local_mutex;
-		std::unique_lock<std::mutex> lock(local_mutex);
-
-		const std::pair<Executable, llvm::ExecutionEngine *> &compileResult =
-			compile(fmt::format("fn_0x%08X", block_entry.address), block_entry.address, block_entry.instructionCount);
-
-		if (!isAddressCommited(block_entry.address / 4))
-			commitAddress(block_entry.address / 4);
-
-		m_executable_storage.push_back(std::unique_ptr<llvm::ExecutionEngine>(compileResult.second));
-		Log() << "Associating " << (void*)(uint64_t)block_entry.address << " with ID " << m_currentId << "\n";
-		FunctionCache[block_entry.address / 4] = std::make_pair(compileResult.first, m_currentId);
-		m_currentId++;
-		block_entry.is_compiled = true;
-	}
-}
-
-std::shared_ptr<RecompilationEngine> RecompilationEngine::GetInstance() {
-	std::lock_guard<std::mutex> lock(s_mutex);
-
-	if (s_the_instance == nullptr) {
-		s_the_instance = std::shared_ptr<RecompilationEngine>(new RecompilationEngine());
-	}
-
-	return s_the_instance;
-}
-
-ppu_recompiler_llvm::CPUHybridDecoderRecompiler::CPUHybridDecoderRecompiler(PPUThread & ppu)
-	: m_ppu(ppu)
-	, m_interpreter(new PPUInterpreter(ppu))
-	, m_decoder(m_interpreter)
-	, m_recompilation_engine(RecompilationEngine::GetInstance()) {
-}
-
-ppu_recompiler_llvm::CPUHybridDecoderRecompiler::~CPUHybridDecoderRecompiler() {
-}
-
-u32 ppu_recompiler_llvm::CPUHybridDecoderRecompiler::DecodeMemory(const u32 address) {
-	ExecuteFunction(&m_ppu, 0);
-	if (m_ppu.pending_exception != nullptr) {
-		std::exception_ptr exn = m_ppu.pending_exception;
-		m_ppu.pending_exception = nullptr;
-		std::rethrow_exception(exn);
-	}
-	return 0;
-}
-
-u32 ppu_recompiler_llvm::CPUHybridDecoderRecompiler::ExecuteFunction(PPUThread * ppu_state, u64 context) {
-	auto execution_engine = (CPUHybridDecoderRecompiler *)ppu_state->GetDecoder();
-	if (ExecuteTillReturn(ppu_state, 0) == ExecutionStatus::ExecutionStatusPropagateException)
-		return ExecutionStatus::ExecutionStatusPropagateException;
-	return ExecutionStatus::ExecutionStatusReturn;
-}
-
-/// Get the branch type from a branch instruction
-static BranchType GetBranchTypeFromInstruction(u32 instruction)
-{
-	u32 instructionOpcode = PPU_instr::fields::OPCD(instruction);
-	u32 lk = instruction & 1;
-
-	if (instructionOpcode == PPU_opcodes::PPU_MainOpcodes::B ||
-		instructionOpcode == PPU_opcodes::PPU_MainOpcodes::BC)
-		return lk ? BranchType::FunctionCall : BranchType::LocalBranch;
-	if (instructionOpcode == PPU_opcodes::PPU_MainOpcodes::G_13) {
-		u32 G13Opcode = PPU_instr::fields::GD_13(instruction);
-		if (G13Opcode == PPU_opcodes::G_13Opcodes::BCLR)
-			return lk ? BranchType::FunctionCall : BranchType::Return;
-		if (G13Opcode == PPU_opcodes::G_13Opcodes::BCCTR)
-			return lk ? BranchType::FunctionCall : BranchType::LocalBranch;
-		return BranchType::NonBranch;
-	}
-	if (instructionOpcode == PPU_opcodes::PPU_MainOpcodes::HACK && (instruction & EIF_PERFORM_BLR)) // classify HACK instruction
-		return instruction & EIF_USE_BRANCH ? BranchType::FunctionCall : BranchType::Return;
-	if (instructionOpcode == PPU_opcodes::PPU_MainOpcodes::HACK && (instruction & EIF_USE_BRANCH))
-		return BranchType::LocalBranch;
-	return BranchType::NonBranch;
-}
-
-u32 ppu_recompiler_llvm::CPUHybridDecoderRecompiler::ExecuteTillReturn(PPUThread * ppu_state, u64 context) {
-	CPUHybridDecoderRecompiler *execution_engine = (CPUHybridDecoderRecompiler *)ppu_state->GetDecoder();
-
-	// A block is a sequence of contiguous address.
-	bool previousInstContigousAndInterp = false;
-
-	while (PollStatus(ppu_state) == false) {
-		const Executable executable = execution_engine->m_recompilation_engine->GetCompiledExecutableIfAvailable(ppu_state->PC);
-		if (executable)
-		{
-			auto entry = ppu_state->PC;
-			u32 exit = (u32)executable(ppu_state, 0);
-			if (exit == ExecutionStatus::ExecutionStatusReturn)
-			{
-				if (Emu.GetCPUThreadStop() == ppu_state->PC) ppu_state->fast_stop();
-				return ExecutionStatus::ExecutionStatusReturn;
-			}
-			if (exit == ExecutionStatus::ExecutionStatusPropagateException)
-				return ExecutionStatus::ExecutionStatusPropagateException;
-			previousInstContigousAndInterp = false;
-			continue;
-		}
-		// if previousInstContigousAndInterp is true, ie previous step was either a compiled block or a branch inst
-		// that caused a "gap" in instruction flow, we notify a new block.
-		if (!previousInstContigousAndInterp)
-			execution_engine->m_recompilation_engine->NotifyBlockStart(ppu_state->PC);
-		u32 instruction = vm::ps3::read32(ppu_state->PC);
-		u32 oldPC = ppu_state->PC;
-		try
-		{
-			execution_engine->m_decoder.Decode(instruction);
-		}
-		catch (...)
-		{
-			ppu_state->pending_exception = std::current_exception();
-			return ExecutionStatus::ExecutionStatusPropagateException;
-		}
-		previousInstContigousAndInterp = (oldPC == ppu_state->PC);
-		auto branch_type = ppu_state->PC != oldPC ? GetBranchTypeFromInstruction(instruction) : BranchType::NonBranch;
-		ppu_state->PC += 4;
-
-		switch (branch_type) {
-		case BranchType::Return:
-			if (Emu.GetCPUThreadStop() == ppu_state->PC) ppu_state->fast_stop();
-			return 0;
-		case BranchType::FunctionCall: {
-			u32 status = ExecuteFunction(ppu_state, 0);
-			if (status == ExecutionStatus::ExecutionStatusPropagateException)
-				return ExecutionStatus::ExecutionStatusPropagateException;
-			break;
-		}
-		case BranchType::LocalBranch:
-			break;
-		case BranchType::NonBranch:
-			break;
-		default:
-			assert(0);
-			break;
-		}
-	}
-
-	return 0;
-}
-
-bool ppu_recompiler_llvm::CPUHybridDecoderRecompiler::PollStatus(PPUThread * ppu_state) {
-	try
-	{
-		return ppu_state->check_status();
-	}
-	catch (...)
-	{
-		ppu_state->pending_exception = std::current_exception();
-		return true;
-	}
-}
-#endif // LLVM_AVAILABLE
+#include "stdafx.h"
+#ifdef LLVM_AVAILABLE
+#include "Emu/System.h"
+#include "Emu/state.h"
+#include "Emu/IdManager.h"
+#include "Emu/PerfCounters.h"
+#include "Emu/RemoteCache.h"
+#include "Emu/Cell/PPUDisAsm.h"
+#include "Emu/Cell/PPUInterpreter2.h"
+#include "Emu/Cell/PPULLVMRecompiler.h"
+#include "Emu/Memory/Memory.h"
+#include "Utilities/VirtualMemory.h"
+#include "Utilities/Trace.h"
+#ifdef _MSC_VER
+#pragma warning(push, 0)
+#endif
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/ExecutionEngine/GenericValue.h"
+#include "llvm/ExecutionEngine/MCJIT.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Analysis/Passes.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Analysis/MemoryDependenceAnalysis.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/Transforms/Scalar.h"
+#include "llvm/Transforms/Vectorize.h"
+#include "llvm/MC/MCDisassembler.h"
+#include "llvm/IR/Verifier.h"
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+
+using namespace llvm;
+using namespace ppu_recompiler_llvm;
+
+#ifdef ID_MANAGER_INCLUDED
+#error "ID Manager cannot be used in this module"
+#endif
+
+// PS3 can address 32 bits aligned on 4 bytes boundaries : 2^30 pointers
+#define VIRTUAL_INSTRUCTION_COUNT 0x40000000
+#define PAGE_SIZE 4096
+
+u64  Compiler::s_rotate_mask[64][64];
+std::once_flag Compiler::s_rotate_mask_inited;
+
+// Version of the compiled objects stored in the object cache (increment it whenever generated code changes)
+#define OBJECT_CACHE_VERSION 5
+
+std::unique_ptr<Module> Compiler::create_module(LLVMContext &llvm_context, const std::string & id)
+{
+	const std::vector<Type *> arg_types = { Type::getInt8PtrTy(llvm_context), Type::getInt64Ty(llvm_context) };
+	FunctionType *compiled_function_type = FunctionType::get(Type::getInt32Ty(llvm_context), arg_types, false);
+
+	std::unique_ptr<llvm::Module> result(new llvm::Module(id, llvm_context));
+	Function *execute_unknown_function = (Function *)result->getOrInsertFunction("execute_unknown_function", compiled_function_type);
+	execute_unknown_function->setCallingConv(CallingConv::X86_64_Win64);
+
+	Function *execute_unknown_block = (Function *)result->getOrInsertFunction("execute_unknown_block", compiled_function_type);
+	execute_unknown_block->setCallingConv(CallingConv::X86_64_Win64);
+
+	std::string targetTriple = "x86_64-pc-windows-elf";
+	result->setTargetTriple(targetTriple);
+
+	return result;
+}
+
+void Compiler::optimise_module(llvm::Module *module)
+{
+	// Inline functions translated in the module (they are only called directly)
+	llvm::PassManager mpm;
+	mpm.add(createFunctionInliningPass());
+	mpm.add(createGlobalDCEPass());
+	mpm.run(*module);
+
+	llvm::FunctionPassManager fpm(module);
+	fpm.add(createNoAAPass());
+	fpm.add(createBasicAliasAnalysisPass());
+	fpm.add(createNoTargetTransformInfoPass());
+	fpm.add(createEarlyCSEPass());
+	fpm.add(createTailCallEliminationPass());
+	fpm.add(createReassociatePass());
+	fpm.add(createInstructionCombiningPass());
+	fpm.add(new DominatorTreeWrapperPass());
+	fpm.add(new MemoryDependenceAnalysis());
+	fpm.add(createGVNPass());
+	fpm.add(createInstructionCombiningPass());
+	fpm.add(new MemoryDependenceAnalysis());
+	fpm.add(createDeadStoreEliminationPass());
+	fpm.add(new LoopInfo());
+	fpm.add(new ScalarEvolution());
+	fpm.add(createSLPVectorizerPass());
+	fpm.add(createInstructionCombiningPass());
+	fpm.add(createCFGSimplificationPass());
+	fpm.doInitialization();
+
+	for (auto I = module->begin(), E = module->end(); I != E; ++I)
+		fpm.run(*I);
+}
+
+void Compiler::optimise_module_fast(llvm::Module *module)
+{
+	llvm::FunctionPassManager fpm(module);
+	fpm.add(createEarlyCSEPass());
+	fpm.add(createCFGSimplificationPass());
+	fpm.doInitialization();
+
+	for (auto I = module->begin(), E = module->end(); I != E; ++I)
+		fpm.run(*I);
+}
+
+
+Compiler::Compiler(LLVMContext *context, llvm::IRBuilder<> *builder, std::unordered_map<std::string, void*> &function_ptrs, bool link_calls)
+	: m_llvm_context(context),
+	m_ir_builder(builder),
+	m_executable_map(function_ptrs),
+	m_link_calls(link_calls) {
+
+	std::vector<Type *> arg_types;
+	arg_types.push_back(m_ir_builder->getInt8PtrTy());
+	arg_types.push_back(m_ir_builder->getInt64Ty());
+	m_compiled_function_type = FunctionType::get(m_ir_builder->getInt32Ty(), arg_types, false);
+
+	std::call_once(s_rotate_mask_inited, InitRotateMask);
+}
+
+Compiler::~Compiler() {
+}
+
+void Compiler::initiate_function(const std::string &name)
+{
+	m_state.function = (Function *)m_module->getOrInsertFunction(name, m_compiled_function_type);
+	m_state.function->setCallingConv(CallingConv::X86_64_Win64);
+	auto arg_i = m_state.function->arg_begin();
+	arg_i->setName("ppu_state");
+	m_state.args[CompileTaskState::Args::State] = arg_i;
+	(++arg_i)->setName("context");
+	m_state.args[CompileTaskState::Args::Context] = arg_i;
+}
+
+void ppu_recompiler_llvm::Compiler::translate_to_llvm_ir(llvm::Module *module, const std::string & name, u32 start_address, u32 instruction_count)
+{
+	m_module = module;
+
+	m_execute_unknown_function = module->getFunction("execute_unknown_function");
+	m_execute_unknown_block = module->getFunction("execute_unknown_block");
+
+	initiate_function(name);
+
+	// Create the entry block and add code to branch to the first instruction
+	m_ir_builder->SetInsertPoint(GetBasicBlockFromAddress(0));
+	m_ir_builder->CreateBr(GetBasicBlockFromAddress(start_address));
+
+	// Convert each instruction in the CFG to LLVM IR
+	std::vector<PHINode *> exit_instr_list;
+	for (u32 instructionAddress = start_address; instructionAddress < start_address + instruction_count * 4; instructionAddress += 4) {
+		m_state.hit_branch_instruction = false;
+		m_state.current_instruction_address = instructionAddress;
+		BasicBlock *instr_bb = GetBasicBlockFromAddress(instructionAddress);
+		m_ir_builder->SetInsertPoint(instr_bb);
+
+		u32 instr = vm::ps3::read32(instructionAddress);
+
+		Decode(instr);
+		if (!m_state.hit_branch_instruction)
+			m_ir_builder->CreateBr(GetBasicBlockFromAddress(instructionAddress + 4));
+	}
+
+	// Generate exit logic for all empty blocks
+	const std::string &default_exit_block_name = GetBasicBlockNameFromAddress(0xFFFFFFFF);
+	for (BasicBlock &block_i : *m_state.function) {
+		if (!block_i.getInstList().empty() || block_i.getName() == default_exit_block_name)
+			continue;
+
+		// Found an empty block
+		m_state.current_instruction_address = GetAddressFromBasicBlockName(block_i.getName());
+
+		m_ir_builder->SetInsertPoint(&block_i);
+		PHINode *exit_instr_i32 = m_ir_builder->CreatePHI(m_ir_builder->getInt32Ty(), 0);
+		exit_instr_list.push_back(exit_instr_i32);
+
+		SetPc(m_ir_builder->getInt32(m_state.current_instruction_address));
+
+		m_ir_builder->CreateRet(m_ir_builder->getInt32(ExecutionStatus::ExecutionStatusBlockEnded));
+	}
+
+	// If the function has a default exit block then generate code for it
+	BasicBlock *default_exit_bb = GetBasicBlockFromAddress(0xFFFFFFFF, "", false);
+	if (default_exit_bb) {
+		m_ir_builder->SetInsertPoint(default_exit_bb);
+		PHINode *exit_instr_i32 = m_ir_builder->CreatePHI(m_ir_builder->getInt32Ty(), 0);
+		exit_instr_list.push_back(exit_instr_i32);
+
+		m_ir_builder->CreateRet(m_ir_builder->getInt32(0));
+	}
+
+	// Add incoming values for all exit instr PHI nodes
+	for (PHINode *exit_instr_i : exit_instr_list) {
+		BasicBlock *block = exit_instr_i->getParent();
+		for (pred_iterator pred_i = pred_begin(block); pred_i != pred_end(block); pred_i++) {
+			u32 pred_address = GetAddressFromBasicBlockName((*pred_i)->getName());
+			exit_instr_i->addIncoming(m_ir_builder->getInt32(pred_address), *pred_i);
+		}
+	}
+
+	std::string        verify;
+	raw_string_ostream verify_ostream(verify);
+	if (verifyFunction(*m_state.function, &verify_ostream)) {
+//		m_recompilation_engine.trace() << "Verification failed: " << verify_ostream.str() << "\n";
+	}
+
+	m_module = nullptr;
+	m_state.function = nullptr;
+}
+
+void Compiler::Decode(const u32 code) {
+	(*PPU_instr::main_list)(this, code);
+}
+
+std::mutex                           RecompilationEngine::s_mutex;
+std::shared_ptr<RecompilationEngine> RecompilationEngine::s_the_instance = nullptr;
+
+RecompilationEngine::RecompilationEngine()
+	: m_log(nullptr)
+	, m_pending_address_start(new PendingSlot[s_pending_queue_size])
+	, m_pending_push_pos(0)
+	, m_pending_pop_pos(0)
+	, m_pending_overflow_count(0)
+	, m_currentId(0)
+	, m_invalidation_count(0)
+	, m_last_cache_clear_time(std::chrono::high_resolution_clock::now())
+	, m_llvm_context(getGlobalContext())
+	, m_ir_builder(getGlobalContext()) {
+	InitializeNativeTarget();
+	InitializeNativeTargetAsmPrinter();
+	InitializeNativeTargetDisassembler();
+
+	for (u32 i = 0; i < s_pending_queue_size; i++)
+		m_pending_address_start[i].seq.store(i, std::memory_order_relaxed);
+
+	FunctionCache = (ExecutableStorageType *)memory_helper::reserve_memory(VIRTUAL_INSTRUCTION_COUNT * sizeof(ExecutableStorageType));
+	// Each char can store 8 page status
+	FunctionCachePagesCommited = (char *)malloc(VIRTUAL_INSTRUCTION_COUNT / (8 * PAGE_SIZE));
+	memset(FunctionCachePagesCommited, 0, VIRTUAL_INSTRUCTION_COUNT / (8 * PAGE_SIZE));
+
+	if (rpcs3::state.config.core.llvm.object_cache.value()) {
+		const std::string &path = fs::get_config_dir() + "data/cache/ppu_llvm/";
+
+		if (fs::is_dir(path) || fs::create_path(path))
+			m_object_cache.reset(new ObjectCache(path));
+	}
+}
+
+RecompilationEngine::~RecompilationEngine() {
+	if (!m_profile.empty())
+		DumpProfile();
+
+	m_retired_engine_lists.clear();
+	m_retired_engines.clear();
+	m_block_engines.clear();
+
+	s64 committed = 0;
+	for (u32 i = 0; i < VIRTUAL_INSTRUCTION_COUNT / (8 * PAGE_SIZE); i++)
+		for (u8 bits = FunctionCachePagesCommited[i]; bits; bits &= bits - 1)
+			committed += 4096;
+	perf::mem_add(perf::mem_ppu_jit, -committed);
+
+	memory_helper::free_reserved_memory(FunctionCache, VIRTUAL_INSTRUCTION_COUNT * sizeof(ExecutableStorageType));
+	free(FunctionCachePagesCommited);
+}
+
+bool RecompilationEngine::isAddressCommited(u32 address) const
+{
+	size_t offset = address * sizeof(ExecutableStorageType);
+	size_t page = offset / 4096;
+	// Since bool is stored in char, the char index is page / 8 (or page >> 3)
+	// and we shr the value with the remaining bits (page & 7)
+	return (FunctionCachePagesCommited[page >> 3] >> (page & 7)) & 1;
+}
+
+void RecompilationEngine::commitAddress(u32 address)
+{
+	size_t offset = address * sizeof(ExecutableStorageType);
+	size_t page = offset / 4096;
+	memory_helper::commit_page_memory((u8*)FunctionCache + page * 4096, 4096);
+	perf::mem_add(perf::mem_ppu_jit, 4096);
+	// Reverse of isAddressCommited : we set the (page & 7)th bit of (page / 8) th char
+	// in the array
+	FunctionCachePagesCommited[page >> 3] |= (1 << (page & 7));
+}
+
+const Executable RecompilationEngine::GetCompiledExecutableIfAvailable(u32 address) const
+{
+	if (!isAddressCommited(address / 4))
+		return nullptr;
+	u32 id = FunctionCache[address / 4].id;
+	if (rpcs3::state.config.core.llvm.exclusion_range.value() &&
+		(id >= rpcs3::state.config.core.llvm.min_id.value() && id <= rpcs3::state.config.core.llvm.max_id.value()))
+		return nullptr;
+	return FunctionCache[address / 4].function;
+}
+
+void RecompilationEngine::NotifyCompiledBlockHit(u32 address) {
+	ExecutableStorageType &entry = FunctionCache[address / 4];
+
+	// Not locked, the counter may go past 0 if several threads decrement it at the same time which only disables optimization
+	if (entry.hits_left && sync_fetch_and_sub(&entry.hits_left, 1) == 1) {
+		std::lock_guard<std::mutex> lock(m_hot_lock);
+		m_hot_blocks.push_back(address);
+	}
+}
+
+void RecompilationEngine::InvalidatePage(u32 page) {
+	std::lock_guard<std::mutex> lock(s_mutex);
+
+	if (s_the_instance)
+		s_the_instance->Invalidate(page);
+}
+
+void RecompilationEngine::Invalidate(u32 page) {
+	std::lock_guard<std::mutex> lock(m_executable_lock);
+
+	m_invalidation_count++;
+
+	const auto found = m_page_blocks.find(page);
+	if (found == m_page_blocks.end())
+		return;
+
+	for (u32 address : found->second) {
+		// The execution engine is retired, the block may still be running in another thread
+		FunctionCache[address / 4] = {};
+		m_invalidated_blocks.push_back(address);
+
+		const auto engine = m_block_engines.find(address);
+		if (engine != m_block_engines.end()) {
+			RetireEngine(std::move(engine->second));
+			m_block_engines.erase(engine);
+		}
+	}
+
+	m_page_blocks.erase(found);
+}
+
+void RecompilationEngine::RetireEngine(StoredEngine && engine) {
+	m_retired_engines.emplace_back(std::move(engine));
+}
+
+void RecompilationEngine::ReclaimRetiredEngines() {
+	{
+		std::lock_guard<std::mutex> lock(m_executable_lock);
+
+		if (!m_retired_engines.empty()) {
+			RetiredEngines list;
+			list.engines.swap(m_retired_engines);
+
+			// Their FunctionCache entries were cleared: a thread entering compiled code from now on checks the entry again after
+			// incrementing its depth (see ExecuteTillReturn), it can only be running them if it is in compiled code now
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+
+			std::lock_guard<std::mutex> threads_lock(m_threads_lock);
+			for (auto &usage : m_threads) {
+				if (usage->depth)
+					list.threads.emplace_back(usage, usage->exits.load());
+			}
+
+			m_retired_engine_lists.emplace_back(std::move(list));
+		}
+	}
+
+	// Engines of a context used by another thread are only destroyed when it doesn't compile (contexts of precompilation threads are idle)
+	std::unordered_map<std::mutex *, std::unique_lock<std::mutex>> context_locks;
+	auto is_context_idle = [&](std::mutex * context_lock) {
+		if (!context_lock)
+			return true;
+
+		auto found = context_locks.find(context_lock);
+		if (found == context_locks.end())
+			found = context_locks.emplace(context_lock, std::unique_lock<std::mutex>(*context_lock, std::try_to_lock)).first;
+
+		return found->second.owns_lock();
+	};
+
+	for (auto it = m_retired_engine_lists.begin(); it != m_retired_engine_lists.end();) {
+		auto &threads = it->threads;
+		threads.erase(std::remove_if(threads.begin(), threads.end(), [](const std::pair<std::shared_ptr<CompiledCodeUsage>, u64> & t) {
+			return t.first->exits != t.second;
+		}), threads.end());
+
+		if (threads.empty()) {
+			auto &engines = it->engines;
+			engines.erase(std::remove_if(engines.begin(), engines.end(), [&](const StoredEngine & e) {
+				return is_context_idle(e.context_lock);
+			}), engines.end());
+		}
+
+		if (it->engines.empty())
+			it = m_retired_engine_lists.erase(it);
+		else
+			++it;
+	}
+}
+
+void RecompilationEngine::RegisterThread(const std::shared_ptr<CompiledCodeUsage> & usage) {
+	std::lock_guard<std::mutex> lock(m_threads_lock);
+	m_threads.push_back(usage);
+}
+
+void RecompilationEngine::UnregisterThread(const std::shared_ptr<CompiledCodeUsage> & usage) {
+	std::lock_guard<std::mutex> lock(m_threads_lock);
+	m_threads.erase(std::remove(m_threads.begin(), m_threads.end(), usage), m_threads.end());
+
+	// Don't wait for the thread anymore
+	usage->exits++;
+}
+
+void RecompilationEngine::UpdateBlockTable() {
+	std::vector<u32> compiled, addresses;
+	{
+		std::lock_guard<std::mutex> lock(m_executable_lock);
+		compiled.swap(m_compiled_blocks);
+		addresses.swap(m_invalidated_blocks);
+	}
+
+	// A block stored and invalidated since the last update is in both lists
+	for (u32 address : compiled) {
+		auto found = m_block_table.find(address);
+		if (found != m_block_table.end())
+			found->second.is_compiled = true;
+	}
+
+	for (u32 address : addresses) {
+		auto found = m_block_table.find(address);
+		if (found == m_block_table.end())
+			continue;
+
+		// Analyse the block again when it is hot
+		found->second.num_hits = 0;
+		found->second.is_analysed = false;
+		found->second.is_compiled = false;
+	}
+}
+
+void RecompilationEngine::ProcessHotBlocks() {
+	std::vector<u32> addresses;
+	{
+		std::lock_guard<std::mutex> lock(m_hot_lock);
+		addresses.swap(m_hot_blocks);
+	}
+
+	for (u32 address : addresses) {
+		auto found = m_block_table.find(address);
+		if (found == m_block_table.end() || !found->second.is_compiled)
+			continue;
+
+		const BlockEntry &block = found->second;
+
+		OptimizationTask task;
+		task.address = address;
+		task.instruction_count = block.instructionCount;
+
+		// Inline small functions called by the block
+		for (u32 target : block.calledFunctions) {
+			if (task.inlined.size() >= s_max_inlined_functions)
+				break;
+			if (target == address || target % 4)
+				continue;
+
+			auto callee = m_block_table.find(target);
+			BlockEntry entry(target);
+			if (callee != m_block_table.end() && callee->second.is_analysed)
+				entry = callee->second;
+			else if (!vm::check_addr(target, 4) || !AnalyseBlock(entry))
+				continue;
+
+			if (entry.is_compilable_function && entry.instructionCount <= s_max_inlined_size)
+				task.inlined.emplace_back(target, entry.instructionCount);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_optimization_lock);
+			m_optimization_tasks.emplace_back(std::move(task));
+		}
+
+		if (!m_optimization_thread) {
+			m_precompile_contexts.emplace_back(new LLVMContext());
+			LLVMContext &context = *m_precompile_contexts.back();
+
+			m_optimization_thread = thread_ctrl::spawn(COPY_EXPR("PPU LLVM Optimizer"), [this, &context]() {
+				OptimizationThread(context);
+			});
+		}
+
+		m_optimization_cv.notify_one();
+	}
+}
+
+void RecompilationEngine::OptimizationThread(LLVMContext & llvm_context) {
+	IRBuilder<> builder(llvm_context);
+
+	while (!Emu.IsStopped()) {
+		OptimizationTask task;
+		{
+			std::unique_lock<std::mutex> lock(m_optimization_lock);
+
+			if (m_optimization_tasks.empty()) {
+				m_optimization_cv.wait_for(lock, std::chrono::milliseconds(10));
+				continue;
+			}
+
+			task = std::move(m_optimization_tasks.front());
+			m_optimization_tasks.pop_front();
+		}
+
+		std::lock_guard<std::mutex> context_lock(m_optimization_context_lock);
+
+		try {
+			u64 invalidation_count = WatchRange(task.address, task.instruction_count);
+			for (auto &f : task.inlined)
+				invalidation_count = std::min(invalidation_count, WatchRange(f.first, f.second));
+
+			StoreOptimizedExecutable(task, compile(fmt::format("fn_0x%08X", task.address), task.address, task.instruction_count, true, llvm_context, builder, task.inlined), invalidation_count);
+		}
+		catch (const std::exception &e) {
+			LOG_ERROR(PPU, "LLVM: optimization of 0x%08x failed: %s", task.address, e.what());
+		}
+	}
+}
+
+void RecompilationEngine::StoreOptimizedExecutable(const OptimizationTask & task, const std::pair<Executable, llvm::ExecutionEngine *> & compile_result, u64 invalidation_count) {
+	std::lock_guard<std::mutex> lock(m_executable_lock);
+
+	StoredEngine engine{ std::unique_ptr<llvm::ExecutionEngine>(compile_result.second), &m_optimization_context_lock };
+
+	ExecutableStorageType &entry = FunctionCache[task.address / 4];
+
+	// Keep the fast tier executable if the code was modified meanwhile (if it was invalidated, the block is compiled again)
+	if (m_invalidation_count != invalidation_count || !entry.function) {
+		RetireEngine(std::move(engine));
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> log_lock(m_log_lock);
+		Log() << "Associating optimized " << (void*)(uint64_t)task.address << " with ID " << m_currentId << "\n";
+	}
+	entry.function = compile_result.first;
+	entry.id = m_currentId++;
+	entry.hits_left = 0;
+
+	// The fast tier code is retired
+	StoredEngine &stored = m_block_engines[task.address];
+	if (stored.engine)
+		RetireEngine(std::move(stored));
+	stored = std::move(engine);
+
+	// Writes to inlined functions invalidate the block too
+	for (auto &f : task.inlined)
+		AddPageBlock(task.address, f.first, f.second);
+}
+
+u64 RecompilationEngine::WatchRange(u32 address, u32 instruction_count) {
+	const u32 first_page = address & ~0xfff;
+	const u32 last_page = (address + std::max<u32>(instruction_count, 1) * 4 - 1) & ~0xfff;
+
+	// Not under m_executable_lock, vm locks are taken first when pages are unmapped
+	for (u64 page = first_page; page <= last_page; page += 4096)
+		vm::page_protect((u32)page, 4096, vm::page_writable, vm::page_code_watch);
+
+	std::lock_guard<std::mutex> lock(m_executable_lock);
+	return m_invalidation_count;
+}
+
+void RecompilationEngine::AddPageBlock(u32 block_address, u32 address, u32 instruction_count) {
+	const u32 first_page = address & ~0xfff;
+	const u32 last_page = (address + std::max<u32>(instruction_count, 1) * 4 - 1) & ~0xfff;
+
+	for (u64 page = first_page; page <= last_page; page += 4096) {
+		auto &blocks = m_page_blocks[(u32)page];
+		if (std::find(blocks.begin(), blocks.end(), block_address) == blocks.end())
+			blocks.push_back(block_address);
+	}
+}
+
+void RecompilationEngine::NotifyBlockStart(u32 address) {
+	u32 pos = m_pending_push_pos.load(std::memory_order_relaxed);
+
+	for (;;) {
+		PendingSlot &slot = m_pending_address_start[pos % s_pending_queue_size];
+		const s32 diff = (s32)(slot.seq.load(std::memory_order_acquire) - pos);
+
+		if (diff == 0) {
+			// The slot is free, try to claim it
+			if (m_pending_push_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+				slot.address = address;
+				slot.seq.store(pos + 1, std::memory_order_release);
+				break;
+			}
+		}
+		else if (diff < 0) {
+			// The queue is full, drop the notification (the block will be hit again anyway)
+			m_pending_overflow_count.fetch_add(1, std::memory_order_relaxed);
+			break;
+		}
+		else {
+			pos = m_pending_push_pos.load(std::memory_order_relaxed);
+		}
+	}
+
+	if (!is_started()) {
+		start();
+	}
+
+	// Wake up the recompilation engine thread once per batch only (it polls the queue periodically anyway)
+	if (pos % s_pending_notify_batch == 0)
+		cv.notify_one();
+	// TODO: Increase the priority of the recompilation engine thread
+}
+
+void RecompilationEngine::PopPendingAddresses(std::vector<u32> & addresses, u32 max_count) {
+	for (u32 i = 0; i < max_count; i++) {
+		PendingSlot &slot = m_pending_address_start[m_pending_pop_pos % s_pending_queue_size];
+
+		if (slot.seq.load(std::memory_order_acquire) != m_pending_pop_pos + 1)
+			break;
+
+		addresses.push_back(slot.address);
+		slot.seq.store(m_pending_pop_pos + s_pending_queue_size, std::memory_order_release);
+		m_pending_pop_pos++;
+	}
+}
+
+raw_fd_ostream & RecompilationEngine::Log() {
+	if (!m_log) {
+		std::error_code error;
+		m_log = new raw_fd_ostream("PPULLVMRecompiler.log", error, sys::fs::F_Text);
+		m_log->SetUnbuffered();
+	}
+
+	return *m_log;
+}
+
+void RecompilationEngine::on_task() {
+	std::chrono::nanoseconds idling_time(0);
+	std::chrono::nanoseconds recompiling_time(0);
+
+	std::vector<u32> current_execution_traces;
+	current_execution_traces.reserve(s_pending_queue_size);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	while (!Emu.IsStopped()) {
+		bool             work_done_this_iteration = false;
+
+		UpdateBlockTable();
+		ReclaimRetiredEngines();
+		ProcessHotBlocks();
+
+		current_execution_traces.clear();
+		PopPendingAddresses(current_execution_traces, s_pending_queue_size);
+
+		for (u32 address : current_execution_traces)
+			work_done_this_iteration |= IncreaseHitCounterAndBuild(address);
+
+		UpdateCompileTasks(current_execution_traces);
+
+		if (!work_done_this_iteration) {
+			// Wait a few ms for something to happen
+			auto idling_start = std::chrono::high_resolution_clock::now();
+			std::unique_lock<std::mutex> lock(mutex);
+			cv.wait_for(lock, std::chrono::milliseconds(10));
+			auto idling_end = std::chrono::high_resolution_clock::now();
+			idling_time += std::chrono::duration_cast<std::chrono::nanoseconds>(idling_end - idling_start);
+		}
+	}
+
+	if (const u64 overflow_count = GetPendingOverflowCount())
+		LOG_WARNING(PPU, "LLVM: %llu block start notifications dropped (pending queue full)", overflow_count);
+
+	LOG_NOTICE(PPU, "LLVM: %llu KB of compiled code and data in use", (u64)m_code_arena.GetUsedSize() / 1024);
+
+	m_compile_cv.notify_all();
+	for (auto &thread : m_compile_threads)
+		thread->join();
+
+	if (m_optimization_thread) {
+		m_optimization_cv.notify_one();
+		m_optimization_thread->join();
+	}
+
+	SaveCompileProfile();
+
+	s_the_instance = nullptr; // Can cause deadlock if this is the last instance. Need to fix this.
+}
+
+void RecompilationEngine::MergeProfile(const std::unordered_map<u32, BlockProfile> & profile) {
+	std::lock_guard<std::mutex> lock(m_profile_lock);
+
+	for (auto &p : profile) {
+		BlockProfile &dst = m_profile[p.first];
+		dst.interpreted_hits += p.second.interpreted_hits;
+		dst.interpreted_instructions += p.second.interpreted_instructions;
+		dst.interpreted_time += p.second.interpreted_time;
+		dst.compiled_hits += p.second.compiled_hits;
+		dst.compiled_time += p.second.compiled_time;
+	}
+}
+
+void RecompilationEngine::DumpProfile() {
+	std::vector<std::pair<u32, BlockProfile>> blocks(m_profile.begin(), m_profile.end());
+
+	std::sort(blocks.begin(), blocks.end(), [](const std::pair<u32, BlockProfile> & a, const std::pair<u32, BlockProfile> & b) {
+		return a.second.interpreted_time + a.second.compiled_time > b.second.interpreted_time + b.second.compiled_time;
+	});
+
+	u64 total_time = 0;
+	for (auto &b : blocks)
+		total_time += b.second.interpreted_time + b.second.compiled_time;
+
+	fs::file report(fs::get_config_dir() + "PPULLVMProfile.log", fom::rewrite);
+
+	if (!report) {
+		LOG_ERROR(PPU, "LLVM: failed to write the block profile");
+		return;
+	}
+
+	std::string out = fmt::format("Total time: %.3f ms, %u blocks\n\n", total_time / 1000000., size32(blocks));
+	out += "   Address |  Interp hits | Interp instrs |  Interp ms | Compiled hits | Compiled ms |  Size | Compiled |    ID |  Time %\n";
+
+	for (auto &b : blocks) {
+		const auto found = m_block_table.find(b.first);
+		const u32 size = found != m_block_table.end() ? found->second.instructionCount : 0;
+		const bool is_compiled = found != m_block_table.end() && found->second.is_compiled;
+		const u32 id = is_compiled ? FunctionCache[b.first / 4].id : 0;
+		const u64 time = b.second.interpreted_time + b.second.compiled_time;
+
+		out += fmt::format("0x%08x | %12llu | %13llu | %10.3f | %13llu | %11.3f | %5u | %8s | %5u | %6.2f%%\n",
+			b.first, b.second.interpreted_hits, b.second.interpreted_instructions, b.second.interpreted_time / 1000000.,
+			b.second.compiled_hits, b.second.compiled_time / 1000000., size, is_compiled ? "Y" : "N", id, total_time ? time * 100. / total_time : 0.);
+	}
+
+	report.write(out.data(), out.size());
+
+	LOG_NOTICE(PPU, "LLVM: block profile (%u blocks) written to PPULLVMProfile.log", size32(blocks));
+}
+
+/// FNV-1a hash of the code of a block
+static u64 HashCode(u32 address, u32 instruction_count) {
+	u64 hash = 0xcbf29ce484222325ull;
+	for (u32 i = 0; i < instruction_count; i++)
+		hash = (hash ^ vm::ps3::read32(address + i * 4)) * 0x100000001b3ull;
+	return hash;
+}
+
+/// Serialized compile profile header
+struct CompileProfileHeader {
+	char magic[4]; // "PPUP"
+	u32 version;
+	u32 count; // number of blocks
+};
+
+/// Serialized block of the compile profile (followed by the addresses of called functions)
+struct CompileProfileBlock {
+	u32 address;
+	u32 instruction_count;
+	u32 num_hits;
+	u32 called_functions;
+	u64 code_hash;
+};
+
+static const u32 COMPILE_PROFILE_VERSION = 1;
+
+/// Maximum number of blocks saved in the compile profile (the hottest ones)
+static const u32 COMPILE_PROFILE_MAX_BLOCKS = 0x10000;
+
+void RecompilationEngine::LoadCompileProfile(const std::vector<std::pair<u32, u32>> & ranges) {
+	// The profile is keyed by the hash of the executable code
+	u64 hash = 0xcbf29ce484222325ull;
+	for (auto &range : ranges)
+		hash = (hash ^ HashCode(range.first, range.second / 4)) * 0x100000001b3ull;
+
+	const std::string &path = fs::get_config_dir() + "data/cache/ppu_llvm/";
+
+	if (!fs::is_dir(path) && !fs::create_path(path))
+		return;
+
+	m_compile_profile_path = path + fmt::format("profile_%016llx.bin", hash);
+
+	if (!fs::is_file(m_compile_profile_path))
+		return;
+
+	const fs::file f(m_compile_profile_path);
+
+	CompileProfileHeader header;
+
+	if (!f || !f.read(header) || std::memcmp(header.magic, "PPUP", 4) || header.version != COMPILE_PROFILE_VERSION) {
+		LOG_WARNING(PPU, "LLVM: compile profile '%s' is outdated or invalid, discarded", m_compile_profile_path);
+		return;
+	}
+
+	std::vector<CompileProfileBlock> blocks;
+	std::vector<std::vector<u32>> called_functions;
+
+	for (u32 i = 0; i < header.count; i++) {
+		CompileProfileBlock block;
+
+		if (!f.read(block) || block.called_functions > f.size()) {
+			LOG_ERROR(PPU, "LLVM: compile profile '%s' is truncated (%u/%u blocks read)", m_compile_profile_path, i, header.count);
+			break;
+		}
+
+		std::vector<u32> called(block.called_functions);
+
+		if (!f.read(called)) {
+			LOG_ERROR(PPU, "LLVM: compile profile '%s' is truncated (%u/%u blocks read)", m_compile_profile_path, i, header.count);
+			break;
+		}
+
+		blocks.emplace_back(block);
+		called_functions.emplace_back(std::move(called));
+	}
+
+	// Called functions are compiled at least with the priority of their callers (hottest callers first)
+	std::unordered_map<u32, u32> priority;
+	for (auto &block : blocks)
+		priority[block.address] = std::max(priority[block.address], block.num_hits);
+
+	for (size_t i = 0; i < blocks.size(); i++)
+		for (u32 callee : called_functions[i]) {
+			const auto found = priority.find(callee);
+			if (found != priority.end())
+				found->second = std::max(found->second, priority[blocks[i].address]);
+		}
+
+	u32 queued = 0;
+	u32 skipped = 0;
+
+	for (auto &info : blocks) {
+		// Blocks of modules which aren't loaded or were modified are skipped
+		if (!info.instruction_count || info.address % 4 || !vm::check_addr(info.address, info.instruction_count * 4) || HashCode(info.address, info.instruction_count) != info.code_hash) {
+			skipped++;
+			continue;
+		}
+
+		auto found = m_block_table.find(info.address);
+		if (found == m_block_table.end())
+			found = m_block_table.emplace(info.address, BlockEntry(info.address)).first;
+
+		BlockEntry &block = found->second;
+		if (block.is_analysed)
+			continue;
+
+		block.num_hits = priority[info.address];
+		CompileBlock(block);
+		queued++;
+	}
+
+	LOG_NOTICE(PPU, "LLVM: %u blocks of the compile profile queued for compilation (%u skipped)", queued, skipped);
+}
+
+void RecompilationEngine::SaveCompileProfile() {
+	if (m_compile_profile_path.empty())
+		return;
+
+	const u32 threshold = rpcs3::state.config.core.llvm.threshold.value();
+
+	std::vector<const BlockEntry *> blocks;
+	for (auto &entry : m_block_table)
+		if (entry.second.is_analysed && entry.second.code_hash && entry.second.num_hits >= threshold)
+			blocks.push_back(&entry.second);
+
+	std::sort(blocks.begin(), blocks.end(), [](const BlockEntry * a, const BlockEntry * b) {
+		return a->num_hits != b->num_hits ? a->num_hits > b->num_hits : a->address < b->address;
+	});
+
+	if (blocks.size() > COMPILE_PROFILE_MAX_BLOCKS)
+		blocks.resize(COMPILE_PROFILE_MAX_BLOCKS);
+
+	if (blocks.empty())
+		return;
+
+	const fs::file f(m_compile_profile_path, fom::rewrite);
+
+	if (!f) {
+		LOG_ERROR(PPU, "LLVM: failed to write the compile profile '%s'", m_compile_profile_path);
+		return;
+	}
+
+	f.write(CompileProfileHeader{ { 'P', 'P', 'U', 'P' }, COMPILE_PROFILE_VERSION, size32(blocks) });
+
+	for (auto block : blocks) {
+		f.write(CompileProfileBlock{ block->address, block->instructionCount, block->num_hits, size32(block->calledFunctions), block->code_hash });
+		f.write(std::vector<u32>{ block->calledFunctions.begin(), block->calledFunctions.end() });
+	}
+
+	LOG_NOTICE(PPU, "LLVM: compile profile (%u blocks) written to '%s'", size32(blocks), m_compile_profile_path);
+}
+
+bool RecompilationEngine::IncreaseHitCounterAndBuild(u32 address) {
+	auto It = m_block_table.find(address);
+	if (It == m_block_table.end())
+		It = m_block_table.emplace(address, BlockEntry(address)).first;
+	BlockEntry &block = It->second;
+	if (!block.is_compiled) {
+		block.num_hits++;
+		if (block.num_hits >= rpcs3::state.config.core.llvm.threshold.value()) {
+			CompileBlock(block);
+			return true;
+		}
+	}
+	return false;
+}
+
+extern void execute_ppu_func_by_index(PPUThread& ppu, u32 id);
+extern void execute_syscall_by_index(PPUThread& ppu, u64 code);
+
+static u32
+wrappedExecutePPUFuncByIndex(PPUThread &CPU, u32 index) noexcept {
+	try
+	{
+		execute_ppu_func_by_index(CPU, index);
+		return ExecutionStatus::ExecutionStatusBlockEnded;
+	}
+	catch (...)
+	{
+		CPU.pending_exception = std::current_exception();
+		return ExecutionStatus::ExecutionStatusPropagateException;
+	}
+}
+
+static u32 wrappedDoSyscall(PPUThread &CPU, u64 code) noexcept {
+	try
+	{
+		execute_syscall_by_index(CPU, code);
+		return ExecutionStatus::ExecutionStatusBlockEnded;
+	}
+	catch (...)
+	{
+		CPU.pending_exception = std::current_exception();
+		return ExecutionStatus::ExecutionStatusPropagateException;
+	}
+}
+
+static void wrapped_fast_stop(PPUThread &CPU)
+{
+	CPU.fast_stop();
+}
+
+static bool wrapped_spin_wait(PPUThread &CPU, u32 addr, u32 target) noexcept {
+	try
+	{
+		CPU.spin_wait(addr, target);
+	}
+	catch (...)
+	{
+		CPU.pending_exception = std::current_exception();
+		return true;
+	}
+
+	// Compiled spin loops don't reach other status checks
+	return CPUHybridDecoderRecompiler::PollStatus(&CPU);
+}
+
+static void wrapped_trap(PPUThread &CPU, u32) noexcept {
+	try
+	{
+		throw EXCEPTION("trap");
+	}
+	catch (...)
+	{
+		CPU.pending_exception = std::current_exception();
+	}
+}
+
+static u64 wrapped_raw_spu_read_reg(PPUThread &CPU, u32 addr) noexcept {
+	try
+	{
+		return raw_spu_read_reg(addr);
+	}
+	catch (...)
+	{
+		CPU.pending_exception = std::current_exception();
+		return ~0ull;
+	}
+}
+
+static bool wrapped_raw_spu_write_reg(PPUThread &CPU, u32 addr, u32 value) noexcept {
+	try
+	{
+		raw_spu_write_reg(addr, value);
+	}
+	catch (...)
+	{
+		CPU.pending_exception = std::current_exception();
+		return true;
+	}
+
+	return false;
+}
+
+std::pair<Executable, llvm::ExecutionEngine *> RecompilationEngine::compile(const std::string & name, u32 start_address, u32 instruction_count, bool optimize) {
+	return compile(name, start_address, instruction_count, optimize, m_llvm_context, m_ir_builder);
+}
+
+std::pair<Executable, llvm::ExecutionEngine *> RecompilationEngine::compile(const std::string & name, u32 start_address, u32 instruction_count, bool optimize, LLVMContext &llvm_context, IRBuilder<> &ir_builder, const std::vector<std::pair<u32, u32>> & inlined) {
+	// Linked calls bypass the dispatcher which filters excluded blocks and profiles them
+	const bool link_calls = rpcs3::state.config.core.llvm.link_calls.value() &&
+		!rpcs3::state.config.core.llvm.exclusion_range.value() && !rpcs3::state.config.core.llvm.profile.value();
+
+	// The module identifier is the key in the object cache, so it includes the hash of the code (FNV-1a) and the tier
+	u64 hash = 0xcbf29ce484222325ull;
+	auto hash_code = [&](u32 address, u32 count) {
+		for (u32 i = 0; i < count; i++) {
+			const u32 instr = vm::ps3::read32(address + i * 4);
+			hash = (hash ^ instr) * 0x100000001b3ull;
+
+			// Linked HLE stubs contain the address and RTOC of the LLE function
+			if (link_calls && PPU_instr::fields::OPCD(instr) == PPU_opcodes::PPU_MainOpcodes::HACK) {
+				if (const u32 lle_func = Compiler::GetLleFunction(instr & 0x3ffffff))
+					hash = (hash ^ ((u64)vm::ps3::read32(lle_func) << 32 | vm::ps3::read32(lle_func + 4))) * 0x100000001b3ull;
+			}
+
+			// Calls to import stubs of HLE functions called directly contain the function index
+			const u32 opcd = PPU_instr::fields::OPCD(instr);
+			if (link_calls && instr & 1 && (opcd == PPU_opcodes::PPU_MainOpcodes::B || opcd == PPU_opcodes::PPU_MainOpcodes::BC)) {
+				const s32 offset = opcd == PPU_opcodes::PPU_MainOpcodes::B ? (s32)(instr << 6) >> 6 & ~3 : (s32)(s16)(instr & 0xfffc);
+				const u32 target = (instr & 2 ? 0 : address + i * 4) + offset;
+				if (const u32 index = Compiler::GetDirectCallIndex(target))
+					hash = (hash ^ index) * 0x100000001b3ull;
+			}
+		}
+	};
+
+	hash_code(start_address, instruction_count);
+	for (auto &f : inlined) {
+		hash = (hash ^ f.first) * 0x100000001b3ull;
+		hash_code(f.first, f.second);
+	}
+
+	const std::string &id = fmt::format("%s_%u_%016llx_%s%s_v%u", name, instruction_count, hash, optimize ? "opt" : "fast", link_calls ? "_link" : "", OBJECT_CACHE_VERSION);
+	const bool is_cached = m_object_cache && m_object_cache->Contains(id);
+
+	std::unique_ptr<llvm::Module> module = Compiler::create_module(llvm_context, id);
+
+	std::unordered_map<std::string, void*> function_ptrs;
+	function_ptrs["execute_unknown_function"] = reinterpret_cast<void*>(CPUHybridDecoderRecompiler::ExecuteFunction);
+	function_ptrs["execute_unknown_block"] = reinterpret_cast<void*>(CPUHybridDecoderRecompiler::ExecuteTillReturn);
+	function_ptrs["PollStatus"] = reinterpret_cast<void*>(CPUHybridDecoderRecompiler::PollStatus);
+	function_ptrs["PPUThread.fast_stop"] = reinterpret_cast<void*>(wrapped_fast_stop);
+	function_ptrs["ppu_spin_wait"] = reinterpret_cast<void*>(wrapped_spin_wait);
+	function_ptrs["vm.reservation_acquire"] = reinterpret_cast<void*>(vm::reservation_acquire);
+	function_ptrs["vm.reservation_update"] = reinterpret_cast<void*>(vm::reservation_update);
+	function_ptrs["get_timebased_time"] = reinterpret_cast<void*>(get_timebased_time);
+	function_ptrs["wrappedExecutePPUFuncByIndex"] = reinterpret_cast<void*>(wrappedExecutePPUFuncByIndex);
+	function_ptrs["wrappedDoSyscall"] = reinterpret_cast<void*>(wrappedDoSyscall);
+	function_ptrs["trap"] = reinterpret_cast<void*>(wrapped_trap);
+	function_ptrs["raw_spu_read_reg"] = reinterpret_cast<void*>(wrapped_raw_spu_read_reg);
+	function_ptrs["raw_spu_write_reg"] = reinterpret_cast<void*>(wrapped_raw_spu_write_reg);
+	function_ptrs["ppu_function_cache"] = FunctionCache;
+
+#define REGISTER_FUNCTION_PTR(name) \
+	function_ptrs[#name] = reinterpret_cast<void*>(PPUInterpreter::name##_impl);
+
+	MACRO_PPU_INST_MAIN_EXPANDERS(REGISTER_FUNCTION_PTR)
+	MACRO_PPU_INST_G_13_EXPANDERS(REGISTER_FUNCTION_PTR)
+	MACRO_PPU_INST_G_1E_EXPANDERS(REGISTER_FUNCTION_PTR)
+	MACRO_PPU_INST_G_1F_EXPANDERS(REGISTER_FUNCTION_PTR)
+	MACRO_PPU_INST_G_3A_EXPANDERS(REGISTER_FUNCTION_PTR)
+	MACRO_PPU_INST_G_3E_EXPANDERS(REGISTER_FUNCTION_PTR)
+
+	Compiler compiler(&llvm_context, &ir_builder, function_ptrs, link_calls);
+
+	// Functions to inline are translated first, so the block calls them directly
+	for (auto &f : inlined) {
+		compiler.translate_to_llvm_ir(module.get(), fmt::format("fn_0x%08X", f.first), f.first, f.second);
+		module->getFunction(fmt::format("fn_0x%08X", f.first))->setLinkage(GlobalValue::InternalLinkage);
+	}
+
+	compiler.translate_to_llvm_ir(module.get(), name, start_address, instruction_count);
+
+	// Entries of the functions called directly are read by the code
+	{
+		std::lock_guard<std::mutex> lock(m_executable_lock);
+
+		for (u32 address : compiler.GetLinkedFunctions()) {
+			if (!isAddressCommited(address / 4))
+				commitAddress(address / 4);
+		}
+	}
+
+	llvm::Module *module_ptr = module.get();
+
+	if (!is_cached) {
+		{
+			std::lock_guard<std::mutex> lock(m_log_lock);
+			Log() << *module_ptr;
+		}
+
+		if (optimize)
+			Compiler::optimise_module(module_ptr);
+		else
+			Compiler::optimise_module_fast(module_ptr);
+	}
+
+	llvm::ExecutionEngine *execution_engine =
+		EngineBuilder(std::move(module))
+		.setEngineKind(EngineKind::JIT)
+		.setMCJITMemoryManager(std::unique_ptr<llvm::SectionMemoryManager>(new CustomSectionMemoryManager(function_ptrs, &m_code_arena)))
+		.setOptLevel(optimize ? llvm::CodeGenOpt::Aggressive : llvm::CodeGenOpt::Less)
+		.setMCPU("nehalem")
+		.create();
+	module_ptr->setDataLayout(execution_engine->getDataLayout());
+
+	if (m_object_cache)
+		execution_engine->setObjectCache(m_object_cache.get());
+
+	// Translate to machine code (or load it from the object cache)
+	execution_engine->finalizeObject();
+
+	Function *llvm_function = module_ptr->getFunction(name);
+	void *function = execution_engine->getPointerToFunction(llvm_function);
+
+	/*    m_recompilation_engine.trace() << "\nDisassembly:\n";
+	auto disassembler = LLVMCreateDisasm(sys::getProcessTriple().c_str(), nullptr, 0, nullptr, nullptr);
+	for (size_t pc = 0; pc < mci.size();) {
+	char str[1024];
+
+	auto size = LLVMDisasmInstruction(disassembler, ((u8 *)mci.address()) + pc, mci.size() - pc, (uint64_t)(((u8 *)mci.address()) + pc), str, sizeof(str));
+	m_recompilation_engine.trace() << fmt::format("0x%08X: ", (u64)(((u8 *)mci.address()) + pc)) << str << '\n';
+	pc += size;
+	}
+
+	LLVMDisasmDispose(disassembler);*/
+
+	assert(function != nullptr);
+	return std::make_pair((Executable)function, execution_engine);
+}
+
+/**
+* This code is inspired from Dolphin PPC Analyst
+*/
+inline s32 SignExt16(s16 x) { return (s32)(s16)x; }
+inline s32 SignExt26(u32 x) { return x & 0x2000000 ? (s32)(x | 0xFC000000) : (s32)(x); }
+
+bool RecompilationEngine::AnalyseBlock(BlockEntry &functionData, size_t maxSize)
+{
+	u32 startAddress = functionData.address;
+	u32 farthestBranchTarget = startAddress;
+	functionData.instructionCount = 0;
+	functionData.calledFunctions.clear();
+	functionData.is_analysed = true;
+	functionData.is_compilable_function = true;
+	std::lock_guard<std::mutex> lock(m_log_lock);
+	Log() << "Analysing " << (void*)(uint64_t)startAddress << "hit " << functionData.num_hits << "\n";
+	// Used to decode instructions
+	PPUDisAsm dis_asm(CPUDisAsm_DumpMode);
+	dis_asm.offset = vm::ps3::_ptr<u8>(startAddress);
+	for (size_t instructionAddress = startAddress; instructionAddress < startAddress + maxSize; instructionAddress += 4)
+	{
+		u32 instr = vm::ps3::read32((u32)instructionAddress);
+
+		dis_asm.dump_pc = instructionAddress - startAddress;
+		(*PPU_instr::main_list)(&dis_asm, instr);
+		Log() << dis_asm.last_opcode;
+		functionData.instructionCount++;
+		if (instr == PPU_instr::implicts::BLR() && instructionAddress >= farthestBranchTarget && functionData.is_compilable_function)
+		{
+			Log() << "Analysis: Block is compilable into a function \n";
+			return true;
+		}
+		else if (PPU_instr::fields::GD_13(instr) == PPU_opcodes::G_13Opcodes::BCCTR)
+		{
+			if (!PPU_instr::fields::LK(instr))
+			{
+				Log() << "Analysis: indirect branching found \n";
+				functionData.is_compilable_function = false;
+				return true;
+			}
+		}
+		else if (PPU_instr::fields::OPCD(instr) == PPU_opcodes::PPU_MainOpcodes::BC)
+		{
+			u32 target = SignExt16(PPU_instr::fields::BD(instr));
+			if (!PPU_instr::fields::AA(instr)) // Absolute address
+				target += (u32)instructionAddress;
+			if (target > farthestBranchTarget && !PPU_instr::fields::LK(instr))
+				farthestBranchTarget = target;
+		}
+		else if (PPU_instr::fields::OPCD(instr) == PPU_opcodes::PPU_MainOpcodes::B)
+		{
+			u32 target = SignExt26(PPU_instr::fields::LL(instr));
+			if (!PPU_instr::fields::AA(instr)) // Absolute address
+				target += (u32)instructionAddress;
+
+			if (!PPU_instr::fields::LK(instr))
+			{
+				if (target < startAddress)
+				{
+					Log() << "Analysis: branch to previous block\n";
+					functionData.is_compilable_function = false;
+					return true;
+				}
+				else if (target > farthestBranchTarget)
+					farthestBranchTarget = target;
+			}
+			else
+				functionData.calledFunctions.insert(target);
+		}
+	}
+	Log() << "Analysis: maxSize reached \n";
+	functionData.is_compilable_function = false;
+	return true;
+}
+
+void RecompilationEngine::CompileBlock(BlockEntry & block_entry) {
+	if (block_entry.is_analysed)
+		return;
+
+	if (!AnalyseBlock(block_entry))
+		return;
+
+	block_entry.code_hash = HashCode(block_entry.address, block_entry.instructionCount);
+
+	{
+		std::lock_guard<std::mutex> lock(m_log_lock);
+		Log() << "Compile: " << block_entry.ToString() << "\n";
+	}
+
+	QueueCompileTask(block_entry.address, block_entry.instructionCount, block_entry.num_hits);
+}
+
+void RecompilationEngine::QueueCompileTask(u32 address, u32 instruction_count, u32 num_hits) {
+	{
+		std::lock_guard<std::mutex> lock(m_compile_lock);
+
+		if (!m_compile_tasks.emplace(address, CompileTask{ instruction_count, num_hits }).second)
+			return;
+
+		m_compile_queue.emplace(num_hits, address);
+	}
+
+	if (m_compile_threads.empty()) {
+		const u32 thread_count = std::max<u32>(rpcs3::state.config.core.llvm.compile_threads.value(), 1);
+
+		for (u32 i = 0; i < thread_count; i++) {
+			m_precompile_contexts.emplace_back(new LLVMContext());
+			m_compile_context_locks.emplace_back();
+
+			LLVMContext &context = *m_precompile_contexts.back();
+			std::mutex &context_lock = m_compile_context_locks.back();
+
+			m_compile_threads.emplace_back(thread_ctrl::spawn(COPY_EXPR(fmt::format("PPU LLVM Compiler[%u]", i)), [this, &context, &context_lock]() {
+				CompileThread(context, context_lock);
+			}));
+		}
+	}
+
+	m_compile_cv.notify_one();
+}
+
+void RecompilationEngine::UpdateCompileTasks(const std::vector<u32> & addresses) {
+	std::lock_guard<std::mutex> lock(m_compile_lock);
+
+	if (m_compile_tasks.empty())
+		return;
+
+	for (u32 address : addresses) {
+		auto task = m_compile_tasks.find(address);
+		if (task == m_compile_tasks.end())
+			continue;
+
+		// Hits are counted until the block is compiled
+		const u32 num_hits = m_block_table.at(address).num_hits;
+		if (task->second.num_hits == num_hits)
+			continue;
+
+		m_compile_queue.erase(std::make_pair(task->second.num_hits, address));
+		m_compile_queue.emplace(num_hits, address);
+		task->second.num_hits = num_hits;
+	}
+}
+
+void RecompilationEngine::CompileThread(LLVMContext & llvm_context, std::mutex & context_lock) {
+	IRBuilder<> builder(llvm_context);
+
+	// With tiered compilation, the block is compiled quickly first and optimized later if it stays hot
+	const bool tiered = rpcs3::state.config.core.llvm.tiered.value();
+	const u32 hits_left = tiered ? std::max<u32>(rpcs3::state.config.core.llvm.optimization_threshold.value(), 1) : 0;
+
+	while (!Emu.IsStopped()) {
+		u32 address;
+		CompileTask task;
+		{
+			std::unique_lock<std::mutex> lock(m_compile_lock);
+
+			if (m_compile_queue.empty()) {
+				m_compile_cv.wait_for(lock, std::chrono::milliseconds(10));
+				continue;
+			}
+
+			address = m_compile_queue.begin()->second;
+			m_compile_queue.erase(m_compile_queue.begin());
+
+			const auto found = m_compile_tasks.find(address);
+			task = found->second;
+			m_compile_tasks.erase(found);
+		}
+
+		_log::timeline_scope scope("ppu", "llvm compile", address);
+
+		std::lock_guard<std::mutex> lock(context_lock);
+
+		try {
+			const u64 invalidation_count = WatchRange(address, task.instruction_count);
+			StoreExecutable(address, task.instruction_count, compile(fmt::format("fn_0x%08X", address), address, task.instruction_count, !tiered, llvm_context, builder), invalidation_count, hits_left, &context_lock);
+		}
+		catch (const std::exception &e) {
+			LOG_ERROR(PPU, "LLVM: compilation of 0x%08x failed: %s", address, e.what());
+		}
+	}
+}
+
+void RecompilationEngine::StoreExecutable(u32 address, u32 instruction_count, const std::pair<Executable, llvm::ExecutionEngine *> & compile_result, u64 invalidation_count, u32 hits_left, std::mutex * context_lock) {
+	std::lock_guard<std::mutex> lock(m_executable_lock);
+
+	StoredEngine engine{ std::unique_ptr<llvm::ExecutionEngine>(compile_result.second), context_lock };
+
+	if (m_invalidation_count != invalidation_count) {
+		// The code may have been modified during compilation, analyse the block again later
+		m_invalidated_blocks.push_back(address);
+		RetireEngine(std::move(engine));
+		return;
+	}
+
+	if (!isAddressCommited(address / 4))
+		commitAddress(address / 4);
+
+	{
+		std::lock_guard<std::mutex> log_lock(m_log_lock);
+		Log() << "Associating " << (void*)(uint64_t)address << " with ID " << m_currentId << "\n";
+	}
+
+	// PPU threads and linked calls read the entry without locking, the function is published last
+	ExecutableStorageType &entry = FunctionCache[address / 4];
+	entry.id = m_currentId++;
+	entry.hits_left = hits_left;
+	std::atomic_thread_fence(std::memory_order_release);
+	entry.function = compile_result.first;
+	m_compiled_blocks.push_back(address);
+
+	StoredEngine &stored = m_block_engines[address];
+	if (stored.engine)
+		RetireEngine(std::move(stored));
+	stored = std::move(engine);
+
+	AddPageBlock(address, address, instruction_count);
+}
+
+void RecompilationEngine::PrecompileRange(u32 start_address, u32 size) {
+	const u32 end_address = start_address + size;
+
+	// Find function entries: targets of all function calls in the range
+	std::set<u32> entries;
+	for (u32 addr = start_address; addr + 4 <= end_address; addr += 4) {
+		const u32 instr = vm::ps3::read32(addr);
+
+		if (PPU_instr::fields::OPCD(instr) == PPU_opcodes::PPU_MainOpcodes::B && PPU_instr::fields::LK(instr)) {
+			u32 target = SignExt26(PPU_instr::fields::LL(instr));
+			if (!PPU_instr::fields::AA(instr)) // Relative address
+				target += addr;
+			if (target >= start_address && target < end_address && target % 4 == 0)
+				entries.insert(target);
+		}
+	}
+
+	// Analyse functions (and functions called by them)
+	std::vector<BlockEntry *> queue;
+	while (!entries.empty()) {
+		const u32 address = *entries.begin();
+		entries.erase(entries.begin());
+
+		auto found = m_block_table.find(address);
+		if (found != m_block_table.end() && found->second.is_analysed)
+			continue;
+		if (found == m_block_table.end())
+			found = m_block_table.emplace(address, BlockEntry(address)).first;
+
+		BlockEntry &block = found->second;
+		if (!AnalyseBlock(block, std::min<size_t>(10000, end_address - address)))
+			continue;
+
+		for (u32 target : block.calledFunctions)
+			if (target >= start_address && target < end_address && target % 4 == 0)
+				entries.insert(target);
+
+		if (block.is_compilable_function && !block.is_compiled)
+			queue.push_back(&block);
+	}
+
+	const u32 thread_count = std::max<u32>(1, std::min<u32>(rpcs3::state.config.core.llvm.aot_threads.value(), size32(queue)));
+
+	LOG_NOTICE(PPU, "LLVM: precompiling %u functions in range 0x%x-0x%x (%u threads)...", size32(queue), start_address, end_address, thread_count);
+
+	for (u32 i = 0; i < thread_count; i++)
+		m_precompile_contexts.emplace_back(new LLVMContext());
+
+	std::atomic<u32> next{ 0 };
+	std::atomic<u32> failed{ 0 };
+	std::vector<std::shared_ptr<thread_ctrl>> threads;
+
+	for (u32 i = 0; i < thread_count; i++) {
+		LLVMContext &context = *m_precompile_contexts[m_precompile_contexts.size() - thread_count + i];
+
+		threads.emplace_back(thread_ctrl::spawn(COPY_EXPR(fmt::format("PPU LLVM Precompiler[%u]", i)), [&, i]() {
+			IRBuilder<> builder(context);
+
+			for (u32 index; (index = next++) < queue.size();) {
+				BlockEntry &block = *queue[index];
+
+				try {
+					// Precompiled functions are optimized directly
+					const u64 invalidation_count = WatchRange(block.address, block.instructionCount);
+					StoreExecutable(block.address, block.instructionCount, compile(fmt::format("fn_0x%08X", block.address), block.address, block.instructionCount, true, context, builder), invalidation_count, 0, nullptr);
+				}
+				catch (const std::exception &e) {
+					LOG_ERROR(PPU, "LLVM: precompilation of 0x%08x failed: %s", block.address, e.what());
+					failed++;
+				}
+			}
+		}));
+	}
+
+	for (auto &thread : threads)
+		thread->join();
+
+	LOG_SUCCESS(PPU, "LLVM: %u functions precompiled (%u failed)", size32(queue) - failed, failed.load());
+}
+
+ppu_recompiler_llvm::CodeArena::CodeArena()
+	: m_used_size(0) {
+	m_memory = (u8 *)memory_helper::reserve_memory(s_region_size * 2);
+
+	for (u32 i = 0; i < 2; i++) {
+		m_regions[i].base = m_memory + s_region_size * i;
+		m_regions[i].next = 0;
+		m_regions[i].committed = 0;
+	}
+}
+
+ppu_recompiler_llvm::CodeArena::~CodeArena() {
+	perf::mem_add(perf::mem_ppu_jit, -(s64)(m_regions[0].committed + m_regions[1].committed));
+	memory_helper::free_reserved_memory(m_memory, s_region_size * 2);
+}
+
+u8 * ppu_recompiler_llvm::CodeArena::Allocate(size_t size, bool code) {
+	size = (size + 15) & ~(size_t)15;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Region &region = m_regions[code ? 0 : 1];
+
+	// First fit in free chunks
+	for (auto it = region.free_chunks.begin(); it != region.free_chunks.end(); ++it) {
+		if (it->second >= size) {
+			const size_t offset = it->first;
+			const size_t left = it->second - size;
+			region.free_chunks.erase(it);
+
+			if (left)
+				region.free_chunks.emplace(offset + size, left);
+
+			m_used_size += size;
+			return region.base + offset;
+		}
+	}
+
+	if (region.next + size > s_region_size)
+		return nullptr;
+
+	const size_t offset = region.next;
+	region.next += size;
+
+	if (region.next > region.committed) {
+		const size_t committed = std::min((region.next + s_commit_size - 1) & ~(s_commit_size - 1), s_region_size);
+		memory_helper::commit_page_memory(region.base + region.committed, committed - region.committed);
+		perf::mem_add(perf::mem_ppu_jit, committed - region.committed);
+
+		// Code stays writable, other sections of the pages are allocated later
+		if (code) {
+			sys::MemoryBlock block(region.base + region.committed, committed - region.committed);
+			sys::Memory::protectMappedMemory(block, sys::Memory::MF_READ | sys::Memory::MF_WRITE | sys::Memory::MF_EXEC);
+		}
+
+		region.committed = committed;
+	}
+
+	m_used_size += size;
+	return region.base + offset;
+}
+
+void ppu_recompiler_llvm::CodeArena::Deallocate(u8 * ptr, size_t size, bool code) {
+	size = (size + 15) & ~(size_t)15;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Region &region = m_regions[code ? 0 : 1];
+	size_t offset = ptr - region.base;
+	m_used_size -= size;
+
+	// Coalesce with the next and the previous free chunks
+	auto next = region.free_chunks.lower_bound(offset);
+	if (next != region.free_chunks.end() && next->first == offset + size) {
+		size += next->second;
+		next = region.free_chunks.erase(next);
+	}
+
+	if (next != region.free_chunks.begin()) {
+		const auto prev = std::prev(next);
+		if (prev->first + prev->second == offset) {
+			offset = prev->first;
+			size += prev->second;
+			region.free_chunks.erase(prev);
+		}
+	}
+
+	// The last chunk goes back to the unallocated part (it stays committed)
+	if (offset + size == region.next)
+		region.next = offset;
+	else
+		region.free_chunks.emplace(offset, size);
+}
+
+size_t ppu_recompiler_llvm::CodeArena::GetUsedSize() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_used_size;
+}
+
+ppu_recompiler_llvm::CustomSectionMemoryManager::~CustomSectionMemoryManager() {
+	for (auto &chunk : chunks)
+		arena->Deallocate(std::get<0>(chunk), std::get<1>(chunk), std::get<2>(chunk));
+}
+
+u8 * ppu_recompiler_llvm::CustomSectionMemoryManager::allocate(uintptr_t size, unsigned alignment, bool code) {
+	if (!arena)
+		return nullptr;
+
+	// Chunks are aligned on 16 bytes, allocate more for bigger alignments
+	alignment = std::max(alignment, 16u);
+	const size_t chunk_size = std::max<size_t>(size + alignment - 16, 16);
+
+	u8 *chunk = arena->Allocate(chunk_size, code);
+	if (!chunk)
+		return nullptr;
+
+	chunks.emplace_back(chunk, chunk_size, code);
+	return (u8 *)(((uintptr_t)chunk + alignment - 1) & ~(uintptr_t)(alignment - 1));
+}
+
+uint8_t * ppu_recompiler_llvm::CustomSectionMemoryManager::allocateCodeSection(uintptr_t Size, unsigned Alignment, unsigned SectionID, StringRef SectionName) {
+	if (u8 *ptr = allocate(Size, Alignment, true))
+		return ptr;
+
+	// The arena is full
+	return SectionMemoryManager::allocateCodeSection(Size, Alignment, SectionID, SectionName);
+}
+
+uint8_t * ppu_recompiler_llvm::CustomSectionMemoryManager::allocateDataSection(uintptr_t Size, unsigned Alignment, unsigned SectionID, StringRef SectionName, bool IsReadOnly) {
+	if (u8 *ptr = allocate(Size, Alignment, false))
+		return ptr;
+
+	return SectionMemoryManager::allocateDataSection(Size, Alignment, SectionID, SectionName, IsReadOnly);
+}
+
+bool ppu_recompiler_llvm::CustomSectionMemoryManager::finalizeMemory(std::string *ErrMsg) {
+	for (auto &chunk : chunks) {
+		if (std::get<2>(chunk))
+			sys::Memory::InvalidateInstructionCache(std::get<0>(chunk), std::get<1>(chunk));
+	}
+
+	// Sections allocated by SectionMemoryManager
+	return SectionMemoryManager::finalizeMemory(ErrMsg);
+}
+
+/// Objects in the remote cache are shared by hosts, the key includes the host CPU the code was generated for
+static std::string GetRemoteObjectKey(const std::string & id) {
+	return id + "_" + llvm::sys::getHostCPUName().str();
+}
+
+bool ppu_recompiler_llvm::ObjectCache::Contains(const std::string & id) const {
+	const std::string &path = m_path + id + ".obj";
+
+	if (fs::is_file(path))
+		return true;
+
+	std::vector<u8> obj;
+
+	// Objects compiled by other hosts are stored locally
+	return remote_cache::get("ppu", GetRemoteObjectKey(id), obj) && fs::write_file_atomic(path, obj.data(), obj.size());
+}
+
+void ppu_recompiler_llvm::ObjectCache::notifyObjectCompiled(const llvm::Module *module, llvm::MemoryBufferRef obj) {
+	const std::string &path = m_path + module->getModuleIdentifier() + ".obj";
+
+	// Other instances may compile and load the same object concurrently, so it's never visible partially written
+	if (!fs::write_file_atomic(path, obj.getBufferStart(), obj.getBufferSize()))
+		LOG_ERROR(PPU, "LLVM: failed to write '%s'", path);
+
+	if (remote_cache::is_enabled())
+		remote_cache::put("ppu", GetRemoteObjectKey(module->getModuleIdentifier()), { obj.getBufferStart(), obj.getBufferEnd() });
+}
+
+std::unique_ptr<llvm::MemoryBuffer> ppu_recompiler_llvm::ObjectCache::getObject(const llvm::Module *module) {
+	// Mapped if large enough (files are replaced atomically, never modified)
+	auto buffer = llvm::MemoryBuffer::getFile(m_path + module->getModuleIdentifier() + ".obj", -1, false);
+
+	if (!buffer)
+		return nullptr;
+
+	return std::move(buffer.get());
+}
+
+std::shared_ptr<RecompilationEngine> RecompilationEngine::GetInstance() {
+	std::lock_guard<std::mutex> lock(s_mutex);
+
+	if (s_the_instance == nullptr) {
+		s_the_instance = std::shared_ptr<RecompilationEngine>(new RecompilationEngine());
+	}
+
+	return s_the_instance;
+}
+
+ppu_recompiler_llvm::CPUHybridDecoderRecompiler::CPUHybridDecoderRecompiler(PPUThread & ppu)
+	: m_ppu(ppu)
+	, m_decoder_cache(fxm::get<ppu_decoder_cache_t>())
+	, m_recompilation_engine(RecompilationEngine::GetInstance())
+	, m_profile_enabled(rpcs3::state.config.core.llvm.profile.value())
+	, m_code_usage(std::make_shared<CompiledCodeUsage>()) {
+	m_recompilation_engine->RegisterThread(m_code_usage);
+}
+
+ppu_recompiler_llvm::CPUHybridDecoderRecompiler::~CPUHybridDecoderRecompiler() {
+	if (!m_profile.empty())
+		m_recompilation_engine->MergeProfile(m_profile);
+
+	m_recompilation_engine->UnregisterThread(m_code_usage);
+}
+
+u32 ppu_recompiler_llvm::CPUHybridDecoderRecompiler::DecodeMemory(const u32 address) {
+	ExecuteFunction(&m_ppu, 0);
+	if (m_ppu.pending_exception != nullptr) {
+		std::exception_ptr exn = m_ppu.pending_exception;
+		m_ppu.pending_exception = nullptr;
+		std::rethrow_exception(exn);
+	}
+	return 0;
+}
+
+u32 ppu_recompiler_llvm::CPUHybridDecoderRecompiler::ExecuteFunction(PPUThread * ppu_state, u64 context) {
+	auto execution_engine = (CPUHybridDecoderRecompiler *)ppu_state->GetDecoder();
+	if (ExecuteTillReturn(ppu_state, 0) == ExecutionStatus::ExecutionStatusPropagateException)
+		return ExecutionStatus::ExecutionStatusPropagateException;
+	return ExecutionStatus::ExecutionStatusReturn;
+}
+
+/// Get the branch type from a branch instruction
+static BranchType GetBranchTypeFromInstruction(u32 instruction)
+{
+	u32 instructionOpcode = PPU_instr::fields::OPCD(instruction);
+	u32 lk = instruction & 1;
+
+	if (instructionOpcode == PPU_opcodes::PPU_MainOpcodes::B ||
+		instructionOpcode == PPU_opcodes::PPU_MainOpcodes::BC)
+		return lk ? BranchType::FunctionCall : BranchType::LocalBranch;
+	if (instructionOpcode == PPU_opcodes::PPU_MainOpcodes::G_13) {
+		u32 G13Opcode = PPU_instr::fields::GD_13(instruction);
+		if (G13Opcode == PPU_opcodes::G_13Opcodes::BCLR)
+			return lk ? BranchType::FunctionCall : BranchType::Return;
+		if (G13Opcode == PPU_opcodes::G_13Opcodes::BCCTR)
+			return lk ? BranchType::FunctionCall : BranchType::LocalBranch;
+		return BranchType::NonBranch;
+	}
+	if (instructionOpcode == PPU_opcodes::PPU_MainOpcodes::HACK && (instruction & EIF_PERFORM_BLR)) // classify HACK instruction
+		return instruction & EIF_USE_BRANCH ? BranchType::FunctionCall : BranchType::Return;
+	if (instructionOpcode == PPU_opcodes::PPU_MainOpcodes::HACK && (instruction & EIF_USE_BRANCH))
+		return BranchType::LocalBranch;
+	return BranchType::NonBranch;
+}
+
+u32 ppu_recompiler_llvm::CPUHybridDecoderRecompiler::ExecuteTillReturn(PPUThread * ppu_state, u64 context) {
+	CPUHybridDecoderRecompiler *execution_engine = (CPUHybridDecoderRecompiler *)ppu_state->GetDecoder();
+
+	// A block is a sequence of contiguous address.
+	bool previousInstContigousAndInterp = false;
+
+	// Profiling of the interpreted block being executed (profiled_block is nullptr if not profiling)
+	BlockProfile *profiled_block = nullptr;
+	std::chrono::steady_clock::time_point profiled_block_start;
+
+	auto end_profiled_block = [&]() {
+		if (profiled_block) {
+			profiled_block->interpreted_time += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - profiled_block_start).count();
+			profiled_block = nullptr;
+		}
+	};
+
+	while (PollStatus(ppu_state) == false) {
+		const Executable executable = execution_engine->m_recompilation_engine->GetCompiledExecutableIfAvailable(ppu_state->PC);
+		if (executable)
+		{
+			CompiledCodeUsage &usage = *execution_engine->m_code_usage;
+
+			// The executable may have been retired before the depth was incremented, it can only be run if it is still stored
+			usage.depth++;
+			if (executable != execution_engine->m_recompilation_engine->GetCompiledExecutableIfAvailable(ppu_state->PC)) {
+				if (--usage.depth == 0)
+					usage.exits++;
+				continue;
+			}
+
+			perf::add(perf::jit_hits);
+			perf::add(perf::ppu_blocks);
+
+			auto entry = ppu_state->PC;
+			u32 exit;
+			if (execution_engine->m_profile_enabled) {
+				end_profiled_block();
+				const auto start = std::chrono::steady_clock::now();
+				exit = (u32)executable(ppu_state, 0);
+				BlockProfile &profile = execution_engine->m_profile[entry];
+				profile.compiled_hits++;
+				profile.compiled_time += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+			}
+			else
+				exit = (u32)executable(ppu_state, 0);
+			if (--usage.depth == 0)
+				usage.exits++;
+			execution_engine->m_recompilation_engine->NotifyCompiledBlockHit(entry);
+			if (exit == ExecutionStatus::ExecutionStatusReturn)
+			{
+				if (Emu.GetCPUThreadStop() == ppu_state->PC) ppu_state->fast_stop();
+				return ExecutionStatus::ExecutionStatusReturn;
+			}
+			if (exit == ExecutionStatus::ExecutionStatusPropagateException)
+				return ExecutionStatus::ExecutionStatusPropagateException;
+			previousInstContigousAndInterp = false;
+			continue;
+		}
+		// if previousInstContigousAndInterp is true, ie previous step was either a compiled block or a branch inst
+		// that caused a "gap" in instruction flow, we notify a new block.
+		if (!previousInstContigousAndInterp) {
+			perf::add(perf::jit_misses);
+
+			execution_engine->m_recompilation_engine->NotifyBlockStart(ppu_state->PC);
+
+			if (execution_engine->m_profile_enabled) {
+				end_profiled_block();
+				profiled_block = &execution_engine->m_profile[ppu_state->PC];
+				profiled_block->interpreted_hits++;
+				profiled_block_start = std::chrono::steady_clock::now();
+			}
+		}
+		if (profiled_block)
+			profiled_block->interpreted_instructions++;
+		u32 instruction = vm::ps3::read32(ppu_state->PC);
+		u32 oldPC = ppu_state->PC;
+		try
+		{
+			execution_engine->m_decoder_cache->initialize_page(oldPC);
+			execution_engine->m_decoder_cache->get(oldPC, instruction)(*ppu_state, { instruction });
+		}
+		catch (...)
+		{
+			end_profiled_block();
+			ppu_state->pending_exception = std::current_exception();
+			return ExecutionStatus::ExecutionStatusPropagateException;
+		}
+		previousInstContigousAndInterp = (oldPC == ppu_state->PC);
+		auto branch_type = ppu_state->PC != oldPC ? GetBranchTypeFromInstruction(instruction) : BranchType::NonBranch;
+		ppu_state->PC += 4;
+
+		switch (branch_type) {
+		case BranchType::Return:
+			end_profiled_block();
+			if (Emu.GetCPUThreadStop() == ppu_state->PC) ppu_state->fast_stop();
+			return 0;
+		case BranchType::FunctionCall: {
+			// The callee is profiled separately, the block is reopened when it is notified again
+			end_profiled_block();
+			u32 status = ExecuteFunction(ppu_state, 0);
+			if (status == ExecutionStatus::ExecutionStatusPropagateException)
+				return ExecutionStatus::ExecutionStatusPropagateException;
+			break;
+		}
+		case BranchType::LocalBranch:
+			break;
+		case BranchType::NonBranch:
+			break;
+		default:
+			assert(0);
+			break;
+		}
+	}
+
+	end_profiled_block();
+	return 0;
+}
+
+bool ppu_recompiler_llvm::CPUHybridDecoderRecompiler::PollStatus(PPUThread * ppu_state) {
+	try
+	{
+		return ppu_state->check_status();
+	}
+	catch (...)
+	{
+		ppu_state->pending_exception = std::current_exception();
+		return true;
+	}
+}
+#endif // LLVM_AVAILABLE
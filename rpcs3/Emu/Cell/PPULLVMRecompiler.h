@@ -1,946 +1,1357 @@
-#ifndef PPU_LLVM_RECOMPILER_H
-#define PPU_LLVM_RECOMPILER_H
-
-#ifdef LLVM_AVAILABLE
-#define PPU_LLVM_RECOMPILER 1
-
-#include <list>
-#include "Emu/Cell/PPUDecoder.h"
-#include "Emu/Cell/PPUThread.h"
-#include "Emu/Cell/PPUInterpreter.h"
-#ifdef _MSC_VER
-#pragma warning(push, 0)
-#endif
-#include "llvm/ExecutionEngine/ExecutionEngine.h"
-#include "llvm/ExecutionEngine/SectionMemoryManager.h"
-#include "llvm/Support/raw_ostream.h"
-#include "llvm/IR/LLVMContext.h"
-#include "llvm/IR/IRBuilder.h"
-#include "llvm/IR/Module.h"
-#include "llvm/IR/GlobalVariable.h"
-#include "llvm/PassManager.h"
-#ifdef _MSC_VER
-#pragma warning(pop)
-#endif
-
-namespace ppu_recompiler_llvm {
-	enum ExecutionStatus
-	{
-		ExecutionStatusReturn = 0, ///< Block has hit a return, caller can continue execution
-		ExecutionStatusBlockEnded, ///< Block has been executed but no return was hit, at least another block must be executed before caller can continue
-		ExecutionStatusPropagateException, ///< an exception was thrown
-	};
-
-	class Compiler;
-	class RecompilationEngine;
-	class ExecutionEngine;
-	struct PPUState;
-
-	enum class BranchType {
-		NonBranch,
-		LocalBranch,
-		FunctionCall,
-		Return,
-	};
-
-	/// Pointer to an executable
-	typedef u32(*Executable)(PPUThread * ppu_state, u64 context);
-
-	/// Parses PPU opcodes and translate them into llvm ir.
-	class Compiler : protected PPUOpcodes, protected PPCDecoder {
-	public:
-		Compiler(llvm::LLVMContext *context, llvm::IRBuilder<> *builder, std::unordered_map<std::string, void*> &function_ptrs);
-
-		Compiler(const Compiler&) = delete; // Delete copy/move constructors and copy/move operators
-
-		virtual ~Compiler();
-
-		/// Create a module setting target triples and some callbacks
-		static std::unique_ptr<llvm::Module> create_module(llvm::LLVMContext &llvm_context);
-
-		/// Create a function called name in module and populates it by translating block at start_address with instruction_count length.
-		void translate_to_llvm_ir(llvm::Module *module, const std::string & name, u32 start_address, u32 instruction_count);
-
-		static void optimise_module(llvm::Module *module);
-
-	protected:
-		void Decode(const u32 code) override;
-
-		void NULL_OP() override;
-		void NOP() override;
-
-		void TDI(u32 to, u32 ra, s32 simm16) override;
-		void TWI(u32 to, u32 ra, s32 simm16) override;
-
-		void MFVSCR(u32 vd) override;
-		void MTVSCR(u32 vb) override;
-		void VADDCUW(u32 vd, u32 va, u32 vb) override;
-		void VADDFP(u32 vd, u32 va, u32 vb) override;
-		void VADDSBS(u32 vd, u32 va, u32 vb) override;
-		void VADDSHS(u32 vd, u32 va, u32 vb) override;
-		void VADDSWS(u32 vd, u32 va, u32 vb) override;
-		void VADDUBM(u32 vd, u32 va, u32 vb) override;
-		void VADDUBS(u32 vd, u32 va, u32 vb) override;
-		void VADDUHM(u32 vd, u32 va, u32 vb) override;
-		void VADDUHS(u32 vd, u32 va, u32 vb) override;
-		void VADDUWM(u32 vd, u32 va, u32 vb) override;
-		void VADDUWS(u32 vd, u32 va, u32 vb) override;
-		void VAND(u32 vd, u32 va, u32 vb) override;
-		void VANDC(u32 vd, u32 va, u32 vb) override;
-		void VAVGSB(u32 vd, u32 va, u32 vb) override;
-		void VAVGSH(u32 vd, u32 va, u32 vb) override;
-		void VAVGSW(u32 vd, u32 va, u32 vb) override;
-		void VAVGUB(u32 vd, u32 va, u32 vb) override;
-		void VAVGUH(u32 vd, u32 va, u32 vb) override;
-		void VAVGUW(u32 vd, u32 va, u32 vb) override;
-		void VCFSX(u32 vd, u32 uimm5, u32 vb) override;
-		void VCFUX(u32 vd, u32 uimm5, u32 vb) override;
-		void VCMPBFP(u32 vd, u32 va, u32 vb) override;
-		void VCMPBFP_(u32 vd, u32 va, u32 vb) override;
-		void VCMPEQFP(u32 vd, u32 va, u32 vb) override;
-		void VCMPEQFP_(u32 vd, u32 va, u32 vb) override;
-		void VCMPEQUB(u32 vd, u32 va, u32 vb) override;
-		void VCMPEQUB_(u32 vd, u32 va, u32 vb) override;
-		void VCMPEQUH(u32 vd, u32 va, u32 vb) override;
-		void VCMPEQUH_(u32 vd, u32 va, u32 vb) override;
-		void VCMPEQUW(u32 vd, u32 va, u32 vb) override;
-		void VCMPEQUW_(u32 vd, u32 va, u32 vb) override;
-		void VCMPGEFP(u32 vd, u32 va, u32 vb) override;
-		void VCMPGEFP_(u32 vd, u32 va, u32 vb) override;
-		void VCMPGTFP(u32 vd, u32 va, u32 vb) override;
-		void VCMPGTFP_(u32 vd, u32 va, u32 vb) override;
-		void VCMPGTSB(u32 vd, u32 va, u32 vb) override;
-		void VCMPGTSB_(u32 vd, u32 va, u32 vb) override;
-		void VCMPGTSH(u32 vd, u32 va, u32 vb) override;
-		void VCMPGTSH_(u32 vd, u32 va, u32 vb) override;
-		void VCMPGTSW(u32 vd, u32 va, u32 vb) override;
-		void VCMPGTSW_(u32 vd, u32 va, u32 vb) override;
-		void VCMPGTUB(u32 vd, u32 va, u32 vb) override;
-		void VCMPGTUB_(u32 vd, u32 va, u32 vb) override;
-		void VCMPGTUH(u32 vd, u32 va, u32 vb) override;
-		void VCMPGTUH_(u32 vd, u32 va, u32 vb) override;
-		void VCMPGTUW(u32 vd, u32 va, u32 vb) override;
-		void VCMPGTUW_(u32 vd, u32 va, u32 vb) override;
-		void VCTSXS(u32 vd, u32 uimm5, u32 vb) override;
-		void VCTUXS(u32 vd, u32 uimm5, u32 vb) override;
-		void VEXPTEFP(u32 vd, u32 vb) override;
-		void VLOGEFP(u32 vd, u32 vb) override;
-		void VMADDFP(u32 vd, u32 va, u32 vc, u32 vb) override;
-		void VMAXFP(u32 vd, u32 va, u32 vb) override;
-		void VMAXSB(u32 vd, u32 va, u32 vb) override;
-		void VMAXSH(u32 vd, u32 va, u32 vb) override;
-		void VMAXSW(u32 vd, u32 va, u32 vb) override;
-		void VMAXUB(u32 vd, u32 va, u32 vb) override;
-		void VMAXUH(u32 vd, u32 va, u32 vb) override;
-		void VMAXUW(u32 vd, u32 va, u32 vb) override;
-		void VMHADDSHS(u32 vd, u32 va, u32 vb, u32 vc) override;
-		void VMHRADDSHS(u32 vd, u32 va, u32 vb, u32 vc) override;
-		void VMINFP(u32 vd, u32 va, u32 vb) override;
-		void VMINSB(u32 vd, u32 va, u32 vb) override;
-		void VMINSH(u32 vd, u32 va, u32 vb) override;
-		void VMINSW(u32 vd, u32 va, u32 vb) override;
-		void VMINUB(u32 vd, u32 va, u32 vb) override;
-		void VMINUH(u32 vd, u32 va, u32 vb) override;
-		void VMINUW(u32 vd, u32 va, u32 vb) override;
-		void VMLADDUHM(u32 vd, u32 va, u32 vb, u32 vc) override;
-		void VMRGHB(u32 vd, u32 va, u32 vb) override;
-		void VMRGHH(u32 vd, u32 va, u32 vb) override;
-		void VMRGHW(u32 vd, u32 va, u32 vb) override;
-		void VMRGLB(u32 vd, u32 va, u32 vb) override;
-		void VMRGLH(u32 vd, u32 va, u32 vb) override;
-		void VMRGLW(u32 vd, u32 va, u32 vb) override;
-		void VMSUMMBM(u32 vd, u32 va, u32 vb, u32 vc) override;
-		void VMSUMSHM(u32 vd, u32 va, u32 vb, u32 vc) override;
-		void VMSUMSHS(u32 vd, u32 va, u32 vb, u32 vc) override;
-		void VMSUMUBM(u32 vd, u32 va, u32 vb, u32 vc) override;
-		void VMSUMUHM(u32 vd, u32 va, u32 vb, u32 vc) override;
-		void VMSUMUHS(u32 vd, u32 va, u32 vb, u32 vc) override;
-		void VMULESB(u32 vd, u32 va, u32 vb) override;
-		void VMULESH(u32 vd, u32 va, u32 vb) override;
-		void VMULEUB(u32 vd, u32 va, u32 vb) override;
-		void VMULEUH(u32 vd, u32 va, u32 vb) override;
-		void VMULOSB(u32 vd, u32 va, u32 vb) override;
-		void VMULOSH(u32 vd, u32 va, u32 vb) override;
-		void VMULOUB(u32 vd, u32 va, u32 vb) override;
-		void VMULOUH(u32 vd, u32 va, u32 vb) override;
-		void VNMSUBFP(u32 vd, u32 va, u32 vc, u32 vb) override;
-		void VNOR(u32 vd, u32 va, u32 vb) override;
-		void VOR(u32 vd, u32 va, u32 vb) override;
-		void VPERM(u32 vd, u32 va, u32 vb, u32 vc) override;
-		void VPKPX(u32 vd, u32 va, u32 vb) override;
-		void VPKSHSS(u32 vd, u32 va, u32 vb) override;
-		void VPKSHUS(u32 vd, u32 va, u32 vb) override;
-		void VPKSWSS(u32 vd, u32 va, u32 vb) override;
-		void VPKSWUS(u32 vd, u32 va, u32 vb) override;
-		void VPKUHUM(u32 vd, u32 va, u32 vb) override;
-		void VPKUHUS(u32 vd, u32 va, u32 vb) override;
-		void VPKUWUM(u32 vd, u32 va, u32 vb) override;
-		void VPKUWUS(u32 vd, u32 va, u32 vb) override;
-		void VREFP(u32 vd, u32 vb) override;
-		void VRFIM(u32 vd, u32 vb) override;
-		void VRFIN(u32 vd, u32 vb) override;
-		void VRFIP(u32 vd, u32 vb) override;
-		void VRFIZ(u32 vd, u32 vb) override;
-		void VRLB(u32 vd, u32 va, u32 vb) override;
-		void VRLH(u32 vd, u32 va, u32 vb) override;
-		void VRLW(u32 vd, u32 va, u32 vb) override;
-		void VRSQRTEFP(u32 vd, u32 vb) override;
-		void VSEL(u32 vd, u32 va, u32 vb, u32 vc) override;
-		void VSL(u32 vd, u32 va, u32 vb) override;
-		void VSLB(u32 vd, u32 va, u32 vb) override;
-		void VSLDOI(u32 vd, u32 va, u32 vb, u32 sh) override;
-		void VSLH(u32 vd, u32 va, u32 vb) override;
-		void VSLO(u32 vd, u32 va, u32 vb) override;
-		void VSLW(u32 vd, u32 va, u32 vb) override;
-		void VSPLTB(u32 vd, u32 uimm5, u32 vb) override;
-		void VSPLTH(u32 vd, u32 uimm5, u32 vb) override;
-		void VSPLTISB(u32 vd, s32 simm5) override;
-		void VSPLTISH(u32 vd, s32 simm5) override;
-		void VSPLTISW(u32 vd, s32 simm5) override;
-		void VSPLTW(u32 vd, u32 uimm5, u32 vb) override;
-		void VSR(u32 vd, u32 va, u32 vb) override;
-		void VSRAB(u32 vd, u32 va, u32 vb) override;
-		void VSRAH(u32 vd, u32 va, u32 vb) override;
-		void VSRAW(u32 vd, u32 va, u32 vb) override;
-		void VSRB(u32 vd, u32 va, u32 vb) override;
-		void VSRH(u32 vd, u32 va, u32 vb) override;
-		void VSRO(u32 vd, u32 va, u32 vb) override;
-		void VSRW(u32 vd, u32 va, u32 vb) override;
-		void VSUBCUW(u32 vd, u32 va, u32 vb) override;
-		void VSUBFP(u32 vd, u32 va, u32 vb) override;
-		void VSUBSBS(u32 vd, u32 va, u32 vb) override;
-		void VSUBSHS(u32 vd, u32 va, u32 vb) override;
-		void VSUBSWS(u32 vd, u32 va, u32 vb) override;
-		void VSUBUBM(u32 vd, u32 va, u32 vb) override;
-		void VSUBUBS(u32 vd, u32 va, u32 vb) override;
-		void VSUBUHM(u32 vd, u32 va, u32 vb) override;
-		void VSUBUHS(u32 vd, u32 va, u32 vb) override;
-		void VSUBUWM(u32 vd, u32 va, u32 vb) override;
-		void VSUBUWS(u32 vd, u32 va, u32 vb) override;
-		void VSUMSWS(u32 vd, u32 va, u32 vb) override;
-		void VSUM2SWS(u32 vd, u32 va, u32 vb) override;
-		void VSUM4SBS(u32 vd, u32 va, u32 vb) override;
-		void VSUM4SHS(u32 vd, u32 va, u32 vb) override;
-		void VSUM4UBS(u32 vd, u32 va, u32 vb) override;
-		void VUPKHPX(u32 vd, u32 vb) override;
-		void VUPKHSB(u32 vd, u32 vb) override;
-		void VUPKHSH(u32 vd, u32 vb) override;
-		void VUPKLPX(u32 vd, u32 vb) override;
-		void VUPKLSB(u32 vd, u32 vb) override;
-		void VUPKLSH(u32 vd, u32 vb) override;
-		void VXOR(u32 vd, u32 va, u32 vb) override;
-		void MULLI(u32 rd, u32 ra, s32 simm16) override;
-		void SUBFIC(u32 rd, u32 ra, s32 simm16) override;
-		void CMPLI(u32 bf, u32 l, u32 ra, u32 uimm16) override;
-		void CMPI(u32 bf, u32 l, u32 ra, s32 simm16) override;
-		void ADDIC(u32 rd, u32 ra, s32 simm16) override;
-		void ADDIC_(u32 rd, u32 ra, s32 simm16) override;
-		void ADDI(u32 rd, u32 ra, s32 simm16) override;
-		void ADDIS(u32 rd, u32 ra, s32 simm16) override;
-		void BC(u32 bo, u32 bi, s32 bd, u32 aa, u32 lk) override;
-		void HACK(u32 id) override;
-		void SC(u32 sc_code) override;
-		void B(s32 ll, u32 aa, u32 lk) override;
-		void MCRF(u32 crfd, u32 crfs) override;
-		void BCLR(u32 bo, u32 bi, u32 bh, u32 lk) override;
-		void CRNOR(u32 bt, u32 ba, u32 bb) override;
-		void CRANDC(u32 bt, u32 ba, u32 bb) override;
-		void ISYNC() override;
-		void CRXOR(u32 bt, u32 ba, u32 bb) override;
-		void CRNAND(u32 bt, u32 ba, u32 bb) override;
-		void CRAND(u32 bt, u32 ba, u32 bb) override;
-		void CREQV(u32 bt, u32 ba, u32 bb) override;
-		void CRORC(u32 bt, u32 ba, u32 bb) override;
-		void CROR(u32 bt, u32 ba, u32 bb) override;
-		void BCCTR(u32 bo, u32 bi, u32 bh, u32 lk) override;
-		void RLWIMI(u32 ra, u32 rs, u32 sh, u32 mb, u32 me, u32 rc) override;
-		void RLWINM(u32 ra, u32 rs, u32 sh, u32 mb, u32 me, u32 rc) override;
-		void RLWNM(u32 ra, u32 rs, u32 rb, u32 MB, u32 ME, u32 rc) override;
-		void ORI(u32 rs, u32 ra, u32 uimm16) override;
-		void ORIS(u32 rs, u32 ra, u32 uimm16) override;
-		void XORI(u32 ra, u32 rs, u32 uimm16) override;
-		void XORIS(u32 ra, u32 rs, u32 uimm16) override;
-		void ANDI_(u32 ra, u32 rs, u32 uimm16) override;
-		void ANDIS_(u32 ra, u32 rs, u32 uimm16) override;
-		void RLDICL(u32 ra, u32 rs, u32 sh, u32 mb, u32 rc) override;
-		void RLDICR(u32 ra, u32 rs, u32 sh, u32 me, u32 rc) override;
-		void RLDIC(u32 ra, u32 rs, u32 sh, u32 mb, u32 rc) override;
-		void RLDIMI(u32 ra, u32 rs, u32 sh, u32 mb, u32 rc) override;
-		void RLDC_LR(u32 ra, u32 rs, u32 rb, u32 m_eb, u32 is_r, u32 rc) override;
-		void CMP(u32 crfd, u32 l, u32 ra, u32 rb) override;
-		void TW(u32 to, u32 ra, u32 rb) override;
-		void LVSL(u32 vd, u32 ra, u32 rb) override;
-		void LVEBX(u32 vd, u32 ra, u32 rb) override;
-		void SUBFC(u32 rd, u32 ra, u32 rb, u32 oe, u32 rc) override;
-		void MULHDU(u32 rd, u32 ra, u32 rb, u32 rc) override;
-		void ADDC(u32 rd, u32 ra, u32 rb, u32 oe, u32 rc) override;
-		void MULHWU(u32 rd, u32 ra, u32 rb, u32 rc) override;
-		void MFOCRF(u32 a, u32 rd, u32 crm) override;
-		void LWARX(u32 rd, u32 ra, u32 rb) override;
-		void LDX(u32 ra, u32 rs, u32 rb) override;
-		void LWZX(u32 rd, u32 ra, u32 rb) override;
-		void SLW(u32 ra, u32 rs, u32 rb, u32 rc) override;
-		void CNTLZW(u32 ra, u32 rs, u32 rc) override;
-		void SLD(u32 ra, u32 rs, u32 rb, u32 rc) override;
-		void AND(u32 ra, u32 rs, u32 rb, u32 rc) override;
-		void CMPL(u32 bf, u32 l, u32 ra, u32 rb) override;
-		void LVSR(u32 vd, u32 ra, u32 rb) override;
-		void LVEHX(u32 vd, u32 ra, u32 rb) override;
-		void SUBF(u32 rd, u32 ra, u32 rb, u32 oe, u32 rc) override;
-		void LDUX(u32 rd, u32 ra, u32 rb) override;
-		void DCBST(u32 ra, u32 rb) override;
-		void LWZUX(u32 rd, u32 ra, u32 rb) override;
-		void CNTLZD(u32 ra, u32 rs, u32 rc) override;
-		void ANDC(u32 ra, u32 rs, u32 rb, u32 rc) override;
-		void TD(u32 to, u32 ra, u32 rb) override;
-		void LVEWX(u32 vd, u32 ra, u32 rb) override;
-		void MULHD(u32 rd, u32 ra, u32 rb, u32 rc) override;
-		void MULHW(u32 rd, u32 ra, u32 rb, u32 rc) override;
-		void LDARX(u32 rd, u32 ra, u32 rb) override;
-		void DCBF(u32 ra, u32 rb) override;
-		void LBZX(u32 rd, u32 ra, u32 rb) override;
-		void LVX(u32 vd, u32 ra, u32 rb) override;
-		void NEG(u32 rd, u32 ra, u32 oe, u32 rc) override;
-		void LBZUX(u32 rd, u32 ra, u32 rb) override;
-		void NOR(u32 ra, u32 rs, u32 rb, u32 rc) override;
-		void STVEBX(u32 vs, u32 ra, u32 rb) override;
-		void SUBFE(u32 rd, u32 ra, u32 rb, u32 oe, u32 rc) override;
-		void ADDE(u32 rd, u32 ra, u32 rb, u32 oe, u32 rc) override;
-		void MTOCRF(u32 l, u32 crm, u32 rs) override;
-		void STDX(u32 rs, u32 ra, u32 rb) override;
-		void STWCX_(u32 rs, u32 ra, u32 rb) override;
-		void STWX(u32 rs, u32 ra, u32 rb) override;
-		void STVEHX(u32 vs, u32 ra, u32 rb) override;
-		void STDUX(u32 rs, u32 ra, u32 rb) override;
-		void STWUX(u32 rs, u32 ra, u32 rb) override;
-		void STVEWX(u32 vs, u32 ra, u32 rb) override;
-		void SUBFZE(u32 rd, u32 ra, u32 oe, u32 rc) override;
-		void ADDZE(u32 rd, u32 ra, u32 oe, u32 rc) override;
-		void STDCX_(u32 rs, u32 ra, u32 rb) override;
-		void STBX(u32 rs, u32 ra, u32 rb) override;
-		void STVX(u32 vs, u32 ra, u32 rb) override;
-		void MULLD(u32 rd, u32 ra, u32 rb, u32 oe, u32 rc) override;
-		void SUBFME(u32 rd, u32 ra, u32 oe, u32 rc) override;
-		void ADDME(u32 rd, u32 ra, u32 oe, u32 rc) override;
-		void MULLW(u32 rd, u32 ra, u32 rb, u32 oe, u32 rc) override;
-		void DCBTST(u32 ra, u32 rb, u32 th) override;
-		void STBUX(u32 rs, u32 ra, u32 rb) override;
-		void ADD(u32 rd, u32 ra, u32 rb, u32 oe, u32 rc) override;
-		void DCBT(u32 ra, u32 rb, u32 th) override;
-		void LHZX(u32 rd, u32 ra, u32 rb) override;
-		void EQV(u32 ra, u32 rs, u32 rb, u32 rc) override;
-		void ECIWX(u32 rd, u32 ra, u32 rb) override;
-		void LHZUX(u32 rd, u32 ra, u32 rb) override;
-		void XOR(u32 rs, u32 ra, u32 rb, u32 rc) override;
-		void MFSPR(u32 rd, u32 spr) override;
-		void LWAX(u32 rd, u32 ra, u32 rb) override;
-		void DST(u32 ra, u32 rb, u32 strm, u32 t) override;
-		void LHAX(u32 rd, u32 ra, u32 rb) override;
-		void LVXL(u32 vd, u32 ra, u32 rb) override;
-		void MFTB(u32 rd, u32 spr) override;
-		void LWAUX(u32 rd, u32 ra, u32 rb) override;
-		void DSTST(u32 ra, u32 rb, u32 strm, u32 t) override;
-		void LHAUX(u32 rd, u32 ra, u32 rb) override;
-		void STHX(u32 rs, u32 ra, u32 rb) override;
-		void ORC(u32 rs, u32 ra, u32 rb, u32 rc) override;
-		void ECOWX(u32 rs, u32 ra, u32 rb) override;
-		void STHUX(u32 rs, u32 ra, u32 rb) override;
-		void OR(u32 ra, u32 rs, u32 rb, u32 rc) override;
-		void DIVDU(u32 rd, u32 ra, u32 rb, u32 oe, u32 rc) override;
-		void DIVWU(u32 rd, u32 ra, u32 rb, u32 oe, u32 rc) override;
-		void MTSPR(u32 spr, u32 rs) override;
-		void DCBI(u32 ra, u32 rb) override;
-		void NAND(u32 ra, u32 rs, u32 rb, u32 rc) override;
-		void STVXL(u32 vs, u32 ra, u32 rb) override;
-		void DIVD(u32 rd, u32 ra, u32 rb, u32 oe, u32 rc) override;
-		void DIVW(u32 rd, u32 ra, u32 rb, u32 oe, u32 rc) override;
-		void LVLX(u32 vd, u32 ra, u32 rb) override;
-		void LDBRX(u32 rd, u32 ra, u32 rb) override;
-		void LSWX(u32 rd, u32 ra, u32 rb) override;
-		void LWBRX(u32 rd, u32 ra, u32 rb) override;
-		void LFSX(u32 frd, u32 ra, u32 rb) override;
-		void SRW(u32 ra, u32 rs, u32 rb, u32 rc) override;
-		void SRD(u32 ra, u32 rs, u32 rb, u32 rc) override;
-		void LVRX(u32 vd, u32 ra, u32 rb) override;
-		void LSWI(u32 rd, u32 ra, u32 nb) override;
-		void LFSUX(u32 frd, u32 ra, u32 rb) override;
-		void SYNC(u32 l) override;
-		void LFDX(u32 frd, u32 ra, u32 rb) override;
-		void LFDUX(u32 frd, u32 ra, u32 rb) override;
-		void STVLX(u32 vs, u32 ra, u32 rb) override;
-		void STDBRX(u32 rd, u32 ra, u32 rb) override;
-		void STSWX(u32 rs, u32 ra, u32 rb) override;
-		void STWBRX(u32 rs, u32 ra, u32 rb) override;
-		void STFSX(u32 frs, u32 ra, u32 rb) override;
-		void STVRX(u32 vs, u32 ra, u32 rb) override;
-		void STFSUX(u32 frs, u32 ra, u32 rb) override;
-		void STSWI(u32 rd, u32 ra, u32 nb) override;
-		void STFDX(u32 frs, u32 ra, u32 rb) override;
-		void STFDUX(u32 frs, u32 ra, u32 rb) override;
-		void LVLXL(u32 vd, u32 ra, u32 rb) override;
-		void LHBRX(u32 rd, u32 ra, u32 rb) override;
-		void SRAW(u32 ra, u32 rs, u32 rb, u32 rc) override;
-		void SRAD(u32 ra, u32 rs, u32 rb, u32 rc) override;
-		void LVRXL(u32 vd, u32 ra, u32 rb) override;
-		void DSS(u32 strm, u32 a) override;
-		void SRAWI(u32 ra, u32 rs, u32 sh, u32 rc) override;
-		void SRADI1(u32 ra, u32 rs, u32 sh, u32 rc) override;
-		void SRADI2(u32 ra, u32 rs, u32 sh, u32 rc) override;
-		void EIEIO() override;
-		void STVLXL(u32 vs, u32 ra, u32 rb) override;
-		void STHBRX(u32 rs, u32 ra, u32 rb) override;
-		void EXTSH(u32 ra, u32 rs, u32 rc) override;
-		void STVRXL(u32 sd, u32 ra, u32 rb) override;
-		void EXTSB(u32 ra, u32 rs, u32 rc) override;
-		void STFIWX(u32 frs, u32 ra, u32 rb) override;
-		void EXTSW(u32 ra, u32 rs, u32 rc) override;
-		void ICBI(u32 ra, u32 rb) override;
-		void DCBZ(u32 ra, u32 rb) override;
-		void LWZ(u32 rd, u32 ra, s32 d) override;
-		void LWZU(u32 rd, u32 ra, s32 d) override;
-		void LBZ(u32 rd, u32 ra, s32 d) override;
-		void LBZU(u32 rd, u32 ra, s32 d) override;
-		void STW(u32 rs, u32 ra, s32 d) override;
-		void STWU(u32 rs, u32 ra, s32 d) override;
-		void STB(u32 rs, u32 ra, s32 d) override;
-		void STBU(u32 rs, u32 ra, s32 d) override;
-		void LHZ(u32 rd, u32 ra, s32 d) override;
-		void LHZU(u32 rd, u32 ra, s32 d) override;
-		void LHA(u32 rs, u32 ra, s32 d) override;
-		void LHAU(u32 rs, u32 ra, s32 d) override;
-		void STH(u32 rs, u32 ra, s32 d) override;
-		void STHU(u32 rs, u32 ra, s32 d) override;
-		void LMW(u32 rd, u32 ra, s32 d) override;
-		void STMW(u32 rs, u32 ra, s32 d) override;
-		void LFS(u32 frd, u32 ra, s32 d) override;
-		void LFSU(u32 frd, u32 ra, s32 d) override;
-		void LFD(u32 frd, u32 ra, s32 d) override;
-		void LFDU(u32 frd, u32 ra, s32 d) override;
-		void STFS(u32 frs, u32 ra, s32 d) override;
-		void STFSU(u32 frs, u32 ra, s32 d) override;
-		void STFD(u32 frs, u32 ra, s32 d) override;
-		void STFDU(u32 frs, u32 ra, s32 d) override;
-		void LD(u32 rd, u32 ra, s32 ds) override;
-		void LDU(u32 rd, u32 ra, s32 ds) override;
-		void LWA(u32 rd, u32 ra, s32 ds) override;
-		void FDIVS(u32 frd, u32 fra, u32 frb, u32 rc) override;
-		void FSUBS(u32 frd, u32 fra, u32 frb, u32 rc) override;
-		void FADDS(u32 frd, u32 fra, u32 frb, u32 rc) override;
-		void FSQRTS(u32 frd, u32 frb, u32 rc) override;
-		void FRES(u32 frd, u32 frb, u32 rc) override;
-		void FMULS(u32 frd, u32 fra, u32 frc, u32 rc) override;
-		void FMADDS(u32 frd, u32 fra, u32 frc, u32 frb, u32 rc) override;
-		void FMSUBS(u32 frd, u32 fra, u32 frc, u32 frb, u32 rc) override;
-		void FNMSUBS(u32 frd, u32 fra, u32 frc, u32 frb, u32 rc) override;
-		void FNMADDS(u32 frd, u32 fra, u32 frc, u32 frb, u32 rc) override;
-		void STD(u32 rs, u32 ra, s32 ds) override;
-		void STDU(u32 rs, u32 ra, s32 ds) override;
-		void MTFSB1(u32 bt, u32 rc) override;
-		void MCRFS(u32 bf, u32 bfa) override;
-		void MTFSB0(u32 bt, u32 rc) override;
-		void MTFSFI(u32 crfd, u32 i, u32 rc) override;
-		void MFFS(u32 frd, u32 rc) override;
-		void MTFSF(u32 flm, u32 frb, u32 rc) override;
-
-		void FCMPU(u32 bf, u32 fra, u32 frb) override;
-		void FRSP(u32 frd, u32 frb, u32 rc) override;
-		void FCTIW(u32 frd, u32 frb, u32 rc) override;
-		void FCTIWZ(u32 frd, u32 frb, u32 rc) override;
-		void FDIV(u32 frd, u32 fra, u32 frb, u32 rc) override;
-		void FSUB(u32 frd, u32 fra, u32 frb, u32 rc) override;
-		void FADD(u32 frd, u32 fra, u32 frb, u32 rc) override;
-		void FSQRT(u32 frd, u32 frb, u32 rc) override;
-		void FSEL(u32 frd, u32 fra, u32 frc, u32 frb, u32 rc) override;
-		void FMUL(u32 frd, u32 fra, u32 frc, u32 rc) override;
-		void FRSQRTE(u32 frd, u32 frb, u32 rc) override;
-		void FMSUB(u32 frd, u32 fra, u32 frc, u32 frb, u32 rc) override;
-		void FMADD(u32 frd, u32 fra, u32 frc, u32 frb, u32 rc) override;
-		void FNMSUB(u32 frd, u32 fra, u32 frc, u32 frb, u32 rc) override;
-		void FNMADD(u32 frd, u32 fra, u32 frc, u32 frb, u32 rc) override;
-		void FCMPO(u32 crfd, u32 fra, u32 frb) override;
-		void FNEG(u32 frd, u32 frb, u32 rc) override;
-		void FMR(u32 frd, u32 frb, u32 rc) override;
-		void FNABS(u32 frd, u32 frb, u32 rc) override;
-		void FABS(u32 frd, u32 frb, u32 rc) override;
-		void FCTID(u32 frd, u32 frb, u32 rc) override;
-		void FCTIDZ(u32 frd, u32 frb, u32 rc) override;
-		void FCFID(u32 frd, u32 frb, u32 rc) override;
-
-		void UNK(const u32 code, const u32 opcode, const u32 gcode) override;
-
-		/// Utility function creating a function called name with Executable signature
-		void initiate_function(const std::string &name);
-
-	protected:
-		/// State of a compilation task
-		struct CompileTaskState {
-			enum Args {
-				State,
-				Context,
-				MaxArgs,
-			};
-
-			/// The LLVM function for the compilation task
-			llvm::Function * function;
-
-			/// Args of the LLVM function
-			llvm::Value * args[MaxArgs];
-
-			/// Address of the current instruction being compiled
-			u32 current_instruction_address;
-
-			/// A flag used to detect branch instructions.
-			/// This is set to false at the start of compilation of an instruction.
-			/// If a branch instruction is encountered, this is set to true by the decode function.
-			bool hit_branch_instruction;
-		};
-
-		/// The function that will be called to execute unknown functions
-		llvm::Function * m_execute_unknown_function;
-
-		/// The executable that will be called to execute unknown blocks
-		llvm::Function *  m_execute_unknown_block;
-
-		/// Maps function name to executable memory pointer
-		std::unordered_map<std::string, void*> &m_executable_map;
-
-		/// LLVM context
-		llvm::LLVMContext * m_llvm_context;
-
-		/// LLVM IR builder
-		llvm::IRBuilder<> * m_ir_builder;
-
-		/// Module to which all generated code is output to
-		llvm::Module * m_module;
-
-		/// LLVM type of the functions genreated by the compiler
-		llvm::FunctionType * m_compiled_function_type;
-
-		/// State of the current compilation task
-		CompileTaskState m_state;
-
-		/// Get the name of the basic block for the specified address
-		std::string GetBasicBlockNameFromAddress(u32 address, const std::string & suffix = "") const;
-
-		/// Get the address of a basic block from its name
-		u32 GetAddressFromBasicBlockName(const std::string & name) const;
-
-		/// Get the basic block in for the specified address.
-		llvm::BasicBlock * GetBasicBlockFromAddress(u32 address, const std::string & suffix = "", bool create_if_not_exist = true);
-
-		/// Get a bit
-		llvm::Value * GetBit(llvm::Value * val, u32 n);
-
-		/// Clear a bit
-		llvm::Value * ClrBit(llvm::Value * val, u32 n);
-
-		/// Set a bit
-		llvm::Value * SetBit(llvm::Value * val, u32 n, llvm::Value * bit, bool doClear = true);
-
-		/// Get a nibble
-		llvm::Value * GetNibble(llvm::Value * val, u32 n);
-
-		/// Clear a nibble
-		llvm::Value * ClrNibble(llvm::Value * val, u32 n);
-
-		/// Set a nibble
-		llvm::Value * SetNibble(llvm::Value * val, u32 n, llvm::Value * nibble, bool doClear = true);
-
-		/// Set a nibble
-		llvm::Value * SetNibble(llvm::Value * val, u32 n, llvm::Value * b0, llvm::Value * b1, llvm::Value * b2, llvm::Value * b3, bool doClear = true);
-
-		/// Load PC
-		llvm::Value * GetPc();
-
-		/// Set PC
-		void SetPc(llvm::Value * val_ix);
-
-		/// Load GPR
-		llvm::Value * GetGpr(u32 r, u32 num_bits = 64);
-
-		/// Set GPR
-		void SetGpr(u32 r, llvm::Value * val_x64);
-
-		/// Load CR
-		llvm::Value * GetCr();
-
-		/// Load CR and get field CRn
-		llvm::Value * GetCrField(u32 n);
-
-		/// Set CR
-		void SetCr(llvm::Value * val_x32);
-
-		/// Set CR field
-		void SetCrField(u32 n, llvm::Value * field);
-
-		/// Set CR field
-		void SetCrField(u32 n, llvm::Value * b0, llvm::Value * b1, llvm::Value * b2, llvm::Value * b3);
-
-		/// Set CR field based on signed comparison
-		void SetCrFieldSignedCmp(u32 n, llvm::Value * a, llvm::Value * b);
-
-		/// Set CR field based on unsigned comparison
-		void SetCrFieldUnsignedCmp(u32 n, llvm::Value * a, llvm::Value * b);
-
-		/// Set CR6 based on the result of the vector compare instruction
-		void SetCr6AfterVectorCompare(u32 vr);
-
-		/// Get LR
-		llvm::Value * GetLr();
-
-		/// Set LR
-		void SetLr(llvm::Value * val_x64);
-
-		/// Get CTR
-		llvm::Value * GetCtr();
-
-		/// Set CTR
-		void SetCtr(llvm::Value * val_x64);
-
-		/// Load XER and convert it to an i64
-		llvm::Value * GetXer();
-
-		/// Load XER and return the CA bit
-		llvm::Value * GetXerCa();
-
-		/// Load XER and return the SO bit
-		llvm::Value * GetXerSo();
-
-		/// Set XER
-		void SetXer(llvm::Value * val_x64);
-
-		/// Set the CA bit of XER
-		void SetXerCa(llvm::Value * ca);
-
-		/// Set the SO bit of XER
-		void SetXerSo(llvm::Value * so);
-
-		/// Get VRSAVE
-		llvm::Value * GetVrsave();
-
-		/// Set VRSAVE
-		void SetVrsave(llvm::Value * val_x64);
-
-		/// Load FPSCR
-		llvm::Value * GetFpscr();
-
-		/// Set FPSCR
-		void SetFpscr(llvm::Value * val_x32);
-
-		/// Get FPR
-		llvm::Value * GetFpr(u32 r, u32 bits = 64, bool as_int = false);
-
-		/// Set FPR
-		void SetFpr(u32 r, llvm::Value * val);
-
-		/// Load VSCR
-		llvm::Value * GetVscr();
-
-		/// Set VSCR
-		void SetVscr(llvm::Value * val_x32);
-
-		/// Load VR
-		llvm::Value * GetVr(u32 vr);
-
-		/// Load VR and convert it to an integer vector
-		llvm::Value * GetVrAsIntVec(u32 vr, u32 vec_elt_num_bits);
-
-		/// Load VR and convert it to a float vector with 4 elements
-		llvm::Value * GetVrAsFloatVec(u32 vr);
-
-		/// Load VR and convert it to a double vector with 2 elements
-		llvm::Value * GetVrAsDoubleVec(u32 vr);
-
-		/// Set VR to the specified value
-		void SetVr(u32 vr, llvm::Value * val_x128);
-
-		/// Check condition for branch instructions
-		llvm::Value * CheckBranchCondition(u32 bo, u32 bi);
-
-		/// Create IR for a branch instruction
-		void CreateBranch(llvm::Value * cmp_i1, llvm::Value * target_i32, bool lk, bool target_is_lr = false);
-
-		/// Read from memory
-		llvm::Value * ReadMemory(llvm::Value * addr_i64, u32 bits, u32 alignment = 0, bool bswap = true, bool could_be_mmio = true);
-
-		/// Write to memory
-		void WriteMemory(llvm::Value * addr_i64, llvm::Value * val_ix, u32 alignment = 0, bool bswap = true, bool could_be_mmio = true);
-
-		/// Convert a C++ type to an LLVM type
-		template<class T>
-		llvm::Type * CppToLlvmType() {
-			if (std::is_void<T>::value) {
-				return m_ir_builder->getVoidTy();
-			}
-			else if (std::is_same<T, long long>::value || std::is_same<T, unsigned long long>::value) {
-				return m_ir_builder->getInt64Ty();
-			}
-			else if (std::is_same<T, int>::value || std::is_same<T, unsigned int>::value) {
-				return m_ir_builder->getInt32Ty();
-			}
-			else if (std::is_same<T, short>::value || std::is_same<T, unsigned short>::value) {
-				return m_ir_builder->getInt16Ty();
-			}
-			else if (std::is_same<T, char>::value || std::is_same<T, unsigned char>::value) {
-				return m_ir_builder->getInt8Ty();
-			}
-			else if (std::is_same<T, float>::value) {
-				return m_ir_builder->getFloatTy();
-			}
-			else if (std::is_same<T, double>::value) {
-				return m_ir_builder->getDoubleTy();
-			}
-			else if (std::is_same<T, bool>::value) {
-				return m_ir_builder->getInt1Ty();
-			}
-			else if (std::is_pointer<T>::value) {
-				return m_ir_builder->getInt8PtrTy();
-			}
-			else {
-				assert(0);
-			}
-
-			return nullptr;
-		}
-
-		/// Call a function
-		template<class ReturnType, class... Args>
-		llvm::Value * Call(const char * name, Args... args) {
-			auto fn = m_module->getFunction(name);
-			if (!fn) {
-				std::vector<llvm::Type *> fn_args_type = { args->getType()... };
-				auto fn_type = llvm::FunctionType::get(CppToLlvmType<ReturnType>(), fn_args_type, false);
-				fn = llvm::cast<llvm::Function>(m_module->getOrInsertFunction(name, fn_type));
-				fn->setCallingConv(llvm::CallingConv::X86_64_Win64);
-				// Create an entry in m_executable_map that will be populated outside of compiler
-				(void)m_executable_map[name];
-			}
-
-			std::vector<llvm::Value *> fn_args = { args... };
-			return m_ir_builder->CreateCall(fn, fn_args);
-		}
-
-		/// Handle compilation errors
-		void CompilationError(const std::string & error);
-
-		/// A mask used in rotate instructions
-		static u64 s_rotate_mask[64][64];
-
-		/// A flag indicating whether s_rotate_mask has been initialised or not
-		static bool s_rotate_mask_inited;
-
-		/// Initialse s_rotate_mask
-		static void InitRotateMask();
-	};
-
-	/**
-	 * Manages block compilation.
-	 * PPUInterpreter1 execution is traced (using Tracer class)
-	 * Periodically RecompilationEngine process traces result to find blocks
-	 * whose compilation can improve performances.
-	 * It then builds them asynchroneously and update the executable mapping
-	 * using atomic based locks to avoid undefined behavior.
-	 **/
-	class RecompilationEngine final : public named_thread_t {
-		friend class CPUHybridDecoderRecompiler;
-	public:
-		virtual ~RecompilationEngine() override;
-
-		/**
-		 * Get the executable for the specified address if a compiled version is
-		 * available, otherwise returns nullptr.
-		 **/
-		const Executable GetCompiledExecutableIfAvailable(u32 address) const;
-
-		/// Notify the recompilation engine about a newly detected block start.
-		void NotifyBlockStart(u32 address);
-
-		/// Log
-		llvm::raw_fd_ostream & Log();
-
-		std::string get_name() const override { return "PPU Recompilation Engine"; }
-
-		void on_task() override;
-
-		/// Get a pointer to the instance of this class
-		static std::shared_ptr<RecompilationEngine> GetInstance();
-
-	private:
-		/// An entry in the block table
-		struct BlockEntry {
-			/// Start address
-			u32 address;
-
-			/// Number of times this block was hit
-			u32 num_hits;
-
-			/// Indicates whether this function has been analysed or not
-			bool is_analysed;
-
-			/// Indicates whether the block has been compiled or not
-			bool is_compiled;
-
-			/// Indicate wheter the block is a function that can be completly compiled
-			/// that is, that has a clear "return" semantic and no indirect branch
-			bool is_compilable_function;
-
-			/// If the analysis was successfull, how long the block is.
-			u32 instructionCount;
-
-			/// If the analysis was successfull, which function does it call.
-			std::set<u32> calledFunctions;
-
-			BlockEntry(u32 start_address)
-				: num_hits(0)
-				, address(start_address)
-				, is_compiled(false)
-				, is_analysed(false)
-				, is_compilable_function(false)
-				, instructionCount(0) {
-			}
-
-			std::string ToString() const {
-				return fmt::format("0x%08X: NumHits=%u, IsCompiled=%c",
-					address, num_hits, is_compiled ? 'Y' : 'N');
-			}
-
-			bool operator == (const BlockEntry & other) const {
-				return address == other.address;
-			}
-		};
-
-		/// Log
-		llvm::raw_fd_ostream * m_log;
-
-		/// Lock for accessing m_pending_address_start. TODO: Eliminate this and use a lock-free queue.
-		std::mutex m_pending_address_start_lock;
-
-		/// Queue of block start address to process
-		std::list<u32> m_pending_address_start;
-
-		/// Block table
-		std::unordered_map<u32, BlockEntry> m_block_table;
-
-		int m_currentId;
-
-		/// (function, id).
-		typedef std::pair<Executable, u32> ExecutableStorageType;
-
-		/// Virtual memory allocated array.
-		/// Store pointer to every compiled function/block and a unique Id.
-		/// We need to map every instruction in PS3 Ram so it's a big table
-		/// But a lot of it won't be accessed. Fortunatly virtual memory help here...
-		ExecutableStorageType* FunctionCache;
-
-		// Bitfield recording page status in FunctionCache reserved memory.
-		char *FunctionCachePagesCommited;
-
-		bool isAddressCommited(u32) const;
-		void commitAddress(u32);
-
-		/// vector storing all exec engine
-		std::vector<std::unique_ptr<llvm::ExecutionEngine> > m_executable_storage;
-
-
-		/// LLVM context
-		llvm::LLVMContext &m_llvm_context;
-
-		/// LLVM IR builder
-		llvm::IRBuilder<> m_ir_builder;
-
-		/**
-		* Compile a code fragment described by a cfg and return an executable and the ExecutionEngine storing it
-		* Pointer to function can be retrieved with getPointerToFunction
-		*/
-		std::pair<Executable, llvm::ExecutionEngine *> compile(const std::string & name, u32 start_address, u32 instruction_count);
-
-		/// The time at which the m_address_to_ordinal cache was last cleared
-		std::chrono::high_resolution_clock::time_point m_last_cache_clear_time;
-
-		RecompilationEngine();
-
-		RecompilationEngine(const RecompilationEngine&) = delete; // Delete copy/move constructors and copy/move operators
-
-		/// Increase usage counter for block starting at addr and compile it if threshold was reached.
-		/// Returns true if block was compiled
-		bool IncreaseHitCounterAndBuild(u32 addr);
-
-		/**
-		* Analyse block to get useful info (function called, has indirect branch...)
-		* This code is inspired from Dolphin PPC Analyst
-		* Return true if analysis is successful.
-		*/
-		bool AnalyseBlock(BlockEntry &functionData, size_t maxSize = 10000);
-
-		/// Compile a block
-		void CompileBlock(BlockEntry & block_entry);
-
-		/// Mutex used to prevent multiple creation
-		static std::mutex s_mutex;
-
-		/// The instance
-		static std::shared_ptr<RecompilationEngine> s_the_instance;
-	};
-
-	/**
-	 * PPU execution engine
-	 * Relies on PPUInterpreter1 to execute uncompiled code.
-	 * Traces execution to determine which block to compile.
-	 * Use LLVM to compile block into native code.
-	 */
-	class CPUHybridDecoderRecompiler : public CPUDecoder {
-		friend class RecompilationEngine;
-		friend class Compiler;
-	public:
-		CPUHybridDecoderRecompiler(PPUThread & ppu);
-
-		CPUHybridDecoderRecompiler(const CPUHybridDecoderRecompiler&) = delete; // Delete copy/move constructors and copy/move operators
-
-		virtual ~CPUHybridDecoderRecompiler();
-
-		u32 DecodeMemory(const u32 address) override;
-
-	private:
-		/// PPU processor context
-		PPUThread & m_ppu;
-
-		/// PPU Interpreter
-		PPUInterpreter * m_interpreter;
-
-		/// PPU instruction Decoder
-		PPUDecoder m_decoder;
-
-		/// Recompilation engine
-		std::shared_ptr<RecompilationEngine> m_recompilation_engine;
-
-		/// Execute a function
-		static u32 ExecuteFunction(PPUThread * ppu_state, u64 context);
-
-		/// Execute till the current function returns
-		static u32 ExecuteTillReturn(PPUThread * ppu_state, u64 context);
-
-		/// Check thread status. Returns true if the thread must exit.
-		static bool PollStatus(PPUThread * ppu_state);
-	};
-
-	class CustomSectionMemoryManager : public llvm::SectionMemoryManager {
-	private:
-		std::unordered_map<std::string, void*> &executableMap;
-	public:
-		CustomSectionMemoryManager(std::unordered_map<std::string, void*> &map) :
-			executableMap(map)
-		{}
-		~CustomSectionMemoryManager() override {}
-
-		virtual uint64_t getSymbolAddress(const std::string &Name) override
-		{
-			std::unordered_map<std::string, void*>::const_iterator It = executableMap.find(Name);
-			if (It != executableMap.end())
-				return (uint64_t)It->second;
-			return getSymbolAddressInProcess(Name);
-		}
-	};
-}
-
-#endif // LLVM_AVAILABLE
-#endif // PPU_LLVM_RECOMPILER_H
+#ifndef PPU_LLVM_RECOMPILER_H
+#define PPU_LLVM_RECOMPILER_H
+
+#ifdef LLVM_AVAILABLE
+#define PPU_LLVM_RECOMPILER 1
+
+#include <list>
+#include "Emu/Cell/PPUDecoder.h"
+#include "Emu/Cell/PPUThread.h"
+#include "Emu/Cell/PPUInterpreter.h"
+#ifdef _MSC_VER
+#pragma warning(push, 0)
+#endif
+#include "llvm/ExecutionEngine/ExecutionEngine.h"
+#include "llvm/ExecutionEngine/ObjectCache.h"
+#include "llvm/ExecutionEngine/SectionMemoryManager.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/PassManager.h"
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+
+namespace ppu_recompiler_llvm {
+	enum ExecutionStatus
+	{
+		ExecutionStatusReturn = 0, ///< Block has hit a return, caller can continue execution
+		ExecutionStatusBlockEnded, ///< Block has been executed but no return was hit, at least another block must be executed before caller can continue
+		ExecutionStatusPropagateException, ///< an exception was thrown
+	};
+
+	class Compiler;
+	class RecompilationEngine;
+	class ObjectCache;
+	class ExecutionEngine;
+	struct PPUState;
+
+	enum class BranchType {
+		NonBranch,
+		LocalBranch,
+		FunctionCall,
+		Return,
+	};
+
+	/// Pointer to an executable
+	typedef u32(*Executable)(PPUThread * ppu_state, u64 context);
+
+	/// An entry of the FunctionCache of the recompilation engine (16 bytes, an entry shouldn't cross a page)
+	struct ExecutableStorageType {
+		/// Compiled function or block (nullptr if none)
+		Executable function;
+
+		/// Unique Id
+		u32 id;
+
+		/// Number of hits left before the block is compiled in the optimized tier (0 if it won't be)
+		u32 hits_left;
+	};
+
+	/// Parses PPU opcodes and translate them into llvm ir.
+	class Compiler : protected PPUOpcodes, protected PPCDecoder {
+	public:
+		/// If link_calls is set, calls to functions at immediate addresses go through their FunctionCache entry
+		/// (the ppu_function_cache symbol) and call the compiled function directly when it is available.
+		Compiler(llvm::LLVMContext *context, llvm::IRBuilder<> *builder, std::unordered_map<std::string, void*> &function_ptrs, bool link_calls = false);
+
+		Compiler(const Compiler&) = delete; // Delete copy/move constructors and copy/move operators
+
+		virtual ~Compiler();
+
+		/// Create a module setting target triples and some callbacks
+		static std::unique_ptr<llvm::Module> create_module(llvm::LLVMContext &llvm_context, const std::string & id = "Module");
+
+		/// Create a function called name in module and populates it by translating block at start_address with instruction_count length.
+		/// Calls to functions already translated in module (named fn_0x%08X) are direct.
+		void translate_to_llvm_ir(llvm::Module *module, const std::string & name, u32 start_address, u32 instruction_count);
+
+		/// Full optimization (optimized tier), functions called directly are inlined
+		static void optimise_module(llvm::Module *module);
+
+		/// Minimal optimization (fast tier)
+		static void optimise_module_fast(llvm::Module *module);
+
+		/// Get the address of the OPD of the LLE function called by an HLE function index (0 if it is executed as HLE)
+		static u32 GetLleFunction(u32 index);
+
+		/// Get the HLE function index of the import stub at address if the function is called directly from translated code (MFF_DIRECT_CALL), 0 otherwise
+		static u32 GetDirectCallIndex(u32 address);
+
+		/// Addresses of the functions whose FunctionCache entry is read by the translated code (entries must be committed before it runs)
+		const std::set<u32> & GetLinkedFunctions() const {
+			return m_linked_functions;
+		}
+
+	protected:
+		void Decode(const u32 code) override;
+
+		void NULL_OP() override;
+		void NOP() override;
+
+		void TDI(u32 to, u32 ra, s32 simm16) override;
+		void TWI(u32 to, u32 ra, s32 simm16) override;
+
+		void MFVSCR(u32 vd) override;
+		void MTVSCR(u32 vb) override;
+		void VADDCUW(u32 vd, u32 va, u32 vb) override;
+		void VADDFP(u32 vd, u32 va, u32 vb) override;
+		void VADDSBS(u32 vd, u32 va, u32 vb) override;
+		void VADDSHS(u32 vd, u32 va, u32 vb) override;
+		void VADDSWS(u32 vd, u32 va, u32 vb) override;
+		void VADDUBM(u32 vd, u32 va, u32 vb) override;
+		void VADDUBS(u32 vd, u32 va, u32 vb) override;
+		void VADDUHM(u32 vd, u32 va, u32 vb) override;
+		void VADDUHS(u32 vd, u32 va, u32 vb) override;
+		void VADDUWM(u32 vd, u32 va, u32 vb) override;
+		void VADDUWS(u32 vd, u32 va, u32 vb) override;
+		void VAND(u32 vd, u32 va, u32 vb) override;
+		void VANDC(u32 vd, u32 va, u32 vb) override;
+		void VAVGSB(u32 vd, u32 va, u32 vb) override;
+		void VAVGSH(u32 vd, u32 va, u32 vb) override;
+		void VAVGSW(u32 vd, u32 va, u32 vb) override;
+		void VAVGUB(u32 vd, u32 va, u32 vb) override;
+		void VAVGUH(u32 vd, u32 va, u32 vb) override;
+		void VAVGUW(u32 vd, u32 va, u32 vb) override;
+		void VCFSX(u32 vd, u32 uimm5, u32 vb) override;
+		void VCFUX(u32 vd, u32 uimm5, u32 vb) override;
+		void VCMPBFP(u32 vd, u32 va, u32 vb) override;
+		void VCMPBFP_(u32 vd, u32 va, u32 vb) override;
+		void VCMPEQFP(u32 vd, u32 va, u32 vb) override;
+		void VCMPEQFP_(u32 vd, u32 va, u32 vb) override;
+		void VCMPEQUB(u32 vd, u32 va, u32 vb) override;
+		void VCMPEQUB_(u32 vd, u32 va, u32 vb) override;
+		void VCMPEQUH(u32 vd, u32 va, u32 vb) override;
+		void VCMPEQUH_(u32 vd, u32 va, u32 vb) override;
+		void VCMPEQUW(u32 vd, u32 va, u32 vb) override;
+		void VCMPEQUW_(u32 vd, u32 va, u32 vb) override;
+		void VCMPGEFP(u32 vd, u32 va, u32 vb) override;
+		void VCMPGEFP_(u32 vd, u32 va, u32 vb) override;
+		void VCMPGTFP(u32 vd, u32 va, u32 vb) override;
+		void VCMPGTFP_(u32 vd, u32 va, u32 vb) override;
+		void VCMPGTSB(u32 vd, u32 va, u32 vb) override;
+		void VCMPGTSB_(u32 vd, u32 va, u32 vb) override;
+		void VCMPGTSH(u32 vd, u32 va, u32 vb) override;
+		void VCMPGTSH_(u32 vd, u32 va, u32 vb) override;
+		void VCMPGTSW(u32 vd, u32 va, u32 vb) override;
+		void VCMPGTSW_(u32 vd, u32 va, u32 vb) override;
+		void VCMPGTUB(u32 vd, u32 va, u32 vb) override;
+		void VCMPGTUB_(u32 vd, u32 va, u32 vb) override;
+		void VCMPGTUH(u32 vd, u32 va, u32 vb) override;
+		void VCMPGTUH_(u32 vd, u32 va, u32 vb) override;
+		void VCMPGTUW(u32 vd, u32 va, u32 vb) override;
+		void VCMPGTUW_(u32 vd, u32 va, u32 vb) override;
+		void VCTSXS(u32 vd, u32 uimm5, u32 vb) override;
+		void VCTUXS(u32 vd, u32 uimm5, u32 vb) override;
+		void VEXPTEFP(u32 vd, u32 vb) override;
+		void VLOGEFP(u32 vd, u32 vb) override;
+		void VMADDFP(u32 vd, u32 va, u32 vc, u32 vb) override;
+		void VMAXFP(u32 vd, u32 va, u32 vb) override;
+		void VMAXSB(u32 vd, u32 va, u32 vb) override;
+		void VMAXSH(u32 vd, u32 va, u32 vb) override;
+		void VMAXSW(u32 vd, u32 va, u32 vb) override;
+		void VMAXUB(u32 vd, u32 va, u32 vb) override;
+		void VMAXUH(u32 vd, u32 va, u32 vb) override;
+		void VMAXUW(u32 vd, u32 va, u32 vb) override;
+		void VMHADDSHS(u32 vd, u32 va, u32 vb, u32 vc) override;
+		void VMHRADDSHS(u32 vd, u32 va, u32 vb, u32 vc) override;
+		void VMINFP(u32 vd, u32 va, u32 vb) override;
+		void VMINSB(u32 vd, u32 va, u32 vb) override;
+		void VMINSH(u32 vd, u32 va, u32 vb) override;
+		void VMINSW(u32 vd, u32 va, u32 vb) override;
+		void VMINUB(u32 vd, u32 va, u32 vb) override;
+		void VMINUH(u32 vd, u32 va, u32 vb) override;
+		void VMINUW(u32 vd, u32 va, u32 vb) override;
+		void VMLADDUHM(u32 vd, u32 va, u32 vb, u32 vc) override;
+		void VMRGHB(u32 vd, u32 va, u32 vb) override;
+		void VMRGHH(u32 vd, u32 va, u32 vb) override;
+		void VMRGHW(u32 vd, u32 va, u32 vb) override;
+		void VMRGLB(u32 vd, u32 va, u32 vb) override;
+		void VMRGLH(u32 vd, u32 va, u32 vb) override;
+		void VMRGLW(u32 vd, u32 va, u32 vb) override;
+		void VMSUMMBM(u32 vd, u32 va, u32 vb, u32 vc) override;
+		void VMSUMSHM(u32 vd, u32 va, u32 vb, u32 vc) override;
+		void VMSUMSHS(u32 vd, u32 va, u32 vb, u32 vc) override;
+		void VMSUMUBM(u32 vd, u32 va, u32 vb, u32 vc) override;
+		void VMSUMUHM(u32 vd, u32 va, u32 vb, u32 vc) override;
+		void VMSUMUHS(u32 vd, u32 va, u32 vb, u32 vc) override;
+		void VMULESB(u32 vd, u32 va, u32 vb) override;
+		void VMULESH(u32 vd, u32 va, u32 vb) override;
+		void VMULEUB(u32 vd, u32 va, u32 vb) override;
+		void VMULEUH(u32 vd, u32 va, u32 vb) override;
+		void VMULOSB(u32 vd, u32 va, u32 vb) override;
+		void VMULOSH(u32 vd, u32 va, u32 vb) override;
+		void VMULOUB(u32 vd, u32 va, u32 vb) override;
+		void VMULOUH(u32 vd, u32 va, u32 vb) override;
+		void VNMSUBFP(u32 vd, u32 va, u32 vc, u32 vb) override;
+		void VNOR(u32 vd, u32 va, u32 vb) override;
+		void VOR(u32 vd, u32 va, u32 vb) override;
+		void VPERM(u32 vd, u32 va, u32 vb, u32 vc) override;
+		void VPKPX(u32 vd, u32 va, u32 vb) override;
+		void VPKSHSS(u32 vd, u32 va, u32 vb) override;
+		void VPKSHUS(u32 vd, u32 va, u32 vb) override;
+		void VPKSWSS(u32 vd, u32 va, u32 vb) override;
+		void VPKSWUS(u32 vd, u32 va, u32 vb) override;
+		void VPKUHUM(u32 vd, u32 va, u32 vb) override;
+		void VPKUHUS(u32 vd, u32 va, u32 vb) override;
+		void VPKUWUM(u32 vd, u32 va, u32 vb) override;
+		void VPKUWUS(u32 vd, u32 va, u32 vb) override;
+		void VREFP(u32 vd, u32 vb) override;
+		void VRFIM(u32 vd, u32 vb) override;
+		void VRFIN(u32 vd, u32 vb) override;
+		void VRFIP(u32 vd, u32 vb) override;
+		void VRFIZ(u32 vd, u32 vb) override;
+		void VRLB(u32 vd, u32 va, u32 vb) override;
+		void VRLH(u32 vd, u32 va, u32 vb) override;
+		void VRLW(u32 vd, u32 va, u32 vb) override;
+		void VRSQRTEFP(u32 vd, u32 vb) override;
+		void VSEL(u32 vd, u32 va, u32 vb, u32 vc) override;
+		void VSL(u32 vd, u32 va, u32 vb) override;
+		void VSLB(u32 vd, u32 va, u32 vb) override;
+		void VSLDOI(u32 vd, u32 va, u32 vb, u32 sh) override;
+		void VSLH(u32 vd, u32 va, u32 vb) override;
+		void VSLO(u32 vd, u32 va, u32 vb) override;
+		void VSLW(u32 vd, u32 va, u32 vb) override;
+		void VSPLTB(u32 vd, u32 uimm5, u32 vb) override;
+		void VSPLTH(u32 vd, u32 uimm5, u32 vb) override;
+		void VSPLTISB(u32 vd, s32 simm5) override;
+		void VSPLTISH(u32 vd, s32 simm5) override;
+		void VSPLTISW(u32 vd, s32 simm5) override;
+		void VSPLTW(u32 vd, u32 uimm5, u32 vb) override;
+		void VSR(u32 vd, u32 va, u32 vb) override;
+		void VSRAB(u32 vd, u32 va, u32 vb) override;
+		void VSRAH(u32 vd, u32 va, u32 vb) override;
+		void VSRAW(u32 vd, u32 va, u32 vb) override;
+		void VSRB(u32 vd, u32 va, u32 vb) override;
+		void VSRH(u32 vd, u32 va, u32 vb) override;
+		void VSRO(u32 vd, u32 va, u32 vb) override;
+		void VSRW(u32 vd, u32 va, u32 vb) override;
+		void VSUBCUW(u32 vd, u32 va, u32 vb) override;
+		void VSUBFP(u32 vd, u32 va, u32 vb) override;
+		void VSUBSBS(u32 vd, u32 va, u32 vb) override;
+		void VSUBSHS(u32 vd, u32 va, u32 vb) override;
+		void VSUBSWS(u32 vd, u32 va, u32 vb) override;
+		void VSUBUBM(u32 vd, u32 va, u32 vb) override;
+		void VSUBUBS(u32 vd, u32 va, u32 vb) override;
+		void VSUBUHM(u32 vd, u32 va, u32 vb) override;
+		void VSUBUHS(u32 vd, u32 va, u32 vb) override;
+		void VSUBUWM(u32 vd, u32 va, u32 vb) override;
+		void VSUBUWS(u32 vd, u32 va, u32 vb) override;
+		void VSUMSWS(u32 vd, u32 va, u32 vb) override;
+		void VSUM2SWS(u32 vd, u32 va, u32 vb) override;
+		void VSUM4SBS(u32 vd, u32 va, u32 vb) override;
+		void VSUM4SHS(u32 vd, u32 va, u32 vb) override;
+		void VSUM4UBS(u32 vd, u32 va, u32 vb) override;
+		void VUPKHPX(u32 vd, u32 vb) override;
+		void VUPKHSB(u32 vd, u32 vb) override;
+		void VUPKHSH(u32 vd, u32 vb) override;
+		void VUPKLPX(u32 vd, u32 vb) override;
+		void VUPKLSB(u32 vd, u32 vb) override;
+		void VUPKLSH(u32 vd, u32 vb) override;
+		void VXOR(u32 vd, u32 va, u32 vb) override;
+		void MULLI(u32 rd, u32 ra, s32 simm16) override;
+		void SUBFIC(u32 rd, u32 ra, s32 simm16) override;
+		void CMPLI(u32 bf, u32 l, u32 ra, u32 uimm16) override;
+		void CMPI(u32 bf, u32 l, u32 ra, s32 simm16) override;
+		void ADDIC(u32 rd, u32 ra, s32 simm16) override;
+		void ADDIC_(u32 rd, u32 ra, s32 simm16) override;
+		void ADDI(u32 rd, u32 ra, s32 simm16) override;
+		void ADDIS(u32 rd, u32 ra, s32 simm16) override;
+		void BC(u32 bo, u32 bi, s32 bd, u32 aa, u32 lk) override;
+		void HACK(u32 id) override;
+		void SC(u32 sc_code) override;
+		void B(s32 ll, u32 aa, u32 lk) override;
+		void MCRF(u32 crfd, u32 crfs) override;
+		void BCLR(u32 bo, u32 bi, u32 bh, u32 lk) override;
+		void CRNOR(u32 bt, u32 ba, u32 bb) override;
+		void CRANDC(u32 bt, u32 ba, u32 bb) override;
+		void ISYNC() override;
+		void CRXOR(u32 bt, u32 ba, u32 bb) override;
+		void CRNAND(u32 bt, u32 ba, u32 bb) override;
+		void CRAND(u32 bt, u32 ba, u32 bb) override;
+		void CREQV(u32 bt, u32 ba, u32 bb) override;
+		void CRORC(u32 bt, u32 ba, u32 bb) override;
+		void CROR(u32 bt, u32 ba, u32 bb) override;
+		void BCCTR(u32 bo, u32 bi, u32 bh, u32 lk) override;
+		void RLWIMI(u32 ra, u32 rs, u32 sh, u32 mb, u32 me, u32 rc) override;
+		void RLWINM(u32 ra, u32 rs, u32 sh, u32 mb, u32 me, u32 rc) override;
+		void RLWNM(u32 ra, u32 rs, u32 rb, u32 MB, u32 ME, u32 rc) override;
+		void ORI(u32 rs, u32 ra, u32 uimm16) override;
+		void ORIS(u32 rs, u32 ra, u32 uimm16) override;
+		void XORI(u32 ra, u32 rs, u32 uimm16) override;
+		void XORIS(u32 ra, u32 rs, u32 uimm16) override;
+		void ANDI_(u32 ra, u32 rs, u32 uimm16) override;
+		void ANDIS_(u32 ra, u32 rs, u32 uimm16) override;
+		void RLDICL(u32 ra, u32 rs, u32 sh, u32 mb, u32 rc) override;
+		void RLDICR(u32 ra, u32 rs, u32 sh, u32 me, u32 rc) override;
+		void RLDIC(u32 ra, u32 rs, u32 sh, u32 mb, u32 rc) override;
+		void RLDIMI(u32 ra, u32 rs, u32 sh, u32 mb, u32 rc) override;
+		void RLDC_LR(u32 ra, u32 rs, u32 rb, u32 m_eb, u32 is_r, u32 rc) override;
+		void CMP(u32 crfd, u32 l, u32 ra, u32 rb) override;
+		void TW(u32 to, u32 ra, u32 rb) override;
+		void LVSL(u32 vd, u32 ra, u32 rb) override;
+		void LVEBX(u32 vd, u32 ra, u32 rb) override;
+		void SUBFC(u32 rd, u32 ra, u32 rb, u32 oe, u32 rc) override;
+		void MULHDU(u32 rd, u32 ra, u32 rb, u32 rc) override;
+		void ADDC(u32 rd, u32 ra, u32 rb, u32 oe, u32 rc) override;
+		void MULHWU(u32 rd, u32 ra, u32 rb, u32 rc) override;
+		void MFOCRF(u32 a, u32 rd, u32 crm) override;
+		void LWARX(u32 rd, u32 ra, u32 rb) override;
+		void LDX(u32 ra, u32 rs, u32 rb) override;
+		void LWZX(u32 rd, u32 ra, u32 rb) override;
+		void SLW(u32 ra, u32 rs, u32 rb, u32 rc) override;
+		void CNTLZW(u32 ra, u32 rs, u32 rc) override;
+		void SLD(u32 ra, u32 rs, u32 rb, u32 rc) override;
+		void AND(u32 ra, u32 rs, u32 rb, u32 rc) override;
+		void CMPL(u32 bf, u32 l, u32 ra, u32 rb) override;
+		void LVSR(u32 vd, u32 ra, u32 rb) override;
+		void LVEHX(u32 vd, u32 ra, u32 rb) override;
+		void SUBF(u32 rd, u32 ra, u32 rb, u32 oe, u32 rc) override;
+		void LDUX(u32 rd, u32 ra, u32 rb) override;
+		void DCBST(u32 ra, u32 rb) override;
+		void LWZUX(u32 rd, u32 ra, u32 rb) override;
+		void CNTLZD(u32 ra, u32 rs, u32 rc) override;
+		void ANDC(u32 ra, u32 rs, u32 rb, u32 rc) override;
+		void TD(u32 to, u32 ra, u32 rb) override;
+		void LVEWX(u32 vd, u32 ra, u32 rb) override;
+		void MULHD(u32 rd, u32 ra, u32 rb, u32 rc) override;
+		void MULHW(u32 rd, u32 ra, u32 rb, u32 rc) override;
+		void LDARX(u32 rd, u32 ra, u32 rb) override;
+		void DCBF(u32 ra, u32 rb) override;
+		void LBZX(u32 rd, u32 ra, u32 rb) override;
+		void LVX(u32 vd, u32 ra, u32 rb) override;
+		void NEG(u32 rd, u32 ra, u32 oe, u32 rc) override;
+		void LBZUX(u32 rd, u32 ra, u32 rb) override;
+		void NOR(u32 ra, u32 rs, u32 rb, u32 rc) override;
+		void STVEBX(u32 vs, u32 ra, u32 rb) override;
+		void SUBFE(u32 rd, u32 ra, u32 rb, u32 oe, u32 rc) override;
+		void ADDE(u32 rd, u32 ra, u32 rb, u32 oe, u32 rc) override;
+		void MTOCRF(u32 l, u32 crm, u32 rs) override;
+		void STDX(u32 rs, u32 ra, u32 rb) override;
+		void STWCX_(u32 rs, u32 ra, u32 rb) override;
+		void STWX(u32 rs, u32 ra, u32 rb) override;
+		void STVEHX(u32 vs, u32 ra, u32 rb) override;
+		void STDUX(u32 rs, u32 ra, u32 rb) override;
+		void STWUX(u32 rs, u32 ra, u32 rb) override;
+		void STVEWX(u32 vs, u32 ra, u32 rb) override;
+		void SUBFZE(u32 rd, u32 ra, u32 oe, u32 rc) override;
+		void ADDZE(u32 rd, u32 ra, u32 oe, u32 rc) override;
+		void STDCX_(u32 rs, u32 ra, u32 rb) override;
+		void STBX(u32 rs, u32 ra, u32 rb) override;
+		void STVX(u32 vs, u32 ra, u32 rb) override;
+		void MULLD(u32 rd, u32 ra, u32 rb, u32 oe, u32 rc) override;
+		void SUBFME(u32 rd, u32 ra, u32 oe, u32 rc) override;
+		void ADDME(u32 rd, u32 ra, u32 oe, u32 rc) override;
+		void MULLW(u32 rd, u32 ra, u32 rb, u32 oe, u32 rc) override;
+		void DCBTST(u32 ra, u32 rb, u32 th) override;
+		void STBUX(u32 rs, u32 ra, u32 rb) override;
+		void ADD(u32 rd, u32 ra, u32 rb, u32 oe, u32 rc) override;
+		void DCBT(u32 ra, u32 rb, u32 th) override;
+		void LHZX(u32 rd, u32 ra, u32 rb) override;
+		void EQV(u32 ra, u32 rs, u32 rb, u32 rc) override;
+		void ECIWX(u32 rd, u32 ra, u32 rb) override;
+		void LHZUX(u32 rd, u32 ra, u32 rb) override;
+		void XOR(u32 rs, u32 ra, u32 rb, u32 rc) override;
+		void MFSPR(u32 rd, u32 spr) override;
+		void LWAX(u32 rd, u32 ra, u32 rb) override;
+		void DST(u32 ra, u32 rb, u32 strm, u32 t) override;
+		void LHAX(u32 rd, u32 ra, u32 rb) override;
+		void LVXL(u32 vd, u32 ra, u32 rb) override;
+		void MFTB(u32 rd, u32 spr) override;
+		void LWAUX(u32 rd, u32 ra, u32 rb) override;
+		void DSTST(u32 ra, u32 rb, u32 strm, u32 t) override;
+		void LHAUX(u32 rd, u32 ra, u32 rb) override;
+		void STHX(u32 rs, u32 ra, u32 rb) override;
+		void ORC(u32 rs, u32 ra, u32 rb, u32 rc) override;
+		void ECOWX(u32 rs, u32 ra, u32 rb) override;
+		void STHUX(u32 rs, u32 ra, u32 rb) override;
+		void OR(u32 ra, u32 rs, u32 rb, u32 rc) override;
+		void DIVDU(u32 rd, u32 ra, u32 rb, u32 oe, u32 rc) override;
+		void DIVWU(u32 rd, u32 ra, u32 rb, u32 oe, u32 rc) override;
+		void MTSPR(u32 spr, u32 rs) override;
+		void DCBI(u32 ra, u32 rb) override;
+		void NAND(u32 ra, u32 rs, u32 rb, u32 rc) override;
+		void STVXL(u32 vs, u32 ra, u32 rb) override;
+		void DIVD(u32 rd, u32 ra, u32 rb, u32 oe, u32 rc) override;
+		void DIVW(u32 rd, u32 ra, u32 rb, u32 oe, u32 rc) override;
+		void LVLX(u32 vd, u32 ra, u32 rb) override;
+		void LDBRX(u32 rd, u32 ra, u32 rb) override;
+		void LSWX(u32 rd, u32 ra, u32 rb) override;
+		void LWBRX(u32 rd, u32 ra, u32 rb) override;
+		void LFSX(u32 frd, u32 ra, u32 rb) override;
+		void SRW(u32 ra, u32 rs, u32 rb, u32 rc) override;
+		void SRD(u32 ra, u32 rs, u32 rb, u32 rc) override;
+		void LVRX(u32 vd, u32 ra, u32 rb) override;
+		void LSWI(u32 rd, u32 ra, u32 nb) override;
+		void LFSUX(u32 frd, u32 ra, u32 rb) override;
+		void SYNC(u32 l) override;
+		void LFDX(u32 frd, u32 ra, u32 rb) override;
+		void LFDUX(u32 frd, u32 ra, u32 rb) override;
+		void STVLX(u32 vs, u32 ra, u32 rb) override;
+		void STDBRX(u32 rd, u32 ra, u32 rb) override;
+		void STSWX(u32 rs, u32 ra, u32 rb) override;
+		void STWBRX(u32 rs, u32 ra, u32 rb) override;
+		void STFSX(u32 frs, u32 ra, u32 rb) override;
+		void STVRX(u32 vs, u32 ra, u32 rb) override;
+		void STFSUX(u32 frs, u32 ra, u32 rb) override;
+		void STSWI(u32 rd, u32 ra, u32 nb) override;
+		void STFDX(u32 frs, u32 ra, u32 rb) override;
+		void STFDUX(u32 frs, u32 ra, u32 rb) override;
+		void LVLXL(u32 vd, u32 ra, u32 rb) override;
+		void LHBRX(u32 rd, u32 ra, u32 rb) override;
+		void SRAW(u32 ra, u32 rs, u32 rb, u32 rc) override;
+		void SRAD(u32 ra, u32 rs, u32 rb, u32 rc) override;
+		void LVRXL(u32 vd, u32 ra, u32 rb) override;
+		void DSS(u32 strm, u32 a) override;
+		void SRAWI(u32 ra, u32 rs, u32 sh, u32 rc) override;
+		void SRADI1(u32 ra, u32 rs, u32 sh, u32 rc) override;
+		void SRADI2(u32 ra, u32 rs, u32 sh, u32 rc) override;
+		void EIEIO() override;
+		void STVLXL(u32 vs, u32 ra, u32 rb) override;
+		void STHBRX(u32 rs, u32 ra, u32 rb) override;
+		void EXTSH(u32 ra, u32 rs, u32 rc) override;
+		void STVRXL(u32 sd, u32 ra, u32 rb) override;
+		void EXTSB(u32 ra, u32 rs, u32 rc) override;
+		void STFIWX(u32 frs, u32 ra, u32 rb) override;
+		void EXTSW(u32 ra, u32 rs, u32 rc) override;
+		void ICBI(u32 ra, u32 rb) override;
+		void DCBZ(u32 ra, u32 rb) override;
+		void LWZ(u32 rd, u32 ra, s32 d) override;
+		void LWZU(u32 rd, u32 ra, s32 d) override;
+		void LBZ(u32 rd, u32 ra, s32 d) override;
+		void LBZU(u32 rd, u32 ra, s32 d) override;
+		void STW(u32 rs, u32 ra, s32 d) override;
+		void STWU(u32 rs, u32 ra, s32 d) override;
+		void STB(u32 rs, u32 ra, s32 d) override;
+		void STBU(u32 rs, u32 ra, s32 d) override;
+		void LHZ(u32 rd, u32 ra, s32 d) override;
+		void LHZU(u32 rd, u32 ra, s32 d) override;
+		void LHA(u32 rs, u32 ra, s32 d) override;
+		void LHAU(u32 rs, u32 ra, s32 d) override;
+		void STH(u32 rs, u32 ra, s32 d) override;
+		void STHU(u32 rs, u32 ra, s32 d) override;
+		void LMW(u32 rd, u32 ra, s32 d) override;
+		void STMW(u32 rs, u32 ra, s32 d) override;
+		void LFS(u32 frd, u32 ra, s32 d) override;
+		void LFSU(u32 frd, u32 ra, s32 d) override;
+		void LFD(u32 frd, u32 ra, s32 d) override;
+		void LFDU(u32 frd, u32 ra, s32 d) override;
+		void STFS(u32 frs, u32 ra, s32 d) override;
+		void STFSU(u32 frs, u32 ra, s32 d) override;
+		void STFD(u32 frs, u32 ra, s32 d) override;
+		void STFDU(u32 frs, u32 ra, s32 d) override;
+		void LD(u32 rd, u32 ra, s32 ds) override;
+		void LDU(u32 rd, u32 ra, s32 ds) override;
+		void LWA(u32 rd, u32 ra, s32 ds) override;
+		void FDIVS(u32 frd, u32 fra, u32 frb, u32 rc) override;
+		void FSUBS(u32 frd, u32 fra, u32 frb, u32 rc) override;
+		void FADDS(u32 frd, u32 fra, u32 frb, u32 rc) override;
+		void FSQRTS(u32 frd, u32 frb, u32 rc) override;
+		void FRES(u32 frd, u32 frb, u32 rc) override;
+		void FMULS(u32 frd, u32 fra, u32 frc, u32 rc) override;
+		void FMADDS(u32 frd, u32 fra, u32 frc, u32 frb, u32 rc) override;
+		void FMSUBS(u32 frd, u32 fra, u32 frc, u32 frb, u32 rc) override;
+		void FNMSUBS(u32 frd, u32 fra, u32 frc, u32 frb, u32 rc) override;
+		void FNMADDS(u32 frd, u32 fra, u32 frc, u32 frb, u32 rc) override;
+		void STD(u32 rs, u32 ra, s32 ds) override;
+		void STDU(u32 rs, u32 ra, s32 ds) override;
+		void MTFSB1(u32 bt, u32 rc) override;
+		void MCRFS(u32 bf, u32 bfa) override;
+		void MTFSB0(u32 bt, u32 rc) override;
+		void MTFSFI(u32 crfd, u32 i, u32 rc) override;
+		void MFFS(u32 frd, u32 rc) override;
+		void MTFSF(u32 flm, u32 frb, u32 rc) override;
+
+		void FCMPU(u32 bf, u32 fra, u32 frb) override;
+		void FRSP(u32 frd, u32 frb, u32 rc) override;
+		void FCTIW(u32 frd, u32 frb, u32 rc) override;
+		void FCTIWZ(u32 frd, u32 frb, u32 rc) override;
+		void FDIV(u32 frd, u32 fra, u32 frb, u32 rc) override;
+		void FSUB(u32 frd, u32 fra, u32 frb, u32 rc) override;
+		void FADD(u32 frd, u32 fra, u32 frb, u32 rc) override;
+		void FSQRT(u32 frd, u32 frb, u32 rc) override;
+		void FSEL(u32 frd, u32 fra, u32 frc, u32 frb, u32 rc) override;
+		void FMUL(u32 frd, u32 fra, u32 frc, u32 rc) override;
+		void FRSQRTE(u32 frd, u32 frb, u32 rc) override;
+		void FMSUB(u32 frd, u32 fra, u32 frc, u32 frb, u32 rc) override;
+		void FMADD(u32 frd, u32 fra, u32 frc, u32 frb, u32 rc) override;
+		void FNMSUB(u32 frd, u32 fra, u32 frc, u32 frb, u32 rc) override;
+		void FNMADD(u32 frd, u32 fra, u32 frc, u32 frb, u32 rc) override;
+		void FCMPO(u32 crfd, u32 fra, u32 frb) override;
+		void FNEG(u32 frd, u32 frb, u32 rc) override;
+		void FMR(u32 frd, u32 frb, u32 rc) override;
+		void FNABS(u32 frd, u32 frb, u32 rc) override;
+		void FABS(u32 frd, u32 frb, u32 rc) override;
+		void FCTID(u32 frd, u32 frb, u32 rc) override;
+		void FCTIDZ(u32 frd, u32 frb, u32 rc) override;
+		void FCFID(u32 frd, u32 frb, u32 rc) override;
+
+		void UNK(const u32 code, const u32 opcode, const u32 gcode) override;
+
+		/// Utility function creating a function called name with Executable signature
+		void initiate_function(const std::string &name);
+
+	protected:
+		/// State of a compilation task
+		struct CompileTaskState {
+			enum Args {
+				State,
+				Context,
+				MaxArgs,
+			};
+
+			/// The LLVM function for the compilation task
+			llvm::Function * function;
+
+			/// Args of the LLVM function
+			llvm::Value * args[MaxArgs];
+
+			/// Address of the current instruction being compiled
+			u32 current_instruction_address;
+
+			/// A flag used to detect branch instructions.
+			/// This is set to false at the start of compilation of an instruction.
+			/// If a branch instruction is encountered, this is set to true by the decode function.
+			bool hit_branch_instruction;
+		};
+
+		/// The function that will be called to execute unknown functions
+		llvm::Function * m_execute_unknown_function;
+
+		/// The executable that will be called to execute unknown blocks
+		llvm::Function *  m_execute_unknown_block;
+
+		/// Maps function name to executable memory pointer
+		std::unordered_map<std::string, void*> &m_executable_map;
+
+		/// Call compiled functions directly instead of going back to the dispatcher
+		bool m_link_calls;
+
+		/// Functions called through their FunctionCache entry
+		std::set<u32> m_linked_functions;
+
+		/// LLVM context
+		llvm::LLVMContext * m_llvm_context;
+
+		/// LLVM IR builder
+		llvm::IRBuilder<> * m_ir_builder;
+
+		/// Module to which all generated code is output to
+		llvm::Module * m_module;
+
+		/// LLVM type of the functions genreated by the compiler
+		llvm::FunctionType * m_compiled_function_type;
+
+		/// State of the current compilation task
+		CompileTaskState m_state;
+
+		/// Get the name of the basic block for the specified address
+		std::string GetBasicBlockNameFromAddress(u32 address, const std::string & suffix = "") const;
+
+		/// Get the address of a basic block from its name
+		u32 GetAddressFromBasicBlockName(const std::string & name) const;
+
+		/// Get the basic block in for the specified address.
+		llvm::BasicBlock * GetBasicBlockFromAddress(u32 address, const std::string & suffix = "", bool create_if_not_exist = true);
+
+		/// Get a bit
+		llvm::Value * GetBit(llvm::Value * val, u32 n);
+
+		/// Clear a bit
+		llvm::Value * ClrBit(llvm::Value * val, u32 n);
+
+		/// Set a bit
+		llvm::Value * SetBit(llvm::Value * val, u32 n, llvm::Value * bit, bool doClear = true);
+
+		/// Get a nibble
+		llvm::Value * GetNibble(llvm::Value * val, u32 n);
+
+		/// Clear a nibble
+		llvm::Value * ClrNibble(llvm::Value * val, u32 n);
+
+		/// Set a nibble
+		llvm::Value * SetNibble(llvm::Value * val, u32 n, llvm::Value * nibble, bool doClear = true);
+
+		/// Set a nibble
+		llvm::Value * SetNibble(llvm::Value * val, u32 n, llvm::Value * b0, llvm::Value * b1, llvm::Value * b2, llvm::Value * b3, bool doClear = true);
+
+		/// Load PC
+		llvm::Value * GetPc();
+
+		/// Set PC
+		void SetPc(llvm::Value * val_ix);
+
+		/// Load GPR
+		llvm::Value * GetGpr(u32 r, u32 num_bits = 64);
+
+		/// Set GPR
+		void SetGpr(u32 r, llvm::Value * val_x64);
+
+		/// Load CR
+		llvm::Value * GetCr();
+
+		/// Load CR and get field CRn
+		llvm::Value * GetCrField(u32 n);
+
+		/// Set CR
+		void SetCr(llvm::Value * val_x32);
+
+		/// Set CR field
+		void SetCrField(u32 n, llvm::Value * field);
+
+		/// Set CR field
+		void SetCrField(u32 n, llvm::Value * b0, llvm::Value * b1, llvm::Value * b2, llvm::Value * b3);
+
+		/// Set CR field based on signed comparison
+		void SetCrFieldSignedCmp(u32 n, llvm::Value * a, llvm::Value * b);
+
+		/// Set CR field based on unsigned comparison
+		void SetCrFieldUnsignedCmp(u32 n, llvm::Value * a, llvm::Value * b);
+
+		/// Set CR6 based on the result of the vector compare instruction
+		void SetCr6AfterVectorCompare(u32 vr);
+
+		/// Get LR
+		llvm::Value * GetLr();
+
+		/// Set LR
+		void SetLr(llvm::Value * val_x64);
+
+		/// Get CTR
+		llvm::Value * GetCtr();
+
+		/// Set CTR
+		void SetCtr(llvm::Value * val_x64);
+
+		/// Load XER and convert it to an i64
+		llvm::Value * GetXer();
+
+		/// Load XER and return the CA bit
+		llvm::Value * GetXerCa();
+
+		/// Load XER and return the SO bit
+		llvm::Value * GetXerSo();
+
+		/// Set XER
+		void SetXer(llvm::Value * val_x64);
+
+		/// Set the CA bit of XER
+		void SetXerCa(llvm::Value * ca);
+
+		/// Set the SO bit of XER
+		void SetXerSo(llvm::Value * so);
+
+		/// Get VRSAVE
+		llvm::Value * GetVrsave();
+
+		/// Set VRSAVE
+		void SetVrsave(llvm::Value * val_x64);
+
+		/// Load FPSCR
+		llvm::Value * GetFpscr();
+
+		/// Set FPSCR
+		void SetFpscr(llvm::Value * val_x32);
+
+		/// Get FPR
+		llvm::Value * GetFpr(u32 r, u32 bits = 64, bool as_int = false);
+
+		/// Set FPR
+		void SetFpr(u32 r, llvm::Value * val);
+
+		/// Load VSCR
+		llvm::Value * GetVscr();
+
+		/// Set VSCR
+		void SetVscr(llvm::Value * val_x32);
+
+		/// Load VR
+		llvm::Value * GetVr(u32 vr);
+
+		/// Load VR and convert it to an integer vector
+		llvm::Value * GetVrAsIntVec(u32 vr, u32 vec_elt_num_bits);
+
+		/// Load VR and convert it to a float vector with 4 elements
+		llvm::Value * GetVrAsFloatVec(u32 vr);
+
+		/// Load VR and convert it to a double vector with 2 elements
+		llvm::Value * GetVrAsDoubleVec(u32 vr);
+
+		/// Set VR to the specified value
+		void SetVr(u32 vr, llvm::Value * val_x128);
+
+		/// Check condition for branch instructions
+		llvm::Value * CheckBranchCondition(u32 bo, u32 bi);
+
+		/// Create IR for a branch instruction
+		void CreateBranch(llvm::Value * cmp_i1, llvm::Value * target_i32, bool lk, bool target_is_lr = false);
+
+		/// Call the function at address if it is compiled and won't be optimized anymore (its FunctionCache entry is read at runtime),
+		/// or fallback otherwise. PC must be set. Returns the execution status of the call (BlockEnded is handled).
+		llvm::Value * CreateLinkedCall(u32 address, const std::function<llvm::Value *()> & fallback);
+
+		/// Get an i1 which is true if the address (i64, upper half clear) is a Raw SPU MMIO register, or nullptr if it can't be one
+		llvm::Value * GetRawSpuMmioCondition(llvm::Value * addr_i64);
+
+		/// Get an index for basic blocks with the suffix which is not used yet by the current instruction
+		u32 GetUniqueBasicBlockIndex(const std::string & suffix);
+
+		/// Read from memory
+		llvm::Value * ReadMemory(llvm::Value * addr_i64, u32 bits, u32 alignment = 0, bool bswap = true, bool could_be_mmio = true);
+
+		/// Write to memory
+		void WriteMemory(llvm::Value * addr_i64, llvm::Value * val_ix, u32 alignment = 0, bool bswap = true, bool could_be_mmio = true);
+
+		/// Convert a C++ type to an LLVM type
+		template<class T>
+		llvm::Type * CppToLlvmType() {
+			if (std::is_void<T>::value) {
+				return m_ir_builder->getVoidTy();
+			}
+			else if (std::is_same<T, long long>::value || std::is_same<T, unsigned long long>::value) {
+				return m_ir_builder->getInt64Ty();
+			}
+			else if (std::is_same<T, int>::value || std::is_same<T, unsigned int>::value) {
+				return m_ir_builder->getInt32Ty();
+			}
+			else if (std::is_same<T, short>::value || std::is_same<T, unsigned short>::value) {
+				return m_ir_builder->getInt16Ty();
+			}
+			else if (std::is_same<T, char>::value || std::is_same<T, unsigned char>::value) {
+				return m_ir_builder->getInt8Ty();
+			}
+			else if (std::is_same<T, float>::value) {
+				return m_ir_builder->getFloatTy();
+			}
+			else if (std::is_same<T, double>::value) {
+				return m_ir_builder->getDoubleTy();
+			}
+			else if (std::is_same<T, bool>::value) {
+				return m_ir_builder->getInt1Ty();
+			}
+			else if (std::is_pointer<T>::value) {
+				return m_ir_builder->getInt8PtrTy();
+			}
+			else {
+				assert(0);
+			}
+
+			return nullptr;
+		}
+
+		/// Call a function
+		template<class ReturnType, class... Args>
+		llvm::Value * Call(const char * name, Args... args) {
+			auto fn = m_module->getFunction(name);
+			if (!fn) {
+				std::vector<llvm::Type *> fn_args_type = { args->getType()... };
+				auto fn_type = llvm::FunctionType::get(CppToLlvmType<ReturnType>(), fn_args_type, false);
+				fn = llvm::cast<llvm::Function>(m_module->getOrInsertFunction(name, fn_type));
+				fn->setCallingConv(llvm::CallingConv::X86_64_Win64);
+				// Create an entry in m_executable_map that will be populated outside of compiler
+				(void)m_executable_map[name];
+			}
+
+			std::vector<llvm::Value *> fn_args = { args... };
+			return m_ir_builder->CreateCall(fn, fn_args);
+		}
+
+		/// Handle compilation errors
+		void CompilationError(const std::string & error);
+
+		/// A mask used in rotate instructions
+		static u64 s_rotate_mask[64][64];
+
+		/// A flag indicating whether s_rotate_mask has been initialised or not
+		static std::once_flag s_rotate_mask_inited;
+
+		/// Initialse s_rotate_mask
+		static void InitRotateMask();
+	};
+
+	/**
+	 * Memory of the sections of all compiled modules.
+	 * Code and data are allocated in two regions of a single reservation (instead of mappings per module, for i-cache and TLB locality)
+	 * which are committed as they grow. Freed chunks are coalesced and reused before growing a region.
+	 */
+	class CodeArena {
+	public:
+		CodeArena();
+
+		CodeArena(const CodeArena&) = delete; // Delete copy/move constructors and copy/move operators
+
+		~CodeArena();
+
+		/// Allocate size bytes (aligned on 16 bytes) in the code or the data region, returns nullptr if the region is full
+		u8 * Allocate(size_t size, bool code);
+
+		/// Free memory returned by Allocate (with the same size)
+		void Deallocate(u8 * ptr, size_t size, bool code);
+
+		/// Get the number of allocated bytes
+		size_t GetUsedSize() const;
+
+	private:
+		/// Size of a region
+		static const size_t s_region_size = 256 * 1024 * 1024;
+
+		/// Regions are committed by this amount of bytes
+		static const size_t s_commit_size = 64 * 1024;
+
+		struct Region {
+			/// Start of the region
+			u8 * base;
+
+			/// Offset of the end of the allocated part
+			size_t next;
+
+			/// Size of the committed part
+			size_t committed;
+
+			/// Free chunks before next (offset -> size)
+			std::map<size_t, size_t> free_chunks;
+		};
+
+		/// Lock for accessing regions
+		mutable std::mutex m_mutex;
+
+		/// The reservation
+		u8 * m_memory;
+
+		/// Code (executable) and data regions
+		Region m_regions[2];
+
+		/// Number of allocated bytes
+		size_t m_used_size;
+	};
+
+	/// Use of compiled code by a PPU thread, tells when executables removed from the FunctionCache can't be running anymore
+	struct CompiledCodeUsage {
+		/// Number of compiled blocks entered from the dispatcher which didn't return yet
+		std::atomic<u32> depth{ 0 };
+
+		/// Number of times depth went back to 0 (or the thread was destroyed)
+		std::atomic<u64> exits{ 0 };
+	};
+
+	/**
+	 * Manages block compilation.
+	 * PPUInterpreter1 execution is traced (using Tracer class)
+	 * Periodically RecompilationEngine process traces result to find blocks
+	 * whose compilation can improve performances.
+	 * It then builds them asynchroneously and update the executable mapping
+	 * using atomic based locks to avoid undefined behavior.
+	 **/
+	class RecompilationEngine final : public named_thread_t {
+		friend class CPUHybridDecoderRecompiler;
+	public:
+		virtual ~RecompilationEngine() override;
+
+		/**
+		 * Get the executable for the specified address if a compiled version is
+		 * available, otherwise returns nullptr.
+		 **/
+		const Executable GetCompiledExecutableIfAvailable(u32 address) const;
+
+		/// Notify the recompilation engine about a newly detected block start.
+		void NotifyBlockStart(u32 address);
+
+		/// Notify the recompilation engine that the compiled block at address was entered (counts hits of the fast tier)
+		void NotifyCompiledBlockHit(u32 address);
+
+		/// Get the number of block start notifications dropped because the pending queue was full
+		u64 GetPendingOverflowCount() const {
+			return m_pending_overflow_count.load(std::memory_order_relaxed);
+		}
+
+		/// Find and compile all functions of the executable range using several threads (must be called before execution starts)
+		void PrecompileRange(u32 start_address, u32 size);
+
+		/// Queue blocks of the compile profile of the executable (code ranges) for compilation, hottest first (must be called before execution starts)
+		/// The profile is written again with the hot blocks of this session when the engine exits.
+		void LoadCompileProfile(const std::vector<std::pair<u32, u32>> & ranges);
+
+		/// Drop compiled blocks containing code of the page (it was modified), they are compiled again when they are hot
+		static void InvalidatePage(u32 page);
+
+		/// Log
+		llvm::raw_fd_ostream & Log();
+
+		std::string get_name() const override { return "PPU Recompilation Engine"; }
+
+		void on_task() override;
+
+		/// Get a pointer to the instance of this class
+		static std::shared_ptr<RecompilationEngine> GetInstance();
+
+		/// Register the compiled code usage of a PPU thread (until it is destroyed)
+		void RegisterThread(const std::shared_ptr<CompiledCodeUsage> & usage);
+
+		/// Remove the compiled code usage of a destroyed PPU thread
+		void UnregisterThread(const std::shared_ptr<CompiledCodeUsage> & usage);
+
+	private:
+		/// An entry in the block table
+		struct BlockEntry {
+			/// Start address
+			u32 address;
+
+			/// Number of times this block was hit
+			u32 num_hits;
+
+			/// Indicates whether this function has been analysed or not
+			bool is_analysed;
+
+			/// Indicates whether the block has been compiled or not
+			bool is_compiled;
+
+			/// Indicate wheter the block is a function that can be completly compiled
+			/// that is, that has a clear "return" semantic and no indirect branch
+			bool is_compilable_function;
+
+			/// If the analysis was successfull, how long the block is.
+			u32 instructionCount;
+
+			/// If the analysis was successfull, which function does it call.
+			std::set<u32> calledFunctions;
+
+			/// Hash of the code of the block (set when it's queued for compilation)
+			u64 code_hash;
+
+			BlockEntry(u32 start_address)
+				: num_hits(0)
+				, address(start_address)
+				, is_compiled(false)
+				, is_analysed(false)
+				, is_compilable_function(false)
+				, instructionCount(0)
+				, code_hash(0) {
+			}
+
+			std::string ToString() const {
+				return fmt::format("0x%08X: NumHits=%u, IsCompiled=%c",
+					address, num_hits, is_compiled ? 'Y' : 'N');
+			}
+
+			bool operator == (const BlockEntry & other) const {
+				return address == other.address;
+			}
+		};
+
+		/// Log
+		llvm::raw_fd_ostream * m_log;
+
+		/// Capacity of m_pending_address_start (power of 2)
+		static const u32 s_pending_queue_size = 16384;
+
+		/// Number of pushed block start addresses after which the recompilation engine thread is woken up
+		static const u32 s_pending_notify_batch = 256;
+
+		/// A slot of m_pending_address_start
+		struct PendingSlot {
+			/// Sequence number of the slot (equals the push position when free, push position + 1 when filled)
+			std::atomic<u32> seq;
+
+			/// Block start address
+			u32 address;
+		};
+
+		/// Bounded MPSC ring of block start addresses to process (producers: PPU threads, consumer: on_task)
+		std::unique_ptr<PendingSlot[]> m_pending_address_start;
+
+		/// Next push position in m_pending_address_start
+		std::atomic<u32> m_pending_push_pos;
+
+		/// Next pop position in m_pending_address_start (only accessed by the consumer)
+		u32 m_pending_pop_pos;
+
+		/// Number of block start addresses dropped because m_pending_address_start was full
+		std::atomic<u64> m_pending_overflow_count;
+
+		/// Pop up to max_count block start addresses from m_pending_address_start
+		void PopPendingAddresses(std::vector<u32> & addresses, u32 max_count);
+
+		/// Block table
+		std::unordered_map<u32, BlockEntry> m_block_table;
+
+		/// Maximum number of functions inlined in an optimized block
+		static const u32 s_max_inlined_functions = 16;
+
+		/// Maximum size of an inlined function (instructions)
+		static const u32 s_max_inlined_size = 512;
+
+		/// A block of the fast tier to compile again in the optimized tier
+		struct OptimizationTask {
+			/// Start address
+			u32 address;
+
+			/// Block length (instructions)
+			u32 instruction_count;
+
+			/// Called functions to inline (address, instruction count)
+			std::vector<std::pair<u32, u32>> inlined;
+		};
+
+		/// Lock for accessing m_hot_blocks
+		std::mutex m_hot_lock;
+
+		/// Start addresses of fast tier blocks which reached the optimization threshold (producers: PPU threads, consumer: on_task)
+		std::vector<u32> m_hot_blocks;
+
+		/// Lock for accessing m_optimization_tasks
+		std::mutex m_optimization_lock;
+
+		/// Signaled when a task is added to m_optimization_tasks
+		std::condition_variable m_optimization_cv;
+
+		/// Blocks to compile in the optimized tier (consumer: m_optimization_thread)
+		std::deque<OptimizationTask> m_optimization_tasks;
+
+		/// Background thread compiling the optimized tier (started with the first task)
+		std::shared_ptr<thread_ctrl> m_optimization_thread;
+
+		/// Create optimization tasks for blocks of m_hot_blocks
+		void ProcessHotBlocks();
+
+		/// Compile optimization tasks until emulation is stopped
+		void OptimizationThread(llvm::LLVMContext & llvm_context);
+
+		/// Owned by the optimization thread while it uses its LLVM context (execution engines of the context can't be destroyed meanwhile)
+		std::mutex m_optimization_context_lock;
+
+		/// A block to compile in a compile worker
+		struct CompileTask {
+			/// Block length (instructions)
+			u32 instruction_count;
+
+			/// Hits of the block (priority)
+			u32 num_hits;
+		};
+
+		/// Lock for accessing m_compile_tasks and m_compile_queue
+		std::mutex m_compile_lock;
+
+		/// Signaled when a task is added to m_compile_queue
+		std::condition_variable m_compile_cv;
+
+		/// Blocks to compile by start address (producer: on_task, consumers: compile workers)
+		std::unordered_map<u32, CompileTask> m_compile_tasks;
+
+		/// Keys of m_compile_tasks ordered by (hits, start address), the most hit block is compiled first
+		std::set<std::pair<u32, u32>, std::greater<std::pair<u32, u32>>> m_compile_queue;
+
+		/// Compile worker threads (started with the first task)
+		std::vector<std::shared_ptr<thread_ctrl>> m_compile_threads;
+
+		/// Owned by compile workers while they use their LLVM context (one per worker)
+		std::deque<std::mutex> m_compile_context_locks;
+
+		/// Queue the block for compilation in a compile worker
+		void QueueCompileTask(u32 address, u32 instruction_count, u32 num_hits);
+
+		/// Raise the priority of queued blocks which were hit again
+		void UpdateCompileTasks(const std::vector<u32> & addresses);
+
+		/// Compile queued blocks until emulation is stopped
+		void CompileThread(llvm::LLVMContext & llvm_context, std::mutex & context_lock);
+
+		/// Lock for accessing m_profile
+		std::mutex m_profile_lock;
+
+		/// Profiling counters of all PPU threads
+		std::unordered_map<u32, BlockProfile> m_profile;
+
+		/// Add profiling counters of a PPU thread
+		void MergeProfile(const std::unordered_map<u32, BlockProfile> & profile);
+
+		/// Write the hot block report sorted by time spent
+		void DumpProfile();
+
+		/// Path of the compile profile of the running executable (empty if not loaded)
+		std::string m_compile_profile_path;
+
+		/// Write blocks which reached the compilation threshold to the compile profile
+		void SaveCompileProfile();
+
+		int m_currentId;
+
+		/// Virtual memory allocated array.
+		/// Store pointer to every compiled function/block and a unique Id.
+		/// We need to map every instruction in PS3 Ram so it's a big table
+		/// But a lot of it won't be accessed. Fortunatly virtual memory help here...
+		ExecutableStorageType* FunctionCache;
+
+		// Bitfield recording page status in FunctionCache reserved memory.
+		char *FunctionCachePagesCommited;
+
+		bool isAddressCommited(u32) const;
+		void commitAddress(u32);
+
+		/// Start addresses of compiled blocks by page of their code
+		std::unordered_map<u32, std::vector<u32>> m_page_blocks;
+
+		/// Start addresses of dropped blocks, their entries in m_block_table are reset by on_task
+		std::vector<u32> m_invalidated_blocks;
+
+		/// Start addresses of stored blocks, their entries in m_block_table are marked as compiled by on_task
+		std::vector<u32> m_compiled_blocks;
+
+		/// Number of invalidated pages (a block compiled meanwhile may contain modified code and isn't stored)
+		u64 m_invalidation_count;
+
+		/// Drop compiled blocks containing code of the page
+		void Invalidate(u32 page);
+
+		/// Mark blocks listed in m_compiled_blocks as compiled, then blocks listed in m_invalidated_blocks as not compiled
+		void UpdateBlockTable();
+
+		/// Memory of compiled code (must outlive execution engines)
+		CodeArena m_code_arena;
+
+		/// An execution engine storing compiled code
+		struct StoredEngine {
+			std::unique_ptr<llvm::ExecutionEngine> engine;
+
+			/// Owned by the thread compiling in the LLVM context of the engine (nullptr if the context is idle or only used by on_task)
+			std::mutex * context_lock;
+		};
+
+		/// Execution engines of the executables in FunctionCache by block address
+		std::unordered_map<u32, StoredEngine> m_block_engines;
+
+		/// Execution engines removed from FunctionCache (invalidated or replaced) or never stored in it
+		std::vector<StoredEngine> m_retired_engines;
+
+		/// Retired execution engines destroyed when threads which were running compiled code when they were retired left it
+		struct RetiredEngines {
+			std::vector<StoredEngine> engines;
+
+			/// Threads running compiled code and their exit count when the engines were retired
+			std::vector<std::pair<std::shared_ptr<CompiledCodeUsage>, u64>> threads;
+		};
+
+		/// Retired engines waiting for threads
+		std::deque<RetiredEngines> m_retired_engine_lists;
+
+		/// Lock for accessing m_threads
+		std::mutex m_threads_lock;
+
+		/// Compiled code usage of PPU threads
+		std::vector<std::shared_ptr<CompiledCodeUsage>> m_threads;
+
+		/// Retire the execution engine (m_executable_lock must be owned)
+		void RetireEngine(StoredEngine && engine);
+
+		/// Destroy retired execution engines which can't be running anymore (their memory goes back to m_code_arena)
+		void ReclaimRetiredEngines();
+
+		/// Lock for accessing FunctionCache, execution engines, m_currentId and invalidation data
+		std::mutex m_executable_lock;
+
+		/// Lock for accessing the log
+		std::mutex m_log_lock;
+
+		/// LLVM contexts created for precompilation, compile and optimization threads (must outlive m_executable_storage)
+		std::vector<std::unique_ptr<llvm::LLVMContext>> m_precompile_contexts;
+
+		/// Cache of compiled objects (nullptr if disabled)
+		std::unique_ptr<ObjectCache> m_object_cache;
+
+
+		/// LLVM context
+		llvm::LLVMContext &m_llvm_context;
+
+		/// LLVM IR builder
+		llvm::IRBuilder<> m_ir_builder;
+
+		/**
+		* Compile a code fragment described by a cfg and return an executable and the ExecutionEngine storing it
+		* Pointer to function can be retrieved with getPointerToFunction
+		*/
+		std::pair<Executable, llvm::ExecutionEngine *> compile(const std::string & name, u32 start_address, u32 instruction_count, bool optimize);
+
+		/// Same as above, using the specified LLVM context and IR builder (for use from other threads)
+		/// Functions of inlined (address, instruction count) are translated in the same module to be inlined (optimized tier only).
+		std::pair<Executable, llvm::ExecutionEngine *> compile(const std::string & name, u32 start_address, u32 instruction_count, bool optimize, llvm::LLVMContext &llvm_context, llvm::IRBuilder<> &ir_builder, const std::vector<std::pair<u32, u32>> & inlined = {});
+
+		/// Watch pages of the code range for writes and get the current invalidation count (called before compiling the code)
+		u64 WatchRange(u32 address, u32 instruction_count);
+
+		/// Add the block to the blocks invalidated by writes to pages of the code range (m_executable_lock must be owned)
+		void AddPageBlock(u32 block_address, u32 address, u32 instruction_count);
+
+		/// Store the compiled executable for the block and mark it as compiled, unless code was invalidated since WatchRange()
+		/// The block is compiled again in the optimized tier after hits_left hits (0: never).
+		/// context_lock is the StoredEngine::context_lock of the engine.
+		void StoreExecutable(u32 address, u32 instruction_count, const std::pair<Executable, llvm::ExecutionEngine *> & compile_result, u64 invalidation_count, u32 hits_left, std::mutex * context_lock);
+
+		/// Replace the fast tier executable of the block by the optimized one, unless code was invalidated since WatchRange()
+		void StoreOptimizedExecutable(const OptimizationTask & task, const std::pair<Executable, llvm::ExecutionEngine *> & compile_result, u64 invalidation_count);
+
+		/// The time at which the m_address_to_ordinal cache was last cleared
+		std::chrono::high_resolution_clock::time_point m_last_cache_clear_time;
+
+		RecompilationEngine();
+
+		RecompilationEngine(const RecompilationEngine&) = delete; // Delete copy/move constructors and copy/move operators
+
+		/// Increase usage counter for block starting at addr and queue it for compilation if threshold was reached.
+		/// Returns true if block was queued
+		bool IncreaseHitCounterAndBuild(u32 addr);
+
+		/**
+		* Analyse block to get useful info (function called, has indirect branch...)
+		* This code is inspired from Dolphin PPC Analyst
+		* Return true if analysis is successful.
+		*/
+		bool AnalyseBlock(BlockEntry &functionData, size_t maxSize = 10000);
+
+		/// Analyse a block and queue it for compilation
+		void CompileBlock(BlockEntry & block_entry);
+
+		/// Mutex used to prevent multiple creation
+		static std::mutex s_mutex;
+
+		/// The instance
+		static std::shared_ptr<RecompilationEngine> s_the_instance;
+	};
+
+	/**
+	 * PPU execution engine
+	 * Relies on the cached interpreter functions (PPUInterpreter2) to execute uncompiled code.
+	 * Traces execution to determine which block to compile.
+	 * Use LLVM to compile block into native code.
+	 */
+	/// Profiling counters of a block (collected if "Profile blocks" is enabled)
+	struct BlockProfile {
+		/// Number of times the block was entered in the interpreter
+		u64 interpreted_hits = 0;
+
+		/// Number of instructions interpreted in the block
+		u64 interpreted_instructions = 0;
+
+		/// Time spent interpreting the block (ns, callees excluded)
+		u64 interpreted_time = 0;
+
+		/// Number of times the compiled block was executed
+		u64 compiled_hits = 0;
+
+		/// Time spent in the compiled block (ns, callees included)
+		u64 compiled_time = 0;
+	};
+
+	class CPUHybridDecoderRecompiler : public CPUDecoder {
+		friend class RecompilationEngine;
+		friend class Compiler;
+	public:
+		CPUHybridDecoderRecompiler(PPUThread & ppu);
+
+		CPUHybridDecoderRecompiler(const CPUHybridDecoderRecompiler&) = delete; // Delete copy/move constructors and copy/move operators
+
+		virtual ~CPUHybridDecoderRecompiler();
+
+		u32 DecodeMemory(const u32 address) override;
+
+	private:
+		/// PPU processor context
+		PPUThread & m_ppu;
+
+		/// Interpreter functions of decoded instructions (interpreter2)
+		const std::shared_ptr<ppu_decoder_cache_t> m_decoder_cache;
+
+		/// Recompilation engine
+		std::shared_ptr<RecompilationEngine> m_recompilation_engine;
+
+		/// Indicates whether blocks are profiled
+		const bool m_profile_enabled;
+
+		/// Profiling counters of this thread (merged into the recompilation engine on destruction)
+		std::unordered_map<u32, BlockProfile> m_profile;
+
+		/// Use of compiled code by this thread
+		const std::shared_ptr<CompiledCodeUsage> m_code_usage;
+
+		/// Execute a function
+		static u32 ExecuteFunction(PPUThread * ppu_state, u64 context);
+
+		/// Execute till the current function returns
+		static u32 ExecuteTillReturn(PPUThread * ppu_state, u64 context);
+
+		/// Check thread status. Returns true if the thread must exit.
+		static bool PollStatus(PPUThread * ppu_state);
+	};
+
+	/**
+	 * Stores objects generated by MCJIT on disk, so that the code generation
+	 * can be skipped when the same module is compiled again.
+	 * The module identifier must describe the compiled code completely.
+	 */
+	class ObjectCache : public llvm::ObjectCache {
+		/// Directory where objects are stored
+		const std::string m_path;
+
+	public:
+		ObjectCache(const std::string & path)
+			: m_path(path)
+		{}
+
+		~ObjectCache() override {}
+
+		/// Check whether an object is available for the module identifier
+		bool Contains(const std::string & id) const;
+
+		void notifyObjectCompiled(const llvm::Module *module, llvm::MemoryBufferRef obj) override;
+
+		std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module *module) override;
+	};
+
+	/// Resolves symbols of executableMap, sections are allocated in the code arena if it is set
+	class CustomSectionMemoryManager : public llvm::SectionMemoryManager {
+	private:
+		std::unordered_map<std::string, void*> &executableMap;
+
+		CodeArena *arena;
+
+		/// Chunks allocated in the arena (pointer, size, code)
+		std::vector<std::tuple<u8 *, size_t, bool>> chunks;
+
+		/// Allocate a section in the arena (nullptr if it isn't set or full)
+		u8 *allocate(uintptr_t size, unsigned alignment, bool code);
+
+	public:
+		CustomSectionMemoryManager(std::unordered_map<std::string, void*> &map, CodeArena *arena = nullptr) :
+			executableMap(map),
+			arena(arena)
+		{}
+		~CustomSectionMemoryManager() override;
+
+		uint8_t *allocateCodeSection(uintptr_t Size, unsigned Alignment, unsigned SectionID, llvm::StringRef SectionName) override;
+
+		uint8_t *allocateDataSection(uintptr_t Size, unsigned Alignment, unsigned SectionID, llvm::StringRef SectionName, bool IsReadOnly) override;
+
+		bool finalizeMemory(std::string *ErrMsg = nullptr) override;
+
+		virtual uint64_t getSymbolAddress(const std::string &Name) override
+		{
+			std::unordered_map<std::string, void*>::const_iterator It = executableMap.find(Name);
+			if (It != executableMap.end())
+				return (uint64_t)It->second;
+			return getSymbolAddressInProcess(Name);
+		}
+	};
+}
+
+#endif // LLVM_AVAILABLE
+#endif // PPU_LLVM_RECOMPILER_H
@@ -4,6 +4,7 @@
 #include "Emu/System.h"
 #include "Emu/Cell/PPULLVMRecompiler.h"
 #include "Emu/Memory/Memory.h"
+#include "Emu/SysCalls/Modules.h"
 #ifdef _MSC_VER
 #pragma warning(push, 0)
 #endif
@@ -1826,12 +1827,95 @@ void Compiler::ADDIS(u32 rd, u32 ra, s32 simm16) {
 }
 
 void Compiler::BC(u32 bo, u32 bi, s32 bd, u32 aa, u32 lk) {
-	auto target_i64 = m_ir_builder->getInt64(branchTarget(aa ? 0 : m_state.current_instruction_address, bd));
+	const u32 target = branchTarget(aa ? 0 : m_state.current_instruction_address, bd);
+	auto target_i64 = m_ir_builder->getInt64(target);
 	auto target_i32 = m_ir_builder->CreateTrunc(target_i64, m_ir_builder->getInt32Ty());
+
+	if (!lk && target <= m_state.current_instruction_address && ppu_find_spin_loop(target, m_state.current_instruction_address)) {
+		// Spin loop: the taken branch goes through ppu_spin_wait which idles the thread when the loop has been running for a while
+		auto cmp_i1 = CheckBranchCondition(bo, bi);
+		auto current_block = m_ir_builder->GetInsertBlock();
+		auto spin_block = GetBasicBlockFromAddress(m_state.current_instruction_address, "spin_wait");
+		auto exit_block = GetBasicBlockFromAddress(m_state.current_instruction_address, "spin_exit");
+		auto loop_block = GetBasicBlockFromAddress(m_state.current_instruction_address, "spin_loop");
+
+		m_ir_builder->SetInsertPoint(spin_block);
+		SetPc(target_i32);
+		auto ret_i1 = Call<bool>("ppu_spin_wait", m_state.args[CompileTaskState::Args::State], m_ir_builder->getInt32(m_state.current_instruction_address), target_i32);
+		m_ir_builder->CreateCondBr(ret_i1, exit_block, loop_block);
+		m_ir_builder->SetInsertPoint(exit_block);
+		m_ir_builder->CreateRet(m_ir_builder->getInt32(ExecutionStatus::ExecutionStatusBlockEnded));
+		m_ir_builder->SetInsertPoint(loop_block);
+		m_ir_builder->CreateBr(GetBasicBlockFromAddress(target));
+
+		m_ir_builder->SetInsertPoint(current_block);
+		m_ir_builder->CreateCondBr(cmp_i1, spin_block, GetBasicBlockFromAddress(m_state.current_instruction_address + 4));
+		m_state.hit_branch_instruction = true;
+		return;
+	}
+
 	CreateBranch(CheckBranchCondition(bo, bi), target_i32, lk ? true : false);
 }
 
+u32 Compiler::GetLleFunction(u32 index) {
+	const auto func = get_ppu_func_dispatch(index);
+
+	if (!func || !func->lle_func)
+		return 0;
+
+	return func->lle_func.addr();
+}
+
+u32 Compiler::GetDirectCallIndex(u32 address) {
+	if (!vm::check_addr(address, 4))
+		return 0;
+
+	const u32 instr = vm::ps3::read32(address);
+	if (PPU_instr::fields::OPCD(instr) != PPU_opcodes::PPU_MainOpcodes::HACK)
+		return 0;
+
+	// The stub must return to the caller
+	const u32 index = instr & 0x3ffffff;
+	if (!(index & EIF_PERFORM_BLR) || index & EIF_USE_BRANCH)
+		return 0;
+
+	const auto func = get_ppu_func_dispatch(index);
+	if (!func || func->lle_func || !func->func || !(func->flags & MFF_DIRECT_CALL))
+		return 0;
+
+	return index;
+}
+
 void Compiler::HACK(u32 index) {
+	const u32 lle_func = m_link_calls && (index & EIF_PERFORM_BLR) && !(index & EIF_USE_BRANCH) ? GetLleFunction(index) : 0;
+	if (lle_func) {
+		// Call the LLE function like execute_ppu_func_by_index does, without going through a nested fast_call
+		if (index & EIF_SAVE_RTOC)
+			WriteMemory(m_ir_builder->CreateAdd(GetGpr(1), m_ir_builder->getInt64(0x28)), GetGpr(2));
+
+		const u32 lle_pc = vm::ps3::read32(lle_func);
+		llvm::Value *rtoc_i64 = GetGpr(2);
+		llvm::Value *lr_i64 = GetLr();
+		SetGpr(2, m_ir_builder->getInt64(vm::ps3::read32(lle_func + 4)));
+		SetPc(m_ir_builder->getInt32(lle_pc));
+
+		llvm::Value *status = CreateLinkedCall(lle_pc, [this]() {
+			return Call<u32>("execute_unknown_function", m_state.args[CompileTaskState::Args::State], m_ir_builder->getInt64(0));
+		});
+		llvm::BasicBlock *cputhreadexitblock = GetBasicBlockFromAddress(m_state.current_instruction_address, "early_exit");
+		llvm::Value *isCPUThreadExit = m_ir_builder->CreateICmpEQ(status, m_ir_builder->getInt32(ExecutionStatus::ExecutionStatusPropagateException));
+		llvm::BasicBlock *normal_execution = GetBasicBlockFromAddress(m_state.current_instruction_address, "normal_execution");
+		m_ir_builder->CreateCondBr(isCPUThreadExit, cputhreadexitblock, normal_execution);
+		m_ir_builder->SetInsertPoint(cputhreadexitblock);
+		m_ir_builder->CreateRet(m_ir_builder->getInt32(ExecutionStatus::ExecutionStatusPropagateException));
+
+		m_ir_builder->SetInsertPoint(normal_execution);
+		SetGpr(2, rtoc_i64);
+		SetLr(lr_i64);
+		CreateBranch(nullptr, m_ir_builder->CreateTrunc(m_ir_builder->CreateAnd(lr_i64, ~0x3ULL), m_ir_builder->getInt32Ty()), false, true);
+		return;
+	}
+
 	llvm::Value *status = Call<u32>("wrappedExecutePPUFuncByIndex", m_state.args[CompileTaskState::Args::State], m_ir_builder->getInt32(index & EIF_USE_BRANCH ? index : index & ~EIF_PERFORM_BLR));
 	llvm::BasicBlock *cputhreadexitblock = GetBasicBlockFromAddress(m_state.current_instruction_address, "early_exit");
 	llvm::Value *isCPUThreadExit = m_ir_builder->CreateICmpEQ(status, m_ir_builder->getInt32(ExecutionStatus::ExecutionStatusPropagateException));
@@ -1842,7 +1926,8 @@ void Compiler::HACK(u32 index) {
 
 	m_ir_builder->SetInsertPoint(normal_execution);
 	if (index & EIF_PERFORM_BLR || index & EIF_USE_BRANCH) {
-		auto lr_i32 = index & EIF_USE_BRANCH ? GetPc() : m_ir_builder->CreateTrunc(m_ir_builder->CreateAnd(GetLr(), ~0x3ULL), m_ir_builder->getInt32Ty());
+		// The branch target set by execute_ppu_func_by_index is the address of the LLE function minus 4 (incremented by the interpreter)
+		auto lr_i32 = index & EIF_USE_BRANCH ? m_ir_builder->CreateAdd(GetPc(), m_ir_builder->getInt32(4)) : m_ir_builder->CreateTrunc(m_ir_builder->CreateAnd(GetLr(), ~0x3ULL), m_ir_builder->getInt32Ty());
 		CreateBranch(nullptr, lr_i32, false, (index & EIF_USE_BRANCH) == 0);
 	}
 }
@@ -5414,11 +5499,41 @@ void Compiler::CreateBranch(llvm::Value * cmp_i1, llvm::Value * target_i32, bool
 			}
 
 			SetPc(target_i32);
-//			Function *fn = m_module->getFunction(fmt::format("function_0x%08X", target_address));
+			Function *fn = m_module->getFunction(fmt::format("fn_0x%08X", target_address));
+			const u32 direct_call_index = m_link_calls ? GetDirectCallIndex(target_address) : 0;
 			llvm::Value *execStatus;
-//			if (fn)
-//				execStatus = m_ir_builder->CreateCall2(fn, m_state.args[CompileTaskState::Args::State], m_ir_builder->getInt64(0));
-//			else
+			if (direct_call_index) {
+				// Call the HLE function instead of the import stub, the stub would return to the next instruction
+				if (direct_call_index & EIF_SAVE_RTOC)
+					WriteMemory(m_ir_builder->CreateAdd(GetGpr(1), m_ir_builder->getInt64(0x28)), GetGpr(2));
+
+				execStatus = Call<u32>("wrappedExecutePPUFuncByIndex", m_state.args[CompileTaskState::Args::State], m_ir_builder->getInt32(direct_call_index & ~EIF_FLAGS));
+			}
+			else if (fn && !fn->isDeclaration() && fn != m_state.function) {
+				// The function was translated in this module (to be inlined)
+				CallInst *call = m_ir_builder->CreateCall2(fn, m_state.args[CompileTaskState::Args::State], m_ir_builder->getInt64(0));
+				call->setCallingConv(fn->getCallingConv());
+
+				// If the function left its compiled range, execute it until it returns
+				BasicBlock *call_block = m_ir_builder->GetInsertBlock();
+				BasicBlock *unknown_block = GetBasicBlockFromAddress(m_state.current_instruction_address, "callee_exit");
+				BasicBlock *call_end = GetBasicBlockFromAddress(m_state.current_instruction_address, "call_end");
+				m_ir_builder->CreateCondBr(m_ir_builder->CreateICmpEQ(call, m_ir_builder->getInt32(ExecutionStatus::ExecutionStatusBlockEnded)), unknown_block, call_end);
+				m_ir_builder->SetInsertPoint(unknown_block);
+				CallInst *unknown_call = m_ir_builder->CreateCall2(m_execute_unknown_block, m_state.args[CompileTaskState::Args::State], m_ir_builder->getInt64(0));
+				unknown_call->setCallingConv(m_execute_unknown_block->getCallingConv());
+				m_ir_builder->CreateBr(call_end);
+				m_ir_builder->SetInsertPoint(call_end);
+				PHINode *status = m_ir_builder->CreatePHI(m_ir_builder->getInt32Ty(), 2);
+				status->addIncoming(call, call_block);
+				status->addIncoming(unknown_call, unknown_block);
+				execStatus = status;
+			}
+			else if (m_link_calls)
+				execStatus = CreateLinkedCall(target_address, [this]() {
+					return Call<u32>("execute_unknown_function", m_state.args[CompileTaskState::Args::State], m_ir_builder->getInt64(0));
+				});
+			else
 				execStatus = Call<u32>("execute_unknown_function", m_state.args[CompileTaskState::Args::State], m_ir_builder->getInt64(0));
 
 			llvm::BasicBlock *cputhreadexitblock = GetBasicBlockFromAddress(m_state.current_instruction_address, "early_exit");
@@ -5485,8 +5600,99 @@ void Compiler::CreateBranch(llvm::Value * cmp_i1, llvm::Value * target_i32, bool
 	m_state.hit_branch_instruction = true;
 }
 
+Value * Compiler::CreateLinkedCall(u32 address, const std::function<Value *()> & fallback) {
+	m_linked_functions.insert(address);
+
+	// The FunctionCache entry is updated when the callee is compiled, optimized or invalidated
+	const u64 entry_offset = (u64)(address / 4) * sizeof(ExecutableStorageType);
+	auto function_cache = m_module->getOrInsertGlobal("ppu_function_cache", m_ir_builder->getInt8Ty());
+	auto function_i8_ptr = m_ir_builder->CreateConstGEP1_64(function_cache, entry_offset + offsetof(ExecutableStorageType, function));
+	auto function_ptr = m_ir_builder->CreateBitCast(function_i8_ptr, m_compiled_function_type->getPointerTo()->getPointerTo());
+	auto function = m_ir_builder->CreateAlignedLoad(function_ptr, 8);
+	auto hits_left_i8_ptr = m_ir_builder->CreateConstGEP1_64(function_cache, entry_offset + offsetof(ExecutableStorageType, hits_left));
+	auto hits_left_i32_ptr = m_ir_builder->CreateBitCast(hits_left_i8_ptr, m_ir_builder->getInt32Ty()->getPointerTo());
+	auto hits_left = m_ir_builder->CreateAlignedLoad(hits_left_i32_ptr, 4);
+
+	// Code of the fast tier is called through the dispatcher which counts hits for the optimized tier
+	auto is_linked = m_ir_builder->CreateAnd(m_ir_builder->CreateIsNotNull(function), m_ir_builder->CreateICmpEQ(hits_left, m_ir_builder->getInt32(0)));
+
+	BasicBlock *linked_block = GetBasicBlockFromAddress(m_state.current_instruction_address, "linked_call");
+	BasicBlock *unknown_block = GetBasicBlockFromAddress(m_state.current_instruction_address, "linked_callee_exit");
+	BasicBlock *fallback_block = GetBasicBlockFromAddress(m_state.current_instruction_address, "unlinked_call");
+	BasicBlock *call_end = GetBasicBlockFromAddress(m_state.current_instruction_address, "linked_call_end");
+	m_ir_builder->CreateCondBr(is_linked, linked_block, fallback_block);
+
+	m_ir_builder->SetInsertPoint(linked_block);
+	CallInst *call = m_ir_builder->CreateCall2(function, m_state.args[CompileTaskState::Args::State], m_ir_builder->getInt64(0));
+	call->setCallingConv(CallingConv::X86_64_Win64);
+	m_ir_builder->CreateCondBr(m_ir_builder->CreateICmpEQ(call, m_ir_builder->getInt32(ExecutionStatus::ExecutionStatusBlockEnded)), unknown_block, call_end);
+
+	// If the callee left its compiled range, execute it until it returns
+	m_ir_builder->SetInsertPoint(unknown_block);
+	CallInst *unknown_call = m_ir_builder->CreateCall2(m_execute_unknown_block, m_state.args[CompileTaskState::Args::State], m_ir_builder->getInt64(0));
+	unknown_call->setCallingConv(m_execute_unknown_block->getCallingConv());
+	m_ir_builder->CreateBr(call_end);
+
+	m_ir_builder->SetInsertPoint(fallback_block);
+	Value *fallback_status = fallback();
+	BasicBlock *fallback_end = m_ir_builder->GetInsertBlock();
+	m_ir_builder->CreateBr(call_end);
+
+	m_ir_builder->SetInsertPoint(call_end);
+	PHINode *status = m_ir_builder->CreatePHI(m_ir_builder->getInt32Ty(), 3);
+	status->addIncoming(call, linked_block);
+	status->addIncoming(unknown_call, unknown_block);
+	status->addIncoming(fallback_status, fallback_end);
+	return status;
+}
+
+Value * Compiler::GetRawSpuMmioCondition(Value * addr_i64) {
+	auto addr_i32 = m_ir_builder->CreateTrunc(addr_i64, m_ir_builder->getInt32Ty());
+	auto in_range_i1 = m_ir_builder->CreateICmpULT(m_ir_builder->CreateSub(addr_i32, m_ir_builder->getInt32(RAW_SPU_BASE_ADDR)), m_ir_builder->getInt32(6 * RAW_SPU_OFFSET));
+	auto is_prob_i1 = m_ir_builder->CreateICmpUGE(m_ir_builder->CreateAnd(addr_i32, RAW_SPU_OFFSET - 1), m_ir_builder->getInt32(RAW_SPU_PROB_OFFSET));
+	auto mmio_i1 = m_ir_builder->CreateAnd(in_range_i1, is_prob_i1);
+
+	// Constant addresses are folded by the builder
+	auto mmio_const = dyn_cast<ConstantInt>(mmio_i1);
+	return mmio_const && mmio_const->isZero() ? nullptr : mmio_i1;
+}
+
+u32 Compiler::GetUniqueBasicBlockIndex(const std::string & suffix) {
+	for (u32 i = 0;; i++) {
+		if (!GetBasicBlockFromAddress(m_state.current_instruction_address, fmt::format("%s_%u", suffix, i), false)) {
+			return i;
+		}
+	}
+}
+
 Value * Compiler::ReadMemory(Value * addr_i64, u32 bits, u32 alignment, bool bswap, bool could_be_mmio) {
 	addr_i64 = m_ir_builder->CreateAnd(addr_i64, 0xFFFFFFFF);
+
+	// Raw SPU registers are accessed directly instead of faulting into the access violation handler
+	auto mmio_i1 = bits == 32 && bswap && could_be_mmio ? GetRawSpuMmioCondition(addr_i64) : nullptr;
+	BasicBlock *mmio_block = nullptr, *memory_block = nullptr, *end_block = nullptr;
+	Value *mmio_val_i32 = nullptr;
+
+	if (mmio_i1) {
+		const u32 index = GetUniqueBasicBlockIndex("mmio");
+		mmio_block = GetBasicBlockFromAddress(m_state.current_instruction_address, fmt::format("mmio_%u", index));
+		auto error_block = GetBasicBlockFromAddress(m_state.current_instruction_address, fmt::format("mmio_error_%u", index));
+		memory_block = GetBasicBlockFromAddress(m_state.current_instruction_address, fmt::format("memory_%u", index));
+		end_block = GetBasicBlockFromAddress(m_state.current_instruction_address, fmt::format("mmio_end_%u", index));
+		m_ir_builder->CreateCondBr(mmio_i1, mmio_block, memory_block);
+
+		// The register value is returned in the low half, an exception is reported with any upper bit set
+		m_ir_builder->SetInsertPoint(mmio_block);
+		auto ret_i64 = Call<u64>("raw_spu_read_reg", m_state.args[CompileTaskState::Args::State], m_ir_builder->CreateTrunc(addr_i64, m_ir_builder->getInt32Ty()));
+		mmio_val_i32 = m_ir_builder->CreateTrunc(ret_i64, m_ir_builder->getInt32Ty());
+		m_ir_builder->CreateCondBr(m_ir_builder->CreateICmpUGT(ret_i64, m_ir_builder->getInt64(0xFFFFFFFF)), error_block, end_block);
+
+		m_ir_builder->SetInsertPoint(error_block);
+		m_ir_builder->CreateRet(m_ir_builder->getInt32(ExecutionStatus::ExecutionStatusPropagateException));
+
+		m_ir_builder->SetInsertPoint(memory_block);
+	}
+
 	auto eaddr_i64 = m_ir_builder->CreateAdd(addr_i64, m_ir_builder->getInt64((u64)vm::base(0)));
 	auto eaddr_ix_ptr = m_ir_builder->CreateIntToPtr(eaddr_i64, m_ir_builder->getIntNTy(bits)->getPointerTo());
 	auto val_ix = (Value *)m_ir_builder->CreateLoad(eaddr_ix_ptr, alignment);
@@ -5494,18 +5700,56 @@ Value * Compiler::ReadMemory(Value * addr_i64, u32 bits, u32 alignment, bool bsw
 		val_ix = m_ir_builder->CreateCall(Intrinsic::getDeclaration(m_module, Intrinsic::bswap, m_ir_builder->getIntNTy(bits)), val_ix);
 	}
 
+	if (mmio_i1) {
+		m_ir_builder->CreateBr(end_block);
+		m_ir_builder->SetInsertPoint(end_block);
+		auto phi = m_ir_builder->CreatePHI(m_ir_builder->getInt32Ty(), 2);
+		phi->addIncoming(mmio_val_i32, mmio_block);
+		phi->addIncoming(val_ix, memory_block);
+		val_ix = phi;
+	}
+
 	return val_ix;
 }
 
 void Compiler::WriteMemory(Value * addr_i64, Value * val_ix, u32 alignment, bool bswap, bool could_be_mmio) {
+	addr_i64 = m_ir_builder->CreateAnd(addr_i64, 0xFFFFFFFF);
+
+	// Raw SPU registers are accessed directly instead of faulting into the access violation handler
+	auto mmio_i1 = val_ix->getType()->isIntegerTy(32) && bswap && could_be_mmio ? GetRawSpuMmioCondition(addr_i64) : nullptr;
+	BasicBlock *end_block = nullptr;
+
+	if (mmio_i1) {
+		const u32 index = GetUniqueBasicBlockIndex("mmio");
+		auto mmio_block = GetBasicBlockFromAddress(m_state.current_instruction_address, fmt::format("mmio_%u", index));
+		auto error_block = GetBasicBlockFromAddress(m_state.current_instruction_address, fmt::format("mmio_error_%u", index));
+		auto memory_block = GetBasicBlockFromAddress(m_state.current_instruction_address, fmt::format("memory_%u", index));
+		end_block = GetBasicBlockFromAddress(m_state.current_instruction_address, fmt::format("mmio_end_%u", index));
+		m_ir_builder->CreateCondBr(mmio_i1, mmio_block, memory_block);
+
+		// The register takes the value in host byte order
+		m_ir_builder->SetInsertPoint(mmio_block);
+		auto failed_i1 = Call<bool>("raw_spu_write_reg", m_state.args[CompileTaskState::Args::State], m_ir_builder->CreateTrunc(addr_i64, m_ir_builder->getInt32Ty()), val_ix);
+		m_ir_builder->CreateCondBr(failed_i1, error_block, end_block);
+
+		m_ir_builder->SetInsertPoint(error_block);
+		m_ir_builder->CreateRet(m_ir_builder->getInt32(ExecutionStatus::ExecutionStatusPropagateException));
+
+		m_ir_builder->SetInsertPoint(memory_block);
+	}
+
 	if (val_ix->getType()->getIntegerBitWidth() > 8 && bswap) {
 		val_ix = m_ir_builder->CreateCall(Intrinsic::getDeclaration(m_module, Intrinsic::bswap, val_ix->getType()), val_ix);
 	}
 
-	addr_i64 = m_ir_builder->CreateAnd(addr_i64, 0xFFFFFFFF);
 	auto eaddr_i64 = m_ir_builder->CreateAdd(addr_i64, m_ir_builder->getInt64((u64)vm::base(0)));
 	auto eaddr_ix_ptr = m_ir_builder->CreateIntToPtr(eaddr_i64, val_ix->getType()->getPointerTo());
 	m_ir_builder->CreateAlignedStore(val_ix, eaddr_ix_ptr, alignment);
+
+	if (mmio_i1) {
+		m_ir_builder->CreateBr(end_block);
+		m_ir_builder->SetInsertPoint(end_block);
+	}
 }
 
 void Compiler::CompilationError(const std::string & error) {
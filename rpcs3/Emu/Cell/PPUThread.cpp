@@ -3,6 +3,7 @@
 #include "Emu/System.h"
 #include "Emu/state.h"
 #include "Emu/IdManager.h"
+#include "Emu/PerfCounters.h"
 #include "Emu/Cell/PPUThread.h"
 #include "Emu/Cell/PPUDecoder.h"
 #include "Emu/Cell/PPUInterpreter.h"
@@ -11,6 +12,8 @@
 //#include "Emu/Cell/PPURecompiler.h"
 #include "Utilities/VirtualMemory.h"
 
+#include <bitset>
+
 #ifdef _WIN32
 #include <Windows.h>
 #else
@@ -23,36 +26,285 @@ u64 rotate_mask[64][64];
 extern u32 ppu_get_tls(u32 thread);
 extern void ppu_free_tls(u32 thread);
 
-//thread_local const std::weak_ptr<ppu_decoder_cache_t> g_tls_ppu_decoder_cache = fxm::get<ppu_decoder_cache_t>();
-thread_local const ppu_decoder_cache_t* g_tls_ppu_decoder_cache = nullptr; // temporarily, because thread_local is not fully available
+//thread_local std::weak_ptr<ppu_decoder_cache_t> g_tls_ppu_decoder_cache = fxm::get<ppu_decoder_cache_t>();
+thread_local ppu_decoder_cache_t* g_tls_ppu_decoder_cache = nullptr; // temporarily, because thread_local is not fully available
+
+static const fiber_tls_t s_fiber_tls_ppu_decoder_cache([]() -> void* { return &g_tls_ppu_decoder_cache; }, sizeof(g_tls_ppu_decoder_cache));
 
 ppu_decoder_cache_t::ppu_decoder_cache_t()
 	: pointer(static_cast<decltype(pointer)>(memory_helper::reserve_memory(0x200000000)))
+	, opcodes(static_cast<decltype(opcodes)>(memory_helper::reserve_memory(0x100000000)))
 {
 }
 
 ppu_decoder_cache_t::~ppu_decoder_cache_t()
 {
+	const auto pages = std::count_if(m_pages.begin(), m_pages.end(), [](const atomic_t<u8>& page) { return page != 0; });
+
+	perf::mem_add(perf::mem_ppu_decoder, -s64(pages * 4096 * (sizeof(ppu_inter_func_t) + sizeof(u32)) / 4));
+
 	memory_helper::free_reserved_memory(pointer, 0x200000000);
+	memory_helper::free_reserved_memory(opcodes, 0x100000000);
 }
 
 void ppu_decoder_cache_t::initialize(u32 addr, u32 size)
 {
-	memory_helper::commit_page_memory(pointer + addr / 4, size * 2);
+	// decode without the lock (several ranges may be initialized concurrently), each function is stored with its opcode
+	std::vector<ppu_inter_func_t> funcs(size / 4);
+	std::vector<u32> codes(size / 4);
 
 	PPUInterpreter2* inter;
 	PPUDecoder dec(inter = new PPUInterpreter2);
 
-	for (u32 pos = addr; pos < addr + size; pos += 4)
+	for (u32 i = 0; i < size / 4; i++)
 	{
 		inter->func = ppu_interpreter::NULL_OP;
 
 		// decode PPU opcode
-		dec.Decode(vm::ps3::read32(pos));
+		const u32 opcode = vm::ps3::read32(addr + i * 4);
+		dec.Decode(opcode);
+
+		funcs[i] = inter->func;
+		codes[i] = opcode;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	memory_helper::commit_page_memory(pointer + addr / 4, size * 2);
+	memory_helper::commit_page_memory(opcodes + addr / 4, size);
+
+	// store function addresses (before the opcodes, which validate them)
+	std::memcpy(pointer + addr / 4, funcs.data(), size / 4 * sizeof(ppu_inter_func_t));
+	std::memcpy(opcodes + addr / 4, codes.data(), size);
+
+	u32 new_pages = 0;
+
+	for (u32 i = addr / 4096; i < (addr + size) / 4096; i++)
+	{
+		new_pages += !m_pages[i];
+		m_pages[i] = true;
+	}
+
+	perf::mem_add(perf::mem_ppu_decoder, new_pages * 4096ll * (sizeof(ppu_inter_func_t) + sizeof(u32)) / 4);
+}
+
+void ppu_decoder_cache_t::initialize_page(u32 addr)
+{
+	const u32 page = addr & ~0xfff;
+
+	if (!m_pages[page / 4096] && vm::check_addr(page, 4096))
+	{
+		initialize(page, 4096);
+	}
+}
+
+ppu_inter_func_t ppu_decoder_cache_t::update(u32 addr, u32 opcode)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	PPUInterpreter2* inter;
+	PPUDecoder dec(inter = new PPUInterpreter2);
+
+	inter->func = ppu_interpreter::NULL_OP;
+	dec.Decode(opcode);
+
+	pointer[addr / 4] = inter->func;
+	opcodes[addr / 4] = opcode;
+
+	return inter->func;
+}
+
+void ppu_invalidate_code(u32 addr)
+{
+	// interpreter functions are validated by their opcodes and don't need to be invalidated
+#ifdef PPU_LLVM_RECOMPILER
+	ppu_recompiler_llvm::RecompilationEngine::InvalidatePage(addr & ~0xfff);
+#endif
+}
+
+bool ppu_on_code_write(u32 addr)
+{
+	// stop watching the page, it will be watched again when code is compiled from it
+	if (!vm::check_addr(addr, 1, vm::page_code_watch) || !vm::page_protect(addr & ~0xfff, 4096, vm::page_code_watch, 0, vm::page_code_watch))
+	{
+		return false;
+	}
+
+	ppu_invalidate_code(addr);
+
+	return true;
+}
+
+// Decode a load allowed in spin loops (returns its size, 0 if it isn't one)
+static u32 ppu_decode_spin_load(u32 op, u32& rd, u32& ra, s32& disp)
+{
+	rd = op >> 21 & 31;
+	ra = op >> 16 & 31;
+	disp = static_cast<s16>(op);
+
+	switch (op >> 26)
+	{
+	case 32: return 4; // lwz
+	case 34: return 1; // lbz
+	case 40: return 2; // lhz
+	case 42: return 2; // lha
+	case 58: disp &= ~3; return (op & 3) == 0 ? 8 : (op & 3) == 2 ? 4 : 0; // ld, lwa
+	}
+
+	return 0;
+}
+
+u32 ppu_find_spin_loop(u32 target, u32 addr)
+{
+	if (target > addr || addr - target > 16 * 4 || !vm::check_addr(target, addr - target + 4))
+	{
+		return 0;
+	}
+
+	// the loop must be closed by a conditional branch which doesn't decrement CTR or set LR
+	const u32 branch = vm::ps3::read32(addr);
+
+	if (branch >> 26 != 16 || branch & 1 || (branch >> 21 & 0x14) != 0x04)
+	{
+		return 0;
+	}
+
+	const u32 cr = 32; // register index used for CR
+
+	std::bitset<33> defined; // registers written by the preceding instructions of the loop
+	std::bitset<33> carried; // registers read before being written in the loop
+
+	u32 load = 0;
+	u32 load_ra = 0;
+
+	for (u32 pos = target; pos < addr; pos += 4)
+	{
+		const u32 op = vm::ps3::read32(pos);
+		const u32 rs = op >> 21 & 31;
+		const u32 ra = op >> 16 & 31;
+		const u32 rb = op >> 11 & 31;
+
+		std::bitset<33> uses, defs;
+
+		u32 rd, base;
+		s32 disp;
+
+		if (ppu_decode_spin_load(op, rd, base, disp))
+		{
+			if (load)
+			{
+				return 0;
+			}
+
+			load = pos;
+			load_ra = base;
+
+			if (base) uses.set(base);
+			defs.set(rd);
+		}
+		else switch (op >> 26)
+		{
+		case 10: // cmpli
+		case 11: // cmpi
+		{
+			uses.set(ra);
+			defs.set(cr);
+			break;
+		}
+
+		case 24: // ori (nop)
+		{
+			uses.set(rs);
+			defs.set(ra);
+			break;
+		}
 
-		// store function address
-		pointer[pos / 4] = inter->func;
+		case 28: // andi.
+		{
+			uses.set(rs);
+			defs.set(ra);
+			defs.set(cr);
+			break;
+		}
+
+		case 21: // rlwinm
+		{
+			uses.set(rs);
+			defs.set(ra);
+			if (op & 1) defs.set(cr);
+			break;
+		}
+
+		case 30: // rldicl, rldicr
+		{
+			if ((op >> 2 & 7) > 1) return 0;
+			uses.set(rs);
+			defs.set(ra);
+			if (op & 1) defs.set(cr);
+			break;
+		}
+
+		case 19: // isync
+		{
+			if ((op >> 1 & 0x3ff) != 150) return 0;
+			break;
+		}
+
+		case 31:
+		{
+			switch (op >> 1 & 0x3ff)
+			{
+			case 0: // cmp
+			case 32: // cmpl
+			{
+				uses.set(ra);
+				uses.set(rb);
+				defs.set(cr);
+				break;
+			}
+
+			case 28: // and
+			case 444: // or
+			{
+				uses.set(rs);
+				uses.set(rb);
+				defs.set(ra);
+				if (op & 1) defs.set(cr);
+				break;
+			}
+
+			case 598: // sync, lwsync
+			case 854: // eieio
+			{
+				break;
+			}
+
+			default: return 0;
+			}
+
+			break;
+		}
+
+		default: return 0;
+		}
+
+		// the load address must stay valid until the branch
+		if (load && load != pos && defs.test(load_ra) && load_ra)
+		{
+			return 0;
+		}
+
+		carried |= uses & ~defined;
+		defined |= defs;
 	}
+
+	// the branch condition must be computed in the loop, and values computed in the loop must not be used by the next iteration
+	if (!load || !defined.test(cr) || (carried & defined).any())
+	{
+		return 0;
+	}
+
+	return load;
 }
 
 PPUThread::PPUThread(const std::string& name)
@@ -134,6 +386,18 @@ bool PPUThread::handle_interrupt()
 	return false;
 }
 
+bool PPUThread::run_on_fiber() const
+{
+	if (!rpcs3::state.config.core.ppu_fibers.value())
+	{
+		return false;
+	}
+
+	// lv2 waits on the thread cv suspend the fiber, other host waits block the worker
+	fiber::start(rpcs3::state.config.core.ppu_fiber_workers.value());
+	return true;
+}
+
 void PPUThread::do_run()
 {
 	m_dec.reset();
@@ -146,7 +410,7 @@ void PPUThread::do_run()
 		break;
 	}
 
-	case ppu_decoder_type::interpreter2: // alternative interpreter
+	case ppu_decoder_type::interpreter2: // alternative interpreter (cached functions, see cpu_task)
 	{
 		break;
 	}
@@ -156,8 +420,7 @@ void PPUThread::do_run()
 #ifdef PPU_LLVM_RECOMPILER
 		m_dec.reset(new ppu_recompiler_llvm::CPUHybridDecoderRecompiler(*this));
 #else
-		LOG_ERROR(PPU, "This image does not include PPU JIT (LLVM)");
-		Emu.Pause();
+		LOG_ERROR(PPU, "This image does not include PPU JIT (LLVM), using interpreter2");
 #endif
 		break;
 	}
@@ -259,6 +522,49 @@ void PPUThread::fast_stop()
 	m_state |= CPU_STATE_RETURN;
 }
 
+void PPUThread::spin_wait(u32 addr, u32 target)
+{
+	if (addr != spin_branch)
+	{
+		// analyse the loop once when it's entered
+		spin_branch = addr;
+		spin_load = ppu_find_spin_loop(target, addr);
+		spin_count = 0;
+		return;
+	}
+
+	const u32 threshold = rpcs3::state.config.core.spin_loop_idle.value();
+
+	if (!spin_load || !threshold || ++spin_count < threshold)
+	{
+		return;
+	}
+
+	spin_count = 0;
+
+	// the code may have been modified
+	if (ppu_find_spin_loop(target, addr) != spin_load)
+	{
+		spin_load = 0;
+		return;
+	}
+
+	u32 rd, ra;
+	s32 disp;
+	const u32 size = ppu_decode_spin_load(vm::ps3::read32(spin_load), rd, ra, disp);
+	const u32 ea = (ra ? static_cast<u32>(GPR[ra]) : 0) + disp;
+
+	if (ea & (size - 1) || !vm::check_addr(ea, size))
+	{
+		return;
+	}
+
+	perf::add(perf::spin_waits);
+
+	// sleep until the value changes, plain stores of other threads are only seen after the timeout
+	vm::wait_change(*this, ea, size, 100);
+}
+
 void PPUThread::cpu_task()
 {
 	SetHostRoundingMode(FPSCR_RN_NEAR);
@@ -282,8 +588,6 @@ void PPUThread::cpu_task()
 		g_tls_ppu_decoder_cache = decoder_cache.get(); // unsafe (TODO)
 	}
 	
-	const auto exec_map = g_tls_ppu_decoder_cache->pointer;
-
 	if (m_dec)
 	{
 		while (true)
@@ -299,26 +603,43 @@ void PPUThread::cpu_task()
 	}
 	else
 	{
+		const auto decoder_cache = g_tls_ppu_decoder_cache;
+
+		// page of the last instruction, known to be initialized in the cache
+		u32 page = 1; // invalid page address
+
+		// instructions not added to the perf counter yet
+		u32 executed = 0;
+
 		while (true)
 		{
-			// get cached interpreter function address
-			const auto func = exec_map[PC / 4];
-
 			// check status
-			if (!m_state)
+			if (m_state)
 			{
-				// call interpreter function
-				func(*this, { vm::ps3::read32(PC) });
+				perf::add(perf::ppu_instructions, executed);
+				executed = 0;
 
-				// next instruction
-				PC += 4;
+				if (check_status()) break;
+			}
+
+			const u32 opcode = vm::ps3::read32(PC);
 
-				continue;
+			if ((PC & ~0xfff) != page)
+			{
+				decoder_cache->initialize_page(PC);
+				page = PC & ~0xfff;
 			}
-			
-			if (check_status())
+
+			// call cached interpreter function (decoded again if the code was modified)
+			decoder_cache->get(PC, opcode)(*this, { opcode });
+
+			// next instruction
+			PC += 4;
+
+			if (++executed == 0x10000)
 			{
-				break;
+				perf::add(perf::ppu_instructions, executed);
+				executed = 0;
 			}
 		}
 	}
@@ -539,6 +539,10 @@ public:
 	// When a thread has met an exception, this variable is used to retro propagate it through stack call.
 	std::exception_ptr pending_exception;
 
+	u32 spin_branch = 0; // address of the last taken backward branch checked for a spin loop
+	u32 spin_load = 0; // address of the load of its spin loop (0 if it isn't a spin loop)
+	u32 spin_count = 0; // consecutive iterations of the spin loop
+
 public:
 	PPUThread(const std::string& name);
 	virtual ~PPUThread() override;
@@ -555,6 +559,8 @@ public:
 	virtual void close_stack() override;
 
 	virtual bool handle_interrupt() override;
+	virtual s32 get_prio() const override { return prio; }
+	virtual bool run_on_fiber() const override;
 
 	u8 GetCR(const u8 n) const
 	{
@@ -825,8 +831,15 @@ public:
 	u64 get_stack_arg(s32 i);
 	void fast_call(u32 addr, u32 rtoc);
 	void fast_stop();
+
+	// Called on taken backward branches at addr, idles the thread if they close a spin loop which has been running for a while
+	void spin_wait(u32 addr, u32 target);
 };
 
+// Check whether the code from target to the conditional branch at addr is a spin loop: a single load from a loop-invariant
+// address and register-only instructions without loop-carried values (returns the address of the load or 0)
+u32 ppu_find_spin_loop(u32 target, u32 addr);
+
 class ppu_thread : cpu_thread
 {
 	static const u32 stack_align = 0x10;
@@ -1015,10 +1028,11 @@ force_inline T cast_from_ppu_gpr(const u64 reg)
 // flags set in ModuleFunc
 enum : u32
 {
-	MFF_FORCED_HLE = (1 << 0), // always call HLE function
-	MFF_NO_RETURN  = (1 << 1), // uses EIF_USE_BRANCH flag with LLE, ignored with MFF_FORCED_HLE
+	MFF_FORCED_HLE  = (1 << 0), // always call HLE function
+	MFF_NO_RETURN   = (1 << 1), // uses EIF_USE_BRANCH flag with LLE, ignored with MFF_FORCED_HLE
+	MFF_DIRECT_CALL = (1 << 2), // HLE function can be called directly from compiled code (doesn't modify PC or LR)
 
-	MFF_PERFECT    = /* 0 */ MFF_FORCED_HLE, // can be set for fully implemented functions with LLE compatibility
+	MFF_PERFECT     = /* 0 */ MFF_FORCED_HLE, // can be set for fully implemented functions with LLE compatibility
 };
 
 // flags passed with index
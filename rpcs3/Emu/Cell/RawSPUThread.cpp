@@ -2,6 +2,7 @@
 #include "Emu/Memory/Memory.h"
 #include "Emu/System.h"
 #include "Emu/SysCalls/Callback.h"
+#include "Emu/CPU/CPUThreadManager.h"
 
 #include "Emu/Cell/RawSPUThread.h"
 
@@ -235,3 +236,27 @@ void RawSPUThread::cpu_task()
 	// save next PC and current SPU Interrupt status
 	npc = pc | ((ch_event_stat & SPU_EVENT_INTR_ENABLED) != 0);
 }
+
+u32 raw_spu_read_reg(u32 addr)
+{
+	const auto thread = Emu.GetCPU().GetRawSPUThread((addr - RAW_SPU_BASE_ADDR) / RAW_SPU_OFFSET);
+
+	u32 value;
+
+	if (!thread || !thread->read_reg(addr, value))
+	{
+		throw EXCEPTION("Invalid RawSPU MMIO read (addr=0x%x)", addr);
+	}
+
+	return value;
+}
+
+void raw_spu_write_reg(u32 addr, u32 value)
+{
+	const auto thread = Emu.GetCPU().GetRawSPUThread((addr - RAW_SPU_BASE_ADDR) / RAW_SPU_OFFSET);
+
+	if (!thread || !thread->write_reg(addr, value))
+	{
+		throw EXCEPTION("Invalid RawSPU MMIO write (addr=0x%x, value=0x%x)", addr, value);
+	}
+}
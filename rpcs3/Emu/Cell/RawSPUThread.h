@@ -15,6 +15,16 @@ force_inline static u32 GetRawSPURegAddrByNum(int num, int offset)
 	return RAW_SPU_OFFSET * num + RAW_SPU_BASE_ADDR + RAW_SPU_PROB_OFFSET + offset;
 }
 
+// Check whether the address belongs to the problem state registers of a Raw SPU (not backed by memory)
+force_inline static bool IsRawSPUMMIO(u32 addr)
+{
+	return addr - RAW_SPU_BASE_ADDR < 6 * RAW_SPU_OFFSET && addr % RAW_SPU_OFFSET >= RAW_SPU_PROB_OFFSET;
+}
+
+// Access a Raw SPU problem state register directly, as the access violation handler would (throws if it doesn't exist)
+u32 raw_spu_read_reg(u32 addr);
+void raw_spu_write_reg(u32 addr, u32 value);
+
 class RawSPUThread final : public SPUThread
 {
 public:
@@ -1,5 +1,7 @@
 #include "stdafx.h"
 #include "Emu/System.h"
+#include "Utilities/Trace.h"
+#include "Emu/PerfCounters.h"
 
 #include "SPUDisAsm.h"
 #include "SPUThread.h"
@@ -15,27 +17,84 @@
 
 #include "asmjit.h"
 
+#ifndef _MSC_VER
+#include <cpuid.h>
+#endif
+
 #define SPU_OFF_128(x) asmjit::host::oword_ptr(*cpu, OFFSET_32(SPUThread, x))
 #define SPU_OFF_64(x) asmjit::host::qword_ptr(*cpu, OFFSET_32(SPUThread, x))
 #define SPU_OFF_32(x) asmjit::host::dword_ptr(*cpu, OFFSET_32(SPUThread, x))
 #define SPU_OFF_16(x) asmjit::host::word_ptr(*cpu, OFFSET_32(SPUThread, x))
 #define SPU_OFF_8(x) asmjit::host::byte_ptr(*cpu, OFFSET_32(SPUThread, x))
 
+static bool avx2_supported()
+{
+	// AVX (CPUID.1:ECX[28]) enabled by the OS (OSXSAVE and XCR0 with XMM and YMM state), and AVX2 (CPUID.7.0:EBX[5])
+#ifdef _MSC_VER
+	int regs[4];
+	__cpuid(regs, 0);
+
+	if (regs[0] < 7)
+	{
+		return false;
+	}
+
+	__cpuid(regs, 1);
+
+	if ((regs[2] & (3 << 27)) != (3 << 27) || (_xgetbv(0) & 6) != 6)
+	{
+		return false;
+	}
+
+	__cpuidex(regs, 7, 0);
+	return (regs[1] & (1 << 5)) != 0;
+#else
+	if (__get_cpuid_max(0, nullptr) < 7)
+	{
+		return false;
+	}
+
+	u32 eax, ebx, ecx, edx;
+	__cpuid(1, eax, ebx, ecx, edx);
+
+	if ((ecx & (3 << 27)) != (3 << 27))
+	{
+		return false;
+	}
+
+	u32 xcr0, xcr0_hi;
+	__asm__ volatile("xgetbv" : "=a"(xcr0), "=d"(xcr0_hi) : "c"(0));
+
+	if ((xcr0 & 6) != 6)
+	{
+		return false;
+	}
+
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+	return (ebx & (1 << 5)) != 0;
+#endif
+}
+
 spu_recompiler::spu_recompiler()
 	: m_jit(std::make_shared<asmjit::JitRuntime>())
+	, m_avx2(avx2_supported())
 {
-	asmjit::X86CpuInfo inf;
-	asmjit::X86CpuUtil::detect(&inf);
-
-	LOG_SUCCESS(SPU, "SPU Recompiler (ASMJIT) created...");
+	LOG_SUCCESS(SPU, "SPU Recompiler (ASMJIT) created (%s)...", m_avx2 ? "AVX2" : "SSE");
 
 	fs::file(fs::get_config_dir() + "SPUJIT.log", fom::rewrite).write(fmt::format("SPU JIT initialization...\n\nTitle: %s\nTitle ID: %s\n\n", Emu.GetTitle().c_str(), Emu.GetTitleID().c_str()));
 }
 
+spu_recompiler::~spu_recompiler()
+{
+	perf::mem_add(perf::mem_spu_jit, -s64(m_jit->getMemMgr()->getAllocatedBytes()));
+}
+
 void spu_recompiler::compile(spu_function_t& f)
 {
 	std::lock_guard<std::mutex> lock(m_mutex);
 
+	_log::timeline_scope scope("spu", "asmjit compile", f.addr);
+
 	if (f.compiled)
 	{
 		// return if function already compiled
@@ -150,8 +209,15 @@ void spu_recompiler::compile(spu_function_t& f)
 		log += dis_asm.last_opcode.c_str();
 		log += '\n';
 
-		// Recompiler function
-		(this->*spu_recompiler::opcodes[op])({ op });
+		// Recompiler function (skip instructions with dead results)
+		if (f.dead.empty() || !f.dead[(m_pos - f.addr) / 4])
+		{
+			(this->*spu_recompiler::opcodes[op])({ op });
+		}
+		else
+		{
+			compiler.addComment("Dead instruction skipped");
+		}
 
 		// Collect allocated xmm vars
 		for (u32 i = 0; i < vec_vars.size(); i++)
@@ -207,7 +273,9 @@ void spu_recompiler::compile(spu_function_t& f)
 	compiler.endFunc();
 
 	// Compile and store function address
-	f.compiled = asmjit_cast<spu_jit_func_t>(compiler.make());
+	const size_t allocated = m_jit->getMemMgr()->getAllocatedBytes();
+	f.compiled.store(asmjit_cast<spu_jit_func_t>(compiler.make()), std::memory_order_release);
+	perf::mem_add(perf::mem_spu_jit, s64(m_jit->getMemMgr()->getAllocatedBytes()) - s64(allocated));
 
 	// Add ASMJIT logs
 	log += logger.getString();
@@ -231,6 +299,19 @@ spu_recompiler::XmmLink spu_recompiler::XmmGet(s8 reg, XmmType type) // get xmm
 {
 	XmmLink result = XmmAlloc();
 
+	if (m_avx2)
+	{
+		switch (type)
+		{
+		case XmmType::Int: c->vmovdqa(result, SPU_OFF_128(gpr[reg])); break;
+		case XmmType::Float: c->vmovaps(result, SPU_OFF_128(gpr[reg])); break;
+		case XmmType::Double: c->vmovapd(result, SPU_OFF_128(gpr[reg])); break;
+		default: throw EXCEPTION("Invalid XmmType");
+		}
+
+		return result;
+	}
+
 	switch (type)
 	{
 	case XmmType::Int: c->movdqa(result, SPU_OFF_128(gpr[reg])); break;
@@ -257,7 +338,7 @@ inline asmjit::X86Mem spu_recompiler::XmmConst(__m128i data)
 	return XmmConst(v128::fromV(data));
 }
 
-void spu_recompiler::InterpreterCall(spu_opcode_t op)
+void spu_recompiler::InterpreterCall(spu_opcode_t op, spu_inter_func_t func)
 {
 	auto gate = [](SPUThread* _spu, u32 opcode, spu_inter_func_t _func) noexcept -> u32
 	{
@@ -294,7 +375,7 @@ void spu_recompiler::InterpreterCall(spu_opcode_t op)
 	asmjit::X86CallNode* call = c->call(asmjit::imm_ptr(asmjit_cast<void*, u32(SPUThread*, u32, spu_inter_func_t)>(gate)), asmjit::kFuncConvHost, asmjit::FuncBuilder3<u32, void*, u32, void*>());
 	call->setArg(0, *cpu);
 	call->setArg(1, asmjit::imm_u(op.opcode));
-	call->setArg(2, asmjit::imm_ptr(asmjit_cast<void*>(spu_interpreter::fast::g_spu_opcode_table[op.opcode])));
+	call->setArg(2, asmjit::imm_ptr(asmjit_cast<void*>(func ? func : spu_interpreter::fast::g_spu_opcode_table[op.opcode])));
 	call->setRet(0, *addr);
 
 	// return immediately if an error occured
@@ -307,7 +388,13 @@ void spu_recompiler::FunctionCall()
 {
 	auto gate = [](SPUThread* _spu, u32 link) noexcept -> u32
 	{
+		// Call override function directly since the type is known
+		auto& dec = static_cast<SPURecompilerDecoder&>(*_spu->m_dec);
+
+		const u32 old_link = dec.return_link;
+
 		_spu->recursion_level++;
+		dec.return_link = link;
 
 		try
 		{
@@ -340,8 +427,7 @@ void spu_recompiler::FunctionCall()
 
 			while (!_spu->m_state || !_spu->check_status())
 			{
-				// Call override function directly since the type is known
-				static_cast<SPURecompilerDecoder&>(*_spu->m_dec).DecodeMemory(_spu->offset + _spu->pc);
+				dec.DecodeMemory(_spu->offset + _spu->pc);
 
 				if (_spu->m_state & CPU_STATE_RETURN)
 				{
@@ -352,11 +438,13 @@ void spu_recompiler::FunctionCall()
 				{
 					// returned successfully
 					_spu->recursion_level--;
+					dec.return_link = old_link;
 					return 0;
 				}
 			}
 
 			_spu->recursion_level--;
+			dec.return_link = old_link;
 			return 0x2000000 | _spu->pc;
 		}
 		catch (...)
@@ -364,6 +452,7 @@ void spu_recompiler::FunctionCall()
 			_spu->pending_exception = std::current_exception();
 
 			_spu->recursion_level--;
+			dec.return_link = old_link;
 			return 0x1000000 | _spu->pc;
 		}
 	};
@@ -379,6 +468,27 @@ void spu_recompiler::FunctionCall()
 	c->unuse(*addr);
 }
 
+void spu_recompiler::CodeWriteCheck()
+{
+	auto gate = [](SPUThread* _spu, u32 lsa) noexcept
+	{
+		_spu->code_write(lsa, 16);
+	};
+
+	// skip the call unless the page is watched by the target cache
+	asmjit::Label skip = c->newLabel();
+	c->shr(*addr, 10);
+	c->cmp(asmjit::host::byte_ptr(*cpu, *addr, 0, OFFSET_32(SPUThread, code_page_watch)), 0);
+	c->je(skip);
+	c->shl(*addr, 10);
+
+	asmjit::X86CallNode* call = c->call(asmjit::imm_ptr(asmjit_cast<void*, void(SPUThread*, u32)>(gate)), asmjit::kFuncConvHost, asmjit::FuncBuilder2<void, SPUThread*, u32>());
+	call->setArg(0, *cpu);
+	call->setArg(1, *addr);
+
+	c->bind(skip);
+}
+
 void spu_recompiler::STOP(spu_opcode_t op)
 {
 	InterpreterCall(op); // TODO
@@ -412,6 +522,12 @@ void spu_recompiler::RDCH(spu_opcode_t op)
 
 void spu_recompiler::RCHCNT(spu_opcode_t op)
 {
+	if (m_func->poll_loops.count(m_pos))
+	{
+		// channel polling loop: idle instead of spinning
+		return InterpreterCall(op, &spu_interpreter::RCHCNT_POLL);
+	}
+
 	InterpreterCall(op); // TODO
 }
 
@@ -473,6 +589,21 @@ void spu_recompiler::ABSDB(spu_opcode_t op)
 
 void spu_recompiler::ROT(spu_opcode_t op)
 {
+	if (m_avx2)
+	{
+		const XmmLink& va = XmmGet(op.ra, XmmType::Int);
+		const XmmLink& vb = XmmGet(op.rb, XmmType::Int);
+		const XmmLink& v1 = XmmAlloc();
+		c->vpand(vb, vb, XmmConst(_mm_set1_epi32(0x1f)));
+		c->vmovdqa(v1, XmmConst(_mm_set1_epi32(32)));
+		c->vpsubd(v1, v1, vb); // counts of 32 produce zero
+		c->vpsllvd(vb, va, vb);
+		c->vpsrlvd(va, va, v1);
+		c->vpor(va, va, vb);
+		c->vmovdqa(SPU_OFF_128(gpr[op.rt]), va);
+		return;
+	}
+
 	auto body = [](u32* t, const u32* a, const s32* b) noexcept
 	{
 		for (u32 i = 0; i < 4; i++)
@@ -500,6 +631,19 @@ void spu_recompiler::ROT(spu_opcode_t op)
 
 void spu_recompiler::ROTM(spu_opcode_t op)
 {
+	if (m_avx2)
+	{
+		const XmmLink& va = XmmGet(op.ra, XmmType::Int);
+		const XmmLink& vb = XmmGet(op.rb, XmmType::Int);
+		const XmmLink& v1 = XmmAlloc();
+		c->vpxor(v1, v1, v1);
+		c->vpsubd(vb, v1, vb);
+		c->vpand(vb, vb, XmmConst(_mm_set1_epi32(0x3f))); // counts above 31 produce zero
+		c->vpsrlvd(va, va, vb);
+		c->vmovdqa(SPU_OFF_128(gpr[op.rt]), va);
+		return;
+	}
+
 	auto body = [](u32* t, const u32* a, const u32* b) noexcept
 	{
 		for (u32 i = 0; i < 4; i++)
@@ -528,6 +672,19 @@ void spu_recompiler::ROTM(spu_opcode_t op)
 
 void spu_recompiler::ROTMA(spu_opcode_t op)
 {
+	if (m_avx2)
+	{
+		const XmmLink& va = XmmGet(op.ra, XmmType::Int);
+		const XmmLink& vb = XmmGet(op.rb, XmmType::Int);
+		const XmmLink& v1 = XmmAlloc();
+		c->vpxor(v1, v1, v1);
+		c->vpsubd(vb, v1, vb);
+		c->vpand(vb, vb, XmmConst(_mm_set1_epi32(0x3f))); // counts above 31 fill with the sign bit
+		c->vpsravd(va, va, vb);
+		c->vmovdqa(SPU_OFF_128(gpr[op.rt]), va);
+		return;
+	}
+
 	auto body = [](s32* t, const s32* a, const u32* b) noexcept
 	{
 		for (u32 i = 0; i < 4; i++)
@@ -556,6 +713,16 @@ void spu_recompiler::ROTMA(spu_opcode_t op)
 
 void spu_recompiler::SHL(spu_opcode_t op)
 {
+	if (m_avx2)
+	{
+		const XmmLink& va = XmmGet(op.ra, XmmType::Int);
+		const XmmLink& vb = XmmGet(op.rb, XmmType::Int);
+		c->vpand(vb, vb, XmmConst(_mm_set1_epi32(0x3f))); // counts above 31 produce zero
+		c->vpsllvd(va, va, vb);
+		c->vmovdqa(SPU_OFF_128(gpr[op.rt]), va);
+		return;
+	}
+
 	auto body = [](u32* t, const u32* a, const u32* b) noexcept
 	{
 		for (u32 i = 0; i < 4; i++)
@@ -697,6 +864,16 @@ void spu_recompiler::ROTI(spu_opcode_t op)
 	const int s = op.i7 & 0x1f;
 	const XmmLink& va = XmmGet(op.ra, XmmType::Int);
 	const XmmLink& v1 = XmmAlloc();
+
+	if (m_avx2)
+	{
+		c->vpsrld(v1, va, 32 - s);
+		c->vpslld(va, va, s);
+		c->vpor(va, va, v1);
+		c->vmovdqa(SPU_OFF_128(gpr[op.rt]), va);
+		return;
+	}
+
 	c->movdqa(v1, va);
 	c->pslld(va, s);
 	c->psrld(v1, 32 - s);
@@ -737,6 +914,16 @@ void spu_recompiler::ROTHI(spu_opcode_t op)
 	const int s = op.i7 & 0xf;
 	const XmmLink& va = XmmGet(op.ra, XmmType::Int);
 	const XmmLink& v1 = XmmAlloc();
+
+	if (m_avx2)
+	{
+		c->vpsrlw(v1, va, 16 - s);
+		c->vpsllw(va, va, s);
+		c->vpor(va, va, v1);
+		c->vmovdqa(SPU_OFF_128(gpr[op.rt]), va);
+		return;
+	}
+
 	c->movdqa(v1, va);
 	c->psllw(va, s);
 	c->psrlw(v1, 16 - s);
@@ -887,11 +1074,33 @@ void spu_recompiler::STQX(spu_opcode_t op)
 	const XmmLink& vt = XmmGet(op.rt, XmmType::Int);
 	c->pshufb(vt, XmmConst(_mm_set_epi32(0x00010203, 0x04050607, 0x08090a0b, 0x0c0d0e0f)));
 	c->movdqa(asmjit::host::oword_ptr(*ls, *addr), vt);
+	CodeWriteCheck();
 	c->unuse(*addr);
 }
 
 void spu_recompiler::BI(spu_opcode_t op)
 {
+	const auto found = m_func->branch_targets.find(m_pos);
+
+	if (found != m_func->branch_targets.end() && !op.d && !op.e)
+	{
+		// constant target: link directly
+		const u32 target = found->second;
+
+		if (labels[target / 4].isInitialized())
+		{
+			c->jmp(labels[target / 4]);
+		}
+		else
+		{
+			c->mov(*addr, target);
+			c->jmp(*end);
+			c->unuse(*addr);
+		}
+
+		return;
+	}
+
 	c->mov(*addr, SPU_OFF_32(gpr[op.ra]._u32[3]));
 	c->and_(*addr, 0x3fffc);
 	if (op.d || op.e) c->or_(*addr, op.e << 26 | op.d << 27); // interrupt flags neutralize jump table
@@ -900,11 +1109,21 @@ void spu_recompiler::BI(spu_opcode_t op)
 
 void spu_recompiler::BISL(spu_opcode_t op)
 {
-	c->mov(*addr, SPU_OFF_32(gpr[op.ra]._u32[3]));
-	c->and_(*addr, 0x3fffc);
-	if (op.d || op.e) c->or_(*addr, op.e << 26 | op.d << 27); // interrupt flags stored to PC
-	c->mov(SPU_OFF_32(pc), *addr);
-	c->unuse(*addr);
+	const auto found = m_func->branch_targets.find(m_pos);
+
+	if (found != m_func->branch_targets.end() && !op.d && !op.e)
+	{
+		// constant target
+		c->mov(SPU_OFF_32(pc), found->second);
+	}
+	else
+	{
+		c->mov(*addr, SPU_OFF_32(gpr[op.ra]._u32[3]));
+		c->and_(*addr, 0x3fffc);
+		if (op.d || op.e) c->or_(*addr, op.e << 26 | op.d << 27); // interrupt flags stored to PC
+		c->mov(SPU_OFF_32(pc), *addr);
+		c->unuse(*addr);
+	}
 
 	const XmmLink& vr = XmmAlloc();
 	c->movdqa(vr, XmmConst(_mm_set_epi32(spu_branch_target(m_pos + 4), 0, 0, 0)));
@@ -991,15 +1210,13 @@ void spu_recompiler::FSMH(spu_opcode_t op)
 
 void spu_recompiler::FSMB(spu_opcode_t op)
 {
+	// see spu_fsmb()
 	const XmmLink& vr = XmmAlloc();
-	c->mov(*qw0, asmjit::imm_ptr((void*)g_spu_imm.fsmb));
-	c->mov(*addr, SPU_OFF_32(gpr[op.ra]._u32[3]));
-	c->and_(*addr, 0xffff);
-	c->shl(*addr, 4);
-	c->movdqa(vr, asmjit::host::oword_ptr(*qw0, *addr));
+	c->movd(vr, SPU_OFF_32(gpr[op.ra]._u32[3]));
+	c->pshufb(vr, XmmConst(_mm_set_epi64x(0x0101010101010101, 0)));
+	c->pand(vr, XmmConst(_mm_set1_epi64x(0x8040201008040201)));
+	c->pcmpeqb(vr, XmmConst(_mm_set1_epi64x(0x8040201008040201)));
 	c->movdqa(SPU_OFF_128(gpr[op.rt]), vr);
-	c->unuse(*addr);
-	c->unuse(*qw0);
 }
 
 void spu_recompiler::FREST(spu_opcode_t op)
@@ -2045,6 +2262,9 @@ void spu_recompiler::STQA(spu_opcode_t op)
 	const XmmLink& vt = XmmGet(op.rt, XmmType::Int);
 	c->pshufb(vt, XmmConst(_mm_set_epi32(0x00010203, 0x04050607, 0x08090a0b, 0x0c0d0e0f)));
 	c->movdqa(asmjit::host::oword_ptr(*ls, spu_ls_target(0, op.i16)), vt);
+	c->mov(*addr, spu_ls_target(0, op.i16));
+	CodeWriteCheck();
+	c->unuse(*addr);
 }
 
 void spu_recompiler::BRNZ(spu_opcode_t op)
@@ -2127,6 +2347,9 @@ void spu_recompiler::STQR(spu_opcode_t op)
 	const XmmLink& vt = XmmGet(op.rt, XmmType::Int);
 	c->pshufb(vt, XmmConst(_mm_set_epi32(0x00010203, 0x04050607, 0x08090a0b, 0x0c0d0e0f)));
 	c->movdqa(asmjit::host::oword_ptr(*ls, spu_ls_target(m_pos, op.i16)), vt);
+	c->mov(*addr, spu_ls_target(m_pos, op.i16));
+	CodeWriteCheck();
+	c->unuse(*addr);
 }
 
 void spu_recompiler::BRA(spu_opcode_t op)
@@ -2211,7 +2434,7 @@ void spu_recompiler::BR(spu_opcode_t op)
 void spu_recompiler::FSMBI(spu_opcode_t op)
 {
 	const XmmLink& vr = XmmAlloc();
-	c->movdqa(vr, XmmConst(g_spu_imm.fsmb[op.i16]));
+	c->movdqa(vr, XmmConst(spu_fsmb(op.i16)));
 	c->movdqa(SPU_OFF_128(gpr[op.rt]), vr);
 }
 
@@ -2356,6 +2579,7 @@ void spu_recompiler::STQD(spu_opcode_t op)
 	const XmmLink& vt = XmmGet(op.rt, XmmType::Int);
 	c->pshufb(vt, XmmConst(_mm_set_epi32(0x00010203, 0x04050607, 0x08090a0b, 0x0c0d0e0f)));
 	c->movdqa(asmjit::host::oword_ptr(*ls, *addr), vt);
+	CodeWriteCheck();
 	c->unuse(*addr);
 }
 
@@ -2543,6 +2767,33 @@ void spu_recompiler::SHUFB(spu_opcode_t op)
 	const XmmLink& v3 = XmmAlloc();
 	const XmmLink& v4 = XmmAlloc();
 	const XmmLink& vFF = XmmAlloc();
+
+	if (m_avx2)
+	{
+		// same algorithm without copies
+		c->vpand(v2, v0, XmmConst(_mm_set1_epi8(-0x20))); //   v2 = mask & 11100000
+		c->vpcmpeqb(vFF, v2, XmmConst(_mm_set1_epi8(-0x40))); // vFF = (mask & 11100000 == 11000000) ? 0xff : 0
+		c->vpand(v4, v0, XmmConst(_mm_set1_epi8(-0x80))); //   v4 = mask & 10000000
+		c->vpcmpeqb(v4, v4, XmmConst(_mm_set1_epi8(-0x80))); // v4 = (mask & 10000000 == 10000000) ? 0xff : 0
+		c->vpcmpeqb(v2, v2, XmmConst(_mm_set1_epi8(-0x20))); // v2 = (mask & 11100000 == 11100000) ? 0xff : 0
+		c->vpand(v2, v2, XmmConst(_mm_set1_epi8(-0x80))); //   v2 = (mask & 11100000 == 11100000) ? 0x80 : 0
+		c->vpor(vFF, vFF, v2); //                           vFF = special values
+		c->vpand(v1, v0, XmmConst(_mm_set1_epi8(0x1f))); //    v1 = mask & 00011111
+		c->vpxor(v1, v1, XmmConst(_mm_set1_epi8(0x10))); //    v1 = (mask & 00011111) ^ 00010000
+		c->vmovdqa(v2, XmmConst(_mm_set1_epi8(0x0f)));
+		c->vpsubb(v2, v2, v1); //                           v2 = 00001111 - ((mask & 00011111) ^ 00010000)
+		c->vmovdqa(v1, SPU_OFF_128(gpr[op.rb]));
+		c->vpshufb(v1, v1, v2); //                          v1 = select(op.rb, v2)
+		c->vpxor(v2, v2, XmmConst(_mm_set1_epi8(-0x10))); //   v2 = v2 ^ 11110000
+		c->vmovdqa(v3, SPU_OFF_128(gpr[op.ra]));
+		c->vpshufb(v3, v3, v2); //                          v3 = select(op.ra, v2)
+		c->vpor(v1, v1, v3);
+		c->vpandn(v4, v4, v1); //                           v4 = v1 & ((mask & 10000000 == 10000000) ? 0 : 0xff)
+		c->vpor(vFF, vFF, v4);
+		c->vmovdqa(SPU_OFF_128(gpr[op.rt4]), vFF);
+		return;
+	}
+
 	c->movdqa(v2, v0); // v2 = mask
 	// generate specific values:
 	c->movdqa(v1, XmmConst(_mm_set1_epi8(-0x20))); // v1 = 11100000
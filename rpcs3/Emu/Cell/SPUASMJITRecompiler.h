@@ -17,9 +17,14 @@ class spu_recompiler : public SPURecompilerBase
 {
 	const std::shared_ptr<asmjit::JitRuntime> m_jit;
 
+	// AVX2 tier: VEX-encoded 3-operand instructions and variable shifts (SSE code is generated otherwise)
+	const bool m_avx2;
+
 public:
 	spu_recompiler();
 
+	~spu_recompiler();
+
 	virtual void compile(spu_function_t& f) override;
 
 private:
@@ -76,8 +81,9 @@ private:
 	asmjit::X86Mem XmmConst(__m128i data);
 
 private:
-	void InterpreterCall(spu_opcode_t op);
+	void InterpreterCall(spu_opcode_t op, spu_inter_func_t func = nullptr); // func replaces the decoded interpreter function
 	void FunctionCall();
+	void CodeWriteCheck(); // uses and clobbers *addr (LS address of the store)
 
 	void STOP(spu_opcode_t op);
 	void LNOP(spu_opcode_t op);
@@ -1,9 +1,13 @@
 #include "stdafx.h"
+#include "Emu/state.h"
+#include "Emu/PerfCounters.h"
 
 #include "Crypto/sha1.h"
 #include "SPURecompiler.h"
 #include "SPUAnalyser.h"
 
+#include <bitset>
+
 const spu_opcode_table_t<spu_itype_t> g_spu_itype{ DEFINE_SPU_OPCODES(spu_itype::), spu_itype::UNK };
 
 std::shared_ptr<spu_function_t> SPUDatabase::find(const be_t<u32>* data, u64 key, u32 max_size)
@@ -25,16 +29,536 @@ std::shared_ptr<spu_function_t> SPUDatabase::find(const be_t<u32>* data, u64 key
 	return nullptr;
 }
 
+// Approximate host memory used by the function (tree nodes are counted as 32 bytes)
+static s64 get_memory_size(const spu_function_t& func)
+{
+	const std::size_t nodes = func.blocks.size() + func.adjacent.size() + func.jtable.size() + func.branch_targets.size() + func.poll_loops.size();
+
+	return sizeof(spu_function_t) + func.data.capacity() * sizeof(u32) + func.dead.capacity() / 8 + nodes * 32;
+}
+
 SPUDatabase::SPUDatabase()
 {
-	// TODO: load existing database associated with currently running executable
+	if (rpcs3::state.config.core.spu_cache.value())
+	{
+		const std::string& dir = fs::get_config_dir() + "data/cache/";
+
+		if (!fs::is_dir(dir) && !fs::create_path(dir))
+		{
+			LOG_ERROR(SPU, "SPU Database: failed to create '%s'", dir);
+		}
+		else
+		{
+			m_path = dir + "spu_db.bin";
+		}
+	}
+
+	load();
 
 	LOG_SUCCESS(SPU, "SPU Database initialized...");
 }
 
 SPUDatabase::~SPUDatabase()
 {
-	// TODO: serialize database
+	try
+	{
+		save();
+	}
+	catch (...)
+	{
+		LOG_ERROR(SPU, "SPU Database: failed to save '%s'", m_path);
+	}
+
+	for (const auto& item : m_db)
+	{
+		perf::mem_add(perf::mem_spu_database, -get_memory_size(*item.second));
+	}
+}
+
+// Serialized database header
+struct spu_db_header_t
+{
+	char magic[4]; // "SPUD"
+	u32 version;
+	u32 count; // number of functions
+};
+
+// Serialized function header (followed by data, blocks, adjacent and jtable arrays)
+struct spu_db_func_t
+{
+	u32 addr;
+	u32 size;
+	u32 blocks;
+	u32 adjacent;
+	u32 jtable;
+	u32 does_reset_stack;
+	u8 hash[20];
+};
+
+void SPUDatabase::load()
+{
+	if (m_path.empty() || !fs::is_file(m_path))
+	{
+		return;
+	}
+
+	const fs::file f(m_path);
+
+	spu_db_header_t header;
+
+	if (!f || !f.read(header) || std::memcmp(header.magic, "SPUD", 4) || header.version != version)
+	{
+		LOG_WARNING(SPU, "SPU Database: '%s' is outdated or invalid, discarded", m_path);
+		return;
+	}
+
+	u32 loaded = 0;
+
+	for (u32 i = 0; i < header.count; i++)
+	{
+		spu_db_func_t info;
+
+		if (!f.read(info) || info.addr >= 0x40000 || info.addr % 4 || !info.size || info.size > 0x40000 - info.addr || info.size % 4)
+		{
+			LOG_ERROR(SPU, "SPU Database: '%s' is truncated (%u/%u functions loaded)", m_path, loaded, header.count);
+			break;
+		}
+
+		auto func = std::make_shared<spu_function_t>(info.addr, info.size);
+
+		func->data.resize(info.size / 4);
+
+		std::vector<u32> blocks(info.blocks), adjacent(info.adjacent), jtable(info.jtable);
+
+		if (!f.read(func->data) || !f.read(blocks) || !f.read(adjacent) || !f.read(jtable))
+		{
+			LOG_ERROR(SPU, "SPU Database: '%s' is truncated (%u/%u functions loaded)", m_path, loaded, header.count);
+			break;
+		}
+
+		sha1(reinterpret_cast<const u8*>(func->data.data()), info.size, func->hash.data());
+
+		if (std::memcmp(func->hash.data(), info.hash, 20))
+		{
+			LOG_ERROR(SPU, "SPU Database: hash mismatch for function [0x%05x] (skipped)", info.addr);
+			continue;
+		}
+
+		const u64 key = info.addr | u64{ func->data[0] } << 32;
+		bool is_known = false;
+
+		// Skip functions already registered (when merging entries written by other instances)
+		for (auto found = m_db.find(key); found != m_db.end() && found->first == key; found++)
+		{
+			is_known |= found->second->data == func->data;
+		}
+
+		if (is_known)
+		{
+			continue;
+		}
+
+		func->blocks.insert(blocks.begin(), blocks.end());
+		func->adjacent.insert(adjacent.begin(), adjacent.end());
+		func->jtable.insert(jtable.begin(), jtable.end());
+		func->does_reset_stack = info.does_reset_stack != 0;
+
+		analyse_registers(*func);
+
+		perf::mem_add(perf::mem_spu_database, get_memory_size(*func));
+		m_db.emplace(key, std::move(func));
+		loaded++;
+	}
+
+	LOG_NOTICE(SPU, "SPU Database: %u functions loaded from '%s'", loaded, m_path);
+}
+
+void SPUDatabase::save()
+{
+	if (m_path.empty())
+	{
+		return;
+	}
+
+	// Merge functions saved by other instances sharing the file since it was loaded
+	load();
+
+	std::vector<u8> data;
+
+	const auto write = [&](const void* ptr, std::size_t size)
+	{
+		data.insert(data.end(), static_cast<const u8*>(ptr), static_cast<const u8*>(ptr) + size);
+	};
+
+	const auto write_set = [&](const std::set<u32>& set)
+	{
+		const std::vector<u32> values{ set.begin(), set.end() };
+		write(values.data(), values.size() * sizeof(u32));
+	};
+
+	const spu_db_header_t header{ { 'S', 'P', 'U', 'D' }, version, size32(m_db) };
+	write(&header, sizeof(header));
+
+	for (const auto& item : m_db)
+	{
+		const spu_function_t& func = *item.second;
+
+		spu_db_func_t info{ func.addr, func.size, size32(func.blocks), size32(func.adjacent), size32(func.jtable), func.does_reset_stack };
+		std::memcpy(info.hash, func.hash.data(), 20);
+
+		write(&info, sizeof(info));
+		write(func.data.data(), func.data.size() * sizeof(u32));
+		write_set(func.blocks);
+		write_set(func.adjacent);
+		write_set(func.jtable);
+	}
+
+	// Replaced atomically, instances loading it concurrently never see a partially written file
+	if (!fs::write_file_atomic(m_path, data.data(), data.size()))
+	{
+		LOG_ERROR(SPU, "SPU Database: failed to write '%s'", m_path);
+	}
+}
+
+// Register usage of the instruction
+struct spu_reg_usage_t
+{
+	std::bitset<128> uses;
+	std::bitset<128> defs;
+	bool barrier; // may read any register (call, exit, interpreter fallback, exception)
+	bool pure; // only writes defs (can be skipped if the result is dead)
+};
+
+static spu_reg_usage_t get_reg_usage(spu_opcode_t op, spu_itype_t type)
+{
+	using namespace spu_itype;
+
+	spu_reg_usage_t r{};
+
+	switch (type)
+	{
+	// Instructions without register operands
+	case LNOP: case NOP: case SYNC: case DSYNC: case HBR: case HBRA: case HBRR:
+	case BR: case BRA:
+	{
+		break;
+	}
+
+	// Immediate loads
+	case IL: case ILH: case ILHU: case ILA: case FSMBI: case FSCRRD: case LQA: case LQR:
+	{
+		r.defs.set(op.rt);
+		r.pure = true;
+		break;
+	}
+
+	// Immediate loads reading the destination
+	case IOHL:
+	{
+		r.uses.set(op.rt);
+		r.defs.set(op.rt);
+		r.pure = true;
+		break;
+	}
+
+	// Unary and register-immediate operations
+	case ROTI: case ROTMI: case ROTMAI: case SHLI: case ROTHI: case ROTHMI: case ROTMAHI: case SHLHI:
+	case GB: case GBH: case GBB: case FSM: case FSMH: case FSMB: case FREST: case FRSQEST:
+	case ORX: case CBD: case CHD: case CWD: case CDD:
+	case ROTQBII: case ROTQMBII: case SHLQBII: case ROTQBYI: case ROTQMBYI: case SHLQBYI:
+	case CLZ: case XSWD: case XSHW: case CNTB: case XSBH: case FESD: case FRDS:
+	case CFLTS: case CFLTU: case CSFLT: case CUFLT:
+	case ORI: case ORHI: case ORBI: case SFI: case SFHI: case ANDI: case ANDHI: case ANDBI: case AI: case AHI:
+	case XORI: case XORHI: case XORBI: case CGTI: case CGTHI: case CGTBI: case CLGTI: case CLGTHI: case CLGTBI:
+	case MPYI: case MPYUI: case CEQI: case CEQHI: case CEQBI: case LQD:
+	{
+		r.uses.set(op.ra);
+		r.defs.set(op.rt);
+		r.pure = true;
+		break;
+	}
+
+	// Binary operations
+	case SF: case OR: case BG: case SFH: case NOR: case ABSDB: case ROT: case ROTM: case ROTMA: case SHL:
+	case ROTH: case ROTHM: case ROTMAH: case SHLH: case A: case AND: case CG: case AH: case NAND: case AVGB:
+	case LQX: case ROTQBYBI: case ROTQMBYBI: case SHLQBYBI: case CBX: case CHX: case CWX: case CDX:
+	case ROTQBI: case ROTQMBI: case SHLQBI: case ROTQBY: case ROTQMBY: case SHLQBY:
+	case CGT: case XOR: case CGTH: case EQV: case CGTB: case SUMB: case CLGT: case ANDC:
+	case FCGT: case FA: case FS: case FM: case CLGTH: case ORC: case FCMGT: case DFA: case DFS: case DFM:
+	case CLGTB: case CEQ: case MPYHHU: case FCEQ: case MPY: case MPYH: case MPYHH: case MPYS: case CEQH:
+	case FCMEQ: case MPYU: case CEQB: case FI:
+	{
+		r.uses.set(op.ra);
+		r.uses.set(op.rb);
+		r.defs.set(op.rt);
+		r.pure = true;
+		break;
+	}
+
+	// Binary operations accumulating to the destination
+	case DFMA: case DFMS: case DFNMS: case DFNMA: case ADDX: case SFX: case CGX: case BGX: case MPYHHA: case MPYHHAU:
+	{
+		r.uses.set(op.ra);
+		r.uses.set(op.rb);
+		r.uses.set(op.rt);
+		r.defs.set(op.rt);
+		r.pure = true;
+		break;
+	}
+
+	// Ternary operations
+	case SELB: case SHUFB: case MPYA: case FNMS: case FMA: case FMS:
+	{
+		r.uses.set(op.ra);
+		r.uses.set(op.rb);
+		r.uses.set(op.rc);
+		r.defs.set(op.rt4);
+		r.pure = true;
+		break;
+	}
+
+	// Stores
+	case STQA: case STQR:
+	{
+		r.uses.set(op.rt);
+		break;
+	}
+
+	case STQD:
+	{
+		r.uses.set(op.rt);
+		r.uses.set(op.ra);
+		break;
+	}
+
+	case STQX:
+	{
+		r.uses.set(op.rt);
+		r.uses.set(op.ra);
+		r.uses.set(op.rb);
+		break;
+	}
+
+	case FSCRWR:
+	{
+		r.uses.set(op.ra);
+		break;
+	}
+
+	// Conditional branches (relative)
+	case BRZ: case BRNZ: case BRHZ: case BRHNZ:
+	{
+		r.uses.set(op.rt);
+		break;
+	}
+
+	// Other instructions: calls, indirect branches, halts, channels, interpreter fallbacks and unimplemented instructions
+	default:
+	{
+		r.barrier = true;
+		break;
+	}
+	}
+
+	return r;
+}
+
+void SPUDatabase::analyse_registers(spu_function_t& func)
+{
+	using namespace spu_itype;
+
+	const u32 count = func.size / 4;
+
+	std::vector<spu_reg_usage_t> usage(count);
+
+	for (u32 i = 0; i < count; i++)
+	{
+		const spu_opcode_t op{ func.data[i] };
+
+		usage[i] = get_reg_usage(op, g_spu_itype[op.opcode]);
+	}
+
+	// Backward liveness analysis (registers are live at every exit from the function)
+	std::vector<std::bitset<128>> live_in(count);
+
+	for (bool changed = true; changed;)
+	{
+		changed = false;
+
+		for (u32 i = count; i--;)
+		{
+			const spu_opcode_t op{ func.data[i] };
+			const spu_itype_t type = g_spu_itype[op.opcode];
+			const u32 pos = func.addr + i * 4;
+
+			std::bitset<128> live_out;
+
+			const auto add_successor = [&](u32 target)
+			{
+				if (target >= func.addr && target < func.addr + func.size)
+				{
+					live_out |= live_in[(target - func.addr) / 4];
+				}
+				else
+				{
+					live_out.set();
+				}
+			};
+
+			std::bitset<128> result;
+
+			if (usage[i].barrier)
+			{
+				result.set();
+			}
+			else
+			{
+				if (type == BR || type == BRA || type == BRZ || type == BRNZ || type == BRHZ || type == BRHNZ)
+				{
+					add_successor(spu_branch_target(type == BRA ? 0 : pos, op.i16));
+				}
+
+				if (type != BR && type != BRA)
+				{
+					add_successor(pos + 4);
+				}
+
+				result = usage[i].uses | (live_out & ~usage[i].defs);
+			}
+
+			if (result != live_in[i])
+			{
+				live_in[i] = result;
+				changed = true;
+			}
+		}
+	}
+
+	func.dead.assign(count, false);
+
+	u32 dead_count = 0;
+
+	for (u32 i = 0; i + 1 < count; i++)
+	{
+		// Pure instructions fall through, so the live-out set is the live-in set of the next instruction
+		if (usage[i].pure && (usage[i].defs & live_in[i + 1]).none())
+		{
+			func.dead[i] = true;
+			dead_count++;
+		}
+	}
+
+	// Forward constant propagation inside of the blocks (only splatted words are tracked)
+	std::bitset<128> known;
+	std::array<u32, 128> value;
+
+	for (u32 i = 0; i < count; i++)
+	{
+		const spu_opcode_t op{ func.data[i] };
+		const spu_itype_t type = g_spu_itype[op.opcode];
+		const u32 pos = func.addr + i * 4;
+
+		if (func.blocks.count(pos))
+		{
+			known.reset();
+		}
+
+		switch (type)
+		{
+		case IL: value[op.rt] = op.si16; known.set(op.rt); break;
+		case ILHU: value[op.rt] = op.i16 << 16; known.set(op.rt); break;
+		case ILA: value[op.rt] = op.i18; known.set(op.rt); break;
+		case IOHL: value[op.rt] |= op.i16; break;
+		case ORI: value[op.rt] = value[op.ra] | op.si10; known[op.rt] = known[op.ra]; break;
+		case ANDI: value[op.rt] = value[op.ra] & op.si10; known[op.rt] = known[op.ra]; break;
+		case AI: value[op.rt] = value[op.ra] + op.si10; known[op.rt] = known[op.ra]; break;
+		case OR: value[op.rt] = value[op.ra] | value[op.rb]; known[op.rt] = known[op.ra] && known[op.rb]; break;
+
+		case BI:
+		case BISL:
+		{
+			if (known[op.ra])
+			{
+				func.branch_targets.emplace(pos, value[op.ra] & 0x3fffc);
+			}
+
+			// BISL calls a function which may change any register
+			known.reset();
+			break;
+		}
+
+		default:
+		{
+			if (usage[i].barrier)
+			{
+				known.reset();
+			}
+			else
+			{
+				known &= ~usage[i].defs;
+			}
+
+			break;
+		}
+		}
+	}
+
+	// Channel polling loops: a short backward conditional branch over a single RCHCNT and pure instructions,
+	// without values carried to the next iteration (the channel count is the only input)
+	for (u32 i = 0; i < count; i++)
+	{
+		const spu_opcode_t op{ func.data[i] };
+		const spu_itype_t type = g_spu_itype[op.opcode];
+		const u32 pos = func.addr + i * 4;
+
+		if (type != BRZ && type != BRNZ && type != BRHZ && type != BRHNZ)
+		{
+			continue;
+		}
+
+		const u32 target = spu_branch_target(pos, op.i16);
+
+		if (target >= pos || target < func.addr || pos - target > 16 * 4)
+		{
+			continue;
+		}
+
+		std::bitset<128> defined, carried;
+		u32 rchcnt = 0, rchcnt_count = 0;
+		bool pure = true;
+
+		for (u32 j = (target - func.addr) / 4; j < i; j++)
+		{
+			const spu_opcode_t op2{ func.data[j] };
+
+			if (g_spu_itype[op2.opcode] == RCHCNT)
+			{
+				rchcnt = func.addr + j * 4;
+				rchcnt_count++;
+				defined.set(op2.rt);
+				continue;
+			}
+
+			if (!usage[j].pure)
+			{
+				pure = false;
+				break;
+			}
+
+			carried |= usage[j].uses & ~defined;
+			defined |= usage[j].defs;
+		}
+
+		if (pure && rchcnt_count == 1 && defined.test(op.rt) && (carried & defined).none())
+		{
+			func.poll_loops.emplace(rchcnt);
+		}
+	}
+
+	if (dead_count || func.branch_targets.size() || func.poll_loops.size())
+	{
+		LOG_NOTICE(SPU, "Function [0x%05x]: %u dead instructions, %u constant indirect branches, %u polling loops", func.addr, dead_count, size32(func.branch_targets), size32(func.poll_loops));
+	}
 }
 
 std::shared_ptr<spu_function_t> SPUDatabase::analyse(const be_t<u32>* ls, u32 entry, u32 max_limit)
@@ -334,7 +858,14 @@ std::shared_ptr<spu_function_t> SPUDatabase::analyse(const be_t<u32>* ls, u32 en
 	// Set whether the function can reset stack
 	func->does_reset_stack = ila_sp_pos < limit;
 
+	// Calculate the hash of the function contents
+	sha1(reinterpret_cast<const u8*>(func->data.data()), func->size, func->hash.data());
+
+	// Find dead instructions and constant branch targets
+	analyse_registers(*func);
+
 	// Add function to the database
+	perf::mem_add(perf::mem_spu_database, get_memory_size(*func));
 	m_db.emplace(key, func);
 
 	LOG_SUCCESS(SPU, "Function detected [0x%05x-0x%05x] (size=0x%x)", func->addr, func->addr + func->size, func->size);
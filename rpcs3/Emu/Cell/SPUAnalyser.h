@@ -246,8 +246,23 @@ struct spu_function_t
 	// whether ila $SP,* instruction found
 	bool does_reset_stack;
 
-	// pointer to the compiled function
-	spu_jit_func_t compiled = nullptr;
+	// instructions which only write a register overwritten before being read (indexed by (pos - addr) / 4, can be skipped)
+	std::vector<bool> dead;
+
+	// indirect branches (BI, BISL) with the target known from constant loads (instruction address -> target)
+	std::map<u32, u32> branch_targets;
+
+	// RCHCNT instructions of channel polling loops (short loops computing only the branch condition from the channel count)
+	std::set<u32> poll_loops;
+
+	// pointer to the compiled function (published atomically by the compiler)
+	std::atomic<spu_jit_func_t> compiled{ nullptr };
+
+	// whether the function was queued for background compilation
+	std::atomic_flag queued = ATOMIC_FLAG_INIT;
+
+	// SHA-1 hash of the function contents (used as a persistent cache key)
+	std::array<u8, 20> hash;
 
 	spu_function_t(u32 addr, u32 size)
 		: addr(addr)
@@ -259,14 +274,29 @@ struct spu_function_t
 // SPU Function Database (must be global or PS3 process-local)
 class SPUDatabase final
 {
+	// Serialized database version (increment it whenever the analyser output changes)
+	static constexpr u32 version = 1;
+
 	shared_mutex m_mutex;
 
 	// All registered functions (uses addr and first instruction as a key)
 	std::unordered_multimap<u64, std::shared_ptr<spu_function_t>> m_db;
 
+	// Path to the persistent database file (empty if disabled)
+	std::string m_path;
+
 	// For internal use
 	std::shared_ptr<spu_function_t> find(const be_t<u32>* data, u64 key, u32 max_size);
 
+	// Load functions from the persistent database file
+	void load();
+
+	// Merge the persistent database file and write all registered functions to it
+	void save();
+
+	// Compute register liveness, constant branch targets and polling loops (fills dead, branch_targets and poll_loops)
+	static void analyse_registers(spu_function_t& func);
+
 public:
 	SPUDatabase();
 	~SPUDatabase();
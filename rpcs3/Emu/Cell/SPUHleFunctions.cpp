@@ -0,0 +1,124 @@
+#include "stdafx.h"
+#include "Emu/state.h"
+#include "Emu/IdManager.h"
+#include "Emu/Memory/Memory.h"
+
+#include "SPUThread.h"
+#include "SPUAnalyser.h"
+#include "SPUHleFunctions.h"
+
+// Number of calls of registered routines, reported on emulation stop
+struct spu_hle_stats_t
+{
+	std::mutex mutex;
+
+	// LS address -> calls (nodes are never removed)
+	std::map<u32, std::atomic<u64>> calls;
+
+	~spu_hle_stats_t()
+	{
+		for (auto& entry : calls)
+		{
+			LOG_NOTICE(SPU, "SPU HLE: channel routine at 0x%05x called %llu times", entry.first, entry.second.load());
+		}
+	}
+};
+
+// Match a leaf routine which only reads and writes channels and returns (wrch/rdch sequence followed by bi $lr),
+// such as MFC command issue (mfc_get, mfc_put) and tag status wait (mfc_read_tag_status_all) routines.
+// Returns the channel instructions (empty if the code doesn't match).
+static std::vector<spu_opcode_t> spu_hle_match_channel_routine(const be_t<u32>* ls, u32 pos)
+{
+	std::vector<spu_opcode_t> ops;
+
+	for (; pos < 0x40000; pos += 4)
+	{
+		const spu_opcode_t op{ ls[pos / 4] };
+
+		switch (g_spu_itype[op.opcode])
+		{
+		case spu_itype::WRCH:
+		case spu_itype::RDCH:
+		{
+			ops.emplace_back(op);
+			continue;
+		}
+
+		case spu_itype::BI:
+		{
+			// return without changing interrupt status
+			if (op.ra == 0 && !op.d && !op.e && ops.size() >= 2)
+			{
+				return ops;
+			}
+
+			return{};
+		}
+		}
+
+		return{};
+	}
+
+	return{};
+}
+
+void spu_hle_register_functions(SPUThread& spu)
+{
+	if (!rpcs3::state.config.core.spu_hle_functions.value())
+	{
+		return;
+	}
+
+	const auto stats = fxm::get_always<spu_hle_stats_t>();
+
+	const auto ls = vm::ps3::_ptr<u32>(spu.offset);
+
+	for (u32 pos = 0; pos < 0x40000; pos += 4)
+	{
+		// only the start of the sequence, the routine may also be the tail of a longer function
+		if (pos)
+		{
+			const auto prev = g_spu_itype[ls[pos / 4 - 1]];
+
+			if (prev == spu_itype::WRCH || prev == spu_itype::RDCH)
+			{
+				continue;
+			}
+		}
+
+		auto ops = spu_hle_match_channel_routine(ls, pos);
+
+		if (ops.empty())
+		{
+			continue;
+		}
+
+		std::atomic<u64>* calls;
+		{
+			std::lock_guard<std::mutex> lock(stats->mutex);
+
+			calls = &stats->calls[pos];
+		}
+
+		spu.RegisterHleFunction(pos, [ops = std::move(ops), calls, stats](SPUThread& spu) -> bool
+		{
+			(*calls)++;
+
+			for (const auto op : ops)
+			{
+				if (g_spu_itype[op.opcode] == spu_itype::WRCH)
+				{
+					spu.set_ch_value(op.ra, spu.gpr[op.rt]._u32[3]);
+				}
+				else
+				{
+					spu.gpr[op.rt] = v128::from32r(spu.get_ch_value(op.ra));
+				}
+			}
+
+			return true;
+		});
+
+		LOG_TRACE(SPU, "SPU HLE: channel routine registered at 0x%05x (%s)", pos, spu.get_name());
+	}
+}
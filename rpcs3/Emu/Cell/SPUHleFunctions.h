@@ -0,0 +1,7 @@
+#pragma once
+
+class SPUThread;
+
+// Find SPU routines with a known native implementation in the thread's LS and register them as HLE functions
+// (enabled by the "SPU HLE Functions" option, must be called after the image is copied to LS)
+void spu_hle_register_functions(SPUThread& spu);
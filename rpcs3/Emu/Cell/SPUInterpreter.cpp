@@ -80,6 +80,11 @@ void spu_interpreter::RCHCNT(SPUThread& spu, spu_opcode_t op)
 	spu.gpr[op.rt] = v128::from32r(spu.get_ch_count(op.ra));
 }
 
+void spu_interpreter::RCHCNT_POLL(SPUThread& spu, spu_opcode_t op)
+{
+	spu.gpr[op.rt] = v128::from32r(spu.get_ch_count_polling(op.ra));
+}
+
 void spu_interpreter::SF(SPUThread& spu, spu_opcode_t op)
 {
 	spu.gpr[op.rt] = v128::sub32(spu.gpr[op.rb], spu.gpr[op.ra]);
@@ -335,7 +340,10 @@ void spu_interpreter::STOPD(SPUThread& spu, spu_opcode_t op)
 
 void spu_interpreter::STQX(SPUThread& spu, spu_opcode_t op)
 {
-	spu._ref<v128>((spu.gpr[op.ra]._u32[3] + spu.gpr[op.rb]._u32[3]) & 0x3fff0) = spu.gpr[op.rt];
+	const u32 lsa = (spu.gpr[op.ra]._u32[3] + spu.gpr[op.rb]._u32[3]) & 0x3fff0;
+
+	spu._ref<v128>(lsa) = spu.gpr[op.rt];
+	spu.code_store(lsa);
 }
 
 void spu_interpreter::BI(SPUThread& spu, spu_opcode_t op)
@@ -393,7 +401,7 @@ void spu_interpreter::FSMH(SPUThread& spu, spu_opcode_t op)
 
 void spu_interpreter::FSMB(SPUThread& spu, spu_opcode_t op)
 {
-	spu.gpr[op.rt] = g_spu_imm.fsmb[spu.gpr[op.ra]._u32[3] & 0xffff];
+	spu.gpr[op.rt].vi = spu_fsmb(spu.gpr[op.ra]._u32[3]);
 }
 
 void spu_interpreter::fast::FREST(SPUThread& spu, spu_opcode_t op)
@@ -977,6 +985,7 @@ void spu_interpreter::BRZ(SPUThread& spu, spu_opcode_t op)
 void spu_interpreter::STQA(SPUThread& spu, spu_opcode_t op)
 {
 	spu._ref<v128>(spu_ls_target(0, op.i16)) = spu.gpr[op.rt];
+	spu.code_store(spu_ls_target(0, op.i16));
 }
 
 void spu_interpreter::BRNZ(SPUThread& spu, spu_opcode_t op)
@@ -1006,6 +1015,7 @@ void spu_interpreter::BRHNZ(SPUThread& spu, spu_opcode_t op)
 void spu_interpreter::STQR(SPUThread& spu, spu_opcode_t op)
 {
 	spu._ref<v128>(spu_ls_target(spu.pc, op.i16)) = spu.gpr[op.rt];
+	spu.code_store(spu_ls_target(spu.pc, op.i16));
 }
 
 void spu_interpreter::BRA(SPUThread& spu, spu_opcode_t op)
@@ -1032,7 +1042,7 @@ void spu_interpreter::BR(SPUThread& spu, spu_opcode_t op)
 
 void spu_interpreter::FSMBI(SPUThread& spu, spu_opcode_t op)
 {
-	spu.gpr[op.rt] = g_spu_imm.fsmb[op.i16];
+	spu.gpr[op.rt].vi = spu_fsmb(op.i16);
 }
 
 void spu_interpreter::BRSL(SPUThread& spu, spu_opcode_t op)
@@ -1120,7 +1130,10 @@ void spu_interpreter::AHI(SPUThread& spu, spu_opcode_t op)
 
 void spu_interpreter::STQD(SPUThread& spu, spu_opcode_t op)
 {
-	spu._ref<v128>((spu.gpr[op.ra]._s32[3] + (op.si10 << 4)) & 0x3fff0) = spu.gpr[op.rt];
+	const u32 lsa = (spu.gpr[op.ra]._s32[3] + (op.si10 << 4)) & 0x3fff0;
+
+	spu._ref<v128>(lsa) = spu.gpr[op.rt];
+	spu.code_store(lsa);
 }
 
 void spu_interpreter::LQD(SPUThread& spu, spu_opcode_t op)
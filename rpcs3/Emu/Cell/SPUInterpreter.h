@@ -28,6 +28,7 @@ namespace spu_interpreter
 	void MFSPR(SPUThread& spu, spu_opcode_t op);
 	void RDCH(SPUThread& spu, spu_opcode_t op);
 	void RCHCNT(SPUThread& spu, spu_opcode_t op);
+	void RCHCNT_POLL(SPUThread& spu, spu_opcode_t op); // RCHCNT of a channel polling loop found by the analyser (not decoded)
 	void SF(SPUThread& spu, spu_opcode_t op);
 	void OR(SPUThread& spu, spu_opcode_t op);
 	void BG(SPUThread& spu, spu_opcode_t op);
@@ -1,80 +1,258 @@
 #include "stdafx.h"
+#include "Utilities/Thread.h"
+#include "Emu/state.h"
 #include "Emu/IdManager.h"
+#include "Emu/PerfCounters.h"
 #include "Emu/Memory/Memory.h"
 
 #include "SPUThread.h"
+#include "SPUInterpreter.h"
 #include "SPURecompiler.h"
 #include "SPUASMJITRecompiler.h"
 
 extern u64 get_system_time();
 
-SPURecompilerDecoder::SPURecompilerDecoder(SPUThread& spu)
-	: db(fxm::get_always<SPUDatabase>())
-	, rec(fxm::get_always<spu_recompiler>())
-	, spu(spu)
+SPURecompilerPool::SPURecompilerPool()
 {
-}
+	const u32 count = rpcs3::state.config.core.spu_compiler_threads.value();
 
-u32 SPURecompilerDecoder::DecodeMemory(const u32 address)
-{
-	if (spu.offset != address - spu.pc || spu.pc >= 0x40000 || spu.pc % 4)
+	for (u32 i = 0; i < count; i++)
 	{
-		throw EXCEPTION("Invalid address or PC (address=0x%x, PC=0x%05x)", address, spu.pc);
-	}
+		const auto rec = std::make_shared<spu_recompiler>();
 
-	// get SPU LS pointer
-	const auto _ls = vm::ps3::_ptr<u32>(spu.offset);
+		m_recs.emplace_back(rec);
+
+		m_workers.emplace_back(thread_ctrl::spawn(COPY_EXPR(fmt::format("SPU Compiler[%u]", i)), [this, rec]()
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
 
-	// always validate (TODO)
-	const auto func = db->analyse(_ls, spu.pc);
+			while (true)
+			{
+				if (m_exit)
+				{
+					return;
+				}
 
-	// reset callstack if necessary
-	if (func->does_reset_stack && spu.recursion_level)
-	{
-		spu.m_state |= CPU_STATE_RETURN;
+				if (m_queue.empty())
+				{
+					m_cv.wait(lock);
+					continue;
+				}
+
+				const auto func = std::move(m_queue.front());
+				m_queue.pop_front();
+
+				lock.unlock();
 
-		return 0;
+				try
+				{
+					rec->compile(*func);
+				}
+				catch (const std::exception& e)
+				{
+					LOG_ERROR(SPU, "Compilation failed [0x%05x]: %s", func->addr, e.what());
+				}
+
+				lock.lock();
+			}
+		}));
 	}
 
-	if (!func->compiled)
+	if (count)
 	{
-		rec->compile(*func);
+		LOG_NOTICE(SPU, "SPU Recompiler: %u background compilation threads started", count);
+	}
+}
 
-		if (!func->compiled) throw EXCEPTION("Compilation failed");
+SPURecompilerPool::~SPURecompilerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		m_exit = true;
+		m_queue.clear();
 	}
 
-	const u32 res = func->compiled(&spu, _ls);
+	m_cv.notify_all();
 
-	if (const auto exception = spu.pending_exception)
+	for (auto& worker : m_workers)
 	{
-		spu.pending_exception = nullptr;
-		std::rethrow_exception(exception);
+		worker->join();
 	}
+}
 
-	if (res & 0x1000000)
+void SPURecompilerPool::enqueue(const std::shared_ptr<spu_function_t>& func)
+{
+	if (func->queued.test_and_set())
 	{
-		spu.halt();
+		return;
 	}
 
-	if (res & 0x2000000)
 	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		m_queue.emplace_back(func);
 	}
 
-	if (res & 0x4000000)
+	m_cv.notify_one();
+}
+
+SPURecompilerDecoder::SPURecompilerDecoder(SPUThread& spu)
+	: db(fxm::get_always<SPUDatabase>())
+	, rec(fxm::get_always<spu_recompiler>())
+	, pool(fxm::get_always<SPURecompilerPool>())
+	, spu(spu)
+{
+}
+
+std::shared_ptr<spu_function_t> SPURecompilerDecoder::get_function(const be_t<u32>* ls)
+{
+	auto& entry = m_cache[spu.pc / 4 % m_cache.size()];
+
+	const u64 stamp = spu.code_stamp;
+
+	if (entry.func && entry.pc == spu.pc)
 	{
-		if (res & 0x8000000)
+		if (entry.stamp == stamp)
 		{
-			throw EXCEPTION("Undefined behaviour");
+			spu_stats_t::add(spu.stats.cache_hits);
+			return entry.func;
 		}
 
-		spu.set_interrupt_status(true);
+		// some watched page was written, check only the pages of this function
+		bool modified = false;
+
+		for (u32 page = entry.func->addr / 1024; page <= (entry.func->addr + entry.func->size - 1) / 1024; page++)
+		{
+			modified |= spu.code_page_stamp[page] > entry.stamp;
+		}
+
+		if (!modified)
+		{
+			spu_stats_t::add(spu.stats.cache_hits);
+			entry.stamp = stamp;
+			return entry.func;
+		}
 	}
-	else if (res & 0x8000000)
+
+	spu_stats_t::add(spu.stats.cache_misses);
+
+	auto func = db->analyse(ls, spu.pc);
+
+	// watch LS pages of the function, writes to them invalidate the entry
+	for (u32 page = func->addr / 1024; page <= (func->addr + func->size - 1) / 1024; page++)
 	{
-		spu.set_interrupt_status(false);
+		spu.code_page_watch[page] = 1;
 	}
 
-	spu.pc = res & 0x3fffc;
+	entry = { spu.pc, stamp, func };
+
+	return func;
+}
 
-	return 0;
+u32 SPURecompilerDecoder::DecodeMemory(const u32 address)
+{
+	if (spu.offset != address - spu.pc || spu.pc >= 0x40000 || spu.pc % 4)
+	{
+		throw EXCEPTION("Invalid address or PC (address=0x%x, PC=0x%05x)", address, spu.pc);
+	}
+
+	// get SPU LS pointer
+	const auto _ls = vm::ps3::_ptr<u32>(spu.offset);
+
+	// chain compiled functions until the control flow requires the thread loop (status check, interrupts, errors)
+	while (true)
+	{
+		// validated by the target cache (entries are invalidated by writes to their LS pages)
+		const auto func = get_function(_ls);
+
+		// reset callstack if necessary
+		if (func->does_reset_stack && spu.recursion_level)
+		{
+			spu.m_state |= CPU_STATE_RETURN;
+
+			return 0;
+		}
+
+		auto compiled = func->compiled.load();
+
+		if (!compiled && !pool->size())
+		{
+			const u64 start = get_system_time();
+
+			rec->compile(*func);
+
+			spu_stats_t::add(spu.stats.compiles);
+			spu_stats_t::add(spu.stats.compile_time, get_system_time() - start);
+
+			if (!(compiled = func->compiled.load())) throw EXCEPTION("Compilation failed");
+		}
+
+		if (!compiled)
+		{
+			perf::add(perf::jit_misses);
+			spu_stats_t::add(spu.stats.jit_misses);
+
+			pool->enqueue(func);
+
+			// Run the interpreter until the control flow changes (the function is being compiled in background)
+			while (true)
+			{
+				const u32 old_pc = spu.pc;
+				const u32 opcode = _ls[old_pc / 4];
+
+				spu_interpreter::fast::g_spu_opcode_table[opcode](spu, { opcode });
+
+				spu.pc += 4;
+
+				if (spu.pc != old_pc + 4 || spu.pc >= 0x40000 || spu.m_state)
+				{
+					return 0;
+				}
+			}
+		}
+
+		perf::add(perf::jit_hits);
+		perf::add(perf::spu_blocks);
+		spu_stats_t::add(spu.stats.blocks);
+
+		const u32 res = compiled(&spu, _ls);
+
+		if (const auto exception = spu.pending_exception)
+		{
+			spu.pending_exception = nullptr;
+			std::rethrow_exception(exception);
+		}
+
+		if (res & 0x1000000)
+		{
+			spu.halt();
+		}
+
+		if (res & 0x2000000)
+		{
+		}
+
+		if (res & 0x4000000)
+		{
+			if (res & 0x8000000)
+			{
+				throw EXCEPTION("Undefined behaviour");
+			}
+
+			spu.set_interrupt_status(true);
+		}
+		else if (res & 0x8000000)
+		{
+			spu.set_interrupt_status(false);
+		}
+
+		spu.pc = res & 0x3fffc;
+
+		// plain branch: continue with the next function directly (unless returning to the caller)
+		if (res & ~0x3fffc || spu.m_state || spu.pc == return_link)
+		{
+			return 0;
+		}
+	}
 }
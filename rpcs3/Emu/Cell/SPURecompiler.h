@@ -20,16 +20,65 @@ public:
 	virtual ~SPURecompilerBase() {};
 };
 
+class thread_ctrl;
+
+// SPU background compilation workers (must be global or PS3 process-local)
+class SPURecompilerPool final
+{
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+
+	// Functions waiting for compilation
+	std::deque<std::shared_ptr<spu_function_t>> m_queue;
+
+	// Recompiler instances (one per worker, they own the generated code)
+	std::vector<std::shared_ptr<SPURecompilerBase>> m_recs;
+
+	std::vector<std::shared_ptr<thread_ctrl>> m_workers;
+
+	bool m_exit = false;
+
+public:
+	SPURecompilerPool();
+	~SPURecompilerPool();
+
+	// Get the number of worker threads (0 if compilation is synchronous)
+	std::size_t size() const
+	{
+		return m_workers.size();
+	}
+
+	// Queue the function for compilation (does nothing if already queued)
+	void enqueue(const std::shared_ptr<spu_function_t>& func);
+};
+
 // SPU Decoder instance (created per SPU thread)
 class SPURecompilerDecoder final : public CPUDecoder
 {
+	struct cache_entry_t
+	{
+		u32 pc;
+		u64 stamp; // SPUThread::code_stamp value when the entry was last validated
+		std::shared_ptr<spu_function_t> func;
+	};
+
+	// Functions at recently executed addresses (direct-mapped by PC)
+	std::array<cache_entry_t, 1024> m_cache{};
+
+	// Find the function at the current PC (in the target cache or in the database)
+	std::shared_ptr<spu_function_t> get_function(const be_t<u32>* ls);
+
 public:
 	const std::shared_ptr<SPUDatabase> db; // associated SPU Analyser instance
 
 	const std::shared_ptr<SPURecompilerBase> rec; // assiciated SPU Recompiler instance
 
+	const std::shared_ptr<SPURecompilerPool> pool; // associated background compilation workers
+
 	SPUThread& spu; // associated SPU Thread
 
+	u32 return_link = -1; // return address of the innermost function call in progress (chaining stops there)
+
 	SPURecompilerDecoder(SPUThread& spu);
 
 	u32 DecodeMemory(const u32 address) override; // non-virtual override (to avoid virtual call whenever possible)
@@ -4,6 +4,7 @@
 #include "Emu/state.h"
 
 #include "Emu/IdManager.h"
+#include "Emu/PerfCounters.h"
 #include "Emu/Cell/PPUThread.h"
 #include "Emu/SysCalls/ErrorCodes.h"
 #include "Emu/SysCalls/lv2/sys_spu.h"
@@ -25,6 +26,62 @@ const spu_opcode_table_t<void(SPUDisAsm::*)(spu_opcode_t)> SPUDisAsm::opcodes{ D
 
 thread_local bool spu_channel_t::notification_required;
 
+// Spin for a while before blocking on a channel ("SPU Channel Spin Count" option), returns true if the condition was met
+template<typename F>
+static bool spu_spin_wait(F pred)
+{
+	for (u32 i = rpcs3::state.config.core.spu_channel_spin.value(); i; i--)
+	{
+		_mm_pause();
+
+		if (pred())
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Accounts the channel operation's sleeps to the channel (nested operations restore the previous channel)
+class spu_stats_channel_t final
+{
+	spu_stats_t& m_stats;
+	const u32 m_prev;
+
+public:
+	spu_stats_channel_t(spu_stats_t& stats, u32 ch)
+		: m_stats(stats)
+		, m_prev(stats.channel)
+	{
+		stats.channel = ch < spu_stats_t::no_channel ? ch : spu_stats_t::no_channel;
+	}
+
+	~spu_stats_channel_t()
+	{
+		m_stats.channel = m_prev;
+	}
+};
+
+// Adds the sleep time to the current channel
+class spu_stats_wait_t final
+{
+	spu_stats_t& m_stats;
+	const u64 m_start = get_system_time();
+
+public:
+	spu_stats_wait_t(spu_stats_t& stats)
+		: m_stats(stats)
+	{
+	}
+
+	~spu_stats_wait_t()
+	{
+		spu_stats_t::add(m_stats.ch_waits[m_stats.channel]);
+		spu_stats_t::add(m_stats.ch_wait_time[m_stats.channel], get_system_time() - m_start);
+	}
+};
+
 void spu_int_ctrl_t::set(u64 ints)
 {
 	// leave only enabled interrupts
@@ -64,10 +121,45 @@ SPUThread::SPUThread(const std::string& name, u32 index)
 	, offset(vm::alloc(0x40000, vm::main))
 {
 	CHECK_ASSERTION(offset);
+
+	if (rpcs3::state.config.core.spu_async_dma.value())
+	{
+		dma_engine = fxm::get_always<spu_dma_engine_t>();
+	}
+
+	if (rpcs3::state.config.core.spu_running_threads.value())
+	{
+		scheduler = fxm::get_always<spu_scheduler_t>();
+	}
 }
 
 SPUThread::~SPUThread()
 {
+	// Wait for unfinished asynchronous transfers (LS must not be deallocated)
+	while (mfc_dma_pending)
+	{
+		std::this_thread::yield();
+	}
+
+	if (rpcs3::state.config.core.spu_channel_spin.value())
+	{
+		const auto report = [this](const char* channel, const spu_channel_stats_t& stats)
+		{
+			if (stats.spun || stats.blocked)
+			{
+				LOG_NOTICE(SPU, "%s: %s waits: %llu spun, %llu blocked", get_name(), channel, stats.spun, stats.blocked);
+			}
+		};
+
+		report("SPU_RdInMbox", ch_in_mbox.stats);
+		report("SPU_RdSigNotify1", ch_snr1.stats);
+		report("SPU_RdSigNotify2", ch_snr2.stats);
+		report("SPU_RdEventStat", ch_event_stats);
+		report("MFC_RdTagStat", ch_tag_stat.stats);
+		report("MFC_RdAtomicStat", ch_atomic_stat.stats);
+		report("MFC_RdListStallStat", ch_stall_stat.stats);
+	}
+
 	// Deallocate Local Storage
 	vm::dealloc_verbose_nothrow(offset);
 }
@@ -100,10 +192,62 @@ void SPUThread::dump_info() const
 	CPUThread::dump_info();
 }
 
+const char* spu_stats_t::get_channel_name(u32 index)
+{
+	return index < no_channel ? spu_ch_name[index] : "other";
+}
+
+std::string SPUThread::format_stats() const
+{
+	std::string result = "Statistics:\n==========\n";
+
+	result += fmt::format("Instructions: %llu, compiled functions: %llu\n", stats.instructions.load(), stats.blocks.load());
+
+	result += fmt::format("Recompiler: %llu cache hits, %llu misses, %llu interpreter fallbacks, %llu compiled in %llu us\n",
+		stats.cache_hits.load(), stats.cache_misses.load(), stats.jit_misses.load(), stats.compiles.load(), stats.compile_time.load());
+
+	result += fmt::format("MFC: %llu GET (%llu bytes), %llu PUT (%llu bytes), %llu GET lists, %llu PUT lists, %llu barriers\n",
+		stats.mfc_cmds[spu_stats_t::mfc_get].load(), stats.mfc_get_bytes.load(), stats.mfc_cmds[spu_stats_t::mfc_put].load(), stats.mfc_put_bytes.load(),
+		stats.mfc_cmds[spu_stats_t::mfc_get_list].load(), stats.mfc_cmds[spu_stats_t::mfc_put_list].load(), stats.mfc_cmds[spu_stats_t::mfc_sync].load());
+
+	result += fmt::format("Atomics: %llu GETLLAR, %llu PUTLLC (%llu failed), %llu PUTLLUC\n",
+		stats.mfc_cmds[spu_stats_t::mfc_getllar].load(), stats.mfc_cmds[spu_stats_t::mfc_putllc].load(), stats.putllc_failures.load(), stats.mfc_cmds[spu_stats_t::mfc_putlluc].load());
+
+	for (u32 ch = 0; ch <= spu_stats_t::no_channel; ch++)
+	{
+		if (const u64 waits = stats.ch_waits[ch])
+		{
+			result += fmt::format("Waits on %s: %llu, %llu us\n", spu_stats_t::get_channel_name(ch), waits, stats.ch_wait_time[ch].load());
+		}
+	}
+
+	return result;
+}
+
 void SPUThread::cpu_task()
 {
 	std::fesetround(FE_TOWARDZERO);
 
+	// hold the scheduler slot while running (nested calls from fast_call() don't acquire it again)
+	struct sched_slot_t
+	{
+		SPUThread& spu;
+		const bool owner;
+
+		sched_slot_t(SPUThread& spu)
+			: spu(spu)
+			, owner(spu.scheduler && !spu.sched_slot)
+		{
+			if (owner) spu.scheduler->acquire(spu);
+		}
+
+		~sched_slot_t()
+		{
+			if (owner) spu.scheduler->release(spu);
+		}
+	}
+	const slot{ *this };
+
 	if (!custom_task && !m_dec)
 	{
 		// Select opcode table (TODO)
@@ -112,23 +256,60 @@ void SPUThread::cpu_task()
 		// LS base address
 		const auto base = vm::_ptr<const u32>(offset);
 
+		// Handler cache mirroring LS, filled lazily
+		if (!ls_decoded)
+		{
+			ls_decoded.reset(new ls_decoded_t[0x10000]{});
+		}
+
+		const auto decoded = ls_decoded.get();
+
+		// instructions not added to the perf counter yet
+		u32 executed = 0;
+
 		while (true)
 		{
+			if (ls_decoded_flush.load(std::memory_order_relaxed))
+			{
+				ls_decoded_update();
+			}
+
 			if (!m_state)
 			{
-				// read opcode
-				const u32 opcode = base[pc / 4];
+				auto& entry = decoded[pc / 4];
+
+				if (!entry.func)
+				{
+					// decode the instruction (stores into the page are reported since now)
+					ls_decoded_page[pc / 1024] = 1;
+
+					const u32 opcode = base[pc / 4];
+
+					entry.func = table[opcode];
+					entry.opcode = opcode;
+				}
 
 				// call interpreter function
-				table[opcode](*this, { opcode });
+				entry.func(*this, { entry.opcode });
 
 				// next instruction
 				pc += 4;
 
+				if (++executed == 0x10000)
+				{
+					perf::add(perf::spu_instructions, executed);
+					spu_stats_t::add(stats.instructions, executed);
+					executed = 0;
+				}
+
 				continue;
 			}
 
-			if (check_status())
+			perf::add(perf::spu_instructions, executed);
+			spu_stats_t::add(stats.instructions, executed);
+			executed = 0;
+
+			if (sched_check_status())
 			{
 				return;
 			}
@@ -137,18 +318,101 @@ void SPUThread::cpu_task()
 
 	if (custom_task)
 	{
-		if (check_status()) return;
+		if (sched_check_status()) return;
 
 		return custom_task(*this);
 	}
 
-	while (!m_state || !check_status())
+	while (!m_state || !sched_check_status())
 	{
 		// decode instruction using specified decoder
 		pc += m_dec->DecodeMemory(pc + offset);
 	}
 }
 
+void SPUThread::sched_wait(std::unique_lock<std::mutex>& lock)
+{
+	spu_stats_wait_t wait_stats(stats);
+
+	if (!scheduler)
+	{
+		return cv.wait(lock);
+	}
+
+	scheduler->release(*this);
+	cv.wait(lock);
+	lock.unlock();
+
+	try
+	{
+		scheduler->acquire(*this);
+	}
+	catch (...)
+	{
+		// callers may rely on the mutex (lv2 lock) being held while unwinding
+		lock.lock();
+		throw;
+	}
+
+	lock.lock();
+}
+
+void SPUThread::sched_wait_for(std::unique_lock<std::mutex>& lock, std::chrono::milliseconds timeout)
+{
+	spu_stats_wait_t wait_stats(stats);
+
+	if (!scheduler)
+	{
+		cv.wait_for(lock, timeout);
+		return;
+	}
+
+	scheduler->release(*this);
+	cv.wait_for(lock, timeout);
+	lock.unlock();
+
+	try
+	{
+		scheduler->acquire(*this);
+	}
+	catch (...)
+	{
+		lock.lock();
+		throw;
+	}
+
+	lock.lock();
+}
+
+bool SPUThread::sched_check_status()
+{
+	if (!scheduler)
+	{
+		return check_status();
+	}
+
+	if (m_state & CPU_STATE_YIELD)
+	{
+		scheduler->yield(*this);
+	}
+
+	if (!is_paused())
+	{
+		return check_status();
+	}
+
+	// paused threads (debugger, waiting or suspended group) don't need the slot
+	scheduler->release(*this);
+
+	if (check_status())
+	{
+		return true;
+	}
+
+	scheduler->acquire(*this);
+	return false;
+}
+
 void SPUThread::init_regs()
 {
 	gpr = {};
@@ -204,6 +468,17 @@ void SPUThread::do_run()
 {
 	m_dec.reset();
 
+	// LS image may be reloaded
+	if (ls_decoded)
+	{
+		for (auto& dirty : ls_decoded_dirty)
+		{
+			dirty = 1;
+		}
+
+		ls_decoded_flush = true;
+	}
+
 	switch (auto mode = rpcs3::state.config.core.spu_decoder.value())
 	{
 	case spu_decoder_type::interpreter_precise: // Interpreter 1 (Precise)
@@ -261,6 +536,235 @@ void SPUThread::fast_call(u32 ls_addr)
 	custom_task = std::move(old_task);
 }
 
+spu_scheduler_t::spu_scheduler_t()
+	: slots(rpcs3::state.config.core.spu_running_threads.value())
+{
+	LOG_NOTICE(SPU, "SPU Scheduler: at most %u SPU threads running", slots);
+}
+
+void spu_scheduler_t::acquire(SPUThread& spu)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	if (spu.sched_slot)
+	{
+		return;
+	}
+
+	m_waiting.emplace_back(&spu);
+
+	while (m_waiting.front() != &spu || m_running.size() >= slots)
+	{
+		if (Emu.IsStopped() || spu.is_stopped())
+		{
+			m_waiting.erase(std::find(m_waiting.begin(), m_waiting.end(), &spu));
+			m_cv.notify_all();
+			lock.unlock();
+
+			CHECK_EMU_STATUS;
+			throw CPUThreadStop{};
+		}
+
+		if (m_cv.wait_for(lock, std::chrono::milliseconds(5)) == std::cv_status::timeout && m_waiting.front() == &spu && m_running.size() >= slots)
+		{
+			// time slice expired, ask the thread running for the longest time to yield
+			m_running.front()->m_state |= CPU_STATE_YIELD;
+		}
+	}
+
+	m_waiting.pop_front();
+	m_running.emplace_back(&spu);
+	spu.sched_slot = true;
+
+	// the next thread may take another free slot
+	m_cv.notify_all();
+}
+
+void spu_scheduler_t::release(SPUThread& spu)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (!spu.sched_slot)
+	{
+		return;
+	}
+
+	m_running.erase(std::find(m_running.begin(), m_running.end(), &spu));
+	spu.sched_slot = false;
+	spu.m_state &= ~CPU_STATE_YIELD;
+
+	m_cv.notify_all();
+}
+
+void spu_scheduler_t::yield(SPUThread& spu)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		spu.m_state &= ~CPU_STATE_YIELD;
+
+		if (m_waiting.empty())
+		{
+			return;
+		}
+	}
+
+	release(spu);
+	acquire(spu);
+}
+
+spu_dma_engine_t::spu_dma_engine_t()
+{
+	const u32 count = std::max<u32>(rpcs3::state.config.core.spu_dma_threads.value(), 1);
+
+	for (u32 i = 0; i < count; i++)
+	{
+		m_workers.emplace_back(thread_ctrl::spawn(COPY_EXPR(fmt::format("SPU DMA[%u]", i)), [this]()
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+
+			while (true)
+			{
+				if (m_exit)
+				{
+					return;
+				}
+
+				if (m_queue.empty())
+				{
+					m_cv.wait(lock);
+					continue;
+				}
+
+				SPUThread& spu = *m_queue.front();
+				m_queue.pop_front();
+
+				lock.unlock();
+
+				bool reschedule = false;
+
+				// Process transfers in order (limited number, so other SPU threads aren't starved)
+				for (u32 n = 0;; n++)
+				{
+					std::pair<u32, spu_mfc_arg_t> transfer;
+
+					{
+						std::lock_guard<std::mutex> lock(spu.mfc_dma_mutex);
+
+						if (spu.mfc_dma_queue.empty())
+						{
+							spu.mfc_dma_scheduled = false;
+							break;
+						}
+
+						if (n >= 64)
+						{
+							reschedule = true;
+							break;
+						}
+
+						transfer = spu.mfc_dma_queue.front();
+						spu.mfc_dma_queue.pop_front();
+					}
+
+					try
+					{
+						spu.do_dma_copy(transfer.first, transfer.second);
+					}
+					catch (const std::exception& e)
+					{
+						LOG_ERROR(SPU, "%s: DMA transfer failed: %s", spu.get_name(), e.what());
+						Emu.Pause();
+					}
+
+					const bool tag_done = --spu.mfc_tag_pending[transfer.second.tag & 31] == 0;
+
+					spu.mfc_dma_pending--;
+
+					if (tag_done)
+					{
+						// lock for reliable notification
+						std::lock_guard<std::mutex> lock(spu.mutex);
+
+						spu.cv.notify_one();
+					}
+				}
+
+				lock.lock();
+
+				if (reschedule)
+				{
+					m_queue.emplace_back(&spu);
+				}
+			}
+		}));
+	}
+}
+
+spu_dma_engine_t::~spu_dma_engine_t()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		m_exit = true;
+	}
+
+	m_cv.notify_all();
+
+	for (auto& worker : m_workers)
+	{
+		worker->join();
+	}
+}
+
+void spu_dma_engine_t::schedule(SPUThread& spu)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		m_queue.emplace_back(&spu);
+	}
+
+	m_cv.notify_one();
+}
+
+u32 SPUThread::get_mfc_busy_tags() const
+{
+	if (!mfc_dma_pending)
+	{
+		return 0;
+	}
+
+	u32 result = 0;
+
+	for (u32 i = 0; i < 32; i++)
+	{
+		if (mfc_tag_pending[i])
+		{
+			result |= 1 << i;
+		}
+	}
+
+	return result;
+}
+
+void SPUThread::mfc_dma_wait(u32 tag_mask)
+{
+	if (!(get_mfc_busy_tags() & tag_mask))
+	{
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while (get_mfc_busy_tags() & tag_mask)
+	{
+		CHECK_EMU_STATUS;
+
+		sched_wait_for(lock, std::chrono::milliseconds(1));
+	}
+}
+
 void SPUThread::do_dma_transfer(u32 cmd, spu_mfc_arg_t args)
 {
 	if (cmd & (MFC_BARRIER_MASK | MFC_FENCE_MASK))
@@ -272,6 +776,9 @@ void SPUThread::do_dma_transfer(u32 cmd, spu_mfc_arg_t args)
 
 	if (eal >= SYS_SPU_THREAD_BASE_LOW && m_type == CPU_THREAD_SPU) // SPU Thread Group MMIO (LS and SNR)
 	{
+		// MMIO access can't be reordered with queued transfers
+		mfc_dma_wait();
+
 		const u32 index = (eal - SYS_SPU_THREAD_BASE_LOW) / SYS_SPU_THREAD_OFFSET; // thread number in group
 		const u32 offset = (eal - SYS_SPU_THREAD_BASE_LOW) % SYS_SPU_THREAD_OFFSET; // LS offset or MMIO register
 
@@ -305,19 +812,165 @@ void SPUThread::do_dma_transfer(u32 cmd, spu_mfc_arg_t args)
 	{
 	case MFC_PUT_CMD:
 	case MFC_PUTR_CMD:
+	case MFC_GET_CMD:
+	{
+		break;
+	}
+
+	default:
 	{
-		std::memcpy(vm::base(eal), vm::base(offset + args.lsa), args.size);
+		throw EXCEPTION("Invalid command %s (cmd=0x%x, lsa=0x%x, ea=0x%llx, tag=0x%x, size=0x%x)", get_mfc_cmd_name(cmd), cmd, args.lsa, args.ea, args.tag, args.size);
+	}
+	}
+
+	args.ea = eal;
+
+	perf::add(perf::dma_bytes, args.size);
+	spu_stats_t::add(cmd & MFC_GET_CMD ? stats.mfc_get_bytes : stats.mfc_put_bytes, args.size);
+
+	// HLE tasks (SPURS) access LS directly without waiting for tags, so their transfers are always synchronous
+	if (dma_engine && !custom_task && eal < SYS_SPU_THREAD_BASE_LOW)
+	{
+		mfc_tag_pending[args.tag & 31]++;
+		mfc_dma_pending++;
+
+		bool schedule;
+
+		{
+			std::lock_guard<std::mutex> lock(mfc_dma_mutex);
+
+			mfc_dma_queue.emplace_back(cmd, args);
+
+			schedule = !mfc_dma_scheduled;
+			mfc_dma_scheduled = true;
+		}
+
+		if (schedule)
+		{
+			dma_engine->schedule(*this);
+		}
+
 		return;
 	}
 
-	case MFC_GET_CMD:
+	do_dma_copy(cmd, args);
+}
+
+extern std::function<bool(u32 addr)> gfxHandler;
+
+void SPUThread::do_dma_copy(u32 cmd, spu_mfc_arg_t args)
+{
+	const u32 eal = VM_CAST(args.ea);
+
+	if (cmd & MFC_GET_CMD)
 	{
 		std::memcpy(vm::base(offset + args.lsa), vm::base(eal), args.size);
+		code_write(args.lsa, args.size);
+		return;
+	}
+
+	// Large aligned PUT: use non-temporal stores (data is usually consumed by PPU or RSX, not by this SPU)
+	if (args.size >= 4096 && ((eal | args.lsa | args.size) & 15) == 0 && eal >> 28 == (eal + args.size - 1) >> 28)
+	{
+		const auto src = static_cast<const __m128i*>(vm::base(offset + args.lsa));
+		const auto dst = static_cast<__m128i*>(vm::base_priv(eal)); // privileged access doesn't fault on reserved pages
+
+		// privileged writes don't fault on pages protected by graphics backend, watched by PPU code or by the memory snapshot either, report them
+		for (u32 page = eal & ~0xfff; page < eal + args.size; page += 4096)
+		{
+			gfxHandler(page);
+			ppu_on_code_write(page);
+			vm::snapshot_on_write(page);
+		}
+
+		for (u32 i = 0; i < args.size / 16; i++)
+		{
+			_mm_stream_si128(dst + i, _mm_load_si128(src + i));
+		}
+
+		_mm_sfence();
+
+		// lose reservations (normal writes would do it in access violation handler)
+		for (u32 addr = eal; addr < eal + args.size; addr += 128)
+		{
+			vm::reservation_break(addr);
+		}
+
 		return;
 	}
+
+	std::memcpy(vm::base(eal), vm::base(offset + args.lsa), args.size);
+}
+
+void SPUThread::code_write(u32 lsa, u32 size)
+{
+	lsa &= 0x3ffff;
+
+	u64 stamp = 0;
+
+	for (u32 page = lsa / 1024; size && page <= std::min<u32>(lsa + size - 1, 0x3ffff) / 1024; page++)
+	{
+		if (code_page_watch[page])
+		{
+			code_page_stamp[page] = stamp ? stamp : stamp = ++code_stamp;
+		}
+
+		// may be called by the DMA engine, the cache is updated by the thread itself
+		ls_decoded_dirty[page] = 1;
 	}
 
-	throw EXCEPTION("Invalid command %s (cmd=0x%x, lsa=0x%x, ea=0x%llx, tag=0x%x, size=0x%x)", get_mfc_cmd_name(cmd), cmd, args.lsa, args.ea, args.tag, args.size);
+	if (size)
+	{
+		ls_decoded_flush = true;
+	}
+}
+
+void SPUThread::ls_decoded_update()
+{
+	ls_decoded_flush = false;
+
+	for (u32 page = 0; page < 256; page++)
+	{
+		if (ls_decoded_dirty[page].exchange(0) && ls_decoded_page[page].exchange(0))
+		{
+			std::fill_n(ls_decoded.get() + page * 256, 256, ls_decoded_t{});
+		}
+	}
+}
+
+void spu_dma_list_copy(u8* ls, u8* mem, u32 lsa, const spu_mfc_list_element_t* list, u32 count, bool is_get)
+{
+	for (u32 i = 0; i < count; i++)
+	{
+		const u32 size = list[i].ts;
+		const u32 addr = list[i].ea;
+
+		if (!size)
+		{
+			continue;
+		}
+
+		u8* const ls_ptr = ls + (lsa | (addr & 0xf));
+		u8* const mem_ptr = mem + addr;
+
+		u8* const dst = is_get ? ls_ptr : mem_ptr;
+		const u8* const src = is_get ? mem_ptr : ls_ptr;
+
+		if (((addr | size) & 0xf) == 0)
+		{
+			// aligned SSE copy (typical 16..128 byte elements)
+			for (u32 j = 0; j < size; j += 16)
+			{
+				_mm_store_si128(reinterpret_cast<__m128i*>(dst + j), _mm_load_si128(reinterpret_cast<const __m128i*>(src + j)));
+			}
+		}
+		else
+		{
+			std::memcpy(dst, src, size);
+		}
+
+		lsa += std::max<u32>(size, 16);
+	}
 }
 
 void SPUThread::do_dma_list_cmd(u32 cmd, spu_mfc_arg_t args)
@@ -331,35 +984,106 @@ void SPUThread::do_dma_list_cmd(u32 cmd, spu_mfc_arg_t args)
 	const u32 list_size = args.size / 8;
 	args.lsa &= 0x3fff0;
 
-	struct list_element
+	const auto list = vm::_ptr<const spu_mfc_list_element_t>(offset + list_addr);
+
+	// Fast path for synchronous lists without stall bits and MMIO accesses (validated in advance)
+	if ((!dma_engine || custom_task) && list_addr + list_size * 8 <= 0x40000)
 	{
-		be_t<u16> sb; // Stall-and-Notify bit (0x8000)
-		be_t<u16> ts; // List Transfer Size
-		be_t<u32> ea; // External Address Low
+		bool fast = true;
+
+		u32 lsa = args.lsa;
+		u32 bytes = 0;
+
+		for (u32 i = 0; i < list_size; i++)
+		{
+			const u32 size = list[i].ts;
+			const u32 addr = list[i].ea;
+
+			if (list[i].sb & 0x8000 || size > 0x4000 || addr >= SYS_SPU_THREAD_BASE_LOW || addr + size > SYS_SPU_THREAD_BASE_LOW || (lsa | (addr & 0xf)) + size > 0x40000)
+			{
+				fast = false;
+				break;
+			}
+
+			if (size)
+			{
+				lsa += std::max<u32>(size, 16);
+				bytes += size;
+			}
+		}
+
+		if (fast)
+		{
+			spu_stats_t::add(cmd & MFC_GET_CMD ? stats.mfc_get_bytes : stats.mfc_put_bytes, bytes);
+
+			if (cmd & (MFC_BARRIER_MASK | MFC_FENCE_MASK))
+			{
+				_mm_mfence();
+			}
+
+			switch (cmd & ~(MFC_BARRIER_MASK | MFC_FENCE_MASK | MFC_LIST_MASK))
+			{
+			case MFC_PUT_CMD:
+			case MFC_PUTR_CMD:
+			{
+				return spu_dma_list_copy(vm::_ptr<u8>(offset), vm::_ptr<u8>(0), args.lsa, list, list_size, false);
+			}
+
+			case MFC_GET_CMD:
+			{
+				spu_dma_list_copy(vm::_ptr<u8>(offset), vm::_ptr<u8>(0), args.lsa, list, list_size, true);
+
+				// the last element ends before lsa + 16
+				return code_write(args.lsa, lsa - args.lsa + 16);
+			}
+			}
+
+			throw EXCEPTION("Invalid command %s (cmd=0x%x, lsa=0x%x, ea=0x%llx, tag=0x%x, size=0x%x)", get_mfc_cmd_name(cmd), cmd, args.lsa, args.ea, args.tag, args.size);
+		}
+	}
+
+	// Elements contiguous both in LS and in memory are coalesced into a single transfer
+	spu_mfc_arg_t transfer{};
+
+	const auto flush = [&]()
+	{
+		if (transfer.size)
+		{
+			do_dma_transfer(cmd & ~MFC_LIST_MASK, transfer);
+
+			transfer.size = 0;
+		}
 	};
 
 	for (u32 i = 0; i < list_size; i++)
 	{
-		auto rec = vm::ptr<list_element>::make(offset + list_addr + i * 8);
+		const auto rec = list + i;
 
 		const u32 size = rec->ts;
 		const u32 addr = rec->ea;
 
 		if (size)
 		{
-			spu_mfc_arg_t transfer;
-			transfer.ea = addr;
-			transfer.lsa = args.lsa | (addr & 0xf);
-			transfer.tag = args.tag;
-			transfer.size = size;
+			const u32 lsa = args.lsa | (addr & 0xf);
 
-			do_dma_transfer(cmd & ~MFC_LIST_MASK, transfer);
+			if (!transfer.size || transfer.ea + transfer.size != addr || transfer.lsa + transfer.size != lsa || transfer.size + size > 0x4000)
+			{
+				flush();
+
+				transfer.ea = addr;
+				transfer.lsa = lsa;
+				transfer.tag = args.tag;
+			}
+
+			transfer.size += size;
 
 			args.lsa += std::max<u32>(size, 16);
 		}
 
 		if (rec->sb & 0x8000)
 		{
+			flush();
+
 			ch_stall_stat.set_value((1 << args.tag) | ch_stall_stat.get_value());
 
 			spu_mfc_arg_t stalled;
@@ -372,6 +1096,8 @@ void SPUThread::do_dma_list_cmd(u32 cmd, spu_mfc_arg_t args)
 			return;
 		}
 	}
+
+	flush();
 }
 
 void SPUThread::process_mfc_cmd(u32 cmd)
@@ -390,6 +1116,8 @@ void SPUThread::process_mfc_cmd(u32 cmd)
 	case MFC_GETB_CMD:
 	case MFC_GETF_CMD:
 	{
+		spu_stats_t::add(stats.mfc_cmds[cmd & MFC_GET_CMD ? spu_stats_t::mfc_get : spu_stats_t::mfc_put]);
+
 		return do_dma_transfer(cmd, ch_mfc_args);
 	}
 
@@ -403,6 +1131,8 @@ void SPUThread::process_mfc_cmd(u32 cmd)
 	case MFC_GETLB_CMD:
 	case MFC_GETLF_CMD:
 	{
+		spu_stats_t::add(stats.mfc_cmds[cmd & MFC_GET_CMD ? spu_stats_t::mfc_get_list : spu_stats_t::mfc_put_list]);
+
 		return do_dma_list_cmd(cmd, ch_mfc_args);
 	}
 
@@ -413,6 +1143,10 @@ void SPUThread::process_mfc_cmd(u32 cmd)
 			break;
 		}
 
+		spu_stats_t::add(stats.mfc_cmds[spu_stats_t::mfc_getllar]);
+
+		mfc_dma_wait();
+
 		const u32 raddr = VM_CAST(ch_mfc_args.ea);
 
 		vm::reservation_acquire(vm::base(offset + ch_mfc_args.lsa), raddr, 128);
@@ -434,6 +1168,10 @@ void SPUThread::process_mfc_cmd(u32 cmd)
 			break;
 		}
 
+		spu_stats_t::add(stats.mfc_cmds[spu_stats_t::mfc_putllc]);
+
+		mfc_dma_wait();
+
 		if (vm::reservation_update(VM_CAST(ch_mfc_args.ea), vm::base(offset + ch_mfc_args.lsa), 128))
 		{
 			if (last_raddr == 0)
@@ -447,6 +1185,8 @@ void SPUThread::process_mfc_cmd(u32 cmd)
 		}
 		else
 		{
+			spu_stats_t::add(stats.putllc_failures);
+
 			if (last_raddr != 0)
 			{
 				ch_event_stat |= SPU_EVENT_LR;
@@ -466,6 +1206,10 @@ void SPUThread::process_mfc_cmd(u32 cmd)
 			break;
 		}
 
+		spu_stats_t::add(stats.mfc_cmds[spu_stats_t::mfc_putlluc]);
+
+		mfc_dma_wait();
+
 		vm::reservation_op(VM_CAST(ch_mfc_args.ea), 128, [this]()
 		{
 			std::memcpy(vm::base_priv(VM_CAST(ch_mfc_args.ea)), vm::base(offset + ch_mfc_args.lsa), 128);
@@ -489,6 +1233,7 @@ void SPUThread::process_mfc_cmd(u32 cmd)
 	case MFC_BARRIER_CMD:
 	case MFC_EIEIO_CMD:
 	case MFC_SYNC_CMD:
+		spu_stats_t::add(stats.mfc_cmds[spu_stats_t::mfc_sync]);
 		LOG_WARNING(SPU, "process_mfc_cmd: Sync channel '%s' ignored. (cmd=0x%x, lsa=0x%x, ea=0x%llx, tag=0x%x, size=0x%x)",
 			get_mfc_cmd_name(cmd), cmd, ch_mfc_args.lsa, ch_mfc_args.ea, ch_mfc_args.tag, ch_mfc_args.size);
 		return;
@@ -595,12 +1340,73 @@ u32 SPUThread::get_ch_count(u32 ch)
 	throw EXCEPTION("Unknown/illegal channel (ch=%d [%s])", ch, ch < 128 ? spu_ch_name[ch] : "???");
 }
 
+u32 SPUThread::get_ch_count_polling(u32 ch)
+{
+	if (const u32 count = get_ch_count(ch))
+	{
+		ch_poll_count = 0;
+		return count;
+	}
+
+	const u32 threshold = rpcs3::state.config.core.spin_loop_idle.value();
+
+	if (!threshold || ++ch_poll_count < threshold)
+	{
+		return 0;
+	}
+
+	ch_poll_count = 0;
+
+	perf::add(perf::spin_waits);
+
+	std::unique_lock<std::mutex> lock(mutex);
+
+	// request notification from the writer where possible, other channels are only checked again after the timeout
+	u32 count;
+
+	switch (ch)
+	{
+	case SPU_RdInMbox:        count = ch_in_mbox.try_wait(); break;
+	case MFC_RdTagStat:       count = ch_tag_stat.try_wait(); break;
+	case MFC_RdListStallStat: count = ch_stall_stat.try_wait(); break;
+	case SPU_RdSigNotify1:    count = ch_snr1.try_wait(); break;
+	case SPU_RdSigNotify2:    count = ch_snr2.try_wait(); break;
+	case MFC_RdAtomicStat:    count = ch_atomic_stat.try_wait(); break;
+	case SPU_RdEventStat:     count = get_events(true) ? 1 : 0; break;
+	default:                  count = get_ch_count(ch);
+	}
+
+	if (!count && !is_stopped())
+	{
+		CHECK_EMU_STATUS;
+
+		sched_wait_for(lock, std::chrono::milliseconds(1));
+	}
+
+	if (ch == SPU_RdEventStat)
+	{
+		ch_event_stat &= ~SPU_EVENT_WAITING;
+	}
+
+	lock.unlock();
+
+	return get_ch_count(ch);
+}
+
 u32 SPUThread::get_ch_value(u32 ch)
 {
 	LOG_TRACE(SPU, "get_ch_value(ch=%d [%s])", ch, ch < 128 ? spu_ch_name[ch] : "???");
 
+	spu_stats_channel_t stats_channel(stats, ch);
+
 	auto read_channel = [this](spu_channel_t& channel) -> u32
 	{
+		// spinning doesn't set the notification flag, so writers don't have to lock the mutex
+		if (!channel.get_count())
+		{
+			channel.stats.add(spu_spin_wait(WRAP_EXPR(channel.get_count() != 0)));
+		}
+
 		std::unique_lock<std::mutex> lock(mutex, std::defer_lock);
 
 		while (true)
@@ -625,7 +1431,7 @@ u32 SPUThread::get_ch_value(u32 ch)
 				continue;
 			}
 
-			cv.wait(lock);
+			sched_wait(lock);
 		}
 	};
 
@@ -636,6 +1442,11 @@ u32 SPUThread::get_ch_value(u32 ch)
 	//	break;
 	case SPU_RdInMbox:
 	{
+		if (!ch_in_mbox.values.load().count)
+		{
+			ch_in_mbox.stats.add(spu_spin_wait(WRAP_EXPR(ch_in_mbox.values.load().count != 0)));
+		}
+
 		std::unique_lock<std::mutex> lock(mutex, std::defer_lock);
 
 		while (true)
@@ -666,7 +1477,7 @@ u32 SPUThread::get_ch_value(u32 ch)
 				continue;
 			}
 
-			cv.wait(lock);
+			sched_wait(lock);
 		}
 	}
 
@@ -714,6 +1525,11 @@ u32 SPUThread::get_ch_value(u32 ch)
 	{
 		std::unique_lock<std::mutex> lock(mutex, std::defer_lock);
 
+		if (!get_events())
+		{
+			ch_event_stats.add(spu_spin_wait(WRAP_EXPR(get_events() != 0)));
+		}
+
 		// start waiting or return immediately
 		if (u32 res = get_events(true))
 		{
@@ -723,7 +1539,13 @@ u32 SPUThread::get_ch_value(u32 ch)
 		if (ch_event_mask & SPU_EVENT_LR)
 		{
 			// register waiter if polling reservation status is required
+			spu_stats_wait_t wait_stats(stats);
+
+			if (scheduler) scheduler->release(*this);
+
 			vm::wait_op(*this, last_raddr, 128, WRAP_EXPR(get_events(true) || is_stopped()));
+
+			if (scheduler) scheduler->acquire(*this);
 		}
 		else
 		{
@@ -734,7 +1556,7 @@ u32 SPUThread::get_ch_value(u32 ch)
 			{
 				CHECK_EMU_STATUS;
 
-				cv.wait(lock);
+				sched_wait(lock);
 			}
 		}
 
@@ -760,6 +1582,8 @@ void SPUThread::set_ch_value(u32 ch, u32 value)
 {
 	LOG_TRACE(SPU, "set_ch_value(ch=%d [%s], value=0x%x)", ch, ch < 128 ? spu_ch_name[ch] : "???", value);
 
+	spu_stats_channel_t stats_channel(stats, ch);
+
 	switch (ch)
 	{
 	//case SPU_WrSRR0:
@@ -767,6 +1591,8 @@ void SPUThread::set_ch_value(u32 ch, u32 value)
 	//	break;
 	case SPU_WrOutIntrMbox:
 	{
+		mfc_dma_wait();
+
 		if (m_type == CPU_THREAD_RAW_SPU)
 		{
 			std::unique_lock<std::mutex> lock(mutex, std::defer_lock);
@@ -783,7 +1609,7 @@ void SPUThread::set_ch_value(u32 ch, u32 value)
 					continue;
 				}
 
-				cv.wait(lock);
+				sched_wait(lock);
 			}
 
 			int_ctrl[2].set(SPU_INT2_STAT_MAILBOX_INT);
@@ -796,8 +1622,6 @@ void SPUThread::set_ch_value(u32 ch, u32 value)
 			{
 				/* ===== sys_spu_thread_send_event (used by spu_printf) ===== */
 
-				LV2_LOCK;
-
 				const u8 spup = code & 63;
 
 				if (!ch_out_mbox.get_count())
@@ -816,7 +1640,7 @@ void SPUThread::set_ch_value(u32 ch, u32 value)
 
 				LOG_TRACE(SPU, "sys_spu_thread_send_event(spup=%d, data0=0x%x, data1=0x%x)", spup, value & 0x00ffffff, data);
 
-				const auto queue = this->spup[spup].lock();
+				const auto queue = get_port(spup);
 
 				if (!queue)
 				{
@@ -824,12 +1648,14 @@ void SPUThread::set_ch_value(u32 ch, u32 value)
 					return ch_in_mbox.set_values(1, CELL_ENOTCONN); // TODO: check error passing
 				}
 
+				lv2_lock_t queue_lock(queue->sync_mutex);
+
 				if (queue->events.size() >= queue->size)
 				{
 					return ch_in_mbox.set_values(1, CELL_EBUSY);
 				}
 
-				queue->push(lv2_lock, SYS_SPU_THREAD_EVENT_USER_KEY, m_id, ((u64)spup << 32) | (value & 0x00ffffff), data);
+				queue->push(queue_lock, SYS_SPU_THREAD_EVENT_USER_KEY, m_id, ((u64)spup << 32) | (value & 0x00ffffff), data);
 
 				return ch_in_mbox.set_values(1, CELL_OK);
 			}
@@ -837,8 +1663,6 @@ void SPUThread::set_ch_value(u32 ch, u32 value)
 			{
 				/* ===== sys_spu_thread_throw_event ===== */
 
-				LV2_LOCK;
-
 				const u8 spup = code & 63;
 
 				if (!ch_out_mbox.get_count())
@@ -852,7 +1676,7 @@ void SPUThread::set_ch_value(u32 ch, u32 value)
 
 				LOG_TRACE(SPU, "sys_spu_thread_throw_event(spup=%d, data0=0x%x, data1=0x%x)", spup, value & 0x00ffffff, data);
 
-				const auto queue = this->spup[spup].lock();
+				const auto queue = get_port(spup);
 
 				if (!queue)
 				{
@@ -860,6 +1684,8 @@ void SPUThread::set_ch_value(u32 ch, u32 value)
 					return;
 				}
 
+				lv2_lock_t queue_lock(queue->sync_mutex);
+
 				// TODO: check passing spup value
 				if (queue->events.size() >= queue->size)
 				{
@@ -867,7 +1693,7 @@ void SPUThread::set_ch_value(u32 ch, u32 value)
 					return;
 				}
 
-				queue->push(lv2_lock, SYS_SPU_THREAD_EVENT_USER_KEY, m_id, ((u64)spup << 32) | (value & 0x00ffffff), data);
+				queue->push(queue_lock, SYS_SPU_THREAD_EVENT_USER_KEY, m_id, ((u64)spup << 32) | (value & 0x00ffffff), data);
 				return;
 			}
 			else if (code == 128)
@@ -973,6 +1799,9 @@ void SPUThread::set_ch_value(u32 ch, u32 value)
 
 	case SPU_WrOutMbox:
 	{
+		// PPU may access memory written by the SPU after receiving the message
+		mfc_dma_wait();
+
 		std::unique_lock<std::mutex> lock(mutex, std::defer_lock);
 
 		while (!ch_out_mbox.try_push(value))
@@ -987,7 +1816,7 @@ void SPUThread::set_ch_value(u32 ch, u32 value)
 				continue;
 			}
 
-			cv.wait(lock);
+			sched_wait(lock);
 		}
 
 		return;
@@ -1001,7 +1830,30 @@ void SPUThread::set_ch_value(u32 ch, u32 value)
 
 	case MFC_WrTagUpdate:
 	{
-		ch_tag_stat.set_value(ch_tag_mask); // hack
+		if (value == MFC_TAG_UPDATE_ALL)
+		{
+			mfc_dma_wait(ch_tag_mask);
+		}
+		else if (value == MFC_TAG_UPDATE_ANY && ch_tag_mask)
+		{
+			// wait for at least one tag group
+			std::unique_lock<std::mutex> lock(mutex, std::defer_lock);
+
+			while ((get_mfc_busy_tags() & ch_tag_mask) == ch_tag_mask)
+			{
+				CHECK_EMU_STATUS;
+
+				if (!lock)
+				{
+					lock.lock();
+					continue;
+				}
+
+				sched_wait_for(lock, std::chrono::milliseconds(1));
+			}
+		}
+
+		ch_tag_stat.set_value(ch_tag_mask & ~get_mfc_busy_tags());
 		return;
 	}
 
@@ -1136,6 +1988,8 @@ void SPUThread::stop_and_signal(u32 code)
 {
 	LOG_TRACE(SPU, "stop_and_signal(code=0x%x)", code);
 
+	mfc_dma_wait();
+
 	if (m_type == CPU_THREAD_RAW_SPU)
 	{
 		status.atomic_op([code](u32& status)
@@ -1154,7 +2008,12 @@ void SPUThread::stop_and_signal(u32 code)
 	{
 	case 0x001:
 	{
-		std::this_thread::sleep_for(std::chrono::milliseconds(1)); // hack
+		// hack: short wait, interrupted by thread notifications (stop, group state change, signaled channels)
+		std::unique_lock<std::mutex> lock(mutex);
+
+		if (is_stopped()) throw CPUThreadStop{};
+
+		sched_wait_for(lock, std::chrono::milliseconds(1));
 		return;
 	}
 
@@ -1243,7 +2102,8 @@ void SPUThread::stop_and_signal(u32 code)
 
 			if (is_stopped()) throw CPUThreadStop{};
 
-			group->cv.wait_for(lv2_lock, std::chrono::milliseconds(1));
+			// notified by notify_state()
+			sched_wait(lv2_lock);
 		}
 
 		// change group status
@@ -1261,29 +2121,41 @@ void SPUThread::stop_and_signal(u32 code)
 			throw EXCEPTION("Unexpected SPU Thread Group state (%d)", group->state);
 		}
 
-		if (queue->events.size())
 		{
-			auto& event = queue->events.front();
-			ch_in_mbox.set_values(4, CELL_OK, static_cast<u32>(std::get<1>(event)), static_cast<u32>(std::get<2>(event)), static_cast<u32>(std::get<3>(event)));
+			lv2_lock_t queue_lock(queue->sync_mutex);
 
-			queue->events.pop_front();
-		}
-		else
-		{
-			// add waiter; protocol is ignored in current implementation
-			sleep_queue_entry_t waiter(*this, queue->sq);
+			if (queue->events.size())
+			{
+				auto& event = queue->events.front();
+				ch_in_mbox.set_values(4, CELL_OK, static_cast<u32>(std::get<1>(event)), static_cast<u32>(std::get<2>(event)), static_cast<u32>(std::get<3>(event)));
 
-			// wait on the event queue
-			while (!unsignal())
+				queue->events.pop_front();
+			}
+			else
 			{
-				CHECK_EMU_STATUS;
+				// add waiter (SPU threads have no priority, FIFO order)
+				sleep_queue_entry_t waiter(*this, queue->sq);
 
-				if (is_stopped()) throw CPUThreadStop{};
+				// push() signals under the queue lock only, don't hold LV2_LOCK while waiting
+				lv2_lock.unlock();
+
+				// wait on the event queue
+				while (!unsignal())
+				{
+					CHECK_EMU_STATUS;
+
+					if (is_stopped()) throw CPUThreadStop{};
+
+					sched_wait(queue_lock);
+				}
 
-				cv.wait(lv2_lock);
+				// event data must be set by push()
 			}
+		}
 
-			// event data must be set by push()
+		if (!lv2_lock)
+		{
+			lv2_lock.lock();
 		}
 		
 		// restore thread group status
@@ -1305,7 +2177,7 @@ void SPUThread::stop_and_signal(u32 code)
 			if (thread) thread->awake(); // untrigger status check
 		}
 
-		group->cv.notify_all();
+		group->notify_state(lv2_lock);
 
 		return;
 	}
@@ -1345,7 +2217,7 @@ void SPUThread::stop_and_signal(u32 code)
 		group->state = SPU_THREAD_GROUP_STATUS_INITIALIZED;
 		group->exit_status = value;
 		group->join_state |= SPU_TGJSF_GROUP_EXIT;
-		group->cv.notify_one();
+		group->notify_join(lv2_lock);
 
 		return stop();
 	}
@@ -1371,7 +2243,7 @@ void SPUThread::stop_and_signal(u32 code)
 		}
 
 		status |= SPU_STATUS_STOPPED_BY_STOP;
-		group->cv.notify_one();
+		group->notify_join(lv2_lock);
 
 		return stop();
 	}
@@ -1391,6 +2263,8 @@ void SPUThread::halt()
 {
 	LOG_TRACE(SPU, "halt()");
 
+	mfc_dma_wait();
+
 	if (m_type == CPU_THREAD_RAW_SPU)
 	{
 		status.atomic_op([](u32& status)
@@ -8,6 +8,7 @@
 struct lv2_event_queue_t;
 struct lv2_spu_group_t;
 struct lv2_int_tag_t;
+union spu_opcode_t;
 
 // SPU Channels
 enum : u32
@@ -135,6 +136,18 @@ enum
 	SPU_RdSigNotify2_offs = 0x1C00C,
 };
 
+// Statistics of SPU channel reads which had to wait for a value (only updated by the SPU thread)
+struct spu_channel_stats_t
+{
+	u64 spun = 0; // value became available while spinning
+	u64 blocked = 0; // value wasn't available after spinning
+
+	void add(bool spin_result)
+	{
+		(spin_result ? spun : blocked)++;
+	}
+};
+
 struct spu_channel_t
 {
 	// set to true if SPU thread must be notified after SPU channel operation
@@ -149,6 +162,8 @@ struct spu_channel_t
 
 	atomic_t<sync_var_t> data;
 
+	spu_channel_stats_t stats;
+
 public:
 	// returns true on success
 	bool try_push(u32 value)
@@ -233,6 +248,16 @@ public:
 	{
 		return data.load().count;
 	}
+
+	// request notification on the next push if no value is available (returns the count)
+	u32 try_wait()
+	{
+		return data.atomic_op([](sync_var_t& data)
+		{
+			data.wait = data.wait || !data.count;
+			return data.count;
+		});
+	}
 };
 
 struct spu_channel_4_t
@@ -253,6 +278,8 @@ struct spu_channel_4_t
 	atomic_t<sync_var_t> values;
 	atomic_t<u32> value3;
 
+	spu_channel_stats_t stats;
+
 public:
 	void clear()
 	{
@@ -317,6 +344,16 @@ public:
 		return values.raw().count;
 	}
 
+	// request notification on the next push if no value is available (returns the count)
+	u32 try_wait()
+	{
+		return values.atomic_op([](sync_var_t& data) -> u32
+		{
+			if (!data.count) data.waiting = 1;
+			return data.count;
+		});
+	}
+
 	void set_values(u32 count, u32 value0, u32 value1 = 0, u32 value2 = 0, u32 value3 = 0)
 	{
 		this->values.raw() = { 0, count, value0, value1, value2 };
@@ -345,7 +382,6 @@ struct spu_int_ctrl_t
 
 struct spu_imm_table_t
 {
-	v128 fsmb[65536]; // table for FSMB, FSMBI instructions
 	v128 fsmh[256]; // table for FSMH instruction
 	v128 fsm[16]; // table for FSM instruction
 
@@ -391,14 +427,6 @@ struct spu_imm_table_t
 			}
 		}
 
-		for (u32 i = 0; i < sizeof(fsmb) / sizeof(fsmb[0]); i++)
-		{
-			for (u32 j = 0; j < 16; j++)
-			{
-				fsmb[i]._u8[j] = (i & (1 << j)) ? 0xff : 0;
-			}
-		}
-
 		for (u32 i = 0; i < sizeof(sldq_pshufb) / sizeof(sldq_pshufb[0]); i++)
 		{
 			for (u32 j = 0; j < 16; j++)
@@ -427,6 +455,16 @@ struct spu_imm_table_t
 
 extern const spu_imm_table_t g_spu_imm;
 
+// Mask for FSMB, FSMBI instructions (computed, a table would take 1 MiB of cache)
+inline __m128i spu_fsmb(u32 mask)
+{
+	const __m128i bits = _mm_set1_epi64x(0x8040201008040201);
+
+	// broadcast mask bytes (low byte to the lower half), then test one bit per byte
+	const __m128i value = _mm_shuffle_epi8(_mm_cvtsi32_si128(mask), _mm_set_epi64x(0x0101010101010101, 0));
+	return _mm_cmpeq_epi8(_mm_and_si128(value, bits), bits);
+}
+
 enum FPSCR_EX
 {
 	//Single-precision exceptions
@@ -526,9 +564,114 @@ public:
 	}
 };
 
+// MFC DMA list element
+struct spu_mfc_list_element_t
+{
+	be_t<u16> sb; // Stall-and-Notify bit (0x8000)
+	be_t<u16> ts; // List Transfer Size
+	be_t<u32> ea; // External Address Low
+};
+
+// Execute DMA list transfers between LS and memory (elements must be validated: no stall bits, no MMIO, LS bounds)
+void spu_dma_list_copy(u8* ls, u8* mem, u32 lsa, const spu_mfc_list_element_t* list, u32 count, bool is_get);
+
+class SPUThread;
+
+// Execution statistics of an SPU thread (written by the thread without locked instructions, read by the debugger and the performance overlay)
+struct spu_stats_t
+{
+	enum mfc_type_t : u32
+	{
+		mfc_get,
+		mfc_put,
+		mfc_get_list,
+		mfc_put_list,
+		mfc_getllar,
+		mfc_putllc,
+		mfc_putlluc,
+		mfc_sync,
+
+		mfc_type_count
+	};
+
+	static const u32 no_channel = 128; // wait time index used outside of channel operations
+
+	std::atomic<u64> instructions{ 0 }; // interpreted instructions
+	std::atomic<u64> blocks{ 0 }; // compiled functions executed
+	std::array<std::atomic<u64>, 129> ch_waits{}; // number of sleeps by channel
+	std::array<std::atomic<u64>, 129> ch_wait_time{}; // time slept by channel (us)
+	std::array<std::atomic<u64>, mfc_type_count> mfc_cmds{};
+	std::atomic<u64> mfc_get_bytes{ 0 };
+	std::atomic<u64> mfc_put_bytes{ 0 };
+	std::atomic<u64> putllc_failures{ 0 }; // (successful PUTLLC commands = mfc_cmds[mfc_putllc] - putllc_failures)
+	std::atomic<u64> cache_hits{ 0 }; // recompiler target cache hits
+	std::atomic<u64> cache_misses{ 0 }; // functions analysed (not found in the target cache or modified)
+	std::atomic<u64> jit_misses{ 0 }; // interpreter fallbacks (function compiled in background)
+	std::atomic<u64> compiles{ 0 }; // functions compiled by the thread itself
+	std::atomic<u64> compile_time{ 0 }; // time spent compiling by the thread itself (us)
+
+	u32 channel = no_channel; // channel of the current operation (only accessed by the thread)
+
+	// Get channel name for the wait time index
+	static const char* get_channel_name(u32 index);
+
+	static void add(std::atomic<u64>& counter, u64 value = 1)
+	{
+		// single writer: no need for a locked instruction
+		counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+	}
+};
+
+// Worker threads performing DMA transfers of SPU threads asynchronously
+class spu_dma_engine_t final
+{
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+
+	// SPU threads with queued transfers
+	std::deque<SPUThread*> m_queue;
+
+	std::vector<std::shared_ptr<thread_ctrl>> m_workers;
+
+	bool m_exit = false;
+
+public:
+	spu_dma_engine_t();
+	~spu_dma_engine_t();
+
+	// Process transfers queued by the SPU thread
+	void schedule(SPUThread& spu);
+};
+
+// Limits the number of SPU threads executing at once (SPU threads release their slot while waiting)
+class spu_scheduler_t final
+{
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+
+	std::deque<SPUThread*> m_running; // Threads holding a slot (in order of acquisition)
+	std::deque<SPUThread*> m_waiting; // Threads waiting for a slot (FIFO)
+
+public:
+	const u32 slots;
+
+	spu_scheduler_t();
+
+	// Wait for a free slot, the longest running thread is asked to yield after a time slice
+	void acquire(SPUThread& spu);
+
+	// Give the slot back (does nothing if the thread doesn't hold one)
+	void release(SPUThread& spu);
+
+	// Move the thread to the end of the queue if other threads are waiting
+	void yield(SPUThread& spu);
+};
+
 class SPUThread : public CPUThread
 {
 	friend class SPURecompilerDecoder;
+	friend class spu_dma_engine_t;
+	friend class spu_scheduler_t;
 	friend class spu_recompiler;
 
 public:
@@ -541,6 +684,33 @@ public:
 
 	std::vector<std::pair<u32, spu_mfc_arg_t>> mfc_queue; // Only used for stalled list transfers
 
+	std::shared_ptr<spu_dma_engine_t> dma_engine; // Asynchronous DMA workers (null if DMA transfers are synchronous)
+
+	std::shared_ptr<spu_scheduler_t> scheduler; // Running threads limit (null if the number isn't limited)
+	bool sched_slot = false; // Set while the thread holds a scheduler slot (modified by the thread itself)
+
+	std::mutex mfc_dma_mutex;
+	std::deque<std::pair<u32, spu_mfc_arg_t>> mfc_dma_queue; // Transfers waiting for the DMA engine
+	bool mfc_dma_scheduled = false; // Set if the thread is in the DMA engine queue (protected by mfc_dma_mutex)
+	std::array<std::atomic<u32>, 32> mfc_tag_pending{}; // Number of unfinished transfers per tag
+	std::atomic<u32> mfc_dma_pending{ 0 }; // Number of unfinished transfers
+
+	std::array<std::atomic<u8>, 256> code_page_watch{}; // Set for 1 KB LS pages containing functions in the recompiler's target cache
+	std::array<std::atomic<u64>, 256> code_page_stamp{}; // Value of code_stamp at the last write to the watched page
+	std::atomic<u64> code_stamp{ 0 }; // Incremented on writes to watched pages
+
+	// Interpreter handler cache entry (one per LS instruction word)
+	struct ls_decoded_t
+	{
+		void(*func)(SPUThread& spu, spu_opcode_t op); // null if not decoded
+		u32 opcode;
+	};
+
+	std::unique_ptr<ls_decoded_t[]> ls_decoded; // Interpreter handler cache (allocated on the first use, only accessed by the thread itself)
+	std::array<std::atomic<u8>, 256> ls_decoded_page{}; // Set for 1 KB LS pages with filled cache entries
+	std::array<std::atomic<u8>, 256> ls_decoded_dirty{}; // Set for 1 KB LS pages written since the last cache update
+	std::atomic<bool> ls_decoded_flush{ false }; // Set if some page is dirty
+
 	u32 ch_tag_mask;
 	spu_channel_t ch_tag_stat;
 	spu_channel_t ch_stall_stat;
@@ -558,6 +728,8 @@ public:
 
 	atomic_t<u32> ch_event_mask;
 	atomic_t<u32> ch_event_stat;
+	spu_channel_stats_t ch_event_stats;
+	u32 ch_poll_count = 0; // consecutive empty polls in get_ch_count_polling()
 	u32 last_raddr; // Last Reservation Address (0 if not set)
 
 	u64 ch_dec_start_timestamp; // timestamp of writing decrementer value
@@ -572,7 +744,9 @@ public:
 	std::weak_ptr<lv2_spu_group_t> tg; // SPU Thread Group
 
 	std::array<std::pair<u32, std::weak_ptr<lv2_event_queue_t>>, 32> spuq; // Event Queue Keys for SPU Thread
-	std::weak_ptr<lv2_event_queue_t> spup[64]; // SPU Ports
+	std::weak_ptr<lv2_event_queue_t> spup[64]; // SPU Ports (modified under LV2_LOCK and the thread mutex)
+
+	spu_stats_t stats;
 
 	u32 pc = 0; // 
 	const u32 index; // SPU index
@@ -604,8 +778,45 @@ public:
 		}
 	}
 
+	// Get the event queue connected to SPU port (doesn't require LV2_LOCK)
+	std::shared_ptr<lv2_event_queue_t> get_port(u8 spup)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		return this->spup[spup].lock();
+	}
+
+	// Wait on cv, releasing the scheduler slot (reacquired before the mutex is locked again)
+	void sched_wait(std::unique_lock<std::mutex>& lock);
+	void sched_wait_for(std::unique_lock<std::mutex>& lock, std::chrono::milliseconds timeout);
+
+	// check_status() which handles yield requests and doesn't hold the scheduler slot while paused
+	bool sched_check_status();
+
 	void do_dma_transfer(u32 cmd, spu_mfc_arg_t args);
+	void do_dma_copy(u32 cmd, spu_mfc_arg_t args);
+
+	// Mark watched LS pages in the range as modified (invalidates functions in the recompiler's target cache)
+	void code_write(u32 lsa, u32 size);
+
+	// Process a 16-byte store to LS
+	void code_store(u32 lsa)
+	{
+		if (code_page_watch[lsa / 1024 % 256] || ls_decoded_page[lsa / 1024 % 256])
+		{
+			code_write(lsa, 16);
+		}
+	}
+
+	// Drop the interpreter handler cache entries of the dirty pages
+	void ls_decoded_update();
 	void do_dma_list_cmd(u32 cmd, spu_mfc_arg_t args);
+
+	// Get mask of tags with unfinished transfers
+	u32 get_mfc_busy_tags() const;
+
+	// Wait for all transfers with specified tags to finish
+	void mfc_dma_wait(u32 tag_mask = -1);
 	void process_mfc_cmd(u32 cmd);
 
 	u32 get_events(bool waiting = false);
@@ -613,6 +824,9 @@ public:
 	void set_interrupt_status(bool enable);
 	u32 get_ch_count(u32 ch);
 	u32 get_ch_value(u32 ch);
+
+	// get_ch_count() called by the channel polling loops found by the analyser, idles the thread after repeated empty polls
+	u32 get_ch_count_polling(u32 ch);
 	void set_ch_value(u32 ch, u32 value);
 
 	void stop_and_signal(u32 code);
@@ -682,9 +896,12 @@ public:
 
 	void fast_call(u32 ls_addr);
 
+	// Format execution statistics (one line per counter group)
+	std::string format_stats() const;
+
 	virtual std::string RegsToString() const override
 	{
-		std::string ret = "Registers:\n=========\n";
+		std::string ret = format_stats() + "\nRegisters:\n=========\n";
 
 		for(uint i=0; i<128; ++i) ret += fmt::format("GPR[%d] = 0x%s\n", i, gpr[i].to_hex().c_str());
 
@@ -64,6 +64,7 @@ void VFS::Mount(const std::string& ps3_path, const std::string& local_path, vfsD
 
 	device->SetPath(simpl_ps3_path, simplify_path(local_path, true, false));
 	m_devices.push_back(device);
+	ClearCache();
 
 	if (m_devices.size() > 1)
 	{
@@ -74,6 +75,7 @@ void VFS::Mount(const std::string& ps3_path, const std::string& local_path, vfsD
 void VFS::Link(const std::string& mount_point, const std::string& ps3_path)
 {
 	links[simplify_path_blocks(mount_point)] = simplify_path_blocks(ps3_path);
+	ClearCache();
 }
 
 std::string VFS::GetLinked(const std::string& ps3_path) const
@@ -115,6 +117,7 @@ void VFS::UnMount(const std::string& ps3_path)
 			delete m_devices[i];
 
 			m_devices.erase(m_devices.begin() +i);
+			ClearCache();
 
 			return;
 		}
@@ -129,6 +132,53 @@ void VFS::UnMountAll()
 	}
 
 	m_devices.clear();
+	ClearCache();
+}
+
+void VFS::ClearCache() const
+{
+	std::lock_guard<std::mutex> lock(m_cache_mutex);
+
+	m_device_cache.clear();
+	m_stat_cache.clear();
+}
+
+bool VFS::GetStat(const std::string& local_path, fs::stat_t& info) const
+{
+	std::lock_guard<std::mutex> lock(m_cache_mutex);
+
+	if (const auto cached = m_stat_cache.find(local_path))
+	{
+		info = cached->second;
+		return cached->first;
+	}
+
+	const bool result = fs::stat(local_path, info);
+
+	m_stat_cache.insert(local_path, { result, info });
+
+	return result;
+}
+
+void VFS::AddStat(const std::string& local_path, const fs::stat_t& info) const
+{
+	std::lock_guard<std::mutex> lock(m_cache_mutex);
+
+	m_stat_cache.insert(local_path, { true, info });
+}
+
+void VFS::InvalidateStat(const std::string& local_path) const
+{
+	std::lock_guard<std::mutex> lock(m_cache_mutex);
+
+	if (local_path.empty())
+	{
+		m_stat_cache.clear();
+	}
+	else
+	{
+		m_stat_cache.erase(local_path);
+	}
 }
 
 vfsFileBase* VFS::OpenFile(const std::string& ps3_path, u32 mode) const
@@ -170,7 +220,9 @@ bool VFS::CreateDir(const std::string& ps3_path) const
 	if (vfsDevice* dev = GetDevice(ps3_path, path))
 	{
 		// return dev->create_dir(path);
-		return fs::create_dir(path);
+		const bool result = fs::create_dir(path);
+		InvalidateStat();
+		return result;
 	}
 
 	return false;
@@ -183,7 +235,9 @@ bool VFS::CreatePath(const std::string& ps3_path) const
 	if (vfsDevice* dev = GetDevice(ps3_path, path))
 	{
 		// return dev->create_path(path);
-		return fs::create_path(path);
+		const bool result = fs::create_path(path);
+		InvalidateStat();
+		return result;
 	}
 
 	return false;
@@ -196,7 +250,9 @@ bool VFS::RemoveFile(const std::string& ps3_path) const
 	if (vfsDevice* dev = GetDevice(ps3_path, path))
 	{
 		// return dev->remove_file(path);
-		return fs::remove_file(path);
+		const bool result = fs::remove_file(path);
+		InvalidateStat();
+		return result;
 	}
 
 	return false;
@@ -209,7 +265,9 @@ bool VFS::RemoveDir(const std::string& ps3_path) const
 	if (vfsDevice* dev = GetDevice(ps3_path, path))
 	{
 		// return dev->remove_dir(path);
-		return fs::remove_dir(path);
+		const bool result = fs::remove_dir(path);
+		InvalidateStat();
+		return result;
 	}
 
 	return false;
@@ -271,7 +329,9 @@ bool VFS::ExistsFile(const std::string& ps3_path) const
 	if (vfsDevice* dev = GetDevice(ps3_path, path))
 	{
 		// return dev->is_file(path);
-		return fs::is_file(path);
+		fs::stat_t info;
+		const bool result = GetStat(path, info);
+		return result && !info.is_directory;
 	}
 
 	return false;
@@ -284,7 +344,9 @@ bool VFS::ExistsDir(const std::string& ps3_path) const
 	if (vfsDevice* dev = GetDevice(ps3_path, path))
 	{
 		// return dev->is_dir(path);
-		return fs::is_dir(path);
+		fs::stat_t info;
+		const bool result = GetStat(path, info);
+		return result && info.is_directory;
 	}
 
 	return false;
@@ -297,7 +359,9 @@ bool VFS::Exists(const std::string& ps3_path) const
 	if (vfsDevice* dev = GetDevice(ps3_path, path))
 	{
 		// return dev->exists(path);
-		return fs::exists(path);
+		fs::stat_t info;
+		const bool result = GetStat(path, info);
+		return result;
 	}
 
 	return false;
@@ -312,7 +376,9 @@ bool VFS::Rename(const std::string& ps3_path_from, const std::string& ps3_path_t
 		if (vfsDevice* dev_ = GetDevice(ps3_path_to, path_to))
 		{
 			// return dev->rename(dev_, path_from, path_to);
-			return fs::rename(path_from, path_to);
+			const bool result = fs::rename(path_from, path_to);
+			InvalidateStat();
+			return result;
 		}
 	}
 
@@ -328,7 +394,9 @@ bool VFS::CopyFile(const std::string& ps3_path_from, const std::string& ps3_path
 		if (vfsDevice* dev_ = GetDevice(ps3_path_to, path_to))
 		{
 			// return dev->copy_file(dev_, path_from, path_to, overwrite);
-			return fs::copy_file(path_from, path_to, overwrite);
+			const bool result = fs::copy_file(path_from, path_to, overwrite);
+			InvalidateStat();
+			return result;
 		}
 	}
 
@@ -342,7 +410,9 @@ bool VFS::TruncateFile(const std::string& ps3_path, u64 length) const
 	if (vfsDevice* dev = GetDevice(ps3_path, path))
 	{
 		// return dev->truncate_file(path, length);
-		return fs::truncate_file(path, length);
+		const bool result = fs::truncate_file(path, length);
+		InvalidateStat();
+		return result;
 	}
 
 	return false;
@@ -350,6 +420,16 @@ bool VFS::TruncateFile(const std::string& ps3_path, u64 length) const
 
 vfsDevice* VFS::GetDevice(const std::string& ps3_path, std::string& path) const
 {
+	{
+		std::lock_guard<std::mutex> lock(m_cache_mutex);
+
+		if (const auto cached = m_device_cache.find(ps3_path))
+		{
+			path = cached->second;
+			return cached->first;
+		}
+	}
+
 	auto try_get_device = [this, &path](const std::string& ps3_path) -> vfsDevice*
 	{
 		std::vector<std::string> ps3_path_blocks = simplify_path_blocks(ps3_path);
@@ -399,7 +479,13 @@ vfsDevice* VFS::GetDevice(const std::string& ps3_path, std::string& path) const
 		return nullptr;
 	}
 
-	return try_get_device(GetLinked(ps3_path));
+	const auto device = try_get_device(GetLinked(ps3_path));
+
+	std::lock_guard<std::mutex> lock(m_cache_mutex);
+
+	m_device_cache.insert(ps3_path, { device, device ? path : std::string{} });
+
+	return device;
 
 	// What is it? cwd is real path, ps3_path is ps3 path, but GetLinked accepts ps3 path
 	//if (auto res = try_get_device(GetLinked(cwd + ps3_path))) 
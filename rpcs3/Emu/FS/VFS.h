@@ -42,6 +42,69 @@ struct VFSManagerEntry
 	}
 };
 
+// Simple LRU cache with string keys (not thread-safe)
+template<typename T> class vfs_lru_cache_t
+{
+	using list_type = std::list<std::pair<std::string, T>>;
+
+	list_type m_list; // most recently used first
+	std::unordered_map<std::string, typename list_type::iterator> m_map;
+	const std::size_t m_max;
+
+public:
+	vfs_lru_cache_t(std::size_t max)
+		: m_max(max)
+	{
+	}
+
+	// Find the value and mark it as recently used (returns nullptr if not found)
+	T* find(const std::string& key)
+	{
+		const auto found = m_map.find(key);
+
+		if (found == m_map.end())
+		{
+			return nullptr;
+		}
+
+		m_list.splice(m_list.begin(), m_list, found->second);
+
+		return &found->second->second;
+	}
+
+	// Add or replace the value (evicts the least recently used value if the cache is full)
+	void insert(const std::string& key, T value)
+	{
+		erase(key);
+
+		m_list.emplace_front(key, std::move(value));
+		m_map.emplace(key, m_list.begin());
+
+		if (m_list.size() > m_max)
+		{
+			m_map.erase(m_list.back().first);
+			m_list.pop_back();
+		}
+	}
+
+	void erase(const std::string& key)
+	{
+		const auto found = m_map.find(key);
+
+		if (found != m_map.end())
+		{
+			m_list.erase(found->second);
+			m_map.erase(found);
+		}
+	}
+
+	void clear()
+	{
+		m_list.clear();
+		m_map.clear();
+	}
+};
+
 std::vector<std::string> simplify_path_blocks(const std::string& path);
 std::string simplify_path(const std::string& path, bool is_dir, bool is_ps3);
 
@@ -68,6 +131,17 @@ struct VFS
 
 	std::map<std::vector<std::string>, std::vector<std::string>, links_sorter> links;
 
+	// Cache of resolved guest paths (device and local path, nullptr device for failed lookups),
+	// cleared when the mount points or links are changed
+	mutable std::mutex m_cache_mutex;
+	mutable vfs_lru_cache_t<std::pair<vfsDevice*, std::string>> m_device_cache{ 4096 };
+
+	// Cache of local path information (false if the path doesn't exist), invalidated by modifications through VFS
+	mutable vfs_lru_cache_t<std::pair<bool, fs::stat_t>> m_stat_cache{ 4096 };
+
+	// Clear the path resolution cache
+	void ClearCache() const;
+
 	void Mount(const std::string& ps3_path, const std::string& local_path, vfsDevice* device);
 	void Link(const std::string& mount_point, const std::string& ps3_path);
 	void UnMount(const std::string& ps3_path);
@@ -90,6 +164,15 @@ struct VFS
 	bool CopyFile(const std::string& ps3_path_from, const std::string& ps3_path_to, bool overwrite = true) const;
 	bool TruncateFile(const std::string& ps3_path, u64 length) const;
 
+	// Get local path information (cached)
+	bool GetStat(const std::string& local_path, fs::stat_t& info) const;
+
+	// Add information of the local path obtained elsewhere (directory listing) to the cache
+	void AddStat(const std::string& local_path, const fs::stat_t& info) const;
+
+	// Invalidate cached information of the local path (or everything if the path is empty)
+	void InvalidateStat(const std::string& local_path = {}) const;
+
 	vfsDevice* GetDevice(const std::string& ps3_path, std::string& path) const;
 	vfsDevice* GetDeviceLocal(const std::string& local_path, std::string& path) const;
 
@@ -46,6 +46,21 @@ u64 vfsFile::Read(void* dst, u64 size)
 	return m_stream->Read(dst, size);
 }
 
+u64 vfsFile::ReadAt(u64 offset, void* dst, u64 size)
+{
+	return m_stream->ReadAt(offset, dst, size);
+}
+
+bool vfsFile::CanReadAt() const
+{
+	return m_stream && m_stream->CanReadAt();
+}
+
+void vfsFile::Prefetch(u64 offset, u64 count)
+{
+	m_stream->Prefetch(offset, count);
+}
+
 u64 vfsFile::Seek(s64 offset, fs::seek_mode whence)
 {
 	return m_stream->Seek(offset, whence);
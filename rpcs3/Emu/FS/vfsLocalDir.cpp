@@ -1,4 +1,6 @@
 #include "stdafx.h"
+#include "Emu/System.h"
+#include "VFS.h"
 #include "vfsDevice.h"
 #include "vfsLocalDir.h"
 
@@ -33,6 +35,12 @@ bool vfsLocalDir::Open(const std::string& path)
 		info.access_time = file_info.atime;
 		info.modify_time = file_info.mtime;
 		info.create_time = file_info.ctime;
+
+		// the whole directory is read at once, so following stat calls for its entries are served from the cache
+		if (name != "." && name != "..")
+		{
+			Emu.GetVFS().AddStat(path + "/" + name, file_info);
+		}
 	}
 
 	return true;
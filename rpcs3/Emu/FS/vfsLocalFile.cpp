@@ -1,4 +1,7 @@
 #include "stdafx.h"
+#include "Emu/System.h"
+#include "Emu/state.h"
+#include "VFS.h"
 #include "vfsLocalFile.h"
 
 vfsLocalFile::vfsLocalFile(vfsDevice* device) : vfsFileBase(device)
@@ -9,38 +12,109 @@ bool vfsLocalFile::Open(const std::string& path, u32 mode)
 {
 	Close();
 
-	return m_file.open(path, mode) && vfsFileBase::Open(path, mode);
+	if (!m_file.open(path, mode) || !vfsFileBase::Open(path, mode))
+	{
+		return false;
+	}
+
+	if (mode & (fom::write | fom::create | fom::trunc))
+	{
+		// the file may be created or modified
+		Emu.GetVFS().InvalidateStat(mode & fom::create ? std::string{} : path);
+	}
+
+	// map read-only files (game data) to avoid syscalls on every read
+	if (mode == fom::read && rpcs3::config.system.map_files.value() && m_file.size() >= rpcs3::config.system.map_files_threshold.value() * 1024ull)
+	{
+		m_map.reset(m_file);
+		m_pos = 0;
+	}
+
+	return true;
 }
 
 void vfsLocalFile::Close()
 {
+	m_map.reset();
 	m_file.close();
 	vfsFileBase::Close();
 }
 
 u64 vfsLocalFile::GetSize() const
 {
-	return m_file.size();
+	return m_map ? m_map.size() : m_file.size();
 }
 
 u64 vfsLocalFile::Write(const void* src, u64 size)
 {
+	Emu.GetVFS().InvalidateStat(m_path);
+
 	return m_file.write(src, size);
 }
 
 u64 vfsLocalFile::Read(void* dst, u64 size)
 {
+	if (m_map)
+	{
+		const u64 result = ReadAt(m_pos, dst, size);
+		m_pos += result;
+		return result;
+	}
+
 	return m_file.read(dst, size);
 }
 
+u64 vfsLocalFile::ReadAt(u64 offset, void* dst, u64 size)
+{
+	if (m_map)
+	{
+		if (offset >= m_map.size())
+		{
+			return 0;
+		}
+
+		const u64 result = std::min<u64>(size, m_map.size() - offset);
+		std::memcpy(dst, m_map + offset, result);
+		return result;
+	}
+
+	return m_file.read_at(offset, dst, size);
+}
+
+bool vfsLocalFile::CanReadAt() const
+{
+	return true;
+}
+
+void vfsLocalFile::Prefetch(u64 offset, u64 count)
+{
+	m_map.prefetch(offset, count);
+}
+
 u64 vfsLocalFile::Seek(s64 offset, fs::seek_mode whence)
 {
+	if (m_map)
+	{
+		const s64 pos =
+			whence == fs::seek_set ? offset :
+			whence == fs::seek_cur ? offset + m_pos :
+			whence == fs::seek_end ? offset + m_map.size() : -1;
+
+		if (pos < 0)
+		{
+			errno = EINVAL;
+			return -1;
+		}
+
+		return m_pos = pos;
+	}
+
 	return m_file.seek(offset, whence);
 }
 
 u64 vfsLocalFile::Tell() const
 {
-	return m_file.seek(0, fs::seek_cur);
+	return m_map ? m_pos : m_file.seek(0, fs::seek_cur);
 }
 
 bool vfsLocalFile::IsOpened() const
@@ -7,6 +7,10 @@ class vfsLocalFile : public vfsFileBase
 private:
 	fs::file m_file;
 
+	// read-only files bigger than the threshold are read from the mapping (with own position)
+	fs::file_read_map m_map;
+	u64 m_pos = 0;
+
 public:
 	vfsLocalFile(vfsDevice* device);
 
@@ -17,6 +21,9 @@ public:
 
 	virtual u64 Write(const void* src, u64 size) override;
 	virtual u64 Read(void* dst, u64 size) override;
+	virtual u64 ReadAt(u64 offset, void* dst, u64 size) override;
+	virtual bool CanReadAt() const override;
+	virtual void Prefetch(u64 offset, u64 count) override;
 
 	virtual u64 Seek(s64 offset, fs::seek_mode whence = fs::seek_set) override;
 	virtual u64 Tell() const override;
@@ -29,6 +29,31 @@ struct vfsStream
 		return Read(&data, count) == count;
 	}
 
+	// Read the data at specified position without changing the current position
+	virtual u64 ReadAt(u64 offset, void* dst, u64 count)
+	{
+		const u64 old_position = Tell();
+
+		CHECK_ASSERTION(Seek(offset) != -1);
+
+		const u64 result = Read(dst, count);
+
+		CHECK_ASSERTION(Seek(old_position) != -1);
+
+		return result;
+	}
+
+	// Check whether ReadAt() may be called concurrently with other operations (default implementation requires external locking)
+	virtual bool CanReadAt() const
+	{
+		return false;
+	}
+
+	// Hint that the specified range will be read soon
+	virtual void Prefetch(u64 offset, u64 count)
+	{
+	}
+
 	virtual u64 Seek(s64 offset, fs::seek_mode whence = fs::seek_set) = 0;
 
 	virtual u64 Tell() const = 0;
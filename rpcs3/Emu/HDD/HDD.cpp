@@ -20,6 +20,8 @@ void vfsHDDManager::CreateEntry(vfsHDD_Entry& entry)
 
 void vfsHDDManager::CreateHDD(const std::string& path, u64 size, u64 block_size)
 {
+	vfsHDD_Cache::Invalidate(path);
+
 	fs::file f(path, fom::rewrite);
 
 	static const u64 cur_dir_block = 1;
@@ -60,6 +62,300 @@ void vfsHDDManager::AppendEntry(vfsHDD_Entry entry)
 {
 }
 
+static std::mutex g_hdd_caches_mutex;
+static std::unordered_map<std::string, std::weak_ptr<vfsHDD_Cache>> g_hdd_caches;
+
+vfsHDD_Cache::vfsHDD_Cache(const std::string& path)
+	: m_file(path, fom::read | fom::write)
+{
+	if (!m_file || m_file.read(&m_info, sizeof(vfsHDD_Hdr)) != sizeof(vfsHDD_Hdr))
+	{
+		LOG_ERROR(HLE, "Failed to open HDD image '%s'", path);
+		memset(&m_info, 0, sizeof(vfsHDD_Hdr));
+	}
+
+	if (!m_info.block_size)
+	{
+		LOG_ERROR(HLE, "Bad block size!");
+		m_info.block_size = 2048;
+	}
+}
+
+vfsHDD_Cache::~vfsHDD_Cache()
+{
+	Flush();
+}
+
+std::shared_ptr<vfsHDD_Cache> vfsHDD_Cache::Get(const std::string& path)
+{
+	std::lock_guard<std::mutex> lock(g_hdd_caches_mutex);
+
+	auto& entry = g_hdd_caches[path];
+
+	if (auto cache = entry.lock())
+	{
+		return cache;
+	}
+
+	auto cache = std::make_shared<vfsHDD_Cache>(path);
+	entry = cache;
+	return cache;
+}
+
+void vfsHDD_Cache::Invalidate(const std::string& path)
+{
+	std::lock_guard<std::mutex> lock(g_hdd_caches_mutex);
+
+	const auto found = g_hdd_caches.find(path);
+
+	if (found == g_hdd_caches.end())
+	{
+		return;
+	}
+
+	if (auto cache = found->second.lock())
+	{
+		std::lock_guard<std::mutex> cache_lock(cache->m_mutex);
+
+		cache->m_blocks.clear();
+		cache->m_used.clear();
+	}
+
+	g_hdd_caches.erase(found);
+}
+
+vfsHDD_Cache::block_t& vfsHDD_Cache::GetBlock(u64 block)
+{
+	const auto found = m_blocks.find(block);
+
+	if (found != m_blocks.end())
+	{
+		found->second.stamp = ++m_stamp;
+		return found->second;
+	}
+
+	if (m_blocks.size() + read_ahead > max_blocks)
+	{
+		Evict();
+	}
+
+	// Read the following blocks which aren't cached with the same request
+	u32 count = 1;
+
+	while (count < read_ahead && block + count < m_info.block_count && !m_blocks.count(block + count))
+	{
+		count++;
+	}
+
+	std::vector<u8> buf(count * m_info.block_size); // the end of the image reads as zeros
+
+	m_file.read_at(block * m_info.block_size, buf.data(), buf.size());
+
+	for (u32 i = 0; i < count; i++)
+	{
+		auto& entry = m_blocks[block + i];
+		entry.data.reset(new u8[m_info.block_size]);
+		entry.dirty = false;
+		entry.stamp = m_stamp;
+		memcpy(entry.data.get(), buf.data() + i * m_info.block_size, m_info.block_size);
+	}
+
+	auto& result = m_blocks[block];
+	result.stamp = ++m_stamp;
+	return result;
+}
+
+void vfsHDD_Cache::WriteBack(std::vector<u64> blocks)
+{
+	std::sort(blocks.begin(), blocks.end());
+
+	std::vector<u8> buf;
+
+	// Write each run of contiguous blocks at once
+	for (std::size_t i = 0, end; i < blocks.size(); i = end)
+	{
+		for (end = i + 1; end < blocks.size() && blocks[end] == blocks[end - 1] + 1; end++)
+		{
+		}
+
+		buf.resize((end - i) * m_info.block_size);
+
+		for (std::size_t j = i; j < end; j++)
+		{
+			auto& entry = m_blocks.at(blocks[j]);
+			memcpy(buf.data() + (j - i) * m_info.block_size, entry.data.get(), m_info.block_size);
+			entry.dirty = false;
+		}
+
+		CHECK_ASSERTION(m_file.seek(blocks[i] * m_info.block_size) != -1);
+
+		if (m_file.write(buf.data(), buf.size()) != buf.size())
+		{
+			LOG_ERROR(HLE, "Failed to write %llu HDD blocks at 0x%llx", (u64)(end - i), blocks[i]);
+		}
+	}
+}
+
+void vfsHDD_Cache::Evict()
+{
+	// Drop the least recently used half
+	std::vector<std::pair<u64, u64>> stamps;
+
+	for (auto& entry : m_blocks)
+	{
+		stamps.emplace_back(entry.second.stamp, entry.first);
+	}
+
+	const auto middle = stamps.begin() + stamps.size() / 2;
+
+	std::nth_element(stamps.begin(), middle, stamps.end());
+
+	std::vector<u64> dirty;
+
+	for (auto it = stamps.begin(); it != middle; it++)
+	{
+		if (m_blocks.at(it->second).dirty)
+		{
+			dirty.push_back(it->second);
+		}
+	}
+
+	WriteBack(std::move(dirty));
+
+	for (auto it = stamps.begin(); it != middle; it++)
+	{
+		m_blocks.erase(it->second);
+	}
+}
+
+void vfsHDD_Cache::BuildBitmap()
+{
+	m_used.assign((m_info.block_count + 63) / 64, 0);
+
+	// Scan the block headers on disk in large chunks, then apply the modified blocks
+	const u64 chunk = 256;
+
+	std::vector<u8> buf(chunk * m_info.block_size);
+
+	for (u64 first = 0; first < m_info.block_count; first += chunk)
+	{
+		const u64 count = std::min<u64>(chunk, m_info.block_count - first);
+
+		std::fill(buf.begin(), buf.end(), 0);
+		m_file.read_at(first * m_info.block_size, buf.data(), count * m_info.block_size);
+
+		for (u64 i = 0; i < count; i++)
+		{
+			vfsHDD_Block header;
+			memcpy(&header, buf.data() + i * m_info.block_size, sizeof(vfsHDD_Block));
+
+			if (header.is_used)
+			{
+				m_used[(first + i) / 64] |= 1ull << ((first + i) % 64);
+			}
+		}
+	}
+
+	for (auto& entry : m_blocks)
+	{
+		vfsHDD_Block header;
+		memcpy(&header, entry.second.data.get(), sizeof(vfsHDD_Block));
+
+		if (entry.first < m_info.block_count)
+		{
+			const u64 bit = 1ull << (entry.first % 64);
+			m_used[entry.first / 64] = header.is_used ? m_used[entry.first / 64] | bit : m_used[entry.first / 64] & ~bit;
+		}
+	}
+
+	// Block 0 holds the HDD header
+	if (m_info.block_count)
+	{
+		m_used[0] |= 1;
+	}
+}
+
+void vfsHDD_Cache::Read(u64 block, u32 offset, void* dst, u32 size)
+{
+	CHECK_ASSERTION(offset + size <= m_info.block_size);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	memcpy(dst, GetBlock(block).data.get() + offset, size);
+}
+
+void vfsHDD_Cache::Write(u64 block, u32 offset, const void* src, u32 size)
+{
+	CHECK_ASSERTION(offset + size <= m_info.block_size);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto& entry = GetBlock(block);
+
+	memcpy(entry.data.get() + offset, src, size);
+	entry.dirty = true;
+
+	// Keep the bitmap up to date when the header is written
+	if (offset < sizeof(vfsHDD_Block) && !m_used.empty() && block < m_info.block_count)
+	{
+		vfsHDD_Block header;
+		memcpy(&header, entry.data.get(), sizeof(vfsHDD_Block));
+
+		const u64 bit = 1ull << (block % 64);
+		m_used[block / 64] = header.is_used ? m_used[block / 64] | bit : m_used[block / 64] & ~bit;
+	}
+}
+
+u64 vfsHDD_Cache::FindFreeBlock()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_used.empty())
+	{
+		BuildBitmap();
+	}
+
+	// Search from the last allocation, then from the start
+	for (u64 pass = 0, start = m_next_free / 64; pass < 2; pass++, start = 0)
+	{
+		for (u64 i = start; i < m_used.size(); i++)
+		{
+			if (~m_used[i])
+			{
+				for (u64 bit = 0; bit < 64; bit++)
+				{
+					const u64 block = i * 64 + bit;
+
+					if (block < m_info.block_count && (m_used[i] & (1ull << bit)) == 0)
+					{
+						m_next_free = block + 1;
+						return block;
+					}
+				}
+			}
+		}
+	}
+
+	return 0;
+}
+
+void vfsHDD_Cache::Flush()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	std::vector<u64> dirty;
+
+	for (auto& entry : m_blocks)
+	{
+		if (entry.second.dirty)
+		{
+			dirty.push_back(entry.first);
+		}
+	}
+
+	WriteBack(std::move(dirty));
+}
+
 bool vfsHDDFile::goto_block(u64 n)
 {
 	vfsHDD_Block block_info;
@@ -69,7 +365,7 @@ bool vfsHDDFile::goto_block(u64 n)
 		return false;
 	}
 
-	CHECK_ASSERTION(m_hdd.Seek(m_info.data_block * m_hdd_info.block_size) != -1);
+	ReadBlock(m_info.data_block, block_info);
 
 	block_info.next_block = m_info.data_block;
 
@@ -80,9 +376,7 @@ bool vfsHDDFile::goto_block(u64 n)
 			return false;
 		}
 
-		CHECK_ASSERTION(m_hdd.Seek(block_info.next_block * m_hdd_info.block_size) != -1);
-
-		m_hdd.Read(&block_info, sizeof(vfsHDD_Block));
+		ReadBlock(block_info.next_block, block_info);
 	}
 
 	return true;
@@ -91,68 +385,55 @@ bool vfsHDDFile::goto_block(u64 n)
 void vfsHDDFile::RemoveBlocks(u64 start_block)
 {
 	vfsHDD_Block block_info;
+	block_info.is_used = true;
 	block_info.next_block = start_block;
 
 	while (block_info.next_block && block_info.is_used)
 	{
-		u64 offset = block_info.next_block * m_hdd_info.block_size;
+		u64 block = block_info.next_block;
 
-		ReadBlock(offset, block_info);
-		WriteBlock(offset, g_null_block);
+		ReadBlock(block, block_info);
+		WriteBlock(block, g_null_block);
 	}
 }
 
 void vfsHDDFile::WriteBlock(u64 block, const vfsHDD_Block& data)
 {
-	CHECK_ASSERTION(m_hdd.Seek(block * m_hdd_info.block_size) != -1);
-	
-	m_hdd.Write(&data, sizeof(vfsHDD_Block));
+	m_hdd.Write(block, 0, &data, sizeof(vfsHDD_Block));
 }
 
 void vfsHDDFile::ReadBlock(u64 block, vfsHDD_Block& data)
 {
-	CHECK_ASSERTION(m_hdd.Seek(block * m_hdd_info.block_size) != -1);
-	
-	m_hdd.Read(&data, sizeof(vfsHDD_Block));
+	m_hdd.Read(block, 0, &data, sizeof(vfsHDD_Block));
 }
 
 void vfsHDDFile::WriteEntry(u64 block, const vfsHDD_Entry& data)
 {
-	CHECK_ASSERTION(m_hdd.Seek(block * m_hdd_info.block_size) != -1);
-	
-	m_hdd.Write(&data, sizeof(vfsHDD_Entry));
+	m_hdd.Write(block, 0, &data, sizeof(vfsHDD_Entry));
 }
 
 void vfsHDDFile::ReadEntry(u64 block, vfsHDD_Entry& data)
 {
-	CHECK_ASSERTION(m_hdd.Seek(block * m_hdd_info.block_size) != -1);
-	
-	m_hdd.Read(&data, sizeof(vfsHDD_Entry));
+	m_hdd.Read(block, 0, &data, sizeof(vfsHDD_Entry));
 }
 
 void vfsHDDFile::ReadEntry(u64 block, vfsHDD_Entry& data, std::string& name)
 {
-	CHECK_ASSERTION(m_hdd.Seek(block * m_hdd_info.block_size) != -1);
-	
-	m_hdd.Read(&data, sizeof(vfsHDD_Entry));
+	m_hdd.Read(block, 0, &data, sizeof(vfsHDD_Entry));
 	name.resize(GetMaxNameLen());
-	m_hdd.Read(&name.front(), GetMaxNameLen());
+	m_hdd.Read(block, sizeof(vfsHDD_Entry), &name.front(), GetMaxNameLen());
 }
 
 void vfsHDDFile::ReadEntry(u64 block, std::string& name)
 {
-	CHECK_ASSERTION(m_hdd.Seek(block * m_hdd_info.block_size + sizeof(vfsHDD_Entry)) != -1);
-	
 	name.resize(GetMaxNameLen());
-	m_hdd.Read(&name.front(), GetMaxNameLen());
+	m_hdd.Read(block, sizeof(vfsHDD_Entry), &name.front(), GetMaxNameLen());
 }
 
 void vfsHDDFile::WriteEntry(u64 block, const vfsHDD_Entry& data, const std::string& name)
 {
-	CHECK_ASSERTION(m_hdd.Seek(block * m_hdd_info.block_size) != -1);
-	
-	m_hdd.Write(&data, sizeof(vfsHDD_Entry));
-	m_hdd.Write(name.c_str(), std::min<size_t>(GetMaxNameLen() - 1, name.length() + 1));
+	m_hdd.Write(block, 0, &data, sizeof(vfsHDD_Entry));
+	m_hdd.Write(block, sizeof(vfsHDD_Entry), name.c_str(), static_cast<u32>(std::min<size_t>(GetMaxNameLen() - 1, name.length() + 1)));
 }
 
 void vfsHDDFile::Open(u64 info_block)
@@ -165,19 +446,7 @@ void vfsHDDFile::Open(u64 info_block)
 
 u64 vfsHDDFile::FindFreeBlock()
 {
-	vfsHDD_Block block_info;
-
-	for (u64 i = 0; i < m_hdd_info.block_count; ++i)
-	{
-		ReadBlock(i, block_info);
-
-		if (!block_info.is_used)
-		{
-			return i;
-		}
-	}
-
-	return 0;
+	return m_hdd.FindFreeBlock();
 }
 
 bool vfsHDDFile::Seek(u64 pos)
@@ -193,11 +462,7 @@ bool vfsHDDFile::Seek(u64 pos)
 
 void vfsHDDFile::SaveInfo()
 {
-	CHECK_ASSERTION(m_hdd.Seek(m_info_block * m_hdd_info.block_size) != -1);
-
-	CHECK_ASSERTION(m_hdd.Seek(m_info_block * m_hdd_info.block_size) != -1);
-
-	m_hdd.Write(&m_info, sizeof(vfsHDD_Entry));
+	m_hdd.Write(m_info_block, 0, &m_info, sizeof(vfsHDD_Entry));
 }
 
 u64 vfsHDDFile::Read(void* dst, u64 size)
@@ -205,20 +470,14 @@ u64 vfsHDDFile::Read(void* dst, u64 size)
 	if (!size)
 		return 0;
 
-	//vfsDeviceLocker lock(m_hdd);
-
 	const u32 block_size = m_hdd_info.block_size - sizeof(vfsHDD_Block);
 	u64 rsize = std::min<u64>(block_size - m_position, size);
 
 	vfsHDD_Block cur_block_info;
-	
-	CHECK_ASSERTION(m_hdd.Seek(m_cur_block * m_hdd_info.block_size) != -1);
 
-	m_hdd.Read(&cur_block_info, sizeof(vfsHDD_Block));
-	
-	CHECK_ASSERTION(m_hdd.Seek(m_cur_block * m_hdd_info.block_size + sizeof(vfsHDD_Block) + m_position) != -1);
+	ReadBlock(m_cur_block, cur_block_info);
 
-	m_hdd.Read(dst, rsize);
+	m_hdd.Read(m_cur_block, sizeof(vfsHDD_Block) + m_position, dst, static_cast<u32>(rsize));
 	size -= rsize;
 	m_position += rsize;
 	if (!size)
@@ -238,14 +497,9 @@ u64 vfsHDDFile::Read(void* dst, u64 size)
 		m_cur_block = cur_block_info.next_block;
 		rsize = std::min<u64>(block_size, size);
 
-		CHECK_ASSERTION(m_hdd.Seek(cur_block_info.next_block * m_hdd_info.block_size) != -1);
-
-		m_hdd.Read(&cur_block_info, sizeof(vfsHDD_Block));
+		ReadBlock(m_cur_block, cur_block_info);
 
-		if (m_hdd.Read((u8*)dst + offset, rsize) != rsize)
-		{
-			return offset;
-		}
+		m_hdd.Read(m_cur_block, sizeof(vfsHDD_Block), (u8*)dst + offset, static_cast<u32>(rsize));
 	}
 
 	m_position = rsize;
@@ -258,8 +512,6 @@ u64 vfsHDDFile::Write(const void* src, u64 size)
 	if (!size)
 		return 0;
 
-	//vfsDeviceLocker lock(m_hdd);
-
 	const u32 block_size = m_hdd_info.block_size - sizeof(vfsHDD_Block);
 
 	if (!m_cur_block)
@@ -290,9 +542,7 @@ u64 vfsHDDFile::Write(const void* src, u64 size)
 
 	if (wsize)
 	{
-		CHECK_ASSERTION(m_hdd.Seek(m_cur_block * m_hdd_info.block_size + sizeof(vfsHDD_Block) + m_position) != -1);
-
-		m_hdd.Write(src, wsize);
+		m_hdd.Write(m_cur_block, sizeof(vfsHDD_Block) + m_position, src, static_cast<u32>(wsize));
 		size -= wsize;
 		m_info.size += wsize;
 		m_position += wsize;
@@ -320,34 +570,14 @@ u64 vfsHDDFile::Write(const void* src, u64 size)
 		m_cur_block = new_block;
 		wsize = std::min<u64>(block_size, size);
 
+		// Link the new block, then write it (blocks are written back to the image in contiguous runs)
 		block_info.next_block = m_cur_block;
-		
-		CHECK_ASSERTION(m_hdd.Seek(last_block * m_hdd_info.block_size) != -1);
-
-		if (m_hdd.Write(&block_info, sizeof(vfsHDD_Block)) != sizeof(vfsHDD_Block))
-		{
-			m_position = 0;
-			SaveInfo();
-			return offset;
-		}
+		WriteBlock(last_block, block_info);
 
 		block_info.next_block = 0;
+		WriteBlock(m_cur_block, block_info);
 
-		CHECK_ASSERTION(m_hdd.Seek(m_cur_block * m_hdd_info.block_size) != -1);
-
-		if (m_hdd.Write(&block_info, sizeof(vfsHDD_Block)) != sizeof(vfsHDD_Block))
-		{
-			m_position = 0;
-			SaveInfo();
-			return offset;
-		}
-
-		if ((m_position = m_hdd.Write((u8*)src + offset, wsize)) != wsize)
-		{
-			m_info.size += wsize;
-			SaveInfo();
-			return offset;
-		}
+		m_hdd.Write(m_cur_block, sizeof(vfsHDD_Block), (u8*)src + offset, static_cast<u32>(wsize));
 
 		last_block = m_cur_block;
 	}
@@ -372,23 +602,15 @@ vfsDirBase* vfsDeviceHDD::GetNewDirStream()
 }
 
 vfsHDD::vfsHDD(vfsDevice* device, const std::string& hdd_path)
-	: m_hdd_file(device)
-	, m_file(m_hdd_file, m_hdd_info)
+	: m_cache(vfsHDD_Cache::Get(hdd_path))
+	, m_file(*m_cache, m_hdd_info)
 	, m_hdd_path(hdd_path)
 	, vfsFileBase(device)
 {
-	m_hdd_file.Open(hdd_path, fom::read | fom::write);
-	m_hdd_file.Read(&m_hdd_info, sizeof(vfsHDD_Hdr));
+	m_hdd_info = m_cache->GetInfo();
 	m_cur_dir_block = m_hdd_info.next_block;
-	if (!m_hdd_info.block_size)
-	{
-		LOG_ERROR(HLE, "Bad block size!");
-		m_hdd_info.block_size = 2048;
-	}
 
-	CHECK_ASSERTION(m_hdd_file.Seek(m_cur_dir_block * m_hdd_info.block_size) != -1);
-	
-	m_hdd_file.Read(&m_cur_dir, sizeof(vfsHDD_Entry));
+	ReadEntry(m_cur_dir_block, m_cur_dir);
 }
 
 bool vfsHDD::SearchEntry(const std::string& name, u64& entry_block, u64* parent_block)
@@ -428,10 +650,8 @@ s32 vfsHDD::OpenDir(const std::string& name)
 		return -1;
 	}
 
-	CHECK_ASSERTION(m_hdd_file.Seek(entry_block * m_hdd_info.block_size) != -1);
-	
 	vfsHDD_Entry entry;
-	m_hdd_file.Read(&entry, sizeof(vfsHDD_Entry));
+	ReadEntry(entry_block, entry);
 
 	if (entry.type == vfsHDD_Entry_File)
 	{
@@ -461,72 +681,46 @@ bool vfsHDD::Rename(const std::string& from, const std::string& to)
 
 u64 vfsHDD::FindFreeBlock()
 {
-	vfsHDD_Block block_info;
-
-	for (u64 i = 0; i < m_hdd_info.block_count; ++i)
-	{
-		ReadBlock(i, block_info);
-
-		if (!block_info.is_used)
-		{
-			return i;
-		}
-	}
-
-	return 0;
+	return m_cache->FindFreeBlock();
 }
 
 void vfsHDD::WriteBlock(u64 block, const vfsHDD_Block& data)
 {
-	CHECK_ASSERTION(m_hdd_file.Seek(block * m_hdd_info.block_size) != -1);
-	
-	m_hdd_file.Write(&data, sizeof(vfsHDD_Block));
+	m_cache->Write(block, 0, &data, sizeof(vfsHDD_Block));
 }
 
 void vfsHDD::ReadBlock(u64 block, vfsHDD_Block& data)
 {
-	CHECK_ASSERTION(m_hdd_file.Seek(block * m_hdd_info.block_size) != -1);
-	
-	m_hdd_file.Read(&data, sizeof(vfsHDD_Block));
+	m_cache->Read(block, 0, &data, sizeof(vfsHDD_Block));
 }
 
 void vfsHDD::WriteEntry(u64 block, const vfsHDD_Entry& data)
 {
-	CHECK_ASSERTION(m_hdd_file.Seek(block * m_hdd_info.block_size) != -1);
-	
-	m_hdd_file.Write(&data, sizeof(vfsHDD_Entry));
+	m_cache->Write(block, 0, &data, sizeof(vfsHDD_Entry));
 }
 
 void vfsHDD::ReadEntry(u64 block, vfsHDD_Entry& data)
 {
-	CHECK_ASSERTION(m_hdd_file.Seek(block * m_hdd_info.block_size) != -1);
-
-	m_hdd_file.Read(&data, sizeof(vfsHDD_Entry));
+	m_cache->Read(block, 0, &data, sizeof(vfsHDD_Entry));
 }
 
 void vfsHDD::ReadEntry(u64 block, vfsHDD_Entry& data, std::string& name)
 {
-	CHECK_ASSERTION(m_hdd_file.Seek(block * m_hdd_info.block_size) != -1);
-
-	m_hdd_file.Read(&data, sizeof(vfsHDD_Entry));
+	m_cache->Read(block, 0, &data, sizeof(vfsHDD_Entry));
 	name.resize(GetMaxNameLen());
-	m_hdd_file.Read(&name.front(), GetMaxNameLen());
+	m_cache->Read(block, sizeof(vfsHDD_Entry), &name.front(), GetMaxNameLen());
 }
 
 void vfsHDD::ReadEntry(u64 block, std::string& name)
 {
-	CHECK_ASSERTION(m_hdd_file.Seek(block * m_hdd_info.block_size + sizeof(vfsHDD_Entry)) != -1);
-	
 	name.resize(GetMaxNameLen());
-	m_hdd_file.Read(&name.front(), GetMaxNameLen());
+	m_cache->Read(block, sizeof(vfsHDD_Entry), &name.front(), GetMaxNameLen());
 }
 
 void vfsHDD::WriteEntry(u64 block, const vfsHDD_Entry& data, const std::string& name)
 {
-	CHECK_ASSERTION(m_hdd_file.Seek(block * m_hdd_info.block_size) != -1);
-	
-	m_hdd_file.Write(&data, sizeof(vfsHDD_Entry));
-	m_hdd_file.Write(name.c_str(), std::min<size_t>(GetMaxNameLen() - 1, name.length() + 1));
+	m_cache->Write(block, 0, &data, sizeof(vfsHDD_Entry));
+	m_cache->Write(block, sizeof(vfsHDD_Entry), name.c_str(), static_cast<u32>(std::min<size_t>(GetMaxNameLen() - 1, name.length() + 1)));
 }
 
 bool vfsHDD::Create(vfsHDD_EntryType type, const std::string& name)
@@ -814,6 +1008,13 @@ bool vfsHDD::IsOpened() const
 	return true; // ???
 }
 
+void vfsHDD::Close()
+{
+	m_cache->Flush();
+
+	vfsFileBase::Close();
+}
+
 u64 vfsHDD::GetSize() const
 {
 	return m_file.GetSize();
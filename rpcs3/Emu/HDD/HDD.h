@@ -55,12 +55,73 @@ public:
 };
 
 
+// Block cache of an HDD image, shared by all streams opened on it.
+// Written blocks are kept until flushed or evicted, then written in contiguous runs; a miss reads the following blocks
+// too (files are allocated mostly contiguously). Free blocks are found in a bitmap, built on the first allocation and
+// updated by every write of a block header.
+class vfsHDD_Cache
+{
+	struct block_t
+	{
+		std::unique_ptr<u8[]> data;
+		bool dirty;
+		u64 stamp; // last access
+	};
+
+	std::mutex m_mutex;
+	fs::file m_file;
+	vfsHDD_Hdr m_info;
+	std::unordered_map<u64, block_t> m_blocks;
+	std::vector<u64> m_used; // bit set = used block (empty if not built yet)
+	u64 m_next_free = 0; // allocation hint
+	u64 m_stamp = 0;
+
+	static const u32 max_blocks = 4096; // cached blocks (8 MB with the default block size)
+	static const u32 read_ahead = 32; // blocks read at once on a miss
+
+	block_t& GetBlock(u64 block);
+
+	void WriteBack(std::vector<u64> blocks);
+
+	void Evict();
+
+	void BuildBitmap();
+
+public:
+	vfsHDD_Cache(const std::string& path);
+
+	~vfsHDD_Cache();
+
+	// Get the cache of the HDD image (opens it if necessary)
+	static std::shared_ptr<vfsHDD_Cache> Get(const std::string& path);
+
+	// Discard the cached blocks of the HDD image without writing them (the image is recreated)
+	static void Invalidate(const std::string& path);
+
+	// Get the HDD header (the block size is always valid)
+	const vfsHDD_Hdr& GetInfo() const
+	{
+		return m_info;
+	}
+
+	// Read or write data in a block (offset + size must not exceed the block size)
+	void Read(u64 block, u32 offset, void* dst, u32 size);
+
+	void Write(u64 block, u32 offset, const void* src, u32 size);
+
+	// Find an unused block (0 if the HDD is full)
+	u64 FindFreeBlock();
+
+	// Write all modified blocks
+	void Flush();
+};
+
 class vfsHDDFile
 {
 	u64 m_info_block;
 	vfsHDD_Entry m_info;
 	const vfsHDD_Hdr& m_hdd_info;
-	vfsLocalFile& m_hdd;
+	vfsHDD_Cache& m_hdd;
 	u32 m_position;
 	u64 m_cur_block;
 
@@ -88,7 +149,7 @@ class vfsHDDFile
 	}
 
 public:
-	vfsHDDFile(vfsLocalFile& hdd, const vfsHDD_Hdr& hdd_info)
+	vfsHDDFile(vfsHDD_Cache& hdd, const vfsHDD_Hdr& hdd_info)
 		: m_hdd(hdd)
 		, m_hdd_info(hdd_info)
 	{
@@ -140,7 +201,7 @@ public:
 class vfsHDD : public vfsFileBase
 {
 	vfsHDD_Hdr m_hdd_info;
-	vfsLocalFile m_hdd_file;
+	std::shared_ptr<vfsHDD_Cache> m_cache;
 	const std::string& m_hdd_path;
 	vfsHDD_Entry m_cur_dir;
 	u64 m_cur_dir_block;
@@ -204,5 +265,7 @@ public:
 
 	virtual bool IsOpened() const override;
 
+	virtual void Close() override;
+
 	virtual u64 GetSize() const override;
 };
@@ -3,9 +3,9 @@
 
 namespace idm
 {
-	shared_mutex g_mutex;
+	std::mutex g_id_mutex;
 
-	idm::map_t g_map;
+	std::array<shard_t, shard_count> g_shards;
 
 	u32 g_last_raw_id = 0;
 
@@ -14,19 +14,22 @@ namespace idm
 
 namespace fxm
 {
-	shared_mutex g_mutex;
-
-	fxm::map_t g_map;
+	std::array<shard_t, shard_count> g_shards;
 }
 
 void idm::clear()
 {
-	std::lock_guard<shared_mutex> lock(g_mutex);
+	std::lock_guard<std::mutex> lock(g_id_mutex);
 
-	// Call recorded finalization functions for all IDs
-	for (auto& id : idm::map_t(std::move(g_map)))
+	for (auto& shard : g_shards)
 	{
-		(*id.second.type_index)(id.second.data.get());
+		std::lock_guard<shared_mutex> shard_lock(shard.mutex);
+
+		// Call recorded finalization functions for all IDs
+		for (auto& id : idm::map_t(std::move(shard.map)))
+		{
+			(*id.second.type_index)(id.second.data.get());
+		}
 	}
 
 	g_last_raw_id = 0;
@@ -34,29 +37,35 @@ void idm::clear()
 
 bool idm::check(u32 in_id, id_type_index_t type)
 {
-	reader_lock lock(g_mutex);
+	auto& shard = get_shard(in_id);
+
+	reader_lock lock(shard.mutex);
 
-	const auto found = g_map.find(in_id);
+	const auto found = shard.map.find(in_id);
 
-	return found != g_map.end() && found->second.type_index == type;
+	return found != shard.map.end() && found->second.type_index == type;
 }
 
 const std::type_info* idm::get_type(u32 raw_id)
 {
-	reader_lock lock(g_mutex);
+	auto& shard = get_shard(raw_id);
 
-	const auto found = g_map.find(raw_id);
+	reader_lock lock(shard.mutex);
 
-	return found == g_map.end() ? nullptr : found->second.info;
+	const auto found = shard.map.find(raw_id);
+
+	return found == shard.map.end() ? nullptr : found->second.info;
 }
 
 std::shared_ptr<void> idm::get(u32 in_id, id_type_index_t type)
 {
-	reader_lock lock(g_mutex);
+	auto& shard = get_shard(in_id);
+
+	reader_lock lock(shard.mutex);
 
-	const auto found = g_map.find(in_id);
+	const auto found = shard.map.find(in_id);
 
-	if (found == g_map.end() || found->second.type_index != type)
+	if (found == shard.map.end() || found->second.type_index != type)
 	{
 		return nullptr;
 	}
@@ -66,15 +75,18 @@ std::shared_ptr<void> idm::get(u32 in_id, id_type_index_t type)
 
 idm::map_t idm::get_all(id_type_index_t type)
 {
-	reader_lock lock(g_mutex);
-
 	idm::map_t result;
 
-	for (auto& id : g_map)
+	for (auto& shard : g_shards)
 	{
-		if (id.second.type_index == type)
+		reader_lock lock(shard.mutex);
+
+		for (auto& id : shard.map)
 		{
-			result.insert(id);
+			if (id.second.type_index == type)
+			{
+				result.insert(id);
+			}
 		}
 	}
 
@@ -83,33 +95,38 @@ idm::map_t idm::get_all(id_type_index_t type)
 
 std::shared_ptr<void> idm::withdraw(u32 in_id, id_type_index_t type)
 {
-	std::lock_guard<shared_mutex> lock(g_mutex);
+	auto& shard = get_shard(in_id);
+
+	std::lock_guard<shared_mutex> lock(shard.mutex);
 
-	const auto found = g_map.find(in_id);
+	const auto found = shard.map.find(in_id);
 
-	if (found == g_map.end() || found->second.type_index != type)
+	if (found == shard.map.end() || found->second.type_index != type)
 	{
 		return nullptr;
 	}
 
 	auto ptr = std::move(found->second.data);
 
-	g_map.erase(found);
+	shard.map.erase(found);
 
 	return ptr;
 }
 
 u32 idm::get_count(id_type_index_t type)
 {
-	reader_lock lock(g_mutex);
-
 	u32 result = 0;
 
-	for (auto& id : g_map)
+	for (auto& shard : g_shards)
 	{
-		if (id.second.type_index == type)
+		reader_lock lock(shard.mutex);
+
+		for (auto& id : shard.map)
 		{
-			result++;
+			if (id.second.type_index == type)
+			{
+				result++;
+			}
 		}
 	}
 
@@ -119,38 +136,47 @@ u32 idm::get_count(id_type_index_t type)
 
 void fxm::clear()
 {
-	std::lock_guard<shared_mutex> lock(g_mutex);
-
-	// Call recorded finalization functions for all IDs
-	for (auto& id : fxm::map_t(std::move(g_map)))
+	for (auto& shard : g_shards)
 	{
-		if (id.second) (*id.first)(id.second.get());
+		std::lock_guard<shared_mutex> lock(shard.mutex);
+
+		// Call recorded finalization functions for all IDs
+		for (auto& id : fxm::map_t(std::move(shard.map)))
+		{
+			if (id.second) (*id.first)(id.second.get());
+		}
 	}
 }
 
 bool fxm::check(id_type_index_t type)
 {
-	reader_lock lock(g_mutex);
+	auto& shard = get_shard(type);
+
+	reader_lock lock(shard.mutex);
 
-	const auto found = g_map.find(type);
+	const auto found = shard.map.find(type);
 
-	return found != g_map.end() && found->second;
+	return found != shard.map.end() && found->second;
 }
 
 std::shared_ptr<void> fxm::get(id_type_index_t type)
 {
-	reader_lock lock(g_mutex);
+	auto& shard = get_shard(type);
 
-	const auto found = g_map.find(type);
+	reader_lock lock(shard.mutex);
 
-	return found != g_map.end() ? found->second : nullptr;
+	const auto found = shard.map.find(type);
+
+	return found != shard.map.end() ? found->second : nullptr;
 }
 
 std::shared_ptr<void> fxm::withdraw(id_type_index_t type)
 {
-	std::unique_lock<shared_mutex> lock(g_mutex);
+	auto& shard = get_shard(type);
+
+	std::unique_lock<shared_mutex> lock(shard.mutex);
 
-	const auto found = g_map.find(type);
+	const auto found = shard.map.find(type);
 
-	return found != g_map.end() ? std::move(found->second) : nullptr;
+	return found != shard.map.end() ? std::move(found->second) : nullptr;
 }
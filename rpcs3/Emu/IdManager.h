@@ -92,6 +92,23 @@ namespace idm
 
 	using map_t = std::unordered_map<u32, id_data_t, id_hash_t>;
 
+	// IDs are spread over several independently locked maps, so lookups of unrelated IDs don't contend on a single lock
+	struct alignas(64) shard_t final
+	{
+		shared_mutex mutex;
+		map_t map;
+	};
+
+	static constexpr u32 shard_count = 64;
+
+	// Get the shard containing the mapped id (consecutive IDs land in different shards)
+	inline shard_t& get_shard(u32 raw_id)
+	{
+		extern std::array<shard_t, shard_count> g_shards;
+
+		return g_shards[raw_id % shard_count];
+	}
+
 	// Can be called from the constructor called through make() or make_ptr() to get the ID of the object being created
 	inline u32 get_last_id()
 	{
@@ -120,22 +137,33 @@ namespace idm
 	template<typename T, typename Ptr>
 	std::shared_ptr<T> add(Ptr&& get_ptr)
 	{
-		extern shared_mutex g_mutex;
-		extern idm::map_t g_map;
+		extern std::mutex g_id_mutex;
 		extern u32 g_last_raw_id;
 		extern thread_local u32 g_tls_last_id;
 
-		std::lock_guard<shared_mutex> lock(g_mutex);
+		// Serialize ID allocation only, readers of the shards are not blocked while the object is created
+		std::lock_guard<std::mutex> lock(g_id_mutex);
 
 		for (u32 raw_id = g_last_raw_id; (raw_id = id_traits<T>::next_id(raw_id)); /**/)
 		{
-			if (g_map.find(raw_id) != g_map.end()) continue;
+			auto& shard = get_shard(raw_id);
+
+			// Only add() inserts IDs and it holds g_id_mutex, so a free ID remains free until it's emplaced below
+			{
+				reader_lock rlock(shard.mutex);
+
+				if (shard.map.find(raw_id) != shard.map.end()) continue;
+			}
 
 			g_tls_last_id = id_traits<T>::out_id(raw_id);
 
 			std::shared_ptr<T> ptr = get_ptr();
 
-			g_map.emplace(raw_id, id_data_t(ptr));
+			{
+				std::lock_guard<shared_mutex> wlock(shard.mutex);
+
+				shard.map.emplace(raw_id, id_data_t(ptr));
+			}
 
 			if (raw_id < 0x80000000) g_last_raw_id = raw_id;
 
@@ -296,6 +324,22 @@ namespace fxm
 
 	using map_t = std::unordered_map<id_type_index_t, std::shared_ptr<void>, hash_t>;
 
+	// Objects are spread over several independently locked maps by type
+	struct alignas(64) shard_t final
+	{
+		shared_mutex mutex;
+		map_t map;
+	};
+
+	static constexpr u32 shard_count = 16;
+
+	inline shard_t& get_shard(id_type_index_t type)
+	{
+		extern std::array<shard_t, shard_count> g_shards;
+
+		return g_shards[hash_t{}(type) % shard_count];
+	}
+
 	// Remove all objects
 	void clear();
 
@@ -303,12 +347,11 @@ namespace fxm
 	template<typename T, bool Always, typename Ptr>
 	std::pair<std::shared_ptr<T>, std::shared_ptr<T>> add(Ptr&& get_ptr)
 	{
-		extern shared_mutex g_mutex;
-		extern fxm::map_t g_map;
+		auto& shard = get_shard(get_id_type_index<T>());
 
-		std::lock_guard<shared_mutex> lock(g_mutex);
+		std::lock_guard<shared_mutex> lock(shard.mutex);
 
-		auto& item = g_map[get_id_type_index<T>()];
+		auto& item = shard.map[get_id_type_index<T>()];
 
 		if (Always || !item)
 		{
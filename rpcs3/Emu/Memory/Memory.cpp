@@ -3,6 +3,59 @@
 
 VirtualMemoryBlock RSXIOMem;
 
+void VirtualMemoryBlock::update_pages(const VirtualMemInfo& info, bool map)
+{
+	const u32 mask = (1 << page_shift) - 1;
+
+	if ((info.addr | info.realAddress | info.size) & mask || info.addr < m_range_start)
+	{
+		return;
+	}
+
+	const u32 first = (info.addr - m_range_start) >> page_shift;
+
+	for (u32 i = 0; i < info.size >> page_shift && first + i < page_count; i++)
+	{
+		m_pages[first + i] = map ? info.realAddress + (i << page_shift) : 0;
+	}
+}
+
+void VirtualMemoryBlock::Clear()
+{
+	for (auto& page : m_pages)
+	{
+		page = 0;
+	}
+
+	m_mapped_memory.clear();
+	m_reserve_size = 0;
+	m_range_start = 0;
+	m_range_size = 0;
+}
+
+void* VirtualMemoryBlock::get_range_ptr(u32 addr, u32 size) const
+{
+	const u32 start = get_page_addr(addr);
+
+	if (!start || !size)
+	{
+		return nullptr;
+	}
+
+	// Following pages must be mapped right after the first one
+	const u32 mask = (1 << page_shift) - 1;
+
+	for (u32 offset = (1 << page_shift) - (addr & mask); offset < size; offset += 1 << page_shift)
+	{
+		if (get_page_addr(addr + offset) != start + offset)
+		{
+			return nullptr;
+		}
+	}
+
+	return vm::base(start);
+}
+
 VirtualMemoryBlock* VirtualMemoryBlock::SetRange(const u32 start, const u32 size)
 {
 	m_range_start = start;
@@ -39,6 +92,7 @@ u32 VirtualMemoryBlock::Map(u32 realaddr, u32 size)
 		if (!is_good_addr) continue;
 
 		m_mapped_memory.emplace_back(addr, realaddr, size);
+		update_pages(m_mapped_memory.back(), true);
 
 		return addr;
 	}
@@ -64,6 +118,7 @@ bool VirtualMemoryBlock::Map(u32 realaddr, u32 size, u32 addr)
 	}
 
 	m_mapped_memory.emplace_back(addr, realaddr, size);
+	update_pages(m_mapped_memory.back(), true);
 	return true;
 }
 
@@ -74,6 +129,7 @@ bool VirtualMemoryBlock::UnmapRealAddress(u32 realaddr, u32& size)
 		if (m_mapped_memory[i].realAddress == realaddr && IsInMyRange(m_mapped_memory[i].addr, m_mapped_memory[i].size))
 		{
 			size = m_mapped_memory[i].size;
+			update_pages(m_mapped_memory[i], false);
 			m_mapped_memory.erase(m_mapped_memory.begin() + i);
 			return true;
 		}
@@ -89,6 +145,7 @@ bool VirtualMemoryBlock::UnmapAddress(u32 addr, u32& size)
 		if (m_mapped_memory[i].addr == addr && IsInMyRange(m_mapped_memory[i].addr, m_mapped_memory[i].size))
 		{
 			size = m_mapped_memory[i].size;
+			update_pages(m_mapped_memory[i], false);
 			m_mapped_memory.erase(m_mapped_memory.begin() + i);
 			return true;
 		}
@@ -99,6 +156,12 @@ bool VirtualMemoryBlock::UnmapAddress(u32 addr, u32& size)
 
 bool VirtualMemoryBlock::Read32(const u32 addr, u32* value)
 {
+	if (const u32 realAddr = get_page_addr(addr))
+	{
+		*value = vm::ps3::read32(realAddr);
+		return true;
+	}
+
 	u32 realAddr;
 	if (!getRealAddr(addr, realAddr))
 		return false;
@@ -117,6 +180,12 @@ bool VirtualMemoryBlock::Write32(const u32 addr, const u32 value)
 
 bool VirtualMemoryBlock::getRealAddr(u32 addr, u32& result)
 {
+	if (const u32 realAddr = get_page_addr(addr))
+	{
+		result = realAddr;
+		return true;
+	}
+
 	for (u32 i = 0; i<m_mapped_memory.size(); ++i)
 	{
 		if (addr >= m_mapped_memory[i].addr && addr < m_mapped_memory[i].addr + m_mapped_memory[i].size)
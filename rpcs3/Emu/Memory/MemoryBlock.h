@@ -42,14 +42,24 @@ class VirtualMemoryBlock
 	u32 m_range_start = 0;
 	u32 m_range_size = 0;
 
+	static const u32 page_shift = 20; // 1 MiB, the IO mapping granularity
+	static const u32 page_count = 0x200; // up to 512 MiB
+
+	// Guest address of each mapped page (relative to the range start), 0 if not mapped
+	// Mappings which aren't page aligned aren't listed and take the slow path
+	std::array<atomic_t<u32>, page_count> m_pages{};
+
+	void update_pages(const VirtualMemInfo& info, bool map);
+
 public:
 	VirtualMemoryBlock() = default;
 
 	VirtualMemoryBlock* SetRange(const u32 start, const u32 size);
-	void Clear() { m_mapped_memory.clear(); m_reserve_size = 0; m_range_start = 0; m_range_size = 0; }
+	void Clear();
 	u32 GetStartAddr() const { return m_range_start; }
 	u32 GetSize() const { return m_range_size; }
 	bool IsInMyRange(const u32 addr, const u32 size);
+	const std::vector<VirtualMemInfo>& GetMappedMemory() const { return m_mapped_memory; }
 
 	// maps real address to virtual address space, returns the mapped address or 0 on failure (if no address is specified the
 	// first mappable space is used)
@@ -79,6 +89,24 @@ public:
 	// return true for success
 	bool getRealAddr(u32 addr, u32& result);
 
+	// Translate a mapped address through the page table (may be called concurrently with map/unmap)
+	// Returns 0 if it isn't mapped or its mapping isn't page aligned
+	u32 get_page_addr(u32 addr) const
+	{
+		const u32 page = (addr - m_range_start) >> page_shift;
+
+		if (page >= page_count)
+		{
+			return 0;
+		}
+
+		const u32 base = m_pages[page].load();
+		return base ? base + (addr & ((1 << page_shift) - 1)) : 0;
+	}
+
+	// Get the host pointer of the range [addr, addr + size) if it is mapped to contiguous guest memory, nullptr otherwise
+	void* get_range_ptr(u32 addr, u32 size) const;
+
 	u32 RealAddr(u32 addr)
 	{
 		u32 realAddr = 0;
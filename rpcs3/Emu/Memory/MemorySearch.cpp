@@ -0,0 +1,223 @@
+#include "stdafx.h"
+#include "Memory.h"
+
+#include "MemorySearch.h"
+
+namespace vm
+{
+	search_pattern_t search_pattern_t::from_string(const std::string& str)
+	{
+		search_pattern_t result;
+		result.data.assign(str.begin(), str.end());
+		result.mask.assign(str.size(), 0xff);
+		return result;
+	}
+
+	bool search_pattern_t::from_hex(const std::string& str, search_pattern_t& result)
+	{
+		result.data.clear();
+		result.mask.clear();
+
+		u8 data = 0, mask = 0;
+		u32 nibbles = 0;
+
+		for (const char c : str)
+		{
+			u8 value;
+
+			if (c == ' ' || c == '\t')
+			{
+				continue;
+			}
+			else if (c >= '0' && c <= '9')
+			{
+				value = c - '0';
+			}
+			else if (c >= 'a' && c <= 'f')
+			{
+				value = c - 'a' + 10;
+			}
+			else if (c >= 'A' && c <= 'F')
+			{
+				value = c - 'A' + 10;
+			}
+			else if (c == '?')
+			{
+				data <<= 4;
+				mask <<= 4;
+			}
+			else
+			{
+				return false;
+			}
+
+			if (c != '?')
+			{
+				data = data << 4 | value;
+				mask = mask << 4 | 0xf;
+			}
+
+			if (++nibbles % 2 == 0)
+			{
+				result.data.push_back(data);
+				result.mask.push_back(mask);
+				data = 0;
+				mask = 0;
+			}
+		}
+
+		return nibbles && nibbles % 2 == 0;
+	}
+
+	// Scan [begin, end) for the pattern start positions (the pattern may extend beyond end up to limit)
+	static void search_range(const u8* begin, const u8* end, const u8* limit, const search_pattern_t& pattern, std::vector<const u8*>& result)
+	{
+		const std::size_t size = pattern.data.size();
+
+		if (limit - begin < static_cast<std::ptrdiff_t>(size))
+		{
+			return;
+		}
+
+		// don't start matches which can't fit
+		end = std::min(end, limit - size + 1);
+
+		const auto verify = [&](const u8* ptr)
+		{
+			for (std::size_t i = 0; i < size; i++)
+			{
+				if ((ptr[i] ^ pattern.data[i]) & pattern.mask[i])
+				{
+					return false;
+				}
+			}
+
+			return true;
+		};
+
+		// find the first fully specified byte to scan for
+		const std::size_t anchor = std::find(pattern.mask.begin(), pattern.mask.end(), 0xff) - pattern.mask.begin();
+
+		if (anchor == size)
+		{
+			for (auto ptr = begin; ptr < end; ptr++)
+			{
+				if (verify(ptr)) result.push_back(ptr);
+			}
+
+			return;
+		}
+
+		const __m128i first = _mm_set1_epi8(pattern.data[anchor]);
+
+		auto ptr = begin;
+
+		// test 16 candidates at once (memchr-style), verify only the positions where the anchor byte matches
+		for (; ptr + 16 <= end; ptr += 16)
+		{
+			u32 bits = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr + anchor)), first));
+
+			while (bits)
+			{
+				const u32 i = 31 - cntlz32(bits & (0 - bits)); // lowest set bit
+
+				bits &= bits - 1;
+
+				if (verify(ptr + i)) result.push_back(ptr + i);
+			}
+		}
+
+		for (; ptr < end; ptr++)
+		{
+			if (ptr[anchor] == pattern.data[anchor] && verify(ptr)) result.push_back(ptr);
+		}
+	}
+
+	std::vector<u32> search(memory_location_t location, const search_pattern_t& pattern, u32 max_count)
+	{
+		std::vector<u32> result;
+
+		const auto block = get(location);
+
+		if (!block || pattern.data.empty() || pattern.data.size() != pattern.mask.size())
+		{
+			return result;
+		}
+
+		struct chunk_t
+		{
+			u32 addr;
+			u32 size;
+			u32 limit; // end of the contiguous allocated range
+		};
+
+		const u32 chunk_size = 16 * 1024 * 1024;
+
+		std::vector<chunk_t> chunks;
+
+		// collect ranges of allocated pages
+		for (u32 addr = block->addr; addr - block->addr < block->size;)
+		{
+			if (!check_addr(addr, 4096))
+			{
+				addr += 4096;
+				continue;
+			}
+
+			u32 end = addr + 4096;
+
+			while (end - block->addr < block->size && check_addr(end, 4096))
+			{
+				end += 4096;
+			}
+
+			for (u32 pos = addr; pos < end; pos += std::min(chunk_size, end - pos))
+			{
+				chunks.push_back({ pos, std::min(chunk_size, end - pos), end });
+			}
+
+			addr = end;
+		}
+
+		std::vector<std::vector<const u8*>> found(chunks.size());
+		std::atomic<std::size_t> next{ 0 };
+		std::vector<std::future<void>> workers;
+
+		const std::size_t count = std::min<std::size_t>(chunks.size(), std::max(std::thread::hardware_concurrency(), 1u));
+
+		for (std::size_t i = 0; i < count; i++)
+		{
+			workers.emplace_back(std::async(std::launch::async, [&]()
+			{
+				for (std::size_t index; (index = next++) < chunks.size();)
+				{
+					const auto& chunk = chunks[index];
+					const auto ptr = static_cast<const u8*>(base(chunk.addr));
+
+					search_range(ptr, ptr + chunk.size, ptr + (chunk.limit - chunk.addr), pattern, found[index]);
+				}
+			}));
+		}
+
+		for (auto& worker : workers)
+		{
+			worker.get();
+		}
+
+		// chunks are sorted by address
+		for (const auto& ptrs : found)
+		{
+			for (const auto ptr : ptrs)
+			{
+				if (result.size() >= max_count)
+				{
+					return result;
+				}
+
+				result.push_back(get_addr(ptr));
+			}
+		}
+
+		return result;
+	}
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+namespace vm
+{
+	// Byte pattern for memory search, only bits set in the mask are compared
+	struct search_pattern_t
+	{
+		std::vector<u8> data;
+		std::vector<u8> mask;
+
+		// Create pattern matching the string exactly
+		static search_pattern_t from_string(const std::string& str);
+
+		// Parse hex pattern like "DE AD ?? EF" or "dead??e?" ('?' matches any nibble), returns false on error
+		static bool from_hex(const std::string& str, search_pattern_t& result);
+	};
+
+	// Search the memory location for the pattern, returns sorted addresses of matches (up to max_count).
+	// Only allocated pages are scanned, contiguous ranges are split into chunks scanned in parallel.
+	std::vector<u32> search(memory_location_t location, const search_pattern_t& pattern, u32 max_count = UINT32_MAX);
+}
@@ -0,0 +1,163 @@
+#include "stdafx.h"
+#include "Memory.h"
+
+#include "MemorySnapshot.h"
+
+namespace vm
+{
+	std::mutex g_snapshot_mutex; // protects g_snapshot
+	std::weak_ptr<snapshot_t> g_snapshot; // active snapshot
+
+	bool snapshot_on_write(u32 addr, bool unmap)
+	{
+		const u32 page = addr & ~0xfff;
+
+		// the protection may be released concurrently, the access is repeated in this case anyway
+		if (!check_addr(page, 1, page_snapshot))
+		{
+			return false;
+		}
+
+		std::shared_ptr<snapshot_t> snapshot;
+		{
+			std::lock_guard<std::mutex> lock(g_snapshot_mutex);
+			snapshot = g_snapshot.lock();
+		}
+
+		if (snapshot)
+		{
+			snapshot->on_write(page);
+		}
+
+		// unmapped pages lose all flags anyway (and the memory lock is already owned)
+		if (!unmap)
+		{
+			page_protect(page, 4096, page_snapshot, 0, page_snapshot);
+		}
+
+		return true;
+	}
+
+	std::shared_ptr<snapshot_t> snapshot_t::create()
+	{
+		static std::mutex s_create_mutex;
+
+		std::lock_guard<std::mutex> create_lock(s_create_mutex);
+
+		{
+			std::lock_guard<std::mutex> lock(g_snapshot_mutex);
+
+			if (!g_snapshot.expired())
+			{
+				return nullptr;
+			}
+		}
+
+		std::shared_ptr<snapshot_t> result(new snapshot_t);
+
+		std::vector<std::pair<u32, u32>> ranges;
+
+		for (const auto location : { main, user_space, video, stack })
+		{
+			const auto block = get(location);
+
+			if (!block)
+			{
+				continue;
+			}
+
+			// collect contiguous ranges of allocated pages
+			for (u32 addr = block->addr; addr - block->addr < block->size;)
+			{
+				if (!check_addr(addr, 4096))
+				{
+					addr += 4096;
+					continue;
+				}
+
+				u32 end = addr + 4096;
+
+				while (end - block->addr < block->size && check_addr(end, 4096))
+				{
+					end += 4096;
+				}
+
+				ranges.emplace_back(addr, end - addr);
+
+				for (; addr < end; addr += 4096)
+				{
+					result->m_pages.push_back(addr);
+					result->m_states.emplace(addr, page_state::protected_page);
+				}
+			}
+		}
+
+		// publish the snapshot before protecting the pages
+		{
+			std::lock_guard<std::mutex> lock(g_snapshot_mutex);
+
+			g_snapshot = result;
+		}
+
+		for (const auto& range : ranges)
+		{
+			page_protect(range.first, range.second, 0, page_snapshot);
+		}
+
+		return result;
+	}
+
+	snapshot_t::~snapshot_t()
+	{
+		for (const auto& pair : m_states)
+		{
+			if (pair.second == page_state::protected_page)
+			{
+				// the page may be already unmapped
+				page_protect(pair.first, 4096, page_snapshot, 0, page_snapshot);
+			}
+		}
+	}
+
+	void snapshot_t::read_page(u32 addr, u8* dst)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		auto& state = m_states.at(addr);
+
+		if (state == page_state::copied)
+		{
+			std::memcpy(dst, m_copies.at(addr).get(), 4096);
+			m_copies.erase(addr);
+			state = page_state::released;
+			return;
+		}
+
+		if (state != page_state::protected_page)
+		{
+			throw EXCEPTION("Page already read (addr=0x%x)", addr);
+		}
+
+		// the page can't be modified while it's protected and the state is locked
+		std::memcpy(dst, g_priv_addr + addr, 4096);
+		state = page_state::released;
+		lock.unlock();
+
+		page_protect(addr, 4096, page_snapshot, 0, page_snapshot);
+	}
+
+	void snapshot_t::on_write(u32 addr)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		const auto found = m_states.find(addr);
+
+		if (found != m_states.end() && found->second == page_state::protected_page)
+		{
+			std::unique_ptr<u8[]> copy(new u8[4096]);
+			std::memcpy(copy.get(), g_priv_addr + addr, 4096);
+			m_copies.emplace(addr, std::move(copy));
+			found->second = page_state::copied;
+		}
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+namespace vm
+{
+	// Copy-on-write snapshot of the allocated guest memory.
+	// Creating it only write-protects the pages (page_snapshot flag), so the emulation is paused only for that.
+	// A page is copied on the first write to it (see snapshot_on_write()), unchanged pages are read directly
+	// and their protection is released as they are read. Only one snapshot can be active at a time.
+	class snapshot_t final
+	{
+		enum class page_state : u8
+		{
+			protected_page, // unchanged, write-protected
+			copied, // written after the snapshot was created, the copy is kept
+			released, // already read
+		};
+
+		std::mutex m_mutex;
+		std::vector<u32> m_pages; // addresses of all pages of the snapshot (sorted)
+		std::unordered_map<u32, page_state> m_states;
+		std::unordered_map<u32, std::unique_ptr<u8[]>> m_copies;
+
+		snapshot_t() = default;
+
+	public:
+		snapshot_t(const snapshot_t&) = delete;
+
+		// Release the protection of the pages which weren't read
+		~snapshot_t();
+
+		// Create the snapshot of all memory locations (the emulation must be paused), nullptr if another snapshot is active
+		static std::shared_ptr<snapshot_t> create();
+
+		const std::vector<u32>& pages() const
+		{
+			return m_pages;
+		}
+
+		// Read the page as it was when the snapshot was created (once per page, the page isn't protected anymore)
+		void read_page(u32 addr, u8* dst);
+
+		// Copy the page before it's modified (called by snapshot_on_write())
+		void on_write(u32 addr);
+	};
+}
@@ -1,6 +1,7 @@
 #include "stdafx.h"
 #include "Memory.h"
 #include "Emu/System.h"
+#include "Emu/state.h"
 #include "Utilities/Thread.h"
 #include "Emu/CPU/CPUThread.h"
 #include "Emu/Cell/PPUThread.h"
@@ -9,7 +10,9 @@
 
 #ifdef _WIN32
 #include <Windows.h>
+#include <intrin.h>
 #else
+#include <cpuid.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -87,6 +90,16 @@ namespace vm
 
 	std::array<atomic_t<u8>, 0x100000000ull / 4096> g_pages{}; // information about every page
 
+	// Pages which may be backed by host memory (written since the last decommit), clean pages are known to be zero.
+	// Only accessed by _page_map() and _page_unmap() which never run concurrently for the same page.
+	std::array<bool, 0x100000000ull / 4096> g_page_committed{};
+
+	std::atomic<u64> g_allocated_bytes{ 0 };
+	std::atomic<u64> g_committed_bytes{ 0 };
+
+	// Host memory of smaller deallocations is kept committed (reused by the next allocation, saves the system calls)
+	const u32 g_decommit_min_size = 0x10000;
+
 	std::vector<std::shared_ptr<block_t>> g_locations; // memory locations
 
 	//using reservation_mutex_t = std::mutex;
@@ -148,76 +161,89 @@ namespace vm
 		}
 	};
 
-	const thread_ctrl* volatile g_reservation_owner = nullptr;
+	thread_local bool g_tls_did_break_reservation = false;
 
-	u32 g_reservation_addr = 0;
-	u32 g_reservation_size = 0;
+	const fiber_tls_t g_fiber_tls_did_break_reservation([]() -> void* { return &g_tls_did_break_reservation; }, sizeof(g_tls_did_break_reservation));
 
-	thread_local bool g_tls_did_break_reservation = false;
+	reservation_mutex_t g_reservation_mutex; // protects memory locations and page flags
 
-	reservation_mutex_t g_reservation_mutex;
+	// reservation granularity (size of the atomic cache line)
+	const u32 g_reservation_line_size = 128;
 
-	std::array<waiter_t, 1024> g_waiter_list;
+	// reservation line versions hashed by line address (odd value: line is being modified)
+	std::array<std::atomic<u64>, 0x10000> g_reservation_lines{};
 
-	std::size_t g_waiter_max = 0; // min unused position
-	std::size_t g_waiter_nil = 0; // min search position
+	// number of reservations keeping every page read-only (to catch normal writes)
+	std::array<atomic_t<u16>, 0x100000000ull / 4096> g_reservation_pages{};
 
-	std::mutex g_waiter_list_mutex;
+	// locks for changing g_reservation_pages and memory protection of reserved pages (hashed by page)
+	std::array<std::mutex, 64> g_reservation_page_mutex;
 
-	waiter_t* _add_waiter(named_thread_t& thread, u32 addr, u32 size)
+	struct reservation_t
 	{
-		std::lock_guard<std::mutex> lock(g_waiter_list_mutex);
+		std::atomic<bool> used{ false }; // slot allocated by a thread
+		std::atomic<const thread_ctrl*> owner{ nullptr };
+		std::atomic<u32> addr{ 0 }; // 0 if no reservation
+		u32 size = 0;
+		u64 version = 0; // line version at the moment of acquiring
+		bool hold = false; // reservation keeps the page read-only (page_protection mode)
+		std::array<u8, 128> data; // reserved data (line_compare mode)
+	};
 
-		const u64 align = 0x80000000ull >> cntlz32(size);
+	// reservation slots of all threads (one reservation per thread)
+	std::array<reservation_t, 256> g_reservations;
 
-		if (!size || !addr || size > 4096 || size != align || addr & (align - 1))
-		{
-			throw EXCEPTION("Invalid arguments (addr=0x%x, size=0x%x)", addr, size);
-		}
+	thread_local reservation_t* g_tls_reservation = nullptr;
 
-		thread.mutex.lock();
+	const fiber_tls_t g_fiber_tls_reservation([]() -> void* { return &g_tls_reservation; }, sizeof(g_tls_reservation));
 
-		// look for empty position
-		for (; g_waiter_nil < g_waiter_max; g_waiter_nil++)
-		{
-			waiter_t& waiter = g_waiter_list[g_waiter_nil];
+	// Waiters hashed by 4 KB page (waited and notified ranges never cross a page since size <= 4096 and addr is aligned to size)
+	struct waiter_bucket_t
+	{
+		std::mutex mutex;
+		std::vector<waiter_t*> list;
+		std::atomic<u32> count{ 0 }; // list size, read without locking to skip empty buckets
+	};
 
-			if (!waiter.thread)
-			{
-				// store next position for further addition
-				g_waiter_nil++;
+	std::array<waiter_bucket_t, 256> g_waiter_buckets;
 
-				return waiter.reset(addr, size, thread);
-			}
-		}
+	waiter_bucket_t& _waiter_bucket(u32 addr)
+	{
+		return g_waiter_buckets[addr / 4096 % g_waiter_buckets.size()];
+	}
+
+	void _add_waiter(waiter_t& waiter, named_thread_t& thread, u32 addr, u32 size)
+	{
+		const u64 align = 0x80000000ull >> cntlz32(size);
 
-		if (g_waiter_max >= g_waiter_list.size())
+		if (!size || !addr || size > 4096 || size != align || addr & (align - 1))
 		{
-			throw EXCEPTION("Waiter list limit broken (%lld)", g_waiter_max);
+			throw EXCEPTION("Invalid arguments (addr=0x%x, size=0x%x)", addr, size);
 		}
 
-		waiter_t& waiter = g_waiter_list[g_waiter_max++];
+		auto& bucket = _waiter_bucket(addr);
 
-		g_waiter_nil = g_waiter_max;
-		
-		return waiter.reset(addr, size, thread);
+		std::lock_guard<std::mutex> lock(bucket.mutex);
+
+		thread.mutex.lock();
+
+		bucket.list.emplace_back(waiter.reset(addr, size, thread));
+		bucket.count++;
 	}
 
-	void _remove_waiter(waiter_t* waiter)
+	void _remove_waiter(waiter_t& waiter, u32 addr)
 	{
-		std::lock_guard<std::mutex> lock(g_waiter_list_mutex);
+		auto& bucket = _waiter_bucket(addr);
 
-		// mark as deleted
-		waiter->thread = nullptr;
+		std::lock_guard<std::mutex> lock(bucket.mutex);
 
-		// amortize adding new element
-		g_waiter_nil = std::min<std::size_t>(g_waiter_nil, waiter - g_waiter_list.data());
+		// unordered removal
+		auto found = std::find(bucket.list.begin(), bucket.list.end(), &waiter);
+		*found = bucket.list.back();
+		bucket.list.pop_back();
+		bucket.count--;
 
-		// amortize polling
-		while (g_waiter_max && !g_waiter_list[g_waiter_max - 1].thread)
-		{
-			g_waiter_max--;
-		}
+		waiter.thread = nullptr;
 	}
 
 	bool waiter_t::try_notify()
@@ -256,62 +282,108 @@ namespace vm
 	}
 
 	waiter_lock_t::waiter_lock_t(named_thread_t& thread, u32 addr, u32 size)
-		: m_waiter(_add_waiter(thread, addr, size))
-		, m_lock(thread.mutex, std::adopt_lock) // must be locked in _add_waiter
 	{
+		_add_waiter(m_waiter, thread, addr, size);
+
+		m_lock = std::unique_lock<std::mutex>(thread.mutex, std::adopt_lock); // locked in _add_waiter
 	}
 
 	void waiter_lock_t::wait()
 	{
 		// if another thread successfully called pred(), it must be set to null
-		while (m_waiter->pred)
+		while (m_waiter.pred)
 		{
 			// if pred() called by another thread threw an exception, it'll be rethrown
-			if (m_waiter->pred())
+			if (m_waiter.pred())
 			{
 				return;
 			}
 
 			CHECK_EMU_STATUS;
 
-			m_waiter->thread->cv.wait(m_lock);
+			m_waiter.thread->cv.wait(m_lock);
 		}
 	}	
 
+	bool waiter_lock_t::wait_for(u64 timeout)
+	{
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(timeout);
+
+		while (m_waiter.pred)
+		{
+			if (m_waiter.pred())
+			{
+				return true;
+			}
+
+			CHECK_EMU_STATUS;
+
+			if (m_waiter.thread->cv.wait_until(m_lock, deadline) == std::cv_status::timeout)
+			{
+				// the predicate may have passed in another thread meanwhile
+				return !m_waiter.pred;
+			}
+		}
+
+		return true;
+	}
+
 	waiter_lock_t::~waiter_lock_t()
 	{
 		// reset some data to avoid excessive signaling
-		m_waiter->addr = 0;
-		m_waiter->mask = ~0;
-		m_waiter->pred = nullptr;
+		m_waiter.addr = 0;
+		m_waiter.mask = ~0;
+		m_waiter.pred = nullptr;
 
-		// unlock thread's mutex to avoid deadlock with g_waiter_list_mutex
+		// unlock thread's mutex to avoid deadlock with the bucket mutex
 		m_lock.unlock();
 
-		_remove_waiter(m_waiter);
+		_remove_waiter(m_waiter, m_waiter.bucket_addr);
 	}
 
 	void _notify_at(u32 addr, u32 size)
 	{
+		auto& bucket = _waiter_bucket(addr);
+
 		// skip notification if no waiters available
-		if (_mm_mfence(), !g_waiter_max) return;
+		if (_mm_mfence(), !bucket.count) return;
 
-		std::lock_guard<std::mutex> lock(g_waiter_list_mutex);
+		std::lock_guard<std::mutex> lock(bucket.mutex);
 
 		const u32 mask = ~(size - 1);
 
-		for (std::size_t i = 0; i < g_waiter_max; i++)
+		for (waiter_t* waiter : bucket.list)
 		{
-			waiter_t& waiter = g_waiter_list[i];
-
 			// check address range overlapping using masks generated from size (power of 2)
-			if (waiter.thread && ((waiter.addr ^ addr) & (mask & waiter.mask)) == 0)
+			if (((waiter->addr ^ addr) & (mask & waiter->mask)) == 0)
 			{
-				waiter.try_notify();
+				waiter->try_notify();
 			}
 		}
 	}
 
+	void wait_change(named_thread_t& thread, u32 addr, u32 size, u64 timeout)
+	{
+		if (!size || size > 8 || size & (size - 1) || addr & (size - 1))
+		{
+			throw EXCEPTION("Invalid arguments (addr=0x%x, size=0x%x)", addr, size);
+		}
+
+		u64 old = 0;
+		std::memcpy(&old, vm::base(addr), size);
+
+		waiter_lock_t lock(thread, addr, size);
+
+		lock->pred = [=]()
+		{
+			u64 data = 0;
+			std::memcpy(&data, vm::base(addr), size);
+			return data != old;
+		};
+
+		lock.wait_for(timeout);
+	}
+
 	void notify_at(u32 addr, u32 size)
 	{
 		const u64 align = 0x80000000ull >> cntlz32(size);
@@ -326,22 +398,28 @@ namespace vm
 
 	bool notify_all()
 	{
-		std::unique_lock<std::mutex> lock(g_waiter_list_mutex);
-
 		std::size_t waiters = 0;
 		std::size_t signaled = 0;
 
-		for (std::size_t i = 0; i < g_waiter_max; i++)
+		for (auto& bucket : g_waiter_buckets)
 		{
-			waiter_t& waiter = g_waiter_list[i];
-
-			if (waiter.thread && waiter.addr)
+			if (!bucket.count)
 			{
-				waiters++;
+				continue;
+			}
+
+			std::lock_guard<std::mutex> lock(bucket.mutex);
 
-				if (waiter.try_notify())
+			for (waiter_t* waiter : bucket.list)
+			{
+				if (waiter->addr)
 				{
-					signaled++;
+					waiters++;
+
+					if (waiter->try_notify())
+					{
+						signaled++;
+					}
 				}
 			}
 		}
@@ -357,231 +435,564 @@ namespace vm
 		{
 			while (!Emu.IsStopped())
 			{
-				// poll waiters periodically (TODO)
-				while (!notify_all() && !Emu.IsPaused())
+				// Waiters are notified by notify_at() and reservation breaks, a slow poll only catches conditions
+				// changed by plain stores (e.g. a predicate reading guest memory written without notification)
+				if (!Emu.IsPaused())
 				{
-					std::this_thread::yield();
+					notify_all();
 				}
 
-				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
 			}
 		});
 	}
 
-	void _reservation_set(u32 addr, bool no_access = false)
+	std::atomic<u64>& _reservation_line(u32 addr)
+	{
+		return g_reservation_lines[addr / g_reservation_line_size % g_reservation_lines.size()];
+	}
+
+	void _reservation_check_args(u32 addr, u32 size)
+	{
+		const u64 align = 0x80000000ull >> cntlz32(size);
+
+		if (!size || !addr || size > g_reservation_line_size || size != align || addr & (align - 1))
+		{
+			throw EXCEPTION("Invalid arguments (addr=0x%x, size=0x%x)", addr, size);
+		}
+	}
+
+	// reservation is value-based (see _reservation_update_cas())
+	bool _reservation_is_small(u32 size)
+	{
+		return size == 4 || size == 8;
+	}
+
+	// lock reservation line and return its version (wait if it's already locked)
+	u64 _reservation_line_lock(std::atomic<u64>& line)
+	{
+		while (true)
+		{
+			u64 version = line.load(std::memory_order_relaxed);
+
+			if (version & 1)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+
+			if (line.compare_exchange_weak(version, version + 1, std::memory_order_acquire))
+			{
+				return version;
+			}
+		}
+	}
+
+	// unlock reservation line (its version is changed, so all reservations are lost)
+	void _reservation_line_unlock(std::atomic<u64>& line)
 	{
+		line.fetch_add(1, std::memory_order_release);
+	}
+
+	// set memory protection of the page according to page flags (read-only if it keeps reservations)
+	void _reservation_protect(u32 addr, bool hold)
+	{
+		const u8 flags = g_pages[addr >> 12];
+
 #ifdef _WIN32
 		DWORD old;
-		if (!::VirtualProtect(vm::base(addr & ~0xfff), 4096, no_access ? PAGE_NOACCESS : PAGE_READONLY, &old))
+		auto protection = flags & page_writable && !hold && !(flags & (page_code_watch | page_snapshot)) ? PAGE_READWRITE : (flags & (page_readable | page_writable) ? PAGE_READONLY : PAGE_NOACCESS);
+		if (!::VirtualProtect(vm::base(addr & ~0xfff), 4096, protection, &old))
 #else
-		if (::mprotect(vm::base(addr & ~0xfff), 4096, no_access ? PROT_NONE : PROT_READ))
+		auto protection = flags & page_writable && !hold && !(flags & (page_code_watch | page_snapshot)) ? PROT_WRITE | PROT_READ : (flags & (page_readable | page_writable) ? PROT_READ : PROT_NONE);
+		if (::mprotect(vm::base(addr & ~0xfff), 4096, protection))
 #endif
 		{
 			throw EXCEPTION("System failure (addr=0x%x)", addr);
 		}
 	}
 
-	bool _reservation_break(u32 addr)
+	void _reservation_page_hold(u32 addr)
 	{
-		if (g_reservation_addr >> 12 == addr >> 12)
+		std::lock_guard<std::mutex> lock(g_reservation_page_mutex[(addr >> 12) % g_reservation_page_mutex.size()]);
+
+		if (g_reservation_pages[addr >> 12]++ == 0)
 		{
-#ifdef _WIN32
-			DWORD old;
-			if (!::VirtualProtect(vm::base(addr & ~0xfff), 4096, PAGE_READWRITE, &old))
-#else
-			if (::mprotect(vm::base(addr & ~0xfff), 4096, PROT_READ | PROT_WRITE))
-#endif
+			_reservation_protect(addr, true);
+		}
+	}
+
+	void _reservation_page_release(u32 addr)
+	{
+		std::lock_guard<std::mutex> lock(g_reservation_page_mutex[(addr >> 12) % g_reservation_page_mutex.size()]);
+
+		if (--g_reservation_pages[addr >> 12] == 0)
+		{
+			_reservation_protect(addr, false);
+		}
+	}
+
+	// get reservation slot of the current thread
+	reservation_t& _reservation_get()
+	{
+		if (!g_tls_reservation)
+		{
+			for (auto& res : g_reservations)
+			{
+				bool used = false;
+
+				if (res.used.compare_exchange_strong(used, true))
+				{
+					res.owner = thread_ctrl::get_current();
+					g_tls_reservation = &res;
+					return res;
+				}
+			}
+
+			throw EXCEPTION("Reservation slot limit broken (%lld)", g_reservations.size());
+		}
+
+		return *g_tls_reservation;
+	}
+
+	// remove the reservation (returns true if it existed)
+	bool _reservation_release(reservation_t& res)
+	{
+		if (const u32 addr = res.addr.exchange(0))
+		{
+			if (res.hold)
 			{
-				throw EXCEPTION("System failure (addr=0x%x)", addr);
+				_reservation_page_release(addr);
 			}
 
-			g_reservation_addr = 0;
-			g_reservation_size = 0;
-			g_reservation_owner = nullptr;
-			
 			return true;
 		}
 
 		return false;
 	}
 
+	// break all reservations in the page
+	void _reservation_break_page(u32 addr)
+	{
+		if (g_reservation_pages[addr >> 12])
+		{
+			for (u32 i = addr & ~0xfff; i < (addr & ~0xfff) + 4096; i += g_reservation_line_size)
+			{
+				auto& line = _reservation_line(i);
+				_reservation_line_lock(line);
+				_reservation_line_unlock(line);
+			}
+		}
+	}
+
 	void reservation_break(u32 addr)
 	{
-		std::unique_lock<reservation_mutex_t> lock(g_reservation_mutex);
+		auto& line = _reservation_line(addr);
 
-		const u32 raddr = g_reservation_addr;
-		const u32 rsize = g_reservation_size;
+		_reservation_line_lock(line);
+		_reservation_line_unlock(line);
 
-		if ((g_tls_did_break_reservation = _reservation_break(addr)))
+		if ((g_tls_did_break_reservation = g_reservation_pages[addr >> 12] != 0))
 		{
-			lock.unlock(), _notify_at(raddr, rsize);
+			_notify_at(addr & ~(g_reservation_line_size - 1), g_reservation_line_size);
 		}
 	}
 
 	void reservation_acquire(void* data, u32 addr, u32 size)
 	{
-		std::lock_guard<reservation_mutex_t> lock(g_reservation_mutex);
+		_reservation_check_args(addr, size);
 
-		const u64 align = 0x80000000ull >> cntlz32(size);
+		const u8 flags = g_pages[addr >> 12];
 
-		if (!size || !addr || size > 4096 || size != align || addr & (align - 1))
+		if (!(flags & page_writable) || !(flags & page_allocated) || (flags & page_no_reservations))
 		{
-			throw EXCEPTION("Invalid arguments (addr=0x%x, size=0x%x)", addr, size);
+			throw EXCEPTION("Invalid page flags (addr=0x%x, size=0x%x, flags=0x%x)", addr, size, flags);
 		}
 
-		const u8 flags = g_pages[addr >> 12];
+		reservation_t& res = _reservation_get();
 
-		if (!(flags & page_writable) || !(flags & page_allocated) || (flags & page_no_reservations))
+		// remove the previous reservation of this thread
+		g_tls_did_break_reservation = _reservation_release(res);
+
+		// in line_compare mode normal writes are detected by comparing the data in reservation_update()
+		// 4 and 8-byte reservations (lwarx, ldarx) always compare the value with host cmpxchg, so they never change memory protection
+		const bool hold = !_reservation_is_small(size) && rpcs3::state.config.core.reservation_mode.value() == reservation_mode_type::page_protection;
+
+		if (hold)
 		{
-			throw EXCEPTION("Invalid page flags (addr=0x%x, size=0x%x, flags=0x%x)", addr, size, flags);
+			// change memory protection to read-only (normal writes will be processed by reservation_query())
+			_reservation_page_hold(addr);
 		}
 
-		// break the reservation
-		g_tls_did_break_reservation = g_reservation_owner && _reservation_break(g_reservation_addr);
+		auto& line = _reservation_line(addr);
+
+		// copy data, retry if the line was modified meanwhile
+		while (true)
+		{
+			const u64 version = line.load(std::memory_order_acquire);
+
+			if (version & 1)
+			{
+				std::this_thread::yield();
+				continue;
+			}
 
-		// change memory protection to read-only
-		_reservation_set(addr);
+			std::memcpy(data, vm::base(addr), size);
 
-		// may not be necessary
-		_mm_mfence();
+			std::atomic_thread_fence(std::memory_order_acquire);
 
-		// set additional information
-		g_reservation_addr = addr;
-		g_reservation_size = size;
-		g_reservation_owner = thread_ctrl::get_current();
+			if (line.load(std::memory_order_relaxed) == version)
+			{
+				if (!hold)
+				{
+					std::memcpy(res.data.data(), data, size);
+				}
 
-		// copy data
-		std::memcpy(data, vm::base(addr), size);
+				res.size = size;
+				res.version = version;
+				res.hold = hold;
+				res.addr.store(addr, std::memory_order_release);
+				return;
+			}
+		}
 	}
 
-	bool reservation_update(u32 addr, const void* data, u32 size)
+	bool _rtm_supported()
 	{
-		std::unique_lock<reservation_mutex_t> lock(g_reservation_mutex);
+#ifdef _MSC_VER
+		int regs[4];
+		__cpuid(regs, 0);
 
-		const u64 align = 0x80000000ull >> cntlz32(size);
+		if (regs[0] < 7)
+		{
+			return false;
+		}
 
-		if (!size || !addr || size > 4096 || size != align || addr & (align - 1))
+		__cpuidex(regs, 7, 0);
+		return (regs[1] & (1 << 11)) != 0;
+#else
+		if (__get_cpuid_max(0, nullptr) < 7)
 		{
-			throw EXCEPTION("Invalid arguments (addr=0x%x, size=0x%x)", addr, size);
+			return false;
+		}
+
+		u32 eax, ebx, ecx, edx;
+		__cpuid_count(7, 0, eax, ebx, ecx, edx);
+		return (ebx & (1 << 11)) != 0;
+#endif
+	}
+
+	// Intel TSX (RTM) availability
+	const bool g_rtm_supported = _rtm_supported();
+
+	// try to compare the line version and update memory in a hardware transaction
+	// returns false if the transaction was aborted, otherwise sets the result of the update
+#ifndef _MSC_VER
+	__attribute__((target("rtm")))
+#endif
+	bool _reservation_update_rtm(std::atomic<u64>& line, u64 version, u32 addr, const void* data, const void* cmp, u32 size, bool& result)
+	{
+		for (u32 i = 0; i < 4; i++)
+		{
+			const u32 status = _xbegin();
+
+			if (status == _XBEGIN_STARTED)
+			{
+				if (line.load(std::memory_order_relaxed) != version)
+				{
+					_xend();
+					result = false;
+					return true;
+				}
+
+				// compare reserved data if necessary (without calling memcmp())
+				if (cmp)
+				{
+					bool equal = true;
+
+					if (size == 4)
+					{
+						equal = *static_cast<const u32*>(vm::base_priv(addr)) == *static_cast<const u32*>(cmp);
+					}
+					else
+					{
+						for (u32 j = 0; j < size; j += 8)
+						{
+							equal &= *reinterpret_cast<const u64*>(static_cast<const u8*>(vm::base_priv(addr)) + j) == *reinterpret_cast<const u64*>(static_cast<const u8*>(cmp) + j);
+						}
+					}
+
+					if (!equal)
+					{
+						_xend();
+						result = false;
+						return true;
+					}
+				}
+
+				// copy data without calling memcpy() (which may abort the transaction)
+				if (size == 4)
+				{
+					*static_cast<u32*>(vm::base_priv(addr)) = *static_cast<const u32*>(data);
+				}
+				else
+				{
+					for (u32 j = 0; j < size; j += 8)
+					{
+						*reinterpret_cast<u64*>(static_cast<u8*>(vm::base_priv(addr)) + j) = *reinterpret_cast<const u64*>(static_cast<const u8*>(data) + j);
+					}
+				}
+
+				line.store(version + 2, std::memory_order_relaxed);
+
+				_xend();
+				result = true;
+				return true;
+			}
+
+			if (!(status & _XABORT_RETRY))
+			{
+				break;
+			}
+		}
+
+		return false;
+	}
+
+	// update 4 or 8-byte reservation: the line version protects against other atomic updates (ABA), the reserved value is
+	// compared with the memory by host cmpxchg, so normal writes of other values are detected without the page protection
+	bool _reservation_update_cas(std::atomic<u64>& line, u64 version, u32 addr, const void* data, const void* cmp, u32 size)
+	{
+		// lock the line only if it wasn't modified since the reservation was acquired
+		if (!line.compare_exchange_strong(version, version + 1, std::memory_order_acquire))
+		{
+			return false;
 		}
 
-		if (g_reservation_owner != thread_ctrl::get_current() || g_reservation_addr != addr || g_reservation_size != size)
+		const bool result = size == 4
+			? sync_bool_compare_and_swap(static_cast<volatile u32*>(vm::base_priv(addr)), *static_cast<const u32*>(cmp), *static_cast<const u32*>(data))
+			: sync_bool_compare_and_swap(static_cast<volatile u64*>(vm::base_priv(addr)), *static_cast<const u64*>(cmp), *static_cast<const u64*>(data));
+
+		if (result)
+		{
+			_reservation_line_unlock(line);
+		}
+		else
+		{
+			// memory wasn't modified, restore the version (reservations of other threads remain valid)
+			line.store(version, std::memory_order_release);
+		}
+
+		return result;
+	}
+
+	bool reservation_update(u32 addr, const void* data, u32 size)
+	{
+		_reservation_check_args(addr, size);
+
+		reservation_t* res = g_tls_reservation;
+
+		if (!res || res->addr != addr || res->size != size)
 		{
 			// atomic update failed
 			return false;
 		}
 
-		// change memory protection to no access
-		_reservation_set(addr, true);
+		// privileged write doesn't fault
+		snapshot_on_write(addr);
+
+		auto& line = _reservation_line(addr);
+
+		bool result;
+
+		// reserved data must be compared if normal writes weren't tracked
+		const void* const cmp = res->hold ? nullptr : res->data.data();
 
-		// update memory using privileged access
-		std::memcpy(vm::base_priv(addr), data, size);
+		// use host cmpxchg for small reservations, otherwise compare and store in a single transaction if possible or use the line lock
+		if (cmp && _reservation_is_small(size))
+		{
+			result = _reservation_update_cas(line, res->version, addr, data, cmp, size);
+		}
+		else if (!g_rtm_supported || !rpcs3::state.config.core.use_tsx.value() || !_reservation_update_rtm(line, res->version, addr, data, cmp, size, result))
+		{
+			// lock the line only if it wasn't modified since the reservation was acquired
+			u64 version = res->version;
+			result = line.compare_exchange_strong(version, version + 1, std::memory_order_acquire);
+
+			if (result && cmp && std::memcmp(vm::base_priv(addr), cmp, size) != 0)
+			{
+				// the line was modified by normal write
+				_reservation_line_unlock(line);
+				result = false;
+			}
+			else if (result)
+			{
+				// update memory using privileged access
+				std::memcpy(vm::base_priv(addr), data, size);
+
+				_reservation_line_unlock(line);
+			}
+		}
 
 		// free the reservation and restore memory protection
-		_reservation_break(addr);
+		_reservation_release(*res);
 
-		// notify waiter
-		lock.unlock(), _notify_at(addr, size);
+		if (result)
+		{
+			// notify waiter
+			_notify_at(addr, size);
+		}
 
-		// atomic update succeeded
-		return true;
+		return result;
 	}
 
 	bool reservation_query(u32 addr, u32 size, bool is_writing, std::function<bool()> callback)
 	{
-		std::unique_lock<reservation_mutex_t> lock(g_reservation_mutex);
-
 		if (!check_addr(addr))
 		{
 			return false;
 		}
 
-		// check if current reservation and address may overlap
-		if (g_reservation_addr >> 12 == addr >> 12 && is_writing)
+		// process write access to the page kept read-only by reservations
+		if (is_writing && g_reservation_pages[addr >> 12])
 		{
-			const bool result = callback(); 
+			const u32 first = addr & ~(g_reservation_line_size - 1);
+			const u32 last = (addr + std::max<u32>(size, 1) - 1) & ~(g_reservation_line_size - 1);
+
+			// lock all affected lines in a fixed order (multiple lines may share the same version)
+			std::vector<std::atomic<u64>*> lines;
+
+			for (u64 i = first; i <= last; i += g_reservation_line_size)
+			{
+				lines.emplace_back(&_reservation_line(static_cast<u32>(i)));
+			}
+
+			std::sort(lines.begin(), lines.end());
+			lines.erase(std::unique(lines.begin(), lines.end()), lines.end());
+
+			for (auto line : lines)
+			{
+				_reservation_line_lock(*line);
+			}
+
+			// write memory using privileged access
+			const bool result = callback();
 
-			if (result && size && addr + size - 1 >= g_reservation_addr && g_reservation_addr + g_reservation_size - 1 >= addr)
+			// break all reservations on these lines
+			for (auto line : lines)
 			{
-				const u32 raddr = g_reservation_addr;
-				const u32 rsize = g_reservation_size;
+				_reservation_line_unlock(*line);
+			}
+
+			if ((g_tls_did_break_reservation = result && size))
+			{
+				_notify_at(first, g_reservation_line_size);
 
-				// break the reservation if overlap
-				if ((g_tls_did_break_reservation = _reservation_break(addr)))
+				if (last != first)
 				{
-					lock.unlock(), _notify_at(raddr, rsize);
+					_notify_at(last, g_reservation_line_size);
 				}
 			}
-			
+
 			return result;
 		}
-		
+
+		// memory protection may have been already restored
 		return true;
 	}
 
 	bool reservation_test(const thread_ctrl* current)
 	{
-		const auto owner = g_reservation_owner;
+		const reservation_t* res = nullptr;
 
-		return owner && owner == current;
+		if (current == thread_ctrl::get_current())
+		{
+			res = g_tls_reservation;
+		}
+		else
+		{
+			for (auto& r : g_reservations)
+			{
+				if (r.used && r.owner == current)
+				{
+					res = &r;
+					break;
+				}
+			}
+		}
+
+		if (!res)
+		{
+			return false;
+		}
+
+		const u32 addr = res->addr.load(std::memory_order_acquire);
+
+		// the reservation is lost if the line version changed
+		if (!addr || _reservation_line(addr).load(std::memory_order_acquire) != res->version)
+		{
+			return false;
+		}
+
+		// the reservation is lost if the data changed (line_compare mode)
+		return res->hold || std::memcmp(vm::base_priv(addr), res->data.data(), res->size) == 0;
 	}
 
 	void reservation_free()
 	{
-		if (reservation_test())
+		if (reservation_t* res = g_tls_reservation)
 		{
-			std::lock_guard<reservation_mutex_t> lock(g_reservation_mutex);
+			g_tls_did_break_reservation = _reservation_release(*res);
 
-			if (g_reservation_owner && g_reservation_owner == thread_ctrl::get_current())
-			{
-				g_tls_did_break_reservation = _reservation_break(g_reservation_addr);
-			}
+			// free the slot
+			res->owner = nullptr;
+			res->used = false;
+			g_tls_reservation = nullptr;
 		}
 	}
 
 	void reservation_op(u32 addr, u32 size, std::function<void()> proc)
 	{
-		std::unique_lock<reservation_mutex_t> lock(g_reservation_mutex);
+		_reservation_check_args(addr, size);
 
-		const u64 align = 0x80000000ull >> cntlz32(size);
+		reservation_t* res = g_tls_reservation;
 
-		if (!size || !addr || size > 4096 || size != align || addr & (align - 1))
-		{
-			throw EXCEPTION("Invalid arguments (addr=0x%x, size=0x%x)", addr, size);
-		}
+		const bool hold = rpcs3::state.config.core.reservation_mode.value() == reservation_mode_type::page_protection;
 
-		g_tls_did_break_reservation = false;
+		// privileged write doesn't fault (must be called before locking the line)
+		snapshot_on_write(addr);
 
-		// check and possibly break previous reservation
-		if (g_reservation_owner != thread_ctrl::get_current() || g_reservation_addr != addr || g_reservation_size != size)
+		if (hold)
 		{
-			if (g_reservation_owner)
-			{
-				_reservation_break(g_reservation_addr);
-			}
-
-			g_tls_did_break_reservation = true;
+			// keep the page read-only so normal writes wait for the operation
+			_reservation_page_hold(addr);
 		}
 
-		// change memory protection to no access
-		_reservation_set(addr, true);
+		auto& line = _reservation_line(addr);
 
-		// set additional information
-		g_reservation_addr = addr;
-		g_reservation_size = size;
-		g_reservation_owner = thread_ctrl::get_current();
+		const u64 version = _reservation_line_lock(line);
 
-		// may not be necessary
-		_mm_mfence();
+		g_tls_did_break_reservation = !res || res->addr != addr || res->size != size || res->version != version;
 
 		// do the operation
 		proc();
 
-		// remove the reservation
-		_reservation_break(addr);
+		// break all reservations on this line
+		_reservation_line_unlock(line);
+
+		// remove the reservation of this thread
+		if (res)
+		{
+			_reservation_release(*res);
+		}
+
+		if (hold)
+		{
+			_reservation_page_release(addr);
+		}
 
 		// notify waiter
-		lock.unlock(), _notify_at(addr, size);
+		_notify_at(addr, size);
 	}
 
 	void _page_map(u32 addr, u32 size, u8 flags)
@@ -619,9 +1030,77 @@ namespace vm
 			{
 				throw EXCEPTION("Concurrent access (addr=0x%x, size=0x%x, flags=0x%x, current_addr=0x%x)", addr, size, flags, i * 4096);
 			}
+
+			// reservations acquired before the page was unmapped may be still held
+			if (g_reservation_pages[i])
+			{
+				std::lock_guard<std::mutex> lock(g_reservation_page_mutex[i % g_reservation_page_mutex.size()]);
+
+				_reservation_protect(i * 4096, g_reservation_pages[i] != 0);
+			}
 		}
 
-		std::memset(priv_addr, 0, size); // ???
+		// clear reused pages, decommitted ones are zero and get committed on the first access
+		for (u32 i = addr / 4096, end = addr / 4096 + size / 4096; i < end;)
+		{
+			if (!g_page_committed[i])
+			{
+				g_page_committed[i] = true;
+				g_committed_bytes += 4096;
+				i++;
+				continue;
+			}
+
+			u32 count = 1;
+
+			while (i + count < end && g_page_committed[i + count])
+			{
+				count++;
+			}
+
+			std::memset(vm::base_priv(i * 4096), 0, count * 4096);
+			i += count;
+		}
+
+		g_allocated_bytes += size;
+	}
+
+	// Give host memory backing the pages back to the system (contents are lost, must be called before the private view is protected)
+	void _page_decommit(u32 addr, u32 size)
+	{
+		u32 count = 0;
+
+		for (u32 i = addr / 4096; i < addr / 4096 + size / 4096; i++)
+		{
+			count += g_page_committed[i];
+		}
+
+		if (!count)
+		{
+			return;
+		}
+
+#if defined(_WIN32)
+		// views of a section can't be decommitted: discard the contents and trim the pages from the working set
+		// (they no longer count as resident, but the commit charge remains and the pages aren't zeroed, so they stay marked)
+		::VirtualAlloc(vm::base_priv(addr), size, MEM_RESET, PAGE_READWRITE);
+		::VirtualUnlock(vm::base_priv(addr), size);
+#elif defined(MADV_REMOVE)
+		// the memory is a shared mapping, MADV_DONTNEED would only drop the page table entries: free the backing shmem pages
+		if (::madvise(vm::base_priv(addr), size, MADV_REMOVE))
+		{
+			LOG_WARNING(MEMORY, "madvise(MADV_REMOVE) failed (addr=0x%x, size=0x%x, errno=%d)", addr, size, errno);
+		}
+		else
+		{
+			for (u32 i = addr / 4096; i < addr / 4096 + size / 4096; i++)
+			{
+				g_page_committed[i] = false;
+			}
+
+			g_committed_bytes -= count * 4096ull;
+		}
+#endif
 	}
 
 	bool page_protect(u32 addr, u32 size, u8 flags_test, u8 flags_set, u8 flags_clear)
@@ -652,28 +1131,18 @@ namespace vm
 
 		for (u32 i = addr / 4096; i < addr / 4096 + size / 4096; i++)
 		{
-			_reservation_break(i * 4096);
+			_reservation_break_page(i * 4096);
 
-			const u8 f1 = g_pages[i]._or(flags_set & ~flags_inv) & (page_writable | page_readable);
+			std::lock_guard<std::mutex> lock(g_reservation_page_mutex[i % g_reservation_page_mutex.size()]);
+
+			const u8 f1 = g_pages[i]._or(flags_set & ~flags_inv) & (page_writable | page_readable | page_code_watch | page_snapshot);
 			g_pages[i]._and_not(flags_clear & ~flags_inv);
-			const u8 f2 = (g_pages[i] ^= flags_inv) & (page_writable | page_readable);
+			const u8 f2 = (g_pages[i] ^= flags_inv) & (page_writable | page_readable | page_code_watch | page_snapshot);
 
 			if (f1 != f2)
 			{
-				void* real_addr = vm::base(i * 4096);
-
-#ifdef _WIN32
-				DWORD old;
-
-				auto protection = f2 & page_writable ? PAGE_READWRITE : (f2 & page_readable ? PAGE_READONLY : PAGE_NOACCESS);
-				if (!::VirtualProtect(real_addr, 4096, protection, &old))
-#else
-				auto protection = f2 & page_writable ? PROT_WRITE | PROT_READ : (f2 & page_readable ? PROT_READ : PROT_NONE);
-				if (::mprotect(real_addr, 4096, protection))
-#endif
-				{
-					throw EXCEPTION("System failure (addr=0x%x, size=0x%x, flags_test=0x%x, flags_set=0x%x, flags_clear=0x%x)", addr, size, flags_test, flags_set, flags_clear);
-				}
+				// keep the page read-only if it's still reserved
+				_reservation_protect(i * 4096, g_reservation_pages[i] != 0);
 			}
 		}
 
@@ -697,14 +1166,35 @@ namespace vm
 
 		for (u32 i = addr / 4096; i < addr / 4096 + size / 4096; i++)
 		{
-			_reservation_break(i * 4096);
+			_reservation_break_page(i * 4096);
+
+			if (g_pages[i] & page_snapshot)
+			{
+				// keep the contents for the snapshot
+				snapshot_on_write(i * 4096, true);
+			}
+
+			const u8 flags = g_pages[i].exchange(0);
 
-			if (!(g_pages[i].exchange(0) & page_allocated))
+			if (!(flags & page_allocated))
 			{
 				throw EXCEPTION("Concurrent access (addr=0x%x, size=0x%x, current_addr=0x%x)", addr, size, i * 4096);
 			}
+
+			if (flags & page_code_watch)
+			{
+				// code compiled from this page is lost
+				ppu_invalidate_code(i * 4096);
+			}
 		}
 
+		if (size >= g_decommit_min_size)
+		{
+			_page_decommit(addr, size);
+		}
+
+		g_allocated_bytes -= size;
+
 		void* real_addr = vm::base(addr);
 		void* priv_addr = vm::base_priv(addr);
 
@@ -720,16 +1210,23 @@ namespace vm
 		}
 	}
 
-	bool check_addr(u32 addr, u32 size)
+	memory_stats_t get_memory_stats()
+	{
+		return{ g_allocated_bytes.load(), g_committed_bytes.load() };
+	}
+
+	bool check_addr(u32 addr, u32 size, u8 flags)
 	{
 		if (addr + (size - 1) < addr)
 		{
 			return false;
 		}
 
+		flags |= page_allocated;
+
 		for (u32 i = addr / 4096; i <= (addr + size - 1) / 4096; i++)
 		{
-			if ((g_pages[i] & page_allocated) == 0)
+			if ((g_pages[i] & flags) != flags)
 			{
 				return false;
 			}
@@ -791,8 +1288,69 @@ namespace vm
 		}
 	}
 
+	void block_t::free_insert(u32 addr, u32 size)
+	{
+		u64 end = u64{ addr } + size;
+
+		const auto next = m_free.lower_bound(addr);
+
+		// merge with the previous range
+		if (next != m_free.begin())
+		{
+			const auto prev = std::prev(next);
+
+			if (u64{ prev->first } + prev->second == addr)
+			{
+				addr = prev->first;
+				m_free_sizes.erase({ prev->second, prev->first });
+				m_free.erase(prev);
+			}
+		}
+
+		// merge with the next range
+		if (next != m_free.end() && next->first == end)
+		{
+			end += next->second;
+			m_free_sizes.erase({ next->second, next->first });
+			m_free.erase(next);
+		}
+
+		m_free.emplace(addr, static_cast<u32>(end - addr));
+		m_free_sizes.emplace(static_cast<u32>(end - addr), addr);
+	}
+
+	void block_t::free_remove(std::map<u32, u32>::iterator range, u32 addr, u32 size)
+	{
+		const u32 start = range->first;
+		const u64 end = u64{ range->first } + range->second;
+
+		m_free_sizes.erase({ range->second, range->first });
+		m_free.erase(range);
+
+		// keep the parts before and after the allocated range
+		if (addr > start)
+		{
+			m_free.emplace(start, addr - start);
+			m_free_sizes.emplace(addr - start, start);
+		}
+
+		if (u64{ addr } + size < end)
+		{
+			m_free.emplace(addr + size, static_cast<u32>(end - addr - size));
+			m_free_sizes.emplace(static_cast<u32>(end - addr - size), addr + size);
+		}
+	}
+
 	bool block_t::try_alloc(u32 addr, u32 size)
 	{
+		// find the free range containing the area
+		auto range = m_free.upper_bound(addr);
+
+		if (range == m_free.begin() || (--range, u64{ range->first } + range->second < u64{ addr } + size))
+		{
+			return false;
+		}
+
 		// check if memory area is already mapped
 		for (u32 i = addr / 4096; i <= (addr + size - 1) / 4096; i++)
 		{
@@ -829,6 +1387,8 @@ namespace vm
 		// add entry
 		m_map[addr] = size;
 
+		free_remove(range, addr, size);
+
 		return true;
 	}
 
@@ -862,12 +1422,19 @@ namespace vm
 			return 0;
 		}
 
-		// search for an appropriate place (unoptimized)
-		for (u32 addr = ::align(this->addr, align); addr < this->addr + this->size - 1; addr += align)
+		if (used + size > this->size)
+		{
+			return 0;
+		}
+
+		// best fit: the smallest free range (at the lowest address) which can hold the aligned area
+		for (auto it = m_free_sizes.lower_bound({ size, 0 }); it != m_free_sizes.end(); it++)
 		{
-			if (try_alloc(addr, size))
+			const u64 addr = ::align<u64>(it->second, align);
+
+			if (addr + size <= u64{ it->second } + it->first && try_alloc(static_cast<u32>(addr), size))
 			{
-				return addr;
+				return static_cast<u32>(addr);
 			}
 
 			if (used + size > this->size)
@@ -876,6 +1443,10 @@ namespace vm
 			}
 		}
 
+		const u32 largest = m_free_sizes.empty() ? 0 : m_free_sizes.rbegin()->first;
+
+		LOG_WARNING(MEMORY, "vm::block_t::alloc(size=0x%x, align=0x%x) failed: used=0x%x/0x%x, %u free ranges, largest=0x%x", size, align, used.load(), this->size, m_free.size(), largest);
+
 		return 0;
 	}
 
@@ -913,6 +1484,8 @@ namespace vm
 			// remove entry
 			m_map.erase(found);
 
+			free_insert(addr, size);
+
 			// return "physical" memory
 			used -= size;
 
@@ -1006,6 +1579,26 @@ namespace vm
 		return nullptr;
 	}
 
+	// Ask the host to back the range with huge pages (reduces TLB misses of JIT code, pages with fine-grained protection are split by the host)
+	void _advise_huge_pages(u32 addr, u32 size)
+	{
+		if (!rpcs3::state.config.core.huge_pages.value())
+		{
+			return;
+		}
+
+#if defined(MADV_HUGEPAGE)
+		// the memory is a shared mapping, so shmem THP must be allowed (/sys/kernel/mm/transparent_hugepage/shmem_enabled)
+		if (::madvise(g_base_addr + addr, size, MADV_HUGEPAGE) || ::madvise(g_priv_addr + addr, size, MADV_HUGEPAGE))
+		{
+			LOG_WARNING(MEMORY, "madvise(MADV_HUGEPAGE) failed (addr=0x%x, size=0x%x, errno=%d)", addr, size, errno);
+		}
+#else
+		// large pages can't back a file mapping committed page by page (Windows) or aren't available
+		LOG_WARNING(MEMORY, "Huge pages are not supported on this platform (addr=0x%x, size=0x%x)", addr, size);
+#endif
+	}
+
 	namespace ps3
 	{
 		void init()
@@ -1019,6 +1612,11 @@ namespace vm
 				std::make_shared<block_t>(0xE0000000, 0x20000000), // SPU reserved
 			};
 
+			// main memory (also contains SPU LS), video memory and SPU LS mirrors
+			_advise_huge_pages(0x00000000, 0x20000000);
+			_advise_huge_pages(0xC0000000, 0x10000000);
+			_advise_huge_pages(0xE0000000, 0x20000000);
+
 			vm::start();
 		}
 	}
@@ -26,6 +26,8 @@ namespace vm
 
 		page_fault_notification = (1 << 3),
 		page_no_reservations    = (1 << 4),
+		page_code_watch         = (1 << 5), // the page is kept read-only, writes invalidate compiled code (see ppu_on_code_write())
+		page_snapshot           = (1 << 6), // the page is kept read-only until it's copied by the active memory snapshot (see snapshot_t)
 
 		page_allocated          = (1 << 7),
 	};
@@ -34,6 +36,7 @@ namespace vm
 	{
 		u32 addr = 0;
 		u32 mask = ~0;
+		u32 bucket_addr = 0; // address used to select the wait table bucket (addr is reset after notification)
 		named_thread_t* thread = nullptr;
 
 		std::function<bool()> pred;
@@ -44,6 +47,7 @@ namespace vm
 		{
 			this->addr = addr;
 			this->mask = ~(size - 1);
+			this->bucket_addr = addr;
 			this->thread = &thread;
 
 			// must be null at this point
@@ -60,19 +64,22 @@ namespace vm
 
 	class waiter_lock_t
 	{
-		waiter_t* m_waiter;
+		waiter_t m_waiter; // registered in the wait table bucket of its address while the lock exists
 		std::unique_lock<std::mutex> m_lock;
 
 	public:
 		waiter_lock_t(named_thread_t& thread, u32 addr, u32 size);
 
-		waiter_t* operator ->() const
+		waiter_t* operator ->()
 		{
-			return m_waiter;
+			return &m_waiter;
 		}
 
 		void wait();
 
+		// Same as wait(), returns false if the timeout (us) expired before the predicate passed
+		bool wait_for(u64 timeout);
+
 		~waiter_lock_t();
 	};
 
@@ -82,6 +89,17 @@ namespace vm
 		// return immediately if condition passed (optimistic case)
 		if (pred(args...)) return;
 
+		// spin shortly before sleeping, sync primitives are usually released within microseconds
+		for (u32 i = 0; i < 200; i++)
+		{
+			_mm_pause();
+			_mm_pause();
+			_mm_pause();
+			_mm_pause();
+
+			if (pred(args...)) return;
+		}
+
 		// initialize waiter and locker
 		waiter_lock_t lock(thread, addr, size);
 
@@ -92,21 +110,30 @@ namespace vm
 		lock.wait();
 	}
 
+	// Wait until data at addr (aligned, size up to 8) changes or the timeout (us) expires, used to idle guest spin loops
+	// Plain stores don't notify waiters, so the change is only seen on notify_at(), reservation updates or the slow poll
+	void wait_change(named_thread_t& thread, u32 addr, u32 size, u64 timeout);
+
 	// Notify waiters on specific addr, addr must be aligned to size which must be a power of 2
 	void notify_at(u32 addr, u32 size);
 
-	// Try to poll each waiter's condition (false if try_lock failed)
+	// Poll each waiter's condition (returns true if all waiters were signaled)
 	bool notify_all();
 
+	// Reservations are tracked per 128-byte line (hashed line versions), so several threads may hold
+	// reservations at the same time (each thread holds at most one); a reservation is lost when its line is modified.
+	// Normal writes are detected either by keeping reserved pages read-only (page_protection mode, see reservation_query())
+	// or by comparing reserved data on update (line_compare mode, doesn't detect ABA changes made by normal writes).
+	// 4 and 8-byte reservations (PPU lwarx/ldarx) are always compared on update (by host cmpxchg) and never change memory protection.
 	// This flag is changed by various reservation functions and may have different meaning.
-	// reservation_break() - true if the reservation was successfully broken.
-	// reservation_acquire() - true if another existing reservation was broken.
+	// reservation_break() - true if the line may have been reserved.
+	// reservation_acquire() - true if the previous reservation of this thread was removed.
 	// reservation_free() - true if this thread's reservation was successfully removed.
 	// reservation_op() - false if reservation_update() would succeed if called instead.
-	// Write access to reserved memory - only set to true if the reservation was broken.
+	// Write access to reserved memory - only set to true if the reservations were broken.
 	extern thread_local bool g_tls_did_break_reservation;
 
-	// Unconditionally break the reservation at specified address
+	// Unconditionally break all reservations of the line at specified address
 	void reservation_break(u32 addr);
 
 	// Reserve memory at the specified address for further atomic update
@@ -118,21 +145,35 @@ namespace vm
 	// Process a memory access error if it's caused by the reservation
 	bool reservation_query(u32 addr, u32 size, bool is_writing, std::function<bool()> callback);
 
-	// Returns true if the current thread owns reservation
+	// Returns true if the thread owns reservation which is not lost
 	bool reservation_test(const thread_ctrl* current = thread_ctrl::get_current());
 
-	// Break all reservations created by the current thread
+	// Remove the reservation of the current thread (must be called on thread exit)
 	void reservation_free();
 
 	// Perform atomic operation unconditionally
 	void reservation_op(u32 addr, u32 size, std::function<void()> proc);
 
+	// Process a write (or unmapping) of a page protected by the active memory snapshot, returns false if the page isn't protected by it.
+	// Privileged writes don't fault, so it must be called before them (defined in MemorySnapshot.cpp).
+	bool snapshot_on_write(u32 addr, bool unmap = false);
+
 	// Change memory protection of specified memory region
 	bool page_protect(u32 addr, u32 size, u8 flags_test = 0, u8 flags_set = 0, u8 flags_clear = 0);
 
+	struct memory_stats_t
+	{
+		u64 allocated; // mapped guest pages (bytes)
+		u64 committed; // guest pages backed by host memory, including freed ones not released yet (bytes)
+	};
+
+	// Get the amount of guest memory allocated and committed (freed ranges of at least 64 KB are released to the host)
+	memory_stats_t get_memory_stats();
+
 	// Check if existing memory range is allocated. Checking address before using it is very unsafe.
 	// Return value may be wrong. Even if it's true and correct, actual memory protection may be read-only and no-access.
-	bool check_addr(u32 addr, u32 size = 1);
+	// Optionally, all pages must have the specified flags.
+	bool check_addr(u32 addr, u32 size = 1, u8 flags = 0);
 
 	// Search and map memory in specified memory location (don't pass alignment smaller than 4096)
 	u32 alloc(u32 size, memory_location_t location, u32 align = 4096);
@@ -150,10 +191,18 @@ namespace vm
 	class block_t final
 	{
 		std::map<u32, u32> m_map; // addr -> size mapping of mapped locations
+		std::map<u32, u32> m_free; // addr -> size mapping of free ranges (adjacent ranges are merged)
+		std::set<std::pair<u32, u32>> m_free_sizes; // (size, addr) of free ranges, for best-fit search
 		std::mutex m_mutex;
 
 		bool try_alloc(u32 addr, u32 size);
 
+		// Add the range to the free list
+		void free_insert(u32 addr, u32 size);
+
+		// Remove the allocated range from the free range containing it
+		void free_remove(std::map<u32, u32>::iterator range, u32 addr, u32 size);
+
 	public:
 		block_t(u32 addr, u32 size, u64 flags = 0)
 			: addr(addr)
@@ -161,6 +210,7 @@ namespace vm
 			, flags(flags)
 			, used(0)
 		{
+			free_insert(addr, size);
 		}
 
 		~block_t();
@@ -398,40 +448,10 @@ namespace vm
 
 namespace vm
 {
-	class stack
-	{
-		u32 m_begin;
-		u32 m_size;
-		int m_page_size;
-		int m_position;
-		u8 m_align;
-
-	public:
-		void init(u32 begin, u32 size, u32 page_size = 180, u8 align = 0x10)
-		{
-			m_begin = begin;
-			m_size = size;
-			m_page_size = page_size;
-			m_position = 0;
-			m_align = align;
-		}
-
-		u32 alloc_new_page()
-		{
-			assert(m_position + m_page_size < (int)m_size);
-			m_position += (int)m_page_size;
-			return m_begin + m_position;
-		}
-
-		u32 dealloc_new_page()
-		{
-			assert(m_position - m_page_size > 0);
-			m_position -= (int)m_page_size;
-			return m_begin + m_position;
-		}
-	};
-
+	// Allocate memory on the current thread's guest stack (LIFO bump allocation by moving the stack pointer, used by vm::var)
 	u32 stack_push(u32 size, u32 align_v);
+
+	// Release memory allocated by stack_push() (must be the last allocation)
 	void stack_pop(u32 addr, u32 size);
 }
 
@@ -0,0 +1,331 @@
+#include "stdafx.h"
+#include "PerfCounters.h"
+#include "Emu/Memory/vm.h"
+#include "Emu/IdManager.h"
+#include "Emu/Cell/SPUThread.h"
+#include "Emu/Cell/RawSPUThread.h"
+
+extern u64 get_system_time();
+
+namespace perf
+{
+	std::atomic<bool> g_log_stats{ false };
+
+	// Counters of a thread (only written by the owner thread, blocks of finished threads are reused)
+	struct block_t
+	{
+		u8 pad0[64]; // keep the counters away from cache lines of other allocations
+		std::atomic<u64> values[counter_count];
+		u8 pad1[64];
+	};
+
+	static std::mutex g_mutex;
+	static std::vector<std::unique_ptr<block_t>> g_blocks;
+	static std::vector<block_t*> g_free_blocks;
+
+	// Host memory accounting (zero-initialized before any dynamic initialization, can be used by static objects)
+	static std::atomic<s64> g_memory[memory_tag_count];
+	static std::atomic<s64> g_memory_peak[memory_tag_count];
+
+	// Last update
+	static u64 g_update_time = 0;
+	static u64 g_memory_log_time = 0;
+	static stats_t g_stats{};
+
+	// SPU thread counters of the last update (by thread type and ID)
+	struct spu_snapshot_t
+	{
+		u64 instructions;
+		u64 blocks;
+		u64 wait_time;
+		u64 dma_bytes;
+		u64 putllc;
+		u64 putllc_failures;
+	};
+
+	static std::unordered_map<u64, spu_snapshot_t> g_spu_snapshots;
+
+	static void update_spu(double elapsed)
+	{
+		std::unordered_map<u64, spu_snapshot_t> snapshots;
+
+		g_stats.spu_threads.clear();
+
+		const auto add_thread = [&](SPUThread& spu)
+		{
+			const auto& stats = spu.stats;
+
+			spu_snapshot_t current{ stats.instructions, stats.blocks, 0, stats.mfc_get_bytes + stats.mfc_put_bytes, stats.mfc_cmds[spu_stats_t::mfc_putllc], stats.putllc_failures };
+
+			// channel with the longest total wait
+			u32 top = spu_stats_t::no_channel;
+
+			for (u32 ch = 0; ch <= spu_stats_t::no_channel; ch++)
+			{
+				current.wait_time += stats.ch_wait_time[ch];
+
+				if (stats.ch_wait_time[ch] > stats.ch_wait_time[top])
+				{
+					top = ch;
+				}
+			}
+
+			const u64 key = u64{ spu.get_type() } << 32 | spu.get_id();
+			const auto found = g_spu_snapshots.find(key);
+			const spu_snapshot_t prev = found != g_spu_snapshots.end() ? found->second : spu_snapshot_t{};
+
+			snapshots[key] = current;
+
+			const u64 putllc = current.putllc - prev.putllc;
+
+			g_stats.spu_threads.emplace_back(fmt::format("%s: %.0f instructions/s, %.0f functions/s, %.0f%% waiting (mostly %s), DMA %.1f MB/s, PUTLLC %.0f/s (%.0f%% failed)",
+				spu.GetFName(),
+				(current.instructions - prev.instructions) / elapsed,
+				(current.blocks - prev.blocks) / elapsed,
+				std::min((current.wait_time - prev.wait_time) / elapsed / 10000., 100.),
+				spu_stats_t::get_channel_name(top),
+				(current.dma_bytes - prev.dma_bytes) / elapsed / 1048576.,
+				putllc / elapsed,
+				putllc ? (current.putllc_failures - prev.putllc_failures) * 100. / putllc : 0.));
+		};
+
+		for (auto& spu : idm::get_all<SPUThread>())
+		{
+			add_thread(*spu);
+		}
+
+		for (auto& spu : idm::get_all<RawSPUThread>())
+		{
+			add_thread(*spu);
+		}
+
+		g_spu_snapshots = std::move(snapshots);
+	}
+
+	// Returns the block to the free list when the thread exits (the values are kept)
+	struct thread_block_t
+	{
+		block_t* block = nullptr;
+
+		~thread_block_t()
+		{
+			if (block)
+			{
+				std::lock_guard<std::mutex> lock(g_mutex);
+
+				g_free_blocks.emplace_back(block);
+			}
+		}
+	};
+
+	static thread_local thread_block_t g_tls_block;
+
+	static block_t* get_block()
+	{
+		if (!g_tls_block.block)
+		{
+			std::lock_guard<std::mutex> lock(g_mutex);
+
+			if (g_free_blocks.size())
+			{
+				g_tls_block.block = g_free_blocks.back();
+				g_free_blocks.pop_back();
+			}
+			else
+			{
+				g_blocks.emplace_back(new block_t{});
+				g_tls_block.block = g_blocks.back().get();
+			}
+		}
+
+		return g_tls_block.block;
+	}
+}
+
+const char* perf::get_name(counter_t counter)
+{
+	switch (counter)
+	{
+	case ppu_instructions: return "PPU instructions";
+	case ppu_blocks: return "PPU blocks";
+	case spu_instructions: return "SPU instructions";
+	case spu_blocks: return "SPU blocks";
+	case jit_hits: return "JIT hits";
+	case jit_misses: return "JIT misses";
+	case draws: return "Draws";
+	case flips: return "Flips";
+	case texture_uploads: return "Texture uploads";
+	case texture_partial_uploads: return "Partial texture uploads";
+	case dma_bytes: return "DMA bytes";
+	case syscalls: return "Syscalls";
+	case spin_waits: return "Spin loop waits";
+	case counter_count: break;
+	}
+
+	return "Unknown";
+}
+
+const char* perf::get_name(memory_tag_t tag)
+{
+	switch (tag)
+	{
+	case mem_ppu_jit: return "PPU JIT";
+	case mem_spu_jit: return "SPU JIT";
+	case mem_ppu_decoder: return "PPU decoder cache";
+	case mem_spu_database: return "SPU database";
+	case mem_shader_cache: return "Shader cache";
+	case mem_gpu_heaps: return "GPU heaps";
+	case mem_texture_cache: return "Texture cache";
+	case mem_log: return "Log buffers";
+	case memory_tag_count: break;
+	}
+
+	return "Unknown";
+}
+
+void perf::mem_add(memory_tag_t tag, s64 bytes)
+{
+	const s64 value = g_memory[tag] += bytes;
+
+	for (s64 peak = g_memory_peak[tag]; value > peak && !g_memory_peak[tag].compare_exchange_weak(peak, value);)
+	{
+	}
+}
+
+void perf::log_memory()
+{
+	std::string text;
+
+	for (u32 i = 0; i < memory_tag_count; i++)
+	{
+		text += fmt::format("%s%s: %.1f MB (peak %.1f MB)", i ? "; " : "", get_name(static_cast<memory_tag_t>(i)), g_memory[i] / 1048576., g_memory_peak[i] / 1048576.);
+	}
+
+	LOG_NOTICE(GENERAL, "Host memory: %s", text);
+}
+
+void perf::add(counter_t counter, u64 value)
+{
+	auto& v = get_block()->values[counter];
+
+	// single writer: no need for a locked instruction
+	v.store(v.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+void perf::reset()
+{
+	std::lock_guard<std::mutex> lock(g_mutex);
+
+	for (auto& block : g_blocks)
+	{
+		for (auto& v : block->values)
+		{
+			v.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	for (u32 i = 0; i < memory_tag_count; i++)
+	{
+		g_memory_peak[i] = g_memory[i].load();
+	}
+
+	g_update_time = get_system_time();
+	g_stats = {};
+	g_spu_snapshots.clear();
+}
+
+bool perf::update(bool force)
+{
+	const u64 time = get_system_time();
+
+	std::lock_guard<std::mutex> lock(g_mutex);
+
+	if (time - g_update_time < 1000000 && (!force || time == g_update_time))
+	{
+		return false;
+	}
+
+	const double elapsed = (time - g_update_time) / 1000000.;
+
+	for (u32 i = 0; i < counter_count; i++)
+	{
+		u64 total = 0;
+
+		for (auto& block : g_blocks)
+		{
+			total += block->values[i].load(std::memory_order_relaxed);
+		}
+
+		// the total may decrease if reset concurrently
+		g_stats.rate[i] = total >= g_stats.total[i] ? (total - g_stats.total[i]) / elapsed : 0.;
+		g_stats.total[i] = total;
+	}
+
+	const auto memory = vm::get_memory_stats();
+	g_stats.memory_allocated = memory.allocated;
+	g_stats.memory_committed = memory.committed;
+
+	for (u32 i = 0; i < memory_tag_count; i++)
+	{
+		g_stats.memory[i] = std::max<s64>(g_memory[i], 0);
+		g_stats.memory_peak[i] = std::max<s64>(g_memory_peak[i], 0);
+	}
+
+	update_spu(elapsed);
+
+	g_update_time = time;
+
+	if (g_log_stats)
+	{
+		std::string text;
+
+		for (auto& line : format_stats(g_stats))
+		{
+			text += text.empty() ? line : "; " + line;
+		}
+
+		LOG_NOTICE(GENERAL, "Perf: %s", text);
+	}
+
+	// Host memory usage is logged once per minute
+	if (time - g_memory_log_time >= 60000000)
+	{
+		g_memory_log_time = time;
+		log_memory();
+	}
+
+	return true;
+}
+
+perf::stats_t perf::get_stats()
+{
+	std::lock_guard<std::mutex> lock(g_mutex);
+
+	return g_stats;
+}
+
+std::vector<std::string> perf::format_stats(const stats_t& stats)
+{
+	std::vector<std::string> result;
+
+	for (u32 i = 0; i < counter_count; i++)
+	{
+		result.emplace_back(fmt::format("%s: %llu (%.0f/s)", get_name(static_cast<counter_t>(i)), stats.total[i], stats.rate[i]));
+	}
+
+	if (stats.rate[flips])
+	{
+		result.emplace_back(fmt::format("Draws per frame: %.1f", stats.rate[draws] / stats.rate[flips]));
+	}
+
+	result.emplace_back(fmt::format("Guest memory: %llu MB allocated, %llu MB committed", stats.memory_allocated >> 20, stats.memory_committed >> 20));
+
+	for (u32 i = 0; i < memory_tag_count; i++)
+	{
+		result.emplace_back(fmt::format("%s memory: %.1f MB (peak %.1f MB)", get_name(static_cast<memory_tag_t>(i)), stats.memory[i] / 1048576., stats.memory_peak[i] / 1048576.));
+	}
+
+	result.insert(result.end(), stats.spu_threads.begin(), stats.spu_threads.end());
+
+	return result;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+// Emulator-wide performance counters.
+// Every thread increments its own block of counters (no shared cache lines on the hot path), readers sum all blocks.
+// Rates are recomputed at most once per second by update() (called on flips and by the GUI); the results are shown
+// by the performance overlay, the Performance Counters dialog and logged if requested with the --perf switch.
+namespace perf
+{
+	enum counter_t : u32
+	{
+		ppu_instructions, // interpreted PPU instructions
+		ppu_blocks, // compiled PPU blocks executed
+		spu_instructions, // interpreted SPU instructions
+		spu_blocks, // compiled SPU functions executed
+		jit_hits, // compiled code found
+		jit_misses, // interpreter fallback (code not compiled yet)
+		draws,
+		flips,
+		texture_uploads,
+		texture_partial_uploads, // rows of a cached texture updated after a write
+		dma_bytes, // MFC transfers
+		syscalls,
+		spin_waits, // guest spin loops idled in the host
+
+		counter_count
+	};
+
+	// Host memory accounting tags (bytes currently used by the subsystem)
+	enum memory_tag_t : u32
+	{
+		mem_ppu_jit, // PPU LLVM code arena and function table
+		mem_spu_jit, // SPU ASMJIT code
+		mem_ppu_decoder, // PPU interpreter decoder cache (committed pages)
+		mem_spu_database, // SPU function copies and analysis
+		mem_shader_cache, // shader binaries kept in memory
+		mem_gpu_heaps, // upload heaps and ring buffers of the renderer
+		mem_texture_cache, // cached textures (estimated from the guest size in GL)
+		mem_log, // log queue, timeline and trace buffers
+
+		memory_tag_count
+	};
+
+	struct stats_t
+	{
+		u64 total[counter_count]; // since reset
+		double rate[counter_count]; // per second, computed by the last update
+		u64 memory_allocated; // guest memory (bytes, see vm::get_memory_stats())
+		u64 memory_committed;
+		u64 memory[memory_tag_count]; // host memory by subsystem (bytes)
+		u64 memory_peak[memory_tag_count]; // since reset
+		std::vector<std::string> spu_threads; // execution rates of each SPU thread (formatted)
+	};
+
+	// Get counter name
+	const char* get_name(counter_t counter);
+
+	// Add value to the counter of the current thread
+	void add(counter_t counter, u64 value = 1);
+
+	// Get memory tag name
+	const char* get_name(memory_tag_t tag);
+
+	// Account host memory allocated (positive) or freed (negative) by a subsystem (not for hot paths: shared counters)
+	void mem_add(memory_tag_t tag, s64 bytes);
+
+	// Set all counters to zero (called on emulation start)
+	void reset();
+
+	// Recompute rates if at least a second elapsed since the previous update or if forced (returns true if updated)
+	bool update(bool force = false);
+
+	// Get totals and rates of the last update
+	stats_t get_stats();
+
+	// Format stats (one line per counter, the average draw count per frame, guest memory, host memory usage by subsystem and SPU threads)
+	std::vector<std::string> format_stats(const stats_t& stats);
+
+	// Log host memory usage by subsystem
+	void log_memory();
+
+	// Log stats on each update (set by the --perf command line switch)
+	extern std::atomic<bool> g_log_stats;
+}
@@ -26,6 +26,99 @@ namespace
 	}
 }
 
+namespace
+{
+	template<typename T>
+	__m128i get_swap_mask();
+
+	template<>
+	__m128i get_swap_mask<u16>()
+	{
+		return _mm_set_epi8(14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1);
+	}
+
+	template<>
+	__m128i get_swap_mask<u32>()
+	{
+		return _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+	}
+
+	/**
+	 * Byte swap count vectors of N components from a strided big endian array to a packed host array.
+	 * If the host vector is larger (3 components 16 bit vectors), the extra component is set to pad.
+	 */
+	template<typename T, u32 N>
+	void write_swapped_vertex_array(u8 *dst, u32 dst_stride, const u8 *src, u32 src_stride, u32 count, T pad = 0)
+	{
+		static const u32 src_size = N * sizeof(T);
+		const bool has_pad = dst_stride > src_size;
+
+		if (src_stride == src_size && !has_pad)
+		{
+			be_to_native((T*)dst, (const be_t<T>*)src, (size_t)count * N);
+			return;
+		}
+
+		u32 i = 0;
+
+		if (src_size > 4 && count)
+		{
+			// 8 or 16 bytes loads and stores may go past the vector, the last ones are left to the scalar loop
+			const __m128i mask = get_swap_mask<T>();
+			const u32 load_size = src_size > 8 ? 16 : 8;
+			const u32 store_size = dst_stride > 8 ? 16 : 8;
+			const u64 src_end = (u64)(count - 1) * src_stride + src_size;
+			const u64 dst_end = (u64)count * dst_stride;
+
+			for (; i < count; i++)
+			{
+				if ((u64)i * src_stride + load_size > src_end || (u64)i * dst_stride + store_size > dst_end)
+					break;
+
+				const u8 *vector_src = src + (size_t)i * src_stride;
+				u8 *vector_dst = dst + (size_t)i * dst_stride;
+
+				__m128i value = load_size == 16 ? _mm_loadu_si128((const __m128i*)vector_src) : _mm_loadl_epi64((const __m128i*)vector_src);
+				value = _mm_shuffle_epi8(value, mask);
+
+				if (sizeof(T) == 2 && N == 3 && has_pad)
+					value = _mm_insert_epi16(value, pad, 3);
+
+				if (store_size == 16)
+					_mm_storeu_si128((__m128i*)vector_dst, value);
+				else
+					_mm_storel_epi64((__m128i*)vector_dst, value);
+			}
+		}
+
+		for (; i < count; i++)
+		{
+			const be_t<T> *c_src = (const be_t<T>*)(src + (size_t)i * src_stride);
+			T *c_dst = (T*)(dst + (size_t)i * dst_stride);
+
+			for (u32 j = 0; j < N; ++j)
+			{
+				c_dst[j] = c_src[j];
+			}
+			if (has_pad)
+				c_dst[N] = pad;
+		}
+	}
+
+	template<typename T>
+	void write_swapped_vertex_array(u8 *dst, u32 dst_stride, const u8 *src, u32 src_stride, u32 count, u32 size, T pad = 0)
+	{
+		switch (size)
+		{
+		case 1: write_swapped_vertex_array<T, 1>(dst, dst_stride, src, src_stride, count, pad); return;
+		case 2: write_swapped_vertex_array<T, 2>(dst, dst_stride, src, src_stride, count, pad); return;
+		case 3: write_swapped_vertex_array<T, 3>(dst, dst_stride, src, src_stride, count, pad); return;
+		case 4: write_swapped_vertex_array<T, 4>(dst, dst_stride, src, src_stride, count, pad); return;
+		}
+		throw new EXCEPTION("Wrong vector size");
+	}
+}
+
 // FIXME: these functions shouldn't access rsx::method_registers (global)
 
 void write_vertex_array_data_to_buffer(void *buffer, u32 first, u32 count, size_t index, const rsx::data_array_format_info &vertex_array_desc)
@@ -43,6 +136,38 @@ void write_vertex_array_data_to_buffer(void *buffer, u32 first, u32 count, size_
 	u32 base_offset = rsx::method_registers[NV4097_SET_VERTEX_DATA_BASE_OFFSET];
 	u32 base_index = rsx::method_registers[NV4097_SET_VERTEX_DATA_BASE_INDEX];
 
+	const u8 *src = vm::ps3::_ptr<const u8>(address + base_offset + vertex_array_desc.stride * (first + base_index));
+	u8 *dst = (u8*)buffer;
+
+	// Whole arrays are converted by kernels specialized on component type and count
+	switch (vertex_array_desc.type)
+	{
+	case Vertex_base_type::ub:
+		if (vertex_array_desc.stride == element_size && element_size == vertex_array_desc.size)
+		{
+			memcpy(dst, src, (size_t)count * element_size);
+			return;
+		}
+		for (u32 i = 0; i < count; ++i)
+		{
+			memcpy(dst + i * element_size, src + vertex_array_desc.stride * i, vertex_array_desc.size);
+		}
+		return;
+
+	case Vertex_base_type::s1:
+	case Vertex_base_type::sf:
+		write_swapped_vertex_array<u16>(dst, element_size, src, vertex_array_desc.stride, count, vertex_array_desc.size, 0x3800);
+		return;
+
+	case Vertex_base_type::f:
+	case Vertex_base_type::s32k:
+		write_swapped_vertex_array<u32>(dst, element_size, src, vertex_array_desc.stride, count, vertex_array_desc.size);
+		return;
+
+	default:
+		break;
+	}
+
 	for (u32 i = 0; i < count; ++i)
 	{
 		auto src = vm::ps3::_ptr<const u8>(address + base_offset + vertex_array_desc.stride * (first + i + base_index));
@@ -50,27 +175,6 @@ void write_vertex_array_data_to_buffer(void *buffer, u32 first, u32 count, size_
 
 		switch (vertex_array_desc.type)
 		{
-		case Vertex_base_type::ub:
-			memcpy(dst, src, vertex_array_desc.size);
-			break;
-
-		case Vertex_base_type::s1:
-		case Vertex_base_type::sf:
-		{
-			auto* c_src = (const be_t<u16>*)src;
-			u16* c_dst = (u16*)dst;
-
-			for (u32 j = 0; j < vertex_array_desc.size; ++j)
-			{
-				*c_dst++ = *c_src++;
-			}
-			if (vertex_array_desc.size * sizeof(u16) < element_size)
-				*c_dst++ = 0x3800;
-			break;
-		}
-
-		case Vertex_base_type::f:
-		case Vertex_base_type::s32k:
 		case Vertex_base_type::ub256:
 		{
 			auto* c_src = (const be_t<u32>*)src;
@@ -93,35 +197,132 @@ void write_vertex_array_data_to_buffer(void *buffer, u32 first, u32 count, size_
 			c_dst[3] = decoded_vector[3];
 			break;
 		}
+		default:
+			break;
 		}
 	}
 }
 
 namespace
 {
-template<typename T>
-std::tuple<T, T> upload_untouched(gsl::span<to_be_t<const T>> src, gsl::span<T> dst, bool is_primitive_restart_enabled, T primitive_restart_index)
-{
-	T min_index = -1;
-	T max_index = 0;
+	/**
+	 * SSE helpers for index buffer conversion.
+	 * SSE2/SSSE3 only have signed 16 bit min/max, and no 32 bit min/max at all: values are biased
+	 * by flipping the sign bit so that signed compares order them as unsigned.
+	 */
+	template<typename T>
+	struct index_vector;
 
-	Expects(dst.size_bytes() >= src.size_bytes());
+	template<>
+	struct index_vector<u16>
+	{
+		static __m128i swap_mask() { return _mm_set_epi8(14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1); }
+		static __m128i set1(u16 value) { return _mm_set1_epi16(value); }
+		static __m128i bias() { return _mm_set1_epi16((s16)0x8000); }
+		static __m128i cmpeq(__m128i a, __m128i b) { return _mm_cmpeq_epi16(a, b); }
+		static __m128i min(__m128i a, __m128i b) { return _mm_min_epi16(a, b); }
+		static __m128i max(__m128i a, __m128i b) { return _mm_max_epi16(a, b); }
+	};
+
+	template<>
+	struct index_vector<u32>
+	{
+		static __m128i swap_mask() { return _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3); }
+		static __m128i set1(u32 value) { return _mm_set1_epi32(value); }
+		static __m128i bias() { return _mm_set1_epi32(0x80000000); }
+		static __m128i cmpeq(__m128i a, __m128i b) { return _mm_cmpeq_epi32(a, b); }
 
-	size_t dst_idx = 0;
-	for (T index : src)
+		static __m128i min(__m128i a, __m128i b)
+		{
+			const __m128i a_greater = _mm_cmpgt_epi32(a, b);
+			return _mm_or_si128(_mm_and_si128(a_greater, b), _mm_andnot_si128(a_greater, a));
+		}
+
+		static __m128i max(__m128i a, __m128i b)
+		{
+			const __m128i a_greater = _mm_cmpgt_epi32(a, b);
+			return _mm_or_si128(_mm_and_si128(a_greater, a), _mm_andnot_si128(a_greater, b));
+		}
+	};
+
+	/**
+	 * Byte swap count indexes 32 bytes at a time, the scalar loop handles the remaining ones.
+	 * Restart indexes become -1 and are ignored by min/max.
+	 */
+	template<typename T>
+	std::tuple<T, T> swap_indexes(const be_t<T>* src, T* dst, size_t count, bool is_primitive_restart_enabled, T primitive_restart_index)
 	{
-		if (is_primitive_restart_enabled && index == primitive_restart_index)
+		using vector = index_vector<T>;
+		static const size_t vector_count = 16 / sizeof(T);
+
+		const __m128i swap_mask = vector::swap_mask();
+		const __m128i bias = vector::bias();
+		const __m128i restart = vector::set1(primitive_restart_index);
+		__m128i min = _mm_xor_si128(vector::set1((T)-1), bias);
+		__m128i max = _mm_xor_si128(vector::set1(0), bias);
+
+		auto process = [&](size_t i)
 		{
-			index = -1;
+			const __m128i value = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + i)), swap_mask);
+			const __m128i cut = is_primitive_restart_enabled ? vector::cmpeq(value, restart) : _mm_setzero_si128();
+			_mm_storeu_si128((__m128i*)(dst + i), _mm_or_si128(value, cut));
+			min = vector::min(min, _mm_xor_si128(_mm_or_si128(value, cut), bias));
+			max = vector::max(max, _mm_xor_si128(_mm_andnot_si128(cut, value), bias));
+		};
+
+		size_t i = 0;
+		for (; i + 2 * vector_count <= count; i += 2 * vector_count)
+		{
+			process(i);
+			process(i + vector_count);
 		}
-		else
+
+		for (; i + vector_count <= count; i += vector_count)
+		{
+			process(i);
+		}
+
+		alignas(16) T min_lanes[vector_count];
+		alignas(16) T max_lanes[vector_count];
+		_mm_store_si128((__m128i*)min_lanes, _mm_xor_si128(min, bias));
+		_mm_store_si128((__m128i*)max_lanes, _mm_xor_si128(max, bias));
+
+		T min_index = -1;
+		T max_index = 0;
+
+		for (size_t lane = 0; lane < vector_count; lane++)
 		{
-			max_index = MAX2(max_index, index);
-			min_index = MIN2(min_index, index);
+			min_index = MIN2(min_index, min_lanes[lane]);
+			max_index = MAX2(max_index, max_lanes[lane]);
 		}
-		dst[dst_idx++] = index;
+
+		for (; i < count; i++)
+		{
+			T index = src[i];
+			if (is_primitive_restart_enabled && index == primitive_restart_index)
+			{
+				index = -1;
+			}
+			else
+			{
+				max_index = MAX2(max_index, index);
+				min_index = MIN2(min_index, index);
+			}
+			dst[i] = index;
+		}
+
+		return std::make_tuple(min_index, max_index);
 	}
-	return std::make_tuple(min_index, max_index);
+
+	// Expansion functions convert source indexes to a stack buffer first, then only shuffle host values
+	const size_t index_chunk_size = 1024;
+
+template<typename T>
+std::tuple<T, T> upload_untouched(gsl::span<to_be_t<const T>> src, gsl::span<T> dst, bool is_primitive_restart_enabled, T primitive_restart_index)
+{
+	Expects(dst.size_bytes() >= src.size_bytes());
+
+	return swap_indexes<T>(src.data(), dst.data(), src.size(), is_primitive_restart_enabled, primitive_restart_index);
 }
 
 // FIXME: expanded primitive type may not support primitive restart correctly
@@ -133,43 +334,33 @@ std::tuple<T, T> expand_indexed_triangle_fan(gsl::span<to_be_t<const T>> src, gs
 
 	Expects(dst.size() >= 3 * (src.size() - 2));
 
-	const T index0 = src[0];
-	if (!is_primitive_restart_enabled || index0 != -1) // Cut
-	{
-		min_index = MIN2(min_index, index0);
-		max_index = MAX2(max_index, index0);
-	}
+	T chunk[index_chunk_size];
+	T index0 = 0;
+	T previous = 0;
 
 	size_t dst_idx = 0;
-	while (src.size() > 2)
+	for (size_t first = 0; first < src.size(); first += index_chunk_size)
 	{
-		gsl::span<to_be_t<const T>> tri_indexes = src.subspan(0, 2);
-		T index1 = tri_indexes[0];
-		if (is_primitive_restart_enabled && index1 == primitive_restart_index)
-		{
-			index1 = -1;
-		}
-		else
-		{
-			min_index = MIN2(min_index, index1);
-			max_index = MAX2(max_index, index1);
-		}
-		T index2 = tri_indexes[1];
-		if (is_primitive_restart_enabled && index2 == primitive_restart_index)
+		const size_t count = std::min(index_chunk_size, src.size() - first);
+		const auto &chunk_min_max = swap_indexes<T>(src.data() + first, chunk, count, is_primitive_restart_enabled, primitive_restart_index);
+		min_index = MIN2(min_index, std::get<0>(chunk_min_max));
+		max_index = MAX2(max_index, std::get<1>(chunk_min_max));
+
+		size_t i = 0;
+		if (first == 0)
 		{
-			index2 = -1;
+			index0 = chunk[0];
+			previous = chunk[std::min<size_t>(1, count - 1)];
+			i = 2;
 		}
-		else
+
+		// Triangle i - 1 is (index0, index i - 1, index i)
+		for (; i < count; i++)
 		{
-			min_index = MIN2(min_index, index2);
-			max_index = MAX2(max_index, index2);
+			dst[dst_idx++] = index0;
+			dst[dst_idx++] = previous;
+			dst[dst_idx++] = previous = chunk[i];
 		}
-
-		dst[dst_idx++] = index0;
-		dst[dst_idx++] = index1;
-		dst[dst_idx++] = index2;
-
-		src = src.subspan(2);
 	}
 	return std::make_tuple(min_index, max_index);
 }
@@ -183,61 +374,28 @@ std::tuple<T, T> expand_indexed_quads(gsl::span<to_be_t<const T>> src, gsl::span
 
 	Expects(4 * dst.size_bytes() >= 6 * src.size_bytes());
 
+	T chunk[index_chunk_size];
+	const size_t index_count = src.size() & ~3;
+
 	size_t dst_idx = 0;
-	while (!src.empty())
+	for (size_t first = 0; first < index_count; first += index_chunk_size)
 	{
-		gsl::span<to_be_t<const T>> quad_indexes = src.subspan(0, 4);
-		T index0 = quad_indexes[0];
-		if (is_primitive_restart_enabled && index0 == primitive_restart_index)
-		{
-			index0 = -1;
-		}
-		else
-		{
-			min_index = MIN2(min_index, index0);
-			max_index = MAX2(max_index, index0);
-		}
-		T index1 = quad_indexes[1];
-		if (is_primitive_restart_enabled && index1 == primitive_restart_index)
-		{
-			index1 = -1;
-		}
-		else
-		{
-			min_index = MIN2(min_index, index1);
-			max_index = MAX2(max_index, index1);
-		}
-		T index2 = quad_indexes[2];
-		if (is_primitive_restart_enabled && index2 == primitive_restart_index)
-		{
-			index2 = -1;
-		}
-		else
-		{
-			min_index = MIN2(min_index, index2);
-			max_index = MAX2(max_index, index2);
-		}
-		T index3 = quad_indexes[3];
-		if (is_primitive_restart_enabled &&index3 == primitive_restart_index)
-		{
-			index3 = -1;
-		}
-		else
+		const size_t count = std::min(index_chunk_size, index_count - first);
+		const auto &chunk_min_max = swap_indexes<T>(src.data() + first, chunk, count, is_primitive_restart_enabled, primitive_restart_index);
+		min_index = MIN2(min_index, std::get<0>(chunk_min_max));
+		max_index = MAX2(max_index, std::get<1>(chunk_min_max));
+
+		for (size_t i = 0; i < count; i += 4)
 		{
-			min_index = MIN2(min_index, index3);
-			max_index = MAX2(max_index, index3);
+			// First triangle
+			dst[dst_idx++] = chunk[i];
+			dst[dst_idx++] = chunk[i + 1];
+			dst[dst_idx++] = chunk[i + 2];
+			// Second triangle
+			dst[dst_idx++] = chunk[i + 2];
+			dst[dst_idx++] = chunk[i + 3];
+			dst[dst_idx++] = chunk[i];
 		}
-
-		// First triangle
-		dst[dst_idx++] = index0;
-		dst[dst_idx++] = index1;
-		dst[dst_idx++] = index2;
-		// Second triangle
-		dst[dst_idx++] = index2;
-		dst[dst_idx++] = index3;
-		dst[dst_idx++] = index0;
-
-		src = src.subspan(4);
 	}
 	return std::make_tuple(min_index, max_index);
 }
@@ -392,6 +550,16 @@ std::tuple<u16, u16> write_index_array_data_to_buffer(gsl::span<u16, gsl::dynami
 	return write_index_array_data_to_buffer_impl(dst, m_draw_mode, first_count_arguments);
 }
 
+std::tuple<u32, u32> upload_index_array(gsl::span<const be_t<u32>> src, gsl::span<u32> dst, bool is_primitive_restart_enabled, u32 primitive_restart_index)
+{
+	return upload_untouched<u32>(src, dst, is_primitive_restart_enabled, primitive_restart_index);
+}
+
+std::tuple<u16, u16> upload_index_array(gsl::span<const be_t<u16>> src, gsl::span<u16> dst, bool is_primitive_restart_enabled, u16 primitive_restart_index)
+{
+	return upload_untouched<u16>(src, dst, is_primitive_restart_enabled, primitive_restart_index);
+}
+
 std::tuple<u32, u32> write_index_array_data_to_buffer_untouched(gsl::span<u32, gsl::dynamic_range> dst, const std::vector<std::pair<u32, u32> > &first_count_arguments)
 {
 	u32 address = rsx::get_address(rsx::method_registers[NV4097_SET_INDEX_ARRAY_ADDRESS], rsx::method_registers[NV4097_SET_INDEX_ARRAY_DMA] & 0xf);
@@ -449,3 +617,30 @@ void stream_vector_from_memory(void *dst, void *src)
 	const __m128i &vector = _mm_loadu_si128((__m128i*)src);
 	_mm_stream_si128((__m128i*)dst, vector);
 }
+
+void expand_u8_to_u32(void *dst, const void *src, size_t count)
+{
+	u8 *dst_bytes = (u8*)dst;
+	const u8 *src_bytes = (const u8*)src;
+
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		const __m128i values = _mm_loadu_si128((const __m128i*)(src_bytes + i));
+		const __m128i low = _mm_unpacklo_epi8(values, values);
+		const __m128i high = _mm_unpackhi_epi8(values, values);
+		_mm_storeu_si128((__m128i*)(dst_bytes + 4 * i), _mm_unpacklo_epi16(low, low));
+		_mm_storeu_si128((__m128i*)(dst_bytes + 4 * i + 16), _mm_unpackhi_epi16(low, low));
+		_mm_storeu_si128((__m128i*)(dst_bytes + 4 * i + 32), _mm_unpacklo_epi16(high, high));
+		_mm_storeu_si128((__m128i*)(dst_bytes + 4 * i + 48), _mm_unpackhi_epi16(high, high));
+	}
+
+	for (; i < count; i++)
+	{
+		const u8 c = src_bytes[i];
+		dst_bytes[4 * i] = c;
+		dst_bytes[4 * i + 1] = c;
+		dst_bytes[4 * i + 2] = c;
+		dst_bytes[4 * i + 3] = c;
+	}
+}
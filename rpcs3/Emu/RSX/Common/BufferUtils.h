@@ -31,6 +31,13 @@ size_t get_index_type_size(Index_array_type type);
 std::tuple<u32, u32> write_index_array_data_to_buffer(gsl::span<u32, gsl::dynamic_range> dst, Primitive_type m_draw_mode, const std::vector<std::pair<u32, u32> > &first_count_arguments);
 std::tuple<u16, u16> write_index_array_data_to_buffer(gsl::span<u16, gsl::dynamic_range> dst, Primitive_type m_draw_mode, const std::vector<std::pair<u32, u32> > &first_count_arguments);
 
+/**
+ * Byte swap indexes from src to dst, primitive restart indexes are replaced by -1 if enabled.
+ * Returns min/max index found, restart indexes excluded.
+ */
+std::tuple<u32, u32> upload_index_array(gsl::span<const be_t<u32>> src, gsl::span<u32> dst, bool is_primitive_restart_enabled, u32 primitive_restart_index);
+std::tuple<u16, u16> upload_index_array(gsl::span<const be_t<u16>> src, gsl::span<u16> dst, bool is_primitive_restart_enabled, u16 primitive_restart_index);
+
 /**
  * Doesn't expand index
  */
@@ -51,3 +58,8 @@ void stream_vector(void *dst, u32 x, u32 y, u32 z, u32 w);
  * Stream a 128 bits vector from src to dst.
  */
 void stream_vector_from_memory(void *dst, void *src);
+
+/**
+ * Write count 32 bits pixels from count 8 bits values, each value is replicated in the 4 bytes of its pixel.
+ */
+void expand_u8_to_u32(void *dst, const void *src, size_t count);
@@ -5,7 +5,7 @@
 #include "FragmentProgramDecompiler.h"
 
 FragmentProgramDecompiler::FragmentProgramDecompiler(const RSXFragmentProgram &prog, u32& size) :
-	m_addr(prog.addr),
+	m_ucode(static_cast<const be_t<u32>*>(prog.ucode ? prog.ucode : vm::base(prog.addr))),
 	m_size(size),
 	m_const_index(0),
 	m_location(0),
@@ -70,7 +70,7 @@ void FragmentProgramDecompiler::SetDst(std::string code, bool append_mask)
 
 void FragmentProgramDecompiler::AddCode(const std::string& code)
 {
-	main.append(m_code_level, '\t') += Format(code) + "\n";
+	main.append(m_code_level, '\t').append(Format(code)) += '\n';
 }
 
 std::string FragmentProgramDecompiler::GetMask()
@@ -114,7 +114,7 @@ std::string FragmentProgramDecompiler::AddConst()
 		return name;
 	}
 
-	auto data = vm::ps3::ptr<u32>::make(m_addr + m_size + 4 * SIZE_32(u32));
+	const be_t<u32>* data = m_ucode + m_size / sizeof(u32) + 4;
 
 	m_offset = 2 * 4 * sizeof(u32);
 	u32 x = GetData(data[0]);
@@ -133,26 +133,31 @@ std::string FragmentProgramDecompiler::AddTex()
 
 std::string FragmentProgramDecompiler::Format(const std::string& code)
 {
-	const std::pair<std::string, std::function<std::string()>> repl_list[] =
+	static const char* const tokens[] =
 	{
-		{ "$$", []() -> std::string { return "$"; } },
-		{ "$0", [this]() -> std::string {return GetSRC<SRC0>(src0);} },//std::bind(std::mem_fn(&GLFragmentDecompilerThread::GetSRC<SRC0>), *this, src0) },
-		{ "$1", [this]() -> std::string {return GetSRC<SRC1>(src1);} },//std::bind(std::mem_fn(&GLFragmentDecompilerThread::GetSRC<SRC1>), this, src1) },
-		{ "$2", [this]() -> std::string {return GetSRC<SRC2>(src2);} },//std::bind(std::mem_fn(&GLFragmentDecompilerThread::GetSRC<SRC2>), this, src2) },
-		{ "$t", std::bind(std::mem_fn(&FragmentProgramDecompiler::AddTex), this) },
-		{ "$m", std::bind(std::mem_fn(&FragmentProgramDecompiler::GetMask), this) },
-		{ "$ifcond ", [this]() -> std::string
-	{
-		const std::string& cond = GetCond();
-		if (cond == "true") return "";
-		return "if(" + cond + ") ";
-	}
-		},
-		{ "$cond", std::bind(std::mem_fn(&FragmentProgramDecompiler::GetCond), this) },
-		{ "$c", std::bind(std::mem_fn(&FragmentProgramDecompiler::AddConst), this) }
+		"$$", "$0", "$1", "$2", "$t", "$m", "$ifcond ", "$cond", "$c",
 	};
 
-	return fmt::replace_all(code, repl_list);
+	return format_shader_code(code, tokens, [this](size_t index, std::string& out)
+	{
+		switch (index)
+		{
+		case 0: out += '$'; break;
+		case 1: out += GetSRC<SRC0>(src0); break;
+		case 2: out += GetSRC<SRC1>(src1); break;
+		case 3: out += GetSRC<SRC2>(src2); break;
+		case 4: out += AddTex(); break;
+		case 5: out += GetMask(); break;
+		case 6:
+		{
+			const std::string& cond = GetCond();
+			if (cond != "true") out.append("if(").append(cond).append(") ");
+			break;
+		}
+		case 7: out += GetCond(); break;
+		case 8: out += AddConst(); break;
+		}
+	});
 }
 
 std::string FragmentProgramDecompiler::GetCond()
@@ -329,7 +334,7 @@ std::string FragmentProgramDecompiler::BuildCode()
 	insertOutputs(OS);
 	OS << std::endl;
 	insertMainStart(OS);
-	OS << main << std::endl;
+	OS.write(main.data(), main.size()) << std::endl;
 	insertMainEnd(OS);
 
 	return OS.str();
@@ -487,11 +492,12 @@ bool FragmentProgramDecompiler::handle_tex_srb(u32 opcode)
 
 std::string FragmentProgramDecompiler::Decompile()
 {
-	auto data = vm::ps3::ptr<u32>::make(m_addr);
+	const be_t<u32>* data = m_ucode;
 	m_size = 0;
 	m_location = 0;
 	m_loop_count = 0;
 	m_code_level = 1;
+	main.reserve(16 * 1024);
 
 	enum
 	{
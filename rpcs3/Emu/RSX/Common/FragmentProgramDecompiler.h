@@ -25,7 +25,7 @@ class FragmentProgramDecompiler
 	SRC2 src2;
 
 	std::string main;
-	u32 m_addr;
+	const be_t<u32>* m_ucode;
 	u32& m_size;
 	const std::vector<texture_dimension> m_texture_dimensions;
 	u32 m_const_index;
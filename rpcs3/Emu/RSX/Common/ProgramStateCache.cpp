@@ -70,6 +70,34 @@ size_t fragment_program_utils::get_fragment_program_ucode_size(void *ptr)
 	}
 }
 
+u64 fragment_program_utils::get_fragment_program_fingerprint(const void *ptr)
+{
+	// Two independent 64 bit lanes mixed with 32x32 multiplies, one SSE step per instruction
+	const __m128i multiplier = _mm_set_epi32(0, 0x9E3779B1, 0, 0x85EBCA77);
+	const __m128i *inst_buffer = (const __m128i*)ptr;
+	__m128i hash = _mm_set_epi64x(0xCBF29CE484222325ULL, 0x84222325CBF29CE4ULL);
+	size_t instIndex = 0;
+	while (true)
+	{
+		const __m128i inst = _mm_loadu_si128(inst_buffer + instIndex);
+		const __m128i mixed = _mm_xor_si128(hash, inst);
+		hash = _mm_add_epi64(_mm_mul_epu32(mixed, multiplier), _mm_shuffle_epi32(mixed, _MM_SHUFFLE(2, 3, 0, 1)));
+
+		const qword& header = ((const qword*)ptr)[instIndex];
+		instIndex++;
+		// Skip constants
+		if (is_constant(header.word[1]) || is_constant(header.word[2]) || is_constant(header.word[3]))
+			instIndex++;
+
+		if ((header.word[0] >> 8) & 0x1)
+			break;
+	}
+
+	alignas(16) u64 lanes[2];
+	_mm_store_si128((__m128i*)lanes, hash);
+	return lanes[0] ^ (lanes[1] * 0x100000001B3ULL);
+}
+
 size_t fragment_program_hash::operator()(const void *program) const
 {
 	// 64-bit Fowler/Noll/Vo FNV-1a hash code
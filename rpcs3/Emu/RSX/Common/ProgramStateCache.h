@@ -3,6 +3,10 @@
 #include "Emu/RSX/RSXFragmentProgram.h"
 #include "Emu/RSX/RSXVertexProgram.h"
 #include "Emu/Memory/vm.h"
+#include "Utilities/Thread.h"
+#include "Utilities/Trace.h"
+
+#include <deque>
 
 
 enum class SHADER_TYPE
@@ -39,6 +43,12 @@ namespace program_hash_util
 		static bool is_constant(u32 sourceOperand);
 
 		static size_t get_fragment_program_ucode_size(void *ptr);
+
+		/**
+		* returns a 64 bit fingerprint of the instructions (constants are skipped like fragment_program_hash).
+		* Cheaper than fragment_program_hash, used with the ucode address to skip the full compare.
+		*/
+		static u64 get_fragment_program_fingerprint(const void *ptr);
 	};
 
 	struct fragment_program_hash
@@ -65,7 +75,12 @@ namespace program_hash_util
 * It should also contains the following function member :
 * - static void recompile_fragment_program(RSXFragmentProgram *RSXFP, FragmentProgramData& fragmentProgramData, size_t ID);
 * - static void recompile_vertex_program(RSXVertexProgram *RSXVP, VertexProgramData& vertexProgramData, size_t ID);
-* - static PipelineData build_program(VertexProgramData &vertexProgramData, FragmentProgramData &fragmentProgramData, const PipelineProperties &pipelineProperties, const ExtraData& extraData);
+* - static PipelineData build_program(VertexProgramData &vertexProgramData, FragmentProgramData &fragmentProgramData, const PipelineProperties &pipelineProperties, const std::vector<u8> &cachedBlob, const ExtraData& extraData);
+* Pipeline cache serialization requires :
+* - static const bool parallel_shader_compilation, true if recompile_*_program and build_pipeline can be called from any thread.
+* - static void serialize_properties(const PipelineProperties &pipelineProperties, std::vector<u8> &out);
+* - static bool deserialize_properties(const u8 *data, size_t size, PipelineProperties &pipelineProperties);
+* - static std::vector<u8> get_pipeline_blob(const PipelineData &pipeline), can be empty if the backend has no binary format.
 */
 template<typename backend_traits>
 class program_state_cache
@@ -106,11 +121,131 @@ class program_state_cache
 		}
 	};
 
+	/**
+	* Pipeline identified by ucode, used before shader ids are known.
+	*/
+	struct pending_pipeline_key
+	{
+		std::vector<u32> vertex_program;
+		std::vector<u8> fragment_program;
+		pipeline_properties properties;
+	};
+
+	struct pending_pipeline_key_hash
+	{
+		size_t operator()(const pending_pipeline_key &key) const
+		{
+			size_t hashValue = program_hash_util::vertex_program_hash()(key.vertex_program);
+			hashValue ^= program_hash_util::fragment_program_hash()(key.fragment_program.data());
+			hashValue ^= std::hash<pipeline_properties>()(key.properties);
+			return hashValue;
+		}
+	};
+
+	struct pending_pipeline_key_compare
+	{
+		bool operator()(const pending_pipeline_key &key1, const pending_pipeline_key &key2) const
+		{
+			return key1.vertex_program == key2.vertex_program && key1.fragment_program == key2.fragment_program && key1.properties == key2.properties;
+		}
+	};
+
+	using pending_pipeline_set = std::unordered_set<pending_pipeline_key, pending_pipeline_key_hash, pending_pipeline_key_compare>;
+
+	struct compile_job
+	{
+		pending_pipeline_key key;
+		RSXFragmentProgram fragment_program; // ucode points to key.fragment_program
+	};
+
+	/**
+	* Pipeline cache file record, followed by vertex program ucode, fragment program ucode,
+	* texture dimensions (one byte each), serialized pipeline properties and pipeline blob.
+	*/
+	struct pipeline_cache_header
+	{
+		u32 magic;
+		u32 vertex_program_size; // in words
+		u32 fragment_program_size; // in bytes
+		u32 fragment_program_ctrl;
+		u32 texture_dimensions_count;
+		u32 properties_size;
+		u32 blob_size;
+	};
+
+	// Bumped when the record or serialized properties layout changes
+	static const u32 pipeline_cache_magic = 0x32435350; // "PSC2"
+
+	struct cached_pipeline
+	{
+		RSXVertexProgram vertex_program;
+		RSXFragmentProgram fragment_program;
+		std::vector<u8> fragment_program_ucode;
+		pipeline_properties properties;
+		std::vector<u8> blob;
+		const vertex_program_type *vp = nullptr;
+		const fragment_program_type *fp = nullptr;
+	};
+
 private:
 	size_t m_next_id = 0;
 	binary_to_vertex_program m_vertex_shader_cache;
 	binary_to_fragment_program m_fragment_shader_cache;
 	std::unordered_map <pipeline_key, pipeline_storage_type, pipeline_key_hash, pipeline_key_compare> m_storage;
+	fs::file m_pipeline_cache_file;
+
+	/// Fragment programs by guest address, valid while the ucode fingerprint matches.
+	std::unordered_map<u32, std::pair<u64, const fragment_program_type*>> m_fragment_program_by_address;
+
+	/// Previous draw lookup, reused until invalidate_last_programs is called.
+	bool m_last_programs_valid = false;
+	const vertex_program_type *m_last_vertex_program = nullptr;
+	const fragment_program_type *m_last_fragment_program = nullptr;
+	pipeline_storage_type *m_last_pipeline = nullptr;
+	pipeline_properties m_last_properties;
+
+	/**
+	* Protects caches above when compiler threads are running.
+	* Shaders listed in m_pending_shaders are being compiled outside of the lock and must not be used,
+	* shaders listed in m_failed_shaders threw during compilation.
+	*/
+	mutable std::mutex m_mutex;
+	std::condition_variable m_shader_ready_cv;
+	std::unordered_set<const void*> m_pending_shaders;
+	std::unordered_set<const void*> m_failed_shaders;
+	pending_pipeline_set m_pending_pipelines;
+	pending_pipeline_set m_failed_pipelines;
+
+	std::mutex m_queue_mutex;
+	std::condition_variable m_queue_cv;
+	std::deque<std::function<void()>> m_queue;
+	std::vector<std::shared_ptr<thread_ctrl>> m_workers;
+	bool m_exit = false;
+
+	static const void* get_ucode(const RSXFragmentProgram& rsx_fp)
+	{
+		return rsx_fp.ucode ? rsx_fp.ucode : vm::base(rsx_fp.addr);
+	}
+
+	/// Backend compilation wrappers, recorded in the timeline.
+	static void recompile_vertex_program(const RSXVertexProgram& rsx_vp, vertex_program_type& shader, size_t id)
+	{
+		_log::timeline_scope scope("rsx", "vertex program compile", id);
+		backend_traits::recompile_vertex_program(rsx_vp, shader, id);
+	}
+
+	static void recompile_fragment_program(const RSXFragmentProgram& rsx_fp, fragment_program_type& shader, size_t id)
+	{
+		_log::timeline_scope scope("rsx", "fragment program compile", id);
+		backend_traits::recompile_fragment_program(rsx_fp, shader, id);
+	}
+
+	template<typename... Args>
+	static pipeline_storage_type build_pipeline(const vertex_program_type& vp, const fragment_program_type& fp, const pipeline_properties& properties, const std::vector<u8>& blob, Args&&... args)
+	{
+		_log::timeline_scope scope("rsx", "pipeline build");
+		return backend_traits::build_pipeline(vp, fp, properties, blob, std::forward<Args>(args)...);
+	}
 
 	/// bool here to inform that the program was preexisting.
 	std::tuple<const vertex_program_type&, bool> search_vertex_program(const RSXVertexProgram& rsx_vp)
@@ -122,46 +257,294 @@ private:
 		}
 		LOG_NOTICE(RSX, "VP not found in buffer!");
 		vertex_program_type& new_shader = m_vertex_shader_cache[rsx_vp.data];
-		backend_traits::recompile_vertex_program(rsx_vp, new_shader, m_next_id++);
+		recompile_vertex_program(rsx_vp, new_shader, m_next_id++);
 
 		return std::forward_as_tuple(new_shader, false);
 	}
 
+	/**
+	* Fragment program lookup, checks address and fingerprint first and only compares whole ucode on mismatch.
+	* found is set to the address entry to update if the program has to be created.
+	*/
+	const fragment_program_type* find_fragment_program(const RSXFragmentProgram& rsx_fp, std::pair<u64, const fragment_program_type*> **found = nullptr)
+	{
+		const void *ucode = get_ucode(rsx_fp);
+
+		// Host copies don't have a stable address
+		if (rsx_fp.ucode)
+		{
+			const auto I = m_fragment_shader_cache.find(const_cast<void*>(ucode));
+			return I != m_fragment_shader_cache.end() ? &I->second : nullptr;
+		}
+
+		const u64 fingerprint = program_hash_util::fragment_program_utils::get_fragment_program_fingerprint(ucode);
+		auto &entry = m_fragment_program_by_address[rsx_fp.addr];
+		if (found)
+			*found = &entry;
+		if (entry.second && entry.first == fingerprint)
+			return entry.second;
+
+		entry = { fingerprint, nullptr };
+		const auto I = m_fragment_shader_cache.find(const_cast<void*>(ucode));
+		if (I == m_fragment_shader_cache.end())
+			return nullptr;
+
+		entry.second = &I->second;
+		return entry.second;
+	}
+
+	/// Same as find_fragment_program for the current draw program, without updating lookup caches
+	const fragment_program_type* find_current_fragment_program(const RSXFragmentProgram& rsx_fp) const
+	{
+		if (m_last_programs_valid && m_last_fragment_program)
+			return m_last_fragment_program;
+		const auto I = m_fragment_shader_cache.find(const_cast<void*>(get_ucode(rsx_fp)));
+		return I != m_fragment_shader_cache.end() ? &I->second : nullptr;
+	}
+
 	/// bool here to inform that the program was preexisting.
 	std::tuple<const fragment_program_type&, bool> search_fragment_program(const RSXFragmentProgram& rsx_fp)
 	{
-		const auto& I = m_fragment_shader_cache.find(vm::base(rsx_fp.addr));
-		if (I != m_fragment_shader_cache.end())
+		std::pair<u64, const fragment_program_type*> *address_entry = nullptr;
+		if (const fragment_program_type *found = find_fragment_program(rsx_fp, &address_entry))
 		{
-			return std::forward_as_tuple(I->second, true);
+			return std::forward_as_tuple(*found, true);
 		}
 		LOG_NOTICE(RSX, "FP not found in buffer!");
-		size_t fragment_program_size = program_hash_util::fragment_program_utils::get_fragment_program_ucode_size(vm::base(rsx_fp.addr));
+		const void *ucode = get_ucode(rsx_fp);
+		size_t fragment_program_size = program_hash_util::fragment_program_utils::get_fragment_program_ucode_size(const_cast<void*>(ucode));
 		gsl::not_null<void*> fragment_program_ucode_copy = malloc(fragment_program_size);
-		std::memcpy(fragment_program_ucode_copy, vm::base(rsx_fp.addr), fragment_program_size);
+		std::memcpy(fragment_program_ucode_copy, ucode, fragment_program_size);
 		fragment_program_type &new_shader = m_fragment_shader_cache[fragment_program_ucode_copy];
-		backend_traits::recompile_fragment_program(rsx_fp, new_shader, m_next_id++);
+		recompile_fragment_program(rsx_fp, new_shader, m_next_id++);
+
+		if (address_entry)
+			address_entry->second = &new_shader;
 
 		return std::forward_as_tuple(new_shader, false);
 	}
 
+	/**
+	* Find or compile a shader from a compiler thread, waits if another thread is already compiling it.
+	* Returns nullptr if compilation failed. Lock must be held.
+	*/
+	template<typename Cache, typename Key, typename Insert, typename Compile>
+	auto acquire_shader(std::unique_lock<std::mutex> &lock, Cache &cache, const Key &key, Insert insert, Compile compile) -> decltype(&cache.begin()->second)
+	{
+		while (true)
+		{
+			auto I = cache.find(key);
+			if (I == cache.end())
+				break;
+
+			if (m_failed_shaders.count(&I->second))
+				return nullptr;
+
+			if (m_pending_shaders.count(&I->second) == 0)
+				return &I->second;
+
+			m_shader_ready_cv.wait(lock);
+		}
+
+		auto *shader = &insert()->second;
+		const size_t id = m_next_id++;
+		m_pending_shaders.insert(shader);
+
+		lock.unlock();
+
+		bool succeeded = true;
+		try
+		{
+			compile(*shader, id);
+		}
+		catch (...)
+		{
+			succeeded = false;
+		}
+
+		lock.lock();
+		m_pending_shaders.erase(shader);
+		if (!succeeded)
+			m_failed_shaders.insert(shader);
+		m_shader_ready_cv.notify_all();
+
+		return succeeded ? shader : nullptr;
+	}
+
+	template<typename... Args>
+	void compile_pipeline(compile_job &job, Args&& ...args)
+	{
+		const pending_pipeline_key &key = job.key;
+		const RSXVertexProgram rsx_vp = { key.vertex_program };
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		const vertex_program_type *vp = acquire_shader(lock, m_vertex_shader_cache, key.vertex_program,
+			[&]() { return m_vertex_shader_cache.emplace(std::piecewise_construct, std::forward_as_tuple(key.vertex_program), std::forward_as_tuple()).first; },
+			[&](vertex_program_type &shader, size_t id) { recompile_vertex_program(rsx_vp, shader, id); });
+
+		const fragment_program_type *fp = vp ? acquire_shader(lock, m_fragment_shader_cache, const_cast<void*>(job.fragment_program.ucode),
+			[&]()
+			{
+				gsl::not_null<void*> fragment_program_ucode_copy = malloc(key.fragment_program.size());
+				std::memcpy(fragment_program_ucode_copy, key.fragment_program.data(), key.fragment_program.size());
+				return m_fragment_shader_cache.emplace(std::piecewise_construct, std::forward_as_tuple(fragment_program_ucode_copy), std::forward_as_tuple()).first;
+			},
+			[&](fragment_program_type &shader, size_t id) { recompile_fragment_program(job.fragment_program, shader, id); }) : nullptr;
+
+		bool succeeded = vp && fp;
+
+		if (succeeded)
+		{
+			const pipeline_key storage_key = { vp->id, fp->id, key.properties };
+
+			if (m_storage.find(storage_key) == m_storage.end())
+			{
+				lock.unlock();
+
+				pipeline_storage_type pipeline;
+				try
+				{
+					pipeline = build_pipeline(*vp, *fp, key.properties, {}, std::forward<Args>(args)...);
+				}
+				catch (...)
+				{
+					succeeded = false;
+				}
+
+				lock.lock();
+
+				if (succeeded)
+				{
+					if (m_pipeline_cache_file)
+						save_pipeline(rsx_vp, job.fragment_program, key.properties, pipeline);
+
+					m_storage.emplace(storage_key, std::move(pipeline));
+				}
+			}
+		}
+
+		if (!succeeded)
+		{
+			LOG_ERROR(RSX, "Background pipeline compilation failed, draws using it will be skipped");
+			m_failed_pipelines.insert(key);
+		}
+
+		m_pending_pipelines.erase(key);
+	}
+
+	void save_pipeline(const RSXVertexProgram& rsx_vp, const RSXFragmentProgram& rsx_fp, const pipeline_properties& properties, const pipeline_storage_type& pipeline)
+	{
+		std::vector<u8> serialized_properties;
+		backend_traits::serialize_properties(properties, serialized_properties);
+		const std::vector<u8> &blob = backend_traits::get_pipeline_blob(pipeline);
+		const void *ucode = get_ucode(rsx_fp);
+
+		pipeline_cache_header header;
+		header.magic = pipeline_cache_magic;
+		header.vertex_program_size = gsl::narrow<u32>(rsx_vp.data.size());
+		header.fragment_program_size = gsl::narrow<u32>(program_hash_util::fragment_program_utils::get_fragment_program_ucode_size(const_cast<void*>(ucode)));
+		header.fragment_program_ctrl = rsx_fp.ctrl;
+		header.texture_dimensions_count = gsl::narrow<u32>(rsx_fp.texture_dimensions.size());
+		header.properties_size = gsl::narrow<u32>(serialized_properties.size());
+		header.blob_size = gsl::narrow<u32>(blob.size());
+
+		// Build the whole record first so that an interrupted write only truncates the last one
+		std::vector<u8> record(sizeof(header));
+		std::memcpy(record.data(), &header, sizeof(header));
+		const u8 *vp_data = reinterpret_cast<const u8*>(rsx_vp.data.data());
+		record.insert(record.end(), vp_data, vp_data + rsx_vp.data.size() * sizeof(u32));
+		const u8 *fp_data = static_cast<const u8*>(ucode);
+		record.insert(record.end(), fp_data, fp_data + header.fragment_program_size);
+		for (texture_dimension dimension : rsx_fp.texture_dimensions)
+			record.push_back((u8)dimension);
+		record.insert(record.end(), serialized_properties.begin(), serialized_properties.end());
+		record.insert(record.end(), blob.begin(), blob.end());
+
+		m_pipeline_cache_file.write(record);
+	}
+
+	/// skipped receives the count of bytes not belonging to well formed records.
+	/// The file may be shared by several instances appending to it, damaged records are skipped by resyncing on the next record magic.
+	static std::vector<cached_pipeline> parse_pipeline_cache(const u8 *data, size_t size, size_t &skipped)
+	{
+		std::vector<cached_pipeline> result;
+		size_t pos = 0;
+		skipped = 0;
+
+		while (pos < size)
+		{
+			pipeline_cache_header header;
+			if (size - pos < sizeof(header))
+			{
+				skipped += size - pos;
+				break;
+			}
+			std::memcpy(&header, data + pos, sizeof(header));
+
+			const u64 record_size = sizeof(header) + (u64)header.vertex_program_size * sizeof(u32) + header.fragment_program_size +
+				header.texture_dimensions_count + header.properties_size + header.blob_size;
+
+			if (header.magic != pipeline_cache_magic || header.fragment_program_size == 0 || header.fragment_program_size % 16 || record_size > size - pos)
+			{
+				pos++;
+				skipped++;
+				continue;
+			}
+
+			const u8 *ptr = data + pos + sizeof(header);
+			cached_pipeline entry;
+
+			entry.vertex_program.data.resize(header.vertex_program_size);
+			std::memcpy(entry.vertex_program.data.data(), ptr, header.vertex_program_size * sizeof(u32));
+			ptr += header.vertex_program_size * sizeof(u32);
+
+			entry.fragment_program_ucode.assign(ptr, ptr + header.fragment_program_size);
+			ptr += header.fragment_program_size;
+
+			entry.fragment_program.ctrl = header.fragment_program_ctrl;
+			for (u32 i = 0; i < header.texture_dimensions_count; i++)
+				entry.fragment_program.texture_dimensions.push_back((texture_dimension)*ptr++);
+
+			if (!backend_traits::deserialize_properties(ptr, header.properties_size, entry.properties))
+			{
+				pos++;
+				skipped++;
+				continue;
+			}
+			ptr += header.properties_size;
+
+			entry.blob.assign(ptr, ptr + header.blob_size);
+
+			result.push_back(std::move(entry));
+			pos += record_size;
+		}
+
+		return result;
+	}
+
 public:
 	program_state_cache() = default;
-	~program_state_cache() = default;
+
+	~program_state_cache()
+	{
+		stop_compiler_threads();
+	}
 
 	const vertex_program_type& get_transform_program(const RSXVertexProgram& rsx_vp) const
 	{
+		std::lock_guard<std::mutex> lock(m_mutex);
 		auto I = m_vertex_shader_cache.find(rsx_vp.data);
-		if (I == m_vertex_shader_cache.end())
+		if (I != m_vertex_shader_cache.end())
 			return I->second;
 		throw new EXCEPTION("Trying to get unknow transform program");
 	}
 
 	const fragment_program_type& get_shader_program(const RSXFragmentProgram& rsx_fp) const
 	{
-		auto I = m_fragment_shader_cache.find(vm::base(rsx_fp.addr));
-		if (I != m_fragment_shader_cache.end())
-			return I->second;
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (const fragment_program_type *fp = find_current_fragment_program(rsx_fp))
+			return *fp;
 		throw new EXCEPTION("Trying to get unknow shader program");
 	}
 
@@ -173,54 +556,403 @@ public:
 		Args&& ...args
 		)
 	{
-		// TODO : use tie and implicit variable declaration syntax with c++17
-		const auto &vp_search = search_vertex_program(vertexShader);
-		const auto &fp_search = search_fragment_program(fragmentShader);
-		const vertex_program_type &vertex_program = std::get<0>(vp_search);
-		const fragment_program_type &fragment_program = std::get<0>(fp_search);
-		bool already_existing_fragment_program = std::get<1>(fp_search);
-		bool already_existing_vertex_program = std::get<1>(vp_search);
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		bool already_existing_programs = true;
+
+		if (m_last_programs_valid)
+		{
+			if (m_last_properties == pipelineProperties)
+				return *m_last_pipeline;
+		}
+		else
+		{
+			// TODO : use tie and implicit variable declaration syntax with c++17
+			const auto &vp_search = search_vertex_program(vertexShader);
+			const auto &fp_search = search_fragment_program(fragmentShader);
+			m_last_vertex_program = &std::get<0>(vp_search);
+			m_last_fragment_program = &std::get<0>(fp_search);
+			already_existing_programs = std::get<1>(vp_search) && std::get<1>(fp_search);
+		}
+
+		const vertex_program_type &vertex_program = *m_last_vertex_program;
+		const fragment_program_type &fragment_program = *m_last_fragment_program;
 
 		pipeline_key key = { vertex_program.id, fragment_program.id, pipelineProperties };
 
-		if (already_existing_fragment_program && already_existing_vertex_program)
+		if (already_existing_programs)
 		{
 			const auto I = m_storage.find(key);
 			if (I != m_storage.end())
+			{
+				m_last_programs_valid = true;
+				m_last_pipeline = &I->second;
+				m_last_properties = pipelineProperties;
 				return I->second;
+			}
 		}
 
+		m_last_programs_valid = false;
+
 		LOG_NOTICE(RSX, "Add program :");
 		LOG_NOTICE(RSX, "*** vp id = %d", vertex_program.id);
 		LOG_NOTICE(RSX, "*** fp id = %d", fragment_program.id);
 
-		m_storage[key] = backend_traits::build_pipeline(vertex_program, fragment_program, pipelineProperties, std::forward<Args>(args)...);
-		return m_storage[key];
+		pipeline_storage_type &pipeline = m_storage[key];
+		pipeline = build_pipeline(vertex_program, fragment_program, pipelineProperties, {}, std::forward<Args>(args)...);
+
+		if (m_pipeline_cache_file)
+			save_pipeline(vertexShader, fragmentShader, pipelineProperties, pipeline);
+
+		m_last_programs_valid = true;
+		m_last_pipeline = &pipeline;
+		m_last_properties = pipelineProperties;
+		return pipeline;
+	}
+
+	/**
+	* Must be called when vertex or fragment program may have changed since the previous lookup.
+	*/
+	void invalidate_last_programs()
+	{
+		m_last_programs_valid = false;
+	}
+
+	/**
+	* Non blocking version of getGraphicPipelineState, only usable when compiler threads are running.
+	* Returns nullptr if the pipeline isn't ready yet, it is then compiled in background
+	* (args are copied until the compilation ends).
+	*/
+	template<typename... Args>
+	pipeline_storage_type* try_get_graphic_pipeline_state(
+		const RSXVertexProgram& vertexShader,
+		const RSXFragmentProgram& fragmentShader,
+		const pipeline_properties& pipelineProperties,
+		Args&& ...args
+		)
+	{
+		const void *ucode = get_ucode(fragmentShader);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			if (m_last_programs_valid && m_last_properties == pipelineProperties)
+				return m_last_pipeline;
+
+			m_last_programs_valid = false;
+
+			const auto vp = m_vertex_shader_cache.find(vertexShader.data);
+			const fragment_program_type *fp = find_fragment_program(fragmentShader, nullptr);
+
+			if (vp != m_vertex_shader_cache.end() && fp && !m_pending_shaders.count(&vp->second) && !m_pending_shaders.count(fp))
+			{
+				const auto I = m_storage.find({ vp->second.id, fp->id, pipelineProperties });
+				if (I != m_storage.end())
+				{
+					m_last_programs_valid = true;
+					m_last_vertex_program = &vp->second;
+					m_last_fragment_program = fp;
+					m_last_pipeline = &I->second;
+					m_last_properties = pipelineProperties;
+					return &I->second;
+				}
+			}
+
+			const size_t fragment_program_size = program_hash_util::fragment_program_utils::get_fragment_program_ucode_size(const_cast<void*>(ucode));
+			const u8 *fragment_program_ucode = static_cast<const u8*>(ucode);
+
+			auto job = std::make_shared<compile_job>();
+			job->key.vertex_program = vertexShader.data;
+			job->key.fragment_program.assign(fragment_program_ucode, fragment_program_ucode + fragment_program_size);
+			job->key.properties = pipelineProperties;
+
+			if (m_failed_pipelines.count(job->key) || !m_pending_pipelines.insert(job->key).second)
+				return nullptr;
+
+			job->fragment_program = fragmentShader;
+			job->fragment_program.ucode = job->key.fragment_program.data();
+
+			std::lock_guard<std::mutex> queue_lock(m_queue_mutex);
+			m_queue.emplace_back([this, job, args...]() mutable
+			{
+				compile_pipeline(*job, args...);
+			});
+		}
+
+		m_queue_cv.notify_one();
+		return nullptr;
+	}
+
+	/**
+	* Start threads used by try_get_graphic_pipeline_state (ignored if backend can't compile in parallel).
+	*/
+	void start_compiler_threads(u32 count)
+	{
+		if (!backend_traits::parallel_shader_compilation)
+			return;
+
+		for (u32 i = 0; i < count; i++)
+		{
+			m_workers.emplace_back(thread_ctrl::spawn(COPY_EXPR(fmt::format("Shader Compiler[%u]", i)), [this]()
+			{
+				std::unique_lock<std::mutex> lock(m_queue_mutex);
+
+				while (true)
+				{
+					if (m_exit)
+					{
+						return;
+					}
+
+					if (m_queue.empty())
+					{
+						m_queue_cv.wait(lock);
+						continue;
+					}
+
+					const auto func = std::move(m_queue.front());
+					m_queue.pop_front();
+
+					lock.unlock();
+					func();
+					lock.lock();
+				}
+			}));
+		}
+
+		if (count)
+		{
+			LOG_NOTICE(RSX, "%u shader compilation threads started", count);
+		}
+	}
+
+	/**
+	* Stop compiler threads, pending compilations are discarded.
+	*/
+	void stop_compiler_threads()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_queue_mutex);
+
+			m_exit = true;
+			m_queue.clear();
+		}
+
+		m_queue_cv.notify_all();
+
+		for (auto& worker : m_workers)
+		{
+			worker->join();
+		}
+
+		m_workers.clear();
+	}
+
+	/**
+	* Returns true if try_get_graphic_pipeline_state can be used.
+	*/
+	bool has_compiler_threads() const
+	{
+		return !m_workers.empty();
+	}
+
+	/**
+	* Build every pipeline recorded in the cache file at path and record new pipelines to it.
+	* Shaders are recompiled from the stored ucode, in parallel if the backend allows it.
+	*/
+	template<typename... Args>
+	void load_pipeline_cache(const std::string &path, Args&& ...args)
+	{
+		std::vector<cached_pipeline> entries;
+
+		const fs::file f(path);
+
+		if (f && f.size())
+		{
+			// Records are only appended (never rewritten), so other instances may be using the file
+			const fs::file_read_map data(f);
+			size_t skipped;
+			entries = parse_pipeline_cache(reinterpret_cast<const u8*>(static_cast<const char*>(data)), data.size(), skipped);
+
+			if (skipped)
+			{
+				LOG_ERROR(RSX, "Pipeline cache is corrupted, %d bytes ignored", skipped);
+			}
+		}
+
+		if (!entries.empty())
+		{
+			std::vector<std::function<void()>> tasks;
+			std::vector<const void*> failed;
+			std::mutex failed_mutex;
+
+			auto add_task = [&](auto &&func, const void *program)
+			{
+				tasks.emplace_back([&, func, program]()
+				{
+					try
+					{
+						func();
+					}
+					catch (...)
+					{
+						std::lock_guard<std::mutex> lock(failed_mutex);
+						failed.push_back(program);
+					}
+				});
+			};
+
+			for (cached_pipeline &entry : entries)
+			{
+				entry.fragment_program.ucode = entry.fragment_program_ucode.data();
+
+				auto vp = m_vertex_shader_cache.find(entry.vertex_program.data);
+				if (vp == m_vertex_shader_cache.end())
+				{
+					vertex_program_type &new_shader = m_vertex_shader_cache[entry.vertex_program.data];
+					const RSXVertexProgram &rsx_vp = entry.vertex_program;
+					const size_t id = m_next_id++;
+					add_task([&new_shader, &rsx_vp, id]() { recompile_vertex_program(rsx_vp, new_shader, id); }, &new_shader);
+					entry.vp = &new_shader;
+				}
+				else
+					entry.vp = &vp->second;
+
+				auto fp = m_fragment_shader_cache.find(entry.fragment_program_ucode.data());
+				if (fp == m_fragment_shader_cache.end())
+				{
+					gsl::not_null<void*> fragment_program_ucode_copy = malloc(entry.fragment_program_ucode.size());
+					std::memcpy(fragment_program_ucode_copy, entry.fragment_program_ucode.data(), entry.fragment_program_ucode.size());
+					fragment_program_type &new_shader = m_fragment_shader_cache[fragment_program_ucode_copy];
+					const RSXFragmentProgram &rsx_fp = entry.fragment_program;
+					const size_t id = m_next_id++;
+					add_task([&new_shader, &rsx_fp, id]() { recompile_fragment_program(rsx_fp, new_shader, id); }, &new_shader);
+					entry.fp = &new_shader;
+				}
+				else
+					entry.fp = &fp->second;
+			}
+
+			const u32 thread_count = backend_traits::parallel_shader_compilation ? std::max(1u, std::thread::hardware_concurrency()) : 0;
+
+			if (thread_count && tasks.size() > 1)
+			{
+				std::atomic<size_t> next_task{ 0 };
+				std::vector<std::shared_ptr<thread_ctrl>> workers;
+
+				for (u32 i = 0; i < std::min<size_t>(thread_count, tasks.size()); i++)
+				{
+					workers.emplace_back(thread_ctrl::spawn(COPY_EXPR(fmt::format("Shader Compiler[%u]", i)), [&]()
+					{
+						for (size_t task; (task = next_task++) < tasks.size();)
+							tasks[task]();
+					}));
+				}
+
+				for (auto &worker : workers)
+					worker->join();
+			}
+			else
+			{
+				for (auto &task : tasks)
+					task();
+			}
+
+			size_t pipeline_count = 0;
+			for (const cached_pipeline &entry : entries)
+			{
+				if (std::find(failed.begin(), failed.end(), entry.vp) != failed.end() || std::find(failed.begin(), failed.end(), entry.fp) != failed.end())
+					continue;
+
+				pipeline_key key = { entry.vp->id, entry.fp->id, entry.properties };
+				if (m_storage.find(key) != m_storage.end())
+					continue;
+
+				try
+				{
+					m_storage[key] = build_pipeline(*entry.vp, *entry.fp, entry.properties, entry.blob, std::forward<Args>(args)...);
+					pipeline_count++;
+				}
+				catch (...)
+				{
+					m_storage.erase(key);
+					LOG_ERROR(RSX, "Pipeline cache: failed to build pipeline (vp id = %d, fp id = %d)", entry.vp->id, entry.fp->id);
+				}
+			}
+
+			// Drop shaders that failed to compile, they will be recompiled on use
+			for (auto It = m_vertex_shader_cache.begin(); It != m_vertex_shader_cache.end();)
+			{
+				if (std::find(failed.begin(), failed.end(), &It->second) != failed.end())
+					It = m_vertex_shader_cache.erase(It);
+				else
+					++It;
+			}
+
+			for (auto It = m_fragment_shader_cache.begin(); It != m_fragment_shader_cache.end();)
+			{
+				if (std::find(failed.begin(), failed.end(), &It->second) != failed.end())
+				{
+					free(It->first);
+					It = m_fragment_shader_cache.erase(It);
+				}
+				else
+					++It;
+			}
+
+			LOG_NOTICE(RSX, "Pipeline cache: %d pipelines loaded, %d shaders failed to compile", pipeline_count, failed.size());
+		}
+
+		if (!m_pipeline_cache_file.open(path, fom::write | fom::append | fom::create))
+			LOG_ERROR(RSX, "Pipeline cache: failed to open '%s'", path);
 	}
 
 	size_t get_fragment_constants_buffer_size(const RSXFragmentProgram &fragmentShader) const
 	{
-		const auto I = m_fragment_shader_cache.find(vm::base(fragmentShader.addr));
-		if (I != m_fragment_shader_cache.end())
-			return I->second.FragmentConstantOffsetCache.size() * 4 * sizeof(float);
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (const fragment_program_type *fp = find_current_fragment_program(fragmentShader))
+			return fp->FragmentConstantOffsetCache.size() * 4 * sizeof(float);
 		LOG_ERROR(RSX, "Can't retrieve constant offset cache");
 		return 0;
 	}
 
+	/**
+	* returns a 64 bit hash of the raw constants embedded in the current fragment program,
+	* used to skip patching and uploading them again when they did not change.
+	*/
+	u64 get_fragment_constants_hash(const RSXFragmentProgram &fragment_program) const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		const fragment_program_type *fp = find_current_fragment_program(fragment_program);
+		if (!fp)
+			return 0;
+
+		u64 hash = 0xcbf29ce484222325ull;
+		for (size_t offset_in_fragment_program : fp->FragmentConstantOffsetCache)
+		{
+			const u64 *data = (const u64*)vm::base(fragment_program.addr + (u32)offset_in_fragment_program);
+			hash = (hash ^ data[0]) * 0x100000001b3ull;
+			hash = (hash ^ data[1]) * 0x100000001b3ull;
+		}
+
+		return hash;
+	}
+
 	void fill_fragment_constans_buffer(gsl::span<f32, gsl::dynamic_range> dst_buffer, const RSXFragmentProgram &fragment_program) const
 	{
-		const auto I = m_fragment_shader_cache.find(vm::base(fragment_program.addr));
-		if (I == m_fragment_shader_cache.end())
+		std::lock_guard<std::mutex> lock(m_mutex);
+		const fragment_program_type *fp = find_current_fragment_program(fragment_program);
+		if (!fp)
 			return;
 		__m128i mask = _mm_set_epi8(0xE, 0xF, 0xC, 0xD,
 			0xA, 0xB, 0x8, 0x9,
 			0x6, 0x7, 0x4, 0x5,
 			0x2, 0x3, 0x0, 0x1);
 
-		Expects(dst_buffer.size_bytes() >= gsl::narrow<int>(I->second.FragmentConstantOffsetCache.size()) * 16);
+		Expects(dst_buffer.size_bytes() >= gsl::narrow<int>(fp->FragmentConstantOffsetCache.size()) * 16);
 
 		size_t offset = 0;
-		for (size_t offset_in_fragment_program : I->second.FragmentConstantOffsetCache)
+		for (size_t offset_in_fragment_program : fp->FragmentConstantOffsetCache)
 		{
 			void *data = vm::base(fragment_program.addr + (u32)offset_in_fragment_program);
 			const __m128i &vector = _mm_loadu_si128((__m128i*)data);
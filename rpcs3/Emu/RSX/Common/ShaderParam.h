@@ -1,6 +1,7 @@
 #pragma once
 #include <string>
 #include <vector>
+#include <cstring>
 
 enum class FUNCTION {
 	FUNCTION_DP2,
@@ -169,7 +170,7 @@ public:
 	{
 		std::unordered_map<char, char> swizzle;
 
-		static std::unordered_map<int, char> pos_to_swizzle =
+		static const std::unordered_map<int, char> pos_to_swizzle =
 		{
 			{ 0, 'x' },
 			{ 1, 'y' },
@@ -217,4 +218,50 @@ public:
 
 		return name + "." + fmt::merge({ swizzles }, ".");
 	}
-};
\ No newline at end of file
+};
+/**
+* Substitute the "$..." placeholders of a shader code line in a single pass.
+* At each '$' the tokens are tried in order, replace(index, out) appends the replacement of the matched one.
+* Unknown placeholders are kept as is and replacements are not rescanned (same result as fmt::replace_all).
+* Doesn't allocate anything but the output, so it's cheap enough to be called for every emitted line.
+*/
+template<size_t list_size, typename Replace>
+std::string format_shader_code(const std::string &code, const char *const (&tokens)[list_size], Replace replace)
+{
+	std::string result;
+	result.reserve(code.size() + 64);
+
+	for (size_t pos = 0; pos < code.size();)
+	{
+		const size_t next = code.find('$', pos);
+
+		if (next == std::string::npos)
+		{
+			result.append(code, pos, std::string::npos);
+			break;
+		}
+
+		result.append(code, pos, next - pos);
+		pos = next;
+
+		size_t i = 0;
+		for (; i < list_size; ++i)
+		{
+			const size_t length = std::strlen(tokens[i]);
+
+			if (code.compare(pos, length, tokens[i]) == 0)
+			{
+				replace(i, result);
+				pos += length;
+				break;
+			}
+		}
+
+		if (i == list_size)
+		{
+			result += code[pos++];
+		}
+	}
+
+	return result;
+}
@@ -8,6 +8,23 @@
 #define MAX2(a, b) ((a) > (b)) ? (a) : (b)
 namespace
 {
+/**
+* Copy count big endian 16 bits values from src to dst in host order.
+*/
+void copy_swapped_u16(void *dst, const void *src, size_t count)
+{
+	const __m128i mask = _mm_set_epi8(14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1);
+	u8 *casted_dst = static_cast<u8*>(dst);
+	const u8 *casted_src = static_cast<const u8*>(src);
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+		_mm_storeu_si128((__m128i*)(casted_dst + i * 2), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(casted_src + i * 2)), mask));
+
+	for (; i < count; i++)
+		((u16*)casted_dst)[i] = ((const be_t<u16>*)casted_src)[i];
+}
+
 /**
 * Write data, assume src pixels are packed but not mipmaplevel
 */
@@ -32,14 +49,18 @@ struct texel_16b_swizzled
 	{
 		u16 *castedSrc = static_cast<u16*>(src), *castedDst = static_cast<u16*>(dst);
 
+		// Rows are already 256 bytes aligned, unswizzle and swap in place
+		if (dst_pitch_in_block == src_pitch_in_block)
+		{
+			rsx::convert_linear_swizzle<u16>(castedSrc, castedDst, src_pitch_in_block, row_count, true);
+			copy_swapped_u16(castedDst, castedDst, row_count * src_pitch_in_block);
+			return;
+		}
+
 		std::unique_ptr<u16[]> temp_swizzled(new u16[row_count * width_in_block]);
 		rsx::convert_linear_swizzle<u16>(castedSrc, temp_swizzled.get(), src_pitch_in_block, row_count, true);
 		for (unsigned row = 0; row < row_count; row++)
-			for (int j = 0; j < width_in_block; j++)
-			{
-				u16 tmp = temp_swizzled[row * src_pitch_in_block + j];
-				castedDst[row * dst_pitch_in_block + j] = (tmp >> 8) | (tmp << 8);
-			}
+			copy_swapped_u16(castedDst + row * dst_pitch_in_block, temp_swizzled.get() + row * src_pitch_in_block, width_in_block);
 	}
 };
 
@@ -51,11 +72,15 @@ struct texel_rgba_swizzled
 	template<size_t block_size>
 	static void copy_mipmap_level(void *dst, void *src, size_t row_count, size_t width_in_block, size_t dst_pitch_in_block, size_t src_pitch_in_block)
 	{
-		u32 *castedSrc, *castedDst;
-		castedSrc = (u32*)src;
-		castedDst = (u32*)dst ;
+		// Rows are already 256 bytes aligned, unswizzle in place
+		if (dst_pitch_in_block == src_pitch_in_block)
+		{
+			rsx::convert_linear_swizzle<u32>(src, dst, src_pitch_in_block, row_count, true);
+			return;
+		}
+
 		std::unique_ptr<u32[]> temp_swizzled(new u32[src_pitch_in_block * row_count]);
-		rsx::convert_linear_swizzle<u32>(castedSrc, temp_swizzled.get(), src_pitch_in_block, row_count, true);
+		rsx::convert_linear_swizzle<u32>(src, temp_swizzled.get(), src_pitch_in_block, row_count, true);
 		for (unsigned row = 0; row < row_count; row++)
 			memcpy((char*)dst + row * dst_pitch_in_block * block_size, (char*)temp_swizzled.get() + row * src_pitch_in_block * block_size, width_in_block * block_size);
 	}
@@ -84,11 +109,7 @@ struct texel_16b_format {
 		unsigned short *castedDst = (unsigned short *)dst, *castedSrc = (unsigned short *)src;
 
 		for (unsigned row = 0; row < row_count; row++)
-			for (int j = 0; j < width_in_block; j++)
-			{
-				u16 tmp = castedSrc[row * src_pitch_in_block + j];
-				castedDst[row * dst_pitch_in_block + j] = (tmp >> 8) | (tmp << 8);
-			}
+			copy_swapped_u16(castedDst + row * dst_pitch_in_block, castedSrc + row * src_pitch_in_block, width_in_block);
 	}
 };
 
@@ -101,11 +122,7 @@ struct texel_16bX4_format {
 	{
 		unsigned short *casted_dst = (unsigned short *)dst, *casted_src = (unsigned short *)src;
 		for (unsigned row = 0; row < row_count; row++)
-			for (int j = 0; j < width_in_block * 4; j++)
-			{
-				u16 tmp = casted_src[row * src_pitch_in_block * 4 + j];
-				casted_dst[row * dst_pitch_in_block * 4 + j] = (tmp >> 8) | (tmp << 8);
-			}
+			copy_swapped_u16(casted_dst + row * dst_pitch_in_block * 4, casted_src + row * src_pitch_in_block * 4, width_in_block * 4);
 	}
 };
 
@@ -163,6 +180,24 @@ std::vector<MipmapLevelInfo> copy_texture_data(void *dst, const void *src, size_
 	return Result;
 }
 
+/**
+ * Copy row_count rows of mipmap level 0 starting at first_row, source rows are packed like for copy_texture_data.
+ */
+template <typename T, size_t block_size_in_bytes, size_t block_edge_in_texel>
+MipmapLevelInfo copy_texture_rows(void *dst, const void *src, size_t width_in_texel, size_t first_row, size_t row_count)
+{
+	size_t width_in_block = (width_in_texel + block_edge_in_texel - 1) / block_edge_in_texel;
+	size_t dst_pitch = align(width_in_block * block_size_in_bytes, 256) / block_size_in_bytes;
+
+	MipmapLevelInfo result = {};
+	result.width = width_in_block * block_edge_in_texel;
+	result.height = row_count * block_edge_in_texel;
+	result.rowPitch = dst_pitch * block_size_in_bytes;
+
+	T::template copy_mipmap_level<block_size_in_bytes>(dst, (char*)src + first_row * width_in_block * block_size_in_bytes, row_count, width_in_block, dst_pitch, width_in_block);
+	return result;
+}
+
 /**
  * A texture is stored as an array of blocks, where a block is a pixel for standard texture
  * but is a structure containing several pixels for compressed format
@@ -315,6 +350,90 @@ std::vector<MipmapLevelInfo> upload_placed_texture(const rsx::texture &texture,
 	}
 }
 
+bool get_texture_dirty_rows(const rsx::texture &texture, size_t begin, size_t end, size_t &first_row, size_t &row_count)
+{
+	if (texture.cubemap() || texture.depth() > 1)
+		return false;
+
+	int format = texture.format() & ~(CELL_GCM_TEXTURE_LN | CELL_GCM_TEXTURE_UN);
+	bool is_swizzled = !(texture.format() & CELL_GCM_TEXTURE_LN);
+
+	// Must match the layouts of upload_placed_texture
+	switch (format)
+	{
+	case CELL_GCM_TEXTURE_A8R8G8B8:
+	case CELL_GCM_TEXTURE_A1R5G5B5:
+	case CELL_GCM_TEXTURE_A4R4G4B4:
+	case CELL_GCM_TEXTURE_R5G6B5:
+		if (is_swizzled)
+			return false;
+		break;
+	case CELL_GCM_TEXTURE_W16_Z16_Y16_X16_FLOAT:
+	case CELL_GCM_TEXTURE_COMPRESSED_DXT1:
+	case CELL_GCM_TEXTURE_COMPRESSED_DXT23:
+	case CELL_GCM_TEXTURE_COMPRESSED_DXT45:
+	case CELL_GCM_TEXTURE_B8:
+		break;
+	default:
+		// Copied as 4 bytes texels
+		if (get_texture_block_size(format) != 4 || get_texture_block_edge(format) != 1)
+			return false;
+		break;
+	}
+
+	size_t block_edge = get_texture_block_edge(format);
+	size_t row_pitch = get_texture_block_size(format) * ((texture.width() + block_edge - 1) / block_edge);
+	size_t height_in_block = (texture.height() + block_edge - 1) / block_edge;
+	size_t level_size = row_pitch * height_in_block;
+
+	if (!row_pitch || begin >= end || begin >= level_size || (end > level_size && texture.mipmap() > 1))
+		return false;
+
+	first_row = begin / row_pitch;
+	row_count = (std::min(end, level_size) + row_pitch - 1) / row_pitch - first_row;
+	return true;
+}
+
+size_t get_placed_texture_rows_storage_size(const rsx::texture &texture, size_t rowPitchAlignement, size_t row_count)
+{
+	int format = texture.format() & ~(CELL_GCM_TEXTURE_LN | CELL_GCM_TEXTURE_UN);
+	size_t blockEdge = get_texture_block_edge(format);
+	size_t blockSizeInByte = get_texture_block_size(format);
+
+	size_t widthInBlocks = (texture.width() + blockEdge - 1) / blockEdge;
+
+	return align(blockSizeInByte * widthInBlocks, rowPitchAlignement) * row_count;
+}
+
+MipmapLevelInfo upload_placed_texture_rows(const rsx::texture &texture, size_t rowPitchAlignement, void* textureData, size_t first_row, size_t row_count)
+{
+	size_t w = texture.width();
+	int format = texture.format() & ~(CELL_GCM_TEXTURE_LN | CELL_GCM_TEXTURE_UN);
+
+	const u32 texaddr = rsx::get_address(texture.offset(), texture.location());
+	auto pixels = vm::ps3::_ptr<const u8>(texaddr);
+	switch (format)
+	{
+	case CELL_GCM_TEXTURE_A8R8G8B8:
+		return copy_texture_rows<texel_rgba, 4, 1>(textureData, pixels, w, first_row, row_count);
+	case CELL_GCM_TEXTURE_A1R5G5B5:
+	case CELL_GCM_TEXTURE_A4R4G4B4:
+	case CELL_GCM_TEXTURE_R5G6B5:
+		return copy_texture_rows<texel_16b_format, 2, 1>(textureData, pixels, w, first_row, row_count);
+	case CELL_GCM_TEXTURE_W16_Z16_Y16_X16_FLOAT:
+		return copy_texture_rows<texel_16bX4_format, 8, 1>(textureData, pixels, w, first_row, row_count);
+	case CELL_GCM_TEXTURE_COMPRESSED_DXT1:
+		return copy_texture_rows<texel_bc_format, 8, 4>(textureData, pixels, w, first_row, row_count);
+	case CELL_GCM_TEXTURE_COMPRESSED_DXT23:
+	case CELL_GCM_TEXTURE_COMPRESSED_DXT45:
+		return copy_texture_rows<texel_bc_format, 16, 4>(textureData, pixels, w, first_row, row_count);
+	case CELL_GCM_TEXTURE_B8:
+		return copy_texture_rows<texel_rgba, 1, 1>(textureData, pixels, w, first_row, row_count);
+	default:
+		return copy_texture_rows<texel_rgba, 4, 1>(textureData, pixels, w, first_row, row_count);
+	}
+}
+
 size_t get_texture_size(const rsx::texture &texture)
 {
 	size_t w = texture.width(), h = texture.height();
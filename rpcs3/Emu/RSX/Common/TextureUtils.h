@@ -23,6 +23,23 @@ size_t get_placed_texture_storage_size(const rsx::texture &texture, size_t rowPi
 */
 std::vector<MipmapLevelInfo> upload_placed_texture(const rsx::texture &texture, size_t rowPitchAlignement, void* textureData);
 
+/**
+* Get the rows of mipmap level 0 (in blocks) stored in bytes begin to end of texture memory (offsets from texture address).
+* Returns false if they can't be uploaded on their own (swizzled data, cubemap or volume, range extending to other mipmap levels).
+*/
+bool get_texture_dirty_rows(const rsx::texture &texture, size_t begin, size_t end, size_t &first_row, size_t &row_count);
+
+/**
+* Get size to store row_count rows of mipmap level 0 with rows aligned to rowPitchAlignement.
+*/
+size_t get_placed_texture_rows_storage_size(const rsx::texture &texture, size_t rowPitchAlignement, size_t row_count);
+
+/**
+* Write row_count rows of mipmap level 0 starting at first_row (in blocks) to textureData, see upload_placed_texture.
+* Rows must come from get_texture_dirty_rows, returned offset is 0 and height covers the written rows.
+*/
+MipmapLevelInfo upload_placed_texture_rows(const rsx::texture &texture, size_t rowPitchAlignement, void* textureData, size_t first_row, size_t row_count);
+
 /**
 * Get number of bytes occupied by texture in RSX mem
 */
@@ -192,32 +192,34 @@ std::string VertexProgramDecompiler::GetTex()
 
 std::string VertexProgramDecompiler::Format(const std::string& code)
 {
-	const std::pair<std::string, std::function<std::string()>> repl_list[] =
+	static const char* const tokens[] =
 	{
-		{ "$$", []() -> std::string { return "$"; } },
-		{ "$0", std::bind(std::mem_fn(&VertexProgramDecompiler::GetSRC), this, 0) },
-		{ "$1", std::bind(std::mem_fn(&VertexProgramDecompiler::GetSRC), this, 1) },
-		{ "$2", std::bind(std::mem_fn(&VertexProgramDecompiler::GetSRC), this, 2) },
-		{ "$s", std::bind(std::mem_fn(&VertexProgramDecompiler::GetSRC), this, 2) },
-		{ "$awm", std::bind(std::mem_fn(&VertexProgramDecompiler::AddAddrRegWithoutMask), this) },
-		{ "$am", std::bind(std::mem_fn(&VertexProgramDecompiler::AddAddrMask), this) },
-		{ "$a", std::bind(std::mem_fn(&VertexProgramDecompiler::AddAddrReg), this) },
-
-		{ "$t", std::bind(std::mem_fn(&VertexProgramDecompiler::GetTex), this) },
-
-		{ "$fa", [this]()->std::string { return std::to_string(GetAddr()); } },
-		{ "$f()", std::bind(std::mem_fn(&VertexProgramDecompiler::GetFunc), this) },
-		{ "$ifcond ", [this]() -> std::string
-	{
-		const std::string& cond = GetCond();
-		if (cond == "true") return "";
-		return "if(" + cond + ") ";
-	}
-		},
-		{ "$cond", std::bind(std::mem_fn(&VertexProgramDecompiler::GetCond), this) }
+		"$$", "$0", "$1", "$2", "$s", "$awm", "$am", "$a", "$t", "$fa", "$f()", "$ifcond ", "$cond",
 	};
 
-	return fmt::replace_all(code, repl_list);
+	return format_shader_code(code, tokens, [this](size_t index, std::string& out)
+	{
+		switch (index)
+		{
+		case 0: out += '$'; break;
+		case 1: out += GetSRC(0); break;
+		case 2: out += GetSRC(1); break;
+		case 3: case 4: out += GetSRC(2); break;
+		case 5: out += AddAddrRegWithoutMask(); break;
+		case 6: out += AddAddrMask(); break;
+		case 7: out += AddAddrReg(); break;
+		case 8: out += GetTex(); break;
+		case 9: out += std::to_string(GetAddr()); break;
+		case 10: out += GetFunc(); break;
+		case 11:
+		{
+			const std::string& cond = GetCond();
+			if (cond != "true") out.append("if(").append(cond).append(") ");
+			break;
+		}
+		case 12: out += GetCond(); break;
+		}
+	});
 }
 
 std::string VertexProgramDecompiler::GetCond()
@@ -343,8 +345,9 @@ u32 VertexProgramDecompiler::GetAddr()
 
 void VertexProgramDecompiler::AddCode(const std::string& code)
 {
-	m_body.push_back(Format(code) + ";");
+	// placeholders may add parameters, so the code is formatted only once
 	m_cur_instr->body.push_back(Format(code));
+	m_body.push_back(m_cur_instr->body.back() + ";");
 }
 
 void VertexProgramDecompiler::SetDSTVec(const std::string& code)
@@ -390,7 +393,16 @@ std::string VertexProgramDecompiler::BuildFuncBody(const FuncInfo& func)
 
 std::string VertexProgramDecompiler::BuildCode()
 {
+	size_t main_size = 0;
+	for (uint i = 0; i < m_instr_count; i++)
+	{
+		for (const auto& line : m_instructions[i].body)
+			main_size += line.size() + 8;
+	}
+
 	std::string main_body;
+	main_body.reserve(main_size + 256);
+
 	for (uint i = 0, lvl = 1; i < m_instr_count; i++)
 	{
 		lvl -= m_instructions[i].close_scopes;
@@ -412,7 +424,7 @@ std::string VertexProgramDecompiler::BuildCode()
 
 		for (uint j = 0; j < m_instructions[i].body.size(); ++j)
 		{
-			main_body.append(lvl, '\t') += m_instructions[i].body[j] + "\n";
+			main_body.append(lvl, '\t').append(m_instructions[i].body[j]) += '\n';
 		}
 
 		lvl += m_instructions[i].open_scopes;
@@ -429,7 +441,7 @@ std::string VertexProgramDecompiler::BuildCode()
 	OS << std::endl;
 
 	insertMainStart(OS);
-	OS << main_body.c_str() << std::endl;
+	OS.write(main_body.data(), main_body.size()) << std::endl;
 	insertMainEnd(OS);
 
 	return OS.str();
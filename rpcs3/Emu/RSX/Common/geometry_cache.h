@@ -0,0 +1,280 @@
+#pragma once
+
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "Emu/Memory/vm.h"
+
+/**
+* Backend agnostic cache of converted vertex and index arrays (static geometry).
+* Entries are keyed by the guest range and the array layout. Guest pages of cached arrays are write-protected
+* like the texture cache does, so a hit reuses the backend buffer without reading or converting guest memory.
+* Written pages are never protected again, dynamic geometry stays on the streaming path.
+*/
+namespace rsx
+{
+	template<typename Buffer>
+	class geometry_cache
+	{
+	public:
+		struct key_t
+		{
+			u32 addr;   // First byte read from guest memory
+			u32 size;   // Bytes read (may be rounded up)
+			u32 format; // Vertex type and component count, or index type and primitive restart flag
+			u32 param;  // Stride for vertex arrays, primitive restart index for index arrays
+			u32 count;  // Element count
+
+			bool operator ==(const key_t& rhs) const
+			{
+				return addr == rhs.addr && size == rhs.size && format == rhs.format && param == rhs.param && count == rhs.count;
+			}
+		};
+
+		struct entry_t
+		{
+			Buffer buffer{};
+			u32 min_index = 0; // Index arrays only
+			u32 max_index = 0;
+		};
+
+	private:
+		struct key_hash
+		{
+			std::size_t operator ()(const key_t& key) const
+			{
+				return std::hash<u64>()((u64)key.addr << 32 | key.size) ^ std::hash<u64>()((u64)key.format << 32 | key.param) * 31 ^ key.count;
+			}
+		};
+
+		struct slot_t
+		{
+			entry_t entry;
+			bool ready = false; // Reserved until publish()
+		};
+
+		static const u32 max_candidates = 0x4000;
+		static const u64 max_size = 256 * 0x100000;
+
+		/**
+		* Mutex protecting all members.
+		* Memory protection fault can be generated by any thread and modifies them.
+		*/
+		std::mutex m_mutex;
+
+		std::unordered_map<key_t, slot_t, key_hash> m_entries;
+		std::unordered_map<key_t, u32, key_hash> m_candidates; // Arrays seen once, cached when drawn again
+		std::unordered_map<u32, u32> m_pages; // Protected pages and the count of entries they contain (0 if only left protected)
+		std::unordered_set<u32> m_dynamic_pages; // Pages written by the guest after being protected
+		std::vector<Buffer> m_released; // Buffers of invalidated entries, destroyed by the render thread
+		u64 m_size = 0; // Bytes of guest memory covered by the entries
+
+		template<typename F>
+		void for_each_page(const key_t& key, F func)
+		{
+			for (u32 page = key.addr & ~0xfff; page - (key.addr & ~0xfff) < key.size + (key.addr & 0xfff); page += 4096)
+			{
+				func(page);
+			}
+		}
+
+		void remove(typename std::unordered_map<key_t, slot_t, key_hash>::iterator found)
+		{
+			for_each_page(found->first, [&](u32 page)
+			{
+				m_pages[page]--;
+			});
+
+			if (found->second.ready)
+			{
+				m_released.emplace_back(std::move(found->second.entry.buffer));
+			}
+
+			m_size -= found->first.size;
+			m_entries.erase(found);
+		}
+
+	public:
+		/**
+		* Get the cached buffer of the array (returns false on a miss).
+		*/
+		bool find(const key_t& key, entry_t& result)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			const auto found = m_entries.find(key);
+
+			if (found == m_entries.end() || !found->second.ready)
+			{
+				return false;
+			}
+
+			result = found->second.entry;
+			return true;
+		}
+
+		/**
+		* Called on a miss before reading guest memory. Returns true if the array should be cached:
+		* its pages are protected now and the converted buffer must be passed to publish().
+		*/
+		bool reserve(const key_t& key)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			if (!key.size || m_size + key.size > max_size || m_entries.count(key))
+			{
+				return false;
+			}
+
+			bool is_dynamic = false;
+
+			for_each_page(key, [&](u32 page)
+			{
+				is_dynamic |= m_dynamic_pages.count(page) != 0;
+			});
+
+			if (is_dynamic)
+			{
+				return false;
+			}
+
+			// Only arrays drawn more than once are cached
+			if (m_candidates.size() >= max_candidates)
+			{
+				m_candidates.clear();
+			}
+
+			if (m_candidates[key]++ == 0)
+			{
+				return false;
+			}
+
+			m_candidates.erase(key);
+
+			std::vector<u32> pages;
+			bool is_protected = true;
+
+			for_each_page(key, [&](u32 page)
+			{
+				if (is_protected && (m_pages.count(page) || vm::page_protect(page, 4096, 0, 0, vm::page_writable)))
+				{
+					m_pages[page]++;
+					pages.emplace_back(page);
+				}
+				else
+				{
+					is_protected = false;
+				}
+			});
+
+			if (!is_protected)
+			{
+				// Some pages aren't mapped, the protected ones stay protected until written
+				for (u32 page : pages)
+				{
+					m_pages[page]--;
+				}
+
+				return false;
+			}
+
+			m_entries[key];
+			m_size += key.size;
+			return true;
+		}
+
+		/**
+		* Cache the converted array reserved by reserve(). Returns false if the guest wrote it meanwhile (the buffer isn't taken).
+		*/
+		bool publish(const key_t& key, const entry_t& entry)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			const auto found = m_entries.find(key);
+
+			if (found == m_entries.end() || found->second.ready)
+			{
+				return false;
+			}
+
+			found->second.entry = entry;
+			found->second.ready = true;
+			return true;
+		}
+
+		/**
+		* Drop entries containing addr and unprotect its page. Returns false if the page isn't protected by the cache.
+		*/
+		bool invalidate_address(u32 addr)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			const u32 page = addr & ~0xfff;
+
+			if (!m_pages.count(page))
+			{
+				return false;
+			}
+
+			for (auto it = m_entries.begin(); it != m_entries.end();)
+			{
+				const auto& key = it->first;
+
+				if (page + 4096 > key.addr && page < key.addr + key.size)
+				{
+					remove(it++);
+				}
+				else
+				{
+					it++;
+				}
+			}
+
+			// Other pages of the removed entries stay protected, unprotecting them could hide writes from other caches
+			m_pages.erase(page);
+			m_dynamic_pages.emplace(page);
+			vm::page_protect(page, 4096, 0, vm::page_writable, 0);
+			return true;
+		}
+
+		/**
+		* Take the buffers of invalidated entries (must be destroyed by the render thread).
+		*/
+		std::vector<Buffer> collect()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			std::vector<Buffer> result;
+			result.swap(m_released);
+			return result;
+		}
+
+		/**
+		* Unprotect memory and drop all entries, returns all buffers to be destroyed.
+		*/
+		std::vector<Buffer> clear()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			while (!m_entries.empty())
+			{
+				remove(m_entries.begin());
+			}
+
+			for (const auto& page : m_pages)
+			{
+				vm::page_protect(page.first, 4096, 0, vm::page_writable, 0);
+			}
+
+			m_pages.clear();
+			m_candidates.clear();
+			m_dynamic_pages.clear();
+
+			std::vector<Buffer> result;
+			result.swap(m_released);
+			return result;
+		}
+	};
+}
@@ -0,0 +1,244 @@
+#pragma once
+
+#include "Utilities/Thread.h"
+
+#include <chrono>
+#include <deque>
+#include <functional>
+
+namespace rsx
+{
+	/**
+	* Presents completed frames on a dedicated thread, so the RSX thread can process the next frame while the previous one is presented.
+	* Each queued frame owns a slot (e.g. a backend texture) which is released once the frame is presented or dropped.
+	* In mailbox mode a new frame replaces the pending ones instead of waiting for a free slot (lowest latency, frames can be dropped).
+	*/
+	class present_thread
+	{
+		struct frame_t
+		{
+			u32 slot;
+			std::function<void()> present;
+		};
+
+		std::shared_ptr<thread_ctrl> m_thread;
+
+		std::mutex m_mutex;
+		std::condition_variable m_cv;
+		std::condition_variable m_done_cv;
+		std::deque<frame_t> m_queue;
+		std::vector<bool> m_slot_used;
+		u32 m_queue_size = 0;
+		bool m_mailbox = false;
+		bool m_presenting = false;
+		bool m_exit = false;
+
+	public:
+		u64 presented = 0;
+		u64 dropped = 0;
+
+		present_thread() = default;
+		present_thread(const present_thread&) = delete;
+
+		~present_thread()
+		{
+			stop();
+		}
+
+		/**
+		* on_start and on_stop run on the present thread, e.g. to make a graphics context current there.
+		*/
+		void start(u32 queue_size, bool mailbox, std::function<void()> on_start = nullptr, std::function<void()> on_stop = nullptr)
+		{
+			m_queue_size = std::max<u32>(queue_size, 1);
+			m_mailbox = mailbox;
+			m_slot_used.assign(m_queue_size + 1, false);
+
+			m_thread = thread_ctrl::spawn(PURE_EXPR("RSX Present"s), [this, on_start, on_stop]()
+			{
+				if (on_start)
+				{
+					on_start();
+				}
+
+				std::unique_lock<std::mutex> lock(m_mutex);
+
+				while (!m_exit)
+				{
+					if (m_queue.empty())
+					{
+						m_cv.wait(lock);
+						continue;
+					}
+
+					frame_t frame = std::move(m_queue.front());
+					m_queue.pop_front();
+					m_presenting = true;
+
+					lock.unlock();
+					frame.present();
+					lock.lock();
+
+					m_presenting = false;
+					m_slot_used[frame.slot] = false;
+					presented++;
+					m_done_cv.notify_all();
+				}
+
+				// Frames left in the queue are never presented
+				for (auto &frame : m_queue)
+				{
+					m_slot_used[frame.slot] = false;
+				}
+
+				m_queue.clear();
+				m_done_cv.notify_all();
+				lock.unlock();
+
+				if (on_stop)
+				{
+					on_stop();
+				}
+			});
+		}
+
+		void stop()
+		{
+			if (!m_thread)
+			{
+				return;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_exit = true;
+			}
+
+			m_cv.notify_all();
+			m_thread->join();
+			m_thread.reset();
+			m_exit = false;
+		}
+
+		explicit operator bool() const
+		{
+			return m_thread.operator bool();
+		}
+
+		/**
+		* Number of slots, one more than the queue size so a frame can be prepared while the queue is full.
+		*/
+		u32 slot_count() const
+		{
+			return m_queue_size + 1;
+		}
+
+		/**
+		* Returns a slot which is neither queued nor being presented, waiting for one if needed.
+		* In mailbox mode the oldest pending frame is dropped instead of waiting.
+		*/
+		u32 acquire_slot()
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+
+			while (true)
+			{
+				for (u32 i = 0; i < m_slot_used.size(); i++)
+				{
+					if (!m_slot_used[i])
+					{
+						m_slot_used[i] = true;
+						return i;
+					}
+				}
+
+				if (m_mailbox && !m_queue.empty())
+				{
+					m_slot_used[m_queue.front().slot] = false;
+					m_queue.pop_front();
+					dropped++;
+					continue;
+				}
+
+				m_done_cv.wait(lock);
+			}
+		}
+
+		/**
+		* Queue a frame prepared in the slot returned by acquire_slot().
+		*/
+		void push(u32 slot, std::function<void()> present)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+
+				if (m_mailbox)
+				{
+					for (auto &frame : m_queue)
+					{
+						m_slot_used[frame.slot] = false;
+						dropped++;
+					}
+
+					m_queue.clear();
+				}
+
+				m_queue.push_back({ slot, std::move(present) });
+			}
+
+			m_cv.notify_one();
+		}
+
+		/**
+		* Wait until every queued frame is presented (or dropped).
+		*/
+		void wait_idle()
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+
+			while (m_thread && (!m_queue.empty() || m_presenting))
+			{
+				m_done_cv.wait(lock);
+			}
+		}
+	};
+
+	/**
+	* Frame pacing for the "Frame limit" setting.
+	* Sleeps until shortly before the next frame is due and spins for the rest, sleep granularity is often 1ms or worse.
+	*/
+	class frame_limiter
+	{
+		using clock = std::chrono::steady_clock;
+
+		clock::time_point m_next;
+
+	public:
+		void wait(double fps)
+		{
+			const auto now = clock::now();
+			const auto period = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / fps));
+
+			// Start again after a pause or a change of the limit instead of catching up
+			if (m_next.time_since_epoch().count() == 0 || now > m_next + period || m_next - now > period)
+			{
+				m_next = now + period;
+				return;
+			}
+
+			const auto spin_time = std::chrono::microseconds(1500);
+
+			if (m_next - now > spin_time)
+			{
+				std::this_thread::sleep_for(m_next - now - spin_time);
+			}
+
+			while (clock::now() < m_next)
+			{
+				std::this_thread::yield();
+			}
+
+			m_next += period;
+		}
+	};
+}
@@ -0,0 +1,169 @@
+#include "stdafx.h"
+#include "shader_binary_cache.h"
+#include "Emu/RemoteCache.h"
+#include "Emu/PerfCounters.h"
+
+namespace
+{
+	// FNV-1a
+	u64 hash_bytes(u64 hash, const void *data, size_t size)
+	{
+		const u8 *bytes = static_cast<const u8*>(data);
+
+		for (size_t i = 0; i < size; i++)
+		{
+			hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+		}
+
+		return hash;
+	}
+}
+
+namespace rsx
+{
+	shader_binary_cache::~shader_binary_cache()
+	{
+		perf::mem_add(perf::mem_shader_cache, -s64(m_size));
+	}
+
+	void shader_binary_cache::open(const std::string &path, const std::string &driver_id)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		m_driver_hash = hash_bytes(0xcbf29ce484222325ull, driver_id.data(), driver_id.size());
+		m_entries.clear();
+		m_file.close();
+		perf::mem_add(perf::mem_shader_cache, -s64(m_size));
+		m_size = 0;
+
+		const fs::file f(path);
+
+		if (f && f.size())
+		{
+			const fs::file_read_map content(f);
+			const u8 *const begin = reinterpret_cast<const u8*>(static_cast<const char*>(content));
+			const size_t size = content.size();
+			size_t pos = 0, skipped = 0;
+
+			while (size - pos >= sizeof(record_header))
+			{
+				record_header header;
+				std::memcpy(&header, begin + pos, sizeof(header));
+
+				if (header.magic != record_magic || header.size > size - pos - sizeof(header))
+				{
+					// The file may be shared by several instances appending to it, so damaged records (an interrupted write)
+					// are skipped instead of truncating the file: resync on the next record magic
+					pos++;
+					skipped++;
+					continue;
+				}
+
+				const u8 *data = begin + pos + sizeof(header);
+				entry &stored = m_entries[header.key];
+				m_size += header.size - stored.data.size();
+				stored = { header.format, { data, data + header.size } };
+				pos += sizeof(header) + header.size;
+			}
+
+			if (skipped || pos != size)
+			{
+				LOG_ERROR(RSX, "Shader binary cache is corrupted, %d bytes ignored", skipped + size - pos);
+			}
+
+			perf::mem_add(perf::mem_shader_cache, m_size);
+			LOG_NOTICE(RSX, "Shader binary cache: %d binaries loaded", m_entries.size());
+		}
+
+		if (!m_file.open(path, fom::write | fom::append | fom::create))
+		{
+			LOG_ERROR(RSX, "Shader binary cache: failed to open '%s'", path);
+		}
+	}
+
+	u64 shader_binary_cache::get_key(std::initializer_list<const std::string*> sources) const
+	{
+		u64 hash = m_driver_hash;
+
+		for (const std::string *source : sources)
+		{
+			const u64 size = source->size();
+			hash = hash_bytes(hash, &size, sizeof(size));
+			hash = hash_bytes(hash, source->data(), source->size());
+		}
+
+		return hash;
+	}
+
+	bool shader_binary_cache::find(u64 key, u32 &format, std::vector<u8> &data)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			const auto found = m_entries.find(key);
+
+			if (found != m_entries.end())
+			{
+				format = found->second.format;
+				data = found->second.data;
+				return true;
+			}
+
+			if (!m_file)
+			{
+				return false;
+			}
+		}
+
+		// Remote entry: format followed by the binary (the key already identifies the driver)
+		std::vector<u8> remote;
+
+		if (!remote_cache::get("shader", fmt::format("%016llx", key), remote) || remote.size() <= sizeof(u32))
+		{
+			return false;
+		}
+
+		std::memcpy(&format, remote.data(), sizeof(u32));
+		data.assign(remote.begin() + sizeof(u32), remote.end());
+		store_local(key, format, data.data(), data.size());
+		return true;
+	}
+
+	void shader_binary_cache::store(u64 key, u32 format, const void *data, size_t size)
+	{
+		if (store_local(key, format, data, size) && remote_cache::is_enabled())
+		{
+			std::vector<u8> remote(sizeof(u32) + size);
+			std::memcpy(remote.data(), &format, sizeof(u32));
+			std::memcpy(remote.data() + sizeof(u32), data, size);
+			remote_cache::put("shader", fmt::format("%016llx", key), std::move(remote));
+		}
+	}
+
+	bool shader_binary_cache::store_local(u64 key, u32 format, const void *data, size_t size)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		if (!m_file || !m_entries.emplace(key, entry{ format, { static_cast<const u8*>(data), static_cast<const u8*>(data) + size } }).second)
+		{
+			return false;
+		}
+
+		m_size += size;
+		perf::mem_add(perf::mem_shader_cache, size);
+
+		record_header header;
+		header.magic = record_magic;
+		header.format = format;
+		header.size = gsl::narrow<u32>(size);
+		header.reserved = 0;
+		header.key = key;
+
+		// Write the whole record at once so that an interrupted write only truncates the last one
+		std::vector<u8> record(sizeof(header) + size);
+		std::memcpy(record.data(), &header, sizeof(header));
+		std::memcpy(record.data() + sizeof(header), data, size);
+		m_file.write(record);
+		return true;
+	}
+}
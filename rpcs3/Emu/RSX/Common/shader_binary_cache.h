@@ -0,0 +1,70 @@
+#pragma once
+
+#include <unordered_map>
+
+namespace rsx
+{
+	/**
+	* Persistent store of compiled shader binaries (DXBC blobs, GL program binaries).
+	* Entries are keyed by a hash of the shader source and of the driver identity given to open(),
+	* so binaries produced by another driver or adapter are never returned. Safe to use from compiler threads.
+	*/
+	class shader_binary_cache
+	{
+		/**
+		* File record, followed by size bytes of binary.
+		* format is backend defined (GL binary format enum, 0 for DXBC).
+		*/
+		struct record_header
+		{
+			u32 magic;
+			u32 format;
+			u32 size;
+			u32 reserved;
+			u64 key;
+		};
+
+		static const u32 record_magic = 0x31434253; // "SBC1"
+
+		struct entry
+		{
+			u32 format;
+			std::vector<u8> data;
+		};
+
+		mutable std::mutex m_mutex;
+		std::unordered_map<u64, entry> m_entries;
+		fs::file m_file;
+		u64 m_driver_hash = 0;
+		size_t m_size = 0; // Bytes of binaries in m_entries
+
+		// Add the entry and append it to the file (returns false if it's already known)
+		bool store_local(u64 key, u32 format, const void *data, size_t size);
+
+	public:
+		~shader_binary_cache();
+
+		/**
+		* Load the records of path and append new binaries to it.
+		* The file can be shared by several instances: records are appended with a single write and never rewritten.
+		*/
+		void open(const std::string &path, const std::string &driver_id);
+
+		bool is_open() const
+		{
+			return static_cast<bool>(m_file);
+		}
+
+		/**
+		* Key of a shader; sources given as several parts (e.g. vertex and fragment text of a GL program) are hashed in order.
+		*/
+		u64 get_key(std::initializer_list<const std::string*> sources) const;
+
+		/**
+		* Get the binary, local misses are looked up in the remote cache (see Emu/RemoteCache.h).
+		*/
+		bool find(u64 key, u32 &format, std::vector<u8> &data);
+
+		void store(u64 key, u32 format, const void *data, size_t size);
+	};
+}
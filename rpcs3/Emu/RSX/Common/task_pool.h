@@ -0,0 +1,181 @@
+#pragma once
+
+#include "Utilities/Thread.h"
+
+#include <deque>
+#include <exception>
+#include <functional>
+
+namespace rsx
+{
+	/**
+	* Worker threads running batches of independent tasks for the RSX thread.
+	* run() returns once every task of the batch is done, the calling thread takes part in the work.
+	* Without worker the tasks simply run on the calling thread.
+	*/
+	class task_pool
+	{
+		std::vector<std::shared_ptr<thread_ctrl>> m_workers;
+
+		std::mutex m_mutex;
+		std::condition_variable m_cv;
+		std::condition_variable m_done_cv;
+		std::deque<std::function<void()>> m_tasks;
+		size_t m_running = 0;
+		std::exception_ptr m_exception;
+		bool m_exit = false;
+
+		/**
+		* Run one queued task, lock must be held and is held again on return.
+		*/
+		void run_one(std::unique_lock<std::mutex> &lock)
+		{
+			const auto func = std::move(m_tasks.front());
+			m_tasks.pop_front();
+			m_running++;
+
+			lock.unlock();
+
+			std::exception_ptr exception;
+			try
+			{
+				func();
+			}
+			catch (...)
+			{
+				exception = std::current_exception();
+			}
+
+			lock.lock();
+
+			if (exception && !m_exception)
+				m_exception = exception;
+
+			if (--m_running == 0 && m_tasks.empty())
+				m_done_cv.notify_all();
+		}
+
+	public:
+		task_pool() = default;
+		task_pool(const task_pool&) = delete;
+
+		~task_pool()
+		{
+			stop();
+		}
+
+		void start(u32 count, const std::string &name)
+		{
+			for (u32 i = 0; i < count; i++)
+			{
+				m_workers.emplace_back(thread_ctrl::spawn(COPY_EXPR(fmt::format("%s[%u]", name, i)), [this]()
+				{
+					std::unique_lock<std::mutex> lock(m_mutex);
+
+					while (true)
+					{
+						if (m_exit)
+						{
+							return;
+						}
+
+						if (m_tasks.empty())
+						{
+							m_cv.wait(lock);
+							continue;
+						}
+
+						run_one(lock);
+					}
+				}));
+			}
+		}
+
+		void stop()
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_exit = true;
+			}
+
+			m_cv.notify_all();
+
+			for (auto &worker : m_workers)
+			{
+				worker->join();
+			}
+
+			m_workers.clear();
+			m_exit = false;
+		}
+
+		size_t size() const
+		{
+			return m_workers.size();
+		}
+
+		/**
+		* Run all tasks and wait for them. The first exception thrown by a task is rethrown here.
+		*/
+		void run(std::vector<std::function<void()>> &tasks)
+		{
+			if (m_workers.empty() || tasks.size() < 2)
+			{
+				for (auto &task : tasks)
+				{
+					task();
+				}
+
+				tasks.clear();
+				return;
+			}
+
+			std::unique_lock<std::mutex> lock(m_mutex);
+
+			for (auto &task : tasks)
+			{
+				m_tasks.emplace_back(std::move(task));
+			}
+
+			tasks.clear();
+			m_cv.notify_all();
+
+			while (!m_tasks.empty())
+			{
+				run_one(lock);
+			}
+
+			while (m_running)
+			{
+				m_done_cv.wait(lock);
+			}
+
+			if (m_exception)
+			{
+				std::exception_ptr exception = m_exception;
+				m_exception = nullptr;
+				std::rethrow_exception(exception);
+			}
+		}
+
+		/**
+		* Split count rows in ranges of at least min_rows rows, func(first, count) is called for each range.
+		*/
+		template<typename F>
+		void run_rows(size_t count, size_t min_rows, F func)
+		{
+			const size_t ranges = std::max<size_t>(1, std::min<size_t>(m_workers.size() + 1, count / std::max<size_t>(min_rows, 1)));
+			const size_t range_size = (count + ranges - 1) / ranges;
+
+			std::vector<std::function<void()>> tasks;
+
+			for (size_t first = 0; first < count; first += range_size)
+			{
+				const size_t rows = std::min(range_size, count - first);
+				tasks.emplace_back([=]() { func(first, rows); });
+			}
+
+			run(tasks);
+		}
+	};
+}
@@ -23,6 +23,10 @@ std::vector<D3D12_VERTEX_BUFFER_VIEW> D3D12GSRender::upload_vertex_attributes(co
 
 	u32 input_mask = rsx::method_registers[NV4097_SET_VERTEX_ATTRIB_INPUT_MASK];
 
+	// Arrays are converted in parallel once all heap ranges are allocated
+	std::vector<std::function<void()>> conversions;
+	std::vector<std::pair<ID3D12Resource*, D3D12_RANGE>> mapped_ranges;
+
 	for (int index = 0; index < rsx::limits::vertex_count; ++index)
 	{
 		bool enabled = !!(input_mask & (1 << index));
@@ -40,12 +44,17 @@ std::vector<D3D12_VERTEX_BUFFER_VIEW> D3D12GSRender::upload_vertex_attributes(co
 			size_t heap_offset = m_buffer_data.alloc<D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT>(buffer_size);
 
 			void *mapped_buffer = m_buffer_data.map<void>(CD3DX12_RANGE(heap_offset, heap_offset + buffer_size));
-			for (const auto &range : vertex_ranges)
+			mapped_ranges.emplace_back(m_buffer_data.get_heap(), CD3DX12_RANGE(heap_offset, heap_offset + buffer_size));
+
+			conversions.emplace_back([mapped_buffer, &vertex_ranges, index, &info, element_size]()
 			{
-				write_vertex_array_data_to_buffer(mapped_buffer, range.first, range.second, index, info);
-				mapped_buffer = (char*)mapped_buffer + range.second * element_size;
-			}
-			m_buffer_data.unmap(CD3DX12_RANGE(heap_offset, heap_offset + buffer_size));
+				char *dst = (char*)mapped_buffer;
+				for (const auto &range : vertex_ranges)
+				{
+					write_vertex_array_data_to_buffer(dst, range.first, range.second, index, info);
+					dst += range.second * element_size;
+				}
+			});
 
 			D3D12_VERTEX_BUFFER_VIEW vertex_buffer_view =
 			{
@@ -102,6 +111,13 @@ std::vector<D3D12_VERTEX_BUFFER_VIEW> D3D12GSRender::upload_vertex_attributes(co
 		}
 	}
 
+	m_upload_pool.run(conversions);
+
+	for (const auto &range : mapped_ranges)
+	{
+		range.first->Unmap(0, &range.second);
+	}
+
 	return vertex_buffer_views;
 }
 
@@ -56,6 +56,17 @@ void D3D12FragmentDecompiler::insertHeader(std::stringstream & OS)
 	OS << "	int tex14_is_unorm;" << std::endl;
 	OS << "	int tex15_is_unorm;" << std::endl;
 	OS << "};" << std::endl;
+
+	// Specialized variants define these macros as constants (see fragment_specialization)
+	OS << "#ifndef SPEC_isAlphaTested" << std::endl;
+	OS << "#define SPEC_isAlphaTested isAlphaTested" << std::endl;
+	OS << "#endif" << std::endl;
+	for (int i = 0; i < 16; i++)
+	{
+		OS << "#ifndef SPEC_tex" << i << "_is_unorm" << std::endl;
+		OS << "#define SPEC_tex" << i << "_is_unorm tex" << i << "_is_unorm" << std::endl;
+		OS << "#endif" << std::endl;
+	}
 }
 
 void D3D12FragmentDecompiler::insertIntputs(std::stringstream & OS)
@@ -191,7 +202,7 @@ void D3D12FragmentDecompiler::insertMainStart(std::stringstream & OS)
 			size_t textureIndex = atoi(PI.name.data() + 3);
 			OS << "	float2  " << PI.name << "_dim;" << std::endl;
 			OS << "	" << PI.name << ".GetDimensions(" << PI.name << "_dim.x, " << PI.name << "_dim.y);" << std::endl;
-			OS << "	float2  " << PI.name << "_scale = (!!" << PI.name << "_is_unorm) ? float2(1., 1.) / " << PI.name << "_dim : float2(1., 1.);" << std::endl;
+			OS << "	float2  " << PI.name << "_scale = (!!SPEC_" << PI.name << "_is_unorm) ? float2(1., 1.) / " << PI.name << "_dim : float2(1., 1.);" << std::endl;
 		}
 	}
 }
@@ -236,7 +247,7 @@ void D3D12FragmentDecompiler::insertMainEnd(std::stringstream & OS)
 		OS << "	Out.depth = " << ((m_ctrl & CELL_GCM_SHADER_CONTROL_32_BITS_EXPORTS) ? "r1.z;" : "h0.z;") << std::endl;
 	// Shaders don't always output colors (for instance if they write to depth only)
 	if (num_output > 0)
-		OS << "	if (isAlphaTested && Out.ocol0.a <= alphaRef) discard;" << std::endl;
+		OS << "	if (SPEC_isAlphaTested && Out.ocol0.a <= alphaRef) discard;" << std::endl;
 	OS << "	return Out;" << std::endl;
 	OS << "}" << std::endl;
 }
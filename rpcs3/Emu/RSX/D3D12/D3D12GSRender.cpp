@@ -9,6 +9,7 @@
 #include "d3dx12.h"
 #include <d3d11on12.h>
 #include "Emu/state.h"
+#include "Utilities/Trace.h"
 #include "D3D12Formats.h"
 #include "../rsx_methods.h"
 
@@ -17,6 +18,7 @@ PFN_D3D12_GET_DEBUG_INTERFACE wrapD3D12GetDebugInterface;
 PFN_D3D12_SERIALIZE_ROOT_SIGNATURE wrapD3D12SerializeRootSignature;
 PFN_D3D11ON12_CREATE_DEVICE wrapD3D11On12CreateDevice;
 pD3DCompile wrapD3DCompile;
+decltype(&D3DCreateBlob) wrapD3DCreateBlob;
 
 namespace
 {
@@ -34,6 +36,7 @@ void loadD3D12FunctionPointers()
 	wrapD3D11On12CreateDevice = (PFN_D3D11ON12_CREATE_DEVICE)GetProcAddress(D3D11Module, "D3D11On12CreateDevice");
 	CHECK_ASSERTION(D3DCompiler = LoadLibrary(L"d3dcompiler_47.dll"));
 	wrapD3DCompile = (pD3DCompile)GetProcAddress(D3DCompiler, "D3DCompile");
+	wrapD3DCreateBlob = (decltype(&D3DCreateBlob))GetProcAddress(D3DCompiler, "D3DCreateBlob");
 }
 
 void unloadD3D12FunctionPointers()
@@ -72,7 +75,21 @@ extern std::function<bool(u32 addr)> gfxHandler;
 bool D3D12GSRender::invalidate_address(u32 addr)
 {
 	bool result = false;
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_readback_mutex);
+		for (const pending_readback &readback : m_pending_readbacks)
+		{
+			if (addr >= readback.protected_start && addr - readback.protected_start < readback.protected_size)
+			{
+				result = true;
+				break;
+			}
+		}
+		if (result)
+			complete_pending_readbacks();
+	}
 	result |= m_texture_cache.invalidate_address(addr);
+	result |= on_report_access(addr);
 	return result;
 }
 
@@ -108,6 +125,8 @@ D3D12GSRender::D3D12GSRender()
 	ComPtr<IDXGIAdapter> adaptater = nullptr;
 	CHECK_HRESULT(dxgi_factory->EnumAdapters(rpcs3::state.config.rsx.d3d12.adaptater.value(), adaptater.GetAddressOf()));
 	CHECK_HRESULT(wrapD3D12CreateDevice(adaptater.Get(), D3D_FEATURE_LEVEL_11_0, IID_PPV_ARGS(&m_device)));
+	if (FAILED(adaptater.As(&m_adapter)))
+		LOG_WARNING(RSX, "Video memory budget is not available, texture cache is unbounded");
 
 	// Queues
 	D3D12_COMMAND_QUEUE_DESC graphic_queue_desc = { D3D12_COMMAND_LIST_TYPE_DIRECT };
@@ -156,14 +175,16 @@ D3D12GSRender::D3D12GSRender()
 			// Samplers
 			CD3DX12_DESCRIPTOR_RANGE(D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER, texture_count, 0),
 		};
-		CD3DX12_ROOT_PARAMETER RP[2];
-		RP[0].InitAsDescriptorTable((texture_count > 0) ? 3 : 2, &descriptorRange[0]);
+		// Textures get their own table so that it can be reused by draws binding the same textures
+		CD3DX12_ROOT_PARAMETER RP[3];
+		RP[0].InitAsDescriptorTable(2, &descriptorRange[0]);
 		RP[1].InitAsDescriptorTable(1, &descriptorRange[3]);
+		RP[2].InitAsDescriptorTable(1, &descriptorRange[2]);
 
 		Microsoft::WRL::ComPtr<ID3DBlob> rootSignatureBlob;
 		Microsoft::WRL::ComPtr<ID3DBlob> errorBlob;
 		CHECK_HRESULT(wrapD3D12SerializeRootSignature(
-			&CD3DX12_ROOT_SIGNATURE_DESC((texture_count > 0) ? 2 : 1, RP, 0, 0, D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT),
+			&CD3DX12_ROOT_SIGNATURE_DESC((texture_count > 0) ? 3 : 1, RP, 0, 0, D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT),
 			D3D_ROOT_SIGNATURE_VERSION_1, &rootSignatureBlob, &errorBlob));
 
 		m_device->CreateRootSignature(0,
@@ -172,6 +193,24 @@ D3D12GSRender::D3D12GSRender()
 			IID_PPV_ARGS(m_root_signatures[texture_count].GetAddressOf()));
 	}
 
+	if (rpcs3::state.config.rsx.shader_binary_cache.value())
+	{
+		DXGI_ADAPTER_DESC adapter_desc;
+		CHECK_HRESULT(adaptater->GetDesc(&adapter_desc));
+		const std::string &driver_id = fmt::format("%04x:%04x:%08x:%x", adapter_desc.VendorId, adapter_desc.DeviceId, adapter_desc.SubSysId, adapter_desc.Revision);
+		g_d3d12_shader_binaries.open(rsx::shaders_cache::path_to_shader_binary_cache("hlsl"), driver_id);
+	}
+
+	if (rpcs3::state.config.rsx.pipeline_cache.value())
+		m_pso_cache.load_pipeline_cache(rsx::shaders_cache::path_to_pipeline_cache("hlsl"), m_device.Get(), m_root_signatures);
+
+	m_pso_cache.start_compiler_threads(rpcs3::state.config.rsx.shader_compiler_threads.value());
+	m_upload_pool.start(rpcs3::state.config.rsx.upload_threads.value(), "D3D12 Upload");
+
+	// The next flip renders to the back buffer being presented, a deeper queue would not help
+	if (rpcs3::state.config.rsx.present_thread.value())
+		m_present_thread.start(1, false);
+
 	m_per_frame_storage[0].init(m_device.Get());
 	m_per_frame_storage[0].reset();
 	m_per_frame_storage[1].init(m_device.Get());
@@ -192,15 +231,54 @@ D3D12GSRender::D3D12GSRender()
 
 	m_rtts.init(m_device.Get());
 	m_readback_resources.init(m_device.Get(), 1024 * 1024 * 128, D3D12_HEAP_TYPE_READBACK, D3D12_RESOURCE_STATE_COPY_DEST);
+	CHECK_HRESULT(m_device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(m_readback_fence.GetAddressOf())));
+	m_readback_fence_event = CreateEventEx(nullptr, FALSE, FALSE, EVENT_ALL_ACCESS);
+
 	m_buffer_data.init(m_device.Get(), 1024 * 1024 * 896, D3D12_HEAP_TYPE_UPLOAD, D3D12_RESOURCE_STATE_GENERIC_READ);
 
-	if (rpcs3::config.rsx.d3d12.overlay.value())
+	D3D12_QUERY_HEAP_DESC query_heap_desc = { D3D12_QUERY_HEAP_TYPE_OCCLUSION, occlusion_query_count, 0 };
+	CHECK_HRESULT(m_device->CreateQueryHeap(&query_heap_desc, IID_PPV_ARGS(m_query_heap.GetAddressOf())));
+	CHECK_HRESULT(
+		m_device->CreateCommittedResource(
+			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK),
+			D3D12_HEAP_FLAG_NONE,
+			&CD3DX12_RESOURCE_DESC::Buffer(occlusion_query_count * sizeof(u64)),
+			D3D12_RESOURCE_STATE_COPY_DEST,
+			nullptr,
+			IID_PPV_ARGS(m_query_readback_buffer.GetAddressOf()))
+		);
+	CHECK_HRESULT(m_device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(m_query_fence.GetAddressOf())));
+	m_query_fence_event = CreateEventEx(nullptr, FALSE, FALSE, EVENT_ALL_ACCESS);
+	for (u32 i = occlusion_query_count; i > 0; i--)
+		m_free_queries.push_back(i - 1);
+
+	m_overlay_enabled = rpcs3::config.rsx.d3d12.overlay.value() || rpcs3::config.rsx.perf_overlay.value();
+
+	if (m_overlay_enabled)
 		init_d2d_structures();
 }
 
 D3D12GSRender::~D3D12GSRender()
 {
+	m_present_thread.stop();
+	m_pso_cache.stop_compiler_threads();
+	m_upload_pool.stop();
+	complete_pending_readbacks();
 	wait_for_command_queue(m_device.Get(), m_command_queue.Get());
+	CloseHandle(m_readback_fence_event);
+	CloseHandle(m_query_fence_event);
+
+	LOG_NOTICE(RSX, "Upload heap: %lld waits, %lld dedicated allocations (%lld bytes)", m_buffer_data.stats.wait_count, m_buffer_data.stats.dedicated_count, m_buffer_data.stats.dedicated_size);
+	LOG_NOTICE(RSX, "Readback heap: %lld waits, %lld dedicated allocations (%lld bytes)", m_readback_resources.stats.wait_count, m_readback_resources.stats.dedicated_count, m_readback_resources.stats.dedicated_size);
+
+	LOG_NOTICE(RSX, "Texture cache: %lld hits, %lld misses, %lld evictions, %lld reuses", m_texture_cache.stats.hits, m_texture_cache.stats.misses, m_texture_cache.stats.evictions, m_texture_cache.stats.reuses);
+
+	for (const resource_storage &storage : m_per_frame_storage)
+	{
+		LOG_NOTICE(RSX, "Descriptor tables: %lld/%lld texture tables reused, %lld/%lld sampler tables reused",
+			storage.stats.texture_table_hits, storage.stats.texture_table_hits + storage.stats.texture_table_misses,
+			storage.stats.sampler_table_hits, storage.stats.sampler_table_hits + storage.stats.sampler_table_misses);
+	}
 
 	m_texture_cache.unprotect_all();
 
@@ -217,6 +295,7 @@ D3D12GSRender::~D3D12GSRender()
 
 void D3D12GSRender::on_exit()
 {
+	m_present_thread.wait_idle();
 }
 
 bool D3D12GSRender::do_method(u32 cmd, u32 arg)
@@ -232,6 +311,10 @@ bool D3D12GSRender::do_method(u32 cmd, u32 arg)
 	case NV4097_BACK_END_WRITE_SEMAPHORE_RELEASE:
 		copy_render_target_to_dma_location();
 		return false; //call rsx::thread method implementation
+	case NV4097_GET_REPORT:
+		// Cell may wait on the report to read surfaces
+		complete_pending_readbacks();
+		return false; //call rsx::thread method implementation
 
 	default:
 		return false;
@@ -240,6 +323,8 @@ bool D3D12GSRender::do_method(u32 cmd, u32 arg)
 
 void D3D12GSRender::end()
 {
+	_log::timeline_scope scope("rsx", "draw");
+
 	std::chrono::time_point<std::chrono::system_clock> start_duration = std::chrono::system_clock::now();
 
 	std::chrono::time_point<std::chrono::system_clock> rtt_duration_start = std::chrono::system_clock::now();
@@ -258,10 +343,17 @@ void D3D12GSRender::end()
 	m_timers.m_vertex_index_duration += std::chrono::duration_cast<std::chrono::microseconds>(vertex_index_duration_end - vertex_index_duration_start).count();
 
 	std::chrono::time_point<std::chrono::system_clock> program_load_start = std::chrono::system_clock::now();
-	load_program();
+	const bool program_ready = load_program();
 	std::chrono::time_point<std::chrono::system_clock> program_load_end = std::chrono::system_clock::now();
 	m_timers.m_program_load_duration += std::chrono::duration_cast<std::chrono::microseconds>(program_load_end - program_load_start).count();
 
+	if (!program_ready)
+	{
+		// Pipeline is compiling in background, skip the draw rather than stall
+		thread::end();
+		return;
+	}
+
 	get_current_resource_storage().command_list->SetGraphicsRootSignature(m_root_signatures[std::get<2>(m_current_pso)].Get());
 	get_current_resource_storage().command_list->OMSetStencilRef(rsx::method_registers[NV4097_SET_STENCIL_FUNC_REF]);
 
@@ -281,20 +373,13 @@ void D3D12GSRender::end()
 	std::chrono::time_point<std::chrono::system_clock> texture_duration_start = std::chrono::system_clock::now();
 	if (std::get<2>(m_current_pso) > 0)
 	{
-		upload_and_bind_textures(get_current_resource_storage().command_list.Get(), currentDescriptorIndex + 3, std::get<2>(m_current_pso) > 0);
-
-
 		get_current_resource_storage().command_list->SetGraphicsRootDescriptorTable(0,
 			CD3DX12_GPU_DESCRIPTOR_HANDLE(get_current_resource_storage().descriptors_heap->GetGPUDescriptorHandleForHeapStart())
 			.Offset((INT)currentDescriptorIndex, g_descriptor_stride_srv_cbv_uav)
 			);
-		get_current_resource_storage().command_list->SetGraphicsRootDescriptorTable(1,
-			CD3DX12_GPU_DESCRIPTOR_HANDLE(get_current_resource_storage().sampler_descriptor_heap[get_current_resource_storage().sampler_descriptors_heap_index]->GetGPUDescriptorHandleForHeapStart())
-			.Offset((INT)get_current_resource_storage().current_sampler_index, g_descriptor_stride_samplers)
-			);
+		get_current_resource_storage().descriptors_heap_index += 3;
 
-		get_current_resource_storage().current_sampler_index += std::get<2>(m_current_pso);
-		get_current_resource_storage().descriptors_heap_index += std::get<2>(m_current_pso) + 3;
+		upload_and_bind_textures(get_current_resource_storage().command_list.Get(), std::get<2>(m_current_pso));
 	}
 	else
 	{
@@ -339,8 +424,10 @@ void D3D12GSRender::end()
 
 	if (rpcs3::config.rsx.d3d12.debug_output.value())
 	{
+		end_zpass_query();
 		CHECK_HRESULT(get_current_resource_storage().command_list->Close());
 		m_command_queue->ExecuteCommandLists(1, (ID3D12CommandList**)get_current_resource_storage().command_list.GetAddressOf());
+		submit_occlusion_queries();
 		get_current_resource_storage().set_new_command_list();
 	}
 	thread::end();
@@ -365,8 +452,27 @@ bool is_flip_surface_in_global_memory(Surface_target color_target)
 }
 }
 
+void D3D12GSRender::update_texture_cache_budget()
+{
+	if (!m_adapter)
+		return;
+
+	DXGI_QUERY_VIDEO_MEMORY_INFO info;
+	if (FAILED(m_adapter->QueryVideoMemoryInfo(0, DXGI_MEMORY_SEGMENT_GROUP_LOCAL, &info)))
+		return;
+
+	// Keep 10% of the budget free, and never shrink the cache below 64 MB
+	const UINT64 cache_size = m_texture_cache.get_size();
+	const UINT64 other_usage = info.CurrentUsage > cache_size ? info.CurrentUsage - cache_size : 0;
+	const UINT64 available = info.Budget > other_usage + info.Budget / 10 ? info.Budget - other_usage - info.Budget / 10 : 0;
+	m_texture_cache.set_budget((size_t)std::max<UINT64>(available, 64 * 1024 * 1024));
+}
+
 void D3D12GSRender::flip(int buffer)
 {
+	// Queries can't span command lists
+	end_zpass_query();
+
 	ID3D12Resource *resource_to_flip;
 	float viewport_w, viewport_h;
 
@@ -430,6 +536,9 @@ void D3D12GSRender::flip(int buffer)
 			resource_to_flip = nullptr;
 	}
 
+	// The back buffer index only advances once the previous frame is presented
+	m_present_thread.wait_idle();
+
 	get_current_resource_storage().command_list->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_backbuffer[m_swap_chain->GetCurrentBackBufferIndex()].Get(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET));
 
 	D3D12_VIEWPORT viewport =
@@ -441,6 +550,20 @@ void D3D12GSRender::flip(int buffer)
 		0.f,
 		1.f
 	};
+
+	const bool resc_enabled = get_resc_config().enabled;
+
+	// libresc conversion, the source surface is drawn scaled into its output area
+	if (resc_enabled)
+	{
+		const areai area = get_flip_output_area(gcm_buffers[gcm_current_buffer].width, gcm_buffers[gcm_current_buffer].height, { (int)viewport.Width, (int)viewport.Height });
+
+		viewport.TopLeftX = (float)area.x1;
+		viewport.TopLeftY = (float)area.y1;
+		viewport.Width = (float)(area.x2 - area.x1);
+		viewport.Height = (float)(area.y2 - area.y1);
+	}
+
 	get_current_resource_storage().command_list->RSSetViewports(1, &viewport);
 
 	D3D12_RECT box =
@@ -493,6 +616,16 @@ void D3D12GSRender::flip(int buffer)
 	get_current_resource_storage().command_list->OMSetRenderTargets(1,
 		&CD3DX12_CPU_DESCRIPTOR_HANDLE(m_backbuffer_descriptor_heap[m_swap_chain->GetCurrentBackBufferIndex()]->GetCPUDescriptorHandleForHeapStart()),
 		true, nullptr);
+
+	// The letterbox area is not covered by the pass
+	if (resc_enabled)
+	{
+		const float clear_color[] = { 0.f, 0.f, 0.f, 1.f };
+		get_current_resource_storage().command_list->ClearRenderTargetView(
+			CD3DX12_CPU_DESCRIPTOR_HANDLE(m_backbuffer_descriptor_heap[m_swap_chain->GetCurrentBackBufferIndex()]->GetCPUDescriptorHandleForHeapStart()),
+			clear_color, 0, nullptr);
+	}
+
 	D3D12_VERTEX_BUFFER_VIEW vertex_buffer_view = {};
 	vertex_buffer_view.BufferLocation = m_output_scaling_pass.m_vertexBuffer->GetGPUVirtualAddress();
 	vertex_buffer_view.StrideInBytes = 4 * sizeof(float);
@@ -502,24 +635,41 @@ void D3D12GSRender::flip(int buffer)
 	if (resource_to_flip)
 		get_current_resource_storage().command_list->DrawInstanced(4, 1, 0, 0);
 
-	if (!rpcs3::config.rsx.d3d12.overlay.value())
+	if (!m_overlay_enabled)
 		get_current_resource_storage().command_list->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_backbuffer[m_swap_chain->GetCurrentBackBufferIndex()].Get(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
 	if (is_flip_surface_in_global_memory(to_surface_target(rsx::method_registers[NV4097_SET_SURFACE_COLOR_TARGET])) && resource_to_flip != nullptr)
 		get_current_resource_storage().command_list->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(resource_to_flip, D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_RENDER_TARGET));
 	CHECK_HRESULT(get_current_resource_storage().command_list->Close());
 	m_command_queue->ExecuteCommandLists(1, (ID3D12CommandList**)get_current_resource_storage().command_list.GetAddressOf());
+	submit_occlusion_queries();
 
-	if(rpcs3::config.rsx.d3d12.overlay.value())
+	if (m_overlay_enabled)
 		render_overlay();
 
 	reset_timer();
 
 	std::chrono::time_point<std::chrono::system_clock> flip_start = std::chrono::system_clock::now();
 
-	CHECK_HRESULT(m_swap_chain->Present(rpcs3::state.config.rsx.vsync.value() ? 1 : 0, 0));
+	const UINT sync_interval = rpcs3::state.config.rsx.vsync.value() ? 1 : 0;
+
+	if (m_present_thread)
+	{
+		const u32 slot = m_present_thread.acquire_slot();
+		m_present_thread.push(slot, [this, sync_interval]()
+		{
+			CHECK_HRESULT(m_swap_chain->Present(sync_interval, 0));
+			m_frame->flip(nullptr);
+		});
+	}
+	else
+	{
+		CHECK_HRESULT(m_swap_chain->Present(sync_interval, 0));
+	}
+
 	// Add an event signaling queue completion
 
-	resource_storage &storage = get_non_current_resource_storage();
+	resource_storage &storage = get_current_resource_storage();
+	m_frame_index = 1 - m_frame_index;
 
 	m_command_queue->Signal(storage.frame_finished_fence.Get(), storage.fence_value);
 	storage.frame_finished_fence->SetEventOnCompletion(storage.fence_value, storage.frame_finished_handle);
@@ -529,29 +679,160 @@ void D3D12GSRender::flip(int buffer)
 	storage.dirty_textures.merge(m_rtts.invalidated_resources);
 	m_rtts.invalidated_resources.clear();
 
-	// Get the put pos - 1. This way after cleaning we can set the get ptr to
-	// this value, allowing heap to proceed even if we cleant before allocating
-	// a new value (that's the reason of the -1)
-	storage.buffer_heap_get_pos = m_buffer_data.get_current_put_pos_minus_one();
-	storage.readback_heap_get_pos = m_readback_resources.get_current_put_pos_minus_one();
+	// Evicted textures may be used by the frame just submitted
+	update_texture_cache_budget();
+	m_texture_cache.evict(storage.dirty_textures);
+
+	// Readback data has to be consumed before its heap space can be reclaimed
+	complete_pending_readbacks();
+
+	// Heap space used by this frame is reclaimed as soon as the GPU is done with it
+	m_buffer_data.signal(m_command_queue.Get());
+	m_readback_resources.signal(m_command_queue.Get());
 
 	// Now get ready for next frame
 	resource_storage &new_storage = get_current_resource_storage();
 
 	new_storage.wait_and_clean();
-	if (new_storage.in_use)
-	{
-		m_buffer_data.m_get_pos = new_storage.buffer_heap_get_pos;
-		m_readback_resources.m_get_pos = new_storage.readback_heap_get_pos;
-	}
 
-	m_frame->flip(nullptr);
+	if (!m_present_thread)
+		m_frame->flip(nullptr);
 
 
 	std::chrono::time_point<std::chrono::system_clock> flip_end = std::chrono::system_clock::now();
 	m_timers.m_flip_duration += std::chrono::duration_cast<std::chrono::microseconds>(flip_end - flip_start).count();
 }
 
+u32 D3D12GSRender::begin_occlusion_query()
+{
+	if (m_free_queries.empty())
+	{
+		LOG_WARNING(RSX, "Out of occlusion queries");
+		return 0;
+	}
+
+	const u32 index = m_free_queries.back();
+	m_free_queries.pop_back();
+
+	get_current_resource_storage().command_list->BeginQuery(m_query_heap.Get(), D3D12_QUERY_TYPE_OCCLUSION, index);
+	return index + 1;
+}
+
+void D3D12GSRender::end_occlusion_query(u32 query)
+{
+	const u32 index = query - 1;
+
+	get_current_resource_storage().command_list->EndQuery(m_query_heap.Get(), D3D12_QUERY_TYPE_OCCLUSION, index);
+	get_current_resource_storage().command_list->ResolveQueryData(m_query_heap.Get(), D3D12_QUERY_TYPE_OCCLUSION, index, 1, m_query_readback_buffer.Get(), index * sizeof(u64));
+	m_unsubmitted_queries.push_back(index);
+}
+
+bool D3D12GSRender::check_occlusion_query(u32 query)
+{
+	const UINT64 value = m_query_submit_value[query - 1];
+	return value && m_query_fence->GetCompletedValue() >= value;
+}
+
+u32 D3D12GSRender::get_occlusion_query_result(u32 query)
+{
+	const u32 index = query - 1;
+
+	if (!m_query_submit_value[index])
+	{
+		end_zpass_query();
+		CHECK_HRESULT(get_current_resource_storage().command_list->Close());
+		m_command_queue->ExecuteCommandLists(1, (ID3D12CommandList**)get_current_resource_storage().command_list.GetAddressOf());
+		submit_occlusion_queries();
+		get_current_resource_storage().set_new_command_list();
+	}
+
+	if (m_query_fence->GetCompletedValue() < m_query_submit_value[index])
+	{
+		CHECK_HRESULT(m_query_fence->SetEventOnCompletion(m_query_submit_value[index], m_query_fence_event));
+		WaitForSingleObjectEx(m_query_fence_event, INFINITE, FALSE);
+	}
+
+	D3D12_RANGE range = { index * sizeof(u64), (index + 1) * sizeof(u64) };
+	void *buffer;
+	CHECK_HRESULT(m_query_readback_buffer->Map(0, &range, &buffer));
+	const u64 result = static_cast<u64*>(buffer)[index];
+	m_query_readback_buffer->Unmap(0, &D3D12_RANGE{ 0, 0 });
+
+	m_query_submit_value[index] = 0;
+	m_free_queries.push_back(index);
+	return (u32)result;
+}
+
+u32 D3D12GSRender::begin_gpu_timer()
+{
+	if (!m_timer_query_heap)
+	{
+		D3D12_QUERY_HEAP_DESC timer_heap_desc = { D3D12_QUERY_HEAP_TYPE_TIMESTAMP, gpu_timer_count * 2, 0 };
+		CHECK_HRESULT(m_device->CreateQueryHeap(&timer_heap_desc, IID_PPV_ARGS(m_timer_query_heap.GetAddressOf())));
+		CHECK_HRESULT(
+			m_device->CreateCommittedResource(
+				&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK),
+				D3D12_HEAP_FLAG_NONE,
+				&CD3DX12_RESOURCE_DESC::Buffer(gpu_timer_count * 2 * sizeof(u64)),
+				D3D12_RESOURCE_STATE_COPY_DEST,
+				nullptr,
+				IID_PPV_ARGS(m_timer_readback_buffer.GetAddressOf()))
+			);
+		CHECK_HRESULT(m_command_queue->GetTimestampFrequency(&m_timestamp_frequency));
+		for (u32 i = gpu_timer_count; i > 0; i--)
+			m_free_timers.push_back(i - 1);
+	}
+
+	if (m_free_timers.empty())
+	{
+		return 0;
+	}
+
+	const u32 index = m_free_timers.back();
+	m_free_timers.pop_back();
+
+	get_current_resource_storage().command_list->EndQuery(m_timer_query_heap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, index * 2);
+	return index + 1;
+}
+
+void D3D12GSRender::end_gpu_timer(u32 query)
+{
+	const u32 index = query - 1;
+
+	get_current_resource_storage().command_list->EndQuery(m_timer_query_heap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, index * 2 + 1);
+	get_current_resource_storage().command_list->ResolveQueryData(m_timer_query_heap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, index * 2, 2, m_timer_readback_buffer.Get(), index * 2 * sizeof(u64));
+}
+
+u64 D3D12GSRender::get_gpu_timer_result(u32 query)
+{
+	const u32 index = query - 1;
+
+	// The command list holding the timestamps was executed by the flip ending the replayed frames
+	wait_for_command_queue(m_device.Get(), m_command_queue.Get());
+
+	D3D12_RANGE range = { index * 2 * sizeof(u64), (index + 1) * 2 * sizeof(u64) };
+	void *buffer;
+	CHECK_HRESULT(m_timer_readback_buffer->Map(0, &range, &buffer));
+	const u64 begin = static_cast<u64*>(buffer)[index * 2];
+	const u64 end = static_cast<u64*>(buffer)[index * 2 + 1];
+	m_timer_readback_buffer->Unmap(0, &D3D12_RANGE{ 0, 0 });
+
+	m_free_timers.push_back(index);
+	return m_timestamp_frequency && end > begin ? (u64)((end - begin) * 1e9 / m_timestamp_frequency) : 0;
+}
+
+void D3D12GSRender::submit_occlusion_queries()
+{
+	if (m_unsubmitted_queries.empty())
+		return;
+
+	m_command_queue->Signal(m_query_fence.Get(), ++m_query_fence_value);
+
+	for (u32 index : m_unsubmitted_queries)
+		m_query_submit_value[index] = m_query_fence_value;
+	m_unsubmitted_queries.clear();
+}
+
 void D3D12GSRender::reset_timer()
 {
 	m_timers.m_draw_calls_count = 0;
@@ -567,11 +848,11 @@ void D3D12GSRender::reset_timer()
 
 resource_storage& D3D12GSRender::get_current_resource_storage()
 {
-	return m_per_frame_storage[m_swap_chain->GetCurrentBackBufferIndex()];
+	return m_per_frame_storage[m_frame_index];
 }
 
 resource_storage& D3D12GSRender::get_non_current_resource_storage()
 {
-	return m_per_frame_storage[1 - m_swap_chain->GetCurrentBackBufferIndex()];
+	return m_per_frame_storage[1 - m_frame_index];
 }
 #endif
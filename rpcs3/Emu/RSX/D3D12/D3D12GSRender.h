@@ -10,6 +10,8 @@
 #include "D3D12PipelineState.h"
 #include "d3dx12.h"
 #include "D3D12MemoryHelpers.h"
+#include "../Common/task_pool.h"
+#include "../Common/present_thread.h"
 
 
 /**
@@ -53,6 +55,7 @@ private:
 	ComPtr<ID3D12Device> m_device;
 	ComPtr<ID3D12CommandQueue> m_command_queue;
 	ComPtr<struct IDXGISwapChain3> m_swap_chain;
+	ComPtr<struct IDXGIAdapter3> m_adapter; // Video memory budget queries
 	ComPtr<ID3D12Resource> m_backbuffer[2];
 	ComPtr<ID3D12DescriptorHeap> m_backbuffer_descriptor_heap[2];
 	// m_rootSignatures[N] is RS with N texture/sample
@@ -62,6 +65,11 @@ private:
 	data_cache m_texture_cache;
 	bool invalidate_address(u32 addr);
 
+	/**
+	* Fit the texture cache in the video memory left by other allocations of the process.
+	*/
+	void update_texture_cache_budget();
+
 	rsx::surface_info m_surface;
 
 	RSXVertexProgram vertex_program;
@@ -109,6 +117,9 @@ private:
 	void initConvertShader();
 
 	resource_storage m_per_frame_storage[2];
+	// Index of the storage used by the frame being recorded, follows the swap chain back buffer index
+	// but does not depend on the (possibly asynchronous) Present
+	u32 m_frame_index = 0;
 	resource_storage &get_current_resource_storage();
 	resource_storage &get_non_current_resource_storage();
 
@@ -116,6 +127,71 @@ private:
 	data_heap m_buffer_data;
 	data_heap m_readback_resources;
 
+	/**
+	 * Surface copy to guest memory recorded at a semaphore release.
+	 * The GPU copy runs asynchronously, data is written to guest memory (and pages unprotected)
+	 * only when Cell touches the range, at next readback, report or flip.
+	 */
+	struct pending_readback
+	{
+		u32 address;
+		u32 protected_start;
+		u32 protected_size;
+		// Resource returned by get_heap() at allocation time, may be a dedicated one
+		ComPtr<ID3D12Resource> resource;
+		size_t offset_in_heap;
+		size_t src_pitch;
+		size_t dst_pitch;
+		u32 height;
+		// Depth is read back as one byte per pixel, replicated to the 4 bytes of the guest pixel
+		bool is_depth;
+	};
+
+	// Accessed from the access violation handler of any thread
+	std::recursive_mutex m_readback_mutex;
+	std::vector<pending_readback> m_pending_readbacks;
+	ComPtr<ID3D12Fence> m_readback_fence;
+	HANDLE m_readback_fence_event;
+	UINT64 m_readback_fence_value = 0;
+	// Depth conversion resources have to live until the GPU is done
+	ComPtr<ID3D12Resource> m_readback_depth_conversion_buffer;
+	ComPtr<ID3D12DescriptorHeap> m_readback_descriptor_heap;
+
+	/**
+	 * Wait for pending readbacks and write them to guest memory.
+	 */
+	void complete_pending_readbacks();
+
+	// Occlusion queries backing ZPASS reports, index + 1 is the query handle
+	static const u32 occlusion_query_count = 1024;
+	ComPtr<ID3D12QueryHeap> m_query_heap;
+	ComPtr<ID3D12Resource> m_query_readback_buffer; // Results are resolved at index * 8
+	ComPtr<ID3D12Fence> m_query_fence;
+	HANDLE m_query_fence_event;
+	UINT64 m_query_fence_value = 0;
+	// Fence value signaled after the command list holding the query is executed, 0 while recording
+	std::array<UINT64, occlusion_query_count> m_query_submit_value = {};
+	std::vector<u32> m_free_queries;
+	std::vector<u32> m_unsubmitted_queries;
+
+	/**
+	 * Signal the query fence for queries recorded in the command list that was just executed.
+	 */
+	void submit_occlusion_queries();
+
+	// Timestamp pairs for the capture replay statistics (created on first use), index + 1 is the timer handle
+	static const u32 gpu_timer_count = 4096;
+	ComPtr<ID3D12QueryHeap> m_timer_query_heap;
+	ComPtr<ID3D12Resource> m_timer_readback_buffer; // Begin and end timestamps are resolved at index * 16
+	UINT64 m_timestamp_frequency = 0;
+	std::vector<u32> m_free_timers;
+
+	// Vertex conversion and texture decoding of a draw, command recording stays on the RSX thread
+	rsx::task_pool m_upload_pool;
+
+	// Present() and the frame window update, if the present thread is enabled
+	rsx::present_thread m_present_thread;
+
 	render_targets m_rtts;
 
 	std::vector<D3D12_INPUT_ELEMENT_DESC> m_IASet;
@@ -141,7 +217,11 @@ private:
 	void init_d2d_structures();
 	void release_d2d_structures();
 
-	void load_program();
+	/**
+	 * Set m_current_pso for the current draw.
+	 * Returns false if the pipeline is still compiling in background, the draw must be skipped.
+	 */
+	bool load_program();
 
 	void set_rtt_and_ds(ID3D12GraphicsCommandList *command_list);
 
@@ -169,10 +249,11 @@ private:
 	/**
 	 * Fetch all textures recorded in the state in the render target cache and in the texture cache.
 	 * If a texture is not cached, populate cmdlist with uploads command.
-	 * Create necessary resource view/sampler descriptors in the per frame storage struct.
-	 * If the count of enabled texture is below texture_count, fills with dummy texture and sampler.
+	 * Bind resource view/sampler descriptor tables for the first texture_count units, tables already written
+	 * in the per frame storage with the same content are reused.
+	 * Disabled units get a dummy texture and sampler.
 	 */
-	void upload_and_bind_textures(ID3D12GraphicsCommandList *command_list, size_t descriptor_index, size_t texture_count);
+	void upload_and_bind_textures(ID3D12GraphicsCommandList *command_list, size_t texture_count);
 
 	/**
 	 * Creates render target if necessary.
@@ -181,6 +262,11 @@ private:
 	 */
 	void prepare_render_targets(ID3D12GraphicsCommandList *command_list);
 
+	/**
+	 * Debug overlay or performance overlay enabled (read once, D2D structures are only created if set).
+	 */
+	bool m_overlay_enabled = false;
+
 	/**
 	 * Render D2D overlay if enabled on top of the backbuffer.
 	 */
@@ -190,6 +276,7 @@ private:
 
 	/**
 	 * Copy currently bound current target to the dma location affecting them.
+	 * Doesn't wait for the GPU, see pending_readback.
 	 * NOTE: We should also copy previously bound rtts.
 	 */
 	void copy_render_target_to_dma_location();
@@ -200,6 +287,14 @@ protected:
 	virtual void end() override;
 	virtual void flip(int buffer) override;
 
+	virtual u32 begin_occlusion_query() override;
+	virtual void end_occlusion_query(u32 query) override;
+	virtual bool check_occlusion_query(u32 query) override;
+	virtual u32 get_occlusion_query_result(u32 query) override;
+	virtual u32 begin_gpu_timer() override;
+	virtual void end_gpu_timer(u32 query) override;
+	virtual u64 get_gpu_timer_result(u32 query) override;
+
 	virtual void copy_render_targets_to_memory(void *buffer, u8 rtt) override;
 	virtual void copy_depth_buffer_to_memory(void *buffer) override;
 	virtual void copy_stencil_buffer_to_memory(void *buffer) override;
@@ -2,47 +2,139 @@
 #include "stdafx_d3d12.h"
 #ifdef _MSC_VER
 #include "D3D12MemoryHelpers.h"
+#include "Emu/PerfCounters.h"
 
 
+namespace
+{
+	size_t get_allocation_size(ID3D12Resource *resource)
+	{
+		ComPtr<ID3D12Device> device;
+		CHECK_HRESULT(resource->GetDevice(IID_PPV_ARGS(device.GetAddressOf())));
+		const D3D12_RESOURCE_DESC &desc = resource->GetDesc();
+		return (size_t)device->GetResourceAllocationInfo(0, 1, &desc).SizeInBytes;
+	}
+
+	bool is_same_description(const D3D12_RESOURCE_DESC &lhs, const D3D12_RESOURCE_DESC &rhs)
+	{
+		return lhs.Dimension == rhs.Dimension && lhs.Format == rhs.Format && lhs.Width == rhs.Width && lhs.Height == rhs.Height &&
+			lhs.DepthOrArraySize == rhs.DepthOrArraySize && lhs.MipLevels == rhs.MipLevels && lhs.Flags == rhs.Flags;
+	}
+}
+
 void data_cache::store_and_protect_data(u64 key, u32 start, size_t size, u8 format, size_t w, size_t h, size_t m, ComPtr<ID3D12Resource> data)
 {
+	const size_t allocation_size = get_allocation_size(data.Get());
+
 	std::lock_guard<std::mutex> lock(m_mut);
+	if (m_address_to_data.count(key))
+		erase(key);
 	m_address_to_data[key] = std::make_pair(texture_entry(format, w, h, m), data);
-	protect_data(key, start, size);
+	m_lru.push_front(key);
+	m_lru_info[key] = std::make_pair(m_lru.begin(), allocation_size);
+	m_size += allocation_size;
+	perf::mem_add(perf::mem_texture_cache, s64(allocation_size));
+	protect_key(key, start, size);
 }
 
 void data_cache::protect_data(u64 key, u32 start, size_t size)
+{
+	std::lock_guard<std::mutex> lock(m_mut);
+	protect_key(key, start, size);
+}
+
+void data_cache::protect_key(u64 key, u32 start, size_t size)
 {
 	/// align start to 4096 byte
 	static const u32 memory_page_size = 4096;
 	u32 protected_range_start = start & ~(memory_page_size - 1);
-	u32 protected_range_size = (u32)align(size, memory_page_size);
+	u32 protected_range_size = (u32)align(start + size, memory_page_size) - protected_range_start;
+
+	// Pages left of the previous ranges are covered by the new one
+	m_protected_ranges.remove_if([key](const std::tuple<u64, u32, u32> &range) { return std::get<0>(range) == key; });
 	m_protected_ranges.push_back(std::make_tuple(key, protected_range_start, protected_range_size));
 	vm::page_protect(protected_range_start, protected_range_size, 0, 0, vm::page_writable);
+
+	auto data = m_address_to_data.find(key);
+	if (data != m_address_to_data.end())
+	{
+		texture_entry &entry = data->second.first;
+		entry.m_is_dirty = false;
+		entry.m_dirty_start = entry.m_dirty_end = 0;
+		entry.m_protected_start = protected_range_start;
+		entry.m_protected_size = protected_range_size;
+	}
+}
+
+void data_cache::mark_dirty_page(u64 key, u32 page)
+{
+	static const u32 memory_page_size = 4096;
+
+	texture_entry &entry = m_address_to_data[key].first;
+	if (entry.m_is_dirty && entry.m_dirty_start == entry.m_dirty_end)
+		return;
+
+	if (!entry.m_is_dirty)
+	{
+		entry.m_is_dirty = true;
+		entry.m_dirty_start = page;
+		entry.m_dirty_end = page + memory_page_size;
+	}
+	else
+	{
+		entry.m_dirty_start = std::min(entry.m_dirty_start, page);
+		entry.m_dirty_end = std::max(entry.m_dirty_end, page + memory_page_size);
+	}
+
+	// Most of the data is being written: stop faulting on every page, it will be uploaded entirely
+	if ((entry.m_dirty_end - entry.m_dirty_start) * 2 > entry.m_protected_size)
+	{
+		entry.m_dirty_start = entry.m_dirty_end = 0;
+		unprotect_key(key);
+	}
 }
 
 bool data_cache::invalidate_address(u32 addr)
 {
-	bool handled = false;
-	auto It = m_protected_ranges.begin(), E = m_protected_ranges.end();
-	for (; It != E;)
+	static const u32 memory_page_size = 4096;
+	const u32 page = addr & ~(memory_page_size - 1);
+
+	std::lock_guard<std::mutex> lock(m_mut);
+	std::vector<u64> keys;
+	for (auto It = m_protected_ranges.begin(); It != m_protected_ranges.end();)
 	{
-		auto currentIt = It;
-		++It;
-		auto protectedTexture = *currentIt;
-		u32 protectedRangeStart = std::get<1>(protectedTexture), protectedRangeSize = std::get<2>(protectedTexture);
-		if (addr >= protectedRangeStart && addr <= protectedRangeSize + protectedRangeStart)
+		u64 key = std::get<0>(*It);
+		u32 protectedRangeStart = std::get<1>(*It), protectedRangeSize = std::get<2>(*It);
+		if (page < protectedRangeStart || page - protectedRangeStart >= protectedRangeSize)
 		{
-			std::lock_guard<std::mutex> lock(m_mut);
-			u64 texadrr = std::get<0>(protectedTexture);
-			m_address_to_data[texadrr].first.m_is_dirty = true;
-
-			vm::page_protect(protectedRangeStart, protectedRangeSize, 0, vm::page_writable, 0);
-			m_protected_ranges.erase(currentIt);
-			handled = true;
+			++It;
+			continue;
 		}
+
+		// Keep pages around the written one protected
+		if (page > protectedRangeStart)
+			m_protected_ranges.insert(It, std::make_tuple(key, protectedRangeStart, page - protectedRangeStart));
+		if (page + memory_page_size < protectedRangeStart + protectedRangeSize)
+			m_protected_ranges.insert(It, std::make_tuple(key, page + memory_page_size, protectedRangeStart + protectedRangeSize - page - memory_page_size));
+		It = m_protected_ranges.erase(It);
+		keys.push_back(key);
 	}
-	return handled;
+
+	if (keys.empty())
+		return false;
+
+	vm::page_protect(page, memory_page_size, 0, vm::page_writable, 0);
+
+	for (u64 key : keys)
+		mark_dirty_page(key, page);
+	return true;
+}
+
+void data_cache::touch(u64 key)
+{
+	auto found = m_lru_info.find(key);
+	if (found != m_lru_info.end())
+		m_lru.splice(m_lru.begin(), m_lru, found->second.first);
 }
 
 std::pair<texture_entry, ComPtr<ID3D12Resource> > *data_cache::find_data_if_available(u64 key)
@@ -50,7 +142,12 @@ std::pair<texture_entry, ComPtr<ID3D12Resource> > *data_cache::find_data_if_avai
 	std::lock_guard<std::mutex> lock(m_mut);
 	auto It = m_address_to_data.find(key);
 	if (It == m_address_to_data.end())
+	{
+		stats.misses++;
 		return nullptr;
+	}
+	stats.hits++;
+	touch(key);
 	return &It->second;
 }
 
@@ -62,22 +159,153 @@ void data_cache::unprotect_all()
 		u32 protectedRangeStart = std::get<1>(protectedTexture), protectedRangeSize = std::get<2>(protectedTexture);
 		vm::page_protect(protectedRangeStart, protectedRangeSize, 0, vm::page_writable, 0);
 	}
+	m_protected_ranges.clear();
 }
 
-ComPtr<ID3D12Resource> data_cache::remove_from_cache(u64 key)
+void data_cache::unprotect_key(u64 key)
 {
-	auto result = m_address_to_data[key].second;
-	m_address_to_data.erase(key);
+	static const u32 memory_page_size = 4096;
+
+	std::vector<std::pair<u32, u32>> removed;
+	for (auto It = m_protected_ranges.begin(); It != m_protected_ranges.end();)
+	{
+		if (std::get<0>(*It) == key)
+		{
+			removed.emplace_back(std::get<1>(*It), std::get<2>(*It));
+			It = m_protected_ranges.erase(It);
+		}
+		else
+			++It;
+	}
+
+	for (const auto &range : removed)
+	{
+		const u32 end = range.first + range.second;
+		u32 run_start = range.first;
+
+		for (u32 page = range.first; page < end; page += memory_page_size)
+		{
+			const bool covered = std::any_of(m_protected_ranges.begin(), m_protected_ranges.end(), [&](const std::tuple<u64, u32, u32> &other)
+			{
+				return page >= std::get<1>(other) && page < std::get<1>(other) + std::get<2>(other);
+			});
+
+			if (covered)
+			{
+				if (page > run_start)
+					vm::page_protect(run_start, page - run_start, 0, vm::page_writable, 0);
+				run_start = page + memory_page_size;
+			}
+		}
+
+		if (end > run_start)
+			vm::page_protect(run_start, end - run_start, 0, vm::page_writable, 0);
+	}
+}
+
+std::pair<ComPtr<ID3D12Resource>, size_t> data_cache::erase(u64 key)
+{
+	std::pair<ComPtr<ID3D12Resource>, size_t> result = {};
+
+	auto data = m_address_to_data.find(key);
+	if (data != m_address_to_data.end())
+	{
+		result.first = data->second.second;
+		m_address_to_data.erase(data);
+	}
+
+	auto info = m_lru_info.find(key);
+	if (info != m_lru_info.end())
+	{
+		result.second = info->second.second;
+		m_size -= info->second.second;
+		perf::mem_add(perf::mem_texture_cache, -s64(info->second.second));
+		m_lru.erase(info->second.first);
+		m_lru_info.erase(info);
+	}
+
 	return result;
 }
 
+ComPtr<ID3D12Resource> data_cache::remove_from_cache(u64 key)
+{
+	std::lock_guard<std::mutex> lock(m_mut);
+	unprotect_key(key);
+	return erase(key).first;
+}
+
+void data_cache::recycle(u64 key)
+{
+	std::lock_guard<std::mutex> lock(m_mut);
+	unprotect_key(key);
+	auto released = erase(key);
+	if (!released.first)
+		return;
+
+	m_reusable.push_back(released);
+	m_size += released.second;
+	perf::mem_add(perf::mem_texture_cache, s64(released.second));
+}
+
+ComPtr<ID3D12Resource> data_cache::take_reusable(const D3D12_RESOURCE_DESC &desc)
+{
+	std::lock_guard<std::mutex> lock(m_mut);
+	for (auto It = m_reusable.begin(); It != m_reusable.end(); ++It)
+	{
+		if (is_same_description(It->first->GetDesc(), desc))
+		{
+			ComPtr<ID3D12Resource> result = It->first;
+			m_size -= It->second;
+			perf::mem_add(perf::mem_texture_cache, -s64(It->second));
+			m_reusable.erase(It);
+			stats.reuses++;
+			return result;
+		}
+	}
+	return nullptr;
+}
+
+void data_cache::set_budget(size_t budget)
+{
+	std::lock_guard<std::mutex> lock(m_mut);
+	m_budget = budget;
+}
+
+void data_cache::evict(std::list<ComPtr<ID3D12Resource>> &released)
+{
+	std::lock_guard<std::mutex> lock(m_mut);
+
+	while (!m_reusable.empty() && (m_size > m_budget || m_reusable.size() > max_reusable_count))
+	{
+		m_size -= m_reusable.front().second;
+		perf::mem_add(perf::mem_texture_cache, -s64(m_reusable.front().second));
+		released.push_back(std::move(m_reusable.front().first));
+		m_reusable.pop_front();
+	}
+
+	while (m_size > m_budget && !m_lru.empty())
+	{
+		const u64 key = m_lru.back();
+		unprotect_key(key);
+		released.push_back(erase(key).first);
+		stats.evictions++;
+	}
+}
+
 void resource_storage::reset()
 {
 	descriptors_heap_index = 0;
-	current_sampler_index = 0;
-	sampler_descriptors_heap_index = 0;
 	render_targets_descriptors_heap_index = 0;
 	depth_stencil_descriptor_heap_index = 0;
+	texture_tables.clear();
+
+	// Samplers written by the previous frames are still valid unless the first heap overflowed
+	if (sampler_descriptors_heap_index != 0)
+	{
+		current_sampler_index = 0;
+		sampler_descriptors_heap_index = 0;
+		sampler_tables.clear();
+	}
 
 	CHECK_HRESULT(command_allocator->Reset());
 	set_new_command_list();
@@ -95,11 +323,84 @@ void resource_storage::set_new_command_list()
 	command_list->SetDescriptorHeaps(2, descriptors);
 }
 
+D3D12_GPU_DESCRIPTOR_HANDLE resource_storage::get_texture_table(ID3D12Resource *const *resources, const D3D12_SHADER_RESOURCE_VIEW_DESC *views, size_t count)
+{
+	// Only the fields set by upload_and_bind_textures, the view union has padding
+	std::string key;
+	for (size_t i = 0; i < count; i++)
+	{
+		key.append((const char*)&resources[i], sizeof(resources[i]));
+		key.append((const char*)&views[i].Format, sizeof(views[i].Format));
+		key.append((const char*)&views[i].ViewDimension, sizeof(views[i].ViewDimension));
+		key.append((const char*)&views[i].Shader4ComponentMapping, sizeof(views[i].Shader4ComponentMapping));
+		key.append((const char*)&views[i].Texture2D.MipLevels, sizeof(views[i].Texture2D.MipLevels));
+	}
+
+	auto found = texture_tables.find(key);
+	if (found != texture_tables.end())
+	{
+		stats.texture_table_hits++;
+		return CD3DX12_GPU_DESCRIPTOR_HANDLE(descriptors_heap->GetGPUDescriptorHandleForHeapStart()).Offset((INT)found->second, descriptor_stride_srv_cbv_uav);
+	}
+
+	stats.texture_table_misses++;
+	const size_t index = descriptors_heap_index;
+	for (size_t i = 0; i < count; i++)
+	{
+		m_device->CreateShaderResourceView(resources[i], &views[i],
+			CD3DX12_CPU_DESCRIPTOR_HANDLE(descriptors_heap->GetCPUDescriptorHandleForHeapStart()).Offset((INT)(index + i), descriptor_stride_srv_cbv_uav));
+	}
+	descriptors_heap_index += count;
+	texture_tables[key] = index;
+	return CD3DX12_GPU_DESCRIPTOR_HANDLE(descriptors_heap->GetGPUDescriptorHandleForHeapStart()).Offset((INT)index, descriptor_stride_srv_cbv_uav);
+}
+
+D3D12_GPU_DESCRIPTOR_HANDLE resource_storage::get_sampler_table(const D3D12_SAMPLER_DESC *descs, size_t count)
+{
+	const std::string key((const char*)descs, count * sizeof(D3D12_SAMPLER_DESC));
+
+	auto found = sampler_tables.find(key);
+	if (found != sampler_tables.end())
+	{
+		stats.sampler_table_hits++;
+		return CD3DX12_GPU_DESCRIPTOR_HANDLE(sampler_descriptor_heap[sampler_descriptors_heap_index]->GetGPUDescriptorHandleForHeapStart()).Offset((INT)found->second, descriptor_stride_samplers);
+	}
+
+	stats.sampler_table_misses++;
+	if (current_sampler_index + count > 2048)
+	{
+		sampler_descriptors_heap_index = 1;
+		current_sampler_index = 0;
+		sampler_tables.clear();
+
+		ID3D12DescriptorHeap *descriptors[] =
+		{
+			descriptors_heap.Get(),
+			sampler_descriptor_heap[sampler_descriptors_heap_index].Get(),
+		};
+		command_list->SetDescriptorHeaps(2, descriptors);
+	}
+
+	const size_t index = current_sampler_index;
+	for (size_t i = 0; i < count; i++)
+	{
+		m_device->CreateSampler(&descs[i],
+			CD3DX12_CPU_DESCRIPTOR_HANDLE(sampler_descriptor_heap[sampler_descriptors_heap_index]->GetCPUDescriptorHandleForHeapStart()).Offset((INT)(index + i), descriptor_stride_samplers));
+	}
+	current_sampler_index += count;
+	sampler_tables[key] = index;
+	return CD3DX12_GPU_DESCRIPTOR_HANDLE(sampler_descriptor_heap[sampler_descriptors_heap_index]->GetGPUDescriptorHandleForHeapStart()).Offset((INT)index, descriptor_stride_samplers);
+}
+
 void resource_storage::init(ID3D12Device *device)
 {
 	in_use = false;
 	m_device = device;
 	ram_framebuffer = nullptr;
+	descriptor_stride_srv_cbv_uav = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	descriptor_stride_samplers = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER);
+	current_sampler_index = 0;
+	sampler_descriptors_heap_index = 0;
 	// Create a global command allocator
 	CHECK_HRESULT(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(command_allocator.GetAddressOf())));
 
@@ -1,6 +1,8 @@
 #pragma once
 #include "D3D12Utils.h"
 #include "d3dx12.h"
+#include "Emu/PerfCounters.h"
+#include <deque>
 
 
 /**
@@ -9,6 +11,11 @@
 * put pointer is used as storage space offset
 * and get is used as beginning of in use data space.
 * This wrapper checks that put pointer doesn't cross get one.
+*
+* Space is reclaimed per submission : signal() queues a fence value after the commands using
+* allocations made so far, and the get pointer moves past them once the GPU has reached it.
+* Allocation only blocks when the ring is full of data still in use.
+* Allocations larger than the whole ring get a dedicated resource, released the same way.
 */
 class data_heap
 {
@@ -43,18 +50,80 @@ class data_heap
 		}
 	}
 
+	struct submission
+	{
+		UINT64 fence_value;
+		size_t get_pos; // Get position once the submission is done
+		std::vector<ComPtr<ID3D12Resource>> dedicated_resources;
+	};
+
 	size_t m_size;
 	size_t m_put_pos; // Start of free space
 	ComPtr<ID3D12Resource> m_heap;
+	ID3D12Resource *m_current_resource = nullptr; // Resource of the last allocation
+
+	ID3D12Device *m_device = nullptr;
+	D3D12_HEAP_TYPE m_heap_type;
+	D3D12_RESOURCE_STATES m_resource_state;
+
+	ComPtr<ID3D12Fence> m_fence;
+	HANDLE m_fence_event = nullptr;
+	UINT64 m_fence_value = 0;
+	std::deque<submission> m_submissions;
+	std::vector<ComPtr<ID3D12Resource>> m_pending_dedicated_resources;
+
+	/**
+	* Move get position past submissions completed by the GPU.
+	*/
+	void retire()
+	{
+		const UINT64 completed = m_fence->GetCompletedValue();
+
+		while (!m_submissions.empty() && m_submissions.front().fence_value <= completed)
+		{
+			m_get_pos = m_submissions.front().get_pos;
+			m_submissions.pop_front();
+		}
+	}
+
+	void wait_oldest_submission()
+	{
+		CHECK_HRESULT(m_fence->SetEventOnCompletion(m_submissions.front().fence_value, m_fence_event));
+		WaitForSingleObjectEx(m_fence_event, INFINITE, FALSE);
+		stats.wait_count++;
+	}
+
 public:
 	size_t m_get_pos; // End of free space
 
+	struct statistics
+	{
+		u64 wait_count = 0; // Allocations that waited for the GPU
+		u64 dedicated_count = 0; // Allocations too large for the ring
+		u64 dedicated_size = 0;
+	} stats;
+
+	data_heap() = default;
+	data_heap(const data_heap&) = delete;
+
+	~data_heap()
+	{
+		if (m_fence_event)
+			CloseHandle(m_fence_event);
+
+		if (m_heap)
+			perf::mem_add(perf::mem_gpu_heaps, -s64(m_size));
+	}
+
 	template <typename... arg_type>
 	void init(ID3D12Device *device, size_t heap_size, D3D12_HEAP_TYPE type, D3D12_RESOURCE_STATES state)
 	{
 		m_size = heap_size;
 		m_put_pos = 0;
 		m_get_pos = heap_size - 1;
+		m_device = device;
+		m_heap_type = type;
+		m_resource_state = state;
 
 		D3D12_HEAP_PROPERTIES heap_properties = {};
 		heap_properties.Type = type;
@@ -65,13 +134,56 @@ public:
 			nullptr,
 			IID_PPV_ARGS(m_heap.GetAddressOf()))
 			);
+		m_current_resource = m_heap.Get();
+		perf::mem_add(perf::mem_gpu_heaps, heap_size);
+
+		CHECK_HRESULT(device->CreateFence(m_fence_value, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(m_fence.GetAddressOf())));
+		m_fence_event = CreateEventEx(nullptr, FALSE, FALSE, EVENT_ALL_ACCESS);
 	}
 
+	/**
+	* Allocate size bytes. Returned offset is relative to get_heap(), which must be
+	* queried after this call since oversized allocations live in their own resource.
+	*/
 	template<int Alignement>
 	size_t alloc(size_t size)
 	{
-		if (!can_alloc<Alignement>(size)) throw EXCEPTION("Working buffer not big enough");
 		size_t alloc_size = align(size, Alignement);
+
+		if (alloc_size >= m_size)
+		{
+			ComPtr<ID3D12Resource> resource;
+			D3D12_HEAP_PROPERTIES heap_properties = {};
+			heap_properties.Type = m_heap_type;
+			CHECK_HRESULT(m_device->CreateCommittedResource(&heap_properties,
+				D3D12_HEAP_FLAG_NONE,
+				&CD3DX12_RESOURCE_DESC::Buffer(alloc_size),
+				m_resource_state,
+				nullptr,
+				IID_PPV_ARGS(resource.GetAddressOf()))
+				);
+
+			stats.dedicated_count++;
+			stats.dedicated_size += alloc_size;
+
+			m_current_resource = resource.Get();
+			m_pending_dedicated_resources.push_back(resource);
+			return 0;
+		}
+
+		retire();
+
+		while (!can_alloc<Alignement>(size))
+		{
+			if (m_submissions.empty())
+				throw EXCEPTION("Working buffer not big enough");
+
+			wait_oldest_submission();
+			retire();
+		}
+
+		m_current_resource = m_heap.Get();
+
 		size_t aligned_put_pos  = align(m_put_pos, Alignement);
 		if (aligned_put_pos + alloc_size < m_size)
 		{
@@ -85,11 +197,36 @@ public:
 		}
 	}
 
+	/**
+	* Signal the heap fence on queue after the commands using allocations made so far.
+	*/
+	void signal(ID3D12CommandQueue *queue)
+	{
+		CHECK_HRESULT(queue->Signal(m_fence.Get(), ++m_fence_value));
+
+		submission new_submission;
+		new_submission.fence_value = m_fence_value;
+		new_submission.get_pos = get_current_put_pos_minus_one();
+		new_submission.dedicated_resources = std::move(m_pending_dedicated_resources);
+		m_submissions.push_back(std::move(new_submission));
+		m_pending_dedicated_resources.clear();
+	}
+
+	/**
+	* Free all allocations, the GPU must be done with them (ie command queue is idle).
+	* Dedicated resources allocated since the last signal() are kept until the next one, they can still be mapped.
+	*/
+	void release_all()
+	{
+		m_submissions.clear();
+		m_get_pos = get_current_put_pos_minus_one();
+	}
+
 	template<typename T>
 	T* map(const D3D12_RANGE &range)
 	{
 		void *buffer;
-		CHECK_HRESULT(m_heap->Map(0, &range, &buffer));
+		CHECK_HRESULT(m_current_resource->Map(0, &range, &buffer));
 		void *mapped_buffer = (char*)buffer + range.Begin;
 		return static_cast<T*>(mapped_buffer);
 	}
@@ -98,24 +235,24 @@ public:
 	T* map(size_t heap_offset)
 	{
 		void *buffer;
-		CHECK_HRESULT(m_heap->Map(0, nullptr, &buffer));
+		CHECK_HRESULT(m_current_resource->Map(0, nullptr, &buffer));
 		void *mapped_buffer = (char*)buffer + heap_offset;
 		return static_cast<T*>(mapped_buffer);
 	}
 
 	void unmap(const D3D12_RANGE &range)
 	{
-		m_heap->Unmap(0, &range);
+		m_current_resource->Unmap(0, &range);
 	}
 
 	void unmap()
 	{
-		m_heap->Unmap(0, nullptr);
+		m_current_resource->Unmap(0, nullptr);
 	}
 
 	ID3D12Resource* get_heap()
 	{
-		return m_heap.Get();
+		return m_current_resource;
 	}
 
 	/**
@@ -123,7 +260,7 @@ public:
 	*/
 	size_t get_current_put_pos_minus_one() const
 	{
-		return (m_put_pos - 1 > 0) ? m_put_pos - 1 : m_size - 1;
+		return (m_put_pos > 0) ? m_put_pos - 1 : m_size - 1;
 	}
 };
 
@@ -135,10 +272,18 @@ struct texture_entry
 	size_t m_height;
 	size_t m_mipmap;
 
-	texture_entry() : m_format(0), m_width(0), m_height(0), m_is_dirty(true)
+	// Written pages when only part of the data is dirty (m_dirty_start == m_dirty_end if all of it is)
+	u32 m_dirty_start;
+	u32 m_dirty_end;
+
+	// Protected range of the data
+	u32 m_protected_start;
+	u32 m_protected_size;
+
+	texture_entry() : m_format(0), m_width(0), m_height(0), m_is_dirty(true), m_dirty_start(0), m_dirty_end(0), m_protected_start(0), m_protected_size(0)
 	{}
 
-	texture_entry(u8 f, size_t w, size_t h, size_t m) : m_format(f), m_width(w), m_height(h), m_is_dirty(false)
+	texture_entry(u8 f, size_t w, size_t h, size_t m) : m_format(f), m_width(w), m_height(h), m_mipmap(m), m_is_dirty(false), m_dirty_start(0), m_dirty_end(0), m_protected_start(0), m_protected_size(0)
 	{}
 
 	bool operator==(const texture_entry &other)
@@ -149,6 +294,8 @@ struct texture_entry
 
 /**
 * Manages cache of data (texture/vertex/index)
+* Entries are evicted in least recently used order once their allocations exceed the budget,
+* resources of replaced entries are kept for reuse by a texture with the same description.
 */
 struct data_cache
 {
@@ -162,7 +309,51 @@ private:
 
 	std::unordered_map<u64, std::pair<texture_entry, ComPtr<ID3D12Resource>> > m_address_to_data; // Storage
 	std::list <std::tuple<u64, u32, u32> > m_protected_ranges; // address, start of protected range, size of protected range
+
+	std::list<u64> m_lru; // keys, most recently used first
+	std::unordered_map<u64, std::pair<std::list<u64>::iterator, size_t>> m_lru_info; // position in m_lru, allocation size
+	std::list<std::pair<ComPtr<ID3D12Resource>, size_t>> m_reusable; // released resources and allocation size, oldest first
+	size_t m_size = 0; // allocation size of entries and reusable resources
+	size_t m_budget = SIZE_MAX;
+
+	static const size_t max_reusable_count = 64;
+
+	void touch(u64 key);
+
+	/**
+	* Protect range of key again (removing what is left of its previous ranges) and mark it clean. Lock must be held.
+	*/
+	void protect_key(u64 key, u32 start, size_t size);
+
+	/**
+	* Add page to the dirty range of key, or make the whole data dirty once most of it was written. Lock must be held.
+	*/
+	void mark_dirty_page(u64 key, u32 page);
+
+	/**
+	* Remove protected ranges of key, pages still covered by other ranges stay protected. Lock must be held.
+	*/
+	void unprotect_key(u64 key);
+
+	/**
+	* Remove key from storage and LRU, returns its resource and allocation size. Lock must be held.
+	*/
+	std::pair<ComPtr<ID3D12Resource>, size_t> erase(u64 key);
+
 public:
+	struct statistics
+	{
+		u64 hits = 0;
+		u64 misses = 0;
+		u64 evictions = 0; // Entries removed to respect the budget
+		u64 reuses = 0; // Uploads into a recycled resource
+	} stats;
+
+	~data_cache()
+	{
+		perf::mem_add(perf::mem_texture_cache, -s64(m_size));
+	}
+
 	void store_and_protect_data(u64 key, u32 start, size_t size, u8 format, size_t w, size_t h, size_t m, ComPtr<ID3D12Resource> data);
 
 	/**
@@ -172,8 +363,9 @@ public:
 	void protect_data(u64 key, u32 start, size_t size);
 
 	/**
-	 * Remove all data containing addr from cache, unprotect them. Returns false if no data is modified.
-	 */
+	* Mark data containing the page of addr dirty and unprotect the page, returns false if no data is modified.
+	* The written pages are recorded (see texture_entry::m_dirty_start) so that only them can be uploaded again.
+	*/
 	bool invalidate_address(u32 addr);
 
 	std::pair<texture_entry, ComPtr<ID3D12Resource> > *find_data_if_available(u64 key);
@@ -185,6 +377,29 @@ public:
 	* The caller is responsible for releasing the ComPtr.
 	*/
 	ComPtr<ID3D12Resource> remove_from_cache(u64 key);
+
+	/**
+	* Remove data stored at key and keep its resource for take_reusable.
+	*/
+	void recycle(u64 key);
+
+	/**
+	* Returns a recycled resource matching desc (in GENERIC_READ state), or nullptr.
+	*/
+	ComPtr<ID3D12Resource> take_reusable(const D3D12_RESOURCE_DESC &desc);
+
+	void set_budget(size_t budget);
+
+	size_t get_size() const
+	{
+		return m_size;
+	}
+
+	/**
+	* Drop reusable resources, then least recently used entries, until the cache fits in the budget.
+	* Released resources may still be referenced by command lists in flight and are appended to released.
+	*/
+	void evict(std::list<ComPtr<ID3D12Resource>> &released);
 };
 
 /**
@@ -223,13 +438,32 @@ struct resource_storage
 	/// Texture that were invalidated
 	std::list<ComPtr<ID3D12Resource> > dirty_textures;
 
+	// Texture descriptor tables written in descriptors_heap during the frame, keyed by resources and views
+	std::unordered_map<std::string, size_t> texture_tables;
+	// Sampler descriptor tables written in the current sampler heap, keyed by sampler descriptions.
+	// They don't reference resources so they are kept across frames until the heap is full.
+	std::unordered_map<std::string, size_t> sampler_tables;
+
+	INT descriptor_stride_srv_cbv_uav;
+	INT descriptor_stride_samplers;
+
+	struct statistics
+	{
+		u64 texture_table_hits = 0;
+		u64 texture_table_misses = 0;
+		u64 sampler_table_hits = 0;
+		u64 sampler_table_misses = 0;
+	} stats;
+
 	/**
-	 * Start position in heaps of resources used for this frame.
-	 * This means newer resources shouldn't allocate memory crossing this position
-	 * until the frame rendering is over.
-	 */
-	size_t buffer_heap_get_pos;
-	size_t readback_heap_get_pos;
+	* Get a table of count SRVs in descriptors_heap, descriptors are only created if the frame has no identical table yet.
+	*/
+	D3D12_GPU_DESCRIPTOR_HANDLE get_texture_table(ID3D12Resource *const *resources, const D3D12_SHADER_RESOURCE_VIEW_DESC *views, size_t count);
+
+	/**
+	* Get a table of count samplers in the current sampler heap, samplers are only created if no identical table was written.
+	*/
+	D3D12_GPU_DESCRIPTOR_HANDLE get_sampler_table(const D3D12_SAMPLER_DESC *descs, size_t count);
 
 	void reset();
 	void init(ID3D12Device *device);
@@ -2,6 +2,8 @@
 #include "stdafx_d3d12.h"
 #ifdef _MSC_VER
 #include "D3D12GSRender.h"
+#include "Emu/state.h"
+#include "Emu/PerfCounters.h"
 #include <d2d1_3.h>
 #include <dwrite_3.h>
 #include <d3d11on12.h>
@@ -167,8 +169,12 @@ void D3D12GSRender::render_overlay()
 	std::wstring flipDuration = L"Flip : " + std::to_wstring(m_timers.m_flip_duration) + L" us";
 
 	std::wstring count = L"Draw count : " + std::to_wstring(m_timers.m_draw_calls_count);
-	draw_strings(rtSize, m_swap_chain->GetCurrentBackBufferIndex(),
-		{
+
+	std::vector<std::wstring> lines;
+
+	if (rpcs3::config.rsx.d3d12.overlay.value())
+	{
+		lines = {
 			duration,
 			count,
 			rttDuration,
@@ -178,6 +184,15 @@ void D3D12GSRender::render_overlay()
 			constantDuration,
 			texDuration,
 			flipDuration
-		});
+		};
+	}
+
+	if (rpcs3::config.rsx.perf_overlay.value())
+	{
+		for (const std::string &line : perf::format_stats(perf::get_stats()))
+			lines.emplace_back(line.begin(), line.end());
+	}
+
+	draw_strings(rtSize, m_swap_chain->GetCurrentBackBufferIndex(), lines);
 }
 #endif
@@ -10,34 +10,97 @@
 #define TO_STRING(x) #x
 
 extern pD3DCompile wrapD3DCompile;
+extern decltype(&D3DCreateBlob) wrapD3DCreateBlob;
 
-void Shader::Compile(const std::string &code, SHADER_TYPE st)
+rsx::shader_binary_cache g_d3d12_shader_binaries;
+
+namespace
 {
-	content = code;
-	HRESULT hr;
-	ComPtr<ID3DBlob> errorBlob;
-	UINT compileFlags;
-	if (rpcs3::config.rsx.d3d12.debug_output.value())
-		compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
-	else
-		compileFlags = 0;
-	switch (st)
+	/**
+	* Compile HLSL code, looking up the shader binary cache first.
+	* defines is a null terminated D3D_SHADER_MACRO array (or nullptr), it takes part in the cache key.
+	*/
+	bool compile_hlsl(const std::string &code, Shader::SHADER_TYPE st, const D3D_SHADER_MACRO *defines, ComPtr<ID3DBlob> &bytecode)
 	{
-	case SHADER_TYPE::SHADER_TYPE_VERTEX:
-		hr = wrapD3DCompile(code.c_str(), code.size(), "VertexProgram.hlsl", nullptr, nullptr, "main", "vs_5_0", compileFlags, 0, &bytecode, errorBlob.GetAddressOf());
-		if (hr != S_OK)
-			LOG_ERROR(RSX, "VS build failed:%s", errorBlob->GetBufferPointer());
-		break;
-	case SHADER_TYPE::SHADER_TYPE_FRAGMENT:
-		hr = wrapD3DCompile(code.c_str(), code.size(), "FragmentProgram.hlsl", nullptr, nullptr, "main", "ps_5_0", compileFlags, 0, &bytecode, errorBlob.GetAddressOf());
+		ComPtr<ID3DBlob> errorBlob;
+		UINT compileFlags;
+		if (rpcs3::config.rsx.d3d12.debug_output.value())
+			compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+		else
+			compileFlags = 0;
+
+		const char *name = st == Shader::SHADER_TYPE::SHADER_TYPE_VERTEX ? "VertexProgram.hlsl" : "FragmentProgram.hlsl";
+		const char *target = st == Shader::SHADER_TYPE::SHADER_TYPE_VERTEX ? "vs_5_0" : "ps_5_0";
+
+		// The binary depends on the target, flags and defines as well as the source
+		std::string options = fmt::format("%s:%x", target, compileFlags);
+		for (const D3D_SHADER_MACRO *define = defines; define && define->Name; define++)
+			options += fmt::format(":%s=%s", define->Name, define->Definition);
+		const u64 key = g_d3d12_shader_binaries.get_key({ &options, &code });
+
+		u32 format;
+		std::vector<u8> binary;
+		if (g_d3d12_shader_binaries.find(key, format, binary) && SUCCEEDED(wrapD3DCreateBlob(binary.size(), bytecode.ReleaseAndGetAddressOf())))
+		{
+			std::memcpy(bytecode->GetBufferPointer(), binary.data(), binary.size());
+			return true;
+		}
+
+		HRESULT hr = wrapD3DCompile(code.c_str(), code.size(), name, defines, nullptr, "main", target, compileFlags, 0, bytecode.ReleaseAndGetAddressOf(), errorBlob.GetAddressOf());
 		if (hr != S_OK)
-			LOG_ERROR(RSX, "FS build failed:%s", errorBlob->GetBufferPointer());
-		break;
+		{
+			LOG_ERROR(RSX, "%s build failed:%s", st == Shader::SHADER_TYPE::SHADER_TYPE_VERTEX ? "VS" : "FS", errorBlob->GetBufferPointer());
+			bytecode.Reset();
+			return false;
+		}
+
+		g_d3d12_shader_binaries.store(key, 0, bytecode->GetBufferPointer(), bytecode->GetBufferSize());
+		return true;
 	}
 }
 
-void D3D12GSRender::load_program()
+void Shader::Compile(const std::string &code, SHADER_TYPE st)
 {
+	content = code;
+	compile_hlsl(code, st, nullptr, bytecode);
+}
+
+ID3DBlob *Shader::get_bytecode(u32 specialization) const
+{
+	if (!specialization || !bytecode)
+		return bytecode.Get();
+
+	std::lock_guard<std::mutex> lock(m_specialized_mutex);
+
+	const auto found = m_specialized_bytecode.find(specialization);
+	if (found != m_specialized_bytecode.end())
+		return found->second.Get();
+
+	// Turn the state read from the constant buffer into constants (see the SPEC_ macros of D3D12FragmentDecompiler::insertHeader)
+	std::vector<std::string> names;
+	names.emplace_back("SPEC_isAlphaTested");
+	for (int i = 0; i < 16; i++)
+		names.emplace_back(fmt::format("SPEC_tex%d_is_unorm", i));
+
+	std::vector<D3D_SHADER_MACRO> defines;
+	defines.push_back({ names[0].c_str(), specialization & fragment_specialization::alpha_test ? "1" : "0" });
+	for (int i = 0; i < 16; i++)
+		defines.push_back({ names[i + 1].c_str(), specialization & (1 << i) ? "1" : "0" });
+	defines.push_back({ nullptr, nullptr });
+
+	ComPtr<ID3DBlob> &result = m_specialized_bytecode[specialization];
+	compile_hlsl(content, SHADER_TYPE::SHADER_TYPE_FRAGMENT, defines.data(), result);
+	return result.Get();
+}
+
+bool D3D12GSRender::load_program()
+{
+	if (programs_dirty)
+	{
+		m_pso_cache.invalidate_last_programs();
+		programs_dirty = false;
+	}
+
 	u32 transform_program_start = rsx::method_registers[NV4097_SET_TRANSFORM_PROGRAM_START];
 	vertex_program.data.reserve((512 - transform_program_start) * 4);
 
@@ -265,8 +328,36 @@ void D3D12GSRender::load_program()
 		}
 	}
 
+	prop.fragment_specialization = 0;
+
+	if (m_pso_cache.has_compiler_threads())
+	{
+		// Alpha test and texture coordinates normalization are baked into a specialized fragment program,
+		// the generic one (reading them from the constant buffer) is used while it compiles in background
+		u32 specialization = fragment_specialization::specialized;
+		if (rsx::method_registers[NV4097_SET_ALPHA_TEST_ENABLE])
+			specialization |= fragment_specialization::alpha_test;
+		for (u32 i = 0; i < rsx::limits::textures_count; ++i)
+		{
+			if (textures[i].enabled() && (textures[i].format() & CELL_GCM_TEXTURE_UN))
+				specialization |= 1 << i;
+		}
+
+		prop.fragment_specialization = specialization;
+		auto pso = m_pso_cache.try_get_graphic_pipeline_state(vertex_program, fragment_program, prop, m_device.Get(), gsl::span<ComPtr<ID3D12RootSignature>, 17>(m_root_signatures));
+		if (!pso)
+		{
+			prop.fragment_specialization = 0;
+			pso = m_pso_cache.try_get_graphic_pipeline_state(vertex_program, fragment_program, prop, m_device.Get(), gsl::span<ComPtr<ID3D12RootSignature>, 17>(m_root_signatures));
+		}
+		if (!pso)
+			return false;
+		m_current_pso = *pso;
+		return true;
+	}
+
 	m_current_pso = m_pso_cache.getGraphicPipelineState(vertex_program, fragment_program, prop, m_device.Get(), m_root_signatures);
-	return;
+	return true;
 }
 
 std::pair<std::string, std::string> D3D12GSRender::get_programs() const
@@ -2,9 +2,23 @@
 
 #include "D3D12Utils.h"
 #include "../Common/ProgramStateCache.h"
+#include "../Common/shader_binary_cache.h"
 #include "D3D12VertexProgramDecompiler.h"
 #include "D3D12FragmentProgramDecompiler.h"
 
+/**
+* Render state baked into specialized fragment program variants (D3D12PipelineProperties::fragment_specialization).
+* Bits 0-15 tell if texture i uses unnormalized coordinates, 0 selects the generic variant reading the state from the constant buffer.
+*/
+namespace fragment_specialization
+{
+	enum : u32
+	{
+		alpha_test = 1u << 16,
+		specialized = 1u << 31,
+	};
+}
+
 struct D3D12PipelineProperties
 {
 	D3D12_PRIMITIVE_TOPOLOGY_TYPE Topology;
@@ -16,6 +30,7 @@ struct D3D12PipelineProperties
 	D3D12_DEPTH_STENCIL_DESC DepthStencil;
 	D3D12_RASTERIZER_DESC Rasterization;
 	D3D12_INDEX_BUFFER_STRIP_CUT_VALUE CutValue;
+	u32 fragment_specialization;
 
 	bool operator==(const D3D12PipelineProperties &in) const
 	{
@@ -42,7 +57,8 @@ struct D3D12PipelineProperties
 			return false;
 		if (memcmp(&Rasterization, &in.Rasterization, sizeof(D3D12_RASTERIZER_DESC)))
 			return false;
-		return Topology == in.Topology && DepthStencilFormat == in.DepthStencilFormat && numMRT == in.numMRT && RenderTargetsFormat == in.RenderTargetsFormat;
+		return Topology == in.Topology && DepthStencilFormat == in.DepthStencilFormat && numMRT == in.numMRT && RenderTargetsFormat == in.RenderTargetsFormat &&
+			fragment_specialization == in.fragment_specialization;
 	}
 };
 
@@ -64,7 +80,8 @@ namespace std
 			size_t seed = hash<unsigned>()(pipelineProperties.DepthStencilFormat) ^
 				(hash<unsigned>()(pipelineProperties.RenderTargetsFormat) << 2) ^
 				(hash<unsigned>()(pipelineProperties.Topology) << 2) ^
-				(hash<unsigned>()(pipelineProperties.numMRT) << 4);
+				(hash<unsigned>()(pipelineProperties.numMRT) << 4) ^
+				(hash<unsigned>()(pipelineProperties.fragment_specialization) << 6);
 			seed ^= hashStructContent(pipelineProperties.Blend);
 			seed ^= hashStructContent(pipelineProperties.DepthStencil);
 			seed ^= hashStructContent(pipelineProperties.Rasterization);
@@ -97,6 +114,12 @@ public:
 	std::vector<size_t> FragmentConstantOffsetCache;
 	size_t m_textureCount;
 
+	/**
+	* Get the bytecode of a fragment program variant, specialized ones are compiled from content on first use.
+	* Thread safe, returns nullptr if the compilation failed.
+	*/
+	ID3DBlob *get_bytecode(u32 specialization) const;
+
 	/**
 	* Decompile a fragment shader located in the PS3's Memory.  This function operates synchronously.
 	* @param prog RSXShaderProgram specifying the location and size of the shader in memory
@@ -105,8 +128,15 @@ public:
 
 	/** Compile the decompiled fragment shader into a format we can use with OpenGL. */
 	void Compile(const std::string &code, enum class SHADER_TYPE st);
+
+private:
+	mutable std::mutex m_specialized_mutex;
+	mutable std::unordered_map<u32, ComPtr<ID3DBlob>> m_specialized_bytecode;
 };
 
+// Compiled DXBC of decompiled shaders, opened by D3D12GSRender
+extern rsx::shader_binary_cache g_d3d12_shader_binaries;
+
 static
 bool has_attribute(size_t attribute, const std::vector<D3D12_INPUT_ELEMENT_DESC> &desc)
 {
@@ -143,6 +173,8 @@ struct D3D12Traits
 	using pipeline_storage_type = std::tuple<ComPtr<ID3D12PipelineState>, std::vector<size_t>, size_t>;
 	using pipeline_properties  = D3D12PipelineProperties;
 
+	static const bool parallel_shader_compilation = true;
+
 	static
 	void recompile_fragment_program(const RSXFragmentProgram &RSXFP, fragment_program_type& fragmentProgramData, size_t ID)
 	{
@@ -184,7 +216,7 @@ struct D3D12Traits
 	static
 		pipeline_storage_type build_pipeline(
 			const vertex_program_type &vertexProgramData, const fragment_program_type &fragmentProgramData, const pipeline_properties &pipelineProperties,
-			ID3D12Device *device, gsl::span<ComPtr<ID3D12RootSignature>, 17> root_signatures)
+			const std::vector<u8> &cached_blob, ID3D12Device *device, gsl::span<ComPtr<ID3D12RootSignature>, 17> root_signatures)
 	{
 		std::tuple<ID3D12PipelineState *, std::vector<size_t>, size_t> result = {};
 		D3D12_GRAPHICS_PIPELINE_STATE_DESC graphicPipelineStateDesc = {};
@@ -194,10 +226,11 @@ struct D3D12Traits
 		graphicPipelineStateDesc.VS.BytecodeLength = vertexProgramData.bytecode->GetBufferSize();
 		graphicPipelineStateDesc.VS.pShaderBytecode = vertexProgramData.bytecode->GetBufferPointer();
 
-		if (fragmentProgramData.bytecode == nullptr)
+		ID3DBlob *fragment_bytecode = fragmentProgramData.get_bytecode(pipelineProperties.fragment_specialization);
+		if (fragment_bytecode == nullptr)
 			throw new EXCEPTION("fragment program compilation failure");
-		graphicPipelineStateDesc.PS.BytecodeLength = fragmentProgramData.bytecode->GetBufferSize();
-		graphicPipelineStateDesc.PS.pShaderBytecode = fragmentProgramData.bytecode->GetBufferPointer();
+		graphicPipelineStateDesc.PS.BytecodeLength = fragment_bytecode->GetBufferSize();
+		graphicPipelineStateDesc.PS.pShaderBytecode = fragment_bytecode->GetBufferPointer();
 
 		graphicPipelineStateDesc.pRootSignature = root_signatures[fragmentProgramData.m_textureCount].Get();
 
@@ -222,12 +255,116 @@ struct D3D12Traits
 		graphicPipelineStateDesc.IBStripCutValue = pipelineProperties.CutValue;
 
 		ComPtr<ID3D12PipelineState> pso;
-		CHECK_HRESULT(device->CreateGraphicsPipelineState(&graphicPipelineStateDesc, IID_PPV_ARGS(pso.GetAddressOf())));
+		if (!cached_blob.empty())
+		{
+			graphicPipelineStateDesc.CachedPSO.pCachedBlob = cached_blob.data();
+			graphicPipelineStateDesc.CachedPSO.CachedBlobSizeInBytes = cached_blob.size();
+			// Blob is rejected if driver or hardware changed
+			if (FAILED(device->CreateGraphicsPipelineState(&graphicPipelineStateDesc, IID_PPV_ARGS(pso.GetAddressOf()))))
+				graphicPipelineStateDesc.CachedPSO = {};
+		}
+		if (!pso)
+			CHECK_HRESULT(device->CreateGraphicsPipelineState(&graphicPipelineStateDesc, IID_PPV_ARGS(pso.GetAddressOf())));
 
 		std::wstring name = L"PSO_" + std::to_wstring(vertexProgramData.id) + L"_" + std::to_wstring(fragmentProgramData.id);
 		pso->SetName(name.c_str());
 		return std::make_tuple(pso, vertexProgramData.vertex_shader_inputs, fragmentProgramData.m_textureCount);
 	}
+
+	struct serialized_properties
+	{
+		D3D12_PRIMITIVE_TOPOLOGY_TYPE Topology;
+		DXGI_FORMAT DepthStencilFormat;
+		DXGI_FORMAT RenderTargetsFormat;
+		D3D12_BLEND_DESC Blend;
+		u32 numMRT;
+		D3D12_DEPTH_STENCIL_DESC DepthStencil;
+		D3D12_RASTERIZER_DESC Rasterization;
+		D3D12_INDEX_BUFFER_STRIP_CUT_VALUE CutValue;
+		u32 fragment_specialization;
+	};
+
+	struct serialized_input_element
+	{
+		u32 SemanticIndex;
+		DXGI_FORMAT Format;
+		u32 InputSlot;
+		u32 AlignedByteOffset;
+		D3D12_INPUT_CLASSIFICATION InputSlotClass;
+		u32 InstanceDataStepRate;
+	};
+
+	static
+	void serialize_properties(const pipeline_properties &pipelineProperties, std::vector<u8> &out)
+	{
+		serialized_properties header = {};
+		header.Topology = pipelineProperties.Topology;
+		header.DepthStencilFormat = pipelineProperties.DepthStencilFormat;
+		header.RenderTargetsFormat = pipelineProperties.RenderTargetsFormat;
+		header.Blend = pipelineProperties.Blend;
+		header.numMRT = pipelineProperties.numMRT;
+		header.DepthStencil = pipelineProperties.DepthStencil;
+		header.Rasterization = pipelineProperties.Rasterization;
+		header.CutValue = pipelineProperties.CutValue;
+		header.fragment_specialization = pipelineProperties.fragment_specialization;
+
+		out.resize(sizeof(header) + pipelineProperties.IASet.size() * sizeof(serialized_input_element));
+		std::memcpy(out.data(), &header, sizeof(header));
+
+		// Semantic names aren't serialized, every attribute uses TEXCOORD
+		serialized_input_element *elements = reinterpret_cast<serialized_input_element*>(out.data() + sizeof(header));
+		for (const D3D12_INPUT_ELEMENT_DESC &desc : pipelineProperties.IASet)
+		{
+			*elements++ = { desc.SemanticIndex, desc.Format, desc.InputSlot, desc.AlignedByteOffset, desc.InputSlotClass, desc.InstanceDataStepRate };
+		}
+	}
+
+	static
+	bool deserialize_properties(const u8 *data, size_t size, pipeline_properties &pipelineProperties)
+	{
+		serialized_properties header;
+		if (size < sizeof(header) || (size - sizeof(header)) % sizeof(serialized_input_element))
+			return false;
+		std::memcpy(&header, data, sizeof(header));
+
+		pipelineProperties.Topology = header.Topology;
+		pipelineProperties.DepthStencilFormat = header.DepthStencilFormat;
+		pipelineProperties.RenderTargetsFormat = header.RenderTargetsFormat;
+		pipelineProperties.Blend = header.Blend;
+		pipelineProperties.numMRT = header.numMRT;
+		pipelineProperties.DepthStencil = header.DepthStencil;
+		pipelineProperties.Rasterization = header.Rasterization;
+		pipelineProperties.CutValue = header.CutValue;
+		pipelineProperties.fragment_specialization = header.fragment_specialization;
+
+		pipelineProperties.IASet.clear();
+		for (size_t offset = sizeof(header); offset < size; offset += sizeof(serialized_input_element))
+		{
+			serialized_input_element element;
+			std::memcpy(&element, data + offset, sizeof(element));
+
+			D3D12_INPUT_ELEMENT_DESC desc = {};
+			desc.SemanticName = "TEXCOORD";
+			desc.SemanticIndex = element.SemanticIndex;
+			desc.Format = element.Format;
+			desc.InputSlot = element.InputSlot;
+			desc.AlignedByteOffset = element.AlignedByteOffset;
+			desc.InputSlotClass = element.InputSlotClass;
+			desc.InstanceDataStepRate = element.InstanceDataStepRate;
+			pipelineProperties.IASet.push_back(desc);
+		}
+		return true;
+	}
+
+	static
+	std::vector<u8> get_pipeline_blob(const pipeline_storage_type &pipeline)
+	{
+		ComPtr<ID3DBlob> blob;
+		if (FAILED(std::get<0>(pipeline)->GetCachedBlob(blob.GetAddressOf())))
+			return{};
+		const u8 *data = static_cast<const u8*>(blob->GetBufferPointer());
+		return{ data, data + blob->GetBufferSize() };
+	}
 };
 
 class PipelineStateObjectCache : public program_state_cache<D3D12Traits>
@@ -8,6 +8,7 @@
 #include "Emu/state.h"
 #include "Emu/RSX/GSRender.h"
 #include "../rsx_methods.h"
+#include "../Common/BufferUtils.h"
 
 #include "D3D12.h"
 #include "D3D12GSRender.h"
@@ -161,8 +162,10 @@ void D3D12GSRender::clear_surface(u32 arg)
 
 	if (rpcs3::config.rsx.d3d12.debug_output.value())
 	{
+		end_zpass_query();
 		CHECK_HRESULT(get_current_resource_storage().command_list->Close());
 		m_command_queue->ExecuteCommandLists(1, (ID3D12CommandList**)get_current_resource_storage().command_list.GetAddressOf());
+		submit_occlusion_queries();
 		get_current_resource_storage().set_new_command_list();
 	}
 }
@@ -298,18 +301,48 @@ namespace
 		return heap_offset;
 	}
 
-	void copy_readback_buffer_to_dest(void *dest, data_heap &readback_heap, size_t offset_in_heap, size_t dst_pitch, size_t src_pitch, size_t height)
+	/**
+	 * Rows converted by each worker of the pool at least (smaller surfaces are converted by the calling thread).
+	 */
+	const size_t readback_min_rows = 64;
+
+	void copy_readback_buffer_to_dest(rsx::task_pool &pool, void *dest, ID3D12Resource *readback_resource, size_t offset_in_heap, size_t dst_pitch, size_t src_pitch, size_t height)
 	{
 		// TODO: Use exact range
-		void *mapped_buffer = readback_heap.map<void>(offset_in_heap);
-		for (unsigned row = 0; row < height; row++)
+		void *buffer;
+		CHECK_HRESULT(readback_resource->Map(0, nullptr, &buffer));
+		const char *mapped_buffer = (char*)buffer + offset_in_heap;
+		pool.run_rows(height, readback_min_rows, [=](size_t first_row, size_t row_count)
 		{
-			u32 *casted_dest = (u32*)((char*)dest + row * dst_pitch);
-			u32 *casted_src = (u32*)((char*)mapped_buffer + row * src_pitch);
-			for (unsigned col = 0; col < src_pitch / 4; col++)
-				*casted_dest++ = se_storage<u32>::swap(*casted_src++);
-		}
-		readback_heap.unmap();
+			for (size_t row = first_row; row < first_row + row_count; row++)
+				se_swap_array<4>((char*)dest + row * dst_pitch, mapped_buffer + row * src_pitch, dst_pitch / 4);
+		});
+		readback_resource->Unmap(0, nullptr);
+	}
+
+	void copy_readback_depth_to_dest(rsx::task_pool &pool, void *dest, ID3D12Resource *readback_resource, size_t offset_in_heap, size_t dst_pitch, size_t src_pitch, size_t height)
+	{
+		void *buffer;
+		CHECK_HRESULT(readback_resource->Map(0, nullptr, &buffer));
+		const u8 *mapped_buffer = (u8*)buffer + offset_in_heap;
+		pool.run_rows(height, readback_min_rows, [=](size_t first_row, size_t row_count)
+		{
+			for (size_t row = first_row; row < first_row + row_count; row++)
+				expand_u8_to_u32((u8*)dest + row * dst_pitch, mapped_buffer + row * src_pitch, dst_pitch / 4);
+		});
+		readback_resource->Unmap(0, nullptr);
+	}
+
+	/**
+	 * Copy rows of row_size bytes from a readback buffer with a different pitch.
+	 */
+	void copy_readback_rows(rsx::task_pool &pool, void *dest, const void *mapped_buffer, size_t dst_pitch, size_t src_pitch, size_t row_size, size_t height)
+	{
+		pool.run_rows(height, readback_min_rows, [=](size_t first_row, size_t row_count)
+		{
+			for (size_t row = first_row; row < first_row + row_count; row++)
+				memcpy((char*)dest + row * dst_pitch, (const char*)mapped_buffer + row * src_pitch, row_size);
+		});
 	}
 
 	void wait_for_command_queue(ID3D12Device *device, ID3D12CommandQueue *command_queue)
@@ -331,13 +364,17 @@ void D3D12GSRender::copy_render_target_to_dma_location()
 	// Add all buffer write
 	// Cell can't make any assumption about readyness of color/depth buffer
 	// Except when a semaphore is written by RSX
+	std::lock_guard<std::recursive_mutex> lock(m_readback_mutex);
+
+	// Previous copies aren't tracked once the surface is rendered again
+	complete_pending_readbacks();
+
 	int clip_w = rsx::method_registers[NV4097_SET_SURFACE_CLIP_HORIZONTAL] >> 16;
 	int clip_h = rsx::method_registers[NV4097_SET_SURFACE_CLIP_VERTICAL] >> 16;
 
-	ComPtr<ID3D12Resource> depth_format_conversion_buffer;
-	ComPtr<ID3D12DescriptorHeap> descriptor_heap;
+	ComPtr<ID3D12Resource> &depth_format_conversion_buffer = m_readback_depth_conversion_buffer;
+	ComPtr<ID3D12DescriptorHeap> &descriptor_heap = m_readback_descriptor_heap;
 	size_t depth_row_pitch = align(clip_w, 256);
-	size_t depth_buffer_offset_in_heap = 0;
 
 	u32 context_dma_color[] =
 	{
@@ -370,7 +407,7 @@ void D3D12GSRender::copy_render_target_to_dma_location()
 
 	if (m_context_dma_z && rpcs3::state.config.rsx.opengl.write_depth_buffer)
 	{
-		size_t uav_size = clip_w * clip_h * 2;
+		size_t depth_buffer_offset_in_heap = m_readback_resources.alloc<D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT>(depth_row_pitch * clip_h);
 
 		CHECK_HRESULT(
 			m_device->CreateCommittedResource(
@@ -421,94 +458,102 @@ void D3D12GSRender::copy_render_target_to_dma_location()
 
 		invalidate_address(address_z);
 
+		if (address_z)
+			m_pending_readbacks.push_back({ address_z, 0, 0, m_readback_resources.get_heap(), depth_buffer_offset_in_heap, depth_row_pitch, (size_t)clip_w * 4, (u32)clip_h, true });
 		need_transfer = true;
 	}
 
-	size_t color_buffer_offset_in_heap[4];
 	if (rpcs3::state.config.rsx.opengl.write_color_buffers)
 	{
+		size_t src_pitch = get_aligned_pitch(m_surface.color_format, clip_w);
+		size_t dst_pitch = get_packed_pitch(m_surface.color_format, clip_w);
+
 		for (u8 i : get_rtt_indexes(to_surface_target(rsx::method_registers[NV4097_SET_SURFACE_COLOR_TARGET])))
 		{
 			if (!address_color[i])
 				continue;
-			color_buffer_offset_in_heap[i] = download_to_readback_buffer(m_device.Get(), get_current_resource_storage().command_list.Get(), m_readback_resources, std::get<1>(m_rtts.m_bound_render_targets[i]), m_surface.color_format);
+			size_t offset_in_heap = download_to_readback_buffer(m_device.Get(), get_current_resource_storage().command_list.Get(), m_readback_resources, std::get<1>(m_rtts.m_bound_render_targets[i]), m_surface.color_format);
 			invalidate_address(address_color[i]);
+			m_pending_readbacks.push_back({ address_color[i], 0, 0, m_readback_resources.get_heap(), offset_in_heap, src_pitch, dst_pitch, (u32)clip_h, false });
 			need_transfer = true;
 		}
 	}
 	if (need_transfer)
 	{
+		end_zpass_query();
 		CHECK_HRESULT(get_current_resource_storage().command_list->Close());
 		m_command_queue->ExecuteCommandLists(1, (ID3D12CommandList**)get_current_resource_storage().command_list.GetAddressOf());
+		submit_occlusion_queries();
 		get_current_resource_storage().set_new_command_list();
+		m_command_queue->Signal(m_readback_fence.Get(), ++m_readback_fence_value);
 	}
 
-	//Wait for result
-	wait_for_command_queue(m_device.Get(), m_command_queue.Get());
-
-	if (address_z && rpcs3::state.config.rsx.opengl.write_depth_buffer)
+	// Cell doesn't see the surfaces until the copy is done
+	for (pending_readback &readback : m_pending_readbacks)
 	{
-		auto ptr = vm::base(address_z);
-		char *depth_buffer = (char*)ptr;
-		u8 *mapped_buffer = m_readback_resources.map<u8>(depth_buffer_offset_in_heap);
-
-		for (unsigned row = 0; row < (unsigned)clip_h; row++)
-		{
-			for (unsigned i = 0; i < (unsigned)clip_w; i++)
-			{
-				unsigned char c = mapped_buffer[row * depth_row_pitch + i];
-				depth_buffer[4 * (row * clip_w + i)] = c;
-				depth_buffer[4 * (row * clip_w + i) + 1] = c;
-				depth_buffer[4 * (row * clip_w + i) + 2] = c;
-				depth_buffer[4 * (row * clip_w + i) + 3] = c;
-			}
-		}
-		m_readback_resources.unmap();
+		readback.protected_start = readback.address & ~0xfff;
+		readback.protected_size = (u32)align(readback.address + readback.dst_pitch * readback.height, 4096) - readback.protected_start;
+		vm::page_protect(readback.protected_start, readback.protected_size, 0, 0, vm::page_readable | vm::page_writable);
 	}
+}
 
-	if (rpcs3::state.config.rsx.opengl.write_color_buffers)
+void D3D12GSRender::complete_pending_readbacks()
+{
+	std::lock_guard<std::recursive_mutex> lock(m_readback_mutex);
+
+	if (m_pending_readbacks.empty())
+		return;
+
+	if (m_readback_fence->GetCompletedValue() < m_readback_fence_value)
 	{
-		size_t srcPitch = get_aligned_pitch(m_surface.color_format, clip_w);
-		size_t dstPitch = get_packed_pitch(m_surface.color_format, clip_w);
+		CHECK_HRESULT(m_readback_fence->SetEventOnCompletion(m_readback_fence_value, m_readback_fence_event));
+		WaitForSingleObjectEx(m_readback_fence_event, INFINITE, FALSE);
+	}
 
-		void *dest_buffer[] =
-		{
-			vm::base(address_color[0]),
-			vm::base(address_color[1]),
-			vm::base(address_color[2]),
-			vm::base(address_color[3]),
-		};
+	// Surfaces may share pages, unprotect everything before writing
+	for (const pending_readback &readback : m_pending_readbacks)
+		vm::page_protect(readback.protected_start, readback.protected_size, 0, vm::page_readable | vm::page_writable, 0);
 
-		for (u8 i : get_rtt_indexes(to_surface_target(rsx::method_registers[NV4097_SET_SURFACE_COLOR_TARGET])))
-		{
-			if (!address_color[i])
-				continue;
-			copy_readback_buffer_to_dest(dest_buffer[i], m_readback_resources, color_buffer_offset_in_heap[i], srcPitch, dstPitch, clip_h);
-		}
+	for (const pending_readback &readback : m_pending_readbacks)
+	{
+		if (readback.is_depth)
+			copy_readback_depth_to_dest(m_upload_pool, vm::base(readback.address), readback.resource.Get(), readback.offset_in_heap, readback.dst_pitch, readback.src_pitch, readback.height);
+		else
+			copy_readback_buffer_to_dest(m_upload_pool, vm::base(readback.address), readback.resource.Get(), readback.offset_in_heap, readback.dst_pitch, readback.src_pitch, readback.height);
 	}
+
+	m_pending_readbacks.clear();
+	m_readback_depth_conversion_buffer.Reset();
+	m_readback_descriptor_heap.Reset();
 }
 
 
 void D3D12GSRender::copy_render_targets_to_memory(void *buffer, u8 rtt)
 {
+	complete_pending_readbacks();
+
 	size_t heap_offset = download_to_readback_buffer(m_device.Get(), get_current_resource_storage().command_list.Get(), m_readback_resources, std::get<1>(m_rtts.m_bound_render_targets[rtt]), m_surface.color_format);
 
+	end_zpass_query();
 	CHECK_HRESULT(get_current_resource_storage().command_list->Close());
 	m_command_queue->ExecuteCommandLists(1, (ID3D12CommandList**)get_current_resource_storage().command_list.GetAddressOf());
+	submit_occlusion_queries();
 	get_current_resource_storage().set_new_command_list();
 
 	wait_for_command_queue(m_device.Get(), m_command_queue.Get());
-	m_readback_resources.m_get_pos = m_readback_resources.get_current_put_pos_minus_one();
+	m_readback_resources.release_all();
 
 	int clip_w = rsx::method_registers[NV4097_SET_SURFACE_CLIP_HORIZONTAL] >> 16;
 	int clip_h = rsx::method_registers[NV4097_SET_SURFACE_CLIP_VERTICAL] >> 16;
 	size_t srcPitch = get_aligned_pitch(m_surface.color_format, clip_w);
 	size_t dstPitch = get_packed_pitch(m_surface.color_format, clip_w);
-	copy_readback_buffer_to_dest(buffer, m_readback_resources, heap_offset, srcPitch, dstPitch, clip_h);
+	copy_readback_buffer_to_dest(m_upload_pool, buffer, m_readback_resources.get_heap(), heap_offset, dstPitch, srcPitch, clip_h);
 }
 
 void D3D12GSRender::copy_depth_buffer_to_memory(void *buffer)
 {
+	complete_pending_readbacks();
+
 	unsigned clip_w = rsx::method_registers[NV4097_SET_SURFACE_CLIP_HORIZONTAL] >> 16;
 	unsigned clip_h = rsx::method_registers[NV4097_SET_SURFACE_CLIP_VERTICAL] >> 16;
 
@@ -523,27 +568,25 @@ void D3D12GSRender::copy_depth_buffer_to_memory(void *buffer)
 		&CD3DX12_TEXTURE_COPY_LOCATION(std::get<1>(m_rtts.m_bound_depth_stencil), 0), nullptr);
 	get_current_resource_storage().command_list->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(std::get<1>(m_rtts.m_bound_depth_stencil), D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_DEPTH_WRITE));
 
+	end_zpass_query();
 	CHECK_HRESULT(get_current_resource_storage().command_list->Close());
 	m_command_queue->ExecuteCommandLists(1, (ID3D12CommandList**)get_current_resource_storage().command_list.GetAddressOf());
+	submit_occlusion_queries();
 	get_current_resource_storage().set_new_command_list();
 
 	wait_for_command_queue(m_device.Get(), m_command_queue.Get());
-	m_readback_resources.m_get_pos = m_readback_resources.get_current_put_pos_minus_one();
+	m_readback_resources.release_all();
 
 	void *mapped_buffer = m_readback_resources.map<void>(heap_offset);
-	for (unsigned row = 0; row < clip_h; row++)
-	{
-		u32 *casted_dest = (u32*)((char*)buffer + row * clip_w * 4);
-		u32 *casted_src = (u32*)((char*)mapped_buffer + row * row_pitch);
-		for (unsigned col = 0; col < row_pitch / 4; col++)
-			*casted_dest++ = *casted_src++;
-	}
+	copy_readback_rows(m_upload_pool, buffer, mapped_buffer, clip_w * 4, row_pitch, clip_w * 4, clip_h);
 	m_readback_resources.unmap();
 }
 
 
 void D3D12GSRender::copy_stencil_buffer_to_memory(void *buffer)
 {
+	complete_pending_readbacks();
+
 	unsigned clip_w = rsx::method_registers[NV4097_SET_SURFACE_CLIP_HORIZONTAL] >> 16;
 	unsigned clip_h = rsx::method_registers[NV4097_SET_SURFACE_CLIP_VERTICAL] >> 16;
 
@@ -558,21 +601,17 @@ void D3D12GSRender::copy_stencil_buffer_to_memory(void *buffer)
 		&CD3DX12_TEXTURE_COPY_LOCATION(std::get<1>(m_rtts.m_bound_depth_stencil), 1), nullptr);
 	get_current_resource_storage().command_list->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(std::get<1>(m_rtts.m_bound_depth_stencil), D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_DEPTH_WRITE));
 
+	end_zpass_query();
 	CHECK_HRESULT(get_current_resource_storage().command_list->Close());
 	m_command_queue->ExecuteCommandLists(1, (ID3D12CommandList**)get_current_resource_storage().command_list.GetAddressOf());
+	submit_occlusion_queries();
 	get_current_resource_storage().set_new_command_list();
 
 	wait_for_command_queue(m_device.Get(), m_command_queue.Get());
-	m_readback_resources.m_get_pos = m_readback_resources.get_current_put_pos_minus_one();
+	m_readback_resources.release_all();
 
 	void *mapped_buffer = m_readback_resources.map<void>(heap_offset);
-	for (unsigned row = 0; row < clip_h; row++)
-	{
-		char *casted_dest = (char*)buffer + row * clip_w;
-		char *casted_src = (char*)mapped_buffer + row * row_pitch;
-		for (unsigned col = 0; col < row_pitch; col++)
-			*casted_dest++ = *casted_src++;
-	}
+	copy_readback_rows(m_upload_pool, buffer, mapped_buffer, clip_w, row_pitch, clip_w, clip_h);
 	m_readback_resources.unmap();
 }
 
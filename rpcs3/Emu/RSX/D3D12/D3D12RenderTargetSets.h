@@ -5,178 +5,21 @@
 #include "d3dx12.h"
 
 #include "D3D12Formats.h"
+#include "../Common/surface_store.h"
 #include <gsl.h>
 
-namespace rsx
-{
-	namespace
-	{
-		std::vector<u8> get_rtt_indexes(Surface_target color_target)
-		{
-			switch (color_target)
-			{
-			case Surface_target::none: return{};
-			case Surface_target::surface_a: return{ 0 };
-			case Surface_target::surface_b: return{ 1 };
-			case Surface_target::surfaces_a_b: return{ 0, 1 };
-			case Surface_target::surfaces_a_b_c: return{ 0, 1, 2 };
-			case Surface_target::surfaces_a_b_c_d: return{ 0, 1, 2, 3 };
-			}
-			throw EXCEPTION("Wrong color_target");
-		}
-	}
-
-	template<typename Traits>
-	struct surface_store
-	{
-	private:
-		using surface_storage_type = typename Traits::surface_storage_type;
-		using surface_type = typename Traits::surface_type;
-		using command_list_type = typename Traits::command_list_type;
-
-		std::unordered_map<u32, surface_storage_type> m_render_targets_storage = {};
-		std::unordered_map<u32, surface_storage_type> m_depth_stencil_storage = {};
-
-	public:
-		std::array<std::tuple<u32, surface_type>, 4> m_bound_render_targets = {};
-		std::tuple<u32, surface_type> m_bound_depth_stencil = {};
-
-		std::list<surface_storage_type> invalidated_resources;
-
-		surface_store() = default;
-		~surface_store() = default;
-		surface_store(const surface_store&) = delete;
-	private:
-		/**
-		* If render target already exists at address, issue state change operation on cmdList.
-		* Otherwise create one with width, height, clearColor info.
-		* returns the corresponding render target resource.
-		*/
-		template <typename ...Args>
-		gsl::not_null<surface_type> bind_address_as_render_targets(
-			command_list_type command_list,
-			u32 address,
-			Surface_color_format surface_color_format, size_t width, size_t height,
-			Args&&... extra_params)
-		{
-			auto It = m_render_targets_storage.find(address);
-			// TODO: Fix corner cases
-			// This doesn't take overlapping surface(s) into account.
-			// Invalidated surface(s) should also copy their content to the new resources.
-			if (It != m_render_targets_storage.end())
-			{
-				surface_storage_type &rtt = It->second;
-				if (Traits::rtt_has_format_width_height(rtt, surface_color_format, width, height))
-				{
-					Traits::prepare_rtt_for_drawing(command_list, rtt.Get());
-					return rtt.Get();
-				}
-				invalidated_resources.push_back(std::move(rtt));
-				m_render_targets_storage.erase(address);
-			}
-
-			m_render_targets_storage[address] = Traits::create_new_surface(address, surface_color_format, width, height, std::forward<Args>(extra_params)...);
-			return m_render_targets_storage[address].Get();
-		}
-
-		template <typename ...Args>
-		gsl::not_null<surface_type> bind_address_as_depth_stencil(
-			command_list_type command_list,
-			u32 address,
-			Surface_depth_format surface_depth_format, size_t width, size_t height,
-			Args&&... extra_params)
-		{
-			auto It = m_depth_stencil_storage.find(address);
-			if (It != m_depth_stencil_storage.end())
-			{
-				surface_storage_type &ds = It->second;
-				if (Traits::ds_has_format_width_height(ds, surface_depth_format, width, height))
-				{
-					Traits::prepare_ds_for_drawing(command_list, ds.Get());
-					return ds.Get();
-				}
-				invalidated_resources.push_back(std::move(ds));
-				m_depth_stencil_storage.erase(address);
-			}
-
-			m_depth_stencil_storage[address] = Traits::create_new_surface(address, surface_depth_format, width, height, std::forward<Args>(extra_params)...);
-			return m_depth_stencil_storage[address].Get();
-		}
-	public:
-		template <typename ...Args>
-		void prepare_render_target(
-			command_list_type command_list,
-			u32 set_surface_format_reg,
-			u32 clip_horizontal_reg, u32 clip_vertical_reg,
-			Surface_target set_surface_target,
-			const std::array<u32, 4> &surface_addresses, u32 address_z,
-			Args&&... extra_params)
-		{
-			u32 clip_width = clip_horizontal_reg >> 16;
-			u32 clip_height = clip_vertical_reg >> 16;
-			u32 clip_x = clip_horizontal_reg;
-			u32 clip_y = clip_vertical_reg;
-
-			rsx::surface_info surface = {};
-			surface.unpack(set_surface_format_reg);
-
-			// Make previous RTTs sampleable
-			for (std::tuple<u32, surface_type> &rtt : m_bound_render_targets)
-			{
-				if (std::get<1>(rtt) != nullptr)
-					Traits::prepare_rtt_for_sampling(command_list, std::get<1>(rtt));
-				rtt = std::make_tuple(0, nullptr);
-			}
-
-			// Create/Reuse requested rtts
-			for (u8 surface_index : get_rtt_indexes(set_surface_target))
-			{
-				if (surface_addresses[surface_index] == 0)
-					continue;
-
-				m_bound_render_targets[surface_index] = std::make_tuple(surface_addresses[surface_index],
-					bind_address_as_render_targets(command_list, surface_addresses[surface_index], surface.color_format, clip_width, clip_height, std::forward<Args>(extra_params)...));
-			}
-
-			// Same for depth buffer
-			if (std::get<1>(m_bound_depth_stencil) != nullptr)
-				Traits::prepare_ds_for_sampling(command_list, std::get<1>(m_bound_depth_stencil));
-			m_bound_depth_stencil = std::make_tuple(0, nullptr);
-			if (!address_z)
-				return;
-			m_bound_depth_stencil = std::make_tuple(address_z,
-				bind_address_as_depth_stencil(command_list, address_z, surface.depth_format, clip_width, clip_height, std::forward<Args>(extra_params)...));
-		}
-
-		surface_type get_texture_from_render_target_if_applicable(u32 address)
-		{
-			// TODO: Handle texture that overlaps one (or several) surface.
-			// Handle texture conversion
-			// FIXME: Disgaea 3 loading screen seems to use a subset of a surface. It's not properly handled here.
-			// Note: not const because conversions/resolve/... can happen
-			auto It = m_render_targets_storage.find(address);
-			if (It != m_render_targets_storage.end())
-				return It->second.Get();
-			return surface_type();
-		}
-
-		surface_type get_texture_from_depth_stencil_if_applicable(u32 address)
-		{
-			// TODO: Same as above although there wasn't any game using corner case for DS yet.
-			auto It = m_depth_stencil_storage.find(address);
-			if (It != m_depth_stencil_storage.end())
-				return It->second.Get();
-			return surface_type();
-		}
-	};
-}
-
 struct render_target_traits
 {
 	using surface_storage_type = ComPtr<ID3D12Resource>;
 	using surface_type = ID3D12Resource*;
 	using command_list_type = gsl::not_null<ID3D12GraphicsCommandList*>;
 
+	static
+	ID3D12Resource* get(const ComPtr<ID3D12Resource> &surface)
+	{
+		return surface.Get();
+	}
+
 	static
 	ComPtr<ID3D12Resource> create_new_surface(
 		u32 address,
@@ -4,6 +4,7 @@
 #include "D3D12GSRender.h"
 #include "d3dx12.h"
 #include "../Common/TextureUtils.h"
+#include "Emu/PerfCounters.h"
 // For clarity this code deals with texture but belongs to D3D12GSRender class
 #include "D3D12Formats.h"
 
@@ -42,19 +43,83 @@ D3D12_SAMPLER_DESC get_sampler_desc(const rsx::texture &texture)
 
 
 /**
- * Create a texture residing in default heap and generate uploads commands in commandList,
+ * Description of the default heap resource holding texture.
+ */
+D3D12_RESOURCE_DESC get_texture_description(const rsx::texture &texture)
+{
+	size_t depth = texture.depth();
+	if (depth == 0) depth = 1;
+	if (texture.cubemap()) depth *= 6;
+
+	const u8 format = texture.format() & ~(CELL_GCM_TEXTURE_LN | CELL_GCM_TEXTURE_UN);
+	return CD3DX12_RESOURCE_DESC::Tex2D(get_texture_format(format), (UINT)texture.width(), (UINT)texture.height(), (UINT)depth, texture.mipmap());
+}
+
+/**
+ * Texture copies of a draw call.
+ * Copies are recorded after a single barrier moving all updated textures to copy dest state,
+ * and followed by a single barrier moving them back to generic read state.
+ */
+struct texture_upload_batch
+{
+	struct copy_command
+	{
+		CD3DX12_TEXTURE_COPY_LOCATION dst;
+		CD3DX12_TEXTURE_COPY_LOCATION src;
+		UINT dst_y;
+	};
+
+	std::vector<D3D12_RESOURCE_BARRIER> to_copy_dest;
+	std::vector<D3D12_RESOURCE_BARRIER> to_generic_read;
+	std::vector<copy_command> copies;
+
+	/**
+	 * Register a texture written by the batch. Created textures are already in copy dest state.
+	 */
+	void add_texture(ID3D12Resource *texture, bool is_created)
+	{
+		for (const D3D12_RESOURCE_BARRIER &barrier : to_generic_read)
+		{
+			if (barrier.Transition.pResource == texture)
+				return;
+		}
+
+		if (!is_created)
+			to_copy_dest.push_back(CD3DX12_RESOURCE_BARRIER::Transition(texture, D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_COPY_DEST));
+		to_generic_read.push_back(CD3DX12_RESOURCE_BARRIER::Transition(texture, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ));
+	}
+
+	void add_copy(const CD3DX12_TEXTURE_COPY_LOCATION &dst, UINT dst_y, const CD3DX12_TEXTURE_COPY_LOCATION &src)
+	{
+		copies.push_back({ dst, src, dst_y });
+	}
+
+	void flush(ID3D12GraphicsCommandList *command_list)
+	{
+		if (!to_copy_dest.empty())
+			command_list->ResourceBarrier((UINT)to_copy_dest.size(), to_copy_dest.data());
+		for (const copy_command &copy : copies)
+			command_list->CopyTextureRegion(&copy.dst, 0, copy.dst_y, 0, &copy.src, nullptr);
+		if (!to_generic_read.empty())
+			command_list->ResourceBarrier((UINT)to_generic_read.size(), to_generic_read.data());
+
+		to_copy_dest.clear();
+		to_generic_read.clear();
+		copies.clear();
+	}
+};
+
+/**
+ * Create a texture residing in default heap and add its upload commands to batch,
  * using a temporary texture buffer.
  */
 ComPtr<ID3D12Resource> upload_single_texture(
 	const rsx::texture &texture,
 	ID3D12Device *device,
-	ID3D12GraphicsCommandList *command_list,
+	texture_upload_batch &batch,
 	data_heap &texture_buffer_heap)
 {
-	size_t w = texture.width(), h = texture.height();
-	size_t depth = texture.depth();
-	if (depth == 0) depth = 1;
-	if (texture.cubemap()) depth *= 6;
+	perf::add(perf::texture_uploads);
 
 	const u8 format = texture.format() & ~(CELL_GCM_TEXTURE_LN | CELL_GCM_TEXTURE_UN);
 	DXGI_FORMAT dxgi_format = get_texture_format(format);
@@ -70,21 +135,20 @@ ComPtr<ID3D12Resource> upload_single_texture(
 	CHECK_HRESULT(device->CreateCommittedResource(
 		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
 		D3D12_HEAP_FLAG_NONE,
-		&CD3DX12_RESOURCE_DESC::Tex2D(dxgi_format, (UINT)w, (UINT)h, (UINT)depth, texture.mipmap()),
+		&get_texture_description(texture),
 		D3D12_RESOURCE_STATE_COPY_DEST,
 		nullptr,
 		IID_PPV_ARGS(result.GetAddressOf())
 		));
 
+	batch.add_texture(result.Get(), true);
 	size_t mip_level = 0;
 	for (const MipmapLevelInfo mli : mipInfos)
 	{
-		command_list->CopyTextureRegion(&CD3DX12_TEXTURE_COPY_LOCATION(result.Get(), (UINT)mip_level), 0, 0, 0,
-			&CD3DX12_TEXTURE_COPY_LOCATION(texture_buffer_heap.get_heap(), { heap_offset + mli.offset, { dxgi_format, (UINT)mli.width, (UINT)mli.height, 1, (UINT)mli.rowPitch } }), nullptr);
+		batch.add_copy(CD3DX12_TEXTURE_COPY_LOCATION(result.Get(), (UINT)mip_level), 0,
+			CD3DX12_TEXTURE_COPY_LOCATION(texture_buffer_heap.get_heap(), { heap_offset + mli.offset, { dxgi_format, (UINT)mli.width, (UINT)mli.height, 1, (UINT)mli.rowPitch } }));
 		mip_level++;
 	}
-
-	command_list->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(result.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ));
 	return result;
 }
 
@@ -93,7 +157,7 @@ ComPtr<ID3D12Resource> upload_single_texture(
 */
 void update_existing_texture(
 	const rsx::texture &texture,
-	ID3D12GraphicsCommandList *command_list,
+	texture_upload_batch &batch,
 	data_heap &texture_buffer_heap,
 	ID3D12Resource *existing_texture)
 {
@@ -109,24 +173,62 @@ void update_existing_texture(
 	std::vector<MipmapLevelInfo> mipInfos = upload_placed_texture(texture, 256, mapped_buffer);
 	texture_buffer_heap.unmap(CD3DX12_RANGE(heap_offset, heap_offset + buffer_size));
 
-	command_list->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(existing_texture, D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_COPY_DEST));
+	batch.add_texture(existing_texture, false);
 	size_t miplevel = 0;
 	for (const MipmapLevelInfo mli : mipInfos)
 	{
-		command_list->CopyTextureRegion(&CD3DX12_TEXTURE_COPY_LOCATION(existing_texture, (UINT)miplevel), 0, 0, 0,
-			&CD3DX12_TEXTURE_COPY_LOCATION(texture_buffer_heap.get_heap(), { heap_offset + mli.offset,{ dxgi_format, (UINT)mli.width, (UINT)mli.height, 1, (UINT)mli.rowPitch } }), nullptr);
+		batch.add_copy(CD3DX12_TEXTURE_COPY_LOCATION(existing_texture, (UINT)miplevel), 0,
+			CD3DX12_TEXTURE_COPY_LOCATION(texture_buffer_heap.get_heap(), { heap_offset + mli.offset,{ dxgi_format, (UINT)mli.width, (UINT)mli.height, 1, (UINT)mli.rowPitch } }));
 		miplevel++;
 	}
+}
 
-	command_list->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(existing_texture, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ));
+/**
+ * Upload the rows of mipmap level 0 stored in bytes dirty_begin to dirty_end of texture memory (offsets from texture address).
+ * Returns false if they can't be updated on their own, nothing is added to batch then.
+ */
+bool update_existing_texture_rows(
+	const rsx::texture &texture,
+	texture_upload_batch &batch,
+	data_heap &texture_buffer_heap,
+	ID3D12Resource *existing_texture,
+	size_t dirty_begin,
+	size_t dirty_end)
+{
+	size_t first_row, row_count;
+	if (!get_texture_dirty_rows(texture, dirty_begin, dirty_end, first_row, row_count))
+		return false;
+
+	perf::add(perf::texture_partial_uploads);
+
+	const u8 format = texture.format() & ~(CELL_GCM_TEXTURE_LN | CELL_GCM_TEXTURE_UN);
+	DXGI_FORMAT dxgi_format = get_texture_format(format);
+
+	size_t buffer_size = get_placed_texture_rows_storage_size(texture, 256, row_count);
+	size_t heap_offset = texture_buffer_heap.alloc<D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT>(buffer_size);
+
+	void *mapped_buffer = texture_buffer_heap.map<void>(CD3DX12_RANGE(heap_offset, heap_offset + buffer_size));
+	MipmapLevelInfo mli = upload_placed_texture_rows(texture, 256, mapped_buffer, first_row, row_count);
+	texture_buffer_heap.unmap(CD3DX12_RANGE(heap_offset, heap_offset + buffer_size));
+
+	// Rows are counted in blocks
+	const UINT first_texel_row = (UINT)(first_row * (mli.height / row_count));
+
+	batch.add_texture(existing_texture, false);
+	batch.add_copy(CD3DX12_TEXTURE_COPY_LOCATION(existing_texture, 0), first_texel_row,
+		CD3DX12_TEXTURE_COPY_LOCATION(texture_buffer_heap.get_heap(), { heap_offset, { dxgi_format, (UINT)mli.width, (UINT)mli.height, 1, (UINT)mli.rowPitch } }));
+	return true;
 }
 }
 
-void D3D12GSRender::upload_and_bind_textures(ID3D12GraphicsCommandList *command_list, size_t descriptor_index, size_t texture_count)
+void D3D12GSRender::upload_and_bind_textures(ID3D12GraphicsCommandList *command_list, size_t texture_count)
 {
-	size_t used_texture = 0;
+	ID3D12Resource *resources[rsx::limits::textures_count];
+	D3D12_SHADER_RESOURCE_VIEW_DESC views[rsx::limits::textures_count];
+	D3D12_SAMPLER_DESC samplers[rsx::limits::textures_count];
+	texture_upload_batch upload_batch;
 
-	for (u32 i = 0; i < rsx::limits::textures_count; ++i)
+	for (u32 i = 0; i < texture_count; ++i)
 	{
 		if (!textures[i].enabled())
 		{
@@ -141,21 +243,15 @@ void D3D12GSRender::upload_and_bind_textures(ID3D12GraphicsCommandList *command_
 				D3D12_SHADER_COMPONENT_MAPPING_FORCE_VALUE_0,
 				D3D12_SHADER_COMPONENT_MAPPING_FORCE_VALUE_0,
 				D3D12_SHADER_COMPONENT_MAPPING_FORCE_VALUE_0);
-			m_device->CreateShaderResourceView(m_dummy_texture, &shader_resource_view_desc,
-				CD3DX12_CPU_DESCRIPTOR_HANDLE(get_current_resource_storage().descriptors_heap->GetCPUDescriptorHandleForHeapStart())
-				.Offset((INT)descriptor_index + (INT)used_texture, g_descriptor_stride_srv_cbv_uav)
-				);
+			resources[i] = m_dummy_texture;
+			views[i] = shader_resource_view_desc;
 
 			D3D12_SAMPLER_DESC sampler_desc = {};
 			sampler_desc.Filter = D3D12_FILTER_MIN_MAG_MIP_POINT;
 			sampler_desc.AddressU = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
 			sampler_desc.AddressV = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
 			sampler_desc.AddressW = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
-			m_device->CreateSampler(&sampler_desc,
-				CD3DX12_CPU_DESCRIPTOR_HANDLE(get_current_resource_storage().sampler_descriptor_heap[get_current_resource_storage().sampler_descriptors_heap_index]->GetCPUDescriptorHandleForHeapStart())
-				.Offset((INT)get_current_resource_storage().current_sampler_index + (INT)used_texture, g_descriptor_stride_samplers)
-				);
-			used_texture++;
+			samplers[i] = sampler_desc;
 			continue;
 		}
 		size_t w = textures[i].width(), h = textures[i].height();
@@ -182,16 +278,28 @@ void D3D12GSRender::upload_and_bind_textures(ID3D12GraphicsCommandList *command_
 		{
 			if (cached_texture->first.m_is_dirty)
 			{
-				update_existing_texture(textures[i], command_list, m_buffer_data, cached_texture->second.Get());
+				const u32 dirty_start = cached_texture->first.m_dirty_start, dirty_end = cached_texture->first.m_dirty_end;
+
+				// Protect before uploading: writes made during the upload will mark the texture dirty again
 				m_texture_cache.protect_data(texaddr, texaddr, get_texture_size(textures[i]));
+
+				// Only some pages were written, upload the rows they contain
+				const bool partial = dirty_end > dirty_start &&
+					update_existing_texture_rows(textures[i], upload_batch, m_buffer_data, cached_texture->second.Get(), dirty_start > texaddr ? dirty_start - texaddr : 0, dirty_end - texaddr);
+				if (!partial)
+					update_existing_texture(textures[i], upload_batch, m_buffer_data, cached_texture->second.Get());
 			}
 			vram_texture = cached_texture->second.Get();
 		}
 		else
 		{
 			if (cached_texture != nullptr)
-				get_current_resource_storage().dirty_textures.push_back(m_texture_cache.remove_from_cache(texaddr));
-			ComPtr<ID3D12Resource> tex = upload_single_texture(textures[i], m_device.Get(), command_list, m_buffer_data);
+				m_texture_cache.recycle(texaddr);
+			ComPtr<ID3D12Resource> tex = m_texture_cache.take_reusable(get_texture_description(textures[i]));
+			if (tex)
+				update_existing_texture(textures[i], upload_batch, m_buffer_data, tex.Get());
+			else
+				tex = upload_single_texture(textures[i], m_device.Get(), upload_batch, m_buffer_data);
 			std::wstring name = L"texture_@" + std::to_wstring(texaddr);
 			tex->SetName(name.c_str());
 			vram_texture = tex.Get();
@@ -318,29 +426,14 @@ void D3D12GSRender::upload_and_bind_textures(ID3D12GraphicsCommandList *command_
 			break;
 		}
 
-		m_device->CreateShaderResourceView(vram_texture, &shared_resource_view_desc,
-			CD3DX12_CPU_DESCRIPTOR_HANDLE(get_current_resource_storage().descriptors_heap->GetCPUDescriptorHandleForHeapStart())
-			.Offset((UINT)descriptor_index + (UINT)used_texture, g_descriptor_stride_srv_cbv_uav));
-
-		if (get_current_resource_storage().current_sampler_index + 16 > 2048)
-		{
-			get_current_resource_storage().sampler_descriptors_heap_index = 1;
-			get_current_resource_storage().current_sampler_index = 0;
-
-			ID3D12DescriptorHeap *descriptors[] =
-			{
-				get_current_resource_storage().descriptors_heap.Get(),
-				get_current_resource_storage().sampler_descriptor_heap[get_current_resource_storage().sampler_descriptors_heap_index].Get(),
-			};
-			command_list->SetDescriptorHeaps(2, descriptors);
-		}
-		m_device->CreateSampler(&get_sampler_desc(textures[i]),
-			CD3DX12_CPU_DESCRIPTOR_HANDLE(get_current_resource_storage().sampler_descriptor_heap[get_current_resource_storage().sampler_descriptors_heap_index]->GetCPUDescriptorHandleForHeapStart())
-			.Offset((UINT)get_current_resource_storage().current_sampler_index + (UINT)used_texture, g_descriptor_stride_samplers));
-
-		used_texture++;
+		resources[i] = vram_texture;
+		views[i] = shared_resource_view_desc;
+		samplers[i] = get_sampler_desc(textures[i]);
 	}
 
+	upload_batch.flush(command_list);
 
+	command_list->SetGraphicsRootDescriptorTable(2, get_current_resource_storage().get_texture_table(resources, views, texture_count));
+	command_list->SetGraphicsRootDescriptorTable(1, get_current_resource_storage().get_sampler_table(samplers, texture_count));
 }
 #endif
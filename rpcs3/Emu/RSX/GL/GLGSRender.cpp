@@ -1,11 +1,13 @@
 #include "stdafx.h"
 #include "Utilities/rPlatform.h" // only for rImage
+#include "Utilities/Trace.h"
 #include "Emu/Memory/Memory.h"
 #include "Emu/System.h"
 #include "Emu/state.h"
 #include "GLGSRender.h"
 #include "../rsx_methods.h"
 #include "../Common/BufferUtils.h"
+#include "../Common/TextureUtils.h"
 
 #define DUMP_VERTEX_DATA 0
 
@@ -30,39 +32,98 @@ namespace
 		}
 		throw EXCEPTION("Unknow depth format");
 	}
-}
-
-GLGSRender::GLGSRender() : GSRender(frame_type::OpenGL)
-{
-	shaders_cache.load(rsx::shader_language::glsl);
-}
 
-u32 GLGSRender::enable(u32 condition, u32 cap)
-{
-	if (condition)
-	{
-		glEnable(cap);
-	}
-	else
+	enum : u32
 	{
-		glDisable(cap);
-	}
+		state_masks = 1 << 0,
+		state_depth = 1 << 1,
+		state_blend = 1 << 2,
+		state_stencil = 1 << 3,
+		state_raster = 1 << 4,
 
-	return condition;
-}
+		state_all = (1 << 5) - 1,
+	};
 
-u32 GLGSRender::enable(u32 condition, u32 cap, u32 index)
-{
-	if (condition)
+	struct state_register_range
 	{
-		glEnablei(cap, index);
-	}
-	else
+		u32 group;
+		u32 reg;
+		u32 count;
+	};
+
+	// Registers read by GLGSRender::begin(), grouped by the GL state they feed
+	const state_register_range state_registers[] =
 	{
-		glDisablei(cap, index);
-	}
+		{ state_masks, NV4097_SET_COLOR_MASK, 1 },
+		{ state_masks, NV4097_SET_DEPTH_MASK, 1 },
+		{ state_masks, NV4097_SET_STENCIL_MASK, 1 },
+
+		{ state_depth, NV4097_SET_DEPTH_TEST_ENABLE, 1 },
+		{ state_depth, NV4097_SET_DEPTH_FUNC, 1 },
+		{ state_depth, NV4097_SET_DEPTH_BOUNDS_TEST_ENABLE, 1 },
+		{ state_depth, NV4097_SET_DEPTH_BOUNDS_MIN, 1 },
+		{ state_depth, NV4097_SET_DEPTH_BOUNDS_MAX, 1 },
+		{ state_depth, NV4097_SET_CLIP_MIN, 1 },
+		{ state_depth, NV4097_SET_CLIP_MAX, 1 },
+
+		{ state_blend, NV4097_SET_BLEND_ENABLE, 1 },
+		{ state_blend, NV4097_SET_BLEND_FUNC_SFACTOR, 1 },
+		{ state_blend, NV4097_SET_BLEND_FUNC_DFACTOR, 1 },
+		{ state_blend, NV4097_SET_BLEND_COLOR, 1 },
+		{ state_blend, NV4097_SET_BLEND_COLOR2, 1 },
+		{ state_blend, NV4097_SET_BLEND_EQUATION, 1 },
+		{ state_blend, NV4097_SET_BLEND_ENABLE_MRT, 1 },
+		{ state_blend, NV4097_SET_SURFACE_FORMAT, 1 },
+
+		{ state_stencil, NV4097_SET_STENCIL_TEST_ENABLE, 1 },
+		{ state_stencil, NV4097_SET_STENCIL_FUNC, 1 },
+		{ state_stencil, NV4097_SET_STENCIL_FUNC_REF, 1 },
+		{ state_stencil, NV4097_SET_STENCIL_FUNC_MASK, 1 },
+		{ state_stencil, NV4097_SET_STENCIL_OP_FAIL, 1 },
+		{ state_stencil, NV4097_SET_STENCIL_OP_ZFAIL, 1 },
+		{ state_stencil, NV4097_SET_STENCIL_OP_ZPASS, 1 },
+		{ state_stencil, NV4097_SET_TWO_SIDED_STENCIL_TEST_ENABLE, 1 },
+		{ state_stencil, NV4097_SET_BACK_STENCIL_MASK, 1 },
+		{ state_stencil, NV4097_SET_BACK_STENCIL_FUNC, 1 },
+		{ state_stencil, NV4097_SET_BACK_STENCIL_FUNC_REF, 1 },
+		{ state_stencil, NV4097_SET_BACK_STENCIL_FUNC_MASK, 1 },
+		{ state_stencil, NV4097_SET_BACK_STENCIL_OP_FAIL, 1 },
+		{ state_stencil, NV4097_SET_BACK_STENCIL_OP_ZFAIL, 1 },
+		{ state_stencil, NV4097_SET_BACK_STENCIL_OP_ZPASS, 1 },
+
+		{ state_raster, NV4097_SET_DITHER_ENABLE, 1 },
+		{ state_raster, NV4097_SET_ALPHA_TEST_ENABLE, 1 },
+		{ state_raster, NV4097_SET_SHADE_MODE, 1 },
+		{ state_raster, NV4097_SET_LOGIC_OP_ENABLE, 1 },
+		{ state_raster, NV4097_SET_LOGIC_OP, 1 },
+		{ state_raster, NV4097_SET_LINE_WIDTH, 1 },
+		{ state_raster, NV4097_SET_LINE_SMOOTH_ENABLE, 1 },
+		{ state_raster, NV4097_SET_POLY_OFFSET_POINT_ENABLE, 1 },
+		{ state_raster, NV4097_SET_POLY_OFFSET_LINE_ENABLE, 1 },
+		{ state_raster, NV4097_SET_POLY_OFFSET_FILL_ENABLE, 1 },
+		{ state_raster, NV4097_SET_POLYGON_OFFSET_SCALE_FACTOR, 1 },
+		{ state_raster, NV4097_SET_POLYGON_OFFSET_BIAS, 1 },
+		{ state_raster, NV4097_SET_USER_CLIP_PLANE_CONTROL, 1 },
+		{ state_raster, NV4097_SET_POLYGON_STIPPLE, 1 },
+		{ state_raster, NV4097_SET_POLYGON_STIPPLE_PATTERN, 32 },
+		{ state_raster, NV4097_SET_FRONT_POLYGON_MODE, 1 },
+		{ state_raster, NV4097_SET_BACK_POLYGON_MODE, 1 },
+		{ state_raster, NV4097_SET_CULL_FACE_ENABLE, 1 },
+		{ state_raster, NV4097_SET_CULL_FACE, 1 },
+		{ state_raster, NV4097_SET_FRONT_FACE, 1 },
+		{ state_raster, NV4097_SET_POLY_SMOOTH_ENABLE, 1 },
+		{ state_raster, NV4097_SET_RESTART_INDEX_ENABLE, 1 },
+		{ state_raster, NV4097_SET_RESTART_INDEX, 1 },
+		{ state_raster, NV4097_SET_LINE_STIPPLE, 1 },
+		{ state_raster, NV4097_SET_LINE_STIPPLE_PATTERN, 1 },
+	};
+}
+
+extern std::function<bool(u32 addr)> gfxHandler;
 
-	return condition;
+GLGSRender::GLGSRender() : GSRender(frame_type::OpenGL)
+{
+	shaders_cache.load(rsx::shader_language::glsl);
 }
 
 extern CellGcmContextData current_context;
@@ -79,110 +140,129 @@ void GLGSRender::begin()
 
 	init_buffers();
 
-	u32 color_mask = rsx::method_registers[NV4097_SET_COLOR_MASK];
-	bool color_mask_b = !!(color_mask & 0xff);
-	bool color_mask_g = !!((color_mask >> 8) & 0xff);
-	bool color_mask_r = !!((color_mask >> 16) & 0xff);
-	bool color_mask_a = !!((color_mask >> 24) & 0xff);
-
-	__glcheck glColorMask(color_mask_r, color_mask_g, color_mask_b, color_mask_a);
-	__glcheck glDepthMask(rsx::method_registers[NV4097_SET_DEPTH_MASK]);
-	__glcheck glStencilMask(rsx::method_registers[NV4097_SET_STENCIL_MASK]);
+	const u32 dirty = get_dirty_state();
 
-	if (__glcheck enable(rsx::method_registers[NV4097_SET_DEPTH_TEST_ENABLE], GL_DEPTH_TEST))
+	if (dirty & state_masks)
 	{
-		__glcheck glDepthFunc(rsx::method_registers[NV4097_SET_DEPTH_FUNC]);
-		__glcheck glDepthMask(rsx::method_registers[NV4097_SET_DEPTH_MASK]);
+		u32 color_mask = rsx::method_registers[NV4097_SET_COLOR_MASK];
+		bool color_mask_b = !!(color_mask & 0xff);
+		bool color_mask_g = !!((color_mask >> 8) & 0xff);
+		bool color_mask_r = !!((color_mask >> 16) & 0xff);
+		bool color_mask_a = !!((color_mask >> 24) & 0xff);
+
+		__glcheck m_gl_state.color_mask(color_mask_r, color_mask_g, color_mask_b, color_mask_a);
+		__glcheck m_gl_state.depth_mask(rsx::method_registers[NV4097_SET_DEPTH_MASK]);
+		__glcheck m_gl_state.stencil_mask(rsx::method_registers[NV4097_SET_STENCIL_MASK]);
 	}
 
-	if (glDepthBoundsEXT && (__glcheck enable(rsx::method_registers[NV4097_SET_DEPTH_BOUNDS_TEST_ENABLE], GL_DEPTH_BOUNDS_TEST_EXT)))
+	if (dirty & state_depth)
 	{
-		__glcheck glDepthBoundsEXT((f32&)rsx::method_registers[NV4097_SET_DEPTH_BOUNDS_MIN], (f32&)rsx::method_registers[NV4097_SET_DEPTH_BOUNDS_MAX]);
-	}
+		if (__glcheck m_gl_state.enable(rsx::method_registers[NV4097_SET_DEPTH_TEST_ENABLE], GL_DEPTH_TEST))
+		{
+			__glcheck m_gl_state.depth_func(rsx::method_registers[NV4097_SET_DEPTH_FUNC]);
+		}
 
-	__glcheck glDepthRange((f32&)rsx::method_registers[NV4097_SET_CLIP_MIN], (f32&)rsx::method_registers[NV4097_SET_CLIP_MAX]);
-	__glcheck enable(rsx::method_registers[NV4097_SET_DITHER_ENABLE], GL_DITHER);
+		if (glDepthBoundsEXT && (__glcheck m_gl_state.enable(rsx::method_registers[NV4097_SET_DEPTH_BOUNDS_TEST_ENABLE], GL_DEPTH_BOUNDS_TEST_EXT)))
+		{
+			__glcheck m_gl_state.depth_bounds((f32&)rsx::method_registers[NV4097_SET_DEPTH_BOUNDS_MIN], (f32&)rsx::method_registers[NV4097_SET_DEPTH_BOUNDS_MAX]);
+		}
 
-	if (__glcheck enable(rsx::method_registers[NV4097_SET_ALPHA_TEST_ENABLE], GL_ALPHA_TEST))
-	{
-		//TODO: NV4097_SET_ALPHA_REF must be converted to f32
-		//glcheck(glAlphaFunc(rsx::method_registers[NV4097_SET_ALPHA_FUNC], rsx::method_registers[NV4097_SET_ALPHA_REF]));
+		__glcheck m_gl_state.depth_range((f32&)rsx::method_registers[NV4097_SET_CLIP_MIN], (f32&)rsx::method_registers[NV4097_SET_CLIP_MAX]);
 	}
 
-	if (__glcheck enable(rsx::method_registers[NV4097_SET_BLEND_ENABLE], GL_BLEND))
+	if (dirty & state_blend)
 	{
-		u32 sfactor = rsx::method_registers[NV4097_SET_BLEND_FUNC_SFACTOR];
-		u32 dfactor = rsx::method_registers[NV4097_SET_BLEND_FUNC_DFACTOR];
-		u16 sfactor_rgb = sfactor;
-		u16 sfactor_a = sfactor >> 16;
-		u16 dfactor_rgb = dfactor;
-		u16 dfactor_a = dfactor >> 16;
+		if (__glcheck m_gl_state.enable(rsx::method_registers[NV4097_SET_BLEND_ENABLE], GL_BLEND))
+		{
+			u32 sfactor = rsx::method_registers[NV4097_SET_BLEND_FUNC_SFACTOR];
+			u32 dfactor = rsx::method_registers[NV4097_SET_BLEND_FUNC_DFACTOR];
+			u16 sfactor_rgb = sfactor;
+			u16 sfactor_a = sfactor >> 16;
+			u16 dfactor_rgb = dfactor;
+			u16 dfactor_a = dfactor >> 16;
 
-		__glcheck glBlendFuncSeparate(sfactor_rgb, dfactor_rgb, sfactor_a, dfactor_a);
+			__glcheck m_gl_state.blend_func(sfactor_rgb, dfactor_rgb, sfactor_a, dfactor_a);
 
-		if (m_surface.color_format == Surface_color_format::w16z16y16x16) //TODO: check another color formats
-		{
-			u32 blend_color = rsx::method_registers[NV4097_SET_BLEND_COLOR];
-			u32 blend_color2 = rsx::method_registers[NV4097_SET_BLEND_COLOR2];
+			if (m_surface.color_format == Surface_color_format::w16z16y16x16) //TODO: check another color formats
+			{
+				u32 blend_color = rsx::method_registers[NV4097_SET_BLEND_COLOR];
+				u32 blend_color2 = rsx::method_registers[NV4097_SET_BLEND_COLOR2];
 
-			u16 blend_color_r = blend_color;
-			u16 blend_color_g = blend_color >> 16;
-			u16 blend_color_b = blend_color2;
-			u16 blend_color_a = blend_color2 >> 16;
+				u16 blend_color_r = blend_color;
+				u16 blend_color_g = blend_color >> 16;
+				u16 blend_color_b = blend_color2;
+				u16 blend_color_a = blend_color2 >> 16;
 
-			__glcheck glBlendColor(blend_color_r / 65535.f, blend_color_g / 65535.f, blend_color_b / 65535.f, blend_color_a / 65535.f);
-		}
-		else
-		{
-			u32 blend_color = rsx::method_registers[NV4097_SET_BLEND_COLOR];
-			u8 blend_color_r = blend_color;
-			u8 blend_color_g = blend_color >> 8;
-			u8 blend_color_b = blend_color >> 16;
-			u8 blend_color_a = blend_color >> 24;
+				__glcheck m_gl_state.blend_color(blend_color_r / 65535.f, blend_color_g / 65535.f, blend_color_b / 65535.f, blend_color_a / 65535.f);
+			}
+			else
+			{
+				u32 blend_color = rsx::method_registers[NV4097_SET_BLEND_COLOR];
+				u8 blend_color_r = blend_color;
+				u8 blend_color_g = blend_color >> 8;
+				u8 blend_color_b = blend_color >> 16;
+				u8 blend_color_a = blend_color >> 24;
 
-			__glcheck glBlendColor(blend_color_r / 255.f, blend_color_g / 255.f, blend_color_b / 255.f, blend_color_a / 255.f);
-		}
+				__glcheck m_gl_state.blend_color(blend_color_r / 255.f, blend_color_g / 255.f, blend_color_b / 255.f, blend_color_a / 255.f);
+			}
+
+			u32 equation = rsx::method_registers[NV4097_SET_BLEND_EQUATION];
+			u16 equation_rgb = equation;
+			u16 equation_a = equation >> 16;
 
-		u32 equation = rsx::method_registers[NV4097_SET_BLEND_EQUATION];
-		u16 equation_rgb = equation;
-		u16 equation_a = equation >> 16;
+			__glcheck m_gl_state.blend_equation(equation_rgb, equation_a);
+		}
 
-		__glcheck glBlendEquationSeparate(equation_rgb, equation_a);
+		if (u32 blend_mrt = rsx::method_registers[NV4097_SET_BLEND_ENABLE_MRT])
+		{
+			__glcheck m_gl_state.enable(blend_mrt & 2, GL_BLEND, GL_COLOR_ATTACHMENT1);
+			__glcheck m_gl_state.enable(blend_mrt & 4, GL_BLEND, GL_COLOR_ATTACHMENT2);
+			__glcheck m_gl_state.enable(blend_mrt & 8, GL_BLEND, GL_COLOR_ATTACHMENT3);
+		}
 	}
-	
-	if (__glcheck enable(rsx::method_registers[NV4097_SET_STENCIL_TEST_ENABLE], GL_STENCIL_TEST))
-	{
-		__glcheck glStencilFunc(rsx::method_registers[NV4097_SET_STENCIL_FUNC], rsx::method_registers[NV4097_SET_STENCIL_FUNC_REF],
-			rsx::method_registers[NV4097_SET_STENCIL_FUNC_MASK]);
-		__glcheck glStencilOp(rsx::method_registers[NV4097_SET_STENCIL_OP_FAIL], rsx::method_registers[NV4097_SET_STENCIL_OP_ZFAIL],
-			rsx::method_registers[NV4097_SET_STENCIL_OP_ZPASS]);
 
-		if (rsx::method_registers[NV4097_SET_TWO_SIDED_STENCIL_TEST_ENABLE]) {
-			__glcheck glStencilMaskSeparate(GL_BACK, rsx::method_registers[NV4097_SET_BACK_STENCIL_MASK]);
-			__glcheck glStencilFuncSeparate(GL_BACK, rsx::method_registers[NV4097_SET_BACK_STENCIL_FUNC],
-				rsx::method_registers[NV4097_SET_BACK_STENCIL_FUNC_REF], rsx::method_registers[NV4097_SET_BACK_STENCIL_FUNC_MASK]);
-			__glcheck glStencilOpSeparate(GL_BACK, rsx::method_registers[NV4097_SET_BACK_STENCIL_OP_FAIL],
-				rsx::method_registers[NV4097_SET_BACK_STENCIL_OP_ZFAIL], rsx::method_registers[NV4097_SET_BACK_STENCIL_OP_ZPASS]);
+	if (dirty & state_stencil)
+	{
+		if (__glcheck m_gl_state.enable(rsx::method_registers[NV4097_SET_STENCIL_TEST_ENABLE], GL_STENCIL_TEST))
+		{
+			__glcheck m_gl_state.stencil_func(rsx::method_registers[NV4097_SET_STENCIL_FUNC], rsx::method_registers[NV4097_SET_STENCIL_FUNC_REF],
+				rsx::method_registers[NV4097_SET_STENCIL_FUNC_MASK]);
+			__glcheck m_gl_state.stencil_op(rsx::method_registers[NV4097_SET_STENCIL_OP_FAIL], rsx::method_registers[NV4097_SET_STENCIL_OP_ZFAIL],
+				rsx::method_registers[NV4097_SET_STENCIL_OP_ZPASS]);
+
+			if (rsx::method_registers[NV4097_SET_TWO_SIDED_STENCIL_TEST_ENABLE]) {
+				__glcheck m_gl_state.back_stencil_mask(rsx::method_registers[NV4097_SET_BACK_STENCIL_MASK]);
+				__glcheck m_gl_state.back_stencil_func(rsx::method_registers[NV4097_SET_BACK_STENCIL_FUNC],
+					rsx::method_registers[NV4097_SET_BACK_STENCIL_FUNC_REF], rsx::method_registers[NV4097_SET_BACK_STENCIL_FUNC_MASK]);
+				__glcheck m_gl_state.back_stencil_op(rsx::method_registers[NV4097_SET_BACK_STENCIL_OP_FAIL],
+					rsx::method_registers[NV4097_SET_BACK_STENCIL_OP_ZFAIL], rsx::method_registers[NV4097_SET_BACK_STENCIL_OP_ZPASS]);
+			}
 		}
 	}
 
-	__glcheck glShadeModel(rsx::method_registers[NV4097_SET_SHADE_MODE]);
+	if (!(dirty & state_raster))
+	{
+		return;
+	}
+
+	__glcheck m_gl_state.enable(rsx::method_registers[NV4097_SET_DITHER_ENABLE], GL_DITHER);
 
-	if (u32 blend_mrt = rsx::method_registers[NV4097_SET_BLEND_ENABLE_MRT])
+	if (__glcheck m_gl_state.enable(rsx::method_registers[NV4097_SET_ALPHA_TEST_ENABLE], GL_ALPHA_TEST))
 	{
-		__glcheck enable(blend_mrt & 2, GL_BLEND, GL_COLOR_ATTACHMENT1);
-		__glcheck enable(blend_mrt & 4, GL_BLEND, GL_COLOR_ATTACHMENT2);
-		__glcheck enable(blend_mrt & 8, GL_BLEND, GL_COLOR_ATTACHMENT3);
+		//TODO: NV4097_SET_ALPHA_REF must be converted to f32
+		//glcheck(glAlphaFunc(rsx::method_registers[NV4097_SET_ALPHA_FUNC], rsx::method_registers[NV4097_SET_ALPHA_REF]));
 	}
-	
-	if (__glcheck enable(rsx::method_registers[NV4097_SET_LOGIC_OP_ENABLE], GL_LOGIC_OP))
+
+	__glcheck m_gl_state.shade_model(rsx::method_registers[NV4097_SET_SHADE_MODE]);
+
+	if (__glcheck m_gl_state.enable(rsx::method_registers[NV4097_SET_LOGIC_OP_ENABLE], GL_LOGIC_OP))
 	{
-		__glcheck glLogicOp(rsx::method_registers[NV4097_SET_LOGIC_OP]);
+		__glcheck m_gl_state.logic_op(rsx::method_registers[NV4097_SET_LOGIC_OP]);
 	}
 
 	u32 line_width = rsx::method_registers[NV4097_SET_LINE_WIDTH];
-	__glcheck glLineWidth((line_width >> 3) + (line_width & 7) / 8.f);
-	__glcheck enable(rsx::method_registers[NV4097_SET_LINE_SMOOTH_ENABLE], GL_LINE_SMOOTH);
+	__glcheck m_gl_state.line_width(((line_width >> 3) + (line_width & 7) / 8.f) * gl_render_target_traits::resolution_scale / 100.f);
+	__glcheck m_gl_state.enable(rsx::method_registers[NV4097_SET_LINE_SMOOTH_ENABLE], GL_LINE_SMOOTH);
 
 	//TODO
 	//NV4097_SET_ANISO_SPREAD
@@ -201,11 +281,11 @@ void GLGSRender::begin()
 	*/
 	//NV4097_SET_FOG_PARAMS
 
-	__glcheck enable(rsx::method_registers[NV4097_SET_POLY_OFFSET_POINT_ENABLE], GL_POLYGON_OFFSET_POINT);
-	__glcheck enable(rsx::method_registers[NV4097_SET_POLY_OFFSET_LINE_ENABLE], GL_POLYGON_OFFSET_LINE);
-	__glcheck enable(rsx::method_registers[NV4097_SET_POLY_OFFSET_FILL_ENABLE], GL_POLYGON_OFFSET_FILL);
+	__glcheck m_gl_state.enable(rsx::method_registers[NV4097_SET_POLY_OFFSET_POINT_ENABLE], GL_POLYGON_OFFSET_POINT);
+	__glcheck m_gl_state.enable(rsx::method_registers[NV4097_SET_POLY_OFFSET_LINE_ENABLE], GL_POLYGON_OFFSET_LINE);
+	__glcheck m_gl_state.enable(rsx::method_registers[NV4097_SET_POLY_OFFSET_FILL_ENABLE], GL_POLYGON_OFFSET_FILL);
 
-	__glcheck glPolygonOffset((f32&)rsx::method_registers[NV4097_SET_POLYGON_OFFSET_SCALE_FACTOR],
+	__glcheck m_gl_state.polygon_offset((f32&)rsx::method_registers[NV4097_SET_POLYGON_OFFSET_SCALE_FACTOR],
 		(f32&)rsx::method_registers[NV4097_SET_POLYGON_OFFSET_BIAS]);
 
 	//NV4097_SET_SPECULAR_ENABLE
@@ -222,31 +302,29 @@ void GLGSRender::begin()
 	u8 clip_plane_5 = (clip_plane_control >> 20) & 0xf;
 
 	//TODO
-	if (__glcheck enable(clip_plane_0, GL_CLIP_DISTANCE0)) {}
-	if (__glcheck enable(clip_plane_1, GL_CLIP_DISTANCE1)) {}
-	if (__glcheck enable(clip_plane_2, GL_CLIP_DISTANCE2)) {}
-	if (__glcheck enable(clip_plane_3, GL_CLIP_DISTANCE3)) {}
-	if (__glcheck enable(clip_plane_4, GL_CLIP_DISTANCE4)) {}
-	if (__glcheck enable(clip_plane_5, GL_CLIP_DISTANCE5)) {}
-
-	__glcheck enable(rsx::method_registers[NV4097_SET_POLY_OFFSET_FILL_ENABLE], GL_POLYGON_OFFSET_FILL);
-
-	if (__glcheck enable(rsx::method_registers[NV4097_SET_POLYGON_STIPPLE], GL_POLYGON_STIPPLE))
+	if (__glcheck m_gl_state.enable(clip_plane_0, GL_CLIP_DISTANCE0)) {}
+	if (__glcheck m_gl_state.enable(clip_plane_1, GL_CLIP_DISTANCE1)) {}
+	if (__glcheck m_gl_state.enable(clip_plane_2, GL_CLIP_DISTANCE2)) {}
+	if (__glcheck m_gl_state.enable(clip_plane_3, GL_CLIP_DISTANCE3)) {}
+	if (__glcheck m_gl_state.enable(clip_plane_4, GL_CLIP_DISTANCE4)) {}
+	if (__glcheck m_gl_state.enable(clip_plane_5, GL_CLIP_DISTANCE5)) {}
+
+	if (__glcheck m_gl_state.enable(rsx::method_registers[NV4097_SET_POLYGON_STIPPLE], GL_POLYGON_STIPPLE))
 	{
 		__glcheck glPolygonStipple((GLubyte*)(rsx::method_registers + NV4097_SET_POLYGON_STIPPLE_PATTERN));
 	}
 
-	__glcheck glPolygonMode(GL_FRONT, rsx::method_registers[NV4097_SET_FRONT_POLYGON_MODE]);
-	__glcheck glPolygonMode(GL_BACK, rsx::method_registers[NV4097_SET_BACK_POLYGON_MODE]);
+	__glcheck m_gl_state.polygon_mode(GL_FRONT, rsx::method_registers[NV4097_SET_FRONT_POLYGON_MODE]);
+	__glcheck m_gl_state.polygon_mode(GL_BACK, rsx::method_registers[NV4097_SET_BACK_POLYGON_MODE]);
 
-	if (__glcheck enable(rsx::method_registers[NV4097_SET_CULL_FACE_ENABLE], GL_CULL_FACE))
+	if (__glcheck m_gl_state.enable(rsx::method_registers[NV4097_SET_CULL_FACE_ENABLE], GL_CULL_FACE))
 	{
-		__glcheck glCullFace(rsx::method_registers[NV4097_SET_CULL_FACE]);
+		__glcheck m_gl_state.cull_face(rsx::method_registers[NV4097_SET_CULL_FACE]);
 	}
 
-	__glcheck glFrontFace(rsx::method_registers[NV4097_SET_FRONT_FACE] ^ 1);
+	__glcheck m_gl_state.front_face(rsx::method_registers[NV4097_SET_FRONT_FACE] ^ 1);
 
-	__glcheck enable(rsx::method_registers[NV4097_SET_POLY_SMOOTH_ENABLE], GL_POLYGON_SMOOTH);
+	__glcheck m_gl_state.enable(rsx::method_registers[NV4097_SET_POLY_SMOOTH_ENABLE], GL_POLYGON_SMOOTH);
 
 	//NV4097_SET_COLOR_KEY_COLOR
 	//NV4097_SET_SHADER_CONTROL
@@ -254,18 +332,52 @@ void GLGSRender::begin()
 	//NV4097_SET_ANTI_ALIASING_CONTROL
 	//NV4097_SET_CLIP_ID_TEST_ENABLE
 
-	if (__glcheck enable(rsx::method_registers[NV4097_SET_RESTART_INDEX_ENABLE], GL_PRIMITIVE_RESTART))
+	if (__glcheck m_gl_state.enable(rsx::method_registers[NV4097_SET_RESTART_INDEX_ENABLE], GL_PRIMITIVE_RESTART))
 	{
-		__glcheck glPrimitiveRestartIndex(rsx::method_registers[NV4097_SET_RESTART_INDEX]);
+		__glcheck m_gl_state.primitive_restart_index(rsx::method_registers[NV4097_SET_RESTART_INDEX]);
 	}
 
-	if (__glcheck enable(rsx::method_registers[NV4097_SET_LINE_STIPPLE], GL_LINE_STIPPLE))
+	if (__glcheck m_gl_state.enable(rsx::method_registers[NV4097_SET_LINE_STIPPLE], GL_LINE_STIPPLE))
 	{
 		u32 line_stipple_pattern = rsx::method_registers[NV4097_SET_LINE_STIPPLE_PATTERN];
 		u16 factor = line_stipple_pattern;
 		u16 pattern = line_stipple_pattern >> 16;
-		__glcheck glLineStipple(factor, pattern);
+		__glcheck m_gl_state.line_stipple(factor, pattern);
+	}
+}
+
+u32 GLGSRender::get_dirty_state()
+{
+	u32 dirty = m_forced_dirty_state;
+	m_forced_dirty_state = 0;
+
+	if (m_applied_state_registers.empty())
+	{
+		for (const auto& range : state_registers)
+		{
+			m_applied_state_registers.resize(m_applied_state_registers.size() + range.count);
+		}
+
+		dirty = state_all;
+	}
+
+	size_t pos = 0;
+
+	for (const auto& range : state_registers)
+	{
+		for (u32 i = 0; i < range.count; i++, pos++)
+		{
+			const u32 value = rsx::method_registers[range.reg + i];
+
+			if (m_applied_state_registers[pos] != value)
+			{
+				m_applied_state_registers[pos] = value;
+				dirty |= range.group;
+			}
+		}
 	}
+
+	return dirty;
 }
 
 template<typename T, int count>
@@ -353,6 +465,8 @@ namespace
 
 void GLGSRender::end()
 {
+	_log::timeline_scope scope("rsx", "draw");
+
 	if (!draw_fbo)
 	{
 		rsx::thread::end();
@@ -364,7 +478,11 @@ void GLGSRender::end()
 	draw_fbo.bind();
 	m_program->use();
 
-	//setup textures
+	//setup textures, all units are bound at once if ARB_multi_bind is supported
+	const bool multi_bind = glBindTextures != nullptr;
+	std::array<GLuint, rsx::limits::textures_count> texture_ids = {};
+	int texture_count = 0;
+
 	for (int i = 0; i < rsx::limits::textures_count; ++i)
 	{
 		if (!textures[i].enabled())
@@ -375,17 +493,23 @@ void GLGSRender::end()
 		int location;
 		if (m_program->uniforms.has_location("tex" + std::to_string(i), &location))
 		{
-			__glcheck m_gl_textures[i].init(i, textures[i]);
+			// Render to texture: write back surfaces before the texture reads guest memory
+			flush_render_targets(rsx::get_address(textures[i].offset(), textures[i].location()), (u32)get_texture_size(textures[i]));
+
+			__glcheck texture_ids[i] = m_texture_cache.bind(i, textures[i], multi_bind);
+			texture_count = i + 1;
 			glProgramUniform1i(m_program->id(), location, i);
 		}
 	}
 
-	//initialize vertex attributes
+	if (multi_bind && texture_count)
+	{
+		__glcheck glBindTextures(0, texture_count, texture_ids.data());
+	}
 
-	//merge all vertex arrays
-	std::vector<u8> vertex_arrays_data;
-	u32 vertex_arrays_offsets[rsx::limits::vertex_count];
+	//initialize vertex attributes
 
+	//stream all vertex arrays through the vertex ring
 	const std::string reg_table[] =
 	{
 		"in_pos", "in_weight", "in_normal",
@@ -398,10 +522,19 @@ void GLGSRender::end()
 
 	u32 input_mask = rsx::method_registers[NV4097_SET_VERTEX_ATTRIB_INPUT_MASK];
 	m_vao.bind();
+	m_vertex_ring.bind();
+
+	if (m_use_geometry_cache)
+	{
+		for (GLuint buffer : m_geometry_cache.collect())
+		{
+			glDeleteBuffers(1, &buffer);
+		}
+	}
 
-	std::vector<u8> vertex_index_array;
+	u32 index_offset = 0;
 	vertex_draw_count = 0;
-	u32 min_index, max_index;
+	u32 min_index = 0, max_index = 0;
 	if (draw_command == Draw_command::draw_command_indexed)
 	{
 		Index_array_type type = to_index_array_type(rsx::method_registers[NV4097_SET_INDEX_ARRAY_DMA] >> 4);
@@ -411,23 +544,69 @@ void GLGSRender::end()
 			vertex_draw_count += first_count.second;
 		}
 
-		vertex_index_array.resize(vertex_draw_count * type_size);
+		const u32 index_address = rsx::get_address(rsx::method_registers[NV4097_SET_INDEX_ARRAY_ADDRESS], rsx::method_registers[NV4097_SET_INDEX_ARRAY_DMA] & 0xf);
+		const geometry_cache_t::key_t index_key{ index_address + first_count_commands.front().first * type_size, vertex_draw_count * type_size,
+			(u32)type | rsx::method_registers[NV4097_SET_RESTART_INDEX_ENABLE] << 8, rsx::method_registers[NV4097_SET_RESTART_INDEX], vertex_draw_count };
+		geometry_cache_t::entry_t cached;
 
-		switch (type)
+		if (m_use_geometry_cache && m_geometry_cache.find(index_key, cached))
 		{
-		case Index_array_type::unsigned_32b:
-			std::tie(min_index, max_index) = write_index_array_data_to_buffer_untouched(gsl::span<u32>((u32*)vertex_index_array.data(), vertex_draw_count), first_count_commands);
-			break;
-		case Index_array_type::unsigned_16b:
-			std::tie(min_index, max_index) = write_index_array_data_to_buffer_untouched(gsl::span<u16>((u16*)vertex_index_array.data(), vertex_draw_count), first_count_commands);
-			break;
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cached.buffer);
+			min_index = cached.min_index;
+			max_index = cached.max_index;
+		}
+		else
+		{
+			const bool cache = m_use_geometry_cache && m_geometry_cache.reserve(index_key);
+
+			auto mapping = m_index_ring.alloc_and_map(vertex_draw_count * type_size, type_size);
+			index_offset = mapping.second;
+
+			switch (type)
+			{
+			case Index_array_type::unsigned_32b:
+				std::tie(min_index, max_index) = write_index_array_data_to_buffer_untouched(gsl::span<u32>((u32*)mapping.first, vertex_draw_count), first_count_commands);
+				break;
+			case Index_array_type::unsigned_16b:
+				std::tie(min_index, max_index) = write_index_array_data_to_buffer_untouched(gsl::span<u16>((u16*)mapping.first, vertex_draw_count), first_count_commands);
+				break;
+			}
+
+			m_index_ring.unmap();
+
+			if (m_use_geometry_cache)
+			{
+				// the previous draw may have used a cached index buffer
+				m_vao.element_array_buffer = m_index_ring;
+			}
+
+			if (cache)
+			{
+				cache_geometry(index_key, m_index_ring, index_offset, vertex_draw_count * type_size, min_index, max_index);
+			}
 		}
 	}
 
-	if (draw_command == Draw_command::draw_command_inlined_array)
+	if (draw_command == Draw_command::draw_command_array)
 	{
-		write_inline_array_to_buffer(vertex_arrays_data.data());
-		u32 offset = 0;
+		for (const auto &first_count : first_count_commands)
+		{
+			vertex_draw_count += first_count.second;
+		}
+	}
+
+	if (m_gpu_vertex_fetch)
+	{
+		upload_vertex_fetch_data(min_index, max_index);
+	}
+
+	if (!m_gpu_vertex_fetch && draw_command == Draw_command::draw_command_inlined_array)
+	{
+		auto mapping = m_vertex_ring.alloc_and_map(inline_vertex_array.size() * sizeof(u32));
+		write_inline_array_to_buffer(mapping.first);
+		m_vertex_ring.unmap();
+
+		u32 offset = mapping.second;
 		for (int index = 0; index < rsx::limits::vertex_count; ++index)
 		{
 			auto &vertex_info = vertex_arrays_info[index];
@@ -446,15 +625,7 @@ void GLGSRender::end()
 		}
 	}
 
-	if (draw_command == Draw_command::draw_command_array)
-	{
-		for (const auto &first_count : first_count_commands)
-		{
-			vertex_draw_count += first_count.second;
-		}
-	}
-
-	if (draw_command == Draw_command::draw_command_array || draw_command == Draw_command::draw_command_indexed)
+	if (!m_gpu_vertex_fetch && (draw_command == Draw_command::draw_command_array || draw_command == Draw_command::draw_command_indexed))
 	{
 		for (int index = 0; index < rsx::limits::vertex_count; ++index)
 		{
@@ -470,35 +641,66 @@ void GLGSRender::end()
 			{
 				auto &vertex_info = vertex_arrays_info[index];
 				// Active vertex array
-				std::vector<u8> vertex_array;
-
-				// Fill vertex_array
 				u32 element_size = rsx::get_vertex_type_size_on_host(vertex_info.type, vertex_info.size);
-				vertex_array.resize(vertex_draw_count * element_size);
+				u32 vertex_count = draw_command == Draw_command::draw_command_indexed ? max_index + 1 : vertex_draw_count;
+
+				// Static arrays drawn as a single range are reused from the geometry cache
+				bool cache = false;
+				geometry_cache_t::key_t vertex_key{};
+
+				if (m_use_geometry_cache && (draw_command == Draw_command::draw_command_indexed || first_count_commands.size() == 1) && vertex_info.frequency <= 1)
+				{
+					const u32 offset = rsx::method_registers[NV4097_SET_VERTEX_DATA_ARRAY_OFFSET + index];
+					const u32 first = draw_command == Draw_command::draw_command_indexed ? 0 : first_count_commands.front().first;
+					const u32 address = rsx::get_address(offset & 0x7fffffff, offset >> 31) + rsx::method_registers[NV4097_SET_VERTEX_DATA_BASE_OFFSET] +
+						vertex_info.stride * (first + rsx::method_registers[NV4097_SET_VERTEX_DATA_BASE_INDEX]);
+
+					// elements are at most 16 bytes long
+					vertex_key = { address, (vertex_count - 1) * vertex_info.stride + 16, (u32)vertex_info.type | vertex_info.size << 8, vertex_info.stride, vertex_count };
+
+					geometry_cache_t::entry_t cached;
+
+					if (m_geometry_cache.find(vertex_key, cached))
+					{
+						glBindBuffer(GL_ARRAY_BUFFER, cached.buffer);
+
+						__glcheck m_program->attribs[location] =
+							(m_vao + 0)
+							.config(gl_types(vertex_info.type), vertex_info.size, gl_normalized(vertex_info.type));
+
+						m_vertex_ring.bind();
+						continue;
+					}
+
+					cache = m_geometry_cache.reserve(vertex_key);
+				}
+
+				auto mapping = m_vertex_ring.alloc_and_map(vertex_count * element_size);
+				u8 *dst = static_cast<u8*>(mapping.first);
+
 				if (draw_command == Draw_command::draw_command_array)
 				{
 					size_t offset = 0;
 					for (const auto &first_count : first_count_commands)
 					{
-						write_vertex_array_data_to_buffer(vertex_array.data() + offset, first_count.first, first_count.second, index, vertex_info);
+						write_vertex_array_data_to_buffer(dst + offset, first_count.first, first_count.second, index, vertex_info);
 						offset += first_count.second * element_size;
 					}
 				}
 				if (draw_command == Draw_command::draw_command_indexed)
 				{
-					vertex_array.resize((max_index + 1) * element_size);
-					write_vertex_array_data_to_buffer(vertex_array.data(), 0, max_index + 1, index, vertex_info);
+					write_vertex_array_data_to_buffer(dst, 0, max_index + 1, index, vertex_info);
 				}
 
-				size_t size = vertex_array.size();
-				size_t position = vertex_arrays_data.size();
-				vertex_arrays_offsets[index] = gsl::narrow<u32>(position);
-				vertex_arrays_data.resize(position + size);
+				m_vertex_ring.unmap();
 
-				memcpy(vertex_arrays_data.data() + position, vertex_array.data(), size);
+				if (cache)
+				{
+					cache_geometry(vertex_key, m_vertex_ring, mapping.second, vertex_count * element_size);
+				}
 
 				__glcheck m_program->attribs[location] =
-					(m_vao + vertex_arrays_offsets[index])
+					(m_vao + mapping.second)
 					.config(gl_types(vertex_info.type), vertex_info.size, gl_normalized(vertex_info.type));
 			}
 			else if (register_vertex_info[index].size > 0)
@@ -525,18 +727,31 @@ void GLGSRender::end()
 			}
 		}
 	}
-	m_vbo.data(vertex_arrays_data.size(), vertex_arrays_data.data());
 
 	if (draw_command == Draw_command::draw_command_indexed)
 	{
-		m_ebo.data(vertex_index_array.size(), vertex_index_array.data());
-
 		Index_array_type indexed_type = to_index_array_type(rsx::method_registers[NV4097_SET_INDEX_ARRAY_DMA] >> 4);
 
 		if (indexed_type == Index_array_type::unsigned_32b)
-			__glcheck glDrawElements(gl::draw_mode(draw_mode), vertex_draw_count, GL_UNSIGNED_INT, nullptr);
+			__glcheck glDrawElements(gl::draw_mode(draw_mode), vertex_draw_count, GL_UNSIGNED_INT, (const void*)(size_t)index_offset);
 		if (indexed_type == Index_array_type::unsigned_16b)
-			__glcheck glDrawElements(gl::draw_mode(draw_mode), vertex_draw_count, GL_UNSIGNED_SHORT, nullptr);
+			__glcheck glDrawElements(gl::draw_mode(draw_mode), vertex_draw_count, GL_UNSIGNED_SHORT, (const void*)(size_t)index_offset);
+	}
+	else if (first_count_commands.size() > 1)
+	{
+		// Ranges are stored one after the other, draw them separately so strips aren't joined
+		std::vector<GLint> firsts;
+		std::vector<GLsizei> counts;
+		GLint first = 0;
+
+		for (const auto &first_count : first_count_commands)
+		{
+			firsts.push_back(first);
+			counts.push_back(first_count.second);
+			first += first_count.second;
+		}
+
+		__glcheck glMultiDrawArrays(gl::draw_mode(draw_mode), firsts.data(), counts.data(), (GLsizei)firsts.size());
 	}
 	else
 	{
@@ -548,6 +763,206 @@ void GLGSRender::end()
 	rsx::thread::end();
 }
 
+namespace
+{
+	u32 get_vertex_type_size_in_memory(Vertex_base_type type, u32 size)
+	{
+		switch (type)
+		{
+		case Vertex_base_type::s1:
+		case Vertex_base_type::sf: return sizeof(u16) * size;
+		case Vertex_base_type::f:
+		case Vertex_base_type::s32k: return sizeof(u32) * size;
+		case Vertex_base_type::ub:
+		case Vertex_base_type::ub256: return sizeof(u8) * size;
+		case Vertex_base_type::cmp: return sizeof(u32);
+		}
+		throw EXCEPTION("unknow vertex type");
+	}
+}
+
+void GLGSRender::cache_geometry(const geometry_cache_t::key_t &key, const gl::ring_buffer &ring, u32 offset, u32 size, u32 min_index, u32 max_index)
+{
+	geometry_cache_t::entry_t entry;
+	entry.min_index = min_index;
+	entry.max_index = max_index;
+
+	// GPU side copy, the ring data is still valid for this draw
+	glGenBuffers(1, &entry.buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, entry.buffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_READ_BUFFER, ring.id());
+	__glcheck glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offset, 0, size);
+
+	if (!m_geometry_cache.publish(key, entry))
+	{
+		// written by the guest meanwhile
+		glDeleteBuffers(1, &entry.buffer);
+	}
+}
+
+void GLGSRender::upload_vertex_fetch_data(u32 min_index, u32 max_index)
+{
+	// x: byte offset in the fetch buffer, y: stride, z: Vertex_base_type, w: component count (0 reads the register value)
+	std::array<s32, 4 * rsx::limits::vertex_count> descriptors = {};
+	std::array<f32, 4 * rsx::limits::vertex_count> registers;
+
+	for (int index = 0; index < rsx::limits::vertex_count; ++index)
+	{
+		registers[index * 4 + 0] = 0.f;
+		registers[index * 4 + 1] = 0.f;
+		registers[index * 4 + 2] = 0.f;
+		registers[index * 4 + 3] = 1.f;
+	}
+
+	if (draw_command == Draw_command::draw_command_inlined_array)
+	{
+		// Interleaved in host layout, components are swapped back to big endian
+		u32 stride = 0;
+		for (const auto &info : vertex_arrays_info)
+		{
+			if (info.size)
+				stride += rsx::get_vertex_type_size_on_host(info.type, info.size);
+		}
+
+		const u32 data_size = (u32)inline_vertex_array.size() * sizeof(u32);
+		auto mapping = m_vertex_fetch_ring.alloc_and_map(std::max<u32>(data_size, 4), 4);
+		const u8 *src = reinterpret_cast<const u8*>(inline_vertex_array.data());
+		u8 *dst = static_cast<u8*>(mapping.first);
+
+		u32 offset = 0;
+		for (int index = 0; index < rsx::limits::vertex_count; ++index)
+		{
+			const auto &info = vertex_arrays_info[index];
+
+			if (!info.size) // disabled
+				continue;
+
+			descriptors[index * 4 + 0] = mapping.second + offset;
+			descriptors[index * 4 + 1] = stride;
+			descriptors[index * 4 + 2] = (s32)info.type;
+			descriptors[index * 4 + 3] = info.size;
+
+			const u32 element_size = rsx::get_vertex_type_size_on_host(info.type, info.size);
+
+			for (u32 vertex = offset; vertex + element_size <= data_size; vertex += stride)
+			{
+				switch (info.type)
+				{
+				case Vertex_base_type::s1:
+				case Vertex_base_type::sf:
+					for (u32 i = 0; i < element_size; i += 2)
+						*(be_t<u16>*)(dst + vertex + i) = *(const u16*)(src + vertex + i);
+					break;
+				case Vertex_base_type::f:
+				case Vertex_base_type::s32k:
+				case Vertex_base_type::cmp:
+					for (u32 i = 0; i < element_size; i += 4)
+						*(be_t<u32>*)(dst + vertex + i) = *(const u32*)(src + vertex + i);
+					break;
+				default:
+					// ub4 is swapped by the CPU path so components come out in memory order here
+					if (info.type == Vertex_base_type::ub && info.size == 4)
+						*(be_t<u32>*)(dst + vertex) = *(const u32*)(src + vertex);
+					else
+						memcpy(dst + vertex, src + vertex, element_size);
+					break;
+				}
+			}
+
+			offset += element_size;
+		}
+
+		m_vertex_fetch_ring.unmap();
+	}
+	else
+	{
+		const u32 input_mask = rsx::method_registers[NV4097_SET_VERTEX_ATTRIB_INPUT_MASK];
+		const u32 base_offset = rsx::method_registers[NV4097_SET_VERTEX_DATA_BASE_OFFSET];
+		const u32 base_index = rsx::method_registers[NV4097_SET_VERTEX_DATA_BASE_INDEX];
+
+		for (int index = 0; index < rsx::limits::vertex_count; ++index)
+		{
+			if (!(input_mask & (1 << index)))
+				continue;
+
+			if (vertex_arrays_info[index].size > 0)
+			{
+				const auto &info = vertex_arrays_info[index];
+				const u32 offset = rsx::method_registers[NV4097_SET_VERTEX_DATA_ARRAY_OFFSET + index];
+				const u32 address = rsx::get_address(offset & 0x7fffffff, offset >> 31) + base_offset;
+				const u32 data_size = get_vertex_type_size_in_memory(info.type, info.size);
+				const u32 stride = info.stride;
+
+				if (info.frequency > 1)
+					LOG_ERROR(RSX, "%s: frequency is not null (%d, index=%d)", __FUNCTION__, info.frequency, index);
+
+				// Only the vertices referenced by the draw are copied, a single memcpy per range
+				if (draw_command == Draw_command::draw_command_indexed)
+				{
+					auto mapping = m_vertex_fetch_ring.alloc_and_map(stride * (max_index - min_index) + data_size, 4);
+					memcpy(mapping.first, vm::base(address + stride * (base_index + min_index)), stride * (max_index - min_index) + data_size);
+					m_vertex_fetch_ring.unmap();
+
+					descriptors[index * 4 + 0] = (s32)mapping.second - (s32)(stride * min_index);
+				}
+				else
+				{
+					auto mapping = m_vertex_fetch_ring.alloc_and_map(stride * std::max(vertex_draw_count, 1u) + data_size, 4);
+					u8 *dst = static_cast<u8*>(mapping.first);
+
+					u32 vertex = 0;
+					for (const auto &first_count : first_count_commands)
+					{
+						if (!first_count.second)
+							continue;
+
+						memcpy(dst + stride * vertex, vm::base(address + stride * (first_count.first + base_index)), stride * (first_count.second - 1) + data_size);
+						vertex += first_count.second;
+					}
+
+					m_vertex_fetch_ring.unmap();
+
+					descriptors[index * 4 + 0] = mapping.second;
+				}
+
+				descriptors[index * 4 + 1] = stride;
+				descriptors[index * 4 + 2] = (s32)info.type;
+				descriptors[index * 4 + 3] = info.size;
+			}
+			else if (register_vertex_info[index].size > 0)
+			{
+				const auto &vertex_data = register_vertex_data[index];
+				const auto &vertex_info = register_vertex_info[index];
+
+				if (vertex_info.type != Vertex_base_type::f)
+				{
+					LOG_ERROR(RSX, "bad non array vertex data format (type = %d, size = %d)", vertex_info.type, vertex_info.size);
+					continue;
+				}
+
+				// Last value wins, like successive glVertexAttrib calls
+				const size_t vector_size = vertex_info.size * sizeof(f32);
+				if (vertex_data.size() >= vector_size)
+				{
+					memcpy(&registers[index * 4], vertex_data.data() + vertex_data.size() / vector_size * vector_size - vector_size, vector_size);
+				}
+			}
+		}
+	}
+
+	int location;
+	if (m_program->uniforms.has_location("input_desc", &location))
+		glProgramUniform4iv(m_program->id(), location, rsx::limits::vertex_count, descriptors.data());
+
+	if (m_program->uniforms.has_location("input_register", &location))
+		glProgramUniform4fv(m_program->id(), location, rsx::limits::vertex_count, registers.data());
+
+	glActiveTexture(GL_TEXTURE0 + gl::vertex_fetch_texture_unit);
+	m_vertex_fetch_texture.bind();
+	glActiveTexture(GL_TEXTURE0);
+}
+
 void GLGSRender::set_viewport()
 {
 	u32 viewport_horizontal = rsx::method_registers[NV4097_SET_VIEWPORT_HORIZONTAL];
@@ -569,21 +984,24 @@ void GLGSRender::set_viewport()
 
 	u8 shader_window_origin = (shader_window >> 12) & 0xf;
 
+	// Render targets are allocated at the internal resolution
+	const auto scale = &gl_render_target_traits::scale;
+
 	//TODO
 	if (true || shader_window_origin == CELL_GCM_WINDOW_ORIGIN_BOTTOM)
 	{
-		__glcheck glViewport(viewport_x, viewport_y, viewport_w, viewport_h);
-		__glcheck glScissor(scissor_x, scissor_y, scissor_w, scissor_h);
+		__glcheck m_gl_state.viewport(scale(viewport_x), scale(viewport_y), scale(viewport_w), scale(viewport_h));
+		__glcheck m_gl_state.scissor(scale(scissor_x), scale(scissor_y), scale(scissor_w), scale(scissor_h));
 	}
 	else
 	{
 		u16 shader_window_height = shader_window & 0xfff;
 
-		__glcheck glViewport(viewport_x, shader_window_height - viewport_y - viewport_h - 1, viewport_w, viewport_h);
-		__glcheck glScissor(scissor_x, shader_window_height - scissor_y - scissor_h - 1, scissor_w, scissor_h);
+		__glcheck m_gl_state.viewport(scale(viewport_x), scale(shader_window_height - viewport_y - viewport_h - 1), scale(viewport_w), scale(viewport_h));
+		__glcheck m_gl_state.scissor(scale(scissor_x), scale(shader_window_height - scissor_y - scissor_h - 1), scale(scissor_w), scale(scissor_h));
 	}
 
-	glEnable(GL_SCISSOR_TEST);
+	m_gl_state.enable(1, GL_SCISSOR_TEST);
 }
 
 void GLGSRender::on_init_thread()
@@ -591,65 +1009,220 @@ void GLGSRender::on_init_thread()
 	GSRender::on_init_thread();
 
 	gl::init();
+
+	m_readback_pool.start(rpcs3::state.config.rsx.upload_threads.value(), "GL Readback");
+
+	gl_render_target_traits::resolution_scale = std::min(std::max(rpcs3::state.config.rsx.resolution_scale.value(), 50u), 400u);
+
+	if (gl_render_target_traits::resolution_scale != 100)
+	{
+		LOG_NOTICE(RSX, "Rendering at %d%% of the guest resolution", gl_render_target_traits::resolution_scale);
+	}
+
+	if (rpcs3::state.config.rsx.present_thread.value())
+	{
+		m_present_context = m_frame->new_shared_context(m_context);
+
+		if (m_present_context)
+		{
+			m_present_thread.start(rpcs3::state.config.rsx.present_queue_size.value(), rpcs3::state.config.rsx.low_latency_present.value(), [this]()
+			{
+				m_frame->set_current(m_present_context);
+				m_present_read_fbo.create();
+			},
+			[this]()
+			{
+				m_present_read_fbo.remove();
+			});
+
+			m_present_textures.resize(m_present_thread.slot_count());
+			m_present_syncs.resize(m_present_thread.slot_count());
+		}
+		else
+		{
+			LOG_WARNING(RSX, "Present thread: shared contexts are not supported, presenting on the RSX thread");
+		}
+	}
+
 	LOG_NOTICE(RSX, "%s", (const char*)glGetString(GL_VERSION));
 	LOG_NOTICE(RSX, "%s", (const char*)glGetString(GL_SHADING_LANGUAGE_VERSION));
 	LOG_NOTICE(RSX, "%s", (const char*)glGetString(GL_VENDOR));
 
 	glEnable(GL_VERTEX_PROGRAM_POINT_SIZE);
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &m_uniform_buffer_offset_align);
+
+	if (!gl::ring_buffer::is_persistent_mapping_supported())
+	{
+		LOG_WARNING(RSX, "ARB_buffer_storage is not supported, streaming buffers are mapped per draw");
+	}
+
 	m_vao.create();
-	m_vbo.create();
-	m_ebo.create();
-	m_scale_offset_buffer.create(16 * sizeof(float));
-	m_vertex_constants_buffer.create(512 * 4 * sizeof(float));
-	m_fragment_constants_buffer.create();
-
-	glBindBufferBase(GL_UNIFORM_BUFFER, 0, m_scale_offset_buffer.id());
-	glBindBufferBase(GL_UNIFORM_BUFFER, 1, m_vertex_constants_buffer.id());
-	glBindBufferBase(GL_UNIFORM_BUFFER, 2, m_fragment_constants_buffer.id());
-
-	m_vao.array_buffer = m_vbo;
-	m_vao.element_array_buffer = m_ebo;
+	m_vertex_ring.create(gl::buffer::target::array, 64 * 0x100000);
+	m_index_ring.create(gl::buffer::target::element_array, 16 * 0x100000);
+	m_uniform_ring.create(gl::buffer::target::uniform, 16 * 0x100000);
+	m_transform_constants_buffer.create(sizeof(transform_constants), transform_constants);
+	consume_transform_constants_dirty_range();
+
+	m_vao.array_buffer = m_vertex_ring;
+	m_vao.element_array_buffer = m_index_ring;
+
+	m_gpu_vertex_fetch = rpcs3::state.config.rsx.opengl.gpu_vertex_fetch.value();
+	m_use_geometry_cache = rpcs3::state.config.rsx.geometry_cache.value() && !m_gpu_vertex_fetch;
+
+	if (m_gpu_vertex_fetch)
+	{
+		GLint max_texels = 0;
+		glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &max_texels);
+
+		m_vertex_fetch_ring.create(gl::buffer::target::texture, std::min<GLsizeiptr>(64 * 0x100000, ((GLsizeiptr)max_texels * 4) & ~0xfff));
+		m_vertex_fetch_texture.create(gl::texture::target::textureBuffer);
+		m_vertex_fetch_texture.bind();
+		__glcheck glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, m_vertex_fetch_ring.id());
+	}
+
+	if (rpcs3::state.config.rsx.opengl.gpu_texture_decoding.value())
+	{
+		if (rsx::gl::texture_decoder::is_supported())
+		{
+			m_texture_decoder.create();
+			m_texture_cache.set_decoder(&m_texture_decoder);
+		}
+		else
+		{
+			LOG_WARNING(RSX, "Compute shaders are not supported, textures are decoded on the CPU");
+		}
+	}
+
+	if (rpcs3::state.config.rsx.shader_binary_cache.value())
+	{
+		if (gl::glsl::program::binaries_supported())
+		{
+			const std::string &driver_id = fmt::format("%s|%s|%s", (const char*)glGetString(GL_VENDOR), (const char*)glGetString(GL_RENDERER), (const char*)glGetString(GL_VERSION));
+			m_program_binaries.open(rsx::shaders_cache::path_to_shader_binary_cache("glsl"), driver_id);
+		}
+		else
+		{
+			LOG_WARNING(RSX, "Program binaries are not supported, shader binary cache disabled");
+		}
+	}
+
+	if (rpcs3::state.config.rsx.pipeline_cache.value())
+		m_prog_buffer.load_pipeline_cache(rsx::shaders_cache::path_to_pipeline_cache("glsl"), &m_program_binaries);
+
+	gfxHandler = [this](u32 addr)
+	{
+		// Both caches may protect the same pages
+		const bool surface_handled = on_access_violation(addr);
+		const bool texture_handled = m_texture_cache.invalidate_address(addr);
+		const bool geometry_handled = m_geometry_cache.invalidate_address(addr);
+		const bool report_handled = on_report_access(addr);
+
+		return surface_handled || texture_handled || geometry_handled || report_handled;
+	};
 }
 
 void GLGSRender::on_exit()
 {
+	gfxHandler = [](u32) { return false; };
+
+	m_readback_pool.stop();
+
+	m_texture_cache.clear();
+	m_texture_cache.set_decoder(nullptr);
+
+	for (GLuint buffer : m_geometry_cache.clear())
+	{
+		glDeleteBuffers(1, &buffer);
+	}
+	m_texture_decoder.remove();
+	m_rtts.clear();
+	m_unscaled_color.reset();
+	m_unscaled_depth.reset();
+	m_expanded_color.reset();
+
+	if (m_scale_src_fbo)
+	{
+		m_scale_src_fbo.remove();
+		m_scale_dst_fbo.remove();
+	}
+
+	if (!m_occlusion_queries.empty())
+	{
+		glDeleteQueries((GLsizei)m_occlusion_queries.size(), m_occlusion_queries.data());
+		m_occlusion_queries.clear();
+		m_free_occlusion_queries.clear();
+	}
+
+	if (!m_timer_queries.empty())
+	{
+		glDeleteQueries((GLsizei)m_timer_queries.size(), m_timer_queries.data());
+		m_timer_queries.clear();
+		m_free_timer_queries.clear();
+	}
+
 	glDisable(GL_VERTEX_PROGRAM_POINT_SIZE);
 
+	LOG_NOTICE(RSX, "GL state cache: %llu redundant calls elided", m_gl_state.elided_calls);
+
+	if (m_present_thread)
+	{
+		m_present_thread.stop();
+
+		LOG_NOTICE(RSX, "Present thread: %llu frames presented, %llu dropped", m_present_thread.presented, m_present_thread.dropped);
+	}
+
+	for (auto &sync : m_present_syncs)
+	{
+		if (sync)
+			glDeleteSync(sync);
+	}
+
+	m_present_syncs.clear();
+	m_present_textures.clear();
+	m_present_context = nullptr;
+
+	if (m_present_fbo)
+		m_present_fbo.remove();
+
 	//if (m_program)
 	//	m_program.remove();
 
 	if (draw_fbo)
 		draw_fbo.remove();
 
-	for (auto &tex : m_draw_tex_color)
-		if (tex) tex.remove();
-
-	if (m_draw_tex_depth_stencil)
-		m_draw_tex_depth_stencil.remove();
-
 	if (m_flip_fbo)
 		m_flip_fbo.remove();
 
+	if (m_flip_source_fbo)
+		m_flip_source_fbo.remove();
+
 	if (m_flip_tex_color)
 		m_flip_tex_color.remove();
 
-	if (m_vbo)
-		m_vbo.remove();
+	if (m_vertex_ring)
+		m_vertex_ring.remove();
 
-	if (m_ebo)
-		m_ebo.remove();
+	if (m_index_ring)
+		m_index_ring.remove();
 
-	if (m_vao)
-		m_vao.remove();
+	if (m_uniform_ring)
+		m_uniform_ring.remove();
 
-	if (m_scale_offset_buffer)
-		m_scale_offset_buffer.remove();
+	m_fragment_constants.clear();
 
-	if (m_vertex_constants_buffer)
-		m_vertex_constants_buffer.remove();
+	LOG_NOTICE(RSX, "GL uniform ring: %llu unchanged constant block uploads skipped", m_uniform_uploads_skipped);
 
-	if (m_fragment_constants_buffer)
-		m_fragment_constants_buffer.remove();
+	if (m_transform_constants_buffer)
+		m_transform_constants_buffer.remove();
+
+	if (m_vertex_fetch_ring)
+		m_vertex_fetch_ring.remove();
+
+	if (m_vertex_fetch_texture)
+		m_vertex_fetch_texture.remove();
+
+	if (m_vao)
+		m_vao.remove();
 }
 
 void nv4097_clear_surface(u32 arg, GLGSRender* renderer)
@@ -682,7 +1255,7 @@ void nv4097_clear_surface(u32 arg, GLGSRender* renderer)
 
 		u32 clear_depth = rsx::method_registers[NV4097_SET_ZSTENCIL_CLEAR_VALUE] >> 8;
 
-		glDepthMask(GL_TRUE);
+		renderer->m_gl_state.depth_mask(GL_TRUE);
 		glClearDepth(double(clear_depth) / max_depth_value);
 		mask |= GLenum(gl::buffers::depth);
 	}
@@ -691,7 +1264,7 @@ void nv4097_clear_surface(u32 arg, GLGSRender* renderer)
 	{
 		u8 clear_stencil = rsx::method_registers[NV4097_SET_ZSTENCIL_CLEAR_VALUE] & 0xff;
 
-		__glcheck glStencilMask(rsx::method_registers[NV4097_SET_STENCIL_MASK]);
+		__glcheck renderer->m_gl_state.stencil_mask(rsx::method_registers[NV4097_SET_STENCIL_MASK]);
 		glClearStencil(clear_stencil);
 
 		mask |= GLenum(gl::buffers::stencil);
@@ -705,13 +1278,17 @@ void nv4097_clear_surface(u32 arg, GLGSRender* renderer)
 		u8 clear_g = clear_color >> 8;
 		u8 clear_b = clear_color;
 
-		glColorMask(((arg & 0x20) ? 1 : 0), ((arg & 0x40) ? 1 : 0), ((arg & 0x80) ? 1 : 0), ((arg & 0x10) ? 1 : 0));
+		renderer->m_gl_state.color_mask(((arg & 0x20) ? 1 : 0), ((arg & 0x40) ? 1 : 0), ((arg & 0x80) ? 1 : 0), ((arg & 0x10) ? 1 : 0));
 		glClearColor(clear_r / 255.f, clear_g / 255.f, clear_b / 255.f, clear_a / 255.f);
 
 		mask |= GLenum(gl::buffers::color);
 	}
 
 	glClear(mask);
+
+	// The clear masks differ from the draw masks, reapply them on the next draw
+	renderer->m_forced_dirty_state |= state_masks;
+
 	renderer->write_buffers();
 }
 
@@ -738,6 +1315,12 @@ bool GLGSRender::do_method(u32 cmd, u32 arg)
 bool GLGSRender::load_program()
 {
 #if 1
+	if (programs_dirty)
+	{
+		m_prog_buffer.invalidate_last_programs();
+		programs_dirty = false;
+	}
+
 	RSXVertexProgram vertex_program;
 	u32 transform_program_start = rsx::method_registers[NV4097_SET_TRANSFORM_PROGRAM_START];
 	vertex_program.data.reserve((512 - transform_program_start) * 4);
@@ -770,7 +1353,7 @@ bool GLGSRender::load_program()
 			fragment_program.texture_dimensions.push_back(texture_dimension::texture_dimension_2d);
 	}
 
-	__glcheck m_program = &m_prog_buffer.getGraphicPipelineState(vertex_program, fragment_program, nullptr);
+	__glcheck m_program = &m_prog_buffer.getGraphicPipelineState(vertex_program, fragment_program, nullptr, &m_program_binaries);
 	__glcheck m_program->use();
 
 #else
@@ -810,102 +1393,101 @@ bool GLGSRender::load_program()
 
 	(m_program.recreate() += { fp.compile(), vp.compile() }).make();
 #endif
-	glBindBuffer(GL_UNIFORM_BUFFER, m_scale_offset_buffer.id());
+	alignas(16) f32 scale_offset[16];
+	fill_scale_offset_data(scale_offset, false);
 
-	void *buffer = glMapBuffer(GL_UNIFORM_BUFFER, GL_WRITE_ONLY);
-	fill_scale_offset_data(buffer, false);
-	glUnmapBuffer(GL_UNIFORM_BUFFER);
+	if (m_scale_offset_range.serial == 0 || std::memcmp(m_scale_offset_data, scale_offset, sizeof(scale_offset)))
+	{
+		std::memcpy(m_scale_offset_data, scale_offset, sizeof(scale_offset));
+		m_scale_offset_range.serial = 0;
+	}
 
-	glBindBuffer(GL_UNIFORM_BUFFER, m_vertex_constants_buffer.id());
-	buffer = glMapBuffer(GL_UNIFORM_BUFFER, GL_WRITE_ONLY);
-	fill_vertex_program_constants_data(buffer);
-	glUnmapBuffer(GL_UNIFORM_BUFFER);
+	const size_t buffer_size = std::max<size_t>(m_prog_buffer.get_fragment_constants_buffer_size(fragment_program), 16);
+	const u64 fragment_constants_hash = m_prog_buffer.get_fragment_constants_hash(fragment_program);
+	auto &fragment_constants = m_fragment_constants[fragment_program.addr];
 
-	glBindBuffer(GL_UNIFORM_BUFFER, m_fragment_constants_buffer.id());
-	size_t buffer_size = m_prog_buffer.get_fragment_constants_buffer_size(fragment_program);
-	glBufferData(GL_UNIFORM_BUFFER, buffer_size, nullptr, GL_STATIC_DRAW);
-	buffer = glMapBuffer(GL_UNIFORM_BUFFER, GL_WRITE_ONLY);
-	m_prog_buffer.fill_fragment_constans_buffer({ static_cast<float*>(buffer), gsl::narrow<int>(buffer_size) }, fragment_program);
-	glUnmapBuffer(GL_UNIFORM_BUFFER);
+	if (fragment_constants.data.size() * sizeof(f32) != buffer_size || fragment_constants.hash != fragment_constants_hash)
+	{
+		fragment_constants.data.resize(buffer_size / sizeof(f32));
+		m_prog_buffer.fill_fragment_constans_buffer({ fragment_constants.data.data(), gsl::narrow<int>(fragment_constants.data.size()) }, fragment_program);
+		fragment_constants.hash = fragment_constants_hash;
+		fragment_constants.range.serial = 0;
+	}
 
-	return true;
-}
+	// A block is reused as long as the ring stays in the segment it was written to;
+	// an upload can move the ring to the next segment, so check both blocks again after it
+	while (m_scale_offset_range.serial != m_uniform_ring.serial() || fragment_constants.range.serial != m_uniform_ring.serial())
+	{
+		upload_uniform_block(m_scale_offset_range, m_scale_offset_data, sizeof(m_scale_offset_data));
+		upload_uniform_block(fragment_constants.range, fragment_constants.data.data(), buffer_size);
+	}
 
-struct color_swizzle
-{
-	gl::texture::channel a = gl::texture::channel::a;
-	gl::texture::channel r = gl::texture::channel::r;
-	gl::texture::channel g = gl::texture::channel::g;
-	gl::texture::channel b = gl::texture::channel::b;
+	bind_uniform_block(0, m_scale_offset_range);
 
-	color_swizzle() = default;
-	color_swizzle(gl::texture::channel a, gl::texture::channel r, gl::texture::channel g, gl::texture::channel b)
-		: a(a), r(r), g(g), b(b)
+	const auto dirty_constants = consume_transform_constants_dirty_range();
+	if (dirty_constants.second)
 	{
+		__glcheck m_transform_constants_buffer.sub_data(dirty_constants.first * sizeof(color4f), dirty_constants.second * sizeof(color4f), transform_constants + dirty_constants.first);
 	}
-};
+	glBindBufferBase(GL_UNIFORM_BUFFER, 1, m_transform_constants_buffer.id());
 
-struct color_format
-{
-	gl::texture::type type;
-	gl::texture::format format;
-	bool swap_bytes;
-	int channel_count;
-	int channel_size;
-	color_swizzle swizzle;
-};
+	bind_uniform_block(2, fragment_constants.range);
+
+	return true;
+}
 
-color_format surface_color_format_to_gl(Surface_color_format color_format)
+void GLGSRender::upload_uniform_block(uniform_range &range, const void *data, u32 size)
 {
-	//color format
-	switch (color_format)
-	{
-	case Surface_color_format::r5g6b5:
-		return{ gl::texture::type::ushort_5_6_5, gl::texture::format::bgr, false, 3, 2 };
-
-	case Surface_color_format::a8r8g8b8:
-		return{ gl::texture::type::uint_8_8_8_8, gl::texture::format::bgra, false, 4, 1 };
-
-	case Surface_color_format::x8r8g8b8_o8r8g8b8:
-		return{ gl::texture::type::uint_8_8_8_8, gl::texture::format::bgra, false, 4, 1,
-		{ gl::texture::channel::one, gl::texture::channel::r, gl::texture::channel::g, gl::texture::channel::b } };
-
-	case Surface_color_format::w16z16y16x16:
-		return{ gl::texture::type::f16, gl::texture::format::rgba, true, 4, 2 };
-
-	case Surface_color_format::w32z32y32x32:
-		return{ gl::texture::type::f32, gl::texture::format::rgba, true, 4, 4 };
-
-	case Surface_color_format::b8:
-	case Surface_color_format::x1r5g5b5_o1r5g5b5:
-	case Surface_color_format::x1r5g5b5_z1r5g5b5:
-	case Surface_color_format::x8r8g8b8_z8r8g8b8:
-	case Surface_color_format::g8b8:
-	case Surface_color_format::x32:
-	case Surface_color_format::x8b8g8r8_o8b8g8r8:
-	case Surface_color_format::x8b8g8r8_z8b8g8r8:
-	case Surface_color_format::a8b8g8r8:
-	default:
-		LOG_ERROR(RSX, "Surface color buffer: Unsupported surface color format (0x%x)", color_format);
-		return{ gl::texture::type::uint_8_8_8_8, gl::texture::format::bgra, false, 4, 1 };
+	if (range.serial == m_uniform_ring.serial())
+	{
+		m_uniform_uploads_skipped++;
+		return;
 	}
+
+	auto mapping = m_uniform_ring.alloc_and_map(size, m_uniform_buffer_offset_align);
+	std::memcpy(mapping.first, data, size);
+	m_uniform_ring.unmap();
+
+	range.offset = mapping.second;
+	range.size = size;
+	range.serial = m_uniform_ring.serial();
 }
 
-std::pair<gl::texture::type, gl::texture::format> surface_depth_format_to_gl(Surface_depth_format depth_format)
+void GLGSRender::bind_uniform_block(u32 index, const uniform_range &range)
 {
-	switch (depth_format)
-	{
-	case Surface_depth_format::z16:
-		return std::make_pair(gl::texture::type::ushort, gl::texture::format::depth);
+	auto &bound = m_bound_uniform_ranges[index];
 
-	default:
-		LOG_ERROR(RSX, "Surface depth buffer: Unsupported surface depth format (0x%x)", depth_format);
-	case Surface_depth_format::z24s8:
-		return std::make_pair(gl::texture::type::uint_24_8, gl::texture::format::depth_stencil);
-		//return std::make_pair(gl::texture::type::f32, gl::texture::format::depth);
+	if (bound.offset != range.offset || bound.size != range.size || bound.serial != range.serial)
+	{
+		m_uniform_ring.bind_range(index, range.offset, range.size);
+		bound = range;
 	}
 }
 
+static const u32 mr_color_offset[rsx::limits::color_buffers_count] =
+{
+	NV4097_SET_SURFACE_COLOR_AOFFSET,
+	NV4097_SET_SURFACE_COLOR_BOFFSET,
+	NV4097_SET_SURFACE_COLOR_COFFSET,
+	NV4097_SET_SURFACE_COLOR_DOFFSET
+};
+
+static const u32 mr_color_dma[rsx::limits::color_buffers_count] =
+{
+	NV4097_SET_CONTEXT_DMA_COLOR_A,
+	NV4097_SET_CONTEXT_DMA_COLOR_B,
+	NV4097_SET_CONTEXT_DMA_COLOR_C,
+	NV4097_SET_CONTEXT_DMA_COLOR_D
+};
+
+static const u32 mr_color_pitch[rsx::limits::color_buffers_count] =
+{
+	NV4097_SET_SURFACE_PITCH_A,
+	NV4097_SET_SURFACE_PITCH_B,
+	NV4097_SET_SURFACE_PITCH_C,
+	NV4097_SET_SURFACE_PITCH_D
+};
+
 void GLGSRender::init_buffers(bool skip_reading)
 {
 	u32 surface_format = rsx::method_registers[NV4097_SET_SURFACE_FORMAT];
@@ -913,78 +1495,116 @@ void GLGSRender::init_buffers(bool skip_reading)
 	u32 clip_horizontal = rsx::method_registers[NV4097_SET_SURFACE_CLIP_HORIZONTAL];
 	u32 clip_vertical = rsx::method_registers[NV4097_SET_SURFACE_CLIP_VERTICAL];
 
-	u32 clip_width = clip_horizontal >> 16;
-	u32 clip_height = clip_vertical >> 16;
-	u32 clip_x = clip_horizontal;
-	u32 clip_y = clip_vertical;
+	m_surface.unpack(surface_format);
+	m_surface.width = clip_horizontal >> 16;
+	m_surface.height = clip_vertical >> 16;
+
+	if (!draw_fbo)
+	{
+		draw_fbo.create();
+	}
+
+	std::array<u32, 4> color_addresses = {};
 
-	if (!draw_fbo || m_surface.format != surface_format)
+	for (int i = 0; i < rsx::limits::color_buffers_count; ++i)
 	{
-		m_surface.unpack(surface_format);
-		m_surface.width = clip_width;
-		m_surface.height = clip_height;
+		if (rsx::method_registers[mr_color_pitch[i]] > 64)
+		{
+			color_addresses[i] = rsx::get_address(rsx::method_registers[mr_color_offset[i]], rsx::method_registers[mr_color_dma[i]]);
+		}
+	}
 
-		LOG_WARNING(RSX, "surface: %dx%d", clip_width, clip_height);
+	u32 depth_address = 0;
+
+	if (rsx::method_registers[NV4097_SET_SURFACE_PITCH_Z] > 64)
+	{
+		depth_address = rsx::get_address(rsx::method_registers[NV4097_SET_SURFACE_ZETA_OFFSET], rsx::method_registers[NV4097_SET_CONTEXT_DMA_ZETA]);
+	}
 
-		draw_fbo.recreate();
-		m_draw_tex_depth_stencil.recreate(gl::texture::target::texture2D);
+	std::lock_guard<std::recursive_mutex> lock(m_rtts.mutex);
 
-		auto format = surface_color_format_to_gl(m_surface.color_format);
+	m_rtts.prepare_render_target(nullptr, surface_format, clip_horizontal, clip_vertical,
+		to_surface_target(rsx::method_registers[NV4097_SET_SURFACE_COLOR_TARGET]), color_addresses, depth_address);
 
-		for (int i = 0; i < rsx::limits::color_buffers_count; ++i)
+	// Surfaces replaced by another format or size at the same address
+	for (auto &surface : m_rtts.invalidated_resources)
+	{
+		if (surface->is_dirty)
 		{
-			m_draw_tex_color[i].recreate(gl::texture::target::texture2D);
-			__glcheck m_draw_tex_color[i].config()
-				.size({ (int)m_surface.width, (int)m_surface.height })
-				.type(format.type)
-				.format(format.format)
-				.swizzle(format.swizzle.r, format.swizzle.g, format.swizzle.b, format.swizzle.a);
+			download_render_target(*surface);
+		}
+
+		m_rtts.protect(*surface, 0);
+	}
 
-			__glcheck m_draw_tex_color[i].pixel_pack_settings().swap_bytes(format.swap_bytes).aligment(1);
-			__glcheck m_draw_tex_color[i].pixel_unpack_settings().swap_bytes(format.swap_bytes).aligment(1);
+	m_rtts.invalidated_resources.clear();
 
-			__glcheck draw_fbo.color[i] = m_draw_tex_color[i];
-			__glcheck draw_fbo.check();
-		}
+	for (int i = 0; i < rsx::limits::color_buffers_count; ++i)
+	{
+		gl::render_target *rtt = std::get<1>(m_rtts.m_bound_render_targets[i]);
 
-		switch (m_surface.depth_format)
+		if (!rtt)
 		{
-		case Surface_depth_format::z16:
+			__glcheck draw_fbo.color[i] = gl::texture(gl::texture::target::texture2D);
+			continue;
+		}
+
+		u32 pitch = rsx::method_registers[mr_color_pitch[i]];
+
+		if (rtt->pitch != pitch)
 		{
-			__glcheck m_draw_tex_depth_stencil.config()
-				.size({ (int)m_surface.width, (int)m_surface.height })
-				.type(gl::texture::type::ushort)
-				.format(gl::texture::format::depth)
-				.internal_format(gl::texture::internal_format::depth16);
+			// Memory layout changed, guest memory must be synchronized again
+			if (rtt->is_dirty)
+			{
+				download_render_target(*rtt);
+			}
 
-			__glcheck draw_fbo.depth = m_draw_tex_depth_stencil;
-			break;
+			m_rtts.protect(*rtt, 0);
+			rtt->needs_upload = true;
 		}
 
-		case Surface_depth_format::z24s8:
+		rtt->offset = rsx::method_registers[mr_color_offset[i]];
+		rtt->location = rsx::method_registers[mr_color_dma[i]];
+		rtt->pitch = pitch;
+		rtt->memory_size = pitch * rtt->surface_height;
+
+		__glcheck draw_fbo.color[i] = *rtt;
+	}
+
+	gl::render_target *ds = std::get<1>(m_rtts.m_bound_depth_stencil);
+
+	__glcheck draw_fbo.depth_stencil = gl::texture(gl::texture::target::texture2D);
+
+	if (ds)
+	{
+		u32 pitch = rsx::method_registers[NV4097_SET_SURFACE_PITCH_Z];
+
+		if (ds->pitch != pitch)
 		{
-			__glcheck m_draw_tex_depth_stencil.config()
-				.size({ (int)m_surface.width, (int)m_surface.height })
-				.type(gl::texture::type::uint_24_8)
-				.format(gl::texture::format::depth_stencil)
-				.internal_format(gl::texture::internal_format::depth24_stencil8);
+			if (ds->is_dirty)
+			{
+				download_render_target(*ds);
+			}
 
-			__glcheck draw_fbo.depth_stencil = m_draw_tex_depth_stencil;
-			break;
+			m_rtts.protect(*ds, 0);
+			ds->needs_upload = true;
 		}
 
-		default:
+		ds->pitch = pitch;
+		ds->memory_size = ds->surface_width * ds->surface_height * get_pixel_size(ds->depth_format);
+
+		if (ds->depth_format == Surface_depth_format::z16)
 		{
-			LOG_ERROR(RSX, "Bad depth format! (%d)", m_surface.depth_format);
-			assert(0);
-			break;
+			__glcheck draw_fbo.depth = *ds;
 		}
+		else
+		{
+			__glcheck draw_fbo.depth_stencil = *ds;
 		}
-
-		__glcheck m_draw_tex_depth_stencil.pixel_pack_settings().aligment(1);
-		__glcheck m_draw_tex_depth_stencil.pixel_unpack_settings().aligment(1);
 	}
 
+	__glcheck draw_fbo.check();
+
 	if (!skip_reading)
 	{
 		read_buffers();
@@ -1022,279 +1642,564 @@ void GLGSRender::init_buffers(bool skip_reading)
 	}
 }
 
-static const u32 mr_color_offset[rsx::limits::color_buffers_count] =
-{
-	NV4097_SET_SURFACE_COLOR_AOFFSET,
-	NV4097_SET_SURFACE_COLOR_BOFFSET,
-	NV4097_SET_SURFACE_COLOR_COFFSET,
-	NV4097_SET_SURFACE_COLOR_DOFFSET
-};
-
-static const u32 mr_color_dma[rsx::limits::color_buffers_count] =
-{
-	NV4097_SET_CONTEXT_DMA_COLOR_A,
-	NV4097_SET_CONTEXT_DMA_COLOR_B,
-	NV4097_SET_CONTEXT_DMA_COLOR_C,
-	NV4097_SET_CONTEXT_DMA_COLOR_D
-};
-
-static const u32 mr_color_pitch[rsx::limits::color_buffers_count] =
-{
-	NV4097_SET_SURFACE_PITCH_A,
-	NV4097_SET_SURFACE_PITCH_B,
-	NV4097_SET_SURFACE_PITCH_C,
-	NV4097_SET_SURFACE_PITCH_D
-};
-
 void GLGSRender::read_buffers()
 {
 	if (!draw_fbo)
 		return;
 
-	glDisable(GL_STENCIL_TEST);
+	m_gl_state.enable(0, GL_STENCIL_TEST);
+	m_forced_dirty_state |= state_stencil;
 
-	if (rpcs3::state.config.rsx.opengl.read_color_buffers)
+	std::lock_guard<std::recursive_mutex> lock(m_rtts.mutex);
+
+	auto read_surface = [&](gl::render_target *surface, bool enabled)
 	{
-		auto color_format = surface_color_format_to_gl(m_surface.color_format);
+		if (!surface || !surface->needs_upload)
+		{
+			return;
+		}
 
-		auto read_color_buffers = [&](int index, int count)
+		if (enabled)
 		{
-			u32 width = rsx::method_registers[NV4097_SET_SURFACE_CLIP_HORIZONTAL] >> 16;
-			u32 height = rsx::method_registers[NV4097_SET_SURFACE_CLIP_VERTICAL] >> 16;
+			// Other surfaces may still hold newer content of this range
+			flush_render_targets(surface->address, surface->memory_size);
 
+			upload_render_target(*surface);
+		}
 
-			for (int i = index; i < index + count; ++i)
-			{
-				u32 offset = rsx::method_registers[mr_color_offset[i]];
-				u32 location = rsx::method_registers[mr_color_dma[i]];
-				u32 pitch = rsx::method_registers[mr_color_pitch[i]];
+		surface->needs_upload = false;
 
-				if (pitch <= 64)
-					continue;
+		// Detect guest writes from now on
+		if (enabled && !surface->is_dirty)
+		{
+			m_rtts.protect(*surface, vm::page_writable);
+		}
+	};
 
-				m_draw_tex_color[i].pixel_unpack_settings().row_length(pitch / (color_format.channel_size * color_format.channel_count));
+	for (auto &rtt : m_rtts.m_bound_render_targets)
+	{
+		read_surface(std::get<1>(rtt), rpcs3::state.config.rsx.opengl.read_color_buffers.value());
+	}
 
-				rsx::tiled_region color_buffer = get_tiled_address(offset, location & 0xf);
+	read_surface(std::get<1>(m_rtts.m_bound_depth_stencil), rpcs3::state.config.rsx.opengl.read_depth_buffer.value());
+}
 
-				if (!color_buffer.tile)
-				{
-					__glcheck m_draw_tex_color[i].copy_from(color_buffer.ptr, color_format.format, color_format.type);
-				}
-				else
-				{
-					std::unique_ptr<u8[]> buffer(new u8[pitch * height]);
-					color_buffer.read(buffer.get(), width, height, pitch);
+void GLGSRender::write_buffers()
+{
+	if (!draw_fbo)
+		return;
 
-					__glcheck m_draw_tex_color[i].copy_from(buffer.get(), color_format.format, color_format.type);
-				}
-			}
-		};
+	std::lock_guard<std::recursive_mutex> lock(m_rtts.mutex);
 
-		switch (to_surface_target(rsx::method_registers[NV4097_SET_SURFACE_COLOR_TARGET]))
+	// Surfaces are written back lazily, when the guest or a texture accesses their memory
+	auto write_surface = [&](gl::render_target *surface, bool enabled)
+	{
+		if (!surface || !enabled)
 		{
-		case Surface_target::none:
-			break;
+			return;
+		}
 
-		case Surface_target::surface_a:
-			read_color_buffers(0, 1);
-			break;
+		surface->is_dirty = true;
+		surface->needs_upload = false;
 
-		case Surface_target::surface_b:
-			read_color_buffers(1, 1);
-			break;
+		if (surface->protection != (vm::page_readable | vm::page_writable))
+		{
+			m_rtts.protect(*surface, vm::page_readable | vm::page_writable);
+		}
+	};
 
-		case Surface_target::surfaces_a_b:
-			read_color_buffers(0, 2);
-			break;
+	switch (to_surface_target(rsx::method_registers[NV4097_SET_SURFACE_COLOR_TARGET]))
+	{
+	case Surface_target::none:
+		break;
 
-		case Surface_target::surfaces_a_b_c:
-			read_color_buffers(0, 3);
-			break;
+	case Surface_target::surface_a:
+		write_surface(std::get<1>(m_rtts.m_bound_render_targets[0]), rpcs3::state.config.rsx.opengl.write_color_buffers.value());
+		break;
 
-		case Surface_target::surfaces_a_b_c_d:
-			read_color_buffers(0, 4);
-			break;
+	case Surface_target::surface_b:
+		write_surface(std::get<1>(m_rtts.m_bound_render_targets[1]), rpcs3::state.config.rsx.opengl.write_color_buffers.value());
+		break;
+
+	case Surface_target::surfaces_a_b:
+	case Surface_target::surfaces_a_b_c:
+	case Surface_target::surfaces_a_b_c_d:
+		for (auto &rtt : m_rtts.m_bound_render_targets)
+		{
+			write_surface(std::get<1>(rtt), rpcs3::state.config.rsx.opengl.write_color_buffers.value());
 		}
+		break;
 	}
 
-	if (rpcs3::state.config.rsx.opengl.read_depth_buffer)
+	write_surface(std::get<1>(m_rtts.m_bound_depth_stencil), rpcs3::state.config.rsx.opengl.write_depth_buffer.value());
+}
+
+void GLGSRender::upload_render_target(gl::render_target &surface)
+{
+	if (surface.is_scaled())
 	{
-		//TODO: use pitch
-		u32 pitch = rsx::method_registers[NV4097_SET_SURFACE_PITCH_Z];
+		gl::render_target &unscaled = get_unscaled_surface(surface);
 
-		if (pitch <= 64)
-			return;
+		upload_render_target(unscaled);
+		blit_surface(unscaled, surface);
+		return;
+	}
+
+	if (!surface.is_depth)
+	{
+		auto color_format = surface_color_format_to_gl(surface.color_format);
+
+		u32 width = surface.width();
+		u32 height = surface.height();
+
+		surface.pixel_unpack_settings().row_length(surface.pitch / (color_format.channel_size * color_format.channel_count));
+
+		const rsx::tiled_region &color_buffer = get_tiled_region(surface);
+
+		if (!color_buffer.tile)
+		{
+			__glcheck surface.copy_from(color_buffer.ptr, color_format.format, color_format.type);
+		}
+		else if (color_buffer.tile->comp == CELL_GCM_COMPMODE_DISABLED || color_buffer.tile->comp == CELL_GCM_COMPMODE_C32_2X1)
+		{
+			// Rows are read in place with the tile pitch
+			gl::pixel_unpack_settings settings = surface.pixel_unpack_settings();
+			settings.row_length(color_buffer.tile->pitch / (color_format.channel_size * color_format.channel_count));
+
+			__glcheck surface.copy_from(color_buffer.ptr + color_buffer.base, color_format.format, color_format.type, settings);
+		}
+		else if (color_buffer.tile->comp == CELL_GCM_COMPMODE_C32_2X2)
+		{
+			// Every pixel is stored 2x2 times, the nearest downscale of the expanded surface keeps one of them
+			gl::render_target &expanded = get_expanded_surface(surface);
+
+			gl::pixel_unpack_settings settings = surface.pixel_unpack_settings();
+			settings.row_length(color_buffer.tile->pitch / (color_format.channel_size * color_format.channel_count));
+
+			__glcheck expanded.copy_from(color_buffer.ptr + color_buffer.base, color_format.format, color_format.type, settings);
+			blit_surface(expanded, surface, gl::filter::nearest);
+		}
+		else
+		{
+			std::unique_ptr<u8[]> buffer(new u8[surface.pitch * height]);
+			color_buffer.read(buffer.get(), width, height, surface.pitch);
+
+			__glcheck surface.copy_from(buffer.get(), color_format.format, color_format.type);
+		}
 
-		auto depth_format = surface_depth_format_to_gl(m_surface.depth_format);
+		return;
+	}
+
+	//TODO: use pitch
+	auto depth_format = surface_depth_format_to_gl(surface.depth_format);
+
+	gl::buffer pbo_depth;
 
-		int pixel_size = get_pixel_size(m_surface.depth_format);
-		gl::buffer pbo_depth;
+	__glcheck pbo_depth.create(surface.memory_size);
+	__glcheck pbo_depth.map([&](GLubyte* pixels)
+	{
+		const size_t width = surface.width();
 
-		__glcheck pbo_depth.create(m_surface.width * m_surface.height * pixel_size);
-		__glcheck pbo_depth.map([&](GLubyte* pixels)
+		m_readback_pool.run_rows(surface.height(), 64, [&](size_t first_row, size_t row_count)
 		{
-			u32 depth_address = rsx::get_address(rsx::method_registers[NV4097_SET_SURFACE_ZETA_OFFSET], rsx::method_registers[NV4097_SET_CONTEXT_DMA_ZETA]);
+			const size_t first = first_row * width, count = row_count * width;
 
-			if (m_surface.depth_format == Surface_depth_format::z16)
+			if (surface.depth_format == Surface_depth_format::z16)
 			{
-				u16 *dst = (u16*)pixels;
-				const be_t<u16>* src = vm::ps3::_ptr<u16>(depth_address);
-				for (int i = 0, end = m_draw_tex_depth_stencil.width() * m_draw_tex_depth_stencil.height(); i < end; ++i)
-				{
-					dst[i] = src[i];
-				}
+				be_to_native((u16*)pixels + first, vm::ps3::_ptr<u16>(surface.address) + first, count);
 			}
 			else
 			{
-				u32 *dst = (u32*)pixels;
-				const be_t<u32>* src = vm::ps3::_ptr<u32>(depth_address);
-				for (int i = 0, end = m_draw_tex_depth_stencil.width() * m_draw_tex_depth_stencil.height(); i < end; ++i)
-				{
-					dst[i] = src[i];
-				}
+				be_to_native((u32*)pixels + first, vm::ps3::_ptr<u32>(surface.address) + first, count);
 			}
-		}, gl::buffer::access::write);
+		});
+	}, gl::buffer::access::write);
 
-		__glcheck m_draw_tex_depth_stencil.copy_from(pbo_depth, depth_format.second, depth_format.first);
-	}
+	__glcheck surface.copy_from(pbo_depth, depth_format.second, depth_format.first);
 }
 
-void GLGSRender::write_buffers()
+void GLGSRender::download_render_target(gl::render_target &surface)
 {
-	if (!draw_fbo)
+	std::lock_guard<std::recursive_mutex> lock(m_rtts.mutex);
+
+	// Guest memory is written below
+	m_rtts.protect(surface, 0);
+	surface.is_dirty = false;
+
+	if (surface.is_scaled())
+	{
+		gl::render_target &unscaled = get_unscaled_surface(surface);
+
+		blit_surface(surface, unscaled);
+		download_render_target(unscaled);
 		return;
+	}
 
-	if (rpcs3::state.config.rsx.opengl.write_color_buffers)
+	if (!surface.is_depth)
 	{
-		//gl::buffer pbo_color;
-		//__glcheck pbo_color.create(m_draw_tex_color[0].width() * m_draw_tex_color[0].height() * 4);
+		auto color_format = surface_color_format_to_gl(surface.color_format);
+
+		u32 width = surface.width();
+		u32 height = surface.height();
 
-		auto color_format = surface_color_format_to_gl(m_surface.color_format);
+		surface.pixel_pack_settings().row_length(surface.pitch / (color_format.channel_size * color_format.channel_count));
 
-		auto write_color_buffers = [&](int index, int count)
+		const rsx::tiled_region &color_buffer = get_tiled_region(surface);
+
+		if (!color_buffer.tile)
+		{
+			__glcheck surface.copy_to(color_buffer.ptr, color_format.format, color_format.type);
+		}
+		else if (color_buffer.tile->comp == CELL_GCM_COMPMODE_DISABLED || color_buffer.tile->comp == CELL_GCM_COMPMODE_C32_2X1)
 		{
-			u32 width = rsx::method_registers[NV4097_SET_SURFACE_CLIP_HORIZONTAL] >> 16;
-			u32 height = rsx::method_registers[NV4097_SET_SURFACE_CLIP_VERTICAL] >> 16;
+			// Rows are written in place with the tile pitch
+			gl::pixel_pack_settings settings = surface.pixel_pack_settings();
+			settings.row_length(color_buffer.tile->pitch / (color_format.channel_size * color_format.channel_count));
 
-			for (int i = index; i < index + count; ++i)
-			{
-				//TODO: swizzle
-				//__glcheck m_draw_tex_color[i].copy_to(pbo_color, color_format.format, color_format.type);
+			__glcheck surface.copy_to(color_buffer.ptr + color_buffer.base, color_format.format, color_format.type, settings);
+		}
+		else if (color_buffer.tile->comp == CELL_GCM_COMPMODE_C32_2X2)
+		{
+			// Every pixel is duplicated on 2 rows and 2 columns by a nearest upscale
+			gl::render_target &expanded = get_expanded_surface(surface);
+			blit_surface(surface, expanded, gl::filter::nearest);
 
-				//pbo_color.map([&](GLubyte* pixels)
-				//{
-				//	u32 color_address = rsx::get_address(rsx::method_registers[mr_color_offset[i]], rsx::method_registers[mr_color_dma[i]]);
-				//	//u32 depth_address = rsx::get_address(rsx::method_registers[NV4097_SET_SURFACE_ZETA_OFFSET], rsx::method_registers[NV4097_SET_CONTEXT_DMA_ZETA]);
+			gl::pixel_pack_settings settings = surface.pixel_pack_settings();
+			settings.row_length(color_buffer.tile->pitch / (color_format.channel_size * color_format.channel_count));
 
-				//	const u32 *src = (const u32*)pixels;
-				//	be_t<u32>* dst = vm::ps3::_ptr<u32>(color_address);
-				//	for (int i = 0, end = m_draw_tex_color[i].width() * m_draw_tex_color[i].height(); i < end; ++i)
-				//	{
-				//		dst[i] = src[i];
-				//	}
+			__glcheck expanded.copy_to(color_buffer.ptr + color_buffer.base, color_format.format, color_format.type, settings);
+		}
+		else
+		{
+			std::unique_ptr<u8[]> buffer(new u8[surface.pitch * height]);
 
-				//}, gl::buffer::access::read);
+			__glcheck surface.copy_to(buffer.get(), color_format.format, color_format.type);
 
-				u32 offset = rsx::method_registers[mr_color_offset[i]];
-				u32 location = rsx::method_registers[mr_color_dma[i]];
-				u32 pitch = rsx::method_registers[mr_color_pitch[i]];
+			color_buffer.write(buffer.get(), width, height, surface.pitch);
+		}
 
-				if (pitch <= 64)
-					continue;
+		return;
+	}
 
-				m_draw_tex_color[i].pixel_pack_settings().row_length(pitch / (color_format.channel_size * color_format.channel_count));
+	//TODO: use pitch
+	auto depth_format = surface_depth_format_to_gl(surface.depth_format);
 
-				rsx::tiled_region color_buffer = get_tiled_address(offset, location & 0xf);
+	gl::buffer pbo_depth;
 
-				if (!color_buffer.tile)
-				{
-					__glcheck m_draw_tex_color[i].copy_to(color_buffer.ptr, color_format.format, color_format.type);
-				}
-				else
-				{
-					std::unique_ptr<u8[]> buffer(new u8[pitch * height]);
+	__glcheck pbo_depth.create(surface.memory_size);
+	__glcheck surface.copy_to(pbo_depth, depth_format.second, depth_format.first);
 
-					__glcheck m_draw_tex_color[i].copy_to(buffer.get(), color_format.format, color_format.type);
+	__glcheck pbo_depth.map([&](GLubyte* pixels)
+	{
+		const size_t width = surface.width();
 
-					color_buffer.write(buffer.get(), width, height, pitch);
-				}
+		m_readback_pool.run_rows(surface.height(), 64, [&](size_t first_row, size_t row_count)
+		{
+			const size_t first = first_row * width, count = row_count * width;
+
+			if (surface.depth_format == Surface_depth_format::z16)
+			{
+				native_to_be(vm::ps3::_ptr<u16>(surface.address) + first, (const u16*)pixels + first, count);
+			}
+			else
+			{
+				native_to_be(vm::ps3::_ptr<u32>(surface.address) + first, (const u32*)pixels + first, count);
 			}
-		};
+		});
 
-		switch (to_surface_target(rsx::method_registers[NV4097_SET_SURFACE_COLOR_TARGET]))
-		{
-		case Surface_target::none:
-			break;
+	}, gl::buffer::access::read);
+}
 
-		case Surface_target::surface_a:
-			write_color_buffers(0, 1);
-			break;
+gl::render_target& GLGSRender::get_unscaled_surface(const gl::render_target &surface)
+{
+	std::unique_ptr<gl::render_target> &unscaled = surface.is_depth ? m_unscaled_depth : m_unscaled_color;
 
-		case Surface_target::surface_b:
-			write_color_buffers(1, 1);
-			break;
+	const bool reusable = unscaled && (surface.is_depth
+		? gl_render_target_traits::ds_has_format_width_height(unscaled, surface.depth_format, surface.surface_width, surface.surface_height)
+		: gl_render_target_traits::rtt_has_format_width_height(unscaled, surface.color_format, surface.surface_width, surface.surface_height));
 
-		case Surface_target::surfaces_a_b:
-			write_color_buffers(0, 2);
-			break;
+	if (!reusable)
+	{
+		unscaled = surface.is_depth
+			? gl_render_target_traits::create_new_surface(surface.address, surface.depth_format, surface.surface_width, surface.surface_height, 100)
+			: gl_render_target_traits::create_new_surface(surface.address, surface.color_format, surface.surface_width, surface.surface_height, 100);
+	}
 
-		case Surface_target::surfaces_a_b_c:
-			write_color_buffers(0, 3);
-			break;
+	unscaled->address = surface.address;
+	unscaled->offset = surface.offset;
+	unscaled->location = surface.location;
+	unscaled->pitch = surface.pitch;
+	unscaled->memory_size = surface.memory_size;
 
-		case Surface_target::surfaces_a_b_c_d:
-			write_color_buffers(0, 4);
-			break;
-		}
+	return *unscaled;
+}
+
+const rsx::tiled_region& GLGSRender::get_tiled_region(gl::render_target &surface)
+{
+	const u32 version = tiles_version.load();
+
+	if (surface.tiled_version != version || surface.tiled_offset != surface.offset || surface.tiled_location != surface.location)
+	{
+		surface.tiled = get_tiled_address(surface.offset, surface.location & 0xf);
+		surface.tiled_offset = surface.offset;
+		surface.tiled_location = surface.location;
+		surface.tiled_version = version;
 	}
 
-	if (rpcs3::state.config.rsx.opengl.write_depth_buffer)
+	return surface.tiled;
+}
+
+gl::render_target& GLGSRender::get_expanded_surface(const gl::render_target &surface)
+{
+	if (!m_expanded_color || !gl_render_target_traits::rtt_has_format_width_height(m_expanded_color, surface.color_format, surface.surface_width, surface.surface_height))
 	{
-		//TODO: use pitch
-		u32 pitch = rsx::method_registers[NV4097_SET_SURFACE_PITCH_Z];
+		m_expanded_color = gl_render_target_traits::create_new_surface(surface.address, surface.color_format, surface.surface_width, surface.surface_height, 200);
+	}
 
-		if (pitch <= 64)
-			return;
+	return *m_expanded_color;
+}
+
+void GLGSRender::blit_surface(gl::render_target &src, gl::render_target &dst, gl::filter color_filter)
+{
+	if (!m_scale_src_fbo)
+	{
+		m_scale_src_fbo.create();
+		m_scale_dst_fbo.create();
+	}
+
+	// The surfaces can be transferred in the middle of a draw
+	gl::fbo::save_binding_state save(m_scale_dst_fbo);
+
+	auto attach = [](gl::fbo &fbo, gl::render_target &surface)
+	{
+		__glcheck fbo.color = gl::texture(gl::texture::target::texture2D);
+		__glcheck fbo.depth = gl::texture(gl::texture::target::texture2D);
+		__glcheck fbo.depth_stencil = gl::texture(gl::texture::target::texture2D);
 
-		auto depth_format = surface_depth_format_to_gl(m_surface.depth_format);
+		if (!surface.is_depth)
+		{
+			__glcheck fbo.color = surface;
+		}
+		else if (surface.depth_format == Surface_depth_format::z16)
+		{
+			__glcheck fbo.depth = surface;
+		}
+		else
+		{
+			__glcheck fbo.depth_stencil = surface;
+		}
+	};
 
-		gl::buffer pbo_depth;
+	attach(m_scale_src_fbo, src);
+	attach(m_scale_dst_fbo, dst);
 
-		int pixel_size = get_pixel_size(m_surface.depth_format);
+	const areai src_area = coordi({}, src.size());
+	const areai dst_area = coordi({}, dst.size());
 
-		__glcheck pbo_depth.create(m_surface.width * m_surface.height * pixel_size);
-		__glcheck m_draw_tex_depth_stencil.copy_to(pbo_depth, depth_format.second, depth_format.first);
+	if (!src.is_depth)
+	{
+		__glcheck m_scale_src_fbo.blit(m_scale_dst_fbo, src_area, dst_area, gl::buffers::color, color_filter);
+	}
+	else
+	{
+		// Depth and stencil can't be filtered
+		const gl::buffers buffers = src.depth_format == Surface_depth_format::z16 ? gl::buffers::depth : gl::buffers::depth_stencil;
 
-		__glcheck pbo_depth.map([&](GLubyte* pixels)
+		__glcheck m_scale_src_fbo.blit(m_scale_dst_fbo, src_area, dst_area, buffers, gl::filter::nearest);
+	}
+}
+
+void GLGSRender::flush_render_targets(u32 start, u32 size)
+{
+	std::lock_guard<std::recursive_mutex> lock(m_rtts.mutex);
+
+	u32 end = start + size;
+	bool flushed = true;
+
+	// Flushed surfaces become accessible, which can expose other surfaces sharing their pages
+	while (flushed)
+	{
+		flushed = false;
+
+		m_rtts.for_each([&](gl::render_target &surface)
 		{
-			u32 depth_address = rsx::get_address(rsx::method_registers[NV4097_SET_SURFACE_ZETA_OFFSET], rsx::method_registers[NV4097_SET_CONTEXT_DMA_ZETA]);
+			if (!surface.is_dirty || !surface.overlaps(start, end - start))
+			{
+				return;
+			}
+
+			start = std::min(start, surface.protected_start);
+			end = std::max(end, surface.protected_start + surface.protected_size);
+
+			download_render_target(surface);
+
+			// Keep detecting guest writes
+			m_rtts.protect(surface, vm::page_writable);
+			flushed = true;
+		});
+	}
+}
 
-			if (m_surface.depth_format == Surface_depth_format::z16)
+bool GLGSRender::on_access_violation(u32 addr)
+{
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_rtts.mutex);
+
+		bool handled = false;
+		bool needs_flush = false;
+
+		m_rtts.for_each([&](gl::render_target &surface)
+		{
+			if (surface.overlaps(addr, 1))
 			{
-				const u16 *src = (const u16*)pixels;
-				be_t<u16>* dst = vm::ps3::_ptr<u16>(depth_address);
-				for (int i = 0, end = m_draw_tex_depth_stencil.width() * m_draw_tex_depth_stencil.height(); i < end; ++i)
-				{
-					dst[i] = src[i];
-				}
+				handled = true;
+				needs_flush |= surface.is_dirty;
 			}
-			else
+		});
+
+		if (!handled)
+		{
+			return false;
+		}
+
+		if (!needs_flush)
+		{
+			// Guest write to synchronized surfaces
+			m_rtts.for_each([&](gl::render_target &surface)
 			{
-				const u32 *src = (const u32*)pixels;
-				be_t<u32>* dst = vm::ps3::_ptr<u32>(depth_address);
-				for (int i = 0, end = m_draw_tex_depth_stencil.width() * m_draw_tex_depth_stencil.height(); i < end; ++i)
+				if (surface.overlaps(addr, 1))
 				{
-					dst[i] = src[i];
+					m_rtts.protect(surface, 0);
+					surface.needs_upload = true;
 				}
-			}
+			});
+
+			return true;
+		}
+	}
+
+	if (std::this_thread::get_id() == m_rsx_thread_id)
+	{
+		flush_render_targets(addr & ~0xfff, 4096);
+		return true;
+	}
+
+	// Surfaces can only be read back by the thread owning the GL context
+	std::lock_guard<std::mutex> request_lock(m_flush_request_mutex);
+	std::unique_lock<std::mutex> lock(m_flush_mutex);
+
+	m_flush_address = addr;
+	m_flush_requested = true;
 
-		}, gl::buffer::access::read);
+	lock.unlock();
+	fifo_wakeup();
+	lock.lock();
+
+	while (m_flush_requested)
+	{
+		if (Emu.IsStopped())
+		{
+			m_flush_requested = false;
+			return false;
+		}
+
+		m_flush_cv.wait_for(lock, 1ms);
+	}
+
+	return true;
+}
+
+u32 GLGSRender::begin_occlusion_query()
+{
+	GLuint query;
+
+	if (m_free_occlusion_queries.empty())
+	{
+		glGenQueries(1, &query);
+		m_occlusion_queries.push_back(query);
+	}
+	else
+	{
+		query = m_free_occlusion_queries.back();
+		m_free_occlusion_queries.pop_back();
+	}
+
+	__glcheck glBeginQuery(GL_SAMPLES_PASSED, query);
+	return query;
+}
+
+void GLGSRender::end_occlusion_query(u32 query)
+{
+	__glcheck glEndQuery(GL_SAMPLES_PASSED);
+}
+
+bool GLGSRender::check_occlusion_query(u32 query)
+{
+	GLuint available = GL_FALSE;
+	glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+	return available != GL_FALSE;
+}
+
+u32 GLGSRender::get_occlusion_query_result(u32 query)
+{
+	GLuint result = 0;
+	glGetQueryObjectuiv(query, GL_QUERY_RESULT, &result);
+	m_free_occlusion_queries.push_back(query);
+	return result;
+}
+
+u32 GLGSRender::begin_gpu_timer()
+{
+	GLuint query;
+
+	if (m_free_timer_queries.empty())
+	{
+		glGenQueries(1, &query);
+		m_timer_queries.push_back(query);
+	}
+	else
+	{
+		query = m_free_timer_queries.back();
+		m_free_timer_queries.pop_back();
+	}
+
+	__glcheck glBeginQuery(GL_TIME_ELAPSED, query);
+	return query;
+}
+
+void GLGSRender::end_gpu_timer(u32 query)
+{
+	__glcheck glEndQuery(GL_TIME_ELAPSED);
+}
+
+u64 GLGSRender::get_gpu_timer_result(u32 query)
+{
+	GLuint64 result = 0;
+	glGetQueryObjectui64v(query, GL_QUERY_RESULT, &result);
+	m_free_timer_queries.push_back(query);
+	return result;
+}
+
+void GLGSRender::do_local_task()
+{
+	std::lock_guard<std::mutex> lock(m_flush_mutex);
+
+	if (m_flush_requested)
+	{
+		// The surfaces must include the draw being merged
+		end_deferred_draw();
+		flush_render_targets(m_flush_address & ~0xfff, 4096);
+		m_flush_requested = false;
+		m_flush_cv.notify_all();
 	}
 }
 
 void GLGSRender::flip(int buffer)
 {
 	//LOG_NOTICE(Log::RSX, "flip(%d)", buffer);
+	// Presentation draws must not be counted by the occlusion query
+	end_zpass_query();
+
 	u32 buffer_width = gcm_buffers[buffer].width;
 	u32 buffer_height = gcm_buffers[buffer].height;
 	u32 buffer_pitch = gcm_buffers[buffer].pitch;
@@ -1302,23 +2207,36 @@ void GLGSRender::flip(int buffer)
 	rsx::tiled_region buffer_region = get_tiled_address(gcm_buffers[buffer].offset, CELL_GCM_LOCATION_LOCAL);
 
 	bool skip_read = false;
+	const gl::fbo *flip_source = &draw_fbo;
+
+	u32 buffer_address = rsx::get_address(gcm_buffers[buffer].offset, CELL_GCM_LOCATION_LOCAL);
+	gl::render_target *surface;
 
-	if (draw_fbo && !rpcs3::state.config.rsx.opengl.write_color_buffers)
 	{
+		std::lock_guard<std::recursive_mutex> lock(m_rtts.mutex);
+		surface = m_rtts.get_texture_from_render_target_if_applicable(buffer_address);
+	}
+
+	if (surface)
+	{
+		// Present the cached surface, guest memory may not contain it yet
 		skip_read = true;
-		/*
-		for (uint i = 0; i < rsx::limits::color_buffers_count; ++i)
-		{
-			u32 color_address = rsx::get_address(rsx::method_registers[mr_color_offset[i]], rsx::method_registers[mr_color_dma[i]]);
 
-			if (color_address == buffer_address)
-			{
-				skip_read = true;
-				__glcheck draw_fbo.draw_buffer(draw_fbo.color[i]);
-				break;
-			}
+		if (!m_flip_source_fbo)
+		{
+			m_flip_source_fbo.create();
 		}
-		*/
+
+		__glcheck m_flip_source_fbo.color = *surface;
+		flip_source = &m_flip_source_fbo;
+	}
+	else if (draw_fbo && !rpcs3::state.config.rsx.opengl.write_color_buffers)
+	{
+		skip_read = true;
+	}
+	else
+	{
+		flush_render_targets(buffer_address, buffer_pitch * buffer_height);
 	}
 
 	if (!skip_read)
@@ -1342,12 +2260,13 @@ void GLGSRender::flip(int buffer)
 
 		m_flip_fbo.bind();
 
-		glDisable(GL_SCISSOR_TEST);
-		glDisable(GL_DEPTH_TEST);
-		glDisable(GL_STENCIL_TEST);
-		glDisable(GL_BLEND);
-		glDisable(GL_LOGIC_OP);
-		glDisable(GL_CULL_FACE);
+		m_gl_state.enable(0, GL_SCISSOR_TEST);
+		m_gl_state.enable(0, GL_DEPTH_TEST);
+		m_gl_state.enable(0, GL_STENCIL_TEST);
+		m_gl_state.enable(0, GL_BLEND);
+		m_gl_state.enable(0, GL_LOGIC_OP);
+		m_gl_state.enable(0, GL_CULL_FACE);
+		m_forced_dirty_state = state_all;
 
 		if (buffer_region.tile)
 		{
@@ -1361,48 +2280,86 @@ void GLGSRender::flip(int buffer)
 		}
 	}
 
-	areai screen_area = coordi({}, { (int)buffer_width, (int)buffer_height });
+	sizei source_size{ (int)buffer_width, (int)buffer_height };
 
-	coordi aspect_ratio;
-	if (1) //enable aspect ratio
+	// Cached surfaces are rendered at the internal resolution
+	if (skip_read)
 	{
-		sizei csize = m_frame->client_size();
-		sizei new_size = csize;
+		source_size = { gl_render_target_traits::scale(buffer_width), gl_render_target_traits::scale(buffer_height) };
+	}
 
-		const double aq = (double)buffer_width / buffer_height;
-		const double rq = (double)new_size.width / new_size.height;
-		const double q = aq / rq;
+	areai screen_area = coordi({}, source_size);
 
-		if (q > 1.0)
-		{
-			new_size.height = int(new_size.height / q);
-			aspect_ratio.y = (csize.height - new_size.height) / 2;
-		}
-		else if (q < 1.0)
-		{
-			new_size.width = int(new_size.width * q);
-			aspect_ratio.x = (csize.width - new_size.width) / 2;
-		}
+	const areai output_area = get_flip_output_area(buffer_width, buffer_height, m_frame->client_size());
 
-		aspect_ratio.size = new_size;
-	}
-	else
+	// libresc scales with bilinear filtering
+	const gl::filter filter = get_resc_config().enabled ? gl::filter::linear : gl::filter::nearest;
+
+	const gl::fbo &source = skip_read ? *flip_source : m_flip_fbo;
+
+	if (m_present_thread)
 	{
-		aspect_ratio.size = m_frame->client_size();
+		present_async(source, source_size, output_area.flipped_vertical(), filter);
+		return;
 	}
 
 	gl::screen.clear(gl::buffers::color_depth_stencil);
 
-	if (!skip_read)
+	__glcheck source.blit(gl::screen, screen_area, output_area.flipped_vertical(), gl::buffers::color, filter);
+
+	m_frame->flip(m_context);
+}
+
+void GLGSRender::present_async(const gl::fbo &source, sizei size, areai dst_area, gl::filter filter)
+{
+	const u32 slot = m_present_thread.acquire_slot();
+
+	// The slot is free, so the present thread is done with its previous frame
+	if (GLsync sync = m_present_syncs[slot])
 	{
-		__glcheck m_flip_fbo.blit(gl::screen, screen_area, areai(aspect_ratio).flipped_vertical());
+		glDeleteSync(sync);
+		m_present_syncs[slot] = nullptr;
 	}
-	else
+
+	gl::texture &target = m_present_textures[slot];
+
+	if (!target || target.size() != size)
 	{
-		__glcheck draw_fbo.blit(gl::screen, screen_area, areai(aspect_ratio).flipped_vertical());
+		target.recreate(gl::texture::target::texture2D);
+
+		__glcheck target.config()
+			.size(size)
+			.type(gl::texture::type::uint_8_8_8_8)
+			.format(gl::texture::format::bgra);
 	}
 
-	m_frame->flip(m_context);
+	if (!m_present_fbo)
+	{
+		m_present_fbo.create();
+	}
+
+	__glcheck m_present_fbo.color = target;
+
+	const areai area = coordi({}, size);
+
+	m_gl_state.enable(0, GL_SCISSOR_TEST);
+	__glcheck source.blit(m_present_fbo, area, area);
+
+	m_present_syncs[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glFlush();
+
+	m_present_thread.push(slot, [this, slot, area, dst_area, filter]()
+	{
+		// Runs on the present thread with m_present_context current
+		__glcheck glWaitSync(m_present_syncs[slot], 0, GL_TIMEOUT_IGNORED);
+
+		__glcheck m_present_read_fbo.color = m_present_textures[slot];
+
+		gl::screen.clear(gl::buffers::color_depth_stencil);
+		__glcheck m_present_read_fbo.blit(gl::screen, area, dst_area, gl::buffers::color, filter);
+
+		m_frame->flip(m_present_context);
+	});
 }
 
 
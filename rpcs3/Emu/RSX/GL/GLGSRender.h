@@ -2,6 +2,9 @@
 #include "Emu/RSX/GSRender.h"
 #include "gl_helpers.h"
 #include "rsx_gl_texture.h"
+#include "gl_render_targets.h"
+#include "Emu/RSX/Common/geometry_cache.h"
+#include "Emu/RSX/Common/task_pool.h"
 
 #define RSX_DEBUG 1
 
@@ -15,7 +18,8 @@ private:
 	GLFragmentProgram m_fragment_prog;
 	GLVertexProgram m_vertex_prog;
 
-	rsx::gl::texture m_gl_textures[rsx::limits::textures_count];
+	rsx::gl::texture_cache m_texture_cache;
+	rsx::gl::texture_decoder m_texture_decoder;
 	rsx::gl::texture m_gl_vertex_textures[rsx::limits::vertex_textures_count];
 
 	gl::glsl::program *m_program;
@@ -27,36 +31,150 @@ public:
 
 private:
 	GLProgramBuffer m_prog_buffer;
+	rsx::shader_binary_cache m_program_binaries;
 
-	gl::texture m_draw_tex_color[rsx::limits::color_buffers_count];
-	gl::texture m_draw_tex_depth_stencil;
+	gl_render_targets m_rtts;
+
+	// Guest sized copies of the surfaces rendered at a different internal resolution, used for guest memory transfers
+	std::unique_ptr<gl::render_target> m_unscaled_color;
+	std::unique_ptr<gl::render_target> m_unscaled_depth;
+	std::unique_ptr<gl::render_target> m_expanded_color;
+	gl::fbo m_scale_src_fbo;
+	gl::fbo m_scale_dst_fbo;
 
 	//buffer
 	gl::fbo m_flip_fbo;
 	gl::texture m_flip_tex_color;
+	gl::fbo m_flip_source_fbo;
+
+	// Frames handed to the present thread, which owns a context sharing objects with the RSX one
+	rsx::present_thread m_present_thread;
+	draw_context_t m_present_context;
+	std::vector<gl::texture> m_present_textures; // per present slot
+	std::vector<GLsync> m_present_syncs; // per present slot, signaled once the frame is copied
+	gl::fbo m_present_fbo; // RSX context
+	gl::fbo m_present_read_fbo; // present context
+
+	// Render target flush requested by another thread (see on_access_violation)
+	std::mutex m_flush_request_mutex;
+	std::mutex m_flush_mutex;
+	std::condition_variable m_flush_cv;
+	u32 m_flush_address = 0;
+	bool m_flush_requested = false;
+
+	gl::ring_buffer m_uniform_ring;
+
+	// Constant block written to m_uniform_ring, valid while the ring serial is unchanged
+	struct uniform_range
+	{
+		u64 serial = 0;
+		u32 offset = 0;
+		u32 size = 0;
+	};
+
+	uniform_range m_scale_offset_range;
+	f32 m_scale_offset_data[16];
+
+	// Fragment constants patched out of the ucode, cached per fragment program address
+	struct fragment_constants_entry
+	{
+		u64 hash = 0;
+		std::vector<f32> data;
+		uniform_range range;
+	};
+
+	std::unordered_map<u32, fragment_constants_entry> m_fragment_constants;
+
+	uniform_range m_bound_uniform_ranges[3];
+	u64 m_uniform_uploads_skipped = 0;
+
+	gl::ring_buffer m_vertex_ring;
+	gl::ring_buffer m_index_ring;
+	GLint m_uniform_buffer_offset_align = 256;
+
+	// Vertex program constants, only the range written since the previous draw is uploaded
+	gl::buffer m_transform_constants_buffer;
+
+	// Raw guest vertex arrays, fetched and converted by the vertex shader
+	bool m_gpu_vertex_fetch = false;
+	gl::ring_buffer m_vertex_fetch_ring;
+	gl::texture m_vertex_fetch_texture;
 
-	gl::buffer m_scale_offset_buffer;
-	gl::buffer m_vertex_constants_buffer;
-	gl::buffer m_fragment_constants_buffer;
-
-	gl::buffer m_vbo;
-	gl::buffer m_ebo;
 	gl::vao m_vao;
 
+	// Static vertex and index arrays copied out of the streaming rings (GL buffer names)
+	using geometry_cache_t = rsx::geometry_cache<GLuint>;
+	geometry_cache_t m_geometry_cache;
+	bool m_use_geometry_cache = false;
+
+	// Workers converting depth surfaces between guest and host layouts
+	rsx::task_pool m_readback_pool;
+
+	// Occlusion queries backing ZPASS reports, reused once their result is read
+	std::vector<GLuint> m_occlusion_queries;
+	std::vector<GLuint> m_free_occlusion_queries;
+
+	// Timer queries for the capture replay statistics
+	std::vector<GLuint> m_timer_queries;
+	std::vector<GLuint> m_free_timer_queries;
+
 public:
 	GLGSRender();
 
 private:
-	static u32 enable(u32 enable, u32 cap);
-	static u32 enable(u32 enable, u32 cap, u32 index);
+	// Snapshot of the state registers applied by the last draw
+	std::vector<u32> m_applied_state_registers;
+
+	// Compare the state registers with the last applied ones, returns the changed groups
+	u32 get_dirty_state();
 
 public:
+	// Last GL state set by this renderer, redundant calls are not forwarded
+	gl::state_cache m_gl_state;
+
+	// State groups changed outside of begin() (clears, flips), reapplied on the next draw
+	u32 m_forced_dirty_state = ~0u;
+
 	bool load_program();
 	void init_buffers(bool skip_reading = false);
 	void read_buffers();
 	void write_buffers();
 	void set_viewport();
 
+	// Copy the frame to a present slot and queue it on the present thread
+	void present_async(const gl::fbo &source, sizei size, areai dst_area, gl::filter filter);
+
+	// Copy the block to the uniform ring unless it is still there
+	void upload_uniform_block(uniform_range &range, const void *data, u32 size);
+	void bind_uniform_block(u32 index, const uniform_range &range);
+
+	// Copy the array reserved in the geometry cache from the ring to its own buffer
+	void cache_geometry(const geometry_cache_t::key_t &key, const gl::ring_buffer &ring, u32 offset, u32 size, u32 min_index = 0, u32 max_index = 0);
+
+	// Copy vertex arrays to the vertex fetch buffer and set up the vertex shader input descriptors
+	void upload_vertex_fetch_data(u32 min_index, u32 max_index);
+
+	void upload_render_target(gl::render_target &surface);
+	void download_render_target(gl::render_target &surface);
+
+	// Guest sized surface with the format and memory layout of a scaled surface
+	gl::render_target& get_unscaled_surface(const gl::render_target &surface);
+
+	// Copy a surface to another one of the same format, scaling it to the destination size
+	void blit_surface(gl::render_target &src, gl::render_target &dst, gl::filter color_filter = gl::filter::linear);
+
+	// Tiled guest region of a surface, decoded again only when tiles have changed
+	const rsx::tiled_region& get_tiled_region(gl::render_target &surface);
+
+	// Surface of twice the size of a color surface, holding the guest layout of C32_2X2 compressed tiles
+	gl::render_target& get_expanded_surface(const gl::render_target &surface);
+
+	// Write back dirty surfaces overlapping the range (RSX thread only)
+	void flush_render_targets(u32 start, u32 size);
+
+	// Guest memory access handler for surfaces, can be called from any thread
+	bool on_access_violation(u32 addr);
+
 protected:
 	void begin() override;
 	void end() override;
@@ -64,6 +182,15 @@ protected:
 	void on_init_thread() override;
 	void on_exit() override;
 	bool do_method(u32 id, u32 arg) override;
+	void do_local_task() override;
+
+	u32 begin_occlusion_query() override;
+	void end_occlusion_query(u32 query) override;
+	bool check_occlusion_query(u32 query) override;
+	u32 get_occlusion_query_result(u32 query) override;
+	u32 begin_gpu_timer() override;
+	void end_gpu_timer(u32 query) override;
+	u64 get_gpu_timer_result(u32 query) override;
 	void flip(int buffer) override;
 	u64 timestamp() const override;
 };
@@ -9,6 +9,9 @@ OPENGL_PROC(PFNGLMAPBUFFERPROC, MapBuffer);
 OPENGL_PROC(PFNGLUNMAPBUFFERPROC, UnmapBuffer);
 OPENGL_PROC(PFNGLGETBUFFERPARAMETERIVPROC, GetBufferParameteriv);
 OPENGL_PROC(PFNGLGETBUFFERPOINTERVPROC, GetBufferPointerv);
+OPENGL_PROC(PFNGLMAPBUFFERRANGEPROC, MapBufferRange);
+OPENGL_PROC(PFNGLFLUSHMAPPEDBUFFERRANGEPROC, FlushMappedBufferRange);
+OPENGL_PROC(PFNGLCOPYBUFFERSUBDATAPROC, CopyBufferSubData);
 OPENGL_PROC(PFNGLBLENDFUNCSEPARATEPROC, BlendFuncSeparate);
 OPENGL_PROC(PFNGLBLENDEQUATIONSEPARATEPROC, BlendEquationSeparate);
 OPENGL_PROC(PFNGLCREATESHADERPROC, CreateShader);
@@ -26,6 +29,9 @@ OPENGL_PROC(PFNGLLINKPROGRAMPROC, LinkProgram);
 OPENGL_PROC(PFNGLVALIDATEPROGRAMPROC, ValidateProgram);
 OPENGL_PROC(PFNGLBINDFRAGDATALOCATIONPROC, BindFragDataLocation);
 OPENGL_PROC(PFNGLBINDATTRIBLOCATIONPROC, BindAttribLocation);
+OPENGL_PROC(PFNGLPROGRAMPARAMETERIPROC, ProgramParameteri);
+OPENGL_PROC(PFNGLGETPROGRAMBINARYPROC, GetProgramBinary);
+OPENGL_PROC(PFNGLPROGRAMBINARYPROC, ProgramBinary);
 OPENGL_PROC(PFNGLGETUNIFORMLOCATIONPROC, GetUniformLocation);
 OPENGL_PROC(PFNGLGETPROGRAMIVPROC, GetProgramiv);
 OPENGL_PROC(PFNGLGETPROGRAMINFOLOGPROC, GetProgramInfoLog);
@@ -153,6 +159,14 @@ OPENGL_PROC(PFNGLFRAMEBUFFERTEXTURE3DPROC, FramebufferTexture3D);
 OPENGL_PROC(PFNGLFRAMEBUFFERRENDERBUFFERPROC, FramebufferRenderbuffer);
 OPENGL_PROC(PFNGLBLITFRAMEBUFFERPROC, BlitFramebuffer);
 OPENGL_PROC(PFNGLDRAWBUFFERSPROC, DrawBuffers);
+OPENGL_PROC(PFNGLMULTIDRAWARRAYSPROC, MultiDrawArrays);
+
+OPENGL_PROC(PFNGLGENQUERIESPROC, GenQueries);
+OPENGL_PROC(PFNGLDELETEQUERIESPROC, DeleteQueries);
+OPENGL_PROC(PFNGLBEGINQUERYPROC, BeginQuery);
+OPENGL_PROC(PFNGLENDQUERYPROC, EndQuery);
+OPENGL_PROC(PFNGLGETQUERYOBJECTUIVPROC, GetQueryObjectuiv);
+OPENGL_PROC(PFNGLGETQUERYOBJECTUI64VPROC, GetQueryObjectui64v);
 
 OPENGL_PROC(PFNGLENABLEIPROC, Enablei);
 OPENGL_PROC(PFNGLDISABLEIPROC, Disablei);
@@ -165,6 +179,32 @@ OPENGL_PROC(PFNGLCHECKFRAMEBUFFERSTATUSPROC, CheckFramebufferStatus);
 
 
 OPENGL_PROC(PFNGLBINDBUFFERBASEPROC, BindBufferBase);
+OPENGL_PROC(PFNGLBINDBUFFERRANGEPROC, BindBufferRange);
+
+//ARB_sync
+OPENGL_PROC(PFNGLFENCESYNCPROC, FenceSync);
+OPENGL_PROC(PFNGLCLIENTWAITSYNCPROC, ClientWaitSync);
+OPENGL_PROC(PFNGLDELETESYNCPROC, DeleteSync);
+
+//ARB_buffer_storage
+OPENGL_PROC(PFNGLBUFFERSTORAGEPROC, BufferStorage);
+
+//ARB_direct_state_access
+OPENGL_PROC(PFNGLTEXTUREPARAMETERIPROC, TextureParameteri);
+OPENGL_PROC(PFNGLTEXTUREPARAMETERFPROC, TextureParameterf);
+
+//ARB_multi_bind
+OPENGL_PROC(PFNGLBINDTEXTURESPROC, BindTextures);
+
+//ARB_texture_buffer_object
+OPENGL_PROC(PFNGLTEXBUFFERPROC, TexBuffer);
+
+//ARB_compute_shader
+OPENGL_PROC(PFNGLDISPATCHCOMPUTEPROC, DispatchCompute);
+
+//ARB_shader_image_load_store
+OPENGL_PROC(PFNGLBINDIMAGETEXTUREPROC, BindImageTexture);
+OPENGL_PROC(PFNGLMEMORYBARRIERPROC, MemoryBarrier);
 
 //KHR_debug
 OPENGL_PROC(PFNGLDEBUGMESSAGECONTROLARBPROC, DebugMessageControlARB);
@@ -2,6 +2,7 @@
 #include "GLVertexProgram.h"
 #include "GLFragmentProgram.h"
 #include "../Common/ProgramStateCache.h"
+#include "../Common/shader_binary_cache.h"
 
 struct GLTraits
 {
@@ -10,6 +11,9 @@ struct GLTraits
 	using pipeline_storage_type = gl::glsl::program;
 	using pipeline_properties = void*;
 
+	// Shaders are compiled within the GL context of the render thread
+	static const bool parallel_shader_compilation = false;
+
 	static
 	void recompile_fragment_program(const RSXFragmentProgram &RSXFP, fragment_program_type& fragmentProgramData, size_t ID)
 	{
@@ -31,10 +35,28 @@ struct GLTraits
 	}
 
 	static
-	pipeline_storage_type build_pipeline(const vertex_program_type &vertexProgramData, const fragment_program_type &fragmentProgramData, const pipeline_properties &pipelineProperties)
+	pipeline_storage_type build_pipeline(const vertex_program_type &vertexProgramData, const fragment_program_type &fragmentProgramData, const pipeline_properties &pipelineProperties, const std::vector<u8> &cachedBlob, rsx::shader_binary_cache *binaries)
 	{
 		pipeline_storage_type result;
-		__glcheck result.create()
+		__glcheck result.create();
+
+		const bool use_binaries = binaries && binaries->is_open();
+		const u64 key = use_binaries ? binaries->get_key({ &vertexProgramData.shader, &fragmentProgramData.shader }) : 0;
+
+		u32 format;
+		std::vector<u8> binary;
+		if (use_binaries && binaries->find(key, format, binary) && result.load_binary(format, binary))
+		{
+			__glcheck result.use();
+
+			LOG_NOTICE(RSX, "*** prog id = %d (binary cache)", result.id());
+			return result;
+		}
+
+		if (use_binaries)
+			__glcheck result.make_binary_retrievable();
+
+		__glcheck result
 			.attach(gl::glsl::shader_view(vertexProgramData.id))
 			.attach(gl::glsl::shader_view(fragmentProgramData.id))
 			.bind_fragment_data_location("ocol0", 0)
@@ -44,6 +66,14 @@ struct GLTraits
 			.make();
 		__glcheck result.use();
 
+		if (use_binaries)
+		{
+			GLenum binary_format;
+			const std::vector<u8> &data = result.get_binary(binary_format);
+			if (!data.empty())
+				binaries->store(key, binary_format, data.data(), data.size());
+		}
+
 		LOG_NOTICE(RSX, "*** prog id = %d", result.id());
 		LOG_NOTICE(RSX, "*** vp id = %d", vertexProgramData.id);
 		LOG_NOTICE(RSX, "*** fp id = %d", fragmentProgramData.id);
@@ -53,6 +83,24 @@ struct GLTraits
 
 		return result;
 	}
+
+	static
+	void serialize_properties(const pipeline_properties &pipelineProperties, std::vector<u8> &out)
+	{
+	}
+
+	static
+	bool deserialize_properties(const u8 *data, size_t size, pipeline_properties &pipelineProperties)
+	{
+		pipelineProperties = nullptr;
+		return size == 0;
+	}
+
+	static
+	std::vector<u8> get_pipeline_blob(const pipeline_storage_type &pipeline)
+	{
+		return{};
+	}
 };
 
 class GLProgramBuffer : public program_state_cache<GLTraits>
@@ -1,5 +1,6 @@
 #include "stdafx.h"
 #include "Emu/System.h"
+#include "Emu/state.h"
 
 #include "GLVertexProgram.h"
 #include "GLCommonDecompiler.h"
@@ -36,6 +37,12 @@ void GLVertexDecompilerThread::insertHeader(std::stringstream &OS)
 
 void GLVertexDecompilerThread::insertInputs(std::stringstream & OS, const std::vector<ParamType>& inputs)
 {
+	if (m_gpu_vertex_fetch)
+	{
+		insertVertexFetch(OS);
+		return;
+	}
+
 	for (const ParamType PT : inputs)
 	{
 		for (const ParamItem &PI : PT.items)
@@ -43,6 +50,89 @@ void GLVertexDecompilerThread::insertInputs(std::stringstream & OS, const std::v
 	}
 }
 
+/**
+ * Vertex arrays are raw copies of guest memory in a R32UI texture buffer.
+ * input_desc holds byte offset, stride, Vertex_base_type and component count of each input,
+ * inputs with no component are read from input_register (register values).
+ * Conversions match the attribute formats set up by the CPU path.
+ */
+void GLVertexDecompilerThread::insertVertexFetch(std::stringstream & OS)
+{
+	OS << "layout(binding = " << gl::vertex_fetch_texture_unit << ") uniform usamplerBuffer vertex_data_buffer;" << std::endl;
+	OS << "uniform ivec4 input_desc[16];" << std::endl;
+	OS << "uniform vec4 input_register[16];" << std::endl;
+	OS << std::endl;
+	OS << "uint read_byte(int address)" << std::endl;
+	OS << "{" << std::endl;
+	OS << "	return (texelFetch(vertex_data_buffer, address >> 2).x >> ((address & 3) << 3)) & 0xffu;" << std::endl;
+	OS << "}" << std::endl;
+	OS << std::endl;
+	OS << "uint read_be16(int address)" << std::endl;
+	OS << "{" << std::endl;
+	OS << "	return (read_byte(address) << 8) | read_byte(address + 1);" << std::endl;
+	OS << "}" << std::endl;
+	OS << std::endl;
+	OS << "uint read_be32(int address)" << std::endl;
+	OS << "{" << std::endl;
+	OS << "	if ((address & 3) != 0)" << std::endl;
+	OS << "		return (read_be16(address) << 16) | read_be16(address + 2);" << std::endl;
+	OS << "	uint value = texelFetch(vertex_data_buffer, address >> 2).x;" << std::endl;
+	OS << "	return (value << 24) | ((value << 8) & 0xff0000u) | ((value >> 8) & 0xff00u) | (value >> 24);" << std::endl;
+	OS << "}" << std::endl;
+	OS << std::endl;
+	OS << "float snorm16(uint value)" << std::endl;
+	OS << "{" << std::endl;
+	OS << "	return max(float(int(value << 16) >> 16) / 32767., -1.);" << std::endl;
+	OS << "}" << std::endl;
+	OS << std::endl;
+	OS << "vec4 read_input(int index)" << std::endl;
+	OS << "{" << std::endl;
+	OS << "	ivec4 desc = input_desc[index];" << std::endl;
+	OS << "	if (desc.w == 0)" << std::endl;
+	OS << "		return input_register[index];" << std::endl;
+	OS << std::endl;
+	OS << "	int address = desc.x + desc.y * gl_VertexID;" << std::endl;
+	OS << "	vec4 result = vec4(0., 0., 0., 1.);" << std::endl;
+	OS << "	// 3 components 16 bits vectors are padded with 0x3800" << std::endl;
+	OS << "	int count = (desc.z == 0 || desc.z == 2) && desc.w == 3 ? 4 : desc.w;" << std::endl;
+	OS << std::endl;
+	OS << "	for (int i = 0; i < count; ++i)" << std::endl;
+	OS << "	{" << std::endl;
+	OS << "		uint value;" << std::endl;
+	OS << "		switch (desc.z)" << std::endl;
+	OS << "		{" << std::endl;
+	OS << "		case 0: // s1" << std::endl;
+	OS << "			value = i < desc.w ? read_be16(address + i * 2) : 0x3800u;" << std::endl;
+	OS << "			result[i] = snorm16(value);" << std::endl;
+	OS << "			break;" << std::endl;
+	OS << "		case 1: // f" << std::endl;
+	OS << "			result[i] = uintBitsToFloat(read_be32(address + i * 4));" << std::endl;
+	OS << "			break;" << std::endl;
+	OS << "		case 2: // sf" << std::endl;
+	OS << "			value = i < desc.w ? read_be16(address + i * 2) : 0x3800u;" << std::endl;
+	OS << "			result[i] = unpackHalf2x16(value).x;" << std::endl;
+	OS << "			break;" << std::endl;
+	OS << "		case 3: // ub" << std::endl;
+	OS << "			result[i] = float(read_byte(address + i)) / 255.;" << std::endl;
+	OS << "			break;" << std::endl;
+	OS << "		case 4: // s32k" << std::endl;
+	OS << "			result[i] = float(int(read_be32(address + i * 4)));" << std::endl;
+	OS << "			break;" << std::endl;
+	OS << "		case 5: // cmp" << std::endl;
+	OS << "			value = read_be32(address);" << std::endl;
+	OS << "			value = i == 0 ? (value & 0x7ffu) << 5 : i == 1 ? ((value >> 11) & 0x7ffu) << 5 : i == 2 ? (value >> 22) << 6 : 1u;" << std::endl;
+	OS << "			result[i] = snorm16(value);" << std::endl;
+	OS << "			break;" << std::endl;
+	OS << "		case 6: // ub256" << std::endl;
+	OS << "			result[i] = float(read_byte(address + i));" << std::endl;
+	OS << "			break;" << std::endl;
+	OS << "		}" << std::endl;
+	OS << "	}" << std::endl;
+	OS << std::endl;
+	OS << "	return result;" << std::endl;
+	OS << "}" << std::endl;
+}
+
 void GLVertexDecompilerThread::insertConstants(std::stringstream & OS, const std::vector<ParamType> & constants)
 {
 	OS << "layout(std140, binding = 1) uniform VertexConstantsBuffer" << std::endl;
@@ -107,6 +197,20 @@ void GLVertexDecompilerThread::insertMainStart(std::stringstream & OS)
 	OS << "void main()" << std::endl;
 	OS << "{" << std::endl;
 
+	if (m_gpu_vertex_fetch)
+	{
+		for (const ParamType PT : m_parr.params[PF_PARAM_IN])
+		{
+			for (const ParamItem &PI : PT.items)
+			{
+				if (PI.location < 16)
+					OS << "	vec4 " << PI.name << " = read_input(" << PI.location << ");" << std::endl;
+				else
+					OS << "	vec4 " << PI.name << " = vec4(0., 0., 0., 1.);" << std::endl;
+			}
+		}
+	}
+
 	// Declare inside main function
 	for (const ParamType PT : m_parr.params[PF_PARAM_NONE])
 	{
@@ -168,7 +272,7 @@ GLVertexProgram::~GLVertexProgram()
 
 void GLVertexProgram::Decompile(const RSXVertexProgram& prog)
 {
-	GLVertexDecompilerThread decompiler(prog, shader, parr);
+	GLVertexDecompilerThread decompiler(prog, shader, parr, rpcs3::state.config.rsx.opengl.gpu_vertex_fetch.value());
 	decompiler.Task();
 }
 
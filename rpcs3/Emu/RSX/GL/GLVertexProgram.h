@@ -4,9 +4,16 @@
 #include "Utilities/Thread.h"
 #include "OpenGL.h"
 
+namespace gl
+{
+	// Texture unit of the vertex data buffer when vertex arrays are fetched by the vertex shader (after the 16 fragment textures)
+	const int vertex_fetch_texture_unit = 16;
+}
+
 struct GLVertexDecompilerThread : public VertexProgramDecompiler
 {
 	std::string &m_shader;
+	bool m_gpu_vertex_fetch;
 protected:
 	virtual std::string getFloatTypeName(size_t elementCount) override;
 	std::string getIntTypeName(size_t elementCount) override;
@@ -19,10 +26,13 @@ protected:
 	virtual void insertOutputs(std::stringstream &OS, const std::vector<ParamType> &outputs) override;
 	virtual void insertMainStart(std::stringstream &OS) override;
 	virtual void insertMainEnd(std::stringstream &OS) override;
+
+	void insertVertexFetch(std::stringstream &OS);
 public:
-	GLVertexDecompilerThread(const RSXVertexProgram &prog, std::string& shader, ParamArray& parr)
+	GLVertexDecompilerThread(const RSXVertexProgram &prog, std::string& shader, ParamArray& parr, bool gpu_vertex_fetch = false)
 		: VertexProgramDecompiler(prog)
 		, m_shader(shader)
+		, m_gpu_vertex_fetch(gpu_vertex_fetch)
 	{
 	}
 
@@ -12,6 +12,7 @@
 
 #include "OpenGL.h"
 #include "../GCM.h"
+#include "Emu/PerfCounters.h"
 
 namespace gl
 {
@@ -371,7 +372,9 @@ namespace gl
 			pixel_pack = GL_PIXEL_PACK_BUFFER,
 			pixel_unpack = GL_PIXEL_UNPACK_BUFFER,
 			array = GL_ARRAY_BUFFER,
-			element_array = GL_ELEMENT_ARRAY_BUFFER
+			element_array = GL_ELEMENT_ARRAY_BUFFER,
+			uniform = GL_UNIFORM_BUFFER,
+			texture = GL_TEXTURE_BUFFER
 		};
 		enum class access
 		{
@@ -419,6 +422,7 @@ namespace gl
 				case target::pixel_unpack: pname = GL_PIXEL_UNPACK_BUFFER_BINDING; break;
 				case target::array: pname = GL_ARRAY_BUFFER_BINDING; break;
 				case target::element_array: pname = GL_ELEMENT_ARRAY_BUFFER_BINDING; break;
+				case target::uniform: pname = GL_UNIFORM_BUFFER_BINDING; break;
 				}
 
 				glGetIntegerv(pname, &m_last_binding);
@@ -567,6 +571,239 @@ namespace gl
 		}
 	};
 
+	//Streaming buffer sub-allocated linearly and wrapped around when full.
+	//Storage is split in segments; a fence is inserted when the write head leaves a segment
+	//and waited on before the segment is reused, so the GPU never reads memory being overwritten.
+	//Uses a persistent coherent mapping (ARB_buffer_storage) when available,
+	//otherwise maps each allocation unsynchronized and must be unmap()'ed before drawing.
+	class ring_buffer
+	{
+		static const int segment_count = 4;
+
+		buffer m_buffer;
+		buffer::target m_target = buffer::target::array;
+		GLsizeiptr m_size = 0;
+		GLsizeiptr m_position = 0;
+		int m_segment = 0;
+		GLubyte* m_persistent_ptr = nullptr;
+		bool m_mapped = false;
+		GLsync m_fences[segment_count] = {};
+		u64 m_serial = 0;
+
+		GLsizeiptr segment_size() const
+		{
+			return m_size / segment_count;
+		}
+
+		int segment_of(GLsizeiptr offset) const
+		{
+			return std::min(int(offset / segment_size()), segment_count - 1);
+		}
+
+		void fence(int segment)
+		{
+			if (!m_fences[segment])
+			{
+				m_fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			}
+		}
+
+		void wait(int segment)
+		{
+			if (GLsync sync = m_fences[segment])
+			{
+				GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+
+				while (true)
+				{
+					GLenum result = glClientWaitSync(sync, flags, 1000000000);
+
+					if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED)
+						break;
+
+					if (result == GL_WAIT_FAILED)
+						throw EXCEPTION("glClientWaitSync() failed");
+
+					flags = 0;
+				}
+
+				glDeleteSync(sync);
+				m_fences[segment] = nullptr;
+			}
+		}
+
+	public:
+		ring_buffer() = default;
+		ring_buffer(const ring_buffer&) = delete;
+
+		~ring_buffer()
+		{
+			if (created())
+				remove();
+		}
+
+		static bool is_persistent_mapping_supported()
+		{
+			return glBufferStorage != nullptr;
+		}
+
+		void create(buffer::target target_, GLsizeiptr size)
+		{
+			m_target = target_;
+			m_size = align(size, segment_count * 256);
+			m_position = 0;
+			m_segment = 0;
+			m_serial++;
+
+			m_buffer.create();
+			m_buffer.bind(m_target);
+
+			if (is_persistent_mapping_supported())
+			{
+				const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+				glBufferStorage((GLenum)m_target, m_size, nullptr, flags);
+				m_persistent_ptr = (GLubyte*)glMapBufferRange((GLenum)m_target, 0, m_size, flags);
+			}
+			else
+			{
+				glBufferData((GLenum)m_target, m_size, nullptr, GL_STREAM_DRAW);
+			}
+
+			perf::mem_add(perf::mem_gpu_heaps, m_size);
+		}
+
+		void remove()
+		{
+			for (auto &sync : m_fences)
+			{
+				if (sync)
+				{
+					glDeleteSync(sync);
+					sync = nullptr;
+				}
+			}
+
+			if (m_persistent_ptr || m_mapped)
+			{
+				m_buffer.bind(m_target);
+				glUnmapBuffer((GLenum)m_target);
+				m_persistent_ptr = nullptr;
+				m_mapped = false;
+			}
+
+			m_buffer.remove();
+			perf::mem_add(perf::mem_gpu_heaps, -s64(m_size));
+			m_size = 0;
+		}
+
+		//Returns a writable pointer and its offset in the buffer
+		std::pair<void*, u32> alloc_and_map(GLsizeiptr size, GLsizeiptr alignment = 16)
+		{
+			if (size > m_size)
+			{
+				throw EXCEPTION("Allocation of 0x%llx bytes exceeds ring buffer size (0x%llx)", (u64)size, (u64)m_size);
+			}
+
+			GLsizeiptr offset = align(m_position, alignment);
+			int first_segment = segment_of(offset);
+
+			if (offset + size > m_size)
+			{
+				offset = 0;
+				first_segment = 0;
+				m_serial++;
+			}
+
+			//all commands referencing the segments left behind have been issued by now
+			if (first_segment != m_segment)
+			{
+				for (int segment = m_segment; segment != first_segment; segment = (segment + 1) % segment_count)
+				{
+					fence(segment);
+				}
+
+				m_segment = first_segment;
+				m_serial++;
+			}
+
+			if (size)
+			{
+				for (int segment = first_segment, last = segment_of(offset + size - 1); segment <= last; ++segment)
+				{
+					wait(segment);
+				}
+			}
+
+			m_position = offset + size;
+
+			if (m_persistent_ptr)
+			{
+				return{ m_persistent_ptr + offset, (u32)offset };
+			}
+
+			m_buffer.bind(m_target);
+			void *ptr = glMapBufferRange((GLenum)m_target, offset, std::max<GLsizeiptr>(size, 1),
+				GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+			m_mapped = true;
+
+			return{ ptr, (u32)offset };
+		}
+
+		//No-op for persistent mappings
+		void unmap()
+		{
+			if (m_mapped)
+			{
+				m_buffer.bind(m_target);
+				glUnmapBuffer((GLenum)m_target);
+				m_mapped = false;
+			}
+		}
+
+		void bind() const
+		{
+			m_buffer.bind(m_target);
+		}
+
+		void bind_range(GLuint index, u32 offset, GLsizeiptr size) const
+		{
+			glBindBufferRange((GLenum)m_target, index, m_buffer.id(), offset, size);
+		}
+
+		//Changes whenever the ring leaves its current segment. Data written with the same serial
+		//is neither overwritten nor fenced yet, so later commands can keep referencing it.
+		u64 serial() const
+		{
+			return m_serial;
+		}
+
+		GLsizeiptr size() const
+		{
+			return m_size;
+		}
+
+		uint id() const
+		{
+			return m_buffer.id();
+		}
+
+		bool created() const
+		{
+			return m_buffer.created();
+		}
+
+		explicit operator bool() const
+		{
+			return created();
+		}
+
+		operator const buffer&() const
+		{
+			return m_buffer;
+		}
+	};
+
 	class vao
 	{
 		template<buffer::target BindId, uint GetStateId>
@@ -830,7 +1067,8 @@ namespace gl
 		{
 			texture1D = GL_TEXTURE_1D,
 			texture2D = GL_TEXTURE_2D,
-			texture3D = GL_TEXTURE_3D
+			texture3D = GL_TEXTURE_3D,
+			textureBuffer = GL_TEXTURE_BUFFER
 		};
 
 		enum class channel_type
@@ -1562,6 +1800,278 @@ namespace gl
 
 	extern const fbo screen;
 
+	/**
+	* Shadow copy of fixed function state: calls setting the value already set are not forwarded to GL.
+	* All state changes must go through it (or be followed by invalidate()) for the copy to stay valid.
+	*/
+	class state_cache
+	{
+	public:
+		enum class slot : u32
+		{
+			color_mask,
+			depth_mask,
+			stencil_mask,
+			depth_func,
+			depth_range,
+			depth_bounds,
+			blend_func,
+			blend_color,
+			blend_equation,
+			stencil_func,
+			stencil_op,
+			back_stencil_mask,
+			back_stencil_func,
+			back_stencil_op,
+			shade_model,
+			logic_op,
+			line_width,
+			polygon_offset,
+			front_polygon_mode,
+			back_polygon_mode,
+			cull_face,
+			front_face,
+			restart_index,
+			line_stipple,
+			viewport,
+			scissor,
+
+			count
+		};
+
+	private:
+		struct value_t
+		{
+			u32 data[4];
+			bool valid;
+		};
+
+		value_t m_values[(u32)slot::count];
+		std::unordered_map<u64, bool> m_caps; // (index << 32 | cap) -> enabled
+
+		// Returns true if the value changed (and records it)
+		bool update(slot s, u32 v0, u32 v1 = 0, u32 v2 = 0, u32 v3 = 0)
+		{
+			value_t& value = m_values[(u32)s];
+
+			if (value.valid && value.data[0] == v0 && value.data[1] == v1 && value.data[2] == v2 && value.data[3] == v3)
+			{
+				elided_calls++;
+				return false;
+			}
+
+			value.data[0] = v0;
+			value.data[1] = v1;
+			value.data[2] = v2;
+			value.data[3] = v3;
+			value.valid = true;
+			return true;
+		}
+
+		bool update_cap(u64 key, bool enabled)
+		{
+			auto found = m_caps.find(key);
+
+			if (found != m_caps.end() && found->second == enabled)
+			{
+				elided_calls++;
+				return false;
+			}
+
+			m_caps[key] = enabled;
+			return true;
+		}
+
+		static u32 bits(f32 value)
+		{
+			return (u32&)value;
+		}
+
+	public:
+		u64 elided_calls = 0;
+
+		state_cache()
+		{
+			invalidate();
+		}
+
+		// Forget all values, the next calls are forwarded to GL
+		void invalidate()
+		{
+			for (auto& value : m_values)
+			{
+				value.valid = false;
+			}
+
+			m_caps.clear();
+		}
+
+		// Returns condition, so the dependent state can be set in the same if
+		u32 enable(u32 condition, GLenum cap)
+		{
+			if (update_cap(cap, !!condition))
+			{
+				condition ? glEnable(cap) : glDisable(cap);
+
+				// Sets the indexed states too
+				for (auto it = m_caps.begin(); it != m_caps.end();)
+				{
+					it = (it->first >> 32) && (u32)it->first == cap ? m_caps.erase(it) : std::next(it);
+				}
+			}
+
+			return condition;
+		}
+
+		u32 enable(u32 condition, GLenum cap, GLuint index)
+		{
+			if (update_cap((u64)(index + 1) << 32 | cap, !!condition))
+			{
+				condition ? glEnablei(cap, index) : glDisablei(cap, index);
+			}
+
+			return condition;
+		}
+
+		void color_mask(bool r, bool g, bool b, bool a)
+		{
+			if (update(slot::color_mask, r | g << 1 | b << 2 | a << 3)) glColorMask(r, g, b, a);
+		}
+
+		void depth_mask(GLboolean mask)
+		{
+			if (update(slot::depth_mask, !!mask)) glDepthMask(mask);
+		}
+
+		// Stencil functions without face set the back face state too
+		void stencil_mask(GLuint mask)
+		{
+			if (update(slot::stencil_mask, mask))
+			{
+				glStencilMask(mask);
+				m_values[(u32)slot::back_stencil_mask].valid = false;
+			}
+		}
+
+		void depth_func(GLenum func)
+		{
+			if (update(slot::depth_func, func)) glDepthFunc(func);
+		}
+
+		void depth_range(f32 min, f32 max)
+		{
+			if (update(slot::depth_range, bits(min), bits(max))) glDepthRange(min, max);
+		}
+
+		void depth_bounds(f32 min, f32 max)
+		{
+			if (update(slot::depth_bounds, bits(min), bits(max))) glDepthBoundsEXT(min, max);
+		}
+
+		void blend_func(GLenum sfactor_rgb, GLenum dfactor_rgb, GLenum sfactor_a, GLenum dfactor_a)
+		{
+			if (update(slot::blend_func, sfactor_rgb, dfactor_rgb, sfactor_a, dfactor_a)) glBlendFuncSeparate(sfactor_rgb, dfactor_rgb, sfactor_a, dfactor_a);
+		}
+
+		void blend_color(f32 r, f32 g, f32 b, f32 a)
+		{
+			if (update(slot::blend_color, bits(r), bits(g), bits(b), bits(a))) glBlendColor(r, g, b, a);
+		}
+
+		void blend_equation(GLenum rgb, GLenum a)
+		{
+			if (update(slot::blend_equation, rgb, a)) glBlendEquationSeparate(rgb, a);
+		}
+
+		void stencil_func(GLenum func, GLint ref, GLuint mask)
+		{
+			if (update(slot::stencil_func, func, ref, mask))
+			{
+				glStencilFunc(func, ref, mask);
+				m_values[(u32)slot::back_stencil_func].valid = false;
+			}
+		}
+
+		void stencil_op(GLenum fail, GLenum zfail, GLenum zpass)
+		{
+			if (update(slot::stencil_op, fail, zfail, zpass))
+			{
+				glStencilOp(fail, zfail, zpass);
+				m_values[(u32)slot::back_stencil_op].valid = false;
+			}
+		}
+
+		void back_stencil_mask(GLuint mask)
+		{
+			if (update(slot::back_stencil_mask, mask)) glStencilMaskSeparate(GL_BACK, mask);
+		}
+
+		void back_stencil_func(GLenum func, GLint ref, GLuint mask)
+		{
+			if (update(slot::back_stencil_func, func, ref, mask)) glStencilFuncSeparate(GL_BACK, func, ref, mask);
+		}
+
+		void back_stencil_op(GLenum fail, GLenum zfail, GLenum zpass)
+		{
+			if (update(slot::back_stencil_op, fail, zfail, zpass)) glStencilOpSeparate(GL_BACK, fail, zfail, zpass);
+		}
+
+		void shade_model(GLenum mode)
+		{
+			if (update(slot::shade_model, mode)) glShadeModel(mode);
+		}
+
+		void logic_op(GLenum op)
+		{
+			if (update(slot::logic_op, op)) glLogicOp(op);
+		}
+
+		void line_width(f32 width)
+		{
+			if (update(slot::line_width, bits(width))) glLineWidth(width);
+		}
+
+		void polygon_offset(f32 factor, f32 units)
+		{
+			if (update(slot::polygon_offset, bits(factor), bits(units))) glPolygonOffset(factor, units);
+		}
+
+		void polygon_mode(GLenum face, GLenum mode)
+		{
+			if (update(face == GL_FRONT ? slot::front_polygon_mode : slot::back_polygon_mode, mode)) glPolygonMode(face, mode);
+		}
+
+		void cull_face(GLenum mode)
+		{
+			if (update(slot::cull_face, mode)) glCullFace(mode);
+		}
+
+		void front_face(GLenum mode)
+		{
+			if (update(slot::front_face, mode)) glFrontFace(mode);
+		}
+
+		void primitive_restart_index(GLuint index)
+		{
+			if (update(slot::restart_index, index)) glPrimitiveRestartIndex(index);
+		}
+
+		void line_stipple(GLint factor, GLushort pattern)
+		{
+			if (update(slot::line_stipple, factor, pattern)) glLineStipple(factor, pattern);
+		}
+
+		void viewport(GLint x, GLint y, GLsizei w, GLsizei h)
+		{
+			if (update(slot::viewport, x, y, w, h)) glViewport(x, y, w, h);
+		}
+
+		void scissor(GLint x, GLint y, GLsizei w, GLsizei h)
+		{
+			if (update(slot::scissor, x, y, w, h)) glScissor(x, y, w, h);
+		}
+	};
+
 	namespace glsl
 	{
 		class compilation_exception : public exception
@@ -1609,7 +2119,8 @@ namespace gl
 			{
 				fragment = GL_FRAGMENT_SHADER,
 				vertex = GL_VERTEX_SHADER,
-				geometry = GL_GEOMETRY_SHADER
+				geometry = GL_GEOMETRY_SHADER,
+				compute = GL_COMPUTE_SHADER
 			};
 
 			shader() = default;
@@ -2074,6 +2585,46 @@ namespace gl
 				validate();
 			}
 
+			static bool binaries_supported()
+			{
+				GLint formats = 0;
+				if (glProgramBinary && glGetProgramBinary && glProgramParameteri)
+					glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+				return formats > 0;
+			}
+
+			/**
+			* Ask the driver to keep the linked binary available for get_binary(), must be called before link().
+			*/
+			program& make_binary_retrievable()
+			{
+				glProgramParameteri(m_id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+				return *this;
+			}
+
+			/**
+			* Link from a binary returned by get_binary(), fails if the driver rejects it (the program can still be linked from shaders).
+			*/
+			bool load_binary(GLenum format, const std::vector<u8>& data)
+			{
+				glProgramBinary(m_id, format, data.data(), gsl::narrow<GLsizei>(data.size()));
+
+				GLint status = GL_FALSE;
+				glGetProgramiv(m_id, GL_LINK_STATUS, &status);
+				return status != GL_FALSE;
+			}
+
+			std::vector<u8> get_binary(GLenum& format) const
+			{
+				GLint length = 0;
+				glGetProgramiv(m_id, GL_PROGRAM_BINARY_LENGTH, &length);
+
+				std::vector<u8> result(length);
+				if (length)
+					glGetProgramBinary(m_id, length, nullptr, &format, result.data());
+				return result;
+			}
+
 			uint id() const
 			{
 				return m_id;
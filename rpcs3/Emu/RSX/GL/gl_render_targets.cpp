@@ -0,0 +1,174 @@
+#include "stdafx.h"
+#include "Emu/Memory/Memory.h"
+#include "gl_render_targets.h"
+
+color_format surface_color_format_to_gl(Surface_color_format color_format)
+{
+	//color format
+	switch (color_format)
+	{
+	case Surface_color_format::r5g6b5:
+		return{ gl::texture::type::ushort_5_6_5, gl::texture::format::bgr, false, 3, 2 };
+
+	case Surface_color_format::a8r8g8b8:
+		return{ gl::texture::type::uint_8_8_8_8, gl::texture::format::bgra, false, 4, 1 };
+
+	case Surface_color_format::x8r8g8b8_o8r8g8b8:
+		return{ gl::texture::type::uint_8_8_8_8, gl::texture::format::bgra, false, 4, 1,
+		{ gl::texture::channel::one, gl::texture::channel::r, gl::texture::channel::g, gl::texture::channel::b } };
+
+	case Surface_color_format::w16z16y16x16:
+		return{ gl::texture::type::f16, gl::texture::format::rgba, true, 4, 2 };
+
+	case Surface_color_format::w32z32y32x32:
+		return{ gl::texture::type::f32, gl::texture::format::rgba, true, 4, 4 };
+
+	case Surface_color_format::b8:
+	case Surface_color_format::x1r5g5b5_o1r5g5b5:
+	case Surface_color_format::x1r5g5b5_z1r5g5b5:
+	case Surface_color_format::x8r8g8b8_z8r8g8b8:
+	case Surface_color_format::g8b8:
+	case Surface_color_format::x32:
+	case Surface_color_format::x8b8g8r8_o8b8g8r8:
+	case Surface_color_format::x8b8g8r8_z8b8g8r8:
+	case Surface_color_format::a8b8g8r8:
+	default:
+		LOG_ERROR(RSX, "Surface color buffer: Unsupported surface color format (0x%x)", color_format);
+		return{ gl::texture::type::uint_8_8_8_8, gl::texture::format::bgra, false, 4, 1 };
+	}
+}
+
+std::pair<gl::texture::type, gl::texture::format> surface_depth_format_to_gl(Surface_depth_format depth_format)
+{
+	switch (depth_format)
+	{
+	case Surface_depth_format::z16:
+		return std::make_pair(gl::texture::type::ushort, gl::texture::format::depth);
+
+	default:
+		LOG_ERROR(RSX, "Surface depth buffer: Unsupported surface depth format (0x%x)", depth_format);
+	case Surface_depth_format::z24s8:
+		return std::make_pair(gl::texture::type::uint_24_8, gl::texture::format::depth_stencil);
+		//return std::make_pair(gl::texture::type::f32, gl::texture::format::depth);
+	}
+}
+
+u32 gl_render_target_traits::resolution_scale = 100;
+
+std::unique_ptr<gl::render_target> gl_render_target_traits::create_new_surface(
+	u32 address,
+	Surface_color_format surface_color_format, size_t width, size_t height, u32 scale_percent)
+{
+	LOG_WARNING(RSX, "Creating RTT @0x%x (%dx%d)", address, (u32)width, (u32)height);
+
+	const sizei host_size{ std::max((int)width * (int)scale_percent / 100, 1), std::max((int)height * (int)scale_percent / 100, 1) };
+
+	auto format = surface_color_format_to_gl(surface_color_format);
+
+	std::unique_ptr<gl::render_target> rtt(new gl::render_target());
+	rtt->color_format = surface_color_format;
+	rtt->address = address;
+	rtt->surface_width = (u16)width;
+	rtt->surface_height = (u16)height;
+
+	rtt->recreate(gl::texture::target::texture2D);
+	__glcheck rtt->config()
+		.size(host_size)
+		.type(format.type)
+		.format(format.format)
+		.swizzle(format.swizzle.r, format.swizzle.g, format.swizzle.b, format.swizzle.a);
+
+	__glcheck rtt->pixel_pack_settings().swap_bytes(format.swap_bytes).aligment(1);
+	__glcheck rtt->pixel_unpack_settings().swap_bytes(format.swap_bytes).aligment(1);
+
+	return rtt;
+}
+
+std::unique_ptr<gl::render_target> gl_render_target_traits::create_new_surface(
+	u32 address,
+	Surface_depth_format surface_depth_format, size_t width, size_t height, u32 scale_percent)
+{
+	LOG_WARNING(RSX, "Creating DS @0x%x (%dx%d)", address, (u32)width, (u32)height);
+
+	const sizei host_size{ std::max((int)width * (int)scale_percent / 100, 1), std::max((int)height * (int)scale_percent / 100, 1) };
+
+	std::unique_ptr<gl::render_target> ds(new gl::render_target());
+	ds->is_depth = true;
+	ds->depth_format = surface_depth_format;
+	ds->address = address;
+	ds->surface_width = (u16)width;
+	ds->surface_height = (u16)height;
+
+	ds->recreate(gl::texture::target::texture2D);
+
+	switch (surface_depth_format)
+	{
+	case Surface_depth_format::z16:
+		__glcheck ds->config()
+			.size(host_size)
+			.type(gl::texture::type::ushort)
+			.format(gl::texture::format::depth)
+			.internal_format(gl::texture::internal_format::depth16);
+		break;
+
+	default:
+		LOG_ERROR(RSX, "Bad depth format! (%d)", surface_depth_format);
+	case Surface_depth_format::z24s8:
+		__glcheck ds->config()
+			.size(host_size)
+			.type(gl::texture::type::uint_24_8)
+			.format(gl::texture::format::depth_stencil)
+			.internal_format(gl::texture::internal_format::depth24_stencil8);
+		break;
+	}
+
+	__glcheck ds->pixel_pack_settings().aligment(1);
+	__glcheck ds->pixel_unpack_settings().aligment(1);
+
+	return ds;
+}
+
+void gl_render_targets::protect(gl::render_target &surface, u8 flags_clear)
+{
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+
+	if (surface.protection)
+	{
+		vm::page_protect(surface.protected_start, surface.protected_size, 0, vm::page_readable | vm::page_writable, 0);
+		surface.protection = 0;
+	}
+
+	if (!flags_clear || !surface.memory_size)
+	{
+		return;
+	}
+
+	surface.protected_start = surface.address & ~0xfff;
+	surface.protected_size = align(surface.address + surface.memory_size, 4096) - surface.protected_start;
+
+	if (vm::page_protect(surface.protected_start, surface.protected_size, 0, 0, flags_clear))
+	{
+		surface.protection = flags_clear;
+	}
+}
+
+void gl_render_targets::clear()
+{
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+
+	for_each([this](gl::render_target &surface)
+	{
+		protect(surface, 0);
+	});
+
+	for (auto &surface : invalidated_resources)
+	{
+		protect(*surface, 0);
+	}
+
+	m_render_targets_storage.clear();
+	m_depth_stencil_storage.clear();
+	m_bound_render_targets = {};
+	m_bound_depth_stencil = {};
+	invalidated_resources.clear();
+}
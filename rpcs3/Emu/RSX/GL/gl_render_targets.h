@@ -0,0 +1,160 @@
+#pragma once
+#include "gl_helpers.h"
+#include "../Common/surface_store.h"
+
+#include <mutex>
+
+struct color_swizzle
+{
+	gl::texture::channel a = gl::texture::channel::a;
+	gl::texture::channel r = gl::texture::channel::r;
+	gl::texture::channel g = gl::texture::channel::g;
+	gl::texture::channel b = gl::texture::channel::b;
+
+	color_swizzle() = default;
+	color_swizzle(gl::texture::channel a, gl::texture::channel r, gl::texture::channel g, gl::texture::channel b)
+		: a(a), r(r), g(g), b(b)
+	{
+	}
+};
+
+struct color_format
+{
+	gl::texture::type type;
+	gl::texture::format format;
+	bool swap_bytes;
+	int channel_count;
+	int channel_size;
+	color_swizzle swizzle;
+};
+
+color_format surface_color_format_to_gl(Surface_color_format color_format);
+std::pair<gl::texture::type, gl::texture::format> surface_depth_format_to_gl(Surface_depth_format depth_format);
+
+namespace gl
+{
+	/**
+	* Color or depth surface kept on the GPU between draws.
+	* Guest memory is only synchronized when something else touches its range:
+	* - is_dirty: rendered content isn't in guest memory yet, the range is not accessible.
+	* - needs_upload: guest memory was written since the last synchronization.
+	* - otherwise both copies match and the range is write protected.
+	*/
+	class render_target : public texture
+	{
+	public:
+		bool is_depth = false;
+		Surface_color_format color_format = Surface_color_format::a8r8g8b8;
+		Surface_depth_format depth_format = Surface_depth_format::z24s8;
+
+		// Guest size, the texture itself is scaled by the internal resolution scale
+		u16 surface_width = 0;
+		u16 surface_height = 0;
+
+		u32 address = 0;
+		u32 offset = 0;
+		u32 location = 0;
+		u32 pitch = 0;
+		u32 memory_size = 0;
+
+		bool is_dirty = false;
+		bool needs_upload = true;
+
+		u32 protected_start = 0;
+		u32 protected_size = 0;
+		u8 protection = 0; // cleared vm page flags
+
+		// Decoded tile configuration of offset and location, valid while tiled_version matches rsx::thread::tiles_version
+		rsx::tiled_region tiled = {};
+		u32 tiled_offset = 0;
+		u32 tiled_location = 0;
+		u32 tiled_version = UINT32_MAX;
+
+		bool is_scaled() const
+		{
+			return width() != surface_width || height() != surface_height;
+		}
+
+		bool overlaps(u32 start, u32 size) const
+		{
+			return protection && protected_start < start + size && start < protected_start + protected_size;
+		}
+	};
+}
+
+struct gl_render_target_traits
+{
+	using surface_storage_type = std::unique_ptr<gl::render_target>;
+	using surface_type = gl::render_target*;
+	using command_list_type = void*;
+
+	// Internal resolution scale of new surfaces in percent, 100 renders at the guest resolution
+	static u32 resolution_scale;
+
+	static int scale(int value)
+	{
+		return value * (int)resolution_scale / 100;
+	}
+
+	static
+	gl::render_target* get(const std::unique_ptr<gl::render_target> &surface)
+	{
+		return surface.get();
+	}
+
+	static
+	std::unique_ptr<gl::render_target> create_new_surface(
+		u32 address,
+		Surface_color_format surface_color_format, size_t width, size_t height, u32 scale_percent = resolution_scale);
+
+	static
+	std::unique_ptr<gl::render_target> create_new_surface(
+		u32 address,
+		Surface_depth_format surface_depth_format, size_t width, size_t height, u32 scale_percent = resolution_scale);
+
+	static void prepare_rtt_for_drawing(void*, gl::render_target*) {}
+	static void prepare_rtt_for_sampling(void*, gl::render_target*) {}
+	static void prepare_ds_for_drawing(void*, gl::render_target*) {}
+	static void prepare_ds_for_sampling(void*, gl::render_target*) {}
+
+	static
+	bool rtt_has_format_width_height(const std::unique_ptr<gl::render_target> &rtt, Surface_color_format surface_color_format, size_t width, size_t height)
+	{
+		return rtt->color_format == surface_color_format && rtt->surface_width == width && rtt->surface_height == height;
+	}
+
+	static
+	bool ds_has_format_width_height(const std::unique_ptr<gl::render_target> &ds, Surface_depth_format surface_depth_stencil_format, size_t width, size_t height)
+	{
+		return ds->depth_format == surface_depth_stencil_format && ds->surface_width == width && ds->surface_height == height;
+	}
+};
+
+struct gl_render_targets : public rsx::surface_store<gl_render_target_traits>
+{
+	/**
+	* Mutex protecting surfaces state.
+	* Memory protection fault can be generated by any thread and modifies it.
+	*/
+	std::recursive_mutex mutex;
+
+	template<typename F>
+	void for_each(F func)
+	{
+		for (auto &rtt : m_render_targets_storage)
+			func(*rtt.second);
+
+		for (auto &ds : m_depth_stencil_storage)
+			func(*ds.second);
+	}
+
+	/**
+	* Set guest memory protection of surface range (flags_clear = 0 unprotects it).
+	*/
+	void protect(gl::render_target &surface, u8 flags_clear);
+
+	/**
+	* Unprotect memory and delete all surfaces (must be called from the GL thread).
+	*/
+	void clear();
+};
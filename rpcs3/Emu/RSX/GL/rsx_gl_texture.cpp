@@ -1,10 +1,12 @@
 #include "stdafx.h"
 #include "rsx_gl_texture.h"
 #include "gl_helpers.h"
+#include "Emu/PerfCounters.h"
 #include "../GCM.h"
 #include "../RSXThread.h"
 #include "../RSXTexture.h"
 #include "../rsx_utils.h"
+#include "../Common/TextureUtils.h"
 
 namespace rsx
 {
@@ -89,6 +91,36 @@ namespace rsx
 			return 1.0f;
 		}
 
+		// Get component remap table for the format (in ARGB order)
+		static const GLint* get_remap_table(u32 format)
+		{
+			static const GLint glRemapStandard[4] = { GL_ALPHA, GL_RED, GL_GREEN, GL_BLUE };
+			static const GLint swizzleMaskB8[] = { GL_BLUE, GL_BLUE, GL_BLUE, GL_BLUE };
+			static const GLint swizzleMaskA4R4G4B4[] = { GL_BLUE, GL_ALPHA, GL_RED, GL_GREEN };
+			static const GLint swizzleMaskG8B8[] = { GL_RED, GL_GREEN, GL_RED, GL_GREEN };
+			static const GLint swizzleMaskX16[] = { GL_RED, GL_ONE, GL_RED, GL_ONE };
+			static const GLint swizzleMaskX32_Y16_X16[] = { GL_GREEN, GL_RED, GL_GREEN, GL_RED };
+			static const GLint swizzleMaskX32_FLOAT[] = { GL_RED, GL_ONE, GL_ONE, GL_ONE };
+			static const GLint swizzleMaskX32_D1R5G5B5[] = { GL_ONE, GL_RED, GL_GREEN, GL_BLUE };
+			static const GLint swizzleMaskX32_D8R8G8B8[] = { GL_ONE, GL_RED, GL_GREEN, GL_BLUE };
+			static const GLint swizzleMaskX32_Y16_X16_FLOAT[] = { GL_RED, GL_GREEN, GL_RED, GL_GREEN };
+
+			switch (format)
+			{
+			case CELL_GCM_TEXTURE_B8: return swizzleMaskB8;
+			case CELL_GCM_TEXTURE_A4R4G4B4: return swizzleMaskA4R4G4B4;
+			case CELL_GCM_TEXTURE_G8B8: return swizzleMaskG8B8;
+			case CELL_GCM_TEXTURE_X16: return swizzleMaskX16;
+			case CELL_GCM_TEXTURE_Y16_X16: return swizzleMaskX32_Y16_X16;
+			case CELL_GCM_TEXTURE_X32_FLOAT: return swizzleMaskX32_FLOAT;
+			case CELL_GCM_TEXTURE_D1R5G5B5: return swizzleMaskX32_D1R5G5B5;
+			case CELL_GCM_TEXTURE_D8R8G8B8: return swizzleMaskX32_D8R8G8B8;
+			case CELL_GCM_TEXTURE_Y16_X16_FLOAT: return swizzleMaskX32_Y16_X16_FLOAT;
+			}
+
+			return glRemapStandard;
+		}
+
 		void texture::init(int index, rsx::texture& tex)
 		{
 			if (!m_id)
@@ -99,6 +131,14 @@ namespace rsx
 			glActiveTexture(GL_TEXTURE0 + index);
 			bind();
 
+			upload(tex);
+			set_parameters(tex);
+		}
+
+		void texture::upload(rsx::texture& tex)
+		{
+			perf::add(perf::texture_uploads);
+
 			const u32 texaddr = rsx::get_address(tex.offset(), tex.location());
 			//LOG_WARNING(RSX, "texture addr = 0x%x, width = %d, height = %d, max_aniso=%d, mipmap=%d, remap=0x%x, zfunc=0x%x, wraps=0x%x, wrapt=0x%x, wrapr=0x%x, minlod=0x%x, maxlod=0x%x", 
 			//	m_offset, m_width, m_height, m_maxaniso, m_mipmap, m_remap, m_zfunc, m_wraps, m_wrapt, m_wrapr, m_minlod, m_maxlod);
@@ -112,9 +152,6 @@ namespace rsx
 
 			const u8* pixels = vm::ps3::_ptr<u8>(texaddr);
 			u8 *unswizzledPixels;
-			static const GLint glRemapStandard[4] = { GL_ALPHA, GL_RED, GL_GREEN, GL_BLUE };
-			// NOTE: This must be in ARGB order in all forms below.
-			const GLint *glRemap = glRemapStandard;
 
 			::gl::pixel_pack_settings().apply();
 			::gl::pixel_unpack_settings().apply();
@@ -127,9 +164,6 @@ namespace rsx
 			{
 				glPixelStorei(GL_UNPACK_ROW_LENGTH, pitch);
 				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tex.width(), tex.height(), 0, GL_BLUE, GL_UNSIGNED_BYTE, pixels);
-
-				static const GLint swizzleMaskB8[] = { GL_BLUE, GL_BLUE, GL_BLUE, GL_BLUE };
-				glRemap = swizzleMaskB8;
 				break;
 			}
 
@@ -150,8 +184,6 @@ namespace rsx
 				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tex.width(), tex.height(), 0, GL_RGBA, GL_UNSIGNED_SHORT_4_4_4_4, pixels);
 
 				// We read it in as R4G4B4A4, so we need to remap each component.
-				static const GLint swizzleMaskA4R4G4B4[] = { GL_BLUE, GL_ALPHA, GL_RED, GL_GREEN };
-				glRemap = swizzleMaskA4R4G4B4;
 				break;
 			}
 
@@ -218,9 +250,6 @@ namespace rsx
 			{
 				glPixelStorei(GL_UNPACK_ROW_LENGTH, pitch / 2);
 				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tex.width(), tex.height(), 0, GL_RG, GL_UNSIGNED_BYTE, pixels);
-
-				static const GLint swizzleMaskG8B8[] = { GL_RED, GL_GREEN, GL_RED, GL_GREEN };
-				glRemap = swizzleMaskG8B8;
 				break;
 			}
 
@@ -281,9 +310,6 @@ namespace rsx
 				glPixelStorei(GL_UNPACK_SWAP_BYTES, GL_TRUE);
 				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tex.width(), tex.height(), 0, GL_RED, GL_UNSIGNED_SHORT, pixels);
 				glPixelStorei(GL_UNPACK_SWAP_BYTES, GL_FALSE);
-
-				static const GLint swizzleMaskX16[] = { GL_RED, GL_ONE, GL_RED, GL_ONE };
-				glRemap = swizzleMaskX16;
 				break;
 			}
 
@@ -293,8 +319,6 @@ namespace rsx
 				glPixelStorei(GL_UNPACK_SWAP_BYTES, GL_TRUE);
 				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tex.width(), tex.height(), 0, GL_RG, GL_UNSIGNED_SHORT, pixels);
 				glPixelStorei(GL_UNPACK_SWAP_BYTES, GL_FALSE);
-				static const GLint swizzleMaskX32_Y16_X16[] = { GL_GREEN, GL_RED, GL_GREEN, GL_RED };
-				glRemap = swizzleMaskX32_Y16_X16;
 				break;
 			}
 
@@ -329,9 +353,6 @@ namespace rsx
 			{
 				glPixelStorei(GL_UNPACK_ROW_LENGTH, pitch / 4);
 				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tex.width(), tex.height(), 0, GL_RED, GL_FLOAT, pixels);
-
-				static const GLint swizzleMaskX32_FLOAT[] = { GL_RED, GL_ONE, GL_ONE, GL_ONE };
-				glRemap = swizzleMaskX32_FLOAT;
 				break;
 			}
 
@@ -343,9 +364,6 @@ namespace rsx
 				// TODO: Texture swizzling
 				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tex.width(), tex.height(), 0, GL_BGRA, GL_UNSIGNED_SHORT_1_5_5_5_REV, pixels);
 
-				static const GLint swizzleMaskX32_D1R5G5B5[] = { GL_ONE, GL_RED, GL_GREEN, GL_BLUE };
-				glRemap = swizzleMaskX32_D1R5G5B5;
-
 				glPixelStorei(GL_UNPACK_SWAP_BYTES, GL_FALSE);
 				break;
 			}
@@ -354,9 +372,6 @@ namespace rsx
 			{
 				glPixelStorei(GL_UNPACK_ROW_LENGTH, pitch / 4);
 				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tex.width(), tex.height(), 0, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8, pixels);
-
-				static const GLint swizzleMaskX32_D8R8G8B8[] = { GL_ONE, GL_RED, GL_GREEN, GL_BLUE };
-				glRemap = swizzleMaskX32_D8R8G8B8;
 				break;
 			}
 
@@ -367,9 +382,6 @@ namespace rsx
 				glPixelStorei(GL_UNPACK_SWAP_BYTES, GL_TRUE);
 				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tex.width(), tex.height(), 0, GL_RG, GL_HALF_FLOAT, pixels);
 				glPixelStorei(GL_UNPACK_SWAP_BYTES, GL_FALSE);
-
-				static const GLint swizzleMaskX32_Y16_X16_FLOAT[] = { GL_RED, GL_GREEN, GL_RED, GL_GREEN };
-				glRemap = swizzleMaskX32_Y16_X16_FLOAT;
 				break;
 			}
 
@@ -432,8 +444,107 @@ namespace rsx
 			}
 			}
 
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, tex.mipmap() - 1);
-			glTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, tex.mipmap() > 1);
+			if (is_swizzled && format == CELL_GCM_TEXTURE_A8R8G8B8)
+			{
+				free(unswizzledPixels);
+			}
+		}
+
+		bool texture::upload_rows(rsx::texture& tex, u32 begin, u32 end)
+		{
+			const u32 format = tex.format() & ~(CELL_GCM_TEXTURE_LN | CELL_GCM_TEXTURE_UN);
+			const bool is_swizzled = !(tex.format() & CELL_GCM_TEXTURE_LN);
+
+			if (is_swizzled)
+			{
+				return false;
+			}
+
+			// Formats uploaded straight from guest memory by upload()
+			GLenum gl_format, gl_type;
+			u32 texel_size;
+			bool swap_bytes = false;
+
+			switch (format)
+			{
+			case CELL_GCM_TEXTURE_B8: gl_format = GL_BLUE; gl_type = GL_UNSIGNED_BYTE; texel_size = 1; break;
+			case CELL_GCM_TEXTURE_A1R5G5B5: gl_format = GL_BGRA; gl_type = GL_UNSIGNED_SHORT_1_5_5_5_REV; texel_size = 2; swap_bytes = true; break;
+			case CELL_GCM_TEXTURE_A4R4G4B4: gl_format = GL_RGBA; gl_type = GL_UNSIGNED_SHORT_4_4_4_4; texel_size = 2; break;
+			case CELL_GCM_TEXTURE_R5G6B5: gl_format = GL_RGB; gl_type = GL_UNSIGNED_SHORT_5_6_5; texel_size = 2; swap_bytes = true; break;
+			case CELL_GCM_TEXTURE_A8R8G8B8: gl_format = GL_BGRA; gl_type = GL_UNSIGNED_INT_8_8_8_8; texel_size = 4; break;
+			case CELL_GCM_TEXTURE_G8B8: gl_format = GL_RG; gl_type = GL_UNSIGNED_BYTE; texel_size = 2; break;
+			case CELL_GCM_TEXTURE_X16: gl_format = GL_RED; gl_type = GL_UNSIGNED_SHORT; texel_size = 2; swap_bytes = true; break;
+			case CELL_GCM_TEXTURE_Y16_X16: gl_format = GL_RG; gl_type = GL_UNSIGNED_SHORT; texel_size = 4; swap_bytes = true; break;
+			case CELL_GCM_TEXTURE_R5G5B5A1: gl_format = GL_RGBA; gl_type = GL_UNSIGNED_SHORT_5_5_5_1; texel_size = 2; swap_bytes = true; break;
+			case CELL_GCM_TEXTURE_W16_Z16_Y16_X16_FLOAT: gl_format = GL_RGBA; gl_type = GL_HALF_FLOAT; texel_size = 8; swap_bytes = true; break;
+			case CELL_GCM_TEXTURE_W32_Z32_Y32_X32_FLOAT: gl_format = GL_RGBA; gl_type = GL_FLOAT; texel_size = 16; swap_bytes = true; break;
+			case CELL_GCM_TEXTURE_X32_FLOAT: gl_format = GL_RED; gl_type = GL_FLOAT; texel_size = 4; break;
+			case CELL_GCM_TEXTURE_D1R5G5B5: gl_format = GL_BGRA; gl_type = GL_UNSIGNED_SHORT_1_5_5_5_REV; texel_size = 2; swap_bytes = true; break;
+			case CELL_GCM_TEXTURE_D8R8G8B8: gl_format = GL_BGRA; gl_type = GL_UNSIGNED_INT_8_8_8_8; texel_size = 4; break;
+			case CELL_GCM_TEXTURE_Y16_X16_FLOAT: gl_format = GL_RG; gl_type = GL_HALF_FLOAT; texel_size = 4; swap_bytes = true; break;
+			default: return false;
+			}
+
+			const u32 pitch = tex.pitch();
+			const u32 height = tex.height();
+
+			if (pitch < tex.width() * texel_size || begin >= end)
+			{
+				return false;
+			}
+
+			// Guest mipmaps past level 0 aren't used, levels are generated from it
+			const u32 first_row = begin / pitch;
+			const u32 last_row = std::min<u32>((end + pitch - 1) / pitch, height);
+
+			if (first_row >= last_row)
+			{
+				return true;
+			}
+
+			const u32 texaddr = rsx::get_address(tex.offset(), tex.location());
+
+			::gl::pixel_pack_settings().apply();
+			::gl::pixel_unpack_settings().apply();
+
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, pitch / texel_size);
+			glPixelStorei(GL_UNPACK_SWAP_BYTES, swap_bytes);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, first_row, tex.width(), last_row - first_row, gl_format, gl_type, vm::ps3::_ptr<u8>(texaddr + first_row * pitch));
+			glPixelStorei(GL_UNPACK_SWAP_BYTES, GL_FALSE);
+
+			if (tex.mipmap() > 1)
+			{
+				glGenerateMipmap(GL_TEXTURE_2D);
+			}
+
+			return true;
+		}
+
+		bool texture::is_dsa_supported()
+		{
+			return glTextureParameteri != nullptr && glTextureParameterf != nullptr;
+		}
+
+		void texture::set_parameters(rsx::texture& tex)
+		{
+			// Edit the texture object directly if possible, otherwise the bound one
+			const bool dsa = is_dsa_supported();
+
+			const auto param = [&](GLenum pname, GLint value)
+			{
+				dsa ? glTextureParameteri(m_id, pname, value) : glTexParameteri(GL_TEXTURE_2D, pname, value);
+			};
+
+			const auto paramf = [&](GLenum pname, GLfloat value)
+			{
+				dsa ? glTextureParameterf(m_id, pname, value) : glTexParameterf(GL_TEXTURE_2D, pname, value);
+			};
+
+			const u32 format = tex.format() & ~(CELL_GCM_TEXTURE_LN | CELL_GCM_TEXTURE_UN);
+			const GLint* glRemap = get_remap_table(format);
+
+			param(GL_TEXTURE_MAX_LEVEL, tex.mipmap() - 1);
+			param(GL_GENERATE_MIPMAP, tex.mipmap() > 1);
 
 			if (format != CELL_GCM_TEXTURE_B8 && format != CELL_GCM_TEXTURE_X16 && format != CELL_GCM_TEXTURE_X32_FLOAT)
 			{
@@ -442,38 +553,34 @@ namespace rsx
 				u8 remap_g = (tex.remap() >> 4) & 0x3;
 				u8 remap_b = (tex.remap() >> 6) & 0x3;
 
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_A, glRemap[remap_a]);
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_R, glRemap[remap_r]);
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, glRemap[remap_g]);
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, glRemap[remap_b]);
+				param(GL_TEXTURE_SWIZZLE_A, glRemap[remap_a]);
+				param(GL_TEXTURE_SWIZZLE_R, glRemap[remap_r]);
+				param(GL_TEXTURE_SWIZZLE_G, glRemap[remap_g]);
+				param(GL_TEXTURE_SWIZZLE_B, glRemap[remap_b]);
 			}
 			else
 			{
 
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_A, glRemap[0]);
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_R, glRemap[1]);
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, glRemap[2]);
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, glRemap[3]);
+				param(GL_TEXTURE_SWIZZLE_A, glRemap[0]);
+				param(GL_TEXTURE_SWIZZLE_R, glRemap[1]);
+				param(GL_TEXTURE_SWIZZLE_G, glRemap[2]);
+				param(GL_TEXTURE_SWIZZLE_B, glRemap[3]);
 			}
 
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, gl_wrap(tex.wrap_s()));
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, gl_wrap(tex.wrap_t()));
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_R, gl_wrap(tex.wrap_r()));
-
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, gl_tex_zfunc[tex.zfunc()]);
+			param(GL_TEXTURE_WRAP_S, gl_wrap(tex.wrap_s()));
+			param(GL_TEXTURE_WRAP_T, gl_wrap(tex.wrap_t()));
+			param(GL_TEXTURE_WRAP_R, gl_wrap(tex.wrap_r()));
 
-			glTexEnvi(GL_TEXTURE_FILTER_CONTROL, GL_TEXTURE_LOD_BIAS, (GLint)tex.bias());
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_LOD, (tex.min_lod() >> 8));
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LOD, (tex.max_lod() >> 8));
+			param(GL_TEXTURE_COMPARE_FUNC, gl_tex_zfunc[tex.zfunc()]);
 
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, gl_tex_min_filter[tex.min_filter()]);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, gl_tex_mag_filter[tex.mag_filter()]);
-			glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, max_aniso(tex.max_aniso()));
+			// texture object bias (added to the texture unit one, which is left at 0)
+			param(GL_TEXTURE_LOD_BIAS, (GLint)tex.bias());
+			param(GL_TEXTURE_MIN_LOD, (tex.min_lod() >> 8));
+			param(GL_TEXTURE_MAX_LOD, (tex.max_lod() >> 8));
 
-			if (is_swizzled && format == CELL_GCM_TEXTURE_A8R8G8B8)
-			{
-				free(unswizzledPixels);
-			}
+			param(GL_TEXTURE_MIN_FILTER, gl_tex_min_filter[tex.min_filter()]);
+			param(GL_TEXTURE_MAG_FILTER, gl_tex_mag_filter[tex.mag_filter()]);
+			paramf(GL_TEXTURE_MAX_ANISOTROPY_EXT, max_aniso(tex.max_aniso()));
 		}
 
 		void texture::bind()
@@ -499,5 +606,379 @@ namespace rsx
 		{
 			return m_id;
 		}
+
+		namespace
+		{
+			const char *texture_decoder_source = R"(
+#version 430
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(binding = 17) uniform usamplerBuffer raw_data;
+layout(binding = 0, rgba8) uniform writeonly image2D decoded;
+
+uniform int format;
+uniform int base;
+uniform int pitch;
+uniform int swizzled;
+uniform ivec2 size;
+uniform ivec2 log2size;
+
+uint read_byte(int offset)
+{
+	return (texelFetch(raw_data, offset >> 2).x >> ((offset & 3) * 8)) & 0xffu;
+}
+
+uint read_be16(int offset)
+{
+	return (read_byte(offset) << 8) | read_byte(offset + 1);
+}
+
+// x and y bits are interleaved up to the smaller dimension, remaining bits are stacked on top
+int get_swizzled_index(ivec2 coord)
+{
+	int log2min = min(log2size.x, log2size.y);
+	int result = 0;
+
+	for (int bit = 0; bit < log2size.x; bit++)
+		result |= ((coord.x >> bit) & 1) << (bit < log2min ? bit * 2 : bit + log2min);
+
+	for (int bit = 0; bit < log2size.y; bit++)
+		result |= ((coord.y >> bit) & 1) << (bit < log2min ? bit * 2 + 1 : bit + log2min);
+
+	return result;
+}
+
+void main()
+{
+	ivec2 coord = ivec2(gl_GlobalInvocationID.xy);
+	if (any(greaterThanEqual(coord, size)))
+		return;
+
+	int texel_size = format == 0 ? 4 : 2;
+	int offset = base + (swizzled != 0 ? get_swizzled_index(coord) * texel_size : coord.y * pitch + coord.x * texel_size);
+	vec4 color;
+
+	if (format == 0)
+	{
+		// A8R8G8B8
+		color = vec4(uvec4(read_byte(offset + 1), read_byte(offset + 2), read_byte(offset + 3), read_byte(offset))) / 255.;
+	}
+	else
+	{
+		uint value = read_be16(offset);
+
+		if (format == 1) // R5G6B5
+			color = vec4(vec3(uvec3(value >> 11, (value >> 5) & 0x3fu, value & 0x1fu)) / vec3(31., 63., 31.), 1.);
+		else if (format == 2) // A1R5G5B5
+			color = vec4(vec3(uvec3((value >> 10) & 0x1fu, (value >> 5) & 0x1fu, value & 0x1fu)) / 31., float(value >> 15));
+		else // A4R4G4B4, same channel layout as the CPU upload (see get_remap_table)
+			color = vec4(uvec4((value >> 4) & 0xfu, value & 0xfu, value >> 12, (value >> 8) & 0xfu)) / 15.;
+	}
+
+	imageStore(decoded, coord, color);
+}
+)";
+
+			// Format index used by the decoder program, -1 if unsupported
+			int get_decoder_format(u32 format)
+			{
+				switch (format)
+				{
+				case CELL_GCM_TEXTURE_A8R8G8B8: return 0;
+				case CELL_GCM_TEXTURE_R5G6B5: return 1;
+				case CELL_GCM_TEXTURE_A1R5G5B5: return 2;
+				case CELL_GCM_TEXTURE_A4R4G4B4: return 3;
+				}
+
+				return -1;
+			}
+		}
+
+		bool texture_decoder::is_supported()
+		{
+			return glDispatchCompute != nullptr && glBindImageTexture != nullptr && glMemoryBarrier != nullptr;
+		}
+
+		void texture_decoder::create()
+		{
+			::gl::glsl::shader shader(::gl::glsl::shader::type::compute, texture_decoder_source);
+			(m_program.recreate() += { shader.compile() }).make();
+
+			GLint max_texels = 0;
+			glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &max_texels);
+
+			m_ring.create(::gl::buffer::target::texture, std::min<GLsizeiptr>(64 * 0x100000, ((GLsizeiptr)max_texels * 4) & ~0xfff));
+			m_buffer_texture.create(::gl::texture::target::textureBuffer);
+			m_buffer_texture.bind();
+			glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, m_ring.id());
+		}
+
+		void texture_decoder::remove()
+		{
+			if (m_buffer_texture)
+				m_buffer_texture.remove();
+
+			if (m_ring)
+				m_ring.remove();
+
+			if (m_program)
+				m_program.remove();
+		}
+
+		bool texture_decoder::decode(int index, u32 texture_id, rsx::texture& tex)
+		{
+			const u32 format = tex.format() & ~(CELL_GCM_TEXTURE_LN | CELL_GCM_TEXTURE_UN);
+			const bool is_swizzled = !(tex.format() & CELL_GCM_TEXTURE_LN);
+			const int decoder_format = get_decoder_format(format);
+			const u16 width = tex.width(), height = tex.height();
+
+			if (decoder_format < 0 || !width || !height)
+			{
+				return false;
+			}
+
+			if (is_swizzled && ((width & (width - 1)) || (height & (height - 1))))
+			{
+				return false;
+			}
+
+			const u32 texel_size = decoder_format == 0 ? 4 : 2;
+			const u32 pitch = std::max<u32>(tex.pitch(), width * texel_size);
+			const u32 data_size = is_swizzled ? width * height * texel_size : pitch * (height - 1) + width * texel_size;
+
+			// Leave room for other textures of the draw
+			if (data_size > m_ring.size() / 4)
+			{
+				return false;
+			}
+
+			const u32 texaddr = rsx::get_address(tex.offset(), tex.location());
+			auto mapping = m_ring.alloc_and_map(data_size, 4);
+			memcpy(mapping.first, vm::ps3::_ptr<u8>(texaddr), data_size);
+			m_ring.unmap();
+
+			GLint current_program = 0;
+			glGetIntegerv(GL_CURRENT_PROGRAM, &current_program);
+
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+			glActiveTexture(GL_TEXTURE0 + raw_data_texture_unit);
+			m_buffer_texture.bind();
+			glBindImageTexture(0, texture_id, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+
+			const GLuint program = m_program.id();
+			glProgramUniform1i(program, m_program.uniforms.location("format"), decoder_format);
+			glProgramUniform1i(program, m_program.uniforms.location("base"), (GLint)mapping.second);
+			glProgramUniform1i(program, m_program.uniforms.location("pitch"), (GLint)pitch);
+			glProgramUniform1i(program, m_program.uniforms.location("swizzled"), is_swizzled);
+			glProgramUniform2i(program, m_program.uniforms.location("size"), width, height);
+			glProgramUniform2i(program, m_program.uniforms.location("log2size"), (GLint)ceil(log2(width)), (GLint)ceil(log2(height)));
+
+			m_program.use();
+			glDispatchCompute((width + 7) / 8, (height + 7) / 8, 1);
+			glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+			glUseProgram(current_program);
+
+			glActiveTexture(GL_TEXTURE0 + index);
+
+			if (tex.mipmap() > 1)
+			{
+				glGenerateMipmap(GL_TEXTURE_2D);
+			}
+
+			return true;
+		}
+
+		// Get size of guest memory used by the texture (conservative), 0 if unknown
+		static u32 get_texture_memory_size(rsx::texture& tex)
+		{
+			const u32 size = (u32)get_texture_size(tex);
+
+			if (!size)
+			{
+				return 0;
+			}
+
+			const u32 base_size = std::max<u32>(size, tex.pitch() * tex.height());
+
+			return tex.mipmap() > 1 ? base_size + base_size / 2 : base_size;
+		}
+
+		namespace
+		{
+			// Texture registers used by texture::set_parameters()
+			std::array<u32, 6> get_sampler_state(rsx::texture& tex)
+			{
+				return{ tex.format() | (u32)tex.mipmap() << 8, tex.remap(), tex.wrap_s() | tex.wrap_t() << 8 | tex.wrap_r() << 16 | (u32)tex.zfunc() << 24,
+					tex.min_lod() | (u32)tex.max_lod() << 12 | (u32)tex.max_aniso() << 24, tex.min_filter() | (u32)tex.mag_filter() << 8, (u32)(s32)tex.bias() };
+			}
+		}
+
+		u32 texture_cache::bind(int index, rsx::texture& tex, bool multi_bind)
+		{
+			const u32 texaddr = rsx::get_address(tex.offset(), tex.location());
+			const u32 size = get_texture_memory_size(tex);
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			if (m_entries.size() >= 1024 && !m_entries.count(texaddr))
+			{
+				// Too many textures, start over
+				for (auto& pair : m_entries)
+				{
+					if (pair.second.is_protected)
+					{
+						vm::page_protect(pair.second.protected_start, pair.second.protected_size, 0, vm::page_writable, 0);
+					}
+
+					pair.second.tex.remove();
+					perf::mem_add(perf::mem_texture_cache, -s64(pair.second.memory_size));
+				}
+
+				m_entries.clear();
+			}
+
+			auto& entry = m_entries[texaddr];
+
+			if (!entry.tex.id())
+			{
+				entry.tex.create();
+			}
+
+			const bool layout_changed = entry.format != tex.format() || entry.width != tex.width() || entry.height != tex.height() || entry.mipmap != tex.mipmap() || entry.pitch != tex.pitch();
+			const bool upload = entry.is_dirty || layout_changed || !size;
+			const auto sampler_state = get_sampler_state(tex);
+			const bool parameters_changed = !entry.has_sampler_state || entry.sampler_state != sampler_state;
+
+			if (!multi_bind || upload || (parameters_changed && !texture::is_dsa_supported()))
+			{
+				glActiveTexture(GL_TEXTURE0 + index);
+				entry.tex.bind();
+			}
+
+			if (upload)
+			{
+				// Only some pages were written: upload the rows they contain once the texture is protected again
+				const bool partial = !layout_changed && size && entry.is_dirty && entry.dirty_end > entry.dirty_start;
+				const u32 dirty_start = entry.dirty_start, dirty_end = entry.dirty_end;
+
+				if (entry.is_protected)
+				{
+					vm::page_protect(entry.protected_start, entry.protected_size, 0, vm::page_writable, 0);
+					entry.is_protected = false;
+				}
+
+				entry.format = tex.format();
+				entry.width = tex.width();
+				entry.height = tex.height();
+				entry.mipmap = tex.mipmap();
+				entry.pitch = tex.pitch();
+				entry.is_dirty = !size;
+
+				perf::mem_add(perf::mem_texture_cache, s64(size) - entry.memory_size);
+				entry.memory_size = size;
+				entry.dirty_start = entry.dirty_end = 0;
+
+				// Protect before uploading: writes made during the upload will mark the texture dirty again
+				if (size)
+				{
+					entry.protected_start = texaddr & ~0xfff;
+					entry.protected_size = ::align(texaddr + size, 4096) - entry.protected_start;
+					entry.is_protected = vm::page_protect(entry.protected_start, entry.protected_size, 0, 0, vm::page_writable);
+					entry.is_dirty = !entry.is_protected;
+				}
+
+				if (partial && entry.tex.upload_rows(tex, std::max(dirty_start, texaddr) - texaddr, dirty_end - texaddr))
+				{
+					perf::add(perf::texture_partial_uploads);
+				}
+				else if (!m_decoder || !m_decoder->decode(index, entry.tex.id(), tex))
+				{
+					entry.tex.upload(tex);
+				}
+			}
+
+			if (parameters_changed)
+			{
+				entry.tex.set_parameters(tex);
+				entry.sampler_state = sampler_state;
+				entry.has_sampler_state = true;
+			}
+
+			return entry.tex.id();
+		}
+
+		bool texture_cache::invalidate_address(u32 addr)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			const u32 page = addr & ~0xfff;
+			bool handled = false;
+
+			for (auto& pair : m_entries)
+			{
+				auto& entry = pair.second;
+
+				if (!entry.is_protected || page < entry.protected_start || page - entry.protected_start >= entry.protected_size)
+				{
+					continue;
+				}
+
+				handled = true;
+
+				// Already dirty entirely: the page was only left protected by other textures
+				if (entry.is_dirty && entry.dirty_end <= entry.dirty_start)
+				{
+					continue;
+				}
+
+				entry.dirty_start = entry.is_dirty ? std::min(entry.dirty_start, page) : page;
+				entry.dirty_end = entry.is_dirty ? std::max(entry.dirty_end, page + 4096) : page + 4096;
+				entry.is_dirty = true;
+
+				// Most of the texture is being written: stop faulting on every page, it will be uploaded entirely
+				if ((entry.dirty_end - entry.dirty_start) * 2 > entry.protected_size)
+				{
+					vm::page_protect(entry.protected_start, entry.protected_size, 0, vm::page_writable, 0);
+					entry.is_protected = false;
+					entry.dirty_start = entry.dirty_end = 0;
+
+					// Other textures sharing unprotected pages can't detect writes anymore
+					for (auto& other : m_entries)
+					{
+						if (other.second.protected_start < entry.protected_start + entry.protected_size && entry.protected_start < other.second.protected_start + other.second.protected_size)
+						{
+							other.second.is_dirty = true;
+							other.second.dirty_start = other.second.dirty_end = 0;
+						}
+					}
+				}
+			}
+
+			if (handled)
+			{
+				vm::page_protect(page, 4096, 0, vm::page_writable, 0);
+			}
+
+			return handled;
+		}
+
+		void texture_cache::clear()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			for (auto& pair : m_entries)
+			{
+				if (pair.second.is_protected)
+				{
+					vm::page_protect(pair.second.protected_start, pair.second.protected_size, 0, vm::page_writable, 0);
+				}
+
+				pair.second.tex.remove();
+				perf::mem_add(perf::mem_texture_cache, -s64(pair.second.memory_size));
+			}
+
+			m_entries.clear();
+		}
 	}
 }
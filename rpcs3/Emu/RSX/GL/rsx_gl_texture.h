@@ -1,3 +1,4 @@
+#include "gl_helpers.h"
 
 namespace rsx
 {
@@ -35,11 +36,116 @@ namespace rsx
 			}
 
 			void init(int index, rsx::texture& tex);
+
+			// Upload texture data to the currently bound texture object
+			void upload(rsx::texture& tex);
+
+			// Upload the rows of level 0 stored in bytes begin to end of texture memory (offsets from texture address) to the currently bound texture object.
+			// Returns false if the format or layout requires a full upload, nothing is modified then.
+			bool upload_rows(rsx::texture& tex, u32 begin, u32 end);
+
+			// ARB_direct_state_access: texture parameters are set without binding the texture
+			static bool is_dsa_supported();
+
+			// Set sampler state and component remap of the texture object (of the currently bound one if DSA isn't supported)
+			void set_parameters(rsx::texture& tex);
+
 			void bind();
 			void unbind();
 			void remove();
 
 			u32 id() const;
 		};
+
+		/**
+		* Decode textures on the GPU: raw guest bytes are copied to a texture buffer and a compute program
+		* does the deswizzle, endian swap and expansion to RGBA8.
+		* Only 32 bit ARGB and 16 bit color formats are handled, other formats use the CPU upload.
+		*/
+		class texture_decoder
+		{
+			::gl::glsl::program m_program;
+			::gl::ring_buffer m_ring;
+			::gl::texture m_buffer_texture;
+
+		public:
+			// Texture unit the raw data buffer is bound to while decoding
+			static const int raw_data_texture_unit = 17;
+
+			static bool is_supported();
+
+			void create();
+			void remove();
+
+			/**
+			* Decode level 0 of tex into the texture object bound to unit index, mipmaps are generated from it.
+			* Returns false if the texture isn't handled, nothing is modified then.
+			*/
+			bool decode(int index, u32 texture_id, rsx::texture& tex);
+		};
+
+		/**
+		* Uploaded textures keyed by address.
+		* Guest memory of cached textures is write-protected, so textures are only uploaded again
+		* when the memory is modified (see invalidate_address) or texture layout changes.
+		* Written pages are unprotected one at a time and only the rows they contain are uploaded, until most of the texture is written.
+		*/
+		class texture_cache
+		{
+			struct entry_t
+			{
+				texture tex;
+				u32 format = 0;
+				u16 width = 0;
+				u16 height = 0;
+				u16 mipmap = 0;
+				u32 pitch = 0;
+				u32 protected_start = 0;
+				u32 protected_size = 0;
+				bool is_protected = false; // Some pages of the range may have been unprotected (see dirty_start)
+				bool is_dirty = true;
+				u32 dirty_start = 0; // Written pages when only part of the texture is dirty (dirty_start == dirty_end if all of it is)
+				u32 dirty_end = 0;
+				std::array<u32, 6> sampler_state; // Texture registers applied by set_parameters()
+				bool has_sampler_state = false;
+				u32 memory_size = 0; // Guest size of the uploaded data (host memory estimate)
+			};
+
+			/**
+			* Mutex protecting m_entries access
+			* Memory protection fault can be generated by any thread and
+			* modifies it.
+			*/
+			std::mutex m_mutex;
+
+			std::unordered_map<u32, entry_t> m_entries;
+
+			texture_decoder *m_decoder = nullptr;
+
+		public:
+			/**
+			* Use decoder for the formats it handles (nullptr to always upload from the CPU).
+			*/
+			void set_decoder(texture_decoder *decoder)
+			{
+				m_decoder = decoder;
+			}
+
+			/**
+			* Bind texture to the texture unit, upload its data and set its parameters if needed. Returns the texture object.
+			* With multi_bind the caller binds all units at once (glBindTextures), the texture is only bound here when it must be edited.
+			*/
+			u32 bind(int index, rsx::texture& tex, bool multi_bind = false);
+
+			/**
+			* Mark textures containing addr dirty and unprotect its page. Returns false if no texture contains addr.
+			*/
+			bool invalidate_address(u32 addr);
+
+			/**
+			* Unprotect memory and delete all textures (must be called from the GL thread).
+			*/
+			void clear();
+		};
 	}
 }
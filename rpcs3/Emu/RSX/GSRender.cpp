@@ -16,6 +16,16 @@ draw_context_t GSFrameBase::new_context()
 	return nullptr;
 }
 
+draw_context_t GSFrameBase::new_shared_context(draw_context_t ctx)
+{
+	if (void* context = make_shared_context(ctx.get()))
+	{
+		return std::shared_ptr<void>(context, [this](void* ctxt) { delete_context(ctxt); });
+	}
+
+	return nullptr;
+}
+
 void GSFrameBase::title_message(const std::wstring& msg)
 {
 	m_title_message = msg;
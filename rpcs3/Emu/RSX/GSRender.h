@@ -20,6 +20,9 @@ public:
 
 	draw_context_t new_context();
 
+	// Context sharing objects with ctx, for another thread (nullptr if not supported)
+	draw_context_t new_shared_context(draw_context_t ctx);
+
 	virtual void set_current(draw_context_t ctx) = 0;
 	virtual void flip(draw_context_t ctx) = 0;
 	virtual size2i client_size() = 0;
@@ -30,6 +33,7 @@ public:
 protected:
 	virtual void delete_context(void* ctx) = 0;
 	virtual void* make_context() = 0;
+	virtual void* make_shared_context(void* ctx) { return nullptr; }
 };
 
 enum class frame_type
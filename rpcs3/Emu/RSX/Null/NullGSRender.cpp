@@ -1,12 +1,348 @@
 #include "stdafx.h"
 #include "NullGSRender.h"
+#include "Emu/Memory/Memory.h"
 #include "Emu/System.h"
+#include "Emu/state.h"
+#include "Emu/PerfCounters.h"
+#include "Emu/RSX/GCM.h"
+#include "Emu/RSX/rsx_methods.h"
+#include "Emu/RSX/Common/BufferUtils.h"
+#include "Emu/RSX/Common/TextureUtils.h"
+#include "Emu/RSX/Common/FragmentProgramDecompiler.h"
+#include "Emu/RSX/Common/VertexProgramDecompiler.h"
 
-NullGSRender::NullGSRender() : GSRender(frame_type::Null)
+namespace
 {
+	void insert_params(std::stringstream &OS, const std::string &qualifier, const std::vector<ParamType> &params)
+	{
+		for (const ParamType &PT : params)
+		{
+			for (const ParamItem &PI : PT.items)
+				OS << qualifier << " " << PT.type << " " << PI.name << ";" << std::endl;
+		}
+	}
+
+	std::string get_float_type_name(size_t element_count)
+	{
+		return element_count == 1 ? "float" : "vec" + std::to_string(element_count);
+	}
+
+	std::string get_function(FUNCTION f)
+	{
+		switch (f)
+		{
+		case FUNCTION::FUNCTION_DP2: return "dp2($0, $1)";
+		case FUNCTION::FUNCTION_DP2A: return "";
+		case FUNCTION::FUNCTION_DP3: return "dp3($0, $1)";
+		case FUNCTION::FUNCTION_DP4: return "dp4($0, $1)";
+		case FUNCTION::FUNCTION_DPH: return "dph($0, $1)";
+		case FUNCTION::FUNCTION_SFL: return "vec4(0.)";
+		case FUNCTION::FUNCTION_STR: return "vec4(1.)";
+		case FUNCTION::FUNCTION_FRACT: return "fract($0)";
+		case FUNCTION::FUNCTION_DFDX: return "dfdx($0)";
+		case FUNCTION::FUNCTION_DFDY: return "dfdy($0)";
+		case FUNCTION::FUNCTION_TEXTURE_SAMPLE:
+		case FUNCTION::FUNCTION_TEXTURE_CUBE_SAMPLE: return "texture($t, $0)";
+		case FUNCTION::FUNCTION_TEXTURE_SAMPLE_PROJ:
+		case FUNCTION::FUNCTION_TEXTURE_CUBE_SAMPLE_PROJ: return "texture_proj($t, $0, $1)";
+		case FUNCTION::FUNCTION_TEXTURE_SAMPLE_LOD:
+		case FUNCTION::FUNCTION_TEXTURE_CUBE_SAMPLE_LOD: return "texture_lod($t, $0, $1)";
+		}
+
+		throw EXCEPTION("Unknown function %d", (int)f);
+	}
+
+	std::string compare_function(COMPARE f, const std::string &Op0, const std::string &Op1)
+	{
+		return "cmp" + std::to_string((int)f) + "(" + Op0 + ", " + Op1 + ")";
+	}
+
+	struct null_fragment_decompiler : public FragmentProgramDecompiler
+	{
+		null_fragment_decompiler(const RSXFragmentProgram &prog, u32& size)
+			: FragmentProgramDecompiler(prog, size)
+		{
+		}
+
+	protected:
+		virtual std::string getFloatTypeName(size_t elementCount) override { return get_float_type_name(elementCount); }
+		virtual std::string getFunction(FUNCTION f) override { return get_function(f); }
+		virtual std::string saturate(const std::string &code) override { return "saturate(" + code + ")"; }
+		virtual std::string compareFunction(COMPARE f, const std::string &Op0, const std::string &Op1) override { return compare_function(f, Op0, Op1); }
+
+		virtual void insertHeader(std::stringstream &OS) override {}
+		virtual void insertIntputs(std::stringstream &OS) override { insert_params(OS, "in", m_parr.params[PF_PARAM_IN]); }
+		virtual void insertOutputs(std::stringstream &OS) override { insert_params(OS, "out", m_parr.params[PF_PARAM_OUT]); }
+		virtual void insertConstants(std::stringstream &OS) override { insert_params(OS, "uniform", m_parr.params[PF_PARAM_UNIFORM]); }
+		virtual void insertMainStart(std::stringstream &OS) override { OS << "void main()" << std::endl << "{" << std::endl; }
+		virtual void insertMainEnd(std::stringstream &OS) override { OS << "}" << std::endl; }
+	};
+
+	struct null_vertex_decompiler : public VertexProgramDecompiler
+	{
+		null_vertex_decompiler(const RSXVertexProgram &prog)
+			: VertexProgramDecompiler(prog)
+		{
+		}
+
+	protected:
+		virtual std::string getFloatTypeName(size_t elementCount) override { return get_float_type_name(elementCount); }
+		virtual std::string getIntTypeName(size_t elementCount) override { return "ivec4"; }
+		virtual std::string getFunction(FUNCTION f) override { return get_function(f); }
+		virtual std::string compareFunction(COMPARE f, const std::string &Op0, const std::string &Op1) override { return compare_function(f, Op0, Op1); }
+
+		virtual void insertHeader(std::stringstream &OS) override {}
+		virtual void insertInputs(std::stringstream &OS, const std::vector<ParamType> &inputs) override { insert_params(OS, "in", inputs); }
+		virtual void insertConstants(std::stringstream &OS, const std::vector<ParamType> &constants) override { insert_params(OS, "uniform", constants); }
+		virtual void insertOutputs(std::stringstream &OS, const std::vector<ParamType> &outputs) override { insert_params(OS, "out", outputs); }
+		virtual void insertMainStart(std::stringstream &OS) override { OS << "void main()" << std::endl << "{" << std::endl; }
+		virtual void insertMainEnd(std::stringstream &OS) override { OS << "}" << std::endl; }
+	};
+
+	size_t elapsed_us(const std::chrono::time_point<std::chrono::system_clock> &start)
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - start).count();
+	}
+}
+
+void NullTraits::recompile_fragment_program(const RSXFragmentProgram &RSXFP, fragment_program_type& fragmentProgramData, size_t ID)
+{
+	u32 size;
+	null_fragment_decompiler decompiler(RSXFP, size);
+	fragmentProgramData.code_size = decompiler.Decompile().size();
+	fragmentProgramData.id = (u32)ID;
+}
+
+void NullTraits::recompile_vertex_program(const RSXVertexProgram &RSXVP, vertex_program_type& vertexProgramData, size_t ID)
+{
+	null_vertex_decompiler decompiler(RSXVP);
+	vertexProgramData.code_size = decompiler.Decompile().size();
+	vertexProgramData.id = (u32)ID;
+}
+
+NullGSRender::NullGSRender()
+	: GSRender(frame_type::Null)
+	, m_benchmark(rpcs3::state.config.rsx.null_benchmark.value())
+{
+}
+
+NullGSRender::~NullGSRender()
+{
+	if (m_benchmark && m_frame_count)
+	{
+		LOG_NOTICE(RSX, "Benchmark: %u frames, average %lld us per frame (programs %lld us, vertex/index %lld us, textures %lld us), %lld draws per frame",
+			m_frame_count,
+			m_total_timers.frame_duration / m_frame_count,
+			m_total_timers.program_duration / m_frame_count,
+			m_total_timers.vertex_index_duration / m_frame_count,
+			m_total_timers.texture_duration / m_frame_count,
+			m_total_timers.draw_calls_count / m_frame_count);
+	}
+}
+
+void NullGSRender::on_init_thread()
+{
+	GSRender::on_init_thread();
+
+	m_frame_start = std::chrono::system_clock::now();
 }
 
 bool NullGSRender::do_method(u32 cmd, u32 value)
 {
 	return false;
 }
+
+void NullGSRender::end()
+{
+	if (m_benchmark)
+	{
+		std::chrono::time_point<std::chrono::system_clock> program_start = std::chrono::system_clock::now();
+		load_program();
+		m_frame_timers.program_duration += elapsed_us(program_start);
+
+		std::chrono::time_point<std::chrono::system_clock> vertex_index_start = std::chrono::system_clock::now();
+		upload_vertex_index_data();
+		m_frame_timers.vertex_index_duration += elapsed_us(vertex_index_start);
+
+		std::chrono::time_point<std::chrono::system_clock> texture_start = std::chrono::system_clock::now();
+		upload_textures();
+		m_frame_timers.texture_duration += elapsed_us(texture_start);
+
+		m_frame_timers.draw_calls_count++;
+	}
+
+	thread::end();
+}
+
+void NullGSRender::load_program()
+{
+	if (programs_dirty)
+	{
+		m_prog_buffer.invalidate_last_programs();
+		programs_dirty = false;
+	}
+
+	RSXVertexProgram vertex_program;
+	u32 transform_program_start = rsx::method_registers[NV4097_SET_TRANSFORM_PROGRAM_START];
+	vertex_program.data.reserve((512 - transform_program_start) * 4);
+
+	for (int i = transform_program_start; i < 512; ++i)
+	{
+		vertex_program.data.resize((i - transform_program_start) * 4 + 4);
+		memcpy(vertex_program.data.data() + (i - transform_program_start) * 4, transform_program + i * 4, 4 * sizeof(u32));
+
+		D3 d3;
+		d3.HEX = transform_program[i * 4 + 3];
+
+		if (d3.end)
+			break;
+	}
+
+	RSXFragmentProgram fragment_program;
+	u32 shader_program = rsx::method_registers[NV4097_SET_SHADER_PROGRAM];
+	fragment_program.offset = shader_program & ~0x3;
+	fragment_program.addr = rsx::get_address(fragment_program.offset, (shader_program & 0x3) - 1);
+	fragment_program.ctrl = rsx::method_registers[NV4097_SET_SHADER_CONTROL];
+
+	for (u32 i = 0; i < rsx::limits::textures_count; ++i)
+	{
+		if (textures[i].enabled() && textures[i].cubemap())
+			fragment_program.texture_dimensions.push_back(texture_dimension::texture_dimension_cubemap);
+		else
+			fragment_program.texture_dimensions.push_back(texture_dimension::texture_dimension_2d);
+	}
+
+	m_prog_buffer.getGraphicPipelineState(vertex_program, fragment_program, nullptr);
+}
+
+void NullGSRender::upload_vertex_index_data()
+{
+	if (draw_command == Draw_command::draw_command_inlined_array)
+	{
+		m_vertex_data.resize(inline_vertex_array.size() * sizeof(u32));
+		write_inline_array_to_buffer(m_vertex_data.data());
+		m_frame_timers.vertex_index_size += m_vertex_data.size();
+		return;
+	}
+
+	std::vector<std::pair<u32, u32>> vertex_ranges = first_count_commands;
+
+	if (draw_command == Draw_command::draw_command_indexed)
+	{
+		size_t index_count = 0;
+		for (const auto &pair : first_count_commands)
+			index_count += pair.second;
+		index_count = get_index_count(draw_mode, gsl::narrow<int>(index_count));
+
+		Index_array_type indexed_type = to_index_array_type(rsx::method_registers[NV4097_SET_INDEX_ARRAY_DMA] >> 4);
+		size_t index_size = get_index_type_size(indexed_type);
+		m_index_data.resize(index_count * index_size);
+
+		u32 max_index = 0;
+
+		if (indexed_type == Index_array_type::unsigned_16b)
+		{
+			gsl::span<u16> dst = { (u16*)m_index_data.data(), gsl::narrow<int>(index_count) };
+			max_index = std::get<1>(write_index_array_data_to_buffer(dst, draw_mode, first_count_commands));
+		}
+
+		if (indexed_type == Index_array_type::unsigned_32b)
+		{
+			gsl::span<u32> dst = { (u32*)m_index_data.data(), gsl::narrow<int>(index_count) };
+			max_index = std::get<1>(write_index_array_data_to_buffer(dst, draw_mode, first_count_commands));
+		}
+
+		m_frame_timers.vertex_index_size += m_index_data.size();
+		vertex_ranges = { std::make_pair(0, max_index + 1) };
+	}
+	else if (!is_primitive_native(draw_mode))
+	{
+		size_t index_count = 0;
+		for (const auto &pair : first_count_commands)
+			index_count += get_index_count(draw_mode, pair.second);
+		m_index_data.resize(index_count * sizeof(u16));
+
+		char *dst = (char*)m_index_data.data();
+		u32 vertex_count = 0;
+		for (const auto &pair : first_count_commands)
+		{
+			write_index_array_for_non_indexed_non_native_primitive_to_buffer(dst, draw_mode, vertex_count, pair.second);
+			dst += get_index_count(draw_mode, pair.second) * sizeof(u16);
+			vertex_count += pair.second;
+		}
+
+		m_frame_timers.vertex_index_size += m_index_data.size();
+	}
+
+	u32 input_mask = rsx::method_registers[NV4097_SET_VERTEX_ATTRIB_INPUT_MASK];
+
+	for (int index = 0; index < rsx::limits::vertex_count; ++index)
+	{
+		const rsx::data_array_format_info &info = vertex_arrays_info[index];
+
+		if (!(input_mask & (1 << index)) || !info.size)
+			continue;
+
+		u32 element_size = rsx::get_vertex_type_size_on_host(info.type, info.size);
+		size_t vertex_count = 0;
+		for (const auto &range : vertex_ranges)
+			vertex_count += range.second;
+		m_vertex_data.resize(vertex_count * element_size);
+
+		size_t offset = 0;
+		for (const auto &range : vertex_ranges)
+		{
+			write_vertex_array_data_to_buffer(m_vertex_data.data() + offset, range.first, range.second, index, info);
+			offset += range.second * element_size;
+		}
+
+		m_frame_timers.vertex_index_size += m_vertex_data.size();
+	}
+}
+
+void NullGSRender::upload_textures()
+{
+	for (u32 i = 0; i < rsx::limits::textures_count; ++i)
+	{
+		if (!textures[i].enabled())
+			continue;
+
+		if (!m_frame_textures.insert(rsx::get_address(textures[i].offset(), textures[i].location())).second)
+			continue;
+
+		// Same row pitch alignment as D3D12 uploads
+		m_texture_data.resize(get_placed_texture_storage_size(textures[i], 256));
+		upload_placed_texture(textures[i], 256, m_texture_data.data());
+		m_frame_timers.texture_size += m_texture_data.size();
+
+		perf::add(perf::texture_uploads);
+	}
+}
+
+void NullGSRender::flip(int buffer)
+{
+	GSRender::flip(buffer);
+
+	if (!m_benchmark)
+		return;
+
+	m_frame_timers.frame_duration = elapsed_us(m_frame_start);
+	m_frame_start = std::chrono::system_clock::now();
+
+	const timers &t = m_frame_timers;
+	LOG_NOTICE(RSX, "Benchmark frame %u: %lld us, programs %lld us, vertex/index %lld us (%lld bytes), textures %lld us (%lld bytes), other %lld us, %lld draws",
+		m_frame_count, t.frame_duration, t.program_duration, t.vertex_index_duration, t.vertex_index_size, t.texture_duration, t.texture_size,
+		t.frame_duration - std::min(t.frame_duration, t.program_duration + t.vertex_index_duration + t.texture_duration), t.draw_calls_count);
+
+	m_total_timers.program_duration += t.program_duration;
+	m_total_timers.vertex_index_duration += t.vertex_index_duration;
+	m_total_timers.texture_duration += t.texture_duration;
+	m_total_timers.frame_duration += t.frame_duration;
+	m_total_timers.draw_calls_count += t.draw_calls_count;
+	m_total_timers.vertex_index_size += t.vertex_index_size;
+	m_total_timers.texture_size += t.texture_size;
+	m_frame_count++;
+
+	m_frame_timers = {};
+	m_frame_textures.clear();
+}
@@ -1,11 +1,102 @@
 #pragma once
 #include "Emu/RSX/GSRender.h"
+#include "Emu/RSX/Common/ProgramStateCache.h"
 
+#include <unordered_set>
+
+/**
+ * Programs of the benchmark mode, decompiled with a minimal syntax and never compiled.
+ */
+struct NullProgram
+{
+	u32 id = 0;
+	size_t code_size = 0;
+};
+
+struct NullTraits
+{
+	using vertex_program_type = NullProgram;
+	using fragment_program_type = NullProgram;
+	using pipeline_storage_type = u64;
+	using pipeline_properties = void*;
+
+	static const bool parallel_shader_compilation = true;
+
+	static void recompile_fragment_program(const RSXFragmentProgram &RSXFP, fragment_program_type& fragmentProgramData, size_t ID);
+	static void recompile_vertex_program(const RSXVertexProgram &RSXVP, vertex_program_type& vertexProgramData, size_t ID);
+
+	static
+	pipeline_storage_type build_pipeline(const vertex_program_type &vertexProgramData, const fragment_program_type &fragmentProgramData, const pipeline_properties &pipelineProperties, const std::vector<u8> &cachedBlob)
+	{
+		return (u64)vertexProgramData.id << 32 | fragmentProgramData.id;
+	}
+
+	static
+	void serialize_properties(const pipeline_properties &pipelineProperties, std::vector<u8> &out)
+	{
+	}
+
+	static
+	bool deserialize_properties(const u8 *data, size_t size, pipeline_properties &pipelineProperties)
+	{
+		pipelineProperties = nullptr;
+		return size == 0;
+	}
+
+	static
+	std::vector<u8> get_pipeline_blob(const pipeline_storage_type &pipeline)
+	{
+		return{};
+	}
+};
+
+/**
+ * Without the "Null Renderer Benchmark" option, methods are only parsed.
+ * In benchmark mode there is no window, draws go through the CPU side of a backend (program decompilation,
+ * index/vertex conversion, texture conversion) without any submission, and time spent in every stage
+ * is logged at flip.
+ */
 class NullGSRender final : public GSRender
 {
+	bool m_benchmark;
+
+	program_state_cache<NullTraits> m_prog_buffer;
+
+	// Conversion destination, replaces backend upload heaps
+	std::vector<u8> m_index_data;
+	std::vector<u8> m_vertex_data;
+	std::vector<u8> m_texture_data;
+
+	// Textures are converted once per frame, like a texture cache hit would skip them
+	std::unordered_set<u32> m_frame_textures;
+
+	struct timers
+	{
+		size_t program_duration;
+		size_t vertex_index_duration;
+		size_t texture_duration;
+		size_t frame_duration;
+		size_t draw_calls_count;
+		size_t vertex_index_size;
+		size_t texture_size;
+	};
+
+	timers m_frame_timers = {};
+	timers m_total_timers = {};
+	u32 m_frame_count = 0;
+	std::chrono::time_point<std::chrono::system_clock> m_frame_start;
+
 public:
 	NullGSRender();
+	~NullGSRender();
 
 private:
+	void load_program();
+	void upload_vertex_index_data();
+	void upload_textures();
+
+	void on_init_thread() override;
 	bool do_method(u32 cmd, u32 value) override;
+	void end() override;
+	void flip(int buffer) override;
 };
@@ -219,11 +219,15 @@ struct RSXFragmentProgram
 	u32 ctrl;
 	std::vector<texture_dimension> texture_dimensions;
 
+	// Host copy of the ucode read instead of guest memory at addr if set
+	const void *ucode;
+
 	RSXFragmentProgram()
 		: size(0)
 		, addr(0)
 		, offset(0)
 		, ctrl(0)
+		, ucode(nullptr)
 	{
 	}
 };
@@ -2,7 +2,10 @@
 #include "Emu/Memory/Memory.h"
 #include "Emu/System.h"
 #include "Emu/state.h"
+#include "Emu/PerfCounters.h"
 #include "Emu/RSX/GSManager.h"
+#include "Emu/CPU/HostThreadPolicy.h"
+#include "Utilities/Trace.h"
 #include "RSXThread.h"
 
 #include "Emu/SysCalls/Callback.h"
@@ -19,11 +22,47 @@ frame_capture_data frame_debug;
 
 namespace rsx
 {
+	// RSX method logging ("RSX Logging" option), written to the binary trace if it's enabled
+	static void log_method(u32 reg, u32 value)
+	{
+		if (_log::g_trace.is_open())
+		{
+			LOG_BINARY("RSX: method 0x%04x = 0x%x", reg, value);
+		}
+		else
+		{
+			LOG_NOTICE(RSX, "%s(0x%x) = 0x%x", get_method_name(reg).c_str(), reg, value);
+		}
+	}
+
 	std::string shaders_cache::path_to_root()
 	{
 		return fs::get_executable_dir() + "data/";
 	}
 
+	std::string shaders_cache::path_to_title_cache()
+	{
+		std::string title_id = Emu.GetTitleID();
+		std::string path = path_to_root() + (title_id.empty() ? "" : title_id + "/") + "cache/";
+
+		if (!fs::is_dir(path) && !fs::create_path(path))
+		{
+			LOG_ERROR(RSX, "Failed to create cache directory '%s'", path);
+		}
+
+		return path;
+	}
+
+	std::string shaders_cache::path_to_pipeline_cache(const std::string &backend)
+	{
+		return path_to_title_cache() + "pipelines." + backend + ".bin";
+	}
+
+	std::string shaders_cache::path_to_shader_binary_cache(const std::string &backend)
+	{
+		return path_to_title_cache() + "shaders." + backend + ".bin";
+	}
+
 	void shaders_cache::load(const std::string &path, shader_language lang)
 	{
 		std::string lang_name = convert::to<std::string>(lang);
@@ -168,7 +207,7 @@ namespace rsx
 		}
 	}
 	
-	void tiled_region::write(const void *src, u32 width, u32 height, u32 pitch)
+	void tiled_region::write(const void *src, u32 width, u32 height, u32 pitch) const
 	{
 		if (!tile)
 		{
@@ -205,14 +244,32 @@ namespace rsx
 		case CELL_GCM_COMPMODE_C32_2X2:
 			for (u32 y = 0; y < height; ++y)
 			{
-				for (u32 x = 0; x < width; ++x)
+				const u8 *src_row = (u8*)src + pitch * y;
+				u8 *dst_row0 = ptr + (offset_y + y * 2 + 0) * tile->pitch + offset_x;
+				u8 *dst_row1 = ptr + (offset_y + y * 2 + 1) * tile->pitch + offset_x;
+
+				// Every pixel is duplicated on 2 rows and 2 columns, 4 pixels at a time
+				u32 x = 0;
+				for (; x + 4 <= width; x += 4)
 				{
-					u32 value = *(u32*)((u8*)src + pitch * y + x * sizeof(u32));
+					const __m128i value = _mm_loadu_si128((const __m128i*)(src_row + x * sizeof(u32)));
+					const __m128i low = _mm_unpacklo_epi32(value, value);
+					const __m128i high = _mm_unpackhi_epi32(value, value);
+
+					_mm_storeu_si128((__m128i*)(dst_row0 + x * 2 * sizeof(u32)), low);
+					_mm_storeu_si128((__m128i*)(dst_row0 + x * 2 * sizeof(u32) + 16), high);
+					_mm_storeu_si128((__m128i*)(dst_row1 + x * 2 * sizeof(u32)), low);
+					_mm_storeu_si128((__m128i*)(dst_row1 + x * 2 * sizeof(u32) + 16), high);
+				}
+
+				for (; x < width; ++x)
+				{
+					u32 value = *(u32*)(src_row + x * sizeof(u32));
 
-					*(u32*)(ptr + (offset_y + y * 2 + 0) * tile->pitch + offset_x + (x * 2 + 0) * sizeof(u32)) = value;
-					*(u32*)(ptr + (offset_y + y * 2 + 0) * tile->pitch + offset_x + (x * 2 + 1) * sizeof(u32)) = value;
-					*(u32*)(ptr + (offset_y + y * 2 + 1) * tile->pitch + offset_x + (x * 2 + 0) * sizeof(u32)) = value;
-					*(u32*)(ptr + (offset_y + y * 2 + 1) * tile->pitch + offset_x + (x * 2 + 1) * sizeof(u32)) = value;
+					*(u32*)(dst_row0 + (x * 2 + 0) * sizeof(u32)) = value;
+					*(u32*)(dst_row0 + (x * 2 + 1) * sizeof(u32)) = value;
+					*(u32*)(dst_row1 + (x * 2 + 0) * sizeof(u32)) = value;
+					*(u32*)(dst_row1 + (x * 2 + 1) * sizeof(u32)) = value;
 				}
 			}
 			break;
@@ -221,7 +278,7 @@ namespace rsx
 		}
 	}
 
-	void tiled_region::read(void *dst, u32 width, u32 height, u32 pitch)
+	void tiled_region::read(void *dst, u32 width, u32 height, u32 pitch) const
 	{
 		if (!tile)
 		{
@@ -257,11 +314,23 @@ namespace rsx
 		case CELL_GCM_COMPMODE_C32_2X2:
 			for (u32 y = 0; y < height; ++y)
 			{
-				for (u32 x = 0; x < width; ++x)
+				const u8 *src_row = ptr + (offset_y + y * 2 + 0) * tile->pitch + offset_x;
+				u8 *dst_row = (u8*)dst + pitch * y;
+
+				// Keep the even pixels of the even rows, 4 pixels at a time
+				u32 x = 0;
+				for (; x + 4 <= width; x += 4)
 				{
-					u32 value = *(u32*)(ptr + (offset_y + y * 2 + 0) * tile->pitch + offset_x + (x * 2 + 0) * sizeof(u32));
+					const __m128 value0 = _mm_loadu_ps((const float*)(src_row + x * 2 * sizeof(u32)));
+					const __m128 value1 = _mm_loadu_ps((const float*)(src_row + x * 2 * sizeof(u32) + 16));
+					_mm_storeu_ps((float*)(dst_row + x * sizeof(u32)), _mm_shuffle_ps(value0, value1, _MM_SHUFFLE(2, 0, 2, 0)));
+				}
 
-					*(u32*)((u8*)dst + pitch * y + x * sizeof(u32)) = value;
+				for (; x < width; ++x)
+				{
+					u32 value = *(u32*)(src_row + (x * 2 + 0) * sizeof(u32));
+
+					*(u32*)(dst_row + x * sizeof(u32)) = value;
 				}
 			}
 			break;
@@ -316,187 +385,1138 @@ namespace rsx
 		}
 		draw_state.programs = get_programs();
 		draw_state.name = name;
-		frame_debug.draw_calls.push_back(draw_state);
-	}
 
-	void thread::begin()
-	{
-		first_count_commands.clear();
-		draw_mode = to_primitive_type(method_registers[NV4097_SET_BEGIN_END]);
+		// Draws of the last captured frame are kept for the debugger
+		if (frame_debug.frame_count + 1 >= std::max<u32>(rpcs3::state.config.rsx.capture_frames.value(), 1))
+		{
+			capture_file.write_draw(draw_state);
+			frame_debug.draw_calls.push_back(std::move(draw_state));
+		}
+		else
+		{
+			capture_file.write_draw(std::move(draw_state));
+		}
 	}
 
-	void thread::end()
+	void thread::capture_state()
 	{
-		transform_constants.clear();
+		frame_debug.registers.assign(method_registers, method_registers + sizeof(method_registers) / sizeof(u32));
+		frame_debug.transform_program.assign(std::begin(transform_program), std::end(transform_program));
 
-		if (capture_current_frame)
+		const auto constants = reinterpret_cast<const u8*>(transform_constants);
+		frame_debug.transform_constants.assign(constants, constants + sizeof(transform_constants));
+
+		const auto tiles_data = reinterpret_cast<const u8*>(tiles);
+		frame_debug.tiles.assign(tiles_data, tiles_data + sizeof(tiles));
+
+		const auto zculls_data = reinterpret_cast<const u8*>(zculls);
+		frame_debug.zculls.assign(zculls_data, zculls_data + sizeof(zculls));
+
+		frame_debug.io_address = ioAddress;
+		frame_debug.io_size = ioSize;
+		frame_debug.label_address = label_addr;
+		frame_debug.display_buffers_address = gcm_buffers.addr();
+		frame_debug.display_buffers_count = gcm_buffers_count;
+
+		// Record allocated pages of the range in blocks of at most 64 KB
+		const auto add_memory = [](u32 addr, u32 size)
 		{
-			capture_frame("Draw " + std::to_string(vertex_draw_count));
+			for (u32 pos = addr & ~0xfff; pos < addr + size;)
+			{
+				if (!vm::check_addr(pos, 4096))
+				{
+					pos += 4096;
+					continue;
+				}
+
+				u32 end = pos + 4096;
+
+				while (end < addr + size && end - pos < 0x10000 && vm::check_addr(end, 4096))
+				{
+					end += 4096;
+				}
+
+				const auto ptr = vm::_ptr<const u8>(pos);
+
+				frame_capture_data::memory_block block{ pos, end - pos };
+
+				if (!std::all_of(ptr, ptr + block.size, [](u8 value) { return value == 0; }))
+				{
+					block.data.assign(ptr, ptr + block.size);
+				}
+
+				frame_debug.memory.emplace_back(std::move(block));
+
+				pos = end;
+			}
+		};
+
+		// Local memory size is the end of the last allocated page
+		u32 local_size = 0;
+
+		for (u32 pos = 0; pos < 0x10000000; pos += 4096)
+		{
+			if (vm::check_addr(local_mem_addr + pos, 4096))
+			{
+				local_size = pos + 4096;
+			}
+		}
+
+		frame_debug.local_address = local_mem_addr;
+		frame_debug.local_size = local_size;
+		add_memory(local_mem_addr, local_size);
+
+		for (const auto& mapping : RSXIOMem.GetMappedMemory())
+		{
+			frame_debug.io_map.push_back({ mapping.addr, mapping.realAddress, mapping.size });
+			add_memory(mapping.realAddress, mapping.size);
 		}
+
+		add_memory(label_addr, 0x1000);
+		add_memory(gcm_buffers.addr(), sizeof(CellGcmDisplayInfo) * 8);
+
+		capture_file.write_state(frame_debug);
 	}
 
-	void thread::on_task()
+	void thread::replay_task()
 	{
-		on_init_thread();
+		const frame_capture_data& capture = *replay_capture;
 
-		reset();
+		struct draw_stats
+		{
+			u64 cpu_total = 0;
+			u64 cpu_min = UINT64_MAX;
+			u64 gpu_total = 0;
+			u64 gpu_min = UINT64_MAX;
+		};
 
-		last_flip_time = get_system_time() - 1000000;
+		// Statistics in nanoseconds per draw (numbered in the capture order)
+		std::vector<draw_stats> stats;
+		std::vector<u32> timers; // GPU timer queries of the current loop
+		u64 loops_total = 0;
+		u32 loops_done = 0;
 
-		scope_thread_t vblank(PURE_EXPR("VBlank Thread"s), [this]()
+		// Draws are measured separately
+		merge_draws = false;
+
+		LOG_NOTICE(RSX, "Replaying capture: %u frame(s), %llu commands, %u loop(s)", capture.frame_count, (u64)capture.command_queue.size(), replay_loops);
+
+		const auto now = []()
 		{
-			const u64 start_time = get_system_time();
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		};
 
-			vblank_count = 0;
+		for (; loops_done < replay_loops && !Emu.IsStopped(); loops_done++)
+		{
+			// Restore the state of the start of the capture
+			for (const auto& block : capture.memory)
+			{
+				if (block.data.empty())
+				{
+					std::memset(vm::base(block.addr), 0, block.size);
+				}
+				else
+				{
+					std::memcpy(vm::base(block.addr), block.data.data(), block.size);
+				}
+			}
 
-			// TODO: exit condition
-			while (!Emu.IsStopped())
+			std::memcpy(method_registers, capture.registers.data(), sizeof(method_registers));
+			std::memcpy(transform_program, capture.transform_program.data(), std::min(sizeof(transform_program), capture.transform_program.size() * sizeof(u32)));
+			std::memcpy(transform_constants, capture.transform_constants.data(), std::min(sizeof(transform_constants), capture.transform_constants.size()));
+			std::memcpy(tiles, capture.tiles.data(), std::min(sizeof(tiles), capture.tiles.size()));
+			std::memcpy(zculls, capture.zculls.data(), std::min(sizeof(zculls), capture.zculls.size()));
+			transform_constants_dirty_begin = 0;
+			transform_constants_dirty_end = limits::transform_constants_count;
+			programs_dirty = true;
+
+			const u64 loop_start = now();
+			u64 draw_start = 0;
+			u32 timer = 0;
+			u32 draw = 0;
+
+			for (const auto& command : capture.command_queue)
 			{
-				if (get_system_time() - start_time > vblank_count * 1000000 / 60)
+				const u32 reg = command.first;
+				const u32 value = command.second;
+
+				do_local_task();
+
+				method_registers[reg] = value;
+
+				if (reg == NV406E_SEMAPHORE_ACQUIRE)
+				{
+					// Values written by the guest during the capture aren't available
+					continue;
+				}
+
+				if (reg == GCM_FLIP_COMMAND)
+				{
+					// Presented without frame limit and guest callbacks
+					flip(value);
+					reset();
+					continue;
+				}
+
+				if (reg == NV4097_SET_BEGIN_END && value)
+				{
+					draw_start = now();
+					timer = begin_gpu_timer();
+				}
+
+				if (auto method = methods[reg])
+					method(this, value);
+
+				if (reg == NV4097_SET_BEGIN_END && !value && draw_start)
 				{
-					vblank_count++;
+					const u64 cpu_time = now() - draw_start;
 
-					if (vblank_handler)
+					if (timer)
 					{
-						Emu.GetCallbackManager().Async([func = vblank_handler](PPUThread& ppu)
-						{
-							func(ppu, 1);
-						});
+						end_gpu_timer(timer);
 					}
 
-					continue;
+					timers.push_back(timer);
+
+					if (stats.size() <= draw)
+					{
+						stats.resize(draw + 1);
+					}
+
+					stats[draw].cpu_total += cpu_time;
+					stats[draw].cpu_min = std::min(stats[draw].cpu_min, cpu_time);
+					draw_start = 0;
+					draw++;
 				}
+			}
 
-				std::this_thread::sleep_for(1ms); // hack
+			// GPU results are read at the end of the loop to not stall between draws
+			for (u32 i = 0; i < timers.size(); i++)
+			{
+				if (timers[i])
+				{
+					const u64 gpu_time = get_gpu_timer_result(timers[i]);
+
+					stats[i].gpu_total += gpu_time;
+					stats[i].gpu_min = std::min(stats[i].gpu_min, gpu_time);
+				}
 			}
-		});
 
-		// TODO: exit condition
-		while (true)
+			timers.clear();
+
+			loops_total += now() - loop_start;
+		}
+
+		if (loops_done)
 		{
-			CHECK_EMU_STATUS;
+			u64 cpu_total = 0, gpu_total = 0;
 
-			be_t<u32> get = ctrl->get;
-			be_t<u32> put = ctrl->put;
+			std::string csv = "draw,cpu_avg_us,cpu_min_us,gpu_avg_us,gpu_min_us\n";
 
-			if (put == get || !Emu.IsRunning())
+			for (u32 i = 0; i < stats.size(); i++)
 			{
-				std::this_thread::sleep_for(std::chrono::milliseconds(1)); // hack
-				continue;
-			}
+				const auto& s = stats[i];
 
-			const u32 cmd = ReadIO32(get);
-			const u32 count = (cmd >> 18) & 0x7ff;
+				cpu_total += s.cpu_total;
+				gpu_total += s.gpu_total;
 
-			if (cmd & CELL_GCM_METHOD_FLAG_JUMP)
-			{
-				u32 offs = cmd & 0x1fffffff;
-				//LOG_WARNING(RSX, "rsx jump(0x%x) #addr=0x%x, cmd=0x%x, get=0x%x, put=0x%x", offs, m_ioAddress + get, cmd, get, put);
-				ctrl->get = offs;
-				continue;
+				csv += fmt::format("%u,%.3f,%.3f,%.3f,%.3f\n", i, s.cpu_total / 1000. / loops_done, s.cpu_min / 1000., s.gpu_total / 1000. / loops_done, s.gpu_total ? s.gpu_min / 1000. : 0.);
 			}
-			if (cmd & CELL_GCM_METHOD_FLAG_CALL)
+
+			LOG_SUCCESS(RSX, "Replay: %u loop(s), %.3f ms per loop, %llu draws, CPU %.3f ms and GPU %.3f ms per loop in draws", loops_done, loops_total / 1e6 / loops_done, (u64)stats.size(), cpu_total / 1e6 / loops_done, gpu_total / 1e6 / loops_done);
+
+			const std::string path = fs::get_config_dir() + "RPCS3.replay.csv";
+
+			if (fs::file file{ path, fom::rewrite })
 			{
-				m_call_stack.push(get + 4);
-				u32 offs = cmd & ~3;
-				//LOG_WARNING(RSX, "rsx call(0x%x) #0x%x - 0x%x", offs, cmd, get);
-				ctrl->get = offs;
-				continue;
+				file.write(csv);
+				LOG_NOTICE(RSX, "Replay statistics per draw saved to %s", path);
 			}
-			if (cmd == CELL_GCM_METHOD_FLAG_RETURN)
+			else
 			{
-				u32 get = m_call_stack.top();
-				m_call_stack.pop();
-				//LOG_WARNING(RSX, "rsx return(0x%x)", get);
-				ctrl->get = get;
-				continue;
+				LOG_ERROR(RSX, "Failed to save replay statistics to %s", path);
 			}
+		}
 
-			if (cmd == 0) //nop
-			{
-				ctrl->get = get + 4;
-				continue;
-			}
+		Emu.CallAfter([]()
+		{
+			Emu.Stop();
+		});
+	}
 
-			auto args = vm::ptr<u32>::make((u32)RSXIOMem.RealAddr(get + 4));
+	void thread::begin()
+	{
+		first_count_commands.clear();
 
-			u32 first_cmd = (cmd & 0xffff) >> 2;
+		// Inline vertex data is appended in bulk by the FIFO, the capacity is kept between draws
+		inline_vertex_array.reserve(0x10000);
+		draw_mode = to_primitive_type(method_registers[NV4097_SET_BEGIN_END]);
 
-			if (cmd & 0x3)
-			{
-				LOG_WARNING(RSX, "unaligned command: %s (0x%x from 0x%x)", get_method_name(first_cmd).c_str(), first_cmd, cmd & 0xffff);
-			}
+		if (method_registers[NV4097_SET_ZPASS_PIXEL_COUNT_ENABLE])
+		{
+			if (!m_zpass_query)
+				m_zpass_query = begin_occlusion_query();
+		}
+		else
+		{
+			end_zpass_query();
+		}
+	}
 
-			for (u32 i = 0; i < count; i++)
-			{
-				u32 reg = cmd & CELL_GCM_METHOD_FLAG_NON_INCREMENT ? first_cmd : first_cmd + i;
-				u32 value = args[i];
+	void thread::end()
+	{
+		perf::add(perf::draws);
 
-				if (rpcs3::config.misc.log.rsx_logging.value())
-				{
-					LOG_NOTICE(RSX, "%s(0x%x) = 0x%x", get_method_name(reg).c_str(), reg, value);
-				}
+		if (capture_current_frame)
+		{
+			capture_frame("Draw " + std::to_string(vertex_draw_count));
+		}
+	}
 
-				method_registers[reg] = value;
-				if (capture_current_frame)
-					frame_debug.command_queue.push_back(std::make_pair(reg, value));
+	bool thread::can_defer_end() const
+	{
+		if (!merge_draws || capture_current_frame || draw_command == Draw_command::draw_command_inlined_array || first_count_commands.empty())
+		{
+			return false;
+		}
 
-				if (auto method = methods[reg])
-					method(this, value);
-			}
+		// Concatenated ranges of strips, fans and loops would be joined
+		switch (draw_mode)
+		{
+		case Primitive_type::points:
+		case Primitive_type::lines:
+		case Primitive_type::triangles:
+		case Primitive_type::quads:
+			return true;
+		}
 
-			ctrl->get = get + (count + 1) * 4;
+		return false;
+	}
+
+	bool thread::can_merge_command(u32 reg, u32 value) const
+	{
+		if (reg == NV4097_SET_BEGIN_END)
+		{
+			return value && to_primitive_type(value) == draw_mode;
 		}
+
+		// Commands with a handler may have side effects, other registers must keep their value
+		return !methods[reg] && method_registers[reg] == value;
 	}
 
-	std::string thread::get_name() const
+	void thread::end_deferred_draw()
 	{
-		return "rsx::thread"s;
+		if (deferred_end)
+		{
+			deferred_end = false;
+			end();
+		}
 	}
 
-	void thread::fill_scale_offset_data(void *buffer, bool is_d3d) const
+	void thread::end_zpass_query()
 	{
-		int clip_w = rsx::method_registers[NV4097_SET_SURFACE_CLIP_HORIZONTAL] >> 16;
-		int clip_h = rsx::method_registers[NV4097_SET_SURFACE_CLIP_VERTICAL] >> 16;
+		if (m_zpass_query)
+		{
+			end_occlusion_query(m_zpass_query);
+			m_zpass_queries.push_back(m_zpass_query);
+			m_zpass_query = 0;
+		}
+	}
 
-		float scale_x = (float&)rsx::method_registers[NV4097_SET_VIEWPORT_SCALE] / (clip_w / 2.f);
-		float offset_x = (float&)rsx::method_registers[NV4097_SET_VIEWPORT_OFFSET] - (clip_w / 2.f);
-		offset_x /= clip_w / 2.f;
+	void thread::get_zpass_report(u32 address)
+	{
+		end_zpass_query();
 
-		float scale_y = (float&)rsx::method_registers[NV4097_SET_VIEWPORT_SCALE + 1] / (clip_h / 2.f);
-		float offset_y = ((float&)rsx::method_registers[NV4097_SET_VIEWPORT_OFFSET + 1] - (clip_h / 2.f));
-		offset_y /= clip_h / 2.f;
-		if (is_d3d) scale_y *= -1;
-		if (is_d3d) offset_y *= -1;
+		std::lock_guard<std::mutex> lock(m_reports_mutex);
 
-		float scale_z = (float&)rsx::method_registers[NV4097_SET_VIEWPORT_SCALE + 2];
-		float offset_z = (float&)rsx::method_registers[NV4097_SET_VIEWPORT_OFFSET + 2];
-		if (!is_d3d) offset_z -= .5;
+		const u64 timestamp = this->timestamp();
 
-		float one = 1.f;
+		if (m_zpass_queries.empty() && m_pending_reports.empty())
+		{
+			if (m_zpass_counter_reset)
+				m_zpass_counter = 0;
+			m_zpass_counter_reset = false;
 
-		stream_vector(buffer, (u32&)scale_x, 0, 0, (u32&)offset_x);
-		stream_vector((char*)buffer + 16, 0, (u32&)scale_y, 0, (u32&)offset_y);
-		stream_vector((char*)buffer + 32, 0, 0, (u32&)scale_z, (u32&)offset_z);
-		stream_vector((char*)buffer + 48, 0, 0, 0, (u32&)one);
+			vm::ps3::ptr<CellGcmReportData> result = { address, vm::addr };
+			result->timer = timestamp;
+			result->value = (u32)m_zpass_counter;
+			return;
+		}
+
+		// Pages may already be protected by a previous report
+		vm::page_protect(address & ~0xfff, 4096, 0, 0, vm::page_readable | vm::page_writable);
+
+		m_pending_reports.push_back({ address, timestamp, m_zpass_counter_reset, std::move(m_zpass_queries) });
+		m_zpass_queries.clear();
+		m_zpass_counter_reset = false;
 	}
 
-	/**
-	* Fill buffer with vertex program constants.
-	* Buffer must be at least 512 float4 wide.
-	*/
-	void thread::fill_vertex_program_constants_data(void *buffer)
+	void thread::clear_zpass_report()
 	{
-		for (const auto &entry : transform_constants)
-			local_transform_constants[entry.first] = entry.second;
-		for (const auto &entry : local_transform_constants)
-			stream_vector_from_memory((char*)buffer + entry.first * 4 * sizeof(float), (void*)entry.second.rgba);
+		end_zpass_query();
+
+		std::lock_guard<std::mutex> lock(m_reports_mutex);
+
+		// Results of the previous queries are still fetched to release them
+		if (!m_zpass_queries.empty())
+		{
+			m_pending_reports.push_back({ 0, 0, m_zpass_counter_reset, std::move(m_zpass_queries) });
+			m_zpass_queries.clear();
+		}
+
+		m_zpass_counter_reset = true;
 	}
 
-	void thread::write_inline_array_to_buffer(void *dst_buffer)
+	void thread::write_reports(bool wait)
 	{
-		u8* src = reinterpret_cast<u8*>(inline_vertex_array.data());
-		u8* dst = (u8*)dst_buffer;
+		while (!m_pending_reports.empty())
+		{
+			pending_report &report = m_pending_reports.front();
+
+			if (!wait)
+			{
+				for (u32 query : report.queries)
+				{
+					if (!check_occlusion_query(query))
+						return;
+				}
+			}
+
+			if (report.reset_counter)
+				m_zpass_counter = 0;
+
+			for (u32 query : report.queries)
+				m_zpass_counter += get_occlusion_query_result(query);
+
+			const u32 address = report.address;
+			const u64 timestamp = report.timestamp;
+			m_pending_reports.pop_front();
+
+			if (!address)
+				continue;
+
+			const u32 page = address & ~0xfff;
+			vm::page_protect(page, 4096, 0, vm::page_readable | vm::page_writable, 0);
+
+			vm::ps3::ptr<CellGcmReportData> result = { address, vm::addr };
+			result->timer = timestamp;
+			result->value = (u32)m_zpass_counter;
+
+			for (const pending_report &other : m_pending_reports)
+			{
+				if (other.address && (other.address & ~0xfff) == page)
+				{
+					vm::page_protect(page, 4096, 0, 0, vm::page_readable | vm::page_writable);
+					break;
+				}
+			}
+		}
+	}
+
+	void thread::update_reports()
+	{
+		std::lock_guard<std::mutex> lock(m_reports_mutex);
+
+		if (m_pending_reports.empty() && !m_reports_sync_requested)
+			return;
+
+		write_reports(m_reports_sync_requested);
+
+		if (m_reports_sync_requested)
+		{
+			m_reports_sync_requested = false;
+			m_reports_cv.notify_all();
+		}
+	}
+
+	bool thread::on_report_access(u32 addr)
+	{
+		std::unique_lock<std::mutex> lock(m_reports_mutex);
+
+		const u32 page = addr & ~0xfff;
+
+		if (std::none_of(m_pending_reports.begin(), m_pending_reports.end(), [page](const pending_report &report) { return report.address && (report.address & ~0xfff) == page; }))
+		{
+			return false;
+		}
+
+		if (std::this_thread::get_id() == m_rsx_thread_id)
+		{
+			write_reports(true);
+			return true;
+		}
+
+		// Query results can only be read by the RSX thread
+		m_reports_sync_requested = true;
+
+		lock.unlock();
+		fifo_wakeup();
+		lock.lock();
+
+		while (m_reports_sync_requested)
+		{
+			if (Emu.IsStopped())
+			{
+				m_reports_sync_requested = false;
+				return false;
+			}
+
+			m_reports_cv.wait_for(lock, 1ms);
+		}
+
+		return true;
+	}
+
+	void thread::on_task()
+	{
+		m_rsx_thread_id = std::this_thread::get_id();
+
+		host_thread_policy::apply_rsx_thread();
+
+		on_init_thread();
+
+		reset();
+
+		last_flip_time = get_system_time() - 1000000;
+
+		merge_draws = rpcs3::state.config.rsx.merge_draws.value();
+
+		if (replay_capture)
+		{
+			replay_task();
+			return;
+		}
+
+		scope_thread_t vblank(PURE_EXPR("VBlank Thread"s), [this]()
+		{
+			const u64 start_time = get_system_time();
+
+			vblank_count = 0;
+
+			// TODO: exit condition
+			while (!Emu.IsStopped())
+			{
+				// Sleep until the next vblank
+				wait_until_system_time(start_time + vblank_count * 1000000 / 60);
+
+				vblank_count++;
+
+				if (vblank_handler)
+				{
+					Emu.GetCallbackManager().Async([func = vblank_handler](PPUThread& ppu)
+					{
+						func(ppu, 1);
+					});
+				}
+			}
+		});
+
+		if (rpcs3::state.config.rsx.async_fifo.value())
+		{
+			scope_thread_t parser(PURE_EXPR("RSX FIFO Thread"s), [this]()
+			{
+				fifo_parser_task();
+			});
+
+			fifo_consumer_task();
+			return;
+		}
+
+		// TODO: exit condition
+		while (true)
+		{
+			CHECK_EMU_STATUS;
+
+			do_local_task();
+			update_reports();
+
+			be_t<u32> get = ctrl->get;
+			be_t<u32> put = ctrl->put;
+
+			if (put == get || !Emu.IsRunning())
+			{
+				end_deferred_draw();
+				wait_fifo();
+				continue;
+			}
+
+			// Fast path: execute pre-decoded method headers up to the next flow control command
+			if (fifo_decode(get, put))
+			{
+				fifo_execute();
+				continue;
+			}
+
+			const u32 cmd = ReadIO32(get);
+			const u32 count = (cmd >> 18) & 0x7ff;
+
+			if (fifo_flow_control(get, cmd))
+			{
+				continue;
+			}
+
+			auto args = vm::ptr<u32>::make((u32)RSXIOMem.RealAddr(get + 4));
+
+			u32 first_cmd = (cmd & 0xffff) >> 2;
+
+			if (cmd & 0x3)
+			{
+				LOG_WARNING(RSX, "unaligned command: %s (0x%x from 0x%x)", get_method_name(first_cmd).c_str(), first_cmd, cmd & 0xffff);
+			}
+
+			for (u32 i = 0; i < count; i++)
+			{
+				u32 reg = cmd & CELL_GCM_METHOD_FLAG_NON_INCREMENT ? first_cmd : first_cmd + i;
+				u32 value = args[i];
+
+				if (rpcs3::config.misc.log.rsx_logging.value())
+				{
+					log_method(reg, value);
+				}
+
+				check_deferred_draw(reg, value);
+
+				method_registers[reg] = value;
+				if (capture_current_frame)
+					frame_debug.command_queue.push_back(std::make_pair(reg, value));
+
+				if (auto method = methods[reg])
+					method(this, value);
+			}
+
+			ctrl->get = get + (count + 1) * 4;
+		}
+	}
+
+	bool thread::fifo_flow_control(u32 get, u32 cmd)
+	{
+		if (cmd & CELL_GCM_METHOD_FLAG_JUMP)
+		{
+			u32 offs = cmd & 0x1fffffff;
+			//LOG_WARNING(RSX, "rsx jump(0x%x) #addr=0x%x, cmd=0x%x, get=0x%x", offs, m_ioAddress + get, cmd, get);
+			ctrl->get = offs;
+			return true;
+		}
+		if (cmd & CELL_GCM_METHOD_FLAG_CALL)
+		{
+			m_call_stack.push(get + 4);
+			u32 offs = cmd & ~3;
+			//LOG_WARNING(RSX, "rsx call(0x%x) #0x%x - 0x%x", offs, cmd, get);
+			ctrl->get = offs;
+			return true;
+		}
+		if (cmd == CELL_GCM_METHOD_FLAG_RETURN)
+		{
+			u32 get = m_call_stack.top();
+			m_call_stack.pop();
+			//LOG_WARNING(RSX, "rsx return(0x%x)", get);
+			ctrl->get = get;
+			return true;
+		}
+
+		if (cmd == 0) //nop
+		{
+			ctrl->get = get + 4;
+			return true;
+		}
+
+		return false;
+	}
+
+	void thread::fifo_parser_task()
+	{
+		fifo_packet_t packet;
+
+		while (!Emu.IsStopped())
+		{
+			const u32 get = ctrl->get.load();
+			const u32 put = ctrl->put.load();
+
+			if (put == get || !Emu.IsRunning())
+			{
+				if (!packet.empty())
+				{
+					push_packet(packet);
+				}
+
+				wait_fifo();
+				continue;
+			}
+
+			if (fifo_decode(get, put))
+			{
+				for (const auto& cmd : m_fifo_commands)
+				{
+					const u32* args = m_fifo_buffer.data() + cmd.args;
+
+					bool seal = false;
+
+					for (u32 i = 0; i < cmd.count; i++)
+					{
+						const u32 reg = cmd.non_increment ? cmd.reg : cmd.reg + i;
+
+						packet.emplace_back(reg, args[i]);
+
+						// Finish packet on draw end or flip
+						seal |= (reg == NV4097_SET_BEGIN_END && !args[i]) || reg == GCM_FLIP_COMMAND;
+					}
+
+					// The command buffer space can be reused as soon as it's recorded
+					ctrl->get = cmd.get + (cmd.count + 1) * 4;
+
+					if (seal || packet.size() >= 0x10000)
+					{
+						push_packet(packet);
+					}
+				}
+
+				continue;
+			}
+
+			const u32 cmd = ReadIO32(get);
+			const u32 count = (cmd >> 18) & 0x7ff;
+
+			if (fifo_flow_control(get, cmd))
+			{
+				continue;
+			}
+
+			auto args = vm::ptr<u32>::make((u32)RSXIOMem.RealAddr(get + 4));
+
+			u32 first_cmd = (cmd & 0xffff) >> 2;
+
+			if (cmd & 0x3)
+			{
+				LOG_WARNING(RSX, "unaligned command: %s (0x%x from 0x%x)", get_method_name(first_cmd).c_str(), first_cmd, cmd & 0xffff);
+			}
+
+			for (u32 i = 0; i < count; i++)
+			{
+				packet.emplace_back(cmd & CELL_GCM_METHOD_FLAG_NON_INCREMENT ? first_cmd : first_cmd + i, args[i]);
+			}
+
+			ctrl->get = get + (count + 1) * 4;
+		}
+	}
+
+	void thread::push_packet(fifo_packet_t& packet)
+	{
+		const std::size_t max_queued_packets = 256;
+
+		std::unique_lock<std::mutex> lock(m_packet_mutex);
+
+		// Backpressure: don't let the parser run too far ahead of the backend
+		while (m_packet_queue.size() >= max_queued_packets && !Emu.IsStopped())
+		{
+			m_packet_cv.wait_for(lock, 1ms);
+		}
+
+		m_packet_queue.emplace_back(std::move(packet));
+
+		if (m_packet_pool.empty())
+		{
+			packet = fifo_packet_t();
+		}
+		else
+		{
+			packet = std::move(m_packet_pool.back());
+			m_packet_pool.pop_back();
+		}
+
+		m_packet_cv.notify_all();
+	}
+
+	void thread::fifo_consumer_task()
+	{
+		fifo_packet_t packet;
+
+		while (true)
+		{
+			CHECK_EMU_STATUS;
+
+			do_local_task();
+			update_reports();
+
+			{
+				std::unique_lock<std::mutex> lock(m_packet_mutex);
+
+				// Recycle storage of the previous packet
+				if (packet.capacity())
+				{
+					packet.clear();
+					m_packet_pool.emplace_back(std::move(packet));
+					packet = fifo_packet_t();
+				}
+
+				if (m_packet_queue.empty() || !Emu.IsRunning())
+				{
+					if (deferred_end)
+					{
+						lock.unlock();
+						end_deferred_draw();
+						continue;
+					}
+
+					m_packet_cv.wait_for(lock, 1ms);
+					continue;
+				}
+
+				packet = std::move(m_packet_queue.front());
+				m_packet_queue.pop_front();
+				m_packet_cv.notify_all();
+			}
+
+			const bool rsx_logging = rpcs3::config.misc.log.rsx_logging.value();
+
+			for (const auto& command : packet)
+			{
+				const u32 reg = command.first;
+				const u32 value = command.second;
+
+				if (rsx_logging)
+				{
+					log_method(reg, value);
+				}
+
+				check_deferred_draw(reg, value);
+
+				method_registers[reg] = value;
+
+				if (capture_current_frame)
+					frame_debug.command_queue.push_back(command);
+
+				if (auto method = methods[reg])
+					method(this, value);
+			}
+		}
+	}
+
+	bool thread::fifo_decode(u32 get, u32 put)
+	{
+		m_fifo_buffer.clear();
+		m_fifo_commands.clear();
+
+		u32 size = std::min<u32>(((put > get ? put : get + 0x10000) - get) / 4, 0x4000);
+
+		// Take the whole range if it's contiguous in guest memory, otherwise stop at the end of the 1 MB IO page
+		auto src = static_cast<const be_t<u32>*>(RSXIOMem.get_range_ptr(get, size * 4));
+
+		if (!src)
+		{
+			const u32 page_end = (get & ~0xfffff) + 0x100000;
+			size = std::min<u32>(size, (page_end - get) / 4);
+
+			const u32 addr = (u32)RSXIOMem.RealAddr(get);
+			src = addr ? vm::_ptr<const be_t<u32>>(addr) : nullptr;
+		}
+
+		if (!src || !size)
+		{
+			return false;
+		}
+
+		// Snapshot the command buffer (put is only advanced after the commands have been written)
+
+		m_fifo_buffer.resize(size);
+
+		for (u32 i = 0; i < size; i++)
+		{
+			m_fifo_buffer[i] = src[i];
+		}
+
+		for (u32 pos = 0; pos < size;)
+		{
+			const u32 cmd = m_fifo_buffer[pos];
+			const u32 count = (cmd >> 18) & 0x7ff;
+			const u32 reg = (cmd & 0xffff) >> 2;
+
+			// Leave flow control, unaligned and incomplete commands to the slow path
+			if (cmd & (CELL_GCM_METHOD_FLAG_JUMP | CELL_GCM_METHOD_FLAG_CALL | 0x3) || cmd == CELL_GCM_METHOD_FLAG_RETURN)
+			{
+				break;
+			}
+
+			if (pos + count + 1 > size || (~cmd & CELL_GCM_METHOD_FLAG_NON_INCREMENT && reg + count > 0x4000))
+			{
+				break;
+			}
+
+			m_fifo_commands.push_back({ get + pos * 4, reg, count, pos + 1, (cmd & CELL_GCM_METHOD_FLAG_NON_INCREMENT) != 0 });
+
+			pos += count + 1;
+		}
+
+		return !m_fifo_commands.empty();
+	}
+
+	void thread::fifo_execute()
+	{
+		const bool rsx_logging = rpcs3::config.misc.log.rsx_logging.value();
+
+		for (const auto& cmd : m_fifo_commands)
+		{
+			if (!Emu.IsRunning())
+			{
+				// ctrl->get points to the first command not executed
+				break;
+			}
+
+			const u32* args = m_fifo_buffer.data() + cmd.args;
+
+			if (rsx_logging || capture_current_frame)
+			{
+				for (u32 i = 0; i < cmd.count; i++)
+				{
+					const u32 reg = cmd.non_increment ? cmd.reg : cmd.reg + i;
+
+					if (rsx_logging)
+					{
+						log_method(reg, args[i]);
+					}
+
+					check_deferred_draw(reg, args[i]);
+
+					method_registers[reg] = args[i];
+
+					if (capture_current_frame)
+						frame_debug.command_queue.push_back(std::make_pair(reg, args[i]));
+
+					if (auto method = methods[reg])
+						method(this, args[i]);
+				}
+			}
+			else if (cmd.non_increment && cmd.reg == NV4097_INLINE_ARRAY && cmd.count)
+			{
+				// The handler only appends the value, the rest of the run is copied at once
+				check_deferred_draw(cmd.reg, args[0]);
+				methods[cmd.reg](this, args[0]);
+
+				inline_vertex_array.insert(inline_vertex_array.end(), args + 1, args + cmd.count);
+				method_registers[cmd.reg] = args[cmd.count - 1];
+			}
+			else if (cmd.non_increment)
+			{
+				if (auto method = methods[cmd.reg])
+				{
+					for (u32 i = 0; i < cmd.count; i++)
+					{
+						check_deferred_draw(cmd.reg, args[i]);
+						method_registers[cmd.reg] = args[i];
+						method(this, args[i]);
+					}
+				}
+				else if (cmd.count)
+				{
+					// Only the last value is observable
+					check_deferred_draw(cmd.reg, args[cmd.count - 1]);
+					method_registers[cmd.reg] = args[cmd.count - 1];
+				}
+			}
+			else
+			{
+				// Write runs of registers without handlers in bulk
+				for (u32 i = 0; i < cmd.count;)
+				{
+					u32 run = 0;
+
+					while (i + run < cmd.count && !methods[cmd.reg + i + run])
+					{
+						run++;
+					}
+
+					if (run)
+					{
+						if (deferred_end && std::memcmp(method_registers + cmd.reg + i, args + i, run * sizeof(u32)))
+						{
+							end_deferred_draw();
+						}
+
+						std::memcpy(method_registers + cmd.reg + i, args + i, run * sizeof(u32));
+						i += run;
+						continue;
+					}
+
+					check_deferred_draw(cmd.reg + i, args[i]);
+					method_registers[cmd.reg + i] = args[i];
+					methods[cmd.reg + i](this, args[i]);
+					i++;
+				}
+			}
+
+			ctrl->get = cmd.get + (cmd.count + 1) * 4;
+		}
+	}
+
+	void thread::wait_fifo()
+	{
+		const u64 min_spin_time = 4;
+		const u64 max_spin_time = 256;
+
+		// Spin first: commands are usually submitted in bursts
+		const u64 start = get_system_time();
+
+		while (get_system_time() - start < m_fifo_spin_time)
+		{
+			if (ctrl->put.load() != ctrl->get.load() && Emu.IsRunning())
+			{
+				// Commands arrived while spinning, spin longer next time
+				m_fifo_spin_time = std::min(m_fifo_spin_time * 2, max_spin_time);
+				return;
+			}
+
+			_mm_pause();
+		}
+
+		m_fifo_spin_time = std::max(m_fifo_spin_time / 2, min_spin_time);
+
+		std::unique_lock<std::mutex> lock(mutex);
+
+		// Guest code may update ctrl->put directly without calling fifo_wakeup(), so the wait is bounded
+		if (ctrl->put.load() == ctrl->get.load() || !Emu.IsRunning())
+		{
+			cv.wait_for(lock, 1ms);
+		}
+	}
+
+	void thread::fifo_wakeup()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		cv.notify_one();
+	}
+
+	std::string thread::get_name() const
+	{
+		return "rsx::thread"s;
+	}
+
+	void thread::set_resc_config(const resc_config &config)
+	{
+		std::lock_guard<std::mutex> lock(m_resc_mutex);
+		m_resc = config;
+	}
+
+	resc_config thread::get_resc_config()
+	{
+		std::lock_guard<std::mutex> lock(m_resc_mutex);
+		return m_resc;
+	}
+
+	areai thread::get_flip_output_area(u32 buffer_width, u32 buffer_height, sizei output_size)
+	{
+		const resc_config resc = get_resc_config();
+
+		// Size of the largest area of the given aspect ratio inside the box, or the smallest covering it
+		auto fit = [](double aspect, double box_width, double box_height, bool cover)
+		{
+			if ((box_width / box_height > aspect) != cover)
+			{
+				return std::make_pair(box_height * aspect, box_height);
+			}
+
+			return std::make_pair(box_width, box_width / aspect);
+		};
+
+		const double buffer_aspect = double(buffer_width) / buffer_height;
+		std::pair<double, double> size;
+
+		if (!resc.enabled)
+		{
+			size = fit(buffer_aspect, output_size.width, output_size.height, false);
+		}
+		else
+		{
+			// The output shows the libresc display mode, SD modes follow the configured aspect ratio
+			const double display_aspect = resc.dst_height <= 576 && rpcs3::state.config.rsx.aspect_ratio.value() == rsx_aspect_ratio::_4x3 ? 4. / 3. : 16. / 9.;
+			const auto display = fit(display_aspect, output_size.width, output_size.height, false);
+
+			switch (resc.ratio_mode)
+			{
+			case resc_ratio_mode::letterbox: size = fit(buffer_aspect, display.first, display.second, false); break;
+			case resc_ratio_mode::panscan: size = fit(buffer_aspect, display.first, display.second, true); break;
+			default: size = display; break;
+			}
+
+			size.first *= resc.ratio_adjust_x;
+			size.second *= resc.ratio_adjust_y;
+		}
+
+		const int width = int(size.first);
+		const int height = int(size.second);
+		const int x = (output_size.width - width) / 2;
+		const int y = (output_size.height - height) / 2;
+
+		return{ x, y, x + width, y + height };
+	}
+
+	void thread::fill_scale_offset_data(void *buffer, bool is_d3d) const
+	{
+		int clip_w = rsx::method_registers[NV4097_SET_SURFACE_CLIP_HORIZONTAL] >> 16;
+		int clip_h = rsx::method_registers[NV4097_SET_SURFACE_CLIP_VERTICAL] >> 16;
+
+		float scale_x = (float&)rsx::method_registers[NV4097_SET_VIEWPORT_SCALE] / (clip_w / 2.f);
+		float offset_x = (float&)rsx::method_registers[NV4097_SET_VIEWPORT_OFFSET] - (clip_w / 2.f);
+		offset_x /= clip_w / 2.f;
+
+		float scale_y = (float&)rsx::method_registers[NV4097_SET_VIEWPORT_SCALE + 1] / (clip_h / 2.f);
+		float offset_y = ((float&)rsx::method_registers[NV4097_SET_VIEWPORT_OFFSET + 1] - (clip_h / 2.f));
+		offset_y /= clip_h / 2.f;
+		if (is_d3d) scale_y *= -1;
+		if (is_d3d) offset_y *= -1;
+
+		float scale_z = (float&)rsx::method_registers[NV4097_SET_VIEWPORT_SCALE + 2];
+		float offset_z = (float&)rsx::method_registers[NV4097_SET_VIEWPORT_OFFSET + 2];
+		if (!is_d3d) offset_z -= .5;
+
+		float one = 1.f;
+
+		stream_vector(buffer, (u32&)scale_x, 0, 0, (u32&)offset_x);
+		stream_vector((char*)buffer + 16, 0, (u32&)scale_y, 0, (u32&)offset_y);
+		stream_vector((char*)buffer + 32, 0, 0, (u32&)scale_z, (u32&)offset_z);
+		stream_vector((char*)buffer + 48, 0, 0, 0, (u32&)one);
+	}
+
+	/**
+	* Fill buffer with vertex program constants.
+	* Buffer must be at least 512 float4 wide.
+	*/
+	void thread::fill_vertex_program_constants_data(void *buffer)
+	{
+		memcpy(buffer, transform_constants, sizeof(transform_constants));
+	}
+
+	std::pair<u32, u32> thread::consume_transform_constants_dirty_range()
+	{
+		const u32 first = transform_constants_dirty_begin;
+		const u32 end = transform_constants_dirty_end;
+
+		transform_constants_dirty_begin = limits::transform_constants_count;
+		transform_constants_dirty_end = 0;
+
+		if (first >= end)
+			return{ 0, 0 };
+
+		return{ first, end - first };
+	}
+
+	void thread::write_inline_array_to_buffer(void *dst_buffer)
+	{
+		u8* src = reinterpret_cast<u8*>(inline_vertex_array.data());
+		u8* dst = (u8*)dst_buffer;
+
+		bool needs_swap = false;
+
+		for (const auto &info : vertex_arrays_info)
+		{
+			needs_swap |= info.size == 4 && info.type == Vertex_base_type::ub;
+		}
+
+		// Already in host layout unless there are ub4 attributes
+		if (!needs_swap)
+		{
+			std::memcpy(dst, src, inline_vertex_array.size() * sizeof(u32));
+			return;
+		}
 
 		size_t bytes_written = 0;
 		while (bytes_written < inline_vertex_array.size() * sizeof(u32))
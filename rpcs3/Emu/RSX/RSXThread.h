@@ -4,6 +4,8 @@
 #include "RSXTexture.h"
 #include "RSXVertexProgram.h"
 #include "RSXFragmentProgram.h"
+#include "Common/present_thread.h"
+#include "rsx_capture.h"
 
 #include <stack>
 #include "Utilities/Semaphore.h"
@@ -12,32 +14,7 @@
 #include "Utilities/convert.h"
 
 extern u64 get_system_time();
-
-struct frame_capture_data
-{
-	struct buffer
-	{
-		std::vector<u8> data;
-		size_t width = 0, height = 0;
-	};
-
-	struct draw_state
-	{
-		std::string name;
-		std::pair<std::string, std::string> programs;
-		buffer color_buffer[4];
-		buffer depth;
-		buffer stencil;
-	};
-	std::vector<std::pair<u32, u32> > command_queue;
-	std::vector<draw_state> draw_calls;
-
-	void reset()
-	{
-		command_queue.clear();
-		draw_calls.clear();
-	}
-};
+extern void wait_until_system_time(u64 deadline);
 
 extern bool user_asked_for_frame_capture;
 extern frame_capture_data frame_debug;
@@ -97,7 +74,8 @@ namespace rsx
 			fragment_count = 32,
 			tiles_count = 15,
 			zculls_count = 8,
-			color_buffers_count = 4
+			color_buffers_count = 4,
+			transform_constants_count = 468
 		};
 	}
 
@@ -146,6 +124,19 @@ namespace rsx
 		void load(shader_language lang);
 
 		static std::string path_to_root();
+
+		/**
+		* Pipeline cache file of the running title for the given backend (created directory).
+		*/
+		static std::string path_to_pipeline_cache(const std::string &backend);
+
+		/**
+		* Compiled shader binary cache file of the running title for the given backend (created directory).
+		*/
+		static std::string path_to_shader_binary_cache(const std::string &backend);
+
+	private:
+		static std::string path_to_title_cache();
 	};
 
 	u32 get_vertex_type_size_on_host(Vertex_base_type type, u32 size);
@@ -159,8 +150,8 @@ namespace rsx
 		GcmTileInfo *tile;
 		u8 *ptr;
 
-		void write(const void *src, u32 width, u32 height, u32 pitch);
-		void read(void *dst, u32 width, u32 height, u32 pitch);
+		void write(const void *src, u32 width, u32 height, u32 pitch) const;
+		void read(void *dst, u32 width, u32 height, u32 pitch) const;
 	};
 
 	struct surface_info
@@ -206,6 +197,27 @@ namespace rsx
 		}
 	};
 
+	/**
+	* Resolution conversion configured through libresc, applied by the backend when the frame is presented
+	* (the source surface stays on the GPU, no converted copy goes through guest memory).
+	*/
+	enum class resc_ratio_mode : u32
+	{
+		fullscreen, // CELL_RESC_FULLSCREEN
+		letterbox, // CELL_RESC_LETTERBOX
+		panscan, // CELL_RESC_PANSCAN
+	};
+
+	struct resc_config
+	{
+		bool enabled = false;
+		u32 dst_width = 0;
+		u32 dst_height = 0;
+		resc_ratio_mode ratio_mode = resc_ratio_mode::fullscreen;
+		f32 ratio_adjust_x = 1.f;
+		f32 ratio_adjust_y = 1.f;
+	};
+
 	class thread : public named_thread_t
 	{
 	protected:
@@ -216,9 +228,10 @@ namespace rsx
 
 		CellGcmControl* ctrl = nullptr;
 
-		Timer timer_sync;
+		frame_limiter flip_limiter;
 
 		GcmTileInfo tiles[limits::tiles_count];
+		atomic_t<u32> tiles_version{ 0 }; // incremented when tiles are changed, invalidates decoded tiled regions
 		GcmZcullInfo zculls[limits::zculls_count];
 
 		rsx::texture textures[limits::textures_count];
@@ -246,20 +259,53 @@ namespace rsx
 		data_array_format_info vertex_arrays_info[limits::vertex_count];
 		u32 vertex_draw_count = 0;
 
-		std::unordered_map<u32, color4_base<f32>> transform_constants;
+		/**
+		* Vertex program constants, kept between draws like the hardware registers.
+		* [transform_constants_dirty_begin, transform_constants_dirty_end) covers the ones written
+		* since the backend last consumed the range (see consume_transform_constants_dirty_range).
+		*/
+		alignas(16) color4f transform_constants[limits::transform_constants_count];
+		u32 transform_constants_dirty_begin = 0;
+		u32 transform_constants_dirty_end = limits::transform_constants_count;
 
 		/**
 		* Stores the first and count argument from draw/draw indexed parameters between begin/end clauses.
 		*/
 		std::vector<std::pair<u32, u32> > first_count_commands;
 
-		// Constant stored for whole frame
-		std::unordered_map<u32, color4f> local_transform_constants;
+		/**
+		* Draw merging ("Merge Draw Calls" option): end() of a list primitive draw is deferred, and the next
+		* draws using the same primitive append their ranges to it as long as no command changes the draw state.
+		*/
+		bool merge_draws = false;
+		bool deferred_end = false;
 
 		u32 transform_program[512 * 4] = {};
 
+		/**
+		* Set by writes to transform program or shader program registers.
+		* When clear, the previous draw programs can be reused without looking at their ucode.
+		*/
+		bool programs_dirty = true;
+
 		bool capture_current_frame = false;
 		void capture_frame(const std::string &name);
+
+		/**
+		* Record the replay data of frame_debug and write it to capture_file (called by the flip starting the capture).
+		*/
+		void capture_state();
+
+		/**
+		* Capture file written while frames are captured (frame_debug only keeps the commands and draws of the last frame).
+		*/
+		capture_writer capture_file;
+
+		/**
+		* Capture replayed instead of executing the FIFO, and the number of replays (see Emulator::ReplayCapture).
+		*/
+		std::shared_ptr<frame_capture_data> replay_capture;
+		u32 replay_loops = 1;
 	public:
 		u32 ioAddress, ioSize;
 		int flip_status;
@@ -295,6 +341,20 @@ namespace rsx
 		u32 draw_array_first;
 		double fps_limit = 59.94;
 
+	private:
+		std::mutex m_resc_mutex;
+		resc_config m_resc;
+
+	public:
+		void set_resc_config(const resc_config &config);
+		resc_config get_resc_config();
+
+		/**
+		* Area of the flipped buffer in an output of the given size, fit keeping its aspect ratio or converted as configured by libresc.
+		* The area can exceed the output (pan and scan), the excess is clipped.
+		*/
+		areai get_flip_output_area(u32 buffer_width, u32 buffer_height, sizei output_size);
+
 	public:
 		semaphore_t sem_flip;
 		u64 last_flip_time;
@@ -303,9 +363,105 @@ namespace rsx
 		vm::ps3::ptr<void(u32)> vblank_handler = vm::null;
 		u64 vblank_count;
 
+	protected:
+		// Pre-decoded FIFO command
+		struct fifo_command_t
+		{
+			u32 get; // command address
+			u32 reg; // first method register
+			u32 count; // argument count
+			u32 args; // first argument position in m_fifo_buffer
+			bool non_increment;
+		};
+
+		// Command buffer snapshot (host endianness)
+		std::vector<u32> m_fifo_buffer;
+		std::vector<fifo_command_t> m_fifo_commands;
+
+		// Snapshot command buffer from get and decode method headers, returns false if nothing can be handled by fifo_execute()
+		bool fifo_decode(u32 get, u32 put);
+
+		// Execute commands decoded by fifo_decode()
+		void fifo_execute();
+
+		// Recorded method writes (same layout as frame_capture_data::command_queue) for asynchronous FIFO mode
+		using fifo_packet_t = std::vector<std::pair<u32, u32>>;
+
+		std::mutex m_packet_mutex;
+		std::condition_variable m_packet_cv; // notified on both push and pop
+		std::deque<fifo_packet_t> m_packet_queue;
+		std::vector<fifo_packet_t> m_packet_pool; // recycled packet storage
+
+		// Handle jump, call, return and nop commands, returns false for methods
+		bool fifo_flow_control(u32 get, u32 cmd);
+
+		// Parse FIFO and record packets (asynchronous FIFO mode, parser thread)
+		void fifo_parser_task();
+
+		// Submit recorded packet (blocks while the backend is too far behind)
+		void push_packet(fifo_packet_t& packet);
+
+		// Execute recorded packets (asynchronous FIFO mode, RSX thread)
+		void fifo_consumer_task();
+
+		// Current spin duration (in microseconds) before blocking on empty FIFO
+		u64 m_fifo_spin_time = 16;
+
+		// Wait (spin, then block) until the FIFO is not empty or timeout expires
+		void wait_fifo();
+
+		std::thread::id m_rsx_thread_id;
+
+		struct pending_report
+		{
+			u32 address; // 0 for queries discarded by a clear
+			u64 timestamp;
+			bool reset_counter; // counter cleared since the previous report
+			std::vector<u32> queries;
+		};
+
+		std::mutex m_reports_mutex;
+		std::condition_variable m_reports_cv;
+		std::deque<pending_report> m_pending_reports;
+		std::vector<u32> m_zpass_queries; // ended since the previous report
+		u32 m_zpass_query = 0; // open around draws
+		bool m_zpass_counter_reset = false;
+		u64 m_zpass_counter = 0;
+		bool m_reports_sync_requested = false;
+
+		// Write pending reports in order, stops at the first one whose results aren't available unless wait is set
+		void write_reports(bool wait);
+
+		/**
+		* Occlusion queries counting passed samples, 0 is never a valid query.
+		* The default implementation has no query support, reports are then 0.
+		*/
+		virtual u32 begin_occlusion_query() { return 0; }
+		virtual void end_occlusion_query(u32 query) {}
+		virtual bool check_occlusion_query(u32 query) { return true; }
+
+		// Blocks until the result is available, the query is released
+		virtual u32 get_occlusion_query_result(u32 query) { return 0; }
+
+		/**
+		* GPU timer queries measuring the duration of the commands between begin and end (capture replay statistics).
+		* The default implementation has no timer support, 0 is never a valid query.
+		*/
+		virtual u32 begin_gpu_timer() { return 0; }
+		virtual void end_gpu_timer(u32 query) {}
+
+		// Blocks until the result (in nanoseconds) is available, the query is released
+		virtual u64 get_gpu_timer_result(u32 query) { return 0; }
+
+		// Execute replay_capture replay_loops times and report the time spent per draw
+		void replay_task();
+
 	public:
 		std::set<u32> m_used_gcm_commands;
 
+		// Signal RSX thread that ctrl->put may have been updated
+		void fifo_wakeup();
+
 	protected:
 		virtual ~thread() {}
 
@@ -323,6 +479,11 @@ namespace rsx
 		virtual void flip(int buffer) = 0;
 		virtual u64 timestamp() const;
 
+		/**
+		* Backend work requested by other threads, called between commands on the RSX thread.
+		*/
+		virtual void do_local_task() {}
+
 		/**
 		 * Fill buffer with 4x4 scale offset matrix.
 		 * Vertex shader's position is to be multiplied by this matrix.
@@ -332,10 +493,66 @@ namespace rsx
 
 		/**
 		* Fill buffer with vertex program constants.
-		* Buffer must be at least 512 float4 wide.
+		* Buffer must be at least limits::transform_constants_count float4 wide.
 		*/
 		void fill_vertex_program_constants_data(void *buffer);
 
+		void set_transform_constants_dirty(u32 index)
+		{
+			transform_constants_dirty_begin = std::min(transform_constants_dirty_begin, index);
+			transform_constants_dirty_end = std::max(transform_constants_dirty_end, index + 1);
+		}
+
+		/**
+		* Returns first index and count of constants written since the previous call, and clears the range.
+		*/
+		std::pair<u32, u32> consume_transform_constants_dirty_range();
+
+		/**
+		* Whether end() of the current draw can be deferred to merge the following draws into it.
+		*/
+		bool can_defer_end() const;
+
+		/**
+		* Whether the deferred draw can stay open when value is written to reg (before the write).
+		*/
+		bool can_merge_command(u32 reg, u32 value) const;
+
+		/**
+		* End the deferred draw, if any.
+		*/
+		void end_deferred_draw();
+
+		void check_deferred_draw(u32 reg, u32 value)
+		{
+			if (deferred_end && !can_merge_command(reg, value))
+				end_deferred_draw();
+		}
+
+		/**
+		* ZPASS_PIXEL_CNT reports are backed by backend occlusion queries and written to guest memory
+		* once the results are available. Meanwhile the report page is protected, a guest access waits
+		* for the results (see on_report_access).
+		*/
+		void get_zpass_report(u32 address);
+		void clear_zpass_report();
+
+		/**
+		* Close the occlusion query open around draws, the next draw opens a new one.
+		* Backends call it when a query can't span the current point (e.g. command list submission).
+		*/
+		void end_zpass_query();
+
+		/**
+		* Write reports whose results are available, or all of them if another thread waits for one (RSX thread only).
+		*/
+		void update_reports();
+
+		/**
+		* Guest memory access handler for pending reports, can be called from any thread.
+		*/
+		bool on_report_access(u32 addr);
+
 		/**
 		* Write inlined array data to buffer.
 		* The storage of inlined data looks different from memory stored arrays.
@@ -0,0 +1,639 @@
+#include "stdafx.h"
+#include "rsx_methods.h"
+#include "rsx_capture.h"
+
+#include <wx/mstream.h>
+#include <wx/zstream.h>
+
+namespace
+{
+	// RSX capture file header, followed by the sections in the order of the fields (the sizes are counts of elements)
+	struct capture_file_header
+	{
+		u32 magic;
+		u32 frame_count;
+		u32 io_address, io_size;
+		u32 local_address, local_size;
+		u32 label_address;
+		u32 display_buffers_address, display_buffers_count;
+		u32 registers_size;
+		u32 transform_program_size;
+		u32 transform_constants_size;
+		u32 tiles_size;
+		u32 zculls_size;
+		u32 io_map_size;
+		u32 memory_size; // blocks (each block is its address, size, data size and data)
+		u32 command_queue_size;
+	};
+
+	const u32 capture_file_magic = 0x31435252; // "RRC1"
+
+	// Streamed capture file: the magic followed by records (the header of each is followed by its zlib-compressed body)
+	const u32 capture_stream_magic = 0x32435252; // "RRC2"
+
+	struct capture_record_header
+	{
+		u32 type;
+		u32 size;
+		u32 compressed_size;
+	};
+
+	enum capture_record_type : u32
+	{
+		capture_record_state = 1, // capture_file_header (without memory blocks and commands) and its sections
+		capture_record_data = 2, // content hash and data of a buffer, written before the first record using it
+		capture_record_memory = 3, // address, size and data hash of a memory block (0 if zero-filled)
+		capture_record_commands = 4, // method writes
+		capture_record_draw = 5, // name, programs, width and height of each surface, then their data hashes (0 if not recorded)
+		capture_record_frame = 6, // end of a captured frame
+	};
+
+	// Reads record bodies with the interface of fs::file
+	struct capture_record_reader
+	{
+		const u8* data;
+		u64 size;
+		u64 pos;
+
+		u64 read(void* buffer, u64 count)
+		{
+			count = std::min<u64>(count, size - pos);
+			std::memcpy(buffer, data + pos, count);
+			pos += count;
+			return count;
+		}
+
+		template<typename T>
+		bool read(T& value)
+		{
+			return read(&value, sizeof(T)) == sizeof(T);
+		}
+
+		template<typename T>
+		bool read(std::vector<T>& vec)
+		{
+			return read(vec.data(), sizeof(T) * vec.size()) == sizeof(T) * vec.size();
+		}
+
+		bool read(std::string& str)
+		{
+			u32 length;
+
+			if (!read(length) || length > size - pos)
+			{
+				return false;
+			}
+
+			str.resize(length);
+			return read(&str[0], length) == length;
+		}
+	};
+
+	template<typename T>
+	void append(std::vector<u8>& out, const T& value)
+	{
+		const auto ptr = reinterpret_cast<const u8*>(&value);
+		out.insert(out.end(), ptr, ptr + sizeof(T));
+	}
+
+	template<typename T>
+	void append(std::vector<u8>& out, const std::vector<T>& vec)
+	{
+		const auto ptr = reinterpret_cast<const u8*>(vec.data());
+		out.insert(out.end(), ptr, ptr + vec.size() * sizeof(T));
+	}
+
+	void append(std::vector<u8>& out, const std::string& str)
+	{
+		append(out, gsl::narrow<u32>(str.size()));
+		out.insert(out.end(), str.begin(), str.end());
+	}
+
+	// Content hash of a buffer (never 0, which is used for missing data)
+	u64 hash_buffer(const std::vector<u8>& data)
+	{
+		u64 hash = 0xcbf29ce484222325ull ^ data.size();
+		std::size_t i = 0;
+
+		for (; i + sizeof(u64) <= data.size(); i += sizeof(u64))
+		{
+			u64 value;
+			std::memcpy(&value, data.data() + i, sizeof(u64));
+			hash = (hash ^ value) * 0x100000001b3ull;
+			hash ^= hash >> 32;
+		}
+
+		for (; i < data.size(); i++)
+		{
+			hash = (hash ^ data[i]) * 0x100000001b3ull;
+		}
+
+		return hash ? hash : 1;
+	}
+
+	std::vector<u8> compress(const std::vector<u8>& data)
+	{
+		wxMemoryOutputStream out;
+
+		{
+			// Fastest level: the writer must keep up with the captured frames
+			wxZlibOutputStream z_stream(out, 1);
+			z_stream.Write(data.data(), data.size());
+			z_stream.Close();
+		}
+
+		std::vector<u8> result(out.GetSize());
+		out.CopyTo(result.data(), result.size());
+		return result;
+	}
+
+	bool decompress(const std::vector<u8>& data, std::vector<u8>& result, u32 size)
+	{
+		result.resize(size);
+
+		if (!size)
+		{
+			return true;
+		}
+
+		wxMemoryInputStream in(data.data(), data.size());
+		wxZlibInputStream z_stream(in);
+		z_stream.Read(result.data(), size);
+		return z_stream.LastRead() == size;
+	}
+
+	capture_file_header make_header(const frame_capture_data& capture, u32 magic)
+	{
+		capture_file_header header;
+		header.magic = magic;
+		header.frame_count = capture.frame_count;
+		header.io_address = capture.io_address;
+		header.io_size = capture.io_size;
+		header.local_address = capture.local_address;
+		header.local_size = capture.local_size;
+		header.label_address = capture.label_address;
+		header.display_buffers_address = capture.display_buffers_address;
+		header.display_buffers_count = capture.display_buffers_count;
+		header.registers_size = gsl::narrow<u32>(capture.registers.size());
+		header.transform_program_size = gsl::narrow<u32>(capture.transform_program.size());
+		header.transform_constants_size = gsl::narrow<u32>(capture.transform_constants.size());
+		header.tiles_size = gsl::narrow<u32>(capture.tiles.size());
+		header.zculls_size = gsl::narrow<u32>(capture.zculls.size());
+		header.io_map_size = gsl::narrow<u32>(capture.io_map.size());
+		header.memory_size = 0;
+		header.command_queue_size = 0;
+		return header;
+	}
+
+	// Read the header fields and the sections following the header (up to the memory blocks)
+	template<typename Source>
+	bool read_state(Source& source, const capture_file_header& header, frame_capture_data& capture, u64 source_size)
+	{
+		capture.frame_count = header.frame_count;
+		capture.io_address = header.io_address;
+		capture.io_size = header.io_size;
+		capture.local_address = header.local_address;
+		capture.local_size = header.local_size;
+		capture.label_address = header.label_address;
+		capture.display_buffers_address = header.display_buffers_address;
+		capture.display_buffers_count = header.display_buffers_count;
+
+		// Sizes are validated against the source size before allocating
+		for (u64 size : std::initializer_list<u64>{ header.registers_size * 4ull, header.transform_program_size * 4ull, header.transform_constants_size * 1ull, header.tiles_size * 1ull, header.zculls_size * 1ull, header.io_map_size * sizeof(frame_capture_data::io_mapping), header.command_queue_size * 8ull })
+		{
+			if (size > source_size)
+			{
+				return false;
+			}
+		}
+
+		capture.registers.resize(header.registers_size);
+		capture.transform_program.resize(header.transform_program_size);
+		capture.transform_constants.resize(header.transform_constants_size);
+		capture.tiles.resize(header.tiles_size);
+		capture.zculls.resize(header.zculls_size);
+		capture.io_map.resize(header.io_map_size);
+
+		return source.read(capture.registers) && source.read(capture.transform_program) && source.read(capture.transform_constants) &&
+			source.read(capture.tiles) && source.read(capture.zculls) && source.read(capture.io_map);
+	}
+
+	// Read the records of a streamed capture file (a truncated last record is ignored)
+	bool read_records(const fs::file& file, frame_capture_data& capture)
+	{
+		const u64 file_size = file.size();
+
+		std::unordered_map<u64, std::vector<u8>> buffers;
+		std::vector<u8> packed, body;
+		capture_record_header header;
+
+		const auto get_buffer = [&](u64 hash, std::vector<u8>& data)
+		{
+			if (!hash)
+			{
+				data.clear();
+				return true;
+			}
+
+			const auto found = buffers.find(hash);
+
+			if (found == buffers.end())
+			{
+				return false;
+			}
+
+			data = found->second;
+			return true;
+		};
+
+		while (file.read(header))
+		{
+			if (header.compressed_size > file_size || header.size > 0x40000000)
+			{
+				return false;
+			}
+
+			packed.resize(header.compressed_size);
+
+			if (!file.read(packed))
+			{
+				break;
+			}
+
+			if (!decompress(packed, body, header.size))
+			{
+				return false;
+			}
+
+			capture_record_reader reader{ body.data(), body.size(), 0 };
+
+			switch (header.type)
+			{
+			case capture_record_state:
+			{
+				capture_file_header state;
+
+				if (!reader.read(state) || !read_state(reader, state, capture, body.size()))
+				{
+					return false;
+				}
+
+				break;
+			}
+
+			case capture_record_data:
+			{
+				u64 hash;
+
+				if (!reader.read(hash))
+				{
+					return false;
+				}
+
+				buffers[hash].assign(body.begin() + sizeof(u64), body.end());
+				break;
+			}
+
+			case capture_record_memory:
+			{
+				frame_capture_data::memory_block block;
+				u64 hash;
+
+				if (!reader.read(block.addr) || !reader.read(block.size) || !reader.read(hash) || !get_buffer(hash, block.data) || (block.data.size() && block.data.size() != block.size))
+				{
+					return false;
+				}
+
+				capture.memory.emplace_back(std::move(block));
+				break;
+			}
+
+			case capture_record_commands:
+			{
+				const std::size_t count = body.size() / sizeof(capture.command_queue[0]);
+				const std::size_t pos = capture.command_queue.size();
+
+				capture.command_queue.resize(pos + count);
+				std::memcpy(capture.command_queue.data() + pos, body.data(), count * sizeof(capture.command_queue[0]));
+				break;
+			}
+
+			case capture_record_draw:
+			{
+				frame_capture_data::draw_state draw;
+				frame_capture_data::buffer* surfaces[] = { &draw.color_buffer[0], &draw.color_buffer[1], &draw.color_buffer[2], &draw.color_buffer[3], &draw.depth, &draw.stencil };
+
+				if (!reader.read(draw.name) || !reader.read(draw.programs.first) || !reader.read(draw.programs.second))
+				{
+					return false;
+				}
+
+				for (auto surface : surfaces)
+				{
+					u32 width, height;
+
+					if (!reader.read(width) || !reader.read(height))
+					{
+						return false;
+					}
+
+					surface->width = width;
+					surface->height = height;
+				}
+
+				for (auto surface : surfaces)
+				{
+					u64 hash;
+
+					if (!reader.read(hash) || !get_buffer(hash, surface->data))
+					{
+						return false;
+					}
+				}
+
+				capture.draw_calls.emplace_back(std::move(draw));
+				break;
+			}
+
+			case capture_record_frame:
+			{
+				capture.frame_count++;
+				break;
+			}
+
+			default:
+			{
+				// Skip records of newer versions
+				break;
+			}
+			}
+		}
+
+		return true;
+	}
+}
+
+bool frame_capture_data::load(const std::string& path)
+{
+	reset();
+
+	fs::file file(path);
+
+	capture_file_header header;
+
+	if (!file || !file.read(header.magic))
+	{
+		return false;
+	}
+
+	if (header.magic == capture_stream_magic)
+	{
+		return read_records(file, *this) && registers.size() == sizeof(rsx::method_registers) / sizeof(u32);
+	}
+
+	if (header.magic != capture_file_magic || file.read(reinterpret_cast<u8*>(&header) + sizeof(u32), sizeof(header) - sizeof(u32)) != sizeof(header) - sizeof(u32))
+	{
+		return false;
+	}
+
+	const u64 file_size = file.size();
+
+	if (!read_state(file, header, *this, file_size))
+	{
+		return false;
+	}
+
+	for (u32 i = 0; i < header.memory_size; i++)
+	{
+		memory_block block;
+		u32 data_size;
+
+		if (!file.read(block.addr) || !file.read(block.size) || !file.read(data_size) || (data_size && data_size != block.size) || data_size > file_size)
+		{
+			return false;
+		}
+
+		block.data.resize(data_size);
+
+		if (!file.read(block.data))
+		{
+			return false;
+		}
+
+		memory.emplace_back(std::move(block));
+	}
+
+	command_queue.resize(header.command_queue_size);
+
+	const u64 queue_size = command_queue.size() * sizeof(command_queue[0]);
+
+	return file.read(command_queue.data(), queue_size) == queue_size && registers.size() == sizeof(rsx::method_registers) / sizeof(u32);
+}
+
+namespace rsx
+{
+	bool capture_writer::open(const std::string& path, u64 max_queued)
+	{
+		finish();
+
+		if (!m_file.open(path, fom::rewrite))
+		{
+			return false;
+		}
+
+		m_file.write(capture_stream_magic);
+
+		m_path = path;
+		m_max_queued = max_queued;
+		m_hashes.clear();
+		m_failed = false;
+		buffers_written = 0;
+		buffers_deduplicated = 0;
+		bytes_written = sizeof(capture_stream_magic);
+
+		m_thread = thread_ctrl::spawn(PURE_EXPR("RSX Capture Writer"s), [this]()
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+
+			while (!m_queue.empty() || !m_exit)
+			{
+				if (m_queue.empty())
+				{
+					m_cv.wait(lock);
+					continue;
+				}
+
+				record_t record = std::move(m_queue.front());
+				m_queue.pop_front();
+
+				lock.unlock();
+				write(record);
+				lock.lock();
+
+				m_queued -= record.size;
+				m_done_cv.notify_all();
+			}
+		});
+
+		return true;
+	}
+
+	bool capture_writer::finish()
+	{
+		if (!m_thread)
+		{
+			return !m_failed;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_exit = true;
+		}
+
+		// Records left in the queue are written before the thread exits
+		m_cv.notify_all();
+		m_thread->join();
+		m_thread.reset();
+		m_exit = false;
+
+		m_file.close();
+		m_hashes.clear();
+
+		return !m_failed;
+	}
+
+	void capture_writer::push(u32 type, std::vector<u8>&& body, std::vector<std::vector<u8>>&& buffers)
+	{
+		record_t record{ type, std::move(body), std::move(buffers), 0 };
+
+		record.size = record.body.size();
+
+		for (const auto& buffer : record.buffers)
+		{
+			record.size += buffer.size();
+		}
+
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+
+			// Wait for the writer if too much data is queued (a record bigger than the limit is queued alone)
+			while (m_queued && m_queued + record.size > m_max_queued)
+			{
+				m_done_cv.wait(lock);
+			}
+
+			m_queued += record.size;
+			m_queue.emplace_back(std::move(record));
+		}
+
+		m_cv.notify_one();
+	}
+
+	void capture_writer::write_record(u32 type, const std::vector<u8>& body)
+	{
+		const std::vector<u8> data = compress(body);
+
+		const capture_record_header header{ type, gsl::narrow<u32>(body.size()), gsl::narrow<u32>(data.size()) };
+
+		if (m_file.write(&header, sizeof(header)) != sizeof(header) || m_file.write(data.data(), data.size()) != data.size())
+		{
+			m_failed = true;
+		}
+
+		bytes_written += sizeof(header) + data.size();
+	}
+
+	void capture_writer::write(record_t& record)
+	{
+		for (auto& buffer : record.buffers)
+		{
+			u64 hash = 0;
+
+			if (!buffer.empty())
+			{
+				hash = hash_buffer(buffer);
+
+				if (m_hashes.insert(hash).second)
+				{
+					buffer.insert(buffer.begin(), reinterpret_cast<const u8*>(&hash), reinterpret_cast<const u8*>(&hash) + sizeof(hash));
+					write_record(capture_record_data, buffer);
+					buffers_written++;
+				}
+				else
+				{
+					buffers_deduplicated++;
+				}
+			}
+
+			append(record.body, hash);
+		}
+
+		write_record(record.type, record.body);
+	}
+
+	void capture_writer::write_state(frame_capture_data& state)
+	{
+		std::vector<u8> body;
+		append(body, make_header(state, capture_stream_magic));
+		append(body, state.registers);
+		append(body, state.transform_program);
+		append(body, state.transform_constants);
+		append(body, state.tiles);
+		append(body, state.zculls);
+		append(body, state.io_map);
+
+		push(capture_record_state, std::move(body));
+
+		for (auto& block : state.memory)
+		{
+			std::vector<u8> block_body;
+			append(block_body, block.addr);
+			append(block_body, block.size);
+
+			std::vector<std::vector<u8>> buffers;
+			buffers.emplace_back(std::move(block.data));
+
+			push(capture_record_memory, std::move(block_body), std::move(buffers));
+		}
+
+		state.memory.clear();
+	}
+
+	void capture_writer::write_commands(const std::vector<std::pair<u32, u32>>& commands)
+	{
+		// Split to keep records small
+		for (std::size_t pos = 0; pos < commands.size(); pos += 0x10000)
+		{
+			const auto begin = reinterpret_cast<const u8*>(commands.data() + pos);
+			const auto end = reinterpret_cast<const u8*>(commands.data() + std::min<std::size_t>(pos + 0x10000, commands.size()));
+
+			push(capture_record_commands, std::vector<u8>(begin, end));
+		}
+	}
+
+	void capture_writer::write_draw(frame_capture_data::draw_state draw)
+	{
+		frame_capture_data::buffer* surfaces[] = { &draw.color_buffer[0], &draw.color_buffer[1], &draw.color_buffer[2], &draw.color_buffer[3], &draw.depth, &draw.stencil };
+
+		std::vector<u8> body;
+		append(body, draw.name);
+		append(body, draw.programs.first);
+		append(body, draw.programs.second);
+
+		std::vector<std::vector<u8>> buffers;
+
+		for (auto surface : surfaces)
+		{
+			append(body, gsl::narrow<u32>(surface->width));
+			append(body, gsl::narrow<u32>(surface->height));
+			buffers.emplace_back(std::move(surface->data));
+		}
+
+		push(capture_record_draw, std::move(body), std::move(buffers));
+	}
+
+	void capture_writer::write_frame_end()
+	{
+		push(capture_record_frame, {});
+	}
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+#include "Utilities/Thread.h"
+
+#include <deque>
+#include <unordered_set>
+
+struct frame_capture_data
+{
+	struct buffer
+	{
+		std::vector<u8> data;
+		size_t width = 0, height = 0;
+	};
+
+	struct draw_state
+	{
+		std::string name;
+		std::pair<std::string, std::string> programs;
+		buffer color_buffer[4];
+		buffer depth;
+		buffer stencil;
+	};
+	std::vector<std::pair<u32, u32> > command_queue;
+	std::vector<draw_state> draw_calls;
+
+	/**
+	* Replay data, recorded when the capture starts (see rsx::thread::replay_task).
+	* Memory is a snapshot of local memory, IO mapped memory, labels and display buffers at that point:
+	* data written by the guest during the captured frames isn't recorded.
+	*/
+	struct memory_block
+	{
+		u32 addr;
+		u32 size;
+		std::vector<u8> data; // empty if the block is zero-filled
+	};
+
+	struct io_mapping
+	{
+		u32 io; // RSX IO offset
+		u32 ea;
+		u32 size;
+	};
+
+	u32 frame_count = 0; // flips recorded
+	std::vector<u32> registers; // method registers
+	std::vector<u32> transform_program;
+	std::vector<u8> transform_constants;
+	std::vector<u8> tiles; // GcmTileInfo array
+	std::vector<u8> zculls; // GcmZcullInfo array
+	u32 io_address = 0, io_size = 0;
+	u32 local_address = 0, local_size = 0;
+	u32 label_address = 0;
+	u32 display_buffers_address = 0, display_buffers_count = 0;
+	std::vector<io_mapping> io_map;
+	std::vector<memory_block> memory;
+
+	void reset()
+	{
+		command_queue.clear();
+		draw_calls.clear();
+		frame_count = 0;
+		registers.clear();
+		transform_program.clear();
+		transform_constants.clear();
+		tiles.clear();
+		zculls.clear();
+		io_map.clear();
+		memory.clear();
+	}
+
+	// Replay data is available (the capture was started on a flip)
+	bool is_replayable() const
+	{
+		return !registers.empty();
+	}
+
+	// Load RSX capture file (written by rsx::capture_writer, or the unstreamed format of older versions)
+	bool load(const std::string& path);
+};
+
+namespace rsx
+{
+	/**
+	* Writes an RSX capture file on a background thread while frames are captured.
+	* Records are compressed, and buffers (memory blocks and surfaces) are stored once per content hash,
+	* so any number of frames can be captured with at most max_queued bytes waiting for the writer.
+	*/
+	class capture_writer
+	{
+		struct record_t
+		{
+			u32 type;
+			std::vector<u8> body;
+			std::vector<std::vector<u8>> buffers; // written once per content, their hashes are appended to the body
+			u64 size; // bytes queued
+		};
+
+		std::shared_ptr<thread_ctrl> m_thread;
+		std::string m_path;
+		fs::file m_file;
+
+		std::mutex m_mutex;
+		std::condition_variable m_cv;
+		std::condition_variable m_done_cv;
+		std::deque<record_t> m_queue;
+		u64 m_queued = 0;
+		u64 m_max_queued = 0;
+		bool m_exit = false;
+
+		// Written by the writer thread
+		std::unordered_set<u64> m_hashes;
+		bool m_failed = false;
+
+		void push(u32 type, std::vector<u8>&& body, std::vector<std::vector<u8>>&& buffers = {});
+		void write_record(u32 type, const std::vector<u8>& body);
+		void write(record_t& record);
+
+	public:
+		// Statistics (valid after finish())
+		u64 buffers_written = 0;
+		u64 buffers_deduplicated = 0;
+		u64 bytes_written = 0;
+
+		capture_writer() = default;
+		capture_writer(const capture_writer&) = delete;
+
+		~capture_writer()
+		{
+			finish();
+		}
+
+		/**
+		* Create the capture file and start the writer thread.
+		*/
+		bool open(const std::string& path, u64 max_queued = 64 * 1024 * 1024);
+
+		/**
+		* Wait until every record is written and close the file. Returns false if a write failed.
+		*/
+		bool finish();
+
+		explicit operator bool() const
+		{
+			return m_thread.operator bool();
+		}
+
+		const std::string& path() const
+		{
+			return m_path;
+		}
+
+		/**
+		* Write the replay data recorded when the capture starts (memory blocks are moved to the writer).
+		*/
+		void write_state(frame_capture_data& state);
+
+		/**
+		* Write method writes of the captured frame.
+		*/
+		void write_commands(const std::vector<std::pair<u32, u32>>& commands);
+
+		/**
+		* Write a captured draw (surfaces are moved to the writer).
+		*/
+		void write_draw(frame_capture_data::draw_state draw);
+
+		/**
+		* Mark the end of a captured frame.
+		*/
+		void write_frame_end();
+	};
+}
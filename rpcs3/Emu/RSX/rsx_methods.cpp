@@ -4,6 +4,10 @@
 #include "Emu/Memory/Memory.h"
 #include "Emu/System.h"
 #include "Emu/state.h"
+#include "Emu/PerfCounters.h"
+#include "Emu/Benchmark.h"
+#include "Emu/TitleProfile.h"
+#include "Utilities/Trace.h"
 #include "rsx_utils.h"
 #include "Emu/SysCalls/Callback.h"
 #include "Emu/SysCalls/CB_FUNC.h"
@@ -34,6 +38,9 @@ namespace rsx
 				if (Emu.IsStopped())
 					break;
 
+				// The guest may wait on a report before releasing the semaphore
+				rsx->update_reports();
+
 				std::this_thread::sleep_for(std::chrono::milliseconds(1));
 			}
 		}
@@ -158,9 +165,23 @@ namespace rsx
 			}
 		};
 
+		/**
+		* Ranges of a merged draw must share the draw command, end the draw otherwise.
+		*/
+		force_inline void set_draw_command(thread* rsx, thread::Draw_command command)
+		{
+			if (rsx->draw_command != command && !rsx->first_count_commands.empty())
+			{
+				rsx->end();
+				rsx->begin();
+			}
+
+			rsx->draw_command = command;
+		}
+
 		force_inline void draw_arrays(thread* rsx, u32 arg)
 		{
-			rsx->draw_command = thread::Draw_command::draw_command_array;
+			set_draw_command(rsx, thread::Draw_command::draw_command_array);
 			u32 first = arg & 0xffffff;
 			u32 count = (arg >> 24) + 1;
 
@@ -169,7 +190,7 @@ namespace rsx
 
 		force_inline void draw_index_array(thread* rsx, u32 arg)
 		{
-			rsx->draw_command = thread::Draw_command::draw_command_indexed;
+			set_draw_command(rsx, thread::Draw_command::draw_command_indexed);
 			u32 first = arg & 0xffffff;
 			u32 count = (arg >> 24) + 1;
 
@@ -178,7 +199,7 @@ namespace rsx
 
 		force_inline void draw_inline_array(thread* rsx, u32 arg)
 		{
-			rsx->draw_command = thread::Draw_command::draw_command_inlined_array;
+			set_draw_command(rsx, thread::Draw_command::draw_command_inlined_array);
 			rsx->draw_inline_vertex_array = true;
 			rsx->inline_vertex_array.push_back(arg);
 		}
@@ -193,10 +214,17 @@ namespace rsx
 				static const size_t count = 4;
 				static const size_t size = count * sizeof(f32);
 
-				size_t reg = index / 4;
-				size_t subreg = index % 4;
+				u32 reg = index / 4;
+				u32 subreg = index % 4;
+
+				if (load + reg >= limits::transform_constants_count)
+				{
+					LOG_ERROR(RSX, "Transform constant %d out of range", load + reg);
+					return;
+				}
 
 				memcpy(rsxthr->transform_constants[load + reg].rgba + subreg, method_registers + NV4097_SET_TRANSFORM_CONSTANT + reg * count + subreg, sizeof(f32));
+				rsxthr->set_transform_constants_dirty(load + reg);
 			}
 		};
 
@@ -211,19 +239,39 @@ namespace rsx
 				static const size_t size = count * sizeof(u32);
 
 				memcpy(rsx->transform_program + load++ * count, method_registers + NV4097_SET_TRANSFORM_PROGRAM + index * count, size);
+				rsx->programs_dirty = true;
 			}
 		};
 
+		force_inline void set_programs_dirty(thread* rsx, u32 arg)
+		{
+			// libgcm rebinds the fragment program after patching its ucode in memory
+			rsx->programs_dirty = true;
+		}
+
 		force_inline void set_begin_end(thread* rsx, u32 arg)
 		{
 			if (arg)
 			{
+				// Same primitive and no state change since the deferred end, append the draw to it
+				if (rsx->deferred_end)
+				{
+					rsx->deferred_end = false;
+					return;
+				}
+
 				rsx->draw_inline_vertex_array = false;
 				rsx->inline_vertex_array.clear();
 				rsx->begin();
 				return;
 			}
 
+			if (rsx->can_defer_end())
+			{
+				rsx->deferred_end = true;
+				return;
+			}
+
 			rsx->end();
 		}
 
@@ -243,13 +291,18 @@ namespace rsx
 				return;
 			}
 
+			if (type == CELL_GCM_ZPASS_PIXEL_CNT)
+			{
+				rsx->get_zpass_report(get_address(offset, location));
+				return;
+			}
+
 			vm::ps3::ptr<CellGcmReportData> result = { get_address(offset, location), vm::addr };
 
 			result->timer = rsx->timestamp();
 
 			switch (type)
 			{
-			case CELL_GCM_ZPASS_PIXEL_CNT:
 			case CELL_GCM_ZCULL_STATS:
 			case CELL_GCM_ZCULL_STATS1:
 			case CELL_GCM_ZCULL_STATS2:
@@ -272,7 +325,7 @@ namespace rsx
 			switch (arg)
 			{
 			case CELL_GCM_ZPASS_PIXEL_CNT:
-				LOG_WARNING(RSX, "TODO: NV4097_CLEAR_REPORT_VALUE: ZPASS_PIXEL_CNT");
+				rsx->clear_zpass_report();
 				break;
 			case CELL_GCM_ZCULL_STATS:
 				LOG_WARNING(RSX, "TODO: NV4097_CLEAR_REPORT_VALUE: ZCULL_STATS");
@@ -620,16 +673,61 @@ namespace rsx
 
 	void flip_command(thread* rsx, u32 arg)
 	{
+		_log::timeline_scope scope("rsx", "flip", arg);
+
+		perf::add(perf::flips);
+		perf::update();
+		bench::on_flip();
+		title_profile::on_flip();
+
+		bool capture_started = false;
+
 		if (user_asked_for_frame_capture)
 		{
-			rsx->capture_current_frame = true;
 			user_asked_for_frame_capture = false;
 			frame_debug.reset();
+
+			const std::string path = fs::get_config_dir() + "RPCS3.rrc";
+
+			if (rsx->capture_file.open(path))
+			{
+				rsx->capture_current_frame = true;
+				capture_started = true;
+			}
+			else
+			{
+				LOG_ERROR(RSX, "Failed to create frame capture file %s", path);
+			}
 		}
 		else if (rsx->capture_current_frame)
 		{
-			rsx->capture_current_frame = false;
-			Emu.Pause();
+			// Captured frames are streamed to the file, only the last one is kept in memory for the debugger
+			const bool last_frame = ++frame_debug.frame_count >= std::max<u32>(rpcs3::state.config.rsx.capture_frames.value(), 1);
+
+			rsx->capture_file.write_commands(frame_debug.command_queue);
+			rsx->capture_file.write_frame_end();
+
+			if (!last_frame)
+			{
+				frame_debug.command_queue.clear();
+				frame_debug.draw_calls.clear();
+			}
+			else
+			{
+				rsx->capture_current_frame = false;
+
+				if (rsx->capture_file.finish())
+				{
+					LOG_SUCCESS(RSX, "Captured %u frame(s) saved to %s (%llu bytes, %llu buffers, %llu deduplicated; replay with --replay)", frame_debug.frame_count, rsx->capture_file.path(),
+						rsx->capture_file.bytes_written, rsx->capture_file.buffers_written, rsx->capture_file.buffers_deduplicated);
+				}
+				else
+				{
+					LOG_ERROR(RSX, "Failed to save frame capture to %s", rsx->capture_file.path());
+				}
+
+				Emu.Pause();
+			}
 		}
 
 		rsx->gcm_current_buffer = arg;
@@ -638,6 +736,12 @@ namespace rsx
 		// Some game use this default state (SH3).
 		rsx->reset();
 
+		if (capture_started)
+		{
+			// Replay starts from the state of the first captured frame
+			rsx->capture_state();
+		}
+
 		rsx->last_flip_time = get_system_time() - 1000000;
 		rsx->gcm_current_buffer = arg;
 		rsx->flip_status = 0;
@@ -667,9 +771,7 @@ namespace rsx
 			return;
 		}
 
-		std::this_thread::sleep_for(std::chrono::milliseconds((s64)(1000.0 / limit - rsx->timer_sync.GetElapsedTimeInMilliSec())));
-		rsx->timer_sync.Start();
-		rsx->local_transform_constants.clear();
+		rsx->flip_limiter.wait(limit);
 	}
 
 	void user_command(thread* rsx, u32 arg)
@@ -804,6 +906,9 @@ namespace rsx
 			bind_range<NV4097_SET_VERTEX_DATA4S_M + 1, 2, 16, nv4097::set_vertex_data4s_m>();
 			bind_range<NV4097_SET_TRANSFORM_CONSTANT, 1, 32, nv4097::set_transform_constant>();
 			bind_range<NV4097_SET_TRANSFORM_PROGRAM + 3, 4, 128, nv4097::set_transform_program>();
+			bind<NV4097_SET_TRANSFORM_PROGRAM_START, nv4097::set_programs_dirty>();
+			bind<NV4097_SET_SHADER_PROGRAM, nv4097::set_programs_dirty>();
+			bind<NV4097_SET_SHADER_CONTROL, nv4097::set_programs_dirty>();
 			bind_cpu_only<NV4097_GET_REPORT, nv4097::get_report>();
 			bind_cpu_only<NV4097_CLEAR_REPORT_VALUE, nv4097::clear_report_value>();
 
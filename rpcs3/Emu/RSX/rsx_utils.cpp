@@ -6,8 +6,141 @@ extern "C"
 #include "libswscale/swscale.h"
 }
 
+namespace
+{
+	/**
+	* Position of value bits in a swizzled texture offset.
+	* Bits are interleaved with the other dimension ones up to the smaller dimension, remaining bits are stacked on top.
+	*/
+	u32 spread_swizzle_bits(u32 value, u16 log2size, u16 log2min, u32 first_bit)
+	{
+		u32 result = 0;
+		for (u16 bit = 0; bit < log2size; bit++)
+		{
+			const u32 position = bit < log2min ? bit * 2 + first_bit : bit + log2min;
+			result |= ((value >> bit) & 1) << position;
+		}
+		return result;
+	}
+
+	u16 get_log2(u16 power_of_2)
+	{
+		u16 result = 0;
+		while ((1u << result) < power_of_2)
+			result++;
+		return result;
+	}
+
+	/**
+	* A 4x4 swizzled tile is made of four 2x2 blocks, each stored as (0, 0) (1, 0) (0, 1) (1, 1).
+	* With 32 bit texels a block row is 8 bytes, so a linear row is the low or high half of two adjacent blocks.
+	*/
+	template<bool input_is_swizzled>
+	void convert_tile_u32(u8 *linear, u32 linear_pitch, u8 *swizzled)
+	{
+		for (int i = 0; i < 2; i++)
+		{
+			__m128i *linear_row0 = (__m128i*)(linear + (i * 2) * linear_pitch);
+			__m128i *linear_row1 = (__m128i*)(linear + (i * 2 + 1) * linear_pitch);
+			__m128i *blocks = (__m128i*)(swizzled + i * 32);
+
+			const __m128i value0 = _mm_loadu_si128(input_is_swizzled ? blocks : linear_row0);
+			const __m128i value1 = _mm_loadu_si128(input_is_swizzled ? blocks + 1 : linear_row1);
+			_mm_storeu_si128(input_is_swizzled ? linear_row0 : blocks, _mm_unpacklo_epi64(value0, value1));
+			_mm_storeu_si128(input_is_swizzled ? linear_row1 : blocks + 1, _mm_unpackhi_epi64(value0, value1));
+		}
+	}
+
+	/**
+	* With 16 bit texels a block row is 4 bytes, two blocks fit in a register and swapping the middle dwords
+	* moves between (row 0, row 1) and (block 0, block 1) halves.
+	*/
+	template<bool input_is_swizzled>
+	void convert_tile_u16(u8 *linear, u32 linear_pitch, u8 *swizzled)
+	{
+		for (int i = 0; i < 2; i++)
+		{
+			u8 *linear_row0 = linear + (i * 2) * linear_pitch;
+			u8 *linear_row1 = linear + (i * 2 + 1) * linear_pitch;
+			__m128i *blocks = (__m128i*)(swizzled + i * 16);
+
+			if (input_is_swizzled)
+			{
+				const __m128i value = _mm_shuffle_epi32(_mm_loadu_si128(blocks), _MM_SHUFFLE(3, 1, 2, 0));
+				_mm_storel_epi64((__m128i*)linear_row0, value);
+				_mm_storel_epi64((__m128i*)linear_row1, _mm_unpackhi_epi64(value, value));
+			}
+			else
+			{
+				const __m128i value = _mm_unpacklo_epi64(_mm_loadl_epi64((__m128i*)linear_row0), _mm_loadl_epi64((__m128i*)linear_row1));
+				_mm_storeu_si128(blocks, _mm_shuffle_epi32(value, _MM_SHUFFLE(3, 1, 2, 0)));
+			}
+		}
+	}
+
+	template<u32 texel_size, bool input_is_swizzled>
+	void convert_tiles(u8 *linear, u8 *swizzled, u16 width, u16 height)
+	{
+		const u16 log2width = get_log2(width);
+		const u16 log2height = get_log2(height);
+		const u16 log2min = std::min(log2width, log2height);
+		const u32 linear_pitch = width * texel_size;
+
+		// x and y bits don't overlap in the offset, the tile offset is x_offset | y_offset
+		std::vector<u32> x_offsets(width / 4);
+		for (u32 tile_x = 0; tile_x < width / 4u; tile_x++)
+			x_offsets[tile_x] = spread_swizzle_bits(tile_x * 4, log2width, log2min, 0);
+
+		for (u32 y = 0; y < height; y += 4)
+		{
+			const u32 y_offset = spread_swizzle_bits(y, log2height, log2min, 1);
+			u8 *linear_row = linear + y * linear_pitch;
+
+			for (u32 tile_x = 0; tile_x < width / 4u; tile_x++)
+			{
+				u8 *linear_tile = linear_row + tile_x * 4 * texel_size;
+				u8 *swizzled_tile = swizzled + (x_offsets[tile_x] | y_offset) * texel_size;
+
+				if (texel_size == 4)
+					convert_tile_u32<input_is_swizzled>(linear_tile, linear_pitch, swizzled_tile);
+				else
+					convert_tile_u16<input_is_swizzled>(linear_tile, linear_pitch, swizzled_tile);
+			}
+		}
+	}
+}
+
 namespace rsx
 {
+	bool convert_linear_swizzle_tiled(void* input_pixels, void* output_pixels, u16 width, u16 height, u32 texel_size, bool input_is_swizzled)
+	{
+		if (width < 4 || height < 4 || (width & (width - 1)) || (height & (height - 1)))
+		{
+			return false;
+		}
+
+		u8 *linear = static_cast<u8*>(input_is_swizzled ? output_pixels : input_pixels);
+		u8 *swizzled = static_cast<u8*>(input_is_swizzled ? input_pixels : output_pixels);
+
+		switch (texel_size)
+		{
+		case 2:
+			if (input_is_swizzled)
+				convert_tiles<2, true>(linear, swizzled, width, height);
+			else
+				convert_tiles<2, false>(linear, swizzled, width, height);
+			return true;
+		case 4:
+			if (input_is_swizzled)
+				convert_tiles<4, true>(linear, swizzled, width, height);
+			else
+				convert_tiles<4, false>(linear, swizzled, width, height);
+			return true;
+		}
+
+		return false;
+	}
+
 	void convert_scale_image(u8 *dst, AVPixelFormat dst_format, int dst_width, int dst_height, int dst_pitch,
 		const u8 *src, AVPixelFormat src_format, int src_width, int src_height, int src_pitch, int src_slice_h, bool bilinear)
 	{
@@ -29,9 +29,20 @@ namespace rsx
 	*       - It will handle any width and height that are a power of 2, square or non square
 	*	 Restriction: It has mixed results if the height or width is not a power of 2
 	*/
+	/**
+	* Swizzle or deswizzle a 16 or 32 bit texture by 4x4 texel tiles using SSE.
+	* Returns false if the texture can't be handled this way (non power of 2 or smaller than 4 texels dimensions).
+	*/
+	bool convert_linear_swizzle_tiled(void* input_pixels, void* output_pixels, u16 width, u16 height, u32 texel_size, bool input_is_swizzled);
+
 	template<typename T>
 	void convert_linear_swizzle(void* input_pixels, void* output_pixels, u16 width, u16 height, bool input_is_swizzled)
 	{
+		if ((sizeof(T) == 2 || sizeof(T) == 4) && convert_linear_swizzle_tiled(input_pixels, output_pixels, width, height, sizeof(T), input_is_swizzled))
+		{
+			return;
+		}
+
 		u16 log2width = gsl::narrow<u16>(ceil(log2(width)));
 		u16 log2height = gsl::narrow<u16>(ceil(log2(height)));
 
@@ -40,7 +51,7 @@ namespace rsx
 		u32 y_mask = 0xAAAAAAAA;
 
 		// We have to limit the masks to the lower of the two dimensions to allow for non-square textures
-		u16 limit_mask = (log2width < log2height) ? log2width : log2height;
+		u32 limit_mask = (log2width < log2height) ? log2width : log2height;
 		// double the limit mask to account for bits in both x and y
 		limit_mask = 1 << (limit_mask << 1);
 
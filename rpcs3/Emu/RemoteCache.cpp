@@ -0,0 +1,344 @@
+#include "stdafx.h"
+#include "config.h"
+#include "Utilities/Thread.h"
+#include "RemoteCache.h"
+
+#ifdef _WIN32
+#undef _WIN32_WINNT
+#define _WIN32_WINNT 0x0601
+#include <winsock2.h>
+#include <WS2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#endif
+
+extern u64 get_system_time();
+
+namespace remote_cache
+{
+#ifdef _WIN32
+	using socket_t = SOCKET;
+	static const socket_t invalid_socket = INVALID_SOCKET;
+#else
+	using socket_t = int;
+	static const socket_t invalid_socket = -1;
+#endif
+
+	static const u64 retry_delay = 30000000; // Time without requests after an error (us)
+	static const int connect_timeout = 2000; // ms
+	static const int io_timeout = 10000; // ms
+	static const std::size_t max_entry_size = 256 * 1024 * 1024;
+	static const std::size_t max_pending_uploads = 64;
+
+	static std::atomic<u64> g_retry_time{ 0 };
+
+	static std::mutex g_upload_mutex;
+	static std::deque<std::tuple<std::string, std::string, std::vector<u8>>> g_uploads;
+	static bool g_upload_thread = false;
+
+	struct url_t
+	{
+		std::string host;
+		std::string port = "80";
+		std::string path; // Without the trailing slash
+	};
+
+	// Parse http://host[:port][/path], returns false if the URL is empty or unsupported
+	static bool parse_url(url_t& result)
+	{
+		std::string url = rpcs3::config.misc.remote_cache_url.value();
+
+		if (url.empty())
+		{
+			return false;
+		}
+
+		if (url.compare(0, 7, "http://") != 0)
+		{
+			LOG_ERROR(GENERAL, "Remote cache: unsupported URL '%s' (only http:// is supported)", url);
+			return false;
+		}
+
+		url.erase(0, 7);
+
+		while (!url.empty() && url.back() == '/')
+		{
+			url.pop_back();
+		}
+
+		const auto path_pos = url.find('/');
+		const std::string& host = url.substr(0, path_pos);
+		const auto port_pos = host.find(':');
+
+		result.host = host.substr(0, port_pos);
+		result.path = path_pos == std::string::npos ? "" : url.substr(path_pos);
+
+		if (port_pos != std::string::npos)
+		{
+			result.port = host.substr(port_pos + 1);
+		}
+
+		return !result.host.empty();
+	}
+
+	static void close_socket(socket_t s)
+	{
+#ifdef _WIN32
+		::closesocket(s);
+#else
+		::close(s);
+#endif
+	}
+
+	static socket_t connect_to(const url_t& url)
+	{
+#ifdef _WIN32
+		static const bool wsa_initialized = []
+		{
+			WSADATA data;
+			return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+		}();
+#endif
+
+		addrinfo hints{};
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+
+		addrinfo* info = nullptr;
+
+		if (::getaddrinfo(url.host.c_str(), url.port.c_str(), &hints, &info) != 0 || !info)
+		{
+			return invalid_socket;
+		}
+
+		socket_t result = invalid_socket;
+
+		for (addrinfo* ai = info; ai && result == invalid_socket; ai = ai->ai_next)
+		{
+			const socket_t s = ::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+
+			if (s == invalid_socket)
+			{
+				continue;
+			}
+
+			// Non-blocking connect with a timeout
+#ifdef _WIN32
+			u_long mode = 1;
+			::ioctlsocket(s, FIONBIO, &mode);
+#else
+			::fcntl(s, F_SETFL, ::fcntl(s, F_GETFL, 0) | O_NONBLOCK);
+#endif
+
+			bool connected = ::connect(s, ai->ai_addr, static_cast<int>(ai->ai_addrlen)) == 0;
+
+			if (!connected)
+			{
+#ifdef _WIN32
+				WSAPOLLFD pfd{ s, POLLOUT };
+				connected = WSAGetLastError() == WSAEWOULDBLOCK && ::WSAPoll(&pfd, 1, connect_timeout) == 1;
+#else
+				pollfd pfd{ s, POLLOUT };
+				connected = errno == EINPROGRESS && ::poll(&pfd, 1, connect_timeout) == 1;
+#endif
+				int error = 0;
+				socklen_t size = sizeof(error);
+
+				connected = connected && ::getsockopt(s, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&error), &size) == 0 && error == 0;
+			}
+
+			if (!connected)
+			{
+				close_socket(s);
+				continue;
+			}
+
+#ifdef _WIN32
+			mode = 0;
+			::ioctlsocket(s, FIONBIO, &mode);
+
+			const DWORD timeout = io_timeout;
+#else
+			::fcntl(s, F_SETFL, ::fcntl(s, F_GETFL, 0) & ~O_NONBLOCK);
+
+			const timeval timeout{ io_timeout / 1000, 0 };
+#endif
+			::setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+			::setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+
+			result = s;
+		}
+
+		::freeaddrinfo(info);
+		return result;
+	}
+
+	static bool send_all(socket_t s, const void* data, std::size_t size)
+	{
+		for (auto ptr = static_cast<const char*>(data); size;)
+		{
+			const auto sent = ::send(s, ptr, static_cast<int>(std::min<std::size_t>(size, 0x100000)), 0);
+
+			if (sent <= 0)
+			{
+				return false;
+			}
+
+			ptr += sent;
+			size -= sent;
+		}
+
+		return true;
+	}
+
+	// Send the request and read the response, returns HTTP status (0 on network error)
+	static u32 request(const char* method, const std::string& ns, const std::string& key, const std::vector<u8>* body, std::vector<u8>* response)
+	{
+		url_t url;
+
+		if (get_system_time() < g_retry_time || !parse_url(url))
+		{
+			return 0;
+		}
+
+		const socket_t s = connect_to(url);
+
+		if (s == invalid_socket)
+		{
+			LOG_WARNING(GENERAL, "Remote cache: cannot connect to %s:%s", url.host, url.port);
+			g_retry_time = get_system_time() + retry_delay;
+			return 0;
+		}
+
+		std::string header = fmt::format("%s %s/%s/%s HTTP/1.0\r\nHost: %s\r\nConnection: close\r\n", method, url.path, ns, key, url.host);
+
+		if (body)
+		{
+			header += fmt::format("Content-Type: application/octet-stream\r\nContent-Length: %llu\r\n", static_cast<u64>(body->size()));
+		}
+
+		header += "\r\n";
+
+		std::vector<u8> data;
+
+		bool ok = send_all(s, header.data(), header.size()) && (!body || send_all(s, body->data(), body->size()));
+
+		// Read until the server closes the connection
+		for (char buf[65536]; ok;)
+		{
+			const auto received = ::recv(s, buf, sizeof(buf), 0);
+
+			if (received == 0)
+			{
+				break;
+			}
+
+			if (received < 0 || data.size() + received > max_entry_size)
+			{
+				ok = false;
+				break;
+			}
+
+			data.insert(data.end(), buf, buf + received);
+		}
+
+		close_socket(s);
+
+		const char* const begin = reinterpret_cast<const char*>(data.data());
+		const char* const end = begin + data.size();
+		const char* const body_pos = std::search(begin, end, "\r\n\r\n", "\r\n\r\n" + 4);
+
+		u32 status = 0;
+
+		if (!ok || body_pos == end || std::sscanf(std::string(begin, body_pos).c_str(), "HTTP/%*u.%*u %u", &status) != 1)
+		{
+			LOG_WARNING(GENERAL, "Remote cache: %s %s/%s failed", method, ns, key);
+			g_retry_time = get_system_time() + retry_delay;
+			return 0;
+		}
+
+		if (response)
+		{
+			response->assign(body_pos + 4, end);
+		}
+
+		return status;
+	}
+}
+
+bool remote_cache::is_enabled()
+{
+	return get_system_time() >= g_retry_time && !rpcs3::config.misc.remote_cache_url.value().empty();
+}
+
+bool remote_cache::get(const std::string& ns, const std::string& key, std::vector<u8>& data)
+{
+	if (!is_enabled())
+	{
+		return false;
+	}
+
+	return request("GET", ns, key, nullptr, &data) == 200 && !data.empty();
+}
+
+void remote_cache::put(const std::string& ns, const std::string& key, std::vector<u8> data)
+{
+	if (!is_enabled())
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(g_upload_mutex);
+
+	if (g_uploads.size() >= max_pending_uploads)
+	{
+		return;
+	}
+
+	g_uploads.emplace_back(ns, key, std::move(data));
+
+	if (g_upload_thread)
+	{
+		return;
+	}
+
+	g_upload_thread = true;
+
+	// The thread exits when the queue is empty
+	thread_ctrl::spawn(PURE_EXPR("Remote Cache Upload"s), []()
+	{
+		std::unique_lock<std::mutex> lock(g_upload_mutex);
+
+		while (!g_uploads.empty())
+		{
+			const auto entry = std::move(g_uploads.front());
+			g_uploads.pop_front();
+
+			lock.unlock();
+
+			const u32 status = request("PUT", std::get<0>(entry), std::get<1>(entry), &std::get<2>(entry), nullptr);
+
+			if (status && (status < 200 || status >= 300))
+			{
+				LOG_WARNING(GENERAL, "Remote cache: upload of %s/%s rejected (HTTP %u)", std::get<0>(entry), std::get<1>(entry), status);
+			}
+
+			lock.lock();
+
+			if (!status)
+			{
+				// Server unreachable, drop pending uploads
+				g_uploads.clear();
+			}
+		}
+
+		g_upload_thread = false;
+	});
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+// Remote compilation cache shared by emulator instances and hosts (set with the "Remote cache URL" option, e.g. http://host:8080/rpcs3).
+// Entries are plain HTTP resources <url>/<namespace>/<key>: GET downloads an entry, PUT uploads it, any static file server accepting PUT works.
+// Local caches stay authoritative: remote entries are only read on local misses and stored locally, uploads are made in background.
+// After a network error the remote cache isn't used for some time (the emulation never waits for an unreachable server more than once).
+namespace remote_cache
+{
+	// Returns true if the URL is set and the server didn't fail recently
+	bool is_enabled();
+
+	// Download the entry (returns false if not found or on error)
+	bool get(const std::string& ns, const std::string& key, std::vector<u8>& data);
+
+	// Queue the entry for the upload (dropped if too many uploads are pending)
+	void put(const std::string& ns, const std::string& key, std::vector<u8> data);
+}
@@ -0,0 +1,338 @@
+#include "stdafx.h"
+#include "Emu/Memory/Memory.h"
+#include "Emu/System.h"
+#include "Emu/IdManager.h"
+#include "Emu/Cell/PPUThread.h"
+#include "Emu/RSX/rsx_methods.h"
+#include "Emu/Memory/MemorySnapshot.h"
+
+#include "SaveState.h"
+
+namespace savestate
+{
+	const u64 magic = 0x0053533353435052ull; // "RPCS3SS\0"
+	const u32 version = 1;
+
+	enum : u32
+	{
+		section_memory = 1,
+		section_ppu = 2,
+		section_rsx = 3,
+		section_end = 0xffffffff,
+	};
+
+	const u32 page_zero = 1; // flag in the page record: the page is filled with zeros (no data follows)
+	const u32 page_end = 0xffffffff;
+
+	const vm::memory_location_t locations[] = { vm::main, vm::user_space, vm::video, vm::stack };
+
+	// PPU thread context (stored as is)
+	struct ppu_context_t
+	{
+		u32 id;
+		u32 PC;
+		u64 GPR[32];
+		u64 FPR[32];
+		v128 VPR[32];
+		u32 CR;
+		u32 FPSCR;
+		u32 VSCR;
+		u32 VRSAVE;
+		u64 XER;
+		u64 LR;
+		u64 CTR;
+		u64 SPRG[8];
+		u64 TB;
+		s32 prio;
+		u32 vpcr;
+	};
+
+	template<typename T>
+	static void write(const fs::file& f, const T& data)
+	{
+		if (f.write(&data, sizeof(T)) != sizeof(T))
+		{
+			throw EXCEPTION("Write failed");
+		}
+	}
+
+	template<typename T>
+	static bool read(const fs::file& f, T& data)
+	{
+		return f.read(&data, sizeof(T)) == sizeof(T);
+	}
+
+	static bool is_zero_page(const u8* ptr)
+	{
+		const u64* data = reinterpret_cast<const u64*>(ptr);
+
+		for (u32 i = 0; i < 4096 / sizeof(u64); i++)
+		{
+			if (data[i]) return false;
+		}
+
+		return true;
+	}
+
+	bool save(const std::string& path)
+	{
+		if (!Emu.IsPaused())
+		{
+			LOG_ERROR(GENERAL, "savestate::save(): the emulation must be paused");
+			return false;
+		}
+
+		const auto f = std::make_shared<fs::file>(path, fom::rewrite);
+
+		if (!*f)
+		{
+			LOG_ERROR(GENERAL, "savestate::save(): failed to create '%s'", path);
+			return false;
+		}
+
+		// Capture the state: guest memory is only write-protected, it's copied later
+		const auto snapshot = vm::snapshot_t::create();
+
+		if (!snapshot)
+		{
+			LOG_ERROR(GENERAL, "savestate::save(): another snapshot is being written");
+			return false;
+		}
+
+		std::vector<ppu_context_t> contexts;
+
+		for (const auto& pair : idm::get_map<PPUThread>())
+		{
+			const PPUThread& ppu = *pair.second;
+
+			ppu_context_t ctx{};
+			ctx.id = pair.first;
+			ctx.PC = ppu.PC;
+			std::memcpy(ctx.GPR, ppu.GPR, sizeof(ctx.GPR));
+			for (u32 i = 0; i < 32; i++) ctx.FPR[i] = ppu.FPR[i]._u64;
+			std::memcpy(ctx.VPR, ppu.VPR, sizeof(ctx.VPR));
+			ctx.CR = ppu.CR.CR;
+			ctx.FPSCR = ppu.FPSCR.FPSCR;
+			ctx.VSCR = ppu.VSCR.VSCR;
+			ctx.VRSAVE = ppu.VRSAVE;
+			ctx.XER = ppu.XER.XER;
+			ctx.LR = ppu.LR;
+			ctx.CTR = ppu.CTR;
+			std::memcpy(ctx.SPRG, ppu.SPRG, sizeof(ctx.SPRG));
+			ctx.TB = ppu.TB;
+			ctx.prio = ppu.prio;
+			ctx.vpcr = ppu.vpcr;
+
+			contexts.emplace_back(ctx);
+		}
+
+		const auto rsx_registers = std::make_shared<std::array<u32, sizeof(rsx::method_registers) / sizeof(u32)>>();
+
+		std::memcpy(rsx_registers->data(), rsx::method_registers, sizeof(rsx::method_registers));
+
+		const std::string title = Emu.GetTitleID();
+
+		// Write the file in background (the emulation may be resumed)
+		thread_ctrl::spawn(PURE_EXPR("Savestate Writer"s), [=]()
+		{
+			write(*f, magic);
+			write(*f, version);
+			write(*f, u32(title.size()));
+			f->write(title.data(), title.size());
+
+			// Guest memory
+			write(*f, section_memory);
+
+			u64 zero_pages = 0;
+
+			u8 page[4096];
+
+			for (const u32 addr : snapshot->pages())
+			{
+				snapshot->read_page(addr, page);
+
+				if (is_zero_page(page))
+				{
+					zero_pages++;
+					write(*f, addr | page_zero);
+					continue;
+				}
+
+				write(*f, addr);
+				f->write(page, 4096);
+			}
+
+			write(*f, page_end);
+
+			// PPU threads
+			write(*f, section_ppu);
+			write(*f, u32(contexts.size()));
+
+			for (const auto& ctx : contexts)
+			{
+				write(*f, ctx);
+			}
+
+			// RSX registers
+			write(*f, section_rsx);
+			write(*f, *rsx_registers);
+
+			write(*f, section_end);
+
+			LOG_SUCCESS(GENERAL, "Savestate written to '%s' (%llu pages, %llu zero pages, %u PPU threads)", path, u64(snapshot->pages().size()), zero_pages, u32(contexts.size()));
+		});
+
+		return true;
+	}
+
+	bool load(const std::string& path)
+	{
+		if (!Emu.IsPaused())
+		{
+			LOG_ERROR(GENERAL, "savestate::load(): the emulation must be paused");
+			return false;
+		}
+
+		fs::file f(path);
+
+		if (!f)
+		{
+			LOG_ERROR(GENERAL, "savestate::load(): failed to open '%s'", path);
+			return false;
+		}
+
+		u64 file_magic;
+		u32 file_version, title_size;
+
+		if (!read(f, file_magic) || !read(f, file_version) || file_magic != magic || file_version != version || !read(f, title_size) || title_size > 4096)
+		{
+			LOG_ERROR(GENERAL, "savestate::load(): '%s' is not a supported savestate", path);
+			return false;
+		}
+
+		std::string title(title_size, '\0');
+
+		if (f.read(&title[0], title_size) != title_size || title != Emu.GetTitleID())
+		{
+			LOG_ERROR(GENERAL, "savestate::load(): the savestate was made for another title (%s)", title);
+			return false;
+		}
+
+		const auto threads = idm::get_map<PPUThread>();
+
+		for (const auto& pair : threads)
+		{
+			if (pair.second->hle_code)
+			{
+				LOG_ERROR(GENERAL, "savestate::load(): %s is inside of an HLE call", pair.second->get_name());
+				return false;
+			}
+		}
+
+		const u64 start = f.seek(0, fs::seek_cur);
+
+		// Validate the snapshot before changing anything, then apply it
+		for (const bool apply : { false, true })
+		{
+			f.seek(start);
+
+			u32 section;
+
+			if (!read(f, section) || section != section_memory)
+			{
+				LOG_ERROR(GENERAL, "savestate::load(): invalid memory section");
+				return false;
+			}
+
+			for (u32 page; read(f, page) && page != page_end;)
+			{
+				const u32 addr = page & ~0xfffu;
+
+				if (!apply && !vm::check_addr(addr, 4096))
+				{
+					LOG_ERROR(GENERAL, "savestate::load(): memory layout mismatch (page 0x%x isn't allocated)", addr);
+					return false;
+				}
+
+				if (page & page_zero)
+				{
+					if (apply) std::memset(vm::g_priv_addr + addr, 0, 4096);
+				}
+				else if (apply)
+				{
+					f.read(vm::g_priv_addr + addr, 4096);
+				}
+				else
+				{
+					f.seek(4096, fs::seek_cur);
+				}
+			}
+
+			u32 count;
+
+			if (!read(f, section) || section != section_ppu || !read(f, count) || count != threads.size())
+			{
+				LOG_ERROR(GENERAL, "savestate::load(): PPU threads mismatch");
+				return false;
+			}
+
+			for (u32 i = 0; i < count; i++)
+			{
+				ppu_context_t ctx;
+
+				if (!read(f, ctx) || !threads.count(ctx.id))
+				{
+					LOG_ERROR(GENERAL, "savestate::load(): PPU threads mismatch");
+					return false;
+				}
+
+				if (!apply)
+				{
+					continue;
+				}
+
+				PPUThread& ppu = *threads.at(ctx.id);
+
+				ppu.PC = ctx.PC;
+				std::memcpy(ppu.GPR, ctx.GPR, sizeof(ctx.GPR));
+				for (u32 r = 0; r < 32; r++) ppu.FPR[r]._u64 = ctx.FPR[r];
+				std::memcpy(ppu.VPR, ctx.VPR, sizeof(ctx.VPR));
+				ppu.CR.CR = ctx.CR;
+				ppu.FPSCR.FPSCR = ctx.FPSCR;
+				ppu.VSCR.VSCR = ctx.VSCR;
+				ppu.VRSAVE = ctx.VRSAVE;
+				ppu.XER.XER = ctx.XER;
+				ppu.LR = ctx.LR;
+				ppu.CTR = ctx.CTR;
+				std::memcpy(ppu.SPRG, ctx.SPRG, sizeof(ctx.SPRG));
+				ppu.TB = ctx.TB;
+				ppu.prio = ctx.prio;
+				ppu.vpcr = ctx.vpcr;
+			}
+
+			if (!read(f, section) || section != section_rsx)
+			{
+				LOG_ERROR(GENERAL, "savestate::load(): invalid RSX section");
+				return false;
+			}
+
+			if (apply)
+			{
+				read(f, rsx::method_registers);
+			}
+			else
+			{
+				f.seek(sizeof(rsx::method_registers), fs::seek_cur);
+			}
+
+			if (!read(f, section) || section != section_end)
+			{
+				LOG_ERROR(GENERAL, "savestate::load(): unexpected end of the savestate");
+				return false;
+			}
+		}
+
+		LOG_SUCCESS(GENERAL, "Savestate loaded from '%s'", path);
+		return true;
+	}
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+// Emulation state snapshots.
+// The file is a sequence of sections written in one pass (so it can be streamed): guest memory (allocated pages only,
+// zero pages are stored without data), PPU thread contexts and RSX method registers.
+// lv2 objects, SPU threads and HLE module state aren't serialized yet: a snapshot can only be restored into a paused
+// emulation of the same title with the same memory layout and PPU threads, none of them being inside of an HLE call.
+namespace savestate
+{
+	// Capture the snapshot of the paused emulation, the file is written in background (guest memory is copied on write,
+	// so the emulation can be resumed immediately)
+	bool save(const std::string& path);
+
+	// Restore the snapshot into the paused emulation (nothing is changed if the snapshot is incompatible)
+	bool load(const std::string& path);
+}
@@ -16,16 +16,50 @@ void CallbackManager::Register(check_cb_t func)
 
 void CallbackManager::Async(async_cb_t func)
 {
-	std::lock_guard<std::mutex> lock(m_mutex);
-
 	if (!m_cb_thread)
 	{
 		throw EXCEPTION("Callback thread not found");
 	}
 
-	m_async_cb.emplace(std::move(func));
+	async_cb_node_t* node = new async_cb_node_t{ std::move(func), m_async_cb.load() };
+
+	while (!m_async_cb.compare_exchange_weak(node->next, node))
+	{
+	}
+
+	if (m_async_waiting)
+	{
+		// The callback thread can't miss the notification: it checks the queue after setting the flag, under the lock
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		m_cb_thread->cv.notify_one();
+	}
+}
+
+CallbackManager::async_cb_node_t* CallbackManager::PopAsync()
+{
+	async_cb_node_t* node = m_async_cb.exchange(nullptr);
+	async_cb_node_t* result = nullptr;
+
+	// Reverse the stack
+	while (node)
+	{
+		async_cb_node_t* next = node->next;
+		node->next = result;
+		result = node;
+		node = next;
+	}
 
-	m_cb_thread->cv.notify_one();
+	return result;
+}
+
+void CallbackManager::DeleteAsync(async_cb_node_t* node)
+{
+	while (node)
+	{
+		std::unique_ptr<async_cb_node_t> current(node);
+		node = node->next;
+	}
 }
 
 CallbackManager::check_cb_t CallbackManager::Check()
@@ -50,32 +84,42 @@ void CallbackManager::Init()
 
 	auto task = [this](PPUThread& ppu)
 	{
-		std::unique_lock<std::mutex> lock(m_mutex);
-
 		while (true)
 		{
 			CHECK_EMU_STATUS;
 
-			if (!lock)
+			// Execute every callback queued since the last wakeup
+			if (async_cb_node_t* node = PopAsync())
 			{
-				lock.lock();
+				while (node)
+				{
+					std::unique_ptr<async_cb_node_t> current(node);
+					node = node->next;
+
+					try
+					{
+						current->func(ppu);
+					}
+					catch (...)
+					{
+						DeleteAsync(node);
+						throw;
+					}
+				}
+
 				continue;
 			}
 
-			if (m_async_cb.size())
-			{
-				async_cb_t func = std::move(m_async_cb.front());
-
-				m_async_cb.pop();
+			std::unique_lock<std::mutex> lock(m_mutex);
 
-				if (lock) lock.unlock();
+			m_async_waiting = true;
 
-				func(ppu);
-
-				continue;
+			if (!m_async_cb.load())
+			{
+				ppu.cv.wait(lock);
 			}
 
-			ppu.cv.wait(lock);
+			m_async_waiting = false;
 		}
 	};
 
@@ -97,7 +141,13 @@ void CallbackManager::Clear()
 	std::lock_guard<std::mutex> lock(m_mutex);
 
 	m_check_cb = decltype(m_check_cb){};
-	m_async_cb = decltype(m_async_cb){};
+
+	DeleteAsync(PopAsync());
 
 	m_cb_thread.reset();
 }
+
+CallbackManager::~CallbackManager()
+{
+	Clear();
+}
@@ -7,13 +7,29 @@ class CallbackManager
 	using check_cb_t = std::function<s32(PPUThread&)>;
 	using async_cb_t = std::function<void(PPUThread&)>;
 
+	struct async_cb_node_t
+	{
+		async_cb_t func;
+		async_cb_node_t* next;
+	};
+
 	std::mutex m_mutex;
 
 	std::queue<check_cb_t> m_check_cb;
-	std::queue<async_cb_t> m_async_cb;
+
+	// Async callbacks pushed by any thread, in reverse order (lock-free stack, drained at once by the callback thread)
+	std::atomic<async_cb_node_t*> m_async_cb{};
+
+	// Set while the callback thread is waiting, producers only lock m_mutex to wake it up
+	std::atomic<bool> m_async_waiting{};
 
 	std::shared_ptr<PPUThread> m_cb_thread;
 
+	// Take all queued async callbacks in the order they were pushed
+	async_cb_node_t* PopAsync();
+
+	static void DeleteAsync(async_cb_node_t* node);
+
 public:
 	// Register checked callback
 	void Register(check_cb_t func);
@@ -27,4 +43,6 @@ public:
 	void Init();
 
 	void Clear();
+
+	~CallbackManager();
 };
@@ -0,0 +1,116 @@
+#include "stdafx.h"
+#include "Emu/System.h"
+
+#include "HLEWorkerPool.h"
+
+class hle_worker_pool_t::worker_t final : public named_thread_t
+{
+	hle_worker_pool_t& m_pool;
+	const u32 m_index;
+
+	void on_task() override
+	{
+		m_pool.work();
+	}
+
+public:
+	worker_t(hle_worker_pool_t& pool, u32 index)
+		: m_pool(pool)
+		, m_index(index)
+	{
+	}
+
+	std::string get_name() const override
+	{
+		return fmt::format("HLE Worker[%u]", m_index);
+	}
+};
+
+void hle_worker_pool_t::work()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while (!m_exit)
+	{
+		CHECK_EMU_STATUS;
+
+		// pick the ready queue with the highest priority
+		queue_t* queue = nullptr;
+
+		for (auto& pair : m_queues)
+		{
+			auto& q = pair.second;
+
+			if (!q.running && q.tasks.size() && (!queue || q.priority < queue->priority))
+			{
+				queue = &q;
+			}
+		}
+
+		if (!queue)
+		{
+			// the timeout is used to check the emulation status
+			m_idle++;
+			m_cv.wait_for(lock, 10ms);
+			m_idle--;
+			continue;
+		}
+
+		const auto task = std::move(queue->tasks.front());
+		queue->tasks.pop_front();
+		queue->running = true;
+
+		lock.unlock();
+
+		try
+		{
+			task();
+		}
+		catch (...)
+		{
+			lock.lock();
+			queue->running = false;
+			throw;
+		}
+
+		lock.lock();
+		queue->running = false;
+	}
+}
+
+hle_worker_pool_t::~hle_worker_pool_t()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		m_exit = true;
+	}
+
+	m_cv.notify_all();
+
+	for (auto& worker : m_workers)
+	{
+		worker->join();
+	}
+}
+
+void hle_worker_pool_t::push(const std::string& queue, s32 priority, std::function<void()> task)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto& q = m_queues[queue];
+
+	q.priority = priority;
+	q.tasks.emplace_back(std::move(task));
+
+	if (!m_idle && m_workers.size() < max_workers)
+	{
+		// started thread waits for the lock
+		m_workers.emplace_back(std::make_shared<worker_t>(*this, static_cast<u32>(m_workers.size())));
+		m_workers.back()->start();
+	}
+	else
+	{
+		m_cv.notify_one();
+	}
+}
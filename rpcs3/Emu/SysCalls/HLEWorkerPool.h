@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Utilities/Thread.h"
+
+// Shared pool of host threads running asynchronous HLE work (AIO requests, dialog timers) instead of a new thread per request.
+// Tasks are pushed to named queues (usually one per module): tasks of the same queue run one at a time in FIFO order,
+// ready queues are served by priority (lower value first, like PPU thread priority).
+// Created on demand with fxm::get_always<hle_worker_pool_t>(), workers exit when the emulation is stopped.
+class hle_worker_pool_t final
+{
+	class worker_t;
+
+	struct queue_t
+	{
+		s32 priority = 0;
+		bool running = false; // a task of this queue is being executed
+		std::deque<std::function<void()>> tasks;
+	};
+
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	std::map<std::string, queue_t> m_queues;
+	std::vector<std::shared_ptr<worker_t>> m_workers;
+	u32 m_idle = 0; // count of workers waiting for tasks
+	bool m_exit = false;
+
+	// Worker thread loop
+	void work();
+
+public:
+	static const u32 max_workers = 4;
+
+	hle_worker_pool_t() = default;
+
+	hle_worker_pool_t(const hle_worker_pool_t&) = delete;
+
+	~hle_worker_pool_t();
+
+	// Add task to the queue (a new worker is started if all workers are busy and the limit isn't reached)
+	void push(const std::string& queue, s32 priority, std::function<void()> task);
+};
@@ -1,4 +1,5 @@
 #include "stdafx.h"
+#include "config.h"
 #include "Modules.h"
 #include "ModuleManager.h"
 
@@ -249,6 +250,8 @@ void ModuleManager::Init()
 	{
 		if (module && processed.emplace(module).second)
 		{
+			// messages below the level are filtered before formatting
+			module->enabled = rpcs3::config.misc.log.hle_level.value();
 			module->Init();
 		}
 	}
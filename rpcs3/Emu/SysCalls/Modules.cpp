@@ -7,30 +7,64 @@
 #include "Crypto/sha1.h"
 #include "ModuleManager.h"
 #include "Emu/Cell/PPUInstrTable.h"
+#include "Utilities/Thread.h"
 
 std::vector<ModuleFunc> g_ppu_func_list;
 std::vector<StaticFunc> g_ppu_func_subs;
 std::vector<ModuleVariable> g_ps3_var_list;
 
+// FNID -> g_ppu_func_list index, VNID -> g_ps3_var_list index
+std::unordered_map<u32, u32> g_ppu_func_index;
+std::unordered_map<u32, u32> g_ps3_var_index;
+
+// Parallel to g_ppu_func_list, updated when the function is registered or its LLE address is set
+std::vector<ppu_func_dispatch_t> g_ppu_func_dispatch;
+
+// HLE call tracing formats function names and is compiled only in debug builds
+#ifdef _DEBUG
+#define HLE_TRACE(fmt, ...) LOG_TRACE(HLE, fmt, ##__VA_ARGS__)
+#else
+#define HLE_TRACE(fmt, ...)
+#endif
+
+static void update_ppu_func_dispatch(u32 index)
+{
+	const auto& func = g_ppu_func_list[index];
+	auto& record = g_ppu_func_dispatch[index];
+
+	record.id = func.id;
+	record.flags = func.flags;
+	record.func = func.func;
+	record.lle_func = func.flags & MFF_FORCED_HLE ? vm::null : func.lle_func;
+	record.module = func.module;
+}
+
 u32 add_ppu_func(ModuleFunc func)
 {
 	if (g_ppu_func_list.empty())
 	{
 		// prevent relocations if the array growths, must be sizeof(ModuleFunc) * 0x8000 ~~ about 1 MB of memory
 		g_ppu_func_list.reserve(0x8000);
+		g_ppu_func_dispatch.reserve(0x8000);
+		g_ppu_func_index.reserve(0x8000);
 	}
 
-	for (auto& f : g_ppu_func_list)
+	const auto found = g_ppu_func_index.emplace(func.id, (u32)g_ppu_func_list.size());
+
+	if (!found.second)
 	{
-		if (f.id == func.id)
-		{
-			// if NIDs overlap or if the same function is added twice
-			throw EXCEPTION("FNID already exists: 0x%08x (%s)", f.id, f.name);
-		}
+		// if NIDs overlap or if the same function is added twice
+		throw EXCEPTION("FNID already exists: 0x%08x (%s)", func.id, g_ppu_func_list[found.first->second].name);
 	}
 
+	g_ppu_func_dispatch.emplace_back();
+	g_ppu_func_dispatch.back().name = func.name ? func.name : get_ps3_function_name(func.id);
+
 	g_ppu_func_list.emplace_back(std::move(func));
-	return (u32)g_ppu_func_list.size() - 1;
+
+	const u32 index = (u32)g_ppu_func_list.size() - 1;
+	update_ppu_func_dispatch(index);
+	return index;
 }
 
 void add_variable(u32 nid, Module<>* module, const char* name, u32(*addr)())
@@ -38,14 +72,12 @@ void add_variable(u32 nid, Module<>* module, const char* name, u32(*addr)())
 	if (g_ps3_var_list.empty())
 	{
 		g_ps3_var_list.reserve(0x4000); // as g_ppu_func_list
+		g_ps3_var_index.reserve(0x4000);
 	}
 
-	for (auto& v : g_ps3_var_list)
+	if (!g_ps3_var_index.emplace(nid, (u32)g_ps3_var_list.size()).second)
 	{
-		if (v.id == nid)
-		{
-			throw EXCEPTION("VNID already exists: 0x%08x (%s)", nid, name);
-		}
+		throw EXCEPTION("VNID already exists: 0x%08x (%s)", nid, name);
 	}
 
 	g_ps3_var_list.emplace_back(ModuleVariable{ nid, module, name, addr });
@@ -53,15 +85,14 @@ void add_variable(u32 nid, Module<>* module, const char* name, u32(*addr)())
 
 ModuleVariable* get_variable_by_nid(u32 nid)
 {
-	for (auto& v : g_ps3_var_list)
+	const auto found = g_ps3_var_index.find(nid);
+
+	if (found == g_ps3_var_index.end())
 	{
-		if (v.id == nid)
-		{
-			return &v;
-		}
+		return nullptr;
 	}
 
-	return nullptr;
+	return &g_ps3_var_list[found->second];
 }
 
 u32 add_ppu_func_sub(StaticFunc func)
@@ -83,20 +114,19 @@ u32 add_ppu_func_sub(const std::initializer_list<SearchPatternEntry>& ops, const
 
 ModuleFunc* get_ppu_func_by_nid(u32 nid, u32* out_index)
 {
-	for (auto& f : g_ppu_func_list)
+	const auto found = g_ppu_func_index.find(nid);
+
+	if (found == g_ppu_func_index.end())
 	{
-		if (f.id == nid)
-		{
-			if (out_index)
-			{
-				*out_index = (u32)(&f - g_ppu_func_list.data());
-			}
+		return nullptr;
+	}
 
-			return &f;
-		}
+	if (out_index)
+	{
+		*out_index = found->second;
 	}
 
-	return nullptr;
+	return &g_ppu_func_list[found->second];
 }
 
 ModuleFunc* get_ppu_func_by_index(u32 index)
@@ -111,9 +141,27 @@ ModuleFunc* get_ppu_func_by_index(u32 index)
 	return &g_ppu_func_list[index];
 }
 
+const ppu_func_dispatch_t* get_ppu_func_dispatch(u32 index)
+{
+	index &= ~EIF_FLAGS;
+
+	if (index >= g_ppu_func_dispatch.size())
+	{
+		return nullptr;
+	}
+
+	return &g_ppu_func_dispatch[index];
+}
+
+void set_ppu_func_lle(u32 index, u32 addr)
+{
+	g_ppu_func_list.at(index).lle_func.set(addr);
+	update_ppu_func_dispatch(index);
+}
+
 void execute_ppu_func_by_index(PPUThread& ppu, u32 index)
 {
-	if (auto func = get_ppu_func_by_index(index))
+	if (auto func = get_ppu_func_dispatch(index))
 	{
 		// save RTOC if necessary
 		if (index & EIF_SAVE_RTOC)
@@ -131,24 +179,24 @@ void execute_ppu_func_by_index(PPUThread& ppu, u32 index)
 
 			if (last_code)
 			{
-				throw EXCEPTION("This function cannot be called from the callback: %s (0x%llx)", get_ps3_function_name(func->id), func->id);
+				throw EXCEPTION("This function cannot be called from the callback: %s (0x%llx)", func->name, func->id);
 			}
 
-			if (!func->lle_func)
+			if (func->flags & MFF_FORCED_HLE)
 			{
-				throw EXCEPTION("LLE function not set: %s (0x%llx)", get_ps3_function_name(func->id), func->id);
+				throw EXCEPTION("Forced HLE enabled: %s (0x%llx)", func->name, func->id);
 			}
 
-			if (func->flags & MFF_FORCED_HLE)
+			if (!func->lle_func)
 			{
-				throw EXCEPTION("Forced HLE enabled: %s (0x%llx)", get_ps3_function_name(func->id), func->id);
+				throw EXCEPTION("LLE function not set: %s (0x%llx)", func->name, func->id);
 			}
 
-			LOG_TRACE(HLE, "Branch to LLE function: %s (0x%llx)", get_ps3_function_name(func->id), func->id);
+			HLE_TRACE("Branch to LLE function: %s (0x%llx)", func->name, func->id);
 
 			if (index & EIF_PERFORM_BLR)
 			{
-				throw EXCEPTION("TODO: Branch with link: %s (0x%llx)", get_ps3_function_name(func->id), func->id);
+				throw EXCEPTION("TODO: Branch with link: %s (0x%llx)", func->name, func->id);
 				// CPU.LR = CPU.PC + 4;
 			}
 
@@ -162,7 +210,7 @@ void execute_ppu_func_by_index(PPUThread& ppu, u32 index)
 		// change current syscall/NID value
 		ppu.hle_code = func->id;
 
-		if (func->lle_func && !(func->flags & MFF_FORCED_HLE))
+		if (func->lle_func)
 		{
 			// call LLE function if available
 
@@ -170,23 +218,23 @@ void execute_ppu_func_by_index(PPUThread& ppu, u32 index)
 			const u32 pc = data[0];
 			const u32 rtoc = data[1];
 
-			LOG_TRACE(HLE, "LLE function called: %s", get_ps3_function_name(func->id));
+			HLE_TRACE("LLE function called: %s", func->name);
 			
 			ppu.fast_call(pc, rtoc);
 
-			LOG_TRACE(HLE, "LLE function finished: %s -> 0x%llx", get_ps3_function_name(func->id), ppu.GPR[3]);
+			HLE_TRACE("LLE function finished: %s -> 0x%llx", func->name, ppu.GPR[3]);
 		}
 		else if (func->func)
 		{
-			LOG_TRACE(HLE, "HLE function called: %s", get_ps3_function_name(func->id));
+			HLE_TRACE("HLE function called: %s", func->name);
 
 			func->func(ppu);
 
-			LOG_TRACE(HLE, "HLE function finished: %s -> 0x%llx", get_ps3_function_name(func->id), ppu.GPR[3]);
+			HLE_TRACE("HLE function finished: %s -> 0x%llx", func->name, ppu.GPR[3]);
 		}
 		else
 		{
-			LOG_TODO(HLE, "Unimplemented function: %s -> CELL_OK", get_ps3_function_name(func->id));
+			LOG_TODO(HLE, "Unimplemented function: %s -> CELL_OK", func->name);
 			ppu.GPR[3] = 0;
 		}
 
@@ -199,7 +247,7 @@ void execute_ppu_func_by_index(PPUThread& ppu, u32 index)
 		// execute module-specific error check
 		if ((s64)ppu.GPR[3] < 0 && func->module && func->module->on_error)
 		{
-			func->module->on_error(ppu.GPR[3], func);
+			func->module->on_error(ppu.GPR[3], &g_ppu_func_list[index & ~EIF_FLAGS]);
 		}
 
 		ppu.hle_code = last_code;
@@ -213,8 +261,11 @@ void execute_ppu_func_by_index(PPUThread& ppu, u32 index)
 void clear_ppu_functions()
 {
 	g_ppu_func_list.clear();
+	g_ppu_func_index.clear();
+	g_ppu_func_dispatch.clear();
 	g_ppu_func_subs.clear();
 	g_ps3_var_list.clear();
+	g_ps3_var_index.clear();
 }
 
 u32 get_function_id(const char* name)
@@ -233,148 +284,265 @@ u32 get_function_id(const char* name)
 	return (u32&)output[0];
 }
 
-void hook_ppu_func(vm::ptr<u32> base, u32 pos, u32 size)
+// check the static function pattern at pos (labels are local to the search)
+static bool match_ppu_func_sub(const StaticFunc& sub, vm::ptr<u32> base, u32 pos, u32 size)
 {
-	using namespace PPU_instr;
+	std::unordered_map<u32, u32> labels;
 
-	for (auto& sub : g_ppu_func_subs)
+	bool found = sub.ops.size() != 0;
+
+	for (u32 k = pos, x = 0; x + 1 <= sub.ops.size(); k++, x++)
 	{
-		bool found = sub.ops.size() != 0;
+		if (k >= size)
+		{
+			found = false;
+			break;
+		}
 
-		for (u32 k = pos, x = 0; x + 1 <= sub.ops.size(); k++, x++)
+		// skip NOP
+		if (base[k] == 0x60000000)
 		{
-			if (k >= size)
+			x--;
+			continue;
+		}
+
+		const be_t<u32> data = sub.ops[x].data;
+		const be_t<u32> mask = sub.ops[x].mask;
+
+		const bool match = (base[k] & mask) == data;
+
+		switch (sub.ops[x].type)
+		{
+		case SPET_MASKED_OPCODE:
+		{
+			// masked pattern
+			if (!match)
 			{
 				found = false;
-				break;
 			}
 
-			// skip NOP
-			if (base[k] == 0x60000000)
+			break;
+		}
+		case SPET_OPTIONAL_MASKED_OPCODE:
+		{
+			// optional masked pattern
+			if (!match)
 			{
-				x--;
-				continue;
+				k--;
 			}
 
-			const be_t<u32> data = sub.ops[x].data;
-			const be_t<u32> mask = sub.ops[x].mask;
-
-			const bool match = (base[k] & mask) == data;
+			break;
+		}
+		case SPET_LABEL:
+		{
+			const u32 addr = (base + k--).addr();
+			const u32 lnum = data;
+			const auto label = labels.find(lnum);
 
-			switch (sub.ops[x].type)
-			{
-			case SPET_MASKED_OPCODE:
+			if (label == labels.end()) // register the label
 			{
-				// masked pattern
-				if (!match)
-				{
-					found = false;
-				}
-
-				break;
+				labels[lnum] = addr;
 			}
-			case SPET_OPTIONAL_MASKED_OPCODE:
+			else if (label->second != addr) // or check registered label
 			{
-				// optional masked pattern
-				if (!match)
-				{
-					k--;
-				}
+				found = false;
+			}
 
+			break;
+		}
+		case SPET_BRANCH_TO_LABEL:
+		{
+			if (!match)
+			{
+				found = false;
 				break;
 			}
-			case SPET_LABEL:
-			{
-				const u32 addr = (base + k--).addr();
-				const u32 lnum = data;
-				const auto label = sub.labels.find(lnum);
 
-				if (label == sub.labels.end()) // register the label
-				{
-					sub.labels[lnum] = addr;
-				}
-				else if (label->second != addr) // or check registered label
-				{
-					found = false;
-				}
+			const auto addr = (base[k] & 2 ? 0 : (base + k).addr()) + ((s32)base[k] << cntlz32(mask) >> (cntlz32(mask) + 2));
+			const auto lnum = sub.ops[x].num;
+			const auto label = labels.find(lnum);
 
-				break;
+			if (label == labels.end()) // register the label
+			{
+				labels[lnum] = addr;
 			}
-			case SPET_BRANCH_TO_LABEL:
+			else if (label->second != addr) // or check registered label
 			{
-				if (!match)
-				{
-					found = false;
-					break;
-				}
+				found = false;
+			}
 
-				const auto addr = (base[k] & 2 ? 0 : (base + k).addr()) + ((s32)base[k] << cntlz32(mask) >> (cntlz32(mask) + 2));
-				const auto lnum = sub.ops[x].num;
-				const auto label = sub.labels.find(lnum);
+			break;
+		}
+		//case SPET_BRANCH_TO_FUNC:
+		//{
+		//	if (!match)
+		//	{
+		//		found = false;
+		//		break;
+		//	}
+
+		//	const auto addr = (base[k] & 2 ? 0 : (base + k).addr()) + ((s32)base[k] << cntlz32(mask) >> (cntlz32(mask) + 2));
+		//	const auto nid = sub.ops[x].num;
+		//	// TODO: recursive call
+		//}
+		default:
+		{
+			throw EXCEPTION("Unknown search pattern type (%d)", sub.ops[x].type);
+		}
+		}
 
-				if (label == sub.labels.end()) // register the label
-				{
-					sub.labels[lnum] = addr;
-				}
-				else if (label->second != addr) // or check registered label
-				{
-					found = false;
-				}
+		if (!found)
+		{
+			break;
+		}
+	}
 
-				break;
+	return found;
+}
+
+// static function patterns indexed by the first instruction they must match
+struct ppu_func_sub_index_t
+{
+	// for every distinct mask: masked instruction -> pattern indices (in g_ppu_func_subs order)
+	std::vector<std::pair<u32, std::unordered_map<u32, std::vector<u32>>>> masked;
+
+	// patterns starting with an optional instruction, checked at every position
+	std::vector<u32> unindexed;
+
+	ppu_func_sub_index_t()
+	{
+		for (u32 i = 0; i < g_ppu_func_subs.size(); i++)
+		{
+			const auto& ops = g_ppu_func_subs[i].ops;
+
+			// labels don't consume instructions
+			auto op = std::find_if(ops.begin(), ops.end(), [](const SearchPatternEntry& op) { return op.type != SPET_LABEL; });
+
+			if (op == ops.end())
+			{
+				continue;
 			}
-			//case SPET_BRANCH_TO_FUNC:
-			//{
-			//	if (!match)
-			//	{
-			//		found = false;
-			//		break;
-			//	}
-
-			//	const auto addr = (base[k] & 2 ? 0 : (base + k).addr()) + ((s32)base[k] << cntlz32(mask) >> (cntlz32(mask) + 2));
-			//	const auto nid = sub.ops[x].num;
-			//	// TODO: recursive call
-			//}
-			default:
+
+			if (op->type != SPET_MASKED_OPCODE && op->type != SPET_BRANCH_TO_LABEL)
 			{
-				throw EXCEPTION("Unknown search pattern type (%d)", sub.ops[x].type);
+				unindexed.emplace_back(i);
+				continue;
 			}
+
+			const u32 mask = op->mask;
+			auto group = std::find_if(masked.begin(), masked.end(), [=](const auto& group) { return group.first == mask; });
+
+			if (group == masked.end())
+			{
+				masked.emplace_back(mask, std::unordered_map<u32, std::vector<u32>>{});
+				group = masked.end() - 1;
 			}
 
-			if (!found)
+			group->second[op->data].emplace_back(i);
+		}
+	}
+
+	// get the index of the first pattern found at pos, or -1
+	u32 find(vm::ptr<u32> base, u32 pos, u32 size) const
+	{
+		const u32 value = base[pos];
+
+		// candidates are checked in g_ppu_func_subs order, as only the first found pattern is hooked
+		std::vector<u32> candidates = unindexed;
+
+		for (auto& group : masked)
+		{
+			const auto found = group.second.find(value & group.first);
+
+			if (found != group.second.end())
 			{
-				break;
+				candidates.insert(candidates.end(), found->second.begin(), found->second.end());
 			}
 		}
 
-		if (found)
+		if (candidates.size() > 1)
 		{
-			LOG_SUCCESS(LOADER, "Function '%s' hooked (addr=*0x%x)", sub.name, base + pos);
-			sub.found++;
-			base[pos] = HACK(sub.index | EIF_PERFORM_BLR);
+			std::sort(candidates.begin(), candidates.end());
 		}
 
-		if (sub.labels.size())
+		for (u32 i : candidates)
 		{
-			sub.labels.clear();
+			if (match_ppu_func_sub(g_ppu_func_subs[i], base, pos, size))
+			{
+				return i;
+			}
 		}
+
+		return -1;
 	}
-}
+};
 
 void hook_ppu_funcs(vm::ptr<u32> base, u32 size)
 {
 	using namespace PPU_instr;
 
-	// TODO: optimize search
-	for (u32 i = 0; i < size; i++)
+	const ppu_func_sub_index_t index;
+
+	// search in parallel (memory isn't modified until all patterns are checked), results are (position, pattern index)
+	const u32 chunk_size = 0x4000;
+	const u32 chunk_count = (size + chunk_size - 1) / chunk_size;
+	const u32 thread_count = std::max<u32>(1, std::min<u32>(std::thread::hardware_concurrency(), chunk_count));
+
+	std::atomic<u32> next{ 0 };
+	std::vector<std::vector<std::pair<u32, u32>>> results(thread_count);
+
+	auto search = [&](u32 thread)
 	{
-		// skip NOP
-		if (base[i] == 0x60000000)
+		for (u32 chunk; (chunk = next++) < chunk_count;)
 		{
-			continue;
+			for (u32 i = chunk * chunk_size, end = std::min(i + chunk_size, size); i < end; i++)
+			{
+				// skip NOP
+				if (base[i] == 0x60000000)
+				{
+					continue;
+				}
+
+				const u32 sub = index.find(base, i, size);
+
+				if (sub < g_ppu_func_subs.size())
+				{
+					results[thread].emplace_back(i, sub);
+				}
+			}
 		}
+	};
+
+	std::vector<std::shared_ptr<thread_ctrl>> threads;
+
+	for (u32 i = 1; i < thread_count; i++)
+	{
+		threads.emplace_back(thread_ctrl::spawn(COPY_EXPR(fmt::format("Function Hook Search[%u]", i)), [&, i]() { search(i); }));
+	}
+
+	search(0);
+
+	for (auto& thread : threads)
+	{
+		thread->join();
+	}
+
+	std::vector<std::pair<u32, u32>> found;
+
+	for (auto& result : results)
+	{
+		found.insert(found.end(), result.begin(), result.end());
+	}
+
+	std::sort(found.begin(), found.end());
+
+	for (auto& pair : found)
+	{
+		auto& sub = g_ppu_func_subs[pair.second];
 
-		hook_ppu_func(base, i, size);
+		LOG_SUCCESS(LOADER, "Function '%s' hooked (addr=*0x%x)", sub.name, base + pair.first);
+		sub.found++;
+		base[pair.first] = HACK(sub.index | EIF_PERFORM_BLR);
 	}
 
 	// check functions
@@ -32,6 +32,17 @@ struct ModuleFunc
 	}
 };
 
+// Dispatch record of a registered function, resolved in advance for execute_ppu_func_by_index
+struct ppu_func_dispatch_t
+{
+	u32 id;
+	u32 flags;
+	ppu_func_caller func;
+	vm::ptr<void()> lle_func; // null if the HLE function must be called (not set or MFF_FORCED_HLE)
+	Module<>* module;
+	std::string name;
+};
+
 struct ModuleVariable
 {
 	u32 id;
@@ -63,7 +74,6 @@ struct StaticFunc
 	const char* name;
 	std::vector<SearchPatternEntry> ops;
 	u32 found;
-	std::unordered_map<u32, u32> labels;
 };
 
 template<> class Module<void> : public _log::channel
@@ -127,6 +137,8 @@ u32 add_ppu_func(ModuleFunc func);
 void add_variable(u32 nid, Module<>* module, const char* name, u32(*addr)());
 ModuleFunc* get_ppu_func_by_nid(u32 nid, u32* out_index = nullptr);
 ModuleFunc* get_ppu_func_by_index(u32 index);
+const ppu_func_dispatch_t* get_ppu_func_dispatch(u32 index);
+void set_ppu_func_lle(u32 index, u32 addr);
 ModuleVariable* get_variable_by_nid(u32 nid);
 void execute_ppu_func_by_index(PPUThread& ppu, u32 id);
 extern std::string get_ps3_function_name(u64 fid);
@@ -464,6 +464,7 @@ void adecOpen(u32 adec_id) // TODO: call from the constructor
 		}
 
 		adec.is_finished = true;
+		adec.finished.notify();
 
 	};
 
@@ -565,11 +566,11 @@ s32 cellAdecClose(u32 handle)
 	adec->is_closed = true;
 	adec->job.try_push(AdecTask(adecClose));
 
-	while (!adec->is_finished)
+	for (u64 events = adec->finished.get(); !adec->is_finished; events = adec->finished.get())
 	{
 		CHECK_EMU_STATUS;
 
-		std::this_thread::sleep_for(std::chrono::milliseconds(1)); // hack
+		adec->finished.wait(events);
 	}
 
 	idm::remove<PPUThread>(adec->adecCb->get_id());
@@ -2,6 +2,7 @@
 #include "Emu/Memory/Memory.h"
 #include "Emu/System.h"
 #include "Emu/state.h"
+#include "Utilities/Trace.h"
 #include "Emu/IdManager.h"
 #include "Emu/SysCalls/Modules.h"
 #include "Emu/SysCalls/Callback.h"
@@ -11,17 +12,149 @@
 #include "Emu/Event.h"
 #include "Emu/Audio/AudioManager.h"
 #include "Emu/Audio/AudioDumper.h"
+#include "Emu/Audio/AudioResampler.h"
 
 #include "cellAudio.h"
 
 extern Module<> cellAudio;
 
 extern u64 get_system_time();
+extern void wait_until_system_time(u64 deadline);
 
 AudioConfig g_audio;
 
 std::shared_ptr<thread_ctrl> g_audio_thread;
 
+static_assert(BUFFER_SIZE == AUDIO_SAMPLES, "Intermediate buffer size mismatch");
+
+namespace
+{
+	// store or accumulate 4 floats
+	template<bool First>
+	inline void mix_ps(float* dst, __m128 value)
+	{
+		_mm_store_ps(dst, First ? value : _mm_add_ps(_mm_load_ps(dst), value));
+	}
+
+	// Compute the volume of every frame of the block (part of cellAudioSetPortLevel functionality):
+	// the level moves by `inc` per frame until it reaches the requested value
+	void step_volume(AudioPortConfig& port, float* volume)
+	{
+		const auto param = port.level_set.load();
+
+		if (param.inc == 0.0f)
+		{
+			const __m128 level = _mm_set1_ps(port.level);
+
+			for (u32 i = 0; i < AUDIO_SAMPLES; i += 4)
+			{
+				_mm_store_ps(volume + i, level);
+			}
+
+			return;
+		}
+
+		const __m128 level = _mm_set1_ps(port.level);
+		const __m128 inc = _mm_set1_ps(param.inc);
+		const __m128 value = _mm_set1_ps(param.value);
+		const bool dec = param.inc < 0.0f;
+
+		for (u32 i = 0; i < AUDIO_SAMPLES; i += 4)
+		{
+			const __m128 step = _mm_add_ps(_mm_set1_ps(static_cast<float>(i)), _mm_set_ps(4.0f, 3.0f, 2.0f, 1.0f));
+			const __m128 ramp = _mm_add_ps(level, _mm_mul_ps(inc, step));
+
+			_mm_store_ps(volume + i, dec ? _mm_max_ps(ramp, value) : _mm_min_ps(ramp, value));
+		}
+
+		port.level = volume[AUDIO_SAMPLES - 1];
+
+		if (port.level == param.value)
+		{
+			port.level_set.compare_and_swap(param, { param.value, 0.0f });
+		}
+	}
+
+	template<bool First>
+	void mix_2ch(const be_t<f32>* buf, const float* volume, float* buf2ch, float* buf8ch)
+	{
+		const __m128 zero = _mm_setzero_ps();
+
+		for (u32 i = 0; i < AUDIO_SAMPLES; i += 4)
+		{
+			const __m128 vol = _mm_load_ps(volume + i);
+
+			// L0 R0 L1 R1, L2 R2 L3 R3
+			const __m128 lr01 = _mm_mul_ps(load_be_ps(buf + i * 2 + 0), _mm_unpacklo_ps(vol, vol));
+			const __m128 lr23 = _mm_mul_ps(load_be_ps(buf + i * 2 + 4), _mm_unpackhi_ps(vol, vol));
+
+			mix_ps<First>(buf2ch + i * 2 + 0, lr01);
+			mix_ps<First>(buf2ch + i * 2 + 4, lr23);
+
+			mix_ps<First>(buf8ch + i * 8 + 0, _mm_movelh_ps(lr01, zero));
+			mix_ps<First>(buf8ch + i * 8 + 8, _mm_movehl_ps(zero, lr01));
+			mix_ps<First>(buf8ch + i * 8 + 16, _mm_movelh_ps(lr23, zero));
+			mix_ps<First>(buf8ch + i * 8 + 24, _mm_movehl_ps(zero, lr23));
+
+			if (First)
+			{
+				for (u32 j = 0; j < 4; j++)
+				{
+					_mm_store_ps(buf8ch + i * 8 + j * 8 + 4, zero);
+				}
+			}
+		}
+	}
+
+	template<bool First>
+	void mix_8ch(const be_t<f32>* buf, const float* volume, float* buf2ch, float* buf8ch)
+	{
+		const __m128 k = _mm_set1_ps(0.708f);
+
+		for (u32 i = 0; i < AUDIO_SAMPLES; i += 2)
+		{
+			__m128 stereo[2];
+
+			for (u32 j = 0; j < 2; j++)
+			{
+				const __m128 vol = _mm_set1_ps(volume[i + j]);
+
+				// L R C LFE, RL RR SL SR
+				const __m128 front = _mm_mul_ps(load_be_ps(buf + (i + j) * 8 + 0), vol);
+				const __m128 back = _mm_mul_ps(load_be_ps(buf + (i + j) * 8 + 4), vol);
+
+				mix_ps<First>(buf8ch + (i + j) * 8 + 0, front);
+				mix_ps<First>(buf8ch + (i + j) * 8 + 4, back);
+
+				// (C + LFE) * 0.708 in every element
+				const __m128 center = _mm_movehl_ps(front, front);
+				const __m128 mid = _mm_mul_ps(_mm_add_ps(center, _mm_shuffle_ps(center, center, 0xb1)), k);
+
+				// L + RL + SL + mid, R + RR + SR + mid
+				stereo[j] = _mm_add_ps(_mm_add_ps(front, mid), _mm_add_ps(back, _mm_movehl_ps(back, back)));
+			}
+
+			mix_ps<First>(buf2ch + i * 2, _mm_movelh_ps(stereo[0], stereo[1]));
+		}
+	}
+}
+
+void audio_mix_port(AudioPortConfig& port, const be_t<f32>* buf, float* buf2ch, float* buf8ch, bool first)
+{
+	alignas(16) float volume[AUDIO_SAMPLES];
+
+	step_volume(port, volume);
+
+	if (port.channel == 2)
+	{
+		first ? mix_2ch<true>(buf, volume, buf2ch, buf8ch) : mix_2ch<false>(buf, volume, buf2ch, buf8ch);
+	}
+	else if (port.channel == 8)
+	{
+		first ? mix_8ch<true>(buf, volume, buf2ch, buf8ch) : mix_8ch<false>(buf, volume, buf2ch, buf8ch);
+	}
+}
+
 s32 cellAudioInit()
 {
 	cellAudio.warning("cellAudioInit()");
@@ -61,76 +194,134 @@ s32 cellAudioInit()
 			throw EXCEPTION("AudioDumper::Init() failed");
 		}
 
-		float buf2ch[2 * BUFFER_SIZE]; // intermediate buffer for 2 channels
-		float buf8ch[8 * BUFFER_SIZE]; // intermediate buffer for 8 channels
+		alignas(16) float buf2ch[2 * BUFFER_SIZE]; // intermediate buffer for 2 channels
+		alignas(16) float buf8ch[8 * BUFFER_SIZE]; // intermediate buffer for 8 channels
 
 		static const size_t out_buffer_size = 8 * BUFFER_SIZE; // output buffer for 8 channels
 
+		const bool use_u16 = rpcs3::config.audio.convert_to_u16.value();
+
+		// backend-driven output: mix when the data queued in the backend drops below the target latency (instead of the fixed schedule)
+		const bool backend_driven = rpcs3::config.audio.backend_driven.value();
+		const u64 latency = std::min<u64>(std::max<u64>(rpcs3::config.audio.latency.value(), 1) * 1000, (BUFFER_NUM - 2) * AUDIO_SAMPLES * 1000000ull / 48000);
+		const u32 frame_size = 8 * (use_u16 ? sizeof(u16) : sizeof(float));
+
+		// time stretching: resample the output to keep the backend queue around the target latency
+		const bool time_stretch = rpcs3::config.audio.time_stretch.value();
+		const size_t stretch_buffer_size = 8 * AudioResampler::GetMaxOutput(BUFFER_SIZE);
+
+		AudioResampler resampler;
+
 		std::unique_ptr<float[]> out_buffer[BUFFER_NUM];
+		std::unique_ptr<float[]> out_buffer_stretch[BUFFER_NUM];
+		std::unique_ptr<u16[]> out_buffer_u16[BUFFER_NUM]; // submitted data must stay valid until played
 
 		for (u32 i = 0; i < BUFFER_NUM; i++)
 		{
 			out_buffer[i].reset(new float[out_buffer_size] {});
+
+			if (time_stretch)
+			{
+				out_buffer_stretch[i].reset(new float[stretch_buffer_size] {});
+			}
+
+			if (use_u16)
+			{
+				out_buffer_u16[i].reset(new u16[time_stretch ? stretch_buffer_size : out_buffer_size] {});
+			}
 		}
 
-		squeue_t<float*, BUFFER_NUM - 1> out_queue;
+		AudioThread& audio_out = Emu.GetAudioManager().GetAudioOut();
+
+		bool opened = false;
 
-		scope_thread_t iat(PURE_EXPR("Internal Audio Thread"s), [&out_queue]()
+		const auto output = [&](u32 pos)
 		{
-			const bool use_u16 = rpcs3::config.audio.convert_to_u16.value();
+			const float* buffer = out_buffer[pos].get();
+			size_t size = out_buffer_size;
+
+			if (time_stretch)
+			{
+				const s32 queued = opened ? audio_out.GetQueuedSize() : -1;
 
-			Emu.GetAudioManager().GetAudioOut().Init();
+				if (queued >= 0)
+				{
+					resampler.UpdateRatio(queued / frame_size * 1000000ull / 48000, latency);
+				}
 
-			bool opened = false;
-			float* buffer;
+				size = 8 * resampler.Process(buffer, BUFFER_SIZE, out_buffer_stretch[pos].get());
+				buffer = out_buffer_stretch[pos].get();
+			}
 
-			while (out_queue.pop(buffer, [](){ return g_audio.state != AUDIO_STATE_INITIALIZED; }))
+			if (use_u16)
 			{
-				if (use_u16)
+				// convert the data from float to u16 with clipping:
+				// 2x MULPS
+				// 2x MAXPS (optional)
+				// 2x MINPS (optional)
+				// 2x CVTPS2DQ (converts float to s32)
+				// PACKSSDW (converts s32 to s16 with signed saturation)
+
+				u16* buf_u16 = out_buffer_u16[pos].get();
+				for (size_t i = 0; i < size; i += 8)
 				{
-					// convert the data from float to u16 with clipping:
-					// 2x MULPS
-					// 2x MAXPS (optional)
-					// 2x MINPS (optional)
-					// 2x CVTPS2DQ (converts float to s32)
-					// PACKSSDW (converts s32 to s16 with signed saturation)
-
-					u16 buf_u16[out_buffer_size];
-					for (size_t i = 0; i < out_buffer_size; i += 8)
-					{
-						const auto scale = _mm_set1_ps(0x8000);
-						(__m128i&)(buf_u16[i]) = _mm_packs_epi32(
-							_mm_cvtps_epi32(_mm_mul_ps(_mm_load_ps(buffer + i), scale)),
-							_mm_cvtps_epi32(_mm_mul_ps(_mm_load_ps(buffer + i + 4), scale)));
-					}
+					const auto scale = _mm_set1_ps(0x8000);
+					(__m128i&)(buf_u16[i]) = _mm_packs_epi32(
+						_mm_cvtps_epi32(_mm_mul_ps(_mm_load_ps(buffer + i), scale)),
+						_mm_cvtps_epi32(_mm_mul_ps(_mm_load_ps(buffer + i + 4), scale)));
+				}
 
-					if (!opened)
-					{
-						Emu.GetAudioManager().GetAudioOut().Open(buf_u16, out_buffer_size * sizeof(u16));
-						opened = true;
-					}
-					else
-					{
-						Emu.GetAudioManager().GetAudioOut().AddData(buf_u16, out_buffer_size * sizeof(u16));
-					}
+				if (!opened)
+				{
+					audio_out.Open(buf_u16, size * sizeof(u16));
+					opened = true;
 				}
 				else
 				{
-					if (!opened)
-					{
-						Emu.GetAudioManager().GetAudioOut().Open(buffer, out_buffer_size * sizeof(float));
-						opened = true;
-					}
-					else
-					{
-						Emu.GetAudioManager().GetAudioOut().AddData(buffer, out_buffer_size * sizeof(float));
-					}
+					audio_out.AddData(buf_u16, size * sizeof(u16));
 				}
 			}
+			else
+			{
+				if (!opened)
+				{
+					audio_out.Open(buffer, size * sizeof(float));
+					opened = true;
+				}
+				else
+				{
+					audio_out.AddData(buffer, size * sizeof(float));
+				}
+			}
+		};
+
+		squeue_t<u32, BUFFER_NUM - 1, true> out_queue; // Single producer (this thread) and consumer (Internal Audio Thread)
+
+		// AddData() may block until the backend has a free buffer, so it's called from another thread (except in backend-driven mode)
+		scope_thread_t iat(PURE_EXPR("Internal Audio Thread"s), [&]()
+		{
+			if (backend_driven)
+			{
+				return;
+			}
+
+			audio_out.Init();
 
-			Emu.GetAudioManager().GetAudioOut().Quit();
+			u32 pos;
+
+			while (out_queue.pop(pos, [](){ return g_audio.state != AUDIO_STATE_INITIALIZED; }))
+			{
+				output(pos);
+			}
+
+			audio_out.Quit();
 		});
 
+		if (backend_driven)
+		{
+			audio_out.Init();
+		}
+
 		while (g_audio.state == AUDIO_STATE_INITIALIZED && !Emu.IsStopped())
 		{
 			if (Emu.IsPaused())
@@ -145,12 +336,27 @@ s32 cellAudioInit()
 
 			// TODO: send beforemix event (in ~2,6 ms before mixing)
 
-			// precise time of sleeping: 5,(3) ms (or 256/48000 sec)
-			const u64 expected_time = g_audio.counter * AUDIO_SAMPLES * 1000000 / 48000;
-			if (expected_time >= time_pos)
+			const s32 queued = backend_driven ? opened ? audio_out.GetQueuedSize() : 0 : -1;
+
+			if (queued >= 0)
 			{
-				std::this_thread::sleep_for(1ms); // hack
-				continue;
+				const u64 queued_time = queued / frame_size * 1000000ull / 48000;
+
+				if (queued_time > latency)
+				{
+					audio_out.WaitForBuffer(queued_time - latency);
+					continue;
+				}
+			}
+			else
+			{
+				// precise time of sleeping: 5,(3) ms (or 256/48000 sec)
+				const u64 expected_time = g_audio.counter * AUDIO_SAMPLES * 1000000 / 48000;
+				if (expected_time >= time_pos)
+				{
+					wait_until_system_time(stamp0 + (expected_time - time_pos) + 1);
+					continue;
+				}
 			}
 			
 			//// crutch to hide giant lags caused by debugger
@@ -165,6 +371,9 @@ s32 cellAudioInit()
 
 			const u32 out_pos = g_audio.counter % BUFFER_NUM;
 
+			// recorded until the end of the iteration (mixing, output and event notification)
+			_log::timeline_scope scope("audio", "mix", g_audio.counter);
+
 			bool first_mix = true;
 
 			// mixing:
@@ -178,136 +387,14 @@ s32 cellAudioInit()
 
 				auto buf = vm::_ptr<f32>(buf_addr);
 
-				static const float k = 1.0f; // may be 1.0f
-				const float& m = port.level;
-
-				auto step_volume = [](AudioPortConfig& port) // part of cellAudioSetPortLevel functionality
-				{
-					const auto param = port.level_set.load();
-
-					if (param.inc != 0.0f)
-					{
-						port.level += param.inc;
-						const bool dec = param.inc < 0.0f;
-
-						if ((!dec && param.value - port.level <= 0.0f) || (dec && param.value - port.level >= 0.0f))
-						{
-							port.level = param.value;
-							port.level_set.compare_and_swap(param, { param.value, 0.0f });
-						}
-					}
-				};
-
-				if (port.channel == 2)
-				{
-					if (first_mix)
-					{
-						for (u32 i = 0; i < (sizeof(buf2ch) / sizeof(float)); i += 2)
-						{
-							step_volume(port);
-
-							// reverse byte order
-							const float left = buf[i + 0] * m;
-							const float right = buf[i + 1] * m;
-
-							buf2ch[i + 0] = left;
-							buf2ch[i + 1] = right;
-
-							buf8ch[i * 4 + 0] = left;
-							buf8ch[i * 4 + 1] = right;
-							buf8ch[i * 4 + 2] = 0.0f;
-							buf8ch[i * 4 + 3] = 0.0f;
-							buf8ch[i * 4 + 4] = 0.0f;
-							buf8ch[i * 4 + 5] = 0.0f;
-							buf8ch[i * 4 + 6] = 0.0f;
-							buf8ch[i * 4 + 7] = 0.0f;
-						}
-						first_mix = false;
-					}
-					else
-					{
-						for (u32 i = 0; i < (sizeof(buf2ch) / sizeof(float)); i += 2)
-						{
-							step_volume(port);
-
-							const float left = buf[i + 0] * m;
-							const float right = buf[i + 1] * m;
-
-							buf2ch[i + 0] += left;
-							buf2ch[i + 1] += right;
-
-							buf8ch[i * 4 + 0] += left;
-							buf8ch[i * 4 + 1] += right;
-						}
-					}
-				}
-				else if (port.channel == 8)
-				{
-					if (first_mix)
-					{
-						for (u32 i = 0; i < (sizeof(buf2ch) / sizeof(float)); i += 2)
-						{
-							step_volume(port);
-
-							const float left = buf[i * 4 + 0] * m;
-							const float right = buf[i * 4 + 1] * m;
-							const float center = buf[i * 4 + 2] * m;
-							const float low_freq = buf[i * 4 + 3] * m;
-							const float rear_left = buf[i * 4 + 4] * m;
-							const float rear_right = buf[i * 4 + 5] * m;
-							const float side_left = buf[i * 4 + 6] * m;
-							const float side_right = buf[i * 4 + 7] * m;
-
-							const float mid = (center + low_freq) * 0.708f;
-							buf2ch[i + 0] = (left + rear_left + side_left + mid) * k;
-							buf2ch[i + 1] = (right + rear_right + side_right + mid) * k;
-
-							buf8ch[i * 4 + 0] = left;
-							buf8ch[i * 4 + 1] = right;
-							buf8ch[i * 4 + 2] = center;
-							buf8ch[i * 4 + 3] = low_freq;
-							buf8ch[i * 4 + 4] = rear_left;
-							buf8ch[i * 4 + 5] = rear_right;
-							buf8ch[i * 4 + 6] = side_left;
-							buf8ch[i * 4 + 7] = side_right;
-						}
-						first_mix = false;
-					}
-					else
-					{
-						for (u32 i = 0; i < (sizeof(buf2ch) / sizeof(float)); i += 2)
-						{
-							step_volume(port);
-
-							const float left = buf[i * 4 + 0] * m;
-							const float right = buf[i * 4 + 1] * m;
-							const float center = buf[i * 4 + 2] * m;
-							const float low_freq = buf[i * 4 + 3] * m;
-							const float rear_left = buf[i * 4 + 4] * m;
-							const float rear_right = buf[i * 4 + 5] * m;
-							const float side_left = buf[i * 4 + 6] * m;
-							const float side_right = buf[i * 4 + 7] * m;
-
-							const float mid = (center + low_freq) * 0.708f;
-							buf2ch[i + 0] += (left + rear_left + side_left + mid) * k;
-							buf2ch[i + 1] += (right + rear_right + side_right + mid) * k;
-
-							buf8ch[i * 4 + 0] += left;
-							buf8ch[i * 4 + 1] += right;
-							buf8ch[i * 4 + 2] += center;
-							buf8ch[i * 4 + 3] += low_freq;
-							buf8ch[i * 4 + 4] += rear_left;
-							buf8ch[i * 4 + 5] += rear_right;
-							buf8ch[i * 4 + 6] += side_left;
-							buf8ch[i * 4 + 7] += side_right;
-						}
-					}
-				}
-				else
+				if (port.channel != 2 && port.channel != 8)
 				{
 					throw EXCEPTION("Unknown channel count (port=%lld, channel=%d)", &port - g_audio.ports, port.channel);
 				}
 
+				audio_mix_port(port, buf, buf2ch, buf8ch, first_mix);
+				first_mix = false;
+
 				memset(buf, 0, block_size * sizeof(float));
 			}
 
@@ -321,10 +408,7 @@ s32 cellAudioInit()
 				//}
 
 				// copy output data (8 ch)
-				for (u32 i = 0; i < (sizeof(buf8ch) / sizeof(float)); i++)
-				{
-					out_buffer[out_pos][i] = buf8ch[i];
-				}
+				std::memcpy(out_buffer[out_pos].get(), buf8ch, sizeof(buf8ch));
 			}
 
 			//const u64 stamp1 = get_system_time();
@@ -334,7 +418,11 @@ s32 cellAudioInit()
 				memset(out_buffer[out_pos].get(), 0, out_buffer_size * sizeof(float));
 			}
 
-			if (!out_queue.push(out_buffer[out_pos].get(), [](){ return g_audio.state != AUDIO_STATE_INITIALIZED; }))
+			if (backend_driven)
+			{
+				output(out_pos);
+			}
+			else if (!out_queue.push(out_pos, [](){ return g_audio.state != AUDIO_STATE_INITIALIZED; }))
 			{
 				break;
 			}
@@ -358,6 +446,8 @@ s32 cellAudioInit()
 					indexes[i] = (position + 1) % port.block; // write new value
 				}
 
+				g_audio.mixed.notify();
+
 				// send aftermix event (normal audio event)
 
 				LV2_LOCK;
@@ -401,6 +491,11 @@ s32 cellAudioInit()
 			//LOG_NOTICE(HLE, "Audio perf: start=%d (access=%d, AddData=%d, events=%d, dump=%d)",
 			//time_pos, stamp1 - stamp0, stamp2 - stamp1, stamp3 - stamp2, get_system_time() - stamp3);
 		}
+
+		if (backend_driven)
+		{
+			audio_out.Quit();
+		}
 	});
 
 	return CELL_OK;
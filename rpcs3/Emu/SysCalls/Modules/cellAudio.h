@@ -134,6 +134,7 @@ struct AudioConfig final // custom structure
 	u64 counter;
 	u64 start_time;
 	std::vector<u64> keys;
+	event_notifier_t mixed; // notified after each mixing iteration (port tags updated)
 
 	u32 open_port()
 	{
@@ -150,3 +151,19 @@ struct AudioConfig final // custom structure
 };
 
 extern AudioConfig g_audio;
+
+// load 4 big-endian floats
+inline __m128 load_be_ps(const be_t<f32>* src)
+{
+	return _mm_castsi128_ps(_mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src)), _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3)));
+}
+
+// store 4 floats as big-endian
+inline void store_be_ps(be_t<f32>* dst, __m128 value)
+{
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_shuffle_epi8(_mm_castps_si128(value), _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3)));
+}
+
+// Mix one block of the port (AUDIO_SAMPLES frames of big-endian floats, 2 or 8 channels) into the intermediate buffers,
+// applying the port level; `first` overwrites the buffers instead of accumulating. The buffers must be 16-byte aligned.
+void audio_mix_port(AudioPortConfig& port, const be_t<f32>* buf, float* buf2ch, float* buf8ch, bool first);
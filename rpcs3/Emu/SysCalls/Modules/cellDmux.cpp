@@ -227,6 +227,7 @@ bool ElementaryStream::release()
 	}
 
 	released++;
+	dmux->notifier.notify();
 	return true;
 }
 
@@ -327,6 +328,9 @@ void dmuxOpen(u32 dmux_id) // TODO: call from the constructor
 			{
 				break;
 			}
+
+			// taken before checking the ES space, so a release after the check wakes the wait
+			const u64 events = dmux.notifier.get();
 			
 			if (!dmux.job.try_peek(task) && dmux.is_running && stream.addr)
 			{
@@ -346,6 +350,7 @@ void dmuxOpen(u32 dmux_id) // TODO: call from the constructor
 					dmux.cbFunc(CPU, dmux.id, dmuxMsg, dmux.cbArg);
 
 					dmux.is_working = false;
+					dmux.notifier.notify();
 
 					stream = {};
 					
@@ -452,7 +457,7 @@ void dmuxOpen(u32 dmux_id) // TODO: call from the constructor
 						if (es.raw_data.size() > 1024 * 1024)
 						{
 							stream = backup;
-							std::this_thread::sleep_for(std::chrono::milliseconds(1)); // hack
+							dmux.notifier.wait(events);
 							continue;
 						}
 
@@ -548,7 +553,7 @@ void dmuxOpen(u32 dmux_id) // TODO: call from the constructor
 						if (es.isfull(old_size))
 						{
 							stream = backup;
-							std::this_thread::sleep_for(std::chrono::milliseconds(1)); // hack
+							dmux.notifier.wait(events);
 							continue;
 						}
 
@@ -642,6 +647,7 @@ void dmuxOpen(u32 dmux_id) // TODO: call from the constructor
 					stream = {};
 
 					dmux.is_working = false;
+					dmux.notifier.notify();
 				}
 
 				break;
@@ -712,11 +718,13 @@ void dmuxOpen(u32 dmux_id) // TODO: call from the constructor
 				if (old_size && (es.fidMajor & -0x10) == 0xe0)
 				{
 					// TODO (it's only for AVC, some ATX data may be lost)
-					while (es.isfull(old_size))
+					while (true)
 					{
-						if (Emu.IsStopped() || dmux.is_closed) break;
+						const u64 events = dmux.notifier.get();
+
+						if (!es.isfull(old_size) || Emu.IsStopped() || dmux.is_closed) break;
 
-						std::this_thread::sleep_for(std::chrono::milliseconds(1)); // hack
+						dmux.notifier.wait(events);
 					}
 
 					es.push_au(old_size, es.last_dts, es.last_pts, stream.userdata, false, 0);
@@ -760,6 +768,7 @@ void dmuxOpen(u32 dmux_id) // TODO: call from the constructor
 		}
 
 		dmux.is_finished = true;
+		dmux.notifier.notify();
 	};
 
 	dmux.dmuxCb->run();
@@ -860,8 +869,9 @@ s32 cellDmuxClose(u32 handle)
 
 	dmux->is_closed = true;
 	dmux->job.try_push(DemuxerTask(dmuxClose));
+	dmux->notifier.notify();
 
-	while (!dmux->is_finished)
+	for (u64 events = dmux->notifier.get(); !dmux->is_finished; events = dmux->notifier.get())
 	{
 		if (Emu.IsStopped())
 		{
@@ -869,7 +879,7 @@ s32 cellDmuxClose(u32 handle)
 			return CELL_OK;
 		}
 
-		std::this_thread::sleep_for(std::chrono::milliseconds(1)); // hack
+		dmux->notifier.wait(events);
 	}
 
 	idm::remove<PPUThread>(dmux->dmuxCb->get_id());
@@ -902,6 +912,7 @@ s32 cellDmuxSetStream(u32 handle, u32 streamAddress, u32 streamSize, b8 disconti
 	info.userdata = userData;
 
 	dmux->job.push(task, &dmux->is_closed);
+	dmux->notifier.notify();
 	return CELL_OK;
 }
 
@@ -917,6 +928,7 @@ s32 cellDmuxResetStream(u32 handle)
 	}
 
 	dmux->job.push(DemuxerTask(dmuxResetStream), &dmux->is_closed);
+	dmux->notifier.notify();
 	return CELL_OK;
 }
 
@@ -939,15 +951,17 @@ s32 cellDmuxResetStreamAndWaitDone(u32 handle)
 	dmux->is_working = true;
 
 	dmux->job.push(DemuxerTask(dmuxResetStreamAndWaitDone), &dmux->is_closed);
+	dmux->notifier.notify();
 
-	while (dmux->is_running && dmux->is_working && !dmux->is_closed) // TODO: ensure that it is safe
+	for (u64 events = dmux->notifier.get(); dmux->is_running && dmux->is_working && !dmux->is_closed; events = dmux->notifier.get()) // TODO: ensure that it is safe
 	{
 		if (Emu.IsStopped())
 		{
 			cellDmux.warning("cellDmuxResetStreamAndWaitDone(%d) aborted", handle);
 			return CELL_OK;
 		}
-		std::this_thread::sleep_for(std::chrono::milliseconds(1)); // hack
+
+		dmux->notifier.wait(events);
 	}
 
 	return CELL_OK;
@@ -1008,6 +1022,7 @@ s32 cellDmuxEnableEs(u32 handle, vm::cptr<CellCodecEsFilterId> esFilterId, vm::c
 	task.es.es_ptr = es.get();
 
 	dmux->job.push(task, &dmux->is_closed);
+	dmux->notifier.notify();
 	return CELL_OK;
 }
 
@@ -1027,6 +1042,7 @@ s32 cellDmuxDisableEs(u32 esHandle)
 	task.es.es_ptr = es.get();
 
 	es->dmux->job.push(task, &es->dmux->is_closed);
+	es->dmux->notifier.notify();
 	return CELL_OK;
 }
 
@@ -1046,6 +1062,7 @@ s32 cellDmuxResetEs(u32 esHandle)
 	task.es.es_ptr = es.get();
 
 	es->dmux->job.push(task, &es->dmux->is_closed);
+	es->dmux->notifier.notify();
 	return CELL_OK;
 }
 
@@ -1175,6 +1192,7 @@ s32 cellDmuxFlushEs(u32 esHandle)
 	task.es.es_ptr = es.get();
 
 	es->dmux->job.push(task, &es->dmux->is_closed);
+	es->dmux->notifier.notify();
 	return CELL_OK;
 }
 
@@ -408,6 +408,9 @@ public:
 	std::atomic<bool> is_running;
 	std::atomic<bool> is_working;
 
+	// notified when an AU is released, a job is pushed or the demuxer thread stops working or finishes
+	event_notifier_t notifier;
+
 	std::shared_ptr<PPUThread> dmuxCb;
 
 	Demuxer(u32 addr, u32 size, vm::ptr<CellDmuxCbMsg> func, u32 arg)
@@ -8,6 +8,120 @@
 
 extern Module<> cellFont;
 
+namespace
+{
+	// Rasterized glyphs, shared by all fonts (key: font data, scale, code point); least recently used glyphs are evicted
+	// when the total size exceeds the budget. Entries of a font are removed when its data is freed.
+	class glyph_cache_t
+	{
+	public:
+		struct glyph_t
+		{
+			std::vector<u8> bitmap;
+			s32 width, height, xoff, yoff;
+		};
+
+	private:
+		struct key_t
+		{
+			const u8* data;
+			u32 scale; // bit pattern of the float scale
+			u32 code;
+
+			bool operator ==(const key_t& rhs) const
+			{
+				return data == rhs.data && scale == rhs.scale && code == rhs.code;
+			}
+		};
+
+		struct key_hash_t
+		{
+			std::size_t operator()(const key_t& key) const
+			{
+				return std::hash<const u8*>()(key.data) ^ (std::size_t)key.scale * 0x9e3779b1 ^ (std::size_t)key.code << 16;
+			}
+		};
+
+		using list_t = std::list<std::pair<key_t, std::shared_ptr<const glyph_t>>>;
+
+		static const std::size_t budget = 4 * 1024 * 1024;
+
+		std::mutex m_mutex;
+		list_t m_list; // most recently used first
+		std::unordered_map<key_t, list_t::iterator, key_hash_t> m_map;
+		std::size_t m_size = 0;
+
+	public:
+		std::shared_ptr<const glyph_t> get(stbtt_fontinfo* font, float scale, u32 code)
+		{
+			const key_t key{ font->data, reinterpret_cast<const u32&>(scale), code };
+
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+
+				const auto found = m_map.find(key);
+
+				if (found != m_map.end())
+				{
+					m_list.splice(m_list.begin(), m_list, found->second);
+					return found->second->second;
+				}
+			}
+
+			auto glyph = std::make_shared<glyph_t>();
+
+			unsigned char* box = stbtt_GetCodepointBitmap(font, scale, scale, code, &glyph->width, &glyph->height, &glyph->xoff, &glyph->yoff);
+
+			if (!box)
+			{
+				return nullptr;
+			}
+
+			glyph->bitmap.assign(box, box + glyph->width * glyph->height);
+			stbtt_FreeBitmap(box, 0);
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			if (m_map.count(key) == 0)
+			{
+				m_list.emplace_front(key, glyph);
+				m_map.emplace(key, m_list.begin());
+				m_size += glyph->bitmap.size();
+
+				while (m_size > budget && m_list.size() > 1)
+				{
+					m_size -= m_list.back().second->bitmap.size();
+					m_map.erase(m_list.back().first);
+					m_list.pop_back();
+				}
+			}
+
+			return glyph;
+		}
+
+		void remove(const u8* data)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			for (auto it = m_list.begin(); it != m_list.end();)
+			{
+				if (it->first.data == data)
+				{
+					m_size -= it->second->bitmap.size();
+					m_map.erase(it->first);
+					it = m_list.erase(it);
+				}
+				else
+				{
+					it++;
+				}
+			}
+		}
+	};
+
+	glyph_cache_t g_glyph_cache;
+}
+
 // Functions
 s32 cellFontInitializeWithRevision(u64 revisionFlags, vm::ptr<CellFontConfig> config)
 {
@@ -305,12 +419,11 @@ s32 cellFontRenderCharGlyphImage(vm::ptr<CellFont> font, u32 code, vm::ptr<CellF
 		return CELL_FONT_ERROR_RENDERER_UNBIND;
 	}
 
-	// Render the character
-	s32 width, height, xoff, yoff;
+	// Render the character (or get it from the cache)
 	float scale = stbtt_ScaleForPixelHeight(font->stbfont, font->scale_y);
-	unsigned char* box = stbtt_GetCodepointBitmap(font->stbfont, scale, scale, code, &width, &height, &xoff, &yoff);
+	const auto glyph = g_glyph_cache.get(font->stbfont, scale, code);
 
-	if (!box)
+	if (!glyph)
 	{
 		return CELL_OK;
 	}
@@ -321,23 +434,25 @@ s32 cellFontRenderCharGlyphImage(vm::ptr<CellFont> font, u32 code, vm::ptr<CellF
 	stbtt_GetFontVMetrics(font->stbfont, &ascent, &descent, &lineGap);
 	baseLineY = (int)((float)ascent * scale); // ???
 
-	// Move the rendered character to the surface
-	unsigned char* buffer = vm::_ptr<unsigned char>(surface->buffer.addr());
-	for (u32 ypos = 0; ypos < (u32)height; ypos++)
-	{
-		if ((u32)y + ypos + yoff + baseLineY >= surface->height)
-			break;
+	// Move the rendered character to the surface (clipped, one row at a time)
+	// TODO: There are some oddities in the position of the character in the final buffer
+	const s32 surface_width = surface->width;
+	const s32 surface_height = surface->height;
+	const s32 dst_x = (s32)x;
+	const s32 dst_y = (s32)y + glyph->yoff + baseLineY;
 
-		for (u32 xpos = 0; xpos < (u32)width; xpos++)
-		{
-			if ((u32)x + xpos >= surface->width)
-				break;
+	const s32 x_begin = std::max(0, -dst_x);
+	const s32 x_end = std::min(glyph->width, surface_width - dst_x);
+	const s32 y_begin = std::max(0, -dst_y);
+	const s32 y_end = std::min(glyph->height, surface_height - dst_y);
 
-			// TODO: There are some oddities in the position of the character in the final buffer
-			buffer[((s32)y + ypos + yoff + baseLineY)*surface->width + (s32)x + xpos] = box[ypos * width + xpos];
-		}
+	unsigned char* buffer = vm::_ptr<unsigned char>(surface->buffer.addr());
+
+	for (s32 ypos = y_begin; ypos < y_end && x_begin < x_end; ypos++)
+	{
+		std::memcpy(buffer + (dst_y + ypos) * surface_width + dst_x + x_begin, glyph->bitmap.data() + ypos * glyph->width + x_begin, x_end - x_begin);
 	}
-	stbtt_FreeBitmap(box, 0);
+
 	return CELL_OK;
 }
 
@@ -386,6 +501,7 @@ s32 cellFontCloseFont(vm::ptr<CellFont> font)
 		font->origin == CELL_FONT_OPEN_FONT_FILE ||
 		font->origin == CELL_FONT_OPEN_MEMORY)
 	{
+		g_glyph_cache.remove(font->stbfont->data);
 		vm::dealloc(font->fontdata_addr, vm::main);
 	}
 
@@ -1,9 +1,11 @@
 #include "stdafx.h"
 #include "Emu/Memory/Memory.h"
 #include "Emu/System.h"
+#include "Emu/state.h"
 #include "Emu/IdManager.h"
 #include "Emu/SysCalls/Modules.h"
 #include "Emu/SysCalls/Callback.h"
+#include "Emu/SysCalls/HLEWorkerPool.h"
 
 #include "Emu/FS/VFS.h"
 #include "Emu/FS/vfsFile.h"
@@ -261,15 +263,7 @@ s32 cellFsReadWithOffset(u32 fd, u64 offset, vm::ptr<void> buf, u64 buffer_size,
 		return CELL_FS_EBADF;
 	}
 
-	std::lock_guard<std::mutex> lock(file->mutex);
-
-	const auto old_position = file->file->Tell();
-
-	CHECK_ASSERTION(file->file->Seek(offset) != -1);
-
-	const auto read = file->file->Read(buf.get_ptr(), buffer_size);
-
-	CHECK_ASSERTION(file->file->Seek(old_position) != -1);
+	const auto read = file->read_at(offset, buf.get_ptr(), buffer_size);
 
 	if (nread)
 	{
@@ -465,6 +459,74 @@ s32 cellFsStReadGetRegid(u32 fd, vm::ptr<u64> regid)
 	return CELL_OK;
 }
 
+// Host-side read-ahead for streaming: a separate thread reads blocks ahead of the ring buffer (up to the window size),
+// so the ring buffer is filled from memory and disk latency spikes don't stall the stream
+struct fs_st_readahead_t
+{
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::deque<std::vector<u8>> blocks; // data read but not yet copied to the ring buffer
+	u64 buffered = 0;
+	bool eof = false;
+	bool stop = false;
+
+	void read(const std::shared_ptr<lv2_file_t>& file, u64 pos, u64 end, u64 block_size, u64 window)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+
+		while (!stop && pos < end && !Emu.IsStopped())
+		{
+			if (buffered + block_size > window)
+			{
+				cv.wait_for(lock, std::chrono::milliseconds(1));
+				continue;
+			}
+
+			lock.unlock();
+
+			std::vector<u8> block(std::min<u64>(block_size, end - pos));
+
+			const u64 res = file->read_at(pos, block.data(), block.size());
+
+			lock.lock();
+
+			if (res == 0 || res == -1)
+			{
+				break;
+			}
+
+			block.resize(res);
+			blocks.emplace_back(std::move(block));
+			buffered += res;
+			pos += res;
+			cv.notify_all();
+		}
+
+		eof = true;
+		cv.notify_all();
+	}
+
+	// Copy the next block to the destination and return its size (0 if nothing is available yet)
+	u64 pop(void* dst)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if (blocks.empty())
+		{
+			return 0;
+		}
+
+		const auto block = std::move(blocks.front());
+		blocks.pop_front();
+		buffered -= block.size();
+		cv.notify_all();
+
+		std::memcpy(dst, block.data(), block.size());
+
+		return block.size();
+	}
+};
+
 s32 cellFsStReadStart(u32 fd, u64 offset, u64 size)
 {
 	cellFs.warning("cellFsStReadStart(fd=%d, offset=0x%llx, size=0x%llx)", fd, offset, size);
@@ -494,6 +556,27 @@ s32 cellFsStReadStart(u32 fd, u64 offset, u64 size)
 
 	file->st_read_size = size;
 
+	// the whole range is going to be read by the stream thread
+	file->file->Prefetch(offset, size);
+
+	// at least two blocks are buffered (double buffering), disabled if zero
+	const u64 window = rpcs3::config.system.stream_readahead.value() * 1024ull;
+
+	std::shared_ptr<fs_st_readahead_t> readahead;
+	std::shared_ptr<thread_ctrl> reader;
+
+	if (window)
+	{
+		readahead = std::make_shared<fs_st_readahead_t>();
+
+		const u64 block_size = file->st_block_size;
+
+		reader = thread_ctrl::spawn(PURE_EXPR("FS ST Read-ahead Thread"s), [=]()
+		{
+			readahead->read(file, offset, offset + size, block_size, std::max<u64>(window, block_size * 2));
+		});
+	}
+
 	file->st_thread = thread_ctrl::spawn(PURE_EXPR("FS ST Thread"s), [=]()
 	{
 		std::unique_lock<std::mutex> lock(file->mutex);
@@ -506,15 +589,26 @@ s32 cellFsStReadStart(u32 fd, u64 offset, u64 size)
 				// get buffer position
 				const u32 position = VM_CAST(file->st_buffer + file->st_total_read % file->st_ringbuf_size);
 
-				// read data
-				auto old = file->file->Tell();
-				CHECK_ASSERTION(file->file->Seek(offset + file->st_total_read) != -1);
-				auto res = file->file->Read(vm::base(position), file->st_block_size);
-				CHECK_ASSERTION(file->file->Seek(old) != -1);
+				// read data (from the read-ahead buffer, or directly without the lock, so other readers of this file aren't blocked)
+				u64 res;
+
+				if (readahead)
+				{
+					res = readahead->pop(vm::base(position));
+				}
+				else
+				{
+					lock.unlock();
+					res = file->read_at(offset + file->st_total_read, vm::base(position), file->st_block_size);
+					lock.lock();
+				}
 
 				// notify
-				file->st_total_read += res;
-				file->cv.notify_one();
+				if (res && res != -1)
+				{
+					file->st_total_read += res;
+					file->cv.notify_one();
+				}
 			}
 
 			// check callback condition if set
@@ -536,6 +630,21 @@ s32 cellFsStReadStart(u32 fd, u64 offset, u64 size)
 			file->cv.wait_for(lock, std::chrono::milliseconds(1));
 		}
 
+		if (reader)
+		{
+			{
+				std::lock_guard<std::mutex> ra_lock(readahead->mutex);
+
+				readahead->stop = true;
+			}
+
+			readahead->cv.notify_all();
+
+			lock.unlock();
+			reader->join();
+			lock.lock();
+		}
+
 		file->st_status.compare_and_swap(SSS_STOPPED, SSS_INITIALIZED);
 		file->st_read_size = 0;
 		file->st_total_read = 0;
@@ -874,7 +983,37 @@ s32 cellFsSdataOpenByFd(u32 mself_fd, s32 flags, vm::ptr<u32> sdata_fd, u64 offs
 
 using fs_aio_cb_t = vm::ptr<void(vm::ptr<CellFsAio> xaio, s32 error, s32 xid, u64 size)>;
 
-void fsAio(vm::ptr<CellFsAio> aio, bool write, s32 xid, fs_aio_cb_t func)
+extern u64 get_system_time();
+
+struct fs_aio_request_t
+{
+	vm::ptr<CellFsAio> aio;
+	bool write;
+	s32 xid;
+	fs_aio_cb_t func;
+	u64 stamp; // submission time
+};
+
+// AIO submission queue: requests are executed in order by a single task of the HLE worker pool,
+// which takes all pending requests at once (one pool task per batch instead of one per request)
+struct fs_aio_queue_t
+{
+	std::mutex mutex;
+	std::deque<fs_aio_request_t> requests;
+	bool scheduled = false; // a task processing the queue is pushed to the pool
+
+	// statistics
+	u32 max_depth = 0;
+	u64 count = 0;
+	u64 bytes = 0;
+	u64 total_latency = 0; // from submission to completion (microseconds)
+	u64 busy_time = 0; // time spent executing requests (microseconds)
+};
+
+// AIO requests are processed in order by a worker of the HLE pool
+const s32 fs_aio_priority = 1000;
+
+u64 fsAio(vm::ptr<CellFsAio> aio, bool write, s32 xid, fs_aio_cb_t func)
 {
 	cellFs.notice("FS AIO Request(%d): fd=%d, offset=0x%llx, buf=*0x%x, size=0x%llx, user_data=0x%llx", xid, aio->fd, aio->offset, aio->buf, aio->size, aio->user_data);
 
@@ -887,6 +1026,10 @@ void fsAio(vm::ptr<CellFsAio> aio, bool write, s32 xid, fs_aio_cb_t func)
 	{
 		error = CELL_FS_EBADF;
 	}
+	else if (!write)
+	{
+		result = file->read_at(aio->offset, aio->buf.get_ptr(), aio->size);
+	}
 	else
 	{
 		std::lock_guard<std::mutex> lock(file->mutex);
@@ -895,7 +1038,7 @@ void fsAio(vm::ptr<CellFsAio> aio, bool write, s32 xid, fs_aio_cb_t func)
 
 		CHECK_ASSERTION(file->file->Seek(aio->offset) != -1);
 
-		result = write ? file->file->Write(aio->buf.get_ptr(), aio->size) : file->file->Read(aio->buf.get_ptr(), aio->size);
+		result = file->file->Write(aio->buf.get_ptr(), aio->size);
 
 		CHECK_ASSERTION(file->file->Seek(old_position) != -1);
 	}
@@ -905,6 +1048,59 @@ void fsAio(vm::ptr<CellFsAio> aio, bool write, s32 xid, fs_aio_cb_t func)
 	{
 		func(ppu, aio, error, xid, result);
 	});
+
+	return result;
+}
+
+void fsAioProcess(std::shared_ptr<fs_aio_queue_t> queue)
+{
+	std::unique_lock<std::mutex> lock(queue->mutex);
+
+	while (queue->requests.size())
+	{
+		std::deque<fs_aio_request_t> batch;
+		batch.swap(queue->requests);
+
+		lock.unlock();
+
+		u64 bytes = 0, latency = 0;
+
+		const u64 start = get_system_time();
+
+		for (const auto& req : batch)
+		{
+			bytes += fsAio(req.aio, req.write, req.xid, req.func);
+			latency += get_system_time() - req.stamp;
+		}
+
+		const u64 busy = get_system_time() - start;
+
+		lock.lock();
+
+		queue->count += batch.size();
+		queue->bytes += bytes;
+		queue->total_latency += latency;
+		queue->busy_time += busy;
+	}
+
+	queue->scheduled = false;
+}
+
+void fsAioSubmit(vm::ptr<CellFsAio> aio, bool write, s32 xid, fs_aio_cb_t func)
+{
+	const auto queue = fxm::get_always<fs_aio_queue_t>();
+
+	std::lock_guard<std::mutex> lock(queue->mutex);
+
+	queue->requests.emplace_back(fs_aio_request_t{ aio, write, xid, func, get_system_time() });
+	queue->max_depth = std::max<u32>(queue->max_depth, static_cast<u32>(queue->requests.size()));
+
+	if (!queue->scheduled)
+	{
+		queue->scheduled = true;
+
+		fxm::get_always<hle_worker_pool_t>()->push("FS AIO", fs_aio_priority, COPY_EXPR(fsAioProcess(queue)));
+	}
 }
 
 s32 cellFsAioInit(vm::cptr<char> mount_point)
@@ -924,6 +1120,17 @@ s32 cellFsAioFinish(vm::cptr<char> mount_point)
 
 	// TODO: delete existing AIO thread for specified mount point
 
+	if (const auto queue = fxm::get<fs_aio_queue_t>())
+	{
+		std::lock_guard<std::mutex> lock(queue->mutex);
+
+		if (queue->count)
+		{
+			cellFs.notice("FS AIO statistics: %lld requests, %lld bytes, max queue depth %d, average latency %lld us, throughput %lld KB/s",
+				queue->count, queue->bytes, queue->max_depth, queue->total_latency / queue->count, queue->busy_time ? queue->bytes * 1000000 / 1024 / queue->busy_time : 0);
+		}
+	}
+
 	return CELL_OK;
 }
 
@@ -937,7 +1144,7 @@ s32 cellFsAioRead(vm::ptr<CellFsAio> aio, vm::ptr<s32> id, fs_aio_cb_t func)
 
 	const s32 xid = (*id = ++g_fs_aio_id);
 
-	thread_ctrl::spawn(PURE_EXPR("FS AIO Read Thread"s), COPY_EXPR(fsAio(aio, false, xid, func)));
+	fsAioSubmit(aio, false, xid, func);
 
 	return CELL_OK;
 }
@@ -950,7 +1157,7 @@ s32 cellFsAioWrite(vm::ptr<CellFsAio> aio, vm::ptr<s32> id, fs_aio_cb_t func)
 
 	const s32 xid = (*id = ++g_fs_aio_id);
 
-	thread_ctrl::spawn(PURE_EXPR("FS AIO Write Thread"s), COPY_EXPR(fsAio(aio, true, xid, func)));
+	fsAioSubmit(aio, true, xid, func);
 
 	return CELL_OK;
 }
@@ -259,6 +259,7 @@ s32 cellGcmBindTile(u8 index)
 
 	auto& tile = Emu.GetGSManager().GetRender().tiles[index];
 	tile.binded = true;
+	Emu.GetGSManager().GetRender().tiles_version++;
 
 	return CELL_OK;
 }
@@ -496,31 +497,14 @@ s32 cellGcmSetPrepareFlip(PPUThread& ppu, vm::ptr<CellGcmContextData> ctxt, u32
 		return CELL_GCM_ERROR_FAILURE;
 	}
 
-	if (ctxt->current + 2 >= ctxt->end)
-	{
-		if (s32 res = ctxt->callback(ppu, ctxt, 8 /* ??? */))
-		{
-			cellGcmSys.error("cellGcmSetPrepareFlip: callback failed (0x%08x)", res);
-			return res;
-		}
-	}
-#if 1
-	*ctxt->current++ = (GCM_FLIP_COMMAND << 2) | (1 << 18);
-	*ctxt->current++ = id;
+	gcm_command_writer writer(ppu, ctxt);
+	writer.method(GCM_FLIP_COMMAND, id);
 
-	if (ctxt.addr() == gcm_info.context_addr)
+	if (s32 res = writer.flush())
 	{
-		vm::_ref<CellGcmControl>(gcm_info.control_addr).put += 2 * sizeof(u32);
+		cellGcmSys.error("cellGcmSetPrepareFlip: callback failed (0x%08x)", res);
+		return res;
 	}
-#else
-	// internal compiler error, try to avoid it for now
-	u32 command_size = rsx::make_command(ctxt->current, GCM_FLIP_COMMAND, id);
-
-	if (ctxt.addr() == gcm_info.context_addr)
-	{
-		vm::_ref<CellGcmControl>(gcm_info.control_addr).put += command_size * sizeof(u32);
-	}
-#endif
 
 	return id;
 }
@@ -593,6 +577,7 @@ s32 cellGcmSetTileInfo(u8 index, u8 location, u32 offset, u32 size, u32 pitch, u
 	tile.bank = bank;
 
 	vm::_ptr<CellGcmTileInfo>(Emu.GetGSManager().GetRender().tiles_addr)[index] = tile.pack();
+	Emu.GetGSManager().GetRender().tiles_version++;
 	return CELL_OK;
 }
 
@@ -669,6 +654,7 @@ s32 cellGcmUnbindTile(u8 index)
 
 	auto& tile = Emu.GetGSManager().GetRender().tiles[index];
 	tile.binded = false;
+	Emu.GetGSManager().GetRender().tiles_version++;
 
 	return CELL_OK;
 }
@@ -1184,6 +1170,7 @@ s32 cellGcmSetTile(u8 index, u8 location, u32 offset, u32 size, u32 pitch, u8 co
 	tile.bank = bank;
 
 	vm::_ptr<CellGcmTileInfo>(Emu.GetGSManager().GetRender().tiles_addr)[index] = tile.pack();
+	Emu.GetGSManager().GetRender().tiles_version++;
 	return CELL_OK;
 }
 
@@ -1269,6 +1256,35 @@ static bool isInCommandBufferExcept(u32 getPos, u32 bufferBegin, u32 bufferEnd)
 	return true;
 }
 
+s32 gcm_command_writer::flush()
+{
+	if (!m_size)
+	{
+		return CELL_OK;
+	}
+
+	if (m_ctxt->current + m_size >= m_ctxt->end)
+	{
+		if (s32 res = m_ctxt->callback(m_ppu, m_ctxt, m_size))
+		{
+			return res;
+		}
+	}
+
+	native_to_be(vm::_ptr<be_t<u32>>(m_ctxt->current.addr()), m_data.data(), m_size);
+
+	m_ctxt->current = m_ctxt->current + m_size;
+
+	if (m_ctxt.addr() == gcm_info.context_addr)
+	{
+		vm::_ref<CellGcmControl>(gcm_info.control_addr).put += m_size * sizeof(u32);
+		Emu.GetGSManager().GetRender().fifo_wakeup();
+	}
+
+	m_size = 0;
+	return CELL_OK;
+}
+
 // TODO: Avoid using syscall 1023 for calling this function
 s32 cellGcmCallback(vm::ptr<CellGcmContextData> context, u32 count)
 {
@@ -1278,6 +1294,7 @@ s32 cellGcmCallback(vm::ptr<CellGcmContextData> context, u32 count)
 	const std::chrono::time_point<std::chrono::system_clock> enterWait = std::chrono::system_clock::now();
 	// Flush command buffer (ie allow RSX to read up to context->current)
 	ctrl.put.exchange(getOffsetFromAddress(context->current.addr()));
+	Emu.GetGSManager().GetRender().fifo_wakeup();
 
 	std::pair<u32, u32> newCommandBuffer = getNextCommandBufferBeginEnd(context->current.addr());
 	u32 offset = getOffsetFromAddress(newCommandBuffer.first);
@@ -1351,9 +1368,9 @@ Module<> cellGcmSys("cellGcmSys", []()
 	REG_FUNC(cellGcmSys, cellGcmResetFlipStatus);
 	REG_FUNC(cellGcmSys, cellGcmSetDebugOutputLevel);
 	REG_FUNC(cellGcmSys, cellGcmSetDisplayBuffer);
-	REG_FUNC(cellGcmSys, cellGcmSetFlip); //
+	REG_FUNC(cellGcmSys, cellGcmSetFlip, MFF_DIRECT_CALL); //
 	REG_FUNC(cellGcmSys, cellGcmSetFlipHandler);
-	REG_FUNC(cellGcmSys, cellGcmSetFlipImmediate);
+	REG_FUNC(cellGcmSys, cellGcmSetFlipImmediate, MFF_DIRECT_CALL);
 	REG_FUNC(cellGcmSys, cellGcmSetFlipMode);
 	REG_FUNC(cellGcmSys, cellGcmSetFlipStatus);
 	REG_FUNC(cellGcmSys, cellGcmSetGraphicsHandler);
@@ -1406,8 +1423,8 @@ Module<> cellGcmSys("cellGcmSys", []()
 	REG_FUNC(cellGcmSys, cellGcmSetDefaultCommandBufferAndSegmentWordSize);
 
 	// Other
-	REG_FUNC(cellGcmSys, _cellGcmSetFlipCommand);
-	REG_FUNC(cellGcmSys, _cellGcmSetFlipCommandWithWaitLabel);
+	REG_FUNC(cellGcmSys, _cellGcmSetFlipCommand, MFF_DIRECT_CALL);
+	REG_FUNC(cellGcmSys, _cellGcmSetFlipCommandWithWaitLabel, MFF_DIRECT_CALL);
 	REG_FUNC(cellGcmSys, cellGcmSetTile);
 	REG_FUNC(cellGcmSys, _cellGcmFunc2);
 	REG_FUNC(cellGcmSys, _cellGcmFunc3);
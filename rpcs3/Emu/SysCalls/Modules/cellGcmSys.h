@@ -4,6 +4,8 @@ namespace vm { using namespace ps3; }
 
 #include "Emu/RSX/GCM.h"
 
+class PPUThread;
+
 enum
 {
 	CELL_GCM_ERROR_FAILURE           = 0x802100ff,
@@ -25,3 +27,38 @@ s32 gcmMapEaIoAddress(u32 ea, u32 io, u32 size, bool is_strict);
 
 // Syscall
 s32 cellGcmCallback(vm::ptr<CellGcmContextData> context, u32 count);
+
+// Host side writer of RSX commands for HLE functions.
+// Commands are gathered in host byte order, then flush() reserves space in the command buffer once (calling its callback if needed),
+// stores the words byte swapped in one go and, for the default context, publishes put once and wakes up the RSX thread.
+class gcm_command_writer
+{
+	PPUThread& m_ppu;
+	const vm::ptr<CellGcmContextData> m_ctxt;
+	std::array<u32, 64> m_data;
+	u32 m_size = 0;
+
+public:
+	gcm_command_writer(PPUThread& ppu, vm::ptr<CellGcmContextData> ctxt)
+		: m_ppu(ppu)
+		, m_ctxt(ctxt)
+	{
+	}
+
+	template<typename... T>
+	void method(u32 start_register, T... values)
+	{
+		const auto command = rsx::make_command(start_register, values...);
+
+		if (m_size + command.size() > m_data.size())
+		{
+			throw EXCEPTION("Too many commands (size=%d)", m_size + command.size());
+		}
+
+		std::memcpy(m_data.data() + m_size, command.data(), sizeof(command));
+		m_size += static_cast<u32>(command.size());
+	}
+
+	// Returns CELL_OK or the error returned by the context callback
+	s32 flush();
+};
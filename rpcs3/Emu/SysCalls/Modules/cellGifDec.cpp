@@ -13,6 +13,7 @@ extern "C"
 #include "Emu/FS/vfsFileBase.h"
 #include "Emu/SysCalls/lv2/sys_fs.h"
 
+#include "cellPngDec.h"
 #include "cellGifDec.h"
 
 extern Module<> cellGifDec;
@@ -176,20 +177,23 @@ s32 cellGifDecDecodeData(PMainHandle mainHandle, PSubHandle subHandle, vm::ptr<u
 	const u64& fileSize = subHandle->fileSize;
 	const CellGifDecOutParam& current_outParam = subHandle->outParam; 
 
-	//Copy the GIF file to a buffer
-	std::unique_ptr<u8[]> gif(new u8[fileSize]);
+	// Decode directly from guest memory, files still have to be read into a host buffer
+	std::unique_ptr<u8[]> gif;
+	const u8* gif_data = nullptr;
 
 	switch (subHandle->src.srcSelect)
 	{
 	case CELL_GIFDEC_BUFFER:
-		std::memcpy(gif.get(), subHandle->src.streamPtr.get_ptr(), fileSize);
+		gif_data = static_cast<const u8*>(subHandle->src.streamPtr.get_ptr());
 		break;
 
 	case CELL_GIFDEC_FILE:
 	{
+		gif.reset(new u8[fileSize]);
 		auto file = idm::get<lv2_file_t>(fd);
 		file->file->Seek(0);
 		file->file->Read(gif.get(), fileSize);
+		gif_data = gif.get();
 		break;
 	}
 	}
@@ -198,77 +202,24 @@ s32 cellGifDecDecodeData(PMainHandle mainHandle, PSubHandle subHandle, vm::ptr<u
 	int width, height, actual_components;
 	auto image = std::unique_ptr<unsigned char,decltype(&::free)>
 		(
-			stbi_load_from_memory(gif.get(), (s32)fileSize, &width, &height, &actual_components, 4),
+			stbi_load_from_memory(gif_data, (s32)fileSize, &width, &height, &actual_components, 4),
 			&::free
 		);
 
 	if (!image)
 		return CELL_GIFDEC_ERROR_STREAM_FORMAT;
 
-	const int bytesPerLine = (u32)dataCtrlParam->outputBytesPerLine;
-	const char nComponents = 4;
-	uint image_size = width * height * nComponents;
+	const u32 bytesPerLine = dataCtrlParam->outputBytesPerLine;
 
 	switch((u32)current_outParam.outputColorSpace)
 	{
 	case CELL_GIFDEC_RGBA:
-	{
-		if (bytesPerLine > width * nComponents) // Check if we need padding
-		{
-			const int linesize = std::min(bytesPerLine, width * nComponents);
-			for (int i = 0; i < height; i++)
-			{
-				const int dstOffset = i * bytesPerLine;
-				const int srcOffset = width * nComponents * i;
-				memcpy(&data[dstOffset], &image.get()[srcOffset], linesize);
-			}
-		}
-		else
-		{
-			memcpy(data.get_ptr(), image.get(), image_size);
-		}
-	}
-	break;
+		image_dec_write(image.get(), width, height, data.get_ptr(), bytesPerLine, image_dec_format::rgba, false);
+		break;
 
 	case CELL_GIFDEC_ARGB:
-	{
-		if (bytesPerLine > width * nComponents) // Check if we need padding
-		{
-			//TODO: find out if we can't do padding without an extra copy
-			const int linesize = std::min(bytesPerLine, width * nComponents);
-			char *output = (char *) malloc(linesize);
-			for (int i = 0; i < height; i++)
-			{
-				const int dstOffset = i * bytesPerLine;
-				const int srcOffset = width * nComponents * i;
-				for (int j = 0; j < linesize; j += nComponents)
-				{
-					output[j + 0] = image.get()[srcOffset + j + 3];
-					output[j + 1] = image.get()[srcOffset + j + 0];
-					output[j + 2] = image.get()[srcOffset + j + 1];
-					output[j + 3] = image.get()[srcOffset + j + 2];
-				}
-				memcpy(&data[dstOffset], output, linesize);
-			}
-			free(output);
-		}
-		else
-		{
-			uint* img = (uint*)new char[image_size];
-			uint* source_current = (uint*)&(image.get()[0]);
-			uint* dest_current = img;
-			for (uint i = 0; i < image_size / nComponents; i++) 
-			{
-				uint val = *source_current;
-				*dest_current = (val >> 24) | (val << 8); // set alpha (A8) as leftmost byte
-				source_current++;
-				dest_current++;
-			}
-			memcpy(data.get_ptr(), img, image_size); 
-			delete[] img;
-		}
-	}
-	break;
+		image_dec_write(image.get(), width, height, data.get_ptr(), bytesPerLine, image_dec_format::argb, false);
+		break;
 
 	default:
 		return CELL_GIFDEC_ERROR_ARG;
@@ -13,6 +13,7 @@ extern "C"
 #include "Emu/FS/vfsFileBase.h"
 #include "Emu/SysCalls/lv2/sys_fs.h"
 
+#include "cellPngDec.h"
 #include "cellJpgDec.h"
 
 extern Module<> cellJpgDec;
@@ -184,20 +185,23 @@ s32 cellJpgDecDecodeData(u32 mainHandle, u32 subHandle, vm::ptr<u8> data, vm::cp
 	const u64& fileSize = subHandle_data->fileSize;
 	const CellJpgDecOutParam& current_outParam = subHandle_data->outParam; 
 
-	//Copy the JPG file to a buffer
-	std::unique_ptr<u8[]> jpg(new u8[fileSize]);
+	// Decode directly from guest memory, files still have to be read into a host buffer
+	std::unique_ptr<u8[]> jpg;
+	const u8* jpg_data = nullptr;
 
 	switch (subHandle_data->src.srcSelect)
 	{
 	case CELL_JPGDEC_BUFFER:
-		std::memcpy(jpg.get(), vm::base(subHandle_data->src.streamPtr), fileSize);
+		jpg_data = static_cast<const u8*>(vm::base(subHandle_data->src.streamPtr));
 		break;
 
 	case CELL_JPGDEC_FILE:
 	{
+		jpg.reset(new u8[fileSize]);
 		auto file = idm::get<lv2_file_t>(fd);
 		file->file->Seek(0);
 		file->file->Read(jpg.get(), fileSize);
+		jpg_data = jpg.get();
 		break;
 	}
 	}
@@ -206,7 +210,7 @@ s32 cellJpgDecDecodeData(u32 mainHandle, u32 subHandle, vm::ptr<u8> data, vm::cp
 	int width, height, actual_components;
 	auto image = std::unique_ptr<unsigned char,decltype(&::free)>
 		(
-			stbi_load_from_memory(jpg.get(), (s32)fileSize, &width, &height, &actual_components, 4),
+			stbi_load_from_memory(jpg_data, (s32)fileSize, &width, &height, &actual_components, 4),
 			&::free
 		);
 
@@ -214,74 +218,21 @@ s32 cellJpgDecDecodeData(u32 mainHandle, u32 subHandle, vm::ptr<u8> data, vm::cp
 		return CELL_JPGDEC_ERROR_STREAM_FORMAT;
 
 	const bool flip = current_outParam.outputMode == CELL_JPGDEC_BOTTOM_TO_TOP;
-	const int bytesPerLine = (u32)dataCtrlParam->outputBytesPerLine;
-	size_t image_size = width * height;
+	const u32 bytesPerLine = dataCtrlParam->outputBytesPerLine;
 
 	switch((u32)current_outParam.outputColorSpace)
 	{
 	case CELL_JPG_RGB:
+		image_dec_write(image.get(), width, height, data.get_ptr(), bytesPerLine, image_dec_format::rgb, flip);
+		break;
+
 	case CELL_JPG_RGBA:
-	{
-		const char nComponents = current_outParam.outputColorSpace == CELL_JPG_RGBA ? 4 : 3;
-		image_size *= nComponents;
-		if (bytesPerLine > width * nComponents || flip) //check if we need padding
-		{
-			const int linesize = std::min(bytesPerLine, width * nComponents);
-			for (int i = 0; i < height; i++)
-			{
-				const int dstOffset = i * bytesPerLine;
-				const int srcOffset = width * nComponents * (flip ? height - i - 1 : i);
-				memcpy(&data[dstOffset], &image.get()[srcOffset], linesize);
-			}
-		}
-		else
-		{
-			memcpy(data.get_ptr(), image.get(), image_size);
-		}
-	}
-	break;
+		image_dec_write(image.get(), width, height, data.get_ptr(), bytesPerLine, image_dec_format::rgba, flip);
+		break;
 
 	case CELL_JPG_ARGB:
-	{
-		const int nComponents = 4;
-		image_size *= nComponents;
-		if (bytesPerLine > width * nComponents || flip) //check if we need padding
-		{
-			//TODO: Find out if we can't do padding without an extra copy
-			const int linesize = std::min(bytesPerLine, width * nComponents);
-			char *output = (char *) malloc(linesize);
-			for (int i = 0; i < height; i++)
-			{
-				const int dstOffset = i * bytesPerLine;
-				const int srcOffset = width * nComponents * (flip ? height - i - 1 : i);
-				for (int j = 0; j < linesize; j += nComponents)
-				{
-					output[j + 0] = image.get()[srcOffset + j + 3];
-					output[j + 1] = image.get()[srcOffset + j + 0];
-					output[j + 2] = image.get()[srcOffset + j + 1];
-					output[j + 3] = image.get()[srcOffset + j + 2];
-				}
-				memcpy(&data[dstOffset], output, linesize);
-			}
-			free(output);
-		}
-		else
-		{
-			uint* img = (uint*)new char[image_size];
-			uint* source_current = (uint*)&(image.get()[0]);
-			uint* dest_current = img;
-			for (uint i = 0; i < image_size / nComponents; i++) 
-			{
-				uint val = *source_current;
-				*dest_current = (val >> 24) | (val << 8); // set alpha (A8) as leftmost byte
-				source_current++;
-				dest_current++;
-			}
-			memcpy(data.get_ptr(), img, image_size); 
-			delete[] img;
-		}
-	}
-	break;
+		image_dec_write(image.get(), width, height, data.get_ptr(), bytesPerLine, image_dec_format::argb, flip);
+		break;
 
 	case CELL_JPG_GRAYSCALE:
 	case CELL_JPG_YCbCr:
@@ -298,7 +249,7 @@ s32 cellJpgDecDecodeData(u32 mainHandle, u32 subHandle, vm::ptr<u8> data, vm::cp
 	dataOutInfo->status = CELL_JPGDEC_DEC_STATUS_FINISH;
 
 	if(dataCtrlParam->outputBytesPerLine)
-		dataOutInfo->outputLines = (u32)(image_size / dataCtrlParam->outputBytesPerLine);
+		dataOutInfo->outputLines = height;
 
 	return CELL_OK;
 }
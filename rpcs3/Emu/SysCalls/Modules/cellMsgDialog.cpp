@@ -4,6 +4,7 @@
 #include "Emu/IdManager.h"
 #include "Emu/SysCalls/Modules.h"
 #include "Emu/SysCalls/Callback.h"
+#include "Emu/SysCalls/HLEWorkerPool.h"
 
 #include "cellSysutil.h"
 #include "cellMsgDialog.h"
@@ -206,7 +207,8 @@ s32 cellMsgDialogClose(f32 delay)
 
 	const u64 wait_until = get_system_time() + static_cast<s64>(std::max<float>(delay, 0.0f) * 1000);
 
-	thread_ctrl::spawn(PURE_EXPR("MsgDialog Thread"s), [=]()
+	// low priority: the task only waits for the closing delay
+	fxm::get_always<hle_worker_pool_t>()->push("MsgDialog", 3000, [=]()
 	{
 		while (dlg->state == MsgDialogState::Open && get_system_time() < wait_until)
 		{
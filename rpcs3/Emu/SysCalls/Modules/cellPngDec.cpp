@@ -239,6 +239,76 @@ s32 pngDecSetParameter(PSubHandle stream, PInParam inParam, POutParam outParam,
 	return CELL_OK;
 }
 
+void image_dec_write(const u8* rgba, u32 width, u32 height, u8* dst, u32 pitch, image_dec_format format, bool flip)
+{
+	const u32 bpp = format == image_dec_format::rgb ? 3 : 4;
+	const u32 row_size = width * bpp;
+
+	if (pitch < row_size)
+	{
+		pitch = row_size;
+	}
+
+	for (u32 y = 0; y < height; y++)
+	{
+		const u8* src = rgba + width * 4 * (flip ? height - y - 1 : y);
+		u8* out = dst + pitch * y;
+		u32 x = 0;
+
+		switch (format)
+		{
+		case image_dec_format::rgba:
+		{
+			std::memcpy(out, src, row_size);
+			continue;
+		}
+
+		case image_dec_format::argb:
+		{
+			// rotate alpha into the first byte of each pixel
+			const __m128i mask = _mm_set_epi8(14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3);
+
+			for (; x + 4 <= width; x += 4)
+			{
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 4), _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 4)), mask));
+			}
+
+			for (; x < width; x++)
+			{
+				out[x * 4 + 0] = src[x * 4 + 3];
+				out[x * 4 + 1] = src[x * 4 + 0];
+				out[x * 4 + 2] = src[x * 4 + 1];
+				out[x * 4 + 3] = src[x * 4 + 2];
+			}
+
+			break;
+		}
+
+		case image_dec_format::rgb:
+		{
+			// drop alpha, 4 pixels become 12 bytes
+			const __m128i mask = _mm_set_epi8(-1, -1, -1, -1, 14, 13, 12, 10, 9, 8, 6, 5, 4, 2, 1, 0);
+
+			for (; x + 4 <= width; x += 4)
+			{
+				const __m128i v = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 4)), mask);
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(out + x * 3), v);
+				*reinterpret_cast<u32*>(out + x * 3 + 8) = _mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+			}
+
+			for (; x < width; x++)
+			{
+				out[x * 3 + 0] = src[x * 4 + 0];
+				out[x * 3 + 1] = src[x * 4 + 1];
+				out[x * 3 + 2] = src[x * 4 + 2];
+			}
+
+			break;
+		}
+		}
+	}
+}
+
 s32 pngDecodeData(PSubHandle stream, vm::ptr<u8> data, PDataCtrlParam dataCtrlParam, PDataOutInfo dataOutInfo, PCbCtrlDisp cbCtrlDisp = vm::null, PDispParam dispParam = vm::null)
 {
 	dataOutInfo->status = CELL_PNGDEC_DEC_STATUS_STOP;
@@ -247,20 +317,23 @@ s32 pngDecodeData(PSubHandle stream, vm::ptr<u8> data, PDataCtrlParam dataCtrlPa
 	const u64& fileSize = stream->fileSize;
 	const CellPngDecOutParam& current_outParam = stream->outParam;
 
-	// Copy the PNG file to a buffer
-	std::unique_ptr<u8[]> png(new u8[fileSize]);
+	// Decode directly from guest memory, files still have to be read into a host buffer
+	std::unique_ptr<u8[]> png;
+	const u8* png_data = nullptr;
 
 	switch (stream->src.srcSelect)
 	{
 	case CELL_PNGDEC_BUFFER:
-		std::memcpy(png.get(), stream->src.streamPtr.get_ptr(), fileSize);
+		png_data = static_cast<const u8*>(stream->src.streamPtr.get_ptr());
 		break;
 
 	case CELL_PNGDEC_FILE:
 	{
+		png.reset(new u8[fileSize]);
 		auto file = idm::get<lv2_file_t>(stream->fd);
 		file->file->Seek(0);
 		file->file->Read(png.get(), fileSize);
+		png_data = png.get();
 		break;
 	}
 	}
@@ -269,7 +342,7 @@ s32 pngDecodeData(PSubHandle stream, vm::ptr<u8> data, PDataCtrlParam dataCtrlPa
 	int width, height, actual_components;
 	auto image = std::unique_ptr<unsigned char, decltype(&::free)>
 		(
-		stbi_load_from_memory(png.get(), (s32)fileSize, &width, &height, &actual_components, 4),
+		stbi_load_from_memory(png_data, (s32)fileSize, &width, &height, &actual_components, 4),
 		&::free
 		);
 	if (!image)
@@ -279,74 +352,21 @@ s32 pngDecodeData(PSubHandle stream, vm::ptr<u8> data, PDataCtrlParam dataCtrlPa
 	}
 
 	const bool flip = current_outParam.outputMode == CELL_PNGDEC_BOTTOM_TO_TOP;
-	const int bytesPerLine = (u32)dataCtrlParam->outputBytesPerLine;
-	uint image_size = width * height;
+	const u32 bytesPerLine = dataCtrlParam->outputBytesPerLine;
 
 	switch (current_outParam.outputColorSpace)
 	{
 	case CELL_PNGDEC_RGB:
+		image_dec_write(image.get(), width, height, data.get_ptr(), bytesPerLine, image_dec_format::rgb, flip);
+		break;
+
 	case CELL_PNGDEC_RGBA:
-	{
-		const char nComponents = current_outParam.outputColorSpace == CELL_PNGDEC_RGBA ? 4 : 3;
-		image_size *= nComponents;
-		if (bytesPerLine > width * nComponents || flip) //check if we need padding
-		{
-			const int linesize = std::min(bytesPerLine, width * nComponents);
-			for (int i = 0; i < height; i++)
-			{
-				const int dstOffset = i * bytesPerLine;
-				const int srcOffset = width * nComponents * (flip ? height - i - 1 : i);
-				memcpy(&data[dstOffset], &image.get()[srcOffset], linesize);
-			}
-		}
-		else
-		{
-			memcpy(data.get_ptr(), image.get(), image_size);
-		}
+		image_dec_write(image.get(), width, height, data.get_ptr(), bytesPerLine, image_dec_format::rgba, flip);
 		break;
-	}
 
 	case CELL_PNGDEC_ARGB:
-	{
-		const int nComponents = 4;
-		image_size *= nComponents;
-		if (bytesPerLine > width * nComponents || flip) //check if we need padding
-		{
-			//TODO: find out if we can't do padding without an extra copy
-			const int linesize = std::min(bytesPerLine, width * nComponents);
-			char *output = (char *)malloc(linesize);
-			for (int i = 0; i < height; i++)
-			{
-				const int dstOffset = i * bytesPerLine;
-				const int srcOffset = width * nComponents * (flip ? height - i - 1 : i);
-				for (int j = 0; j < linesize; j += nComponents)
-				{
-					output[j + 0] = image.get()[srcOffset + j + 3];
-					output[j + 1] = image.get()[srcOffset + j + 0];
-					output[j + 2] = image.get()[srcOffset + j + 1];
-					output[j + 3] = image.get()[srcOffset + j + 2];
-				}
-				memcpy(&data[dstOffset], output, linesize);
-			}
-			free(output);
-		}
-		else
-		{
-			uint* img = (uint*)new char[image_size];
-			uint* source_current = (uint*)&(image.get()[0]);
-			uint* dest_current = img;
-			for (uint i = 0; i < image_size / nComponents; i++)
-			{
-				uint val = *source_current;
-				*dest_current = (val >> 24) | (val << 8); // set alpha (A8) as leftmost byte
-				source_current++;
-				dest_current++;
-			}
-			memcpy(data.get_ptr(), img, image_size);
-			delete[] img;
-		}
+		image_dec_write(image.get(), width, height, data.get_ptr(), bytesPerLine, image_dec_format::argb, flip);
 		break;
-	}
 
 	case CELL_PNGDEC_GRAYSCALE:
 	case CELL_PNGDEC_PALETTE:
@@ -285,3 +285,14 @@ struct PngStream
 	CellPngDecStrmInfo streamInfo;
 	CellPngDecStrmParam streamParam;
 };
+
+// Output layout for decoded RGBA8 images (shared by cellPngDec, cellJpgDec and cellGifDec)
+enum class image_dec_format
+{
+	rgb,
+	rgba,
+	argb,
+};
+
+// Write decoded RGBA8 pixels directly into the guest output buffer (pitch 0 means tightly packed)
+void image_dec_write(const u8* rgba, u32 width, u32 height, u8* dst, u32 pitch, image_dec_format format, bool flip);
@@ -464,6 +464,21 @@ void InitMembers()
 	}
 }
 
+// The conversion itself is done by the RSX backend when the source buffer is presented
+void UpdateRsxRescConfig()
+{
+	rsx::resc_config config;
+
+	config.enabled = s_rescInternalInstance->m_bInitialized && s_rescInternalInstance->m_dstWidth > 0;
+	config.dst_width = s_rescInternalInstance->m_dstWidth;
+	config.dst_height = s_rescInternalInstance->m_dstHeight;
+	config.ratio_mode = (rsx::resc_ratio_mode)(u32)s_rescInternalInstance->m_initConfig.ratioMode;
+	config.ratio_adjust_x = s_rescInternalInstance->m_ratioAdjX;
+	config.ratio_adjust_y = s_rescInternalInstance->m_ratioAdjY;
+
+	Emu.GetGSManager().GetRender().set_resc_config(config);
+}
+
 void SetupRsxRenderingStates(vm::ptr<CellGcmContextData>& cntxt)
 {
 	//TODO: use cntxt
@@ -622,6 +637,8 @@ void cellRescExit()
 	}
 
 	s_rescInternalInstance->m_bInitialized = false;
+
+	UpdateRsxRescConfig();
 }
 
 s32 cellRescVideoOutResolutionId2RescBufferMode(u32 resolutionId, vm::ptr<u32> bufferMode)
@@ -804,6 +821,8 @@ s32 cellRescSetDisplayMode(u32 displayMode)
 	if (s_rescInternalInstance->s_applicationFlipHandler)   SetFlipHandler(s_rescInternalInstance->s_applicationFlipHandler);
 	cellGcmSetFlipMode((s_rescInternalInstance->m_initConfig.flipMode == CELL_RESC_DISPLAY_VSYNC) ? CELL_GCM_DISPLAY_VSYNC : CELL_GCM_DISPLAY_HSYNC);
 
+	UpdateRsxRescConfig();
+
 	return CELL_OK;
 }
 
@@ -826,6 +845,8 @@ s32 cellRescAdjustAspectRatio(float horizontal, float vertical)
 	s_rescInternalInstance->m_ratioAdjX = horizontal;
 	s_rescInternalInstance->m_ratioAdjY = vertical;
 
+	UpdateRsxRescConfig();
+
 	if (s_rescInternalInstance->m_vertexArrayEA)
 	{
 		if (IsTextureNR())
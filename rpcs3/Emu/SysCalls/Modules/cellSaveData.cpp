@@ -1,7 +1,9 @@
 #include "stdafx.h"
 #include "Emu/Memory/Memory.h"
 #include "Emu/System.h"
+#include "Emu/IdManager.h"
 #include "Emu/SysCalls/Modules.h"
+#include "Emu/SysCalls/HLEWorkerPool.h"
 
 #include "Emu/FS/VFS.h"
 #include "Emu/FS/vfsFile.h"
@@ -38,6 +40,143 @@ enum : u32
 
 std::mutex g_savedata_mutex;
 
+// Savedata file writer and cache of savedata directory information.
+// File writes are copied and performed by the "cellSaveData" queue of the HLE worker pool, so savedata_op doesn't
+// wait for the disk: files stay open until the end of the operation and are synced once together with PARAM.SFO.
+// The next operation waits for the completion of pending writes before accessing the files.
+struct savedata_io_t
+{
+	struct dir_info_t
+	{
+		s64 sfo_mtime; // PARAM.SFO stats when cached
+		u64 sfo_size;
+		PSFLoader psf;
+		u64 size; // total size of the files
+	};
+
+	struct digest_t
+	{
+		u64 size;
+		s64 mtime;
+		u64 hash;
+	};
+
+	// Files written by the current operation (only accessed by the tasks)
+	struct write_t
+	{
+		std::map<std::string, fs::file> files; // local path -> opened file
+		std::map<std::string, u64> hashes; // local path -> hash of the whole contents (if written by a single truncating write)
+	};
+
+	std::mutex mutex;
+	std::condition_variable cv;
+	u32 pending = 0; // count of queued tasks
+
+	std::unordered_map<std::string, dir_info_t> dirs; // savedata directory path -> information (only accessed by savedata_op)
+	std::unordered_map<std::string, digest_t> digests; // local path -> contents written last time (only accessed by the tasks)
+
+	static u64 get_hash(const u8* data, std::size_t size)
+	{
+		// FNV-1a
+		u64 hash = 0xcbf29ce484222325ull;
+
+		for (std::size_t i = 0; i < size; i++)
+		{
+			hash ^= data[i];
+			hash *= 0x100000001b3ull;
+		}
+
+		return hash;
+	}
+
+	void push(std::function<void()> task)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			pending++;
+		}
+
+		fxm::get_always<hle_worker_pool_t>()->push("cellSaveData", 3000, [this, task = std::move(task)]()
+		{
+			try
+			{
+				task();
+			}
+			catch (...)
+			{
+				complete();
+				throw;
+			}
+
+			complete();
+		});
+	}
+
+	void complete()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if (!--pending)
+		{
+			cv.notify_all();
+		}
+	}
+
+	// Wait for the completion of all queued tasks
+	void wait()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+
+		while (pending)
+		{
+			CHECK_EMU_STATUS;
+
+			cv.wait_for(lock, 1ms);
+		}
+	}
+
+	// Get information of the savedata directory (nullptr if PARAM.SFO is missing or invalid)
+	const dir_info_t* get_dir(const std::string& dir_path)
+	{
+		std::string sfo_local_path;
+
+		fs::stat_t sfo_info;
+
+		if (!Emu.GetVFS().GetDevice(dir_path + "PARAM.SFO", sfo_local_path) || !fs::stat(sfo_local_path, sfo_info))
+		{
+			dirs.erase(dir_path);
+			return nullptr;
+		}
+
+		const auto found = dirs.find(dir_path);
+
+		if (found != dirs.end() && found->second.sfo_mtime == sfo_info.mtime && found->second.sfo_size == sfo_info.size)
+		{
+			return &found->second;
+		}
+
+		dir_info_t info{ sfo_info.mtime, sfo_info.size };
+
+		vfsFile f(dir_path + "PARAM.SFO");
+
+		if (!info.psf.Load(f))
+		{
+			dirs.erase(dir_path);
+			return nullptr;
+		}
+
+		info.size = 0;
+
+		for (const auto entry : vfsDir(dir_path))
+		{
+			info.size += entry->size;
+		}
+
+		return &(dirs[dir_path] = std::move(info));
+	}
+};
+
 never_inline s32 savedata_op(PPUThread& ppu, u32 operation, u32 version, vm::cptr<char> dirName,
 	u32 errDialog, PSetList setList, PSetBuf setBuf, PFuncList funcList, PFuncFixed funcFixed, PFuncStat funcStat,
 	PFuncFile funcFile, u32 container, u32 unknown, vm::ptr<void> userdata, u32 userId, PFuncDone funcDone)
@@ -60,6 +199,11 @@ never_inline s32 savedata_op(PPUThread& ppu, u32 operation, u32 version, vm::cpt
 	vm::var<CellSaveDataFileGet>  fileGet;
 	vm::var<CellSaveDataFileSet>  fileSet;
 
+	const auto io = fxm::get_always<savedata_io_t>();
+
+	// files written by the previous operation
+	io->wait();
+
 	// path of the specified user (00000001 by default)
 	const std::string base_dir = fmt::format("/dev_hdd0/home/%08u/savedata/", userId ? userId : 1u);
 
@@ -95,14 +239,15 @@ never_inline s32 savedata_op(PPUThread& ppu, u32 operation, u32 version, vm::cpt
 						listGet->dirNum++;
 
 						// PSF parameters
-						vfsFile f(base_dir + entry->name + "/PARAM.SFO");
-						const PSFLoader psf(f);
+						const auto dir = io->get_dir(base_dir + entry->name + "/");
 
-						if (!psf)
+						if (!dir)
 						{
 							break;
 						}
 
+						const PSFLoader& psf = dir->psf;
+
 						SaveDataEntry save_entry2;
 						save_entry2.dirName = psf.GetString("SAVEDATA_DIRECTORY");
 						save_entry2.listParam = psf.GetString("SAVEDATA_LIST_PARAM");
@@ -110,12 +255,7 @@ never_inline s32 savedata_op(PPUThread& ppu, u32 operation, u32 version, vm::cpt
 						save_entry2.subtitle = psf.GetString("SUB_TITLE");
 						save_entry2.details = psf.GetString("DETAIL");
 
-						save_entry2.size = 0;
-
-						for (const auto entry2 : vfsDir(base_dir + entry->name))
-						{
-							save_entry2.size += entry2->size;
-						}
+						save_entry2.size = dir->size;
 
 						save_entry2.atime = entry->access_time;
 						save_entry2.mtime = entry->modify_time;
@@ -343,9 +483,9 @@ never_inline s32 savedata_op(PPUThread& ppu, u32 operation, u32 version, vm::cpt
 	PSFLoader psf;
 
 	// Load PARAM.SFO
+	if (const auto dir = io->get_dir(dir_path))
 	{
-		vfsFile f(sfo_path);
-		psf.Load(f);
+		psf = dir->psf;
 	}
 
 	// Get save stats
@@ -477,6 +617,8 @@ never_inline s32 savedata_op(PPUThread& ppu, u32 operation, u32 version, vm::cpt
 		case CELL_SAVEDATA_RECREATE_YES_RESET_OWNER:
 		{
 			// kill it with fire
+			io->dirs.erase(dir_path);
+
 			for (const auto entry : vfsDir(dir_path))
 			{
 				if (entry->flags & DirEntry_TypeFile)
@@ -515,6 +657,8 @@ never_inline s32 savedata_op(PPUThread& ppu, u32 operation, u32 version, vm::cpt
 	fileGet->excSize = 0;
 	memset(fileGet->reserved, 0, sizeof(fileGet->reserved));
 
+	const auto write = std::make_shared<savedata_io_t::write_t>();
+
 	while (funcFile)
 	{
 		funcFile(ppu, result, fileGet, fileSet);
@@ -582,6 +726,9 @@ never_inline s32 savedata_op(PPUThread& ppu, u32 operation, u32 version, vm::cpt
 		{
 		case CELL_SAVEDATA_FILEOP_READ:
 		{
+			// the file may be written by the previous requests
+			io->wait();
+
 			fs::file file(local_path, fom::read);
 			file.seek(fileSet->fileOffset);
 			fileGet->excSize = static_cast<u32>(file.read(fileSet->fileBuf.get_ptr(), std::min<u32>(fileSet->fileSize, fileSet->fileBufSize)));
@@ -589,26 +736,73 @@ never_inline s32 savedata_op(PPUThread& ppu, u32 operation, u32 version, vm::cpt
 		}
 
 		case CELL_SAVEDATA_FILEOP_WRITE:
+		case CELL_SAVEDATA_FILEOP_WRITE_NOTRUNC:
 		{
-			fs::file file(local_path, fom::write | fom::create);
-			file.seek(fileSet->fileOffset);
-			fileGet->excSize = static_cast<u32>(file.write(fileSet->fileBuf.get_ptr(), std::min<u32>(fileSet->fileSize, fileSet->fileBufSize)));
-			file.trunc(file.seek(0, fs::seek_cur)); // truncate
+			const u32 size = std::min<u32>(fileSet->fileSize, fileSet->fileBufSize);
+			const u64 offset = fileSet->fileOffset;
+			const bool truncate = op == CELL_SAVEDATA_FILEOP_WRITE;
+			const auto buf = static_cast<const u8*>(fileSet->fileBuf.get_ptr());
+
+			io->push([=, data = std::vector<u8>(buf, buf + size)]()
+			{
+				const bool whole = truncate && offset == 0;
+				const u64 hash = whole ? savedata_io_t::get_hash(data.data(), data.size()) : 0;
+
+				if (whole && !write->files.count(local_path))
+				{
+					const auto found = io->digests.find(local_path);
+
+					fs::stat_t info;
+
+					// skip rewriting the file with the same contents
+					if (found != io->digests.end() && found->second.hash == hash && fs::stat(local_path, info) && info.size == found->second.size && info.mtime == found->second.mtime)
+					{
+						return;
+					}
+				}
+
+				io->digests.erase(local_path);
+
+				auto& file = write->files[local_path];
+
+				if (!file)
+				{
+					file.open(local_path, fom::write | fom::create);
+				}
+
+				file.seek(offset);
+				file.write(data.data(), data.size());
+
+				if (truncate)
+				{
+					file.trunc(offset + data.size());
+				}
+
+				if (whole)
+				{
+					write->hashes[local_path] = hash;
+				}
+				else
+				{
+					write->hashes.erase(local_path);
+				}
+			});
+
+			fileGet->excSize = size;
 			break;
 		}
 
 		case CELL_SAVEDATA_FILEOP_DELETE:
 		{
-			fs::remove_file(local_path);
-			fileGet->excSize = 0;
-			break;
-		}
+			io->push([=]()
+			{
+				write->files.erase(local_path);
+				write->hashes.erase(local_path);
+				io->digests.erase(local_path);
+				fs::remove_file(local_path);
+			});
 
-		case CELL_SAVEDATA_FILEOP_WRITE_NOTRUNC:
-		{
-			fs::file file(local_path, fom::write | fom::create);
-			file.seek(fileSet->fileOffset);
-			fileGet->excSize = static_cast<u32>(file.write(fileSet->fileBuf.get_ptr(), std::min<u32>(fileSet->fileSize, fileSet->fileBufSize)));
+			fileGet->excSize = 0;
 			break;
 		}
 
@@ -620,11 +814,48 @@ never_inline s32 savedata_op(PPUThread& ppu, u32 operation, u32 version, vm::cpt
 		}
 	}
 
-	// Write PARAM.SFO
+	// Write PARAM.SFO and flush all written files
 	if (psf)
 	{
-		vfsFile f(sfo_path, fom::rewrite);
-		psf.Save(f);
+		io->dirs.erase(dir_path);
+
+		std::string sfo_local_path;
+
+		Emu.GetVFS().GetDevice(sfo_path, sfo_local_path);
+
+		io->push([=]()
+		{
+			{
+				vfsFile f(sfo_path, fom::rewrite);
+				psf.Save(f);
+			}
+
+			if (!fs::file(sfo_local_path, fom::write).sync())
+			{
+				cellSaveData.error("Failed to sync %s", sfo_path);
+			}
+
+			for (auto& pair : write->files)
+			{
+				if (!pair.second.sync())
+				{
+					cellSaveData.error("Failed to sync %s", pair.first);
+				}
+
+				pair.second.close();
+
+				fs::stat_t info;
+
+				const auto found = write->hashes.find(pair.first);
+
+				if (found != write->hashes.end() && fs::stat(pair.first, info))
+				{
+					io->digests[pair.first] = { info.size, info.mtime, found->second };
+				}
+			}
+
+			write->files.clear();
+		});
 	}
 
 	return CELL_OK;
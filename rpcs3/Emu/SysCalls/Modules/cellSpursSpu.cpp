@@ -65,6 +65,7 @@ static void spursSysServiceCleanupAfterSystemWorkload(SPUThread & spu, SpursKern
 static bool spursTasksetEntry(SPUThread & spu);
 static bool spursTasksetSyscallEntry(SPUThread & spu);
 static void spursTasksetResumeTask(SPUThread & spu);
+static void spursTasksetStopThread(SPUThread & spu);
 static void spursTasksetStartTask(SPUThread & spu, CellSpursTaskArgument & taskArgs);
 static s32 spursTasksetProcessRequest(SPUThread & spu, s32 request, u32 * taskId, u32 * isWaiting);
 static void spursTasksetProcessPollStatus(SPUThread & spu, u32 pollStatus);
@@ -528,9 +529,19 @@ bool spursKernelWorkloadExit(SPUThread & spu) {
 
 /// SPURS kernel entry point
 bool spursKernelEntry(SPUThread & spu) {
-    while (true) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
-        CHECK_EMU_STATUS;
+    // The kernel is not started yet. Block until the thread is stopped (notified by stop() and Emu.Stop()).
+    {
+        std::unique_lock<std::mutex> lock(spu.mutex);
+
+        while (true) {
+            CHECK_EMU_STATUS;
+
+            if (spu.is_stopped()) {
+                throw CPUThreadStop{};
+            }
+
+            spu.sched_wait(lock);
+        }
     }
 
     auto ctxt = vm::_ptr<SpursKernelContext>(spu.offset + 0x100);
@@ -604,8 +615,6 @@ bool spursSysServiceEntry(SPUThread & spu) {
 void spursSysServiceIdleHandler(SPUThread & spu, SpursKernelContext * ctxt) {
     bool shouldExit;
 
-    std::unique_lock<std::mutex> lock(spu.mutex, std::defer_lock);
-
     while (true) {
         vm::reservation_acquire(vm::base(spu.offset + 0x100), VM_CAST(ctxt->spurs.addr()), 128);
         auto spurs = vm::_ptr<CellSpurs>(spu.offset + 0x100);
@@ -674,9 +683,15 @@ void spursSysServiceIdleHandler(SPUThread & spu, SpursKernelContext * ctxt) {
         // If all SPUs are idling and the exit_if_no_work flag is set then the SPU thread group must exit. Otherwise wait for external events.
         if (spuIdling && shouldExit == false && foundReadyWorkload == false) {
             // The system service blocks by making a reservation and waiting on the lock line reservation lost event.
+            // Writes to the CellSpurs line (workload signals, ready counts, messages) notify the waiter, so idle SPUs don't poll.
+            if (spu.scheduler) spu.scheduler->release(spu);
+
+            vm::wait_op(spu, VM_CAST(ctxt->spurs.addr()), 128, WRAP_EXPR(!vm::reservation_test(spu.get_thread_ctrl()) || spu.is_stopped()));
+
+            if (spu.scheduler) spu.scheduler->acquire(spu);
+
             CHECK_EMU_STATUS;
-            if (!lock) lock.lock();
-            spu.cv.wait_for(lock, std::chrono::milliseconds(1));
+            if (spu.is_stopped()) throw CPUThreadStop{};
             continue;
         }
 
@@ -1143,6 +1158,21 @@ bool spursTasksetSyscallEntry(SPUThread & spu) {
     return false;
 }
 
+/// Stop the SPU thread as if it executed sys_spu_thread_exit
+void spursTasksetStopThread(SPUThread & spu) {
+    {
+        LV2_LOCK;
+
+        spu.status |= SPU_STATUS_STOPPED_BY_STOP;
+
+        if (const auto group = spu.tg.lock()) {
+            group->notify_join(lv2_lock);
+        }
+    }
+
+    spu.stop();
+}
+
 /// Resume a task
 void spursTasksetResumeTask(SPUThread & spu) {
     auto ctxt = vm::_ptr<SpursTasksetContext>(spu.offset + 0x2700);
@@ -1505,8 +1535,7 @@ void spursTasksetDispatch(SPUThread & spu) {
         cellSpursModulePutTrace(&pkt, 0x1F);
 
         if (elfAddr & 2) { // TODO: Figure this out
-            spu.status |= SPU_STATUS_STOPPED_BY_STOP;
-            spu.stop();
+            spursTasksetStopThread(spu);
             return;
         }
 
@@ -1551,8 +1580,7 @@ void spursTasksetDispatch(SPUThread & spu) {
         cellSpursModulePutTrace(&pkt, 0x1F);
 
         if (elfAddr & 2) { // TODO: Figure this out
-            spu.status |= SPU_STATUS_STOPPED_BY_STOP;
-            spu.stop();
+            spursTasksetStopThread(spu);
             return;
         }
 
@@ -1629,9 +1629,9 @@ Module<> cellSync("cellSync", []()
 	};
 
 	REG_FUNC(cellSync, cellSyncMutexInitialize);
-	REG_FUNC(cellSync, cellSyncMutexLock);
-	REG_FUNC(cellSync, cellSyncMutexTryLock);
-	REG_FUNC(cellSync, cellSyncMutexUnlock);
+	REG_FUNC(cellSync, cellSyncMutexLock, MFF_DIRECT_CALL);
+	REG_FUNC(cellSync, cellSyncMutexTryLock, MFF_DIRECT_CALL);
+	REG_FUNC(cellSync, cellSyncMutexUnlock, MFF_DIRECT_CALL);
 
 	REG_FUNC(cellSync, cellSyncBarrierInitialize);
 	REG_FUNC(cellSync, cellSyncBarrierNotify);
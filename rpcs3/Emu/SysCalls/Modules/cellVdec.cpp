@@ -1,6 +1,7 @@
 #include "stdafx.h"
 #include "Emu/Memory/Memory.h"
 #include "Emu/System.h"
+#include "Emu/state.h"
 #include "Emu/IdManager.h"
 #include "Emu/SysCalls/Modules.h"
 
@@ -328,6 +329,11 @@ void vdecOpen(u32 vdec_id) // TODO: call from the constructor
 					}
 					vdec.ctx = vdec.fmt->streams[0]->codec; // TODO: check data
 						
+					// decoding threads (0 = one per host core); frame threading decodes several frames in parallel
+					// at the cost of thread_count frames of delay, slice threading only helps streams with several slices
+					vdec.ctx->thread_count = rpcs3::state.config.core.vdec_threads.value();
+					vdec.ctx->thread_type = rpcs3::state.config.core.vdec_frame_threading.value() ? FF_THREAD_FRAME | FF_THREAD_SLICE : FF_THREAD_SLICE;
+
 					opts = nullptr;
 					av_dict_set(&opts, "refcounted_frames", "1", 0);
 					{
@@ -536,6 +542,7 @@ void vdecOpen(u32 vdec_id) // TODO: call from the constructor
 		}
 
 		vdec.is_finished = true;
+		vdec.finished.notify();
 	};
 
 	vdec.vdecCb->run();
@@ -588,11 +595,11 @@ s32 cellVdecClose(u32 handle)
 	vdec->is_closed = true;
 	vdec->job.try_push(VdecTask(vdecClose));
 
-	while (!vdec->is_finished)
+	for (u64 events = vdec->finished.get(); !vdec->is_finished; events = vdec->finished.get())
 	{
 		CHECK_EMU_STATUS;
 
-		std::this_thread::sleep_for(std::chrono::milliseconds(1)); // hack
+		vdec->finished.wait(events);
 	}
 
 	idm::remove<PPUThread>(vdec->vdecCb->get_id());
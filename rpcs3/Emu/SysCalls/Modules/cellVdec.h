@@ -699,6 +699,7 @@ public:
 	u32 id;
 	volatile bool is_closed;
 	volatile bool is_finished;
+	event_notifier_t finished; // notified when is_finished is set
 	bool just_started;
 	bool just_finished;
 
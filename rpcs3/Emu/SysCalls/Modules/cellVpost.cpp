@@ -13,6 +13,71 @@ extern "C"
 
 extern Module<> cellVpost;
 
+VpostInstance::~VpostInstance()
+{
+	sws_freeContext(sws);
+}
+
+void vpost_yuv420_to_rgba(const u8* y, const u8* u, const u8* v, u8* out, u32 width, u32 height, u8 alpha)
+{
+	// fixed point coefficients (x1024), applied with PMULHW to values pre-multiplied by 64
+	const __m128i k_y = _mm_set1_epi16(1192); // 1.164
+	const __m128i k_vr = _mm_set1_epi16(1634); // 1.596
+	const __m128i k_ug = _mm_set1_epi16(401); // 0.391
+	const __m128i k_vg = _mm_set1_epi16(833); // 0.813
+	const __m128i k_ub = _mm_set1_epi16(2066); // 2.018
+	const __m128i c16 = _mm_set1_epi16(16);
+	const __m128i c128 = _mm_set1_epi16(128);
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i a = _mm_set1_epi8(alpha);
+
+	const auto clamp = [](s32 value) -> u8 { return value < 0 ? 0 : value > 255 ? 255 : static_cast<u8>(value); };
+
+	for (u32 row = 0; row < height; row++)
+	{
+		const u8* py = y + row * width;
+		const u8* pu = u + (row / 2) * (width / 2);
+		const u8* pv = v + (row / 2) * (width / 2);
+		u8* dst = out + row * width * 4;
+
+		u32 x = 0;
+
+		for (; x + 8 <= width; x += 8)
+		{
+			const __m128i vy = _mm_slli_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(py + x)), zero), c16), 6);
+
+			// 4 chroma samples, each used by two horizontal pixels
+			__m128i vu = _mm_unpacklo_epi8(_mm_cvtsi32_si128(*(const s32*)(pu + x / 2)), zero);
+			__m128i vv = _mm_unpacklo_epi8(_mm_cvtsi32_si128(*(const s32*)(pv + x / 2)), zero);
+			vu = _mm_slli_epi16(_mm_sub_epi16(_mm_unpacklo_epi16(vu, vu), c128), 6);
+			vv = _mm_slli_epi16(_mm_sub_epi16(_mm_unpacklo_epi16(vv, vv), c128), 6);
+
+			const __m128i luma = _mm_mulhi_epi16(vy, k_y);
+			const __m128i r = _mm_add_epi16(luma, _mm_mulhi_epi16(vv, k_vr));
+			const __m128i g = _mm_sub_epi16(luma, _mm_add_epi16(_mm_mulhi_epi16(vu, k_ug), _mm_mulhi_epi16(vv, k_vg)));
+			const __m128i b = _mm_add_epi16(luma, _mm_mulhi_epi16(vu, k_ub));
+
+			const __m128i rg = _mm_unpacklo_epi8(_mm_packus_epi16(r, zero), _mm_packus_epi16(g, zero));
+			const __m128i ba = _mm_unpacklo_epi8(_mm_packus_epi16(b, zero), a);
+
+			_mm_storeu_si128((__m128i*)(dst + x * 4), _mm_unpacklo_epi16(rg, ba));
+			_mm_storeu_si128((__m128i*)(dst + x * 4 + 16), _mm_unpackhi_epi16(rg, ba));
+		}
+
+		for (; x < width; x++)
+		{
+			const s32 cy = (py[x] - 16) * 1192;
+			const s32 cu = pu[x / 2] - 128;
+			const s32 cv = pv[x / 2] - 128;
+
+			dst[x * 4 + 0] = clamp((cy + cv * 1634) >> 10);
+			dst[x * 4 + 1] = clamp((cy - cu * 401 - cv * 833) >> 10);
+			dst[x * 4 + 2] = clamp((cy + cu * 2066) >> 10);
+			dst[x * 4 + 3] = alpha;
+		}
+	}
+}
+
 s32 cellVpostQueryAttr(vm::cptr<CellVpostCfgParam> cfgParam, vm::ptr<CellVpostAttr> attr)
 {
 	cellVpost.warning("cellVpostQueryAttr(cfgParam=*0x%x, attr=*0x%x)", cfgParam, attr);
@@ -114,26 +179,28 @@ s32 cellVpostExec(u32 handle, vm::cptr<u8> inPicBuff, vm::cptr<CellVpostCtrlPara
 	picInfo->reserved1 = 0;
 	picInfo->reserved2 = 0;
 
-	//u64 stamp0 = get_system_time();
-	std::unique_ptr<u8[]> pA(new u8[w*h]);
-
-	memset(pA.get(), ctrlParam->outAlpha, w*h);
-
-	//u64 stamp1 = get_system_time();
+	if (w == ow && h == oh && w % 2 == 0 && h % 2 == 0)
+	{
+		// direct conversion into the output buffer
+		vpost_yuv420_to_rgba(&inPicBuff[0], &inPicBuff[w * h], &inPicBuff[w * h * 5 / 4], outPicBuff.get_ptr(), w, h, ctrlParam->outAlpha);
+		return CELL_OK;
+	}
 
-	std::unique_ptr<SwsContext, void(*)(SwsContext*)> sws(sws_getContext(w, h, AV_PIX_FMT_YUVA420P, ow, oh, AV_PIX_FMT_RGBA, SWS_BILINEAR, NULL, NULL, NULL), sws_freeContext);
+	if (vpost->alpha.size() != w * h || vpost->alpha_value != ctrlParam->outAlpha)
+	{
+		vpost->alpha_value = ctrlParam->outAlpha;
+		vpost->alpha.assign(w * h, vpost->alpha_value);
+	}
 
-	//u64 stamp2 = get_system_time();
+	vpost->sws = sws_getCachedContext(vpost->sws, w, h, AV_PIX_FMT_YUVA420P, ow, oh, AV_PIX_FMT_RGBA, SWS_BILINEAR, NULL, NULL, NULL);
 
-	const u8* in_data[4] = { &inPicBuff[0], &inPicBuff[w * h], &inPicBuff[w * h * 5 / 4], pA.get() };
+	const u8* in_data[4] = { &inPicBuff[0], &inPicBuff[w * h], &inPicBuff[w * h * 5 / 4], vpost->alpha.data() };
 	int in_line[4] = { w, w/2, w/2, w };
 	u8* out_data[4] = { outPicBuff.get_ptr(), NULL, NULL, NULL };
 	int out_line[4] = { static_cast<int>(ow*4), 0, 0, 0 };
 
-	sws_scale(sws.get(), in_data, in_line, 0, h, out_data, out_line);
+	sws_scale(vpost->sws, in_data, in_line, 0, h, out_data, out_line);
 
-	//ConLog.Write("cellVpostExec() perf (access=%d, getContext=%d, scale=%d, finalize=%d)",
-		//stamp1 - stamp0, stamp2 - stamp1, stamp3 - stamp2, get_system_time() - stamp3);
 	return CELL_OK;
 }
 
@@ -318,13 +318,24 @@ struct CellVpostPictureInfo
 	be_t<u32> reserved2;
 };
 
+struct SwsContext;
+
 class VpostInstance
 {
 public:
 	const bool to_rgba;
 
+	SwsContext* sws = nullptr; // scaling context of the last cellVpostExec (reused while the sizes don't change)
+	std::vector<u8> alpha; // constant alpha plane for the scaler
+	u8 alpha_value = 0;
+
 	VpostInstance(bool rgba)
 		: to_rgba(rgba)
 	{
 	}
+
+	~VpostInstance();
 };
+
+// Convert a YUV420 planar picture (BT.601, limited range) to RGBA with constant alpha, without scaling
+void vpost_yuv420_to_rgba(const u8* y, const u8* u, const u8* v, u8* out, u32 width, u32 height, u8 alpha);
@@ -14,6 +14,21 @@ SurMixerConfig g_surmx;
 
 std::vector<SSPlayer> g_ssp;
 
+namespace
+{
+	// load 2 big-endian floats (upper lanes zeroed)
+	inline __m128 load_be_ps2(const be_t<f32>* src)
+	{
+		return _mm_castsi128_ps(_mm_shuffle_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src)), _mm_set_epi8(-1, -1, -1, -1, -1, -1, -1, -1, 4, 5, 6, 7, 0, 1, 2, 3)));
+	}
+
+	// accumulate 4 channels of the mix buffer
+	inline void mix_frame_front(f32* dst, __m128 value)
+	{
+		_mm_store_ps(dst, _mm_add_ps(_mm_load_ps(dst), value));
+	}
+}
+
 s32 cellAANAddData(u32 aan_handle, u32 aan_port, u32 offset, vm::ptr<float> addr, u32 samples)
 {
 	libmixer.trace("cellAANAddData(aan_handle=0x%x, aan_port=0x%x, offset=0x%x, addr=*0x%x, samples=%d)", aan_handle, aan_port, offset, addr, samples);
@@ -43,52 +58,51 @@ s32 cellAANAddData(u32 aan_handle, u32 aan_port, u32 offset, vm::ptr<float> addr
 
 	std::lock_guard<std::mutex> lock(g_surmx.mutex);
 
+	const be_t<f32>* src = addr.get_ptr();
+	f32* dst = g_surmx.mixdata;
+
+	// keeps the first two channels (front left and right) of a frame
+	const __m128 lr_mask = _mm_castsi128_ps(_mm_set_epi32(0, 0, -1, -1));
+
 	if (type == CELL_SURMIXER_CHSTRIP_TYPE1A)
 	{
 		// mono upmixing
-		for (u32 i = 0; i < samples; i++)
+		for (u32 i = 0; i < samples; i += 4)
 		{
-			const float center = addr[i];
-			g_surmx.mixdata[i * 8 + 0] += center;
-			g_surmx.mixdata[i * 8 + 1] += center;
-		}		
+			const __m128 center = load_be_ps(src + i);
+			const __m128 c01 = _mm_unpacklo_ps(center, center);
+			const __m128 c23 = _mm_unpackhi_ps(center, center);
+			mix_frame_front(dst + (i + 0) * 8, _mm_and_ps(c01, lr_mask));
+			mix_frame_front(dst + (i + 1) * 8, _mm_and_ps(_mm_movehl_ps(c01, c01), lr_mask));
+			mix_frame_front(dst + (i + 2) * 8, _mm_and_ps(c23, lr_mask));
+			mix_frame_front(dst + (i + 3) * 8, _mm_and_ps(_mm_movehl_ps(c23, c23), lr_mask));
+		}
 	}
 	else if (type == CELL_SURMIXER_CHSTRIP_TYPE2A)
 	{
 		// stereo upmixing
-		for (u32 i = 0; i < samples; i++)
+		for (u32 i = 0; i < samples; i += 2)
 		{
-			const float left = addr[i * 2 + 0];
-			const float right = addr[i * 2 + 1];
-			g_surmx.mixdata[i * 8 + 0] += left;
-			g_surmx.mixdata[i * 8 + 1] += right;
+			const __m128 lr = load_be_ps(src + i * 2);
+			mix_frame_front(dst + (i + 0) * 8, _mm_and_ps(lr, lr_mask));
+			mix_frame_front(dst + (i + 1) * 8, _mm_and_ps(_mm_movehl_ps(lr, lr), lr_mask));
 		}
 	}
 	else if (type == CELL_SURMIXER_CHSTRIP_TYPE6A)
 	{
-		// 5.1 upmixing
+		// 5.1 upmixing (L, R, C, LFE | RL, RR)
 		for (u32 i = 0; i < samples; i++)
 		{
-			const float left = addr[i * 6 + 0];
-			const float right = addr[i * 6 + 1];
-			const float center = addr[i * 6 + 2];
-			const float low_freq = addr[i * 6 + 3];
-			const float rear_left = addr[i * 6 + 4];
-			const float rear_right = addr[i * 6 + 5];
-			g_surmx.mixdata[i * 8 + 0] += left;
-			g_surmx.mixdata[i * 8 + 1] += right;
-			g_surmx.mixdata[i * 8 + 2] += center;
-			g_surmx.mixdata[i * 8 + 3] += low_freq;
-			g_surmx.mixdata[i * 8 + 4] += rear_left;
-			g_surmx.mixdata[i * 8 + 5] += rear_right;
+			mix_frame_front(dst + i * 8, load_be_ps(src + i * 6));
+			mix_frame_front(dst + i * 8 + 4, load_be_ps2(src + i * 6 + 4));
 		}
 	}
 	else if (type == CELL_SURMIXER_CHSTRIP_TYPE8A)
 	{
 		// 7.1
-		for (u32 i = 0; i < samples * 8; i++)
+		for (u32 i = 0; i < samples * 8; i += 4)
 		{
-			g_surmx.mixdata[i] += addr[i];
+			mix_frame_front(dst + i, load_be_ps(src + i));
 		}
 	}
 
@@ -331,9 +345,11 @@ s32 cellSurMixerCreate(vm::cptr<CellSurMixerConfig> config)
 		{
 			CHECK_EMU_STATUS;
 
+			const u64 events = g_audio.mixed.get();
+
 			if (g_surmx.mixcount > (port.tag + 0)) // adding positive value (1-15): preemptive buffer filling (hack)
 			{
-				std::this_thread::sleep_for(std::chrono::milliseconds(1)); // hack
+				g_audio.mixed.wait(events);
 				continue;
 			}
 
@@ -358,6 +374,7 @@ s32 cellSurMixerCreate(vm::cptr<CellSurMixerConfig> config)
 						float left = 0.0f;
 						float right = 0.0f;
 						float speed = fabs(p.m_speed);
+						const float scale = p.m_level / 0x8000;
 						float fpos = 0.0f;
 						for (s32 i = 0; i < 256; i++) if (p.m_active)
 						{
@@ -392,12 +409,12 @@ s32 cellSurMixerCreate(vm::cptr<CellSurMixerConfig> config)
 							p.m_position += (u32)pos_inc;
 							if (p.m_channels == 1) // get mono data
 							{
-								left = right = (float)v[pos] / 0x8000 * p.m_level;
+								left = right = (float)v[pos] * scale;
 							}
 							else if (p.m_channels == 2) // get stereo data
 							{
-								left = (float)v[pos * 2 + 0] / 0x8000 * p.m_level;
-								right = (float)v[pos * 2 + 1] / 0x8000 * p.m_level;
+								left = (float)v[pos * 2 + 0] * scale;
+								right = (float)v[pos * 2 + 1] * scale;
 							}
 							if (p.m_connected) // mix
 							{
@@ -430,10 +447,10 @@ s32 cellSurMixerCreate(vm::cptr<CellSurMixerConfig> config)
 
 				auto buf = vm::_ptr<f32>(port.addr + (g_surmx.mixcount % port.block) * port.channel * AUDIO_SAMPLES * sizeof(float));
 
-				for (auto& mixdata : g_surmx.mixdata)
+				for (u32 i = 0; i < 8 * 256; i += 4)
 				{
 					// reverse byte order
-					*buf++ = mixdata;
+					store_be_ps(buf + i, _mm_load_ps(g_surmx.mixdata + i));
 				}
 
 				//u64 stamp3 = get_system_time();
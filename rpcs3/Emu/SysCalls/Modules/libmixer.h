@@ -181,7 +181,7 @@ struct SurMixerConfig
 	vm::ptr<CellSurMixerNotifyCallbackFunction> cb;
 	vm::ptr<void> cb_arg;
 
-	f32 mixdata[8 * 256];
+	alignas(16) f32 mixdata[8 * 256];
 	u64 mixcount;
 };
 
@@ -15,7 +15,14 @@ s32 sys_lwcond_create(vm::ptr<sys_lwcond_t> lwcond, vm::ptr<sys_lwmutex_t> lwmut
 {
 	sysPrxForUser.warning("sys_lwcond_create(lwcond=*0x%x, lwmutex=*0x%x, attr=*0x%x)", lwcond, lwmutex, attr);
 
-	lwcond->lwcond_queue = idm::make<lv2_lwcond_t>(reinterpret_cast<u64&>(attr->name));
+	const auto mutex = idm::get<lv2_lwmutex_t>(lwmutex->sleep_queue);
+
+	if (!mutex)
+	{
+		return CELL_ESRCH;
+	}
+
+	lwcond->lwcond_queue = idm::make<lv2_lwcond_t>(mutex, reinterpret_cast<u64&>(attr->name));
 	lwcond->lwmutex = lwmutex;
 
 	return CELL_OK;
@@ -229,6 +236,9 @@ s32 sys_lwcond_wait(PPUThread& ppu, vm::ptr<sys_lwcond_t> lwcond, u64 timeout)
 	lwmutex->vars.owner = lwmutex_reserved;
 	lwmutex->recursive_count = 0;
 
+	// threads waiting in user space must continue in the syscall
+	vm::notify_at(lwmutex.addr(), 8);
+
 	// call the syscall
 	s32 res = _sys_lwcond_queue_wait(ppu, lwcond->lwcond_queue, lwmutex->sleep_queue, timeout);
 
@@ -68,6 +68,9 @@ s32 sys_lwmutex_destroy(PPUThread& ppu, vm::ptr<sys_lwmutex_t> lwmutex)
 	// deleting succeeded
 	lwmutex->vars.owner.exchange(lwmutex_dead);
 
+	// wake threads waiting in user space
+	vm::notify_at(lwmutex.addr(), 8);
+
 	return CELL_OK;
 }
 
@@ -127,6 +130,27 @@ s32 sys_lwmutex_lock(PPUThread& ppu, vm::ptr<sys_lwmutex_t> lwmutex, u64 timeout
 		}
 	}
 
+	if (!timeout)
+	{
+		// wait in user space while the mutex is owned by another thread, the kernel is only entered if the owner
+		// is lwmutex_reserved (ownership is passed through the syscalls); notified by sys_lwmutex_unlock()
+		be_t<u32> old = tid;
+
+		vm::wait_op(ppu, lwmutex.addr(), 8, WRAP_EXPR((old = lwmutex->vars.owner.compare_and_swap(lwmutex_free, tid)) == lwmutex_free || old == lwmutex_reserved || old == lwmutex_dead));
+
+		if (old == lwmutex_free)
+		{
+			// locking succeeded
+			return CELL_OK;
+		}
+
+		if (old == lwmutex_dead)
+		{
+			// deleted while waiting
+			return CELL_EINVAL;
+		}
+	}
+
 	// atomically increment waiter value using 64 bit op
 	lwmutex->all_info++;
 
@@ -255,7 +279,9 @@ s32 sys_lwmutex_unlock(PPUThread& ppu, vm::ptr<sys_lwmutex_t> lwmutex)
 	// ensure that waiter is zero
 	if (lwmutex->lock_var.compare_and_swap_test({ tid, 0 }, { lwmutex_free, 0 }))
 	{
-		// unlocking succeeded
+		// unlocking succeeded, pass the mutex to a thread waiting in user space (if any)
+		vm::notify_at(lwmutex.addr(), 8);
+
 		return CELL_OK;
 	}
 
@@ -267,6 +293,9 @@ s32 sys_lwmutex_unlock(PPUThread& ppu, vm::ptr<sys_lwmutex_t> lwmutex)
 	// set special value
 	lwmutex->vars.owner.exchange(lwmutex_reserved);
 
+	// threads waiting in user space must continue in the syscall
+	vm::notify_at(lwmutex.addr(), 8);
+
 	// call the syscall
 	if (_sys_lwmutex_unlock(lwmutex->sleep_queue) == CELL_ESRCH)
 	{
@@ -280,7 +309,7 @@ void sysPrxForUser_sys_lwmutex_init()
 {
 	REG_FUNC(sysPrxForUser, sys_lwmutex_create);
 	REG_FUNC(sysPrxForUser, sys_lwmutex_destroy);
-	REG_FUNC(sysPrxForUser, sys_lwmutex_lock);
-	REG_FUNC(sysPrxForUser, sys_lwmutex_trylock);
-	REG_FUNC(sysPrxForUser, sys_lwmutex_unlock);
+	REG_FUNC(sysPrxForUser, sys_lwmutex_lock, MFF_DIRECT_CALL);
+	REG_FUNC(sysPrxForUser, sys_lwmutex_trylock, MFF_DIRECT_CALL);
+	REG_FUNC(sysPrxForUser, sys_lwmutex_unlock, MFF_DIRECT_CALL);
 }
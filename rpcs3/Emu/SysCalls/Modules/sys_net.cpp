@@ -1,5 +1,7 @@
 #include "stdafx.h"
 #include "Emu/Memory/Memory.h"
+#include "Emu/System.h"
+#include "Emu/IdManager.h"
 #include "Emu/SysCalls/Modules.h"
 
 #include "sys_net.h"
@@ -16,14 +18,272 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#endif
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #endif
 
 extern Module<> libnet;
 
+extern u64 get_system_time();
+
+struct socket_entry_t
+{
+	s64 native;
+	bool nbio; // guest non-blocking mode (host sockets are always non-blocking)
+	s64 rcvtimeo; // guest receive timeout (us, -1 if not set)
+	s64 sndtimeo; // guest send timeout (us, -1 if not set)
+};
+
 // We map host sockets to sequential IDs to return as FDs because syscalls using
 // socketselect(), etc. expect socket FDs to be under 1024.
 // We start at 1 because 0 is an invalid socket.
-std::vector<s64> g_socketMap{ 0 };
+std::vector<socket_entry_t> g_socketMap{ { 0, false, -1, -1 } };
+
+// Host network reactor. Guest blocking calls and socketselect()/socketpoll() wait for the readiness of
+// non-blocking host sockets instead of blocking in host calls, so the waits can be interrupted (emulation stop)
+// and many sockets are served without a host thread per blocked call.
+// On Linux a single thread waits on an edge-triggered epoll set of all guest sockets and wakes up only the waiters
+// interested in the ready sockets. Elsewhere the waiters poll their sockets themselves in short slices.
+class net_reactor_t final
+{
+	struct waiter_t
+	{
+		const ::pollfd* fds;
+		std::size_t count;
+		std::condition_variable cv;
+		bool signaled;
+	};
+
+	std::mutex m_mutex;
+	std::vector<waiter_t*> m_waiters;
+
+#ifdef __linux__
+	int m_epoll = -1;
+	int m_event = -1; // eventfd to stop the thread
+	std::shared_ptr<thread_ctrl> m_thread;
+
+	void work()
+	{
+		std::array<::epoll_event, 64> events;
+
+		while (true)
+		{
+			const int count = ::epoll_wait(m_epoll, events.data(), static_cast<int>(events.size()), -1);
+
+			if (count < 0)
+			{
+				if (errno == EINTR)
+				{
+					continue;
+				}
+
+				throw EXCEPTION("epoll_wait() failed (errno=%d)", errno);
+			}
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			for (int i = 0; i < count; i++)
+			{
+				if (events[i].data.fd == m_event)
+				{
+					return;
+				}
+
+				for (auto waiter : m_waiters)
+				{
+					for (std::size_t j = 0; j < waiter->count; j++)
+					{
+						if (waiter->fds[j].fd == events[i].data.fd)
+						{
+							waiter->signaled = true;
+							waiter->cv.notify_one();
+							break;
+						}
+					}
+				}
+			}
+		}
+	}
+#endif
+
+	static s32 native_poll(::pollfd* fds, std::size_t count, s32 timeout_ms)
+	{
+#ifdef _WIN32
+		return count ? ::WSAPoll(fds, static_cast<ULONG>(count), timeout_ms) : 0;
+#else
+		return ::poll(fds, static_cast<nfds_t>(count), timeout_ms);
+#endif
+	}
+
+public:
+	net_reactor_t()
+	{
+#ifdef __linux__
+		m_epoll = ::epoll_create1(EPOLL_CLOEXEC);
+		m_event = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+		if (m_epoll < 0 || m_event < 0)
+		{
+			throw EXCEPTION("Failed to create epoll instance (errno=%d)", errno);
+		}
+
+		::epoll_event event{};
+		event.events = EPOLLIN;
+		event.data.fd = m_event;
+		::epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_event, &event);
+
+		m_thread = thread_ctrl::spawn(PURE_EXPR("Network Reactor"s), [this] { work(); });
+#endif
+	}
+
+	net_reactor_t(const net_reactor_t&) = delete;
+
+	~net_reactor_t()
+	{
+#ifdef __linux__
+		const u64 value = 1;
+		::write(m_event, &value, sizeof(value));
+
+		m_thread->join();
+
+		::close(m_event);
+		::close(m_epoll);
+#endif
+	}
+
+	// Register host socket (must be non-blocking)
+	void add(s64 sock)
+	{
+#ifdef __linux__
+		::epoll_event event{};
+		event.events = EPOLLIN | EPOLLOUT | EPOLLPRI | EPOLLRDHUP | EPOLLET;
+		event.data.fd = static_cast<int>(sock);
+		::epoll_ctl(m_epoll, EPOLL_CTL_ADD, static_cast<int>(sock), &event);
+#endif
+	}
+
+	// Unregister host socket (before closing)
+	void remove(s64 sock)
+	{
+#ifdef __linux__
+		::epoll_ctl(m_epoll, EPOLL_CTL_DEL, static_cast<int>(sock), nullptr);
+#endif
+	}
+
+	// Wait until any socket is ready like poll() (timeout in us, -1 = infinite), returns the result of the last poll()
+	s32 wait(::pollfd* fds, std::size_t count, s64 timeout)
+	{
+		const u64 start_time = get_system_time();
+
+		waiter_t waiter{ fds, count };
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		m_waiters.emplace_back(&waiter);
+
+		// unregister even if the emulation is stopped
+		auto unregister = [&]
+		{
+			m_waiters.erase(std::find(m_waiters.begin(), m_waiters.end(), &waiter));
+		};
+
+		while (true)
+		{
+			if (Emu.IsStopped())
+			{
+				unregister();
+				throw EmulationStopped{};
+			}
+
+			waiter.signaled = false;
+
+			lock.unlock();
+			const s32 result = native_poll(fds, count, 0);
+			lock.lock();
+
+			const u64 passed = get_system_time() - start_time;
+
+			if (result || (timeout >= 0 && passed >= static_cast<u64>(timeout)))
+			{
+				unregister();
+				return result;
+			}
+
+			// wake up periodically to check the emulation status
+			const u64 slice = timeout >= 0 ? std::min<u64>(timeout - passed, 10000) : 10000;
+
+#ifdef __linux__
+			waiter.cv.wait_for(lock, std::chrono::microseconds(slice), [&] { return waiter.signaled; });
+#else
+			lock.unlock();
+
+			if (count)
+			{
+				native_poll(fds, count, static_cast<s32>((slice + 999) / 1000));
+			}
+			else
+			{
+				std::this_thread::sleep_for(std::chrono::microseconds(slice));
+			}
+
+			lock.lock();
+#endif
+		}
+	}
+};
+
+// Set host socket to non-blocking mode (guest blocking mode is emulated with net_reactor_t)
+static void set_native_nonblocking(s64 sock)
+{
+#ifdef _WIN32
+	u_long mode = 1;
+	::ioctlsocket(sock, FIONBIO, &mode);
+#else
+	::fcntl(sock, F_SETFL, ::fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+#endif
+}
+
+static bool native_would_block()
+{
+#ifdef _WIN32
+	const int error = WSAGetLastError();
+	return error == WSAEWOULDBLOCK || error == WSAEINPROGRESS;
+#else
+	return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINPROGRESS;
+#endif
+}
+
+// Convert guest poll events to host and back (the values differ on Windows)
+static s16 get_native_events(s16 events)
+{
+	return
+		(events & SYS_NET_POLLIN ? POLLIN : 0) |
+#ifndef _WIN32
+		(events & SYS_NET_POLLPRI ? POLLPRI : 0) | // not allowed by WSAPoll
+#endif
+		(events & SYS_NET_POLLOUT ? POLLOUT : 0);
+}
+
+static s16 get_guest_events(s16 revents)
+{
+	return
+		(revents & POLLIN ? SYS_NET_POLLIN : 0) |
+		(revents & POLLPRI ? SYS_NET_POLLPRI : 0) |
+		(revents & POLLOUT ? SYS_NET_POLLOUT : 0) |
+		(revents & POLLERR ? SYS_NET_POLLERR : 0) |
+		(revents & POLLHUP ? SYS_NET_POLLHUP : 0) |
+		(revents & POLLNVAL ? SYS_NET_POLLNVAL : 0);
+}
+
+static bool is_valid_socket(s32 s)
+{
+	return s > 0 && static_cast<u32>(s) < g_socketMap.size() && g_socketMap[s].native != -1;
+}
 
 // Auxiliary Functions
 int inet_pton4(const char *src, char *dst)
@@ -89,30 +349,6 @@ s32 getLastError()
 #endif
 }
 
-void copy_fdset(fd_set* set, vm::ptr<sys_net::fd_set> src)
-{
-	FD_ZERO(set);
-
-	if (src)
-	{
-		// Go through the bit set fds_bits and calculate the
-		// socket FDs from it, setting it in the native fd-set.
-
-		for (int i = 0; i < 32; i++)
-		{
-			for (int bit = 0; bit < 32; bit++)
-			{
-				if (src->fds_bits[i] & (1 << bit))
-				{
-					u32 sock = (i << 5) | bit;
-					//libnet.error("setting: fd %d", sock);
-					FD_SET(g_socketMap[sock], set);
-				}
-			}
-		}
-	}
-}
-
 namespace sys_net
 {
 	struct _tls_data_t
@@ -124,6 +360,8 @@ namespace sys_net
 	// TODO
 	thread_local vm::ptr<_tls_data_t> g_tls_net_data{};
 
+	const fiber_tls_t g_fiber_tls_net_data([]() -> void* { return &g_tls_net_data; }, sizeof(g_tls_net_data));
+
 	static void initialize_tls()
 	{
 		// allocate if not initialized
@@ -152,33 +390,84 @@ namespace sys_net
 		return g_tls_net_data.ref(&_tls_data_t::_h_errno);
 	}
 
+	// Copy host address to guest sockaddr
+	static void copy_sockaddr(vm::ptr<sockaddr> dst, const ::sockaddr& src)
+	{
+		dst->sa_len = sizeof(sockaddr);
+		dst->sa_family = static_cast<u8>(src.sa_family);
+		memcpy(dst->sa_data, src.sa_data, sizeof(dst->sa_data));
+	}
+
+	// Repeat the operation on the non-blocking host socket until it doesn't block, waiting for the readiness between attempts.
+	// Returns EWOULDBLOCK if the guest socket is non-blocking or the guest timeout (SO_RCVTIMEO or SO_SNDTIMEO) expired.
+	template<typename F>
+	static s32 call_blocking(s32 s, bool is_send, F&& op)
+	{
+		if (!is_valid_socket(s))
+		{
+			get_errno() = SYS_NET_EBADF;
+			return -1;
+		}
+
+		const auto sock = g_socketMap[s];
+
+		while (true)
+		{
+			const s32 ret = op(sock.native);
+
+			if (ret >= 0 || !native_would_block())
+			{
+				get_errno() = getLastError();
+				return ret;
+			}
+
+			::pollfd pfd{};
+			pfd.fd = sock.native;
+			pfd.events = is_send ? POLLOUT : POLLIN;
+
+			if (sock.nbio || !fxm::get_always<net_reactor_t>()->wait(&pfd, 1, is_send ? sock.sndtimeo : sock.rcvtimeo))
+			{
+				get_errno() = SYS_NET_EWOULDBLOCK;
+				return -1;
+			}
+		}
+	}
+
 	// Functions
 	s32 accept(s32 s, vm::ptr<sockaddr> addr, vm::ptr<u32> paddrlen)
 	{
 		libnet.warning("accept(s=%d, family=*0x%x, paddrlen=*0x%x)", s, addr, paddrlen);
-		s = g_socketMap[s];
 
-		if (!addr) {
-			int ret = ::accept(s, nullptr, nullptr);
-			get_errno() = getLastError();
+		::sockaddr _addr;
+		::socklen_t _paddrlen = sizeof(::sockaddr);
+
+		const s32 ret = call_blocking(s, false, [&](s64 sock)
+		{
+			return static_cast<s32>(::accept(sock, &_addr, &_paddrlen));
+		});
+
+		if (ret < 0)
+		{
 			return ret;
 		}
-		else {
-			::sockaddr _addr;
-			memcpy(&_addr, addr.get_ptr(), sizeof(::sockaddr));
-			_addr.sa_family = addr->sa_family;
-			::socklen_t _paddrlen;
-			s32 ret = ::accept(s, &_addr, &_paddrlen);
+
+		if (addr)
+		{
+			copy_sockaddr(addr, _addr);
 			*paddrlen = _paddrlen;
-			get_errno() = getLastError();
-			return ret;
 		}
+
+		set_native_nonblocking(ret);
+		fxm::get_always<net_reactor_t>()->add(ret);
+
+		g_socketMap.push_back({ ret, false, -1, -1 });
+		return g_socketMap.size() - 1;
 	}
 
 	s32 bind(s32 s, vm::cptr<sockaddr> addr, u32 addrlen)
 	{
 		libnet.warning("bind(s=%d, family=*0x%x, addrlen=%d)", s, addr, addrlen);
-		s = g_socketMap[s];
+		s = g_socketMap[s].native;
 
 		::sockaddr_in saddr;
 		memcpy(&saddr, addr.get_ptr(), sizeof(::sockaddr_in));
@@ -194,17 +483,55 @@ namespace sys_net
 	s32 connect(s32 s, vm::ptr<sockaddr> addr, u32 addrlen)
 	{
 		libnet.warning("connect(s=%d, family=*0x%x, addrlen=%d)", s, addr, addrlen);
-		s = g_socketMap[s];
+
+		if (!is_valid_socket(s))
+		{
+			get_errno() = SYS_NET_EBADF;
+			return -1;
+		}
+
+		const auto sock = g_socketMap[s];
 
 		::sockaddr_in saddr;
 		memcpy(&saddr, addr.get_ptr(), sizeof(::sockaddr_in));
 		saddr.sin_family = addr->sa_family;
 		const char *ipaddr = ::inet_ntoa(saddr.sin_addr);
 		libnet.warning("connecting on %s to port %d", ipaddr, ntohs(saddr.sin_port));
-		s32 ret = ::connect(s, (const ::sockaddr*)&saddr, addrlen);
-		get_errno() = getLastError();
+		s32 ret = ::connect(sock.native, (const ::sockaddr*)&saddr, addrlen);
 
-		return ret;
+		if (ret == 0 || !native_would_block())
+		{
+			get_errno() = getLastError();
+			return ret;
+		}
+
+		if (sock.nbio)
+		{
+			get_errno() = SYS_NET_EINPROGRESS;
+			return -1;
+		}
+
+		// wait until the connection is established or failed
+		::pollfd pfd{};
+		pfd.fd = sock.native;
+		pfd.events = POLLOUT;
+		fxm::get_always<net_reactor_t>()->wait(&pfd, 1, -1);
+
+		int error = 0;
+		::socklen_t len = sizeof(error);
+		::getsockopt(sock.native, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&error), &len);
+
+		if (error)
+		{
+#ifdef _WIN32
+			get_errno() = error > 10000 && error < 11000 ? error % 10000 : -1;
+#else
+			get_errno() = error;
+#endif
+			return -1;
+		}
+
+		return CELL_OK;
 	}
 
 	s32 gethostbyaddr()
@@ -301,7 +628,7 @@ namespace sys_net
 	s32 listen(s32 s, s32 backlog)
 	{
 		libnet.warning("listen(s=%d, backlog=%d)", s, backlog);
-		s = g_socketMap[s];
+		s = g_socketMap[s].native;
 		s32 ret = ::listen(s, backlog);
 		get_errno() = getLastError();
 
@@ -311,26 +638,30 @@ namespace sys_net
 	s32 recv(s32 s, vm::ptr<char> buf, u32 len, s32 flags)
 	{
 		libnet.warning("recv(s=%d, buf=*0x%x, len=%d, flags=0x%x)", s, buf, len, flags);
-		s = g_socketMap[s];
-
-		s32 ret = ::recv(s, buf.get_ptr(), len, flags);
-		get_errno() = getLastError();
 
-		return ret;
+		return call_blocking(s, false, [&](s64 sock)
+		{
+			return static_cast<s32>(::recv(sock, buf.get_ptr(), len, flags));
+		});
 	}
 
 	s32 recvfrom(s32 s, vm::ptr<char> buf, u32 len, s32 flags, vm::ptr<sockaddr> addr, vm::ptr<u32> paddrlen)
 	{
 		libnet.warning("recvfrom(s=%d, buf=*0x%x, len=%d, flags=0x%x, addr=*0x%x, paddrlen=*0x%x)", s, buf, len, flags, addr, paddrlen);
-		s = g_socketMap[s];
 
 		::sockaddr _addr;
-		memcpy(&_addr, addr.get_ptr(), sizeof(::sockaddr));
-		_addr.sa_family = addr->sa_family;
-		::socklen_t _paddrlen;
-		s32 ret = ::recvfrom(s, buf.get_ptr(), len, flags, &_addr, &_paddrlen);
-		*paddrlen = _paddrlen;
-		get_errno() = getLastError();
+		::socklen_t _paddrlen = sizeof(::sockaddr);
+
+		const s32 ret = call_blocking(s, false, [&](s64 sock)
+		{
+			return static_cast<s32>(::recvfrom(sock, buf.get_ptr(), len, flags, &_addr, &_paddrlen));
+		});
+
+		if (ret >= 0 && addr)
+		{
+			copy_sockaddr(addr, _addr);
+			*paddrlen = _paddrlen;
+		}
 
 		return ret;
 	}
@@ -344,12 +675,11 @@ namespace sys_net
 	s32 send(s32 s, vm::cptr<char> buf, u32 len, s32 flags)
 	{
 		libnet.warning("send(s=%d, buf=*0x%x, len=%d, flags=0x%x)", s, buf, len, flags);
-		s = g_socketMap[s];
 
-		s32 ret = ::send(s, buf.get_ptr(), len, flags);
-		get_errno() = getLastError();
-
-		return ret;
+		return call_blocking(s, true, [&](s64 sock)
+		{
+			return static_cast<s32>(::send(sock, buf.get_ptr(), len, flags));
+		});
 	}
 
 	s32 sendmsg()
@@ -361,21 +691,51 @@ namespace sys_net
 	s32 sendto(s32 s, vm::cptr<char> buf, u32 len, s32 flags, vm::ptr<sockaddr> addr, u32 addrlen)
 	{
 		libnet.warning("sendto(s=%d, buf=*0x%x, len=%d, flags=0x%x, addr=*0x%x, addrlen=%d)", s, buf, len, flags, addr, addrlen);
-		s = g_socketMap[s];
 
 		::sockaddr _addr;
 		memcpy(&_addr, addr.get_ptr(), sizeof(::sockaddr));
 		_addr.sa_family = addr->sa_family;
-		s32 ret = ::sendto(s, buf.get_ptr(), len, flags, &_addr, addrlen);
-		get_errno() = getLastError();
 
-		return ret;
+		return call_blocking(s, true, [&](s64 sock)
+		{
+			return static_cast<s32>(::sendto(sock, buf.get_ptr(), len, flags, &_addr, addrlen));
+		});
 	}
 
 	s32 setsockopt(s32 s, s32 level, s32 optname, vm::cptr<char> optval, u32 optlen)
 	{
 		libnet.warning("socket(s=%d, level=%d, optname=%d, optval=*0x%x, optlen=%d)", s, level, optname, optval, optlen);
-		s = g_socketMap[s];
+
+		if (!is_valid_socket(s))
+		{
+			get_errno() = SYS_NET_EBADF;
+			return -1;
+		}
+
+		// blocking mode and timeouts are emulated (host sockets are always non-blocking)
+		if (level == SYS_NET_SOL_SOCKET)
+		{
+			switch (optname)
+			{
+			case SYS_NET_SO_NBIO:
+			{
+				g_socketMap[s].nbio = *vm::cptr<s32>{ optval.addr(), vm::addr } != 0;
+				return CELL_OK;
+			}
+
+			case SYS_NET_SO_RCVTIMEO:
+			case SYS_NET_SO_SNDTIMEO:
+			{
+				const vm::cptr<timeval> tv{ optval.addr(), vm::addr };
+				const s64 usec = tv->tv_sec * 1000000 + tv->tv_usec;
+
+				(optname == SYS_NET_SO_RCVTIMEO ? g_socketMap[s].rcvtimeo : g_socketMap[s].sndtimeo) = usec ? usec : -1;
+				return CELL_OK;
+			}
+			}
+		}
+
+		s = g_socketMap[s].native;
 
 		s32 ret = ::setsockopt(s, level, optname, optval.get_ptr(), optlen);
 		get_errno() = getLastError();
@@ -386,7 +746,7 @@ namespace sys_net
 	s32 shutdown(s32 s, s32 how)
 	{
 		libnet.warning("shutdown(s=%d, how=%d)", s, how);
-		s = g_socketMap[s];
+		s = g_socketMap[s].native;
 
 		s32 ret = ::shutdown(s, how);
 		get_errno() = getLastError();
@@ -401,14 +761,33 @@ namespace sys_net
 		s32 sock = ::socket(family, type, protocol);
 		get_errno() = getLastError();
 
-		g_socketMap.push_back(sock);
+		if (sock < 0)
+		{
+			return -1;
+		}
+
+		set_native_nonblocking(sock);
+		fxm::get_always<net_reactor_t>()->add(sock);
+
+		g_socketMap.push_back({ sock, false, -1, -1 });
 		return g_socketMap.size() - 1;
 	}
 
 	s32 socketclose(s32 s)
 	{
 		libnet.warning("socket(s=%d)", s);
-		s = g_socketMap[s];
+
+		if (!is_valid_socket(s))
+		{
+			get_errno() = SYS_NET_EBADF;
+			return -1;
+		}
+
+		fxm::get_always<net_reactor_t>()->remove(g_socketMap[s].native);
+
+		const s64 sock = g_socketMap[s].native;
+		g_socketMap[s].native = -1;
+		s = static_cast<s32>(sock);
 
 #ifdef _WIN32
 		int ret = ::closesocket(s);
@@ -419,45 +798,147 @@ namespace sys_net
 		return ret;
 	}
 
-	s32 socketpoll()
+	s32 socketpoll(vm::ptr<pollfd> fds, s32 nfds, s32 ms)
 	{
-		UNIMPLEMENTED_FUNC(libnet);
-		return CELL_OK;
+		libnet.warning("socketpoll(fds=*0x%x, nfds=%d, ms=%d)", fds, nfds, ms);
+
+		std::vector<::pollfd> _fds;
+		std::vector<s32> index; // guest pollfd index of each host pollfd
+
+		s32 count = 0;
+
+		for (s32 i = 0; i < nfds; i++)
+		{
+			const s32 fd = fds[i].fd;
+
+			fds[i].revents = 0;
+
+			if (fd < 0)
+			{
+				continue;
+			}
+
+			if (!is_valid_socket(fd))
+			{
+				fds[i].revents = SYS_NET_POLLNVAL;
+				count++;
+				continue;
+			}
+
+			::pollfd pfd{};
+			pfd.fd = g_socketMap[fd].native;
+			pfd.events = get_native_events(fds[i].events);
+			_fds.push_back(pfd);
+			index.push_back(i);
+		}
+
+		// don't wait if some descriptors are already invalid
+		const s32 ret = fxm::get_always<net_reactor_t>()->wait(_fds.data(), _fds.size(), count ? 0 : ms < 0 ? -1 : ms * 1000ll);
+
+		if (ret < 0)
+		{
+			get_errno() = getLastError();
+			return -1;
+		}
+
+		for (std::size_t i = 0; i < _fds.size(); i++)
+		{
+			if (const s16 revents = get_guest_events(_fds[i].revents))
+			{
+				fds[index[i]].revents = revents;
+				count++;
+			}
+		}
+
+		return count;
 	}
 
 	s32 socketselect(s32 nfds, vm::ptr<fd_set> readfds, vm::ptr<fd_set> writefds, vm::ptr<fd_set> exceptfds, vm::ptr<timeval> timeout)
 	{
 		libnet.warning("socketselect(nfds=%d, readfds=*0x%x, writefds=*0x%x, exceptfds=*0x%x, timeout=*0x%x)", nfds, readfds, writefds, exceptfds, timeout);
 
-		::timeval _timeout;
+		std::vector<::pollfd> fds;
+		std::vector<s32> socks; // guest socket of each host pollfd
+		std::vector<s16> requested; // guest events of each host pollfd
+
+		const auto is_set = [](vm::ptr<fd_set> set, s32 s)
+		{
+			return set && (set->fds_bits[s >> 5] & (1u << (s & 31))) != 0;
+		};
 
-		if (timeout)
+		// translate fd_sets to the list of sockets
+		for (s32 s = 0; s < std::min<s32>(nfds, 1024); s++)
 		{
-			_timeout.tv_sec = timeout->tv_sec;
-			_timeout.tv_usec = timeout->tv_usec;
+			const s16 events =
+				(is_set(readfds, s) ? SYS_NET_POLLIN : 0) |
+				(is_set(writefds, s) ? SYS_NET_POLLOUT : 0) |
+				(is_set(exceptfds, s) ? SYS_NET_POLLPRI : 0);
+
+			if (!events)
+			{
+				continue;
+			}
+
+			if (!is_valid_socket(s))
+			{
+				get_errno() = SYS_NET_EBADF;
+				return -1;
+			}
+
+			::pollfd pfd{};
+			pfd.fd = g_socketMap[s].native;
+			pfd.events = get_native_events(events);
+			fds.push_back(pfd);
+			socks.push_back(s);
+			requested.push_back(events);
 		}
 
-		//libnet.error("timeval: %d . %d", _timeout.tv_sec, _timeout.tv_usec);
+		const s64 wait_time = timeout ? timeout->tv_sec * 1000000 + timeout->tv_usec : -1;
 
-		::fd_set _readfds;
-		::fd_set _writefds;
-		::fd_set _exceptfds;
+		const s32 ret = fxm::get_always<net_reactor_t>()->wait(fds.data(), fds.size(), wait_time);
 
-		// Copy the fd_sets to native ones
-		copy_fdset(&_readfds, readfds);
-		copy_fdset(&_writefds, writefds);
-		copy_fdset(&_exceptfds, exceptfds);
+		if (ret < 0)
+		{
+			get_errno() = getLastError();
+			return -1;
+		}
 
-		s32 ret = ::select(nfds, &_readfds, &_writefds, &_exceptfds, timeout ? &_timeout : NULL);
-		get_errno() = getLastError();
+		// write back ready sockets only
+		for (auto set : { readfds, writefds, exceptfds })
+		{
+			if (set)
+			{
+				memset(set.get_ptr(), 0, sizeof(fd_set));
+			}
+		}
+
+		s32 count = 0;
 
-		if (getLastError() >= 0)
+		for (std::size_t i = 0; i < fds.size(); i++)
 		{
-			libnet.error("socketselect(): error %d", getLastError());
+			const s16 revents = get_guest_events(fds[i].revents);
+			const s32 s = socks[i];
+
+			if (requested[i] & SYS_NET_POLLIN && revents & (SYS_NET_POLLIN | SYS_NET_POLLHUP | SYS_NET_POLLERR))
+			{
+				readfds->fds_bits[s >> 5] |= 1u << (s & 31);
+				count++;
+			}
+
+			if (requested[i] & SYS_NET_POLLOUT && revents & (SYS_NET_POLLOUT | SYS_NET_POLLERR))
+			{
+				writefds->fds_bits[s >> 5] |= 1u << (s & 31);
+				count++;
+			}
+
+			if (requested[i] & SYS_NET_POLLPRI && revents & SYS_NET_POLLPRI)
+			{
+				exceptfds->fds_bits[s >> 5] |= 1u << (s & 31);
+				count++;
+			}
 		}
 
-		//return ret;
-		return CELL_OK;
+		return count;
 	}
 
 	s32 sys_net_initialize_network_ex(vm::ptr<sys_net_initialize_parameter_t> param)
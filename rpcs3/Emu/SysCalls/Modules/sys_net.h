@@ -114,6 +114,34 @@ namespace sys_net
 	};
 }
 
+// Socket options handled by the emulator
+enum
+{
+	SYS_NET_SOL_SOCKET  = 0xffff,
+	SYS_NET_SO_SNDTIMEO = 0x1005,
+	SYS_NET_SO_RCVTIMEO = 0x1006,
+	SYS_NET_SO_NBIO     = 0x1100,
+};
+
+// Error codes (errno)
+enum
+{
+	SYS_NET_EBADF       = 9,
+	SYS_NET_EWOULDBLOCK = 35,
+	SYS_NET_EINPROGRESS = 36,
+};
+
+// Poll events
+enum : s16
+{
+	SYS_NET_POLLIN   = 0x0001,
+	SYS_NET_POLLPRI  = 0x0002,
+	SYS_NET_POLLOUT  = 0x0004,
+	SYS_NET_POLLERR  = 0x0008,
+	SYS_NET_POLLHUP  = 0x0010,
+	SYS_NET_POLLNVAL = 0x0020,
+};
+
 struct sys_net_initialize_parameter_t
 {
 	vm::bptr<void> memory;
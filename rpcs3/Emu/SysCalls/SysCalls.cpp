@@ -1,8 +1,10 @@
 #include "stdafx.h"
 #include "Utilities/AutoPause.h"
+#include "Utilities/Trace.h"
 #include "Emu/Memory/Memory.h"
 #include "Emu/System.h"
 #include "Emu/state.h"
+#include "Emu/PerfCounters.h"
 #include "Modules.h"
 
 #include "lv2/sys_lwmutex.h"
@@ -890,21 +892,117 @@ const ppu_func_caller g_sc_table[1024] =
 	null_func, null_func, null_func, BIND_FUNC(cellGcmCallback), //1023  UNS
 };
 
+// Syscall call count and cumulative host time ("Syscall Statistics" option)
+struct syscall_stats_t
+{
+	std::atomic<u64> calls;
+	std::atomic<u64> time; // ns
+};
+
+static syscall_stats_t g_sc_stats[1024];
+
+// Features of the debug dispatch, selected by init_syscall_dispatch
+static bool g_sc_trace = false;
+static bool g_sc_auto_pause = false;
+static bool g_sc_stats_enabled = false;
+
+static void execute_syscall_fast(PPUThread& ppu, u64 code)
+{
+	g_sc_table[code](ppu);
+}
+
+static void execute_syscall_debug(PPUThread& ppu, u64 code)
+{
+	if (g_sc_auto_pause)
+	{
+		Debug::AutoPause::getInstance().TryPause(static_cast<u32>(code));
+	}
+
+	if (g_sc_trace)
+	{
+		LOG_TRACE(PPU, "Syscall %lld called: %s", code, get_ps3_function_name(~code));
+	}
+
+	const auto start = std::chrono::high_resolution_clock::now();
+
+	g_sc_table[code](ppu);
+
+	if (g_sc_stats_enabled)
+	{
+		g_sc_stats[code].calls++;
+		g_sc_stats[code].time += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	if (g_sc_trace)
+	{
+		LOG_TRACE(PPU, "Syscall %lld finished: %s -> 0x%llx", code, get_ps3_function_name(~code), ppu.GPR[3]);
+	}
+}
+
+// Tracing, auto-pause and statistics wrap the table call only when one of them is enabled
+static void(*g_sc_dispatch)(PPUThread& ppu, u64 code) = execute_syscall_fast;
+
+void init_syscall_dispatch()
+{
+	const auto& autopause = Debug::AutoPause::getInstance();
+
+	g_sc_trace = _log::PPU.enabled >= _log::level::trace;
+	g_sc_auto_pause = autopause.m_pause_syscall_enable && autopause.m_pause_syscall.size();
+	g_sc_stats_enabled = rpcs3::state.config.misc.debug.syscall_stats.value();
+
+	for (auto& stats : g_sc_stats)
+	{
+		stats.calls = 0;
+		stats.time = 0;
+	}
+
+	g_sc_dispatch = g_sc_trace || g_sc_auto_pause || g_sc_stats_enabled ? execute_syscall_debug : execute_syscall_fast;
+}
+
+void log_syscall_stats()
+{
+	if (!g_sc_stats_enabled)
+	{
+		return;
+	}
+
+	std::vector<std::pair<u64, u32>> list; // (time, syscall)
+
+	for (u32 i = 0; i < 1024; i++)
+	{
+		if (g_sc_stats[i].calls)
+		{
+			list.emplace_back(g_sc_stats[i].time, i);
+		}
+	}
+
+	std::sort(list.begin(), list.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+	LOG_NOTICE(PPU, "Syscall statistics (%u syscalls used):", size32(list));
+
+	for (auto& entry : list)
+	{
+		const u64 calls = g_sc_stats[entry.second].calls;
+
+		LOG_NOTICE(PPU, "%s: %llu calls, %llu us, %llu ns/call", get_ps3_function_name(~(u64)entry.second), calls, entry.first / 1000, entry.first / calls);
+	}
+}
+
 void execute_syscall_by_index(PPUThread& ppu, u64 code)
 {
 	if (code >= 1024)
 	{
 		throw EXCEPTION("Invalid syscall number (0x%llx)", code);
 	}
-	
-	auto last_code = ppu.hle_code;
-	ppu.hle_code = ~code;
 
-	LOG_TRACE(PPU, "Syscall %lld called: %s", code, get_ps3_function_name(~code));
+	_log::timeline_scope scope("lv2", "syscall", code);
 
-	g_sc_table[code](ppu);
+	perf::add(perf::syscalls);
+
+	auto last_code = ppu.hle_code;
+	ppu.hle_code = ~code;
 
-	LOG_TRACE(PPU, "Syscall %lld finished: %s -> 0x%llx", code, get_ps3_function_name(~code), ppu.GPR[3]);
+	g_sc_dispatch(ppu, code);
 
 	ppu.hle_code = last_code;
 }
@@ -0,0 +1,309 @@
+#include "stdafx.h"
+#include "Emu/System.h"
+
+#include "TimerWheel.h"
+
+extern u64 get_system_time();
+
+void lv2_timer_wheel_t::insert(item_t&& item)
+{
+	// expired items are put into the current tick
+	const u64 expire = std::max<u64>(item.deadline >> tick_shift, m_tick);
+	const u64 delta = expire - m_tick;
+
+	m_count++;
+
+	for (u32 level = 0; level < level_count; level++)
+	{
+		const u32 shift = level * slot_bits;
+
+		if (delta < 1ull << (shift + slot_bits))
+		{
+			m_slots[level][(expire >> shift) % slot_count].emplace_back(std::move(item));
+			return;
+		}
+	}
+
+	// too far, put into the last slot of the top level (will be reinserted when it's cascaded)
+	const u32 shift = (level_count - 1) * slot_bits;
+
+	m_slots[level_count - 1][((m_tick >> shift) + slot_count - 1) % slot_count].emplace_back(std::move(item));
+}
+
+void lv2_timer_wheel_t::cascade(u32 level, u64 index)
+{
+	auto items = std::move(m_slots[level][index]);
+
+	m_slots[level][index].clear();
+	m_count -= items.size();
+
+	for (auto& item : items)
+	{
+		// drop cancelled items
+		if (item.gen == item.entry->gen)
+		{
+			insert(std::move(item));
+		}
+	}
+}
+
+u64 lv2_timer_wheel_t::get_wakeup_time() const
+{
+	if (!m_count)
+	{
+		return 0;
+	}
+
+	// items of the current tick are fired at their exact deadline
+	u64 result = UINT64_MAX;
+
+	for (auto& item : m_slots[0][m_tick % slot_count])
+	{
+		if (item.gen == item.entry->gen)
+		{
+			result = std::min<u64>(result, item.deadline);
+		}
+	}
+
+	if (result != UINT64_MAX)
+	{
+		return result;
+	}
+
+	// find the next non-empty slot of the first level or the next slot to be cascaded
+	const u64 end = m_tick + (1ull << (level_count * slot_bits));
+
+	for (u64 t = m_tick + 1; t < end;)
+	{
+		for (u32 level = 1; level < level_count; level++)
+		{
+			const u32 shift = level * slot_bits;
+
+			if (t % (1ull << shift))
+			{
+				break;
+			}
+
+			if (m_slots[level][(t >> shift) % slot_count].size())
+			{
+				return t << tick_shift;
+			}
+		}
+
+		const u64 delta = t - m_tick;
+
+		if (delta < slot_count)
+		{
+			if (m_slots[0][t % slot_count].size())
+			{
+				return t << tick_shift;
+			}
+
+			t++;
+			continue;
+		}
+
+		// skip to the next boundary of the level which can still contain the items for it
+		u32 shift = slot_bits;
+
+		while (shift < (level_count - 1) * slot_bits && delta >= 1ull << (shift + slot_bits))
+		{
+			shift += slot_bits;
+		}
+
+		t = ((t >> shift) + 1) << shift;
+	}
+
+	return end << tick_shift;
+}
+
+void lv2_timer_wheel_t::work()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	std::vector<item_t> due;
+
+	while (!m_exit)
+	{
+		const u64 time = get_system_time();
+		const u64 wakeup = get_wakeup_time();
+
+		if (!wakeup || time < wakeup)
+		{
+			m_wakeup = wakeup ? wakeup : UINT64_MAX;
+
+			if (wakeup)
+			{
+				m_cv.wait_for(lock, std::chrono::microseconds(wakeup - time));
+			}
+			else
+			{
+				m_cv.wait(lock);
+			}
+
+			m_wakeup = 0;
+			continue;
+		}
+
+		const u64 tick = time >> tick_shift;
+
+		while (true)
+		{
+			// move items of the higher levels (starting from the top level)
+			for (u32 level = level_count - 1; level; level--)
+			{
+				const u32 shift = level * slot_bits;
+
+				if (m_tick % (1ull << shift) == 0)
+				{
+					cascade(level, (m_tick >> shift) % slot_count);
+				}
+			}
+
+			auto& slot = m_slots[0][m_tick % slot_count];
+
+			for (std::size_t i = 0; i < slot.size();)
+			{
+				auto& item = slot[i];
+
+				if (item.gen == item.entry->gen && item.deadline > time)
+				{
+					i++;
+					continue;
+				}
+
+				if (item.gen == item.entry->gen)
+				{
+					due.emplace_back(std::move(item));
+				}
+
+				item = std::move(slot.back());
+				slot.pop_back();
+				m_count--;
+			}
+
+			// the current tick is processed again until it's over
+			if (m_tick >= tick)
+			{
+				break;
+			}
+
+			m_tick++;
+		}
+
+		for (auto& item : due)
+		{
+			// may be cancelled or rescheduled by the previous callback
+			if (item.gen != item.entry->gen)
+			{
+				continue;
+			}
+
+			item.entry->firing = true;
+			lock.unlock();
+
+			try
+			{
+				item.entry->callback();
+			}
+			catch (...)
+			{
+				lock.lock();
+				item.entry->firing = false;
+				m_fired_cv.notify_all();
+				throw;
+			}
+
+			lock.lock();
+			item.entry->firing = false;
+			m_fired_cv.notify_all();
+		}
+
+		due.clear();
+	}
+}
+
+lv2_timer_wheel_t::~lv2_timer_wheel_t()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		m_exit = true;
+	}
+
+	m_cv.notify_one();
+
+	if (m_thread)
+	{
+		m_thread->join();
+	}
+}
+
+void lv2_timer_wheel_t::schedule(const std::shared_ptr<entry_t>& entry, u64 deadline)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (!m_count)
+	{
+		m_tick = get_system_time() >> tick_shift;
+	}
+
+	insert({ entry, deadline, ++entry->gen });
+
+	if (!m_thread)
+	{
+		// started thread waits for the lock
+		m_thread = thread_ctrl::spawn(PURE_EXPR("lv2 Timer Wheel"s), [this] { work(); });
+	}
+	else if (deadline < m_wakeup)
+	{
+		// wake up only if the timer thread sleeps longer than necessary
+		m_cv.notify_one();
+	}
+}
+
+void lv2_timer_wheel_t::cancel(const std::shared_ptr<entry_t>& entry)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	// the item is removed from its slot later
+	entry->gen++;
+}
+
+void lv2_timer_wheel_t::cancel(const std::shared_ptr<entry_t>& entry, std::unique_lock<std::mutex>& lock)
+{
+	std::unique_lock<std::mutex> wheel_lock(m_mutex);
+
+	entry->gen++;
+
+	if (entry->firing)
+	{
+		// the callback may be waiting for this lock
+		lock.unlock();
+
+		m_fired_cv.wait(wheel_lock, [&] { return !entry->firing; });
+
+		wheel_lock.unlock();
+		lock.lock();
+	}
+}
+
+void lv2_timer_wheel_t::wait_for(thread_cv_t& cv, std::unique_lock<std::mutex>& lock, u64 usec)
+{
+	const auto entry = std::make_shared<entry_t>();
+
+	entry->callback = [&cv, mutex = lock.mutex()]()
+	{
+		// the waiter is either not waiting yet (and will check the time) or will be notified
+		std::lock_guard<std::mutex> lock(*mutex);
+
+		cv.notify_one();
+	};
+
+	schedule(entry, get_system_time() + usec);
+
+	cv.wait(lock);
+
+	// the mutex or the condition variable may be destroyed after return
+	cancel(entry, lock);
+}
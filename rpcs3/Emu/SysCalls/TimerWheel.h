@@ -0,0 +1,74 @@
+#pragma once
+
+#include "Utilities/Thread.h"
+
+// Central service for lv2 timeouts and timers (sys_timer, timed waits of sync primitives and event queues).
+// A single host thread serves a hierarchical timer wheel (4 levels of 64 slots, the first level has 128 us slots),
+// so the thread count doesn't depend on the number of timers and the thread only wakes up when something expires.
+// Created on demand with fxm::get_always<lv2_timer_wheel_t>(), the thread exits when the emulation is stopped.
+class lv2_timer_wheel_t final
+{
+public:
+	// Scheduled callback, can be rescheduled or cancelled at any time
+	struct entry_t
+	{
+		std::function<void()> callback; // called in the timer thread without locks
+
+		u64 gen = 0; // incremented to invalidate the scheduled expiration (protected by the wheel mutex)
+		bool firing = false; // callback is being executed (protected by the wheel mutex)
+	};
+
+private:
+	static const u32 tick_shift = 7; // 128 us
+	static const u32 slot_bits = 6;
+	static const u32 slot_count = 1 << slot_bits;
+	static const u32 level_count = 4;
+
+	struct item_t
+	{
+		std::shared_ptr<entry_t> entry;
+		u64 deadline; // system time (us)
+		u64 gen;
+	};
+
+	std::mutex m_mutex;
+	std::condition_variable m_cv; // timer thread waits on it
+	std::condition_variable m_fired_cv; // cancel() waits on it for the callback completion
+	std::shared_ptr<thread_ctrl> m_thread;
+	std::array<std::array<std::vector<item_t>, slot_count>, level_count> m_slots;
+	u64 m_tick = 0; // current tick, all preceding ticks are processed
+	u64 m_count = 0; // count of items in the slots (including cancelled ones)
+	u64 m_wakeup = 0; // time the timer thread is going to wake up at (0 if not waiting)
+	bool m_exit = false;
+
+	// Put the item into the slot corresponding to its deadline
+	void insert(item_t&& item);
+
+	// Reinsert all items of the slot (moves them to the lower levels)
+	void cascade(u32 level, u64 index);
+
+	// Get the earliest time when the next tick must be processed (0 if empty)
+	u64 get_wakeup_time() const;
+
+	// Timer thread loop
+	void work();
+
+public:
+	lv2_timer_wheel_t() = default;
+
+	lv2_timer_wheel_t(const lv2_timer_wheel_t&) = delete;
+
+	~lv2_timer_wheel_t();
+
+	// Schedule (or reschedule) the entry to be fired at the specified system time
+	void schedule(const std::shared_ptr<entry_t>& entry, u64 deadline);
+
+	// Cancel the entry (the callback may still be running in the timer thread)
+	void cancel(const std::shared_ptr<entry_t>& entry);
+
+	// Cancel the entry and wait for the completion of its callback (the lock is released while waiting)
+	void cancel(const std::shared_ptr<entry_t>& entry, std::unique_lock<std::mutex>& lock);
+
+	// Replacement of cv.wait_for() for lv2 waits: the timer thread notifies cv under the same mutex on timeout
+	void wait_for(thread_cv_t& cv, std::unique_lock<std::mutex>& lock, u64 usec);
+};
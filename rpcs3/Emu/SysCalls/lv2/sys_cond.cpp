@@ -15,12 +15,14 @@ extern u64 get_system_time();
 
 void lv2_cond_t::notify(lv2_lock_t& lv2_lock, sleep_queue_t::value_type& thread)
 {
-	CHECK_LV2_LOCK(lv2_lock);
+	CHECK_LV2_SYNC_LOCK(lv2_lock, mutex->sync_mutex);
+
+	stats.wake();
 
 	if (mutex->owner)
 	{
 		// add thread to the mutex sleep queue if cannot lock immediately
-		mutex->sq.emplace_back(thread);
+		sleep_queue_insert(mutex->sq, thread, lv2_sync_priority(mutex->protocol));
 	}
 	else
 	{
@@ -37,11 +39,11 @@ s32 sys_cond_create(vm::ptr<u32> cond_id, u32 mutex_id, vm::ptr<sys_cond_attribu
 {
 	sys_cond.warning("sys_cond_create(cond_id=*0x%x, mutex_id=0x%x, attr=*0x%x)", cond_id, mutex_id, attr);
 
-	LV2_LOCK;
+	LV2_DEFER_LOCK;
 
 	const auto mutex = idm::get<lv2_mutex_t>(mutex_id);
 
-	if (!mutex)
+	if (!mutex || !lv2_sync_lock(lv2_lock, mutex->sync_mutex, mutex_id, mutex))
 	{
 		return CELL_ESRCH;
 	}
@@ -66,11 +68,11 @@ s32 sys_cond_destroy(u32 cond_id)
 {
 	sys_cond.warning("sys_cond_destroy(cond_id=0x%x)", cond_id);
 
-	LV2_LOCK;
+	LV2_DEFER_LOCK;
 
 	const auto cond = idm::get<lv2_cond_t>(cond_id);
 
-	if (!cond)
+	if (!cond || !lv2_sync_lock(lv2_lock, cond->mutex->sync_mutex, cond_id, cond))
 	{
 		return CELL_ESRCH;
 	}
@@ -94,16 +96,16 @@ s32 sys_cond_signal(u32 cond_id)
 {
 	sys_cond.trace("sys_cond_signal(cond_id=0x%x)", cond_id);
 
-	LV2_LOCK;
+	LV2_DEFER_LOCK;
 
 	const auto cond = idm::get<lv2_cond_t>(cond_id);
 
-	if (!cond)
+	if (!cond || !lv2_sync_lock(lv2_lock, cond->mutex->sync_mutex, cond_id, cond))
 	{
 		return CELL_ESRCH;
 	}
 
-	// signal one waiting thread; protocol is ignored in current implementation
+	// signal one waiting thread (the sleep queue is ordered by the mutex protocol)
 	if (!cond->sq.empty())
 	{
 		cond->notify(lv2_lock, cond->sq.front());
@@ -117,16 +119,16 @@ s32 sys_cond_signal_all(u32 cond_id)
 {
 	sys_cond.trace("sys_cond_signal_all(cond_id=0x%x)", cond_id);
 
-	LV2_LOCK;
+	LV2_DEFER_LOCK;
 
 	const auto cond = idm::get<lv2_cond_t>(cond_id);
 
-	if (!cond)
+	if (!cond || !lv2_sync_lock(lv2_lock, cond->mutex->sync_mutex, cond_id, cond))
 	{
 		return CELL_ESRCH;
 	}
 
-	// signal all waiting threads; protocol is ignored in current implementation
+	// signal all waiting threads
 	for (auto& thread : cond->sq)
 	{
 		cond->notify(lv2_lock, thread);
@@ -141,11 +143,11 @@ s32 sys_cond_signal_to(u32 cond_id, u32 thread_id)
 {
 	sys_cond.trace("sys_cond_signal_to(cond_id=0x%x, thread_id=0x%x)", cond_id, thread_id);
 
-	LV2_LOCK;
+	LV2_DEFER_LOCK;
 
 	const auto cond = idm::get<lv2_cond_t>(cond_id);
 
-	if (!cond)
+	if (!cond || !lv2_sync_lock(lv2_lock, cond->mutex->sync_mutex, cond_id, cond))
 	{
 		return CELL_ESRCH;
 	}
@@ -174,11 +176,11 @@ s32 sys_cond_wait(PPUThread& ppu, u32 cond_id, u64 timeout)
 
 	const u64 start_time = get_system_time();
 
-	LV2_LOCK;
+	LV2_DEFER_LOCK;
 
 	const auto cond = idm::get<lv2_cond_t>(cond_id);
 
-	if (!cond)
+	if (!cond || !lv2_sync_lock(lv2_lock, cond->mutex->sync_mutex, cond_id, cond))
 	{
 		return CELL_ESRCH;
 	}
@@ -195,11 +197,12 @@ s32 sys_cond_wait(PPUThread& ppu, u32 cond_id, u64 timeout)
 	// unlock the mutex
 	cond->mutex->unlock(lv2_lock);
 
-	// add waiter; protocol is ignored in current implementation
-	sleep_queue_entry_t waiter(ppu, cond->sq);
+	// add waiter (ordered by the mutex protocol)
+	sleep_queue_entry_t waiter(ppu, cond->sq, lv2_sync_priority(cond->mutex->protocol));
+	lv2_sync_wait_t wait_stats(cond->stats);
 
 	// potential mutex waiter (not added immediately)
-	sleep_queue_entry_t mutex_waiter(ppu, cond->mutex->sq, defer_sleep);
+	sleep_queue_entry_t mutex_waiter(ppu, cond->mutex->sq, defer_sleep, lv2_sync_priority(cond->mutex->protocol));
 
 	while (!ppu.unsignal())
 	{
@@ -225,7 +228,7 @@ s32 sys_cond_wait(PPUThread& ppu, u32 cond_id, u64 timeout)
 				continue;
 			}
 
-			ppu.cv.wait_for(lv2_lock, std::chrono::microseconds(timeout - passed));
+			fxm::get_always<lv2_timer_wheel_t>()->wait_for(ppu.cv, lv2_lock, timeout - passed);
 		}
 		else
 		{
@@ -248,5 +251,7 @@ s32 sys_cond_wait(PPUThread& ppu, u32 cond_id, u64 timeout)
 		return CELL_ETIMEDOUT;
 	}
 
+	cond->stats.acquired++;
+
 	return CELL_OK;
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Utilities/SleepQueue.h"
+#include "sys_sync.h"
 
 namespace vm { using namespace ps3; }
 
@@ -22,10 +23,12 @@ struct sys_cond_attribute_t
 struct lv2_cond_t
 {
 	const u64 name;
-	const std::shared_ptr<lv2_mutex_t> mutex; // associated mutex
+	const std::shared_ptr<lv2_mutex_t> mutex; // associated mutex (its sync_mutex also protects sq)
 
 	sleep_queue_t sq;
 
+	lv2_sync_stats_t stats;
+
 	lv2_cond_t(const std::shared_ptr<lv2_mutex_t>& mutex, u64 name)
 		: mutex(mutex)
 		, name(name)
@@ -27,11 +27,17 @@ lv2_event_queue_t::lv2_event_queue_t(u32 protocol, s32 type, u64 name, u64 key,
 
 void lv2_event_queue_t::push(lv2_lock_t& lv2_lock, u64 source, u64 data1, u64 data2, u64 data3)
 {
-	CHECK_LV2_LOCK(lv2_lock);
+	CHECK_LV2_SYNC_LOCK(lv2_lock, sync_mutex);
 
 	// save event if no waiters
 	if (sq.empty())
 	{
+		if (events.size() >= size)
+		{
+			// senders reporting CELL_EBUSY check it themselves
+			return sys_event.error("Event queue 0x%x is full, event dropped (source=0x%llx, data1=0x%llx, data2=0x%llx, data3=0x%llx)", id, source, data1, data2, data3);
+		}
+
 		return events.emplace_back(source, data1, data2, data3);
 	}
 
@@ -40,7 +46,7 @@ void lv2_event_queue_t::push(lv2_lock_t& lv2_lock, u64 source, u64 data1, u64 da
 		throw EXCEPTION("Unexpected");
 	}
 
-	// notify waiter; protocol is ignored in current implementation
+	// notify waiter (the sleep queue is ordered by protocol)
 	auto& thread = sq.front();
 
 	if (type == SYS_PPU_QUEUE && thread->get_type() == CPU_THREAD_PPU)
@@ -70,6 +76,8 @@ void lv2_event_queue_t::push(lv2_lock_t& lv2_lock, u64 source, u64 data1, u64 da
 		throw EXCEPTION("Thread already signaled");
 	}
 
+	stats.wake();
+
 	return sq.pop_front();
 }
 
@@ -114,11 +122,11 @@ s32 sys_event_queue_destroy(u32 equeue_id, s32 mode)
 {
 	sys_event.warning("sys_event_queue_destroy(equeue_id=0x%x, mode=%d)", equeue_id, mode);
 
-	LV2_LOCK;
+	LV2_DEFER_LOCK;
 
 	const auto queue = idm::get<lv2_event_queue_t>(equeue_id);
 
-	if (!queue)
+	if (!queue || !lv2_sync_lock(lv2_lock, queue->sync_mutex, equeue_id, queue))
 	{
 		return CELL_ESRCH;
 	}
@@ -163,11 +171,11 @@ s32 sys_event_queue_tryreceive(u32 equeue_id, vm::ptr<sys_event_t> event_array,
 {
 	sys_event.trace("sys_event_queue_tryreceive(equeue_id=0x%x, event_array=*0x%x, size=%d, number=*0x%x)", equeue_id, event_array, size, number);
 
-	LV2_LOCK;
+	LV2_DEFER_LOCK;
 
 	const auto queue = idm::get<lv2_event_queue_t>(equeue_id);
 
-	if (!queue)
+	if (!queue || !lv2_sync_lock(lv2_lock, queue->sync_mutex, equeue_id, queue))
 	{
 		return CELL_ESRCH;
 	}
@@ -204,11 +212,11 @@ s32 sys_event_queue_receive(PPUThread& ppu, u32 equeue_id, vm::ptr<sys_event_t>
 
 	const u64 start_time = get_system_time();
 
-	LV2_LOCK;
+	LV2_DEFER_LOCK;
 
 	const auto queue = idm::get<lv2_event_queue_t>(equeue_id);
 
-	if (!queue)
+	if (!queue || !lv2_sync_lock(lv2_lock, queue->sync_mutex, equeue_id, queue))
 	{
 		return CELL_ESRCH;
 	}
@@ -224,6 +232,7 @@ s32 sys_event_queue_receive(PPUThread& ppu, u32 equeue_id, vm::ptr<sys_event_t>
 		std::tie(ppu.GPR[4], ppu.GPR[5], ppu.GPR[6], ppu.GPR[7]) = queue->events.front();
 
 		queue->events.pop_front();
+		queue->stats.acquired++;
 
 		return CELL_OK;
 	}
@@ -231,8 +240,9 @@ s32 sys_event_queue_receive(PPUThread& ppu, u32 equeue_id, vm::ptr<sys_event_t>
 	// cause (if cancelled) will be returned in r3
 	ppu.GPR[3] = 0;
 
-	// add waiter; protocol is ignored in current implementation
-	sleep_queue_entry_t waiter(ppu, queue->sq);
+	// add waiter
+	sleep_queue_entry_t waiter(ppu, queue->sq, lv2_sync_priority(queue->protocol));
+	lv2_sync_wait_t wait_stats(queue->stats);
 
 	while (!ppu.unsignal())
 	{
@@ -247,7 +257,7 @@ s32 sys_event_queue_receive(PPUThread& ppu, u32 equeue_id, vm::ptr<sys_event_t>
 				return CELL_ETIMEDOUT;
 			}
 
-			ppu.cv.wait_for(lv2_lock, std::chrono::microseconds(timeout - passed));
+			fxm::get_always<lv2_timer_wheel_t>()->wait_for(ppu.cv, lv2_lock, timeout - passed);
 		}
 		else
 		{
@@ -265,6 +275,8 @@ s32 sys_event_queue_receive(PPUThread& ppu, u32 equeue_id, vm::ptr<sys_event_t>
 		return CELL_ECANCELED;
 	}
 
+	queue->stats.acquired++;
+
 	// r4-r7 registers must be set by push()
 	return CELL_OK;
 }
@@ -273,11 +285,11 @@ s32 sys_event_queue_drain(u32 equeue_id)
 {
 	sys_event.trace("sys_event_queue_drain(equeue_id=0x%x)", equeue_id);
 
-	LV2_LOCK;
+	LV2_DEFER_LOCK;
 
 	const auto queue = idm::get<lv2_event_queue_t>(equeue_id);
 
-	if (!queue)
+	if (!queue || !lv2_sync_lock(lv2_lock, queue->sync_mutex, equeue_id, queue))
 	{
 		return CELL_ESRCH;
 	}
@@ -401,6 +413,8 @@ s32 sys_event_port_send(u32 eport_id, u64 data1, u64 data2, u64 data3)
 		return CELL_ENOTCONN;
 	}
 
+	lv2_lock_t queue_lock(queue->sync_mutex);
+
 	if (queue->events.size() >= queue->size)
 	{
 		return CELL_EBUSY;
@@ -408,7 +422,7 @@ s32 sys_event_port_send(u32 eport_id, u64 data1, u64 data2, u64 data3)
 
 	const u64 source = port->name ? port->name : ((u64)process_getpid() << 32) | (u64)eport_id;
 
-	queue->push(lv2_lock, source, data1, data2, data3);
+	queue->push(queue_lock, source, data1, data2, data3);
 
 	return CELL_OK;
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Utilities/SleepQueue.h"
+#include "sys_sync.h"
 
 namespace vm { using namespace ps3; }
 
@@ -65,6 +66,49 @@ struct sys_event_t
 	be_t<u64> data3;
 };
 
+// Fixed-capacity event ring (capacity is the maximal event queue size), doesn't allocate on push
+class lv2_event_ring_t
+{
+public:
+	// tuple elements: source, data1, data2, data3
+	using value_type = std::tuple<u64, u64, u64, u64>;
+
+	static const u32 capacity = 127;
+
+private:
+	std::array<value_type, capacity> m_data;
+	u32 m_first = 0;
+	u32 m_count = 0;
+
+public:
+	std::size_t size() const
+	{
+		return m_count;
+	}
+
+	value_type& front()
+	{
+		return m_data[m_first];
+	}
+
+	void pop_front()
+	{
+		m_first = (m_first + 1) % capacity;
+		m_count--;
+	}
+
+	void emplace_back(u64 source, u64 data1, u64 data2, u64 data3)
+	{
+		m_data[(m_first + m_count++) % capacity] = std::make_tuple(source, data1, data2, data3);
+	}
+
+	void clear()
+	{
+		m_first = 0;
+		m_count = 0;
+	}
+};
+
 struct lv2_event_queue_t
 {
 	const u32 id;
@@ -74,11 +118,14 @@ struct lv2_event_queue_t
 	const u64 key;
 	const s32 size;
 
-	// tuple elements: source, data1, data2, data3
-	std::deque<std::tuple<u64, u64, u64, u64>> events;
+	lv2_event_ring_t events; // never exceeds size
 
 	sleep_queue_t sq;
 
+	std::mutex sync_mutex; // protects events and sq
+
+	lv2_sync_stats_t stats;
+
 	lv2_event_queue_t(u32 protocol, s32 type, u64 name, u64 key, s32 size);
 
 	void push(lv2_lock_t& lv2_lock, u64 source, u64 data1, u64 data2, u64 data3);
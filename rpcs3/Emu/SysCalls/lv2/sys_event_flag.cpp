@@ -35,13 +35,15 @@ void lv2_event_flag_t::notify_all(lv2_lock_t& lv2_lock)
 				throw EXCEPTION("Thread already signaled");
 			}
 
+			stats.wake();
+
 			return true;
 		}
 
 		return false;
 	};
 
-	// check all waiters; protocol is ignored in current implementation
+	// check all waiters (the sleep queue is ordered by protocol)
 	sq.erase(std::remove_if(sq.begin(), sq.end(), pred), sq.end());
 }
 
@@ -143,11 +145,14 @@ s32 sys_event_flag_wait(PPUThread& ppu, u32 id, u64 bitptn, u32 mode, vm::ptr<u6
 
 		if (result) *result = pattern;
 
+		eflag->stats.acquired++;
+
 		return CELL_OK;
 	}
 
-	// add waiter; protocol is ignored in current implementation
-	sleep_queue_entry_t waiter(ppu, eflag->sq);
+	// add waiter
+	sleep_queue_entry_t waiter(ppu, eflag->sq, lv2_sync_priority(eflag->protocol));
+	lv2_sync_wait_t wait_stats(eflag->stats);
 
 	while (!ppu.unsignal())
 	{
@@ -164,7 +169,7 @@ s32 sys_event_flag_wait(PPUThread& ppu, u32 id, u64 bitptn, u32 mode, vm::ptr<u6
 				return CELL_ETIMEDOUT;
 			}
 
-			ppu.cv.wait_for(lv2_lock, std::chrono::microseconds(timeout - passed));
+			fxm::get_always<lv2_timer_wheel_t>()->wait_for(ppu.cv, lv2_lock, timeout - passed);
 		}
 		else
 		{
@@ -184,6 +189,8 @@ s32 sys_event_flag_wait(PPUThread& ppu, u32 id, u64 bitptn, u32 mode, vm::ptr<u6
 		return CELL_ECANCELED;
 	}
 
+	eflag->stats.acquired++;
+
 	return CELL_OK;
 }
 
@@ -214,6 +221,8 @@ s32 sys_event_flag_trywait(u32 id, u64 bitptn, u32 mode, vm::ptr<u64> result)
 
 		if (result) *result = pattern;
 
+		eflag->stats.acquired++;
+
 		return CELL_OK;
 	}
 
@@ -301,6 +310,7 @@ s32 sys_event_flag_cancel(u32 id, vm::ptr<u32> num)
 		}
 	}
 
+	eflag->stats.wake(static_cast<u32>(eflag->sq.size()));
 	eflag->sq.clear();
 	
 	return CELL_OK;
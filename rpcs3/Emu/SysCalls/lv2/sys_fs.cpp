@@ -2,17 +2,31 @@
 #include "Emu/Memory/Memory.h"
 #include "Emu/System.h"
 #include "Emu/IdManager.h"
+#include "Utilities/Trace.h"
 #include "Emu/SysCalls/SysCalls.h"
 
 #include "Emu/FS/VFS.h"
 #include "Emu/FS/vfsFile.h"
 #include "Emu/FS/vfsLocalFile.h"
 #include "Emu/FS/vfsDir.h"
+#include "Crypto/unedat.h"
 
 #include "sys_fs.h"
 
 SysCallBase sys_fs("sys_fs");
 
+u64 lv2_file_t::read_at(u64 offset, void* buf, u64 size)
+{
+	if (file->CanReadAt())
+	{
+		return file->ReadAt(offset, buf, size);
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	return file->ReadAt(offset, buf, size);
+}
+
 s32 sys_fs_test(u32 arg1, u32 arg2, vm::ptr<u32> arg3, u32 arg4, vm::ptr<char> arg5, u32 arg6)
 {
 	sys_fs.todo("sys_fs_test(arg1=0x%x, arg2=0x%x, arg3=*0x%x, arg4=0x%x, arg5=*0x%x, arg6=0x%x) -> CELL_OK", arg1, arg2, arg3, arg4, arg5, arg6);
@@ -43,7 +57,9 @@ s32 sys_fs_open(vm::cptr<char> path, s32 flags, vm::ptr<u32> fd, s32 mode, vm::c
 
 	// TODO: other checks for path
 
-	if (fs::is_dir(local_path))
+	fs::stat_t info;
+
+	if (Emu.GetVFS().GetStat(local_path, info) && info.is_directory)
 	{
 		sys_fs.error("sys_fs_open('%s') failed: path is a directory", path.get_ptr());
 		return CELL_FS_EISDIR;
@@ -100,7 +116,18 @@ s32 sys_fs_open(vm::cptr<char> path, s32 flags, vm::ptr<u32> fd, s32 mode, vm::c
 		throw EXCEPTION("Invalid or unimplemented flags (%#o): '%s'", flags, path.get_ptr());
 	}
 
-	std::shared_ptr<vfsStream> file(Emu.GetVFS().OpenFile(path.get_ptr(), open_mode));
+	std::shared_ptr<vfsStream> file;
+
+	if (open_mode == fom::read && size == 8 && arg && vm::static_ptr_cast<const be_t<u32>>(arg)[0] == 0x180)
+	{
+		// SDATA file (opened by cellFsSdataOpen): blocks are decrypted on read, falls back to the raw file if unsupported
+		file = sdata_stream_t::open(local_path);
+	}
+
+	if (!file)
+	{
+		file.reset(Emu.GetVFS().OpenFile(path.get_ptr(), open_mode));
+	}
 
 	if (!file || !file->IsOpened())
 	{
@@ -140,6 +167,8 @@ s32 sys_fs_read(u32 fd, vm::ptr<void> buf, u64 nbytes, vm::ptr<u64> nread)
 
 	std::lock_guard<std::mutex> lock(file->mutex);
 
+	_log::timeline_scope scope("lv2", "sys_fs_read", nbytes);
+
 	*nread = file->file->Read(buf.get_ptr(), nbytes);
 
 	return CELL_OK;
@@ -160,6 +189,8 @@ s32 sys_fs_write(u32 fd, vm::cptr<void> buf, u64 nbytes, vm::ptr<u64> nwrite)
 
 	std::lock_guard<std::mutex> lock(file->mutex);
 
+	_log::timeline_scope scope("lv2", "sys_fs_write", nbytes);
+
 	*nwrite = file->file->Write(buf.get_ptr(), nbytes);
 
 	return CELL_OK;
@@ -268,7 +299,7 @@ s32 sys_fs_stat(vm::cptr<char> path, vm::ptr<CellFsStat> sb)
 
 	fs::stat_t info;
 
-	if (!fs::stat(local_path, info))
+	if (!Emu.GetVFS().GetStat(local_path, info))
 	{
 		sys_fs.error("sys_fs_stat('%s') failed: not found", path.get_ptr());
 		return CELL_FS_ENOENT;
@@ -509,6 +540,8 @@ s32 sys_fs_ftruncate(u32 fd, u64 size)
 		return CELL_FS_EIO; // ???
 	}
 
+	Emu.GetVFS().InvalidateStat(local_file->GetPath());
+
 	return CELL_OK;
 }
 
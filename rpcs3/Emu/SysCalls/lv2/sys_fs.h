@@ -201,6 +201,9 @@ struct lv2_file_t
 		, st_callback(fs_st_cb_rec_t{})
 	{
 	}
+
+	// Read the data at specified position (the mutex is only locked if the stream doesn't support concurrent positional reads)
+	u64 read_at(u64 offset, void* buf, u64 size);
 };
 
 template<> struct id_traits<lv2_file_t>
@@ -5,6 +5,7 @@
 #include "Emu/SysCalls/SysCalls.h"
 
 #include "Emu/Cell/PPUThread.h"
+#include "sys_sync.h"
 #include "sys_lwmutex.h"
 #include "sys_lwcond.h"
 
@@ -14,7 +15,7 @@ extern u64 get_system_time();
 
 void lv2_lwcond_t::notify(lv2_lock_t & lv2_lock, sleep_queue_t::value_type& thread, const std::shared_ptr<lv2_lwmutex_t>& mutex, bool mode2)
 {
-	CHECK_LV2_LOCK(lv2_lock);
+	CHECK_LV2_SYNC_LOCK(lv2_lock, this->mutex->sync_mutex);
 
 	auto& ppu = static_cast<PPUThread&>(*thread);
 
@@ -24,7 +25,7 @@ void lv2_lwcond_t::notify(lv2_lock_t & lv2_lock, sleep_queue_t::value_type& thre
 	{
 		if (!mutex->signaled)
 		{
-			return mutex->sq.emplace_back(thread);
+			return sleep_queue_insert(mutex->sq, thread, lv2_sync_priority(mutex->protocol));
 		}
 
 		mutex->signaled--;
@@ -40,7 +41,14 @@ s32 _sys_lwcond_create(vm::ptr<u32> lwcond_id, u32 lwmutex_id, vm::ptr<sys_lwcon
 {
 	sys_lwcond.warning("_sys_lwcond_create(lwcond_id=*0x%x, lwmutex_id=0x%x, control=*0x%x, name=0x%llx, arg5=0x%x)", lwcond_id, lwmutex_id, control, name, arg5);
 
-	*lwcond_id = idm::make<lv2_lwcond_t>(name);
+	const auto mutex = idm::get<lv2_lwmutex_t>(lwmutex_id);
+
+	if (!mutex)
+	{
+		return CELL_ESRCH;
+	}
+
+	*lwcond_id = idm::make<lv2_lwcond_t>(mutex, name);
 
 	return CELL_OK;
 }
@@ -49,11 +57,11 @@ s32 _sys_lwcond_destroy(u32 lwcond_id)
 {
 	sys_lwcond.warning("_sys_lwcond_destroy(lwcond_id=0x%x)", lwcond_id);
 
-	LV2_LOCK;
+	LV2_DEFER_LOCK;
 
 	const auto cond = idm::get<lv2_lwcond_t>(lwcond_id);
 
-	if (!cond)
+	if (!cond || !lv2_sync_lock(lv2_lock, cond->mutex->sync_mutex, lwcond_id, cond))
 	{
 		return CELL_ESRCH;
 	}
@@ -72,16 +80,21 @@ s32 _sys_lwcond_signal(u32 lwcond_id, u32 lwmutex_id, u32 ppu_thread_id, u32 mod
 {
 	sys_lwcond.trace("_sys_lwcond_signal(lwcond_id=0x%x, lwmutex_id=0x%x, ppu_thread_id=0x%x, mode=%d)", lwcond_id, lwmutex_id, ppu_thread_id, mode);
 
-	LV2_LOCK;
+	LV2_DEFER_LOCK;
 
 	const auto cond = idm::get<lv2_lwcond_t>(lwcond_id);
 	const auto mutex = idm::get<lv2_lwmutex_t>(lwmutex_id);
 
-	if (!cond || (lwmutex_id && !mutex))
+	if (!cond || (lwmutex_id && !mutex) || !lv2_sync_lock(lv2_lock, cond->mutex->sync_mutex, lwcond_id, cond))
 	{
 		return CELL_ESRCH;
 	}
 
+	if (mutex && mutex != cond->mutex)
+	{
+		throw EXCEPTION("Unexpected lwmutex (lwcond_id=0x%x, lwmutex_id=0x%x)", lwcond_id, lwmutex_id);
+	}
+
 	if (mode != 1 && mode != 2 && mode != 3)
 	{
 		throw EXCEPTION("Unknown mode (%d)", mode);
@@ -91,7 +104,7 @@ s32 _sys_lwcond_signal(u32 lwcond_id, u32 lwmutex_id, u32 ppu_thread_id, u32 mod
 	// mode 2: lightweight mutex was not owned by the calling thread and waiter hasn't been increased
 	// mode 3: lightweight mutex was forcefully owned by the calling thread
 
-	// pick waiter; protocol is ignored in current implementation
+	// pick waiter (the sleep queue is ordered by the lwmutex protocol)
 	const auto found = !~ppu_thread_id ? cond->sq.begin() : std::find_if(cond->sq.begin(), cond->sq.end(), [=](sleep_queue_t::value_type& thread)
 	{
 		return thread->get_id() == ppu_thread_id;
@@ -125,16 +138,21 @@ s32 _sys_lwcond_signal_all(u32 lwcond_id, u32 lwmutex_id, u32 mode)
 {
 	sys_lwcond.trace("_sys_lwcond_signal_all(lwcond_id=0x%x, lwmutex_id=0x%x, mode=%d)", lwcond_id, lwmutex_id, mode);
 
-	LV2_LOCK;
+	LV2_DEFER_LOCK;
 
 	const auto cond = idm::get<lv2_lwcond_t>(lwcond_id);
 	const auto mutex = idm::get<lv2_lwmutex_t>(lwmutex_id);
 
-	if (!cond || (lwmutex_id && !mutex))
+	if (!cond || (lwmutex_id && !mutex) || !lv2_sync_lock(lv2_lock, cond->mutex->sync_mutex, lwcond_id, cond))
 	{
 		return CELL_ESRCH;
 	}
 
+	if (mutex && mutex != cond->mutex)
+	{
+		throw EXCEPTION("Unexpected lwmutex (lwcond_id=0x%x, lwmutex_id=0x%x)", lwcond_id, lwmutex_id);
+	}
+
 	if (mode != 1 && mode != 2)
 	{
 		throw EXCEPTION("Unknown mode (%d)", mode);
@@ -143,7 +161,7 @@ s32 _sys_lwcond_signal_all(u32 lwcond_id, u32 lwmutex_id, u32 mode)
 	// mode 1: lightweight mutex was initially owned by the calling thread
 	// mode 2: lightweight mutex was not owned by the calling thread and waiter hasn't been increased
 
-	// signal all waiting threads; protocol is ignored in current implementation
+	// signal all waiting threads
 	for (auto& thread : cond->sq)
 	{
 		cond->notify(lv2_lock, thread, mutex, mode == 2);
@@ -163,24 +181,29 @@ s32 _sys_lwcond_queue_wait(PPUThread& ppu, u32 lwcond_id, u32 lwmutex_id, u64 ti
 
 	const u64 start_time = get_system_time();
 
-	LV2_LOCK;
+	LV2_DEFER_LOCK;
 
 	const auto cond = idm::get<lv2_lwcond_t>(lwcond_id);
 	const auto mutex = idm::get<lv2_lwmutex_t>(lwmutex_id);
 
-	if (!cond || !mutex)
+	if (!cond || !mutex || !lv2_sync_lock(lv2_lock, cond->mutex->sync_mutex, lwcond_id, cond))
 	{
 		return CELL_ESRCH;
 	}
 
+	if (mutex && mutex != cond->mutex)
+	{
+		throw EXCEPTION("Unexpected lwmutex (lwcond_id=0x%x, lwmutex_id=0x%x)", lwcond_id, lwmutex_id);
+	}
+
 	// finalize unlocking the mutex
 	mutex->unlock(lv2_lock);
 
-	// add waiter; protocol is ignored in current implementation
-	sleep_queue_entry_t waiter(ppu, cond->sq);
+	// add waiter (ordered by the lwmutex protocol)
+	sleep_queue_entry_t waiter(ppu, cond->sq, lv2_sync_priority(mutex->protocol));
 
 	// potential mutex waiter (not added immediately)
-	sleep_queue_entry_t mutex_waiter(ppu, cond->sq, defer_sleep);
+	sleep_queue_entry_t mutex_waiter(ppu, cond->sq, defer_sleep, lv2_sync_priority(mutex->protocol));
 
 	while (!ppu.unsignal())
 	{
@@ -205,7 +228,7 @@ s32 _sys_lwcond_queue_wait(PPUThread& ppu, u32 lwcond_id, u32 lwmutex_id, u64 ti
 				}
 			}
 
-			ppu.cv.wait_for(lv2_lock, std::chrono::microseconds(timeout - passed));
+			fxm::get_always<lv2_timer_wheel_t>()->wait_for(ppu.cv, lv2_lock, timeout - passed);
 		}
 		else
 		{
@@ -5,6 +5,7 @@
 namespace vm { using namespace ps3; }
 
 struct sys_lwmutex_t;
+struct lv2_lwmutex_t;
 
 struct sys_lwcond_attribute_t
 {
@@ -20,11 +21,13 @@ struct sys_lwcond_t
 struct lv2_lwcond_t
 {
 	const u64 name;
+	const std::shared_ptr<lv2_lwmutex_t> mutex; // associated lwmutex (its sync_mutex also protects sq)
 
 	sleep_queue_t sq;
 
-	lv2_lwcond_t(u64 name)
-		: name(name)
+	lv2_lwcond_t(const std::shared_ptr<lv2_lwmutex_t>& mutex, u64 name)
+		: mutex(mutex)
+		, name(name)
 	{
 	}
 
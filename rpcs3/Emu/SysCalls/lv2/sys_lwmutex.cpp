@@ -14,7 +14,7 @@ extern u64 get_system_time();
 
 void lv2_lwmutex_t::unlock(lv2_lock_t& lv2_lock)
 {
-	CHECK_LV2_LOCK(lv2_lock);
+	CHECK_LV2_SYNC_LOCK(lv2_lock, sync_mutex);
 
 	if (signaled)
 	{
@@ -29,6 +29,7 @@ void lv2_lwmutex_t::unlock(lv2_lock_t& lv2_lock)
 		}
 
 		sq.pop_front();
+		stats.wake();
 	}
 	else
 	{
@@ -60,11 +61,11 @@ s32 _sys_lwmutex_destroy(u32 lwmutex_id)
 {
 	sys_lwmutex.warning("_sys_lwmutex_destroy(lwmutex_id=0x%x)", lwmutex_id);
 
-	LV2_LOCK;
+	LV2_DEFER_LOCK;
 
 	const auto mutex = idm::get<lv2_lwmutex_t>(lwmutex_id);
 
-	if (!mutex)
+	if (!mutex || !lv2_sync_lock(lv2_lock, mutex->sync_mutex, lwmutex_id, mutex))
 	{
 		return CELL_ESRCH;
 	}
@@ -85,11 +86,11 @@ s32 _sys_lwmutex_lock(PPUThread& ppu, u32 lwmutex_id, u64 timeout)
 
 	const u64 start_time = get_system_time();
 
-	LV2_LOCK;
+	LV2_DEFER_LOCK;
 
 	const auto mutex = idm::get<lv2_lwmutex_t>(lwmutex_id);
 
-	if (!mutex)
+	if (!mutex || !lv2_sync_lock(lv2_lock, mutex->sync_mutex, lwmutex_id, mutex))
 	{
 		return CELL_ESRCH;
 	}
@@ -97,12 +98,14 @@ s32 _sys_lwmutex_lock(PPUThread& ppu, u32 lwmutex_id, u64 timeout)
 	if (mutex->signaled)
 	{
 		mutex->signaled--;
+		mutex->stats.acquired++;
 
 		return CELL_OK;
 	}
 
-	// add waiter; protocol is ignored in current implementation
-	sleep_queue_entry_t waiter(ppu, mutex->sq);
+	// add waiter
+	sleep_queue_entry_t waiter(ppu, mutex->sq, lv2_sync_priority(mutex->protocol));
+	lv2_sync_wait_t wait_stats(mutex->stats);
 
 	while (!ppu.unsignal())
 	{
@@ -117,7 +120,7 @@ s32 _sys_lwmutex_lock(PPUThread& ppu, u32 lwmutex_id, u64 timeout)
 				return CELL_ETIMEDOUT;
 			}
 
-			ppu.cv.wait_for(lv2_lock, std::chrono::microseconds(timeout - passed));
+			fxm::get_always<lv2_timer_wheel_t>()->wait_for(ppu.cv, lv2_lock, timeout - passed);
 		}
 		else
 		{
@@ -125,6 +128,8 @@ s32 _sys_lwmutex_lock(PPUThread& ppu, u32 lwmutex_id, u64 timeout)
 		}
 	}
 
+	mutex->stats.acquired++;
+
 	return CELL_OK;
 }
 
@@ -132,11 +137,11 @@ s32 _sys_lwmutex_trylock(u32 lwmutex_id)
 {
 	sys_lwmutex.trace("_sys_lwmutex_trylock(lwmutex_id=0x%x)", lwmutex_id);
 
-	LV2_LOCK;
+	LV2_DEFER_LOCK;
 
 	const auto mutex = idm::get<lv2_lwmutex_t>(lwmutex_id);
 
-	if (!mutex)
+	if (!mutex || !lv2_sync_lock(lv2_lock, mutex->sync_mutex, lwmutex_id, mutex))
 	{
 		return CELL_ESRCH;
 	}
@@ -147,6 +152,7 @@ s32 _sys_lwmutex_trylock(u32 lwmutex_id)
 	}
 
 	mutex->signaled--;
+	mutex->stats.acquired++;
 
 	return CELL_OK;
 }
@@ -155,11 +161,11 @@ s32 _sys_lwmutex_unlock(u32 lwmutex_id)
 {
 	sys_lwmutex.trace("_sys_lwmutex_unlock(lwmutex_id=0x%x)", lwmutex_id);
 
-	LV2_LOCK;
+	LV2_DEFER_LOCK;
 
 	const auto mutex = idm::get<lv2_lwmutex_t>(lwmutex_id);
 
-	if (!mutex)
+	if (!mutex || !lv2_sync_lock(lv2_lock, mutex->sync_mutex, lwmutex_id, mutex))
 	{
 		return CELL_ESRCH;
 	}
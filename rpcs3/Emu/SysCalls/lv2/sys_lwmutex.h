@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Utilities/SleepQueue.h"
+#include "sys_sync.h"
 
 namespace vm { using namespace ps3; }
 
@@ -56,6 +57,10 @@ struct lv2_lwmutex_t
 
 	sleep_queue_t sq;
 
+	std::mutex sync_mutex; // protects signaled and sq, shared with associated lv2_lwcond_t
+
+	lv2_sync_stats_t stats;
+
 	lv2_lwmutex_t(u32 protocol, u64 name)
 		: protocol(protocol)
 		, name(name)
@@ -14,19 +14,21 @@ extern u64 get_system_time();
 
 void lv2_mutex_t::unlock(lv2_lock_t& lv2_lock)
 {
-	CHECK_LV2_LOCK(lv2_lock);
+	CHECK_LV2_SYNC_LOCK(lv2_lock, sync_mutex);
 
 	owner.reset();
 
 	if (sq.size())
 	{
-		// pick new owner; protocol is ignored in current implementation
+		// pick new owner (the sleep queue is ordered by protocol)
 		owner = sq.front();
 
 		if (!owner->signal())
 		{
 			throw EXCEPTION("Mutex owner already signaled");
 		}
+
+		stats.wake();
 	}
 }
 
@@ -72,11 +74,11 @@ s32 sys_mutex_destroy(u32 mutex_id)
 {
 	sys_mutex.warning("sys_mutex_destroy(mutex_id=0x%x)", mutex_id);
 
-	LV2_LOCK;
+	LV2_DEFER_LOCK;
 
 	const auto mutex = idm::get<lv2_mutex_t>(mutex_id);
 
-	if (!mutex)
+	if (!mutex || !lv2_sync_lock(lv2_lock, mutex->sync_mutex, mutex_id, mutex))
 	{
 		return CELL_ESRCH;
 	}
@@ -102,11 +104,11 @@ s32 sys_mutex_lock(PPUThread& ppu, u32 mutex_id, u64 timeout)
 
 	const u64 start_time = get_system_time();
 
-	LV2_LOCK;
+	LV2_DEFER_LOCK;
 
 	const auto mutex = idm::get<lv2_mutex_t>(mutex_id);
 
-	if (!mutex)
+	if (!mutex || !lv2_sync_lock(lv2_lock, mutex->sync_mutex, mutex_id, mutex))
 	{
 		return CELL_ESRCH;
 	}
@@ -133,12 +135,14 @@ s32 sys_mutex_lock(PPUThread& ppu, u32 mutex_id, u64 timeout)
 	if (!mutex->owner)
 	{
 		mutex->owner = std::static_pointer_cast<CPUThread>(ppu.shared_from_this());
+		mutex->stats.acquired++;
 
 		return CELL_OK;
 	}
 
-	// add waiter; protocol is ignored in current implementation
-	sleep_queue_entry_t waiter(ppu, mutex->sq);
+	// add waiter
+	sleep_queue_entry_t waiter(ppu, mutex->sq, lv2_sync_priority(mutex->protocol));
+	lv2_sync_wait_t wait_stats(mutex->stats);
 
 	while (!ppu.unsignal())
 	{
@@ -153,7 +157,7 @@ s32 sys_mutex_lock(PPUThread& ppu, u32 mutex_id, u64 timeout)
 				return CELL_ETIMEDOUT;
 			}
 
-			ppu.cv.wait_for(lv2_lock, std::chrono::microseconds(timeout - passed));
+			fxm::get_always<lv2_timer_wheel_t>()->wait_for(ppu.cv, lv2_lock, timeout - passed);
 		}
 		else
 		{
@@ -167,6 +171,8 @@ s32 sys_mutex_lock(PPUThread& ppu, u32 mutex_id, u64 timeout)
 		throw EXCEPTION("Unexpected mutex owner");
 	}
 
+	mutex->stats.acquired++;
+
 	return CELL_OK;
 }
 
@@ -174,11 +180,11 @@ s32 sys_mutex_trylock(PPUThread& ppu, u32 mutex_id)
 {
 	sys_mutex.trace("sys_mutex_trylock(mutex_id=0x%x)", mutex_id);
 
-	LV2_LOCK;
+	LV2_DEFER_LOCK;
 
 	const auto mutex = idm::get<lv2_mutex_t>(mutex_id);
 
-	if (!mutex)
+	if (!mutex || !lv2_sync_lock(lv2_lock, mutex->sync_mutex, mutex_id, mutex))
 	{
 		return CELL_ESRCH;
 	}
@@ -208,6 +214,7 @@ s32 sys_mutex_trylock(PPUThread& ppu, u32 mutex_id)
 
 	// own the mutex if free
 	mutex->owner = std::static_pointer_cast<CPUThread>(ppu.shared_from_this());
+	mutex->stats.acquired++;
 
 	return CELL_OK;
 }
@@ -216,11 +223,11 @@ s32 sys_mutex_unlock(PPUThread& ppu, u32 mutex_id)
 {
 	sys_mutex.trace("sys_mutex_unlock(mutex_id=0x%x)", mutex_id);
 
-	LV2_LOCK;
+	LV2_DEFER_LOCK;
 
 	const auto mutex = idm::get<lv2_mutex_t>(mutex_id);
 
-	if (!mutex)
+	if (!mutex || !lv2_sync_lock(lv2_lock, mutex->sync_mutex, mutex_id, mutex))
 	{
 		return CELL_ESRCH;
 	}
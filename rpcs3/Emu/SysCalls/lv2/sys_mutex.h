@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Utilities/SleepQueue.h"
+#include "sys_sync.h"
 
 namespace vm { using namespace ps3; }
 
@@ -33,6 +34,10 @@ struct lv2_mutex_t
 
 	sleep_queue_t sq;
 
+	std::mutex sync_mutex; // protects owner and sq, shared with associated lv2_cond_t
+
+	lv2_sync_stats_t stats;
+
 	lv2_mutex_t(bool recursive, u32 protocol, u64 name)
 		: recursive(recursive)
 		, protocol(protocol)
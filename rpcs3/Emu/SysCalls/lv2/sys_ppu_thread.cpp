@@ -5,6 +5,7 @@
 #include "Emu/SysCalls/SysCalls.h"
 
 #include "Emu/Cell/PPUThread.h"
+#include "Emu/CPU/HostThreadPolicy.h"
 #include "sys_mutex.h"
 #include "sys_ppu_thread.h"
 
@@ -19,10 +20,12 @@ void _sys_ppu_thread_exit(PPUThread& ppu, u64 errorcode)
 	// get all sys_mutex objects
 	for (auto& mutex : idm::get_all<lv2_mutex_t>())
 	{
+		lv2_lock_t mutex_lock(mutex->sync_mutex);
+
 		// unlock mutex if locked by this thread
 		if (mutex->owner.get() == &ppu)
 		{
-			mutex->unlock(lv2_lock);
+			mutex->unlock(mutex_lock);
 		}
 	}
 
@@ -150,6 +153,8 @@ s32 sys_ppu_thread_set_priority(u32 thread_id, s32 prio)
 
 	thread->prio = prio;
 
+	host_thread_policy::update_ppu_priority(*thread);
+
 	return CELL_OK;
 }
 
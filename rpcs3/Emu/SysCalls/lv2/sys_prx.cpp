@@ -27,13 +27,13 @@ s32 prx_load_module(std::string path, u64 flags, vm::ptr<sys_prx_load_module_opt
 
 	loader::handlers::elf64 loader;
 
-	vfsFile f(path);
-	if (!f.IsOpened())
+	const auto f = OpenSelfOrElf(path);
+	if (!f || !f->IsOpened())
 	{
 		return CELL_PRX_ERROR_UNKNOWN_MODULE;
 	}
 
-	if (loader.init(f) != loader::handler::error_code::ok || !loader.is_sprx())
+	if (loader.init(*f) != loader::handler::error_code::ok || !loader.is_sprx())
 	{
 		return CELL_PRX_ERROR_ILLEGAL_LIBRARY;
 	}
@@ -75,7 +75,7 @@ s32 prx_load_module(std::string path, u64 flags, vm::ptr<sys_prx_load_module_opt
 			}
 			else
 			{
-				func->lle_func.set(addr);
+				set_ppu_func_lle(index, addr);
 
 				if (func->flags & MFF_FORCED_HLE)
 				{
@@ -122,22 +122,7 @@ s32 prx_load_module(std::string path, u64 flags, vm::ptr<sys_prx_load_module_opt
 		}
 	}
 
-	const auto decoder_cache = fxm::get<ppu_decoder_cache_t>();
-
-	for (auto& seg : info.segments)
-	{
-		const u32 addr = seg.begin.addr();
-		const u32 size = align(seg.size, 4096);
-
-		if (vm::check_addr(addr, size))
-		{
-			decoder_cache->initialize(addr, size);
-		}
-		else
-		{
-			sys_prx.error("Failed to process executable area (addr=0x%x, size=0x%x)", addr, size);
-		}
-	}
+	// the PPU decoder cache is initialized on the first execution of each page
 
 	return prx->id;
 }
@@ -2,6 +2,8 @@
 #include "Emu/Memory/Memory.h"
 #include "Emu/System.h"
 #include "Emu/SysCalls/SysCalls.h"
+#include "Emu/RSX/GSManager.h"
+#include "Emu/RSX/GSRender.h"
 
 #include "sys_rsx.h"
 
@@ -122,6 +124,7 @@ s32 sys_rsx_context_attribute(s32 context_id, u32 package_id, u64 a3, u64 a4, u6
 	switch(package_id)
 	{
 	case 0x001: // FIFO
+		Emu.GetGSManager().GetRender().fifo_wakeup();
 		break;
 	
 	case 0x100: // Display mode set
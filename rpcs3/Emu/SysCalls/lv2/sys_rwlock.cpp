@@ -16,7 +16,7 @@ void lv2_rwlock_t::notify_all(lv2_lock_t& lv2_lock)
 {
 	CHECK_LV2_LOCK(lv2_lock);
 
-	// pick a new writer if possible; protocol is ignored in current implementation
+	// pick a new writer if possible (the sleep queue is ordered by protocol)
 	if (!readers && !writer && wsq.size())
 	{
 		writer = wsq.front();
@@ -26,6 +26,8 @@ void lv2_rwlock_t::notify_all(lv2_lock_t& lv2_lock)
 			throw EXCEPTION("Writer already signaled");
 		}
 
+		stats.wake();
+
 		return wsq.pop_front();
 	}
 
@@ -33,6 +35,7 @@ void lv2_rwlock_t::notify_all(lv2_lock_t& lv2_lock)
 	if (!writer && !wsq.size())
 	{
 		readers += static_cast<u32>(rsq.size());
+		stats.wake(static_cast<u32>(rsq.size()));
 
 		for (auto& thread : rsq)
 		{
@@ -119,11 +122,14 @@ s32 sys_rwlock_rlock(PPUThread& ppu, u32 rw_lock_id, u64 timeout)
 			throw EXCEPTION("Too many readers");
 		}
 
+		rwlock->stats.acquired++;
+
 		return CELL_OK;
 	}
 
-	// add waiter; protocol is ignored in current implementation
-	sleep_queue_entry_t waiter(ppu, rwlock->rsq);
+	// add waiter
+	sleep_queue_entry_t waiter(ppu, rwlock->rsq, lv2_sync_priority(rwlock->protocol));
+	lv2_sync_wait_t wait_stats(rwlock->stats);
 
 	while (!ppu.unsignal())
 	{
@@ -138,7 +144,7 @@ s32 sys_rwlock_rlock(PPUThread& ppu, u32 rw_lock_id, u64 timeout)
 				return CELL_ETIMEDOUT;
 			}
 
-			ppu.cv.wait_for(lv2_lock, std::chrono::microseconds(timeout - passed));
+			fxm::get_always<lv2_timer_wheel_t>()->wait_for(ppu.cv, lv2_lock, timeout - passed);
 		}
 		else
 		{
@@ -151,6 +157,8 @@ s32 sys_rwlock_rlock(PPUThread& ppu, u32 rw_lock_id, u64 timeout)
 		throw EXCEPTION("Unexpected");
 	}
 
+	rwlock->stats.acquired++;
+
 	return CELL_OK;
 }
 
@@ -177,6 +185,8 @@ s32 sys_rwlock_tryrlock(u32 rw_lock_id)
 		throw EXCEPTION("Too many readers");
 	}
 
+	rwlock->stats.acquired++;
+
 	return CELL_OK;
 }
 
@@ -229,12 +239,14 @@ s32 sys_rwlock_wlock(PPUThread& ppu, u32 rw_lock_id, u64 timeout)
 	if (!rwlock->readers && !rwlock->writer)
 	{
 		rwlock->writer = std::static_pointer_cast<CPUThread>(ppu.shared_from_this());
+		rwlock->stats.acquired++;
 
 		return CELL_OK;
 	}
 
-	// add waiter; protocol is ignored in current implementation
-	sleep_queue_entry_t waiter(ppu, rwlock->wsq);
+	// add waiter
+	sleep_queue_entry_t waiter(ppu, rwlock->wsq, lv2_sync_priority(rwlock->protocol));
+	lv2_sync_wait_t wait_stats(rwlock->stats);
 
 	while (!ppu.unsignal())
 	{
@@ -261,7 +273,7 @@ s32 sys_rwlock_wlock(PPUThread& ppu, u32 rw_lock_id, u64 timeout)
 				return CELL_ETIMEDOUT;
 			}
 
-			ppu.cv.wait_for(lv2_lock, std::chrono::microseconds(timeout - passed));
+			fxm::get_always<lv2_timer_wheel_t>()->wait_for(ppu.cv, lv2_lock, timeout - passed);
 		}
 		else
 		{
@@ -274,6 +286,8 @@ s32 sys_rwlock_wlock(PPUThread& ppu, u32 rw_lock_id, u64 timeout)
 		throw EXCEPTION("Unexpected");
 	}
 
+	rwlock->stats.acquired++;
+
 	return CELL_OK;
 }
 
@@ -301,6 +315,7 @@ s32 sys_rwlock_trywlock(PPUThread& ppu, u32 rw_lock_id)
 	}
 
 	rwlock->writer = std::static_pointer_cast<CPUThread>(ppu.shared_from_this());
+	rwlock->stats.acquired++;
 
 	return CELL_OK;
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Utilities/SleepQueue.h"
+#include "sys_sync.h"
 
 namespace vm { using namespace ps3; }
 
@@ -30,6 +31,8 @@ struct lv2_rwlock_t
 	sleep_queue_t rsq; // threads trying to acquire readed lock
 	sleep_queue_t wsq; // threads trying to acquire writer lock
 
+	lv2_sync_stats_t stats;
+
 	lv2_rwlock_t(u32 protocol, u64 name)
 		: protocol(protocol)
 		, name(name)
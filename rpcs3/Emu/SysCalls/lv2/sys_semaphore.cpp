@@ -87,12 +87,14 @@ s32 sys_semaphore_wait(PPUThread& ppu, u32 sem_id, u64 timeout)
 	if (sem->value > 0)
 	{
 		sem->value--;
+		sem->stats.acquired++;
 		
 		return CELL_OK;
 	}
 
-	// add waiter; protocol is ignored in current implementation
-	sleep_queue_entry_t waiter(ppu, sem->sq);
+	// add waiter
+	sleep_queue_entry_t waiter(ppu, sem->sq, lv2_sync_priority(sem->protocol));
+	lv2_sync_wait_t wait_stats(sem->stats);
 
 	while (!ppu.unsignal())
 	{
@@ -107,7 +109,7 @@ s32 sys_semaphore_wait(PPUThread& ppu, u32 sem_id, u64 timeout)
 				return CELL_ETIMEDOUT;
 			}
 
-			ppu.cv.wait_for(lv2_lock, std::chrono::microseconds(timeout - passed));
+			fxm::get_always<lv2_timer_wheel_t>()->wait_for(ppu.cv, lv2_lock, timeout - passed);
 		}
 		else
 		{
@@ -115,6 +117,8 @@ s32 sys_semaphore_wait(PPUThread& ppu, u32 sem_id, u64 timeout)
 		}
 	}
 
+	sem->stats.acquired++;
+
 	return CELL_OK;
 }
 
@@ -137,6 +141,7 @@ s32 sys_semaphore_trywait(u32 sem_id)
 	}
 
 	sem->value--;
+	sem->stats.acquired++;
 
 	return CELL_OK;
 }
@@ -179,6 +184,7 @@ s32 sys_semaphore_post(u32 sem_id, s32 count)
 		}
 
 		sem->sq.pop_front();
+		sem->stats.wake();
 	}
 
 	// add the rest to the value
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Utilities/SleepQueue.h"
+#include "sys_sync.h"
 
 namespace vm { using namespace ps3; }
 
@@ -29,6 +30,8 @@ struct lv2_sema_t
 
 	sleep_queue_t sq;
 
+	lv2_sync_stats_t stats;
+
 	lv2_sema_t(u32 protocol, s32 max, u64 name, s32 value)
 		: protocol(protocol)
 		, max(max)
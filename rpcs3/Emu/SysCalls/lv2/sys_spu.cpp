@@ -6,6 +6,7 @@
 
 #include "Emu/CPU/CPUThreadManager.h"
 #include "Emu/Cell/RawSPUThread.h"
+#include "Emu/Cell/SPUHleFunctions.h"
 #include "Emu/FS/vfsStreamMemory.h"
 #include "Emu/FS/vfsFile.h"
 #include "Loader/ELF32.h"
@@ -16,6 +17,26 @@
 
 SysCallBase sys_spu("sys_spu");
 
+void lv2_spu_group_t::notify_join(lv2_lock_t& lv2_lock)
+{
+	CHECK_LV2_LOCK(lv2_lock);
+
+	for (auto& thread : join_sq)
+	{
+		thread->cv.notify_one();
+	}
+}
+
+void lv2_spu_group_t::notify_state(lv2_lock_t& lv2_lock)
+{
+	CHECK_LV2_LOCK(lv2_lock);
+
+	for (auto& thread : threads)
+	{
+		if (thread) thread->cv.notify_one();
+	}
+}
+
 void LoadSpuImage(vfsStream& stream, u32& spu_ep, u32 addr)
 {
 	loader::handlers::elf32 h;
@@ -314,6 +335,8 @@ s32 sys_spu_thread_group_start(u32 id)
 			// TODO: use segment info
 			std::memcpy(vm::base(t->offset), vm::base(image->addr), 256 * 1024);
 
+			spu_hle_register_functions(*t);
+
 			t->pc = image->entry_point;
 			t->run();
 			t->gpr[3] = v128::from64(0, args.arg1);
@@ -425,7 +448,7 @@ s32 sys_spu_thread_group_resume(u32 id)
 		if (t) t->awake(); // untrigger status check
 	}
 
-	group->cv.notify_all();
+	group->notify_state(lv2_lock);
 
 	return CELL_OK;
 }
@@ -507,7 +530,7 @@ s32 sys_spu_thread_group_terminate(u32 id, s32 value)
 	group->state = SPU_THREAD_GROUP_STATUS_INITIALIZED;
 	group->exit_status = value;
 	group->join_state |= SPU_TGJSF_TERMINATED;
-	group->cv.notify_one();
+	group->notify_join(lv2_lock);
 
 	return CELL_OK;
 }
@@ -536,6 +559,11 @@ s32 sys_spu_thread_group_join(u32 id, vm::ptr<u32> cause, vm::ptr<u32> status)
 		return CELL_EBUSY;
 	}
 
+	const auto cpu = get_current_cpu_thread();
+
+	// add waiter (notified by notify_join())
+	sleep_queue_entry_t waiter(*cpu, group->join_sq);
+
 	while ((group->join_state & ~SPU_TGJSF_IS_JOINING) == 0)
 	{
 		bool stopped = true;
@@ -559,7 +587,7 @@ s32 sys_spu_thread_group_join(u32 id, vm::ptr<u32> cause, vm::ptr<u32> status)
 
 		CHECK_EMU_STATUS;
 
-		group->cv.wait_for(lv2_lock, std::chrono::milliseconds(1));
+		cpu->cv.wait(lv2_lock);
 	}
 
 	switch (group->join_state & ~SPU_TGJSF_IS_JOINING)
@@ -634,6 +662,8 @@ s32 sys_spu_thread_write_ls(u32 id, u32 lsa, u64 value, u32 type)
 	default: return CELL_EINVAL;
 	}
 
+	thread->code_write(lsa, type);
+
 	return CELL_OK;
 }
 
@@ -929,6 +959,8 @@ s32 sys_spu_thread_connect_event(u32 id, u32 eq, u32 et, u8 spup)
 		return CELL_EISCONN;
 	}
 
+	std::lock_guard<std::mutex> thread_lock(thread->mutex);
+
 	port = queue;
 
 	return CELL_OK;
@@ -960,6 +992,8 @@ s32 sys_spu_thread_disconnect_event(u32 id, u32 et, u8 spup)
 		return CELL_ENOTCONN;
 	}
 
+	std::lock_guard<std::mutex> thread_lock(thread->mutex);
+
 	port.reset();
 
 	return CELL_OK;
@@ -1097,6 +1131,8 @@ s32 sys_spu_thread_group_connect_event_all_threads(u32 id, u32 eq, u64 req, vm::
 	{
 		if (t)
 		{
+			std::lock_guard<std::mutex> thread_lock(t->mutex);
+
 			t->spup[port] = queue;
 		}
 	}
@@ -1128,6 +1164,8 @@ s32 sys_spu_thread_group_disconnect_event_all_threads(u32 id, u8 spup)
 	{
 		if (t)
 		{
+			std::lock_guard<std::mutex> thread_lock(t->mutex);
+
 			t->spup[spup].reset();
 		}
 	}
@@ -159,7 +159,7 @@ struct lv2_spu_group_t
 	s32 exit_status; // SPU Thread Group Exit Status
 
 	std::atomic<u32> join_state; // flags used to detect exit cause
-	std::condition_variable cv; // used to signal waiting PPU thread
+	sleep_queue_t join_sq; // PPU thread waiting in sys_spu_thread_group_join
 
 	std::weak_ptr<lv2_event_queue_t> ep_run; // port for SYS_SPU_THREAD_GROUP_EVENT_RUN events
 	std::weak_ptr<lv2_event_queue_t> ep_exception; // TODO: SYS_SPU_THREAD_GROUP_EVENT_EXCEPTION
@@ -177,13 +177,21 @@ struct lv2_spu_group_t
 	{
 	}
 
+	// wake the joining PPU thread after the exit cause or SPU thread status was changed
+	void notify_join(lv2_lock_t& lv2_lock);
+
+	// wake SPU threads waiting for the group to leave WAITING or SUSPENDED state
+	void notify_state(lv2_lock_t& lv2_lock);
+
 	void send_run_event(lv2_lock_t& lv2_lock, u64 data1, u64 data2, u64 data3)
 	{
 		CHECK_LV2_LOCK(lv2_lock);
 
 		if (const auto queue = ep_run.lock())
 		{
-			queue->push(lv2_lock, SYS_SPU_THREAD_GROUP_EVENT_RUN_KEY, data1, data2, data3);
+			lv2_lock_t queue_lock(queue->sync_mutex);
+
+			queue->push(queue_lock, SYS_SPU_THREAD_GROUP_EVENT_RUN_KEY, data1, data2, data3);
 		}
 	}
 
@@ -193,7 +201,9 @@ struct lv2_spu_group_t
 
 		if (const auto queue = ep_exception.lock())
 		{
-			queue->push(lv2_lock, SYS_SPU_THREAD_GROUP_EVENT_EXCEPTION_KEY, data1, data2, data3);
+			lv2_lock_t queue_lock(queue->sync_mutex);
+
+			queue->push(queue_lock, SYS_SPU_THREAD_GROUP_EVENT_EXCEPTION_KEY, data1, data2, data3);
 		}
 	}
 
@@ -203,7 +213,9 @@ struct lv2_spu_group_t
 
 		if (const auto queue = ep_sysmodule.lock())
 		{
-			queue->push(lv2_lock, SYS_SPU_THREAD_GROUP_EVENT_SYSTEM_MODULE_KEY, data1, data2, data3);
+			lv2_lock_t queue_lock(queue->sync_mutex);
+
+			queue->push(queue_lock, SYS_SPU_THREAD_GROUP_EVENT_SYSTEM_MODULE_KEY, data1, data2, data3);
 		}
 	}
 };
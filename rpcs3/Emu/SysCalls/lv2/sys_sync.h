@@ -1,5 +1,8 @@
 #pragma once
 
+#include "Emu/IdManager.h"
+#include "Emu/SysCalls/TimerWheel.h"
+
 namespace vm { using namespace ps3; }
 
 // attr_protocol (waiting scheduling policy)
@@ -40,3 +43,70 @@ enum
 	SYS_SYNC_ADAPTIVE     = 0x1000,
 	SYS_SYNC_NOT_ADAPTIVE = 0x2000,
 };
+
+// Check whether waiters of lv2 sync object with given protocol are woken in thread priority order
+inline bool lv2_sync_priority(u32 protocol)
+{
+	return protocol == SYS_SYNC_PRIORITY || protocol == SYS_SYNC_PRIORITY_INHERIT;
+}
+
+// Per-object locking of lv2 sync primitives.
+// lv2_mutex_t, lv2_lwmutex_t and lv2_event_queue_t own a sync_mutex protecting their state and sleep queue.
+// lv2_cond_t and lv2_lwcond_t use the sync_mutex of the associated (lw)mutex, because their waiters are moved
+// to the mutex sleep queue and must be signaled under the same lock they are waiting with.
+// Lock order: LV2_LOCK (process-wide objects) -> sync_mutex -> CPUThread::mutex. Only one sync_mutex is held at a time.
+
+// Lock sync_mutex and check that the object (obtained by id) was not destroyed before the lock was acquired
+template<typename T> bool lv2_sync_lock(lv2_lock_t& lv2_lock, std::mutex& sync_mutex, u32 id, const std::shared_ptr<T>& object)
+{
+	lv2_lock = lv2_lock_t(sync_mutex);
+
+	return idm::get<T>(id) == object;
+}
+
+#define CHECK_LV2_SYNC_LOCK(x, m) if (!(x).owns_lock() || (x).mutex() != &(m)) throw EXCEPTION("lv2 sync lock is invalid or not locked")
+
+extern u64 get_system_time();
+
+// Contention statistics of an lv2 sync object (displayed by the Kernel Explorer)
+struct lv2_sync_stats_t
+{
+	std::atomic<u64> acquired{ 0 }; // successful lock, wait or receive operations
+	std::atomic<u64> contended{ 0 }; // operations which had to sleep (including timed out ones)
+	std::atomic<u64> wait_time{ 0 }; // total sleep time (us)
+	std::atomic<u64> max_wait{ 0 }; // longest sleep (us)
+	std::atomic<u64> wakes{ 0 }; // waiters woken by unlock, signal, post, send or set
+
+	void wake(u64 count = 1)
+	{
+		wakes += count;
+	}
+
+	void waited(u64 time)
+	{
+		contended++;
+		wait_time += time;
+
+		for (u64 max = max_wait; time > max && !max_wait.compare_exchange_weak(max, time);)
+		{
+		}
+	}
+};
+
+// Records the sleep of a waiter in the object stats when destroyed (create it when the thread starts waiting)
+class lv2_sync_wait_t final
+{
+	lv2_sync_stats_t& m_stats;
+	const u64 m_start = get_system_time();
+
+public:
+	lv2_sync_wait_t(lv2_sync_stats_t& stats)
+		: m_stats(stats)
+	{
+	}
+
+	~lv2_sync_wait_t()
+	{
+		m_stats.waited(get_system_time() - m_start);
+	}
+};
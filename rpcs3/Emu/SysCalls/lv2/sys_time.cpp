@@ -41,6 +41,8 @@ const g_time_aux_info = []() -> time_aux_info_t // initialize time-related value
 #else
 
 #include "errno.h"
+#include <cpuid.h>
+#include <x86intrin.h>
 
 #endif
 
@@ -48,8 +50,8 @@ SysCallBase sys_time("sys_time");
 
 static const u64 g_timebase_freq = /*79800000*/ 80000000; // 80 Mhz
 
-// Auxiliary functions
-u64 get_timebased_time()
+// Monotonic OS clock in nanoseconds
+static u64 get_os_time_ns()
 {
 #ifdef _WIN32
 	LARGE_INTEGER count;
@@ -61,45 +63,204 @@ u64 get_timebased_time()
 	const u64 time = count.QuadPart;
 	const u64 freq = g_time_aux_info.perf_freq;
 
-	return time / freq * g_timebase_freq + time % freq * g_timebase_freq / freq;
+	return time / freq * 1000000000u + time % freq * 1000000000u / freq;
 #else
 	struct timespec ts;
 	if (::clock_gettime(CLOCK_MONOTONIC, &ts))
 	{
 		throw EXCEPTION("System error %d", errno);
 	}
-	
-	return static_cast<u64>(ts.tv_sec) * g_timebase_freq + static_cast<u64>(ts.tv_nsec) * g_timebase_freq / 1000000000u;
+
+	return static_cast<u64>(ts.tv_sec) * 1000000000u + static_cast<u64>(ts.tv_nsec);
+#endif
+}
+
+static bool invariant_tsc_supported()
+{
+	// Invariant TSC (CPUID.80000007H:EDX[8]) runs at a constant rate in all power states
+#ifdef _MSC_VER
+	int regs[4];
+	__cpuid(regs, 0x80000000);
+
+	if ((u32)regs[0] < 0x80000007)
+	{
+		return false;
+	}
+
+	__cpuid(regs, 0x80000007);
+	return (regs[3] & (1 << 8)) != 0;
+#else
+	if (__get_cpuid_max(0x80000000, nullptr) < 0x80000007)
+	{
+		return false;
+	}
+
+	u32 eax, ebx, ecx, edx;
+	__cpuid(0x80000007, eax, ebx, ecx, edx);
+	return (edx & (1 << 8)) != 0;
 #endif
 }
 
+// (a * b) >> 32 without overflow
+static inline u64 mul_shr32(u64 a, u64 b)
+{
+#ifdef _MSC_VER
+	u64 high;
+	const u64 low = _umul128(a, b, &high);
+	return high << 32 | low >> 32;
+#else
+	return static_cast<u64>((static_cast<unsigned __int128>(a) * b) >> 32);
+#endif
+}
+
+// RDTSC clock calibrated against the OS clock at startup, reading it doesn't enter the kernel
+const struct tsc_clock_t
+{
+	u64 start_tsc;
+	u64 start_ns;
+	u64 ns_mult; // nanoseconds per TSC tick (32.32 fixed point), 0 if the OS clock must be used
+
+	tsc_clock_t()
+		: start_tsc(0)
+		, start_ns(0)
+		, ns_mult(0)
+	{
+		if (!invariant_tsc_supported())
+		{
+			return;
+		}
+
+		const u64 tsc0 = __rdtsc();
+		const u64 ns0 = get_os_time_ns();
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+		const u64 tsc1 = __rdtsc();
+		const u64 ns1 = get_os_time_ns();
+
+		if (tsc1 <= tsc0 || ns1 <= ns0)
+		{
+			return;
+		}
+
+		const u64 freq = static_cast<u64>(static_cast<double>(tsc1 - tsc0) * 1e9 / (ns1 - ns0));
+
+		if (freq < 1000000)
+		{
+			return;
+		}
+
+		start_tsc = tsc1;
+		start_ns = ns1;
+		ns_mult = (1000000000ull << 32) / freq;
+	}
+
+	u64 get_ns() const
+	{
+		return ns_mult ? start_ns + mul_shr32(__rdtsc() - start_tsc, ns_mult) : get_os_time_ns();
+	}
+}
+g_tsc_clock;
+
+// Auxiliary functions
+u64 get_timebased_time()
+{
+	const u64 ns = g_tsc_clock.get_ns();
+
+	// 80 MHz timebase: 8 ticks per 100 ns
+	return ns / 100 * 8 + ns % 100 * 8 / 100;
+}
+
 // Returns some relative time in microseconds, don't change this fact
 u64 get_system_time()
 {
 	while (true)
 	{
+		const u64 result = g_tsc_clock.get_ns() / 1000;
+
+		if (result) return result;
+	}
+}
+
 #ifdef _WIN32
-		LARGE_INTEGER count;
-		if (!QueryPerformanceCounter(&count))
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+// Per-thread waitable timer (high-resolution timers are only available since Windows 10 1803)
+thread_local const struct hr_timer_t
+{
+	HANDLE handle;
+	u64 slack; // expected timer inaccuracy (microseconds)
+
+	hr_timer_t()
+	{
+		handle = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+		slack = 500;
+
+		if (!handle)
 		{
-			throw EXCEPTION("Unexpected");
+			handle = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+			slack = 2000;
 		}
+	}
+
+	~hr_timer_t()
+	{
+		if (handle) CloseHandle(handle);
+	}
+}
+g_tls_hr_timer;
 
-		const u64 time = count.QuadPart;
-		const u64 freq = g_time_aux_info.perf_freq;
+#endif
 
-		const u64 result = time / freq * 1000000u + (time % freq) * 1000000u / freq;
+// Sleep until get_system_time() >= deadline (sleeps on high-resolution timer, then yields for the remaining time)
+void wait_until_system_time(u64 deadline)
+{
+#ifdef _WIN32
+	const u64 slack = g_tls_hr_timer.handle ? g_tls_hr_timer.slack : 2000;
 #else
-		struct timespec ts;
-		if (::clock_gettime(CLOCK_MONOTONIC, &ts))
+	const u64 slack = 100;
+#endif
+
+	while (true)
+	{
+		const u64 now = get_system_time();
+
+		if (now >= deadline)
 		{
-			throw EXCEPTION("System error %d", errno);
+			return;
 		}
 
-		const u64 result = static_cast<u64>(ts.tv_sec) * 1000000u + static_cast<u64>(ts.tv_nsec) / 1000u;
-#endif
+		if (deadline - now <= slack)
+		{
+			std::this_thread::yield();
+			continue;
+		}
 
-		if (result) return result;
+#ifdef _WIN32
+		if (g_tls_hr_timer.handle)
+		{
+			LARGE_INTEGER due;
+			due.QuadPart = -static_cast<s64>((deadline - now - slack) * 10); // relative time in 100ns units
+
+			if (SetWaitableTimer(g_tls_hr_timer.handle, &due, 0, nullptr, nullptr, FALSE))
+			{
+				WaitForSingleObject(g_tls_hr_timer.handle, INFINITE);
+				continue;
+			}
+		}
+
+		std::this_thread::sleep_for(std::chrono::microseconds(deadline - now - slack));
+#else
+		struct timespec ts;
+		ts.tv_sec = (deadline - slack) / 1000000;
+		ts.tv_nsec = (deadline - slack) % 1000000 * 1000;
+
+		// get_system_time() is based on CLOCK_MONOTONIC, so absolute time can be used directly
+		::clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr);
+#endif
 	}
 }
 
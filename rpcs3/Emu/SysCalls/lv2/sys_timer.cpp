@@ -12,63 +12,68 @@
 SysCallBase sys_timer("sys_timer");
 
 extern u64 get_system_time();
+extern void wait_until_system_time(u64 deadline);
 
-void lv2_timer_t::on_task()
+void lv2_timer_t::on_expire()
 {
-	std::unique_lock<std::mutex> lock(mutex);
+	LV2_LOCK;
 
-	while (state <= SYS_TIMER_STATE_RUN)
+	// the timer could be stopped or restarted before the lock was acquired
+	if (state != SYS_TIMER_STATE_RUN || get_system_time() < expire)
 	{
-		CHECK_EMU_STATUS;
+		return;
+	}
 
-		if (state == SYS_TIMER_STATE_RUN)
-		{
-			if (lock) lock.unlock();
-
-			LV2_LOCK;
-
-			if (get_system_time() >= expire)
-			{
-				const auto queue = port.lock();
-
-				if (queue)
-				{
-					queue->push(lv2_lock, source, data1, data2, expire);
-				}
-
-				if (period && queue)
-				{
-					expire += period; // set next expiration time
-
-					continue; // hack: check again
-				}
-				else
-				{
-					state = SYS_TIMER_STATE_STOP; // stop if oneshot or the event port was disconnected (TODO: is it correct?)
-				}
-			}
-		}
+	const auto queue = port.lock();
 
-		if (!lock)
-		{
-			lock.lock();
-			continue;
-		}
+	if (queue)
+	{
+		lv2_lock_t queue_lock(queue->sync_mutex);
 
-		cv.wait_for(lock, std::chrono::milliseconds(1));
+		queue->push(queue_lock, source, data1, data2, expire);
+	}
+
+	if (period && queue)
+	{
+		expire += period; // set next expiration time
+
+		fxm::get_always<lv2_timer_wheel_t>()->schedule(entry, expire);
+	}
+	else
+	{
+		state = SYS_TIMER_STATE_STOP; // stop if oneshot or the event port was disconnected (TODO: is it correct?)
 	}
 }
 
 lv2_timer_t::lv2_timer_t()
 	: id(idm::get_last_id())
+	, entry(std::make_shared<lv2_timer_wheel_t::entry_t>())
+{
+}
+
+lv2_timer_t::~lv2_timer_t()
 {
+	if (const auto wheel = fxm::get<lv2_timer_wheel_t>())
+	{
+		wheel->cancel(entry);
+	}
 }
 
 s32 sys_timer_create(vm::ptr<u32> timer_id)
 {
 	sys_timer.warning("sys_timer_create(timer_id=*0x%x)", timer_id);
 
-	*timer_id = idm::make<lv2_timer_t>();
+	const auto timer = idm::make_ptr<lv2_timer_t>();
+
+	timer->entry->callback = [ptr = std::weak_ptr<lv2_timer_t>(timer)]()
+	{
+		if (const auto timer = ptr.lock())
+		{
+			timer->on_expire();
+		}
+	};
+
+	*timer_id = timer->id;
 
 	return CELL_OK;
 }
@@ -163,14 +168,11 @@ s32 _sys_timer_start(u32 timer_id, u64 base_time, u64 period)
 
 	// sys_timer_start_periodic() will use current time (TODO: is it correct?)
 
-	// lock for reliable notification
-	std::lock_guard<std::mutex> lock(timer->mutex);
-
 	timer->expire = base_time ? base_time : start_time + period;
 	timer->period = period;
 	timer->state  = SYS_TIMER_STATE_RUN;
 
-	timer->cv.notify_one();
+	fxm::get_always<lv2_timer_wheel_t>()->schedule(timer->entry, timer->expire);
 
 	return CELL_OK;
 }
@@ -190,6 +192,8 @@ s32 sys_timer_stop(u32 timer_id)
 
 	timer->state = SYS_TIMER_STATE_STOP; // stop timer
 
+	fxm::get_always<lv2_timer_wheel_t>()->cancel(timer->entry);
+
 	return CELL_OK;
 }
 
@@ -241,6 +245,8 @@ s32 sys_timer_disconnect_event_queue(u32 timer_id)
 	timer->port.reset(); // disconnect event queue
 	timer->state = SYS_TIMER_STATE_STOP; // stop timer
 
+	fxm::get_always<lv2_timer_wheel_t>()->cancel(timer->entry);
+
 	return CELL_OK;
 }
 
@@ -254,17 +260,14 @@ s32 sys_timer_sleep(u32 sleep_time)
 
 	u64 passed;
 
-	while (useconds > (passed = get_system_time() - start_time) + 1000)
+	while (useconds > (passed = get_system_time() - start_time) + 10000)
 	{
 		CHECK_EMU_STATUS;
 
-		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		wait_until_system_time(start_time + passed + 10000);
 	}
 	
-	if (useconds > passed)
-	{
-		std::this_thread::sleep_for(std::chrono::microseconds(useconds - passed));
-	}
+	wait_until_system_time(start_time + useconds);
 
 	return CELL_OK;
 }
@@ -277,17 +280,14 @@ s32 sys_timer_usleep(u64 sleep_time)
 
 	u64 passed;
 
-	while (sleep_time > (passed = get_system_time() - start_time) + 1000)
+	while (sleep_time > (passed = get_system_time() - start_time) + 10000)
 	{
 		CHECK_EMU_STATUS;
 
-		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		wait_until_system_time(start_time + passed + 10000);
 	}
 
-	if (sleep_time > passed)
-	{
-		std::this_thread::sleep_for(std::chrono::microseconds(sleep_time - passed));
-	}
+	wait_until_system_time(start_time + sleep_time);
 
 	return CELL_OK;
 }
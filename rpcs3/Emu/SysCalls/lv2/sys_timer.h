@@ -1,6 +1,6 @@
 #pragma once
 
-#include "Utilities/Thread.h"
+#include "Emu/SysCalls/TimerWheel.h"
 
 namespace vm { using namespace ps3; }
 
@@ -19,23 +19,12 @@ struct sys_timer_information_t
 	be_t<u32> pad;
 };
 
-class lv2_timer_t final : public named_thread_t
+class lv2_timer_t final
 {
-	void on_task() override;
-
-	void on_id_aux_finalize() override
-	{
-		// Signal thread using invalid state and join
-		{ std::lock_guard<std::mutex>{mutex}, state = -1; }
-
-		cv.notify_one();
-		join();
-	}
-
 public:
 	lv2_timer_t();
 
-	std::string get_name() const override { return fmt::format("Timer Thread[0x%x]", id); }
+	~lv2_timer_t();
 
 	const u32 id;
 
@@ -47,7 +36,12 @@ public:
 	u64 expire = 0; // next expiration time
 	u64 period = 0; // period (oneshot if 0)
 
-	std::atomic<u32> state{ SYS_TIMER_STATE_RUN }; // timer state
+	std::atomic<u32> state{ SYS_TIMER_STATE_STOP }; // timer state
+
+	const std::shared_ptr<lv2_timer_wheel_t::entry_t> entry; // scheduled expiration
+
+	// Send the event and schedule the next expiration (called by the timer wheel)
+	void on_expire();
 };
 
 s32 sys_timer_create(vm::ptr<u32> timer_id);
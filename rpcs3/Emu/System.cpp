@@ -17,15 +17,24 @@
 #include "Emu/FS/vfsDeviceLocalFile.h"
 
 #include "Emu/CPU/CPUThreadManager.h"
+#include "Emu/CPU/HostThreadPolicy.h"
+#include "Utilities/Trace.h"
+#include "Emu/PerfCounters.h"
+#include "Emu/Benchmark.h"
+#include "Emu/TitleProfile.h"
 #include "Emu/SysCalls/Callback.h"
 #include "Emu/IdManager.h"
 #include "Emu/Io/Pad.h"
 #include "Emu/Io/Keyboard.h"
 #include "Emu/Io/Mouse.h"
 #include "Emu/RSX/GSManager.h"
+#include "Emu/RSX/GSRender.h"
 #include "Emu/Audio/AudioManager.h"
 #include "Emu/FS/VFS.h"
 #include "Emu/Event.h"
+#include "Emu/SysCalls/lv2/sys_mutex.h"
+#include "Emu/SysCalls/lv2/sys_lwmutex.h"
+#include "Emu/SysCalls/lv2/sys_event.h"
 
 #include "Loader/PSF.h"
 #include "Loader/ELF64.h"
@@ -62,6 +71,8 @@ extern std::atomic<u32> g_thread_count;
 
 extern u64 get_system_time();
 extern void finalize_psv_modules();
+extern void init_syscall_dispatch();
+extern void log_syscall_stats();
 
 Emulator::Emulator()
 	: m_status(Stopped)
@@ -187,16 +198,35 @@ void Emulator::Load()
 			m_path += ".decrypted.elf";
 		}
 
+		const u64 decrypt_start = get_system_time();
+
 		if (!DecryptSelf(m_path, elf_dir + elf_name))
 		{
 			m_status = Stopped;
 			return;
 		}
+
+		LOG_NOTICE(LOADER, "Load time: SELF decrypted in %llu us", get_system_time() - decrypt_start);
 	}
 
 	ResetInfo();
+	perf::reset();
+	host_thread_policy::reset();
 	GetVFS().Init(elf_dir);
 
+	if (rpcs3::config.misc.log.binary_trace.value())
+	{
+		if (!_log::g_trace.open(fs::get_config_dir() + "RPCS3.trace", rpcs3::config.misc.log.binary_trace_size.value() * 0x100000ull))
+		{
+			LOG_ERROR(GENERAL, "Failed to create binary trace file");
+		}
+	}
+
+	if (rpcs3::config.misc.log.timeline.value())
+	{
+		_log::g_timeline.start();
+	}
+
 	LOG_NOTICE(LOADER, "Loading '%s'...", m_path.c_str());
 
 	// /dev_bdvd/ mounting
@@ -255,6 +285,9 @@ void Emulator::Load()
 		}
 	}
 
+	title_profile::configure(GetTitleID());
+	bench::configure();
+
 	LOG_NOTICE(LOADER, "Used configuration: '%s'", rpcs3::state.config.path().c_str());
 	LOG_NOTICE(LOADER, "");
 	LOG_NOTICE(LOADER, rpcs3::state.config.to_string().c_str());
@@ -276,6 +309,8 @@ void Emulator::Load()
 		return;
 	}
 
+	const u64 load_start = get_system_time();
+
 	if (!m_loader.load(f))
 	{
 		LOG_ERROR(LOADER, "Loading '%s' failed", m_path.c_str());
@@ -284,6 +319,8 @@ void Emulator::Load()
 		vm::close();
 		return;
 	}
+
+	LOG_NOTICE(LOADER, "Load time: executable loaded in %llu us", get_system_time() - load_start);
 	
 	LoadPoints(fs::get_config_dir() + BreakPointsDBName);
 
@@ -315,6 +352,8 @@ void Emulator::Run()
 
 	SendDbgCommand(DID_START_EMU);
 
+	init_syscall_dispatch();
+
 	m_pause_start_time = 0;
 	m_pause_amend_time = 0;
 	m_status = Running;
@@ -323,6 +362,80 @@ void Emulator::Run()
 	SendDbgCommand(DID_STARTED_EMU);
 }
 
+void Emulator::ReplayCapture(const std::string& path, u32 loops)
+{
+	if (!IsStopped())
+	{
+		Stop();
+	}
+
+	const auto capture = std::make_shared<frame_capture_data>();
+
+	if (!capture->load(path) || !capture->is_replayable())
+	{
+		LOG_ERROR(GENERAL, "Failed to load RSX capture '%s'", path);
+		return;
+	}
+
+	LOG_NOTICE(LOADER, "Replaying RSX capture '%s'...", path);
+
+	ResetInfo();
+	perf::reset();
+	SetTitle(path);
+	rpcs3::state.config = rpcs3::config;
+
+	if (rpcs3::config.misc.log.timeline.value())
+	{
+		_log::g_timeline.start();
+	}
+
+	vm::ps3::init();
+
+	// Restore memory allocations and the IO mapping of the capture (contents are restored by every replay loop)
+	if (capture->local_size)
+	{
+		vm::falloc(capture->local_address, capture->local_size, vm::video);
+	}
+
+	for (const auto& block : capture->memory)
+	{
+		for (u32 page = block.addr; page < block.addr + block.size; page += 4096)
+		{
+			if (!vm::check_addr(page, 4096))
+			{
+				vm::falloc(page, 4096);
+			}
+		}
+	}
+
+	RSXIOMem.SetRange(0, 0x10000000);
+
+	for (const auto& mapping : capture->io_map)
+	{
+		RSXIOMem.Map(mapping.ea, mapping.size, mapping.io);
+	}
+
+	const u32 ctrl_addr = vm::alloc(sizeof(CellGcmControl), vm::main);
+
+	m_status = Running;
+	SendDbgCommand(DID_START_EMU);
+
+	GetGSManager().Init();
+	GetCallbackManager().Init();
+
+	auto& render = GetGSManager().GetRender();
+	render.replay_capture = capture;
+	render.replay_loops = std::max<u32>(loops, 1);
+	render.gcm_buffers.set(capture->display_buffers_address);
+	render.gcm_buffers_count = capture->display_buffers_count;
+	render.gcm_current_buffer = 0;
+	render.main_mem_addr = 0;
+	render.label_addr = capture->label_address;
+	render.init(capture->io_address, capture->io_size, ctrl_addr, capture->local_address);
+
+	SendDbgCommand(DID_STARTED_EMU);
+}
+
 bool Emulator::Pause()
 {
 	const u64 start = get_system_time();
@@ -401,9 +514,29 @@ void Emulator::Stop()
 	rpcs3::onstop();
 	SendDbgCommand(DID_STOP_EMU);
 
+	// threads are still running: their CPU time is sampled for the benchmark report
+	bench::on_stop();
+	title_profile::on_stop();
+
 	{
 		LV2_LOCK;
 
+		// threads waiting on lv2 sync objects check the status under the object lock (see sys_sync.h)
+		for (auto& mutex : idm::get_all<lv2_mutex_t>())
+		{
+			std::lock_guard<std::mutex> lock(mutex->sync_mutex);
+		}
+
+		for (auto& mutex : idm::get_all<lv2_lwmutex_t>())
+		{
+			std::lock_guard<std::mutex> lock(mutex->sync_mutex);
+		}
+
+		for (auto& queue : idm::get_all<lv2_event_queue_t>())
+		{
+			std::lock_guard<std::mutex> lock(queue->sync_mutex);
+		}
+
 		// notify all threads
 		for (auto& t : GetCPU().GetAllThreads())
 		{
@@ -426,6 +559,26 @@ void Emulator::Stop()
 
 	LOG_NOTICE(GENERAL, "All threads stopped...");
 
+	log_syscall_stats();
+
+	// final stats are logged with --perf
+	perf::update(true);
+	perf::log_memory();
+
+	if (_log::g_timeline.enabled())
+	{
+		const std::string path = fs::get_config_dir() + "RPCS3.timeline.json";
+
+		if (_log::g_timeline.stop(path))
+		{
+			LOG_NOTICE(GENERAL, "Timeline saved to %s", path);
+		}
+		else
+		{
+			LOG_ERROR(GENERAL, "Failed to save timeline to %s", path);
+		}
+	}
+
 	idm::clear();
 	fxm::clear();
 
@@ -245,6 +245,10 @@ public:
 
 	void Load();
 	void Run();
+
+	// Replay RSX capture file (recorded by the debugger "Capture frame" button) loops times without running a game
+	void ReplayCapture(const std::string& path, u32 loops);
+
 	bool Pause();
 	void Resume();
 	void Stop();
@@ -260,6 +264,7 @@ public:
 
 extern Emulator Emu;
 
+// LV2_LOCK protects process-wide lv2 state; lv2 sync primitives use per-object locks (see sys_sync.h) taken after it
 using lv2_lock_t = std::unique_lock<std::mutex>;
 
 inline bool check_lv2_lock(lv2_lock_t& lv2_lock)
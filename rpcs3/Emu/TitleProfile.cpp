@@ -0,0 +1,284 @@
+#include "stdafx.h"
+#include "Utilities/Log.h"
+#include "Utilities/File.h"
+#include "Emu/state.h"
+#include "Benchmark.h"
+#include "TitleProfile.h"
+
+#include <numeric>
+
+extern u64 get_system_time();
+
+namespace title_profile
+{
+	// Variant of the tuning options, applied on top of the configuration of the game
+	struct candidate_t
+	{
+		const char* name; // key in the profile store
+		const char* description;
+		bool(*applicable)(); // the variant would change the configuration
+		void(*apply)();
+	};
+
+	// Measurements of a candidate (all runs of the title)
+	struct record_t
+	{
+		u32 runs = 0;
+		u64 frames = 0;
+		u64 total_us = 0; // sum of frame times
+		u64 low_1_percent_us = 0; // average of the slowest 1% of frames (last run)
+	};
+
+	static const u32 warmup_frames = 600; // frames ignored at the start (loading screens, shader compilation)
+	static const u32 min_frames = 1000; // frames to measure for a run to be recorded
+
+	static const candidate_t g_candidates[] =
+	{
+		{
+			"default", "settings of the title",
+			[] { return true; },
+			[] {},
+		},
+		{
+			"ppu_threshold_low", "PPU blocks compiled after 4x fewer executions",
+			[] { return rpcs3::state.config.core.ppu_decoder.value() == ppu_decoder_type::recompiler_llvm && rpcs3::state.config.core.llvm.threshold.value() > 1; },
+			[] { rpcs3::state.config.core.llvm.threshold = std::max<u32>(rpcs3::state.config.core.llvm.threshold.value() / 4, 1); },
+		},
+		{
+			"ppu_threshold_high", "PPU blocks compiled after 4x more executions (fewer compilations)",
+			[] { return rpcs3::state.config.core.ppu_decoder.value() == ppu_decoder_type::recompiler_llvm; },
+			[] { rpcs3::state.config.core.llvm.threshold = rpcs3::state.config.core.llvm.threshold.value() * 4; },
+		},
+		{
+			"ppu_no_exclusion", "excluded PPU block range compiled",
+			[] { return rpcs3::state.config.core.ppu_decoder.value() == ppu_decoder_type::recompiler_llvm && rpcs3::state.config.core.llvm.exclusion_range.value(); },
+			[] { rpcs3::state.config.core.llvm.exclusion_range = false; },
+		},
+		{
+			"spu_recompiler", "SPU recompiler",
+			[] { return rpcs3::state.config.core.spu_decoder.value() != spu_decoder_type::recompiler_asmjit; },
+			[] { rpcs3::state.config.core.spu_decoder = spu_decoder_type::recompiler_asmjit; },
+		},
+		{
+			"no_color_buffer_writes", "color buffers not written to memory (may break effects reading them)",
+			[] { return rpcs3::state.config.rsx.renderer.value() != rsx_renderer_type::Null && rpcs3::state.config.rsx.opengl.write_color_buffers.value(); },
+			[] { rpcs3::state.config.rsx.opengl.write_color_buffers = false; },
+		},
+		{
+			"no_depth_buffer_reads", "depth buffer not read from memory (may break effects writing it)",
+			[] { return rpcs3::state.config.rsx.renderer.value() != rsx_renderer_type::Null && rpcs3::state.config.rsx.opengl.read_depth_buffer.value(); },
+			[] { rpcs3::state.config.rsx.opengl.read_depth_buffer = false; },
+		},
+	};
+
+	static std::mutex g_mutex;
+	static std::atomic<bool> g_active{ false };
+	static std::string g_title; // title ID (as in the data directory)
+	static std::string g_path; // profile store
+	static std::string g_candidate; // applied candidate
+	static std::map<std::string, record_t> g_records;
+
+	static u64 g_flips = 0;
+	static u64 g_last = 0; // time of the last flip
+	static std::vector<u64> g_intervals; // frame times measured after the warmup (us)
+
+	static std::map<std::string, record_t> load_store(const std::string& path)
+	{
+		std::map<std::string, record_t> result;
+
+		fs::file file(path);
+
+		if (!file)
+		{
+			return result;
+		}
+
+		for (const auto& line : fmt::split(file.to_string(), { "\n", "\r" }))
+		{
+			const auto tokens = fmt::split(line, { " " });
+
+			if (tokens.empty() || tokens[0][0] == '#')
+			{
+				continue;
+			}
+
+			record_t& record = result[tokens[0]];
+
+			for (std::size_t i = 1; i < tokens.size(); i++)
+			{
+				const auto pos = tokens[i].find('=');
+
+				if (pos == std::string::npos)
+				{
+					continue;
+				}
+
+				const std::string key = tokens[i].substr(0, pos);
+				const u64 value = std::strtoull(tokens[i].c_str() + pos + 1, nullptr, 10);
+
+				if (key == "runs") record.runs = static_cast<u32>(value);
+				else if (key == "frames") record.frames = value;
+				else if (key == "total_us") record.total_us = value;
+				else if (key == "low_1_percent_us") record.low_1_percent_us = value;
+			}
+		}
+
+		return result;
+	}
+
+	static void save_store(const std::string& path, const std::map<std::string, record_t>& records)
+	{
+		std::string out = "# Automatic performance profile: frame times measured with each candidate (see TitleProfile.h)\n";
+
+		for (const auto& r : records)
+		{
+			out += fmt::format("%s runs=%u frames=%llu total_us=%llu low_1_percent_us=%llu\n", r.first, r.second.runs, r.second.frames, r.second.total_us, r.second.low_1_percent_us);
+		}
+
+		fs::file file(path, fom::rewrite);
+
+		if (!file)
+		{
+			LOG_ERROR(GENERAL, "Profile: failed to write %s", path);
+			return;
+		}
+
+		file.write(out);
+	}
+
+	static double average_ms(const record_t& record)
+	{
+		return record.frames ? record.total_us / 1000. / record.frames : 0.;
+	}
+}
+
+void title_profile::configure(const std::string& title_id)
+{
+	// Benchmark runs must use the configuration as is
+	if (!rpcs3::config.misc.auto_profiles.value() || title_id.size() < 9 || bench::enabled())
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(g_mutex);
+
+	g_title = title_id.substr(0, 4) + "-" + title_id.substr(4, 5);
+
+	const std::string dir = fs::get_config_dir() + "data/" + g_title + "/";
+
+	if (!fs::is_dir(dir) && !fs::create_path(dir))
+	{
+		LOG_ERROR(GENERAL, "Profile: failed to create %s", dir);
+		return;
+	}
+
+	g_path = dir + "profile.txt";
+	g_records = load_store(g_path);
+
+	// Try every candidate once in order, then apply the one with the lowest average frame time
+	const candidate_t* chosen = nullptr;
+	const candidate_t* untried = nullptr;
+	u32 untried_count = 0;
+
+	for (const auto& candidate : g_candidates)
+	{
+		if (!candidate.applicable())
+		{
+			continue;
+		}
+
+		const auto found = g_records.find(candidate.name);
+
+		if (found == g_records.end() || !found->second.frames)
+		{
+			LOG_NOTICE(GENERAL, "Profile: %s: candidate '%s' (%s): not measured", g_title, candidate.name, candidate.description);
+
+			if (!untried)
+			{
+				untried = &candidate;
+			}
+
+			untried_count++;
+			continue;
+		}
+
+		const record_t& record = found->second;
+
+		LOG_NOTICE(GENERAL, "Profile: %s: candidate '%s' (%s): %.2f ms average, %.2f ms 1%% low, %llu frames in %u run(s)", g_title, candidate.name, candidate.description,
+			average_ms(record), record.low_1_percent_us / 1000., record.frames, record.runs);
+
+		if (!chosen || average_ms(record) < average_ms(g_records[chosen->name]))
+		{
+			chosen = &candidate;
+		}
+	}
+
+	if (untried)
+	{
+		LOG_SUCCESS(GENERAL, "Profile: %s: applying '%s' (%s) to measure it, %u candidate(s) left to try", g_title, untried->name, untried->description, untried_count);
+		chosen = untried;
+	}
+	else
+	{
+		LOG_SUCCESS(GENERAL, "Profile: %s: applying '%s' (%s): lowest average frame time (%.2f ms)", g_title, chosen->name, chosen->description, average_ms(g_records[chosen->name]));
+	}
+
+	chosen->apply();
+
+	g_candidate = chosen->name;
+	g_flips = 0;
+	g_last = 0;
+	g_intervals.clear();
+	g_active = true;
+}
+
+void title_profile::on_flip()
+{
+	if (!g_active)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(g_mutex);
+
+	const u64 now = get_system_time();
+
+	if (g_last && ++g_flips > warmup_frames)
+	{
+		g_intervals.push_back(now - g_last);
+	}
+
+	g_last = now;
+}
+
+void title_profile::on_stop()
+{
+	if (!g_active.exchange(false))
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(g_mutex);
+
+	if (g_intervals.size() < min_frames)
+	{
+		LOG_NOTICE(GENERAL, "Profile: %s: '%s' not recorded (%llu frame(s) measured after the warmup, %u needed)", g_title, g_candidate, (u64)g_intervals.size(), min_frames);
+		return;
+	}
+
+	// Average of the slowest 1% of frames
+	std::sort(g_intervals.begin(), g_intervals.end());
+
+	const std::size_t slowest = std::max<std::size_t>(g_intervals.size() / 100, 1);
+
+	record_t& record = g_records[g_candidate];
+	record.runs++;
+	record.frames += g_intervals.size();
+	record.total_us += std::accumulate(g_intervals.begin(), g_intervals.end(), 0ull);
+	record.low_1_percent_us = std::accumulate(g_intervals.end() - slowest, g_intervals.end(), 0ull) / slowest;
+
+	save_store(g_path, g_records);
+
+	LOG_SUCCESS(GENERAL, "Profile: %s: '%s' measured: %.2f ms average, %.2f ms 1%% low over %llu frames (saved to %s)", g_title, g_candidate,
+		std::accumulate(g_intervals.begin(), g_intervals.end(), 0ull) / 1000. / g_intervals.size(), record.low_1_percent_us / 1000., (u64)g_intervals.size(), g_path);
+}
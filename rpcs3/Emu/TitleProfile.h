@@ -0,0 +1,17 @@
+#pragma once
+
+// Automatic per-title performance profiles ("Automatic performance profiles" option).
+// A few variants of the tuning options (candidates) are tried on successive boots of a title, the average frame time
+// of each is measured and stored in data/<title ID>/profile.txt, then the fastest one is applied on the next boots.
+// Decisions and measurements are logged with the "Profile:" prefix.
+namespace title_profile
+{
+	// Choose a candidate for the title and apply it to the configuration of the game (called after it is loaded)
+	void configure(const std::string& title_id);
+
+	// Called by the RSX thread on each flip
+	void on_flip();
+
+	// Called when the emulation stops: record the measurement of the applied candidate
+	void on_stop();
+}
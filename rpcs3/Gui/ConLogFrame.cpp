@@ -16,10 +16,189 @@ EVT_CLOSE(LogFrame::OnQuit)
 EVT_TIMER(id_timer, LogFrame::OnTimer)
 END_EVENT_TABLE()
 
+static wxColour get_log_color(_log::level level)
+{
+	switch (level)
+	{
+	case _log::level::always: return{ 0x00, 0xFF, 0xFF }; // Cyan
+	case _log::level::fatal: return{ 0xFF, 0x00, 0xFF }; // Fuchsia
+	case _log::level::error: return{ 0xFF, 0x00, 0x00 }; // Red
+	case _log::level::todo: return{ 0xFF, 0x60, 0x00 }; // Orange
+	case _log::level::success: return{ 0x00, 0xFF, 0x00 }; // Green
+	case _log::level::warning: return{ 0xFF, 0xFF, 0x00 }; // Yellow
+	case _log::level::notice: return{ 0xFF, 0xFF, 0xFF }; // White
+	case _log::level::trace: return{ 0x80, 0x80, 0x80 }; // Gray
+	}
+
+	return{ 0xFF, 0xFF, 0xFF };
+}
+
+LogList::LogList(wxWindow* parent)
+	: wxListCtrl(parent, wxID_ANY, wxDefaultPosition, wxDefaultSize, wxLC_REPORT | wxLC_VIRTUAL | wxLC_NO_HEADER)
+	, m_level(rpcs3::config.misc.log.level.value())
+{
+	SetBackgroundColour(wxColour("Black"));
+	SetFont(wxFont(8, wxFONTFAMILY_MODERN, wxFONTSTYLE_NORMAL, wxFONTWEIGHT_NORMAL));
+	InsertColumn(0, wxEmptyString, 0, 4000);
+	m_attr.SetBackgroundColour(wxColour("Black"));
+}
+
+bool LogList::IsVisible(const record_t& record) const
+{
+	return record.level <= m_level && (m_filter.empty() || record.text.Contains(m_filter));
+}
+
+void LogList::UpdateView()
+{
+	m_view.clear();
+
+	for (std::size_t i = 0; i < m_records.size(); i++)
+	{
+		if (IsVisible(m_records[i]))
+		{
+			m_view.push_back(m_first + i);
+		}
+	}
+
+	SetItemCount(m_shown = m_view.size());
+	Refresh();
+}
+
+void LogList::Append(_log::level level, const wxString& text)
+{
+	for (std::size_t start = 0; start < text.size();)
+	{
+		std::size_t end = text.find('\n', start);
+
+		const bool terminated = end != wxString::npos;
+
+		if (!terminated)
+		{
+			end = text.size();
+		}
+
+		if (m_open)
+		{
+			// continue the last line (removed from the view and filtered again)
+			auto& record = m_records.back();
+
+			if (m_view.size() && m_view.back() == m_first + m_records.size() - 1)
+			{
+				m_view.pop_back();
+			}
+
+			record.text += text.substr(start, end - start);
+		}
+		else
+		{
+			m_records.push_back({ level, text.substr(start, end - start) });
+		}
+
+		if (IsVisible(m_records.back()))
+		{
+			m_view.push_back(m_first + m_records.size() - 1);
+		}
+
+		m_open = !terminated;
+		start = end + 1;
+	}
+
+	// drop the oldest records
+	while (m_records.size() > max_records)
+	{
+		m_records.pop_front();
+		m_first++;
+
+		if (m_view.size() && m_view.front() < m_first)
+		{
+			m_view.pop_front();
+		}
+	}
+}
+
+void LogList::Commit()
+{
+	const _log::level level = rpcs3::config.misc.log.level.value();
+
+	if (level != m_level)
+	{
+		m_level = level;
+		UpdateView();
+	}
+
+	const std::size_t count = m_view.size();
+
+	// keep following the end of the log only if it's visible
+	const bool at_end = GetTopItem() + GetCountPerPage() >= static_cast<long>(m_shown);
+
+	if (count != m_shown)
+	{
+		SetItemCount(m_shown = count);
+	}
+
+	if (count)
+	{
+		// dropped records shift the items
+		RefreshItems(GetTopItem(), std::min<long>(GetTopItem() + GetCountPerPage(), static_cast<long>(count) - 1));
+
+		if (at_end)
+		{
+			EnsureVisible(static_cast<long>(count) - 1);
+		}
+	}
+}
+
+void LogList::ClearRecords()
+{
+	m_records.clear();
+	m_view.clear();
+	m_first = 0;
+	m_open = false;
+	SetItemCount(m_shown = 0);
+	Refresh();
+}
+
+void LogList::SetFilter(_log::level level, const wxString& filter)
+{
+	m_level = level;
+	m_filter = filter;
+	UpdateView();
+}
+
+wxString LogList::GetSelectedText() const
+{
+	wxString result;
+
+	for (long item = GetFirstSelected(); item != -1; item = GetNextSelected(item))
+	{
+		result += OnGetItemText(item, 0);
+		result += '\n';
+	}
+
+	return result;
+}
+
+wxString LogList::OnGetItemText(long item, long column) const
+{
+	return item >= 0 && static_cast<std::size_t>(item) < m_view.size() ? m_records[m_view[item] - m_first].text : wxString();
+}
+
+wxListItemAttr* LogList::OnGetItemAttr(long item) const
+{
+	if (item >= 0 && static_cast<std::size_t>(item) < m_view.size())
+	{
+		m_attr.SetTextColour(get_log_color(m_records[m_view[item] - m_first].level));
+	}
+
+	return &m_attr;
+}
+
 LogFrame::LogFrame(wxWindow* parent)
 	: wxPanel(parent, wxID_ANY, wxDefaultPosition, wxSize(600, 500))
 	, m_tabs(this, wxID_ANY, wxDefaultPosition, wxDefaultSize, wxAUI_NB_TOP | wxAUI_NB_TAB_SPLIT | wxAUI_NB_TAB_MOVE | wxAUI_NB_SCROLL_BUTTONS)
-	, m_log(new wxTextCtrl(&m_tabs, wxID_ANY, wxEmptyString, wxDefaultPosition, wxDefaultSize, wxTE_MULTILINE | wxTE_READONLY | wxTE_RICH2))
+	, m_log_page(new wxPanel(&m_tabs))
+	, m_filter(new wxTextCtrl(m_log_page, wxID_ANY))
+	, m_log(new LogList(m_log_page))
 	, m_tty(new wxTextCtrl(&m_tabs, wxID_ANY, wxEmptyString, wxDefaultPosition, wxDefaultSize, wxTE_MULTILINE | wxTE_READONLY | wxTE_RICH2))
 	, m_timer(this, id_timer)
 {
@@ -28,10 +207,16 @@ LogFrame::LogFrame(wxWindow* parent)
 	m_tty_file.open(fs::get_config_dir() + "TTY.log",   fom::read | fom::create);
 
 	m_tty->SetBackgroundColour(wxColour("Black"));
-	m_log->SetBackgroundColour(wxColour("Black"));
 	m_tty->SetFont(wxFont(8, wxFONTFAMILY_MODERN, wxFONTSTYLE_NORMAL, wxFONTWEIGHT_NORMAL));
 	m_tty->SetDefaultStyle(wxColour(255, 255, 255));
-	m_tabs.AddPage(m_log, "Log");
+	m_filter->SetHint("Filter");
+
+	wxBoxSizer* s_log = new wxBoxSizer(wxVERTICAL);
+	s_log->Add(m_filter, 0, wxEXPAND);
+	s_log->Add(m_log, 1, wxEXPAND);
+	m_log_page->SetSizer(s_log);
+
+	m_tabs.AddPage(m_log_page, "Log");
 	m_tabs.AddPage(m_tty, "TTY");
 
 	wxBoxSizer* s_main = new wxBoxSizer(wxVERTICAL);
@@ -40,6 +225,7 @@ LogFrame::LogFrame(wxWindow* parent)
 	Layout();
 
 	m_log->Bind(wxEVT_RIGHT_DOWN, &LogFrame::OnRightClick, this);
+	m_filter->Bind(wxEVT_TEXT, &LogFrame::OnFilter, this);
 	Bind(wxEVT_MENU, &LogFrame::OnContextMenu, this, id_log_clear);
 	Bind(wxEVT_MENU, &LogFrame::OnContextMenu, this, id_log_copy);
 
@@ -82,15 +268,15 @@ void LogFrame::OnContextMenu(wxCommandEvent& event)
 	switch (id)
 	{
 	case id_log_clear:
-		m_log->Clear();
+		m_log->ClearRecords();
 		break;
 	case id_log_copy:
 		if (wxTheClipboard->Open())
 		{
-			m_tdo = new wxTextDataObject(m_log->GetStringSelection());
+			m_tdo = new wxTextDataObject(m_log->GetSelectedText());
 			if (m_tdo->GetTextLength() > 0)
 			{
-				wxTheClipboard->SetData(new wxTextDataObject(m_log->GetStringSelection()));
+				wxTheClipboard->SetData(new wxTextDataObject(m_log->GetSelectedText()));
 			}
 			wxTheClipboard->Close();
 		}
@@ -100,6 +286,11 @@ void LogFrame::OnContextMenu(wxCommandEvent& event)
 	}
 }
 
+void LogFrame::OnFilter(wxCommandEvent& event)
+{
+	m_log->SetFilter(rpcs3::config.misc.log.level.value(), m_filter->GetValue());
+}
+
 void LogFrame::OnTimer(wxTimerEvent& event)
 {
 	char buf[4096];
@@ -147,13 +338,12 @@ void LogFrame::OnTimer(wxTimerEvent& event)
 	{
 		const wxString& text = get_utf8(m_log_file, size);
 
-		// Append text if necessary
+		// Add text to the log buffer (filtered by the list)
 		auto flush_logs = [&](u64 start, u64 pos)
 		{
-			if (pos != start && m_level <= rpcs3::config.misc.log.level.value())
+			if (pos != start)
 			{
-				m_log->SetDefaultStyle(m_color);
-				m_log->AppendText(text.substr(start, pos - start));
+				m_log->Append(m_level, text.substr(start, pos - start));
 			}
 		};
 
@@ -174,18 +364,17 @@ void LogFrame::OnTimer(wxTimerEvent& event)
 				if (text[pos + 2] == ' ')
 				{
 					_log::level level;
-					wxColour color;
 
 					switch (text[pos + 1].GetValue())
 					{
-					case 'A': level = _log::level::always; color.Set(0x00, 0xFF, 0xFF); break; // Cyan
-					case 'F': level = _log::level::fatal; color.Set(0xFF, 0x00, 0xFF); break; // Fuchsia
-					case 'E': level = _log::level::error; color.Set(0xFF, 0x00, 0x00); break; // Red
-					case 'U': level = _log::level::todo; color.Set(0xFF, 0x60, 0x00); break; // Orange
-					case 'S': level = _log::level::success; color.Set(0x00, 0xFF, 0x00); break; // Green
-					case 'W': level = _log::level::warning; color.Set(0xFF, 0xFF, 0x00); break; // Yellow
-					case '!': level = _log::level::notice; color.Set(0xFF, 0xFF, 0xFF); break; // White
-					case 'T': level = _log::level::trace; color.Set(0x80, 0x80, 0x80); break; // Gray
+					case 'A': level = _log::level::always; break;
+					case 'F': level = _log::level::fatal; break;
+					case 'E': level = _log::level::error; break;
+					case 'U': level = _log::level::todo; break;
+					case 'S': level = _log::level::success; break;
+					case 'W': level = _log::level::warning; break;
+					case '!': level = _log::level::notice; break;
+					case 'T': level = _log::level::trace; break;
 					default: continue;
 					}
 
@@ -193,7 +382,6 @@ void LogFrame::OnTimer(wxTimerEvent& event)
 
 					start = pos + 3;
 					m_level = level;
-					m_color = color;
 				}
 			}
 
@@ -207,4 +395,6 @@ void LogFrame::OnTimer(wxTimerEvent& event)
 		// Limit processing time
 		if (std::chrono::high_resolution_clock::now() >= stamp1 + 3ms || text.empty()) break;
 	}
+
+	m_log->Commit();
 }
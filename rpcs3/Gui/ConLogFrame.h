@@ -1,15 +1,64 @@
 #pragma once
 
+// Virtual list of the log records: lines are kept in a bounded ring buffer and only visible rows are rendered.
+// Filtering (by log level and text) is done on the buffer and only changes the item count.
+class LogList : public wxListCtrl
+{
+	struct record_t
+	{
+		_log::level level;
+		wxString text;
+	};
+
+	std::deque<record_t> m_records; // ring buffer of the last log lines
+	u64 m_first = 0; // index of m_records.front() since the last Clear()
+	bool m_open = false; // the last record isn't terminated by a line break yet
+	std::deque<u64> m_view; // indices of the records passing the filter
+	std::size_t m_shown = 0; // item count set in the control
+
+	_log::level m_level; // max level shown
+	wxString m_filter; // text filter (case-sensitive)
+
+	mutable wxListItemAttr m_attr;
+
+	bool IsVisible(const record_t& record) const;
+
+	// Rebuild m_view after changing the filter
+	void UpdateView();
+
+public:
+	static const std::size_t max_records = 100000;
+
+	LogList(wxWindow* parent);
+
+	// Add text (may contain several lines or continue the last line), Commit() must be called to show it
+	void Append(_log::level level, const wxString& text);
+
+	// Show new records (scrolls to the end if the end was visible)
+	void Commit();
+
+	void ClearRecords();
+
+	void SetFilter(_log::level level, const wxString& filter);
+
+	// Get the text of selected records
+	wxString GetSelectedText() const;
+
+	virtual wxString OnGetItemText(long item, long column) const override;
+	virtual wxListItemAttr* OnGetItemAttr(long item) const override;
+};
+
 class LogFrame : public wxPanel
 {
 	fs::file m_log_file;
 	fs::file m_tty_file;
 
 	_log::level m_level{ _log::level::always }; // current log level
-	wxColour m_color{ 0, 255, 255 }; // current log color
 
 	wxAuiNotebook m_tabs;
-	wxTextCtrl *m_log;
+	wxPanel *m_log_page;
+	wxTextCtrl *m_filter;
+	LogList *m_log;
 	wxTextCtrl *m_tty;
 
 	//Copy Action in Context Menu
@@ -30,6 +79,7 @@ private:
 	void OnQuit(wxCloseEvent& event);
 	void OnRightClick(wxMouseEvent& event); // Show context menu
 	void OnContextMenu(wxCommandEvent& event); // After select
+	void OnFilter(wxCommandEvent& event);
 	void OnTimer(wxTimerEvent& event);
 
 	DECLARE_EVENT_TABLE();
@@ -15,6 +15,11 @@ void* GLGSFrame::make_context()
 	return new wxGLContext(m_canvas);
 }
 
+void* GLGSFrame::make_shared_context(void* context)
+{
+	return new wxGLContext(m_canvas, (wxGLContext*)context);
+}
+
 void GLGSFrame::set_current(draw_context_t ctx)
 {
 	m_canvas->SetCurrent(*(wxGLContext*)ctx.get());
@@ -10,6 +10,7 @@ public:
 	GLGSFrame();
 
 	void* make_context() override;
+	void* make_shared_context(void* context) override;
 	void set_current(draw_context_t context) override;
 	void delete_context(void* context) override;
 	void flip(draw_context_t context) override;
@@ -3,6 +3,7 @@
 #include "GSFrame.h"
 #include "Emu/System.h"
 #include "Emu/state.h"
+#include "Emu/PerfCounters.h"
 #include "Emu/SysCalls/Modules/cellVideoOut.h"
 #include "rpcs3.h"
 #include "Utilities/Timer.h"
@@ -102,6 +103,15 @@ void GSFrame::flip(draw_context_t)
 	{
 		std::string title = fmt::format("FPS: %.2f", (double)m_frames / fps_t.GetElapsedTimeInSec());
 
+		// short form of the performance overlay (the GL renderer has no text rendering)
+		if (rpcs3::config.rsx.perf_overlay.value())
+		{
+			const auto stats = perf::get_stats();
+
+			title += fmt::format(" | Draws/s: %.0f | Syscalls/s: %.0f | DMA: %.1f MB/s | JIT hits/misses: %.0f/%.0f",
+				stats.rate[perf::draws], stats.rate[perf::syscalls], stats.rate[perf::dma_bytes] / 0x100000, stats.rate[perf::jit_hits], stats.rate[perf::jit_misses]);
+		}
+
 		if (!m_title_message.empty())
 			title += " | " + m_title_message;
 
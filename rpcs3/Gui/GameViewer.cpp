@@ -11,6 +11,7 @@
 #include "SettingsDialog.h"
 
 static const std::string m_class_name = "GameViewer";
+static const std::string s_game_db_name = "GameList.db";
 
 // Auxiliary classes
 class sortGameData
@@ -51,6 +52,7 @@ GameViewer::GameViewer(wxWindow* parent) : wxListView(parent)
 	Bind(wxEVT_LIST_COL_CLICK, &GameViewer::OnColClick, this);
 	Bind(wxEVT_LIST_ITEM_RIGHT_CLICK, &GameViewer::RightClick, this);
 
+	LoadGameDB();
 	Refresh();
 }
 
@@ -91,80 +93,168 @@ void GameViewer::LoadGames()
 	}
 }
 
+// Parse PARAM.SFO of the game (called in parallel by LoadPSF)
+static bool load_game_info(const std::string& sfo, const std::string& local_path, const std::string& dir, GameInfo& game)
+{
+	vfsFile f;
+
+	if (!f.Open(sfo))
+	{
+		return false;
+	}
+
+	const PSFLoader psf(f);
+
+	if (!psf)
+	{
+		return false;
+	}
+
+	game.root = dir;
+	game.serial = psf.GetString("TITLE_ID");
+	game.name = psf.GetString("TITLE");
+	game.app_ver = psf.GetString("APP_VER");
+	game.category = psf.GetString("CATEGORY");
+	game.fw = psf.GetString("PS3_SYSTEM_VER");
+	game.parental_lvl = psf.GetInteger("PARENTAL_LEVEL");
+	game.resolution = psf.GetInteger("RESOLUTION");
+	game.sound_format = psf.GetInteger("SOUND_FORMAT");
+
+	if (game.serial.length() == 9)
+	{
+		game.serial = game.serial.substr(0, 4) + "-" + game.serial.substr(4, 5);
+	}
+
+	if (game.category.substr(0, 2) == "HG")
+	{
+		game.category = "HDD Game";
+		game.icon_path = local_path + "/" + dir + "/ICON0.PNG";
+	}
+	else if (game.category.substr(0, 2) == "DG")
+	{
+		game.category = "Disc Game";
+		game.icon_path = local_path + "/" + dir + "/PS3_GAME/ICON0.PNG";
+	}
+	else if (game.category.substr(0, 2) == "HM")
+	{
+		game.category = "Home";
+		game.icon_path = local_path + "/" + dir + "/ICON0.PNG";
+	}
+	else if (game.category.substr(0, 2) == "AV")
+	{
+		game.category = "Audio/Video";
+		game.icon_path = local_path + "/" + dir + "/ICON0.PNG";
+	}
+	else if (game.category.substr(0, 2) == "GD")
+	{
+		game.category = "Game Data";
+		game.icon_path = local_path + "/" + dir + "/ICON0.PNG";
+	}
+
+	return true;
+}
+
 void GameViewer::LoadPSF()
 {
 	m_game_data.clear();
-	for (u32 i = 0; i < m_games.size(); ++i)
+
+	// get local path from VFS...
+	std::string local_path;
+	Emu.GetVFS().GetDevice(m_path, local_path);
+
+	struct pending_t
 	{
-		const std::string sfb = m_path + m_games[i] + "/PS3_DISC.SFB"; 
-		const std::string sfo = m_path + m_games[i] + (Emu.GetVFS().ExistsFile(sfb) ? "/PS3_GAME/PARAM.SFO" : "/PARAM.SFO");
+		std::string sfo;
+		std::string local_sfo;
+		std::string dir;
+		fs::stat_t info;
+	};
 
-		if (!Emu.GetVFS().ExistsFile(sfo))
-		{
-			continue;
-		}
+	// PARAM.SFO files to parse (new or changed since they were cached)
+	std::vector<pending_t> pending;
+	std::unordered_set<std::string> found;
+
+	for (const auto& dir : m_games)
+	{
+		const std::string sfb = m_path + dir + "/PS3_DISC.SFB"; 
+		const std::string sfo = m_path + dir + (Emu.GetVFS().ExistsFile(sfb) ? "/PS3_GAME/PARAM.SFO" : "/PARAM.SFO");
 
-		vfsFile f;
+		std::string local_sfo;
+		fs::stat_t info;
 
-		if (!f.Open(sfo))
+		if (!Emu.GetVFS().GetDevice(sfo, local_sfo) || !fs::stat(local_sfo, info) || info.is_directory)
 		{
 			continue;
 		}
 
-		const PSFLoader psf(f);
+		found.emplace(local_sfo);
 
-		if (!psf)
+		const auto cached = m_game_db.find(local_sfo);
+
+		if (cached != m_game_db.end() && cached->second.mtime == info.mtime && cached->second.size == info.size)
 		{
+			m_game_data.push_back(cached->second.info);
 			continue;
 		}
 
-		// get local path from VFS...
-		std::string local_path;
-		Emu.GetVFS().GetDevice(m_path, local_path);
-
-		GameInfo game;
-		game.root = m_games[i];
-		game.serial = psf.GetString("TITLE_ID");
-		game.name = psf.GetString("TITLE");
-		game.app_ver = psf.GetString("APP_VER");
-		game.category = psf.GetString("CATEGORY");
-		game.fw = psf.GetString("PS3_SYSTEM_VER");
-		game.parental_lvl = psf.GetInteger("PARENTAL_LEVEL");
-		game.resolution = psf.GetInteger("RESOLUTION");
-		game.sound_format = psf.GetInteger("SOUND_FORMAT");
-		
-		if (game.serial.length() == 9)
-		{
-			game.serial = game.serial.substr(0, 4) + "-" + game.serial.substr(4, 5);
-		}
+		pending.push_back({ sfo, local_sfo, dir, info });
+	}
+
+	bool db_changed = false;
 
-		if (game.category.substr(0, 2) == "HG")
+	// drop removed games
+	for (auto it = m_game_db.begin(); it != m_game_db.end();)
+	{
+		if (!found.count(it->first))
 		{
-			game.category = "HDD Game";
-			game.icon_path = local_path + "/" + m_games[i] + "/ICON0.PNG";
+			it = m_game_db.erase(it);
+			db_changed = true;
 		}
-		else if (game.category.substr(0, 2) == "DG")
+		else
 		{
-			game.category = "Disc Game";
-			game.icon_path = local_path + "/" + m_games[i] + "/PS3_GAME/ICON0.PNG";
+			it++;
 		}
-		else if (game.category.substr(0, 2) == "HM")
+	}
+
+	if (pending.size())
+	{
+		std::vector<GameInfo> games(pending.size());
+		std::vector<char> valid(pending.size());
+		std::atomic<std::size_t> next{ 0 };
+		std::vector<std::future<void>> workers;
+
+		const std::size_t count = std::min<std::size_t>(pending.size(), std::max(std::thread::hardware_concurrency(), 1u));
+
+		for (std::size_t i = 0; i < count; i++)
 		{
-			game.category = "Home";
-			game.icon_path = local_path + "/" + m_games[i] + "/ICON0.PNG";
+			workers.emplace_back(std::async(std::launch::async, [&]()
+			{
+				for (std::size_t index; (index = next++) < pending.size();)
+				{
+					valid[index] = load_game_info(pending[index].sfo, local_path, pending[index].dir, games[index]);
+				}
+			}));
 		}
-		else if (game.category.substr(0, 2) == "AV")
+
+		for (auto& worker : workers)
 		{
-			game.category = "Audio/Video";
-			game.icon_path = local_path + "/" + m_games[i] + "/ICON0.PNG";
+			worker.get();
 		}
-		else if (game.category.substr(0, 2) == "GD")
+
+		for (std::size_t i = 0; i < pending.size(); i++)
 		{
-			game.category = "Game Data";
-			game.icon_path = local_path + "/" + m_games[i] + "/ICON0.PNG";
+			if (valid[i])
+			{
+				m_game_db[pending[i].local_sfo] = { pending[i].info.mtime, pending[i].info.size, games[i] };
+				m_game_data.push_back(games[i]);
+				db_changed = true;
+			}
 		}
-			
-		m_game_data.push_back(game);
+	}
+
+	if (db_changed)
+	{
+		SaveGameDB();
 	}
 
 	// Sort entries and update columns
@@ -172,6 +262,79 @@ void GameViewer::LoadPSF()
 	m_columns.Update(m_game_data);
 }
 
+// Game list database format: one line per game, fields are separated by tabs
+// (local path of PARAM.SFO, its mtime and size, GameInfo strings, GameInfo integers)
+
+void GameViewer::LoadGameDB()
+{
+	m_game_db.clear();
+
+	fs::file f(fs::get_config_dir() + s_game_db_name);
+
+	if (!f)
+	{
+		return;
+	}
+
+	std::string data(f.size(), '\0');
+	data.resize(f.read(&data[0], data.size()));
+
+	for (const auto& line : fmt::split(data, { "\n" }))
+	{
+		const auto fields = fmt::split(line, { "\t" }, false);
+
+		if (fields.size() != 13)
+		{
+			continue;
+		}
+
+		game_db_entry_t entry;
+		entry.mtime = std::strtoll(fields[1].c_str(), nullptr, 10);
+		entry.size = std::strtoull(fields[2].c_str(), nullptr, 10);
+		entry.info.root = fields[3];
+		entry.info.icon_path = fields[4];
+		entry.info.name = fields[5];
+		entry.info.serial = fields[6];
+		entry.info.app_ver = fields[7];
+		entry.info.category = fields[8];
+		entry.info.fw = fields[9];
+		entry.info.parental_lvl = std::strtoul(fields[10].c_str(), nullptr, 10);
+		entry.info.resolution = std::strtoul(fields[11].c_str(), nullptr, 10);
+		entry.info.sound_format = std::strtoul(fields[12].c_str(), nullptr, 10);
+
+		m_game_db[fields[0]] = std::move(entry);
+	}
+}
+
+void GameViewer::SaveGameDB()
+{
+	// tabs and line breaks can't be stored
+	const auto escape = [](std::string str)
+	{
+		std::replace_if(str.begin(), str.end(), [](char c) { return c == '\t' || c == '\n' || c == '\r'; }, ' ');
+		return str;
+	};
+
+	std::string data;
+
+	for (const auto& pair : m_game_db)
+	{
+		const auto& entry = pair.second;
+		const auto& info = entry.info;
+
+		data += fmt::format("%s\t%lld\t%llu\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%u\t%u\t%u\n", escape(pair.first), entry.mtime, entry.size,
+			escape(info.root), escape(info.icon_path), escape(info.name), escape(info.serial), escape(info.app_ver), escape(info.category), escape(info.fw),
+			info.parental_lvl, info.resolution, info.sound_format);
+	}
+
+	fs::file f(fs::get_config_dir() + s_game_db_name, fom::rewrite);
+
+	if (!f || f.write(data.data(), data.size()) != data.size())
+	{
+		LOG_ERROR(GENERAL, "GameViewer: failed to save the game list database");
+	}
+}
+
 void GameViewer::ShowData()
 {
 	m_columns.ShowData(this);
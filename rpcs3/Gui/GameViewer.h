@@ -79,10 +79,12 @@ public:
 
 	wxImageList* m_img_list;
 	std::vector<int> m_icon_indexes;
+	std::unordered_map<std::string, int> m_icon_cache; // icon path -> index in m_img_list
 
 	void Init()
 	{
 		m_img_list = new wxImageList(80, 44);
+		m_icon_cache.clear();
 
 		m_columns.clear();
 		m_columns.emplace_back(m_columns.size(),  90, "Icon");
@@ -125,9 +127,17 @@ public:
 			m_col_path->data.push_back(game.root);
 		}
 
-		// load icons
+		// load icons (only new ones, the image list isn't cleared)
 		for (const auto& path : m_col_icon->data)
 		{
+			const auto found = m_icon_cache.find(path);
+
+			if (found != m_icon_cache.end())
+			{
+				m_icon_indexes.push_back(found->second);
+				continue;
+			}
+
 			wxImage game_icon(80, 44);
 			{
 				wxLogNull logNo; // temporary disable wx warnings ("iCCP: known incorrect sRGB profile" spamming)
@@ -135,7 +145,7 @@ public:
 					game_icon.Rescale(80, 44, wxIMAGE_QUALITY_HIGH);
 			}
 
-			m_icon_indexes.push_back(m_img_list->Add(game_icon));
+			m_icon_indexes.push_back(m_icon_cache[path] = m_img_list->Add(game_icon));
 		}
 	}
 
@@ -259,11 +269,19 @@ public:
 
 class GameViewer : public wxListView
 {
+	struct game_db_entry_t
+	{
+		s64 mtime; // PARAM.SFO stats when it was parsed
+		u64 size;
+		GameInfo info;
+	};
+
 	int m_sortColumn;
 	bool m_sortAscending;
 	std::string m_path;
 	std::vector<std::string> m_games;
 	std::vector<GameInfo> m_game_data;
+	std::unordered_map<std::string, game_db_entry_t> m_game_db; // local path of PARAM.SFO -> game information
 	ColumnsArr m_columns;
 	wxMenu* m_popup;
 
@@ -275,6 +293,8 @@ public:
 
 	void LoadGames();
 	void LoadPSF();
+	void LoadGameDB();
+	void SaveGameDB();
 	void ShowData();
 
 	void SaveSettings();
@@ -22,6 +22,52 @@
 
 #include "KernelExplorer.h"
 
+enum sync_sort_key : int
+{
+	sort_by_id,
+	sort_by_acquired,
+	sort_by_contended,
+	sort_by_wait_time,
+	sort_by_max_wait,
+	sort_by_wakes,
+};
+
+static u64 get_sort_value(const lv2_sync_stats_t& stats, int key)
+{
+	switch (key)
+	{
+	case sort_by_acquired: return stats.acquired;
+	case sort_by_contended: return stats.contended;
+	case sort_by_wait_time: return stats.wait_time;
+	case sort_by_max_wait: return stats.max_wait;
+	case sort_by_wakes: return stats.wakes;
+	}
+
+	return 0;
+}
+
+// Get sync objects ordered by ID or by the selected statistics (descending)
+template<typename T> static std::vector<std::pair<u32, std::shared_ptr<T>>> get_sorted(const std::map<u32, std::shared_ptr<T>>& map, int key)
+{
+	std::vector<std::pair<u32, std::shared_ptr<T>>> result(map.begin(), map.end());
+
+	if (key != sort_by_id)
+	{
+		std::stable_sort(result.begin(), result.end(), [key](const std::pair<u32, std::shared_ptr<T>>& a, const std::pair<u32, std::shared_ptr<T>>& b)
+		{
+			return get_sort_value(a.second->stats, key) > get_sort_value(b.second->stats, key);
+		});
+	}
+
+	return result;
+}
+
+static std::string format_stats(const lv2_sync_stats_t& stats)
+{
+	return fmt::format(", Acquired = %llu, Contended = %llu, Wait = %llu us (max %llu us), Wakes = %llu",
+		stats.acquired.load(), stats.contended.load(), stats.wait_time.load(), stats.max_wait.load(), stats.wakes.load());
+}
+
 KernelExplorer::KernelExplorer(wxWindow* parent) 
 	: wxDialog(parent, wxID_ANY, "Kernel Explorer", wxDefaultPosition, wxSize(700, 450))
 {
@@ -34,6 +80,17 @@ KernelExplorer::KernelExplorer(wxWindow* parent)
 	box_buttons->AddSpacer(10);
 	box_buttons->Add(b_refresh);
 	box_buttons->AddSpacer(10);
+
+	m_sort = new wxChoice(this, wxID_ANY);
+	m_sort->Append("Sort by ID");
+	m_sort->Append("Sort by Acquisitions");
+	m_sort->Append("Sort by Contended");
+	m_sort->Append("Sort by Total Wait");
+	m_sort->Append("Sort by Max Wait");
+	m_sort->Append("Sort by Wakes");
+	m_sort->SetSelection(sort_by_id);
+	box_buttons->Add(m_sort);
+	box_buttons->AddSpacer(10);
 	
 	wxStaticBoxSizer* box_tree = new wxStaticBoxSizer(wxHORIZONTAL, this, "Kernel");
 	m_tree = new wxTreeCtrl(this, wxID_ANY, wxDefaultPosition, wxSize(600,300));
@@ -49,6 +106,7 @@ KernelExplorer::KernelExplorer(wxWindow* parent)
 
 	// Events
 	b_refresh->Bind(wxEVT_BUTTON, &KernelExplorer::OnRefresh, this);
+	m_sort->Bind(wxEVT_CHOICE, &KernelExplorer::OnRefresh, this);
 	
 	// Fill the wxTreeCtrl
 	Update();
@@ -57,6 +115,7 @@ KernelExplorer::KernelExplorer(wxWindow* parent)
 void KernelExplorer::Update()
 {
 	m_tree->DeleteAllItems();
+	const int sort_key = m_sort->GetSelection();
 	const u32 total_memory_usage = vm::get(vm::user_space)->used.load();
 
 	const auto& root = m_tree->AddRoot(fmt::format("Process, ID = 0x00000001, Total Memory Usage = 0x%x (%0.2f MB)", total_memory_usage, (float)total_memory_usage / (1024 * 1024)));
@@ -86,12 +145,12 @@ void KernelExplorer::Update()
 	{
 		const auto& node = m_tree->AppendItem(root, fmt::format("Semaphores (%zu)", sema_map.size()));
 
-		for (const auto& data : sema_map)
+		for (const auto& data : get_sorted(sema_map, sort_key))
 		{
 			const auto& sema = *data.second;
 
-			m_tree->AppendItem(node, fmt::format("Semaphore: ID = 0x%08x '%s', Count = %d, Max Count = %d, Waiters = %#zu", data.first,
-				&name64(sema.name), sema.value.load(), sema.max, sema.sq.size()));
+			m_tree->AppendItem(node, fmt::format("Semaphore: ID = 0x%08x '%s', Count = %d, Max Count = %d, Waiters = %#zu%s", data.first,
+				&name64(sema.name), sema.value.load(), sema.max, sema.sq.size(), format_stats(sema.stats)));
 		}
 	}
 
@@ -102,12 +161,12 @@ void KernelExplorer::Update()
 	{
 		const auto& node = m_tree->AppendItem(root, fmt::format("Mutexes (%zu)", mutex_map.size()));
 
-		for (const auto& data : mutex_map)
+		for (const auto& data : get_sorted(mutex_map, sort_key))
 		{
 			const auto& mutex = *data.second;
 
-			m_tree->AppendItem(node, fmt::format("Mutex: ID = 0x%08x '%s'", data.first,
-				&name64(mutex.name)));
+			m_tree->AppendItem(node, fmt::format("Mutex: ID = 0x%08x '%s'%s", data.first,
+				&name64(mutex.name), format_stats(mutex.stats)));
 		}
 	}
 
@@ -118,12 +177,12 @@ void KernelExplorer::Update()
 	{
 		const auto& node = m_tree->AppendItem(root, fmt::format("Lightweight Mutexes (%zu)", lwm_map.size()));
 
-		for (const auto& data : lwm_map)
+		for (const auto& data : get_sorted(lwm_map, sort_key))
 		{
 			const auto& lwm = *data.second;
 
-			m_tree->AppendItem(node, fmt::format("LWMutex: ID = 0x%08x '%s'", data.first,
-				&name64(lwm.name)));
+			m_tree->AppendItem(node, fmt::format("LWMutex: ID = 0x%08x '%s'%s", data.first,
+				&name64(lwm.name), format_stats(lwm.stats)));
 		}
 	}
 
@@ -134,12 +193,12 @@ void KernelExplorer::Update()
 	{
 		const auto& node = m_tree->AppendItem(root, fmt::format("Condition Variables (%zu)", cond_map.size()));
 
-		for (const auto& data : cond_map)
+		for (const auto& data : get_sorted(cond_map, sort_key))
 		{
 			const auto& cond = *data.second;
 
-			m_tree->AppendItem(node, fmt::format("Cond: ID = 0x%08x '%s'", data.first,
-				&name64(cond.name)));
+			m_tree->AppendItem(node, fmt::format("Cond: ID = 0x%08x '%s'%s", data.first,
+				&name64(cond.name), format_stats(cond.stats)));
 		}
 	}
 
@@ -166,12 +225,12 @@ void KernelExplorer::Update()
 	{
 		const auto& node = m_tree->AppendItem(root, fmt::format("Event Queues (%zu)", eq_map.size()));
 
-		for (const auto& data : eq_map)
+		for (const auto& data : get_sorted(eq_map, sort_key))
 		{
 			const auto& eq = *data.second;
 
-			m_tree->AppendItem(node, fmt::format("Event Queue: ID = 0x%08x '%s', %s, Key = %#llx, Events = %zu/%d, Waiters = %zu", data.first,
-				&name64(eq.name), eq.type == SYS_SPU_QUEUE ? "SPU" : "PPU", eq.key, eq.events.size(), eq.size, eq.sq.size()));
+			m_tree->AppendItem(node, fmt::format("Event Queue: ID = 0x%08x '%s', %s, Key = %#llx, Events = %zu/%d, Waiters = %zu%s", data.first,
+				&name64(eq.name), eq.type == SYS_SPU_QUEUE ? "SPU" : "PPU", eq.key, eq.events.size(), eq.size, eq.sq.size(), format_stats(eq.stats)));
 		}
 	}
 
@@ -198,11 +257,12 @@ void KernelExplorer::Update()
 	{
 		const auto& node = m_tree->AppendItem(root, fmt::format("Event Flags (%zu)", ef_map.size()));
 
-		for (const auto& data : ef_map)
+		for (const auto& data : get_sorted(ef_map, sort_key))
 		{
 			const auto& ef = *data.second;
 
-			m_tree->AppendItem(node, fmt::format("Event Flag: ID = 0x%08x", data.first));
+			m_tree->AppendItem(node, fmt::format("Event Flag: ID = 0x%08x '%s'%s", data.first,
+				&name64(ef.name), format_stats(ef.stats)));
 		}
 	}
 
@@ -213,11 +273,12 @@ void KernelExplorer::Update()
 	{
 		const auto& node = m_tree->AppendItem(root, fmt::format("Reader/writer Locks (%zu)", rwlock_map.size()));
 
-		for (const auto& data : rwlock_map)
+		for (const auto& data : get_sorted(rwlock_map, sort_key))
 		{
 			const auto& rwlock = *data.second;
 
-			m_tree->AppendItem(node, fmt::format("RWLock: ID = 0x%08x", data.first));
+			m_tree->AppendItem(node, fmt::format("RWLock: ID = 0x%08x '%s'%s", data.first,
+				&name64(rwlock.name), format_stats(rwlock.stats)));
 		}
 	}
 
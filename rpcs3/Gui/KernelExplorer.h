@@ -3,6 +3,7 @@
 class KernelExplorer : public wxDialog
 {
 	wxTreeCtrl* m_tree;
+	wxChoice* m_sort;
 
 public:
 	KernelExplorer(wxWindow* parent);
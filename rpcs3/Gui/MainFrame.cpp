@@ -23,7 +23,9 @@
 #include "Gui/MemoryStringSearcher.h"
 #include "Gui/LLEModulesManager.h"
 #include "Gui/CgDisasm.h"
+#include "Gui/PerfCountersDialog.h"
 #include "Crypto/unpkg.h"
+#include "Emu/SaveState.h"
 
 #ifndef _WIN32
 #include "frame_icon.xpm"
@@ -41,6 +43,8 @@ enum IDs
 	id_boot_exit,
 	id_sys_pause,
 	id_sys_stop,
+	id_sys_save_state,
+	id_sys_load_state,
 	id_sys_send_open_menu,
 	id_sys_send_exit,
 	id_config_emu,
@@ -56,6 +60,7 @@ enum IDs
 	id_tools_rsx_debugger,
 	id_tools_string_search,
 	id_tools_cg_disasm,
+	id_tools_perf_counters,
 	id_help_about,
 	id_update_dbg
 };
@@ -90,6 +95,9 @@ MainFrame::MainFrame()
 	menu_sys->Append(id_sys_pause, "&Pause")->Enable(false);
 	menu_sys->Append(id_sys_stop, "&Stop\tCtrl + S")->Enable(false);
 	menu_sys->AppendSeparator();
+	menu_sys->Append(id_sys_save_state, "Sa&ve state")->Enable(false);
+	menu_sys->Append(id_sys_load_state, "&Load state")->Enable(false);
+	menu_sys->AppendSeparator();
 	menu_sys->Append(id_sys_send_open_menu, "Send &open system menu cmd")->Enable(false);
 	menu_sys->Append(id_sys_send_exit, "Send &exit cmd")->Enable(false);
 
@@ -114,6 +122,7 @@ MainFrame::MainFrame()
 	menu_tools->Append(id_tools_rsx_debugger, "&RSX Debugger")->Enable(false);
 	menu_tools->Append(id_tools_string_search, "&String Search")->Enable(false);
 	menu_tools->Append(id_tools_cg_disasm, "&Cg Disasm")->Enable();
+	menu_tools->Append(id_tools_perf_counters, "&Performance Counters");
 
 	wxMenu* menu_help = new wxMenu();
 	menubar->Append(menu_help, "&Help");
@@ -139,6 +148,8 @@ MainFrame::MainFrame()
 
 	Bind(wxEVT_MENU, &MainFrame::Pause, this, id_sys_pause);
 	Bind(wxEVT_MENU, &MainFrame::Stop, this, id_sys_stop);
+	Bind(wxEVT_MENU, &MainFrame::SaveState, this, id_sys_save_state);
+	Bind(wxEVT_MENU, &MainFrame::SaveState, this, id_sys_load_state);
 	Bind(wxEVT_MENU, &MainFrame::SendOpenCloseSysMenu, this, id_sys_send_open_menu);
 	Bind(wxEVT_MENU, &MainFrame::SendExit, this, id_sys_send_exit);
 
@@ -156,6 +167,7 @@ MainFrame::MainFrame()
 	Bind(wxEVT_MENU, &MainFrame::OpenRSXDebugger, this, id_tools_rsx_debugger);
 	Bind(wxEVT_MENU, &MainFrame::OpenStringSearch, this, id_tools_string_search);
 	Bind(wxEVT_MENU, &MainFrame::OpenCgDisasm, this, id_tools_cg_disasm);
+	Bind(wxEVT_MENU, &MainFrame::OpenPerfCounters, this, id_tools_perf_counters);
 
 	Bind(wxEVT_MENU, &MainFrame::AboutDialogHandler, this, id_help_about);
 
@@ -371,6 +383,38 @@ void MainFrame::Stop(wxCommandEvent& WXUNUSED(event))
 	Emu.Stop();
 }
 
+void MainFrame::SaveState(wxCommandEvent& event)
+{
+	const std::string dir = fs::get_config_dir() + "savestates/";
+	const std::string path = dir + (Emu.GetTitleID().size() ? Emu.GetTitleID() : "unknown") + ".state";
+
+	const bool was_running = Emu.IsRunning();
+
+	if (was_running)
+	{
+		Emu.Pause();
+	}
+
+	if (event.GetId() == id_sys_save_state)
+	{
+		fs::create_dir(dir);
+
+		if (!savestate::save(path))
+		{
+			wxMessageBox("Failed to save the state (see the log for details).", "Save state", wxOK | wxICON_ERROR, this);
+		}
+	}
+	else if (!savestate::load(path))
+	{
+		wxMessageBox("Failed to load the state (see the log for details).", "Load state", wxOK | wxICON_ERROR, this);
+	}
+
+	if (was_running)
+	{
+		Emu.Resume();
+	}
+}
+
 void MainFrame::SendExit(wxCommandEvent& event)
 {
 	sysutilSendSystemCommand(CELL_SYSUTIL_REQUEST_EXITGAME, 0);
@@ -449,6 +493,11 @@ void MainFrame::OpenCgDisasm(wxCommandEvent& WXUNUSED(event))
 	(new CgDisasm(this))->Show();
 }
 
+void MainFrame::OpenPerfCounters(wxCommandEvent& WXUNUSED(event))
+{
+	(new PerfCountersDialog(this))->Show();
+}
+
 void MainFrame::AboutDialogHandler(wxCommandEvent& WXUNUSED(event))
 {
 	AboutDialog(this).ShowModal();
@@ -534,6 +583,10 @@ void MainFrame::UpdateUI(wxCommandEvent& event)
 	pause.Enable(!is_stopped);
 	stop.Enable(!is_stopped);
 
+	// Savestates
+	menubar.FindItem(id_sys_save_state)->Enable(!is_stopped && !is_ready);
+	menubar.FindItem(id_sys_load_state)->Enable(!is_stopped && !is_ready);
+
 	// PS3 Commands
 	wxMenuItem& send_exit = *menubar.FindItem(id_sys_send_exit);
 	wxMenuItem& send_open_menu = *menubar.FindItem(id_sys_send_open_menu);
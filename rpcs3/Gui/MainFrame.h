@@ -30,6 +30,7 @@ private:
 	void BootElf(wxCommandEvent& event);
 	void Pause(wxCommandEvent& event);
 	void Stop(wxCommandEvent& event);
+	void SaveState(wxCommandEvent& event);
 	void SendExit(wxCommandEvent& event);
 	void SendOpenCloseSysMenu(wxCommandEvent& event);
 	void Config(wxCommandEvent& event);
@@ -45,6 +46,7 @@ private:
 	void OpenRSXDebugger(wxCommandEvent& evt);
 	void OpenStringSearch(wxCommandEvent& evt);
 	void OpenCgDisasm(wxCommandEvent& evt);
+	void OpenPerfCounters(wxCommandEvent& evt);
 	void AboutDialogHandler(wxCommandEvent& event);
 	void UpdateUI(wxCommandEvent& event);
 	void OnKeyDown(wxKeyEvent& event);
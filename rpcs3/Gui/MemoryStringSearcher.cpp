@@ -2,6 +2,7 @@
 #include "stdafx_gui.h"
 #include "Utilities/rPlatform.h"
 #include "Emu/Memory/Memory.h"
+#include "Emu/Memory/MemorySearch.h"
 #include "Emu/System.h"
 
 #include "MemoryStringSearcher.h"
@@ -20,50 +21,44 @@ MemoryStringSearcher::MemoryStringSearcher(wxWindow* parent)
 	//wxNotebook* nb_rsx = new wxNotebook(this, wxID_ANY, wxDefaultPosition, wxSize(482,475));
 
 	s_panel = new wxBoxSizer(wxHORIZONTAL);
-	t_addr = new wxTextCtrl(this, wxID_ANY, wxEmptyString, wxDefaultPosition, wxSize(482, -1));
+	t_addr = new wxTextCtrl(this, wxID_ANY, wxEmptyString, wxDefaultPosition, wxSize(432, -1));
+	c_hex = new wxCheckBox(this, wxID_ANY, "Hex", wxPoint(432, 0), wxSize(50, -1));
+	c_hex->SetToolTip("Search for hex bytes, '?' matches any nibble (e.g. \"DE AD ?? EF\")");
 	b_search = new wxButton(this, wxID_ANY, "Search", wxPoint(482, 0), wxSize(40, -1));
 	b_search->Bind(wxEVT_BUTTON, &MemoryStringSearcher::Search, this);
 	s_panel->Add(t_addr);
+	s_panel->Add(c_hex);
 	s_panel->Add(b_search);
 };
 
 void MemoryStringSearcher::Search(wxCommandEvent& event)
 {
-	const wxString wstr = t_addr->GetValue();
-	const char *str = wstr.c_str();
-	const u32 len = wstr.length();
+	const std::string str = fmt::ToUTF8(t_addr->GetValue());
 
-	LOG_NOTICE(GENERAL, "Searching for string %s", str);
+	vm::search_pattern_t pattern;
 
-	// Search the address space for the string
-	u32 strIndex = 0;
-	u32 numFound = 0;
-	const auto area = vm::get(vm::main);
-	for (u32 addr = area->addr; addr < area->addr + area->size; addr++) {
-		if (!vm::check_addr(addr)) {
-			strIndex = 0;
-			continue;
+	if (c_hex->GetValue())
+	{
+		if (!vm::search_pattern_t::from_hex(str, pattern))
+		{
+			LOG_ERROR(GENERAL, "Invalid hex pattern: %s", str);
+			return;
 		}
+	}
+	else
+	{
+		pattern = vm::search_pattern_t::from_string(str);
+	}
 
-		u8 byte = vm::read8(addr);
-		if (byte == str[strIndex]) {
-			if (strIndex == len) {
-				// Found it
-				LOG_NOTICE(GENERAL, "Found @ %04x", addr - len);
-				numFound++;
-				strIndex = 0;
-				continue;
-			}
+	LOG_NOTICE(GENERAL, "Searching for %s", str);
 
-			strIndex++;
-		}
-		else
-			strIndex = 0;
+	// Search the address space for the pattern
+	const auto found = vm::search(vm::main, pattern);
 
-		if (addr % (1024 * 1024 * 64) == 0) { // Log every 64mb
-			LOG_NOTICE(GENERAL, "Searching %04x ...", addr);
-		}
+	for (const u32 addr : found)
+	{
+		LOG_NOTICE(GENERAL, "Found @ 0x%08x", addr);
 	}
 
-	LOG_NOTICE(GENERAL, "Search completed (found %d matches)", numFound);
-}
\ No newline at end of file
+	LOG_NOTICE(GENERAL, "Search completed (found %u matches)", static_cast<u32>(found.size()));
+}
@@ -3,6 +3,7 @@
 class MemoryStringSearcher : public wxDialog
 {
 	wxTextCtrl* t_addr;
+	wxCheckBox* c_hex;
 	wxBoxSizer* s_panel;
 	wxButton* b_search;
 
@@ -0,0 +1,85 @@
+#include "stdafx.h"
+#include "stdafx_gui.h"
+#include "Emu/PerfCounters.h"
+#include "PerfCountersDialog.h"
+
+PerfCountersDialog::PerfCountersDialog(wxWindow* parent)
+	: wxDialog(parent, wxID_ANY, "Performance Counters")
+	, m_timer(this)
+{
+	SetMinSize(wxSize(400, 360));
+
+	wxBoxSizer* s_main = new wxBoxSizer(wxVERTICAL);
+
+	m_list = new wxListView(this);
+	m_list->InsertColumn(0, "Counter");
+	m_list->InsertColumn(1, "Total");
+	m_list->InsertColumn(2, "Per second");
+
+	s_main->Add(m_list, 1, wxALL | wxEXPAND, 5);
+
+	wxBoxSizer* s_action = new wxBoxSizer(wxHORIZONTAL);
+
+	s_action->Add(new wxButton(this, wxID_COPY, wxT("&Copy"), wxDefaultPosition, wxDefaultSize, 0), 0, wxALL, 5);
+	s_action->Add(new wxButton(this, wxID_CANCEL, wxT("&Close"), wxDefaultPosition, wxDefaultSize, 0), 0, wxALL, 5);
+
+	s_main->Add(s_action, 0, wxALL, 5);
+
+	Bind(wxEVT_BUTTON, &PerfCountersDialog::OnCopy, this, wxID_COPY);
+	Bind(wxEVT_TIMER, &PerfCountersDialog::OnTimer, this);
+
+	UpdateList();
+
+	SetSizerAndFit(s_main);
+	Layout();
+
+	m_timer.Start(1000);
+}
+
+void PerfCountersDialog::UpdateList()
+{
+	perf::update();
+
+	const auto stats = perf::get_stats();
+
+	m_list->Freeze();
+	m_list->DeleteAllItems();
+
+	for (u32 i = 0; i < perf::counter_count; i++)
+	{
+		m_list->InsertItem(i, perf::get_name(static_cast<perf::counter_t>(i)));
+		m_list->SetItem(i, 1, fmt::format("%llu", stats.total[i]));
+		m_list->SetItem(i, 2, fmt::format("%.0f", stats.rate[i]));
+	}
+
+	m_list->InsertItem(perf::counter_count, "Guest memory allocated (MB)");
+	m_list->SetItem(perf::counter_count, 1, fmt::format("%llu", stats.memory_allocated >> 20));
+	m_list->InsertItem(perf::counter_count + 1, "Guest memory committed (MB)");
+	m_list->SetItem(perf::counter_count + 1, 1, fmt::format("%llu", stats.memory_committed >> 20));
+
+	m_list->SetColumnWidth(0, wxLIST_AUTOSIZE_USEHEADER);
+	m_list->SetColumnWidth(1, wxLIST_AUTOSIZE_USEHEADER);
+	m_list->SetColumnWidth(2, wxLIST_AUTOSIZE_USEHEADER);
+	m_list->Thaw();
+}
+
+void PerfCountersDialog::OnTimer(wxTimerEvent& event)
+{
+	UpdateList();
+}
+
+void PerfCountersDialog::OnCopy(wxCommandEvent& event)
+{
+	std::string text;
+
+	for (const auto& line : perf::format_stats(perf::get_stats()))
+	{
+		text += line + "\n";
+	}
+
+	if (wxTheClipboard->Open())
+	{
+		wxTheClipboard->SetData(new wxTextDataObject(fmt::FromUTF8(text)));
+		wxTheClipboard->Close();
+	}
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+// Performance counters (totals and rates), refreshed every second
+class PerfCountersDialog : public wxDialog
+{
+	wxListView* m_list;
+	wxTimer m_timer;
+
+public:
+	PerfCountersDialog(wxWindow* parent);
+
+	void UpdateList();
+
+	void OnTimer(wxTimerEvent& event);
+	void OnCopy(wxCommandEvent& event);
+};
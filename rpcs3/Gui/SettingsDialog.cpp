@@ -193,10 +193,13 @@ SettingsDialog::SettingsDialog(wxWindow *parent, rpcs3::config_t* cfg)
 	wxCheckBox* chbox_gs_overlay = new wxCheckBox(p_graphics, wxID_ANY, "Debug overlay");
 	wxCheckBox* chbox_audio_dump = new wxCheckBox(p_audio, wxID_ANY, "Dump to file");
 	wxCheckBox* chbox_audio_conv = new wxCheckBox(p_audio, wxID_ANY, "Convert to 16 bit");
+	wxCheckBox* chbox_audio_backend_driven = new wxCheckBox(p_audio, wxID_ANY, "Backend-driven output (low latency)");
+	wxCheckBox* chbox_audio_time_stretch = new wxCheckBox(p_audio, wxID_ANY, "Time stretching");
 	wxCheckBox* chbox_rsx_logging = new wxCheckBox(p_misc, wxID_ANY, "RSX Logging");
 	wxCheckBox* chbox_hle_exitonstop = new wxCheckBox(p_misc, wxID_ANY, "Exit RPCS3 when process finishes");
 	wxCheckBox* chbox_hle_always_start = new wxCheckBox(p_misc, wxID_ANY, "Always start after boot");
 	wxCheckBox* chbox_hle_use_default_ini = new wxCheckBox(p_misc, wxID_ANY, "Use default configuration");
+	wxCheckBox* chbox_hle_auto_profiles = new wxCheckBox(p_misc, wxID_ANY, "Automatic performance profiles");
 
 	wxTextCtrl* txt_dbg_range_min = new wxTextCtrl(p_core, wxID_ANY, wxEmptyString, wxDefaultPosition, wxSize(55, 20));
 	wxTextCtrl* txt_dbg_range_max = new wxTextCtrl(p_core, wxID_ANY, wxEmptyString, wxDefaultPosition, wxSize(55, 20));
@@ -333,10 +336,13 @@ SettingsDialog::SettingsDialog(wxWindow *parent, rpcs3::config_t* cfg)
 	chbox_gs_overlay->SetValue(cfg->rsx.d3d12.overlay.value());
 	chbox_audio_dump->SetValue(rpcs3::config.audio.dump_to_file.value());
 	chbox_audio_conv->SetValue(rpcs3::config.audio.convert_to_u16.value());
+	chbox_audio_backend_driven->SetValue(rpcs3::config.audio.backend_driven.value());
+	chbox_audio_time_stretch->SetValue(rpcs3::config.audio.time_stretch.value());
 	chbox_rsx_logging->SetValue(rpcs3::config.misc.log.rsx_logging.value());
 	chbox_hle_exitonstop->SetValue(rpcs3::config.misc.exit_on_stop.value());
 	chbox_hle_always_start->SetValue(rpcs3::config.misc.always_start.value());
 	chbox_hle_use_default_ini->SetValue(rpcs3::config.misc.use_default_ini.value());
+	chbox_hle_auto_profiles->SetValue(rpcs3::config.misc.auto_profiles.value());
 	chbox_core_hook_stfunc->SetValue(cfg->core.hook_st_func.value());
 	chbox_core_load_liblv2->SetValue(cfg->core.load_liblv2.value());
 
@@ -443,6 +449,8 @@ SettingsDialog::SettingsDialog(wxWindow *parent, rpcs3::config_t* cfg)
 	s_subpanel_audio->Add(s_round_audio_out, wxSizerFlags().Border(wxALL, 5).Expand());
 	s_subpanel_audio->Add(chbox_audio_dump, wxSizerFlags().Border(wxALL, 5).Expand());
 	s_subpanel_audio->Add(chbox_audio_conv, wxSizerFlags().Border(wxALL, 5).Expand());
+	s_subpanel_audio->Add(chbox_audio_backend_driven, wxSizerFlags().Border(wxALL, 5).Expand());
+	s_subpanel_audio->Add(chbox_audio_time_stretch, wxSizerFlags().Border(wxALL, 5).Expand());
 
 	// Miscellaneous
 	s_subpanel_misc->Add(s_round_hle_log_lvl, wxSizerFlags().Border(wxALL, 5).Expand());
@@ -450,6 +458,7 @@ SettingsDialog::SettingsDialog(wxWindow *parent, rpcs3::config_t* cfg)
 	s_subpanel_misc->Add(chbox_hle_exitonstop, wxSizerFlags().Border(wxALL, 5).Expand());
 	s_subpanel_misc->Add(chbox_hle_always_start, wxSizerFlags().Border(wxALL, 5).Expand());
 	s_subpanel_misc->Add(chbox_hle_use_default_ini, wxSizerFlags().Border(wxALL, 5).Expand());
+	s_subpanel_misc->Add(chbox_hle_auto_profiles, wxSizerFlags().Border(wxALL, 5).Expand());
 
 	// Auto Pause
 	s_subpanel_misc->Add(chbox_dbg_ap_systemcall, wxSizerFlags().Border(wxALL, 5).Expand());
@@ -528,6 +537,8 @@ SettingsDialog::SettingsDialog(wxWindow *parent, rpcs3::config_t* cfg)
 		rpcs3::config.rsx.d3d12.overlay = chbox_gs_overlay->GetValue();
 		rpcs3::config.audio.dump_to_file = chbox_audio_dump->GetValue();
 		rpcs3::config.audio.convert_to_u16 = chbox_audio_conv->GetValue();
+		rpcs3::config.audio.backend_driven = chbox_audio_backend_driven->GetValue();
+		rpcs3::config.audio.time_stretch = chbox_audio_time_stretch->GetValue();
 		rpcs3::config.misc.log.level = cbox_hle_loglvl->GetSelection();
 		rpcs3::config.misc.log.rsx_logging = chbox_rsx_logging->GetValue();
 		rpcs3::config.misc.net.status = cbox_net_status->GetSelection();
@@ -537,6 +548,7 @@ SettingsDialog::SettingsDialog(wxWindow *parent, rpcs3::config_t* cfg)
 		rpcs3::config.misc.always_start = chbox_hle_always_start->GetValue();
 		rpcs3::config.misc.exit_on_stop = chbox_hle_exitonstop->GetValue();
 		rpcs3::config.misc.use_default_ini = chbox_hle_use_default_ini->GetValue();
+		rpcs3::config.misc.auto_profiles = chbox_hle_auto_profiles->GetValue();
 		rpcs3::config.system.language = cbox_sys_lang->GetSelection();
 		rpcs3::config.system.emulation_dir_path_enable = chbox_emulationdir_enable->GetValue();
 		rpcs3::config.system.emulation_dir_path = txt_emulationdir_path->GetValue().ToStdString();
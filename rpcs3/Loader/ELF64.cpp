@@ -1,4 +1,5 @@
 #include "stdafx.h"
+#include "Utilities/Thread.h"
 #include "Emu/FS/vfsStream.h"
 #include "Emu/FS/vfsFile.h"
 #include "Emu/FS/vfsDir.h"
@@ -11,10 +12,24 @@
 #include "Emu/SysCalls/ModuleManager.h"
 #include "Emu/SysCalls/lv2/sys_prx.h"
 #include "Emu/Cell/PPUInstrTable.h"
+#include "Emu/Cell/PPULLVMRecompiler.h"
+#include "Crypto/unself.h"
 #include "ELF64.h"
 
 using namespace PPU_instr;
 
+extern u64 get_system_time();
+
+#ifdef PPU_LLVM_RECOMPILER
+static void precompile_ppu(u32 addr, u32 size)
+{
+	if (rpcs3::state.config.core.ppu_decoder.value() == ppu_decoder_type::recompiler_llvm && rpcs3::state.config.core.llvm.aot.value())
+	{
+		ppu_recompiler_llvm::RecompilationEngine::GetInstance()->PrecompileRange(addr, size);
+	}
+}
+#endif
+
 namespace loader
 {
 	namespace handlers
@@ -295,6 +310,14 @@ namespace loader
 				}
 			}
 
+#ifdef PPU_LLVM_RECOMPILER
+			// the first segment of PRX contains the code
+			if (!info.segments.empty() && info.segments[0].size_file)
+			{
+				precompile_ppu(info.segments[0].begin.addr(), info.segments[0].size_file);
+			}
+#endif
+
 			return ok;
 		}
 
@@ -320,9 +343,19 @@ namespace loader
 			std::vector<u32> stop_funcs;
 			std::vector<u32> exit_funcs;
 
+			const u64 time_start = get_system_time();
+
 			//load modules
 			vfsDir lle_dir("/dev_flash/sys/external");
-			
+
+			struct lle_module_t
+			{
+				std::shared_ptr<vfsStream> file;
+				elf64 handler;
+			};
+
+			std::vector<std::string> lle_paths;
+
 			for (const auto module : lle_dir)
 			{
 				if (module->flags & DirEntry_TypeDir)
@@ -338,14 +371,55 @@ namespace loader
 					}
 				}
 
-				elf64 sprx_handler;
+				lle_paths.emplace_back(lle_dir.GetPath() + "/" + module->name);
+			}
+
+			// open (and decrypt) the modules in parallel, they are loaded to memory in the directory order
+			std::vector<lle_module_t> lle_modules(lle_paths.size());
+
+			{
+				std::atomic<u32> next{ 0 };
+
+				auto open = [&]()
+				{
+					for (u32 i; (i = next++) < lle_modules.size();)
+					{
+						auto& module = lle_modules[i];
+
+						module.file = OpenSelfOrElf(lle_paths[i]);
+
+						if (module.file && module.file->IsOpened())
+						{
+							module.handler.init(*module.file);
+						}
+					}
+				};
 
-				vfsFile fsprx(lle_dir.GetPath() + "/" + module->name);
+				const u32 thread_count = std::max<u32>(1, std::min<u32>(std::thread::hardware_concurrency(), (u32)lle_modules.size()));
 
-				if (fsprx.IsOpened())
+				std::vector<std::shared_ptr<thread_ctrl>> threads;
+
+				for (u32 i = 1; i < thread_count; i++)
 				{
-					sprx_handler.init(fsprx);
+					threads.emplace_back(thread_ctrl::spawn(COPY_EXPR(fmt::format("LLE Module Loader[%u]", i)), open));
+				}
+
+				open();
 
+				for (auto& thread : threads)
+				{
+					thread->join();
+				}
+			}
+
+			const u64 time_open = get_system_time();
+
+			for (auto& lle_module : lle_modules)
+			{
+				auto& sprx_handler = lle_module.handler;
+
+				if (lle_module.file && lle_module.file->IsOpened())
+				{
 					if (sprx_handler.is_sprx())
 					{
 						if (!rpcs3::state.config.core.load_liblv2.value())
@@ -437,7 +511,7 @@ namespace loader
 								}
 								else
 								{
-									func->lle_func.set(addr);
+									set_ppu_func_lle(index, addr);
 
 									if (func->flags & MFF_FORCED_HLE)
 									{
@@ -485,10 +559,14 @@ namespace loader
 				}
 			}
 
+			const u64 time_link = get_system_time();
+
 			res = load_data(0);
 			if (res != ok)
 				return res;
 
+			const u64 time_data = get_system_time();
+
 			//initialize process
 			auto rsx_callback_data = vm::ptr<u32>::make(vm::alloc(4 * 4, vm::main));
 			*rsx_callback_data++ = (rsx_callback_data + 1).addr();
@@ -554,17 +632,31 @@ namespace loader
 			// branch to initialization
 			make_branch(entry, m_ehdr.e_entry);
 
-			const auto decoder_cache = fxm::make<ppu_decoder_cache_t>();
+			// the cache is initialized lazily on the first execution of each page (PPUThread::cpu_task)
+			fxm::make<ppu_decoder_cache_t>();
+
+			LOG_NOTICE(LOADER, "Load time: LLE modules opened in %llu us (%u modules), linked in %llu us, segments loaded in %llu us",
+				time_open - time_start, (u32)lle_modules.size(), time_link - time_open, time_data - time_link);
+
+#ifdef PPU_LLVM_RECOMPILER
+			std::vector<std::pair<u32, u32>> code_ranges;
 
-			for (u32 page = 0; page < 0x20000000; page += 4096)
+			for (auto &phdr : m_phdrs)
 			{
-				// TODO: scan only executable areas
-				if (vm::check_addr(page, 4096))
+				// executable load segments
+				if (phdr.p_type == 0x1 && (phdr.p_flags & 0x1) && phdr.p_filesz)
 				{
-					decoder_cache->initialize(page, 4096);
+					precompile_ppu(phdr.p_vaddr.addr(), phdr.p_filesz);
+					code_ranges.emplace_back(phdr.p_vaddr.addr(), phdr.p_filesz);
 				}
 			}
 
+			if (rpcs3::state.config.core.ppu_decoder.value() == ppu_decoder_type::recompiler_llvm && rpcs3::state.config.core.llvm.compile_profile.value())
+			{
+				ppu_recompiler_llvm::RecompilationEngine::GetInstance()->LoadCompileProfile(code_ranges);
+			}
+#endif
+
 			ppu_thread main_thread(OPD.addr(), "main_thread");
 
 			main_thread.args({ Emu.GetPath()/*, "-emu"*/ }).run();
@@ -598,8 +690,69 @@ namespace loader
 			return ok;
 		}
 
+		void elf64::load_segments()
+		{
+			// Chunks of LOAD segments (guest address, file offset, size)
+			std::vector<std::tuple<u32, u64, u32>> chunks;
+
+			for (auto &phdr : m_phdrs)
+			{
+				if (phdr.p_type == 0x00000001 && phdr.p_memsz && phdr.p_filesz)
+				{
+					const u64 file_offset = handler::get_stream_offset() + phdr.p_offset;
+
+					m_stream->Prefetch(file_offset, phdr.p_filesz);
+
+					for (u64 pos = 0; pos < phdr.p_filesz; pos += 0x100000)
+					{
+						chunks.emplace_back(VM_CAST(phdr.p_vaddr.addr() + pos), file_offset + pos, static_cast<u32>(std::min<u64>(phdr.p_filesz - pos, 0x100000)));
+					}
+				}
+			}
+
+			// Read directly into the guest memory (the page cache is copied once if the file is mapped)
+			if (!m_stream->CanReadAt())
+			{
+				for (auto &chunk : chunks)
+				{
+					m_stream->Seek(std::get<1>(chunk));
+					m_stream->Read(vm::base(std::get<0>(chunk)), std::get<2>(chunk));
+				}
+
+				return;
+			}
+
+			std::atomic<u32> next{ 0 };
+
+			auto work = [&]()
+			{
+				for (u32 i; (i = next++) < chunks.size();)
+				{
+					m_stream->ReadAt(std::get<1>(chunks[i]), vm::base(std::get<0>(chunks[i])), std::get<2>(chunks[i]));
+				}
+			};
+
+			const u32 thread_count = std::max<u32>(std::min<u32>(std::thread::hardware_concurrency(), 8), 1);
+
+			std::vector<std::shared_ptr<thread_ctrl>> threads;
+
+			for (u32 i = 1; i < thread_count && i < chunks.size(); i++)
+			{
+				threads.emplace_back(thread_ctrl::spawn(COPY_EXPR(fmt::format("ELF Worker[%u]", i)), work));
+			}
+
+			work();
+
+			for (auto& thread : threads)
+			{
+				thread->join();
+			}
+		}
+
 		handler::error_code elf64::load_data(u64 offset)
 		{
+			load_segments();
+
 			for (auto &phdr : m_phdrs)
 			{
 				switch (phdr.p_type.value())
@@ -610,9 +763,6 @@ namespace loader
 					{
 						if (phdr.p_filesz)
 						{
-							m_stream->Seek(handler::get_stream_offset() + phdr.p_offset);
-							m_stream->Read(phdr.p_vaddr.get_ptr(), phdr.p_filesz);
-
 							if (rpcs3::state.config.core.hook_st_func.value())
 							{
 								hook_ppu_funcs(vm::static_ptr_cast<u32>(phdr.p_vaddr), phdr.p_filesz / 4);
@@ -287,7 +287,7 @@ namespace convert
 			if (value == "recompiler_llvm")
 				return ppu_decoder_type::recompiler_llvm;
 
-			return ppu_decoder_type::interpreter;
+			return ppu_decoder_type::interpreter2;
 		}
 	};
 }
@@ -336,6 +336,45 @@ namespace convert
 	};
 }
 
+enum class reservation_mode_type
+{
+	page_protection,
+	line_compare
+};
+
+namespace convert
+{
+	template<>
+	struct to_impl_t<std::string, reservation_mode_type>
+	{
+		static std::string func(reservation_mode_type value)
+		{
+			switch (value)
+			{
+			case reservation_mode_type::page_protection: return "page_protection";
+			case reservation_mode_type::line_compare: return "line_compare";
+			}
+
+			return "Unknown";
+		}
+	};
+
+	template<>
+	struct to_impl_t<reservation_mode_type, std::string>
+	{
+		static reservation_mode_type func(const std::string &value)
+		{
+			if (value == "page_protection")
+				return reservation_mode_type::page_protection;
+
+			if (value == "line_compare")
+				return reservation_mode_type::line_compare;
+
+			return reservation_mode_type::page_protection;
+		}
+	};
+}
+
 enum class io_camera_state
 {
 	null,
@@ -592,7 +631,16 @@ namespace rpcs3
 				entry<bool> exclusion_range     { this, "Compiled blocks exclusion", false };
 				entry<u32> min_id               { this, "Excluded block range min",  200 };
 				entry<u32> max_id               { this, "Excluded block range max",  250 };
-				entry<u32> threshold            { this, "Compilation threshold",     1000 };
+				entry<u32> threshold            { this, "Compilation threshold",     100 };
+				entry<bool> tiered              { this, "Tiered compilation",        true };
+				entry<u32> optimization_threshold { this, "Optimization threshold",  10000 };
+				entry<bool> link_calls          { this, "Link function calls",       true };
+				entry<bool> aot                 { this, "Ahead-of-time compilation", false };
+				entry<u32> aot_threads          { this, "AOT compilation threads",   4 };
+				entry<u32> compile_threads      { this, "Compilation threads",       2 };
+				entry<bool> object_cache        { this, "Cache compiled objects",    true };
+				entry<bool> profile             { this, "Profile blocks",            false };
+				entry<bool> compile_profile     { this, "Profile-guided compilation", true };
 
 #define MACRO_PPU_INST_MAIN_EXPANDERS(MACRO) \
 	/*MACRO(HACK)*/ \
@@ -836,10 +884,27 @@ namespace rpcs3
 
 			} llvm{ this };
 
-			entry<ppu_decoder_type> ppu_decoder { this, "PPU Decoder",               ppu_decoder_type::interpreter };
+			entry<ppu_decoder_type> ppu_decoder { this, "PPU Decoder",               ppu_decoder_type::interpreter2 };
 			entry<spu_decoder_type> spu_decoder { this, "SPU Decoder",               spu_decoder_type::interpreter_precise };
 			entry<bool> hook_st_func            { this, "Hook static functions",     false };
 			entry<bool> load_liblv2             { this, "Load liblv2.sprx",          false };
+			entry<bool> spu_cache               { this, "SPU Analysis Cache",        true };
+			entry<u32> spu_compiler_threads     { this, "SPU Compiler Threads",      2 };
+			entry<bool> use_tsx                 { this, "Use TSX for reservations",  true };
+			entry<reservation_mode_type> reservation_mode { this, "Reservation Mode", reservation_mode_type::page_protection };
+			entry<bool> spu_async_dma           { this, "Asynchronous SPU DMA",      false };
+			entry<u32> spu_dma_threads          { this, "SPU DMA Threads",           1 };
+			entry<bool> thread_priorities       { this, "Map PPU thread priorities", false };
+			entry<bool> thread_affinity         { this, "Pin threads to cores",      false };
+			entry<bool> ppu_fibers              { this, "Run PPU threads on fibers", false };
+			entry<u32> ppu_fiber_workers        { this, "PPU Fiber Workers",         0 };
+			entry<u32> spu_channel_spin         { this, "SPU Channel Spin Count",    0 };
+			entry<u32> spin_loop_idle           { this, "Spin Loop Idle Threshold",  256 };
+			entry<u32> spu_running_threads      { this, "Max Running SPU Threads",   0 };
+			entry<bool> spu_hle_functions       { this, "SPU HLE Functions",         false };
+			entry<bool> huge_pages              { this, "Use Huge Pages",            false };
+			entry<u32> vdec_threads             { this, "Video Decoder Threads",     0 };
+			entry<bool> vdec_frame_threading    { this, "Video Decoder Frame Threading", true };
 
 		} core{ this };
 
@@ -853,6 +918,8 @@ namespace rpcs3
 				entry<bool> write_depth_buffer  { this, "Write Depth Buffer",  true };
 				entry<bool> read_color_buffers  { this, "Read Color Buffers",  true };
 				entry<bool> read_depth_buffer   { this, "Read Depth Buffer",   true };
+				entry<bool> gpu_vertex_fetch    { this, "GPU Vertex Fetch",    false };
+				entry<bool> gpu_texture_decoding { this, "GPU Texture Decoding", false };
 			} opengl{ this };
 
 			struct d3d12_group : protected group
@@ -871,8 +938,22 @@ namespace rpcs3
 			entry<rsx_aspect_ratio> aspect_ratio{ this, "Aspect ratio",        rsx_aspect_ratio::_16x9 };
 			entry<rsx_frame_limit> frame_limit  { this, "Frame limit",         rsx_frame_limit::Off };
 			entry<bool> log_programs            { this, "Log shader programs", false };
+			entry<bool> perf_overlay            { this, "Performance overlay", false };
 			entry<bool> vsync                   { this, "VSync",               false };
+			entry<bool> present_thread          { this, "Present Thread",      false };
+			entry<u32> present_queue_size       { this, "Present Queue Size",  2 };
+			entry<bool> low_latency_present     { this, "Low Latency Present", false };
+			entry<u32> resolution_scale         { this, "Resolution Scale",    100 };
 			entry<bool> _3dtv                   { this, "3D Monitor",          false };
+			entry<bool> async_fifo              { this, "Asynchronous FIFO",   false };
+			entry<bool> pipeline_cache          { this, "Pipeline Cache",      true };
+			entry<bool> shader_binary_cache     { this, "Shader Binary Cache", true };
+			entry<bool> merge_draws             { this, "Merge Draw Calls",    false };
+			entry<bool> geometry_cache          { this, "Geometry Cache",      false };
+			entry<u32> shader_compiler_threads  { this, "Shader Compiler Threads", 2 };
+			entry<u32> upload_threads           { this, "Upload Threads",      2 };
+			entry<bool> null_benchmark          { this, "Null Renderer Benchmark", false };
+			entry<u32> capture_frames           { this, "Capture Frame Count", 1 };
 
 		} rsx{ this };
 
@@ -883,6 +964,9 @@ namespace rpcs3
 			entry<audio_output_type> out{ this, "Audio Out",         audio_output_type::OpenAL };
 			entry<bool> dump_to_file    { this, "Dump to file",      false };
 			entry<bool> convert_to_u16  { this, "Convert to 16 bit", false };
+			entry<bool> backend_driven  { this, "Backend-driven output", false };
+			entry<u32> latency          { this, "Target latency (ms)", 20 };
+			entry<bool> time_stretch    { this, "Time stretching",   false };
 		} audio{ this };
 
 		struct io_group : protected group
@@ -937,6 +1021,10 @@ namespace rpcs3
 
 				entry<_log::level> level     { this, "Log Level",               _log::level::success };
 				entry<bool> rsx_logging      { this, "RSX Logging",             false };
+				entry<_log::level> hle_level { this, "HLE Module Log Level",    _log::level::notice };
+				entry<bool> binary_trace     { this, "Binary Trace",            false };
+				entry<u32> binary_trace_size { this, "Binary Trace Size (MB)",  256 };
+				entry<bool> timeline         { this, "Timeline",                false };
 			} log{ this };
 
 			struct net_group : protected group
@@ -953,11 +1041,14 @@ namespace rpcs3
 
 				entry<bool> auto_pause_syscall   { this, "Auto Pause at System Call",        false };
 				entry<bool> auto_pause_func_call { this, "Auto Pause at Function Call",      false };
+				entry<bool> syscall_stats        { this, "Syscall Statistics",               false };
 			} debug{ this };
 
 			entry<bool> exit_on_stop             { this, "Exit RPCS3 when process finishes", false };
 			entry<bool> always_start             { this, "Always start after boot",          true };
 			entry<bool> use_default_ini          { this, "Use default configuration",        true };
+			entry<bool> auto_profiles            { this, "Automatic performance profiles",   false };
+			entry<std::string> remote_cache_url  { this, "Remote cache URL",                 "" };
 		} misc{ this };
 
 		struct system_group : protected group
@@ -967,6 +1058,10 @@ namespace rpcs3
 			entry<u32> language                  { this, "Language",                         1 };
 			entry<std::string> emulation_dir_path{ this, "Emulation dir path",               "" };
 			entry<bool> emulation_dir_path_enable{ this, "Use path below as EmulationDir",   false };
+			entry<bool> map_files                { this, "Map read-only files",              true };
+			entry<u32> map_files_threshold       { this, "Mapped file size threshold (KB)",  256 };
+			entry<u32> stream_readahead          { this, "Stream read-ahead window (KB)",    4096 };
+			entry<bool> self_cache               { this, "Cache decrypted SELF files",       true };
 		} system{ this };
 
 		struct vfs_group : public group
@@ -3,6 +3,8 @@
 #include "Emu/Memory/Memory.h"
 #include "Emu/System.h"
 #include "Emu/state.h"
+#include "Emu/PerfCounters.h"
+#include "Emu/Benchmark.h"
 #include "rpcs3.h"
 #include "Gui/ConLogFrame.h"
 #include "Emu/GameInfo.h"
@@ -56,8 +58,16 @@ bool Rpcs3App::OnInit()
 {
 	static const wxCmdLineEntryDesc desc[]
 	{
-		{ wxCMD_LINE_SWITCH, "h", "help", "Command line options:\nh (help): Help and commands\nt (test): For directly executing a (S)ELF", wxCMD_LINE_VAL_NONE, wxCMD_LINE_OPTION_HELP },
+		{ wxCMD_LINE_SWITCH, "h", "help", "Command line options:\nh (help): Help and commands\nt (test): For directly executing a (S)ELF\np (perf): Log performance counters\nr (replay): Replay an RSX capture\nl (loops): Replay count\nb (bench): Benchmark a (S)ELF\nf (frames), s (seconds): Benchmark length\nn (null): Benchmark with the Null renderer\no (report): Benchmark report file", wxCMD_LINE_VAL_NONE, wxCMD_LINE_OPTION_HELP },
 		{ wxCMD_LINE_SWITCH, "t", "test", "Run in test mode on (S)ELF", wxCMD_LINE_VAL_NONE },
+		{ wxCMD_LINE_SWITCH, "p", "perf", "Log performance counters every second", wxCMD_LINE_VAL_NONE },
+		{ wxCMD_LINE_OPTION, "r", "replay", "Replay RSX capture file with the configured renderer", wxCMD_LINE_VAL_STRING },
+		{ wxCMD_LINE_OPTION, "l", "loops", "Number of capture replays (default 100)", wxCMD_LINE_VAL_NUMBER },
+		{ wxCMD_LINE_SWITCH, "b", "bench", "Run (S)ELF without the main window, write a benchmark report and exit", wxCMD_LINE_VAL_NONE },
+		{ wxCMD_LINE_OPTION, "f", "frames", "Benchmark length in frames after the first flip (default 1000 if no length is given)", wxCMD_LINE_VAL_NUMBER },
+		{ wxCMD_LINE_OPTION, "s", "seconds", "Benchmark length in seconds after the first flip", wxCMD_LINE_VAL_NUMBER },
+		{ wxCMD_LINE_SWITCH, "n", "null", "Benchmark with the Null renderer in benchmark mode (no window, no GPU)", wxCMD_LINE_VAL_NONE },
+		{ wxCMD_LINE_OPTION, "o", "report", "Benchmark report file (default RPCS3.bench.json)", wxCMD_LINE_VAL_STRING },
 		{ wxCMD_LINE_PARAM, NULL, NULL, "(S)ELF", wxCMD_LINE_VAL_STRING, wxCMD_LINE_PARAM_OPTIONAL },
 		{ wxCMD_LINE_NONE }
 	};
@@ -128,7 +138,7 @@ bool Rpcs3App::OnInit()
 		{
 		case frame_type::OpenGL: return std::make_unique<GLGSFrame>();
 		case frame_type::DX12: return std::make_unique<GSFrame>("DirectX 12");
-		case frame_type::Null: return std::make_unique<GSFrame>("Null");
+		case frame_type::Null: return rpcs3::state.config.rsx.null_benchmark.value() ? nullptr : std::make_unique<GSFrame>("Null");
 		}
 
 		throw EXCEPTION("Invalid Frame Type");
@@ -180,7 +190,12 @@ bool Rpcs3App::OnInit()
 
 	m_MainFrame = new MainFrame();
 	SetTopWindow(m_MainFrame);
-	m_MainFrame->Show();
+
+	if (!parser.FoundSwitch("b"))
+	{
+		m_MainFrame->Show();
+	}
+
 	m_MainFrame->DoSettings(true);
 
 	OnArguments(parser);
@@ -193,8 +208,13 @@ void Rpcs3App::OnArguments(const wxCmdLineParser& parser)
 	// Usage:
 	//   rpcs3-*.exe               Initializes RPCS3
 	//   rpcs3-*.exe [(S)ELF]      Initializes RPCS3, then loads and runs the specified (S)ELF file.
+	//   rpcs3-*.exe -p [(S)ELF]   Same, with performance counters logged every second and on stop.
+	//   rpcs3-*.exe -r FILE [-l N] Replays an RSX capture N times and logs the time spent per draw.
+	//   rpcs3-*.exe -b [-f N] [-s T] [-n] [-o FILE] (S)ELF
+	//                             Runs the (S)ELF for N frames or T seconds after the first flip (optionally on the Null
+	//                             renderer), writes frame times and CPU utilisation to a JSON report and exits.
 
-	if (parser.FoundSwitch("t"))
+	if (parser.FoundSwitch("t") || parser.FoundSwitch("b"))
 	{
 		HLEExitOnStop = rpcs3::config.misc.exit_on_stop.value();
 		rpcs3::config.misc.exit_on_stop = true;
@@ -204,7 +224,40 @@ void Rpcs3App::OnArguments(const wxCmdLineParser& parser)
 			this->Exit();
 		}
 	}
+
+	if (parser.FoundSwitch("b"))
+	{
+		long frames = 0, seconds = 0;
+		wxString report;
+
+		parser.Found("f", &frames);
+		parser.Found("s", &seconds);
+
+		bench::settings_t settings{};
+		settings.frames = frames > 0 ? (u32)frames : seconds > 0 ? 0 : 1000;
+		settings.seconds = seconds > 0 ? (u32)seconds : 0;
+		settings.null_renderer = parser.FoundSwitch("n");
+		settings.report = parser.Found("o", &report) ? fmt::ToUTF8(report) : fs::get_config_dir() + "RPCS3.bench.json";
+
+		bench::enable(settings);
+	}
 	
+	if (parser.FoundSwitch("p"))
+	{
+		perf::g_log_stats = true;
+	}
+
+	wxString replay;
+
+	if (parser.Found("r", &replay))
+	{
+		long loops = 100;
+		parser.Found("l", &loops);
+
+		Emu.ReplayCapture(fmt::ToUTF8(replay), loops > 0 ? (u32)loops : 1);
+		return;
+	}
+
 	if (parser.GetParamCount() > 0)
 	{
 		Emu.SetPath(fmt::ToUTF8(parser.GetParam(0)));
@@ -215,7 +268,7 @@ void Rpcs3App::OnArguments(const wxCmdLineParser& parser)
 
 void Rpcs3App::Exit()
 {
-	if (parser.FoundSwitch("t"))
+	if (parser.FoundSwitch("t") || parser.FoundSwitch("b"))
 	{
 		rpcs3::config.misc.exit_on_stop = HLEExitOnStop;
 	}
@@ -0,0 +1,205 @@
+// Converts the binary trace (RPCS3.trace, see Utilities/Trace.h) to text.
+// Usage: trace_decode <RPCS3.trace> [output.log]
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+
+// File layout (must match Utilities/Trace.h)
+struct trace_header_t
+{
+	char magic[8];
+	std::uint32_t version;
+	std::uint32_t record_size;
+	std::uint64_t strings_offset;
+	std::uint64_t strings_size;
+	std::uint64_t strings_used;
+	std::uint64_t records_offset;
+	std::uint64_t records_max;
+};
+
+struct trace_record_t
+{
+	std::uint64_t seq;
+	std::uint64_t time;
+	std::uint32_t msg;
+	std::uint32_t thread;
+	std::uint32_t argc;
+	std::uint32_t reserved;
+	std::uint64_t args[4];
+};
+
+static const std::uint32_t trace_version = 1;
+
+static std::string get_string(const std::vector<char>& data, const trace_header_t& header, std::uint32_t id)
+{
+	if (id >= header.strings_used)
+	{
+		return "<unknown>";
+	}
+
+	const char* str = data.data() + header.strings_offset + id;
+
+	return std::string(str, strnlen(str, static_cast<std::size_t>(header.strings_used - id)));
+}
+
+// Format the record using its printf-like format string (integer arguments, %s arguments are string ids)
+static std::string format_record(const std::vector<char>& data, const trace_header_t& header, const trace_record_t& record)
+{
+	const std::string fmt = get_string(data, header, record.msg);
+
+	std::string result;
+	std::uint32_t arg = 0;
+
+	for (std::size_t i = 0; i < fmt.size(); i++)
+	{
+		if (fmt[i] != '%')
+		{
+			result += fmt[i];
+			continue;
+		}
+
+		if (i + 1 < fmt.size() && fmt[i + 1] == '%')
+		{
+			result += '%';
+			i++;
+			continue;
+		}
+
+		// flags, width and precision are passed to snprintf, length modifiers are replaced
+		std::string spec = "%";
+
+		for (i++; i < fmt.size() && std::strchr("-+ #0123456789.", fmt[i]); i++)
+		{
+			spec += fmt[i];
+		}
+
+		while (i < fmt.size() && std::strchr("hlLqjzt", fmt[i]))
+		{
+			i++;
+		}
+
+		if (i >= fmt.size())
+		{
+			break;
+		}
+
+		const char type = fmt[i];
+		const std::uint64_t value = arg < record.argc && arg < 4 ? record.args[arg] : 0;
+		arg++;
+
+		char buf[64];
+
+		switch (type)
+		{
+		case 'd':
+		case 'i':
+			std::snprintf(buf, sizeof(buf), (spec + "lld").c_str(), static_cast<long long>(value));
+			result += buf;
+			break;
+
+		case 'u':
+		case 'x':
+		case 'X':
+		case 'o':
+			std::snprintf(buf, sizeof(buf), (spec + "ll" + type).c_str(), static_cast<unsigned long long>(value));
+			result += buf;
+			break;
+
+		case 'c':
+			result += static_cast<char>(value);
+			break;
+
+		case 's':
+			result += get_string(data, header, static_cast<std::uint32_t>(value));
+			break;
+
+		default:
+			std::snprintf(buf, sizeof(buf), "0x%llx", static_cast<unsigned long long>(value));
+			result += buf;
+			break;
+		}
+	}
+
+	return result;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::fprintf(stderr, "Usage: %s <RPCS3.trace> [output.log]\n", argv[0]);
+		return 1;
+	}
+
+	std::ifstream input(argv[1], std::ios::binary);
+
+	if (!input)
+	{
+		std::fprintf(stderr, "Can't open %s\n", argv[1]);
+		return 1;
+	}
+
+	const std::vector<char> data{ std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>() };
+
+	trace_header_t header;
+
+	if (data.size() < sizeof(header))
+	{
+		std::fprintf(stderr, "Invalid trace file\n");
+		return 1;
+	}
+
+	std::memcpy(&header, data.data(), sizeof(header));
+
+	if (std::memcmp(header.magic, "RPCS3TR", 8) || header.version != trace_version || header.record_size != sizeof(trace_record_t) ||
+		header.strings_offset + header.strings_used > data.size() || header.records_offset + header.records_max * sizeof(trace_record_t) > data.size())
+	{
+		std::fprintf(stderr, "Invalid or unsupported trace file\n");
+		return 1;
+	}
+
+	// collect complete records (the ring buffer may have been overwritten several times)
+	std::vector<trace_record_t> records;
+
+	for (std::uint64_t i = 0; i < header.records_max; i++)
+	{
+		trace_record_t record;
+		std::memcpy(&record, data.data() + header.records_offset + i * sizeof(trace_record_t), sizeof(record));
+
+		if (record.seq && (record.seq - 1) % header.records_max == i)
+		{
+			records.push_back(record);
+		}
+	}
+
+	std::sort(records.begin(), records.end(), [](const trace_record_t& a, const trace_record_t& b)
+	{
+		return a.seq < b.seq;
+	});
+
+	std::FILE* output = argc > 2 ? std::fopen(argv[2], "w") : stdout;
+
+	if (!output)
+	{
+		std::fprintf(stderr, "Can't create %s\n", argv[2]);
+		return 1;
+	}
+
+	for (const auto& record : records)
+	{
+		std::fprintf(output, "[%12.3f us] {%s} %s\n", record.time / 1000.0, get_string(data, header, record.thread).c_str(), format_record(data, header, record).c_str());
+	}
+
+	if (output != stdout)
+	{
+		std::fclose(output);
+	}
+
+	std::fprintf(stderr, "%zu records decoded\n", records.size());
+	return 0;
+}